@@ -6,8 +6,11 @@
 #include "app.h"
 #include "hal/hal.h"
 #include "apps/app_installer.h"
+#include "apps/utils/scheduler/scheduler.h"
 #include <mooncake.h>
 #include <mooncake_log.h>
+#include <smooth_ui_toolkit.h>
+#include <lvgl.h>
 #include <string>
 #include <thread>
 
@@ -24,14 +27,20 @@ void app::Init(InitCallback_t callback)
         callback.onHalInjection();
     }
 
+    // The UI animations step on LVGL's tick, the clock its own anim timer and the display refresh run on, rather
+    // than on a clock of their own: a frame of an animation is never dated differently from the frame it's drawn in
+    smooth_ui_toolkit::ui_hal::on_get_tick([]() { return lv_tick_get(); });
+
     GetMooncake();
 
+    on_fast_resume();
     on_startup_anim();
     on_install_apps();
 }
 
 void app::Update()
 {
+    scheduler::begin_update();
     GetMooncake().update();
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -41,6 +50,16 @@ void app::Update()
 #endif
 }
 
+uint32_t app::IdleTime()
+{
+    return scheduler::idle_time();
+}
+
+void app::Wake()
+{
+    scheduler::wake();
+}
+
 bool app::IsDone()
 {
     return false;
@@ -5,6 +5,7 @@
  */
 #pragma once
 #include <mooncake.h>
+#include <cstdint>
 #include <functional>
 
 /**
@@ -30,6 +31,19 @@ void Init(InitCallback_t callback);
  */
 void Update();
 
+/**
+ * @brief How long the loop can sleep after an Update() before an app is due
+ *
+ * @return 0 to pace the next Update() by the display instead
+ */
+uint32_t IdleTime();
+
+/**
+ * @brief The sleep was cut short by an event or touch input, every app runs on the next Update()
+ *
+ */
+void Wake();
+
 /**
  * @brief
  *
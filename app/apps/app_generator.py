@@ -164,6 +164,19 @@ def installApp(appName):
     app_install_cb_file.write(content_app_install_cb_file)
     app_install_cb_file.close()
 
+    # 添加到应用清单, 不在清单里的应用不会编译
+    manifest_file = open(script_directory + "app_manifest.cmake", mode='r')
+    content_manifest_file = manifest_file.read()
+    manifest_file.close()
+
+    manifest_tag = "# App manifest locator (Don't remove)"
+    content_manifest_file = content_manifest_file.replace(
+        manifest_tag, "{}\n    {}".format(toSnakeCase(appName), manifest_tag))
+
+    manifest_file = open(script_directory + "app_manifest.cmake", mode='w+')
+    manifest_file.write(content_manifest_file)
+    manifest_file.close()
+
 
 if __name__ == "__main__": 
     print("app generator")
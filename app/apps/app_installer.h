@@ -11,21 +11,33 @@
 #include "app_launcher/app_launcher.h"
 #include "app_startup_anim/app_startup_anim.h"
 #include "app_radio/app_radio.h"
+#include "app_radio/fast_resume.h"
 /* Header files locator (Don't remove) */
 
-// Start boot anim app and wait for it to finish
+// Let the radio connect and start its last station behind the boot anim, if that's switched on
+inline void on_fast_resume()
+{
+    // NVS, the settings and saved WiFi are read from it
+    GetHAL()->startWifiAp();
+    radio::start_fast_resume();
+}
+
+inline AppStartupAnim*& startup_anim()
+{
+    static AppStartupAnim* s_startup_anim = nullptr;
+    return s_startup_anim;
+}
+
+// Start boot anim app, it plays on top while the apps are installed and opened beneath it. Not after a software
+// reset, the radio view is back as soon as it's built
 inline void on_startup_anim()
 {
-    auto app_id = mooncake::GetMooncake().installApp(std::make_unique<AppStartupAnim>());
-    mooncake::GetMooncake().openApp(app_id);
-    while (1) {
-        mooncake::GetMooncake().update();
-        if (mooncake::GetMooncake().getAppCurrentState(app_id) == mooncake::AppAbility::StateSleeping) {
-            break;
-        }
-        GetHAL()->delay(1);
+    if (GetHAL()->getWarmRestart(nullptr)) {
+        return;
     }
-    mooncake::GetMooncake().uninstallApp(app_id);
+    auto anim      = std::make_unique<AppStartupAnim>();
+    startup_anim() = anim.get();
+    mooncake::GetMooncake().openApp(mooncake::GetMooncake().installApp(std::move(anim)));
 }
 
 /**
@@ -38,7 +50,14 @@ inline void on_install_apps()
     auto app_id = mooncake::GetMooncake().installApp(std::make_unique<AppRadio>());
     mooncake::GetMooncake().openApp(app_id);
 
-    // Original launcher (commented out - can be restored if needed)
+    // The boot anim is done once the radio view is up and running
+    if (startup_anim()) {
+        startup_anim()->setReadyCheck([app_id]() {
+            return mooncake::GetMooncake().getAppCurrentState(app_id) == mooncake::AppAbility::StateRunning;
+        });
+    }
+
+    // Original launcher (commented out - can be restored if needed, app_launcher goes back into app_manifest.cmake)
     // mooncake::GetMooncake().installApp(std::make_unique<AppLauncher>());
     /* Install app locator (Don't remove) */
 }
@@ -32,9 +32,12 @@ void AppLauncher::onOpen()
     _view->init();
 }
 
-void AppLauncher::onRunning()
+uint32_t AppLauncher::onUpdate()
 {
-    _view->update();
+    // Runs as often as the most eager panel in sight asks, the camera preview needs every frame. Under the LVGL lock
+    // like the radio, the results of background jobs come in on the LVGL thread
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
+    return _view->update();
 }
 
 void AppLauncher::onClose()
@@ -6,20 +6,21 @@
 #pragma once
 #include "view/view.h"
 #include <mooncake.h>
+#include <apps/utils/scheduler/scheduler.h>
 #include <memory>
 
 /**
  * @brief 派生 App
  *
  */
-class AppLauncher : public mooncake::AppAbility {
+class AppLauncher : public scheduler::ScheduledApp {
 public:
     AppLauncher();
 
     // 重写生命周期回调
     void onCreate() override;
     void onOpen() override;
-    void onRunning() override;
+    uint32_t onUpdate() override;
     void onClose() override;
 
 private:
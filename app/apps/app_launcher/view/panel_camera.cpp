@@ -57,9 +57,22 @@ public:
         _camera_canvas->addFlag(LV_OBJ_FLAG_CLICKABLE);
         _camera_canvas->setOpa(0);
         _camera_canvas->onClick().connect([&]() {
+            if (_is_still_pressed) {
+                _is_still_pressed = false;
+                return;
+            }
             _is_camera_minimized = !_is_camera_minimized;
             update_camera_canvas();
+            if (_is_camera_opened) {
+                GetHAL()->setCameraPreviewSize(preview_width(), preview_height());
+            }
         });
+        // Long press for a still at full resolution
+        lv_obj_add_event_cb(_camera_canvas->get(), [](lv_event_t* e) {
+            auto window               = (CameraWindow*)lv_event_get_user_data(e);
+            window->_is_still_pressed = true;
+            GetHAL()->requestCameraStill();
+        }, LV_EVENT_LONG_PRESSED, this);
 
         update_camera_canvas();
     }
@@ -80,10 +93,16 @@ public:
         }
 
         if (!_is_camera_opened) {
-            GetHAL()->startCameraCapture(_camera_canvas->get());
+            GetHAL()->startCameraCapture(_camera_canvas->get(), preview_width(), preview_height());
             _is_camera_opened = true;
             _camera_canvas->setOpa(255);
         }
+
+        std::vector<uint16_t> still;
+        int width, height;
+        if (GetHAL()->takeCameraStill(still, &width, &height)) {
+            mclog::tagInfo(_tag, "still {}x{}", width, height);
+        }
     }
 
     void onClose() override
@@ -97,6 +116,17 @@ private:
     bool _is_camera_opened    = false;
     bool _is_camera_minimized = true;
     bool _is_camera_closing   = false;
+    bool _is_still_pressed    = false;  // Swallows the click that ends a long press
+
+    // Captured at the size it's shown at, no bigger
+    int preview_width() const
+    {
+        return _is_camera_minimized ? 760 : 1280;
+    }
+    int preview_height() const
+    {
+        return _is_camera_minimized ? 440 : 720;
+    }
 
     void update_camera_canvas()
     {
@@ -128,7 +158,7 @@ void PanelCamera::init()
     });
 }
 
-void PanelCamera::update(bool isStacked)
+uint32_t PanelCamera::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -136,4 +166,5 @@ void PanelCamera::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
@@ -8,6 +8,7 @@
 #include "view.h"
 #include <lvgl.h>
 #include <hal/hal.h>
+#include <algorithm>
 #include <memory>
 #include <mooncake_log.h>
 #include <smooth_ui_toolkit.h>
@@ -76,11 +77,13 @@ public:
             return;
         }
 
-        std::lock_guard<std::mutex> lock(GetHAL()->uartMonitorData.mutex);
-        while (!GetHAL()->uartMonitorData.rxQueue.empty()) {
-            uint8_t c = GetHAL()->uartMonitorData.rxQueue.front();
-            GetHAL()->uartMonitorData.rxQueue.pop();
-            _msg_panel->addChar(c);
+        // A block at a time, each add lays the text area out again
+        char text[257];
+        size_t len;
+        while ((len = GetHAL()->uartMonitorData.rx.read((uint8_t*)text, sizeof(text) - 1)) > 0) {
+            std::replace(text, text + len, '\0', ' ');
+            text[len] = '\0';
+            lv_textarea_add_text(_msg_panel->get(), text);
         }
     }
 
@@ -114,7 +117,7 @@ void PanelComMonitor::init()
     });
 }
 
-void PanelComMonitor::update(bool isStacked)
+uint32_t PanelComMonitor::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -122,4 +125,5 @@ void PanelComMonitor::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
@@ -12,6 +12,7 @@
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <apps/utils/audio/audio.h>
+#include <apps/utils/audio/mic_scope.h>
 #include <apps/utils/ui/window.h>
 
 using namespace launcher_view;
@@ -40,6 +41,7 @@ public:
 
         _chart_mic_right = std::make_unique<Chart>(_window->get());
         apply_chart_style(_chart_mic_right.get(), 80, 0);
+        _mic.open();
 
         _rec_btn = std::make_unique<Button>(_window->get());
         _rec_btn->align(LV_ALIGN_CENTER, 267, 0);
@@ -65,12 +67,14 @@ public:
         }
 
         // Record and plot
-        if (_chart_mic_left && _chart_mic_right) {
-            GetHAL()->audioRecord(_record_data, 4);  // 48000 * 4 / 1000 = 192
-            // [MIC-L, AEC, MIC-R, MIC-HP]
-            for (int i = 0; i < _record_data.size(); i += 4) {
-                _chart_mic_left->setNextValue(0, _record_data[i]);
-                _chart_mic_right->setNextValue(0, _record_data[i + 2]);
+        if (_chart_mic_left && _chart_mic_right && _mic.update()) {
+            const int16_t* left = _mic.channel(0);
+            for (int i = 0; i < audio::MicScope::FRAME_SAMPLES; i++) {
+                _chart_mic_left->setNextValue(0, left[i]);
+            }
+            const int16_t* right = _mic.channel(2);
+            for (int i = 0; i < audio::MicScope::FRAME_SAMPLES; i++) {
+                _chart_mic_right->setNextValue(0, right[i]);
             }
         }
     }
@@ -78,13 +82,14 @@ public:
     void onClose() override
     {
         audio::play_next_tone_progression();
+        _mic.close();
         _chart_mic_left.reset();
         _chart_mic_right.reset();
     }
 
 private:
     uint32_t _time_count = 0;
-    std::vector<int16_t> _record_data;
+    audio::MicScope _mic;
     std::unique_ptr<Chart> _chart_mic_left;
     std::unique_ptr<Chart> _chart_mic_right;
     std::unique_ptr<Button> _rec_btn;
@@ -156,7 +161,7 @@ void PanelDualMic::init()
     });
 }
 
-void PanelDualMic::update(bool isStacked)
+uint32_t PanelDualMic::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -164,4 +169,5 @@ void PanelDualMic::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
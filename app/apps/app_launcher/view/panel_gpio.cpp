@@ -237,7 +237,7 @@ void PanelGpioTest::init()
     });
 }
 
-void PanelGpioTest::update(bool isStacked)
+uint32_t PanelGpioTest::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -245,4 +245,5 @@ void PanelGpioTest::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
@@ -12,6 +12,7 @@
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <apps/utils/audio/audio.h>
+#include <apps/utils/audio/mic_scope.h>
 #include <apps/utils/ui/window.h>
 
 using namespace launcher_view;
@@ -37,6 +38,7 @@ public:
 
         _chart_mic = std::make_unique<Chart>(_window->get());
         apply_chart_style(_chart_mic.get(), -55, -26);
+        _mic.open();
 
         _rec_btn = std::make_unique<Button>(_window->get());
         _rec_btn->align(LV_ALIGN_CENTER, 134, -26);
@@ -67,11 +69,10 @@ public:
         }
 
         // Record and plot
-        if (_chart_mic) {
-            GetHAL()->audioRecord(_record_data, 4);  // 48000 * 4 / 1000 = 192
-            // [MIC-L, AEC, MIC-R, MIC-HP]
-            for (int i = 0; i < _record_data.size(); i += 4) {
-                _chart_mic->setNextValue(0, _record_data[i + 3]);
+        if (_chart_mic && _mic.update()) {
+            const int16_t* headphone = _mic.channel(3);
+            for (int i = 0; i < audio::MicScope::FRAME_SAMPLES; i++) {
+                _chart_mic->setNextValue(0, headphone[i]);
             }
         }
     }
@@ -79,12 +80,13 @@ public:
     void onClose() override
     {
         audio::play_next_tone_progression();
+        _mic.close();
         _chart_mic.reset();
     }
 
 private:
     uint32_t _time_count = 0;
-    std::vector<int16_t> _record_data;
+    audio::MicScope _mic;
     std::unique_ptr<Chart> _chart_mic;
     std::unique_ptr<Button> _rec_btn;
     std::unique_ptr<Spinner> _rec_btn_spinner;
@@ -167,7 +169,7 @@ void PanelHeadphone::init()
     });
 }
 
-void PanelHeadphone::update(bool isStacked)
+uint32_t PanelHeadphone::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -175,4 +177,5 @@ void PanelHeadphone::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
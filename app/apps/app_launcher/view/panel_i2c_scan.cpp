@@ -28,6 +28,9 @@ static const std::string _toast_msg_ext_5v_disable = "EXT 5V disabled";
 static const ui::Window::KeyFrame_t _kf_rtc_setting_close = {-505, 229, 75, 75, 0};
 static const ui::Window::KeyFrame_t _kf_rtc_setting_open  = {-356, -12, 512, 356, 255};
 
+// Port A has no detect line, while it's shown it's asked for again this often to catch what gets plugged in
+static constexpr uint32_t _port_a_rescan_ms = 2000;
+
 class I2cScanWindow : public ui::Window {
 public:
     I2cScanWindow()
@@ -50,10 +53,10 @@ public:
         _btn_porta_scan->setOpa(0);
         _btn_porta_scan->onClick().connect([&] {
             _is_scanning_internal = false;
-            _scan_time_count      = 0;
             audio::play_tone_from_midi(60 + 24);
             update_i2c_dev_chart();
             update_btn_ext5v_on();
+            start_scan();
         });
 
         _btn_internal_scan = std::make_unique<Container>(_window->get());
@@ -62,10 +65,10 @@ public:
         _btn_internal_scan->setOpa(0);
         _btn_internal_scan->onClick().connect([&] {
             _is_scanning_internal = true;
-            _scan_time_count      = 0;
             audio::play_tone_from_midi(63 + 24);
             update_i2c_dev_chart();
             update_btn_ext5v_on();
+            start_scan();
         });
 
         _btn_ext5v_on = std::make_unique<Image>(_window->get());
@@ -84,6 +87,8 @@ public:
         update_btn_ext5v_on();
 
         GetHAL()->initPortAI2c();
+        _events = GetHAL()->subscribeEvents();
+        start_scan();
     }
 
     void onUpdate() override
@@ -92,31 +97,28 @@ public:
             return;
         }
 
-        if (GetHAL()->millis() - _scan_time_count < 300) {
-            return;
+        // The scans run off the UI thread, here their maps are only shown
+        hal::HalBase::Event_t event;
+        while (GetHAL()->pollEvent(_events, &event)) {
+            if (event.type == hal::HalBase::EVENT_RESYNC ||
+                (event.type == hal::HalBase::EVENT_I2C_SCAN && event.value == _is_scanning_internal)) {
+                show_devices();
+            }
         }
-
-        // Scan and create labels
-        std::vector<uint8_t> addrs;
-        if (!_is_scanning_internal && !GetHAL()->getExt5vEnable()) {
-            // Scan without ext 5v cause no response blocking
-        } else {
-            addrs = GetHAL()->i2cScan(_is_scanning_internal);
+        if (!_is_scanning_internal && GetHAL()->millis() - _scan_time_count >= _port_a_rescan_ms) {
+            start_scan();
         }
-        _label_addrs.clear();
-        for (auto addr : addrs) {
-            _label_addrs.push_back(std::make_unique<Label>(_window->get()));
-            apply_addr_label_style(_label_addrs.back().get(), addr);
-        }
-
-        _scan_time_count = GetHAL()->millis();
     }
 
     void onClose() override
     {
         audio::play_next_tone_progression();
+        GetHAL()->unsubscribeEvents(_events);
+        _events = -1;
         _label_addrs.clear();
         _img_i2c_dev_chart.reset();
+        assets::release_image(assets::INTERNAL_I2C_DEV_CHART);
+        assets::release_image(assets::PORTA_I2C_DEV_CHART);
         GetHAL()->deinitPortAI2c();
     }
 
@@ -128,13 +130,33 @@ private:
     std::vector<std::unique_ptr<Label>> _label_addrs;
     bool _is_scanning_internal = true;
     uint32_t _scan_time_count  = 0;
+    int _events                = -1;
+
+    // Shows what the last scan of the bus found straight away, its own map replaces it when it's done
+    void start_scan()
+    {
+        GetHAL()->startI2cScan(_is_scanning_internal);
+        _scan_time_count = GetHAL()->millis();
+        show_devices();
+    }
+
+    void show_devices()
+    {
+        std::vector<uint8_t> addrs;
+        GetHAL()->getI2cDevices(_is_scanning_internal, &addrs);
+        _label_addrs.clear();
+        for (auto addr : addrs) {
+            _label_addrs.push_back(std::make_unique<Label>(_window->get()));
+            apply_addr_label_style(_label_addrs.back().get(), addr);
+        }
+    }
 
     void update_i2c_dev_chart()
     {
         if (_is_scanning_internal) {
-            _img_i2c_dev_chart->setSrc(&internal_i2c_dev_chart);
+            assets::set_image(_img_i2c_dev_chart->get(), assets::INTERNAL_I2C_DEV_CHART);
         } else {
-            _img_i2c_dev_chart->setSrc(&porta_i2c_dev_chart);
+            assets::set_image(_img_i2c_dev_chart->get(), assets::PORTA_I2C_DEV_CHART);
         }
     }
 
@@ -183,7 +205,7 @@ void PanelI2cScan::init()
     });
 }
 
-void PanelI2cScan::update(bool isStacked)
+uint32_t PanelI2cScan::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -191,4 +213,5 @@ void PanelI2cScan::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
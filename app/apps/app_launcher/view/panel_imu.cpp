@@ -77,16 +77,18 @@ void PanelImu::init()
     _anim_size.play();
 }
 
-void PanelImu::update(bool isStacked)
+uint32_t PanelImu::update(bool isStacked)
 {
-    if (!(_anim_x.done() && _anim_y.done() && _anim_size.done())) {
+    bool moving = !(_anim_x.done() && _anim_y.done() && _anim_size.done());
+    if (moving) {
         _accel_dot->setPos(_anim_x, _anim_y);
         _anim_size.update();
         _accel_dot->setSize(_anim_size.directValue(), _anim_size.directValue());
     }
 
-    if (GetHAL()->millis() - _time_count < 100) {
-        return;
+    uint32_t elapsed = GetHAL()->millis() - _time_count;
+    if (elapsed < 100) {
+        return moving ? scheduler::EVERY_FRAME : 100 - elapsed;
     }
 
     GetHAL()->updateImuData();
@@ -117,4 +119,5 @@ void PanelImu::update(bool isStacked)
     }
 
     _time_count = GetHAL()->millis();
+    return scheduler::EVERY_FRAME;  // The dot moves to the new reading
 }
@@ -88,9 +88,11 @@ void PanelLcdBacklight::init()
     _label_y_anim.teleport(_label_pos_y);
 }
 
-void PanelLcdBacklight::update(bool isStacked)
+uint32_t PanelLcdBacklight::update(bool isStacked)
 {
     if (!_label_y_anim.done()) {
         _label_brightness->setY(_label_y_anim);
+        return scheduler::EVERY_FRAME;
     }
+    return IDLE_MS;
 }
@@ -11,6 +11,7 @@
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <apps/utils/audio/audio.h>
+#include <apps/utils/audio/mic_scope.h>
 #include <apps/utils/ui/window.h>
 #include <apps/utils/ui/toast.h>
 
@@ -50,6 +51,7 @@ public:
 
         _chart_aec = std::make_unique<Chart>(_window->get());
         apply_chart_style(_chart_aec.get(), -60, -17);
+        _mic.open(20);
 
         _rec_btn = std::make_unique<Button>(_window->get());
         _rec_btn->align(LV_ALIGN_CENTER, 135, 0);
@@ -77,11 +79,10 @@ public:
     void onUpdate() override
     {
         // Record and plot
-        if (_chart_aec) {
-            GetHAL()->audioRecord(_record_data, 4, 20);  // 48000 * 4 / 1000 = 192
-            // [MIC-L, AEC, MIC-R, MIC-HP]
-            for (int i = 0; i < _record_data.size(); i += 4) {
-                _chart_aec->setNextValue(0, _record_data[i + 1]);
+        if (_chart_aec && _mic.update()) {
+            const int16_t* aec = _mic.channel(1);
+            for (int i = 0; i < audio::MicScope::FRAME_SAMPLES; i++) {
+                _chart_aec->setNextValue(0, aec[i]);
             }
         }
 
@@ -100,12 +101,13 @@ public:
         GetHAL()->stopPlayMusicTest();
         _rec_btn.reset();
         _rec_btn_spinner.reset();
+        _mic.close();
         _chart_aec.reset();
     }
 
 private:
     uint32_t _time_count = 0;
-    std::vector<int16_t> _record_data;
+    audio::MicScope _mic;
     std::unique_ptr<Button> _rec_btn;
     std::unique_ptr<Spinner> _rec_btn_spinner;
     std::unique_ptr<Chart> _chart_aec;
@@ -169,7 +171,7 @@ void PanelMusic::init()
     });
 }
 
-void PanelMusic::update(bool isStacked)
+uint32_t PanelMusic::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -177,4 +179,5 @@ void PanelMusic::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
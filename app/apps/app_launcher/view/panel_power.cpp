@@ -263,7 +263,7 @@ void PanelPower::init()
     });
 }
 
-void PanelPower::update(bool isStacked)
+uint32_t PanelPower::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -271,4 +271,5 @@ void PanelPower::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
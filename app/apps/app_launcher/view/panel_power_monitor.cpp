@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: MIT
  */
 #include "view.h"
+#include <algorithm>
 #include <cstdint>
 #include <lvgl.h>
 #include <hal/hal.h>
@@ -54,7 +55,7 @@ void PanelPowerMonitor::init()
     _img_chg_arrow_down->setSrc(&chg_arrow_down);
 }
 
-void PanelPowerMonitor::update(bool isStacked)
+uint32_t PanelPowerMonitor::update(bool isStacked)
 {
     if (GetHAL()->millis() - _pm_data_update_time_count > 100) {
         GetHAL()->updatePowerMonitorData();
@@ -77,4 +78,7 @@ void PanelPowerMonitor::update(bool isStacked)
         _label_cpu_temp->setText(fmt::format("{}", GetHAL()->getCpuTemp()));
         _cpu_temp_update_time_count = GetHAL()->millis();
     }
+
+    uint32_t now = GetHAL()->millis();
+    return std::min<uint32_t>(_pm_data_update_time_count + 100 - now, _cpu_temp_update_time_count + 1000 - now) + 1;
 }
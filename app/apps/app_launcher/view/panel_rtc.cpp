@@ -182,7 +182,7 @@ void PanelRtc::init()
     });
 }
 
-void PanelRtc::update(bool isStacked)
+uint32_t PanelRtc::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -191,8 +191,9 @@ void PanelRtc::update(bool isStacked)
         }
     }
 
-    if (GetHAL()->millis() - _time_count < 1000) {
-        return;
+    uint32_t elapsed = GetHAL()->millis() - _time_count;
+    if (elapsed < 1000) {
+        return _window ? scheduler::EVERY_FRAME : 1000 - elapsed;
     }
 
     std::time_t now    = std::time(nullptr);
@@ -202,4 +203,5 @@ void PanelRtc::update(bool isStacked)
     _label_date->setText(fmt::format("{}/{}/{}", localTime->tm_year + 1900, localTime->tm_mon + 1, localTime->tm_mday));
 
     _time_count = GetHAL()->millis();
+    return _window ? scheduler::EVERY_FRAME : 1000;
 }
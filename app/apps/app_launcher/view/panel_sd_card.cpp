@@ -52,7 +52,7 @@ public:
             _label_msg->setText("Scanning SD Card ...");
         } else {
             _label_msg->setTextColor(lv_color_hex(0xFD4444));
-            _label_msg->setText("SD Card not mounted.\n\nPlease insert SD Card and reboot.");
+            _label_msg->setText("SD Card not mounted.\n\nPlease insert SD Card.");
         }
     }
 
@@ -63,35 +63,19 @@ public:
         }
 
         if (GetHAL()->isSdCardMounted() && !_is_scanned) {
-            _is_scanned       = true;
-            auto file_entries = GetHAL()->scanSdCard("/");
-            if (file_entries.empty()) {
-                _label_msg->setText("No files found on SD Card.");
-                return;
-            }
-
-            _label_file_entries.clear();
-
-            for (size_t i = 0; i < file_entries.size(); i++) {
-                _label_file_entries.push_back(std::make_unique<Label>(_panel_file_entries->get()));
-                _label_file_entries.back()->align(LV_ALIGN_TOP_LEFT, 0, i * 42);
-                _label_file_entries.back()->setTextFont(&lv_font_montserrat_24);
-                if (file_entries[i].isDir) {
-                    _label_file_entries.back()->setTextColor(lv_color_hex(0xFDBE1A));
-                    lv_label_set_text(_label_file_entries.back()->get(), LV_SYMBOL_DIRECTORY);
-                } else {
-                    _label_file_entries.back()->setTextColor(lv_color_hex(0x43D2FF));
-                    lv_label_set_text(_label_file_entries.back()->get(), LV_SYMBOL_FILE);
-                }
-
-                _label_file_entries.push_back(std::make_unique<Label>(_panel_file_entries->get()));
-                _label_file_entries.back()->align(LV_ALIGN_TOP_LEFT, 36, i * 42);
-                _label_file_entries.back()->setTextFont(&lv_font_montserrat_24);
-                _label_file_entries.back()->setTextColor(lv_color_hex(file_entries[i].isDir ? 0xFDBE1A : 0x43D2FF));
-                _label_file_entries.back()->setText(file_entries[i].name);
+            _is_scanned = true;
+            _listing    = std::make_shared<Listing_t>();
+            if (_label_msg) {
+                _label_msg->setTextColor(lv_color_hex(0xFFFFFF));
+                _label_msg->setText("Scanning SD Card ...");
             }
+            load_next_page();
+        }
 
-            _label_msg.reset();
+        // The next page once the list is scrolled close to its end
+        if (_listing && !_listing->loading && !_listing->done && _panel_file_entries &&
+            lv_obj_get_scroll_bottom(_panel_file_entries->get()) < SCROLL_AHEAD) {
+            load_next_page();
         }
     }
 
@@ -101,13 +85,95 @@ public:
         _label_msg.reset();
         _label_file_entries.clear();
         _panel_file_entries.reset();
+        _listing.reset();
     }
 
 private:
+    static constexpr int PAGE_ENTRIES = 32;
+    static constexpr int SCROLL_AHEAD = 200;  // Pixels left below the view when the next page is read
+
+    // Shared with the reads in the background, whoever drops it last closes the cursor
+    struct Listing_t {
+        int cursor   = -1;
+        bool loading = false;
+        bool done    = false;
+        std::vector<hal::HalBase::FileEntry_t> page;
+        ~Listing_t()
+        {
+            if (cursor >= 0) {
+                GetHAL()->closeSdCardDir(cursor);
+            }
+        }
+    };
+
     std::unique_ptr<Label> _label_msg;
     std::unique_ptr<Container> _panel_file_entries;
     std::vector<std::unique_ptr<Label>> _label_file_entries;
     bool _is_scanned = false;
+    int _row_count   = 0;
+    std::shared_ptr<Listing_t> _listing;
+    std::shared_ptr<bool> _alive = std::make_shared<bool>(true);  // Gone with the window, for the reads' results
+
+    // Reading the card blocks, the window keeps moving meanwhile
+    void load_next_page()
+    {
+        auto listing     = _listing;
+        listing->loading = true;
+        GetHAL()->runInBackground(
+            [listing]() {
+                if (listing->cursor < 0) {
+                    listing->cursor = GetHAL()->openSdCardDir("/");
+                }
+                listing->page.clear();
+                if (listing->cursor >= 0) {
+                    listing->page = GetHAL()->readSdCardDir(listing->cursor, PAGE_ENTRIES);
+                }
+            },
+            [this, alive = std::weak_ptr<bool>(_alive), listing]() {
+                listing->loading = false;
+                listing->done    = (int)listing->page.size() < PAGE_ENTRIES;
+                if (!alive.expired() && listing == _listing) {
+                    show_file_entries(listing->page);
+                    if (listing->done) {
+                        _listing.reset();  // Closes the cursor, the rows stay
+                    }
+                }
+            });
+    }
+
+    void show_file_entries(const std::vector<hal::HalBase::FileEntry_t>& file_entries)
+    {
+        if (!_panel_file_entries) {
+            return;  // Closed meanwhile
+        }
+        if (file_entries.empty() && _row_count == 0) {
+            if (_label_msg) {
+                _label_msg->setText("No files found on SD Card.");
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < file_entries.size(); i++, _row_count++) {
+            _label_file_entries.push_back(std::make_unique<Label>(_panel_file_entries->get()));
+            _label_file_entries.back()->align(LV_ALIGN_TOP_LEFT, 0, _row_count * 42);
+            _label_file_entries.back()->setTextFont(&lv_font_montserrat_24);
+            if (file_entries[i].isDir) {
+                _label_file_entries.back()->setTextColor(lv_color_hex(0xFDBE1A));
+                lv_label_set_text(_label_file_entries.back()->get(), LV_SYMBOL_DIRECTORY);
+            } else {
+                _label_file_entries.back()->setTextColor(lv_color_hex(0x43D2FF));
+                lv_label_set_text(_label_file_entries.back()->get(), LV_SYMBOL_FILE);
+            }
+
+            _label_file_entries.push_back(std::make_unique<Label>(_panel_file_entries->get()));
+            _label_file_entries.back()->align(LV_ALIGN_TOP_LEFT, 36, _row_count * 42);
+            _label_file_entries.back()->setTextFont(&lv_font_montserrat_24);
+            _label_file_entries.back()->setTextColor(lv_color_hex(file_entries[i].isDir ? 0xFDBE1A : 0x43D2FF));
+            _label_file_entries.back()->setText(file_entries[i].name);
+        }
+
+        _label_msg.reset();
+    }
 };
 
 void PanelSdCard::init()
@@ -126,7 +192,7 @@ void PanelSdCard::init()
     });
 }
 
-void PanelSdCard::update(bool isStacked)
+uint32_t PanelSdCard::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -134,4 +200,5 @@ void PanelSdCard::update(bool isStacked)
             _window.reset();
         }
     }
+    return _window ? scheduler::EVERY_FRAME : IDLE_MS;
 }
@@ -87,9 +87,11 @@ void PanelSpeakerVolume::init()
     _label_y_anim.teleport(_label_pos_y);
 }
 
-void PanelSpeakerVolume::update(bool isStacked)
+uint32_t PanelSpeakerVolume::update(bool isStacked)
 {
     if (!_label_y_anim.done()) {
         _label_volume->setY(_label_y_anim);
+        return scheduler::EVERY_FRAME;
     }
+    return IDLE_MS;
 }
@@ -288,7 +288,7 @@ void PanelSwitches::init()
     update_detect_images();
 }
 
-void PanelSwitches::update(bool isStacked)
+uint32_t PanelSwitches::update(bool isStacked)
 {
     if (_window) {
         _window->update();
@@ -302,6 +302,7 @@ void PanelSwitches::update(bool isStacked)
         update_detect_images();
         _time_count = GetHAL()->millis();
     }
+    return _window ? scheduler::EVERY_FRAME : _time_count + 201 - GetHAL()->millis();
 }
 
 void PanelSwitches::update_images()
@@ -11,6 +11,7 @@
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <apps/utils/audio/audio.h>
+#include <algorithm>
 
 using namespace launcher_view;
 using namespace smooth_ui_toolkit;
@@ -25,7 +26,7 @@ void LauncherView::init()
     ui::signal_window_opened().clear();
     ui::signal_window_opened().connect([&](bool opened) { _is_stacked = opened; });
 
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_OPEN);
 
     // Base screen
     lv_obj_remove_flag(lv_screen_active(), LV_OBJ_FLAG_SCROLLABLE);
@@ -33,7 +34,7 @@ void LauncherView::init()
     // Background image
     _img_bg = std::make_unique<Image>(lv_screen_active());
     _img_bg->setAlign(LV_ALIGN_CENTER);
-    _img_bg->setSrc(&launcher_bg);
+    assets::set_image(_img_bg->get(), assets::LAUNCHER_BG);
 
     // Install panels
     _panels.push_back(std::make_unique<PanelRtc>());
@@ -55,13 +56,28 @@ void LauncherView::init()
     for (auto& panel : _panels) {
         panel->init();
     }
+    _panel_due_at.assign(_panels.size(), GetHAL()->millis());
 }
 
-void LauncherView::update()
+uint32_t LauncherView::update()
 {
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
 
-    for (auto& panel : _panels) {
-        panel->update(_is_stacked);
+    uint32_t now      = GetHAL()->millis();
+    bool touched      = scheduler::input_active();
+    uint32_t next_due = PanelBase::IDLE_MS;
+    for (size_t i = 0; i < _panels.size(); i++) {
+        // Covered by the open window, left as it is until that closes
+        if (_is_stacked && !_panels[i]->hasWindow()) {
+            continue;
+        }
+        if (!touched && (int32_t)(now - _panel_due_at[i]) < 0) {
+            next_due = std::min(next_due, _panel_due_at[i] - now);
+            continue;
+        }
+        uint32_t period  = _panels[i]->update(_is_stacked);
+        _panel_due_at[i] = now + period;
+        next_due         = std::min(next_due, period);
     }
+    return next_due;
 }
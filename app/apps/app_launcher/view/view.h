@@ -8,6 +8,7 @@
 #include <memory>
 #include <lvgl.h>
 #include <apps/utils/ui/window.h>
+#include <apps/utils/scheduler/scheduler.h>
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <vector>
@@ -15,17 +16,31 @@
 namespace launcher_view {
 
 /**
- * @brief
+ * @brief A tile of the launcher, updated only while it can be seen
  *
+ * `update()` returns the ms until the panel wants to run again, scheduler::EVERY_FRAME while something of it moves,
+ * and isn't called before that's up (a touch on the screen runs every panel in sight). While a window is open, only
+ * the panel owning it is updated: the rest are covered, they neither poll their hardware nor touch their widgets until
+ * it closes.
  */
 class PanelBase {
 public:
+    // From update(): nothing to do until the next touch
+    static constexpr uint32_t IDLE_MS = 60 * 1000;
+
     virtual ~PanelBase()
     {
     }
 
-    virtual void init()                 = 0;
-    virtual void update(bool isStacked) = 0;
+    virtual void init()                     = 0;
+    virtual uint32_t update(bool isStacked) = 0;
+
+    bool hasWindow() const
+    {
+        return _window != nullptr;
+    }
+
+protected:
 };
 
 /**
@@ -35,14 +50,13 @@ public:
 class PanelRtc : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     uint32_t _time_count = 0;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _label_time;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _label_date;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_rtc_setting;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -52,7 +66,7 @@ private:
 class PanelLcdBacklight : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _label_brightness;
@@ -68,7 +82,7 @@ private:
 class PanelSpeakerVolume : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _label_volume;
@@ -84,7 +98,7 @@ private:
 class PanelPowerMonitor : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     uint32_t _pm_data_update_time_count  = 0;
@@ -103,7 +117,7 @@ private:
 class PanelImu : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     uint32_t _time_count = 0;
@@ -123,7 +137,7 @@ private:
 class PanelSwitches : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     uint32_t _time_count = 0;
@@ -143,7 +157,6 @@ private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Image> _img_hp_detect;
 
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_ap_msg;
-    std::unique_ptr<ui::Window> _window;
 
     bool _last_usb_c_detect = false;
     bool _last_usb_a_detect = false;
@@ -161,14 +174,13 @@ private:
 class PanelPower : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_power_off;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_sleep_touch_wakeup;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_sleep_shake_wakeup;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_sleep_rtc_wakeup;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -178,11 +190,10 @@ private:
 class PanelCamera : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_camera;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -192,11 +203,10 @@ private:
 class PanelDualMic : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_mic_test;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -206,11 +216,10 @@ private:
 class PanelHeadphone : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_headphone_test;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -220,11 +229,10 @@ private:
 class PanelSdCard : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_sd_card_scan;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -234,11 +242,10 @@ private:
 class PanelI2cScan : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_i2c_scan;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -248,11 +255,10 @@ private:
 class PanelGpioTest : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_gpio_test;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -262,11 +268,10 @@ private:
 class PanelMusic : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_music_test;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -276,11 +281,10 @@ private:
 class PanelComMonitor : public PanelBase {
 public:
     void init() override;
-    void update(bool isStacked) override;
+    uint32_t update(bool isStacked) override;
 
 private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _btn_com_monitor;
-    std::unique_ptr<ui::Window> _window;
 };
 
 /**
@@ -290,12 +294,17 @@ private:
 class LauncherView {
 public:
     void init();
-    void update();
+
+    /**
+     * @return ms until a panel in sight is due again
+     */
+    uint32_t update();
 
 private:
     bool _is_stacked = false;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Image> _img_bg;
     std::vector<std::unique_ptr<PanelBase>> _panels;
+    std::vector<uint32_t> _panel_due_at;
 
     void update_anim();
 };
@@ -0,0 +1,68 @@
+# Apps built into the firmware, by folder name under app/apps. One left out isn't compiled, and neither are the images
+# in app/assets/images only it draws. app_generator.py adds a new app here, as well as to app_installer.h
+set(APP_MANIFEST
+    app_startup_anim
+    app_radio
+    # App manifest locator (Don't remove)
+)
+
+# The images (app/assets/images/<name>.c) each app draws, the HAL's are always built
+set(APP_IMAGES_HAL mouse_cursor)
+set(APP_IMAGES_app_startup_anim logo_tab logo_5)
+set(APP_IMAGES_app_launcher
+    sw_chg_off sw_chg_on sw_off sw_on sw_qc_off sw_qc_on sw_rf_h sw_rf_l
+    arrow_state_on porta_i2c_ext5v_on chg_arrow_down chg_arrow_up
+)
+
+# The app layer's sources under APP_DIR into OUT_VAR: everything but the apps not in APP_MANIFEST (app_template is
+# only the generator's template) and the images none of the built apps draw
+function(app_layer_sources APP_DIR OUT_VAR)
+    get_filename_component(APP_DIR ${APP_DIR} ABSOLUTE)
+    file(GLOB_RECURSE srcs
+        ${APP_DIR}/*.c
+        ${APP_DIR}/*.cc
+        ${APP_DIR}/*.cpp
+    )
+
+    file(GLOB app_dirs LIST_DIRECTORIES true ${APP_DIR}/apps/app_*)
+    foreach(dir ${app_dirs})
+        get_filename_component(app ${dir} NAME)
+        if(IS_DIRECTORY ${dir} AND NOT app IN_LIST APP_MANIFEST)
+            list(FILTER srcs EXCLUDE REGEX "^${dir}/")
+        endif()
+    endforeach()
+
+    set(images ${APP_IMAGES_HAL})
+    foreach(app ${APP_MANIFEST})
+        list(APPEND images ${APP_IMAGES_${app}})
+    endforeach()
+    file(GLOB image_srcs ${APP_DIR}/assets/images/*.c)
+    foreach(image ${image_srcs})
+        get_filename_component(name ${image} NAME_WE)
+        if(NOT name IN_LIST images)
+            list(REMOVE_ITEM srcs ${image})
+        endif()
+    endforeach()
+
+    set(${OUT_VAR} ${srcs} PARENT_SCOPE)
+endfunction()
+
+# The built-in station table for TARGET: app_radio/gen_stations.py turns app_radio/stations.json into
+# stations_builtin.h in the build tree, which stations.h includes. Regenerated when the manifest or the generator
+# changes, before anything of TARGET compiles
+function(app_station_table TARGET APP_DIR PYTHON)
+    get_filename_component(APP_DIR ${APP_DIR} ABSOLUTE)
+    set(manifest ${APP_DIR}/apps/app_radio/stations.json)
+    set(generator ${APP_DIR}/apps/app_radio/gen_stations.py)
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/generated)
+    add_custom_command(
+        OUTPUT ${out_dir}/stations_builtin.h
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${out_dir}
+        COMMAND ${PYTHON} ${generator} ${manifest} ${out_dir}/stations_builtin.h
+        DEPENDS ${manifest} ${generator}
+        COMMENT "Generating the built-in station table"
+        VERBATIM
+    )
+    target_sources(${TARGET} PRIVATE ${out_dir}/stations_builtin.h)
+    target_include_directories(${TARGET} PUBLIC ${out_dir})
+endfunction()
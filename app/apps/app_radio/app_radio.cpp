@@ -5,6 +5,7 @@
  */
 #include "app_radio.h"
 #include "view/radio_view.h"
+#include "radio_session.h"
 #include <mooncake_log.h>
 #include <hal/hal.h>
 
@@ -28,26 +29,31 @@ void AppRadio::onOpen()
 {
     mclog::tagInfo(TAG, "onOpen");
 
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_OPEN);
     _view = std::make_unique<radio_view::RadioView>();
     _view->init();
 }
 
-void AppRadio::onRunning()
+uint32_t AppRadio::onUpdate()
 {
-    if (_view) {
-        LvglLockGuard lock;
-        _view->update();
+    if (!_view) {
+        return scheduler::EVERY_FRAME;
     }
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
+    return _view->update();
+}
+
+void AppRadio::onSleeping()
+{
+    // Another app is in front, the station plays on and the remote's commands still get done
+    radio::session().update();
 }
 
 void AppRadio::onClose()
 {
     mclog::tagInfo(TAG, "onClose");
 
-    // Stop any playing stream
-    GetHAL()->stopRadioStream();
-
-    LvglLockGuard lock;
+    // Only the view goes, the session keeps the stream
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_OPEN);
     _view.reset();
 }
@@ -5,6 +5,7 @@
  */
 #pragma once
 #include <mooncake.h>
+#include <apps/utils/scheduler/scheduler.h>
 #include <memory>
 
 namespace radio_view {
@@ -13,16 +14,18 @@ class RadioView;
 
 /**
  * @brief SomaFM Web Radio Player Application
- * Standalone app for streaming internet radio stations
+ * Standalone app for streaming internet radio stations. The view is its UI, what plays is radio::session()'s and
+ * carries on while another app is open
  */
-class AppRadio : public mooncake::AppAbility {
+class AppRadio : public scheduler::ScheduledApp {
 public:
     AppRadio();
     ~AppRadio() override;
 
     void onCreate() override;
     void onOpen() override;
-    void onRunning() override;
+    uint32_t onUpdate() override;
+    void onSleeping() override;
     void onClose() override;
 
 private:
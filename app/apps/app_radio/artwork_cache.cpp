@@ -0,0 +1,340 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "artwork_cache.h"
+#include "../utils/json/json_sax.h"
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <cctype>
+#include <cstdio>
+
+using namespace radio;
+
+static const char* TAG = "artwork";
+
+/* -------------------------------------------------------------------------- */
+/*                                   Storage                                  */
+/* -------------------------------------------------------------------------- */
+// One file per station: a small header and the raw pixels, read straight back into a thumbnail
+static constexpr uint32_t THUMB_MAGIC = 0x31545241;  // "ART1"
+
+struct ThumbHeader_t {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+};
+
+static std::string thumb_path(const std::string& id)
+{
+    std::string dir = GetHAL()->getDataDir();
+    if (dir.empty()) {
+        return "";
+    }
+
+    // Hashed, SPIFFS names are short and station ids aren't bounded
+    uint32_t hash = 2166136261u;
+    for (char c : id) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    char name[24];
+    snprintf(name, sizeof(name), "/art_%08x.565", (unsigned)hash);
+    return dir + name;
+}
+
+static bool read_thumb(const std::string& path, std::vector<uint16_t>* pixels)
+{
+    FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    ThumbHeader_t header;
+    size_t count = (size_t)ArtworkCache::SIZE * ArtworkCache::SIZE;
+    pixels->resize(count);
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == THUMB_MAGIC &&
+              header.width == ArtworkCache::SIZE && header.height == ArtworkCache::SIZE &&
+              fread(pixels->data(), sizeof(uint16_t), count, file) == count;
+    fclose(file);
+    if (!ok) {
+        pixels->clear();
+    }
+    return ok;
+}
+
+static void write_thumb(const std::string& path, const std::vector<uint16_t>& pixels)
+{
+    FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+
+    ThumbHeader_t header = {THUMB_MAGIC, ArtworkCache::SIZE, ArtworkCache::SIZE};
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(pixels.data(), sizeof(uint16_t), pixels.size(), file) == pixels.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        // A partial file fails the size check on read, but would take the space
+        mclog::tagWarn(TAG, "Failed to write {}", path);
+        remove(path.c_str());
+    }
+}
+
+/**
+ * @brief Storage first, the network and the decoder only for a station never seen before
+ */
+static bool load_thumb(const std::string& id, const std::string& url, bool store, std::vector<uint16_t>* pixels)
+{
+    std::string path = store ? thumb_path(id) : "";
+    if (read_thumb(path, pixels)) {
+        return true;
+    }
+
+    std::vector<uint8_t> jpeg;
+    bool ok = GetHAL()->httpGet(url, [&](const char* data, size_t len) {
+        if (jpeg.size() + len > ArtworkCache::MAX_DOWNLOAD) {
+            return false;
+        }
+        jpeg.insert(jpeg.end(), data, data + len);
+        return true;
+    });
+    if (!ok || jpeg.empty()) {
+        mclog::tagWarn(TAG, "Download failed: {}", url);
+        return false;
+    }
+
+    pixels->resize((size_t)ArtworkCache::SIZE * ArtworkCache::SIZE);
+    if (!GetHAL()->decodeJpegThumbnail(jpeg.data(), jpeg.size(), ArtworkCache::SIZE, pixels->data())) {
+        pixels->clear();
+        return false;
+    }
+    write_thumb(path, *pixels);
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Track Lookup                                */
+/* -------------------------------------------------------------------------- */
+// The iTunes Search API: no key, JSON, and its covers are JPEG, which is all the hardware decoder takes
+#define TRACK_SEARCH_URL "https://itunes.apple.com/search?media=music&entity=song&limit=1&term="
+
+// Keys tracks apart from station ids in the shared cache
+static const std::string TRACK_KEY = "track:";
+
+static constexpr size_t MAX_SEARCH_RESPONSE = 16 * 1024;  // One result is ~2 KB
+
+static std::string url_encode(const std::string& text)
+{
+    static const char* HEX = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : text) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += (char)c;
+        } else if (c == ' ') {
+            encoded += '+';
+        } else {
+            encoded += '%';
+            encoded += HEX[c >> 4];
+            encoded += HEX[c & 15];
+        }
+    }
+    return encoded;
+}
+
+/**
+ * @brief First `results[].artworkUrl100` of a search response
+ *
+ *     {"resultCount": 1, "results": [{"artistName": "...", "artworkUrl100": "https://.../100x100bb.jpg", ...}]}
+ */
+class SearchHandler : public json::SaxParser::Handler {
+public:
+    std::string artwork;
+
+    void onKey(const char* key, size_t len) override
+    {
+        _key.assign(key, len);
+    }
+
+    void onString(const char* text, size_t len) override
+    {
+        if (artwork.empty() && _key == "artworkUrl100") {
+            artwork.assign(text, len);
+        }
+    }
+
+private:
+    std::string _key;
+};
+
+static bool lookup_track_art(const std::string& title, std::string* url)
+{
+    // "Artist - Track" searches best as plain words
+    std::string term = title;
+    size_t dash      = term.find(" - ");
+    if (dash != std::string::npos) {
+        term.replace(dash, 3, " ");
+    }
+
+    SearchHandler handler;
+    json::SaxParser parser{handler};
+    size_t received = 0;
+    bool ok         = GetHAL()->httpGet(TRACK_SEARCH_URL + url_encode(term), [&](const char* data, size_t len) {
+        received += len;
+        return received <= MAX_SEARCH_RESPONSE && parser.feed(data, len) && handler.artwork.empty();
+    });
+    if (handler.artwork.empty()) {
+        mclog::tagInfo(TAG, "No cover for '{}'{}", title, ok ? "" : " (search failed)");
+        return false;
+    }
+    *url = handler.artwork;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                ArtworkCache                                */
+/* -------------------------------------------------------------------------- */
+const lv_image_dsc_t* ArtworkCache::get(const Station& station)
+{
+    if (!station.artworkUrl) {
+        return nullptr;
+    }
+
+    if (auto thumb = find(station.id)) {
+        return thumb;
+    }
+    if (_requested.insert(station.id).second) {
+        request({station.id, station.artworkUrl, ""});
+    }
+    return nullptr;
+}
+
+const lv_image_dsc_t* ArtworkCache::getTrack(const std::string& title)
+{
+    if (title.empty()) {
+        return nullptr;
+    }
+
+    std::string key = TRACK_KEY + title;
+    if (auto thumb = find(key)) {
+        return thumb;
+    }
+    if (_requested.insert(key).second) {
+        request({key, "", title});
+    }
+    return nullptr;
+}
+
+const lv_image_dsc_t* ArtworkCache::find(const std::string& id)
+{
+    auto found = _index.find(id);
+    if (found == _index.end()) {
+        return nullptr;
+    }
+    _lru.splice(_lru.begin(), _lru, found->second);
+    return &found->second->dsc;
+}
+
+void ArtworkCache::request(Request_t request)
+{
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        bool track = !request.title.empty();
+        _queue.push_back(std::move(request));
+
+        // Titles still waiting are already off the air, the newest are the ones worth a lookup
+        int tracks = 0;
+        for (auto it = _queue.end(); track && it != _queue.begin();) {
+            --it;
+            if (!it->title.empty() && ++tracks > MAX_TRACK_REQUESTS) {
+                _requested.erase(it->id);
+                it = _queue.erase(it);
+            }
+        }
+        start        = !_job_running;
+        _job_running = true;
+    }
+    if (start) {
+        GetHAL()->runInBackground([this]() { run_job(); });
+    }
+}
+
+void ArtworkCache::update()
+{
+    std::vector<Loaded_t> loaded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loaded.swap(_loaded);
+    }
+
+    for (auto& result : loaded) {
+        if (result.pixels.empty()) {
+            // Stays requested, a logo that failed isn't fetched again every frame. Titles keep coming, only the
+            // latest misses are remembered
+            if (result.id.compare(0, TRACK_KEY.size(), TRACK_KEY) == 0) {
+                _track_misses.push_back(result.id);
+                if ((int)_track_misses.size() > MAX_TRACK_MISSES) {
+                    _requested.erase(_track_misses.front());
+                    _track_misses.pop_front();
+                }
+            }
+            continue;
+        }
+        _requested.erase(result.id);
+
+        _lru.push_front({result.id, std::move(result.pixels), {}});
+        Thumb_t& thumb            = _lru.front();
+        thumb.dsc.header.magic    = LV_IMAGE_HEADER_MAGIC;
+        thumb.dsc.header.cf       = LV_COLOR_FORMAT_RGB565;
+        thumb.dsc.header.w        = SIZE;
+        thumb.dsc.header.h        = SIZE;
+        thumb.dsc.header.stride   = SIZE * sizeof(uint16_t);
+        thumb.dsc.data_size       = thumb.pixels.size() * sizeof(uint16_t);
+        thumb.dsc.data            = (const uint8_t*)thumb.pixels.data();
+        _index[thumb.id]          = _lru.begin();
+
+        // The least recently used is off screen, storage has it for when it scrolls back
+        if ((int)_lru.size() > CAPACITY) {
+            Thumb_t& oldest = _lru.back();
+            lv_image_cache_drop(&oldest.dsc);
+            _index.erase(oldest.id);
+            _lru.pop_back();
+        }
+    }
+}
+
+void ArtworkCache::run_job()
+{
+    // One job drains the queue, so logos load one at a time without holding more than one download. It holds no
+    // lock of the UI's or the radio's while on the network, only `_mutex` around the queue
+    while (true) {
+        Request_t request;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queue.empty()) {
+                _job_running = false;
+                return;
+            }
+            request = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        Loaded_t result;
+        result.id  = request.id;
+        bool track = !request.title.empty();
+        if (!track || lookup_track_art(request.title, &request.url)) {
+            load_thumb(request.id, request.url, !track, &result.pixels);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _loaded.push_back(std::move(result));
+    }
+}
+
+ArtworkCache& radio::artwork()
+{
+    static ArtworkCache s_artwork;
+    return s_artwork;
+}
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "stations.h"
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <lvgl.h>
+
+namespace radio {
+
+/**
+ * @brief Station logos as ready-to-draw RGB565 thumbnails, decoded once per station and then only copied
+ *
+ * A miss queues the logo for a background job: it is read back from the HAL's data directory if it was decoded
+ * on an earlier boot, otherwise downloaded, decoded and scaled by the HAL (hardware JPEG and PPA on the Tab5)
+ * and written there. The UI keeps the CAPACITY most recently used thumbnails in memory (PSRAM on the device, as
+ * any large allocation), a thumbnail dropped from there comes back from storage, never from another decode.
+ *
+ * Cover art for the playing track goes through the same job and memory cache, looked up from the ICY title first.
+ * Those aren't written to storage (a day of titles would fill it), and only the newest MAX_TRACK_REQUESTS titles
+ * are kept waiting, so zapping through stations doesn't queue a lookup for every title seen on the way.
+ *
+ *     radio::artwork().update();                  // UI thread, once per tick
+ *     if (auto art = radio::artwork().get(station)) {
+ *         lv_image_set_src(image, art);
+ *     }
+ *     auto cover = radio::artwork().getTrack(metadata.title);
+ */
+class ArtworkCache {
+public:
+    static constexpr int SIZE            = 48;          // Thumbnail side in pixels, fits under a card's text
+    static constexpr int CAPACITY        = 32;          // Thumbnails in memory, well over the cards on screen
+    static constexpr size_t MAX_DOWNLOAD = 256 * 1024;  // Bytes of JPEG
+
+    static constexpr int MAX_TRACK_REQUESTS = 2;   // Titles waiting for a lookup, older ones are dropped
+    static constexpr int MAX_TRACK_MISSES   = 64;  // Titles without a cover, not looked up again meanwhile
+
+    /**
+     * @brief UI thread. Counts as a use, so keep calling it for thumbnails on screen
+     * @return the station's thumbnail, nullptr while it loads or if the station has none
+     */
+    const lv_image_dsc_t* get(const Station& station);
+
+    /**
+     * @brief UI thread. Cover art for an ICY StreamTitle ("Artist - Track"), looked up online
+     * @return the cover's thumbnail, nullptr while it loads or if none was found
+     */
+    const lv_image_dsc_t* getTrack(const std::string& title);
+
+    /**
+     * @brief UI thread, adopts loads that finished since the last call
+     */
+    void update();
+
+private:
+    struct Thumb_t {
+        std::string id;
+        std::vector<uint16_t> pixels;
+        lv_image_dsc_t dsc;
+    };
+    struct Request_t {
+        std::string id;
+        std::string url;
+        std::string title;  // Track cover: `url` comes from looking the title up
+    };
+    struct Loaded_t {
+        std::string id;
+        std::vector<uint16_t> pixels;  // Empty if the load failed
+    };
+
+    // UI thread only
+    std::list<Thumb_t> _lru;  // Most recently used first, nodes never move so `dsc` pointers stay valid
+    std::unordered_map<std::string, std::list<Thumb_t>::iterator> _index;
+    std::unordered_set<std::string> _requested;  // Loading, or failed and not retried until reboot
+    std::deque<std::string> _track_misses;       // Oldest first, leaves `_requested` past MAX_TRACK_MISSES
+
+    std::mutex _mutex;  // Guards the job's side
+    std::deque<Request_t> _queue;
+    std::vector<Loaded_t> _loaded;
+    bool _job_running = false;
+
+    const lv_image_dsc_t* find(const std::string& id);
+    void request(Request_t request);
+    void run_job();
+};
+
+/**
+ * @brief The one artwork cache
+ */
+ArtworkCache& artwork();
+
+}  // namespace radio
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "fast_resume.h"
+#include "settings_store.h"
+#include "station_catalog.h"
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+static const char* TAG = "resume";
+
+enum ResumeState_t {
+    RESUME_IDLE,
+    RESUME_CONNECTING,  // WiFi association running
+    RESUME_STARTING,    // Connected, handing the station to the HAL
+};
+
+static std::atomic<int> s_resume_state{RESUME_IDLE};
+
+void radio::start_fast_resume()
+{
+    auto& settings = radio::settings();
+    settings.load();
+
+    // A crash or a restart cut the radio short, it picks up where it was. That's more recent than the settings,
+    // which are saved a little after each change
+    hal::HalBase::WarmRestart_t warm;
+    bool resume = GetHAL()->getWarmRestart(&warm) && warm.playing;
+
+    // Before the startup sound, so that already plays at the saved volume
+    if (resume) {
+        GetHAL()->setSpeakerVolume(warm.volume);
+    } else if (settings.volume() >= 0) {
+        GetHAL()->setSpeakerVolume(settings.volume());
+    }
+
+    // Woken by the radio alarm, the station plays whether or not fast resume is on
+    bool alarm = GetHAL()->wokeByRtcAlarm() && settings.alarmEnabled();
+    if (!settings.fastResume() && !alarm && !resume) {
+        return;
+    }
+    int index = catalog().find(settings.lastStation().c_str());
+    std::string ssid, password;
+    if (index < 0 || !GetHAL()->loadWifiConfig(ssid, password)) {
+        return;
+    }
+
+    // The very stream it last started, at the bitrate that was picked then
+    std::string url = resume ? warm.url : stream_url(catalog().at(index));
+    std::vector<hal::HalBase::RadioVariant_t> variants;
+    for (const auto& variant : stream_variants(catalog().at(index))) {
+        variants.push_back({variant.url, variant.kbps});
+    }
+    mclog::tagInfo(TAG, "Resuming {} once WiFi is connected, last on {}{}", settings.lastStation(), ssid,
+                   resume ? ", after a restart" : alarm ? ", for the alarm" : "");
+
+    s_resume_state = RESUME_CONNECTING;
+    GetHAL()->runInBackground([url, variants]() {
+        uint32_t start = GetHAL()->millis();
+        bool connected = GetHAL()->connectSavedWifi();
+
+        int expected = RESUME_CONNECTING;
+        if (!connected || !s_resume_state.compare_exchange_strong(expected, RESUME_STARTING)) {
+            s_resume_state = RESUME_IDLE;
+            return;
+        }
+        mclog::tagInfo(TAG, "WiFi up after {} ms, starting stream", GetHAL()->millis() - start);
+        GetHAL()->setRadioVariants(variants);
+        GetHAL()->startRadioStream(url);
+        s_resume_state = RESUME_IDLE;
+    });
+}
+
+bool radio::fast_resume_pending()
+{
+    return s_resume_state != RESUME_IDLE;
+}
+
+void radio::cancel_fast_resume()
+{
+    int expected = RESUME_CONNECTING;
+    s_resume_state.compare_exchange_strong(expected, RESUME_IDLE);
+}
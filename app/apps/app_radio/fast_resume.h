@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+namespace radio {
+
+/**
+ * @brief Opt-in fast resume: connect to the saved WiFi and start the last station behind the startup animation
+ *
+ * Called before the animation, returns straight away. WiFi association and then the stream's connect and
+ * prebuffer run in the background while the animation plays and the radio view is built, so the first audio
+ * comes one association time after boot. Does nothing unless the setting is on, the RTC alarm woke the board for
+ * the radio alarm or a software reset cut the stream short (HalBase::getWarmRestart()), and there's a last station
+ * and saved WiFi. The view takes over whatever state this leaves:
+ *
+ *     if (radio::fast_resume_pending()) {
+ *         // Show it as playing, don't connect WiFi a second time
+ *     }
+ *     radio::cancel_fast_resume();                // The user pressed play or stop meanwhile
+ */
+void start_fast_resume();
+
+/**
+ * @return true from start_fast_resume() until the stream has been started or the WiFi connect failed
+ */
+bool fast_resume_pending();
+
+/**
+ * @brief A pending resume won't start the stream once WiFi is up
+ */
+void cancel_fast_resume();
+
+}  // namespace radio
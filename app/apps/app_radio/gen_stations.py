@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025
+#
+# SPDX-License-Identifier: MIT
+"""Generate the built-in station table, stations_builtin.h, from the stations.json manifest.
+
+The build runs it (app_station_table() in app/apps/app_manifest.cmake), the header lands in the build tree and
+stations.h includes it. Besides the table it holds a perfect hash on the ids: the ids are split into buckets by
+station_hash(id, 0), and every bucket gets the seed that puts each of its ids in a slot of its own, so a lookup is two
+hashes and one compare. stations.h checks the result at compile time.
+
+    python3 app/apps/app_radio/gen_stations.py app/apps/app_radio/stations.json stations_builtin.h
+"""
+import json
+import sys
+
+FORMATS = {"mp3": "StreamFormat::MP3", "aac": "StreamFormat::AAC"}
+FIELDS = ("id", "name", "description", "streamUrl", "aacStreamUrl", "preferredFormat", "color", "artworkUrl")
+MAX_SEED = 1 << 16
+
+
+def station_hash(text, seed):
+    """FNV-1a from a seeded basis, the same as station_hash() in stations.h."""
+    value = 2166136261 ^ seed
+    for byte in text.encode("utf-8"):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def build_index(ids):
+    """The seed for each bucket and the station in each slot (-1 for none), biggest buckets placed first."""
+    slots = 1
+    while slots < 2 * len(ids):
+        slots *= 2
+    buckets = max(1, (len(ids) + 3) // 4)
+    members = [[] for _ in range(buckets)]
+    for index, station_id in enumerate(ids):
+        members[station_hash(station_id, 0) % buckets].append(index)
+
+    seeds = [0] * buckets
+    table = [-1] * slots
+    for bucket in sorted(range(buckets), key=lambda b: -len(members[b])):
+        for seed in range(1, MAX_SEED):
+            placed = [station_hash(ids[i], seed) & (slots - 1) for i in members[bucket]]
+            if len(set(placed)) == len(placed) and all(table[slot] < 0 for slot in placed):
+                for slot, index in zip(placed, members[bucket]):
+                    table[slot] = index
+                seeds[bucket] = seed
+                break
+        else:
+            sys.exit(f"No seed below {MAX_SEED} places bucket {bucket}")
+    return seeds, table
+
+
+def literal(value):
+    if value is None:
+        return "nullptr"
+    return json.dumps(value, ensure_ascii=False)
+
+
+def load(path):
+    with open(path, encoding="utf-8") as file:
+        stations = json.load(file)["stations"]
+    if not stations:
+        sys.exit(f"{path}: no stations")
+    seen = set()
+    for station in stations:
+        missing = [field for field in FIELDS if field not in station]
+        if missing:
+            sys.exit(f"{path}: {station.get('id', '?')} has no {', '.join(missing)}")
+        if station["id"] in seen:
+            sys.exit(f"{path}: {station['id']} is there twice")
+        if station["preferredFormat"] not in FORMATS:
+            sys.exit(f"{path}: {station['id']} prefers {station['preferredFormat']}, not mp3 or aac")
+        if not station["color"].startswith("#") or len(station["color"]) != 7:
+            sys.exit(f"{path}: {station['id']}'s colour isn't #RRGGBB")
+        seen.add(station["id"])
+    return stations
+
+
+def generate(stations, source):
+    seeds, table = build_index([station["id"] for station in stations])
+    out = [
+        f"// Generated from {source} by gen_stations.py, don't edit",
+        "#pragma once",
+        "",
+        "namespace radio {",
+        "",
+        "inline constexpr Station STATIONS[] = {",
+    ]
+    for station in stations:
+        color = f"0x{station['color'][1:].upper()},"
+        if station.get("colorName"):
+            color += f"  // {station['colorName']}"
+        out += [
+            "    {",
+            f"        {literal(station['id'])},",
+            f"        {literal(station['name'])},",
+            f"        {literal(station['description'])},",
+            f"        {literal(station['streamUrl'])},",
+            f"        {literal(station['aacStreamUrl'])},",
+            f"        {FORMATS[station['preferredFormat']]},",
+            f"        {color}",
+            f"        {literal(station['artworkUrl'])},",
+            "    },",
+        ]
+    out += [
+        "};",
+        "",
+        f"inline constexpr int STATION_BUCKETS = {len(seeds)};",
+        f"inline constexpr int STATION_SLOTS   = {len(table)};",
+        "inline constexpr uint32_t STATION_SEEDS[STATION_BUCKETS] = {" + ", ".join(map(str, seeds)) + "};",
+        "inline constexpr int16_t STATION_SLOT_INDEX[STATION_SLOTS] = {" + ", ".join(map(str, table)) + "};",
+        "",
+        "}  // namespace radio",
+        "",
+    ]
+    return "\n".join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    source, header = sys.argv[1:]
+    text = generate(load(source), source.replace("\\", "/").rsplit("/", 1)[-1])
+    # Left alone when unchanged, so what includes it isn't rebuilt
+    try:
+        with open(header, encoding="utf-8") as file:
+            if file.read() == text:
+                return
+    except FileNotFoundError:
+        pass
+    with open(header, "w", encoding="utf-8") as file:
+        file.write(text)
+
+
+if __name__ == "__main__":
+    main()
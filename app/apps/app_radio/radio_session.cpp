@@ -0,0 +1,302 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "radio_session.h"
+#include "station_catalog.h"
+#include "settings_store.h"
+#include "fast_resume.h"
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <algorithm>
+#include <vector>
+
+using namespace radio;
+
+static const char* TAG = "session";
+
+void Session::load()
+{
+    if (_loaded) {
+        return;
+    }
+    _loaded = true;
+
+    auto& settings = radio::settings();
+    settings.load();
+    _station_id = settings.lastStation();
+    station();
+    _events = GetHAL()->subscribeEvents();
+
+    // A fast resume is connecting, or has started the station already
+    _resuming = radio::fast_resume_pending();
+    _playing  = _resuming || GetHAL()->getRadioState() != hal::HalBase::RADIO_STOPPED;
+}
+
+void Session::update()
+{
+    load();
+
+    hal::HalBase::Event_t event;
+    while (_events >= 0 && GetHAL()->pollEvent(_events, &event)) {
+        if (event.type == hal::HalBase::EVENT_REMOTE) {
+            handle_remote_command(event.value);
+        } else if (event.type == hal::HalBase::EVENT_RADIO_STATE && event.value == hal::HalBase::RADIO_ERROR) {
+            _playing = _scanning;  // Play again to retry, a scan moves on to the next station
+        }
+    }
+
+    // The resume is done: either the stream was started, or WiFi didn't come up and there's nothing playing
+    if (_resuming && !radio::fast_resume_pending()) {
+        _resuming = false;
+        if (GetHAL()->getRadioState() == hal::HalBase::RADIO_STOPPED) {
+            _playing = false;
+        }
+    }
+
+    update_scan();
+    radio::settings().update();
+}
+
+int Session::station()
+{
+    const auto& catalog = radio::catalog();
+    if (catalog.count() == 0) {
+        return 0;
+    }
+    // The index may be stale after a refresh of the list, the id isn't
+    if (_station >= catalog.count() || _station_id != catalog.at(_station).id) {
+        _station    = std::max(catalog.find(_station_id.c_str()), 0);
+        _station_id = catalog.at(_station).id;
+    }
+    return _station;
+}
+
+void Session::select(int station)
+{
+    const auto& catalog = radio::catalog();
+    if (station < 0 || station >= catalog.count()) {
+        return;
+    }
+    _station    = station;
+    _station_id = catalog.at(station).id;
+}
+
+bool Session::take_over_fast_resume()
+{
+    // A fast resume still connecting is called off, one already starting the stream gets to finish first
+    radio::cancel_fast_resume();
+    _resuming = radio::fast_resume_pending();
+    return !_resuming;
+}
+
+bool Session::play(int station)
+{
+    _scanning = false;
+    select(station);
+    if (!take_over_fast_resume()) {
+        return true;
+    }
+    if (_stopping) {
+        _play_after_stop = true;  // Started once the stop in flight is done
+        _playing         = true;
+        return true;
+    }
+    if (GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED) {
+        return false;
+    }
+
+    const auto& current = radio::catalog().at(this->station());
+    mclog::tagInfo(TAG, "Playing station: {}", current.name);
+    radio::settings().setLastStation(current.id);
+
+    // Start streaming, this is an instant switch if the station was kept warm
+    start_stream(radio::stream_url(current));
+    _playing = true;
+    return true;
+}
+
+// The current station's `url`. On a slow link it steps down to a lower bitrate of the station and back up again,
+// rather than running dry
+void Session::start_stream(const std::string& url)
+{
+    std::vector<hal::HalBase::RadioVariant_t> variants;
+    for (const auto& variant : radio::stream_variants(radio::catalog().at(station()))) {
+        variants.push_back({variant.url, variant.kbps});
+    }
+    GetHAL()->setRadioVariants(variants);
+    GetHAL()->startRadioStream(url);
+}
+
+void Session::stop()
+{
+    mclog::tagInfo(TAG, "Stopping playback");
+    _scanning = false;
+    if (!take_over_fast_resume()) {
+        return;
+    }
+    _playing         = false;
+    _play_after_stop = false;
+    if (_stopping) {
+        return;
+    }
+
+    // Off the UI thread, with an HTTP connect hanging the stop waits seconds for it. The session outlives it
+    _stopping = true;
+    GetHAL()->runInBackground([]() { GetHAL()->stopRadioStream(); },
+                              [this]() {
+                                  _stopping = false;
+                                  if (_play_after_stop) {
+                                      _play_after_stop = false;
+                                      play(_station);
+                                  }
+                              });
+}
+
+bool Session::togglePause()
+{
+    if (!_playing) {
+        return false;
+    }
+    if (GetHAL()->getRadioState() == hal::HalBase::RADIO_PAUSED) {
+        GetHAL()->resumeRadioStream();
+        return false;
+    }
+    return GetHAL()->pauseRadioStream();
+}
+
+int Session::neighbour(int direction)
+{
+    int count = radio::catalog().count();
+    return count > 0 ? ((station() + direction) % count + count) % count : 0;
+}
+
+void Session::step(int direction)
+{
+    if (radio::catalog().count() == 0) {
+        return;
+    }
+    int next = neighbour(direction);
+    if (_playing) {
+        play(next);
+    } else {
+        select(next);
+    }
+}
+
+bool Session::scan()
+{
+    // A stop or a fast resume still starting the stream is waited for, the scan starts after it
+    take_over_fast_resume();
+    if (GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED || radio::catalog().count() == 0) {
+        return false;
+    }
+    mclog::tagInfo(TAG, "Scanning the stations");
+    _scanning        = true;
+    _playing         = true;
+    _play_after_stop = false;
+    _scan_at         = 0;
+    update_scan();
+    return true;
+}
+
+void Session::keep()
+{
+    if (!_scanning) {
+        return;
+    }
+    _scanning           = false;
+    const auto& current = radio::catalog().at(station());
+    if (_scan_at != 0 && !_stopping && !_resuming && GetHAL()->switchRadioVariant(radio::stream_url(current))) {
+        mclog::tagInfo(TAG, "Keeping station: {}", current.name);
+        radio::settings().setLastStation(current.id);
+        return;
+    }
+    play(_station);
+}
+
+void Session::scan_to(int station)
+{
+    select(station);
+    _scan_at  = std::max<uint32_t>(GetHAL()->millis(), 1);
+    _heard_at = 0;
+    mclog::tagInfo(TAG, "Scanning: {}", radio::catalog().at(this->station()).name);
+    start_stream(radio::preview_url(radio::catalog().at(this->station())));
+}
+
+void Session::update_scan()
+{
+    if (!_scanning || _stopping || _resuming) {
+        return;
+    }
+    if (_scan_at == 0) {
+        scan_to(neighbour(1));
+        return;
+    }
+
+    uint32_t now                     = GetHAL()->millis();
+    hal::HalBase::RadioState_t state = GetHAL()->getRadioState();
+    if (_heard_at == 0 && state == hal::HalBase::RADIO_PLAYING) {
+        _heard_at = now;
+    }
+    bool done = _heard_at != 0 ? now - _heard_at >= SCAN_DWELL_MS
+                               : now - _scan_at >= SCAN_CONNECT_MS || state == hal::HalBase::RADIO_ERROR;
+    if (done) {
+        scan_to(neighbour(1));
+    } else if (_heard_at != 0) {
+        // The next one connected ahead, starting it is then a switch to what it already buffered
+        GetHAL()->prewarmRadioStream(radio::preview_url(radio::catalog().at(neighbour(1))));
+    }
+}
+
+int Session::volume() const
+{
+    return GetHAL()->getSpeakerVolume();
+}
+
+void Session::setVolume(int volume)
+{
+    volume = std::clamp(volume, 0, 100);
+    GetHAL()->setSpeakerVolume(volume);
+    radio::settings().setVolume(volume);
+}
+
+void Session::handle_remote_command(uint32_t value)
+{
+    uint32_t argument = value >> 8;
+    switch (value & 0xFF) {
+        case hal::HalBase::REMOTE_PLAY:
+            if (!_playing && !play(station())) {
+                mclog::tagWarn(TAG, "Not playing, no WiFi");
+            }
+            break;
+        case hal::HalBase::REMOTE_STOP:
+            if (_playing) {
+                stop();
+            }
+            break;
+        case hal::HalBase::REMOTE_NEXT_STATION:
+            step(1);
+            break;
+        case hal::HalBase::REMOTE_PREVIOUS_STATION:
+            step(-1);
+            break;
+        case hal::HalBase::REMOTE_STATION:
+            if ((int)argument < radio::catalog().count()) {
+                play(argument);
+            }
+            break;
+        case hal::HalBase::REMOTE_VOLUME:
+            setVolume(argument);
+            break;
+        default:
+            break;
+    }
+}
+
+Session& radio::session()
+{
+    static Session s_session;
+    return s_session;
+}
@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace radio {
+
+/**
+ * @brief What the radio plays, whichever app is in front: the station, play and stop, the remote's commands
+ *
+ * The HAL owns the stream, the decoder and the mixer. The session is the rest of the playback state: the current
+ * station, whether play was pressed, a stop still running in the background, a fast resume still connecting. UIs
+ * are its clients: the radio view, the web remote and MQTT (their commands come in as HAL events) all act on the
+ * same session, and a UI that opens shows it as it is. Closing the radio view leaves the station playing, opening
+ * it again costs no reconnect and no decoder restart.
+ *
+ * `update()` runs from whichever app is in front, the settings are saved from it too. UI thread only.
+ *
+ *     auto& session = radio::session();
+ *     session.update();                        // Every tick
+ *     if (!session.play(index)) {
+ *         show_wifi_config();                  // Nothing to stream over
+ *     }
+ *     session.step(1);                         // Next station, playing if this one was
+ *     session.scan();                          // Each station in turn until keep()
+ */
+class Session {
+public:
+    /**
+     * @brief Take over the last station from the settings, once, later calls do nothing
+     */
+    void load();
+
+    void update();
+
+    /**
+     * @return catalog index of the current station, 0 if there's none
+     */
+    int station();
+    const std::string& stationId() const
+    {
+        return _station_id;
+    }
+
+    /**
+     * @brief Make `station` the current one, without starting it
+     */
+    void select(int station);
+
+    /**
+     * @brief Play `station`, which becomes the current one. A stop still running finishes first, a fast resume
+     * starting the stream is left to it
+     *
+     * @return false without WiFi, nothing was started
+     */
+    bool play(int station);
+    void stop();
+
+    /**
+     * @return true if it's paused now
+     */
+    bool togglePause();
+
+    /**
+     * @brief The next (1) or previous (-1) station, played if the current one was
+     */
+    void step(int direction);
+
+    /**
+     * @brief Car radio scan: the stations after the current one in turn, each for SCAN_DWELL_MS once it's heard. They
+     * play at their lowest bitrate with the next one connected ahead, so each plays straight away. play(), stop() and
+     * step() end it, keep() stays on the station
+     *
+     * @return false without WiFi, nothing was started
+     */
+    bool scan();
+
+    /**
+     * @brief End the scan on the station playing, which goes on at full quality without a gap where the platform can
+     * splice (HalBase::switchRadioVariant()), reconnected where it can't
+     */
+    void keep();
+
+    bool scanning() const
+    {
+        return _scanning;
+    }
+
+    /**
+     * @return play was pressed (or a fast resume is starting the stream), until stop or a stream error
+     */
+    bool playing() const
+    {
+        return _playing;
+    }
+
+    /**
+     * @return 0..100
+     */
+    int volume() const;
+    void setVolume(int volume);
+
+private:
+    static constexpr uint32_t SCAN_DWELL_MS   = 8000;
+    static constexpr uint32_t SCAN_CONNECT_MS = 4000;  // A station that isn't heard by then is skipped
+
+    bool _loaded = false;
+    int _events  = -1;  // Own event subscription, for the remote's commands and stream errors
+    int _station = 0;
+    std::string _station_id;
+    bool _playing         = false;
+    bool _resuming        = false;  // A fast resume was connecting when the session took over
+    bool _stopping        = false;  // stopRadioStream() is running in the background
+    bool _play_after_stop = false;  // Play was pressed meanwhile
+    bool _scanning        = false;
+    uint32_t _scan_at     = 0;  // When the station scanned was started, 0 before the first
+    uint32_t _heard_at    = 0;  // When it started playing, 0 until it has
+
+    bool take_over_fast_resume();
+    int neighbour(int direction);
+    void start_stream(const std::string& url);
+    void scan_to(int station);
+    void update_scan();
+    void handle_remote_command(uint32_t value);
+};
+
+Session& session();
+
+}  // namespace radio
@@ -0,0 +1,222 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "settings_store.h"
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <algorithm>
+
+using namespace radio;
+
+static const char* TAG = "settings";
+
+/* -------------------------------------------------------------------------- */
+/*                                    Blob                                    */
+/* -------------------------------------------------------------------------- */
+// A list of tagged records, [tag][length][value], so a setting can be added without invalidating older blobs:
+// a reader skips tags it doesn't know and keeps the default for ones that aren't there
+enum SettingTag_t : uint8_t {
+    TAG_VOLUME       = 1,  // One byte, 0..100
+    TAG_LAST_STATION = 2,  // Station id
+    TAG_FAVORITE     = 3,  // Station id, one record per favorite
+    TAG_FAST_RESUME  = 4,  // One byte, 0 or 1
+    TAG_TRACK_ART    = 5,  // One byte, 0 or 1
+    TAG_ALARM        = 6,  // Enabled (0 or 1), hour, minute
+    TAG_PRESENCE     = 7,  // One byte, 0 or 1
+};
+
+static constexpr size_t MAX_VALUE = 255;
+
+static void put_record(std::vector<uint8_t>* blob, SettingTag_t tag, const void* value, size_t len)
+{
+    len = std::min(len, MAX_VALUE);
+    blob->push_back(tag);
+    blob->push_back((uint8_t)len);
+    blob->insert(blob->end(), (const uint8_t*)value, (const uint8_t*)value + len);
+}
+
+static void put_string(std::vector<uint8_t>* blob, SettingTag_t tag, const std::string& value)
+{
+    put_record(blob, tag, value.data(), value.size());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                SettingsStore                               */
+/* -------------------------------------------------------------------------- */
+void SettingsStore::load()
+{
+    if (_loaded) {
+        return;
+    }
+    _loaded = true;
+
+    std::vector<uint8_t> blob;
+    if (!GetHAL()->loadSettings(blob)) {
+        mclog::tagInfo(TAG, "No saved settings");
+        return;
+    }
+
+    _favorites.clear();
+    size_t pos = 0;
+    while (pos + 2 <= blob.size()) {
+        uint8_t tag   = blob[pos];
+        size_t len    = blob[pos + 1];
+        const char* v = (const char*)blob.data() + pos + 2;
+        if (pos + 2 + len > blob.size()) {
+            break;
+        }
+        pos += 2 + len;
+
+        if (tag == TAG_VOLUME && len == 1) {
+            _volume = std::min<int>((uint8_t)v[0], 100);
+        } else if (tag == TAG_LAST_STATION) {
+            _last_station.assign(v, len);
+        } else if (tag == TAG_FAVORITE) {
+            _favorites.emplace_back(v, len);
+        } else if (tag == TAG_FAST_RESUME && len == 1) {
+            _fast_resume = v[0] != 0;
+        } else if (tag == TAG_TRACK_ART && len == 1) {
+            _track_art = v[0] != 0;
+        } else if (tag == TAG_PRESENCE && len == 1) {
+            _presence_wake = v[0] != 0;
+        } else if (tag == TAG_ALARM && len == 3) {
+            _alarm_enabled = v[0] != 0;
+            _alarm_minute  = std::min<int>((uint8_t)v[1], 23) * 60 + std::min<int>((uint8_t)v[2], 59);
+        }
+    }
+    _dirty = false;
+    mclog::tagInfo(TAG, "Loaded: volume {}, last station '{}', {} favorites", _volume, _last_station,
+                   _favorites.size());
+}
+
+void SettingsStore::update()
+{
+    if (_dirty && GetHAL()->millis() - _changed_at >= SAVE_DELAY_MS) {
+        save();
+    }
+}
+
+void SettingsStore::flush()
+{
+    if (_dirty) {
+        save();
+    }
+}
+
+void SettingsStore::setVolume(int volume)
+{
+    if (volume != _volume) {
+        _volume = volume;
+        changed();
+    }
+}
+
+void SettingsStore::setFastResume(bool enable)
+{
+    if (enable != _fast_resume) {
+        _fast_resume = enable;
+        changed();
+    }
+}
+
+void SettingsStore::setTrackArt(bool enable)
+{
+    if (enable != _track_art) {
+        _track_art = enable;
+        changed();
+    }
+}
+
+void SettingsStore::setPresenceWake(bool enable)
+{
+    if (enable != _presence_wake) {
+        _presence_wake = enable;
+        changed();
+    }
+}
+
+void SettingsStore::setAlarm(bool enabled, int minute)
+{
+    minute = (minute % (24 * 60) + 24 * 60) % (24 * 60);
+    if (enabled != _alarm_enabled || minute != _alarm_minute) {
+        _alarm_enabled = enabled;
+        _alarm_minute  = minute;
+        changed();
+    }
+}
+
+void SettingsStore::setLastStation(const std::string& id)
+{
+    if (id != _last_station) {
+        _last_station = id;
+        changed();
+    }
+}
+
+bool SettingsStore::isFavorite(const std::string& id) const
+{
+    return std::find(_favorites.begin(), _favorites.end(), id) != _favorites.end();
+}
+
+void SettingsStore::setFavorite(const std::string& id, bool favorite)
+{
+    auto found = std::find(_favorites.begin(), _favorites.end(), id);
+    if (favorite == (found != _favorites.end())) {
+        return;
+    }
+    if (favorite) {
+        _favorites.push_back(id);
+    } else {
+        _favorites.erase(found);
+    }
+    changed();
+}
+
+void SettingsStore::changed()
+{
+    // Every change restarts the delay, a save waits for things to settle
+    _dirty      = true;
+    _changed_at = GetHAL()->millis();
+}
+
+void SettingsStore::save()
+{
+    std::vector<uint8_t> blob;
+    if (_volume >= 0) {
+        uint8_t volume = _volume;
+        put_record(&blob, TAG_VOLUME, &volume, 1);
+    }
+    if (_fast_resume) {
+        uint8_t enable = 1;
+        put_record(&blob, TAG_FAST_RESUME, &enable, 1);
+    }
+    if (_track_art) {
+        uint8_t enable = 1;
+        put_record(&blob, TAG_TRACK_ART, &enable, 1);
+    }
+    if (_presence_wake) {
+        uint8_t enable = 1;
+        put_record(&blob, TAG_PRESENCE, &enable, 1);
+    }
+    if (_alarm_enabled || _alarm_minute != DEFAULT_ALARM_MINUTE) {
+        uint8_t alarm[3] = {_alarm_enabled, (uint8_t)(_alarm_minute / 60), (uint8_t)(_alarm_minute % 60)};
+        put_record(&blob, TAG_ALARM, alarm, sizeof(alarm));
+    }
+    if (!_last_station.empty()) {
+        put_string(&blob, TAG_LAST_STATION, _last_station);
+    }
+    for (const auto& id : _favorites) {
+        put_string(&blob, TAG_FAVORITE, id);
+    }
+
+    GetHAL()->saveSettings(blob);
+    _dirty = false;
+}
+
+SettingsStore& radio::settings()
+{
+    static SettingsStore s_settings;
+    return s_settings;
+}
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace radio {
+
+/**
+ * @brief The radio's settings (volume, last station, favorites...), held in RAM and written back in batches
+ *
+ * Everything is one blob the HAL keeps in NVS, read once by `load()`. A change only marks the store dirty, the
+ * blob goes back in a single write and commit SAVE_DELAY_MS after the last change, so dragging the volume slider
+ * costs one flash write, not one per step. UI thread only.
+ *
+ *     radio::settings().load();                   // Startup
+ *     radio::settings().setVolume(vol);           // As often as it changes
+ *     radio::settings().update();                 // Once per tick, saves when changes have settled
+ */
+class SettingsStore {
+public:
+    static constexpr uint32_t SAVE_DELAY_MS   = 5000;
+    static constexpr int DEFAULT_ALARM_MINUTE = 7 * 60;
+
+    /**
+     * @brief Read the saved settings, once, later calls do nothing
+     */
+    void load();
+    void update();
+
+    /**
+     * @brief Save now if anything changed, for when the app closes
+     */
+    void flush();
+
+    /**
+     * @return speaker volume 0..100, -1 if none was saved
+     */
+    int volume() const
+    {
+        return _volume;
+    }
+    void setVolume(int volume);
+
+    /**
+     * @return id of the station last played, empty if none
+     */
+    const std::string& lastStation() const
+    {
+        return _last_station;
+    }
+    void setLastStation(const std::string& id);
+
+    /**
+     * @brief Opt-in: connect and start the last station at boot, behind the startup animation
+     */
+    bool fastResume() const
+    {
+        return _fast_resume;
+    }
+    void setFastResume(bool enable);
+
+    /**
+     * @brief Opt-in: look the playing track's cover up online, which sends its title to the search service
+     */
+    bool trackArt() const
+    {
+        return _track_art;
+    }
+    void setTrackArt(bool enable);
+
+    /**
+     * @brief Opt-in: the camera watches for a face, the screen wakes for one and dims once nobody is there
+     */
+    bool presenceWake() const
+    {
+        return _presence_wake;
+    }
+    void setPresenceWake(bool enable);
+
+    /**
+     * @brief Radio alarm: the last station plays at this time every day, and sleeping until it powers the board up
+     */
+    bool alarmEnabled() const
+    {
+        return _alarm_enabled;
+    }
+    int alarmMinute() const  // Of the day, local time
+    {
+        return _alarm_minute;
+    }
+    void setAlarm(bool enabled, int minute);
+
+    bool isFavorite(const std::string& id) const;
+    void setFavorite(const std::string& id, bool favorite);
+    const std::vector<std::string>& favorites() const
+    {
+        return _favorites;
+    }
+
+private:
+    int _volume         = -1;
+    bool _fast_resume   = false;
+    bool _track_art     = false;
+    bool _presence_wake = false;
+    bool _alarm_enabled = false;
+    int _alarm_minute   = DEFAULT_ALARM_MINUTE;
+    std::string _last_station;
+    std::vector<std::string> _favorites;  // Station ids, in the order they were added
+
+    bool _loaded         = false;
+    bool _dirty          = false;
+    uint32_t _changed_at = 0;
+
+    void changed();
+    void save();
+};
+
+/**
+ * @brief The one settings store
+ */
+SettingsStore& settings();
+
+}  // namespace radio
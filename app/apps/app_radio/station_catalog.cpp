@@ -0,0 +1,520 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "station_catalog.h"
+#include "../utils/json/json_sax.h"
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <algorithm>
+
+using namespace radio;
+
+static const char* TAG = "catalog";
+
+/* -------------------------------------------------------------------------- */
+/*                                Catalog Image                               */
+/* -------------------------------------------------------------------------- */
+// Written and read by the device itself only, so in its own byte order. Records are read in place, so everything
+// is 4-byte aligned: the header is 24 bytes and the stride a multiple of 4
+static constexpr uint32_t IMAGE_MAGIC   = 0x54414353;  // "SCAT"
+static constexpr uint16_t IMAGE_VERSION = 3;
+static constexpr uint32_t NO_STRING     = 0xFFFFFFFF;
+
+struct ImageHeader_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t stride;  // Bytes per record, newer fields would go at the end of one
+    uint32_t count;
+    uint32_t stringsSize;
+    uint32_t sequence;  // Bumped by every write, the newest intact slot wins
+    uint32_t checksum;  // FNV-1a over the records, then the strings
+};
+
+// Strings are offsets into the string table, which follows the records
+struct ImageRecord_t {
+    uint32_t id;
+    uint32_t name;
+    uint32_t description;
+    uint32_t streamUrl;
+    uint32_t aacStreamUrl;  // NO_STRING if there is none
+    uint32_t artworkUrl;    // NO_STRING if there is none
+    uint32_t color;
+    uint8_t format;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(ImageHeader_t) % 4 == 0 && sizeof(ImageRecord_t) % 4 == 0, "Records must stay aligned");
+
+static uint32_t fnv1a(const void* data, size_t len, uint32_t hash = 2166136261u)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Collects stations as string table offsets, then lays them out as an image
+ */
+struct TableBuilder {
+    std::vector<char> strings;
+    std::vector<ImageRecord_t> records;
+
+    uint32_t add(const std::string& text)
+    {
+        uint32_t offset = strings.size();
+        strings.insert(strings.end(), text.begin(), text.end());
+        strings.push_back('\0');
+        return offset;
+    }
+
+    std::vector<uint8_t> image(uint32_t sequence) const
+    {
+        size_t recordBytes = records.size() * sizeof(ImageRecord_t);
+        size_t padding     = (4 - strings.size() % 4) % 4;  // Keeps the next image in a buffer aligned too
+
+        ImageHeader_t header = {};
+        header.magic         = IMAGE_MAGIC;
+        header.version       = IMAGE_VERSION;
+        header.stride        = sizeof(ImageRecord_t);
+        header.count         = records.size();
+        header.stringsSize   = strings.size() + padding;
+        header.sequence      = sequence;
+        header.checksum      = fnv1a(records.data(), recordBytes);
+        header.checksum      = fnv1a(strings.data(), strings.size(), header.checksum);
+        header.checksum      = fnv1a("\0\0\0", padding, header.checksum);
+
+        std::vector<uint8_t> image(sizeof(header) + recordBytes + header.stringsSize, 0);
+        memcpy(image.data(), &header, sizeof(header));
+        memcpy(image.data() + sizeof(header), records.data(), recordBytes);
+        memcpy(image.data() + sizeof(header) + recordBytes, strings.data(), strings.size());
+        return image;
+    }
+};
+
+static const char* record_id(const StationCatalog::Table_t& table, int index)
+{
+    const auto* record = (const ImageRecord_t*)(table.records + (size_t)index * table.stride);
+    return table.strings + record->id;
+}
+
+/**
+ * @brief Hash the ids of an opened image into its index, open addressed with linear probing
+ */
+static void index_image(StationCatalog::Table_t* table)
+{
+    size_t slots = 1;
+    while (slots < 2 * (size_t)table->count) {
+        slots *= 2;
+    }
+    table->index.assign(slots, 0);
+    for (int i = 0; i < table->count; i++) {
+        size_t slot = station_hash(record_id(*table, i)) & (slots - 1);
+        while (table->index[slot]) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        table->index[slot] = i + 1;
+    }
+}
+
+/**
+ * @brief Check that `data` holds a whole, intact image and describe it in `table`, nothing is copied
+ */
+static bool open_image(const uint8_t* data, size_t size, StationCatalog::Table_t* table)
+{
+    ImageHeader_t header;
+    if (!data || size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.stride < sizeof(ImageRecord_t) ||
+        header.stride % 4 != 0 || header.count == 0 || header.count > StationCatalog::MAX_STATIONS ||
+        header.stringsSize == 0 || sizeof(header) + (size_t)header.count * header.stride + header.stringsSize > size) {
+        return false;
+    }
+
+    const uint8_t* records = data + sizeof(header);
+    const char* strings    = (const char*)records + (size_t)header.count * header.stride;
+    uint32_t checksum      = fnv1a(records, (size_t)header.count * header.stride);
+    if (fnv1a(strings, header.stringsSize, checksum) != header.checksum || strings[header.stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    // With the table terminated, any offset inside it is a valid string
+    for (uint32_t i = 0; i < header.count; i++) {
+        const auto* record = (const ImageRecord_t*)(records + (size_t)i * header.stride);
+        auto valid         = [&](uint32_t offset, bool optional) {
+            return offset < header.stringsSize || (optional && offset == NO_STRING);
+        };
+        if (!valid(record->id, false) || !valid(record->name, false) || !valid(record->description, false) ||
+            !valid(record->streamUrl, false) || !valid(record->aacStreamUrl, true) ||
+            !valid(record->artworkUrl, true)) {
+            return false;
+        }
+    }
+
+    table->records  = records;
+    table->strings  = strings;
+    table->stride   = header.stride;
+    table->count    = header.count;
+    table->checksum = header.checksum;
+    table->sequence = header.sequence;
+    index_image(table);
+    return true;
+}
+
+/**
+ * @return the newest intact image in the HAL's catalog slots, read in place, nullptr if there is none
+ */
+static std::unique_ptr<StationCatalog::Table_t> map_newest_slot()
+{
+    std::unique_ptr<StationCatalog::Table_t> newest;
+    for (int slot = 0; slot < hal::HalBase::CATALOG_SLOTS; slot++) {
+        size_t size         = 0;
+        const uint8_t* data = GetHAL()->mapCatalogSlot(slot, &size);
+
+        StationCatalog::Table_t table;
+        if (open_image(data, size, &table) && (!newest || table.sequence > newest->sequence)) {
+            table.slot = slot;
+            newest     = std::make_unique<StationCatalog::Table_t>(table);
+        }
+    }
+    return newest;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Channel Parser                               */
+/* -------------------------------------------------------------------------- */
+// A stable colour per station, so cards look the same on every boot
+static uint32_t station_color(const std::string& id)
+{
+    float hue = (fnv1a(id.data(), id.size()) % 360) / 60.0f;
+    float s   = 0.55f;
+    float v   = 0.75f;
+    float c   = v * s;
+    float x   = c * (1 - std::abs(std::fmod(hue, 2.0f) - 1));
+
+    // R, G and B per 60 degree sector of the hue
+    const float rgb[3][6] = {
+        {c, x, 0, 0, x, c},
+        {x, c, c, x, 0, 0},
+        {0, 0, x, c, c, x},
+    };
+    int sector     = std::min((int)hue, 5);
+    uint32_t color = 0;
+    for (int i = 0; i < 3; i++) {
+        color = (color << 8) | (uint32_t)((rgb[i][sector] + v - c) * 255.0f);
+    }
+    return color;
+}
+
+// "ambient|electronica" -> "Ambient/Electronica"
+static std::string genre_text(const std::string& genre)
+{
+    std::string text;
+    bool word_start = true;
+    for (char c : genre) {
+        if (c == '|') {
+            text += '/';
+            word_start = true;
+        } else {
+            text += word_start ? (char)toupper((unsigned char)c) : c;
+            word_start = c == ' ';
+        }
+    }
+    return text;
+}
+
+/**
+ * @brief Picks `channels[].{id, title, genre, image, playlists[].format}` out of the SomaFM channel list
+ *
+ *     {"channels": [{"id": "groovesalad", "title": "Groove Salad", "genre": "ambient|electronica",
+ *                    "playlists": [{"url": "...", "format": "mp3", "quality": "highest"}, ...], ...}, ...]}
+ */
+class ChannelHandler : public json::SaxParser::Handler {
+public:
+    explicit ChannelHandler(TableBuilder& builder) : _builder(builder)
+    {
+    }
+
+    void onObjectStart() override
+    {
+        _depth++;
+        if (_in_channels && _depth == CHANNEL) {
+            _channel = {};
+        }
+    }
+
+    void onObjectEnd() override
+    {
+        if (_in_channels && _depth == CHANNEL) {
+            add_channel();
+        }
+        _depth--;
+    }
+
+    void onArrayStart() override
+    {
+        _depth++;
+        if (_depth == CHANNELS && _key == "channels") {
+            _in_channels = true;
+        } else if (_in_channels && _depth == PLAYLISTS && _key == "playlists") {
+            _in_playlists = true;
+        }
+    }
+
+    void onArrayEnd() override
+    {
+        if (_depth == CHANNELS) {
+            _in_channels = false;
+        } else if (_depth == PLAYLISTS) {
+            _in_playlists = false;
+        }
+        _depth--;
+    }
+
+    void onKey(const char* key, size_t len) override
+    {
+        _key.assign(key, len);
+    }
+
+    void onString(const char* text, size_t len) override
+    {
+        if (!_in_channels) {
+            return;
+        }
+        if (_depth == CHANNEL) {
+            if (_key == "id") {
+                _channel.id.assign(text, len);
+            } else if (_key == "title") {
+                _channel.title.assign(text, len);
+            } else if (_key == "genre") {
+                _channel.genre.assign(text, len);
+            } else if (_channel.artwork.empty() && is_artwork_key(_key) && is_jpeg_url(text, len)) {
+                // Keys come smallest logo first, the hardware decoder only takes JPEG
+                _channel.artwork.assign(text, len);
+            }
+        } else if (_in_playlists && _depth == PLAYLIST && _key == "format") {
+            // SomaFM's "aacp" playlists are the 64kbps HE-AAC mounts
+            _channel.mp3 |= strncmp(text, "mp3", len) == 0 && len == 3;
+            _channel.aac |= strncmp(text, "aacp", len) == 0 && len == 4;
+        }
+    }
+
+private:
+    // Nesting of each level, the root object is 1
+    static constexpr int CHANNELS  = 2;
+    static constexpr int CHANNEL   = 3;
+    static constexpr int PLAYLISTS = 4;
+    static constexpr int PLAYLIST  = 5;
+
+    struct Channel_t {
+        std::string id;
+        std::string title;
+        std::string genre;
+        std::string artwork;
+        bool mp3 = false;
+        bool aac = false;
+    };
+
+    static bool is_artwork_key(const std::string& key)
+    {
+        return key == "image" || key == "largeimage" || key == "xlimage";
+    }
+
+    static bool is_jpeg_url(const char* text, size_t len)
+    {
+        std::string path(text, std::find(text, text + len, '?'));
+        auto ends_with = [&](const char* suffix) {
+            size_t n = strlen(suffix);
+            return path.size() >= n && strcasecmp(path.c_str() + path.size() - n, suffix) == 0;
+        };
+        return ends_with(".jpg") || ends_with(".jpeg");
+    }
+
+    void add_channel()
+    {
+        // The id becomes part of the stream URLs
+        bool valid = !_channel.id.empty() && !_channel.title.empty() && _channel.mp3;
+        for (char c : _channel.id) {
+            valid = valid && (isalnum((unsigned char)c) || c == '-' || c == '_');
+        }
+        if (!valid || _builder.records.size() >= StationCatalog::MAX_STATIONS) {
+            return;
+        }
+
+        // Stations from the built-in list keep their short description and colour
+        const Station* builtin = builtin_station(_channel.id.c_str());
+        std::string base       = "http://ice1.somafm.com/" + _channel.id;
+
+        ImageRecord_t record = {};
+        record.id            = _builder.add(_channel.id);
+        record.name          = _builder.add(_channel.title);
+        record.description   = _builder.add(builtin ? builtin->description : genre_text(_channel.genre));
+        record.streamUrl     = _builder.add(base + "-128-mp3");
+        record.aacStreamUrl  = _channel.aac ? _builder.add(base + "-64-aac") : NO_STRING;
+        record.artworkUrl    = _channel.artwork.empty() ? NO_STRING : _builder.add(_channel.artwork);
+        record.color         = builtin ? builtin->color : station_color(_channel.id);
+        record.format        = (uint8_t)(_channel.aac ? StreamFormat::AAC : StreamFormat::MP3);
+        _builder.records.push_back(record);
+    }
+
+    TableBuilder& _builder;
+    Channel_t _channel;
+    std::string _key;
+    int _depth         = 0;
+    bool _in_channels  = false;
+    bool _in_playlists = false;
+};
+
+/* -------------------------------------------------------------------------- */
+/*                               StationCatalog                               */
+/* -------------------------------------------------------------------------- */
+StationCatalog::StationCatalog()
+{
+    _table = map_newest_slot();
+    if (_table) {
+        mclog::tagInfo(TAG, "{} stations from catalog slot {}", _table->count, _table->slot);
+    } else {
+        mclog::tagInfo(TAG, "No catalog in flash, using the built-in stations");
+    }
+
+    // Left behind by firmware that kept the list on SPIFFS
+    std::string dir = GetHAL()->getDataDir();
+    if (!dir.empty()) {
+        remove((dir + "/stations.bin").c_str());
+    }
+}
+
+StationCatalog::~StationCatalog()
+{
+    delete _fresh.exchange(nullptr);
+}
+
+bool StationCatalog::update()
+{
+    uint32_t now = GetHAL()->millis();
+    if (!_refreshed.load() && !_refreshing.load() && GetHAL()->getWifiState() == hal::HalBase::WIFI_CONNECTED &&
+        (_last_attempt == 0 || now - _last_attempt >= RETRY_MS)) {
+        _last_attempt = now;
+        start_refresh();
+    }
+
+    std::unique_ptr<Table_t> fresh(_fresh.exchange(nullptr));
+    if (!fresh) {
+        return false;
+    }
+    _table = std::move(fresh);
+    return true;
+}
+
+void StationCatalog::start_refresh()
+{
+    // What's shown now, the job only writes a slot for a list that's different from it
+    uint32_t shown    = _table ? _table->checksum : 0;
+    uint32_t sequence = _table ? _table->sequence : 0;
+    int slot          = _table && _table->slot == 0 ? 1 : 0;
+
+    _refreshing.store(true);
+    GetHAL()->runInBackground([this, shown, sequence, slot]() {
+        // The parser holds a token buffer, too big for a task stack
+        struct Refresh_t {
+            TableBuilder builder;
+            ChannelHandler handler{builder};
+            json::SaxParser parser{handler};
+        };
+        auto refresh = std::make_unique<Refresh_t>();
+
+        bool ok = GetHAL()->httpGet(CHANNELS_URL, [&](const char* data, size_t len) {
+            return refresh->parser.feed(data, len);
+        });
+        ok = ok && refresh->parser.done() && !refresh->builder.records.empty();
+
+        auto table   = std::make_unique<Table_t>();
+        table->image = ok ? refresh->builder.image(sequence + 1) : std::vector<uint8_t>();
+        ok           = ok && open_image(table->image.data(), table->image.size(), table.get());
+        if (!ok) {
+            mclog::tagWarn(TAG, "Refresh failed, retrying in {}s", RETRY_MS / 1000);
+            _refreshing.store(false);
+            return;
+        }
+
+        _refreshed.store(true);
+        if (table->checksum == shown) {
+            mclog::tagInfo(TAG, "Refreshed, {} stations, unchanged", table->count);
+        } else {
+            // The other slot, the one shown stays intact under the UI and as the fallback. Read back through the
+            // mapping, the RAM copy is only kept if that fails
+            Table_t mapped;
+            size_t size         = 0;
+            bool written        = GetHAL()->writeCatalogSlot(slot, table->image.data(), table->image.size());
+            const uint8_t* data = written ? GetHAL()->mapCatalogSlot(slot, &size) : nullptr;
+            if (open_image(data, size, &mapped) && mapped.checksum == table->checksum) {
+                mapped.slot = slot;
+                *table      = mapped;
+            } else {
+                mclog::tagWarn(TAG, "Can't write catalog slot {}", slot);
+            }
+            mclog::tagInfo(TAG, "Refreshed, {} stations", table->count);
+            delete _fresh.exchange(table.release());
+        }
+        _refreshing.store(false);
+    });
+}
+
+int StationCatalog::count() const
+{
+    return _table ? _table->count : STATION_COUNT;
+}
+
+Station StationCatalog::at(int index) const
+{
+    if (!_table) {
+        return STATIONS[index];
+    }
+
+    const auto* record = (const ImageRecord_t*)(_table->records + (size_t)index * _table->stride);
+    auto text          = [&](uint32_t offset) -> const char* {
+        return offset == NO_STRING ? nullptr : _table->strings + offset;
+    };
+    Station station;
+    station.id              = text(record->id);
+    station.name            = text(record->name);
+    station.description     = text(record->description);
+    station.streamUrl       = text(record->streamUrl);
+    station.aacStreamUrl    = text(record->aacStreamUrl);
+    station.preferredFormat = record->format == (uint8_t)StreamFormat::AAC ? StreamFormat::AAC : StreamFormat::MP3;
+    station.color           = record->color;
+    station.artworkUrl      = text(record->artworkUrl);
+    return station;
+}
+
+int StationCatalog::find(const char* id) const
+{
+    if (!_table) {
+        return builtin_station_index(id);
+    }
+
+    // At most half full, a miss ends at an empty slot in a probe or two
+    size_t mask = _table->index.size() - 1;
+    for (size_t slot = station_hash(id) & mask; _table->index[slot]; slot = (slot + 1) & mask) {
+        int index = _table->index[slot] - 1;
+        if (strcmp(record_id(*_table, index), id) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+StationCatalog& radio::catalog()
+{
+    static StationCatalog s_catalog;
+    return s_catalog;
+}
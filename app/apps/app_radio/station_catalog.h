@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "stations.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace radio {
+
+/**
+ * @brief The station list: SomaFM's channel directory, cached on the device, the built-in list until there is one
+ *
+ * The list is kept as a flat image (header, fixed-stride records, string table) in one of the HAL's two catalog
+ * slots. Construction maps the newest intact slot and reads it in place, nothing is parsed or copied, so a list of
+ * hundreds of stations is there at boot before the network is. Once WiFi is up `update()` fetches
+ * https://api.somafm.com/channels.json in the background, parses it as it streams in and writes the image to the
+ * other slot. The result is adopted by the next `update()` on the UI thread, stations handed out before that stay
+ * valid until then.
+ *
+ *     auto& catalog = radio::catalog();
+ *     if (catalog.update()) {
+ *         rebuild(catalog.count());                 // A refresh came in
+ *     }
+ *     play(radio::stream_url(catalog.at(index)));
+ */
+class StationCatalog {
+public:
+    static constexpr const char* CHANNELS_URL = "https://api.somafm.com/channels.json";
+    static constexpr uint32_t RETRY_MS        = 60 * 1000;  // After a failed refresh
+    static constexpr int MAX_STATIONS         = 1024;
+
+    StationCatalog();
+    ~StationCatalog();
+
+    /**
+     * @brief UI thread, call regularly: starts the refresh once WiFi is up, adopts its result
+     * @return true if the list changed, every index from before is stale
+     */
+    bool update();
+
+    int count() const;
+
+    /**
+     * @brief Built on the fly, the strings point into the image
+     */
+    Station at(int index) const;
+
+    /**
+     * @return index of the station with `id`, -1 if there is none, by hash against the built-in list and the image
+     */
+    int find(const char* id) const;
+
+    /**
+     * @brief A checked image, mapped from a catalog slot or held in RAM
+     */
+    struct Table_t {
+        std::vector<uint8_t> image;  // The bytes of a RAM table, empty for a mapped one
+        const uint8_t* records = nullptr;
+        const char* strings    = nullptr;
+        uint32_t stride        = 0;
+        int count              = 0;
+        uint32_t checksum      = 0;
+        uint32_t sequence      = 0;   // Higher is newer
+        int slot               = -1;  // Catalog slot holding the image, -1 if it isn't in flash
+        std::vector<uint16_t> index;  // Index + 1 of the station hashed there by station_hash(id), 0 for none
+    };
+
+private:
+    std::unique_ptr<Table_t> _table;        // What the UI sees, null while on the built-in list
+    std::atomic<Table_t*> _fresh{nullptr};  // Handed over by the refresh job
+    std::atomic<bool> _refreshing{false};
+    std::atomic<bool> _refreshed{false};    // Once per boot
+    uint32_t _last_attempt = 0;
+
+    void start_refresh();
+};
+
+/**
+ * @brief The one catalog, created (and loaded from the snapshot) on first use
+ */
+StationCatalog& catalog();
+
+}  // namespace radio
@@ -0,0 +1,223 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "station_search.h"
+#include "station_catalog.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace radio;
+
+static uint32_t trigram(const char* p)
+{
+    return (uint8_t)p[0] | (uint8_t)p[1] << 8 | (uint32_t)(uint8_t)p[2] << 16;
+}
+
+static bool word_start(const std::string& text, size_t at)
+{
+    if (at == 0) {
+        return true;
+    }
+    char c = text[at - 1];
+    return !((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'));
+}
+
+// ASCII only, the rest of UTF-8 is compared as it is
+std::string StationSearch::normalize(const std::string& text)
+{
+    std::string lower(text);
+    for (char& c : lower) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+    }
+    return lower;
+}
+
+std::vector<std::string> StationSearch::words(const std::string& query)
+{
+    std::vector<std::string> words;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find(' ', start);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        if (end > start) {
+            words.push_back(query.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return words;
+}
+
+void StationSearch::build(const StationCatalog& catalog)
+{
+    _entries.clear();
+    _postings.clear();
+    _query.clear();
+    _matched.clear();
+    _results.clear();
+    _letters = false;
+
+    int count = std::min(catalog.count(), (int)UINT16_MAX);
+    _entries.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Station station = catalog.at(i);
+        Entry_t entry;
+        entry.text    = normalize(station.name ? station.name : "");
+        entry.nameLen = entry.text.size();
+        entry.text += '\n';
+        entry.text += normalize(station.description ? station.description : "");
+
+        // Trigrams across a space can't come from a query word
+        for (size_t j = 0; j + 3 <= entry.text.size(); j++) {
+            const char* p = entry.text.data() + j;
+            if (p[0] != ' ' && p[1] != ' ' && p[2] != ' ' && p[0] != '\n' && p[1] != '\n' && p[2] != '\n') {
+                _postings.push_back({trigram(p), (uint16_t)i});
+            }
+        }
+        _entries.push_back(std::move(entry));
+    }
+
+    auto less = [](const Posting_t& a, const Posting_t& b) {
+        return a.trigram != b.trigram ? a.trigram < b.trigram : a.station < b.station;
+    };
+    auto same = [](const Posting_t& a, const Posting_t& b) {
+        return a.trigram == b.trigram && a.station == b.station;
+    };
+    std::sort(_postings.begin(), _postings.end(), less);
+    _postings.erase(std::unique(_postings.begin(), _postings.end(), same), _postings.end());
+    _postings.shrink_to_fit();
+}
+
+// The stations with every trigram of the words, in catalog order. All of them when no word is three bytes long
+std::vector<int> StationSearch::candidates(const std::vector<std::string>& words) const
+{
+    std::vector<int> stations;
+    bool all = true;
+    for (const auto& word : words) {
+        for (size_t j = 0; j + 3 <= word.size(); j++) {
+            uint32_t key = trigram(word.data() + j);
+            auto range   = std::equal_range(_postings.begin(), _postings.end(), Posting_t{key, 0},
+                                            [](const Posting_t& a, const Posting_t& b) { return a.trigram < b.trigram; });
+            std::vector<int> with;
+            with.reserve(std::distance(range.first, range.second));
+            for (auto it = range.first; it != range.second; ++it) {
+                with.push_back(it->station);
+            }
+            if (all) {
+                stations = std::move(with);
+                all      = false;
+            } else {
+                std::vector<int> both;
+                std::set_intersection(stations.begin(), stations.end(), with.begin(), with.end(),
+                                      std::back_inserter(both));
+                stations = std::move(both);
+            }
+            if (stations.empty()) {
+                return stations;
+            }
+        }
+    }
+    if (all) {
+        stations.resize(_entries.size());
+        for (size_t i = 0; i < stations.size(); i++) {
+            stations[i] = i;
+        }
+    }
+    return stations;
+}
+
+StationSearch::Tier_t StationSearch::match(const Entry_t& entry, const std::vector<std::string>& words, bool letters)
+{
+    if (letters) {
+        size_t at = 0;
+        for (const auto& word : words) {
+            for (char c : word) {
+                at = entry.text.find(c, at);
+                if (at == std::string::npos || at >= entry.nameLen) {
+                    return TIER_NONE;
+                }
+                at++;
+            }
+        }
+        return TIER_LETTERS;
+    }
+
+    Tier_t tier = TIER_NAME_WORDS;
+    for (const auto& word : words) {
+        Tier_t best = TIER_NONE;
+        for (size_t at = entry.text.find(word); at != std::string::npos; at = entry.text.find(word, at + 1)) {
+            if (at + word.size() > entry.nameLen) {
+                best = std::min(best, TIER_TEXT);
+                break;  // In the description, so is every later one
+            }
+            best = std::min(best, word_start(entry.text, at) ? TIER_NAME_WORDS : TIER_NAME);
+            if (best == TIER_NAME_WORDS) {
+                break;
+            }
+        }
+        if (best == TIER_NONE) {
+            return TIER_NONE;
+        }
+        tier = std::max(tier, best);
+    }
+    return tier;
+}
+
+void StationSearch::rank(const std::vector<int>& candidates, const std::vector<std::string>& words, bool letters)
+{
+    std::vector<std::pair<Tier_t, int>> ranked;
+    for (int station : candidates) {
+        Tier_t tier = match(_entries[station], words, letters);
+        if (tier != TIER_NONE) {
+            ranked.push_back({tier, station});
+        }
+    }
+    _matched.clear();
+    for (const auto& r : ranked) {
+        _matched.push_back(r.second);
+    }
+    // Catalog order within a tier
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const std::pair<Tier_t, int>& a, const std::pair<Tier_t, int>& b) { return a.first < b.first; });
+    _results.clear();
+    for (const auto& r : ranked) {
+        _results.push_back(r.second);
+    }
+    _letters = letters;
+}
+
+const std::vector<int>& StationSearch::find(const std::string& query)
+{
+    auto list = words(normalize(query));
+    std::string normalized;
+    for (const auto& word : list) {
+        normalized += (normalized.empty() ? "" : " ") + word;
+    }
+    if (normalized == _query) {
+        return _results;
+    }
+
+    // Every word of the new query holds a word of the old one, so it matches nothing the old one didn't
+    bool extends = !_query.empty() && normalized.compare(0, _query.size(), _query) == 0;
+    _query       = normalized;
+    if (list.empty()) {
+        _matched.clear();
+        _results.clear();
+        _letters = false;
+        return _results;
+    }
+
+    bool letters          = _letters;
+    std::vector<int> last = std::move(_matched);
+    rank(extends && !letters ? last : candidates(list), list, false);
+    if (_results.empty()) {
+        // Only the letters-in-order matches of the old query can be ones of the new query
+        rank(extends && letters ? last : candidates({}), list, true);
+    }
+    return _results;
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace radio {
+
+class StationCatalog;
+
+/**
+ * @brief Finds stations by what's typed, a keystroke at a time, over the name and the description (the genres)
+ *
+ * Each word typed has to be in the station's text, in any order: "space amb" finds Space Station Soma. A query that matches
+ * no station that way falls back to the letters in order in the name, "grsl" for Groove Salad. Results come best
+ * first: every word starting a word of the name, then all of them in the name, then in the description, then the
+ * letters in order.
+ *
+ * `build()` indexes the catalog once as it loads: the lowercased text, and a sorted table of the trigrams
+ * (three-byte sequences) each station's text has. A fresh query only looks at the stations that have every trigram
+ * of its words. A query that extends the previous one, the next keystroke, only looks at what the previous one
+ * matched, which is all the stations it can match.
+ *
+ *     radio::StationSearch search;
+ *     search.build(radio::catalog());
+ *     for (int station : search.find("groo")) { ... }  // Catalog indices
+ *     for (int station : search.find("groov")) { ... }  // Narrowed from "groo"
+ */
+class StationSearch {
+public:
+    /**
+     * @brief Index the catalog, the earlier results are gone: the indices changed with it
+     */
+    void build(const StationCatalog& catalog);
+
+    /**
+     * @return catalog indices of the stations that match, best first. Empty for an empty query
+     */
+    const std::vector<int>& find(const std::string& query);
+
+    const std::string& query() const
+    {
+        return _query;
+    }
+
+private:
+    enum Tier_t : uint8_t {
+        TIER_NAME_WORDS,  // Each word starts a word of the name
+        TIER_NAME,        // Each word is in the name
+        TIER_TEXT,        // Each word is in the name or the description
+        TIER_LETTERS,     // The letters are in the name in order
+        TIER_NONE,
+    };
+
+    struct Entry_t {
+        std::string text;  // Lowercased name, '\n', lowercased description
+        size_t nameLen;
+    };
+
+    // Station `station`'s text has `trigram`, sorted by trigram then station
+    struct Posting_t {
+        uint32_t trigram;
+        uint16_t station;
+    };
+
+    static std::string normalize(const std::string& text);
+    static std::vector<std::string> words(const std::string& query);
+    static Tier_t match(const Entry_t& entry, const std::vector<std::string>& words, bool letters);
+
+    std::vector<int> candidates(const std::vector<std::string>& words) const;
+    void rank(const std::vector<int>& candidates, const std::vector<std::string>& words, bool letters);
+
+    std::vector<Entry_t> _entries;
+    std::vector<Posting_t> _postings;
+
+    std::string _query;         // Last query, normalized
+    std::vector<int> _matched;  // Everything it matched, in catalog order: what an extension of it can match
+    bool _letters = false;      // _matched came from the letters-in-order fallback
+    std::vector<int> _results;  // _matched best first
+};
+
+}  // namespace radio
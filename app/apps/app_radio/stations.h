@@ -5,83 +5,140 @@
  */
 #pragma once
 #include <cstdint>
+#include <string>
+#include <vector>
 
 namespace radio {
 
+enum class StreamFormat {
+    MP3,
+    AAC,
+};
+
 /**
  * @brief SomaFM station definition
  */
 struct Station {
-    const char* id;           // Station identifier
-    const char* name;         // Display name
-    const char* description;  // Short description
-    const char* streamUrl;    // MP3 stream URL (128kbps)
-    uint32_t color;           // UI accent color
+    const char* id;                // Station identifier
+    const char* name;              // Display name
+    const char* description;       // Short description
+    const char* streamUrl;         // MP3 stream URL (128kbps)
+    const char* aacStreamUrl;      // HE-AAC stream URL (64kbps), nullptr if there is none
+    StreamFormat preferredFormat;  // Format to play when both are available
+    uint32_t color;                // UI accent color
+    const char* artworkUrl;        // JPEG logo, nullptr if there is none
 };
 
 /**
- * @brief List of SomaFM stations
- * All streams are 128kbps MP3 format
+ * @brief Hash of a station id, FNV-1a from a basis `seed` moves, the seeds are picked by gen_stations.py
+ */
+constexpr uint32_t station_hash(const char* id, uint32_t seed = 0)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *id; id++) {
+        hash = (hash ^ (uint8_t)*id) * 16777619u;
+    }
+    return hash;
+}
+
+}  // namespace radio
+
+/**
+ * @brief Built-in SomaFM stations, what `StationCatalog` offers until it has the channel list
+ * Every station has a 128kbps MP3 and a 64kbps HE-AAC stream, the AAC one sounds comparable for half the WiFi
+ * airtime and buffer memory. Generated by the build from stations.json (gen_stations.py), one `constexpr` table for
+ * the whole firmware with a perfect hash on the ids
+ */
+#include "stations_builtin.h"
+
+namespace radio {
+
+inline constexpr int STATION_COUNT = sizeof(STATIONS) / sizeof(STATIONS[0]);
+
+constexpr bool ids_equal(const char* a, const char* b)
+{
+    for (; *a && *a == *b; a++, b++) {
+    }
+    return *a == *b;
+}
+
+/**
+ * @return index in STATIONS of the built-in station with `id`, -1 if there is none: two hashes and one compare
  */
-static const Station STATIONS[] = {
-    {
-        "groovesalad",
-        "Groove Salad",
-        "Ambient/Downtempo",
-        "http://ice1.somafm.com/groovesalad-128-mp3",
-        0x7B68EE  // Medium slate blue
-    },
-    {
-        "dronezone",
-        "Drone Zone",
-        "Atmospheric Textures",
-        "http://ice1.somafm.com/dronezone-128-mp3",
-        0x4682B4  // Steel blue
-    },
-    {
-        "spacestation",
-        "Space Station Soma",
-        "Spaced-out Ambient",
-        "http://ice1.somafm.com/spacestation-128-mp3",
-        0x191970  // Midnight blue
-    },
-    {
-        "deepspaceone",
-        "Deep Space One",
-        "Deep Ambient",
-        "http://ice1.somafm.com/deepspaceone-128-mp3",
-        0x2F4F4F  // Dark slate gray
-    },
-    {
-        "defcon",
-        "DEF CON Radio",
-        "Hacker Tunes",
-        "http://ice1.somafm.com/defcon-128-mp3",
-        0x00FF00  // Lime green
-    },
-    {
-        "secretagent",
-        "Secret Agent",
-        "Lounge/Spy Music",
-        "http://ice1.somafm.com/secretagent-128-mp3",
-        0xDC143C  // Crimson
-    },
-    {
-        "lush",
-        "Lush",
-        "Sensuous Vocals",
-        "http://ice1.somafm.com/lush-128-mp3",
-        0xFF69B4  // Hot pink
-    },
-    {
-        "bootliquor",
-        "Boot Liquor",
-        "Americana/Roots",
-        "http://ice1.somafm.com/bootliquor-128-mp3",
-        0x8B4513  // Saddle brown
-    },
+constexpr int builtin_station_index(const char* id)
+{
+    uint32_t seed = STATION_SEEDS[station_hash(id) % STATION_BUCKETS];
+    int index     = STATION_SLOT_INDEX[station_hash(id, seed) & (STATION_SLOTS - 1)];
+    return index >= 0 && ids_equal(STATIONS[index].id, id) ? index : -1;
+}
+
+constexpr bool builtin_index_holds_every_station()
+{
+    for (int i = 0; i < STATION_COUNT; i++) {
+        if (builtin_station_index(STATIONS[i].id) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert((STATION_SLOTS & (STATION_SLOTS - 1)) == 0 && builtin_index_holds_every_station(),
+              "stations_builtin.h doesn't match station_hash(), regenerate it");
+
+/**
+ * @return the built-in station with `id`, nullptr if there is none
+ */
+inline const Station* builtin_station(const char* id)
+{
+    int index = builtin_station_index(id);
+    return index >= 0 ? &STATIONS[index] : nullptr;
+}
+
+/**
+ * @brief URL to stream for a station, honouring its preferred format
+ */
+inline const char* stream_url(const Station& station)
+{
+    if (station.preferredFormat == StreamFormat::AAC && station.aacStreamUrl) {
+        return station.aacStreamUrl;
+    }
+    return station.streamUrl;
+}
+
+struct StreamVariant {
+    std::string url;
+    int kbps;
 };
 
-static const int STATION_COUNT = sizeof(STATIONS) / sizeof(STATIONS[0]);
+/**
+ * @brief The station's stream at each bitrate SomaFM serves it at, lowest first, for the radio to step between.
+ * They're named `<id>-<kbps>-<codec>` on every mirror, the 320kbps one isn't there for every station. Empty for a
+ * stream that isn't named that way
+ */
+inline std::vector<StreamVariant> stream_variants(const Station& station)
+{
+    static const std::string SUFFIX = "-128-mp3";
+    std::string url = station.streamUrl;
+    if (url.size() <= SUFFIX.size() || url.compare(url.size() - SUFFIX.size(), SUFFIX.size(), SUFFIX) != 0) {
+        return {};
+    }
+    std::string base = url.substr(0, url.size() - SUFFIX.size());
+    std::vector<StreamVariant> variants;
+    if (station.aacStreamUrl) {
+        variants.push_back({base + "-32-aac", 32});
+        variants.push_back({station.aacStreamUrl, 64});
+    }
+    variants.push_back({url, 128});
+    variants.push_back({base + "-320-mp3", 320});
+    return variants;
+}
+
+/**
+ * @brief The station's lowest bitrate stream, what a scan previews it at: the 32kbps HE-AAC one where it has one
+ */
+inline std::string preview_url(const Station& station)
+{
+    std::vector<StreamVariant> variants = stream_variants(station);
+    return variants.empty() ? std::string(stream_url(station)) : variants.front().url;
+}
 
 }  // namespace radio
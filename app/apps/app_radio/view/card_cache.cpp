@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "card_cache.h"
+
+using namespace radio_view;
+
+CardCache::CardCache(lv_obj_t* container, lv_color_t background) : _container(container), _background(background)
+{
+}
+
+CardCache::~CardCache()
+{
+    // The proxies go with the container
+    for (auto& slot : _slots) {
+        if (slot.snap) {
+            lv_image_cache_drop(slot.snap);
+            lv_draw_buf_destroy(slot.snap);
+        }
+    }
+    if (_scratch) {
+        lv_draw_buf_destroy(_scratch);
+    }
+}
+
+int CardCache::add(lv_obj_t* card)
+{
+    Slot_t slot;
+    slot.card  = card;
+    slot.proxy = lv_image_create(_container);
+    lv_obj_add_flag(slot.proxy, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(slot.proxy, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_flag(slot.proxy, LV_OBJ_FLAG_IGNORE_LAYOUT);
+    _slots.push_back(slot);
+    return _slots.size() - 1;
+}
+
+void CardCache::invalidate(int slot)
+{
+    auto& s = _slots[slot];
+    s.valid = false;
+    if (_active) {
+        show_proxy(s);
+    }
+}
+
+void CardCache::begin()
+{
+    if (_active) {
+        return;
+    }
+    _active = true;
+    for (auto& slot : _slots) {
+        show_proxy(slot);
+    }
+}
+
+void CardCache::end()
+{
+    if (!_active) {
+        return;
+    }
+    _active = false;
+    for (auto& slot : _slots) {
+        lv_obj_add_flag(slot.proxy, LV_OBJ_FLAG_HIDDEN);
+        set_card_drawn(slot.card, true);
+    }
+}
+
+void CardCache::set_card_drawn(lv_obj_t* card, bool drawn)
+{
+    // LVGL skips an object with no layered opacity outright, input still finds it
+    lv_obj_set_style_opa_layered(card, drawn ? LV_OPA_COVER : LV_OPA_TRANSP, LV_PART_MAIN);
+}
+
+void CardCache::show_proxy(Slot_t& slot)
+{
+    if (lv_obj_has_flag(slot.card, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(slot.proxy, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    if (!slot.valid && !render(slot)) {
+        // Out of memory for it, the card draws itself
+        lv_obj_add_flag(slot.proxy, LV_OBJ_FLAG_HIDDEN);
+        set_card_drawn(slot.card, true);
+        return;
+    }
+
+    int32_t ext = lv_obj_get_ext_draw_size(slot.card);
+    lv_obj_set_pos(slot.proxy, lv_obj_get_x(slot.card) - ext, lv_obj_get_y(slot.card) - ext);
+    lv_obj_clear_flag(slot.proxy, LV_OBJ_FLAG_HIDDEN);
+    set_card_drawn(slot.card, false);
+}
+
+bool CardCache::render(Slot_t& slot)
+{
+    set_card_drawn(slot.card, true);
+    lv_obj_update_layout(slot.card);
+    if (!_scratch) {
+        _scratch = lv_snapshot_create_draw_buf(slot.card, LV_COLOR_FORMAT_ARGB8888);
+    } else if (lv_snapshot_reshape_draw_buf(slot.card, _scratch) != LV_RESULT_OK) {
+        lv_draw_buf_destroy(_scratch);
+        _scratch = lv_snapshot_create_draw_buf(slot.card, LV_COLOR_FORMAT_ARGB8888);
+    }
+    if (!_scratch || lv_snapshot_take_to_draw_buf(slot.card, LV_COLOR_FORMAT_ARGB8888, _scratch) != LV_RESULT_OK) {
+        return false;
+    }
+
+    uint32_t w = _scratch->header.w;
+    uint32_t h = _scratch->header.h;
+    if (slot.snap && (slot.snap->header.w != w || slot.snap->header.h != h)) {
+        lv_image_cache_drop(slot.snap);
+        lv_draw_buf_destroy(slot.snap);
+        slot.snap = nullptr;
+    }
+    if (!slot.snap) {
+        slot.snap = lv_draw_buf_create(w, h, LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+        if (!slot.snap) {
+            return false;
+        }
+    }
+
+    // Flatten onto the container's background, so the proxy is an opaque copy with nothing left to blend
+    for (uint32_t y = 0; y < h; y++) {
+        auto src = reinterpret_cast<const lv_color32_t*>(lv_draw_buf_goto_xy(_scratch, 0, y));
+        auto dst = reinterpret_cast<uint16_t*>(lv_draw_buf_goto_xy(slot.snap, 0, y));
+        for (uint32_t x = 0; x < w; x++) {
+            lv_color_t c = lv_color_mix(lv_color_make(src[x].red, src[x].green, src[x].blue), _background, src[x].alpha);
+            dst[x]       = lv_color_to_u16(c);
+        }
+    }
+
+    lv_image_cache_drop(slot.snap);
+    lv_image_set_src(slot.proxy, slot.snap);
+    lv_obj_invalidate(slot.proxy);
+    slot.valid = true;
+    return true;
+}
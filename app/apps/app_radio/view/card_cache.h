@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <vector>
+
+namespace radio_view {
+
+/**
+ * @brief Pre-rendered stand-ins for the cards of a scrolling container
+ *
+ * A scroll redraws every card in view each frame: rounded borders, text, logos. While it runs, each card is shown as
+ * an opaque RGB565 snapshot of itself instead, a plain image copy per card, and the live cards are back once the
+ * scroll (a fling included) has settled. Cards stay where they are and keep taking input, they're only not drawn.
+ *
+ * Snapshots are kept between scrolls. Tell the cache when a card changed, it only renders those again:
+ *
+ *     int slot = cache.add(card);
+ *     ...
+ *     lv_label_set_text(label_in_card, "...");
+ *     cache.invalidate(slot);
+ */
+class CardCache {
+public:
+    /**
+     * @param background what the container shows around the cards' rounded corners
+     */
+    CardCache(lv_obj_t* container, lv_color_t background);
+    ~CardCache();
+
+    int add(lv_obj_t* card);
+    void invalidate(int slot);
+
+    // LV_EVENT_SCROLL_BEGIN and LV_EVENT_SCROLL_END of the container
+    void begin();
+    void end();
+    bool active() const
+    {
+        return _active;
+    }
+
+private:
+    struct Slot_t {
+        lv_obj_t* card      = nullptr;
+        lv_obj_t* proxy     = nullptr;
+        lv_draw_buf_t* snap = nullptr;  // RGB565, what the proxy shows
+        bool valid          = false;
+    };
+
+    lv_obj_t* _container;
+    lv_color_t _background;
+    std::vector<Slot_t> _slots;
+    lv_draw_buf_t* _scratch = nullptr;  // ARGB8888, snapshots are rendered here first
+    bool _active            = false;
+
+    bool render(Slot_t& slot);
+    void show_proxy(Slot_t& slot);
+    static void set_card_drawn(lv_obj_t* card, bool drawn);
+};
+
+}  // namespace radio_view
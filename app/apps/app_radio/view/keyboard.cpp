@@ -5,10 +5,96 @@
  */
 #include "keyboard.h"
 #include "radio_view.h"
+#include "theme.h"
+#include <cstring>
 
 using namespace radio_view;
 using namespace smooth_ui_toolkit::lvgl_cpp;
 
+// A row is ROW_SPAN half keys wide, the keyboard is ROWS of them, GAP apart (the keyboard style's pad gap)
+static constexpr int ROWS       = 5;
+static constexpr int ROW_SPAN   = 24;
+static constexpr int32_t GAP    = 5;
+static constexpr int32_t HEIGHT = 280;
+
+enum Action_t { TYPE, BACKSPACE, DONE, SHIFT, SYMBOLS_TOGGLE, LEFT, RIGHT, CLOSE, NEXT_ROW };
+
+struct Keyboard::KeyDef_t {
+    const char* text;  // Typed for TYPE keys, the cap otherwise
+    uint8_t span;      // In half keys
+    Action_t action;
+};
+
+using KeyDef = Keyboard::KeyDef_t;
+
+#define KEY(text)  {text, 2, TYPE}
+#define ROW_END    {nullptr, 0, NEXT_ROW}
+
+static const KeyDef s_lower[] = {
+    KEY("1"), KEY("2"), KEY("3"), KEY("4"), KEY("5"), KEY("6"), KEY("7"), KEY("8"), KEY("9"), KEY("0"),
+    {LV_SYMBOL_BACKSPACE, 4, BACKSPACE}, ROW_END,
+    KEY("q"), KEY("w"), KEY("e"), KEY("r"), KEY("t"), KEY("y"), KEY("u"), KEY("i"), KEY("o"), KEY("p"),
+    KEY("-"), KEY("_"), ROW_END,
+    KEY("a"), KEY("s"), KEY("d"), KEY("f"), KEY("g"), KEY("h"), KEY("j"), KEY("k"), KEY("l"), KEY("@"),
+    {LV_SYMBOL_OK, 4, DONE}, ROW_END,
+    {LV_SYMBOL_UP, 4, SHIFT}, KEY("z"), KEY("x"), KEY("c"), KEY("v"), KEY("b"), KEY("n"), KEY("m"), KEY("."),
+    KEY(","), KEY("/"), ROW_END,
+    {"#+=", 4, SYMBOLS_TOGGLE}, {LV_SYMBOL_LEFT, 2, LEFT}, {" ", 10, TYPE}, {LV_SYMBOL_RIGHT, 2, RIGHT},
+    {LV_SYMBOL_KEYBOARD, 6, CLOSE}, ROW_END,
+};
+
+static const KeyDef s_upper[] = {
+    KEY("1"), KEY("2"), KEY("3"), KEY("4"), KEY("5"), KEY("6"), KEY("7"), KEY("8"), KEY("9"), KEY("0"),
+    {LV_SYMBOL_BACKSPACE, 4, BACKSPACE}, ROW_END,
+    KEY("Q"), KEY("W"), KEY("E"), KEY("R"), KEY("T"), KEY("Y"), KEY("U"), KEY("I"), KEY("O"), KEY("P"),
+    KEY("-"), KEY("_"), ROW_END,
+    KEY("A"), KEY("S"), KEY("D"), KEY("F"), KEY("G"), KEY("H"), KEY("J"), KEY("K"), KEY("L"), KEY("@"),
+    {LV_SYMBOL_OK, 4, DONE}, ROW_END,
+    {LV_SYMBOL_UP, 4, SHIFT}, KEY("Z"), KEY("X"), KEY("C"), KEY("V"), KEY("B"), KEY("N"), KEY("M"), KEY("."),
+    KEY(","), KEY("/"), ROW_END,
+    {"#+=", 4, SYMBOLS_TOGGLE}, {LV_SYMBOL_LEFT, 2, LEFT}, {" ", 10, TYPE}, {LV_SYMBOL_RIGHT, 2, RIGHT},
+    {LV_SYMBOL_KEYBOARD, 6, CLOSE}, ROW_END,
+};
+
+static const KeyDef s_symbols[] = {
+    KEY("1"), KEY("2"), KEY("3"), KEY("4"), KEY("5"), KEY("6"), KEY("7"), KEY("8"), KEY("9"), KEY("0"),
+    {LV_SYMBOL_BACKSPACE, 4, BACKSPACE}, ROW_END,
+    KEY("!"), KEY("\""), KEY("#"), KEY("$"), KEY("%"), KEY("&"), KEY("'"), KEY("("), KEY(")"), KEY("*"),
+    KEY("+"), KEY("="), ROW_END,
+    KEY(":"), KEY(";"), KEY("<"), KEY(">"), KEY("?"), KEY("["), KEY("]"), KEY("\\"), KEY("^"), KEY("`"),
+    {LV_SYMBOL_OK, 4, DONE}, ROW_END,
+    {LV_SYMBOL_UP, 4, SHIFT}, KEY("{"), KEY("|"), KEY("}"), KEY("~"), KEY("-"), KEY("_"), KEY("@"), KEY("."),
+    KEY(","), KEY("/"), ROW_END,
+    {"abc", 4, SYMBOLS_TOGGLE}, {LV_SYMBOL_LEFT, 2, LEFT}, {" ", 10, TYPE}, {LV_SYMBOL_RIGHT, 2, RIGHT},
+    {LV_SYMBOL_KEYBOARD, 6, CLOSE}, ROW_END,
+};
+
+#undef KEY
+#undef ROW_END
+
+// The layout's keys laid out in a `width` wide keyboard
+static std::vector<Keyboard::Key_t> lay_out(const KeyDef* defs, size_t count, int32_t width)
+{
+    std::vector<Keyboard::Key_t> keys;
+    float half = (width + GAP) / (float)ROW_SPAN;  // A half key and half a gap
+    int32_t h  = (HEIGHT - (ROWS - 1) * GAP) / ROWS;
+    int row    = 0;
+    int at     = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (defs[i].action == NEXT_ROW) {
+            row++;
+            at = 0;
+            continue;
+        }
+        int32_t x1 = (int32_t)(at * half);
+        int32_t x2 = (int32_t)((at + defs[i].span) * half) - GAP - 1;
+        int32_t y1 = row * (h + GAP);
+        keys.push_back({{x1, y1, x2, y1 + h - 1}, &defs[i]});
+        at += defs[i].span;
+    }
+    return keys;
+}
+
 Keyboard::Keyboard(lv_obj_t* parent)
     : _parent(parent)
     , _keyboard(nullptr)
@@ -23,55 +109,241 @@ Keyboard::~Keyboard()
     if (_keyboard) {
         lv_obj_delete(_keyboard);
     }
+    if (_caps) {
+        lv_image_cache_drop(_caps);
+        lv_draw_buf_destroy(_caps);
+    }
 }
 
 void Keyboard::create_keyboard()
 {
     // Create keyboard container
-    _container = std::make_unique<Container>(_parent);
-    _container->setSize(1280, 300);
+    int32_t screen_width = lv_display_get_horizontal_resolution(lv_display_get_default());
+    _container           = std::make_unique<Container>(_parent);
+    _container->setSize(screen_width, 300);
     _container->align(LV_ALIGN_BOTTOM_MID, 0, 0);
-    _container->setBgColor(lv_color_hex(colors::BG_SECONDARY));
-    _container->setBorderWidth(0);
-    _container->setRadius(0);
+    lv_obj_add_style(_container->get(), theme::keyboard_panel(), LV_PART_MAIN);
     _container->setHidden(true);
 
-    // Create LVGL keyboard widget
-    _keyboard = lv_keyboard_create(_container->get());
-    lv_obj_set_size(_keyboard, 1240, 280);
+    // The caps are drawn in the keys' style, shift while it's on and the key held down in the checked one
+    int32_t width = screen_width - 40;
+    _keyboard     = lv_canvas_create(_container->get());
+    lv_obj_add_style(_keyboard, theme::keyboard(), LV_PART_MAIN);
+    lv_obj_add_style(_keyboard, theme::keyboard_key(), LV_PART_ITEMS);
+    lv_obj_add_flag(_keyboard, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(_keyboard, width, HEIGHT);
     lv_obj_align(_keyboard, LV_ALIGN_CENTER, 0, 0);
 
-    // Style the keyboard
-    lv_obj_set_style_bg_color(_keyboard, lv_color_hex(colors::BG_SECONDARY), LV_PART_MAIN);
-    lv_obj_set_style_bg_color(_keyboard, lv_color_hex(colors::BG_TERTIARY), LV_PART_ITEMS);
-    lv_obj_set_style_text_color(_keyboard, lv_color_hex(colors::TEXT_PRIMARY), LV_PART_ITEMS);
-    lv_obj_set_style_text_font(_keyboard, &lv_font_montserrat_18, LV_PART_ITEMS);
-    lv_obj_set_style_border_width(_keyboard, 0, LV_PART_ITEMS);
-    lv_obj_set_style_radius(_keyboard, 8, LV_PART_ITEMS);
-    lv_obj_set_style_pad_gap(_keyboard, 5, LV_PART_MAIN);
-
-    // Style checked (shift) keys
-    lv_obj_set_style_bg_color(_keyboard, lv_color_hex(colors::ACCENT), LV_PART_ITEMS | LV_STATE_CHECKED);
-
-    // Set keyboard ready callback
-    lv_obj_add_event_cb(_keyboard, [](lv_event_t* e) {
-        Keyboard* kb = (Keyboard*)lv_event_get_user_data(e);
-        uint32_t id = lv_keyboard_get_selected_button(kb->_keyboard);
-        const char* txt = lv_keyboard_get_button_text(kb->_keyboard, id);
-
-        if (txt && (strcmp(txt, LV_SYMBOL_OK) == 0 || strcmp(txt, LV_SYMBOL_KEYBOARD) == 0)) {
-            kb->hide();
-            if (kb->_on_done) {
-                kb->_on_done();
+    _keys[LOWER]   = lay_out(s_lower, sizeof(s_lower) / sizeof(s_lower[0]), width);
+    _keys[UPPER]   = lay_out(s_upper, sizeof(s_upper) / sizeof(s_upper[0]), width);
+    _keys[SYMBOLS] = lay_out(s_symbols, sizeof(s_symbols) / sizeof(s_symbols[0]), width);
+
+    _caps = lv_draw_buf_create(width, HEIGHT, LV_COLOR_FORMAT_NATIVE, LV_STRIDE_AUTO);
+    if (_caps) {
+        lv_canvas_set_draw_buf(_keyboard, _caps);
+    }
+    render_caps();
+
+    for (lv_event_code_t code : {LV_EVENT_PRESSED, LV_EVENT_PRESSING, LV_EVENT_RELEASED, LV_EVENT_PRESS_LOST,
+                                 LV_EVENT_LONG_PRESSED_REPEAT, LV_EVENT_DRAW_POST}) {
+        lv_obj_add_event_cb(_keyboard, event_cb, code, this);
+    }
+}
+
+void Keyboard::render_caps()
+{
+    if (!_caps) {
+        return;  // Drawn with every redraw
+    }
+    lv_canvas_fill_bg(_keyboard, lv_obj_get_style_bg_color(_keyboard, LV_PART_MAIN), LV_OPA_COVER);
+    lv_layer_t layer;
+    lv_canvas_init_layer(_keyboard, &layer);
+    for (int i = 0; i < (int)_keys[_layout].size(); i++) {
+        draw_key(&layer, i, 0, 0, false);
+    }
+    lv_canvas_finish_layer(_keyboard, &layer);
+    lv_image_cache_drop(_caps);
+    lv_obj_invalidate(_keyboard);
+}
+
+void Keyboard::draw_key(lv_layer_t* layer, int index, int32_t x, int32_t y, bool highlight)
+{
+    const Key_t& key = _keys[_layout][index];
+    lv_area_t area   = key.area;
+    lv_area_move(&area, x, y);
+
+    lv_draw_rect_dsc_t rect;
+    lv_draw_rect_dsc_init(&rect);
+    lv_obj_init_draw_rect_dsc(_keyboard, LV_PART_ITEMS, &rect);
+    lv_draw_label_dsc_t label;
+    lv_draw_label_dsc_init(&label);
+    lv_obj_init_draw_label_dsc(_keyboard, LV_PART_ITEMS, &label);
+    // Taken from the style, a checked state on the canvas would invalidate all of it
+    lv_style_value_t checked;
+    if ((highlight || (key.def->action == SHIFT && _layout == UPPER)) &&
+        lv_style_get_prop(theme::keyboard_key_checked(), LV_STYLE_BG_COLOR, &checked) == LV_STYLE_RES_FOUND) {
+        rect.bg_color = checked.color;
+    }
+
+    lv_draw_rect(layer, &rect, &area);
+    label.text          = key.def->text;
+    label.align         = LV_TEXT_ALIGN_CENTER;
+    int32_t top         = (lv_area_get_height(&area) - lv_font_get_line_height(label.font)) / 2;
+    lv_area_t text_area = {area.x1, area.y1 + top, area.x2, area.y2};
+    lv_draw_label(layer, &label, &text_area);
+}
+
+void Keyboard::invalidate_key(int index)
+{
+    if (index < 0) {
+        return;
+    }
+    lv_area_t area = _keys[_layout][index].area;
+    lv_area_t coords;
+    lv_obj_get_coords(_keyboard, &coords);
+    lv_area_move(&area, coords.x1, coords.y1);
+    lv_obj_invalidate_area(_keyboard, &area);
+}
+
+int Keyboard::key_at(const lv_point_t& point) const
+{
+    lv_area_t coords;
+    lv_obj_get_coords(_keyboard, &coords);
+    lv_point_t p = {point.x - coords.x1, point.y - coords.y1};
+    // A touch in a gap goes to the key on either side of it
+    for (int i = 0; i < (int)_keys[_layout].size(); i++) {
+        const lv_area_t& a = _keys[_layout][i].area;
+        if (p.x >= a.x1 - GAP / 2 && p.x <= a.x2 + (GAP + 1) / 2 && p.y >= a.y1 - GAP / 2 &&
+            p.y <= a.y2 + (GAP + 1) / 2) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void Keyboard::press(int index)
+{
+    if (index == _pressed) {
+        return;
+    }
+    invalidate_key(_pressed);
+    _pressed = index;
+    invalidate_key(_pressed);
+}
+
+void Keyboard::set_layout(Layout_t layout)
+{
+    _pressed = -1;
+    _layout  = layout;
+    render_caps();
+}
+
+void Keyboard::activate(int index)
+{
+    const KeyDef_t* def = _keys[_layout][index].def;
+    switch (def->action) {
+        case TYPE:
+            if (_target_ta) {
+                lv_textarea_add_text(_target_ta, def->text);
+            }
+            break;
+        case BACKSPACE:
+            if (_target_ta) {
+                lv_textarea_delete_char(_target_ta);
+            }
+            break;
+        case LEFT:
+            if (_target_ta) {
+                lv_textarea_cursor_left(_target_ta);
+            }
+            break;
+        case RIGHT:
+            if (_target_ta) {
+                lv_textarea_cursor_right(_target_ta);
+            }
+            break;
+        case SHIFT:
+            set_layout(_layout == UPPER ? LOWER : UPPER);  // From the symbols too
+            break;
+        case SYMBOLS_TOGGLE:
+            set_layout(_layout == SYMBOLS ? LOWER : SYMBOLS);
+            break;
+        case DONE:
+            if (_target_ta) {
+                lv_obj_send_event(_target_ta, LV_EVENT_READY, nullptr);
+            }
+            hide();
+            if (_on_done) {
+                _on_done();
+            }
+            break;
+        case CLOSE:
+            if (_target_ta) {
+                lv_obj_send_event(_target_ta, LV_EVENT_CANCEL, nullptr);
+            }
+            hide();
+            if (_on_done) {
+                _on_done();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void Keyboard::event_cb(lv_event_t* e)
+{
+    static_cast<Keyboard*>(lv_event_get_user_data(e))->handle_event(e);
+}
+
+void Keyboard::handle_event(lv_event_t* e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_DRAW_POST) {
+        lv_layer_t* layer = lv_event_get_layer(e);
+        lv_area_t coords;
+        lv_obj_get_coords(_keyboard, &coords);
+        if (!_caps) {
+            for (int i = 0; i < (int)_keys[_layout].size(); i++) {
+                draw_key(layer, i, coords.x1, coords.y1, false);
             }
         }
-    }, LV_EVENT_READY, this);
+        if (_pressed >= 0) {
+            draw_key(layer, _pressed, coords.x1, coords.y1, true);
+        }
+        return;
+    }
 
-    // Also handle cancel
-    lv_obj_add_event_cb(_keyboard, [](lv_event_t* e) {
-        Keyboard* kb = (Keyboard*)lv_event_get_user_data(e);
-        kb->hide();
-    }, LV_EVENT_CANCEL, this);
+    lv_point_t point;
+    lv_indev_t* indev = lv_indev_active();
+    if (!indev) {
+        return;
+    }
+    lv_indev_get_point(indev, &point);
+    switch (code) {
+        case LV_EVENT_PRESSED:
+        case LV_EVENT_PRESSING:
+            press(key_at(point));  // Slides along to the key under the finger, as lv_keyboard does
+            break;
+        case LV_EVENT_LONG_PRESSED_REPEAT:
+            if (_pressed >= 0 && _keys[_layout][_pressed].def->action == BACKSPACE) {
+                activate(_pressed);
+            }
+            break;
+        case LV_EVENT_RELEASED: {
+            int index = _pressed;
+            press(-1);
+            if (index >= 0) {
+                activate(index);
+            }
+            break;
+        }
+        case LV_EVENT_PRESS_LOST:
+            press(-1);
+            break;
+        default:
+            break;
+    }
 }
 
 void Keyboard::show()
@@ -82,12 +354,19 @@ void Keyboard::show()
 
 void Keyboard::hide()
 {
+    press(-1);
     _container->setHidden(true);
     _visible = false;
 }
 
 void Keyboard::setTarget(lv_obj_t* textarea)
 {
+    // The focused look moves with the typing, as with lv_keyboard
+    if (_target_ta) {
+        lv_obj_remove_state(_target_ta, LV_STATE_FOCUSED);
+    }
     _target_ta = textarea;
-    lv_keyboard_set_textarea(_keyboard, textarea);
+    if (_target_ta) {
+        lv_obj_add_state(_target_ta, LV_STATE_FOCUSED);
+    }
 }
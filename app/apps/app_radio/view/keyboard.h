@@ -10,11 +10,17 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <vector>
 
 namespace radio_view {
 
 /**
  * @brief On-screen QWERTY keyboard for text input
+ *
+ * The key caps of the current layout are drawn once into a canvas, and a redraw of the keyboard is one image blit.
+ * Keys sit on a grid worked out once, a touch is matched against that rather than against widgets. A press redraws
+ * only its key, in the checked style, over the caps. Only switching layouts (shift, symbols) renders the caps again.
+ * With no memory for the canvas, the caps are drawn on every redraw instead.
  */
 class Keyboard {
 public:
@@ -25,18 +31,43 @@ public:
     void hide();
     bool isVisible() const { return _visible; }
 
+    /**
+     * @brief Type into `textarea`, which gets the focused state while it's the target
+     */
     void setTarget(lv_obj_t* textarea);
     void setOnDone(std::function<void()> callback) { _on_done = callback; }
 
+    enum Layout_t { LOWER = 0, UPPER, SYMBOLS, LAYOUT_COUNT };
+    struct KeyDef_t;
+    struct Key_t {
+        lv_area_t area;  // In the canvas
+        const KeyDef_t* def;
+    };
+
 private:
     lv_obj_t* _parent;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _container;
-    lv_obj_t* _keyboard;
+    lv_obj_t* _keyboard;  // The canvas the caps are drawn into
+    lv_draw_buf_t* _caps = nullptr;
     lv_obj_t* _target_ta;
     bool _visible;
     std::function<void()> _on_done;
 
+    std::vector<Key_t> _keys[LAYOUT_COUNT];
+    Layout_t _layout = LOWER;
+    int _pressed     = -1;  // Into the layout's keys, -1 for none
+
     void create_keyboard();
+    void render_caps();
+    void draw_key(lv_layer_t* layer, int index, int32_t x, int32_t y, bool highlight);
+    void invalidate_key(int index);
+    int key_at(const lv_point_t& point) const;
+    void press(int index);
+    void activate(int index);
+    void set_layout(Layout_t layout);
+
+    static void event_cb(lv_event_t* e);
+    void handle_event(lv_event_t* e);
 };
 
 }  // namespace radio_view
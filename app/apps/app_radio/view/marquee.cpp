@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "marquee.h"
+#include "text_image.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace radio_view;
+using namespace smooth_ui_toolkit::lvgl_cpp;
+
+// Longest step a tick takes, the first after the loop was stopped doesn't jump
+static constexpr uint32_t MAX_STEP_MS = 100;
+
+Marquee::Marquee(lv_obj_t* parent)
+{
+    _container = std::make_unique<Container>(parent);
+    lv_obj_remove_style_all(_container->get());
+    lv_obj_set_height(_container->get(), LV_SIZE_CONTENT);
+    lv_obj_clear_flag(_container->get(), LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_clear_flag(_container->get(), LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(_container->get(), draw_event_cb, LV_EVENT_DRAW_MAIN, this);
+
+    // Sizes the strip's height and takes its font and color from it
+    _label = lv_label_create(_container->get());
+    lv_label_set_text(_label, "");
+    lv_obj_set_pos(_label, 0, 0);
+}
+
+Marquee::~Marquee()
+{
+    // The label goes with the strip
+    if (_mask) {
+        lv_image_cache_drop(_mask);
+        lv_draw_buf_destroy(_mask);
+    }
+}
+
+void Marquee::setText(const char* text)
+{
+    const char* shown = lv_label_get_text(_label);
+    if (shown && std::strcmp(shown, text) == 0) {
+        return;
+    }
+    lv_label_set_text(_label, text);
+    refresh();
+}
+
+void Marquee::refresh()
+{
+    if (TextImage::render_mask(_label, &_mask)) {
+        lv_obj_set_style_opa_layered(_label, LV_OPA_TRANSP, LV_PART_MAIN);
+    } else {
+        // No memory for the mask, the label draws itself, clipped by the strip and still
+        if (_mask) {
+            lv_image_cache_drop(_mask);
+            lv_draw_buf_destroy(_mask);
+            _mask = nullptr;
+        }
+        lv_obj_set_style_opa_layered(_label, LV_OPA_COVER, LV_PART_MAIN);
+    }
+    lv_obj_update_layout(_container->get());
+    _scrolling = _mask && lv_obj_get_width(_label) > lv_obj_get_content_width(_container->get());
+    restart();
+    lv_obj_invalidate(_container->get());
+}
+
+void Marquee::restart()
+{
+    _offset = 0;
+    _travel = 0;
+    _held   = 0;
+}
+
+void Marquee::tick(uint32_t now)
+{
+    uint32_t elapsed = now - _last_tick;
+    if (elapsed < FRAME_MS) {
+        return;
+    }
+    _last_tick = now;
+    if (!_scrolling) {
+        return;
+    }
+
+    elapsed = std::min(elapsed, MAX_STEP_MS);
+    if (_held < HOLD_MS) {
+        _held += elapsed;
+        return;
+    }
+    _travel += elapsed * SPEED;
+    int32_t offset = _travel / 1000;
+    if (offset >= lv_obj_get_width(_label) + GAP) {
+        restart();  // The second copy is where the first started
+        offset = 0;
+    }
+    if (offset != _offset) {
+        _offset = offset;
+        lv_obj_invalidate(_container->get());
+    }
+}
+
+void Marquee::draw_event_cb(lv_event_t* e)
+{
+    static_cast<Marquee*>(lv_event_get_user_data(e))->draw(lv_event_get_layer(e));
+}
+
+void Marquee::draw(lv_layer_t* layer)
+{
+    if (!_mask) {
+        return;
+    }
+
+    lv_area_t strip;
+    lv_obj_get_content_coords(_container->get(), &strip);
+    lv_area_t clip;
+    if (!lv_area_intersect(&clip, &layer->_clip_area, &strip)) {
+        return;
+    }
+
+    // The mask has the label's extra draw area around it
+    int32_t ext = lv_obj_get_ext_draw_size(_label);
+    int32_t w   = _mask->header.w;
+    int32_t h   = _mask->header.h;
+    int32_t x   = _scrolling ? strip.x1 - ext - _offset : strip.x1 + (lv_area_get_width(&strip) - w) / 2;
+    int32_t y   = strip.y1 - ext;
+
+    lv_draw_image_dsc_t dsc;
+    lv_draw_image_dsc_init(&dsc);
+    dsc.src         = _mask;
+    dsc.recolor     = lv_obj_get_style_text_color(_container->get(), LV_PART_MAIN);
+    dsc.recolor_opa = LV_OPA_COVER;
+    dsc.opa         = lv_obj_get_style_text_opa(_container->get(), LV_PART_MAIN);
+
+    lv_area_t saved   = layer->_clip_area;
+    layer->_clip_area = clip;
+    int copies        = _scrolling ? 2 : 1;
+    for (int i = 0; i < copies; i++) {
+        int32_t at    = x + i * (lv_obj_get_width(_label) + GAP);
+        lv_area_t img = {at, y, at + w - 1, y + h - 1};
+        if (img.x2 >= clip.x1 && img.x1 <= clip.x2) {
+            lv_draw_image(layer, &dsc, &img);
+        }
+    }
+    layer->_clip_area = saved;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <smooth_ui_toolkit.h>
+#include <smooth_lvgl.h>
+#include <cstdint>
+#include <memory>
+
+namespace radio_view {
+
+/**
+ * @brief One line of text in a fixed width strip, scrolling round when it's longer than that
+ *
+ * A label in LV_LABEL_LONG_SCROLL_CIRCULAR mode is an animated object: every step moves its text and redraws the
+ * whole label, glyph by glyph. Here the text is rendered once per `setText()` into an A8 mask (as TextImage does),
+ * and a step only changes the offset it's drawn at: one recolored mask blit, twice across the wrap, clipped to the
+ * strip, and only the strip is invalidated. Text that fits is centred and doesn't move. Each pass starts with the
+ * text held still for HOLD_MS.
+ *
+ * It moves in `tick()`, so with the view's update loop stopped while the display is off it stops with it, and
+ * picks up where it was when it's back on.
+ *
+ *     Marquee title(card);
+ *     lv_obj_set_width(title.get(), 900);
+ *     lv_obj_add_style(title.get(), theme::label_primary(), LV_PART_MAIN);  // The text is drawn in its font and color
+ *     title.setText("Now Playing: ...");
+ *     title.tick(now);  // Every loop
+ */
+class Marquee {
+public:
+    static constexpr uint32_t FRAME_MS = 16;    // Scroll step, ~60 fps
+    static constexpr uint32_t HOLD_MS  = 2000;  // Still at the start of each pass
+    static constexpr int SPEED         = 40;    // Pixels per second
+    static constexpr int GAP           = 80;    // Pixels between the end and the start coming round again
+
+    Marquee(lv_obj_t* parent);
+    ~Marquee();
+
+    lv_obj_t* get()
+    {
+        return _container->get();
+    }
+
+    void setText(const char* text);
+
+    // Render again after changing the strip's font or text color
+    void refresh();
+
+    /**
+     * @brief Scroll on, cheap to call every loop: nothing is invalidated until the text moves a whole pixel
+     */
+    void tick(uint32_t now);
+
+    /**
+     * @brief Longer than the strip, `tick()` moves it
+     */
+    bool scrolling() const
+    {
+        return _scrolling;
+    }
+
+private:
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _container;
+    lv_obj_t* _label;                // Holds the text and is rendered from, drawn only without a mask
+    lv_draw_buf_t* _mask = nullptr;  // A8, the rendered text
+
+    bool _scrolling     = false;
+    int32_t _offset     = 0;  // Pixels the text is moved left by
+    uint32_t _travel    = 0;  // This pass so far, in 1/1000 pixels
+    uint32_t _held      = 0;  // Ms held still at the start of this pass
+    uint32_t _last_tick = 0;
+
+    void restart();
+    static void draw_event_cb(lv_event_t* e);
+    void draw(lv_layer_t* layer);
+};
+
+}  // namespace radio_view
@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "perf_hud.h"
+#include "radio_view.h"
+#include "ui_setters.h"
+#include <cstdio>
+#include <string>
+
+using namespace radio_view;
+using namespace smooth_ui_toolkit::lvgl_cpp;
+
+PerfHud::PerfHud()
+{
+    _panel = std::make_unique<Container>(lv_layer_top());
+    _panel->align(LV_ALIGN_TOP_LEFT, 10, 10);
+    _panel->setBgColor(lv_color_hex(colors::BG_PRIMARY));
+    _panel->setBorderWidth(0);
+    _panel->setRadius(8);
+    lv_obj_set_size(_panel->get(), LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(_panel->get(), LV_OPA_80, 0);
+    lv_obj_set_style_pad_all(_panel->get(), 10, 0);
+    lv_obj_clear_flag(_panel->get(), LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_clear_flag(_panel->get(), LV_OBJ_FLAG_SCROLLABLE);
+
+    _label = lv_label_create(_panel->get());
+    lv_obj_set_style_text_color(_label, lv_color_hex(colors::TEXT_PRIMARY), 0);
+    lv_obj_set_style_text_font(_label, &lv_font_montserrat_14, 0);
+    lv_label_set_text(_label, "Sampling...");
+
+    update();
+}
+
+void PerfHud::update()
+{
+    if (!GetHAL()->getPerfStats(&_stats)) {
+        set_text(_label, "No performance data on this platform");
+        return;
+    }
+    if (_stats.sampledAtMs == _shown_at) {
+        return;
+    }
+    _shown_at = _stats.sampledAtMs;
+
+    char text[1024];
+    int len = snprintf(text, sizeof(text),
+                       "%.1f fps   render %.1f ms   flush %.1f ms   redraw %.0f%% in %.1f areas\n"
+                       "Touch to frame %.1f ms (max %.1f ms)   I2C %.0f%% busy, touch waited %.1f ms max\n"
+                       "Buffer %s   underruns %lu\n"
+                       "Internal %u KB free (min %u KB)   PSRAM %u KB free\n"
+                       "WiFi %s   %.0f mA (avg %.0f mA awake, %.0f mA power save)",
+                       _stats.fps, _stats.renderMs, _stats.flushMs, _stats.redrawPercent, _stats.redrawAreas,
+                       _stats.touchLatencyMs, _stats.touchLatencyMaxMs, _stats.i2cBusyPercent,
+                       _stats.i2cTouchWaitMaxMs,
+                       _stats.bufferPercent < 0 ? "-" : (std::to_string(_stats.bufferPercent) + "%").c_str(),
+                       (unsigned long)_stats.underruns, (unsigned)(_stats.internalFree / 1024),
+                       (unsigned)(_stats.internalMin / 1024), (unsigned)(_stats.psramFree / 1024),
+                       _stats.wifiPowerSave ? "power save" : "awake", _stats.currentMa, _stats.currentAwakeMa,
+                       _stats.currentSavingMa);
+    // Peak use of the pools set aside at boot is what they have to be sized for
+    for (int pool = 0; pool < hal::HalBase::MEMORY_POOL_COUNT; pool++) {
+        hal::HalBase::MemoryPoolStats_t memory;
+        if (len < 0 || len >= (int)sizeof(text) ||
+            !GetHAL()->getMemoryPoolStats((hal::HalBase::MemoryPool_t)pool, &memory)) {
+            break;
+        }
+        len += snprintf(text + len, sizeof(text) - len, "\n%s pool %u / %u KB (peak %u KB), %lu from the heap",
+                        memory.name.c_str(), (unsigned)(memory.used / 1024), (unsigned)(memory.size / 1024),
+                        (unsigned)(memory.highWater / 1024), (unsigned long)memory.fallbacks);
+    }
+    // A site waiting long for the lock is held up by another, or by the LVGL task rendering
+    for (const auto& lock : _stats.lvglLocks) {
+        if (len < 0 || len >= (int)sizeof(text)) {
+            break;
+        }
+        len += snprintf(text + len, sizeof(text) - len,
+                        "\nLVGL lock %s: %.0f/s, %.1f%% held, wait %.1f ms, hold %.1f ms max", lock.site.c_str(),
+                        lock.holdsPerSecond, lock.heldPercent, lock.waitMaxMs, lock.holdMaxMs);
+    }
+    for (const auto& task : _stats.tasks) {
+        if (len < 0 || len >= (int)sizeof(text)) {
+            break;
+        }
+        char core[4] = "*";
+        if (task.core >= 0) {
+            snprintf(core, sizeof(core), "%d", task.core);
+        }
+        len += snprintf(text + len, sizeof(text) - len, "\n%5.1f%%  %s (core %s)", task.cpuPercent, task.name.c_str(),
+                        core);
+    }
+    set_text(_label, text);
+}
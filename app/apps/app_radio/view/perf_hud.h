@@ -0,0 +1,39 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <smooth_ui_toolkit.h>
+#include <smooth_lvgl.h>
+#include <hal/hal.h>
+#include <cstdint>
+#include <memory>
+
+namespace radio_view {
+
+/**
+ * @brief Performance overlay: frame rate, render and flush time, task load, stream buffer and heap
+ *
+ * Floats on LVGL's top layer and lets touches through. The HAL samples once a second, the text only changes when a
+ * new sample is in, so an open HUD costs one small redraw a second.
+ */
+class PerfHud {
+public:
+    PerfHud();
+    ~PerfHud() = default;
+
+    /**
+     * @brief Call every tick, does nothing until a new sample is in
+     */
+    void update();
+
+private:
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _panel;
+    lv_obj_t* _label = nullptr;
+    hal::HalBase::PerfStats_t _stats;
+    uint32_t _shown_at = 0;  // sampledAtMs of the sample on screen
+};
+
+}  // namespace radio_view
@@ -5,9 +5,24 @@
  */
 #include "radio_view.h"
 #include "wifi_config_dialog.h"
-#include "../stations.h"
+#include "keyboard.h"
+#include "spectrum_bars.h"
+#include "waveform_view.h"
+#include "card_cache.h"
+#include "text_image.h"
+#include "marquee.h"
+#include "perf_hud.h"
+#include "ui_setters.h"
+#include "theme.h"
+#include "../station_catalog.h"
+#include "../artwork_cache.h"
+#include "../settings_store.h"
+#include "../radio_session.h"
 #include <hal/hal.h>
 #include <mooncake_log.h>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
 
 using namespace radio_view;
 using namespace smooth_ui_toolkit;
@@ -15,20 +30,41 @@ using namespace smooth_ui_toolkit::lvgl_cpp;
 
 static const char* TAG = "radio_view";
 
+// Station grid geometry, columns and height follow the screen in init() so a card's place follows from its index
+static constexpr int GRID_TOP    = 260;  // Below the now playing card
+static constexpr int CARD_WIDTH  = 300;
+static constexpr int CARD_HEIGHT = 170;
+static constexpr int CARD_GAP_X  = 13;  // (1240 - 4 * 300) / 3
+static constexpr int CARD_GAP_Y  = 15;
+static constexpr int ROW_PITCH   = CARD_HEIGHT + CARD_GAP_Y;
+
+// One row of transport controls at the bottom, two in portrait where they don't fit side by side
+static constexpr int CONTROLS_HEIGHT = 90;
+
+// Track cover, top left of the now playing card, above the spectrum
+static constexpr int COVER_SIZE = 80;
+
 RadioView::RadioView()
 {
-    memset(_spectrum_data, 0, sizeof(_spectrum_data));
 }
 
 RadioView::~RadioView()
 {
-    // Stop playback on destruction
-    GetHAL()->stopRadioStream();
+    GetHAL()->resumeDisplay();
+    // The station plays on, the session has it
+    GetHAL()->unsubscribeEvents(_events);
+    GetHAL()->stopVoiceControl();
+    GetHAL()->stopPresenceDetection();
+    undim_display();
+    GetHAL()->setRadioWaveformColumns(0);
+    lv_anim_delete(this, beat_anim_cb);
+    radio::settings().flush();
 }
 
 void RadioView::init()
 {
     mclog::tagInfo(TAG, "Initializing radio view");
+    _init_at = GetHAL()->millis();
 
     // Get actual display size (after rotation)
     lv_display_t* disp = lv_display_get_default();
@@ -36,6 +72,14 @@ void RadioView::init()
     int32_t screen_height = lv_display_get_vertical_resolution(disp);
     mclog::tagInfo(TAG, "Screen size: {}x{}", screen_width, screen_height);
 
+    // Landscape, or the panel's native portrait orientation when it's left unrotated
+    _screen_width   = screen_width;
+    _screen_height  = screen_height;
+    _portrait       = screen_height > screen_width;
+    _grid_columns   = std::max((_screen_width - 40 + CARD_GAP_X) / (CARD_WIDTH + CARD_GAP_X), 1);
+    _grid_height    = controls_top() - 10 - GRID_TOP;
+    _cell_pool_size = (_grid_height / ROW_PITCH + 2) * _grid_columns;  // Rows partly in view included
+
     // Create root container (full screen)
     _root = std::make_unique<Container>(lv_screen_active());
     _root->setSize(screen_width, screen_height);
@@ -47,47 +91,103 @@ void RadioView::init()
     // Disable scrolling on root to prevent layout issues
     lv_obj_clear_flag(_root->get(), LV_OBJ_FLAG_SCROLLABLE);
 
+    // Saved settings first, the controls are built showing them
+    auto& settings = radio::settings();
+    settings.load();
+    if (settings.volume() >= 0) {
+        GetHAL()->setSpeakerVolume(settings.volume());
+    }
+
     // Build UI components
     create_wifi_status();
     create_now_playing_card();
     create_station_grid();
     create_transport_controls();
     create_wifi_settings_button();
+    _search.build(radio::catalog());
+    create_search();
 
-    // Initialize state
-    select_station(0);
+    // Initialize state, the session's station: the last one played, or what's playing since the view was closed
+    auto& session = radio::session();
+    session.load();
+    select_station(session.station());
+
+    prewarm_station_hosts();
+    publish_remote_stations();
+
+    // Labels are redrawn on change from here, the first event is a resync that fills them in
+    _events = GetHAL()->subscribeEvents();
+
+    // Playing from before the view, or a fast resume is connecting: show that instead of connecting again
+    if (session.playing()) {
+        show_playing(true);
+        return;
+    }
 
     // Try auto-connect to saved WiFi
     try_auto_connect();
 }
 
-void RadioView::update()
+uint32_t RadioView::update()
 {
     uint32_t now = GetHAL()->millis();
 
-    // Update at ~20Hz
-    if (now - _last_update < 50) {
-        return;
+    // Nothing is drawn with the display off, only what can turn it back on or has to go on regardless
+    if (GetHAL()->isDisplaySuspended()) {
+        radio::session().update();
+        handle_events();
+        update_alarm();
+        return SUSPENDED_UPDATE_MS;
+    }
+
+    // The visualizer and a long track title run at the display's pace while they move, the rest is fine at ~20Hz
+    update_spectrum(now);
+    _track_info->tick(now);
+    bool moving =
+        _radio_state == hal::HalBase::RADIO_PLAYING || !_spectrum_bars->settled() || _track_info->scrolling();
+
+    if (now - _last_update < UPDATE_MS) {
+        return moving ? 0 : UPDATE_MS - (now - _last_update);
     }
     _last_update = now;
 
-    update_wifi_status();
-    update_now_playing();
-    update_spectrum();
+    if (radio::catalog().update()) {
+        reload_stations();
+    }
+    radio::artwork().update();
+    for (auto& cell : _station_cells) {
+        update_station_art(cell);
+    }
+    update_cover();
+    radio::session().update();
+    update_session();
+    update_alarm();
+    update_screen_off();
+
+    handle_events();
+    update_warm_station();
+    update_record_button();
+    if (_perf_hud) {
+        _perf_hud->update();
+    }
 
     // Update WiFi dialog if open
-    if (_wifi_dialog) {
+    if (_wifi_dialog && !_wifi_dialog->isClosed()) {
         _wifi_dialog->update();
-        if (_wifi_dialog->isClosed()) {
-            _wifi_dialog.reset();
-        }
     }
+    update_prebuilt(now);
+    return moving ? 0 : UPDATE_MS;
 }
 
 /* -------------------------------------------------------------------------- */
 /*                              Create UI Components                          */
 /* -------------------------------------------------------------------------- */
 
+int RadioView::controls_top() const
+{
+    return _screen_height - (_portrait ? 2 : 1) * CONTROLS_HEIGHT;
+}
+
 void RadioView::create_wifi_status()
 {
     // WiFi status container (top right) - stored as class member to keep alive
@@ -108,8 +208,33 @@ void RadioView::create_wifi_status()
     _wifi_status_label = std::make_unique<Label>(_wifi_status_container->get());
     _wifi_status_label->align(LV_ALIGN_LEFT_MID, 18, 0);
     _wifi_status_label->setText("Disconnected");
-    _wifi_status_label->setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
-    _wifi_status_label->setTextFont(&lv_font_montserrat_14);
+    lv_obj_add_style(_wifi_status_label->get(), theme::label_secondary(), LV_PART_MAIN);
+
+    // Diagnostics for units in the field, no serial cable needed
+    _wifi_status_container->onClick().connect([this]() {
+        if (_long_pressed) {
+            _long_pressed = false;
+            return;
+        }
+        if (_perf_hud) {
+            _perf_hud.reset();
+        } else {
+            _perf_hud = std::make_unique<PerfHud>();
+        }
+    });
+
+    // Long press runs the self benchmark with the HUD up, the LVGL demo at its end keeps the screen until a restart
+    lv_obj_add_event_cb(_wifi_status_container->get(), [](lv_event_t* e) {
+        auto view           = (RadioView*)lv_event_get_user_data(e);
+        view->_long_pressed = true;
+        if (!view->_perf_hud) {
+            view->_perf_hud = std::make_unique<PerfHud>();
+        }
+        GetHAL()->runInBackground([]() {
+            hal::HalBase::SelfBenchmark_t result;
+            GetHAL()->runSelfBenchmark(&result);
+        });
+    }, LV_EVENT_LONG_PRESSED, this);
 }
 
 void RadioView::create_now_playing_card()
@@ -119,46 +244,51 @@ void RadioView::create_now_playing_card()
     //         Station grid (middle), Transport controls (bottom)
     _now_playing_card = std::make_unique<Container>(_root->get());
     _now_playing_card->align(LV_ALIGN_TOP_MID, 0, 50);
-    _now_playing_card->setSize(1000, 200);  // Wider, shorter
-    _now_playing_card->setBgColor(lv_color_hex(colors::BG_SECONDARY));
-    _now_playing_card->setRadius(16);
-    _now_playing_card->setBorderWidth(2);
-    _now_playing_card->setBorderColor(lv_color_hex(colors::BG_TERTIARY));
+    _now_playing_card->setSize(std::min(1000, _screen_width - 40), 200);  // Wider, shorter
+    lv_obj_add_style(_now_playing_card->get(), theme::card(), LV_PART_MAIN);
+    _now_playing_card->setRadius(BEAT_RIM);
+    lv_obj_add_event_cb(_now_playing_card->get(), card_draw_post_cb, LV_EVENT_DRAW_POST, this);
 
     // Station name (large)
     _station_name_label = std::make_unique<Label>(_now_playing_card->get());
     _station_name_label->align(LV_ALIGN_TOP_MID, 0, 20);
     _station_name_label->setText("Groove Salad");
-    _station_name_label->setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
+    lv_obj_add_style(_station_name_label->get(), theme::label_primary(), LV_PART_MAIN);
     _station_name_label->setTextFont(&lv_font_montserrat_32);
+    _station_name_text = std::make_unique<TextImage>(_station_name_label->get());
 
     // Station description
     _station_desc_label = std::make_unique<Label>(_now_playing_card->get());
     _station_desc_label->align(LV_ALIGN_TOP_MID, 0, 60);
     _station_desc_label->setText("Ambient/Downtempo");
-    _station_desc_label->setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
+    lv_obj_add_style(_station_desc_label->get(), theme::label_secondary(), LV_PART_MAIN);
     _station_desc_label->setTextFont(&lv_font_montserrat_16);
+    _station_desc_text = std::make_unique<TextImage>(_station_desc_label->get());
 
     // Spectrum visualizer - make it more compact
-    _spectrum_chart = std::make_unique<Chart>(_now_playing_card->get());
-    _spectrum_chart->align(LV_ALIGN_BOTTOM_MID, 0, -45);
-    _spectrum_chart->setSize(900, 50);  // Shorter height
-    _spectrum_chart->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _spectrum_chart->setRadius(6);
-    _spectrum_chart->setBorderWidth(0);
-    _spectrum_chart->setStyleSize(0, 0, LV_PART_INDICATOR);
-    _spectrum_chart->setPointCount(32);
-    _spectrum_chart->setRange(LV_CHART_AXIS_PRIMARY_Y, 0, 255);
-    _spectrum_chart->setUpdateMode(LV_CHART_UPDATE_MODE_CIRCULAR);
-    _spectrum_chart->setDivLineCount(0, 0);
-    _spectrum_chart->addSeries(lv_color_hex(colors::ACCENT_GLOW), LV_CHART_AXIS_PRIMARY_Y);
-
-    // Track info
-    _track_info_label = std::make_unique<Label>(_now_playing_card->get());
-    _track_info_label->align(LV_ALIGN_BOTTOM_MID, 0, -15);
-    _track_info_label->setText("Press Play to start streaming");
-    _track_info_label->setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
-    _track_info_label->setTextFont(&lv_font_montserrat_14);
+    _spectrum_bars = std::make_unique<SpectrumBars>(_now_playing_card->get());
+    lv_obj_align(_spectrum_bars->get(), LV_ALIGN_BOTTOM_MID, 0, -45);
+    lv_obj_set_size(_spectrum_bars->get(), std::min(1000, _screen_width - 40) - 100, 50);  // Shorter height
+    _spectrum_bars->setOnClick([this]() {
+        set_spectrum_bands(_spectrum_bands >= hal::HalBase::RadioSpectrum_t::MAX_BANDS ? 0 : _spectrum_bands * 2);
+    });
+    _waveform = std::make_unique<WaveformView>(_now_playing_card->get());
+    lv_obj_align(_waveform->get(), LV_ALIGN_BOTTOM_MID, 0, -45);
+    lv_obj_set_size(_waveform->get(), std::min(1000, _screen_width - 40) - 100, 50);
+    lv_obj_add_flag(_waveform->get(), LV_OBJ_FLAG_HIDDEN);
+    _waveform->setOnClick([this]() { set_spectrum_bands(32); });
+
+    // The full-width landscape screen has room for finer bars
+    bool wideScreen = lv_display_get_horizontal_resolution(lv_display_get_default()) >= 1280;
+    set_spectrum_bands(wideScreen ? 64 : 32);
+
+    // Track info, as wide as the visualizer. ICY titles longer than that scroll
+    _track_info = std::make_unique<Marquee>(_now_playing_card->get());
+    lv_obj_set_width(_track_info->get(), std::min(1000, _screen_width - 40) - 100);
+    lv_obj_align(_track_info->get(), LV_ALIGN_BOTTOM_MID, 0, -15);
+    lv_obj_add_style(_track_info->get(), theme::label_primary(), LV_PART_MAIN);
+    lv_obj_set_style_text_font(_track_info->get(), &lv_font_montserrat_14, LV_PART_MAIN);
+    _track_info->setText("Press Play to start streaming");
 
     // Status label (buffering/playing)
     _status_label = std::make_unique<Label>(_now_playing_card->get());
@@ -176,143 +306,437 @@ void RadioView::create_now_playing_card()
     _buffering_spinner->setArcColor(lv_color_hex(colors::ACCENT), LV_PART_INDICATOR);
     _buffering_spinner->setAnimParams(1000, 200);
     _buffering_spinner->setHidden(true);
+
+    // Track cover, tap to turn the lookup on or off. The thumbnail is scaled up, the cache keeps one size
+    _cover = std::make_unique<Container>(_now_playing_card->get());
+    _cover->align(LV_ALIGN_TOP_LEFT, 20, 15);
+    _cover->setSize(COVER_SIZE, COVER_SIZE);
+    _cover->setBgColor(lv_color_hex(colors::BG_TERTIARY));
+    _cover->setRadius(8);
+    _cover->setBorderWidth(0);
+    _cover->setPadding(0, 0, 0, 0);
+    _cover->setScrollbarMode(LV_SCROLLBAR_MODE_OFF);
+    _cover->onClick().connect([this]() { toggle_track_art(); });
+
+    _cover_image = lv_image_create(_cover->get());
+    lv_obj_center(_cover_image);
+    lv_image_set_scale(_cover_image, LV_SCALE_NONE * COVER_SIZE / radio::ArtworkCache::SIZE);
+    lv_obj_add_flag(_cover_image, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_clear_flag(_cover_image, LV_OBJ_FLAG_CLICKABLE);
+
+    _cover_label = lv_label_create(_cover->get());
+    lv_obj_center(_cover_label);
+    lv_label_set_text(_cover_label, LV_SYMBOL_IMAGE);
+    lv_obj_set_style_text_font(_cover_label, &lv_font_montserrat_24, 0);
+    update_cover_label();
 }
 
 void RadioView::create_station_grid()
 {
-    // Station grid container - 4x2 grid of station cards
-    // Screen is 1280x720. Now playing card ends at y=250, transport starts at y=630
+    // Station grid container - 4 columns of station cards, two rows visible on the 1280x720 landscape screen
+    // Now playing card ends at y=250, transport starts at y=630
     // Available space for stations: y=260 to y=620 = 360px
-    _station_grid = std::make_unique<Container>(_root->get());
-    _station_grid->setPos(20, 260);
-    _station_grid->setSize(1240, 360);  // Height for 2 rows of 170px cards + gaps
-    _station_grid->setBgColor(lv_color_hex(colors::BG_PRIMARY));
-    _station_grid->setBorderWidth(0);
+    int grid_width = _grid_columns * (CARD_WIDTH + CARD_GAP_X) - CARD_GAP_X;
+    _station_grid  = std::make_unique<Container>(_root->get());
+    _station_grid->setPos((_screen_width - grid_width) / 2, GRID_TOP);
+    _station_grid->setSize(grid_width, _grid_height);  // Height for 2 rows of 170px cards + gaps
+    lv_obj_add_style(_station_grid->get(), theme::panel(), LV_PART_MAIN);
     _station_grid->setScrollbarMode(LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_layout(_station_grid->get(), LV_LAYOUT_FLEX);
-    lv_obj_set_flex_flow(_station_grid->get(), LV_FLEX_FLOW_ROW_WRAP);  // Wrap to multiple rows
-    lv_obj_set_flex_align(_station_grid->get(), LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
-    lv_obj_set_style_pad_gap(_station_grid->get(), 10, 0);
-    lv_obj_set_style_pad_row(_station_grid->get(), 15, 0);
     lv_obj_set_style_pad_all(_station_grid->get(), 0, 0);  // No internal padding
-    lv_obj_clear_flag(_station_grid->get(), LV_OBJ_FLAG_SCROLLABLE);
+    // The rest of the catalog scrolls up
+    lv_obj_set_scroll_dir(_station_grid->get(), LV_DIR_VER);
+
+    // An invisible pixel below the last row gives the grid the whole catalog's scroll range
+    _station_grid_end = lv_obj_create(_station_grid->get());
+    lv_obj_remove_style_all(_station_grid_end);
+    lv_obj_set_size(_station_grid_end, 1, 1);
+    lv_obj_clear_flag(_station_grid_end, LV_OBJ_FLAG_CLICKABLE);
+
+    _card_cache = std::make_unique<CardCache>(_station_grid->get(), lv_color_hex(colors::BG_PRIMARY));
+    create_station_cells();
+
+    lv_obj_add_event_cb(_station_grid->get(), [](lv_event_t* e) {
+        auto view = (RadioView*)lv_event_get_user_data(e);
+        view->bind_station_cells();
+    }, LV_EVENT_SCROLL, this);
+
+    // Drags and flings move card snapshots, the live cards are back once it has settled
+    lv_obj_add_event_cb(_station_grid->get(), [](lv_event_t* e) {
+        auto view = (RadioView*)lv_event_get_user_data(e);
+        view->_card_cache->begin();
+    }, LV_EVENT_SCROLL_BEGIN, this);
+    lv_obj_add_event_cb(_station_grid->get(), [](lv_event_t* e) {
+        auto view = (RadioView*)lv_event_get_user_data(e);
+        view->_card_cache->end();
+    }, LV_EVENT_SCROLL_END, this);
+
+    update_station_grid();
+}
 
-    // Create station cards - 4 stations per row, 2 rows = 8 total
-    // Grid is 1240px wide: (1240 - 30 gaps) / 4 = ~302px per card, use 300px
+void RadioView::create_station_cells()
+{
+    // Only the rows that can be on screen at once get cards, scrolling rebinds the row that went out of view
+    // to the one coming in. 4 stations per row
+    // Grid is 1240px wide: (1240 - 3 gaps) / 4 = ~302px per card, use 300px
     // Grid is 360px tall: 2 rows * 170px + 15px gap = 355px
-    for (int i = 0; i < radio::STATION_COUNT; i++) {
-        auto card = std::make_unique<Container>(_station_grid->get());
-        card->setSize(300, 170);  // Slightly taller for better spacing
-        card->setBgColor(lv_color_hex(colors::BG_SECONDARY));
-        card->setRadius(12);
-        card->setBorderWidth(2);
-        card->setBorderColor(lv_color_hex(colors::BG_TERTIARY));
+    for (int i = 0; i < _cell_pool_size; i++) {
+        StationCell_t cell;
+        cell.card = std::make_unique<Container>(_station_grid->get());
+        cell.card->setSize(CARD_WIDTH, CARD_HEIGHT);  // Slightly taller for better spacing
+        lv_obj_add_style(cell.card->get(), theme::card(), LV_PART_MAIN);
+        lv_obj_add_style(cell.card->get(), theme::card_selected(), LV_STATE_CHECKED);
+        cell.card->setHidden(true);
         // Disable scrolling on individual cards
-        lv_obj_clear_flag(card->get(), LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_clear_flag(cell.card->get(), LV_OBJ_FLAG_SCROLLABLE);
+        cell.cacheSlot = _card_cache->add(cell.card->get());
 
         // Station name label (at top with padding)
-        auto name_label = lv_label_create(card->get());
-        lv_label_set_text(name_label, radio::STATIONS[i].name);
-        lv_obj_set_style_text_color(name_label, lv_color_hex(colors::TEXT_PRIMARY), 0);
-        lv_obj_set_style_text_font(name_label, &lv_font_montserrat_18, 0);
-        lv_obj_align(name_label, LV_ALIGN_TOP_MID, 0, 25);
-        lv_label_set_long_mode(name_label, LV_LABEL_LONG_DOT);
-        lv_obj_set_width(name_label, 270);
-        lv_obj_set_style_text_align(name_label, LV_TEXT_ALIGN_CENTER, 0);
+        lv_obj_t* nameLabel = lv_label_create(cell.card->get());
+        lv_obj_add_style(nameLabel, theme::card_name(), LV_PART_MAIN);
+        lv_obj_align(nameLabel, LV_ALIGN_TOP_MID, 0, 25);
+        lv_label_set_long_mode(nameLabel, LV_LABEL_LONG_DOT);
+        lv_obj_set_width(nameLabel, 270);
+        cell.nameText = std::make_unique<TextImage>(nameLabel);
 
         // Station description label (below name with spacing)
-        auto desc_label = lv_label_create(card->get());
-        lv_label_set_text(desc_label, radio::STATIONS[i].description);
-        lv_obj_set_style_text_color(desc_label, lv_color_hex(colors::TEXT_SECONDARY), 0);
-        lv_obj_set_style_text_font(desc_label, &lv_font_montserrat_14, 0);
-        lv_obj_align(desc_label, LV_ALIGN_TOP_MID, 0, 60);  // Below name with 35px gap
-        lv_label_set_long_mode(desc_label, LV_LABEL_LONG_WRAP);  // Wrap to multiple lines if needed
-        lv_obj_set_width(desc_label, 270);
-        lv_obj_set_style_text_align(desc_label, LV_TEXT_ALIGN_CENTER, 0);
-
-        // Click handler
-        int station_idx = i;
-        card->onClick().connect([this, station_idx]() {
-            select_station(station_idx);
+        lv_obj_t* descLabel = lv_label_create(cell.card->get());
+        lv_obj_add_style(descLabel, theme::card_desc(), LV_PART_MAIN);
+        lv_obj_align(descLabel, LV_ALIGN_TOP_MID, 0, 60);       // Below name with 35px gap
+        lv_label_set_long_mode(descLabel, LV_LABEL_LONG_WRAP);  // Wrap to multiple lines if needed
+        lv_obj_set_width(descLabel, 270);
+        cell.descText = std::make_unique<TextImage>(descLabel);
+
+        // Station logo (bottom right), shown once the artwork cache has it
+        cell.artImage = lv_image_create(cell.card->get());
+        lv_obj_set_size(cell.artImage, radio::ArtworkCache::SIZE, radio::ArtworkCache::SIZE);
+        lv_obj_align(cell.artImage, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
+        lv_obj_add_flag(cell.artImage, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(cell.artImage, LV_OBJ_FLAG_CLICKABLE);
+
+        // Favorite marker (top right)
+        cell.favMark = lv_obj_create(cell.card->get());
+        lv_obj_set_size(cell.favMark, 12, 12);
+        lv_obj_align(cell.favMark, LV_ALIGN_TOP_RIGHT, 0, 0);
+        lv_obj_add_style(cell.favMark, theme::marker(), LV_PART_MAIN);
+        lv_obj_add_flag(cell.favMark, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(cell.favMark, LV_OBJ_FLAG_CLICKABLE);
+
+        // Long press toggles the favorite, the click that follows its release is swallowed
+        lv_obj_add_event_cb(cell.card->get(), [](lv_event_t* e) {
+            auto view = (RadioView*)lv_event_get_user_data(e);
+            for (auto& c : view->_station_cells) {
+                if (c.card->get() == lv_event_get_current_target(e) && c.station >= 0) {
+                    view->toggle_favorite(c.station);
+                    view->_long_pressed = true;
+                }
+            }
+        }, LV_EVENT_LONG_PRESSED, this);
+
+        // Click handler, plays whatever the cell shows right now
+        cell.card->onClick().connect([this, i]() {
+            int station = _station_cells[i].station;
+            if (station < 0 || _long_pressed) {
+                _long_pressed = false;
+                return;
+            }
+            select_station(station);
             if (_is_playing) {
                 play_selected_station();
             }
         });
 
-        _station_cards.push_back(std::move(card));
+        _station_cells.push_back(std::move(cell));
+    }
+}
+
+void RadioView::update_station_grid()
+{
+    // The catalog or the search results changed: new scroll range, every cell rebound
+    int rows = (grid_count() + _grid_columns - 1) / _grid_columns;
+    lv_obj_set_pos(_station_grid_end, 0, std::max(rows * ROW_PITCH - CARD_GAP_Y, _grid_height) - 1);
+    lv_obj_update_layout(_station_grid->get());
+    lv_obj_readjust_scroll(_station_grid->get(), LV_ANIM_OFF);
+
+    for (auto& cell : _station_cells) {
+        cell.station  = -1;
+        cell.position = -1;
+    }
+    bind_station_cells();
+}
+
+void RadioView::bind_station_cells()
+{
+    // Position i always lands in cell i % _cell_pool_size, so a scroll by one row rebinds just that row's cells
+    int first = std::max((int)lv_obj_get_scroll_y(_station_grid->get()), 0) / ROW_PITCH * _grid_columns;
+    for (int position = first; position < first + _cell_pool_size; position++) {
+        auto& cell = _station_cells[position % _cell_pool_size];
+        if (cell.position != position) {
+            bind_station_cell(cell, position);
+        }
+    }
+}
+
+void RadioView::bind_station_cell(StationCell_t& cell, int position)
+{
+    const auto& catalog = radio::catalog();
+    if (position >= grid_count()) {
+        cell.station  = -1;
+        cell.position = -1;
+        set_hidden(cell.card->get(), true);
+        _card_cache->invalidate(cell.cacheSlot);
+        return;
+    }
+
+    int station   = grid_station(position);
+    cell.station  = station;
+    cell.position = position;
+    cell.card->setPos((position % _grid_columns) * (CARD_WIDTH + CARD_GAP_X), (position / _grid_columns) * ROW_PITCH);
+    cell.nameText->setText(catalog.at(station).name);
+    cell.descText->setText(catalog.at(station).description);
+    style_station_cell(cell);
+    update_station_art(cell);
+    set_hidden(cell.card->get(), false);
+    _card_cache->invalidate(cell.cacheSlot);
+}
+
+void RadioView::update_station_art(StationCell_t& cell)
+{
+    // Asked every tick so the thumbnails on screen stay the most recently used, a pointer compare otherwise
+    const lv_image_dsc_t* art = cell.station >= 0 ? radio::artwork().get(radio::catalog().at(cell.station)) : nullptr;
+    if (art == cell.art) {
+        return;
+    }
+    cell.art = art;
+    if (art) {
+        lv_image_set_src(cell.artImage, art);
+        set_hidden(cell.artImage, false);
+    } else {
+        set_hidden(cell.artImage, true);
+    }
+    _card_cache->invalidate(cell.cacheSlot);
+}
+
+void RadioView::update_cover()
+{
+    // Asked every tick while shown, like the station logos, so the cache keeps it
+    const lv_image_dsc_t* art = radio::settings().trackArt() ? radio::artwork().getTrack(_track_title) : nullptr;
+    if (art == _cover_art) {
+        return;
+    }
+    _cover_art = art;
+    if (art) {
+        lv_image_set_src(_cover_image, art);
+        set_hidden(_cover_image, false);
+        set_hidden(_cover_label, true);
+    } else {
+        set_hidden(_cover_image, true);
+        set_hidden(_cover_label, false);
+    }
+}
+
+void RadioView::update_cover_label()
+{
+    bool enabled = radio::settings().trackArt();
+    set_text_color(_cover_label, lv_color_hex(enabled ? colors::ACCENT_GLOW : colors::TEXT_SECONDARY), 0);
+}
+
+void RadioView::toggle_track_art()
+{
+    auto& settings = radio::settings();
+    settings.setTrackArt(!settings.trackArt());
+    update_cover_label();
+}
+
+void RadioView::scroll_to_station(int index)
+{
+    int position = index;
+    if (_filtered) {
+        auto it = std::find(_grid_stations.begin(), _grid_stations.end(), index);
+        if (it == _grid_stations.end()) {
+            return;  // Not among the results
+        }
+        position = it - _grid_stations.begin();
+    }
+    int top    = (position / _grid_columns) * ROW_PITCH;
+    int scroll = lv_obj_get_scroll_y(_station_grid->get());
+    if (top < scroll) {
+        lv_obj_scroll_to_y(_station_grid->get(), top, LV_ANIM_ON);
+    } else if (top + CARD_HEIGHT > scroll + _grid_height) {
+        lv_obj_scroll_to_y(_station_grid->get(), top + CARD_HEIGHT - _grid_height, LV_ANIM_ON);
+    }
+}
+
+int RadioView::grid_count() const
+{
+    return _filtered ? (int)_grid_stations.size() : radio::catalog().count();
+}
+
+int RadioView::grid_station(int position) const
+{
+    return _filtered ? _grid_stations[position] : position;
+}
+
+void RadioView::create_search()
+{
+    // Top left, above the now playing card. The field is shown while searching, each keystroke refilters the grid
+    _btn_search = std::make_unique<Button>(_root->get());
+    _btn_search->setPos(20, 9);
+    _btn_search->setSize(110, 34);
+    lv_obj_add_style(_btn_search->get(), theme::button(), LV_PART_MAIN);
+    _btn_search->label().setText(LV_SYMBOL_KEYBOARD " Search");
+    _btn_search->onClick().connect([this]() {
+        if (_searching) {
+            close_search();
+        } else {
+            open_search();
+        }
+    });
+
+    // Left of the WiFi status
+    _search_field = lv_textarea_create(_root->get());
+    lv_obj_set_pos(_search_field, 140, 7);
+    lv_obj_set_size(_search_field, std::max(_screen_width - 380, 200), 38);
+    lv_textarea_set_one_line(_search_field, true);
+    lv_textarea_set_placeholder_text(_search_field, "Station, genre...");
+    lv_obj_add_style(_search_field, theme::field(), LV_PART_MAIN);
+    lv_obj_add_style(_search_field, theme::field_focused(), LV_STATE_FOCUSED);
+    lv_obj_set_style_pad_ver(_search_field, 8, 0);
+    lv_obj_add_flag(_search_field, LV_OBJ_FLAG_HIDDEN);
+
+    lv_obj_add_event_cb(_search_field, [](lv_event_t* e) {
+        auto view = (RadioView*)lv_event_get_user_data(e);
+        view->update_search();
+    }, LV_EVENT_VALUE_CHANGED, this);
+
+    // The keyboard was put away to see all the results, a tap on the field brings it back
+    lv_obj_add_event_cb(_search_field, [](lv_event_t* e) {
+        auto view = (RadioView*)lv_event_get_user_data(e);
+        if (view->_search_keyboard) {
+            view->_search_keyboard->show();
+        }
+    }, LV_EVENT_CLICKED, this);
+}
+
+void RadioView::open_search()
+{
+    if (!_search_keyboard) {
+        _search_keyboard = std::make_unique<Keyboard>(_root->get());
+        _search_keyboard->setTarget(_search_field);
+    }
+    _searching = true;
+    set_hidden(_search_field, false);
+    _btn_search->label().setText(LV_SYMBOL_CLOSE " Close");
+    _search_keyboard->show();
+}
+
+void RadioView::close_search()
+{
+    _searching = false;
+    _search_keyboard->hide();
+    set_hidden(_search_field, true);
+    _btn_search->label().setText(LV_SYMBOL_KEYBOARD " Search");
+    lv_textarea_set_text(_search_field, "");  // The whole catalog is back
+    scroll_to_station(_selected_station);
+}
+
+void RadioView::update_search()
+{
+    // The search narrows the last result down as the query grows, only the cells in view are rebound
+    const auto& results = _search.find(lv_textarea_get_text(_search_field));
+    bool filtered       = !_search.query().empty();
+    if (filtered == _filtered && (!filtered || results == _grid_stations)) {
+        return;
     }
+    _filtered      = filtered;
+    _grid_stations = results;
+    lv_obj_scroll_to_y(_station_grid->get(), 0, LV_ANIM_OFF);
+    update_station_grid();
 }
 
 void RadioView::create_transport_controls()
 {
     // Transport container - stored as class member to keep alive
-    // Position at bottom of screen (720 - 70 = 650)
+    // Position at bottom of screen (720 - 90 = 630), in portrait on a row of its own above the buttons
     _transport_container = std::make_unique<Container>(_root->get());
-    _transport_container->setPos(80, 630);  // Use absolute position
+    _transport_container->setPos(_portrait ? 20 : 80, controls_top());  // Use absolute position
     _transport_container->setSize(400, 60);
-    _transport_container->setBgColor(lv_color_hex(colors::BG_PRIMARY));
-    _transport_container->setBorderWidth(0);
+    lv_obj_add_style(_transport_container->get(), theme::panel(), LV_PART_MAIN);
     lv_obj_clear_flag(_transport_container->get(), LV_OBJ_FLAG_SCROLLABLE);
 
     // Previous button
     _btn_prev = std::make_unique<Button>(_transport_container->get());
     _btn_prev->align(LV_ALIGN_LEFT_MID, 0, 0);
     _btn_prev->setSize(60, 50);
-    _btn_prev->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _btn_prev->setRadius(12);
-    _btn_prev->setBorderWidth(0);
-    _btn_prev->setShadowWidth(0);
+    lv_obj_add_style(_btn_prev->get(), theme::transport_button(), LV_PART_MAIN);
     _btn_prev->label().setText(LV_SYMBOL_PREV);
-    _btn_prev->label().setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
-    _btn_prev->label().setTextFont(&lv_font_montserrat_20);
     _btn_prev->onClick().connect([this]() { prev_station(); });
 
     // Play/Pause button
     _btn_play = std::make_unique<Button>(_transport_container->get());
     _btn_play->align(LV_ALIGN_CENTER, 0, 0);
     _btn_play->setSize(100, 50);
+    lv_obj_add_style(_btn_play->get(), theme::transport_button(), LV_PART_MAIN);
     _btn_play->setBgColor(lv_color_hex(colors::ACCENT));
-    _btn_play->setRadius(12);
-    _btn_play->setBorderWidth(0);
-    _btn_play->setShadowWidth(0);
     _btn_play->label().setText(LV_SYMBOL_PLAY " PLAY");
-    _btn_play->label().setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
     _btn_play->label().setTextFont(&lv_font_montserrat_16);
     _btn_play->onClick().connect([this]() { toggle_playback(); });
 
-    // Next button
+    // Next button, long press to scan: a few seconds of each station until Keep is tapped
     _btn_next = std::make_unique<Button>(_transport_container->get());
     _btn_next->align(LV_ALIGN_RIGHT_MID, 0, 0);
     _btn_next->setSize(60, 50);
-    _btn_next->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _btn_next->setRadius(12);
-    _btn_next->setBorderWidth(0);
-    _btn_next->setShadowWidth(0);
+    lv_obj_add_style(_btn_next->get(), theme::transport_button(), LV_PART_MAIN);
     _btn_next->label().setText(LV_SYMBOL_NEXT);
-    _btn_next->label().setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
-    _btn_next->label().setTextFont(&lv_font_montserrat_20);
-    _btn_next->onClick().connect([this]() { next_station(); });
+    _btn_next->onClick().connect([this]() {
+        if (_long_pressed) {
+            _long_pressed = false;
+            return;
+        }
+        next_station();
+    });
+    lv_obj_add_event_cb(_btn_next->get(), [](lv_event_t* e) {
+        auto view           = (RadioView*)lv_event_get_user_data(e);
+        view->_long_pressed = true;
+        view->start_scan();
+    }, LV_EVENT_LONG_PRESSED, this);
+
+    // Time-shift: skip back into the buffered history
+    _btn_back = std::make_unique<Button>(_transport_container->get());
+    _btn_back->align(LV_ALIGN_LEFT_MID, 70, 0);
+    _btn_back->setSize(60, 50);
+    lv_obj_add_style(_btn_back->get(), theme::transport_button(), LV_PART_MAIN);
+    _btn_back->label().setText("-30s");
+    _btn_back->label().setTextFont(&lv_font_montserrat_16);
+    _btn_back->onClick().connect([]() { GetHAL()->skipRadioStream(-30); });
+
+    // Time-shift: pause keeps buffering, resume continues where it stopped
+    _btn_pause = std::make_unique<Button>(_transport_container->get());
+    _btn_pause->align(LV_ALIGN_RIGHT_MID, -70, 0);
+    _btn_pause->setSize(60, 50);
+    lv_obj_add_style(_btn_pause->get(), theme::transport_button(), LV_PART_MAIN);
+    _btn_pause->label().setText(LV_SYMBOL_PAUSE);
+    _btn_pause->onClick().connect([this]() { toggle_pause(); });
 
     // Volume slider container - stored as class member to keep alive
-    // Position to the right of transport controls (at y=640)
+    // Position to the right of transport controls (at y=640), narrower in portrait to fit beside them
+    int volume_width  = _portrait ? 280 : 350;
     _volume_container = std::make_unique<Container>(_root->get());
-    _volume_container->setPos(520, 640);  // Use absolute position
-    _volume_container->setSize(350, 50);
-    _volume_container->setBgColor(lv_color_hex(colors::BG_PRIMARY));
-    _volume_container->setBorderWidth(0);
+    _volume_container->setPos(_portrait ? _screen_width - volume_width - 20 : 520, controls_top() + 10);
+    _volume_container->setSize(volume_width, 50);
+    lv_obj_add_style(_volume_container->get(), theme::panel(), LV_PART_MAIN);
     lv_obj_clear_flag(_volume_container->get(), LV_OBJ_FLAG_SCROLLABLE);
 
     // Volume icon
     _volume_label = std::make_unique<Label>(_volume_container->get());
     _volume_label->align(LV_ALIGN_LEFT_MID, 0, 0);
     _volume_label->setText(LV_SYMBOL_VOLUME_MAX);
-    _volume_label->setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
+    lv_obj_add_style(_volume_label->get(), theme::label_secondary(), LV_PART_MAIN);
     _volume_label->setTextFont(&lv_font_montserrat_18);
 
     // Volume slider
     _volume_slider = std::make_unique<Slider>(_volume_container->get());
     _volume_slider->align(LV_ALIGN_RIGHT_MID, 0, 0);
-    _volume_slider->setSize(220, 10);
+    _volume_slider->setSize(volume_width - 130, 10);
     _volume_slider->setRange(0, 100);
     _volume_slider->setValue(GetHAL()->getSpeakerVolume());
     lv_obj_set_style_bg_color(_volume_slider->get(), lv_color_hex(colors::BG_TERTIARY), LV_PART_MAIN);
@@ -323,121 +747,403 @@ void RadioView::create_transport_controls()
     // Volume change callback using native LVGL event
     lv_obj_add_event_cb(_volume_slider->get(), [](lv_event_t* e) {
         lv_obj_t* target = (lv_obj_t*)lv_event_get_target(e);
-        int vol = lv_slider_get_value(target);
-        GetHAL()->setSpeakerVolume(vol);
+        radio::session().setVolume(lv_slider_get_value(target));
     }, LV_EVENT_VALUE_CHANGED, this);
 }
 
 void RadioView::create_wifi_settings_button()
 {
     _btn_wifi_settings = std::make_unique<Button>(_root->get());
-    _btn_wifi_settings->setPos(1130, 650);  // Bottom right, use absolute position
+    _btn_wifi_settings->setPos(_screen_width - 150, _screen_height - 70);  // Bottom right, use absolute position
     _btn_wifi_settings->setSize(130, 40);
-    _btn_wifi_settings->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _btn_wifi_settings->setRadius(8);
-    _btn_wifi_settings->setBorderWidth(0);
-    _btn_wifi_settings->setShadowWidth(0);
+    lv_obj_add_style(_btn_wifi_settings->get(), theme::button(), LV_PART_MAIN);
     _btn_wifi_settings->label().setText(LV_SYMBOL_SETTINGS " WiFi");
-    _btn_wifi_settings->label().setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
-    _btn_wifi_settings->label().setTextFont(&lv_font_montserrat_14);
     _btn_wifi_settings->onClick().connect([this]() { show_wifi_config(); });
+
+    // Record to SD card, left of the WiFi button. Tap to record from now on, long press to save what was just played
+    _btn_record = std::make_unique<Button>(_root->get());
+    _btn_record->setPos(_screen_width - 290, _screen_height - 70);
+    _btn_record->setSize(130, 40);
+    lv_obj_add_style(_btn_record->get(), theme::button(), LV_PART_MAIN);
+    _btn_record->label().setText(LV_SYMBOL_SD_CARD " Record");
+    _btn_record->onClick().connect([this]() {
+        if (_long_pressed) {
+            _long_pressed = false;
+            return;
+        }
+        toggle_recording();
+    });
+    lv_obj_add_event_cb(_btn_record->get(), [](lv_event_t* e) {
+        auto view           = (RadioView*)lv_event_get_user_data(e);
+        view->_long_pressed = true;
+        view->save_history();
+    }, LV_EVENT_LONG_PRESSED, this);
+
+    // Fast resume at boot, left of the record button
+    _btn_fast_resume = std::make_unique<Button>(_root->get());
+    _btn_fast_resume->setPos(_screen_width - 400, _screen_height - 70);
+    _btn_fast_resume->setSize(100, 40);
+    lv_obj_add_style(_btn_fast_resume->get(), theme::button(), LV_PART_MAIN);
+    _btn_fast_resume->label().setText(LV_SYMBOL_REFRESH " Resume");
+    _btn_fast_resume->onClick().connect([this]() { toggle_fast_resume(); });
+    update_fast_resume_button();
+
+    // Voice commands, left of fast resume. Tap to listen, long press to record the commands anew
+    _btn_voice = std::make_unique<Button>(_root->get());
+    _btn_voice->setPos(_screen_width - 510, _screen_height - 70);
+    _btn_voice->setSize(100, 40);
+    lv_obj_add_style(_btn_voice->get(), theme::button(), LV_PART_MAIN);
+    _btn_voice->onClick().connect([this]() {
+        if (_long_pressed) {
+            _long_pressed = false;
+            return;
+        }
+        toggle_voice_control();
+    });
+    lv_obj_add_event_cb(_btn_voice->get(), [](lv_event_t* e) {
+        auto view           = (RadioView*)lv_event_get_user_data(e);
+        view->_long_pressed = true;
+        view->train_voice_commands(0);
+    }, LV_EVENT_LONG_PRESSED, this);
+    update_voice_button();
+
+    // Radio alarm, left of voice. Tap to switch it on or off, long press to set the time or sleep until it
+    _btn_alarm = std::make_unique<Button>(_root->get());
+    _btn_alarm->setPos(_screen_width - 620, _screen_height - 70);
+    _btn_alarm->setSize(100, 40);
+    lv_obj_add_style(_btn_alarm->get(), theme::button(), LV_PART_MAIN);
+    _btn_alarm->onClick().connect([this]() {
+        if (_long_pressed) {
+            _long_pressed = false;
+            return;
+        }
+        toggle_alarm();
+    });
+    lv_obj_add_event_cb(_btn_alarm->get(), [](lv_event_t* e) {
+        auto view           = (RadioView*)lv_event_get_user_data(e);
+        view->_long_pressed = true;
+        view->show_alarm_panel();
+    }, LV_EVENT_LONG_PRESSED, this);
+    update_alarm_button();
+
+    // Presence wake, left of the alarm. Landscape only, there's no room left in the portrait row
+    _btn_presence = std::make_unique<Button>(_root->get());
+    _btn_presence->setPos(_screen_width - 730, _screen_height - 70);
+    _btn_presence->setSize(100, 40);
+    lv_obj_add_style(_btn_presence->get(), theme::button(), LV_PART_MAIN);
+    _btn_presence->label().setText(LV_SYMBOL_EYE_OPEN " Wake");
+    _btn_presence->onClick().connect([this]() { toggle_presence_wake(); });
+    set_hidden(_btn_presence->get(), _portrait);
+    if (radio::settings().presenceWake() && !GetHAL()->startPresenceDetection()) {
+        mclog::tagWarn(TAG, "Presence wake not started, no camera?");
+    }
+    update_presence_button();
 }
 
 /* -------------------------------------------------------------------------- */
 /*                              Update Methods                                */
 /* -------------------------------------------------------------------------- */
 
+void RadioView::handle_events()
+{
+    // A platform without events gets every label redrawn each tick, as if it had asked for a resync
+    hal::HalBase::Event_t event;
+    if (_events < 0) {
+        handle_event(event);
+    }
+    while (GetHAL()->pollEvent(_events, &event)) {
+        handle_event(event);
+    }
+
+    // How far behind live a pause is grows by itself, no event for that
+    if (_radio_state == hal::HalBase::RADIO_PAUSED && GetHAL()->millis() - _state_shown_at >= 1000) {
+        update_radio_state();
+    }
+}
+
+void RadioView::handle_event(const hal::HalBase::Event_t& event)
+{
+    switch (event.type) {
+        case hal::HalBase::EVENT_RADIO_STATE:
+            _radio_state = (hal::HalBase::RadioState_t)event.value;
+            if (_radio_state == hal::HalBase::RADIO_BUFFERING) {
+                _buffer_level = 0;  // Filling up from empty, the level events follow
+            }
+            update_radio_state();
+            update_track_info();
+            break;
+        case hal::HalBase::EVENT_RADIO_TITLE:
+            update_track_info();
+            break;
+        case hal::HalBase::EVENT_RADIO_BUFFER:
+            _buffer_level = event.value;
+            if (_radio_state == hal::HalBase::RADIO_BUFFERING) {
+                update_radio_state();
+            }
+            break;
+        case hal::HalBase::EVENT_WIFI_STATE:
+        case hal::HalBase::EVENT_WIFI_STEP:
+            update_wifi_status();
+            break;
+        case hal::HalBase::EVENT_WIFI_SCAN:
+            if (_wifi_dialog && !_wifi_dialog->isClosed()) {
+                _wifi_dialog->updateNetworks(event.value);
+            }
+            break;
+        case hal::HalBase::EVENT_SD_CARD:
+        case hal::HalBase::EVENT_MEDIA_INDEX:
+            break;  // Recording looks for the card when it starts
+        case hal::HalBase::EVENT_VOICE_COMMAND:
+            handle_voice_command(event.value);
+            break;
+        case hal::HalBase::EVENT_VOICE_TRAINED:
+            if (_voice_training == event.value) {
+                train_voice_commands(_voice_training + 1);
+            }
+            break;
+        case hal::HalBase::EVENT_CAMERA_STILL:
+            break;  // The camera panel's
+        case hal::HalBase::EVENT_I2C_SCAN:
+            break;  // The I2C scan panel's
+        case hal::HalBase::EVENT_KEY:
+            handle_key(event.value);
+            break;
+        case hal::HalBase::EVENT_REMOTE:
+            break;  // The session's, update_session() shows what it did
+        case hal::HalBase::EVENT_RADIO_BEAT:
+            pulse_beat();
+            break;
+        case hal::HalBase::EVENT_PRESENCE:
+            handle_presence(event.value != 0);
+            break;
+        case hal::HalBase::EVENT_HEADPHONE:
+            break;  // The output switches over by itself
+        default:
+            _radio_state  = GetHAL()->getRadioState();
+            _buffer_level = GetHAL()->getRadioMetadata().bufferPercent;
+            update_wifi_status();
+            update_radio_state();
+            update_track_info();
+            break;
+    }
+}
+
 void RadioView::update_wifi_status()
 {
     auto state = GetHAL()->getWifiState();
-    std::string ip = GetHAL()->getWifiIp();
+    auto ip    = GetHAL()->getWifiIp();
 
     switch (state) {
-        case hal::HalBase::WIFI_CONNECTED:
-            _wifi_status_dot->setBgColor(lv_color_hex(colors::SUCCESS));
-            _wifi_status_label->setText(("WiFi: " + ip).c_str());
+        case hal::HalBase::WIFI_CONNECTED: {
+            set_bg_color(_wifi_status_dot->get(), lv_color_hex(colors::SUCCESS));
+            char text[32];
+            snprintf(text, sizeof(text), "WiFi: %s", ip.c_str());
+            set_text(_wifi_status_label->get(), text);
             break;
+        }
         case hal::HalBase::WIFI_CONNECTING:
-            _wifi_status_dot->setBgColor(lv_color_hex(colors::WARNING));
-            _wifi_status_label->setText("Connecting...");
+            set_bg_color(_wifi_status_dot->get(), lv_color_hex(colors::WARNING));
+            set_text(_wifi_status_label->get(), wifi_step_text(GetHAL()->getWifiStep()));
             break;
         case hal::HalBase::WIFI_FAILED:
-            _wifi_status_dot->setBgColor(lv_color_hex(colors::ERROR_COLOR));
-            _wifi_status_label->setText("Connection Failed");
+            set_bg_color(_wifi_status_dot->get(), lv_color_hex(colors::ERROR_COLOR));
+            set_text(_wifi_status_label->get(), "Connection Failed");
             break;
         default:
-            _wifi_status_dot->setBgColor(lv_color_hex(colors::ERROR_COLOR));
-            _wifi_status_label->setText("Disconnected");
+            set_bg_color(_wifi_status_dot->get(), lv_color_hex(colors::ERROR_COLOR));
+            set_text(_wifi_status_label->get(), "Disconnected");
             break;
     }
 }
 
-void RadioView::update_now_playing()
+void RadioView::update_radio_state()
 {
-    auto state = GetHAL()->getRadioState();
+    _state_shown_at = GetHAL()->millis();
 
     // Update status label and spinner
-    switch (state) {
+    switch (_radio_state) {
         case hal::HalBase::RADIO_BUFFERING:
-            _status_label->setText("Buffering...");
-            _status_label->setTextColor(lv_color_hex(colors::WARNING));
-            _buffering_spinner->setHidden(false);
+            set_text(_status_label->get(), ("Buffering... " + std::to_string(_buffer_level) + "%").c_str());
+            set_text_color(_status_label->get(), lv_color_hex(colors::WARNING));
+            set_hidden(_buffering_spinner->get(), false);
             break;
         case hal::HalBase::RADIO_PLAYING:
-            _status_label->setText("Playing");
-            _status_label->setTextColor(lv_color_hex(colors::SUCCESS));
-            _buffering_spinner->setHidden(true);
+            set_text(_status_label->get(), "Playing");
+            set_text_color(_status_label->get(), lv_color_hex(colors::SUCCESS));
+            set_hidden(_buffering_spinner->get(), true);
+            break;
+        case hal::HalBase::RADIO_PAUSED: {
+            auto timeShift = GetHAL()->getRadioTimeShift();
+            set_text(_status_label->get(),
+                     ("Paused - " + std::to_string(timeShift.behindLiveS) + "s behind live").c_str());
+            set_text_color(_status_label->get(), lv_color_hex(colors::WARNING));
+            set_hidden(_buffering_spinner->get(), true);
             break;
+        }
         case hal::HalBase::RADIO_ERROR:
-            _status_label->setText("Error - Check WiFi");
-            _status_label->setTextColor(lv_color_hex(colors::ERROR_COLOR));
-            _buffering_spinner->setHidden(true);
+            set_text(_status_label->get(), "Error - Check WiFi");
+            set_text_color(_status_label->get(), lv_color_hex(colors::ERROR_COLOR));
+            set_hidden(_buffering_spinner->get(), true);
             _is_playing = false;
-            _btn_play->label().setText(LV_SYMBOL_PLAY " PLAY");
-            _btn_play->setBgColor(lv_color_hex(colors::ACCENT));
+            set_text(_btn_play->label().get(), LV_SYMBOL_PLAY " PLAY");
+            set_bg_color(_btn_play->get(), lv_color_hex(colors::ACCENT));
             break;
         default:
-            _status_label->setText("");
-            _buffering_spinner->setHidden(true);
+            set_text(_status_label->get(), "");
+            set_hidden(_buffering_spinner->get(), true);
             break;
     }
+}
 
-    // Update track info from metadata
-    auto& metadata = GetHAL()->radioMetadata;
-    if (!metadata.title.empty()) {
-        _track_info_label->setText(("Now Playing: " + metadata.title).c_str());
-    } else if (state == hal::HalBase::RADIO_STOPPED) {
-        _track_info_label->setText("Press Play to start streaming");
+void RadioView::update_track_info()
+{
+    // A snapshot copy that never waits on the network task
+    auto metadata = GetHAL()->getRadioMetadata();
+    _track_title  = metadata.title;
+    if (metadata.title[0] != '\0') {
+        _track_info->setText((std::string("Now Playing: ") + metadata.title).c_str());
+    } else if (_radio_state == hal::HalBase::RADIO_STOPPED) {
+        _track_info->setText("Press Play to start streaming");
     }
 }
 
-void RadioView::update_spectrum()
+void RadioView::update_spectrum(uint32_t now)
 {
-    if (GetHAL()->getRadioState() != hal::HalBase::RADIO_PLAYING) {
+    // A new frame only once it has the band count we asked for, the bars ignore the others
+    if (_spectrum_bands == 0) {
+        if (GetHAL()->getRadioWaveform(&_waveform_frame)) {
+            _waveform->setFrame(_waveform_frame);
+        }
         return;
     }
+    if (GetHAL()->getRadioSpectrum(&_spectrum)) {
+        _spectrum_bars->setLevels(_spectrum.levels, _spectrum.bands, now);
+    }
+    _spectrum_bars->tick(now);
+}
+
+void RadioView::pulse_beat()
+{
+    // A fade that's still running starts over, the scheduler keeps frames coming while it runs
+    lv_anim_t anim;
+    lv_anim_init(&anim);
+    lv_anim_set_var(&anim, this);
+    lv_anim_set_exec_cb(&anim, beat_anim_cb);
+    lv_anim_set_values(&anim, LV_OPA_COVER, LV_OPA_TRANSP);
+    lv_anim_set_duration(&anim, BEAT_FADE_MS);
+    lv_anim_set_path_cb(&anim, lv_anim_path_ease_out);
+    lv_anim_set_early_apply(&anim, true);
+    lv_anim_start(&anim);
+}
+
+void RadioView::beat_anim_cb(void* view, int32_t glow)
+{
+    auto* self = static_cast<RadioView*>(view);
+    if (self->_beat_glow != glow) {
+        self->_beat_glow = (lv_opa_t)glow;
+        self->invalidate_card_rim();
+    }
+}
 
-    // Get spectrum data from HAL
-    GetHAL()->getRadioSpectrum(_spectrum_data, 32);
+void RadioView::invalidate_card_rim()
+{
+    // A style change would redraw the whole card with everything on it, the border only needs its four edges
+    lv_obj_t* card = _now_playing_card->get();
+    lv_area_t area;
+    lv_obj_get_coords(card, &area);
+    lv_area_t edges[4] = {
+        {area.x1, area.y1, area.x2, area.y1 + BEAT_RIM - 1},
+        {area.x1, area.y2 - BEAT_RIM + 1, area.x2, area.y2},
+        {area.x1, area.y1 + BEAT_RIM, area.x1 + BEAT_RIM - 1, area.y2 - BEAT_RIM},
+        {area.x2 - BEAT_RIM + 1, area.y1 + BEAT_RIM, area.x2, area.y2 - BEAT_RIM},
+    };
+    for (auto& edge : edges) {
+        lv_obj_invalidate_area(card, &edge);
+    }
+}
+
+void RadioView::card_draw_post_cb(lv_event_t* e)
+{
+    auto* self = static_cast<RadioView*>(lv_event_get_user_data(e));
+    if (self->_beat_glow == LV_OPA_TRANSP) {
+        return;
+    }
+    lv_obj_t* card = self->_now_playing_card->get();
+    lv_area_t area;
+    lv_obj_get_coords(card, &area);
+
+    lv_draw_rect_dsc_t dsc;
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_opa       = LV_OPA_TRANSP;
+    dsc.radius       = lv_obj_get_style_radius(card, LV_PART_MAIN);
+    dsc.border_width = lv_obj_get_style_border_width(card, LV_PART_MAIN);
+    dsc.border_color = lv_color_hex(colors::ACCENT_GLOW);
+    dsc.border_opa   = self->_beat_glow;
+    lv_draw_rect(lv_event_get_layer(e), &dsc, &area);
+}
 
-    // Update chart
-    for (int i = 0; i < 32; i++) {
-        _spectrum_chart->setNextValue(0, _spectrum_data[i]);
+void RadioView::set_spectrum_bands(int bands)
+{
+    // The HAL only decimates the waveform while it's shown, the spectrum's FFT always runs
+    _spectrum_bands = bands;
+    bool waveform   = bands == 0;
+    set_hidden(_spectrum_bars->get(), waveform);
+    set_hidden(_waveform->get(), !waveform);
+    if (waveform) {
+        _waveform->clear();
+        GetHAL()->setRadioWaveformColumns(_waveform->columns());
+        return;
     }
+    GetHAL()->setRadioWaveformColumns(0);
+    _spectrum_bars->setBands(bands);
+    GetHAL()->setRadioSpectrumBands(bands);
 }
 
 void RadioView::update_station_highlight()
 {
-    for (int i = 0; i < _station_cards.size(); i++) {
-        if (i == _selected_station) {
-            _station_cards[i]->setBgColor(lv_color_hex(radio::STATIONS[i].color));
-            _station_cards[i]->setBorderColor(lv_color_hex(colors::ACCENT_GLOW));
-            _station_cards[i]->setBorderWidth(3);
-        } else {
-            _station_cards[i]->setBgColor(lv_color_hex(colors::BG_SECONDARY));
-            _station_cards[i]->setBorderColor(lv_color_hex(colors::BG_TERTIARY));
-            _station_cards[i]->setBorderWidth(2);
-        }
+    for (auto& cell : _station_cells) {
+        style_station_cell(cell);
+    }
+}
+
+void RadioView::style_station_cell(StationCell_t& cell)
+{
+    // Selected is the checked state, the shared style's border over the station's own colour
+    bool selected = cell.station >= 0 && cell.station == _selected_station;
+    if (selected) {
+        set_bg_color(cell.card->get(), lv_color_hex(radio::catalog().at(cell.station).color), LV_STATE_CHECKED);
+    }
+    if (selected && !lv_obj_has_state(cell.card->get(), LV_STATE_CHECKED)) {
+        lv_obj_add_state(cell.card->get(), LV_STATE_CHECKED);
+    } else if (!selected && lv_obj_has_state(cell.card->get(), LV_STATE_CHECKED)) {
+        lv_obj_remove_state(cell.card->get(), LV_STATE_CHECKED);
+    }
+
+    bool favorite = cell.station >= 0 && radio::settings().isFavorite(radio::catalog().at(cell.station).id);
+    if (favorite) {
+        set_hidden(cell.favMark, false);
+    } else {
+        set_hidden(cell.favMark, true);
+    }
+    _card_cache->invalidate(cell.cacheSlot);
+}
+
+void RadioView::update_warm_station()
+{
+    // Keep the next station in the browsing direction connected so prev/next is an instant switch. A scan keeps
+    // its own next one warm
+    if (!_is_playing || _is_scanning || _radio_state != hal::HalBase::RADIO_PLAYING) {
+        _warm_station = -1;
+        return;
+    }
+
+    int count     = radio::catalog().count();
+    int neighbour = (_selected_station + _zap_direction + count) % count;
+    if (neighbour == _warm_station) {
+        return;
+    }
+    if (GetHAL()->prewarmRadioStream(radio::stream_url(radio::catalog().at(neighbour)))) {
+        _warm_station = neighbour;
     }
 }
 
@@ -447,66 +1153,535 @@ void RadioView::update_station_highlight()
 
 void RadioView::select_station(int index)
 {
-    if (index < 0 || index >= radio::STATION_COUNT) {
+    const auto& catalog = radio::catalog();
+    if (index < 0 || index >= catalog.count()) {
         return;
     }
 
     _selected_station = index;
+    radio::session().select(index);
 
     // Update now playing card
-    _station_name_label->setText(radio::STATIONS[index].name);
-    _station_desc_label->setText(radio::STATIONS[index].description);
+    _station_name_text->setText(catalog.at(index).name);
+    _station_desc_text->setText(catalog.at(index).description);
 
-    // Update card highlight
+    // Update card highlight, bringing the card into view for prev/next
     update_station_highlight();
+    scroll_to_station(index);
 
     // Update card border color
-    _now_playing_card->setBorderColor(lv_color_hex(radio::STATIONS[index].color));
+    _now_playing_card->setBorderColor(lv_color_hex(catalog.at(index).color));
+}
+
+void RadioView::reload_stations()
+{
+    // Indices changed with the list, the selection follows its station if that is still in it
+    mclog::tagInfo(TAG, "Station list updated, {} stations", radio::catalog().count());
+    _search.build(radio::catalog());
+    _filtered = false;
+    _grid_stations.clear();
+    if (_searching) {
+        update_search();  // The query against the new list
+    }
+    update_station_grid();
+    _warm_station = -1;
+    select_station(radio::session().station());
+    prewarm_station_hosts();
+    publish_remote_stations();
+}
+
+void RadioView::prewarm_station_hosts()
+{
+    // Resolve the station hosts ahead of the first tap (the HAL repeats this on every WiFi connect)
+    const auto& catalog = radio::catalog();
+    std::vector<std::string> urls;
+    for (int i = 0; i < catalog.count(); i++) {
+        urls.push_back(catalog.at(i).streamUrl);
+        if (catalog.at(i).aacStreamUrl) {
+            urls.push_back(catalog.at(i).aacStreamUrl);
+        }
+    }
+    GetHAL()->prewarmRadioHosts(urls);
+}
+
+void RadioView::publish_remote_stations()
+{
+    // The web remote picks by index, it lists the stations the same way
+    const auto& catalog = radio::catalog();
+    std::vector<std::string> names;
+    names.reserve(catalog.count());
+    for (int i = 0; i < catalog.count(); i++) {
+        names.push_back(catalog.at(i).name);
+    }
+    GetHAL()->setRemoteStations(names);
 }
 
 void RadioView::play_selected_station()
 {
-    // Check WiFi
-    if (GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED) {
-        _track_info_label->setText("Connect to WiFi first");
+    if (!radio::session().play(_selected_station)) {
+        _track_info->setText("Connect to WiFi first");
         show_wifi_config();
         return;
     }
+    _warm_station = -1;  // Taken by the stream if it was this one
+    show_playing(radio::session().playing());
+}
 
-    mclog::tagInfo(TAG, "Playing station: {}", radio::STATIONS[_selected_station].name);
+void RadioView::start_scan()
+{
+    if (!radio::session().scan()) {
+        _track_info->setText("Connect to WiFi first");
+        show_wifi_config();
+        return;
+    }
+    _warm_station = -1;
+    show_playing(radio::session().playing());
+}
 
-    // Start streaming
-    GetHAL()->startRadioStream(radio::STATIONS[_selected_station].streamUrl);
+void RadioView::show_playing(bool playing)
+{
+    _is_playing  = playing;
+    _is_scanning = radio::session().scanning();
+    set_text(_btn_play->label().get(),
+             _is_scanning ? LV_SYMBOL_OK " KEEP" : (playing ? LV_SYMBOL_STOP " STOP" : LV_SYMBOL_PLAY " PLAY"));
+    set_bg_color(_btn_play->get(), lv_color_hex(playing ? colors::ERROR_COLOR : colors::ACCENT));
+    set_text(_btn_pause->label().get(), LV_SYMBOL_PAUSE);
+}
 
-    _is_playing = true;
-    _btn_play->label().setText(LV_SYMBOL_STOP " STOP");
-    _btn_play->setBgColor(lv_color_hex(colors::ERROR_COLOR));
+void RadioView::update_session()
+{
+    // The web remote, MQTT, the RS485 link and stream errors change it too
+    auto& session = radio::session();
+    if (session.station() != _selected_station) {
+        select_station(session.station());
+    }
+    if (session.playing() != _is_playing || session.scanning() != _is_scanning) {
+        show_playing(session.playing());
+    }
+    if (session.volume() != (int)lv_slider_get_value(_volume_slider->get())) {
+        _volume_slider->setValue(session.volume());
+    }
 }
 
-void RadioView::stop_playback()
+void RadioView::toggle_fast_resume()
 {
-    mclog::tagInfo(TAG, "Stopping playback");
+    auto& settings = radio::settings();
+    settings.setFastResume(!settings.fastResume());
+    update_fast_resume_button();
+}
 
-    GetHAL()->stopRadioStream();
+void RadioView::update_fast_resume_button()
+{
+    bool enabled = radio::settings().fastResume();
+    set_bg_color(_btn_fast_resume->get(), lv_color_hex(enabled ? colors::ACCENT : colors::BG_TERTIARY));
+    set_text_color(_btn_fast_resume->label().get(),
+                   lv_color_hex(enabled ? colors::TEXT_PRIMARY : colors::TEXT_SECONDARY));
+}
 
-    _is_playing = false;
-    _btn_play->label().setText(LV_SYMBOL_PLAY " PLAY");
-    _btn_play->setBgColor(lv_color_hex(colors::ACCENT));
-    _track_info_label->setText("Press Play to start streaming");
+/* -------------------------------------------------------------------------- */
+/*                                 Radio alarm                                */
+/* -------------------------------------------------------------------------- */
+
+void RadioView::toggle_alarm()
+{
+    auto& settings = radio::settings();
+    settings.setAlarm(!settings.alarmEnabled(), settings.alarmMinute());
+    update_alarm_button();
+}
+
+void RadioView::update_alarm_button()
+{
+    auto& settings = radio::settings();
+    bool enabled   = settings.alarmEnabled();
+    char text[16];
+    snprintf(text, sizeof(text), LV_SYMBOL_BELL " %02d:%02d", settings.alarmMinute() / 60, settings.alarmMinute() % 60);
+    set_text(_btn_alarm->label().get(), text);
+    set_bg_color(_btn_alarm->get(), lv_color_hex(enabled ? colors::ACCENT : colors::BG_TERTIARY));
+    set_text_color(_btn_alarm->label().get(), lv_color_hex(enabled ? colors::TEXT_PRIMARY : colors::TEXT_SECONDARY));
+}
+
+void RadioView::update_alarm()
+{
+    auto& settings = radio::settings();
+    if (!settings.alarmEnabled()) {
+        return;
+    }
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    int minute = local.tm_hour * 60 + local.tm_min;
+    if (minute == _alarm_handled) {
+        return;
+    }
+
+    int until = (settings.alarmMinute() - minute + 24 * 60) % (24 * 60);
+    if (until == ALARM_PREPARE_MIN) {
+        // Associated by the time it goes off, the hosts are kept resolved already: only the stream is left to open
+        _alarm_handled = minute;
+        if (GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED) {
+            try_auto_connect();
+        }
+    } else if (until == 0) {
+        _alarm_handled = minute;
+        mclog::tagInfo(TAG, "Alarm, playing {}", radio::catalog().at(_selected_station).name);
+        GetHAL()->resumeDisplay();
+        if (GetHAL()->getRadioState() == hal::HalBase::RADIO_PAUSED) {
+            toggle_pause();
+        } else if (!_is_playing) {
+            play_selected_station();
+        }
+    }
+}
+
+void RadioView::show_alarm_panel()
+{
+    if (!_alarm_panel) {
+        create_alarm_panel();
+    }
+    int minute = radio::settings().alarmMinute();
+    lv_roller_set_selected(_alarm_hour, minute / 60, LV_ANIM_OFF);
+    lv_roller_set_selected(_alarm_minute, minute % 60, LV_ANIM_OFF);
+    set_hidden(_alarm_panel->get(), false);
+}
+
+void RadioView::create_alarm_panel()
+{
+    _alarm_panel = std::make_unique<Container>(lv_layer_top());
+    _alarm_panel->align(LV_ALIGN_CENTER, 0, 0);
+    _alarm_panel->setSize(360, 300);
+    _alarm_panel->setBgColor(lv_color_hex(colors::BG_SECONDARY));
+    _alarm_panel->setBorderWidth(0);
+    _alarm_panel->setRadius(12);
+    lv_obj_clear_flag(_alarm_panel->get(), LV_OBJ_FLAG_SCROLLABLE);
+
+    auto make_roller = [this](const std::string& options, int x) {
+        lv_obj_t* roller = lv_roller_create(_alarm_panel->get());
+        lv_roller_set_options(roller, options.c_str(), LV_ROLLER_MODE_INFINITE);
+        lv_roller_set_visible_row_count(roller, 3);
+        lv_obj_set_width(roller, 100);
+        lv_obj_align(roller, LV_ALIGN_TOP_MID, x, 10);
+        lv_obj_set_style_text_font(roller, &lv_font_montserrat_24, 0);
+        lv_obj_set_style_bg_color(roller, lv_color_hex(colors::BG_TERTIARY), 0);
+        lv_obj_set_style_text_color(roller, lv_color_hex(colors::TEXT_PRIMARY), 0);
+        lv_obj_set_style_bg_color(roller, lv_color_hex(colors::ACCENT), LV_PART_SELECTED);
+        lv_obj_set_style_border_width(roller, 0, 0);
+        return roller;
+    };
+    std::string hours, minutes;
+    for (int i = 0; i < 60; i++) {
+        char option[4];
+        snprintf(option, sizeof(option), i ? "\n%02d" : "%02d", i);
+        if (i < 24) {
+            hours += option;
+        }
+        minutes += option;
+    }
+    _alarm_hour   = make_roller(hours, -60);
+    _alarm_minute = make_roller(minutes, 60);
+
+    auto make_button = [this](const char* text, int x, uint32_t color, AlarmPanelAction_t action) {
+        auto button = std::make_unique<Button>(_alarm_panel->get());
+        button->align(LV_ALIGN_BOTTOM_MID, x, -10);
+        button->setSize(100, 50);
+        button->setBgColor(lv_color_hex(color));
+        button->setRadius(8);
+        button->setBorderWidth(0);
+        button->setShadowWidth(0);
+        button->label().setText(text);
+        button->label().setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
+        button->label().setTextFont(&lv_font_montserrat_16);
+        button->onClick().connect([this, action]() { close_alarm_panel(action); });
+        _alarm_buttons.push_back(std::move(button));
+    };
+    make_button("Cancel", -115, colors::BG_TERTIARY, ALARM_PANEL_CANCEL);
+    make_button("Set", 0, colors::ACCENT, ALARM_PANEL_SET);
+    make_button(LV_SYMBOL_POWER " Sleep", 115, colors::BG_TERTIARY, ALARM_PANEL_SLEEP);
+}
+
+void RadioView::close_alarm_panel(AlarmPanelAction_t action)
+{
+    set_hidden(_alarm_panel->get(), true);
+    if (action == ALARM_PANEL_CANCEL) {
+        return;
+    }
+    int minute = lv_roller_get_selected(_alarm_hour) * 60 + lv_roller_get_selected(_alarm_minute);
+    radio::settings().setAlarm(true, minute);
+    update_alarm_button();
+    if (action == ALARM_PANEL_SLEEP) {
+        // Powers off for good, the saved settings are what the alarm's boot resumes from
+        mclog::tagInfo(TAG, "Sleeping until the alarm at {:02d}:{:02d}", minute / 60, minute % 60);
+        radio::settings().flush();
+        GetHAL()->stopRadioStream();
+        GetHAL()->sleepAndAlarmWakeup(minute / 60, minute % 60);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Screen off                                 */
+/* -------------------------------------------------------------------------- */
+
+void RadioView::update_screen_off()
+{
+    // A touch since the dimming is someone there after all
+    if (_undimmed_brightness >= 0 && lv_display_get_inactive_time(nullptr) < GetHAL()->millis() - _absent_at) {
+        undim_display();
+    }
+    if (GetHAL()->isPresenceDetectionRunning() && (_present || GetHAL()->millis() - _absent_at < SCREEN_OFF_MS)) {
+        return;
+    }
+    if (GetHAL()->isDisplaySuspended() || _radio_state == hal::HalBase::RADIO_STOPPED ||
+        _radio_state == hal::HalBase::RADIO_ERROR || lv_display_get_inactive_time(nullptr) < SCREEN_OFF_MS) {
+        return;
+    }
+    bool dialog_open = (_wifi_dialog && !_wifi_dialog->isClosed()) ||
+                       (_alarm_panel && !lv_obj_has_flag(_alarm_panel->get(), LV_OBJ_FLAG_HIDDEN));
+    if (!dialog_open) {
+        GetHAL()->suspendDisplay();
+    }
+}
+
+void RadioView::toggle_presence_wake()
+{
+    auto& settings = radio::settings();
+    settings.setPresenceWake(!settings.presenceWake());
+    _present = true;
+    if (!settings.presenceWake()) {
+        GetHAL()->stopPresenceDetection();
+        undim_display();
+    } else if (!GetHAL()->startPresenceDetection()) {
+        mclog::tagWarn(TAG, "Presence wake not started, no camera?");
+        settings.setPresenceWake(false);
+    }
+    update_presence_button();
+}
+
+void RadioView::update_presence_button()
+{
+    bool enabled = radio::settings().presenceWake();
+    set_bg_color(_btn_presence->get(), lv_color_hex(enabled ? colors::ACCENT : colors::BG_TERTIARY));
+    set_text_color(_btn_presence->label().get(), lv_color_hex(enabled ? colors::TEXT_PRIMARY : colors::TEXT_SECONDARY));
+}
+
+void RadioView::handle_presence(bool present)
+{
+    _present = present;
+    if (present) {
+        // The screen as it was left, the off timer starts over from here
+        GetHAL()->resumeDisplay();
+        lv_display_trigger_activity(nullptr);
+        undim_display();
+        return;
+    }
+    _absent_at = GetHAL()->millis();
+    if (_undimmed_brightness < 0 && !GetHAL()->isDisplaySuspended()) {
+        _undimmed_brightness = GetHAL()->getDisplayBrightness();
+        GetHAL()->setDisplayBrightness(std::min<int>(_undimmed_brightness, PRESENCE_DIM_BRIGHTNESS));
+    }
+}
+
+void RadioView::undim_display()
+{
+    if (_undimmed_brightness >= 0) {
+        GetHAL()->setDisplayBrightness(_undimmed_brightness);
+        _undimmed_brightness = -1;
+    }
+}
+
+void RadioView::toggle_voice_control()
+{
+    if (_voice_training >= 0 || GetHAL()->isVoiceControlRunning()) {
+        _voice_training = -1;
+        GetHAL()->stopVoiceControl();
+    } else if (GetHAL()->getVoiceCommandExamples(hal::HalBase::VOICE_NEXT_STATION) == 0) {
+        train_voice_commands(0);  // Nothing to listen for yet
+        return;
+    } else if (!GetHAL()->startVoiceControl()) {
+        mclog::tagWarn(TAG, "Voice control not started, no mics?");
+    }
+    update_voice_button();
+}
+
+void RadioView::train_voice_commands(int from)
+{
+    // One example of each command in turn, then listening starts
+    _voice_training = from;
+    if (from >= hal::HalBase::VOICE_COMMAND_COUNT) {
+        _voice_training = -1;
+        GetHAL()->startVoiceControl();
+    } else if (!GetHAL()->trainVoiceCommand((hal::HalBase::VoiceCommand_t)from)) {
+        mclog::tagWarn(TAG, "Voice training not started, no mics?");
+        _voice_training = -1;
+    }
+    update_voice_button();
+}
+
+void RadioView::update_voice_button()
+{
+    static const char* prompts[hal::HalBase::VOICE_COMMAND_COUNT] = {"Say: next", "Say: back", "Say: louder",
+                                                                     "Say: quieter"};
+    bool training  = _voice_training >= 0;
+    bool listening = GetHAL()->isVoiceControlRunning();
+    uint32_t bg    = training ? colors::WARNING : listening ? colors::ACCENT : colors::BG_TERTIARY;
+    set_text(_btn_voice->label().get(), training ? prompts[_voice_training] : LV_SYMBOL_AUDIO " Voice");
+    set_bg_color(_btn_voice->get(), lv_color_hex(bg));
+    set_text_color(_btn_voice->label().get(),
+                   lv_color_hex(training || listening ? colors::TEXT_PRIMARY : colors::TEXT_SECONDARY));
+}
+
+void RadioView::handle_voice_command(int command)
+{
+    switch (command) {
+        case hal::HalBase::VOICE_NEXT_STATION:
+            next_station();
+            break;
+        case hal::HalBase::VOICE_PREVIOUS_STATION:
+            prev_station();
+            break;
+        case hal::HalBase::VOICE_VOLUME_UP:
+            change_volume(10);
+            break;
+        case hal::HalBase::VOICE_VOLUME_DOWN:
+            change_volume(-10);
+            break;
+        default:
+            break;
+    }
+}
+
+void RadioView::handle_key(uint32_t key)
+{
+    // Typing goes to the dialog's fields, the keys it has no field focused for do nothing behind it
+    if (_wifi_dialog && !_wifi_dialog->isClosed()) {
+        return;
+    }
+    // Typing a letter starts a search, Esc ends it
+    if (_searching && key == LV_KEY_ESC) {
+        close_search();
+        return;
+    }
+    if (_searching && key == LV_KEY_BACKSPACE) {
+        lv_textarea_delete_char(_search_field);
+        return;
+    }
+    if ((key > ' ' && key < 0x7F) || (_searching && key == ' ')) {
+        if (!_searching) {
+            open_search();
+        }
+        lv_textarea_add_char(_search_field, key);
+        return;
+    }
+    switch (key) {
+        case LV_KEY_ENTER:
+            toggle_playback();
+            break;
+        case LV_KEY_ESC:
+            if (_is_playing) {
+                stop_playback();
+            }
+            break;
+        case LV_KEY_LEFT:
+            prev_station();
+            break;
+        case LV_KEY_RIGHT:
+            next_station();
+            break;
+        case LV_KEY_UP:
+            change_volume(10);
+            break;
+        case LV_KEY_DOWN:
+            change_volume(-10);
+            break;
+        default:
+            break;
+    }
+}
+
+void RadioView::change_volume(int delta)
+{
+    // Setting the slider doesn't raise its value event, so the volume goes out here as the slider's callback would
+    int vol = std::clamp((int)lv_slider_get_value(_volume_slider->get()) + delta, 0, 100);
+    _volume_slider->setValue(vol);
+    radio::session().setVolume(vol);
+}
+
+void RadioView::toggle_favorite(int index)
+{
+    const char* id = radio::catalog().at(index).id;
+    radio::settings().setFavorite(id, !radio::settings().isFavorite(id));
+    update_station_highlight();
+}
+
+void RadioView::stop_playback()
+{
+    radio::session().stop();
+    show_playing(radio::session().playing());
+    if (!_is_playing) {
+        _track_info->setText("Press Play to start streaming");
+    }
 }
 
 void RadioView::toggle_playback()
 {
-    if (_is_playing) {
+    if (_is_scanning) {
+        radio::session().keep();  // Full quality from where the preview's buffer ends
+        show_playing(radio::session().playing());
+    } else if (_is_playing) {
         stop_playback();
     } else {
         play_selected_station();
     }
 }
 
+void RadioView::toggle_recording()
+{
+    if (GetHAL()->isRadioRecording()) {
+        GetHAL()->stopRadioRecording();
+    } else if (_is_playing && !GetHAL()->startRadioRecording()) {
+        mclog::tagWarn(TAG, "Recording not started, is an SD card inserted?");
+    }
+    update_record_button();
+}
+
+void RadioView::save_history()
+{
+    if (_is_playing && !GetHAL()->saveRadioHistory(SAVE_MINUTES)) {
+        mclog::tagWarn(TAG, "History not saved, is an SD card inserted?");
+    }
+    update_record_button();
+}
+
+void RadioView::update_record_button()
+{
+    // The recording also ends on its own on a station change or a full card
+    bool recording = GetHAL()->isRadioRecording();
+    bool saving    = GetHAL()->isRadioHistorySaving();
+    if (recording == _is_recording && saving == _is_saving) {
+        return;
+    }
+    _is_recording    = recording;
+    _is_saving       = saving;
+    const char* text = recording ? LV_SYMBOL_STOP " Recording"
+                       : saving  ? LV_SYMBOL_SAVE " Saving"
+                                 : LV_SYMBOL_SD_CARD " Record";
+    set_bg_color(_btn_record->get(), lv_color_hex(recording ? colors::ERROR_COLOR : colors::BG_TERTIARY));
+    set_text(_btn_record->label().get(), text);
+    set_text_color(_btn_record->label().get(),
+                   lv_color_hex(recording || saving ? colors::TEXT_PRIMARY : colors::TEXT_SECONDARY));
+}
+
+void RadioView::toggle_pause()
+{
+    if (!_is_playing) {
+        return;
+    }
+    set_text(_btn_pause->label().get(), radio::session().togglePause() ? LV_SYMBOL_PLAY : LV_SYMBOL_PAUSE);
+}
+
 void RadioView::prev_station()
 {
-    int new_index = (_selected_station - 1 + radio::STATION_COUNT) % radio::STATION_COUNT;
+    int count      = radio::catalog().count();
+    int new_index  = (_selected_station - 1 + count) % count;
+    _zap_direction = -1;
     select_station(new_index);
     if (_is_playing) {
         play_selected_station();
@@ -515,7 +1690,8 @@ void RadioView::prev_station()
 
 void RadioView::next_station()
 {
-    int new_index = (_selected_station + 1) % radio::STATION_COUNT;
+    int new_index  = (_selected_station + 1) % radio::catalog().count();
+    _zap_direction = 1;
     select_station(new_index);
     if (_is_playing) {
         play_selected_station();
@@ -526,7 +1702,25 @@ void RadioView::show_wifi_config()
 {
     if (!_wifi_dialog) {
         _wifi_dialog = std::make_unique<WifiConfigDialog>(_root->get());
-        _wifi_dialog->show();
+    }
+    _wifi_dialog->show();
+}
+
+void RadioView::update_prebuilt(uint32_t now)
+{
+    if (now - _init_at < PREBUILD_DELAY_MS || now - _prebuilt_check_at < 1000) {
+        return;
+    }
+    _prebuilt_check_at = now;
+
+    // Without heap figures from the platform there's nothing to budget against
+    hal::HalBase::PerfStats_t stats;
+    bool roomy = !GetHAL()->getPerfStats(&stats) || stats.internalFree >= PREBUILT_MIN_FREE;
+    if (!_wifi_dialog && roomy) {
+        _wifi_dialog = std::make_unique<WifiConfigDialog>(_root->get());
+    } else if (_wifi_dialog && _wifi_dialog->isClosed() && !roomy) {
+        mclog::tagInfo(TAG, "Low on memory, giving up the prebuilt WiFi dialog");
+        _wifi_dialog.reset();
     }
 }
 
@@ -534,7 +1728,7 @@ void RadioView::try_auto_connect()
 {
     std::string ssid, password;
     if (GetHAL()->loadWifiConfig(ssid, password)) {
-        mclog::tagInfo(TAG, "Auto-connecting to saved WiFi: {}", ssid);
-        GetHAL()->connectWifiSta(ssid, password);
+        mclog::tagInfo(TAG, "Auto-connecting to saved WiFi, last was {}", ssid);
+        GetHAL()->startSavedWifi();  // The outcome comes as WiFi events
     }
 }
@@ -11,12 +11,20 @@
 #include <lvgl.h>
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
+#include <hal/hal.h>
+#include "../station_search.h"
 
 namespace radio_view {
 
 // Forward declarations
 class Keyboard;
 class WifiConfigDialog;
+class SpectrumBars;
+class WaveformView;
+class PerfHud;
+class CardCache;
+class TextImage;
+class Marquee;
 
 /**
  * @brief Modern dark theme color palette
@@ -34,6 +42,23 @@ namespace colors {
     const uint32_t ERROR_COLOR    = 0xEF4444;  // Red (error)
 }  // namespace colors
 
+/**
+ * @brief What a WiFi connect in progress is doing, for the status texts
+ */
+inline const char* wifi_step_text(hal::HalBase::WifiStep_t step)
+{
+    switch (step) {
+        case hal::HalBase::WIFI_STEP_SCANNING:
+            return "Looking for network...";
+        case hal::HalBase::WIFI_STEP_AUTHENTICATING:
+            return "Authenticating...";
+        case hal::HalBase::WIFI_STEP_DHCP:
+            return "Getting IP address...";
+        default:
+            return "Connecting...";
+    }
+}
+
 /**
  * @brief Main radio player view
  */
@@ -43,7 +68,8 @@ public:
     ~RadioView();
 
     void init();
-    void update();
+    // @return ms until it wants the next update, 0 for the next frame
+    uint32_t update();
 
 private:
     // Root container
@@ -58,55 +84,205 @@ private:
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _now_playing_card;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _station_name_label;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _station_desc_label;
-    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _track_info_label;
+    std::unique_ptr<TextImage> _station_name_text;  // Draw the two labels above
+    std::unique_ptr<TextImage> _station_desc_text;
+    std::unique_ptr<Marquee> _track_info;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _status_label;
-    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Chart> _spectrum_chart;
+    std::unique_ptr<SpectrumBars> _spectrum_bars;
+    std::unique_ptr<WaveformView> _waveform;  // In the bars' place, the step after 128 bands
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Spinner> _buffering_spinner;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _cover;
+    lv_obj_t* _cover_image           = nullptr;
+    lv_obj_t* _cover_label           = nullptr;  // Placeholder while there's no cover, dim while the lookup is off
+    const lv_image_dsc_t* _cover_art = nullptr;  // Shown, owned by the artwork cache
+    std::string _track_title;
 
-    // Station grid
+    // Station grid, cards are recycled as it scrolls so there are only enough for the rows in view
+    struct StationCell_t {
+        std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> card;
+        std::unique_ptr<TextImage> nameText;
+        std::unique_ptr<TextImage> descText;
+        lv_obj_t* artImage        = nullptr;
+        lv_obj_t* favMark         = nullptr;
+        const lv_image_dsc_t* art = nullptr;  // Thumbnail shown, owned by the artwork cache
+        int station               = -1;       // Catalog index shown, -1 while unused
+        int position              = -1;       // Place in the grid, the catalog index but while searching
+        int cacheSlot             = -1;       // In _card_cache
+    };
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _station_grid;
-    std::vector<std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container>> _station_cards;
+    std::unique_ptr<CardCache> _card_cache;  // Stands in for the cards while the grid scrolls
+    std::vector<StationCell_t> _station_cells;
+    lv_obj_t* _station_grid_end = nullptr;  // Sets the scroll range
+
+    // Station search, the grid shows the matches best first while there's a query
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_search;
+    lv_obj_t* _search_field = nullptr;
+    std::unique_ptr<Keyboard> _search_keyboard;  // Built the first time the search opens
+    radio::StationSearch _search;
+    std::vector<int> _grid_stations;  // Catalog index per grid position while filtered
+    bool _searching = false;
+    bool _filtered  = false;  // The grid shows _grid_stations rather than the catalog
+
+    // Screen geometry, set in init(): 1280x720 landscape, or 720x1280 when the panel is left unrotated
+    int _screen_width   = 1280;
+    int _screen_height  = 720;
+    bool _portrait      = false;
+    int _grid_columns   = 4;
+    int _grid_height    = 360;
+    int _cell_pool_size = 0;
 
     // Transport controls
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _transport_container;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_prev;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_play;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_next;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_back;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_pause;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _volume_container;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Slider> _volume_slider;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _volume_label;
 
     // WiFi settings button
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_wifi_settings;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_record;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_fast_resume;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_voice;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_alarm;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _btn_presence;
+
+    // Radio alarm: set on the panel a long press on its button opens, built the first time
+    enum AlarmPanelAction_t { ALARM_PANEL_CANCEL, ALARM_PANEL_SET, ALARM_PANEL_SLEEP };
+    static constexpr int ALARM_PREPARE_MIN = 2;  // WiFi is brought up this long before the alarm
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _alarm_panel;
+    std::vector<std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button>> _alarm_buttons;
+    lv_obj_t* _alarm_hour   = nullptr;
+    lv_obj_t* _alarm_minute = nullptr;
+    int _alarm_handled      = -1;  // Minute of the day last acted on, each is once
 
-    // Dialogs
+    // Listening and untouched this long, the display and the UI behind it are suspended until the next touch
+    static constexpr uint32_t SCREEN_OFF_MS       = 60000;
+    static constexpr uint32_t SUSPENDED_UPDATE_MS = 1000;
+
+    // Presence wake: a face wakes the screen and keeps it on, nobody there dims it and SCREEN_OFF_MS later it's off
+    static constexpr int PRESENCE_DIM_BRIGHTNESS = 10;  // %
+    bool _present            = true;
+    uint32_t _absent_at      = 0;
+    int _undimmed_brightness = -1;  // What the dimming took the backlight down from, -1 while it isn't dimmed
+
+    // Dialogs, built hidden once the view has settled and then only shown and hidden. A hidden one is given up
+    // while internal RAM is short
+    static constexpr uint32_t PREBUILD_DELAY_MS = 2000;
+    static constexpr size_t PREBUILT_MIN_FREE   = 64 * 1024;
     std::unique_ptr<WifiConfigDialog> _wifi_dialog;
+    uint32_t _init_at           = 0;
+    uint32_t _prebuilt_check_at = 0;
+    std::unique_ptr<PerfHud> _perf_hud;  // Tap the WiFi status to toggle, long press to benchmark
+
+    static constexpr uint32_t UPDATE_MS = 50;  // Everything but the visualizer, ~20Hz
+
+    // The now playing card's border lights up on each EVENT_RADIO_BEAT and fades, only its rim is redrawn meanwhile
+    static constexpr uint32_t BEAT_FADE_MS = 220;
+    static constexpr int SAVE_MINUTES      = 5;  // Long press on Record, the HAL saves what the history goes back
+    static constexpr int BEAT_RIM          = 16;  // The card's corner radius, the strip along each edge invalidated
+    lv_opa_t _beat_glow = LV_OPA_TRANSP;
 
     // State
     int _selected_station   = 0;
-    bool _is_playing        = false;
+    bool _is_playing        = false;  // What the play button shows, radio::session().playing()
+    bool _is_scanning       = false;  // The play button is Keep, radio::session().scanning()
+    bool _is_recording      = false;
+    bool _is_saving         = false;  // The time-shift history is being written to the card
+    int _zap_direction      = 1;   // Last prev/next direction, the neighbour that way is kept warm
+    int _warm_station       = -1;  // Station the HAL has confirmed warm, -1 if none
     uint32_t _last_update   = 0;
-    uint8_t _spectrum_data[32];
+    int _spectrum_bands     = 32;  // Tap the visualizer to cycle through 32 / 64 / 128 / 0, the waveform
+    hal::HalBase::RadioSpectrum_t _spectrum;
+    hal::HalBase::RadioWaveform_t _waveform_frame;
+    bool _long_pressed  = false;  // A card or the WiFi status was long pressed, swallow its click
+    int _voice_training = -1;     // Command the guided training is asking for, -1 when it isn't running
+
+    // What the HAL last reported, labels are only touched when one of its events says something changed
+    int _events              = -1;  // Event subscription, -1 if the platform has none and the labels are polled
+    int _buffer_level        = 0;   // %, in BUFFER_EVENT_STEP steps
+    uint32_t _state_shown_at = 0;
+    hal::HalBase::RadioState_t _radio_state = hal::HalBase::RADIO_STOPPED;
 
     // Methods
+    int controls_top() const;
     void create_wifi_status();
     void create_now_playing_card();
     void create_station_grid();
+    void create_station_cells();
+    void update_station_grid();
+    void bind_station_cells();
+    void bind_station_cell(StationCell_t& cell, int station);
+    void style_station_cell(StationCell_t& cell);
+    void update_station_art(StationCell_t& cell);
+    void update_cover();
+    void update_cover_label();
+    void scroll_to_station(int index);
+    int grid_count() const;
+    int grid_station(int position) const;
+    void create_search();
+    void open_search();
+    void close_search();
+    void update_search();
     void create_transport_controls();
     void create_wifi_settings_button();
 
+    void handle_events();
+    void handle_event(const hal::HalBase::Event_t& event);
     void update_wifi_status();
-    void update_now_playing();
-    void update_spectrum();
+    void update_radio_state();
+    void update_track_info();
+    void update_spectrum(uint32_t now);
+    void pulse_beat();
+    void invalidate_card_rim();
+    static void beat_anim_cb(void* view, int32_t glow);
+    static void card_draw_post_cb(lv_event_t* e);
+    void set_spectrum_bands(int bands);  // 0 shows the waveform instead
     void update_station_highlight();
+    void update_warm_station();
+    void update_record_button();
+    void update_session();
+    void update_fast_resume_button();
+    void update_voice_button();
+    void update_presence_button();
 
     void select_station(int index);
+    void reload_stations();
+    void prewarm_station_hosts();
+    void publish_remote_stations();
     void play_selected_station();
+    void start_scan();
+    void show_playing(bool playing);
     void stop_playback();
     void toggle_playback();
+    void toggle_pause();
+    void toggle_recording();
+    void save_history();
+    void toggle_favorite(int index);
+    void toggle_fast_resume();
+    void toggle_alarm();
+    void update_alarm_button();
+    void update_alarm();
+    void show_alarm_panel();
+    void create_alarm_panel();
+    void close_alarm_panel(AlarmPanelAction_t action);
+    void update_screen_off();
+    void toggle_presence_wake();
+    void handle_presence(bool present);
+    void undim_display();
+    void toggle_voice_control();
+    void train_voice_commands(int from);
+    void handle_voice_command(int command);
+    void handle_key(uint32_t key);
+    void change_volume(int delta);
+    void toggle_track_art();
     void prev_station();
     void next_station();
     void show_wifi_config();
+    void update_prebuilt(uint32_t now);
 
     void try_auto_connect();
 };
@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "spectrum_bars.h"
+#include "radio_view.h"
+#include <algorithm>
+
+using namespace radio_view;
+using namespace smooth_ui_toolkit::lvgl_cpp;
+
+SpectrumBars::SpectrumBars(lv_obj_t* parent)
+{
+    _container = std::make_unique<Container>(parent);
+    _container->setBgColor(lv_color_hex(colors::BG_TERTIARY));
+    _container->setRadius(6);
+    _container->setBorderWidth(0);
+    lv_obj_set_style_pad_hor(_container->get(), 8, 0);
+    lv_obj_set_style_pad_ver(_container->get(), 4, 0);
+    lv_obj_clear_flag(_container->get(), LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(_container->get(), draw_event_cb, LV_EVENT_DRAW_MAIN, this);
+    _container->onClick().connect([this]() {
+        if (_on_click) {
+            _on_click();
+        }
+    });
+}
+
+void SpectrumBars::setBands(int bands)
+{
+    _bands = std::clamp(bands, 1, MAX_BANDS);
+    std::fill(std::begin(_levels), std::end(_levels), 0);
+    std::fill(std::begin(_peaks), std::end(_peaks), 0);
+    lv_obj_invalidate(_container->get());
+}
+
+void SpectrumBars::setLevels(const uint8_t* levels, int count, uint32_t now)
+{
+    if (count != _bands) {
+        return;
+    }
+
+    for (int i = 0; i < _bands; i++) {
+        uint8_t oldLevel = _levels[i];
+        uint8_t oldPeak  = _peaks[i];
+        _levels[i]       = levels[i];
+        if (levels[i] >= _peaks[i]) {
+            _peaks[i]   = levels[i];
+            _peak_at[i] = now;
+        }
+        invalidate_band(i, oldLevel, oldPeak);
+    }
+}
+
+void SpectrumBars::tick(uint32_t now)
+{
+    if (now - _last_tick < FRAME_MS) {
+        return;
+    }
+    _last_tick = now;
+
+    for (int i = 0; i < _bands; i++) {
+        if (_peaks[i] <= _levels[i] || now - _peak_at[i] < PEAK_HOLD_MS) {
+            continue;
+        }
+        uint8_t oldPeak = _peaks[i];
+        _peaks[i]       = std::max<int>(_levels[i], _peaks[i] - PEAK_FALL);
+        invalidate_band(i, _levels[i], oldPeak);
+    }
+}
+
+bool SpectrumBars::settled() const
+{
+    for (int i = 0; i < _bands; i++) {
+        if (_peaks[i] > _levels[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int32_t SpectrumBars::level_top(const lv_area_t& content, uint8_t level) const
+{
+    // First row of a bar of this level, one past the bottom for level 0
+    return content.y2 + 1 - level * lv_area_get_height(&content) / 255;
+}
+
+int32_t SpectrumBars::cap_top(const lv_area_t& content, uint8_t peak) const
+{
+    return std::max(content.y1, level_top(content, peak) - CAP_HEIGHT);
+}
+
+void SpectrumBars::band_area(const lv_area_t& content, int band, lv_area_t* area) const
+{
+    // Bars split the width evenly, with a gap that shrinks to a pixel once they get narrow
+    int32_t width = lv_area_get_width(&content);
+    int32_t gap   = width / _bands >= 6 ? 2 : 1;
+    area->x1      = content.x1 + band * width / _bands;
+    area->x2      = std::max(area->x1, content.x1 + (band + 1) * width / _bands - 1 - gap);
+    area->y1      = content.y1;
+    area->y2      = content.y2;
+}
+
+void SpectrumBars::invalidate_band(int band, uint8_t oldLevel, uint8_t oldPeak)
+{
+    if (oldLevel == _levels[band] && oldPeak == _peaks[band]) {
+        return;
+    }
+
+    lv_area_t content;
+    lv_obj_get_content_coords(_container->get(), &content);
+    lv_area_t area;
+    band_area(content, band, &area);
+
+    // Only the rows between the old and new bar top, and the old and new cap
+    int32_t barOld = level_top(content, oldLevel);
+    int32_t barNew = level_top(content, _levels[band]);
+    int32_t capOld = cap_top(content, oldPeak);
+    int32_t capNew = cap_top(content, _peaks[band]);
+    area.y1        = std::min({barOld, barNew, capOld, capNew});
+    area.y2        = std::min(content.y2, std::max({barOld, barNew, capOld + CAP_HEIGHT, capNew + CAP_HEIGHT}));
+    if (area.y1 > area.y2) {
+        return;
+    }
+    lv_obj_invalidate_area(_container->get(), &area);
+}
+
+void SpectrumBars::draw_event_cb(lv_event_t* e)
+{
+    static_cast<SpectrumBars*>(lv_event_get_user_data(e))->draw(lv_event_get_layer(e));
+}
+
+void SpectrumBars::draw(lv_layer_t* layer)
+{
+    if (_bands <= 0) {
+        return;
+    }
+
+    lv_area_t content;
+    lv_obj_get_content_coords(_container->get(), &content);
+    const lv_area_t& clip = layer->_clip_area;
+
+    lv_draw_rect_dsc_t bar_dsc;
+    lv_draw_rect_dsc_init(&bar_dsc);
+    bar_dsc.bg_color = lv_color_hex(colors::ACCENT_GLOW);
+    bar_dsc.radius   = 0;
+
+    lv_draw_rect_dsc_t cap_dsc;
+    lv_draw_rect_dsc_init(&cap_dsc);
+    cap_dsc.bg_color = lv_color_hex(colors::TEXT_PRIMARY);
+    cap_dsc.radius   = 0;
+
+    for (int i = 0; i < _bands; i++) {
+        lv_area_t area;
+        band_area(content, i, &area);
+        if (area.x2 < clip.x1 || area.x1 > clip.x2) {
+            continue;  // Only the invalidated bars are redrawn
+        }
+
+        int32_t top = level_top(content, _levels[i]);
+        if (top <= content.y2) {
+            lv_area_t bar = area;
+            bar.y1        = top;
+            lv_draw_rect(layer, &bar_dsc, &bar);
+        }
+        if (_peaks[i] > 0) {
+            lv_area_t cap = area;
+            cap.y1        = cap_top(content, _peaks[i]);
+            cap.y2        = std::min(content.y2, cap.y1 + CAP_HEIGHT - 1);
+            lv_draw_rect(layer, &cap_dsc, &cap);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <smooth_ui_toolkit.h>
+#include <smooth_lvgl.h>
+#include <cstdint>
+#include <memory>
+#include <functional>
+
+namespace radio_view {
+
+/**
+ * @brief Spectrum visualizer, one filled bar per band with a peak-hold cap on top
+ *
+ * Draws itself in LV_EVENT_DRAW_MAIN with a single rect fill per bar and per cap, so the SW renderer's fill kernel
+ * does all the work. A new frame only invalidates the rows of the bars whose bar or cap moved, the rest of the
+ * widget stays as it is in the frame buffer. Peaks fall on their own, call `tick()` once per loop for a smooth
+ * 60 fps decay even when the analyzer delivers fewer frames.
+ */
+class SpectrumBars {
+public:
+    static constexpr int MAX_BANDS         = 128;
+    static constexpr uint32_t FRAME_MS     = 16;   // Peak animation step, ~60 fps
+    static constexpr uint32_t PEAK_HOLD_MS = 400;  // A peak stays put this long before it falls
+    static constexpr int PEAK_FALL         = 6;    // Levels (0..255) a peak falls per frame
+    static constexpr int CAP_HEIGHT        = 2;    // Peak cap, in pixels
+
+    SpectrumBars(lv_obj_t* parent);
+    ~SpectrumBars() = default;
+
+    lv_obj_t* get()
+    {
+        return _container->get();
+    }
+    void setOnClick(std::function<void()> callback)
+    {
+        _on_click = callback;
+    }
+
+    /**
+     * @brief Number of bars, clears all bars and peaks
+     */
+    void setBands(int bands);
+    int bands() const
+    {
+        return _bands;
+    }
+
+    /**
+     * @brief Show a new frame, `count` levels 0..255 low to high frequency, ignored unless it matches `bands()`
+     */
+    void setLevels(const uint8_t* levels, int count, uint32_t now);
+
+    /**
+     * @brief Let the peaks fall, cheap to call every loop
+     */
+    void tick(uint32_t now);
+
+    /**
+     * @brief No peak left to fall, `tick()` has nothing to do until the next frame
+     */
+    bool settled() const;
+
+private:
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _container;
+    std::function<void()> _on_click;
+
+    int _bands          = 0;
+    uint32_t _last_tick = 0;
+    uint8_t _levels[MAX_BANDS]{};
+    uint8_t _peaks[MAX_BANDS]{};
+    uint32_t _peak_at[MAX_BANDS]{};  // When each peak was last pushed up
+
+    // Pixel rows of a level within the content area, and the absolute area of a band's column
+    int32_t level_top(const lv_area_t& content, uint8_t level) const;
+    int32_t cap_top(const lv_area_t& content, uint8_t peak) const;
+    void band_area(const lv_area_t& content, int band, lv_area_t* area) const;
+    void invalidate_band(int band, uint8_t oldLevel, uint8_t oldPeak);
+
+    static void draw_event_cb(lv_event_t* e);
+    void draw(lv_layer_t* layer);
+};
+
+}  // namespace radio_view
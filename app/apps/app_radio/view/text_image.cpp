@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "text_image.h"
+#include <cstring>
+
+using namespace radio_view;
+
+// ARGB8888, shared by all of them, the texts are rendered here first
+static lv_draw_buf_t* s_scratch = nullptr;
+
+TextImage::TextImage(lv_obj_t* label) : _label(label)
+{
+    _image = lv_image_create(lv_obj_get_parent(label));
+    lv_obj_clear_flag(_image, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_flag(_image, LV_OBJ_FLAG_IGNORE_LAYOUT);
+    lv_obj_add_flag(_image, LV_OBJ_FLAG_HIDDEN);
+    refresh();
+}
+
+TextImage::~TextImage()
+{
+    // The image goes with the label's parent
+    if (_mask) {
+        lv_image_cache_drop(_mask);
+        lv_draw_buf_destroy(_mask);
+    }
+}
+
+void TextImage::setText(const char* text)
+{
+    const char* shown = lv_label_get_text(_label);
+    if (shown && std::strcmp(shown, text) == 0) {
+        return;
+    }
+    lv_label_set_text(_label, text);
+    refresh();
+}
+
+void TextImage::refresh()
+{
+    if (render()) {
+        lv_obj_clear_flag(_image, LV_OBJ_FLAG_HIDDEN);
+        set_label_drawn(_label, false);
+    } else {
+        lv_obj_add_flag(_image, LV_OBJ_FLAG_HIDDEN);
+        set_label_drawn(_label, true);
+    }
+}
+
+void TextImage::set_label_drawn(lv_obj_t* label, bool drawn)
+{
+    // Same as the cards in CardCache, LVGL skips it without layered opacity
+    lv_obj_set_style_opa_layered(label, drawn ? LV_OPA_COVER : LV_OPA_TRANSP, LV_PART_MAIN);
+}
+
+bool TextImage::render()
+{
+    const char* text = lv_label_get_text(_label);
+    if (!text || text[0] == '\0') {
+        return false;  // Nothing to draw either way
+    }
+    if (!render_mask(_label, &_mask)) {
+        return false;
+    }
+
+    int32_t ext = lv_obj_get_ext_draw_size(_label);
+    lv_obj_set_pos(_image, lv_obj_get_x(_label) - ext, lv_obj_get_y(_label) - ext);
+    lv_obj_set_style_image_recolor(_image, lv_obj_get_style_text_color(_label, LV_PART_MAIN), LV_PART_MAIN);
+    lv_obj_set_style_image_recolor_opa(_image, LV_OPA_COVER, LV_PART_MAIN);
+    lv_obj_set_style_image_opa(_image, lv_obj_get_style_text_opa(_label, LV_PART_MAIN), LV_PART_MAIN);
+
+    lv_image_cache_drop(_mask);
+    lv_image_set_src(_image, _mask);
+    lv_obj_invalidate(_image);
+    return true;
+}
+
+bool TextImage::render_mask(lv_obj_t* label, lv_draw_buf_t** mask)
+{
+    set_label_drawn(label, true);
+    lv_obj_update_layout(label);
+    if (!s_scratch) {
+        s_scratch = lv_snapshot_create_draw_buf(label, LV_COLOR_FORMAT_ARGB8888);
+    } else if (lv_snapshot_reshape_draw_buf(label, s_scratch) != LV_RESULT_OK) {
+        lv_draw_buf_destroy(s_scratch);
+        s_scratch = lv_snapshot_create_draw_buf(label, LV_COLOR_FORMAT_ARGB8888);
+    }
+    bool taken = s_scratch && lv_snapshot_take_to_draw_buf(label, LV_COLOR_FORMAT_ARGB8888, s_scratch) == LV_RESULT_OK;
+    set_label_drawn(label, false);
+    if (!taken) {
+        return false;
+    }
+
+    uint32_t w = s_scratch->header.w;
+    uint32_t h = s_scratch->header.h;
+    if (*mask) {
+        lv_image_cache_drop(*mask);
+        if ((*mask)->header.w != w || (*mask)->header.h != h) {
+            lv_draw_buf_destroy(*mask);
+            *mask = nullptr;
+        }
+    }
+    if (!*mask) {
+        *mask = lv_draw_buf_create(w, h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+        if (!*mask) {
+            return false;
+        }
+    }
+
+    // Only the coverage is kept, the color comes back as the image's recolor
+    for (uint32_t y = 0; y < h; y++) {
+        auto src = reinterpret_cast<const lv_color32_t*>(lv_draw_buf_goto_xy(s_scratch, 0, y));
+        auto dst = static_cast<uint8_t*>(lv_draw_buf_goto_xy(*mask, 0, y));
+        for (uint32_t x = 0; x < w; x++) {
+            dst[x] = src[x].alpha;
+        }
+    }
+    return true;
+}
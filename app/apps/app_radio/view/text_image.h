@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+
+namespace radio_view {
+
+/**
+ * @brief A label drawn from an A8 snapshot of itself
+ *
+ * Every redraw of a label lays its text out again and blends each glyph. For text that rarely changes the label is
+ * rendered once into an alpha mask instead and an image sibling shows it, recolored with the label's text color, so
+ * a redraw is one masked fill. The label stays where it is for layout but isn't drawn. Only `setText()` renders again,
+ * and only for a new text; with no memory for the mask the label draws itself as before.
+ *
+ * Style and place the label first, the snapshot is taken of what it shows then:
+ *
+ *     auto label = lv_label_create(card);
+ *     lv_obj_set_style_text_font(label, &lv_font_montserrat_18, 0);
+ *     lv_obj_align(label, LV_ALIGN_TOP_MID, 0, 25);
+ *     TextImage name(label);
+ *     name.setText("Groove Salad");
+ */
+class TextImage {
+public:
+    TextImage(lv_obj_t* label);
+    ~TextImage();
+
+    void setText(const char* text);
+
+    // Render again after changing the label's style or place
+    void refresh();
+
+    lv_obj_t* label()
+    {
+        return _label;
+    }
+
+    /**
+     * @brief Render `label` into `*mask`, an A8 buffer made or resized to fit it. The label isn't drawn afterwards
+     *
+     * @return false without the memory for it
+     */
+    static bool render_mask(lv_obj_t* label, lv_draw_buf_t** mask);
+
+private:
+    lv_obj_t* _label;
+    lv_obj_t* _image;
+    lv_draw_buf_t* _mask = nullptr;  // A8, what the image shows
+
+    bool render();
+    static void set_label_drawn(lv_obj_t* label, bool drawn);
+};
+
+}  // namespace radio_view
@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "theme.h"
+#include "radio_view.h"
+
+using namespace radio_view;
+
+namespace {
+
+struct Styles_t {
+    lv_style_t panel;
+    lv_style_t card;
+    lv_style_t cardSelected;
+    lv_style_t cardName;
+    lv_style_t cardDesc;
+    lv_style_t marker;
+    lv_style_t labelPrimary;
+    lv_style_t labelSecondary;
+    lv_style_t button;
+    lv_style_t transportButton;
+    lv_style_t field;
+    lv_style_t fieldFocused;
+    lv_style_t listRowPressed;
+    lv_style_t keyboardPanel;
+    lv_style_t keyboard;
+    lv_style_t keyboardKey;
+    lv_style_t keyboardKeyChecked;
+};
+
+// Built on first use from the UI thread, never freed: objects anywhere may point at them
+Styles_t& styles()
+{
+    static Styles_t* s = nullptr;
+    if (s) {
+        return *s;
+    }
+    s = new Styles_t;
+
+    lv_style_init(&s->panel);
+    lv_style_set_bg_color(&s->panel, lv_color_hex(colors::BG_PRIMARY));
+    lv_style_set_border_width(&s->panel, 0);
+
+    lv_style_init(&s->card);
+    lv_style_set_bg_color(&s->card, lv_color_hex(colors::BG_SECONDARY));
+    lv_style_set_radius(&s->card, 12);
+    lv_style_set_border_width(&s->card, 2);
+    lv_style_set_border_color(&s->card, lv_color_hex(colors::BG_TERTIARY));
+
+    lv_style_init(&s->cardSelected);
+    lv_style_set_border_width(&s->cardSelected, 3);
+    lv_style_set_border_color(&s->cardSelected, lv_color_hex(colors::ACCENT_GLOW));
+
+    lv_style_init(&s->cardName);
+    lv_style_set_text_color(&s->cardName, lv_color_hex(colors::TEXT_PRIMARY));
+    lv_style_set_text_font(&s->cardName, &lv_font_montserrat_18);
+    lv_style_set_text_align(&s->cardName, LV_TEXT_ALIGN_CENTER);
+
+    lv_style_init(&s->cardDesc);
+    lv_style_set_text_color(&s->cardDesc, lv_color_hex(colors::TEXT_SECONDARY));
+    lv_style_set_text_font(&s->cardDesc, &lv_font_montserrat_14);
+    lv_style_set_text_align(&s->cardDesc, LV_TEXT_ALIGN_CENTER);
+
+    lv_style_init(&s->marker);
+    lv_style_set_radius(&s->marker, LV_RADIUS_CIRCLE);
+    lv_style_set_bg_color(&s->marker, lv_color_hex(colors::WARNING));
+    lv_style_set_border_width(&s->marker, 0);
+
+    lv_style_init(&s->labelPrimary);
+    lv_style_set_text_color(&s->labelPrimary, lv_color_hex(colors::TEXT_PRIMARY));
+    lv_style_set_text_font(&s->labelPrimary, &lv_font_montserrat_16);
+
+    lv_style_init(&s->labelSecondary);
+    lv_style_set_text_color(&s->labelSecondary, lv_color_hex(colors::TEXT_SECONDARY));
+    lv_style_set_text_font(&s->labelSecondary, &lv_font_montserrat_14);
+
+    lv_style_init(&s->button);
+    lv_style_set_bg_color(&s->button, lv_color_hex(colors::BG_TERTIARY));
+    lv_style_set_radius(&s->button, 8);
+    lv_style_set_border_width(&s->button, 0);
+    lv_style_set_shadow_width(&s->button, 0);
+    lv_style_set_text_color(&s->button, lv_color_hex(colors::TEXT_SECONDARY));
+    lv_style_set_text_font(&s->button, &lv_font_montserrat_14);
+
+    lv_style_init(&s->transportButton);
+    lv_style_set_bg_color(&s->transportButton, lv_color_hex(colors::BG_TERTIARY));
+    lv_style_set_radius(&s->transportButton, 12);
+    lv_style_set_border_width(&s->transportButton, 0);
+    lv_style_set_shadow_width(&s->transportButton, 0);
+    lv_style_set_text_color(&s->transportButton, lv_color_hex(colors::TEXT_PRIMARY));
+    lv_style_set_text_font(&s->transportButton, &lv_font_montserrat_20);
+
+    lv_style_init(&s->field);
+    lv_style_set_bg_color(&s->field, lv_color_hex(colors::BG_TERTIARY));
+    lv_style_set_text_color(&s->field, lv_color_hex(colors::TEXT_PRIMARY));
+    lv_style_set_text_font(&s->field, &lv_font_montserrat_16);
+    lv_style_set_radius(&s->field, 8);
+
+    lv_style_init(&s->fieldFocused);
+    lv_style_set_border_color(&s->fieldFocused, lv_color_hex(colors::ACCENT));
+    lv_style_set_border_width(&s->fieldFocused, 2);
+
+    lv_style_init(&s->listRowPressed);
+    lv_style_set_bg_color(&s->listRowPressed, lv_color_hex(colors::BG_SECONDARY));
+    lv_style_set_bg_opa(&s->listRowPressed, LV_OPA_COVER);
+
+    lv_style_init(&s->keyboardPanel);
+    lv_style_set_bg_color(&s->keyboardPanel, lv_color_hex(colors::BG_SECONDARY));
+    lv_style_set_border_width(&s->keyboardPanel, 0);
+    lv_style_set_radius(&s->keyboardPanel, 0);
+
+    lv_style_init(&s->keyboard);
+    lv_style_set_bg_color(&s->keyboard, lv_color_hex(colors::BG_SECONDARY));
+    lv_style_set_pad_gap(&s->keyboard, 5);
+
+    lv_style_init(&s->keyboardKey);
+    lv_style_set_bg_color(&s->keyboardKey, lv_color_hex(colors::BG_TERTIARY));
+    lv_style_set_text_color(&s->keyboardKey, lv_color_hex(colors::TEXT_PRIMARY));
+    lv_style_set_text_font(&s->keyboardKey, &lv_font_montserrat_18);
+    lv_style_set_border_width(&s->keyboardKey, 0);
+    lv_style_set_radius(&s->keyboardKey, 8);
+
+    lv_style_init(&s->keyboardKeyChecked);
+    lv_style_set_bg_color(&s->keyboardKeyChecked, lv_color_hex(colors::ACCENT));
+    return *s;
+}
+
+}  // namespace
+
+lv_style_t* theme::panel()
+{
+    return &styles().panel;
+}
+
+lv_style_t* theme::card()
+{
+    return &styles().card;
+}
+
+lv_style_t* theme::card_selected()
+{
+    return &styles().cardSelected;
+}
+
+lv_style_t* theme::card_name()
+{
+    return &styles().cardName;
+}
+
+lv_style_t* theme::card_desc()
+{
+    return &styles().cardDesc;
+}
+
+lv_style_t* theme::marker()
+{
+    return &styles().marker;
+}
+
+lv_style_t* theme::label_primary()
+{
+    return &styles().labelPrimary;
+}
+
+lv_style_t* theme::label_secondary()
+{
+    return &styles().labelSecondary;
+}
+
+lv_style_t* theme::button()
+{
+    return &styles().button;
+}
+
+lv_style_t* theme::transport_button()
+{
+    return &styles().transportButton;
+}
+
+lv_style_t* theme::field()
+{
+    return &styles().field;
+}
+
+lv_style_t* theme::field_focused()
+{
+    return &styles().fieldFocused;
+}
+
+lv_style_t* theme::list_row_pressed()
+{
+    return &styles().listRowPressed;
+}
+
+lv_style_t* theme::keyboard_panel()
+{
+    return &styles().keyboardPanel;
+}
+
+lv_style_t* theme::keyboard()
+{
+    return &styles().keyboard;
+}
+
+lv_style_t* theme::keyboard_key()
+{
+    return &styles().keyboardKey;
+}
+
+lv_style_t* theme::keyboard_key_checked()
+{
+    return &styles().keyboardKeyChecked;
+}
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+
+namespace radio_view {
+
+/**
+ * @brief The view's looks as shared styles, made from `colors` once and added to objects by reference
+ *
+ * Every `lv_obj_set_style_*()`, and every setter of the lvgl_cpp wrappers, gives the object a local style of its
+ * own: allocated with the object, held as long as it lives, and looked through first for every property resolved
+ * while drawing. An object given one of these instead holds a pointer. Local styles are left for what is the
+ * object's own (a position, a station's colour) or changes while it's shown, they win over the shared ones.
+ *
+ * Text colour and font are inherited, a button's or a card's labels take them from its style.
+ *
+ *     lv_obj_add_style(card, theme::card(), LV_PART_MAIN);
+ *     lv_obj_add_style(card, theme::card_selected(), LV_STATE_CHECKED);
+ */
+namespace theme {
+
+lv_style_t* panel();                 // Plain container, BG_PRIMARY and no border
+lv_style_t* card();                  // Station and now playing cards, the WiFi dialog
+lv_style_t* card_selected();         // For LV_STATE_CHECKED, the bright border. The fill is the station's colour
+lv_style_t* card_name();             // Station card texts, centred
+lv_style_t* card_desc();
+lv_style_t* marker();                // Small round WARNING dot
+lv_style_t* label_primary();         // TEXT_PRIMARY in 16 px
+lv_style_t* label_secondary();       // TEXT_SECONDARY in 14 px
+lv_style_t* button();                // Secondary actions, TEXT_SECONDARY in 14 px
+lv_style_t* transport_button();      // Transport controls, TEXT_PRIMARY in 20 px
+lv_style_t* field();                 // Text areas, the border lights up focused
+lv_style_t* field_focused();         // For LV_STATE_FOCUSED
+lv_style_t* list_row_pressed();      // For LV_STATE_PRESSED on a row with no style of its own
+lv_style_t* keyboard_panel();        // Behind the on-screen keyboard
+lv_style_t* keyboard();              // The keyboard, LV_PART_MAIN
+lv_style_t* keyboard_key();          // LV_PART_ITEMS
+lv_style_t* keyboard_key_checked();  // LV_PART_ITEMS | LV_STATE_CHECKED, shift
+
+}  // namespace theme
+
+}  // namespace radio_view
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <cstring>
+
+namespace radio_view {
+
+/**
+ * @brief Setters that leave an object alone when it already shows the value
+ *
+ * LVGL invalidates an object on every set, also when nothing changes. The view's update paths set the same texts and
+ * colors over and over, these keep a steady screen from being redrawn. Styles are compared against the object's own
+ * local style for `selector`, not whatever its state resolves to.
+ */
+inline void set_text(lv_obj_t* label, const char* text)
+{
+    const char* shown = lv_label_get_text(label);
+    if (shown && std::strcmp(shown, text) == 0) {
+        return;
+    }
+    lv_label_set_text(label, text);
+}
+
+inline bool has_local_color(lv_obj_t* obj, lv_style_prop_t prop, lv_color_t color, lv_style_selector_t selector)
+{
+    lv_style_value_t value;
+    return lv_obj_get_local_style_prop(obj, prop, &value, selector) == LV_STYLE_RES_FOUND &&
+           lv_color_eq(value.color, color);
+}
+
+inline void set_bg_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector = LV_PART_MAIN)
+{
+    if (!has_local_color(obj, LV_STYLE_BG_COLOR, color, selector)) {
+        lv_obj_set_style_bg_color(obj, color, selector);
+    }
+}
+
+inline void set_text_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector = LV_PART_MAIN)
+{
+    if (!has_local_color(obj, LV_STYLE_TEXT_COLOR, color, selector)) {
+        lv_obj_set_style_text_color(obj, color, selector);
+    }
+}
+
+inline void set_hidden(lv_obj_t* obj, bool hidden)
+{
+    if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN) == hidden) {
+        return;
+    }
+    if (hidden) {
+        lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+}  // namespace radio_view
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "waveform_view.h"
+#include "radio_view.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace radio_view;
+using namespace smooth_ui_toolkit::lvgl_cpp;
+
+WaveformView::WaveformView(lv_obj_t* parent)
+{
+    _container = std::make_unique<Container>(parent);
+    _container->setBgColor(lv_color_hex(colors::BG_TERTIARY));
+    _container->setRadius(6);
+    _container->setBorderWidth(0);
+    lv_obj_set_style_pad_hor(_container->get(), 8, 0);
+    lv_obj_set_style_pad_ver(_container->get(), 4, 0);
+    lv_obj_clear_flag(_container->get(), LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(_container->get(), draw_event_cb, LV_EVENT_DRAW_MAIN, this);
+    _container->onClick().connect([this]() {
+        if (_on_click) {
+            _on_click();
+        }
+    });
+}
+
+WaveformView::~WaveformView()
+{
+    if (_mask) {
+        lv_image_cache_drop(_mask);
+        lv_draw_buf_destroy(_mask);
+    }
+}
+
+int WaveformView::columns()
+{
+    lv_obj_update_layout(_container->get());
+    return std::max<int32_t>(0, lv_obj_get_content_width(_container->get()));
+}
+
+bool WaveformView::ensure_mask(int32_t w, int32_t h)
+{
+    if (_mask && _mask->header.w == w && _mask->header.h == h) {
+        return true;
+    }
+    if (_mask) {
+        lv_image_cache_drop(_mask);
+        lv_draw_buf_destroy(_mask);
+    }
+    _mask = lv_draw_buf_create(w, h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+    if (!_mask) {
+        return false;
+    }
+    memset(_mask->data, 0, _mask->data_size);
+    _drawn_top    = 0;
+    _drawn_bottom = -1;
+    return true;
+}
+
+int32_t WaveformView::row_of(int8_t value, int32_t h) const
+{
+    // Full scale up is the top row, full scale down the bottom one
+    return (127 - value) * (h - 1) / 255;
+}
+
+void WaveformView::invalidate_rows(int32_t top, int32_t bottom)
+{
+    if (top > bottom) {
+        return;
+    }
+    lv_area_t area;
+    lv_obj_get_content_coords(_container->get(), &area);
+    area.y2 = area.y1 + bottom;
+    area.y1 = area.y1 + top;
+    lv_obj_invalidate_area(_container->get(), &area);
+}
+
+void WaveformView::setFrame(const hal::HalBase::RadioWaveform_t& frame)
+{
+    lv_area_t content;
+    lv_obj_get_content_coords(_container->get(), &content);
+    int32_t w = lv_area_get_width(&content);
+    int32_t h = lv_area_get_height(&content);
+    if (frame.columns != w || h <= 0 || !ensure_mask(w, h)) {
+        return;
+    }
+
+    // The image cache may hold on to the old pixels
+    lv_image_cache_drop(_mask);
+    uint32_t stride = _mask->header.stride;
+    if (_drawn_top <= _drawn_bottom) {
+        memset(_mask->data + _drawn_top * stride, 0, (_drawn_bottom - _drawn_top + 1) * stride);
+    }
+
+    int32_t top       = h;
+    int32_t bottom    = -1;
+    int32_t prevTop   = 0;
+    int32_t prevBelow = 0;
+    for (int32_t x = 0; x < w; x++) {
+        int32_t high = row_of(frame.max[x], h);
+        int32_t low  = row_of(frame.min[x], h);
+        int32_t y1   = high;
+        int32_t y2   = low;
+        if (x > 0) {
+            // Over to where the last column's stroke ends, a gap between them would break the trace
+            y1 = std::min(y1, prevBelow);
+            y2 = std::max(y2, prevTop);
+        }
+        prevTop   = high;
+        prevBelow = low;
+
+        uint8_t* pixel = _mask->data + y1 * stride + x;
+        for (int32_t y = y1; y <= y2; y++, pixel += stride) {
+            *pixel = 0xFF;
+        }
+        top    = std::min(top, y1);
+        bottom = std::max(bottom, y2);
+    }
+
+    invalidate_rows(std::min(top, _drawn_top), std::max(bottom, _drawn_bottom));
+    _drawn_top    = top;
+    _drawn_bottom = bottom;
+}
+
+void WaveformView::clear()
+{
+    if (!_mask || _drawn_top > _drawn_bottom) {
+        return;
+    }
+    lv_image_cache_drop(_mask);
+    uint32_t stride = _mask->header.stride;
+    memset(_mask->data + _drawn_top * stride, 0, (_drawn_bottom - _drawn_top + 1) * stride);
+    invalidate_rows(_drawn_top, _drawn_bottom);
+    _drawn_top    = 0;
+    _drawn_bottom = -1;
+}
+
+void WaveformView::draw_event_cb(lv_event_t* e)
+{
+    static_cast<WaveformView*>(lv_event_get_user_data(e))->draw(lv_event_get_layer(e));
+}
+
+void WaveformView::draw(lv_layer_t* layer)
+{
+    if (!_mask || _drawn_top > _drawn_bottom) {
+        return;
+    }
+
+    lv_area_t content;
+    lv_obj_get_content_coords(_container->get(), &content);
+    lv_area_t img = {content.x1, content.y1, content.x1 + (int32_t)_mask->header.w - 1,
+                     content.y1 + (int32_t)_mask->header.h - 1};
+    if (!lv_area_is_on(&img, &layer->_clip_area)) {
+        return;
+    }
+
+    lv_draw_image_dsc_t dsc;
+    lv_draw_image_dsc_init(&dsc);
+    dsc.src         = _mask;
+    dsc.recolor     = lv_color_hex(colors::ACCENT_GLOW);
+    dsc.recolor_opa = LV_OPA_COVER;
+    lv_draw_image(layer, &dsc, &img);
+}
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <lvgl.h>
+#include <smooth_ui_toolkit.h>
+#include <smooth_lvgl.h>
+#include <hal/hal.h>
+#include <cstdint>
+#include <memory>
+#include <functional>
+
+namespace radio_view {
+
+/**
+ * @brief Oscilloscope view of the stream, a min/max stroke per pixel column from the HAL's decimated waveform
+ *
+ * Each column's stroke reaches over to its neighbour's, so together they read as one trace however steep it is. The
+ * trace is rendered into an A8 mask the size of the content area and drawn as a single recolored image blit, and a
+ * new frame only invalidates the rows the old and the new trace cover.
+ */
+class WaveformView {
+public:
+    WaveformView(lv_obj_t* parent);
+    ~WaveformView();
+
+    lv_obj_t* get()
+    {
+        return _container->get();
+    }
+    void setOnClick(std::function<void()> callback)
+    {
+        _on_click = callback;
+    }
+
+    /**
+     * @brief The columns a frame should have, the content width, once the widget is laid out
+     */
+    int columns();
+
+    /**
+     * @brief Show a new frame, ignored unless it has `columns()` columns
+     */
+    void setFrame(const hal::HalBase::RadioWaveform_t& frame);
+
+    /**
+     * @brief Flatten the trace, for when it's shown again after a while
+     */
+    void clear();
+
+private:
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _container;
+    std::function<void()> _on_click;
+    lv_draw_buf_t* _mask = nullptr;
+    int32_t _drawn_top    = 0;  // Rows of the mask the current trace covers
+    int32_t _drawn_bottom = -1;
+
+    bool ensure_mask(int32_t w, int32_t h);
+    int32_t row_of(int8_t value, int32_t h) const;
+    void invalidate_rows(int32_t top, int32_t bottom);
+
+    static void draw_event_cb(lv_event_t* e);
+    void draw(lv_layer_t* layer);
+};
+
+}  // namespace radio_view
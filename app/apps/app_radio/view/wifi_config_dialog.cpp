@@ -5,20 +5,32 @@
  */
 #include "wifi_config_dialog.h"
 #include "keyboard.h"
+#include "text_image.h"
 #include "radio_view.h"
+#include "ui_setters.h"
+#include "theme.h"
 #include <hal/hal.h>
 #include <mooncake_log.h>
+#include <algorithm>
 
 using namespace radio_view;
 using namespace smooth_ui_toolkit::lvgl_cpp;
 
 static const char* TAG = "wifi_dialog";
 
+static constexpr int NETWORK_ROW_HEIGHT = 44;
+static constexpr int NETWORK_PANEL_H    = 220;
+static constexpr int NETWORK_ROW_POOL   = NETWORK_PANEL_H / NETWORK_ROW_HEIGHT + 2;  // Rows partly in view included
+
 WifiConfigDialog::WifiConfigDialog(lv_obj_t* parent)
     : _parent(parent)
-    , _closed(false)
+    , _closed(true)
     , _password_visible(false)
+    , _connected_at(0)
     , _active_textarea(nullptr)
+    , _network_panel(nullptr)
+    , _network_end(nullptr)
+    , _network_hint(nullptr)
 {
     create_dialog();
 }
@@ -31,7 +43,8 @@ void WifiConfigDialog::create_dialog()
 {
     // Create semi-transparent backdrop
     _backdrop = std::make_unique<Container>(_parent);
-    _backdrop->setSize(1280, 720);
+    lv_display_t* disp = lv_display_get_default();
+    _backdrop->setSize(lv_display_get_horizontal_resolution(disp), lv_display_get_vertical_resolution(disp));
     _backdrop->setPos(0, 0);
     _backdrop->setBgColor(lv_color_hex(0x000000));
     _backdrop->setBgOpa(LV_OPA_70);
@@ -47,10 +60,8 @@ void WifiConfigDialog::create_dialog()
     _dialog = std::make_unique<Container>(_backdrop->get());
     _dialog->setSize(500, 380);
     _dialog->align(LV_ALIGN_TOP_MID, 0, 80);
-    _dialog->setBgColor(lv_color_hex(colors::BG_SECONDARY));
+    lv_obj_add_style(_dialog->get(), theme::card(), LV_PART_MAIN);
     _dialog->setRadius(16);
-    _dialog->setBorderWidth(2);
-    _dialog->setBorderColor(lv_color_hex(colors::BG_TERTIARY));
     // Stop click propagation
     _dialog->onClick().connect([]() {});
 
@@ -58,47 +69,47 @@ void WifiConfigDialog::create_dialog()
     _title_label = std::make_unique<Label>(_dialog->get());
     _title_label->align(LV_ALIGN_TOP_MID, 0, 20);
     _title_label->setText("WiFi Configuration");
-    _title_label->setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
+    lv_obj_add_style(_title_label->get(), theme::label_primary(), LV_PART_MAIN);
     _title_label->setTextFont(&lv_font_montserrat_22);
+    _title_text = std::make_unique<TextImage>(_title_label->get());  // The captions never change
 
     // SSID label
     _ssid_label = std::make_unique<Label>(_dialog->get());
     _ssid_label->align(LV_ALIGN_TOP_LEFT, 30, 70);
     _ssid_label->setText("SSID (Network Name)");
-    _ssid_label->setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
-    _ssid_label->setTextFont(&lv_font_montserrat_14);
+    lv_obj_add_style(_ssid_label->get(), theme::label_secondary(), LV_PART_MAIN);
+    _ssid_text = std::make_unique<TextImage>(_ssid_label->get());
 
     // SSID textarea
     _ssid_textarea = lv_textarea_create(_dialog->get());
-    lv_obj_set_size(_ssid_textarea, 440, 45);
+    lv_obj_set_size(_ssid_textarea, 380, 45);
     lv_obj_align(_ssid_textarea, LV_ALIGN_TOP_LEFT, 30, 95);
     lv_textarea_set_one_line(_ssid_textarea, true);
     lv_textarea_set_placeholder_text(_ssid_textarea, "Enter WiFi name");
-    lv_obj_set_style_bg_color(_ssid_textarea, lv_color_hex(colors::BG_TERTIARY), 0);
-    lv_obj_set_style_text_color(_ssid_textarea, lv_color_hex(colors::TEXT_PRIMARY), 0);
-    lv_obj_set_style_text_font(_ssid_textarea, &lv_font_montserrat_16, 0);
-    lv_obj_set_style_border_color(_ssid_textarea, lv_color_hex(colors::ACCENT), LV_STATE_FOCUSED);
-    lv_obj_set_style_border_width(_ssid_textarea, 2, LV_STATE_FOCUSED);
-    lv_obj_set_style_radius(_ssid_textarea, 8, 0);
-
-    // Load saved SSID if available
-    std::string saved_ssid, saved_pass;
-    if (GetHAL()->loadWifiConfig(saved_ssid, saved_pass)) {
-        lv_textarea_set_text(_ssid_textarea, saved_ssid.c_str());
-    }
+    lv_obj_add_style(_ssid_textarea, theme::field(), LV_PART_MAIN);
+    lv_obj_add_style(_ssid_textarea, theme::field_focused(), LV_STATE_FOCUSED);
 
     // SSID click to show keyboard
     lv_obj_add_event_cb(_ssid_textarea, [](lv_event_t* e) {
         WifiConfigDialog* dlg = (WifiConfigDialog*)lv_event_get_user_data(e);
+        dlg->show_network_panel(false);
         dlg->show_keyboard_for(dlg->_ssid_textarea);
     }, LV_EVENT_CLICKED, this);
 
+    // Scan button, opens the network picker
+    _scan_btn = std::make_unique<Button>(_dialog->get());
+    _scan_btn->align(LV_ALIGN_TOP_LEFT, 420, 95);
+    _scan_btn->setSize(50, 45);
+    lv_obj_add_style(_scan_btn->get(), theme::button(), LV_PART_MAIN);
+    _scan_btn->label().setText(LV_SYMBOL_WIFI);
+    _scan_btn->onClick().connect([this]() { show_network_panel(lv_obj_has_flag(_network_panel, LV_OBJ_FLAG_HIDDEN)); });
+
     // Password label
     _password_label = std::make_unique<Label>(_dialog->get());
     _password_label->align(LV_ALIGN_TOP_LEFT, 30, 155);
     _password_label->setText("Password");
-    _password_label->setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
-    _password_label->setTextFont(&lv_font_montserrat_14);
+    lv_obj_add_style(_password_label->get(), theme::label_secondary(), LV_PART_MAIN);
+    _password_text = std::make_unique<TextImage>(_password_label->get());
 
     // Password textarea
     _password_textarea = lv_textarea_create(_dialog->get());
@@ -107,16 +118,13 @@ void WifiConfigDialog::create_dialog()
     lv_textarea_set_one_line(_password_textarea, true);
     lv_textarea_set_placeholder_text(_password_textarea, "Enter password");
     lv_textarea_set_password_mode(_password_textarea, true);
-    lv_obj_set_style_bg_color(_password_textarea, lv_color_hex(colors::BG_TERTIARY), 0);
-    lv_obj_set_style_text_color(_password_textarea, lv_color_hex(colors::TEXT_PRIMARY), 0);
-    lv_obj_set_style_text_font(_password_textarea, &lv_font_montserrat_16, 0);
-    lv_obj_set_style_border_color(_password_textarea, lv_color_hex(colors::ACCENT), LV_STATE_FOCUSED);
-    lv_obj_set_style_border_width(_password_textarea, 2, LV_STATE_FOCUSED);
-    lv_obj_set_style_radius(_password_textarea, 8, 0);
+    lv_obj_add_style(_password_textarea, theme::field(), LV_PART_MAIN);
+    lv_obj_add_style(_password_textarea, theme::field_focused(), LV_STATE_FOCUSED);
 
     // Password click to show keyboard
     lv_obj_add_event_cb(_password_textarea, [](lv_event_t* e) {
         WifiConfigDialog* dlg = (WifiConfigDialog*)lv_event_get_user_data(e);
+        dlg->show_network_panel(false);
         dlg->show_keyboard_for(dlg->_password_textarea);
     }, LV_EVENT_CLICKED, this);
 
@@ -124,12 +132,8 @@ void WifiConfigDialog::create_dialog()
     _show_password_btn = std::make_unique<Button>(_dialog->get());
     _show_password_btn->align(LV_ALIGN_TOP_LEFT, 420, 180);
     _show_password_btn->setSize(50, 45);
-    _show_password_btn->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _show_password_btn->setRadius(8);
-    _show_password_btn->setBorderWidth(0);
-    _show_password_btn->setShadowWidth(0);
+    lv_obj_add_style(_show_password_btn->get(), theme::button(), LV_PART_MAIN);
     _show_password_btn->label().setText(LV_SYMBOL_EYE_CLOSE);
-    _show_password_btn->label().setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
     _show_password_btn->onClick().connect([this]() { toggle_password_visibility(); });
 
     // Status label
@@ -152,12 +156,8 @@ void WifiConfigDialog::create_dialog()
     _cancel_btn = std::make_unique<Button>(_dialog->get());
     _cancel_btn->align(LV_ALIGN_BOTTOM_LEFT, 30, -30);
     _cancel_btn->setSize(120, 45);
-    _cancel_btn->setBgColor(lv_color_hex(colors::BG_TERTIARY));
-    _cancel_btn->setRadius(8);
-    _cancel_btn->setBorderWidth(0);
-    _cancel_btn->setShadowWidth(0);
+    lv_obj_add_style(_cancel_btn->get(), theme::button(), LV_PART_MAIN);
     _cancel_btn->label().setText("Cancel");
-    _cancel_btn->label().setTextColor(lv_color_hex(colors::TEXT_SECONDARY));
     _cancel_btn->label().setTextFont(&lv_font_montserrat_16);
     _cancel_btn->onClick().connect([this]() { hide(); });
 
@@ -165,25 +165,187 @@ void WifiConfigDialog::create_dialog()
     _connect_btn = std::make_unique<Button>(_dialog->get());
     _connect_btn->align(LV_ALIGN_BOTTOM_RIGHT, -30, -30);
     _connect_btn->setSize(120, 45);
+    lv_obj_add_style(_connect_btn->get(), theme::button(), LV_PART_MAIN);
     _connect_btn->setBgColor(lv_color_hex(colors::ACCENT));
-    _connect_btn->setRadius(8);
-    _connect_btn->setBorderWidth(0);
-    _connect_btn->setShadowWidth(0);
     _connect_btn->label().setText("Connect");
     _connect_btn->label().setTextColor(lv_color_hex(colors::TEXT_PRIMARY));
     _connect_btn->label().setTextFont(&lv_font_montserrat_16);
     _connect_btn->onClick().connect([this]() { try_connect(); });
 
+    // Over the fields below the SSID while open
+    create_network_panel();
+
     // Create keyboard (initially hidden)
     _keyboard = std::make_unique<Keyboard>(_backdrop->get());
     _keyboard->setOnDone([this]() {
         // Move dialog back up when keyboard closes
         _dialog->align(LV_ALIGN_TOP_MID, 0, 80);
     });
+
+    _backdrop->setHidden(true);
+}
+
+void WifiConfigDialog::create_network_panel()
+{
+    _network_panel = lv_obj_create(_dialog->get());
+    lv_obj_set_size(_network_panel, 440, NETWORK_PANEL_H);
+    lv_obj_align(_network_panel, LV_ALIGN_TOP_LEFT, 30, 142);
+    lv_obj_set_style_bg_color(_network_panel, lv_color_hex(colors::BG_TERTIARY), 0);
+    lv_obj_set_style_border_width(_network_panel, 0, 0);
+    lv_obj_set_style_radius(_network_panel, 8, 0);
+    lv_obj_set_style_pad_all(_network_panel, 0, 0);
+    lv_obj_set_scrollbar_mode(_network_panel, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_scroll_dir(_network_panel, LV_DIR_VER);
+
+    _network_end = lv_obj_create(_network_panel);
+    lv_obj_remove_style_all(_network_end);
+    lv_obj_set_size(_network_end, 1, 1);
+    lv_obj_clear_flag(_network_end, LV_OBJ_FLAG_CLICKABLE);
+
+    _network_hint = lv_label_create(_network_panel);
+    lv_obj_add_style(_network_hint, theme::label_secondary(), LV_PART_MAIN);
+    lv_obj_align(_network_hint, LV_ALIGN_CENTER, 0, 0);
+
+    _network_rows.resize(NETWORK_ROW_POOL);
+    for (int i = 0; i < NETWORK_ROW_POOL; i++) {
+        auto& row = _network_rows[i];
+        row.row   = lv_obj_create(_network_panel);
+        lv_obj_remove_style_all(row.row);
+        lv_obj_set_size(row.row, 440, NETWORK_ROW_HEIGHT);
+        lv_obj_add_style(row.row, theme::list_row_pressed(), LV_STATE_PRESSED);
+        lv_obj_clear_flag(row.row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row.row, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_set_user_data(row.row, (void*)(intptr_t)i);
+
+        row.name = lv_label_create(row.row);
+        lv_obj_set_width(row.name, 300);
+        lv_label_set_long_mode(row.name, LV_LABEL_LONG_DOT);
+        lv_obj_add_style(row.name, theme::label_primary(), LV_PART_MAIN);
+        lv_obj_align(row.name, LV_ALIGN_LEFT_MID, 15, 0);
+
+        row.signal = lv_label_create(row.row);
+        lv_obj_add_style(row.signal, theme::label_secondary(), LV_PART_MAIN);
+        lv_obj_align(row.signal, LV_ALIGN_RIGHT_MID, -15, 0);
+
+        lv_obj_add_event_cb(row.row, [](lv_event_t* e) {
+            auto dlg = (WifiConfigDialog*)lv_event_get_user_data(e);
+            int i    = (intptr_t)lv_obj_get_user_data((lv_obj_t*)lv_event_get_current_target(e));
+            dlg->pick_network(dlg->_network_rows[i].network);
+        }, LV_EVENT_CLICKED, this);
+    }
+
+    lv_obj_add_event_cb(_network_panel, [](lv_event_t* e) {
+        auto dlg = (WifiConfigDialog*)lv_event_get_user_data(e);
+        dlg->bind_network_rows();
+    }, LV_EVENT_SCROLL, this);
+
+    lv_obj_add_flag(_network_panel, LV_OBJ_FLAG_HIDDEN);
+}
+
+void WifiConfigDialog::show_network_panel(bool shown)
+{
+    set_hidden(_network_panel, !shown);
+    if (!shown) {
+        return;
+    }
+    _keyboard->hide();
+    _dialog->align(LV_ALIGN_TOP_MID, 0, 80);
+    // What an earlier scan found right away, a fresh one updates it
+    updateNetworks(GetHAL()->startWifiScan());
+}
+
+void WifiConfigDialog::updateNetworks(bool scanning)
+{
+    _networks = GetHAL()->getWifiNetworks();
+
+    if (!_networks.empty()) {
+        lv_label_set_text(_network_hint, "");
+    } else if (scanning) {
+        lv_label_set_text(_network_hint, "Scanning...");
+    } else {
+        lv_label_set_text(_network_hint, "No networks found");
+    }
+
+    int height = (int)_networks.size() * NETWORK_ROW_HEIGHT;
+    lv_obj_set_pos(_network_end, 0, std::max(height, NETWORK_PANEL_H) - 1);
+    lv_obj_update_layout(_network_panel);
+    lv_obj_readjust_scroll(_network_panel, LV_ANIM_OFF);
+
+    // The order may have changed under every row
+    for (auto& row : _network_rows) {
+        row.network = -1;
+    }
+    bind_network_rows();
+}
+
+void WifiConfigDialog::bind_network_rows()
+{
+    // Network i always lands in row i % pool, a scroll by one row rebinds just that one
+    int first = std::max((int)lv_obj_get_scroll_y(_network_panel), 0) / NETWORK_ROW_HEIGHT;
+    for (int network = first; network < first + NETWORK_ROW_POOL; network++) {
+        auto& row = _network_rows[network % NETWORK_ROW_POOL];
+        if (row.network != network) {
+            bind_network_row(row, network);
+        }
+    }
+}
+
+void WifiConfigDialog::bind_network_row(NetworkRow_t& row, int network)
+{
+    if (network >= (int)_networks.size()) {
+        row.network = -1;
+        set_hidden(row.row, true);
+        return;
+    }
+
+    const auto& info = _networks[network];
+    row.network      = network;
+    lv_obj_set_pos(row.row, 0, network * NETWORK_ROW_HEIGHT);
+    set_text(row.name, info.ssid.c_str());
+    char signal[24];
+    snprintf(signal, sizeof(signal), "%s%d dBm", info.secured ? "" : "Open  ", info.rssi);
+    set_text(row.signal, signal);
+    set_hidden(row.row, false);
+}
+
+void WifiConfigDialog::pick_network(int network)
+{
+    if (network < 0 || network >= (int)_networks.size()) {
+        return;
+    }
+    lv_textarea_set_text(_ssid_textarea, _networks[network].ssid.c_str());
+    lv_textarea_set_text(_password_textarea, "");
+    show_network_panel(false);
+    // An open network needs no password, the rest go straight to typing it
+    if (_networks[network].secured) {
+        show_keyboard_for(_password_textarea);
+    }
+}
+
+void WifiConfigDialog::reset()
+{
+    // Saved SSID if available, the rest as a new dialog has it
+    std::string saved_ssid, saved_pass;
+    lv_textarea_set_text(_ssid_textarea, GetHAL()->loadWifiConfig(saved_ssid, saved_pass) ? saved_ssid.c_str() : "");
+    lv_textarea_set_text(_password_textarea, "");
+    if (_password_visible) {
+        toggle_password_visibility();
+    }
+    _status_label->setText("");
+    _status_label->setTextColor(lv_color_hex(colors::WARNING));
+    _connecting_spinner->setHidden(true);
+    set_hidden(_network_panel, true);
+    _dialog->align(LV_ALIGN_TOP_MID, 0, 80);
+    _connected_at = 0;
 }
 
 void WifiConfigDialog::show()
 {
+    reset();
+    // Results are likely in by the time the picker is opened
+    GetHAL()->startWifiScan();
+    // Above whatever was added to the parent since it was built
+    lv_obj_move_foreground(_backdrop->get());
     _backdrop->setHidden(false);
     _closed = false;
 }
@@ -202,22 +364,23 @@ void WifiConfigDialog::update()
     auto state = GetHAL()->getWifiState();
 
     if (state == hal::HalBase::WIFI_CONNECTED) {
-        _status_label->setText("Connected!");
-        _status_label->setTextColor(lv_color_hex(colors::SUCCESS));
-        _connecting_spinner->setHidden(true);
+        set_text(_status_label->get(), "Connected!");
+        set_text_color(_status_label->get(), lv_color_hex(colors::SUCCESS));
+        set_hidden(_connecting_spinner->get(), true);
 
         // Auto-close after successful connection
-        static uint32_t connected_time = 0;
-        if (connected_time == 0) {
-            connected_time = GetHAL()->millis();
-        } else if (GetHAL()->millis() - connected_time > 1500) {
-            connected_time = 0;
+        if (_connected_at == 0) {
+            _connected_at = GetHAL()->millis();
+        } else if (GetHAL()->millis() - _connected_at > 1500) {
             hide();
         }
+    } else if (state == hal::HalBase::WIFI_CONNECTING) {
+        set_text(_status_label->get(), wifi_step_text(GetHAL()->getWifiStep()));
+        set_hidden(_connecting_spinner->get(), false);
     } else if (state == hal::HalBase::WIFI_FAILED) {
-        _status_label->setText("Connection failed. Check credentials.");
-        _status_label->setTextColor(lv_color_hex(colors::ERROR_COLOR));
-        _connecting_spinner->setHidden(true);
+        set_text(_status_label->get(), "Connection failed. Check credentials.");
+        set_text_color(_status_label->get(), lv_color_hex(colors::ERROR_COLOR));
+        set_hidden(_connecting_spinner->get(), true);
     }
 }
 
@@ -247,8 +410,12 @@ void WifiConfigDialog::try_connect()
     // Save config
     GetHAL()->saveWifiConfig(ssid, password);
 
-    // Start connection in background
-    GetHAL()->connectWifiSta(ssid, password);
+    // Returns at once, update() follows the steps and the outcome
+    if (!GetHAL()->startWifiSta(ssid, password)) {
+        _status_label->setText("Connection failed. Check credentials.");
+        _status_label->setTextColor(lv_color_hex(colors::ERROR_COLOR));
+        _connecting_spinner->setHidden(true);
+    }
 }
 
 void WifiConfigDialog::toggle_password_visibility()
@@ -7,15 +7,21 @@
 #include <lvgl.h>
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
+#include <hal/hal.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace radio_view {
 
 class Keyboard;
+class TextImage;
 
 /**
  * @brief WiFi configuration dialog with SSID/password input
+ *
+ * Built hidden, `show()` brings it up fresh each time, so one instance can be kept and reused. The button next to the
+ * SSID opens a list of the networks around, filled in by `updateNetworks()` as the scan goes on
  */
 class WifiConfigDialog {
 public:
@@ -25,6 +31,8 @@ public:
     void show();
     void hide();
     void update();
+    // EVENT_WIFI_SCAN, `scanning` is its value
+    void updateNetworks(bool scanning);
     bool isClosed() const { return _closed; }
 
 private:
@@ -39,16 +47,34 @@ private:
 
     // Title
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _title_label;
+    std::unique_ptr<TextImage> _title_text;
 
     // SSID input
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _ssid_label;
+    std::unique_ptr<TextImage> _ssid_text;
     lv_obj_t* _ssid_textarea;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _scan_btn;
+
+    // Network picker, a few pooled rows rebound while it scrolls like the station grid
+    struct NetworkRow_t {
+        lv_obj_t* row;
+        lv_obj_t* name;
+        lv_obj_t* signal;
+        int network = -1;  // Bound to, -1 if none
+    };
+    lv_obj_t* _network_panel;
+    lv_obj_t* _network_end;   // Gives the panel the whole list's scroll range
+    lv_obj_t* _network_hint;  // Scanning or nothing found
+    std::vector<NetworkRow_t> _network_rows;
+    std::vector<hal::HalBase::WifiNetwork_t> _networks;
 
     // Password input
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _password_label;
+    std::unique_ptr<TextImage> _password_text;
     lv_obj_t* _password_textarea;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Button> _show_password_btn;
     bool _password_visible;
+    uint32_t _connected_at;  // When it saw the connection, it closes a moment later
 
     // Status
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _status_label;
@@ -63,9 +89,15 @@ private:
     lv_obj_t* _active_textarea;
 
     void create_dialog();
+    void reset();
     void try_connect();
     void toggle_password_visibility();
     void show_keyboard_for(lv_obj_t* textarea);
+    void create_network_panel();
+    void show_network_panel(bool shown);
+    void bind_network_rows();
+    void bind_network_row(NetworkRow_t& row, int network);
+    void pick_network(int network);
 };
 
 }  // namespace radio_view
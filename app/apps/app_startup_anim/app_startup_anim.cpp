@@ -26,108 +26,125 @@ void AppStartupAnim::onCreate()
     mclog::tagInfo(getAppInfo().name, "on create");
 }
 
+static void anim_set_y(void* obj, int32_t value)
+{
+    lv_obj_set_y(static_cast<lv_obj_t*>(obj), value);
+}
+
+static void anim_set_x(void* obj, int32_t value)
+{
+    lv_obj_set_x(static_cast<lv_obj_t*>(obj), value);
+}
+
+static void anim_set_image_opa(void* obj, int32_t value)
+{
+    lv_obj_set_style_image_opa(static_cast<lv_obj_t*>(obj), value, LV_PART_MAIN);
+}
+
+static void start_anim(lv_obj_t* obj, lv_anim_exec_xcb_t exec, int32_t from, int32_t to, uint32_t delay,
+                       uint32_t time, lv_anim_path_cb_t path)
+{
+    lv_anim_t anim;
+    lv_anim_init(&anim);
+    lv_anim_set_var(&anim, obj);
+    lv_anim_set_exec_cb(&anim, exec);
+    lv_anim_set_values(&anim, from, to);
+    lv_anim_set_delay(&anim, delay);
+    lv_anim_set_duration(&anim, time);
+    lv_anim_set_path_cb(&anim, path);
+    lv_anim_set_early_apply(&anim, true);
+    lv_anim_start(&anim);
+}
+
 void AppStartupAnim::onOpen()
 {
     mclog::tagInfo(getAppInfo().name, "on open");
 
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_OPEN);
+
+    // An opaque overlay, the screen beneath is hidden meanwhile so what's built there isn't rendered under it
+    lv_obj_add_flag(lv_screen_active(), LV_OBJ_FLAG_HIDDEN);
 
-    lv_obj_set_style_bg_color(lv_screen_active(), lv_color_hex(0xFFFFFF), LV_PART_MAIN);
-    lv_obj_remove_flag(lv_screen_active(), LV_OBJ_FLAG_SCROLLABLE);
+    _overlay = std::make_unique<Container>(lv_layer_top());
+    _overlay->setSize(LV_PCT(100), LV_PCT(100));
+    _overlay->setPos(0, 0);
+    _overlay->setBgColor(lv_color_hex(0xFFFFFF));
+    _overlay->setBorderWidth(0);
+    _overlay->setRadius(0);
+    lv_obj_set_style_pad_all(_overlay->get(), 0, 0);
+    lv_obj_remove_flag(_overlay->get(), LV_OBJ_FLAG_SCROLLABLE);
+    _overlay->onClick().connect([this]() { _skip_requested = true; });
 
-    _logo_tab = std::make_unique<Image>(lv_screen_active());
+    _logo_tab = std::make_unique<Image>(_overlay->get());
     _logo_tab->setAlign(LV_ALIGN_TOP_MID);
     _logo_tab->setSrc(&logo_tab);
+    // An A8 image (assets/alpha_image.py), drawn in its ink over the white overlay
+    lv_obj_set_style_image_recolor(_logo_tab->get(), lv_color_hex(0x312C29), LV_PART_MAIN);
+    lv_obj_set_style_image_recolor_opa(_logo_tab->get(), LV_OPA_COVER, LV_PART_MAIN);
     _logo_tab->setPos(-46, 785);
 
-    _logo_5 = std::make_unique<Image>(lv_screen_active());
+    _logo_5 = std::make_unique<Image>(_overlay->get());
     _logo_5->setAlign(LV_ALIGN_TOP_MID);
     _logo_5->setSrc(&logo_5);
     _logo_5->setPos(700, 308);
 
-    _label_version = std::make_unique<Label>(lv_screen_active());
+    _label_version = std::make_unique<Label>(_overlay->get());
     _label_version->setTextColor(lv_color_hex(0xCCCCCC));
     _label_version->setTextFont(&lv_font_montserrat_24);
     _label_version->align(LV_ALIGN_CENTER, 580, 320);
     _label_version->setText(FIRMWARE_VERSION);
 
-    _anim_logo_tab_y.pause();
-    _anim_logo_tab_y.teleport(785);
-    _anim_logo_tab_y.springOptions().visualDuration = 0.6;
-    _anim_logo_tab_y.springOptions().bounce         = 0.2;
-
-    _anim_logo_tab_opa.pause();
-    _anim_logo_tab_opa.teleport(0);
-    _anim_logo_tab_opa.easingOptions().easingFunction = ease::linear;
-    _anim_logo_tab_opa.easingOptions().duration       = 0.6;
-
-    _anim_logo_5_x.pause();
-    _anim_logo_5_x.teleport(700);
-    _anim_logo_5_x.springOptions().visualDuration = 0.4;
-    _anim_logo_5_x.springOptions().bounce         = 0.2;
+    // The LVGL task plays these, the loop is free to open the apps meanwhile
+    start_anim(_logo_tab->get(), anim_set_y, 785, 309, LOGO_TAB_DELAY, LOGO_TAB_TIME, lv_anim_path_overshoot);
+    start_anim(_logo_tab->get(), anim_set_image_opa, LV_OPA_TRANSP, LV_OPA_COVER, LOGO_TAB_DELAY, LOGO_TAB_TIME,
+               lv_anim_path_linear);
+    start_anim(_logo_5->get(), anim_set_x, 700, 82, LOGO_5_DELAY, LOGO_5_TIME, lv_anim_path_overshoot);
 
+    _volume     = GetHAL()->getSpeakerVolume();
     _time_count = GetHAL()->millis();
 }
 
-void AppStartupAnim::onRunning()
+uint32_t AppStartupAnim::onUpdate()
 {
-    if (_anime_state == AnimState_StartupDelay) {
-        if (GetHAL()->millis() - _time_count > 400) {
-            _anime_state = AnimState_LogoTabMoveUp;
-            _anim_logo_tab_y.play();
-            _anim_logo_tab_y = 309;
-            _anim_logo_tab_opa.play();
-            _anim_logo_tab_opa = 255;
-        }
-        return;
-    }
+    uint32_t elapsed = GetHAL()->millis() - _time_count;
 
-    else if (_anime_state == AnimState_LogoTabMoveUp) {
-        if (_anim_logo_tab_y.done()) {
-            _anime_state = AnimState_Logo5MoveLeft;
-            _anim_logo_5_x.play();
-            _anim_logo_5_x = 82;
-        }
+    if (!_is_sfx_played && elapsed >= SFX_AT) {
+        GetHAL()->setSpeakerVolume(80);
+        GetHAL()->playStartupSfx();
+        _is_sfx_played = true;
     }
 
-    else if (_anime_state == AnimState_Logo5MoveLeft) {
-        if (_anim_logo_5_x.done()) {
-            _anime_state = AnimState_FinalDelay;
-            _time_count  = GetHAL()->millis();
-            GetHAL()->startWifiAp();
-        }
-        if (!_is_sfx_played) {
-            if (_anim_logo_5_x.directValue() < 90) {
-                GetHAL()->setSpeakerVolume(80);
-                GetHAL()->playStartupSfx();
-                _is_sfx_played = true;
-            }
-        }
+    bool ready = !_is_ready || _is_ready();
+    if (ready && !_is_ready_logged) {
+        mclog::tagInfo(getAppInfo().name, "app ready at {} ms", GetHAL()->millis());
+        _is_ready_logged = true;
     }
 
-    else if (_anime_state == AnimState_FinalDelay) {
-        if (GetHAL()->millis() - _time_count > 1000) {
-            close();
-        }
-        return;
+    // Cut short by a tap, otherwise until the logo has landed, and never past the point the app beneath is ready
+    if (elapsed < GIVE_UP_AT && !(ready && (_skip_requested || elapsed >= LANDED_AT))) {
+        return scheduler::EVERY_FRAME;  // The logos are moving
     }
-
-    LvglLockGuard lock;
-
-    _logo_tab->setY(_anim_logo_tab_y);
-    _logo_tab->setOpa(_anim_logo_tab_opa);
-    _logo_5->setX(_anim_logo_5_x);
+    mclog::tagInfo(getAppInfo().name, "boot to interactive: {} ms{}", GetHAL()->millis(),
+                   _skip_requested ? ", skipped" : "");
+    close();
+    return scheduler::EVERY_FRAME;
 }
 
 void AppStartupAnim::onClose()
 {
     mclog::tagInfo(getAppInfo().name, "on close");
 
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_OPEN);
 
+    // Deleting the objects also deletes their animations
     _logo_tab.reset();
     _logo_5.reset();
     _label_version.reset();
+    _overlay.reset();
+    lv_obj_remove_flag(lv_screen_active(), LV_OBJ_FLAG_HIDDEN);
 
-    GetHAL()->setSpeakerVolume(60);
+    // The startup sound is louder than whatever the apps set meanwhile
+    if (_is_sfx_played) {
+        GetHAL()->setSpeakerVolume(_volume);
+    }
 }
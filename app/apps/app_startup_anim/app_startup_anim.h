@@ -5,7 +5,9 @@
  */
 #pragma once
 #include <mooncake.h>
+#include <apps/utils/scheduler/scheduler.h>
 #include <memory>
+#include <functional>
 #include "lvgl_cpp/label.h"
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
@@ -14,32 +16,43 @@
 /**
  * @brief 派生 App
  *
+ * Boot animation on the top layer. It doesn't block: the apps opened after it are built on the screen beneath while
+ * the logos move, the moves themselves are LVGL animations run by the LVGL task. It goes away once the logo has
+ * landed and `setReadyCheck()` says the app beneath is usable, or on a tap as soon as that's the case.
  */
-class AppStartupAnim : public mooncake::AppAbility {
+class AppStartupAnim : public scheduler::ScheduledApp {
 public:
     AppStartupAnim();
 
+    void setReadyCheck(std::function<bool()> isReady)
+    {
+        _is_ready = isReady;
+    }
+
     // 重写生命周期回调
     void onCreate() override;
     void onOpen() override;
-    void onRunning() override;
+    uint32_t onUpdate() override;
     void onClose() override;
 
 private:
-    enum AnimState_t {
-        AnimState_StartupDelay = 0,
-        AnimState_LogoTabMoveUp,
-        AnimState_Logo5MoveLeft,
-        AnimState_FinalDelay
-    };
+    // Timeline from onOpen(), in ms
+    static constexpr uint32_t LOGO_TAB_DELAY = 400;
+    static constexpr uint32_t LOGO_TAB_TIME  = 600;
+    static constexpr uint32_t LOGO_5_DELAY   = LOGO_TAB_DELAY + LOGO_TAB_TIME;
+    static constexpr uint32_t LOGO_5_TIME    = 400;
+    static constexpr uint32_t SFX_AT         = LOGO_5_DELAY + LOGO_5_TIME * 3 / 4;
+    static constexpr uint32_t LANDED_AT      = LOGO_5_DELAY + LOGO_5_TIME + 300;
+    static constexpr uint32_t GIVE_UP_AT     = 10000;  // Ready or not
 
-    AnimState_t _anime_state = AnimState_StartupDelay;
+    std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Container> _overlay;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Image> _logo_tab;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Image> _logo_5;
     std::unique_ptr<smooth_ui_toolkit::lvgl_cpp::Label> _label_version;
-    smooth_ui_toolkit::AnimateValue _anim_logo_tab_y;
-    smooth_ui_toolkit::AnimateValue _anim_logo_tab_opa;
-    smooth_ui_toolkit::AnimateValue _anim_logo_5_x;
-    uint32_t _time_count = 0;
-    bool _is_sfx_played  = false;
+    std::function<bool()> _is_ready;
+    uint32_t _time_count  = 0;
+    uint8_t _volume       = 0;
+    bool _is_sfx_played   = false;
+    bool _skip_requested  = false;
+    bool _is_ready_logged = false;
 };
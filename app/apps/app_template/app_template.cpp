@@ -34,9 +34,10 @@ void AppTemplate::onOpen()
     mclog::tagInfo(getAppInfo().name, "on open");
 }
 
-void AppTemplate::onRunning()
+uint32_t AppTemplate::onUpdate()
 {
     // mclog::tagInfo(getAppInfo().name, "on running");
+    return 1000;  // ms until the next update, scheduler::EVERY_FRAME while something moves
 }
 
 void AppTemplate::onClose()
@@ -10,18 +10,19 @@
  */
 #pragma once
 #include <mooncake.h>
+#include <apps/utils/scheduler/scheduler.h>
 
 /**
  * @brief 派生 App
  *
  */
-class AppTemplate : public mooncake::AppAbility {
+class AppTemplate : public scheduler::ScheduledApp {
 public:
     AppTemplate();
 
     // 重写生命周期回调
     void onCreate() override;
     void onOpen() override;
-    void onRunning() override;
+    uint32_t onUpdate() override;
     void onClose() override;
 };
@@ -8,101 +8,147 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <cstring>
 #include <hal/hal.h>
 
-static constexpr int SAMPLE_RATE = 48000;
+static constexpr int SAMPLE_RATE = AudioMixer::SAMPLE_RATE;
 static constexpr double PI       = 3.14159265358979323846;
 
-// 简单线性包络：attack + decay
-void generate_tone_with_linear_envelope(std::vector<int16_t>& buffer, double freq, double duration, double volume)
+/* -------------------------------------------------------------------------- */
+/*                                  Wavetable                                 */
+/* -------------------------------------------------------------------------- */
+// Tones are read from a sine table built at compile time, with linear interpolation that's well below 16 bit
+// noise. Everything renders straight into a mixer voice, nothing is allocated per key press.
+static constexpr int TABLE_BITS = 10;
+static constexpr int TABLE_SIZE = 1 << TABLE_BITS;
+static constexpr int MAX_NOTES  = 8;  // Per chord
+
+// std::sin isn't constexpr, the series converges to double precision on [-pi, pi]
+static constexpr double constexpr_sin(double x)
 {
-    int samples        = static_cast<int>(SAMPLE_RATE * duration);
-    int attack_samples = SAMPLE_RATE * 0.005;  // 5ms attack
-    for (int i = 0; i < samples; ++i) {
-        double t         = static_cast<double>(i) / SAMPLE_RATE;
-        double amplitude = 1.0;
-
-        if (i < attack_samples) {
-            amplitude = static_cast<double>(i) / attack_samples;  // Linear attack
-        } else {
-            amplitude = 1.0 - static_cast<double>(i - attack_samples) / (samples - attack_samples);  // Linear decay
-        }
-
-        double sample = std::sin(2.0 * PI * freq * t) * amplitude;
-        int16_t s     = static_cast<int16_t>(sample * volume * 32767);
-        buffer.push_back(s);  // Left
-        buffer.push_back(s);  // Right
+    while (x > PI) {
+        x -= 2 * PI;
+    }
+    double term = x;
+    double sum  = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
     }
+    return sum;
 }
 
-namespace audio {
+struct SineTable_t {
+    int16_t value[TABLE_SIZE + 1];  // The last one repeats the first, for the interpolation
+};
 
-void play_tone(int frequency, double durationSec)
+static constexpr SineTable_t make_sine_table()
 {
-    if (GetHAL()->getSpeakerVolume() <= 0) {
-        return;
+    SineTable_t table{};
+    for (int i = 0; i <= TABLE_SIZE; i++) {
+        table.value[i] = static_cast<int16_t>(constexpr_sin(2 * PI * i / TABLE_SIZE) * 32767);
     }
+    return table;
+}
 
-    const int sample_rate = 48000;
-    const int samples     = static_cast<int>(sample_rate * durationSec);
-    std::vector<int16_t> buffer(samples * 2);  // 双声道
-
-    const int fade_len    = 200;  // 淡出长度（采样点）
-    const float amplitude = 32767.0f / 5;
+static constexpr SineTable_t _sine_table = make_sine_table();
 
-    for (int i = 0; i < samples; ++i) {
-        float amp = amplitude;
+struct Oscillator_t {
+    uint32_t phase = 0;
+    uint32_t step  = 0;  // Phase per sample, a full turn is 2^32
 
-        // 应用结尾淡出（fade-out）
-        if (i >= samples - fade_len) {
-            float fade_factor = static_cast<float>(samples - i) / fade_len;
-            amp *= fade_factor;
-        }
+    void setFrequency(float freq)
+    {
+        phase = 0;
+        step  = static_cast<uint32_t>(freq * (4294967296.0f / SAMPLE_RATE));
+    }
 
-        int16_t value     = static_cast<int16_t>(amp * sin(2.0 * M_PI * frequency * i / sample_rate));
-        buffer[i * 2]     = value;  // 左声道
-        buffer[i * 2 + 1] = value;  // 右声道
+    int32_t next()
+    {
+        uint32_t index = phase >> (32 - TABLE_BITS);
+        int32_t frac   = (phase >> (32 - TABLE_BITS - 15)) & 0x7fff;
+        int32_t a      = _sine_table.value[index];
+        int32_t b      = _sine_table.value[index + 1];
+        phase += step;
+        return a + (((b - a) * frac) >> 15);
     }
+};
 
-    GetHAL()->audioPlay(buffer);
+static float midi_to_freq(int midi)
+{
+    return 440.0f * std::pow(2.0f, (midi - 69) / 12.0f);
 }
 
-void play_melody(const std::vector<int>& midiList, double durationSec = 0.1)
+/**
+ * @brief Render `frames` stereo frames into a free mixer voice and start it
+ * @param render (int16_t* out, int frames), `out` is only as large as one voice
+ */
+template <typename Render>
+static void play_voice(int frames, Render render)
 {
-    if (GetHAL()->getSpeakerVolume() <= 0) {
+    AudioMixer& mixer = GetHAL()->audioMixer;
+    int voice         = mixer.acquire();
+    if (voice < 0) {
         return;
     }
+    frames = std::min(frames, mixer.voiceFrames());
+    render(mixer.buffer(voice), frames);
+    GetHAL()->audioPlayVoice(voice, frames);
+}
 
-    const int sample_rate      = 48000;
-    const int samples_per_note = static_cast<int>(sample_rate * durationSec);
-    const int fade_len         = 200;  // 每个音符结尾的淡出长度
-    const float amplitude      = 32767.0f / 5;
-
-    std::vector<int16_t> buffer;                             // 大 buffer 存放整首旋律
-    buffer.reserve(midiList.size() * samples_per_note * 2);  // 双声道预留空间
+/**
+ * @brief A note with a fade over its last `fadeLen` frames
+ */
+static void render_note(int16_t* out, int frames, float freq, int fadeLen, float amplitude)
+{
+    Oscillator_t osc;
+    osc.setFrequency(freq);
+    int32_t amp = static_cast<int32_t>(amplitude * 32768.0f);
+    for (int i = 0; i < frames; ++i) {
+        int32_t gain = amp;
+        if (i >= frames - fadeLen) {
+            gain = amp * (frames - i) / fadeLen;
+        }
+        int16_t value  = static_cast<int16_t>((osc.next() * gain) >> 15);
+        out[i * 2]     = value;  // 左声道
+        out[i * 2 + 1] = value;  // 右声道
+    }
+}
 
-    for (int midiNote : midiList) {
-        for (int i = 0; i < samples_per_note; ++i) {
-            float amp = amplitude;
+namespace audio {
 
-            // 应用淡出（仅每个音符的结尾）
-            if (i >= samples_per_note - fade_len) {
-                float fade_factor = static_cast<float>(samples_per_note - i) / fade_len;
-                amp *= fade_factor;
-            }
+void play_tone(int frequency, double durationSec)
+{
+    if (GetHAL()->getSpeakerVolume() <= 0) {
+        return;
+    }
 
-            int16_t sample = 0;
-            if (midiNote >= 0) {
-                double freq = 440.0 * pow(2.0, (midiNote - 69) / 12.0);
-                sample      = static_cast<int16_t>(amp * sin(2.0 * M_PI * freq * i / sample_rate));
-            }
+    const int samples = static_cast<int>(SAMPLE_RATE * durationSec);
+    play_voice(samples, [frequency](int16_t* out, int frames) {
+        render_note(out, frames, frequency, std::min(200, frames), 1.0f / 5);  // 结尾淡出 200 个采样点
+    });
+}
 
-            buffer.push_back(sample);  // 左声道
-            buffer.push_back(sample);  // 右声道
-        }
+void play_melody(const std::vector<int>& midiList, double durationSec = 0.1)
+{
+    if (GetHAL()->getSpeakerVolume() <= 0) {
+        return;
     }
 
-    GetHAL()->audioPlay(buffer);
+    const int samples_per_note = static_cast<int>(SAMPLE_RATE * durationSec);
+    const int fade_len         = std::min(200, samples_per_note);  // 每个音符结尾的淡出长度
+
+    play_voice(midiList.size() * samples_per_note, [&](int16_t* out, int frames) {
+        for (int note = 0; note * samples_per_note < frames; note++) {
+            int16_t* noteOut = out + note * samples_per_note * 2;
+            int noteFrames   = std::min(samples_per_note, frames - note * samples_per_note);
+            if (midiList[note] >= 0) {
+                render_note(noteOut, noteFrames, midi_to_freq(midiList[note]), fade_len, 1.0f / 5);
+            } else {
+                memset(noteOut, 0, noteFrames * 2 * sizeof(int16_t));
+            }
+        }
+    });
 }
 
 void play_tone_from_midi(int midi, double durationSec)
@@ -111,8 +157,7 @@ void play_tone_from_midi(int midi, double durationSec)
         return;
     }
 
-    double freq = 440.0 * std::pow(2.0, (midi - 69) / 12.0);
-    play_tone(static_cast<int>(freq), durationSec);
+    play_tone(static_cast<int>(midi_to_freq(midi)), durationSec);
 }
 
 void play_random_tone(int semitoneShift = 0, double durationSec = 0.15)
@@ -155,35 +200,35 @@ void play_next_tone_progression(double durationSec)
 
 void play_chord(const std::vector<int>& midiNotes, double durationSec)
 {
-    if (GetHAL()->getSpeakerVolume() <= 0) {
+    if (GetHAL()->getSpeakerVolume() <= 0 || midiNotes.empty()) {
         return;
     }
 
-    std::vector<double> freqs;
-    for (int midi : midiNotes) {
-        double freq = 440.0 * std::pow(2.0, (midi - 69) / 12.0);
-        freqs.push_back(freq);
-    }
-
-    std::vector<int16_t> buffer;
-    std::vector<std::vector<int16_t>> tones;
-    for (double freq : freqs) {
-        std::vector<int16_t> tone;
-        generate_tone_with_linear_envelope(tone, freq, durationSec, 0.35);
-        tones.push_back(tone);
-    }
-
-    size_t num_samples = tones[0].size();
-    buffer.resize(num_samples, 0);
-    for (size_t i = 0; i < num_samples; ++i) {
-        int32_t mixed = 0;
-        for (auto& tone : tones) {
-            mixed += tone[i];
+    // Every note on one voice: 5 ms linear attack, then a linear decay to the end
+    const int samples = static_cast<int>(SAMPLE_RATE * durationSec);
+    play_voice(samples, [&midiNotes](int16_t* out, int frames) {
+        Oscillator_t oscs[MAX_NOTES];
+        int notes = std::min(static_cast<int>(midiNotes.size()), MAX_NOTES);
+        for (int n = 0; n < notes; n++) {
+            oscs[n].setFrequency(midi_to_freq(midiNotes[n]));
         }
-        buffer[i] = std::clamp((int)mixed, -32768, 32767);
-    }
 
-    GetHAL()->audioPlay(buffer);
+        const int attack_samples = SAMPLE_RATE * 5 / 1000;
+        const float volume       = 0.35f;
+        for (int i = 0; i < frames; ++i) {
+            float amplitude = (i < attack_samples) ? static_cast<float>(i) / attack_samples
+                                                   : 1.0f - static_cast<float>(i - attack_samples) /
+                                                                std::max(1, frames - attack_samples);
+            int32_t gain  = static_cast<int32_t>(amplitude * volume * 32768.0f);
+            int32_t mixed = 0;
+            for (int n = 0; n < notes; n++) {
+                mixed += (oscs[n].next() * gain) >> 15;
+            }
+            int16_t value  = static_cast<int16_t>(std::clamp(mixed, (int32_t)-32768, (int32_t)32767));
+            out[i * 2]     = value;
+            out[i * 2 + 1] = value;
+        }
+    });
 }
 
 void play_random_chord(int semitoneShift, double durationSec)
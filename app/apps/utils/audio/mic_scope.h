@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <hal/hal.h>
+#include <stream/pcm_channels.h>
+#include <cstdint>
+#include <string.h>
+
+namespace audio {
+
+/**
+ * @brief The newest mic frame for a waveform or level display, from a capture reader kept open meanwhile
+ *
+ *     _mic.open();
+ *     if (_mic.update()) {  // Once per UI update
+ *         const int16_t* left = _mic.channel(0);  // MIC_FRAME_SAMPLES of them
+ *     }
+ *     _mic.close();
+ */
+class MicScope {
+public:
+    static constexpr int FRAME_SAMPLES = hal::HalBase::MIC_FRAME_SAMPLES;
+    static constexpr int CHANNELS      = hal::HalBase::MIC_CHANNELS;
+
+    ~MicScope()
+    {
+        close();
+    }
+
+    void open(float gain = 80.0f)
+    {
+        if (_reader < 0) {
+            GetHAL()->setMicGain(gain);
+            _reader = GetHAL()->openMicCapture();
+        }
+    }
+
+    void close()
+    {
+        if (_reader >= 0) {
+            GetHAL()->closeMicCapture(_reader);
+            _reader = -1;
+        }
+    }
+
+    /**
+     * @brief Catch up with the capture, older frames are passed over
+     *
+     * @return true if a frame came in since the last call
+     */
+    bool update()
+    {
+        bool fresh = false;
+        int n;
+        while (_reader >= 0 && (n = GetHAL()->readMicCapture(_reader, _batch, READ_FRAMES)) > 0) {
+            memcpy(_latest, _batch + (n - 1) * FRAME_SAMPLES * CHANNELS, sizeof(_latest));
+            fresh = true;
+            if (n < READ_FRAMES) {
+                break;
+            }
+        }
+        return fresh;
+    }
+
+    /**
+     * @param ch 0 MIC-L, 1 AEC, 2 MIC-R, 3 MIC-HP
+     */
+    const int16_t* channel(int ch)
+    {
+        pcm_channels::extract(_latest, FRAME_SAMPLES, CHANNELS, ch, _channel);
+        return _channel;
+    }
+
+private:
+    static constexpr int READ_FRAMES = 8;
+
+    int _reader = -1;
+    int16_t _batch[READ_FRAMES * FRAME_SAMPLES * CHANNELS];
+    int16_t _latest[FRAME_SAMPLES * CHANNELS] = {};
+    int16_t _channel[FRAME_SAMPLES];
+};
+
+}  // namespace audio
@@ -0,0 +1,311 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace json {
+
+/**
+ * @brief Incremental SAX-style JSON parser, the document is fed in whatever chunks it arrives in
+ *
+ * Nothing is built: the handler sees every key and value as it completes, so a large document is parsed in the
+ * space of one token. Strings longer than MAX_TOKEN are cut (and still reported). Numbers, true, false and null
+ * are reported as their text. Mismatched brackets, bad escapes and stray characters are errors, anything that
+ * wouldn't mislead the handler is let through rather than validated to the letter.
+ *
+ *     struct Titles : json::SaxParser::Handler {
+ *         void onString(const char* text, size_t len) override { ... }
+ *     } handler;
+ *     json::SaxParser parser(handler);
+ *     parser.feed(chunk, len);    // per HTTP chunk
+ *     bool ok = parser.done();
+ */
+class SaxParser {
+public:
+    static constexpr int MAX_TOKEN = 1024;  // Bytes kept of one string, UTF-8
+    static constexpr int MAX_DEPTH = 16;
+
+    struct Handler {
+        virtual ~Handler() = default;
+        virtual void onObjectStart() {}
+        virtual void onObjectEnd() {}
+        virtual void onArrayStart() {}
+        virtual void onArrayEnd() {}
+        virtual void onKey(const char* key, size_t len) {}
+        virtual void onString(const char* text, size_t len) {}
+        virtual void onScalar(const char* text, size_t len) {}  // Number, true, false or null
+    };
+
+    explicit SaxParser(Handler& handler) : _handler(handler)
+    {
+    }
+
+    /**
+     * @return false once the input is malformed, everything after that is ignored
+     */
+    bool feed(const char* data, size_t len)
+    {
+        for (size_t i = 0; i < len && !_error; i++) {
+            if (!step(data[i])) {
+                _error = true;
+            }
+        }
+        return !_error;
+    }
+
+    /**
+     * @return true once a whole top level value has been parsed without error
+     */
+    bool done() const
+    {
+        return !_error && _complete && !_in_string;
+    }
+
+    bool failed() const
+    {
+        return _error;
+    }
+
+private:
+    enum : uint8_t {
+        NONE,
+        STRING,
+        ESCAPE,
+        UNICODE,  // \uXXXX, _unicode_digits read so far
+        SCALAR,
+    };
+
+    bool step(char c)
+    {
+        switch (_state) {
+            case STRING:
+                if (c == '"') {
+                    end_string();
+                } else if (c == '\\') {
+                    _state = ESCAPE;
+                } else {
+                    append(c);
+                }
+                return true;
+            case ESCAPE:
+                return escape(c);
+            case UNICODE:
+                return unicode(c);
+            case SCALAR:
+                if (is_scalar_char(c)) {
+                    append(c);
+                    return true;
+                }
+                _state = NONE;
+                _handler.onScalar(_token, _token_len);
+                value_done();
+                // The delimiter is parsed on its own
+                break;
+            default:
+                break;
+        }
+        return structural(c);
+    }
+
+    bool structural(char c)
+    {
+        switch (c) {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+            case ':':
+                return true;
+            case ',':
+                _expect_key = _depth > 0 && _stack[_depth - 1] == '{';
+                return _depth > 0;
+            case '{':
+            case '[':
+                if (_depth >= MAX_DEPTH || _complete) {
+                    return false;
+                }
+                _stack[_depth++] = c;
+                _expect_key      = c == '{';
+                if (c == '{') {
+                    _handler.onObjectStart();
+                } else {
+                    _handler.onArrayStart();
+                }
+                return true;
+            case '}':
+            case ']':
+                if (_depth == 0 || _stack[_depth - 1] != (c == '}' ? '{' : '[')) {
+                    return false;
+                }
+                _depth--;
+                if (c == '}') {
+                    _handler.onObjectEnd();
+                } else {
+                    _handler.onArrayEnd();
+                }
+                value_done();
+                return true;
+            case '"':
+                if (_complete) {
+                    return false;
+                }
+                _state     = STRING;
+                _is_key    = _expect_key;
+                _token_len = 0;
+                _in_string = true;
+                return true;
+            default:
+                if (!is_scalar_char(c) || _complete || _expect_key) {
+                    return false;
+                }
+                _state     = SCALAR;
+                _token_len = 0;
+                append(c);
+                return true;
+        }
+    }
+
+    bool escape(char c)
+    {
+        _state = STRING;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                append(c);
+                return true;
+            case 'b':
+                append('\b');
+                return true;
+            case 'f':
+                append('\f');
+                return true;
+            case 'n':
+                append('\n');
+                return true;
+            case 'r':
+                append('\r');
+                return true;
+            case 't':
+                append('\t');
+                return true;
+            case 'u':
+                _state          = UNICODE;
+                _unicode        = 0;
+                _unicode_digits = 0;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool unicode(char c)
+    {
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        _unicode = (_unicode << 4) | digit;
+        if (++_unicode_digits < 4) {
+            return true;
+        }
+        _state = STRING;
+
+        // Surrogate pairs come as two escapes, the high half waits for the low one
+        uint32_t cp = _unicode;
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            _high_surrogate = cp;
+            return true;
+        }
+        if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            if (!_high_surrogate) {
+                return true;
+            }
+            cp              = 0x10000 + ((_high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+            _high_surrogate = 0;
+        }
+        append_utf8(cp);
+        return true;
+    }
+
+    void end_string()
+    {
+        _state          = NONE;
+        _in_string      = false;
+        _high_surrogate = 0;
+        if (_is_key) {
+            _expect_key = false;
+            _handler.onKey(_token, _token_len);
+        } else {
+            _handler.onString(_token, _token_len);
+            value_done();
+        }
+    }
+
+    void value_done()
+    {
+        if (_depth == 0) {
+            _complete = true;
+        }
+    }
+
+    void append(char c)
+    {
+        if (_token_len < MAX_TOKEN) {
+            _token[_token_len++] = c;
+            _token[_token_len]   = '\0';
+        }
+    }
+
+    void append_utf8(uint32_t cp)
+    {
+        if (cp < 0x80) {
+            append((char)cp);
+        } else if (cp < 0x800) {
+            append((char)(0xC0 | (cp >> 6)));
+            append((char)(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            append((char)(0xE0 | (cp >> 12)));
+            append((char)(0x80 | ((cp >> 6) & 0x3F)));
+            append((char)(0x80 | (cp & 0x3F)));
+        } else {
+            append((char)(0xF0 | (cp >> 18)));
+            append((char)(0x80 | ((cp >> 12) & 0x3F)));
+            append((char)(0x80 | ((cp >> 6) & 0x3F)));
+            append((char)(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    static bool is_scalar_char(char c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' ||
+               c == '.';
+    }
+
+    Handler& _handler;
+    char _token[MAX_TOKEN + 1] = {};
+    int _token_len             = 0;
+    char _stack[MAX_DEPTH]     = {};
+    int _depth                 = 0;
+    uint8_t _state             = NONE;
+    bool _expect_key           = false;
+    bool _is_key               = false;
+    bool _in_string            = false;
+    bool _complete             = false;
+    bool _error                = false;
+    uint32_t _unicode          = 0;
+    int _unicode_digits        = 0;
+    uint32_t _high_surrogate   = 0;
+};
+
+}  // namespace json
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "scheduler.h"
+#include <hal/hal.h>
+#include <algorithm>
+
+using namespace scheduler;
+
+// Longest sleep, for apps that aren't ScheduledApp and still rate limit themselves
+static constexpr uint32_t MAX_IDLE_MS = 500;
+// Frame paced this long after the last touch, a scroll throw goes on after the finger is gone
+static constexpr uint32_t INPUT_HOLD_MS = 1000;
+
+static bool s_woken        = false;  // By wake(), for the next update
+static bool s_woken_update = false;  // The update in progress runs every app
+static uint32_t s_idle_ms  = MAX_IDLE_MS;
+
+void ScheduledApp::onRunning()
+{
+    uint32_t now = GetHAL()->millis();
+    if (_scheduled && !s_woken_update && (int32_t)(now - _due_at) < 0) {
+        s_idle_ms = std::min(s_idle_ms, _due_at - now);
+        return;
+    }
+    uint32_t period = onUpdate();
+    _due_at         = now + period;
+    _scheduled      = true;
+    s_idle_ms       = std::min(s_idle_ms, period);
+}
+
+void scheduler::wake()
+{
+    s_woken = true;
+}
+
+void scheduler::begin_update()
+{
+    s_woken_update = s_woken;
+    s_woken        = false;
+    s_idle_ms      = MAX_IDLE_MS;
+}
+
+bool scheduler::input_active()
+{
+    if (s_woken_update) {
+        return true;
+    }
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
+    return lv_display_get_inactive_time(nullptr) < INPUT_HOLD_MS;
+}
+
+uint32_t scheduler::idle_time()
+{
+    // A woken update is followed by a frame paced one, LVGL may not have read the touch that woke it yet
+    if (s_idle_ms == 0 || input_active()) {
+        return 0;
+    }
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
+    if (lv_anim_count_running() > 0) {
+        return 0;
+    }
+    return s_idle_ms;
+}
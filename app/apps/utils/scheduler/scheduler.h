@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <mooncake.h>
+#include <cstdint>
+
+namespace scheduler {
+
+// From onUpdate(): run again on the next panel refresh
+static constexpr uint32_t EVERY_FRAME = 0;
+
+/**
+ * @brief An app that says when it wants to run next, instead of rate limiting its own onRunning()
+ *
+ * mooncake still calls onRunning() on every loop, it's skipped here until the app is due. `onUpdate()` does the work
+ * and returns the ms until it wants to run again, EVERY_FRAME while something on screen moves. A HAL event or touch
+ * input wakes the loop and runs every app straight away, so an app that only reacts to those can ask for a long
+ * period. The loop sleeps until the earliest app is due, see `idle_time()`.
+ *
+ *     uint32_t AppClock::onUpdate()
+ *     {
+ *         update_time_label();
+ *         return 1000;
+ *     }
+ */
+class ScheduledApp : public mooncake::AppAbility {
+public:
+    void onRunning() final;
+
+protected:
+    virtual uint32_t onUpdate() = 0;
+
+private:
+    uint32_t _due_at = 0;
+    bool _scheduled  = false;  // `_due_at` is set, false until the first run
+};
+
+/**
+ * @brief The loop was woken before the idle time was up, every app runs on the next update
+ */
+void wake();
+
+/**
+ * @brief Ahead of GetMooncake().update()
+ */
+void begin_update();
+
+/**
+ * @brief The screen was touched in the last moment, or this update was woken: what a touch started may be due now
+ *
+ * For an app keeping its own rates for parts of its view, a tap on one of them can't wait for its next turn
+ */
+bool input_active();
+
+/**
+ * @brief After the update, how long the loop can sleep before an app is due
+ *
+ * @return 0 to pace the next update by the display: an app asked for EVERY_FRAME, the screen is being touched or LVGL
+ * is animating something
+ */
+uint32_t idle_time();
+
+}  // namespace scheduler
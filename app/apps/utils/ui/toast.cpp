@@ -63,23 +63,48 @@ static ToastColor_t get_toast_color(toast_type::Type_t type)
     return _toast_color_dark;
 }
 
+struct ToastStyle_t {
+    lv_style_t toast;
+    lv_style_t msg;
+    bool ready = false;
+};
+
+// Shared by every toast of the type, built when the first one pops, rather than local styles for each
+static ToastStyle_t& get_toast_style(toast_type::Type_t type)
+{
+    static ToastStyle_t styles[toast_type::dark + 1];
+    auto& style = styles[type];
+    if (!style.ready) {
+        auto toast_color = get_toast_color(type);
+        lv_style_init(&style.toast);
+        lv_style_set_border_width(&style.toast, 1);
+        lv_style_set_border_color(&style.toast, lv_color_hex(toast_color.border));
+        lv_style_set_bg_color(&style.toast, lv_color_hex(toast_color.bg));
+        lv_style_set_radius(&style.toast, 24);
+        lv_style_init(&style.msg);
+        lv_style_set_text_font(&style.msg, &lv_font_montserrat_24);
+        lv_style_set_text_color(&style.msg, lv_color_hex(toast_color.msg));
+        style.ready = true;
+    }
+    return style;
+}
+
 void Toast::init(lv_obj_t* parent)
 {
-    auto toast_color = get_toast_color(config.type);
+    auto& style = get_toast_style(config.type);
 
+    // Laid out once where it's open, the animation only moves and widens what's drawn (see apply_anim())
     _toast = std::make_unique<Container>(parent);
-    _toast->setBorderWidth(1);
-    _toast->setBorderColor(lv_color_hex(toast_color.border));
-    _toast->setBgColor(lv_color_hex(toast_color.bg));
-    _toast->setRadius(24);
+    lv_obj_add_style(_toast->get(), &style.toast, LV_PART_MAIN);
     _toast->setAlign(LV_ALIGN_TOP_MID);
+    _toast->setPos(_toast_x, _toast_kf_opened.y);
+    _toast->setSize(_toast_kf_opened.w, _toast_h);
     _toast->removeFlag(LV_OBJ_FLAG_SCROLLABLE);
     _toast->onClick().connect([&]() { close(); });
 
     _msg_label = std::make_unique<Label>(_toast->get());
-    _msg_label->setTextFont(&lv_font_montserrat_24);
+    lv_obj_add_style(_msg_label->get(), &style.msg, LV_PART_MAIN);
     _msg_label->setText(config.msg);
-    _msg_label->setTextColor(lv_color_hex(toast_color.msg));
     _msg_label->align(LV_ALIGN_CENTER, 0, 0);
     if (_msg_label->getWidth() > 580) {
         _msg_label->setWidth(580);
@@ -97,11 +122,8 @@ void Toast::init(lv_obj_t* parent)
 void Toast::update()
 {
     // Apply animation
-    if (!_anim_y.done()) {
-        _toast->setPos(_toast_x, _anim_y);
-    }
-    if (!_anim_w.done()) {
-        _toast->setSize(_anim_w, _toast_h);
+    if (!(_anim_y.done() && _anim_w.done())) {
+        apply_anim();
     }
 
     // Update state
@@ -153,15 +175,24 @@ void Toast::update_anim(const KeyFrame_t& target, bool teleport)
     if (teleport) {
         _anim_y.teleport(target.y);
         _anim_w.teleport(target.w);
-
-        _toast->setPos(_toast_x, _anim_y);
-        _toast->setSize(_anim_w, _toast_h);
+        apply_anim();
     } else {
         _anim_y = target.y;
         _anim_w = target.w;
     }
 }
 
+void Toast::apply_anim()
+{
+    // Style transforms off the open layout, rather than setPos()/setSize(): the translation moves the toast with its
+    // label, the transform width only widens the background drawn on both sides of it (it stays centred, like the
+    // size it stands for would). Neither lays out the label again or resizes anything
+    int32_t y = _anim_y;
+    int32_t w = _anim_w;
+    lv_obj_set_style_translate_y(_toast->get(), y - _toast_kf_opened.y, LV_PART_MAIN);
+    lv_obj_set_style_transform_width(_toast->get(), (w - _toast_kf_opened.w) / 2, LV_PART_MAIN);
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                Toast Manager                               */
 /* -------------------------------------------------------------------------- */
@@ -176,7 +207,7 @@ void ToastManager::onCreate()
 
 void ToastManager::onRunning()
 {
-    LvglLockGuard lock;
+    LvglLockGuard lock(hal::HalBase::LVGL_LOCK_APP_UPDATE);
 
     // Handle toast request
     if (!_toast_request_queue.empty()) {
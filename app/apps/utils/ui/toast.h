@@ -76,6 +76,7 @@ protected:
     smooth_ui_toolkit::AnimateValue _anim_w;
 
     void update_anim(const KeyFrame_t& target, bool teleport);
+    void apply_anim();
 };
 
 class ToastManager : public mooncake::BasicAbility {
@@ -9,6 +9,7 @@
 #include <smooth_ui_toolkit.h>
 #include <smooth_lvgl.h>
 #include <apps/utils/audio/audio.h>
+#include <algorithm>
 
 using namespace ui;
 using namespace smooth_ui_toolkit;
@@ -23,8 +24,13 @@ smooth_ui_toolkit::Signal<bool>& ui::signal_window_opened()
 
 void Window::init(lv_obj_t* parent)
 {
+    // Laid out once where it's open, the animation only transforms it (see apply_anim())
     _window = std::make_unique<Container>(parent);
     _window->setAlign(LV_ALIGN_CENTER);
+    _window->setPos(config.kfOpened.x, config.kfOpened.y);
+    _window->setSize(config.kfOpened.w, config.kfOpened.h);
+    lv_obj_set_style_transform_pivot_x(_window->get(), config.kfOpened.w / 2, LV_PART_MAIN);
+    lv_obj_set_style_transform_pivot_y(_window->get(), config.kfOpened.h / 2, LV_PART_MAIN);
     _window->setPadding(0, 0, 0, 0);
     _window->setRadius(24);
     _window->setBorderWidth(1);
@@ -90,14 +96,8 @@ void Window::init(lv_obj_t* parent)
 void Window::update()
 {
     // Apply animation
-    if (!(_anim_x.done() && _anim_y.done())) {
-        _window->setPos(_anim_x, _anim_y);
-    }
-    if (!(_anim_w.done() && _anim_h.done())) {
-        _window->setSize(_anim_w, _anim_h);
-    }
-    if (!_anim_opa.done()) {
-        _window->setOpa(_anim_opa);
+    if (!(_anim_x.done() && _anim_y.done() && _anim_w.done() && _anim_h.done() && _anim_opa.done())) {
+        apply_anim();
     }
 
     // Update state
@@ -164,10 +164,7 @@ void Window::update_anim(const KeyFrame_t& target, bool teleport)
         _anim_w.teleport(target.w);
         _anim_h.teleport(target.h);
         _anim_opa.teleport(target.opa);
-
-        _window->setPos(_anim_x, _anim_y);
-        _window->setSize(_anim_w, _anim_h);
-        _window->setOpa(_anim_opa);
+        apply_anim();
     } else {
         _anim_x   = target.x;
         _anim_y   = target.y;
@@ -176,3 +173,25 @@ void Window::update_anim(const KeyFrame_t& target, bool teleport)
         _anim_opa = target.opa;
     }
 }
+
+static int32_t anim_scale(int32_t size, int32_t opened)
+{
+    if (size == opened || opened <= 0) {
+        return LV_SCALE_NONE;
+    }
+    return std::max<int32_t>(size * LV_SCALE_NONE / opened, 1);
+}
+
+void Window::apply_anim()
+{
+    // Style transforms off the open layout, rather than setPos()/setSize(): a resize would lay out the panel's
+    // content again on every frame. Scaled, the window is rendered into a layer and blitted at its size, as it
+    // already was for the fade, content and all, and it's back to drawing straight once the animation is done
+    int32_t x = _anim_x;
+    int32_t y = _anim_y;
+    lv_obj_set_style_translate_x(_window->get(), x - config.kfOpened.x, LV_PART_MAIN);
+    lv_obj_set_style_translate_y(_window->get(), y - config.kfOpened.y, LV_PART_MAIN);
+    lv_obj_set_style_transform_scale_x(_window->get(), anim_scale(_anim_w, config.kfOpened.w), LV_PART_MAIN);
+    lv_obj_set_style_transform_scale_y(_window->get(), anim_scale(_anim_h, config.kfOpened.h), LV_PART_MAIN);
+    _window->setOpa(_anim_opa);
+}
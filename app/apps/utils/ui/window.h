@@ -90,6 +90,7 @@ protected:
     State_t _state = Closed;
 
     void update_anim(const KeyFrame_t& target, bool teleport);
+    void apply_anim();
 };
 
 /**
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025
+#
+# SPDX-License-Identifier: MIT
+"""
+Turn an LVGL 9 RGB565 image C array of one ink on a plain background into an A8 (alpha only) one.
+
+Half the bytes, and LVGL draws it as a fill of the ink color through the image as a mask, rather than a blend of its
+pixels. The ink is the image's `image_recolor` with `image_recolor_opa` LV_OPA_COVER, the background comes from what
+it's drawn on. Refused unless the A8 image over the background is within TOLERANCE of every pixel.
+
+    python3 alpha_image.py images/logo_tab.c images/logo_tab.c
+    images/logo_tab.c: 180x80, 28800 -> 14400 bytes, ink 0x392C29 on 0xFFFFFF, max error 9
+"""
+import re
+import sys
+from collections import Counter
+
+from pack_image import parse_c_image
+
+TOLERANCE = 10  # Per 8-bit channel, a step of RGB565's 5-bit red or blue is 8
+
+
+def rgb888(c):
+    return (c >> 11 & 0x1F) * 255 // 31, (c >> 5 & 0x3F) * 255 // 63, (c & 0x1F) * 255 // 31
+
+
+def to_alpha(colors):
+    """The most common color is the background, the one furthest from it the ink"""
+    bg = rgb888(Counter(colors).most_common(1)[0][0])
+    ink = max((rgb888(c) for c in set(colors)), key=lambda c: sum((c[i] - bg[i]) ** 2 for i in range(3)))
+    span = [ink[i] - bg[i] for i in range(3)]
+    norm = sum(s * s for s in span)
+    if norm == 0:
+        raise SystemExit("the image is one color")
+
+    alpha = bytearray()
+    worst = 0
+    for c in colors:
+        c = rgb888(c)
+        a = round(255 * sum((c[i] - bg[i]) * span[i] for i in range(3)) / norm)
+        a = min(max(a, 0), 255)
+        alpha.append(a)
+        worst = max(worst, max(abs(bg[i] + span[i] * a // 255 - c[i]) for i in range(3)))
+    return bytes(alpha), bg, ink, worst
+
+
+def c_image(name, w, h, alpha):
+    rows = ",\n".join("  " + ", ".join("0x%02x" % b for b in alpha[y * w:(y + 1) * w]) for y in range(h))
+    attribute = "LV_ATTRIBUTE_IMAGE_" + name.upper()
+    return ("#ifdef __has_include\n"
+            "    #if __has_include(\"lvgl.h\")\n"
+            "        #ifndef LV_LVGL_H_INCLUDE_SIMPLE\n"
+            "            #define LV_LVGL_H_INCLUDE_SIMPLE\n"
+            "        #endif\n"
+            "    #endif\n"
+            "#endif\n\n"
+            "#if defined(LV_LVGL_H_INCLUDE_SIMPLE)\n"
+            "    #include \"lvgl.h\"\n"
+            "#else\n"
+            "    #include \"lvgl/lvgl.h\"\n"
+            "#endif\n\n\n"
+            "#ifndef LV_ATTRIBUTE_MEM_ALIGN\n"
+            "#define LV_ATTRIBUTE_MEM_ALIGN\n"
+            "#endif\n\n"
+            "#ifndef %s\n"
+            "#define %s\n"
+            "#endif\n\n"
+            "const LV_ATTRIBUTE_MEM_ALIGN LV_ATTRIBUTE_LARGE_CONST %s uint8_t %s_map[] = {\n"
+            "%s\n"
+            "};\n\n"
+            "const lv_image_dsc_t %s = {\n"
+            "  .header.cf = LV_COLOR_FORMAT_A8,\n"
+            "  .header.magic = LV_IMAGE_HEADER_MAGIC,\n"
+            "  .header.w = %d,\n"
+            "  .header.h = %d,\n"
+            "  .data_size = %d,\n"
+            "  .data = %s_map,\n"
+            "};\n") % (attribute, attribute, attribute, name, rows, name, w, h, len(alpha), name)
+
+
+def main():
+    if len(sys.argv) != 3:
+        raise SystemExit(__doc__)
+    with open(sys.argv[1]) as f:
+        text = f.read()
+    name = re.search(r"const lv_image_dsc_t (\w+)\s*=", text).group(1)
+    cf, w, h, stride, pixels = parse_c_image(text)
+    colors = [pixels[i] | pixels[i + 1] << 8 for i in range(0, len(pixels), 2)]
+    alpha, bg, ink, worst = to_alpha(colors)
+    if worst > TOLERANCE:
+        raise SystemExit("%s isn't one ink on a background, off by up to %d" % (sys.argv[1], worst))
+    with open(sys.argv[2], "w") as f:
+        f.write(c_image(name, w, h, alpha))
+    print("%s: %dx%d, %d -> %d bytes, ink 0x%02X%02X%02X on 0x%02X%02X%02X, max error %d" %
+          (sys.argv[2], w, h, len(pixels), len(alpha), *ink, *bg, worst))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,28 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "assets.h"
+#include <hal/hal.h>
+
+std::string assets::image_path(const char* name)
+{
+    std::string dir = GetHAL()->getAssetDir();
+    return dir.empty() ? "" : dir + name;
+}
+
+void assets::set_image(lv_obj_t* image, const char* name)
+{
+    // LVGL copies a file source, the path doesn't have to outlive the call
+    std::string path = image_path(name);
+    lv_image_set_src(image, path.empty() ? nullptr : path.c_str());
+}
+
+void assets::release_image(const char* name)
+{
+    std::string path = image_path(name);
+    if (!path.empty()) {
+        lv_image_cache_drop(path.c_str());
+    }
+}
@@ -5,8 +5,8 @@
  */
 #pragma once
 #include <lvgl.h>
+#include <string>
 
-LV_IMG_DECLARE(launcher_bg);
 LV_IMG_DECLARE(sw_chg_off);
 LV_IMG_DECLARE(sw_chg_on);
 LV_IMG_DECLARE(sw_off);
@@ -17,10 +17,31 @@ LV_IMG_DECLARE(sw_rf_h);
 LV_IMG_DECLARE(sw_rf_l);
 LV_IMG_DECLARE(arrow_state_on);
 LV_IMG_DECLARE(mouse_cursor);
-LV_IMG_DECLARE(internal_i2c_dev_chart);
-LV_IMG_DECLARE(porta_i2c_dev_chart);
 LV_IMG_DECLARE(porta_i2c_ext5v_on);
 LV_IMG_DECLARE(logo_tab);
 LV_IMG_DECLARE(logo_5);
 LV_IMG_DECLARE(chg_arrow_down);
 LV_IMG_DECLARE(chg_arrow_up);
+
+/**
+ * @brief Large images are packed (LZ4 RGB565, pack_image.py) into the asset partition instead of the firmware
+ *
+ * LVGL reads one from HalBase::getAssetDir() and decompresses it into its image cache on first draw, later draws use
+ * the cached pixels until they are evicted or released.
+ */
+namespace assets {
+
+inline constexpr const char* LAUNCHER_BG            = "launcher_bg.bin";
+inline constexpr const char* INTERNAL_I2C_DEV_CHART = "internal_i2c_dev_chart.bin";
+inline constexpr const char* PORTA_I2C_DEV_CHART    = "porta_i2c_dev_chart.bin";
+
+// LVGL file path of a packed image, empty if there is no asset partition
+std::string image_path(const char* name);
+
+// Show a packed image, or nothing when the assets are missing
+void set_image(lv_obj_t* image, const char* name);
+
+// Drop a packed image's decoded pixels from the cache, for a screen that is going away
+void release_image(const char* name);
+
+}  // namespace assets
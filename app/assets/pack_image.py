@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025
+#
+# SPDX-License-Identifier: MIT
+"""
+Turn an LVGL 9 RGB565 image C array into an LZ4-compressed LVGL .bin image for the asset partition.
+
+The firmware no longer links large images, LVGL reads the .bin through its file system driver and decompresses it
+into the image cache on first draw (LV_USE_LZ4_INTERNAL).
+
+    python3 pack_image.py images/launcher_bg.c bin/launcher_bg.bin
+"""
+import re
+import struct
+import sys
+
+LV_IMAGE_HEADER_MAGIC = 0x19
+LV_IMAGE_FLAGS_COMPRESSED = 0x0008
+LV_IMAGE_COMPRESS_LZ4 = 2
+COLOR_FORMATS = {"LV_COLOR_FORMAT_RGB565": (0x12, 2)}
+
+MIN_MATCH = 4
+LAST_LITERALS = 5     # The block format wants the last bytes as literals
+MATCH_LIMIT = 12      # and no match starting this close to the end
+MAX_OFFSET = 0xFFFF
+
+
+def parse_c_image(text):
+    fields = dict(re.findall(r"\.header\.(\w+)\s*=\s*(\w+)", text))
+    if fields.get("cf") not in COLOR_FORMATS:
+        raise SystemExit("only RGB565 images are supported, got %s" % fields.get("cf"))
+    body = re.search(r"_map\[\]\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    pixels = bytes(int(b, 16) for b in re.findall(r"0x([0-9a-fA-F]{2})", body))
+    cf, bpp = COLOR_FORMATS[fields["cf"]]
+    w, h = int(fields["w"]), int(fields["h"])
+    if len(pixels) != w * h * bpp:
+        raise SystemExit("expected %d bytes of pixels, got %d" % (w * h * bpp, len(pixels)))
+    return cf, w, h, w * bpp, pixels
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def lz4_compress(src):
+    """Greedy LZ4 block compressor, hashing 4-byte sequences"""
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    end = len(src)
+    limit = end - MATCH_LIMIT
+    while i < limit:
+        key = src[i:i + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = i
+        if ref is None or i - ref > MAX_OFFSET:
+            i += 1
+            continue
+        n = MIN_MATCH
+        while i + n < end - LAST_LITERALS and src[ref + n] == src[i + n]:
+            n += 1
+        literals = i - anchor
+        ml = n - MIN_MATCH
+        out.append((min(literals, 15) << 4) | min(ml, 15))
+        if literals >= 15:
+            _length(out, literals - 15)
+        out += src[anchor:i]
+        out += struct.pack("<H", i - ref)
+        if ml >= 15:
+            _length(out, ml - 15)
+        i += n
+        anchor = i
+    literals = end - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        _length(out, literals - 15)
+    out += src[anchor:]
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        raise SystemExit(__doc__)
+    with open(sys.argv[1]) as f:
+        cf, w, h, stride, pixels = parse_c_image(f.read())
+    packed = lz4_compress(pixels)
+    with open(sys.argv[2], "wb") as f:
+        # lv_image_header_t, then lv_image_compressed_t's method and sizes, then the data
+        f.write(struct.pack("<BBHHHHH", LV_IMAGE_HEADER_MAGIC, cf, LV_IMAGE_FLAGS_COMPRESSED, w, h, stride, 0))
+        f.write(struct.pack("<III", LV_IMAGE_COMPRESS_LZ4, len(packed), len(pixels)))
+        f.write(packed)
+    print("%s: %dx%d, %d -> %d bytes" % (sys.argv[2], w, h, len(pixels), len(packed)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "hot_path.h"
+
+/**
+ * @brief Fixed pool of 48 kHz stereo voices summed onto whatever the output is playing
+ *
+ * Every voice owns a slice of one sample pool handed over at `init()`, starting a sound copies (or renders) into
+ * that slice, so nothing is allocated per sound. Any task may start voices, only the task currently writing the
+ * output calls `mix()`. A sound that finds every voice busy is dropped, a sound longer than a voice is cut.
+ *
+ *     mixer.init(pool, 24000);                  // pool: MAX_VOICES * 24000 stereo frames
+ *     mixer.play(click.data(), click.size() / 2);
+ *     mixer.mix(block, frames, volume);         // output side, adds onto `block`
+ */
+class AudioMixer {
+public:
+    static constexpr int MAX_VOICES  = 6;
+    static constexpr int SAMPLE_RATE = 48000;
+
+    /**
+     * @param pool MAX_VOICES * voiceFrames interleaved stereo frames, kept by the mixer from now on
+     */
+    void init(int16_t* pool, int voiceFrames)
+    {
+        _pool         = pool;
+        _voice_frames = voiceFrames;
+        for (auto& voice : _voices) {
+            voice.state.store(FREE);
+        }
+    }
+
+    bool ready() const
+    {
+        return _pool != nullptr;
+    }
+
+    int voiceFrames() const
+    {
+        return _voice_frames;
+    }
+
+    /**
+     * @brief Reserve a free voice to render into `buffer(voice)`, then `commit()` it
+     * @return the voice, or -1 if all are busy
+     */
+    int acquire()
+    {
+        if (!_pool) {
+            return -1;
+        }
+        for (int i = 0; i < MAX_VOICES; i++) {
+            uint8_t expected = FREE;
+            if (_voices[i].state.compare_exchange_strong(expected, LOADING, std::memory_order_acquire)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int16_t* buffer(int voice)
+    {
+        return _pool + (size_t)voice * _voice_frames * 2;
+    }
+
+    /**
+     * @brief Start an acquired voice playing its first `frames` frames
+     */
+    void commit(int voice, int frames, float gain = 1.0f)
+    {
+        Voice_t& v = _voices[voice];
+        v.frames   = std::min(frames, _voice_frames);
+        v.pos      = 0;
+        v.gain     = (int32_t)(std::min(std::max(gain, 0.0f), 1.0f) * 32768.0f);
+        v.state.store(PLAYING, std::memory_order_release);
+    }
+
+    /**
+     * @param pcm interleaved stereo
+     * @return the voice, or -1 if the sound was dropped
+     */
+    int play(const int16_t* pcm, int frames, float gain = 1.0f)
+    {
+        int voice = acquire();
+        if (voice < 0) {
+            return -1;
+        }
+        frames = std::min(frames, _voice_frames);
+        memcpy(buffer(voice), pcm, (size_t)frames * 2 * sizeof(int16_t));
+        commit(voice, frames, gain);
+        return voice;
+    }
+
+    /**
+     * @brief Ends the voice at the next `mix()`
+     */
+    void stop(int voice)
+    {
+        uint8_t expected = PLAYING;
+        _voices[voice].state.compare_exchange_strong(expected, STOPPING);
+    }
+
+    void stopAll()
+    {
+        for (int i = 0; i < MAX_VOICES; i++) {
+            stop(i);
+        }
+    }
+
+    bool playing(int voice) const
+    {
+        return _voices[voice].state.load(std::memory_order_acquire) != FREE;
+    }
+
+    /**
+     * @return true while any voice is playing or about to
+     */
+    bool active() const
+    {
+        for (const auto& voice : _voices) {
+            if (voice.state.load(std::memory_order_acquire) != FREE) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Add every playing voice onto `out` with saturation, finished voices are freed
+     * @param out interleaved stereo at SAMPLE_RATE
+     * @param gain applied on top of each voice's own, 0..1
+     * @return voices mixed
+     */
+    HOT_PATH int mix(int16_t* out, int frames, float gain = 1.0f)
+    {
+        int32_t master = (int32_t)(std::min(std::max(gain, 0.0f), 1.0f) * 32768.0f);
+        int mixed      = 0;
+        for (int i = 0; i < MAX_VOICES; i++) {
+            Voice_t& v    = _voices[i];
+            uint8_t state = v.state.load(std::memory_order_acquire);
+            if (state == STOPPING) {
+                v.state.store(FREE, std::memory_order_release);
+                continue;
+            }
+            if (state != PLAYING) {
+                continue;
+            }
+
+            const int16_t* src = buffer(i) + (size_t)v.pos * 2;
+            int n              = std::min(frames, v.frames - v.pos);
+            int32_t g          = (int32_t)(((int64_t)v.gain * master) >> 15);
+            for (int s = 0; s < n * 2; s++) {
+                int32_t sample = out[s] + ((src[s] * g) >> 15);
+                out[s]         = (int16_t)std::min(std::max(sample, (int32_t)-32768), (int32_t)32767);
+            }
+            v.pos += n;
+            mixed++;
+            if (v.pos >= v.frames) {
+                v.state.store(FREE, std::memory_order_release);
+            }
+        }
+        return mixed;
+    }
+
+private:
+    enum : uint8_t {
+        FREE,
+        LOADING,   // Acquired, the producer is filling the buffer
+        PLAYING,
+        STOPPING,  // Stopped while playing, freed by the output side
+    };
+
+    struct Voice_t {
+        std::atomic<uint8_t> state{FREE};
+        int frames   = 0;
+        int pos      = 0;  // Owned by the output side while playing
+        int32_t gain = 0;  // Q15
+    };
+
+    int16_t* _pool    = nullptr;
+    int _voice_frames = 0;
+    Voice_t _voices[MAX_VOICES];
+};
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+
+/**
+ * @brief Fixed-size lock-free single-producer/single-consumer byte ring
+ *
+ * For the small byte streams between a driver task and the UI, where a `std::queue` behind a mutex would push and
+ * lock per byte. Head and tail are free-running counters, so CAPACITY has to be a power of two and a read or write is
+ * at most two memcpy segments. Only one task may write and only one task may read; a write that finds the ring full
+ * keeps what fits and drops the rest.
+ *
+ *     ByteRing<4096> rx;
+ *     rx.write(data, len);                 // Driver task
+ *     n = rx.read(buf, sizeof(buf));       // UI
+ *
+ * The peek/commit pairs expose the next contiguous span, for a driver to read into or send from in place:
+ *
+ *     uint8_t* span;
+ *     size_t n = rx.peekWrite(&span);      // Producer: fill up to n bytes at span
+ *     rx.commitWrite(filled);
+ */
+template <size_t CAPACITY>
+class ByteRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    // @return bytes written, fewer than `len` when full
+    size_t write(const uint8_t* data, size_t len)
+    {
+        size_t total = 0;
+        uint8_t* span;
+        size_t n;
+        while (total < len && (n = peekWrite(&span)) > 0) {
+            n = n < len - total ? n : len - total;
+            memcpy(span, data + total, n);
+            commitWrite(n);
+            total += n;
+        }
+        return total;
+    }
+
+    // @return bytes read, 0 once empty
+    size_t read(uint8_t* data, size_t len)
+    {
+        size_t total = 0;
+        const uint8_t* span;
+        size_t n;
+        while (total < len && (n = peekRead(&span)) > 0) {
+            n = n < len - total ? n : len - total;
+            memcpy(data + total, span, n);
+            commitRead(n);
+            total += n;
+        }
+        return total;
+    }
+
+    // Free space up to the end of the storage, producer only
+    size_t peekWrite(uint8_t** span)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t room = CAPACITY - (head - _tail.load(std::memory_order_acquire));
+        size_t edge = CAPACITY - (head & (CAPACITY - 1));
+        *span       = &_data[head & (CAPACITY - 1)];
+        return room < edge ? room : edge;
+    }
+
+    void commitWrite(size_t len)
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    // Unread bytes up to the end of the storage, consumer only
+    size_t peekRead(const uint8_t** span)
+    {
+        size_t tail      = _tail.load(std::memory_order_relaxed);
+        size_t available = _head.load(std::memory_order_acquire) - tail;
+        size_t edge      = CAPACITY - (tail & (CAPACITY - 1));
+        *span            = &_data[tail & (CAPACITY - 1)];
+        return available < edge ? available : edge;
+    }
+
+    void commitRead(size_t len)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    uint8_t _data[CAPACITY];
+    std::atomic<size_t> _head{0};  // Written so far, the producer's
+    std::atomic<size_t> _tail{0};  // Read so far, the consumer's
+};
@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * @brief History of a sampled signal at three resolutions: min, max and mean per second, per minute and per hour
+ *
+ * Each tier keeps its last POINTS points, that's 2 minutes at 1 s, 2 hours at 1 min and 5 days at 1 h, in under 5 KB.
+ * A sample goes into the open second only; a second that closes goes into the open minute, a minute into the open
+ * hour, so adding is the same few compares whatever the history holds. A gap in the samples leaves no points, the
+ * tiers don't pretend to know what happened meanwhile.
+ *
+ * A chart showing a span picks the finest tier that covers it in no more points than it has pixels, 24 hours costs it
+ * 24 points just like the last minute costs 60:
+ *
+ *     auto tier = DecimationRing::tierFor(24 * 60 * 60 * 1000, 300);
+ *     DecimationRing::Point_t points[DecimationRing::POINTS];
+ *     int n = ring.read(tier, points, DecimationRing::spanPoints(tier, 24 * 60 * 60 * 1000));
+ *
+ * Not thread safe, the owner locks around it.
+ */
+class DecimationRing {
+public:
+    enum Tier_t { SECONDS = 0, MINUTES, HOURS, TIER_COUNT };
+    static constexpr int POINTS = 120;
+
+    struct Point_t {
+        float min  = 0.0f;
+        float max  = 0.0f;
+        float mean = 0.0f;
+    };
+
+    static constexpr int64_t tierMs(Tier_t tier)
+    {
+        return tier == SECONDS ? 1000 : tier == MINUTES ? 60 * 1000 : 60 * 60 * 1000;
+    }
+
+    // Points of `tier` a span of `spanMs` takes, at most POINTS
+    static int spanPoints(Tier_t tier, int64_t spanMs)
+    {
+        return (int)std::min<int64_t>((spanMs + tierMs(tier) - 1) / tierMs(tier), POINTS);
+    }
+
+    // The finest tier showing `spanMs` in at most `pixels` points, the coarsest if none does
+    static Tier_t tierFor(int64_t spanMs, int pixels)
+    {
+        for (int tier = SECONDS; tier < HOURS; tier++) {
+            int64_t needed = (spanMs + tierMs((Tier_t)tier) - 1) / tierMs((Tier_t)tier);
+            if (needed <= std::min(pixels, POINTS)) {
+                return (Tier_t)tier;
+            }
+        }
+        return HOURS;
+    }
+
+    void add(float value, int64_t nowMs)
+    {
+        add(SECONDS, value, value, value, 1, nowMs);
+    }
+
+    /**
+     * @brief The newest `count` closed points of `tier`, oldest first, or fewer if there aren't that many yet
+     *
+     * @return the number of points written
+     */
+    int read(Tier_t tier, Point_t* points, int count) const
+    {
+        const auto& t  = _tiers[tier];
+        int n          = (int)std::min<uint32_t>(std::max(count, 0), std::min<uint32_t>(t.written, POINTS));
+        uint32_t first = t.written - n;
+        for (int i = 0; i < n; i++) {
+            points[i] = t.ring[(first + i) % POINTS];
+        }
+        return n;
+    }
+
+private:
+    struct Tier {
+        Point_t ring[POINTS];
+        uint32_t written = 0;  // The newest closed point is at (written - 1) % POINTS
+        int64_t bucket   = -1;  // Of the open point, in tierMs() since boot, -1 before the first sample
+        float min        = 0.0f;
+        float max        = 0.0f;
+        double sum       = 0.0;  // Of the samples, the mean is weighted by them
+        uint32_t samples = 0;
+    };
+    Tier _tiers[TIER_COUNT];
+
+    void add(int tier, float min, float max, float mean, uint32_t samples, int64_t nowMs)
+    {
+        auto& t        = _tiers[tier];
+        int64_t bucket = nowMs / tierMs((Tier_t)tier);
+        if (t.bucket != bucket) {
+            close(tier);
+            t.bucket  = bucket;
+            t.min     = min;
+            t.max     = max;
+            t.sum     = 0.0;
+            t.samples = 0;
+        }
+        t.min = std::min(t.min, min);
+        t.max = std::max(t.max, max);
+        t.sum += (double)mean * samples;
+        t.samples += samples;
+    }
+
+    // The open point of `tier` is done, into its ring and on into the next tier
+    void close(int tier)
+    {
+        auto& t = _tiers[tier];
+        if (t.samples == 0) {
+            return;
+        }
+        Point_t point;
+        point.min  = t.min;
+        point.max  = t.max;
+        point.mean = (float)(t.sum / t.samples);
+        t.ring[t.written % POINTS] = point;
+        t.written++;
+        if (tier + 1 < TIER_COUNT) {
+            // Dated by its own start, a late sample doesn't push a second into the next minute
+            add(tier + 1, point.min, point.max, point.mean, t.samples, t.bucket * tierMs((Tier_t)tier));
+        }
+    }
+};
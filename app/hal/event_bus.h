@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Fan-out of small events to a few subscribers, each with its own bounded lock-free queue
+ *
+ * Any task may post, a post never blocks and never allocates: each queue is a fixed ring whose slots are claimed
+ * with one compare-and-swap, so the WiFi event task, the stream tasks and the UI can post at once. Only the
+ * subscriber's own task polls its queue. A subscriber that falls CAPACITY events behind loses the queue's contents
+ * and is handed `resync` next, the event telling it to re-read the state instead of replaying changes. A new
+ * subscriber starts with `resync` too, so it picks up the current state the same way.
+ *
+ *     static EventBus<Event_t, 32, 4> s_bus(Event_t{EVENT_RESYNC});
+ *     int id = s_bus.subscribe();
+ *     s_bus.post(event);                          // From any task
+ *     while (s_bus.poll(id, &event)) { ... }      // Subscriber's own task
+ */
+template <typename T, int CAPACITY, int MAX_SUBSCRIBERS>
+class EventBus {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    explicit EventBus(const T& resync) : _resync(resync)
+    {
+        for (auto& queue : _queues) {
+            for (uint32_t i = 0; i < CAPACITY; i++) {
+                queue.slots[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @return subscriber id, -1 if all MAX_SUBSCRIBERS are taken
+     */
+    int subscribe()
+    {
+        for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+            bool used = false;
+            if (_queues[i].used.compare_exchange_strong(used, true, std::memory_order_acq_rel)) {
+                // Whatever an earlier subscriber left in it goes with the first resync
+                _queues[i].lost.store(true, std::memory_order_release);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void unsubscribe(int id)
+    {
+        if (id >= 0 && id < MAX_SUBSCRIBERS) {
+            _queues[id].used.store(false, std::memory_order_release);
+        }
+    }
+
+    void post(const T& event)
+    {
+        for (auto& queue : _queues) {
+            if (queue.used.load(std::memory_order_acquire) && !push(queue, event)) {
+                queue.lost.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    /**
+     * @return false once the subscriber's queue is empty
+     */
+    bool poll(int id, T* event)
+    {
+        if (id < 0 || id >= MAX_SUBSCRIBERS || !_queues[id].used.load(std::memory_order_acquire)) {
+            return false;
+        }
+        Queue_t& queue = _queues[id];
+        if (queue.lost.exchange(false, std::memory_order_acq_rel)) {
+            T dropped;
+            while (pop(queue, &dropped)) {
+            }
+            *event = _resync;
+            return true;
+        }
+        return pop(queue, event);
+    }
+
+private:
+    // Each slot's sequence tells whose turn it is: equal to the write position when free, one past it once written
+    struct Slot_t {
+        std::atomic<uint32_t> seq;
+        T event;
+    };
+    struct Queue_t {
+        Slot_t slots[CAPACITY];
+        std::atomic<uint32_t> tail{0};  // Next write, claimed by the producers
+        uint32_t head = 0;              // Next read, the subscriber's alone
+        std::atomic<bool> used{false};
+        std::atomic<bool> lost{false};  // Events were dropped, `resync` is next
+    };
+
+    static bool push(Queue_t& queue, const T& event)
+    {
+        uint32_t pos = queue.tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot_t& slot = queue.slots[pos % CAPACITY];
+            int32_t diff = (int32_t)(slot.seq.load(std::memory_order_acquire) - pos);
+            if (diff < 0) {
+                return false;  // Full, the subscriber hasn't read this slot yet
+            }
+            if (diff == 0) {
+                if (queue.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.event = event;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else {
+                pos = queue.tail.load(std::memory_order_relaxed);  // Another producer got there first
+            }
+        }
+    }
+
+    static bool pop(Queue_t& queue, T* event)
+    {
+        Slot_t& slot = queue.slots[queue.head % CAPACITY];
+        if (slot.seq.load(std::memory_order_acquire) != queue.head + 1) {
+            return false;  // Empty, or its producer is still writing
+        }
+        *event = slot.event;
+        slot.seq.store(queue.head + CAPACITY, std::memory_order_release);
+        queue.head++;
+        return true;
+    }
+
+    Queue_t _queues[MAX_SUBSCRIBERS];
+    const T _resync;
+};
@@ -5,12 +5,19 @@
  */
 #pragma once
 #include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <memory>
 #include <queue>
 #include <string>
 #include <lvgl.h>
 #include <mutex>
 #include <vector>
+#include "audio_mixer.h"
+#include "byte_ring.h"
+#include "decimation_ring.h"
+#include "inline_string.h"
+#include "snapshot.h"
 
 /**
  * @brief Hardware abstraction layer
@@ -56,6 +63,97 @@ public:
     {
         return 0.0f;
     }
+    /**
+     * @brief For work that blocks (I/O, a HAL call that waits), runs `job` off the UI thread and returns straight away
+     *
+     * One of a few HAL workers takes it, jobs queue while they're all busy. `done` then runs on the LVGL thread with
+     * the LVGL lock held, to show the result: keep it short, and check that what it touches is still there.
+     */
+    virtual void runInBackground(std::function<void()> job, std::function<void()> done = nullptr)
+    {
+        job();
+        if (done) {
+            done();
+        }
+    }
+    struct PerfTask_t {
+        std::string name;
+        int core         = -1;  // -1: not pinned
+        float cpuPercent = 0;   // Of one core
+    };
+    struct PerfLock_t {
+        std::string site;  // Who took the LVGL lock, see LvglLockSite_t
+        float holdsPerSecond = 0;
+        float heldPercent    = 0;  // Of the time since the last sample
+        float waitMaxMs      = 0;  // Longest it waited for the lock, and held it, since the last sample
+        float holdMaxMs      = 0;
+    };
+    struct PerfStats_t {
+        uint32_t sampledAtMs    = 0;    // 0 until the first sample
+        float fps               = 0;    // Frames LVGL rendered, idle frames don't count
+        float renderMs          = 0;    // Per rendered frame, without the flushes
+        float flushMs           = 0;    // Per rendered frame, in the flush callbacks
+        float redrawPercent     = 0;    // Of the screen invalidated per rendered frame, overlaps count twice
+        float redrawAreas       = 0;    // Invalidated areas per rendered frame
+        float touchLatencyMs    = 0;    // Touch sample to the end of the first frame flushed after it, 0: no touch
+        float touchLatencyMaxMs = 0;
+        float i2cBusyPercent    = 0;    // Of the internal I2C bus, held by the drivers that poll it
+        float i2cTouchWaitMaxMs = 0;    // Longest the touch task waited for the bus
+        int bufferPercent       = -1;   // Stream ring buffer fill, -1 while not streaming
+        uint32_t underruns      = 0;    // Since boot, see RadioOutputStats_t
+        size_t internalFree     = 0;    // Bytes
+        size_t internalMin      = 0;    // Lowest free since boot
+        size_t psramFree        = 0;
+        bool wifiPowerSave      = false;  // The WiFi modem sleeps between beacons
+        float currentMa         = 0;      // Board supply, 0 if not measured
+        float currentAwakeMa    = 0;      // Average since boot with WiFi power save off, and on
+        float currentSavingMa   = 0;
+        std::vector<PerfTask_t> tasks;      // Busiest first
+        std::vector<PerfLock_t> lvglLocks;  // Sites that took the LVGL lock since the last sample
+    };
+    /**
+     * @brief The latest performance sample, taken at most once a second, for an on-device HUD
+     *
+     * @return false if the platform doesn't measure
+     */
+    virtual bool getPerfStats(PerfStats_t* stats)
+    {
+        return false;
+    }
+
+    /* --------------------------------- Memory --------------------------------- */
+    enum MemoryPool_t {
+        MEMORY_STREAM = 0,  // PSRAM: stream rings with their time-shift history, crossfade and probe buffers
+        MEMORY_INTERNAL,    // Internal SRAM, DMA-capable: I2S blocks, decoder frames, network chunks
+        MEMORY_POOL_COUNT,
+    };
+    struct MemoryPoolStats_t {
+        std::string name;
+        size_t size        = 0;  // Bytes reserved at boot, 0 if the pool couldn't be
+        size_t used        = 0;
+        size_t highWater   = 0;  // Most used at once since boot
+        uint32_t fallbacks = 0;  // Buffers the pool had no room for, taken from the system heap
+    };
+    /**
+     * @brief A buffer that lives as long as a stream or longer, from a pool set aside at boot
+     *
+     * Buffers that are freed and allocated again with every station change come from here instead of the system heap,
+     * which they would fragment after a few days. Platforms without pools use the system heap.
+     *
+     * @return nullptr if neither the pool nor the system heap has room
+     */
+    virtual void* allocBuffer(MemoryPool_t pool, size_t size)
+    {
+        return malloc(size);
+    }
+    virtual void freeBuffer(MemoryPool_t pool, void* buffer)
+    {
+        free(buffer);
+    }
+    virtual bool getMemoryPoolStats(MemoryPool_t pool, MemoryPoolStats_t* stats)
+    {
+        return false;
+    }
 
     /* --------------------------------- Display -------------------------------- */
     virtual int getDisplayWidth()
@@ -73,6 +171,47 @@ public:
     {
         return 0;
     }
+    /**
+     * @brief Backlight off and the UI pipeline stopped: no LVGL timers, rendering or flushes until the next touch
+     * (which goes no further) or resumeDisplay(). The CPU clock may drop meanwhile, as far as audio allows
+     *
+     * @return false if the platform can't, the display stays as it is
+     */
+    virtual bool suspendDisplay()
+    {
+        return false;
+    }
+    // Redraws the whole screen before the backlight comes back on
+    virtual void resumeDisplay()
+    {
+    }
+    virtual bool isDisplaySuspended()
+    {
+        return false;
+    }
+    /**
+     * @brief Render what the UI changed and block until the panel's next refresh, paces the app loop to the display
+     *
+     * Frames where nothing changed cost no rendering, only the wakeup.
+     *
+     * @return false on a timeout, or when the panel doesn't report its refresh and this only yielded
+     */
+    virtual bool waitDisplayFrame(uint32_t timeoutMs)
+    {
+        delay(1);
+        return false;
+    }
+    /**
+     * @brief Render what the UI changed like waitDisplayFrame(), then sleep through the panel's refreshes until
+     * `timeoutMs` is up or a HAL event or touch input wakes the app loop
+     *
+     * @return true if woken before the timeout
+     */
+    virtual bool waitWake(uint32_t timeoutMs)
+    {
+        delay(timeoutMs);
+        return false;
+    }
 
     /* ---------------------------------- Lvgl ---------------------------------- */
     lv_indev_t* lvTouchpad = nullptr;
@@ -82,6 +221,22 @@ public:
     virtual void lvglUnlock()
     {
     }
+    // Who takes the LVGL lock, the perf HUD and /metrics keep its waits and holds apart per site
+    enum LvglLockSite_t {
+        LVGL_LOCK_OTHER = 0,
+        LVGL_LOCK_APP_UPDATE,  // The apps' updates from the mooncake loop, and the scheduler's idle checks
+        LVGL_LOCK_APP_OPEN,    // Views built and torn down as apps open and close
+        LVGL_LOCK_CAMERA,      // Preview frames put on the canvas
+        LVGL_LOCK_HAL,         // The HAL's own: display power, renders on demand, background jobs' results
+        LVGL_LOCK_SITE_COUNT,
+    };
+    /**
+     * @brief lvglLock(), with the time it waits and holds the lock counted against `site`
+     */
+    virtual void lvglLockAt(LvglLockSite_t site)
+    {
+        lvglLock();
+    }
 
     /* ---------------------------------- Power --------------------------------- */
     struct PMData_t {
@@ -91,9 +246,45 @@ public:
         float shuntCurrent = 0.0f;
     };
     PMData_t powerMonitorData;
+    // The newest sample into powerMonitorData
     virtual void updatePowerMonitorData()
     {
     }
+    /**
+     * @brief The newest `count` samples, oldest first, or fewer if there aren't that many yet
+     *
+     * @return the number of samples written
+     */
+    virtual int getPowerMonitorWindow(PMData_t* samples, int count)
+    {
+        return 0;
+    }
+    // What the energy drawn is booked against, the screen being off wins over anything playing
+    enum PowerState_t {
+        POWER_STATE_STREAMING,
+        POWER_STATE_IDLE,
+        POWER_STATE_SCREEN_OFF,
+        POWER_STATE_COUNT
+    };
+    struct PowerEnergy_t {
+        float joules  = 0.0f;  // Since boot, net of charging
+        float seconds = 0.0f;
+    };
+    virtual bool getPowerEnergy(PowerState_t state, PowerEnergy_t* energy)
+    {
+        return false;
+    }
+    /**
+     * @brief Bus power (W) per second, minute or hour since boot, the newest `count` points of `tier`, oldest first
+     *
+     * A chart picks the tier by its span and width, DecimationRing::tierFor()
+     *
+     * @return the number of points written
+     */
+    virtual int getPowerHistory(DecimationRing::Tier_t tier, DecimationRing::Point_t* points, int count)
+    {
+        return 0;
+    }
     virtual void setChargeQcEnable(bool enable)
     {
     }
@@ -134,6 +325,37 @@ public:
     virtual void sleepAndRtcWakeup()
     {
     }
+    /**
+     * @brief Power off until the RTC alarm at hour:minute, local time, which boots the board like the power key.
+     * Nothing is kept over it, PSRAM included: the radio comes back through fast resume
+     */
+    virtual void sleepAndAlarmWakeup(int hour, int minute)
+    {
+    }
+    /**
+     * @return true if this boot is the RTC alarm's rather than the power key's
+     */
+    virtual bool wokeByRtcAlarm()
+    {
+        return false;
+    }
+    // What the radio was doing when a software reset cut it short
+    struct WarmRestart_t {
+        bool playing   = false;
+        char url[256]  = {0};  // The stream it last started, as handed to startRadioStream()
+        uint8_t volume = 0;    // Speaker volume it played at
+    };
+    /**
+     * @brief true if this boot follows a crash, a watchdog or esp_restart() and found the last boot's state in
+     * memory that survives those. The app then resumes without the boot animation. A board that keeps resetting
+     * soon after boot gets a cold boot after a few tries
+     *
+     * @param state What was going on then, may be nullptr
+     */
+    virtual bool getWarmRestart(WarmRestart_t* state)
+    {
+        return false;
+    }
 
     /* ----------------------------------- IMU ---------------------------------- */
     struct IMUData_t {
@@ -145,14 +367,30 @@ public:
         float gyroZ  = 0.0f;
     };
     IMUData_t imuData;
+    static constexpr int IMU_SAMPLE_RATE = 200;  // Hz, of the samples getImuWindow() gives
+    // The newest sample into imuData
     virtual void updateImuData()
     {
     }
+    /**
+     * @brief The newest `count` samples, oldest first, or fewer if there aren't that many yet
+     *
+     * Reads keep the sampling going, it stops a while after the last one.
+     *
+     * @return the number of samples written
+     */
+    virtual int getImuWindow(IMUData_t* samples, int count)
+    {
+        return 0;
+    }
     virtual void clearImuIrq()
     {
     }
 
     /* ----------------------------------- RTC ---------------------------------- */
+    /**
+     * @brief Local time from the system clock, which the RTC keeps in step, as cheap as time()
+     */
     virtual void getRtcTime(tm* time)
     {
     }
@@ -164,9 +402,31 @@ public:
     }
 
     /* --------------------------------- Camera --------------------------------- */
-    virtual void startCameraCapture(lv_obj_t* imgCanvas)
+    /**
+     * @brief Show the camera on `imgCanvas`, captured at `width` x `height` rather than scaled down afterwards
+     *
+     * The size is negotiated with the driver, which settles on the nearest mode the sensor has. The canvas shows
+     * frames as they come, at whichever size that was.
+     */
+    virtual void startCameraCapture(lv_obj_t* imgCanvas, int width = 1280, int height = 720)
+    {
+    }
+    // Another capture size while capturing, for a canvas that grew or shrank
+    virtual void setCameraPreviewSize(int width, int height)
     {
     }
+    /**
+     * @brief Take one frame at the sensor's full resolution and go back to the preview, EVENT_CAMERA_STILL once done
+     */
+    virtual bool requestCameraStill()
+    {
+        return false;
+    }
+    // The still EVENT_CAMERA_STILL announced, RGB565. false if there's none
+    virtual bool takeCameraStill(std::vector<uint16_t>& pixels, int* width, int* height)
+    {
+        return false;
+    }
     virtual void stopCameraCapture()
     {
     }
@@ -174,16 +434,51 @@ public:
     {
         return false;
     }
+    /**
+     * @brief Viewers of the camera over the network, an MJPEG stream while it captures
+     *
+     * The stream's quality follows what the slowest viewer's link takes.
+     */
+    virtual int getCameraStreamViewers()
+    {
+        return 0;
+    }
+    /**
+     * @brief Look for a face in front of the screen a couple of times a second, EVENT_PRESENCE when someone turns up
+     * or nobody has been seen for a while
+     *
+     * Shares the sensor with the preview: it waits while the camera captures and carries on after. Starts out
+     * assuming someone is there, the first event is either a face or the lack of one.
+     *
+     * @return false if the platform can't
+     */
+    virtual bool startPresenceDetection()
+    {
+        return false;
+    }
+    virtual void stopPresenceDetection()
+    {
+    }
+    virtual bool isPresenceDetectionRunning()
+    {
+        return false;
+    }
+
+    /* ---------------------------------- Image --------------------------------- */
+    // Decode a JPEG, centre-cropped to square and scaled to fit `size` x `size` RGB565 (LVGL's order) in `pixels`
+    virtual bool decodeJpegThumbnail(const uint8_t* data, size_t len, int size, uint16_t* pixels)
+    {
+        return false;
+    }
 
     /* ---------------------------------- USB-A --------------------------------- */
     struct HidMouseData_t {
-        std::mutex mutex;
         int x         = 0;
         int y         = 0;
         bool btnLeft  = false;
         bool btnRight = false;
     };
-    HidMouseData_t hidMouseData;
+    Snapshot<HidMouseData_t> hidMouseData;  // Where the cursor's indev last put the cursor, and its buttons
 
     /* ---------------------------------- Audio --------------------------------- */
     virtual void setSpeakerVolume(uint8_t volume)
@@ -193,14 +488,62 @@ public:
     {
         return 0;
     }
-    // [MIC-L, AEC, MIC-R, MIC-HP]
+    // [MIC-L, AEC, MIC-R, MIC-HP], blocks for the whole duration. Anything that reads over and over should keep a
+    // mic capture reader open instead
     virtual void audioRecord(std::vector<int16_t>& data, uint16_t durationMs, float gain = 80.0f)
     {
     }
+
+    /* ------------------------------- Mic Capture ------------------------------ */
+    static constexpr int MIC_SAMPLE_RATE   = 48000;
+    static constexpr int MIC_CHANNELS      = 4;    // Interleaved [MIC-L, AEC, MIC-R, MIC-HP]
+    static constexpr int MIC_FRAME_SAMPLES = 192;  // Per channel in a frame, 4 ms
+    /**
+     * @brief Follow the mics from now on, they're captured while anyone has a reader open
+     *
+     * Readers share one capture and each goes at its own pace: one that falls behind by more than the capture
+     * keeps loses the oldest frames, it never holds the capture or the others back.
+     *
+     * @return reader id, -1 if there are no mics or no reader left
+     */
+    virtual int openMicCapture()
+    {
+        return -1;
+    }
+    virtual void closeMicCapture(int reader)
+    {
+    }
+    /**
+     * @brief Copy up to `maxFrames` whole frames captured since the reader's last call, oldest first
+     *
+     * @param data room for maxFrames * MIC_FRAME_SAMPLES * MIC_CHANNELS samples
+     * @param timeoutMs how long to wait for the first frame, 0 to take what's there
+     * @param dropped where to add the frames the reader lost by falling behind, optional
+     * @return frames copied
+     */
+    virtual int readMicCapture(int reader, int16_t* data, int maxFrames, uint32_t timeoutMs = 0,
+                               int* dropped = nullptr)
+    {
+        return 0;
+    }
+    // Shared by every reader, the last one set applies
+    virtual void setMicGain(float gain)
+    {
+    }
+    // 48 kHz stereo, mixed over whatever is playing
     virtual void audioPlay(std::vector<int16_t>& data, bool async = true)
     {
     }
 
+    // Start a voice rendered straight into `audioMixer`: acquire(), fill buffer(), then this instead of commit()
+    virtual void audioPlayVoice(int voice, int frames)
+    {
+        audioMixer.commit(voice, frames);
+    }
+
+    // UI sounds, the platform sets its pool up and mixes it into its output
+    AudioMixer audioMixer;
+
     // Mic record test
     enum MicTestState_t {
         MIC_TEST_IDLE,
@@ -246,6 +589,48 @@ public:
     {
     }
 
+    /* ------------------------------ Voice Control ----------------------------- */
+    enum VoiceCommand_t {
+        VOICE_NEXT_STATION = 0,
+        VOICE_PREVIOUS_STATION,
+        VOICE_VOLUME_UP,
+        VOICE_VOLUME_DOWN,
+        VOICE_COMMAND_COUNT,
+    };
+    /**
+     * @brief Listen to the mics for the trained commands, EVENT_VOICE_COMMAND for each one heard
+     *
+     * What the speaker plays is cancelled out of the mics against the codec's reference of it first, so a command
+     * is heard over the music. Commands are matched against the user's own examples, see trainVoiceCommand().
+     */
+    virtual bool startVoiceControl()
+    {
+        return false;
+    }
+    virtual void stopVoiceControl()
+    {
+    }
+    virtual bool isVoiceControlRunning()
+    {
+        return false;
+    }
+    /**
+     * @brief Take the next thing said as an example of `command`, EVENT_VOICE_TRAINED once it's kept
+     *
+     * Listens meanwhile if voice control is off. A few examples are kept per command, another replaces the oldest.
+     */
+    virtual bool trainVoiceCommand(VoiceCommand_t command)
+    {
+        return false;
+    }
+    virtual int getVoiceCommandExamples(VoiceCommand_t command)
+    {
+        return 0;
+    }
+    virtual void clearVoiceCommands()
+    {
+    }
+
     /* --------------------------------- Network -------------------------------- */
     virtual void setExtAntennaEnable(bool enable)
     {
@@ -265,47 +650,151 @@ public:
         WIFI_CONNECTED,
         WIFI_FAILED
     };
+    // How far a connect got while WIFI_CONNECTING, WIFI_STEP_IDLE otherwise
+    enum WifiStep_t {
+        WIFI_STEP_IDLE,
+        WIFI_STEP_SCANNING,        // Looking for the network
+        WIFI_STEP_AUTHENTICATING,  // Found it, the handshake failed and is being tried again
+        WIFI_STEP_DHCP,            // Associated, waiting for an address
+    };
     virtual WifiState_t getWifiState()
     {
         return WIFI_DISCONNECTED;
     }
+    virtual WifiStep_t getWifiStep()
+    {
+        return WIFI_STEP_IDLE;
+    }
+    // Blocks until connected or given up
     virtual bool connectWifiSta(const std::string& ssid, const std::string& password)
     {
         return false;
     }
+    /**
+     * @brief Start connecting and return at once, the outcome comes as EVENT_WIFI_STATE and the steps on the way as
+     * EVENT_WIFI_STEP
+     *
+     * @return false if the connect couldn't even be started
+     */
+    virtual bool startWifiSta(const std::string& ssid, const std::string& password)
+    {
+        return connectWifiSta(ssid, password);
+    }
     virtual void disconnectWifi()
     {
     }
-    virtual std::string getWifiIp()
+    // Inline and fixed size, what the WiFi task publishes reads without touching the heap
+    using WifiSsid_t = InlineString<33>;  // 32 bytes, as 802.11 has it
+    using WifiIp_t   = InlineString<16>;  // Dotted IPv4
+    struct WifiNetwork_t {
+        WifiSsid_t ssid;
+        int rssi     = 0;  // dBm, of its strongest AP
+        bool secured = false;
+    };
+    /**
+     * @brief Scan for networks and return at once, EVENT_WIFI_SCAN follows whenever getWifiNetworks() has more
+     *
+     * A scan finished a few seconds ago isn't repeated, its results are posted again straight away
+     *
+     * @return false if the platform can't scan, or can't right now (busy connecting)
+     */
+    virtual bool startWifiScan()
     {
-        return "";
+        return false;
     }
-    virtual std::string getWifiSsid()
+    // One per SSID found so far, strongest first
+    virtual std::vector<WifiNetwork_t> getWifiNetworks()
     {
-        return "";
+        return {};
+    }
+    virtual WifiIp_t getWifiIp()
+    {
+        return {};
+    }
+    virtual WifiSsid_t getWifiSsid()
+    {
+        return {};
     }
+    // Adds it to the saved networks, or updates it there
     virtual void saveWifiConfig(const std::string& ssid, const std::string& password)
     {
     }
+    // The saved network saved or joined last
     virtual bool loadWifiConfig(std::string& ssid, std::string& password)
     {
         return false;
     }
+    /**
+     * @brief Join the best of the saved networks and return at once, like startWifiSta()
+     *
+     * One scan ranks them: those in range first, the most recently joined of them first. A network that doesn't take
+     * us moves on to the next instead of failing
+     *
+     * @return false if there are none, or the connect couldn't even be started
+     */
+    virtual bool startSavedWifi()
+    {
+        std::string ssid, password;
+        return loadWifiConfig(ssid, password) && startWifiSta(ssid, password);
+    }
+    // Blocks until connected to one of them or all were given up
+    virtual bool connectSavedWifi()
+    {
+        std::string ssid, password;
+        return loadWifiConfig(ssid, password) && connectWifiSta(ssid, password);
+    }
+    struct NetBenchmark_t {
+        uint64_t bytes   = 0;
+        float seconds    = 0;
+        float mbps       = 0;  // Megabits per second
+        float cpuPercent = 0;  // Of all cores together, everything but idle while it ran
+    };
+    /**
+     * @brief Download `url` for up to `seconds` as fast as the link goes and throw the data away, blocks until done
+     *
+     * Point it at a large file on a LAN server to see how fast the stream buffer can fill and what the network path
+     * costs in CPU.
+     */
+    virtual bool runNetworkBenchmark(const std::string& url, uint32_t seconds, NetBenchmark_t* result)
+    {
+        return false;
+    }
+    // Blocking GET, the body is handed to `onData` as it arrives. False on any failure or if `onData` returns false
+    virtual bool httpGet(const std::string& url, std::function<bool(const char* data, size_t len)> onData)
+    {
+        return false;
+    }
 
     /* ------------------------------ Radio Stream ------------------------------ */
     enum RadioState_t {
         RADIO_STOPPED,
         RADIO_BUFFERING,
         RADIO_PLAYING,
-        RADIO_ERROR
+        RADIO_ERROR,
+        RADIO_PAUSED
     };
+    // Plain arrays so the HAL can publish it as a lock-free snapshot
     struct RadioMetadata_t {
-        std::string title;       // Current track (from ICY metadata)
-        std::string station;     // Station name
+        char title[256]   = {0};  // Current track (from ICY metadata)
+        char station[64]  = {0};  // Station name
         int bitrate       = 0;
         int bufferPercent = 0;
     };
-    RadioMetadata_t radioMetadata;
+    enum RadioCodec_t {
+        RADIO_CODEC_UNKNOWN,
+        RADIO_CODEC_MP3,
+        RADIO_CODEC_AAC,
+        RADIO_CODEC_OPUS,  // In Ogg
+        RADIO_CODEC_FLAC,  // Native or in Ogg
+    };
+    // What the stream's own frames say, as opposed to the icy-* headers
+    struct RadioStreamFormat_t {
+        RadioCodec_t codec = RADIO_CODEC_UNKNOWN;
+        int sampleRate     = 0;  // Output rate, so twice the core rate for HE-AAC
+        int channels       = 0;
+        int bitrate        = 0;  // kbps, the average for VBR
+        bool vbr           = false;
+    };
     virtual RadioState_t getRadioState()
     {
         return RADIO_STOPPED;
@@ -317,8 +806,478 @@ public:
     virtual void stopRadioStream()
     {
     }
-    virtual void getRadioSpectrum(uint8_t* spectrum, size_t len)
+    /**
+     * @brief Open a second connection to `url` while the current stream plays, a later startRadioStream(url) then
+     * switches over without reconnecting or prebuffering. Call repeatedly, returns true once the stream is warm
+     */
+    virtual bool prewarmRadioStream(const std::string& url)
+    {
+        return false;
+    }
+    struct RadioVariant_t {
+        std::string url;
+        int kbps = 0;
+    };
+    /**
+     * @brief The same station at other bitrates. While startRadioStream() plays one of them it steps down to a lower
+     * one before the buffer runs dry on a slow link, and back up once the link has room again. Holds until the next
+     * call, an empty list turns it off
+     */
+    virtual void setRadioVariants(const std::vector<RadioVariant_t>& variants)
+    {
+    }
+    /**
+     * @brief Step the variant playing straight to `url`, another of the variants, spliced in where what's buffered of
+     * the one playing ends: a preview at a low bitrate goes on at full quality without a gap
+     *
+     * @return false if no variant plays or a step is already under way, startRadioStream(url) is left then
+     */
+    virtual bool switchRadioVariant(const std::string& url)
+    {
+        return false;
+    }
+    /**
+     * @brief Keep the hosts of these stream URLs resolved, now and on every WiFi (re)connect, so starting a station
+     * doesn't wait for DNS
+     */
+    virtual void prewarmRadioHosts(const std::vector<std::string>& urls)
+    {
+    }
+    /**
+     * @brief The station names in catalog order, for the web remote's list: REMOTE_STATION's argument indexes them
+     */
+    virtual void setRemoteStations(const std::vector<std::string>& names)
+    {
+    }
+    virtual RadioMetadata_t getRadioMetadata()
+    {
+        return {};
+    }
+    virtual RadioStreamFormat_t getRadioStreamFormat()
+    {
+        return {};
+    }
+    /**
+     * @brief Play files from the SD card (paths as for openSdCardDir()) through the radio's decoder, each one
+     * straight after the one before
+     *
+     * MP3 and ADTS AAC. Replaces whatever plays, stopRadioStream() ends it, getRadioMetadata() has the file name.
+     */
+    virtual bool startRadioFiles(const std::vector<std::string>& paths)
+    {
+        return false;
+    }
+    /**
+     * @brief Add a file to the end of what startRadioFiles() plays, or start playing it if nothing from the card is
+     */
+    virtual bool queueRadioFile(const std::string& path)
+    {
+        return false;
+    }
+    /* Time-shift: pausing keeps receiving into the buffer, play resumes where it stopped */
+    struct RadioTimeShift_t {
+        bool paused     = false;
+        int behindLiveS = 0;  // Buffered ahead of the play position
+        int historyS    = 0;  // How far skipRadioStream() can go back
+    };
+    virtual bool pauseRadioStream()
+    {
+        return false;
+    }
+    virtual void resumeRadioStream()
+    {
+    }
+    /**
+     * @brief Jump back (negative) into the history or forward through the buffer, at most up to live
+     */
+    virtual bool skipRadioStream(int seconds)
+    {
+        return false;
+    }
+    virtual RadioTimeShift_t getRadioTimeShift()
+    {
+        return {};
+    }
+    /* On demand: a URL served as a file (podcasts, archives) with its length and byte ranges can be seeked in */
+    struct RadioPosition_t {
+        bool seekable = false;
+        int positionS = 0;
+        int durationS = 0;
+    };
+    /**
+     * @brief Jump to `seconds` into an on-demand stream. What isn't buffered is asked for with an HTTP Range request
+     * from the target on, playback picks up as soon as a few frames of it are in
+     *
+     * skipRadioStream() seeks the same way on these
+     */
+    virtual bool seekRadioStream(int seconds)
+    {
+        return false;
+    }
+    virtual RadioPosition_t getRadioPosition()
+    {
+        return {};
+    }
+    /**
+     * @brief Record the playing stream to the SD card as it's received, a new file per ICY title
+     */
+    virtual bool startRadioRecording()
+    {
+        return false;
+    }
+    virtual void stopRadioRecording()
+    {
+    }
+    virtual bool isRadioRecording()
+    {
+        return false;
+    }
+    /**
+     * @brief Save the last `minutes` played to the SD card, as far back as the time-shift history goes, a file per
+     * title like a recording. It's written in the background while the stream plays on
+     *
+     * @return false if there's nothing to save, no card, or the last save is still being written
+     */
+    virtual bool saveRadioHistory(int minutes)
+    {
+        return false;
+    }
+    virtual bool isRadioHistorySaving()
+    {
+        return false;
+    }
+    struct RadioHistoryEntry_t {
+        uint32_t time = 0;    // Unix seconds the title came up, 0 if the clock wasn't set yet
+        std::string station;  // Stream URL it played on
+        std::string title;
+    };
+    /**
+     * @brief Titles played on any stream, kept across reboots, newest first
+     *
+     * @param prefix matches the start of any word of a title, case-insensitive, empty returns everything
+     */
+    virtual std::vector<RadioHistoryEntry_t> searchRadioHistory(const std::string& prefix, int maxResults = 20)
     {
+        return {};
+    }
+    struct RadioEq_t {
+        int bassDb     = 0;     // Low shelf at 120 Hz, +-12
+        int midDb      = 0;     // Peak at 1 kHz
+        int trebleDb   = 0;     // High shelf at 8 kHz
+        bool normalize = true;  // Bring every station to the same loudness
+    };
+    /**
+     * @brief Output EQ and loudness normalization, applied from the next decoded frame on
+     */
+    virtual void setRadioEq(const RadioEq_t& eq)
+    {
+    }
+    virtual RadioEq_t getRadioEq()
+    {
+        return {};
+    }
+    /**
+     * @brief Crossfade when zapping to a pre-warmed station, 500..3000 ms, 0 switches straight over
+     */
+    virtual void setRadioCrossfade(int ms)
+    {
+    }
+    virtual int getRadioCrossfade()
+    {
+        return 0;
+    }
+    struct RadioOutputStats_t {
+        uint32_t underruns        = 0;      // Times the output ran dry during playback and was faded out, since boot
+        uint32_t silentDmaBuffers = 0;      // I2S DMA buffers that went out as silence, since boot (also while idle)
+        bool usbAudio             = false;  // The last block went to a USB DAC rather than the speaker codec
+        uint32_t latencyMs        = 0;      // The last block's, handed to the output until its end is heard
+    };
+    virtual RadioOutputStats_t getRadioOutputStats()
+    {
+        return {};
+    }
+    struct RadioSpectrum_t {
+        static constexpr int MAX_BANDS = 128;
+
+        uint32_t version     = 0;       // Bumped for every analysis, 0 until the first one
+        uint32_t timestampMs = 0;       // When the analysis ran
+        int bands            = 0;
+        float rmsDb          = -96.0f;  // Of the analyzed window, dBFS
+        float peakDb         = -96.0f;
+        uint8_t levels[MAX_BANDS]{};    // 0..255, low to high frequency
+    };
+    /**
+     * @brief Copy the newest spectrum frame, tear-free
+     *
+     * @return true if it's newer than the one `frame` already holds (by version)
+     */
+    virtual bool getRadioSpectrum(RadioSpectrum_t* frame)
+    {
+        return false;
+    }
+    /**
+     * @brief Number of bands the analyzer splits the spectrum into, from the next frame on
+     */
+    virtual void setRadioSpectrumBands(int bands)
+    {
+    }
+    struct RadioWaveform_t {
+        static constexpr int MAX_COLUMNS = 1024;
+
+        uint32_t version     = 0;  // Bumped for every frame, 0 until the first one
+        uint32_t timestampMs = 0;
+        int columns          = 0;
+        int8_t min[MAX_COLUMNS]{};  // Per pixel column, oldest on the left, full scale is -128..127
+        int8_t max[MAX_COLUMNS]{};
+    };
+    /**
+     * @brief Copy the newest waveform frame, tear-free
+     *
+     * @return true if it's newer than the one `frame` already holds (by version)
+     */
+    virtual bool getRadioWaveform(RadioWaveform_t* frame)
+    {
+        return false;
+    }
+    /**
+     * @brief Pixel columns the waveform is decimated to, from the next frame on. 0 (the default) for none, it's only
+     * worked out while something shows it
+     */
+    virtual void setRadioWaveformColumns(int columns)
+    {
+    }
+    struct RadioBenchmark_t {
+        RadioCodec_t codec      = RADIO_CODEC_UNKNOWN;
+        uint32_t frames         = 0;
+        uint32_t decodeErrors   = 0;
+        uint32_t bitrateKbps    = 0;
+        float audioSeconds      = 0;
+        uint32_t cyclesPerFrame = 0;  // Average, frame scan to resampled PCM
+        uint32_t maxFrameCycles = 0;
+        uint32_t maxFrameUs     = 0;  // Slowest frame, what the output queue has to cover
+        float coreLoad          = 0;  // Share of one core the stream takes when played in real time
+        uint32_t internalBytes  = 0;  // Most internal RAM / PSRAM taken while running
+        uint32_t psramBytes     = 0;
+    };
+    /**
+     * @brief Replay an embedded MP3 through the radio's decode path with the output left out, blocks until done
+     *
+     * @param path another sample to replay instead, an .mp3, .aac, .opus/.ogg or .flac file
+     * @return false if there's no decoder on this platform, the radio is playing or the file can't be read
+     */
+    virtual bool runRadioBenchmark(RadioBenchmark_t* result, const char* path = nullptr)
+    {
+        return false;
+    }
+    struct OutputBenchmark_t {
+        bool usbAudio         = false;  // Where it played: a USB DAC, or the speaker codec
+        float seconds         = 0;
+        uint32_t blocks       = 0;
+        uint32_t underruns    = 0;
+        uint32_t latencyMs    = 0;  // Average, a block handed over until its end is heard
+        uint32_t maxLatencyMs = 0;
+        float coreLoad        = 0;  // Share of the audio core the output task took
+    };
+    /**
+     * @brief Play silence through the radio's output for `seconds`, to whichever sink is there, blocks until done
+     *
+     * @return false if there's no output on this platform or the radio is playing
+     */
+    virtual bool runOutputBenchmark(uint32_t seconds, OutputBenchmark_t* result)
+    {
+        return false;
+    }
+    struct SelfBenchmark_t {
+        std::string firmware;  // Version and build date, what the numbers belong to
+        std::string hardware;  // Chip revision and PSRAM size
+        float psramCopyMBps     = 0;  // memcpy within PSRAM, well past the cache
+        float internalCopyMBps  = 0;  // memcpy within internal SRAM
+        float ppaRotateMpxps    = 0;  // PPA 90 degree RGB565 rotation, megapixels per second
+        uint32_t fftCycles      = 0;  // One spectrum analyzer frame
+        uint32_t dspCycles      = 0;  // PcmDsp with EQ and normalizer over one stereo MP3 frame
+        uint32_t resampleCycles = 0;  // The same frame from 44.1 to 48 kHz
+        float ringMBps          = 0;  // Stream ring, producer and consumer on the cores the radio uses
+        uint32_t decodeCycles   = 0;  // Per frame, runRadioBenchmark()
+        float mp3Load           = 0;  // Share of a core decoding in real time, the same run
+        float aacLoad           = 0;  // The same for the samples in bench/ on the SD card, 0 without
+        float opusLoad          = 0;
+        float flacLoad          = 0;
+        float netMbps           = 0;  // runNetworkBenchmark(), 0 without WiFi
+        float sdWriteMBps       = 0;  // Recording's writer, whole blocks to a growing file, 0 without a card
+        float sdWorstWriteMs    = 0;  // Slowest of those blocks
+        float lvglFps           = 0;  // While the LVGL demo benchmark runs, 0 where there is none
+        float lvglRenderMs      = 0;
+    };
+    /**
+     * @brief Run the whole suite, from memory bandwidth to the LVGL demo benchmark, and log the results, blocks
+     *
+     * Meant for comparing boards and firmware: the results are printed and, where there's storage, appended to a
+     * log along with the firmware version. The LVGL demo takes the screen over and stays until a restart.
+     *
+     * @return false if this platform has no suite or the radio is playing
+     */
+    virtual bool runSelfBenchmark(SelfBenchmark_t* result)
+    {
+        return false;
+    }
+    enum StressLoad_t : uint32_t {
+        STRESS_PPA    = 1 << 0,  // Full screen PPA rotations back to back, as the camera preview and the flush do
+        STRESS_REDRAW = 1 << 1,  // The whole screen invalidated every frame
+        STRESS_SD     = 1 << 2,  // Recording's writer, flat out
+        STRESS_I2C    = 1 << 3,  // Probes on the internal bus, at the telemetry's rank
+        STRESS_PSRAM  = 1 << 4,  // memcpy within PSRAM, well past the cache
+        STRESS_ALL    = (1 << 5) - 1,
+    };
+    struct StressPhase_t {
+        uint32_t loads              = 0;  // StressLoad_t bits, 0 for the baseline
+        float seconds               = 0;
+        uint32_t underruns          = 0;
+        uint32_t outputLatencyMaxMs = 0;  // A block handed to the output until its end is heard
+        uint32_t decodeFrames       = 0;  // Decodes the latencies below are from, 0 without the stream trace
+        float decodeP50Ms           = 0;
+        float decodeP99Ms           = 0;
+        float decodeMaxMs           = 0;
+        float fps                   = 0;  // Frames LVGL rendered, averaged over the phase
+        float frameMsMax            = 0;  // Render and flush per frame, the worst second's average
+        float psramMBps             = 0;  // What a light reader got out of PSRAM meanwhile, the worst probe
+    };
+    struct StressBenchmark_t {
+        std::vector<StressPhase_t> phases;  // The baseline, each load alone, then all of them together
+    };
+    /**
+     * @brief Run combinations of the loads audio glitches were seen with under the playing stream, blocks
+     *
+     * Each phase runs for `phaseSeconds`: nothing first, then each of `loads` on its own and finally all of them at
+     * once. The phases show in the stream trace as spans, the decode latencies are read back from it. Results are
+     * logged, and appended to a log where there's storage, for comparing an optimization's worst case before and
+     * after.
+     *
+     * @return false if this platform has no suite or the radio isn't playing
+     */
+    virtual bool runStressBenchmark(uint32_t phaseSeconds, uint32_t loads, StressBenchmark_t* result)
+    {
+        return false;
+    }
+    /**
+     * @brief Record what the touch, the mouse and the keypads hand LVGL from now on, see input_recording.h
+     *
+     * @return false if this platform can't record or already is
+     */
+    virtual bool startInputRecording()
+    {
+        return false;
+    }
+    /**
+     * @brief Stop recording and save it to `name`, in the platform's storage
+     */
+    virtual bool stopInputRecording(const std::string& name)
+    {
+        return false;
+    }
+    struct InputReplay_t {
+        uint32_t records        = 0;
+        float seconds           = 0;  // From the replay's start to its last record and a settling time after it
+        uint32_t frames         = 0;  // Rendered meanwhile
+        float fps               = 0;
+        float renderMsMean      = 0;  // Per frame, without the flushes
+        float renderMsP95       = 0;
+        float renderMsMax       = 0;
+        float flushMsMean       = 0;
+        float flushMsMax        = 0;
+        float redrawPercentMean = 0;  // Of the screen invalidated per frame, overlaps count twice
+        float redrawPercentP95  = 0;
+        float areasMean         = 0;  // Invalidated areas per frame
+    };
+    /**
+     * @brief Play a recording back in place of the real input, blocks, and measure the frames it renders
+     *
+     * The input devices read nothing else until it's done. It should start from the screen the recording did. The
+     * result is logged, and appended to a log where there's storage, so a rendering change can be compared on the
+     * same scenario before and after.
+     *
+     * @return false if there's no such recording or a replay or recording is in progress
+     */
+    virtual bool runInputReplay(const std::string& name, InputReplay_t* result)
+    {
+        return false;
+    }
+
+    /* ----------------------------- Firmware Update ---------------------------- */
+    enum FirmwareUpdateState_t {
+        FIRMWARE_UPDATE_IDLE,
+        FIRMWARE_UPDATE_DOWNLOADING,  // And written to the other slot as it comes
+        FIRMWARE_UPDATE_VERIFYING,
+        FIRMWARE_UPDATE_READY,        // Boots next restart, unless that one fails to come up
+        FIRMWARE_UPDATE_FAILED,
+    };
+    struct FirmwareUpdate_t {
+        FirmwareUpdateState_t state = FIRMWARE_UPDATE_IDLE;
+        bool delta                  = false;  // Applied on top of the running firmware
+        uint32_t downloaded         = 0;      // Bytes of the update
+        uint32_t written            = 0;      // Bytes of the new firmware image
+        uint32_t imageSize          = 0;      // 0 until the update's header is in
+        std::string error;                    // What went wrong, for FIRMWARE_UPDATE_FAILED
+    };
+    /**
+     * @brief Download an update (pack_ota.py) into the other firmware slot and return at once, EVENT_FW_UPDATE follows
+     * every state change
+     *
+     * The radio keeps playing, the download runs below it. A verified update boots at the next restart, or at once
+     * with `restart`; the old firmware comes back if the new one doesn't get its UI up.
+     *
+     * @return false if an update is already going, or this platform can't update itself
+     */
+    virtual bool startFirmwareUpdate(const std::string& url, bool restart = false)
+    {
+        return false;
+    }
+    virtual FirmwareUpdate_t getFirmwareUpdate()
+    {
+        return {};
+    }
+
+    /* ------------------------------ Change Events ----------------------------- */
+    enum EventType_t {
+        EVENT_RESYNC,         // Events were lost, or the subscription is new: re-read everything
+        EVENT_RADIO_STATE,    // value: the new RadioState_t
+        EVENT_RADIO_TITLE,    // getRadioMetadata() has another title, empty once the stream stops
+        EVENT_RADIO_BUFFER,   // value: buffer level in %, rounded down to BUFFER_EVENT_STEP
+        EVENT_WIFI_STATE,     // value: the new WifiState_t
+        EVENT_WIFI_STEP,      // value: the new WifiStep_t
+        EVENT_WIFI_SCAN,      // More scan results, value: 1 while the scan goes on, 0 once it's done
+        EVENT_SD_CARD,        // value: 1 a card was mounted, 0 it was removed
+        EVENT_MEDIA_INDEX,    // A card scan finished, value: the files in the media index
+        EVENT_VOICE_COMMAND,  // value: the VoiceCommand_t heard
+        EVENT_VOICE_TRAINED,  // value: the VoiceCommand_t an example was kept for
+        EVENT_CAMERA_STILL,   // value: 1 takeCameraStill() has it, 0 the capture failed
+        EVENT_I2C_SCAN,       // getI2cDevices() has a new map, value: 1 the internal bus, 0 Port A
+        EVENT_KEY,            // A hardware key no text field took, value: an LV_KEY_* or the character
+        EVENT_REMOTE,         // A command over RS485 or the web remote, value: RemoteCommand_t | argument << 8
+        EVENT_FW_UPDATE,      // value: the new FirmwareUpdateState_t, getFirmwareUpdate() has the rest
+        EVENT_RADIO_BEAT,     // An onset in what's playing, value: the tempo in BPM, 0 until there's a steady one
+        EVENT_PRESENCE,       // value: 1 a face came into view, 0 none has been seen for a while
+        EVENT_HEADPHONE,      // value: 1 headphones were plugged in, 0 pulled out, the output follows by itself
+    };
+    struct Event_t {
+        EventType_t type = EVENT_RESYNC;
+        int value        = 0;
+    };
+    static constexpr int BUFFER_EVENT_STEP = 10;
+    /**
+     * @brief Subscribe to what changed instead of polling the getters, events queue up until pollEvent()
+     *
+     * @return subscriber id, -1 if this platform has no events (poll the getters instead)
+     */
+    virtual int subscribeEvents()
+    {
+        return -1;
+    }
+    virtual void unsubscribeEvents(int id)
+    {
+    }
+    virtual bool pollEvent(int id, Event_t* event)
+    {
+        return false;
     }
 
     /* --------------------------------- SD Card -------------------------------- */
@@ -326,15 +1285,132 @@ public:
         std::string name;
         bool isDir;
     };
+    /**
+     * @brief Whether a card is in and mounted, it's mounted once and followed for removal and insertion
+     *
+     * EVENT_SD_CARD tells the subscribers when this changes.
+     */
     virtual bool isSdCardMounted()
     {
         return false;
     }
-    virtual std::vector<FileEntry_t> scanSdCard(const std::string& dirPath)
+    /**
+     * @brief Start listing `dirPath` on the card, then read it with readSdCardDir() a page at a time
+     *
+     * Blocking I/O, like the reads: call it from runInBackground(). An open listing keeps the card mounted.
+     *
+     * @return cursor for the other two, -1 if there's no card or no such directory
+     */
+    virtual int openSdCardDir(const std::string& dirPath)
+    {
+        return -1;
+    }
+    /**
+     * @brief The next up to `maxEntries` entries, in directory order without "." and ".."
+     *
+     * A page shorter than `maxEntries` is the last one.
+     */
+    virtual std::vector<FileEntry_t> readSdCardDir(int cursor, int maxEntries)
+    {
+        return {};
+    }
+    virtual void closeSdCardDir(int cursor)
+    {
+    }
+    // The whole directory at once, blocking
+    std::vector<FileEntry_t> scanSdCard(const std::string& dirPath)
+    {
+        std::vector<FileEntry_t> entries;
+        int cursor = openSdCardDir(dirPath);
+        if (cursor < 0) {
+            return entries;
+        }
+        constexpr int PAGE = 64;
+        while (true) {
+            std::vector<FileEntry_t> page = readSdCardDir(cursor, PAGE);
+            entries.insert(entries.end(), page.begin(), page.end());
+            if ((int)page.size() < PAGE) {
+                break;
+            }
+        }
+        closeSdCardDir(cursor);
+        return entries;
+    }
+
+    /* ------------------------------- Media Index ------------------------------ */
+    // The card's music by its tags, kept in an index on the card that a scan brings up to date
+    enum MediaField_t {
+        MEDIA_ARTIST,  // Results by artist, album, title
+        MEDIA_TITLE,
+    };
+    struct MediaEntry_t {
+        std::string artist;
+        std::string album;
+        std::string title;
+        std::string path;  // As for openSdCardDir() and startRadioFiles()
+    };
+    /**
+     * @brief Bring the index up to date in the background, only files new or changed since the last scan are read
+     *
+     * A card is scanned as it's mounted too. EVENT_MEDIA_INDEX tells when it's done.
+     */
+    virtual bool startMediaScan()
+    {
+        return false;
+    }
+    virtual bool isMediaScanRunning()
+    {
+        return false;
+    }
+    /**
+     * @brief Files whose `field` starts with `prefix`, case-insensitive. An empty prefix lists from the start
+     */
+    virtual std::vector<MediaEntry_t> searchMedia(MediaField_t field, const std::string& prefix, int maxResults = 50)
     {
         return {};
     }
 
+    /* --------------------------------- Storage -------------------------------- */
+    // Directory for small files the apps keep across reboots, empty if there is none
+    virtual std::string getDataDir()
+    {
+        return "";
+    }
+    /**
+     * @brief LVGL path of the packed images (app/assets/pack_image.py), empty if there are none
+     *
+     * A drive prefix like "A:", file names are appended as they are, see `assets::image_path()`
+     */
+    virtual std::string getAssetDir()
+    {
+        return "";
+    }
+    /**
+     * @brief The station catalog's flash slots, read in place through the flash mmap
+     *
+     * A slot's mapping stays valid until reboot, so what's read from it can be used without a copy. Rewriting one
+     * slot leaves the other, and anything pointing into it, alone
+     */
+    static constexpr int CATALOG_SLOTS = 2;
+    virtual const uint8_t* mapCatalogSlot(int slot, size_t* size)
+    {
+        return nullptr;
+    }
+    virtual bool writeCatalogSlot(int slot, const void* data, size_t len)
+    {
+        return false;
+    }
+    /**
+     * @brief The apps' settings as one blob, so reading them is a single lookup and saving a single commit
+     */
+    virtual bool loadSettings(std::vector<uint8_t>& data)
+    {
+        return false;
+    }
+    virtual void saveSettings(const std::vector<uint8_t>& data)
+    {
+    }
+
     /* -------------------------------- Interface ------------------------------- */
     virtual bool usbCDetect()
     {
@@ -344,14 +1420,33 @@ public:
     {
         return false;
     }
+    // Headphones in the jack, debounced. The speaker is off while they are, EVENT_HEADPHONE when that changes
     virtual bool headPhoneDetect()
     {
         return false;
     }
+    // Probes every address and waits for it, prefer startI2cScan()
     virtual std::vector<uint8_t> i2cScan(bool isInternal)
     {
         return {};
     }
+    /**
+     * @brief Scan a bus in the background and return at once, EVENT_I2C_SCAN follows once getI2cDevices() has it
+     *
+     * Port A (between initPortAI2c() and deinitPortAI2c()) is scanned again by itself when EXT 5V is switched. It
+     * has no detect line, a device plugged in while the power stays on only shows at the next request.
+     *
+     * @return false if the platform can't scan
+     */
+    virtual bool startI2cScan(bool isInternal)
+    {
+        return false;
+    }
+    // The addresses that answered the latest scan of the bus, false if none has finished
+    virtual bool getI2cDevices(bool isInternal, std::vector<uint8_t>* addrs)
+    {
+        return false;
+    }
     virtual void initPortAI2c()
     {
     }
@@ -371,19 +1466,26 @@ public:
 
     /* ------------------------------ UART monitor ------------------------------ */
     struct UartMonitorData_t {
-        std::mutex mutex;
-        std::queue<uint8_t> rxQueue;
-        std::queue<uint8_t> txQueue;
+        ByteRing<4096> rx;  // Written by the UART task, read by the monitor panel
+        ByteRing<1024> tx;  // Written by uartMonitorSend(), read by the UART task
     };
     UartMonitorData_t uartMonitorData;
+    // What EVENT_REMOTE asks the UI to do, the link answers status requests itself
+    enum RemoteCommand_t {
+        REMOTE_PLAY = 0,
+        REMOTE_STOP,
+        REMOTE_NEXT_STATION,
+        REMOTE_PREVIOUS_STATION,
+        REMOTE_STATION,  // argument: the station's index in the catalog, played at once
+        REMOTE_VOLUME,   // argument: 0..100
+    };
+    // From the UI task only, the tx ring has a single producer
     virtual void uartMonitorSend(std::string msg, bool newLine = true)
     {
-        std::lock_guard<std::mutex> lock(uartMonitorData.mutex);
-        for (auto c : msg) {
-            uartMonitorData.txQueue.push(c);
-        }
+        uartMonitorData.tx.write((const uint8_t*)msg.data(), msg.size());
         if (newLine) {
-            uartMonitorData.txQueue.push('\n');
+            uint8_t c = '\n';
+            uartMonitorData.tx.write(&c, 1);
         }
     }
 };
@@ -429,14 +1531,14 @@ inline hal::HalBase* GetHAL()
 }
 
 /**
- * @brief
+ * @brief The LVGL lock for a scope, tagged with who takes it
  *
  */
 class LvglLockGuard {
 public:
-    LvglLockGuard()
+    LvglLockGuard(hal::HalBase::LvglLockSite_t site = hal::HalBase::LVGL_LOCK_OTHER)
     {
-        GetHAL()->lvglLock();
+        GetHAL()->lvglLockAt(site);
     }
     ~LvglLockGuard()
     {
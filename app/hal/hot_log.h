@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mooncake_log.h>
+#include "hal.h"
+
+/**
+ * @brief Logging for the hot paths (per chunk, per frame, per buffer wait), compiled out below HOT_LOG_LEVEL
+ *
+ * A call above the level is an empty statement: neither the format nor its arguments are evaluated. The Tab5 build
+ * defines the level from menuconfig (CONFIG_TAB5_HOT_LOG_LEVEL), elsewhere it's info, or warnings with NDEBUG. A
+ * translation unit can pick its own by defining HOT_LOG_LEVEL before including this.
+ *
+ *     HOT_LOG_INFO(TAG, "MP3 sync: skipped {} bytes", skipped);
+ *     HOT_LOG_WARN_EVERY(1000, TAG, "Buffer low: {} KB", available / 1024);   // at most once a second
+ */
+#define HOT_LOG_LEVEL_NONE  0
+#define HOT_LOG_LEVEL_ERROR 1
+#define HOT_LOG_LEVEL_WARN  2
+#define HOT_LOG_LEVEL_INFO  3
+
+#ifndef HOT_LOG_LEVEL
+#ifdef NDEBUG
+#define HOT_LOG_LEVEL HOT_LOG_LEVEL_WARN
+#else
+#define HOT_LOG_LEVEL HOT_LOG_LEVEL_INFO
+#endif
+#endif
+
+/**
+ * @brief Lets one call through per interval, from any number of tasks, without a lock
+ */
+class LogLimiter {
+public:
+    explicit constexpr LogLimiter(uint32_t intervalMs) : _interval_ms(intervalMs)
+    {
+    }
+
+    bool allow(uint32_t nowMs)
+    {
+        uint32_t last = _last_ms.load(std::memory_order_relaxed);
+        if (_logged.load(std::memory_order_relaxed) && nowMs - last < _interval_ms) {
+            return false;
+        }
+        // Of several tasks that got here at once, the one that moves the timestamp logs
+        if (!_last_ms.compare_exchange_strong(last, nowMs, std::memory_order_relaxed)) {
+            return false;
+        }
+        _logged.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    uint32_t _interval_ms;
+    std::atomic<uint32_t> _last_ms{0};
+    std::atomic<bool> _logged{false};
+};
+
+#define HOT_LOG_IF_(level, call)                  \
+    do {                                          \
+        if constexpr (HOT_LOG_LEVEL >= (level)) { \
+            call;                                 \
+        }                                         \
+    } while (0)
+
+#define HOT_LOG_EVERY_IF_(level, intervalMs, call)            \
+    do {                                                      \
+        if constexpr (HOT_LOG_LEVEL >= (level)) {             \
+            static LogLimiter hot_log_limiter_(intervalMs);   \
+            if (hot_log_limiter_.allow(GetHAL()->millis())) { \
+                call;                                         \
+            }                                                 \
+        }                                                     \
+    } while (0)
+
+#define HOT_LOG_ERROR(tag, ...) HOT_LOG_IF_(HOT_LOG_LEVEL_ERROR, mclog::tagError(tag, __VA_ARGS__))
+#define HOT_LOG_WARN(tag, ...)  HOT_LOG_IF_(HOT_LOG_LEVEL_WARN, mclog::tagWarn(tag, __VA_ARGS__))
+#define HOT_LOG_INFO(tag, ...)  HOT_LOG_IF_(HOT_LOG_LEVEL_INFO, mclog::tagInfo(tag, __VA_ARGS__))
+
+#define HOT_LOG_WARN_EVERY(intervalMs, tag, ...) \
+    HOT_LOG_EVERY_IF_(HOT_LOG_LEVEL_WARN, intervalMs, mclog::tagWarn(tag, __VA_ARGS__))
+#define HOT_LOG_INFO_EVERY(intervalMs, tag, ...) \
+    HOT_LOG_EVERY_IF_(HOT_LOG_LEVEL_INFO, intervalMs, mclog::tagInfo(tag, __VA_ARGS__))
@@ -0,0 +1,26 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/**
+ * @brief Marks a function the audio or render path runs per chunk, frame or block, to be run from internal RAM
+ *
+ * With CONFIG_SPIRAM_XIP_FROM_PSRAM the code is fetched from PSRAM through the cache, and a miss queues behind the
+ * display's DMA. The Tab5 build defines HOT_PATH_SECTIONS from menuconfig (CONFIG_TAB5_HOT_PATH_IRAM): each marked
+ * function then gets a `.hot_path.N` section of its own, which main/linker.lf places in IRAM. Elsewhere, or with
+ * the option off, it's nothing.
+ *
+ *     HOT_PATH size_t write(const uint8_t* data, size_t len)
+ *
+ * Only for what's measured hot, the stream trace shows it: IRAM is shared with the drivers' ISRs.
+ */
+#if defined(HOT_PATH_SECTIONS) && HOT_PATH_SECTIONS
+#define HOT_PATH_STRINGIFY_(x) #x
+#define HOT_PATH_STRINGIFY(x)  HOT_PATH_STRINGIFY_(x)
+#define HOT_PATH               __attribute__((section(".hot_path." HOT_PATH_STRINGIFY(__COUNTER__))))
+#else
+#define HOT_PATH
+#endif
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string.h>
+
+/**
+ * @brief Text of at most CAPACITY - 1 bytes, held inline and always NUL terminated
+ *
+ * For what the HAL publishes to the UI from its own tasks: it's trivially copyable, so it returns by value, goes into
+ * a Snapshot and copies with a memcpy, and none of that touches the heap. Longer text is cut, on a UTF-8 character
+ * boundary so the tail never shows half a character.
+ *
+ *     InlineString<16> ip = "192.168.1.20";
+ *     set_text(label, ip.c_str());
+ */
+template <size_t CAPACITY>
+class InlineString {
+    static_assert(CAPACITY > 0, "InlineString needs room for the NUL");
+
+public:
+    InlineString() = default;
+    InlineString(const char* text)
+    {
+        assign(text);
+    }
+    InlineString(const std::string& text)
+    {
+        assign(text.data(), text.size());
+    }
+
+    InlineString& operator=(const char* text)
+    {
+        assign(text);
+        return *this;
+    }
+    InlineString& operator=(const std::string& text)
+    {
+        assign(text.data(), text.size());
+        return *this;
+    }
+
+    void assign(const char* text)
+    {
+        assign(text, text ? strlen(text) : 0);
+    }
+    void assign(const char* text, size_t len)
+    {
+        if (len >= CAPACITY) {
+            len = CAPACITY - 1;
+            while (len > 0 && ((unsigned char)text[len] & 0xC0) == 0x80) {
+                len--;  // Back to the start of the character that doesn't fit
+            }
+        }
+        if (len > 0) {
+            memmove(_text, text, len);
+        }
+        _text[len] = '\0';
+    }
+    void clear()
+    {
+        _text[0] = '\0';
+    }
+
+    const char* c_str() const
+    {
+        return _text;
+    }
+    size_t size() const
+    {
+        return strlen(_text);
+    }
+    bool empty() const
+    {
+        return _text[0] == '\0';
+    }
+    static constexpr size_t capacity()
+    {
+        return CAPACITY - 1;
+    }
+
+    bool operator==(const char* text) const
+    {
+        return strcmp(_text, text) == 0;
+    }
+    bool operator!=(const char* text) const
+    {
+        return !(*this == text);
+    }
+    template <size_t OTHER>
+    bool operator==(const InlineString<OTHER>& other) const
+    {
+        return strcmp(_text, other.c_str()) == 0;
+    }
+    template <size_t OTHER>
+    bool operator!=(const InlineString<OTHER>& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    char _text[CAPACITY] = {0};
+};
@@ -0,0 +1,223 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief What LVGL read from its input devices, timestamped, to play a session back read for read
+ *
+ * A recording is an 8 byte header, "T5IR" and a version, then a 12 byte record, little endian, for every change a
+ * device reported: a press, a release, a move or a key. Times are ms since the recording started, a replay plays them
+ * from when it starts, so both should start from the same screen. Points are in the display's coordinates, a
+ * recording replays on the platform that made it. All of it is in memory until saved, a drag recorded on every 16 ms
+ * read is ~750 bytes a second.
+ *
+ *     recorder.read(input_recording::TOUCH, lv_tick_get(), pressed, x, y, 0);  // In the indev's read callback
+ *     recorder.save(path);
+ *
+ *     while (replayer.next(input_recording::POINTERS, lv_tick_get() - startMs, &record)) { ... }
+ */
+namespace input_recording {
+
+enum Device_t : uint8_t {
+    TOUCH = 0,
+    MOUSE,
+    KEYPAD,
+    DEVICE_COUNT,
+};
+// Masks of devices for Replayer::next(), the pointers replay as one on a platform with a single pointer
+static constexpr uint32_t POINTERS = (1 << TOUCH) | (1 << MOUSE);
+static constexpr uint32_t KEYS     = 1 << KEYPAD;
+
+static constexpr char MAGIC[4]      = {'T', '5', 'I', 'R'};
+static constexpr uint32_t VERSION   = 1;
+static constexpr size_t MAX_RECORDS = 1 << 16;  // ~20 minutes of dragging, more isn't kept
+
+struct Record_t {
+    uint32_t atMs;    // Since the recording started
+    uint8_t device;   // Device_t
+    uint8_t pressed;  // Pointer button or key down
+    int16_t x;        // Pointers, in the display's coordinates
+    int16_t y;
+    uint16_t key;  // Keypads, an LV_KEY_ or a character
+};
+static_assert(sizeof(Record_t) == 12, "Records are 12 bytes in the file");
+
+class Recorder {
+public:
+    void start(uint32_t nowMs)
+    {
+        _records.clear();
+        _start_ms  = nowMs;
+        _recording = true;
+        for (bool& seen : _seen) {
+            seen = false;
+        }
+    }
+    void stop()
+    {
+        _recording = false;
+    }
+    bool recording() const
+    {
+        return _recording;
+    }
+
+    /**
+     * @brief What a device's read callback handed LVGL, kept if it changed since the device's last read
+     */
+    void read(Device_t device, uint32_t nowMs, bool pressed, int x, int y, uint32_t key)
+    {
+        if (!_recording || device >= DEVICE_COUNT || _records.size() >= MAX_RECORDS) {
+            return;
+        }
+        Record_t record = {nowMs - _start_ms, device, pressed, (int16_t)x, (int16_t)y, (uint16_t)key};
+        Record_t& last  = _last[device];
+        if (_seen[device] && last.pressed == record.pressed && last.x == record.x && last.y == record.y &&
+            last.key == record.key) {
+            return;
+        }
+        _seen[device] = true;
+        last          = record;
+        _records.push_back(record);
+    }
+
+    size_t size() const
+    {
+        return _records.size();
+    }
+
+    /**
+     * @return false if `path` can't be written
+     */
+    bool save(const char* path) const
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC) &&
+                  fwrite(&VERSION, sizeof(VERSION), 1, file) == 1 &&
+                  fwrite(_records.data(), sizeof(Record_t), _records.size(), file) == _records.size();
+        return fclose(file) == 0 && ok;
+    }
+
+private:
+    std::vector<Record_t> _records;
+    uint32_t _start_ms = 0;
+    bool _recording    = false;
+    Record_t _last[DEVICE_COUNT]{};
+    bool _seen[DEVICE_COUNT]{};  // The first read of a device is always kept, it's the state the replay starts from
+};
+
+class Replayer {
+public:
+    /**
+     * @return false if `path` can't be read or isn't a recording
+     */
+    bool load(const char* path)
+    {
+        _records.clear();
+        rewind();
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        char magic[sizeof(MAGIC)];
+        uint32_t version = 0;
+        bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                  fread(&version, sizeof(version), 1, file) == 1 && version == VERSION;
+        Record_t record;
+        while (ok && _records.size() < MAX_RECORDS && fread(&record, sizeof(record), 1, file) == 1) {
+            if (record.device < DEVICE_COUNT) {
+                _records.push_back(record);
+            }
+        }
+        fclose(file);
+        return ok;
+    }
+
+    void rewind()
+    {
+        for (size_t& cursor : _cursor) {
+            cursor = 0;
+        }
+    }
+
+    /**
+     * @brief The oldest record not replayed yet of one of `devices` (a mask of 1 << Device_t) that's due by
+     * `elapsedMs`, one a call so that a press and its release read in the same period both get to LVGL
+     *
+     * @return false if none is due
+     */
+    bool next(uint32_t devices, uint32_t elapsedMs, Record_t* record)
+    {
+        int due = -1;
+        for (int device = 0; device < DEVICE_COUNT; device++) {
+            const Record_t* next = (devices & (1u << device)) ? upcoming(device) : nullptr;
+            if (next && next->atMs <= elapsedMs && (due < 0 || next->atMs < _records[_cursor[due]].atMs)) {
+                due = device;
+            }
+        }
+        if (due < 0) {
+            return false;
+        }
+        *record = _records[_cursor[due]++];
+        return true;
+    }
+
+    /**
+     * @brief Whether next() has another record due, for lv_indev_data_t::continue_reading
+     */
+    bool pending(uint32_t devices, uint32_t elapsedMs)
+    {
+        for (int device = 0; device < DEVICE_COUNT; device++) {
+            const Record_t* next = (devices & (1u << device)) ? upcoming(device) : nullptr;
+            if (next && next->atMs <= elapsedMs) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const
+    {
+        return _records.size();
+    }
+    // When the first button or key went down, a run is measured from there, what's before it is the start screen
+    uint32_t firstPressMs() const
+    {
+        for (const auto& record : _records) {
+            if (record.pressed) {
+                return record.atMs;
+            }
+        }
+        return lastMs();
+    }
+    uint32_t lastMs() const
+    {
+        return _records.empty() ? 0 : _records.back().atMs;
+    }
+
+private:
+    std::vector<Record_t> _records;
+    size_t _cursor[DEVICE_COUNT]{};  // Per device, at or before its next record
+
+    // The device's next record, its cursor moved up to it
+    const Record_t* upcoming(int device)
+    {
+        size_t& cursor = _cursor[device];
+        while (cursor < _records.size() && _records[cursor].device != device) {
+            cursor++;
+        }
+        return cursor < _records.size() ? &_records[cursor] : nullptr;
+    }
+};
+
+}  // namespace input_recording
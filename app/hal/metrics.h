@@ -0,0 +1,265 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+/**
+ * @brief Process-wide counters, gauges and histograms, rendered in the Prometheus text format
+ *
+ * Metrics are statics that register themselves when constructed, updating one is a relaxed atomic add or store that
+ * never blocks, so the audio tasks can count from their hot paths. A scrape only loads the atomics: it may see one
+ * metric a step ahead of another, never a torn value.
+ *
+ *     static metrics::Counter s_underruns("radio_underruns_total", "Output ran dry");
+ *     static metrics::Histogram s_render("ui_render_ms", "Render time per frame", {2, 5, 10, 20, 50});
+ *     static metrics::Gauge s_stack("task_stack_free_bytes", "Least free stack so far", "task=\"audio_decode\"");
+ *     s_underruns.inc();
+ *     metrics::render(&text);   // The HTTP server's task
+ *
+ * Metrics sharing a name are one family told apart by their labels. Counters are 32 bits, Prometheus takes a wrap
+ * for a counter reset.
+ */
+namespace metrics {
+
+enum Type_t {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+};
+
+class Metric {
+public:
+    /**
+     * @param labels `key="value"` pairs without the braces, nullptr for none. All three are kept, not copied
+     */
+    Metric(const char* name, const char* help, Type_t type, const char* labels)
+        : _name(name), _help(help), _labels(labels), _type(type)
+    {
+        // Statics are constructed before any task starts, but stay safe for a function-local one
+        _next = head().load(std::memory_order_relaxed);
+        while (!head().compare_exchange_weak(_next, this, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+    Metric(const Metric&)            = delete;
+    Metric& operator=(const Metric&) = delete;
+
+    const char* name() const
+    {
+        return _name;
+    }
+    const char* help() const
+    {
+        return _help;
+    }
+    Type_t type() const
+    {
+        return _type;
+    }
+    const Metric* next() const
+    {
+        return _next;
+    }
+
+    // Appends the sample lines, without HELP and TYPE
+    virtual void renderSamples(std::string* out) const = 0;
+
+    static const Metric* first()
+    {
+        return head().load(std::memory_order_acquire);
+    }
+
+protected:
+    // `name{labels,extra} value`, `extra` being another `key="value"` or nullptr
+    void appendSample(std::string* out, const char* suffix, const char* extra, const char* value) const
+    {
+        out->append(_name);
+        out->append(suffix);
+        bool labels = _labels && _labels[0];
+        if (labels || extra) {
+            out->push_back('{');
+            if (labels) {
+                out->append(_labels);
+            }
+            if (labels && extra) {
+                out->push_back(',');
+            }
+            if (extra) {
+                out->append(extra);
+            }
+            out->push_back('}');
+        }
+        out->push_back(' ');
+        out->append(value);
+        out->push_back('\n');
+    }
+
+private:
+    static std::atomic<Metric*>& head()
+    {
+        // Constant initialised, so it's there for metrics constructed during static initialisation
+        static std::atomic<Metric*> s_head{nullptr};
+        return s_head;
+    }
+
+    const char* _name;
+    const char* _help;
+    const char* _labels;
+    Type_t _type;
+    Metric* _next = nullptr;
+};
+
+class Counter : public Metric {
+public:
+    Counter(const char* name, const char* help, const char* labels = nullptr) : Metric(name, help, COUNTER, labels)
+    {
+    }
+
+    void inc(uint32_t n = 1)
+    {
+        _value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint32_t value() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+    void renderSamples(std::string* out) const override
+    {
+        char value[16];
+        snprintf(value, sizeof(value), "%u", (unsigned)this->value());
+        appendSample(out, "", nullptr, value);
+    }
+
+private:
+    std::atomic<uint32_t> _value{0};
+};
+
+class Gauge : public Metric {
+public:
+    Gauge(const char* name, const char* help, const char* labels = nullptr) : Metric(name, help, GAUGE, labels)
+    {
+    }
+
+    void set(float value)
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+    float value() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+    void renderSamples(std::string* out) const override
+    {
+        char value[24];
+        snprintf(value, sizeof(value), "%g", (double)this->value());
+        appendSample(out, "", nullptr, value);
+    }
+
+private:
+    std::atomic<float> _value{0};
+};
+
+/**
+ * @brief Counts of observations at or below each of up to MAX_BUCKETS fixed upper bounds
+ *
+ * Bounds and values are integers in the unit the name says (`_ms`, `_bytes`), the sum wraps like a counter.
+ */
+class Histogram : public Metric {
+public:
+    static constexpr size_t MAX_BUCKETS = 12;
+
+    /**
+     * @param bounds ascending upper bounds, the +Inf bucket is implied
+     */
+    Histogram(const char* name, const char* help, std::initializer_list<uint32_t> bounds,
+              const char* labels = nullptr)
+        : Metric(name, help, HISTOGRAM, labels)
+    {
+        for (uint32_t bound : bounds) {
+            if (_bucket_count == MAX_BUCKETS) {
+                break;
+            }
+            _bounds[_bucket_count++] = bound;
+        }
+    }
+
+    void observe(uint32_t value)
+    {
+        size_t i = 0;
+        while (i < _bucket_count && value > _bounds[i]) {
+            i++;
+        }
+        _counts[i].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void renderSamples(std::string* out) const override
+    {
+        // Cumulative, and the count is the +Inf bucket, so the buckets agree with each other even mid-update
+        char le[24];
+        char value[16];
+        uint32_t cumulative = 0;
+        for (size_t i = 0; i <= _bucket_count; i++) {
+            cumulative += _counts[i].load(std::memory_order_relaxed);
+            if (i < _bucket_count) {
+                snprintf(le, sizeof(le), "le=\"%u\"", (unsigned)_bounds[i]);
+            } else {
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            }
+            snprintf(value, sizeof(value), "%u", (unsigned)cumulative);
+            appendSample(out, "_bucket", le, value);
+        }
+        snprintf(value, sizeof(value), "%u", (unsigned)_sum.load(std::memory_order_relaxed));
+        appendSample(out, "_sum", nullptr, value);
+        snprintf(value, sizeof(value), "%u", (unsigned)cumulative);
+        appendSample(out, "_count", nullptr, value);
+    }
+
+private:
+    uint32_t _bounds[MAX_BUCKETS] = {};
+    size_t _bucket_count          = 0;
+    std::atomic<uint32_t> _counts[MAX_BUCKETS + 1]{};
+    std::atomic<uint32_t> _sum{0};
+};
+
+/**
+ * @brief Append every registered metric in the Prometheus text exposition format (version 0.0.4)
+ */
+inline void render(std::string* out)
+{
+    static const char* const TYPES[] = {"counter", "gauge", "histogram"};
+    for (const Metric* metric = Metric::first(); metric; metric = metric->next()) {
+        // A family is written where its first member is, with all the others
+        bool seen = false;
+        for (const Metric* earlier = Metric::first(); earlier != metric; earlier = earlier->next()) {
+            if (strcmp(earlier->name(), metric->name()) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+        out->append("# HELP ").append(metric->name()).append(" ").append(metric->help()).append("\n");
+        out->append("# TYPE ").append(metric->name()).append(" ").append(TYPES[metric->type()]).append("\n");
+        for (const Metric* member = metric; member; member = member->next()) {
+            if (strcmp(member->name(), metric->name()) == 0) {
+                member->renderSamples(out);
+            }
+        }
+    }
+}
+
+}  // namespace metrics
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+
+/**
+ * @brief Single-writer seqlock around a trivially copyable value
+ *
+ * The writer never waits. A reader copies the value and retries if the sequence number was odd (write in
+ * progress) or changed underneath it, so it never blocks the writer and never sees half an update. Only one task may
+ * call `store()` at a time.
+ *
+ *     Snapshot<Position_t> s_position;
+ *     s_position.store({x, y});                 // Writer's task
+ *     Position_t position = s_position.load();  // Any task
+ */
+template <typename T>
+class Snapshot {
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshot needs a trivially copyable type");
+
+public:
+    void store(const T& value)
+    {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &value, sizeof(T));
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        T value;
+        for (int attempt = 0;; attempt++) {
+            uint32_t before = _seq.load(std::memory_order_acquire);
+            if ((before & 1) == 0) {
+                memcpy(&value, &_value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_seq.load(std::memory_order_relaxed) == before) {
+                    return value;
+                }
+            }
+            // A higher priority reader on the writer's core would spin forever, let the writer finish
+            if (attempt >= 8) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+private:
+    std::atomic<uint32_t> _seq{0};
+    T _value{};
+};
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief AAC ADTS frame header parsing, the AAC counterpart of mp3_frame
+ *
+ * See: https://wiki.multimedia.cx/index.php/ADTS
+ */
+namespace adts_frame {
+
+static constexpr size_t HEADER_SIZE    = 7;
+static constexpr size_t MAX_FRAME_SIZE = 8191;  // 13 bit length field
+
+struct FrameInfo_t {
+    int sampleRate   = 0;  // Core AAC rate, HE-AAC decodes to twice this
+    int channels     = 0;
+    bool vbr         = false;  // Buffer fullness 0x7FF marks a variable rate stream
+    size_t frameSize = 0;      // Including the header
+};
+
+static constexpr int SAMPLES_PER_FRAME = 1024;  // Core AAC, before SBR
+
+/**
+ * @return true if `header` (7 bytes) is a valid ADTS header
+ */
+inline bool parse_header(const uint8_t* header, FrameInfo_t* info)
+{
+    static const int32_t sample_rates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                             22050, 16000, 12000, 11025, 8000,  7350};
+
+    // Sync word: 12 bits set, then MPEG version, layer (always 00)
+    if (header[0] != 0xFF || (header[1] & 0xF6) != 0xF0) {
+        return false;
+    }
+
+    int sampleRateIdx = (header[2] >> 2) & 0x0F;
+    int channelConfig = ((header[2] & 0x01) << 2) | (header[3] >> 6);
+    size_t frameSize  = ((size_t)(header[3] & 0x03) << 11) | ((size_t)header[4] << 3) | (header[5] >> 5);
+    bool hasCrc       = (header[1] & 0x01) == 0;
+    if (sampleRateIdx >= 13 || channelConfig == 0 || frameSize < (hasCrc ? HEADER_SIZE + 2 : HEADER_SIZE)) {
+        return false;
+    }
+
+    info->sampleRate = sample_rates[sampleRateIdx];
+    info->channels   = (channelConfig == 7) ? 8 : channelConfig;
+    info->frameSize  = frameSize;
+    info->vbr        = (((header[5] & 0x1F) << 6) | (header[6] >> 2)) == 0x7FF;
+    return true;
+}
+
+/**
+ * @brief Find the first frame in `data`, confirmed by the following header when it's in `data` too
+ *
+ * @return offset of the frame, -1 if there is none
+ */
+inline int find_frame(const uint8_t* data, size_t len, FrameInfo_t* info)
+{
+    for (size_t i = 0; i + HEADER_SIZE <= len; i++) {
+        if (!parse_header(data + i, info)) {
+            continue;
+        }
+
+        size_t next = i + info->frameSize;
+        if (next + HEADER_SIZE <= len) {
+            FrameInfo_t nextInfo;
+            if (!parse_header(data + next, &nextInfo) || nextInfo.sampleRate != info->sampleRate) {
+                continue;
+            }
+        }
+        return (int)i;
+    }
+    return -1;
+}
+
+}  // namespace adts_frame
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Holds a live stream's buffer level where playback settled, by trimming the output's rate
+ *
+ * The encoder's sample clock and the local output clock never quite agree. 50 ppm apart the buffer gains or loses
+ * 4 seconds a day, so after a few days of uptime it runs dry or fills the ring. The level is low-passed over
+ * minutes, long enough to average out network hiccups, power save refill bursts and HLS segments. A PI loop on the
+ * distance from the reference then turns it into a rate trim for the resampler, at most MAX_PPM either way. The
+ * reference is the mean level over the first SETTLE_S of playback; the integral term is the clocks' actual
+ * difference and survives rebase().
+ *
+ *     ClockDrift drift;
+ *     int ppm = drift.update(bufferedSeconds, elapsedSeconds);  // Every second or so while playing
+ *     drift.rebase();                                           // After a skip, pause or rebuffer
+ *     drift.reset();                                            // Another station, another encoder clock
+ */
+class ClockDrift {
+public:
+    static constexpr float MAX_PPM     = 1000;   // The resampler's trim range
+    static constexpr float SMOOTHING_S = 300;    // Level low-pass time constant
+    static constexpr float SETTLE_S    = 300;    // Averaged into the reference
+    static constexpr float GAIN_PPM    = 100;    // Per second of level off the reference
+    static constexpr float INTEGRAL_S  = 14400;  // Integral time, well damped with the gain
+
+    void reset()
+    {
+        _integral = 0;
+        rebase();
+    }
+
+    /**
+     * @brief Take a new reference, the drift found so far is kept
+     */
+    void rebase()
+    {
+        _settled  = 0;
+        _smoothed = 0;
+        _ppm      = _integral;
+    }
+
+    /**
+     * @param level seconds of audio buffered ahead
+     * @param elapsed seconds since the last update
+     * @return trim in ppm, positive to play faster
+     */
+    int update(float level, float elapsed)
+    {
+        if (elapsed <= 0) {
+            return ppm();
+        }
+        if (_settled < SETTLE_S) {
+            // A plain mean to begin with, the low-pass carries on from it
+            _settled += elapsed;
+            _smoothed += (level - _smoothed) * elapsed / _settled;
+            _reference = _smoothed;
+            return ppm();
+        }
+        _smoothed += (level - _smoothed) * std::min(1.0f, elapsed / SMOOTHING_S);
+
+        // Growing means the encoder's clock is ahead of ours. The integral only moves while the output isn't
+        // clamped, so a long dropout doesn't wind it up
+        float error    = _smoothed - _reference;
+        float integral = _integral + GAIN_PPM * error * elapsed / INTEGRAL_S;
+        float output   = GAIN_PPM * error + integral;
+        if (std::fabs(output) < MAX_PPM) {
+            _integral = integral;
+        }
+        _ppm = std::min(std::max(output, -MAX_PPM), MAX_PPM);
+        return ppm();
+    }
+
+    int ppm() const
+    {
+        return (int)lroundf(_ppm);
+    }
+
+    // Seconds the smoothed level is off the reference, 0 while settling
+    float error() const
+    {
+        return _smoothed - _reference;
+    }
+
+private:
+    float _smoothed  = 0;
+    float _reference = 0;
+    float _integral  = 0;  // ppm
+    float _ppm       = 0;
+    float _settled   = 0;  // Seconds into the reference
+};
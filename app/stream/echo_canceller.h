@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <dsps_dotprod.h>
+
+/**
+ * @brief Takes what the speaker plays out of what a mic hears, NLMS against the codec's reference of the speaker
+ *
+ * The reference is the signal going to the speaker, sampled with the mics so the two are in step: the filter only
+ * has to learn the path from the speaker to the mic, which in a case this size ends within a few ms. One TAPS long
+ * dot product per sample (esp-dsp) gives the echo estimate, and while the mic is much louder than anything the
+ * speaker played (someone talking over it, the Geigel test) the filter holds still so it doesn't learn the voice.
+ *
+ *     EchoCanceller aec;
+ *     aec.init();
+ *     aec.process(mic, ref, out, 64);  // Floats, the same sample rate on both
+ */
+class EchoCanceller {
+public:
+    static constexpr int MAX_TAPS        = 512;
+    static constexpr float GEIGEL_RATIO  = 2.0f;  // Mic over the reference peak that counts as talk
+    static constexpr int DOUBLETALK_HOLD = 480;   // Samples adaptation stays off after talk, 30 ms at 16 kHz
+
+    /**
+     * @param taps filter length in samples, 128 is 8 ms at 16 kHz
+     * @param mu step size, smaller adapts slower but leaves less of the echo once settled
+     */
+    void init(int taps = 128, float mu = 0.25f)
+    {
+        _taps = std::min(std::max(taps, 8), MAX_TAPS);
+        _mu   = mu;
+        reset();
+    }
+
+    void reset()
+    {
+        _w.assign(_taps, 0.0f);
+        _x.assign(_taps * 2, 0.0f);
+        _pos       = 0;
+        _power     = 0;
+        _ref_peak  = 0;
+        _hold      = 0;
+        _mic_level = 0;
+        _out_level = 0;
+    }
+
+    /**
+     * @param out `n` samples, can be `mic` itself
+     */
+    void process(const float* mic, const float* ref, float* out, size_t n)
+    {
+        const float peakDecay = 1.0f - 1.0f / _taps;
+        for (size_t i = 0; i < n; i++) {
+            // The history is kept twice over so the newest TAPS samples are always one run, oldest first
+            float oldest = _x[_pos];
+            float x      = ref[i];
+            _x[_pos]         = x;
+            _x[_pos + _taps] = x;
+            _pos             = (_pos + 1 == _taps) ? 0 : _pos + 1;
+            _power           = std::max(0.0f, _power + x * x - oldest * oldest);
+            _ref_peak        = std::max(fabsf(x), _ref_peak * peakDecay);
+
+            const float* window = &_x[_pos];
+            float echo          = 0;
+            dsps_dotprod_f32(window, _w.data(), &echo, _taps);
+            float d = mic[i];
+            float e = d - echo;
+
+            if (fabsf(d) > GEIGEL_RATIO * _ref_peak && fabsf(d) > 1e-4f) {
+                _hold = DOUBLETALK_HOLD;
+            }
+            if (_hold > 0) {
+                _hold--;
+            } else if (_power > 1e-6f) {
+                float g = _mu * e / (_power + 1e-3f);
+                for (int k = 0; k < _taps; k++) {
+                    _w[k] += g * window[k];
+                }
+            }
+
+            _mic_level += (d * d - _mic_level) * LEVEL_SMOOTHING;
+            _out_level += (e * e - _out_level) * LEVEL_SMOOTHING;
+            out[i] = e;
+        }
+    }
+
+    /**
+     * @brief How much quieter the output is than the mic, in dB: the echo taken out while only the speaker plays
+     */
+    float erleDb() const
+    {
+        return 10.0f * log10f((_mic_level + 1e-12f) / (_out_level + 1e-12f));
+    }
+
+    bool doubleTalk() const
+    {
+        return _hold > 0;
+    }
+
+private:
+    static constexpr float LEVEL_SMOOTHING = 1.0f / 8000;  // About half a second at 16 kHz
+
+    int _taps        = 128;
+    float _mu        = 0.25f;
+    int _pos         = 0;
+    float _power     = 0;  // Of the reference over the filter's length
+    float _ref_peak  = 0;
+    int _hold        = 0;
+    float _mic_level = 0;
+    float _out_level = 0;
+
+    std::vector<float> _w;  // Tap k weighs window[k], oldest first like the history
+    std::vector<float> _x;
+};
@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <string.h>
+
+/**
+ * @brief Minimal HLS (RFC 8216) playlist parsing, enough for live audio
+ *
+ * Handles master playlists (variants) and media playlists (segments with their media sequence). Encryption, byte
+ * ranges and discontinuities aren't supported.
+ */
+namespace hls_playlist {
+
+struct Segment_t {
+    int64_t sequence = 0;
+    float duration   = 0;
+    std::string uri;
+};
+
+struct Variant_t {
+    int bandwidth = 0;
+    std::string codecs;
+    std::string uri;
+};
+
+struct Playlist_t {
+    bool isMaster         = false;
+    bool endList          = false;
+    int targetDuration    = 0;  // Seconds
+    int64_t mediaSequence = 0;
+    std::vector<Segment_t> segments;
+    std::vector<Variant_t> variants;
+};
+
+/**
+ * @brief Resolve a playlist entry against the playlist's own URL
+ */
+inline std::string resolve_url(const std::string& base, const std::string& ref)
+{
+    if (ref.find("://") != std::string::npos) {
+        return ref;
+    }
+
+    size_t schemeEnd = base.find("://");
+    size_t hostEnd   = base.find('/', schemeEnd == std::string::npos ? 0 : schemeEnd + 3);
+    if (!ref.empty() && ref[0] == '/') {
+        return base.substr(0, hostEnd) + ref;
+    }
+
+    // Relative to the directory of the base, ignoring its query string
+    std::string path = base.substr(0, base.find('?'));
+    size_t lastSlash = path.rfind('/');
+    if (lastSlash == std::string::npos || (hostEnd != std::string::npos && lastSlash < hostEnd)) {
+        return path + "/" + ref;
+    }
+    return path.substr(0, lastSlash + 1) + ref;
+}
+
+/**
+ * @brief Read an `ATTR=value` or `ATTR="value"` from an attribute list
+ */
+inline std::string attribute(const std::string& line, const char* name)
+{
+    std::string key = std::string(name) + "=";
+    size_t pos      = 0;
+    while ((pos = line.find(key, pos)) != std::string::npos) {
+        // Must start an attribute, not be the tail of a longer name
+        if (pos == 0 || line[pos - 1] == ',' || line[pos - 1] == ':') {
+            break;
+        }
+        pos += key.size();
+    }
+    if (pos == std::string::npos) {
+        return "";
+    }
+
+    pos += key.size();
+    if (pos < line.size() && line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        return line.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+    }
+    size_t end = line.find(',', pos);
+    return line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+/**
+ * @return false if `text` isn't a playlist
+ */
+inline bool parse(const std::string& text, Playlist_t* playlist)
+{
+    *playlist = Playlist_t();
+
+    size_t pos            = 0;
+    bool first            = true;
+    float pendingDuration = -1;
+    Variant_t pendingVariant;
+    bool variantPending = false;
+
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(pos, end - pos);
+        pos              = end + 1;
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        if (first) {
+            if (line.compare(0, 7, "#EXTM3U") != 0) {
+                return false;
+            }
+            first = false;
+            continue;
+        }
+
+        if (line[0] == '#') {
+            if (line.compare(0, 8, "#EXTINF:") == 0) {
+                pendingDuration = atof(line.c_str() + 8);
+            } else if (line.compare(0, 22, "#EXT-X-TARGETDURATION:") == 0) {
+                playlist->targetDuration = atoi(line.c_str() + 22);
+            } else if (line.compare(0, 22, "#EXT-X-MEDIA-SEQUENCE:") == 0) {
+                playlist->mediaSequence = atoll(line.c_str() + 22);
+            } else if (line.compare(0, 14, "#EXT-X-ENDLIST") == 0) {
+                playlist->endList = true;
+            } else if (line.compare(0, 18, "#EXT-X-STREAM-INF:") == 0) {
+                pendingVariant           = Variant_t();
+                pendingVariant.bandwidth = atoi(attribute(line, "BANDWIDTH").c_str());
+                pendingVariant.codecs    = attribute(line, "CODECS");
+                variantPending           = true;
+                playlist->isMaster       = true;
+            }
+            continue;
+        }
+
+        // A URI line belongs to the tag before it
+        if (variantPending) {
+            pendingVariant.uri = line;
+            playlist->variants.push_back(pendingVariant);
+            variantPending = false;
+        } else if (pendingDuration >= 0) {
+            Segment_t segment;
+            segment.sequence = playlist->mediaSequence + (int64_t)playlist->segments.size();
+            segment.duration = pendingDuration;
+            segment.uri      = line;
+            playlist->segments.push_back(segment);
+            pendingDuration = -1;
+        }
+    }
+    return !first;
+}
+
+}  // namespace hls_playlist
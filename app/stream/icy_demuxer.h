@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+#include <hal/hot_path.h>
+
+/**
+ * @brief Incremental ICY (Shoutcast/Icecast) stream demuxer
+ *
+ * An ICY stream is `metaInt` audio bytes, one length byte (N * 16), N * 16 bytes of metadata, then audio again. The
+ * demuxer remembers where it is between calls, so chunks can be split at any byte. Audio is handed out as spans
+ * pointing straight into the caller's chunk, only metadata (at most 4080 bytes) is accumulated into a local buffer:
+ *
+ *     icy.reset(metaInt);
+ *     icy.feed(chunk, len,
+ *              [&](const uint8_t* audio, size_t n) { ring.write(audio, n); },
+ *              [&](const char* meta, size_t n) { parse(meta, n); });
+ *
+ * With `metaInt == 0` every byte is audio.
+ */
+class IcyDemuxer {
+public:
+    static constexpr size_t MAX_METADATA_SIZE = 255 * 16;
+
+    void reset(int metaInt)
+    {
+        _meta_int    = (metaInt > 0) ? (size_t)metaInt : 0;
+        _state       = STATE_AUDIO;
+        _remaining   = _meta_int;
+        _meta_len    = 0;
+        _meta_filled = 0;
+    }
+
+    int metaInt() const
+    {
+        return (int)_meta_int;
+    }
+
+    /**
+     * @brief Demux one chunk
+     *
+     * @param onAudio called as `onAudio(const uint8_t* data, size_t len)` for each audio span
+     * @param onMetadata called as `onMetadata(const char* text, size_t len)` once a metadata block is complete, the
+     * text is NUL terminated
+     */
+    template <typename AudioFn, typename MetaFn>
+    HOT_PATH void feed(const uint8_t* data, size_t len, AudioFn onAudio, MetaFn onMetadata)
+    {
+        if (_meta_int == 0) {
+            if (len > 0) {
+                onAudio(data, len);
+            }
+            return;
+        }
+
+        size_t pos = 0;
+        while (pos < len) {
+            switch (_state) {
+                case STATE_AUDIO: {
+                    size_t n = len - pos;
+                    if (n > _remaining) {
+                        n = _remaining;
+                    }
+                    onAudio(data + pos, n);
+                    pos += n;
+                    _remaining -= n;
+                    if (_remaining == 0) {
+                        _state = STATE_LENGTH;
+                    }
+                    break;
+                }
+
+                case STATE_LENGTH:
+                    _meta_len    = (size_t)data[pos++] * 16;
+                    _meta_filled = 0;
+                    if (_meta_len == 0) {
+                        // Empty block, the title hasn't changed
+                        start_audio();
+                    } else {
+                        _state = STATE_METADATA;
+                    }
+                    break;
+
+                case STATE_METADATA: {
+                    size_t n = len - pos;
+                    if (n > _meta_len - _meta_filled) {
+                        n = _meta_len - _meta_filled;
+                    }
+                    memcpy(_meta + _meta_filled, data + pos, n);
+                    pos += n;
+                    _meta_filled += n;
+                    if (_meta_filled == _meta_len) {
+                        _meta[_meta_len] = '\0';
+                        onMetadata((const char*)_meta, _meta_len);
+                        start_audio();
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Find the title in a metadata block, `StreamTitle='Artist - Track';StreamUrl='...';`
+     *
+     * @return false if the block has none or it's empty, `title` then points into `metadata`, not NUL terminated
+     */
+    static bool streamTitle(const char* metadata, const char** title, size_t* len)
+    {
+        const char* start = strstr(metadata, "StreamTitle='");
+        if (!start) {
+            return false;
+        }
+        start += 13;  // Skip "StreamTitle='"
+        const char* end = strchr(start, '\'');
+        if (!end || end == start) {
+            return false;
+        }
+        *title = start;
+        *len   = end - start;
+        return true;
+    }
+
+private:
+    enum State_t {
+        STATE_AUDIO,
+        STATE_LENGTH,
+        STATE_METADATA,
+    };
+
+    void start_audio()
+    {
+        _state     = STATE_AUDIO;
+        _remaining = _meta_int;
+    }
+
+    size_t _meta_int    = 0;
+    State_t _state      = STATE_AUDIO;
+    size_t _remaining   = 0;  // Audio bytes left before the next length byte
+    size_t _meta_len    = 0;
+    size_t _meta_filled = 0;
+    uint8_t _meta[MAX_METADATA_SIZE + 1];
+};
@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief A music library as one sorted blob: artist / album / title to the file, looked up by binary search
+ *
+ * Written to the card as is and read back into one buffer, so a library of thousands of files costs a handful of
+ * allocations rather than a few per file. Layout, in the byte order of the machine that wrote it (little endian on
+ * both platforms):
+ *
+ *     Header_t
+ *     Record_t[count]   by artist, then album, then title, case-insensitive
+ *     uint32_t[count]   record numbers by title
+ *     char[strings]     NUL terminated, what the records point at
+ *
+ *     MediaIndex index;
+ *     index.load(std::move(blob));
+ *     index.findByArtist("boards", [&](const MediaIndex::Record_t& r) {
+ *         printf("%s - %s\n", index.string(r.album), index.string(r.title));
+ *         return true;  // false stops
+ *     });
+ */
+class MediaIndex {
+public:
+    static constexpr uint32_t MAGIC   = 0x5844494D;  // "MIDX"
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header_t {
+        uint32_t magic   = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t count   = 0;
+        uint32_t strings = 0;  // Bytes
+    };
+
+    struct Record_t {
+        uint32_t artist;  // Offsets into the strings
+        uint32_t album;
+        uint32_t title;
+        uint32_t path;   // On the card, from its root
+        uint32_t size;   // Of the file when its tags were read, a rescan reads them again if either changed
+        uint32_t mtime;
+    };
+
+    /**
+     * @brief Take `blob` over if it's a whole, consistent index, nothing in it can point outside it then
+     */
+    bool load(std::vector<uint8_t>&& blob)
+    {
+        if (blob.size() < sizeof(Header_t)) {
+            return false;
+        }
+        Header_t header;
+        memcpy(&header, blob.data(), sizeof(header));
+        uint64_t expected = sizeof(Header_t) + (uint64_t)header.count * (sizeof(Record_t) + sizeof(uint32_t)) +
+                            header.strings;
+        if (header.magic != MAGIC || header.version != VERSION || expected != blob.size() || header.strings == 0 ||
+            blob.back() != '\0') {
+            return false;
+        }
+        const Record_t* records = (const Record_t*)(blob.data() + sizeof(Header_t));
+        const uint32_t* order   = (const uint32_t*)(records + header.count);
+        for (uint32_t i = 0; i < header.count; i++) {
+            const Record_t& r = records[i];
+            if (r.artist >= header.strings || r.album >= header.strings || r.title >= header.strings ||
+                r.path >= header.strings || order[i] >= header.count) {
+                return false;
+            }
+        }
+        _blob  = std::move(blob);
+        _count = header.count;
+        return true;
+    }
+
+    void clear()
+    {
+        _blob.clear();
+        _count = 0;
+    }
+
+    const std::vector<uint8_t>& data() const
+    {
+        return _blob;
+    }
+
+    uint32_t size() const
+    {
+        return _count;
+    }
+
+    const Record_t& record(uint32_t i) const
+    {
+        return records()[i];
+    }
+
+    const char* string(uint32_t offset) const
+    {
+        return strings() + offset;
+    }
+
+    /**
+     * @brief Records whose artist starts with `prefix`, by artist, album and title. An empty prefix walks them all
+     */
+    template <typename Fn>
+    void findByArtist(const char* prefix, Fn onRecord) const
+    {
+        size_t len = strlen(prefix);
+        auto first = records();
+        auto last  = first + _count;
+        auto it    = std::lower_bound(first, last, prefix, [this](const Record_t& r, const char* p) {
+            return strcasecmp(string(r.artist), p) < 0;
+        });
+        for (; it != last && strncasecmp(string(it->artist), prefix, len) == 0; ++it) {
+            if (!onRecord(*it)) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Records whose title starts with `prefix`, by title
+     */
+    template <typename Fn>
+    void findByTitle(const char* prefix, Fn onRecord) const
+    {
+        size_t len = strlen(prefix);
+        auto first = titleOrder();
+        auto last  = first + _count;
+        auto it    = std::lower_bound(first, last, prefix, [this](uint32_t i, const char* p) {
+            return strcasecmp(string(record(i).title), p) < 0;
+        });
+        for (; it != last && strncasecmp(string(record(*it).title), prefix, len) == 0; ++it) {
+            if (!onRecord(record(*it))) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Record numbers by path, for findPath(). Built on demand since only a rescan looks paths up
+     */
+    std::vector<uint32_t> pathOrder() const
+    {
+        std::vector<uint32_t> order(_count);
+        for (uint32_t i = 0; i < _count; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return strcmp(string(record(a).path), string(record(b).path)) < 0;
+        });
+        return order;
+    }
+
+    /**
+     * @return the record of `path`, nullptr if it isn't in the index
+     */
+    const Record_t* findPath(const std::vector<uint32_t>& pathOrder, const char* path) const
+    {
+        auto it = std::lower_bound(pathOrder.begin(), pathOrder.end(), path, [this](uint32_t i, const char* p) {
+            return strcmp(string(record(i).path), p) < 0;
+        });
+        if (it == pathOrder.end() || strcmp(string(record(*it).path), path) != 0) {
+            return nullptr;
+        }
+        return &record(*it);
+    }
+
+private:
+    std::vector<uint8_t> _blob;
+    uint32_t _count = 0;
+
+    const Record_t* records() const
+    {
+        return (const Record_t*)(_blob.data() + sizeof(Header_t));
+    }
+
+    const uint32_t* titleOrder() const
+    {
+        return (const uint32_t*)(records() + _count);
+    }
+
+    const char* strings() const
+    {
+        return (const char*)(titleOrder() + _count);
+    }
+};
+
+/**
+ * @brief Collects records in any order, then sorts and lays them out as MediaIndex::load() takes them
+ *
+ * Strings go into one growing pool. Files of an album come one after the other in a walk of the card, so an artist
+ * or album the same as the record before it is stored once.
+ */
+class MediaIndexBuilder {
+public:
+    void add(const char* artist, const char* album, const char* title, const char* path, uint32_t size,
+             uint32_t mtime)
+    {
+        MediaIndex::Record_t r;
+        r.artist = (!_records.empty() && strcmp(artist, pool(_records.back().artist)) == 0) ? _records.back().artist
+                                                                                            : intern(artist);
+        r.album  = (!_records.empty() && strcmp(album, pool(_records.back().album)) == 0) ? _records.back().album
+                                                                                          : intern(album);
+        r.title  = intern(title);
+        r.path   = intern(path);
+        r.size   = size;
+        r.mtime  = mtime;
+        _records.push_back(r);
+    }
+
+    size_t size() const
+    {
+        return _records.size();
+    }
+
+    std::vector<uint8_t> finish()
+    {
+        if (_strings.empty()) {
+            _strings.push_back('\0');  // load() wants a terminated pool, even an empty index has one byte
+        }
+        using Record_t = MediaIndex::Record_t;
+        std::sort(_records.begin(), _records.end(), [this](const Record_t& a, const Record_t& b) {
+            int c = strcasecmp(pool(a.artist), pool(b.artist));
+            if (c == 0) {
+                c = strcasecmp(pool(a.album), pool(b.album));
+            }
+            if (c == 0) {
+                c = strcasecmp(pool(a.title), pool(b.title));
+            }
+            return c < 0;
+        });
+        std::vector<uint32_t> byTitle(_records.size());
+        for (uint32_t i = 0; i < byTitle.size(); i++) {
+            byTitle[i] = i;
+        }
+        std::stable_sort(byTitle.begin(), byTitle.end(), [this](uint32_t a, uint32_t b) {
+            return strcasecmp(pool(_records[a].title), pool(_records[b].title)) < 0;
+        });
+
+        MediaIndex::Header_t header;
+        header.count   = _records.size();
+        header.strings = _strings.size();
+        std::vector<uint8_t> blob(sizeof(header) + _records.size() * sizeof(MediaIndex::Record_t) +
+                                  byTitle.size() * sizeof(uint32_t) + _strings.size());
+        uint8_t* out = blob.data();
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        if (!_records.empty()) {
+            memcpy(out, _records.data(), _records.size() * sizeof(MediaIndex::Record_t));
+            out += _records.size() * sizeof(MediaIndex::Record_t);
+            memcpy(out, byTitle.data(), byTitle.size() * sizeof(uint32_t));
+            out += byTitle.size() * sizeof(uint32_t);
+        }
+        memcpy(out, _strings.data(), _strings.size());
+        return blob;
+    }
+
+private:
+    std::vector<MediaIndex::Record_t> _records;
+    std::vector<char> _strings;
+
+    uint32_t intern(const char* s)
+    {
+        uint32_t offset = _strings.size();
+        _strings.insert(_strings.end(), s, s + strlen(s) + 1);
+        return offset;
+    }
+
+    const char* pool(uint32_t offset) const
+    {
+        return _strings.data() + offset;
+    }
+};
@@ -0,0 +1,383 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief Artist, album and title from the tags audio files carry, out of the bytes read from the file's start
+ *
+ * ID3v2.2-2.4 (MP3, ADTS AAC), FLAC and Ogg Vorbis / Opus comments, ID3v1 from a file's last 128 bytes. Nothing is
+ * read outside the buffer handed in, a tag that runs past its end gives what was in it. The track's loudness comes
+ * along where a tagger left it: ReplayGain in an ID3 TXXX frame or a comment, R128_TRACK_GAIN in an Opus one.
+ *
+ *     media_tags::Tags_t tags;
+ *     media_tags::parse(head, headLen, &tags);  // First HEAD_BYTES of the file
+ *     if (!tags.complete()) { media_tags::parse_id3v1(tail, &tags); }
+ */
+namespace media_tags {
+
+static constexpr size_t HEAD_BYTES  = 16 * 1024;  // Covers the text frames, cover art usually comes after them
+static constexpr size_t ID3V1_SIZE  = 128;
+static constexpr size_t MAX_TAG_LEN = 255;  // Longer values are cut, bytes of UTF-8
+
+struct Tags_t {
+    std::string artist;
+    std::string album;
+    std::string title;
+    bool hasGain = false;
+    float gainDb = 0;  // Track gain to ReplayGain's -18 LUFS reference
+
+    bool complete() const
+    {
+        return !artist.empty() && !album.empty() && !title.empty();
+    }
+};
+
+namespace detail {
+
+inline uint32_t be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline uint32_t le32(const uint8_t* p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+inline uint32_t syncsafe(const uint8_t* p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((p[1] & 0x7F) << 14) | ((p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+inline void append_utf8(std::string* out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *out += (char)cp;
+    } else if (cp < 0x800) {
+        *out += (char)(0xC0 | (cp >> 6));
+        *out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out += (char)(0xE0 | (cp >> 12));
+        *out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out += (char)(0xF0 | (cp >> 18));
+        *out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Trailing blanks and the padding some taggers leave go, a value cut at MAX_TAG_LEN isn't left mid-character
+inline void finish(std::string* value)
+{
+    if (value->size() > MAX_TAG_LEN) {
+        size_t cut = MAX_TAG_LEN;
+        while (cut > 0 && ((uint8_t)(*value)[cut] & 0xC0) == 0x80) {
+            cut--;
+        }
+        value->resize(cut);
+    }
+    while (!value->empty() && (value->back() == ' ' || value->back() == '\0')) {
+        value->pop_back();
+    }
+}
+
+inline std::string latin1(const uint8_t* data, size_t len)
+{
+    std::string out;
+    for (size_t i = 0; i < len && data[i]; i++) {
+        append_utf8(&out, data[i]);
+    }
+    finish(&out);
+    return out;
+}
+
+inline std::string utf16(const uint8_t* data, size_t len, bool bigEndian)
+{
+    std::string out;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        uint32_t unit = bigEndian ? (data[i] << 8 | data[i + 1]) : (data[i + 1] << 8 | data[i]);
+        if (unit == 0) {
+            break;
+        }
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < len) {
+            uint32_t low = bigEndian ? (data[i + 2] << 8 | data[i + 3]) : (data[i + 3] << 8 | data[i + 2]);
+            if (low >= 0xDC00 && low < 0xE000) {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        append_utf8(&out, unit);
+    }
+    finish(&out);
+    return out;
+}
+
+/**
+ * @brief An ID3v2 text frame's value: encoding byte, then the text. Only the first of several values is kept
+ */
+inline std::string id3_text(const uint8_t* data, size_t len)
+{
+    if (len < 2) {
+        return "";
+    }
+    const uint8_t* text = data + 1;
+    size_t textLen      = len - 1;
+    switch (data[0]) {
+        case 0:
+            return latin1(text, textLen);
+        case 1:
+            if (textLen >= 2 && ((text[0] == 0xFF && text[1] == 0xFE) || (text[0] == 0xFE && text[1] == 0xFF))) {
+                return utf16(text + 2, textLen - 2, text[0] == 0xFE);
+            }
+            return utf16(text, textLen, false);
+        case 2:
+            return utf16(text, textLen, true);
+        default: {
+            std::string out((const char*)text, strnlen((const char*)text, textLen));
+            finish(&out);
+            return out;
+        }
+    }
+}
+
+inline void set(std::string* field, std::string value)
+{
+    if (field->empty() && !value.empty()) {
+        *field = std::move(value);
+    }
+}
+
+}  // namespace detail
+
+/**
+ * @brief A loudness comment's gain: REPLAYGAIN_TRACK_GAIN ("-6.20 dB"), or Opus' R128_TRACK_GAIN (Q7.8 dB to
+ * -23 LUFS, moved over to the same -18 LUFS reference)
+ *
+ * @return false if `key` is neither, or the value isn't a number
+ */
+inline bool parse_gain(const char* key, size_t keyLen, const char* value, size_t valueLen, float* gainDb)
+{
+    bool replayGain = keyLen == 21 && strncasecmp(key, "REPLAYGAIN_TRACK_GAIN", 21) == 0;
+    bool r128       = keyLen == 15 && strncasecmp(key, "R128_TRACK_GAIN", 15) == 0;
+    if (!replayGain && !r128) {
+        return false;
+    }
+    char text[24];
+    size_t n = valueLen < sizeof(text) - 1 ? valueLen : sizeof(text) - 1;
+    memcpy(text, value, n);
+    text[n]   = '\0';
+    char* end = nullptr;
+    float db  = replayGain ? strtof(text, &end) : strtol(text, &end, 10) / 256.0f + 5.0f;
+    if (end == text) {
+        return false;
+    }
+    *gainDb = db;
+    return true;
+}
+
+namespace detail {
+
+// A TXXX frame: encoding byte, description, value. ReplayGain is the one description looked for
+inline void id3_user_text(const uint8_t* data, size_t len, Tags_t* tags)
+{
+    if (len < 2 || tags->hasGain) {
+        return;
+    }
+    size_t unit = (data[0] == 1 || data[0] == 2) ? 2 : 1;
+    size_t pos  = 1;
+    while (pos + unit <= len && !(data[pos] == 0 && (unit == 1 || data[pos + 1] == 0))) {
+        pos += unit;
+    }
+    if (pos + unit > len) {
+        return;
+    }
+    std::string key = id3_text(data, pos);
+    std::string value(1, (char)data[0]);  // id3_text() wants the encoding in front
+    value.append((const char*)data + pos + unit, len - pos - unit);
+    value = id3_text((const uint8_t*)value.data(), value.size());
+    tags->hasGain = parse_gain(key.data(), key.size(), value.data(), value.size(), &tags->gainDb);
+}
+
+}  // namespace detail
+
+/**
+ * @return bytes the ID3v2 tag at the front of `data` takes, 0 if there's none
+ */
+inline size_t id3v2_size(const uint8_t* data, size_t len)
+{
+    if (len < 10 || memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    return 10 + detail::syncsafe(data + 6) + ((data[5] & 0x10) ? 10 : 0);
+}
+
+inline bool parse_id3v2(const uint8_t* data, size_t len, Tags_t* tags)
+{
+    size_t size = id3v2_size(data, len);
+    if (size == 0) {
+        return false;
+    }
+    int version = data[3];
+    if (version < 2 || version > 4 || (data[5] & 0x80)) {
+        return false;  // Unsynchronised tags are rare enough not to undo
+    }
+    size_t end = size < len ? size : len;
+    size_t pos = 10;
+    if (version >= 3 && (data[5] & 0x40) && pos + 4 <= end) {
+        // Extended header: v2.4 counts its own size, v2.3 doesn't
+        pos += (version == 4) ? detail::syncsafe(data + pos) : 4 + detail::be32(data + pos);
+    }
+
+    size_t idLen     = (version == 2) ? 3 : 4;
+    size_t headerLen = (version == 2) ? 6 : 10;
+    while (pos + headerLen <= end && data[pos] != 0) {
+        const uint8_t* frame = data + pos;
+        size_t frameLen      = 0;
+        if (version == 2) {
+            frameLen = ((size_t)frame[3] << 16) | (frame[4] << 8) | frame[5];
+        } else {
+            frameLen = (version == 4) ? detail::syncsafe(frame + 4) : detail::be32(frame + 4);
+        }
+        size_t body  = pos + headerLen;
+        size_t avail = body < end ? end - body : 0;
+        size_t n     = frameLen < avail ? frameLen : avail;
+        if (idLen == 3 ? memcmp(frame, "TP1", 3) == 0 : memcmp(frame, "TPE1", 4) == 0) {
+            detail::set(&tags->artist, detail::id3_text(data + body, n));
+        } else if (idLen == 3 ? memcmp(frame, "TAL", 3) == 0 : memcmp(frame, "TALB", 4) == 0) {
+            detail::set(&tags->album, detail::id3_text(data + body, n));
+        } else if (idLen == 3 ? memcmp(frame, "TT2", 3) == 0 : memcmp(frame, "TIT2", 4) == 0) {
+            detail::set(&tags->title, detail::id3_text(data + body, n));
+        } else if (idLen == 3 ? memcmp(frame, "TXX", 3) == 0 : memcmp(frame, "TXXX", 4) == 0) {
+            detail::id3_user_text(data + body, n, tags);
+        }
+        if (frameLen > avail) {
+            break;  // Runs past what was read
+        }
+        pos = body + frameLen;
+    }
+    return true;
+}
+
+/**
+ * @param tail the file's last ID3V1_SIZE bytes
+ */
+inline bool parse_id3v1(const uint8_t* tail, Tags_t* tags)
+{
+    if (memcmp(tail, "TAG", 3) != 0) {
+        return false;
+    }
+    detail::set(&tags->title, detail::latin1(tail + 3, 30));
+    detail::set(&tags->artist, detail::latin1(tail + 33, 30));
+    detail::set(&tags->album, detail::latin1(tail + 63, 30));
+    return true;
+}
+
+/**
+ * @brief A Vorbis comment block (FLAC, Ogg Vorbis and Opus), starting with its vendor string
+ */
+inline bool parse_vorbis_comment(const uint8_t* data, size_t len, Tags_t* tags)
+{
+    if (len < 8) {
+        return false;
+    }
+    size_t pos = 4 + (size_t)detail::le32(data);
+    if (pos + 4 > len) {
+        return false;
+    }
+    uint32_t count = detail::le32(data + pos);
+    pos += 4;
+    for (uint32_t i = 0; i < count && pos + 4 <= len; i++) {
+        size_t n = detail::le32(data + pos);
+        pos += 4;
+        if (n > len - pos) {
+            break;
+        }
+        const char* comment = (const char*)data + pos;
+        const char* eq      = (const char*)memchr(comment, '=', n);
+        if (eq) {
+            size_t keyLen = eq - comment;
+            std::string value(eq + 1, n - keyLen - 1);
+            detail::finish(&value);
+            if (keyLen == 6 && strncasecmp(comment, "ARTIST", 6) == 0) {
+                detail::set(&tags->artist, std::move(value));
+            } else if (keyLen == 5 && strncasecmp(comment, "ALBUM", 5) == 0) {
+                detail::set(&tags->album, std::move(value));
+            } else if (keyLen == 5 && strncasecmp(comment, "TITLE", 5) == 0) {
+                detail::set(&tags->title, std::move(value));
+            } else if (!tags->hasGain) {
+                tags->hasGain = parse_gain(comment, keyLen, eq + 1, n - keyLen - 1, &tags->gainDb);
+            }
+        }
+        pos += n;
+    }
+    return true;
+}
+
+/**
+ * @brief FLAC's metadata blocks, up to the VORBIS_COMMENT one
+ */
+inline bool parse_flac(const uint8_t* data, size_t len, Tags_t* tags)
+{
+    if (len < 4 || memcmp(data, "fLaC", 4) != 0) {
+        return false;
+    }
+    size_t pos = 4;
+    while (pos + 4 <= len) {
+        bool last     = data[pos] & 0x80;
+        int type      = data[pos] & 0x7F;
+        size_t length = ((size_t)data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+        pos += 4;
+        if (type == 4) {
+            return parse_vorbis_comment(data + pos, len - pos < length ? len - pos : length, tags);
+        }
+        if (last) {
+            break;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+/**
+ * @brief Ogg Vorbis or Opus: the comment header is the second packet, usually in the second page
+ *
+ * The packet isn't reassembled across pages, a comment block longer than a page gives the comments before the cut.
+ */
+inline bool parse_ogg(const uint8_t* data, size_t len, Tags_t* tags)
+{
+    if (len < 4 || memcmp(data, "OggS", 4) != 0) {
+        return false;
+    }
+    for (size_t pos = 0; pos + 8 <= len; pos++) {
+        if (memcmp(data + pos, "\x03vorbis", 7) == 0) {
+            return parse_vorbis_comment(data + pos + 7, len - pos - 7, tags);
+        }
+        if (memcmp(data + pos, "OpusTags", 8) == 0) {
+            return parse_vorbis_comment(data + pos + 8, len - pos - 8, tags);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Whatever tag the file starts with
+ *
+ * @return false if there's none this knows, ID3v1 is worth a try then
+ */
+inline bool parse(const uint8_t* head, size_t len, Tags_t* tags)
+{
+    return parse_id3v2(head, len, tags) || parse_flac(head, len, tags) || parse_ogg(head, len, tags);
+}
+
+}  // namespace media_tags
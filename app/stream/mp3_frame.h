@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+
+/**
+ * @brief MPEG audio Layer III frame header parsing, used to hand the decoder exactly one frame at a time
+ *
+ * See: http://www.mp3-tech.org/programmer/frame_header.html
+ */
+namespace mp3_frame {
+
+static constexpr size_t HEADER_SIZE    = 4;
+static constexpr size_t MAX_FRAME_SIZE = 1441;  // 320kbps @ 32kHz MPEG-1, 160kbps @ 8kHz MPEG-2.5
+
+enum Version_t {
+    MPEG_1,
+    MPEG_2,
+    MPEG_2_5,
+};
+
+struct FrameInfo_t {
+    Version_t version = MPEG_1;
+    int bitrateKbps   = 0;
+    int sampleRate    = 0;
+    int channels      = 0;
+    bool hasCrc       = false;
+    size_t frameSize  = 0;  // Including the header
+};
+
+/**
+ * @brief Xing/Info (LAME) or VBRI (Fraunhofer) tag, found in the first frame of a file
+ */
+struct VbrInfo_t {
+    bool vbr        = false;  // "Info" is the same tag written for CBR
+    uint32_t frames = 0;      // 0 when the tag doesn't say
+    uint32_t bytes  = 0;
+    bool hasToc     = false;
+    uint8_t toc[100]{};  // Xing: where each percent of the duration starts, in 256ths of `bytes`
+};
+
+/**
+ * @brief Parse a 4 byte frame header, only Layer III is accepted since that's what the decoder handles
+ *
+ * @return true if `header` is a valid Layer III frame header
+ */
+inline bool parse_header(const uint8_t* header, FrameInfo_t* info)
+{
+    static const int16_t bitrates_v1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+    static const int16_t bitrates_v2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+    static const int32_t sample_rates[3] = {44100, 48000, 32000};
+
+    uint8_t b0 = header[0];
+    uint8_t b1 = header[1];
+    uint8_t b2 = header[2];
+    uint8_t b3 = header[3];
+
+    // Sync word: 11 bits set (0xFF followed by 0xE0 or higher)
+    if (b0 != 0xFF || (b1 & 0xE0) != 0xE0) {
+        return false;
+    }
+
+    // Bits in b1: AAAB BCCD
+    // A = sync (111), B = version (00=2.5, 01=reserved, 10=2, 11=1)
+    // C = layer (00=reserved, 01=III, 10=II, 11=I), D = protection
+    int versionBits = (b1 >> 3) & 0x03;
+    int layerBits   = (b1 >> 1) & 0x03;
+    if (versionBits == 1 || layerBits != 1) {
+        return false;
+    }
+
+    // Bits in b2: EEEE FFGH
+    // E = bitrate index (0000 = free and 1111 = bad), F = sample rate index (11 is reserved), G = padding
+    int bitrateIdx    = (b2 >> 4) & 0x0F;
+    int sampleRateIdx = (b2 >> 2) & 0x03;
+    int padding       = (b2 >> 1) & 0x01;
+    if (bitrateIdx == 0 || bitrateIdx == 15 || sampleRateIdx == 3) {
+        return false;
+    }
+
+    Version_t version = (versionBits == 3) ? MPEG_1 : (versionBits == 2) ? MPEG_2 : MPEG_2_5;
+    int bitrate       = (version == MPEG_1) ? bitrates_v1[bitrateIdx] : bitrates_v2[bitrateIdx];
+    int sampleRate    = sample_rates[sampleRateIdx] >> (int)version;
+
+    // Layer III: 1152 samples per MPEG-1 frame, 576 for MPEG-2/2.5
+    int slotsFactor = (version == MPEG_1) ? 144 : 72;
+
+    info->version     = version;
+    info->bitrateKbps = bitrate;
+    info->sampleRate  = sampleRate;
+    info->channels    = ((b3 >> 6) == 3) ? 1 : 2;
+    info->hasCrc      = (b1 & 0x01) == 0;
+    info->frameSize   = (size_t)(slotsFactor * bitrate * 1000 / sampleRate + padding);
+    return true;
+}
+
+inline int samples_per_frame(const FrameInfo_t& info)
+{
+    return (info.version == MPEG_1) ? 1152 : 576;
+}
+
+/**
+ * @brief Look for a VBR tag in a complete first frame
+ *
+ * @return true if `frame` carries one, it's then silent and not part of the audio
+ */
+inline bool parse_vbr_tag(const uint8_t* frame, size_t len, const FrameInfo_t& info, VbrInfo_t* vbr)
+{
+    auto be32 = [](const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    };
+
+    // Xing/Info follows the side info: 32/17 bytes for MPEG-1 stereo/mono, 17/9 for MPEG-2/2.5
+    size_t sideInfo = (info.version == MPEG_1) ? (info.channels == 1 ? 17 : 32) : (info.channels == 1 ? 9 : 17);
+    size_t pos      = HEADER_SIZE + (info.hasCrc ? 2 : 0) + sideInfo;
+    if (pos + 8 <= len && (memcmp(frame + pos, "Xing", 4) == 0 || memcmp(frame + pos, "Info", 4) == 0)) {
+        vbr->vbr       = frame[pos] == 'X';
+        uint32_t flags = be32(frame + pos + 4);
+        pos += 8;
+        vbr->frames = 0;
+        vbr->bytes  = 0;
+        vbr->hasToc = false;
+        if ((flags & 0x01) && pos + 4 <= len) {
+            vbr->frames = be32(frame + pos);
+            pos += 4;
+        }
+        if ((flags & 0x02) && pos + 4 <= len) {
+            vbr->bytes = be32(frame + pos);
+            pos += 4;
+        }
+        if ((flags & 0x04) && pos + sizeof(vbr->toc) <= len) {
+            memcpy(vbr->toc, frame + pos, sizeof(vbr->toc));
+            vbr->hasToc = true;
+        }
+        return true;
+    }
+
+    // VBRI is always 32 bytes after the header
+    pos = HEADER_SIZE + 32;
+    if (pos + 18 <= len && memcmp(frame + pos, "VBRI", 4) == 0) {
+        vbr->vbr    = true;
+        vbr->bytes  = be32(frame + pos + 10);
+        vbr->frames = be32(frame + pos + 14);
+        vbr->hasToc = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Find the first frame in `data`
+ *
+ * When the following header is also in `data` it has to match too, which rules out most false syncs in the middle
+ * of a frame (joining a live stream, switching stations).
+ *
+ * @return offset of the frame, -1 if there is none
+ */
+inline int find_frame(const uint8_t* data, size_t len, FrameInfo_t* info)
+{
+    for (size_t i = 0; i + HEADER_SIZE <= len; i++) {
+        if (!parse_header(data + i, info)) {
+            continue;
+        }
+
+        size_t next = i + info->frameSize;
+        if (next + HEADER_SIZE <= len) {
+            FrameInfo_t nextInfo;
+            if (!parse_header(data + next, &nextInfo) || nextInfo.version != info->version ||
+                nextInfo.sampleRate != info->sampleRate) {
+                continue;
+            }
+        }
+        return (int)i;
+    }
+    return -1;
+}
+
+}  // namespace mp3_frame
@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * @brief Beats from the spectrum analyzer's frames: spectral flux against a running threshold, and a tempo from the
+ * intervals between them
+ *
+ * The flux is the mean rise in dB of the bands since the last frame, falls don't count. A frame is an onset when its
+ * flux crosses SENSITIVITY times the mean of the last HISTORY frames' and MIN_FLUX_DB, at most every MIN_GAP_MS. The
+ * intervals between onsets are folded into MIN_BPM..2 * MIN_BPM, so a detector hearing every other beat or every
+ * half beat still agrees, and the tempo is their median once most of them agree with it. That's a subtraction per
+ * band and a few compares a frame.
+ *
+ *     analyzer.process(samples, rate, levels, bands);
+ *     if (onsets.process(analyzer.bandDb(), bands, nowMs)) {
+ *         post_beat(onsets.bpm());
+ *     }
+ */
+class OnsetDetector {
+public:
+    static constexpr int MAX_BANDS         = 128;
+    static constexpr int HISTORY           = 32;     // Frames of flux the threshold follows, ~1 s at display rate
+    static constexpr float SENSITIVITY     = 1.5f;   // Times the mean flux an onset stands out by
+    static constexpr float MIN_FLUX_DB     = 1.0f;   // Quiet passages don't beat on noise
+    static constexpr uint32_t MIN_GAP_MS   = 250;    // 240 BPM
+    static constexpr uint32_t MAX_GAP_MS   = 2000;   // A longer interval is a pause, not a tempo
+    static constexpr int INTERVALS         = 16;     // Kept for the tempo
+    static constexpr int MIN_BPM           = 80;     // Tempos are folded into MIN_BPM .. 2 * MIN_BPM
+    static constexpr float AGREEMENT       = 0.08f;  // An interval within this of the median agrees with it
+
+    void reset()
+    {
+        _primed      = false;
+        _history_sum = 0.0f;
+        _slot        = 0;
+        _frames      = 0;
+        _above       = false;
+        std::fill(_history, _history + HISTORY, 0.0f);
+    }
+
+    /**
+     * @brief One analyzer frame, `bands` levels in dB low to high, with the same band layout as the last
+     *
+     * @return true if it's an onset
+     */
+    bool process(const float* bandDb, int bands, uint32_t nowMs)
+    {
+        bands = std::min(bands, MAX_BANDS);
+        if (!_primed || bands != _bands) {
+            std::copy(bandDb, bandDb + bands, _prev);
+            _bands  = bands;
+            _primed = true;
+            return false;
+        }
+
+        float flux = 0.0f;
+        for (int i = 0; i < bands; i++) {
+            flux += std::max(0.0f, bandDb[i] - _prev[i]);
+            _prev[i] = bandDb[i];
+        }
+        flux /= bands;
+
+        float mean      = _frames > 0 ? _history_sum / _frames : flux;
+        float threshold = std::max(MIN_FLUX_DB, mean * SENSITIVITY);
+        _history_sum += flux - _history[_slot];
+        _history[_slot] = flux;
+        _slot           = (_slot + 1) % HISTORY;
+        _frames         = std::min(_frames + 1, HISTORY);
+
+        // Only the frame crossing the threshold, a loud stretch is one onset and not one a frame
+        bool above = flux > threshold;
+        bool onset = above && !_above && (!_onset_seen || nowMs - _last_onset >= MIN_GAP_MS);
+        _above     = above;
+        if (onset) {
+            add_interval(nowMs);
+        }
+        return onset;
+    }
+
+    /**
+     * @brief Beats a minute, 0 until enough onsets agree on one
+     */
+    int bpm() const
+    {
+        return _bpm;
+    }
+
+private:
+    float _prev[MAX_BANDS]{};  // Last frame's levels, in dB
+    int _bands   = 0;
+    bool _primed = false;
+    float _history[HISTORY]{};  // Flux of the last frames, the newest at _slot - 1
+    float _history_sum = 0.0f;
+    int _slot          = 0;
+    int _frames        = 0;  // In the history, up to HISTORY
+    bool _above        = false;
+
+    bool _onset_seen     = false;
+    uint32_t _last_onset = 0;
+    uint32_t _intervals[INTERVALS]{};  // Folded, in ms
+    int _interval_slot   = 0;          // Where the next one goes
+    int _interval_count  = 0;          // Kept, up to INTERVALS
+    int _bpm             = 0;
+
+    void add_interval(uint32_t nowMs)
+    {
+        uint32_t gap = nowMs - _last_onset;
+        bool first   = !_onset_seen;
+        _onset_seen  = true;
+        _last_onset  = nowMs;
+        if (first || gap > MAX_GAP_MS) {
+            return;
+        }
+
+        const uint32_t longest = 60000 / MIN_BPM;
+        while (gap > longest) {
+            gap /= 2;
+        }
+        while (gap <= longest / 2) {
+            gap *= 2;
+        }
+        _intervals[_interval_slot] = gap;
+        _interval_slot             = (_interval_slot + 1) % INTERVALS;
+        _interval_count            = std::min(_interval_count + 1, INTERVALS);
+
+        int n = _interval_count;
+        if (n < 4) {
+            return;
+        }
+        uint32_t sorted[INTERVALS];
+        std::copy(_intervals, _intervals + n, sorted);
+        std::nth_element(sorted, sorted + n / 2, sorted + n);
+        uint32_t median = sorted[n / 2];
+
+        uint32_t sum = 0;
+        int agreeing = 0;
+        for (int i = 0; i < n; i++) {
+            if (fabsf((float)_intervals[i] - (float)median) <= median * AGREEMENT) {
+                sum += _intervals[i];
+                agreeing++;
+            }
+        }
+        _bpm = agreeing * 2 > n ? (int)lroundf(60000.0f * agreeing / sum) : 0;
+    }
+};
@@ -0,0 +1,699 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string.h>
+#include <strings.h>
+#include <hal/hal.h>
+#include "media_tags.h"
+#include "packet_frame.h"
+
+struct PacketCrc16Table_t {
+    uint16_t table[256];
+    constexpr PacketCrc16Table_t() : table()
+    {
+        for (int i = 0; i < 256; i++) {
+            uint16_t crc = (uint16_t)(i << 8);
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+            }
+            table[i] = crc;
+        }
+    }
+};
+
+/**
+ * @brief Incremental demuxer for Ogg Opus, Ogg FLAC and native FLAC streams, into packet_frame packets
+ *
+ * The container is told apart by the first bytes ("OggS" or "fLaC"), the codec by the first packet of each Ogg
+ * stream: OpusHead, or the 0x7F "FLAC" header of the Ogg FLAC mapping. Vorbis and the rest come out as
+ * CODEC_UNSUPPORTED. Every packet is handed out with its packet_frame header in front, the decoder's config (OpusHead,
+ * or the FLAC stream header with its STREAMINFO) as a config packet before the first audio of each chained stream and
+ * again every CONFIG_REPEAT packets, so a reader joining the ring anywhere has it within a few. Titles come from the
+ * Vorbis comments (OpusTags, the FLAC VORBIS_COMMENT block) as "Artist - Title", and so does the track's loudness,
+ * see comments() and trackGain():
+ *
+ *     demux.reset();
+ *     demux.feed(chunk, len,
+ *                [&](const uint8_t* frame, size_t n) { ring.write(frame, n); },
+ *                [&](const char* title) { show(title); });
+ *
+ * TCP delivers what the server sent, so the Ogg page CRC isn't checked, only the capture pattern, version and serial.
+ * Native FLAC frames don't say how long they are: one ends where the next frame's header (and its CRC-8) starts and
+ * its own CRC-16 checks out.
+ */
+class PacketDemuxer {
+public:
+    enum Codec_t {
+        CODEC_UNKNOWN,  // Nothing identified yet
+        CODEC_OPUS,
+        CODEC_FLAC,
+        CODEC_UNSUPPORTED,
+    };
+
+    static constexpr int CONFIG_REPEAT      = 16;  // Audio packets between config packets
+    static constexpr size_t MAX_CONFIG_SIZE = 64;  // OpusHead with a channel mapping table, the 42 byte FLAC header
+    static constexpr size_t MAX_TITLE_SIZE  = 256;
+
+    ~PacketDemuxer()
+    {
+        if (_buffer) {
+            GetHAL()->freeBuffer(hal::HalBase::MEMORY_STREAM, _buffer);
+        }
+    }
+
+    /**
+     * @brief Start on a new stream, the packet buffer comes out of the stream pool the first time
+     *
+     * @return false if there's no room for it
+     */
+    bool reset()
+    {
+        if (!_buffer) {
+            _buffer = (uint8_t*)GetHAL()->allocBuffer(hal::HalBase::MEMORY_STREAM, BUFFER_SIZE);
+        }
+        _container    = CONTAINER_SNIFF;
+        _state        = 0;
+        _filled       = 0;
+        _codec        = CODEC_UNKNOWN;
+        _config_len   = 0;
+        _since_config = 0;
+        _has_serial   = false;
+        _ended        = false;
+        _audio        = 0;
+        _comments     = 0;
+        _has_gain     = false;
+        start_packet();
+        return _buffer != nullptr;
+    }
+
+    Codec_t codec() const
+    {
+        return _codec;
+    }
+
+    /**
+     * @brief Comment blocks seen since reset(), it goes up where a chained stream's next track begins
+     */
+    uint32_t comments() const
+    {
+        return _comments;
+    }
+
+    /**
+     * @return false if the last comment block carried no loudness, see media_tags::parse_gain()
+     */
+    bool trackGain(float* gainDb) const
+    {
+        *gainDb = _gain_db;
+        return _has_gain;
+    }
+
+    /**
+     * @brief Demux one chunk
+     *
+     * @param onFrame called as `onFrame(const uint8_t* frame, size_t len)` for each framed packet
+     * @param onTitle called as `onTitle(const char* title)` when a stream's comments name the track
+     */
+    template <typename FrameFn, typename TitleFn>
+    void feed(const uint8_t* data, size_t len, FrameFn onFrame, TitleFn onTitle)
+    {
+        if (!_buffer) {
+            return;
+        }
+        while (len > 0 && _container == CONTAINER_SNIFF) {
+            _sniff[_filled++] = *data++;
+            len--;
+            if (_filled == 4) {
+                // Anything else is scanned for an Ogg page, as after a lost one
+                bool flac  = memcmp(_sniff, "fLaC", 4) == 0;
+                _container = flac ? CONTAINER_FLAC : CONTAINER_OGG;
+                _filled    = 0;
+                if (flac) {
+                    _state = FLAC_BLOCK_HEADER;
+                } else {
+                    feed_ogg(_sniff, 4, onFrame, onTitle);
+                }
+            }
+        }
+        if (_container == CONTAINER_OGG) {
+            feed_ogg(data, len, onFrame, onTitle);
+        } else if (_container == CONTAINER_FLAC) {
+            feed_flac(data, len, onFrame, onTitle);
+        }
+    }
+
+    /**
+     * @brief "Artist - Title" from a Vorbis comment block, without the framing bit
+     *
+     * @return false if neither is there, or the block is cut short before them
+     */
+    static bool commentTitle(const uint8_t* data, size_t len, char* title, size_t size)
+    {
+        char artist[MAX_TITLE_SIZE] = {0};
+        char track[MAX_TITLE_SIZE]  = {0};
+        size_t pos                  = 0;
+        if (len < 4) {
+            return false;
+        }
+        pos += 4 + le32(data);
+        if (pos + 4 > len) {
+            return false;
+        }
+        uint32_t count = le32(data + pos);
+        pos += 4;
+        for (uint32_t i = 0; i < count && pos + 4 <= len; i++) {
+            size_t entryLen = le32(data + pos);
+            pos += 4;
+            if (entryLen > len - pos) {
+                break;  // Cut short, cover art usually
+            }
+            const char* entry = (const char*)data + pos;
+            if (entryLen > 7 && strncasecmp(entry, "ARTIST=", 7) == 0) {
+                copy(artist, entry + 7, entryLen - 7);
+            } else if (entryLen > 6 && strncasecmp(entry, "TITLE=", 6) == 0) {
+                copy(track, entry + 6, entryLen - 6);
+            }
+            pos += entryLen;
+        }
+        if (!artist[0] && !track[0]) {
+            return false;
+        }
+        snprintf(title, size, "%s%s%s", artist, artist[0] && track[0] ? " - " : "", track);
+        return true;
+    }
+
+    /**
+     * @brief The track gain a Vorbis comment block carries
+     *
+     * @return false if there's none
+     */
+    static bool commentGain(const uint8_t* data, size_t len, float* gainDb)
+    {
+        if (len < 4) {
+            return false;
+        }
+        size_t pos = 4 + le32(data);
+        if (pos + 4 > len) {
+            return false;
+        }
+        uint32_t count = le32(data + pos);
+        pos += 4;
+        for (uint32_t i = 0; i < count && pos + 4 <= len; i++) {
+            size_t entryLen = le32(data + pos);
+            pos += 4;
+            if (entryLen > len - pos) {
+                break;
+            }
+            const char* entry = (const char*)data + pos;
+            const char* eq    = (const char*)memchr(entry, '=', entryLen);
+            if (eq && media_tags::parse_gain(entry, eq - entry, eq + 1, entryLen - (eq - entry) - 1, gainDb)) {
+                return true;
+            }
+            pos += entryLen;
+        }
+        return false;
+    }
+
+private:
+    enum Container_t {
+        CONTAINER_SNIFF,
+        CONTAINER_OGG,
+        CONTAINER_FLAC,
+    };
+
+    enum State_t {
+        OGG_CAPTURE,  // Looking for "OggS"
+        OGG_HEADER,   // The rest of the 27 byte page header
+        OGG_LACING,   // The segment table
+        OGG_BODY,
+        FLAC_BLOCK_HEADER,
+        FLAC_BLOCK_BODY,
+        FLAC_FRAMES,
+    };
+
+    static constexpr size_t PAGE_HEADER_SIZE = 27;
+    static constexpr size_t FLAC_MAX_HEADER  = 16;  // Frame header with the longest coded number and both extensions
+    static constexpr size_t BUFFER_SIZE      = packet_frame::MAX_FRAME_SIZE + FLAC_MAX_HEADER;
+    static constexpr PacketCrc16Table_t CRC16{};
+
+    static uint32_t le32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static void copy(char* dst, const char* src, size_t len)
+    {
+        len = len < MAX_TITLE_SIZE - 1 ? len : MAX_TITLE_SIZE - 1;
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+    }
+
+    uint8_t* payload()
+    {
+        return _buffer + packet_frame::HEADER_SIZE;
+    }
+
+    void start_packet()
+    {
+        _packet_len = 0;
+        _in_packet  = false;
+        _truncated  = false;
+    }
+
+    void append(const uint8_t* data, size_t len)
+    {
+        size_t room = packet_frame::MAX_PAYLOAD_SIZE - _packet_len;
+        if (len > room) {
+            len        = room;
+            _truncated = true;
+        }
+        memcpy(payload() + _packet_len, data, len);
+        _packet_len += len;
+    }
+
+    void set_config(const uint8_t* data, size_t len)
+    {
+        if (len > MAX_CONFIG_SIZE) {
+            _codec = CODEC_UNSUPPORTED;
+            return;
+        }
+        memcpy(_config + packet_frame::HEADER_SIZE, data, len);
+        packet_frame::write_header(_config, len, true);
+        _config_len   = len;
+        _since_config = 0;
+    }
+
+    // An audio packet of `len` bytes at payload(), behind the config when it's due
+    template <typename FrameFn>
+    void emit_audio(size_t len, FrameFn& onFrame)
+    {
+        if (_config_len == 0 || len == 0) {
+            return;
+        }
+        if (_since_config == 0) {
+            onFrame((const uint8_t*)_config, packet_frame::HEADER_SIZE + _config_len);
+        }
+        _since_config = (_since_config + 1) % CONFIG_REPEAT;
+        packet_frame::write_header(_buffer, len, false);
+        onFrame((const uint8_t*)_buffer, packet_frame::HEADER_SIZE + len);
+        _audio++;
+    }
+
+    template <typename TitleFn>
+    void emit_comments(const uint8_t* data, size_t len, TitleFn& onTitle)
+    {
+        _has_gain = commentGain(data, len, &_gain_db);
+        _comments++;
+        char title[MAX_TITLE_SIZE];
+        if (commentTitle(data, len, title, sizeof(title))) {
+            onTitle((const char*)title);
+        }
+    }
+
+    /* ---------------------------------- Ogg ---------------------------------- */
+    template <typename FrameFn, typename TitleFn>
+    void feed_ogg(const uint8_t* data, size_t len, FrameFn& onFrame, TitleFn& onTitle)
+    {
+        static const uint8_t capture[4] = {'O', 'g', 'g', 'S'};
+        size_t pos                      = 0;
+        while (pos < len || (_state == OGG_BODY && _segment_left == 0)) {
+            switch (_state) {
+                case OGG_CAPTURE: {
+                    uint8_t c = data[pos++];
+                    if (c == capture[_filled]) {
+                        _page[_filled++] = c;
+                    } else {
+                        _filled = (c == 'O') ? 1 : 0;
+                    }
+                    if (_filled == 4) {
+                        _state = OGG_HEADER;
+                    }
+                    break;
+                }
+
+                case OGG_HEADER: {
+                    size_t n = std::min(len - pos, PAGE_HEADER_SIZE - _filled);
+                    memcpy(_page + _filled, data + pos, n);
+                    pos += n;
+                    _filled += n;
+                    if (_filled == PAGE_HEADER_SIZE) {
+                        _filled   = 0;
+                        _segments = _page[26];
+                        _state    = (_page[4] != 0 || _segments == 0) ? OGG_CAPTURE : OGG_LACING;
+                    }
+                    break;
+                }
+
+                case OGG_LACING: {
+                    size_t n = std::min(len - pos, _segments - _filled);
+                    memcpy(_lacing + _filled, data + pos, n);
+                    pos += n;
+                    _filled += n;
+                    if (_filled == _segments) {
+                        begin_page();
+                        _filled       = 0;
+                        _segment      = 0;
+                        _segment_left = _lacing[0];
+                        _state        = OGG_BODY;
+                    }
+                    break;
+                }
+
+                case OGG_BODY: {
+                    size_t n = std::min(len - pos, _segment_left);
+                    if (!_skip_page && !_drop_packet) {
+                        append(data + pos, n);
+                    }
+                    pos += n;
+                    _segment_left -= n;
+                    if (_segment_left > 0) {
+                        break;
+                    }
+                    // A lacing value under 255 ends the packet, 255 continues it in the next segment or page
+                    if (!_skip_page) {
+                        if (_lacing[_segment] < 255) {
+                            if (!_drop_packet) {
+                                ogg_packet(onFrame, onTitle);
+                            }
+                            start_packet();
+                            _drop_packet = false;
+                        } else {
+                            _in_packet = true;
+                        }
+                    }
+                    if (++_segment == _segments) {
+                        _state = OGG_CAPTURE;
+                    } else {
+                        _segment_left = _lacing[_segment];
+                    }
+                    break;
+                }
+
+                default:
+                    return;
+            }
+        }
+    }
+
+    void begin_page()
+    {
+        uint8_t flags   = _page[5];
+        uint32_t serial = le32(_page + 14);
+        // BOS pages only come before any audio, unless a new stream is chained on
+        if ((flags & 0x02) && (!_has_serial || _ended || _audio > 0)) {
+            _serial      = serial;
+            _has_serial  = true;
+            _ended       = false;
+            _audio       = 0;
+            _codec       = CODEC_UNKNOWN;
+            _config_len  = 0;
+            _drop_packet = false;
+            start_packet();
+        }
+        _skip_page = !_has_serial || serial != _serial;
+        if (_skip_page) {
+            return;  // Another stream multiplexed in
+        }
+        bool continued = flags & 0x01;
+        if (continued != _in_packet) {
+            // A page went missing: the partial packet is gone, or this one continues a packet never seen
+            start_packet();
+            _drop_packet = continued;
+        }
+        if (flags & 0x04) {
+            _ended = true;
+        }
+    }
+
+    template <typename FrameFn, typename TitleFn>
+    void ogg_packet(FrameFn& onFrame, TitleFn& onTitle)
+    {
+        const uint8_t* p = payload();
+        size_t n         = _packet_len;
+        if (_codec == CODEC_UNKNOWN) {
+            if (n >= 19 && memcmp(p, "OpusHead", 8) == 0) {
+                _codec = (p[9] >= 1 && p[9] <= 2) ? CODEC_OPUS : CODEC_UNSUPPORTED;  // Mono or stereo
+                set_config(p, n);
+            } else if (n >= 51 && p[0] == 0x7F && memcmp(p + 1, "FLAC", 4) == 0 && memcmp(p + 9, "fLaC", 4) == 0) {
+                _codec = CODEC_FLAC;
+                set_config(p + 9, 42);  // "fLaC" and the STREAMINFO block, as a native stream starts
+                _config[packet_frame::HEADER_SIZE + 4] |= 0x80;  // Marked the last metadata block
+            } else {
+                _codec = CODEC_UNSUPPORTED;
+            }
+            return;
+        }
+        if (_codec == CODEC_OPUS) {
+            if (n >= 8 && memcmp(p, "OpusTags", 8) == 0) {
+                emit_comments(p + 8, n - 8, onTitle);
+                return;
+            }
+        } else if (_codec == CODEC_FLAC) {
+            if (n > 0 && p[0] != 0xFF) {
+                // The other header packets are metadata blocks
+                if ((p[0] & 0x7F) == 4 && n >= 4) {
+                    emit_comments(p + 4, n - 4, onTitle);
+                }
+                return;
+            }
+        } else {
+            return;
+        }
+        if (!_truncated) {
+            emit_audio(n, onFrame);
+        }
+    }
+
+    /* ------------------------------ Native FLAC ------------------------------ */
+    static uint8_t crc8(const uint8_t* data, size_t len)
+    {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    static uint16_t crc16(const uint8_t* data, size_t len)
+    {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < len; i++) {
+            crc = (uint16_t)((crc << 8) ^ CRC16.table[(crc >> 8) ^ data[i]]);
+        }
+        return crc;
+    }
+
+    /**
+     * @return the size of the frame header at `h`, 0 if there's none, -1 if `len` is too short to tell
+     */
+    static int flac_header(const uint8_t* h, size_t len)
+    {
+        if (len < 5) {
+            return -1;
+        }
+        int blockSize  = h[2] >> 4;
+        int sampleRate = h[2] & 0x0F;
+        if (h[0] != 0xFF || (h[1] & 0xFE) != 0xF8 || blockSize == 0 || sampleRate == 15 || (h[3] >> 4) > 10 ||
+            ((h[3] >> 1) & 0x07) == 3 || (h[3] & 0x01)) {
+            return 0;
+        }
+        // The frame or sample number, UTF-8 coded
+        int extra = 0;
+        for (uint8_t mask = 0x80; extra < 7 && (h[4] & mask); mask >>= 1) {
+            extra++;
+        }
+        if (extra == 1 || extra == 7) {
+            return 0;
+        }
+        extra       = extra ? extra - 1 : 0;
+        size_t size = 5 + extra;
+        if (len < size) {
+            return -1;
+        }
+        for (int i = 0; i < extra; i++) {
+            if ((h[5 + i] & 0xC0) != 0x80) {
+                return 0;
+            }
+        }
+        size += (blockSize == 6) ? 1 : (blockSize == 7) ? 2 : 0;
+        size += (sampleRate == 12) ? 1 : (sampleRate == 13 || sampleRate == 14) ? 2 : 0;
+        if (len < size + 1) {
+            return -1;
+        }
+        return crc8(h, size) == h[size] ? (int)size + 1 : 0;
+    }
+
+    template <typename FrameFn, typename TitleFn>
+    void feed_flac(const uint8_t* data, size_t len, FrameFn& onFrame, TitleFn& onTitle)
+    {
+        size_t pos = 0;
+        while (pos < len) {
+            switch (_state) {
+                case FLAC_BLOCK_HEADER: {
+                    size_t n = std::min(len - pos, (size_t)4 - _filled);
+                    memcpy(_page + _filled, data + pos, n);
+                    pos += n;
+                    _filled += n;
+                    if (_filled == 4) {
+                        _filled     = 0;
+                        _block_left = ((size_t)_page[1] << 16) | ((size_t)_page[2] << 8) | _page[3];
+                        start_packet();
+                        _state = FLAC_BLOCK_BODY;
+                    }
+                    break;
+                }
+
+                case FLAC_BLOCK_BODY: {
+                    size_t n = std::min(len - pos, _block_left);
+                    append(data + pos, n);  // Cover art only fills the buffer, what fits is kept
+                    pos += n;
+                    _block_left -= n;
+                    if (_block_left == 0) {
+                        flac_block(onTitle);
+                    }
+                    break;
+                }
+
+                case FLAC_FRAMES: {
+                    size_t room = BUFFER_SIZE - packet_frame::HEADER_SIZE - _packet_len;
+                    size_t n    = std::min(len - pos, room);
+                    memcpy(payload() + _packet_len, data + pos, n);
+                    _packet_len += n;
+                    pos += n;
+                    flac_frames(onFrame);
+                    break;
+                }
+
+                default:
+                    return;
+            }
+        }
+    }
+
+    template <typename TitleFn>
+    void flac_block(TitleFn& onTitle)
+    {
+        int type = _page[0] & 0x7F;
+        if (type == 0 && _packet_len == 34) {
+            uint8_t header[42] = {'f', 'L', 'a', 'C', 0x80, 0, 0, 34};
+            memcpy(header + 8, payload(), 34);
+            _codec = CODEC_FLAC;
+            set_config(header, sizeof(header));
+        } else if (type == 4) {
+            emit_comments(payload(), _packet_len, onTitle);
+        }
+        if (_page[0] & 0x80) {
+            if (_codec != CODEC_FLAC) {
+                _codec = CODEC_UNSUPPORTED;  // No STREAMINFO
+            }
+            start_packet();
+            _synced = false;
+            _state  = FLAC_FRAMES;
+        } else {
+            _state = FLAC_BLOCK_HEADER;
+        }
+    }
+
+    // Hand out every frame that the buffer holds the end of
+    template <typename FrameFn>
+    void flac_frames(FrameFn& onFrame)
+    {
+        uint8_t* p = payload();
+        if (!_synced) {
+            // Start at the first frame header, like after a frame too big to keep
+            size_t i = 0;
+            int size = 0;
+            for (; i < _packet_len; i++) {
+                size = flac_header(p + i, _packet_len - i);
+                if (size != 0) {
+                    break;
+                }
+            }
+            if (size <= 0) {
+                drop_front(size < 0 ? i : _packet_len);  // Keep a header that isn't complete yet
+                return;
+            }
+            drop_front(i);
+            _synced   = true;
+            _scan_pos = (size_t)size;
+        }
+        while (_scan_pos < _packet_len) {
+            size_t i = _scan_pos;
+            // The next frame's header has the same sync, rate and sample size
+            if (p[i] != 0xFF) {
+                _scan_pos++;
+                continue;
+            }
+            int size = flac_header(p + i, _packet_len - i);
+            if (size < 0) {
+                return;  // Wait for the rest of it
+            }
+            if (size == 0 || p[i + 1] != p[1] || (p[i + 2] & 0x0F) != (p[2] & 0x0F) ||
+                (p[i + 3] & 0x0E) != (p[3] & 0x0E) || crc16(p, i) != 0) {
+                _scan_pos++;
+                continue;
+            }
+            if (i <= packet_frame::MAX_PAYLOAD_SIZE) {
+                emit_audio(i, onFrame);
+            }
+            drop_front(i);
+            _scan_pos = (size_t)size;
+        }
+        if (_packet_len >= BUFFER_SIZE - packet_frame::HEADER_SIZE) {
+            // No end in sight: too big to keep, or it wasn't a frame. Start over at the next header
+            drop_front(1);
+            _synced = false;
+            flac_frames(onFrame);
+        }
+    }
+
+    void drop_front(size_t n)
+    {
+        memmove(payload(), payload() + n, _packet_len - n);
+        _packet_len -= n;
+    }
+
+    uint8_t* _buffer       = nullptr;  // The header, then the packet
+    Container_t _container = CONTAINER_SNIFF;
+    int _state             = 0;
+    size_t _filled         = 0;  // Of the sniff, capture, page header, lacing or block header
+    uint8_t _sniff[4]      = {};
+    Codec_t _codec         = CODEC_UNKNOWN;
+    uint8_t _config[packet_frame::HEADER_SIZE + MAX_CONFIG_SIZE] = {};  // Framed, ready to hand out
+    size_t _config_len  = 0;  // Payload, 0 until the codec's header was seen
+    int _since_config   = 0;
+    size_t _packet_len  = 0;
+    bool _in_packet     = false;  // Its last segment was 255 bytes, it goes on
+    bool _truncated     = false;  // Didn't fit, only a comment block is of any use then
+    uint32_t _audio     = 0;      // Audio packets of the current stream
+    uint32_t _comments  = 0;
+    bool _has_gain      = false;
+    float _gain_db      = 0;
+
+    // Ogg
+    uint8_t _page[PAGE_HEADER_SIZE] = {};
+    uint8_t _lacing[255]            = {};
+    size_t _segments                = 0;
+    size_t _segment                 = 0;
+    size_t _segment_left            = 0;
+    uint32_t _serial                = 0;  // The logical stream followed
+    bool _has_serial                = false;
+    bool _ended                     = false;  // Its EOS page went by
+    bool _skip_page                 = false;
+    bool _drop_packet               = false;
+
+    // Native FLAC
+    size_t _block_left = 0;
+    bool _synced       = false;
+    size_t _scan_pos   = 0;  // Where the next frame header may start
+};
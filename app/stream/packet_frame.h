@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Framing for the codecs that don't frame themselves, the packet counterpart of mp3_frame and adts_frame
+ *
+ * Opus packets only have the Ogg page around them to say where they end, and FLAC frames only the next frame's sync
+ * code. The demuxers take them out of their container and write each one to the ring behind a header of its own, so
+ * the frame scan, time shift and reconnect resync treat them like MP3 or ADTS frames:
+ *
+ *     [0] 0xFE  [1] 0x70 | flags  [2..3] payload length, big endian  [4] header check
+ *
+ * A config packet (FLAG_CONFIG) carries what the decoder has to be opened with, OpusHead or the FLAC stream
+ * header, and comes before the audio of each chained stream.
+ */
+namespace packet_frame {
+
+// The largest FLAC frame a stream can have (the streamable subset, up to 48 kHz): 4608 samples of 24 bit stereo,
+// stored verbatim with the side channel a bit wider, behind the longest frame header and ahead of the CRC
+static constexpr size_t FLAC_MAX_FRAME = 16 + 2 + (4608 * (24 + 25) + 7) / 8 + 2;
+
+static constexpr size_t HEADER_SIZE      = 5;
+static constexpr size_t MAX_PAYLOAD_SIZE = 28 * 1024;
+static constexpr size_t MAX_FRAME_SIZE   = HEADER_SIZE + MAX_PAYLOAD_SIZE;
+static constexpr uint8_t FLAG_CONFIG     = 0x01;
+static_assert(MAX_PAYLOAD_SIZE >= FLAC_MAX_FRAME && MAX_PAYLOAD_SIZE <= 0xFFFF, "A FLAC frame fits the length field");
+
+struct FrameInfo_t {
+    size_t frameSize = 0;  // Including the header
+    bool config      = false;
+};
+
+inline uint8_t check_byte(const uint8_t* header)
+{
+    return (uint8_t)(~(header[1] ^ header[2] ^ header[3]) + 0x5A);
+}
+
+/**
+ * @brief Write the header for a `len` byte payload to `header` (HEADER_SIZE bytes)
+ */
+inline void write_header(uint8_t* header, size_t len, bool config)
+{
+    header[0] = 0xFE;
+    header[1] = 0x70 | (config ? FLAG_CONFIG : 0);
+    header[2] = (uint8_t)(len >> 8);
+    header[3] = (uint8_t)len;
+    header[4] = check_byte(header);
+}
+
+/**
+ * @return true if `header` (5 bytes) is a valid packet header
+ */
+inline bool parse_header(const uint8_t* header, FrameInfo_t* info)
+{
+    if (header[0] != 0xFE || (header[1] & 0xFE) != 0x70 || header[4] != check_byte(header)) {
+        return false;
+    }
+    size_t len = ((size_t)header[2] << 8) | header[3];
+    if (len == 0 || len > MAX_PAYLOAD_SIZE) {
+        return false;
+    }
+    info->frameSize = HEADER_SIZE + len;
+    info->config    = (header[1] & FLAG_CONFIG) != 0;
+    return true;
+}
+
+/**
+ * @brief Find the first packet in `data`, confirmed by the following header when it's in `data` too
+ *
+ * @return offset of the packet, -1 if there is none
+ */
+inline int find_frame(const uint8_t* data, size_t len, FrameInfo_t* info)
+{
+    for (size_t i = 0; i + HEADER_SIZE <= len; i++) {
+        if (!parse_header(data + i, info)) {
+            continue;
+        }
+
+        size_t next = i + info->frameSize;
+        if (next + HEADER_SIZE <= len) {
+            FrameInfo_t nextInfo;
+            if (!parse_header(data + next, &nextInfo)) {
+                continue;
+            }
+        }
+        return (int)i;
+    }
+    return -1;
+}
+
+}  // namespace packet_frame
@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Channels out of interleaved 16 bit PCM, such as the mic capture's [MIC-L, AEC, MIC-R, MIC-HP]
+ *
+ *     int16_t left[192], right[192];
+ *     int16_t* out[4] = {left, nullptr, right, nullptr};  // AEC and MIC-HP aren't wanted
+ *     pcm_channels::deinterleave(frame, 192, 4, out);
+ */
+namespace pcm_channels {
+
+/**
+ * @brief One channel, four frames per step so the loads of a step don't wait on each other
+ */
+inline void extract(const int16_t* in, size_t frames, int channels, int channel, int16_t* out)
+{
+    const int16_t* p = in + channel;
+    size_t i         = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int16_t a = p[0];
+        int16_t b = p[channels];
+        int16_t c = p[2 * channels];
+        int16_t d = p[3 * channels];
+        out[i]     = a;
+        out[i + 1] = b;
+        out[i + 2] = c;
+        out[i + 3] = d;
+        p += 4 * channels;
+    }
+    for (; i < frames; i++, p += channels) {
+        out[i] = *p;
+    }
+}
+
+/**
+ * @param out one buffer of `frames` samples per channel, nullptr for a channel to leave out
+ */
+inline void deinterleave(const int16_t* in, size_t frames, int channels, int16_t* const* out)
+{
+    for (int ch = 0; ch < channels; ch++) {
+        if (out[ch]) {
+            extract(in, frames, channels, ch, out[ch]);
+        }
+    }
+}
+
+}  // namespace pcm_channels
@@ -0,0 +1,398 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <string.h>
+#include <hal/hot_path.h>
+#include <dsps_biquad.h>
+#include <dsps_dotprod.h>
+#include <dsps_mulc.h>
+
+/**
+ * @brief Output stage for decoded PCM: 3 band EQ, loudness normalization and a smoothed volume
+ *
+ * Works on one decoded frame at a time in float, the filters and the energy sums are esp-dsp kernels (the optimized
+ * variant for the target is picked by esp-dsp). Loudness is measured like EBU R128 does: K-weighted, 400 ms
+ * blocks every 100 ms, absolute and relative gates. The gated blocks are averaged over the last ~8 s rather than
+ * the whole programme, since a station never ends. Gain changes, whether from the volume, the normalizer or the
+ * clip guard, ramp across the frame instead of stepping, so nothing zippers.
+ *
+ * A track whose tags give its loudness (ReplayGain, R128) takes that instead of the measurement. With the EQ flat
+ * as well there's nothing left to filter, the frame's gain is worked out once as a Q15 multiplier and applied to the
+ * 16 bit samples directly, no float per sample.
+ *
+ * Not thread safe: the decoder owns it, settings are handed over by the caller.
+ *
+ *     PcmDsp dsp;
+ *     dsp.configure(44100, 2);
+ *     dsp.setVolume(0.5f);
+ *     dsp.process(pcm, samples);   // in place, interleaved
+ */
+class PcmDsp {
+public:
+    static constexpr int MAX_FRAMES = 2048;  // Per channel, one HE-AAC frame
+    static constexpr int EQ_BANDS   = 3;     // Bass, mid, treble
+
+    static constexpr float EQ_MAX_DB       = 12.0f;
+    static constexpr float TARGET_LUFS     = -18.0f;
+    static constexpr float MAX_BOOST_DB    = 9.0f;
+    static constexpr float MAX_CUT_DB      = 12.0f;
+    static constexpr float LEVEL_SLEW_DB_S = 2.0f;   // How fast the normalizer follows a new level
+    static constexpr float CEILING         = 0.98f;  // Output peak the clip guard keeps below
+
+    /**
+     * @brief Set the stream format, filter states start over when it changes
+     */
+    void configure(int sampleRate, int channels)
+    {
+        channels = std::min(std::max(channels, 1), 2);
+        if (sampleRate == _sample_rate && channels == _channels) {
+            return;
+        }
+        _sample_rate = sampleRate;
+        _channels    = channels;
+        memset(_eq_state, 0, sizeof(_eq_state));
+        memset(_k_state, 0, sizeof(_k_state));
+
+        // K-weighting from BS.1770: the head's high shelf, then the low cut
+        design(_k_coef[0], HIGH_SHELF, 1681.97f, 0.7072f, 4.0f);
+        design(_k_coef[1], HIGH_PASS, 38.13f, 0.5003f, 0.0f);
+        update_eq();
+        resetLoudness();
+    }
+
+    /**
+     * @param gain linear, ramped to over the next frame
+     */
+    void setVolume(float gain)
+    {
+        _volume = std::max(gain, 0.0f);
+    }
+
+    void setEq(const float gainsDb[EQ_BANDS])
+    {
+        for (int band = 0; band < EQ_BANDS; band++) {
+            _eq_db[band] = std::min(EQ_MAX_DB, std::max(-EQ_MAX_DB, gainsDb[band]));
+        }
+        update_eq();
+    }
+
+    void setNormalize(bool enabled)
+    {
+        _normalize = enabled;
+    }
+
+    /**
+     * @brief The loudness the track's tags give, as the gain to TARGET_LUFS. The normalizer takes it as it is
+     *
+     * @param known false for a track without one, measured from here on
+     */
+    void setTrackGain(bool known, float gainDb)
+    {
+        _track_known = known;
+        _track_db    = std::min(MAX_BOOST_DB, std::max(-MAX_CUT_DB, gainDb));
+        if (known && _normalize) {
+            _level_db = _track_db;  // A new track, no slewing over from the last one's
+        }
+    }
+
+    /**
+     * @brief Forget the measured loudness, for when a different programme starts
+     */
+    void resetLoudness()
+    {
+        memset(_block_energy, 0, sizeof(_block_energy));
+        _block_index     = 0;
+        _block_filled    = 0;
+        _sub_energy      = 0;
+        _sub_frames      = 0;
+        _gated_blocks    = 0;
+        _integrated      = 0;
+        _target_level_db = 0;
+        _track_known     = false;
+    }
+
+    /**
+     * @return the gated loudness measured so far, LUFS, -70 before there is any
+     */
+    float loudness() const
+    {
+        return (_integrated > 0) ? energy_to_lufs(_integrated) : ABSOLUTE_GATE_LUFS;
+    }
+
+    float levelGainDb() const
+    {
+        return _level_db;
+    }
+
+    /**
+     * @param pcm interleaved, `configure()`d channel count, processed in place
+     */
+    HOT_PATH void process(int16_t* pcm, int samples)
+    {
+        if (_sample_rate <= 0) {
+            return;
+        }
+        int frames = std::min(samples / _channels, MAX_FRAMES);
+        if (!_eq_active[0] && !_eq_active[1] && !_eq_active[2] && (_track_known || !_normalize)) {
+            process_fixed(pcm, frames);
+            return;
+        }
+
+        // Deinterleave, then EQ each channel
+        for (int ch = 0; ch < _channels; ch++) {
+            float* x = _x[ch];
+            for (int i = 0; i < frames; i++) {
+                x[i] = pcm[i * _channels + ch] * (1.0f / 32768.0f);
+            }
+            for (int band = 0; band < EQ_BANDS; band++) {
+                if (_eq_active[band]) {
+                    dsps_biquad_f32(x, x, frames, _eq_coef[band], _eq_state[ch][band]);  // Works in place
+                }
+            }
+        }
+
+        measure(frames);
+        update_level(frames);
+
+        // Volume and normalizer gain, capped so this frame's peak stays under the ceiling
+        float peak = 0;
+        for (int ch = 0; ch < _channels; ch++) {
+            for (int i = 0; i < frames; i++) {
+                peak = std::max(peak, fabsf(_x[ch][i]));
+            }
+        }
+        float target = _volume * powf(10.0f, _level_db / 20.0f);
+        if (peak * target > CEILING) {
+            target = CEILING / peak;
+        }
+
+        float step = (target - _gain) / frames;
+        for (int ch = 0; ch < _channels; ch++) {
+            const float* x = _x[ch];
+            float gain     = _gain;
+            for (int i = 0; i < frames; i++) {
+                gain += step;
+                pcm[i * _channels + ch] = (int16_t)std::min(32767.0f, std::max(-32768.0f, x[i] * gain * 32768.0f));
+            }
+        }
+        _gain = target;
+    }
+
+private:
+    enum FilterType_t {
+        LOW_SHELF,
+        PEAKING,
+        HIGH_SHELF,
+        HIGH_PASS,
+    };
+
+    static constexpr float ABSOLUTE_GATE_LUFS = -70.0f;
+    static constexpr float RELATIVE_GATE_LU   = 10.0f;
+    static constexpr int SUB_BLOCK_MS         = 100;
+    static constexpr int BLOCK_SUB_BLOCKS     = 4;   // 400 ms momentary blocks with 75% overlap
+    static constexpr int INTEGRATION_BLOCKS   = 80;  // ~8 s of gated blocks
+
+    static constexpr int32_t Q15_ONE = 32768;
+
+    static float energy_to_lufs(float energy)
+    {
+        return -0.691f + 10.0f * log10f(energy);
+    }
+
+    /**
+     * @brief RBJ cookbook biquad, as b0 b1 b2 a1 a2 normalized to a0 (the esp-dsp layout)
+     */
+    void design(float* coef, FilterType_t type, float freq, float q, float gainDb)
+    {
+        freq        = std::min(freq, _sample_rate * 0.45f);
+        float a     = powf(10.0f, gainDb / 40.0f);
+        float w0    = 2.0f * (float)M_PI * freq / _sample_rate;
+        float cosw  = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * q);
+        float shelf = 2.0f * sqrtf(a) * alpha;
+        float b0, b1, b2, a0, a1, a2;
+        switch (type) {
+            case LOW_SHELF:
+                b0 = a * ((a + 1) - (a - 1) * cosw + shelf);
+                b1 = 2 * a * ((a - 1) - (a + 1) * cosw);
+                b2 = a * ((a + 1) - (a - 1) * cosw - shelf);
+                a0 = (a + 1) + (a - 1) * cosw + shelf;
+                a1 = -2 * ((a - 1) + (a + 1) * cosw);
+                a2 = (a + 1) + (a - 1) * cosw - shelf;
+                break;
+            case PEAKING:
+                b0 = 1 + alpha * a;
+                b1 = -2 * cosw;
+                b2 = 1 - alpha * a;
+                a0 = 1 + alpha / a;
+                a1 = -2 * cosw;
+                a2 = 1 - alpha / a;
+                break;
+            case HIGH_SHELF:
+                b0 = a * ((a + 1) + (a - 1) * cosw + shelf);
+                b1 = -2 * a * ((a - 1) + (a + 1) * cosw);
+                b2 = a * ((a + 1) + (a - 1) * cosw - shelf);
+                a0 = (a + 1) - (a - 1) * cosw + shelf;
+                a1 = 2 * ((a - 1) - (a + 1) * cosw);
+                a2 = (a + 1) - (a - 1) * cosw - shelf;
+                break;
+            default:
+                b0 = (1 + cosw) / 2;
+                b1 = -(1 + cosw);
+                b2 = (1 + cosw) / 2;
+                a0 = 1 + alpha;
+                a1 = -2 * cosw;
+                a2 = 1 - alpha;
+                break;
+        }
+        coef[0] = b0 / a0;
+        coef[1] = b1 / a0;
+        coef[2] = b2 / a0;
+        coef[3] = a1 / a0;
+        coef[4] = a2 / a0;
+    }
+
+    void update_eq()
+    {
+        if (_sample_rate <= 0) {
+            return;
+        }
+        static const FilterType_t types[EQ_BANDS] = {LOW_SHELF, PEAKING, HIGH_SHELF};
+        static const float freqs[EQ_BANDS]        = {120.0f, 1000.0f, 8000.0f};
+        static const float qs[EQ_BANDS]           = {0.707f, 0.9f, 0.707f};
+        for (int band = 0; band < EQ_BANDS; band++) {
+            // A flat band is skipped rather than run as a unity filter
+            _eq_active[band] = fabsf(_eq_db[band]) >= 0.1f;
+            design(_eq_coef[band], types[band], freqs[band], qs[band], _eq_db[band]);
+        }
+    }
+
+    /**
+     * @brief Add the frame's K-weighted energy to the loudness blocks
+     */
+    HOT_PATH void measure(int frames)
+    {
+        float energy = 0;
+        for (int ch = 0; ch < _channels; ch++) {
+            dsps_biquad_f32(_x[ch], _scratch, frames, _k_coef[0], _k_state[ch][0]);
+            dsps_biquad_f32(_scratch, _scratch, frames, _k_coef[1], _k_state[ch][1]);
+            float sum = 0;
+            dsps_dotprod_f32(_scratch, _scratch, &sum, frames);
+            energy += sum;  // BS.1770 weighs left and right alike
+        }
+        _sub_energy += energy;
+        _sub_frames += frames;
+        if (_sub_frames < _sample_rate * SUB_BLOCK_MS / 1000) {
+            return;
+        }
+
+        _block_energy[_block_index] = _sub_energy / _sub_frames;
+        _block_index                = (_block_index + 1) % BLOCK_SUB_BLOCKS;
+        _block_filled               = std::min(_block_filled + 1, BLOCK_SUB_BLOCKS);
+        _sub_energy                 = 0;
+        _sub_frames                 = 0;
+        if (_block_filled < BLOCK_SUB_BLOCKS) {
+            return;
+        }
+
+        float block = 0;
+        for (int i = 0; i < BLOCK_SUB_BLOCKS; i++) {
+            block += _block_energy[i];
+        }
+        block /= BLOCK_SUB_BLOCKS;
+
+        // Silence and quiet passages mustn't pull the level up
+        float lufs = (block > 0) ? energy_to_lufs(block) : ABSOLUTE_GATE_LUFS - 1;
+        if (lufs < ABSOLUTE_GATE_LUFS || (_integrated > 0 && lufs < loudness() - RELATIVE_GATE_LU)) {
+            return;
+        }
+        _gated_blocks = std::min(_gated_blocks + 1, INTEGRATION_BLOCKS);
+        _integrated += (block - _integrated) / _gated_blocks;
+
+        float wanted     = TARGET_LUFS - loudness();
+        _target_level_db = std::min(MAX_BOOST_DB, std::max(-MAX_CUT_DB, wanted));
+    }
+
+    HOT_PATH void update_level(int frames)
+    {
+        float target = !_normalize ? 0.0f : _track_known ? _track_db : _target_level_db;
+        float slew   = LEVEL_SLEW_DB_S * frames / _sample_rate;
+        _level_db += std::min(slew, std::max(-slew, target - _level_db));
+    }
+
+    /**
+     * @brief Gain only, in Q15: nothing to filter or measure
+     */
+    HOT_PATH void process_fixed(int16_t* pcm, int frames)
+    {
+        int n    = frames * _channels;
+        int peak = 0;
+        for (int i = 0; i < n; i++) {
+            peak = std::max(peak, std::abs((int)pcm[i]));
+        }
+        update_level(frames);
+        float target = _volume * powf(10.0f, _level_db / 20.0f);
+        if (peak * target > CEILING * 32768.0f) {
+            target = CEILING * 32768.0f / peak;
+        }
+
+        int32_t from = (int32_t)lrintf(_gain * Q15_ONE);
+        int32_t to   = (int32_t)lrintf(target * Q15_ONE);
+        _gain        = target;
+        if (from == to && to == Q15_ONE) {
+            return;
+        }
+        if (from == to && to < Q15_ONE) {
+            dsps_mulc_s16(pcm, pcm, n, (int16_t)to, 1, 1);  // Under unity nothing can overflow, works in place
+            return;
+        }
+
+        // Ramping, or a boost: the Q15 gain in 16 more fraction bits so a slow ramp still moves
+        int64_t gain = (int64_t)from << 16;
+        int64_t step = ((int64_t)(to - from) << 16) / frames;
+        for (int i = 0; i < frames; i++) {
+            gain += step;
+            int32_t g = (int32_t)(gain >> 16);
+            for (int ch = 0; ch < _channels; ch++) {
+                int16_t* x = &pcm[i * _channels + ch];
+                int32_t y  = (int32_t)(((int64_t)*x * g) >> 15);
+                *x         = (int16_t)std::min<int32_t>(32767, std::max<int32_t>(-32768, y));
+            }
+        }
+    }
+
+    int _sample_rate  = 0;
+    int _channels     = 2;
+    float _volume     = 1.0f;
+    float _gain       = 0.0f;  // Applied at the end of the last frame, starts at 0 so playback fades in
+    bool _normalize   = true;
+    float _level_db   = 0.0f;  // Normalizer gain being applied
+    bool _track_known = false;
+    float _track_db   = 0.0f;  // From the track's tags, see setTrackGain()
+
+    float _eq_db[EQ_BANDS]    = {0, 0, 0};
+    bool _eq_active[EQ_BANDS] = {false, false, false};
+    float _eq_coef[EQ_BANDS][5];
+    float _eq_state[2][EQ_BANDS][2];
+    float _k_coef[2][5];
+    float _k_state[2][2][2];
+
+    float _block_energy[BLOCK_SUB_BLOCKS];
+    int _block_index       = 0;
+    int _block_filled      = 0;
+    float _sub_energy      = 0;
+    int _sub_frames        = 0;
+    int _gated_blocks      = 0;
+    float _integrated      = 0;  // Mean energy of the gated blocks
+    float _target_level_db = 0;
+
+    alignas(16) float _x[2][MAX_FRAMES];
+    alignas(16) float _scratch[MAX_FRAMES];
+};
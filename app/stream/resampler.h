@@ -0,0 +1,233 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include <hal/hot_path.h>
+#include <dsps_dotprod.h>
+
+/**
+ * @brief Polyphase windowed-sinc sample rate converter, 16 bit interleaved in, stereo out
+ *
+ * The ratio is kept exact as L/M (44.1 -> 48 kHz is 160/147), each output sample is one TAPS long dot product
+ * (esp-dsp, the optimized variant for the target is picked by esp-dsp) against the phase's slice of a Kaiser
+ * windowed low-pass. Mono input is duplicated to both channels. Equal rates are copied straight through, delayed
+ * by the filter's TAPS / 2 so a trim can take over without a jump.
+ *
+ * setTrim() nudges the ratio by a few hundred ppm to follow a clock that drifts against the output's. The phase then
+ * carries a fraction, and the output is interpolated between the two neighbouring phases' dot products. Equal rates
+ * get a bank of EQUAL_PHASES phases for it the first time they're trimmed.
+ *
+ *     Resampler src;
+ *     src.configure(44100, 48000, 2);
+ *     int frames = src.process(pcm, inFrames, out, outCapacity);
+ */
+class Resampler {
+public:
+    static constexpr int TAPS       = 48;     // Per phase, in input samples
+    static constexpr int MAX_PHASES = 640;    // 11.025 -> 48 kHz, the finest ratio a stream can need
+    static constexpr int MAX_INPUT  = 2048;   // Frames per process() call
+    static constexpr float STOP_DB  = 80.0f;  // Kaiser window attenuation
+    static constexpr int EQUAL_PHASES  = 64;    // Equal rates, only designed once trimmed
+    static constexpr int MAX_TRIM_PPM  = 1000;  // setTrim() range
+
+    /**
+     * @return false if the ratio needs more than MAX_PHASES phases
+     */
+    bool configure(int inRate, int outRate, int channels)
+    {
+        channels = std::min(std::max(channels, 1), 2);
+        if (inRate == _in_rate && outRate == _out_rate && channels == _channels) {
+            return true;
+        }
+        int divisor = gcd(inRate, outRate);
+        int up      = inRate == outRate ? EQUAL_PHASES : outRate / divisor;
+        int down    = inRate == outRate ? EQUAL_PHASES : inRate / divisor;
+        if (inRate <= 0 || up > MAX_PHASES) {
+            return false;
+        }
+        _in_rate  = inRate;
+        _out_rate = outRate;
+        _channels = channels;
+        _up       = up;
+        _down     = down;
+        reset();
+        _coef.clear();
+        if (inRate != outRate || _trim != 0) {
+            design();
+        }
+        return true;
+    }
+
+    void reset()
+    {
+        memset(_x, 0, sizeof(_x));
+        _phase = 0;
+        _frac  = 0;
+        _pos   = TAPS - 1;
+    }
+
+    /**
+     * @brief Consume input `ppm` parts per million faster (slower if negative) than the configured ratio
+     *
+     * Kept over configure() and reset(), it's the clocks' difference rather than the stream's
+     */
+    void setTrim(int ppm)
+    {
+        ppm   = std::min(std::max(ppm, -MAX_TRIM_PPM), MAX_TRIM_PPM);
+        _trim = ppm * 1e-6f;
+        if (_trim != 0 && _coef.empty() && _in_rate > 0) {
+            design();
+        }
+    }
+
+    /**
+     * @brief Most output frames `inFrames` of input can give, at any trim
+     */
+    int maxOutput(int inFrames) const
+    {
+        int64_t phases = (int64_t)inFrames * _up * 1000000 / (1000000 - MAX_TRIM_PPM) + 1;
+        return (int)((phases + _down - 1) / _down) + 2;
+    }
+
+    /**
+     * @brief Most input frames whose output fits in `outFrames`, at any trim
+     */
+    int maxInput(int outFrames) const
+    {
+        return (int)((int64_t)(outFrames - 3) * _down * (1000000 - MAX_TRIM_PPM) / (1000000LL * _up));
+    }
+
+    /**
+     * @param in `inFrames` (at most MAX_INPUT) interleaved frames of the configured channel count
+     * @param out stereo frames, `maxOutput(inFrames)` of room is always enough
+     * @return frames written to `out`
+     */
+    HOT_PATH int process(const int16_t* in, int inFrames, int16_t* out, int outCapacity)
+    {
+        inFrames = std::min(inFrames, MAX_INPUT);
+
+        // History of the last TAPS - 1 samples, then this call's input
+        for (int ch = 0; ch < _channels; ch++) {
+            float* x = _x[ch] + TAPS - 1;
+            for (int i = 0; i < inFrames; i++) {
+                x[i] = in[i * _channels + ch];
+            }
+        }
+
+        int produced = 0;
+        int end      = TAPS - 1 + inFrames;
+        while (_pos < end && produced < outCapacity) {
+            for (int ch = 0; ch < 2; ch++) {
+                const float* x = _x[std::min(ch, _channels - 1)] + _pos - (TAPS - 1);
+                float y        = 0;
+                if (_coef.empty()) {
+                    y = x[TAPS - 1 - TAPS / 2];  // Equal rates, untrimmed
+                } else {
+                    dsps_dotprod_f32(x, &_coef[(size_t)_phase * TAPS], &y, TAPS);
+                    if (_frac != 0) {
+                        float next = 0;
+                        dsps_dotprod_f32(x, &_coef[(size_t)(_phase + 1) * TAPS], &next, TAPS);
+                        y += (next - y) * _frac;
+                    }
+                }
+                out[produced * 2 + ch] = (int16_t)std::min(32767.0f, std::max(-32768.0f, y));
+            }
+            produced++;
+
+            // A trimmed step carries its fraction of a phase over, a whole one slips the step by one
+            int step = _down;
+            if (_trim != 0) {
+                _frac += _down * _trim;
+                int slip = (int)floorf(_frac);
+                _frac -= slip;
+                step += slip;
+            }
+            _phase += step;
+            _pos += _phase / _up;
+            _phase %= _up;
+        }
+
+        for (int ch = 0; ch < _channels; ch++) {
+            memmove(_x[ch], _x[ch] + inFrames, (TAPS - 1) * sizeof(float));
+        }
+        _pos -= inFrames;
+        return produced;
+    }
+
+private:
+    static int gcd(int a, int b)
+    {
+        while (b != 0) {
+            int t = a % b;
+            a     = b;
+            b     = t;
+        }
+        return a;
+    }
+
+    static double bessel_i0(double x)
+    {
+        double sum  = 1;
+        double term = 1;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Low-pass at the upsampled rate, split into `_up` phases stored newest-tap-last for the dot product
+     *
+     * One more phase follows the last, the first one a sample later, for a fractional phase to interpolate towards
+     */
+    void design()
+    {
+        int length = _up * TAPS;
+        _coef.assign((size_t)(_up + 1) * TAPS, 0.0f);
+
+        // The transition band ends at the lower Nyquist frequency, all relative to the upsampled rate. What's left
+        // of an image above that folds back to just under the output Nyquist, out of hearing
+        double nyquist = 0.5 * std::min(_in_rate, _out_rate) / ((double)_in_rate * _up);
+        double width   = (STOP_DB - 8) / (2.285 * 2 * M_PI * TAPS) / _up;
+        double cutoff  = nyquist - width / 2;
+        double beta    = 0.1102 * (STOP_DB - 8.7);
+        double center  = (length - 1) / 2.0;
+        for (int n = 0; n < length; n++) {
+            double t      = n - center;
+            double sinc   = (t == 0) ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+            double r      = t / center;
+            double window = bessel_i0(beta * sqrt(std::max(0.0, 1 - r * r))) / bessel_i0(beta);
+            float value   = (float)(sinc * window * _up);
+
+            // Tap j of phase p weighs input pos - j, the dot product runs oldest first. The extra phase's tap j is
+            // phase 0's tap j + 1, its last lies past the window and stays zero
+            int phase = n % _up;
+            int tap   = n / _up;
+            _coef[(size_t)phase * TAPS + (TAPS - 1 - tap)] = value;
+            if (phase == 0 && tap > 0) {
+                _coef[(size_t)_up * TAPS + (TAPS - tap)] = value;
+            }
+        }
+    }
+
+    int _in_rate  = 0;
+    int _out_rate = 0;
+    int _channels = 2;
+    int _up       = 1;
+    int _down     = 1;
+    int _phase    = 0;
+    float _frac   = 0;  // Of a phase, on top of _phase, while trimmed
+    float _trim   = 0;
+    int _pos      = TAPS - 1;  // Newest input sample the next output is centred on, index into _x
+
+    std::vector<float> _coef;
+    alignas(16) float _x[2][TAPS - 1 + MAX_INPUT];
+};
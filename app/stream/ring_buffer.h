@@ -0,0 +1,643 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <string.h>
+#include <hal/hal.h>
+#include <hal/hot_path.h>
+#include "stream_signal.h"
+
+/**
+ * @brief Lock-free single-producer/single-consumer byte ring buffer
+ *
+ * Head and tail are free-running counters, the slot index is `counter & (size - 1)`, so the capacity is always a
+ * power of two and every read/write is at most two memcpy segments. Only one task may write and only one task may
+ * read at a time; `reset()` must only be called while neither side is active.
+ *
+ * The peek/commit pairs expose the next contiguous span for zero-copy access:
+ *
+ *     uint8_t* span;
+ *     size_t n = rb.peekWrite(&span);   // producer: fill up to n bytes at span
+ *     rb.commitWrite(filled);
+ *
+ *     const uint8_t* span;
+ *     size_t n = rb.peekRead(&span);    // consumer: use up to n bytes at span
+ *     rb.commitRead(used);
+ *
+ * Either side can block until the other has made progress with `waitForData()` / `waitForSpace()`. The waiter
+ * publishes how many bytes it needs and the opposite side only signals once that threshold is reached, so a blocked
+ * decoder is woken exactly once per refill rather than on every network chunk.
+ *
+ * With `setHistory()` the consumer keeps up to that many already-read bytes behind the tail, and can `rewind()`
+ * into them. The producer treats the history as used space, so it's never overwritten while it can be rewound to.
+ *
+ * Besides the consumer, up to MAX_CURSORS extra readers can follow the stream with `openCursor()`, each from its own
+ * task and at its own pace. A holding cursor is waited for like the consumer. A lagging one never holds the producer
+ * back: it can trail as far as the consumer's history reaches, and when it falls further behind it's moved forward
+ * and told how much it skipped.
+ *
+ * The storage is large and usually in PSRAM. With `setReadWindow()` the consumer's `peek()` and `read()` come out
+ * of a small copy in internal SRAM instead, refilled from the storage in bursts that end on a cache line. The
+ * decoder scans and re-peeks the same bytes several times per frame, those all hit the window.
+ */
+class RingBuffer {
+public:
+    ~RingBuffer()
+    {
+        deinit();
+    }
+
+    /**
+     * @brief Allocate the storage with the HAL, capacity is rounded up to a power of two
+     *
+     * @param bufferSize
+     * @param pool kept for the ring's lifetime, where the storage comes from
+     * @return true on success
+     */
+    bool init(size_t bufferSize, hal::HalBase::MemoryPool_t pool = hal::HalBase::MEMORY_STREAM)
+    {
+        size_t capacity = 1;
+        while (capacity < bufferSize) {
+            capacity <<= 1;
+        }
+
+        _pool   = pool;
+        _buffer = (uint8_t*)GetHAL()->allocBuffer(pool, capacity);
+        if (!_buffer) {
+            return false;
+        }
+        _size = capacity;
+        _mask = capacity - 1;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _floor.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    void deinit()
+    {
+        if (_buffer) {
+            GetHAL()->freeBuffer(_pool, _buffer);
+            _buffer = nullptr;
+        }
+        if (_window) {
+            GetHAL()->freeBuffer(_window_pool, _window);
+            _window      = nullptr;
+            _window_size = 0;
+        }
+        for (auto& cursor : _cursors) {
+            cursor.mode.store(CURSOR_FREE, std::memory_order_relaxed);
+        }
+        _size = 0;
+        _mask = 0;
+    }
+
+    bool isInitialized() const
+    {
+        return _buffer != nullptr;
+    }
+
+    void reset()
+    {
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _floor.store(0, std::memory_order_relaxed);
+        _window_len = 0;
+        for (auto& cursor : _cursors) {
+            cursor.pos.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Keep up to `bytes` of already-read data for `rewind()`, only while neither side is active
+     */
+    void setHistory(size_t bytes)
+    {
+        _history_limit = (bytes < _size) ? bytes : _size;
+    }
+
+    /**
+     * @brief Serve the consumer's `peek()` and `read()` from a `bytes` copy in `pool`, only while neither side is
+     * active
+     *
+     * A byte never changes once written, so the copy stays good wherever the read position goes, until `reset()`.
+     * Reads larger than the window go to the storage directly.
+     *
+     * @return false if there's no memory for it, reads go to the storage as before then
+     */
+    bool setReadWindow(size_t bytes, hal::HalBase::MemoryPool_t pool = hal::HalBase::MEMORY_INTERNAL)
+    {
+        if (_window) {
+            GetHAL()->freeBuffer(_window_pool, _window);
+        }
+        bytes        = (bytes + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+        _window_pool = pool;
+        _window      = (bytes > 0) ? (uint8_t*)GetHAL()->allocBuffer(pool, bytes) : nullptr;
+        _window_size = _window ? bytes : 0;
+        _window_len  = 0;
+        return _window != nullptr || bytes == 0;
+    }
+
+    /* -------------------------------- Producer -------------------------------- */
+    HOT_PATH size_t peekWrite(uint8_t** span)
+    {
+        size_t head   = _head.load(std::memory_order_relaxed);
+        size_t space  = _size - (head - protected_from(head));
+        size_t offset = head & _mask;
+        size_t linear = _size - offset;
+        *span         = _buffer + offset;
+        return (space < linear) ? space : linear;
+    }
+
+    HOT_PATH void commitWrite(size_t len)
+    {
+        // seq_cst pairs with the waiter's threshold store, otherwise a wakeup could be lost
+        _head.store(_head.load(std::memory_order_relaxed) + len, std::memory_order_seq_cst);
+
+        size_t wanted = _data_wanted.load(std::memory_order_seq_cst);
+        if (wanted && available() >= wanted) {
+            _data_wanted.store(0, std::memory_order_relaxed);
+            _data_signal.give();
+        }
+        for (int id = 0; id < MAX_CURSORS; id++) {
+            Cursor& cursor = _cursors[id];
+            wanted         = cursor.wanted.load(std::memory_order_seq_cst);
+            if (wanted && cursorAvailable(id) >= wanted) {
+                cursor.wanted.store(0, std::memory_order_relaxed);
+                cursor.signal.give();
+            }
+        }
+    }
+
+    HOT_PATH size_t write(const uint8_t* data, size_t len)
+    {
+        size_t written = 0;
+        // At most two segments: up to the end of storage, then from the start
+        for (int segment = 0; segment < 2 && written < len; segment++) {
+            uint8_t* span;
+            size_t n = peekWrite(&span);
+            if (n == 0) {
+                break;
+            }
+            if (n > len - written) {
+                n = len - written;
+            }
+            memcpy(span, data + written, n);
+            commitWrite(n);
+            written += n;
+        }
+        return written;
+    }
+
+    /* -------------------------------- Consumer -------------------------------- */
+    HOT_PATH size_t peekRead(const uint8_t** span)
+    {
+        size_t tail   = _tail.load(std::memory_order_relaxed);
+        size_t head   = _head.load(std::memory_order_acquire);
+        size_t avail  = head - tail;
+        size_t offset = tail & _mask;
+        size_t linear = _size - offset;
+        *span         = _buffer + offset;
+        return (avail < linear) ? avail : linear;
+    }
+
+    HOT_PATH void commitRead(size_t len)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed) + len;
+        _tail.store(tail, std::memory_order_seq_cst);
+        // History beyond the limit is handed back to the producer
+        if (tail - _floor.load(std::memory_order_relaxed) > _history_limit) {
+            _floor.store(tail - _history_limit, std::memory_order_seq_cst);
+        }
+
+        signal_space();
+    }
+
+    HOT_PATH size_t read(uint8_t* data, size_t len)
+    {
+        if (_window) {
+            size_t n = peek(data, len);
+            if (n > 0) {
+                commitRead(n);
+            }
+            return n;
+        }
+        size_t total = 0;
+        for (int segment = 0; segment < 2 && total < len; segment++) {
+            const uint8_t* span;
+            size_t n = peekRead(&span);
+            if (n == 0) {
+                break;
+            }
+            if (n > len - total) {
+                n = len - total;
+            }
+            memcpy(data + total, span, n);
+            commitRead(n);
+            total += n;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Copy up to `len` of the oldest bytes without consuming them, e.g. to inspect a frame header
+     *
+     * @return number of bytes copied
+     */
+    HOT_PATH size_t peek(uint8_t* data, size_t len) const
+    {
+        size_t tail  = _tail.load(std::memory_order_relaxed);
+        size_t avail = _head.load(std::memory_order_acquire) - tail;
+        if (len > avail) {
+            len = avail;
+        }
+        if (len == 0 || len > _window_size) {
+            copy_out(data, tail, len);
+            return len;
+        }
+        if ((ptrdiff_t)(tail - _window_pos) < 0 || tail + len - _window_pos > _window_len) {
+            fill_window(tail, tail + avail, len);
+        }
+        memcpy(data, _window + (tail - _window_pos), len);
+        return len;
+    }
+
+    /**
+     * @brief Drop up to `len` of the oldest bytes, this is a consumer-side operation
+     *
+     * @return number of bytes dropped
+     */
+    HOT_PATH size_t discard(size_t len)
+    {
+        size_t avail = available();
+        if (len > avail) {
+            len = avail;
+        }
+        if (len > 0) {
+            commitRead(len);
+        }
+        return len;
+    }
+
+    /**
+     * @brief Move the read position back by up to `len` bytes of history, this is a consumer-side operation
+     *
+     * @return number of bytes rewound
+     */
+    size_t rewind(size_t len)
+    {
+        size_t tail    = _tail.load(std::memory_order_relaxed);
+        size_t history = tail - _floor.load(std::memory_order_relaxed);
+        if (len > history) {
+            len = history;
+        }
+        _tail.store(tail - len, std::memory_order_seq_cst);
+        return len;
+    }
+
+    /* --------------------------------- Cursors -------------------------------- */
+    static constexpr int MAX_CURSORS = 4;
+
+    /**
+     * @brief Start an extra reader at the newest byte, safe while the producer and consumer are running
+     *
+     * @param holdsProducer true to make the producer wait for this cursor, false to let it lag and skip instead
+     * @param behind start this many bytes before the newest, at most back to the oldest byte of the history
+     * @return cursor id, -1 if all are in use
+     */
+    int openCursor(bool holdsProducer, size_t behind = 0)
+    {
+        for (int id = 0; id < MAX_CURSORS; id++) {
+            uint8_t expected = CURSOR_FREE;
+            if (_cursors[id].mode.compare_exchange_strong(expected, CURSOR_OPENING)) {
+                size_t head   = _head.load(std::memory_order_acquire);
+                size_t oldest = _floor.load(std::memory_order_acquire);
+                if (behind > head - oldest) {
+                    behind = head - oldest;
+                }
+                _cursors[id].pos.store(head - behind, std::memory_order_relaxed);
+                _cursors[id].wanted.store(0, std::memory_order_relaxed);
+                _cursors[id].mode.store(holdsProducer ? CURSOR_HOLDING : CURSOR_LAGGING, std::memory_order_seq_cst);
+                return id;
+            }
+        }
+        return -1;
+    }
+
+    void closeCursor(int id)
+    {
+        if (id < 0 || id >= MAX_CURSORS) {
+            return;
+        }
+        _cursors[id].mode.store(CURSOR_FREE, std::memory_order_seq_cst);
+        // A producer waiting on this cursor can carry on
+        signal_space();
+    }
+
+    size_t cursorAvailable(int id) const
+    {
+        if (_cursors[id].mode.load(std::memory_order_acquire) < CURSOR_LAGGING) {
+            return 0;
+        }
+        return _head.load(std::memory_order_acquire) - _cursors[id].pos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Stream position of the cursor, on the same free-running count as `writePosition()`
+     */
+    size_t cursorPosition(int id) const
+    {
+        return _cursors[id].pos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Copy up to `len` bytes at the cursor and move it on, only from the cursor's own task
+     *
+     * @param skipped set to the bytes a lagging cursor lost because it fell behind, 0 otherwise
+     * @return number of bytes copied, 0 if the cursor was moved forward instead
+     */
+    HOT_PATH size_t readCursor(int id, uint8_t* data, size_t len, size_t* skipped = nullptr)
+    {
+        Cursor& cursor = _cursors[id];
+        size_t pos     = cursor.pos.load(std::memory_order_relaxed);
+        size_t avail   = cursorAvailable(id);
+        if (skipped) {
+            *skipped = 0;
+        }
+        if (len > avail) {
+            len = avail;
+        }
+
+        copy_out(data, pos, len);
+
+        // The producer only writes over bytes behind the oldest protected one. If that passed the cursor during the
+        // copy, the copy may be torn and the cursor restarts at the oldest byte that is still safe
+        if (cursor.mode.load(std::memory_order_relaxed) == CURSOR_LAGGING) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            size_t oldest = _floor.load(std::memory_order_acquire);
+            if ((ptrdiff_t)(oldest - pos) > 0) {
+                if (skipped) {
+                    *skipped = oldest - pos;
+                }
+                cursor.pos.store(oldest, std::memory_order_release);
+                return 0;
+            }
+        }
+
+        cursor.pos.store(pos + len, std::memory_order_seq_cst);
+        if (cursor.mode.load(std::memory_order_relaxed) == CURSOR_HOLDING) {
+            signal_space();
+        }
+        return len;
+    }
+
+    /**
+     * @brief Move the cursor forward by up to `len` bytes without copying them, only from the cursor's own task
+     *
+     * @return number of bytes skipped
+     */
+    size_t skipCursor(int id, size_t len)
+    {
+        size_t avail = cursorAvailable(id);
+        if (len > avail) {
+            len = avail;
+        }
+        _cursors[id].pos.store(_cursors[id].pos.load(std::memory_order_relaxed) + len, std::memory_order_seq_cst);
+        if (_cursors[id].mode.load(std::memory_order_relaxed) == CURSOR_HOLDING) {
+            signal_space();
+        }
+        return len;
+    }
+
+    /**
+     * @brief Block the cursor's task until at least `minBytes` are there for it
+     *
+     * @return true if the data is there, false on timeout or `wakeAll()`
+     */
+    bool waitForCursorData(int id, size_t minBytes, uint32_t timeoutMs)
+    {
+        if (minBytes > _size) {
+            minBytes = _size;
+        }
+        return wait_for(_cursors[id].signal, _cursors[id].wanted, minBytes, timeoutMs,
+                        [this, id]() { return cursorAvailable(id); });
+    }
+
+    /* --------------------------------- Waiting -------------------------------- */
+    /**
+     * @brief Block the consumer until at least `minBytes` are buffered
+     *
+     * @return true if the data is there, false on timeout or `wakeAll()`
+     */
+    bool waitForData(size_t minBytes, uint32_t timeoutMs)
+    {
+        if (minBytes > _size) {
+            minBytes = _size;
+        }
+        return wait_for(_data_signal, _data_wanted, minBytes, timeoutMs, [this]() { return available(); });
+    }
+
+    /**
+     * @brief Block the producer until at least `minBytes` can be written
+     *
+     * @return true if the space is there, false on timeout or `wakeAll()`
+     */
+    bool waitForSpace(size_t minBytes, uint32_t timeoutMs)
+    {
+        if (minBytes > _size) {
+            minBytes = _size;
+        }
+        return wait_for(_space_signal, _space_wanted, minBytes, timeoutMs, [this]() { return freeSpace(); });
+    }
+
+    /**
+     * @brief Release any blocked waiter, e.g. when the stream is being stopped
+     */
+    void wakeAll()
+    {
+        _data_wanted.store(0, std::memory_order_relaxed);
+        _space_wanted.store(0, std::memory_order_relaxed);
+        _data_signal.give();
+        _space_signal.give();
+        for (auto& cursor : _cursors) {
+            cursor.wanted.store(0, std::memory_order_relaxed);
+            cursor.signal.give();
+        }
+    }
+
+    /* ---------------------------------- State --------------------------------- */
+    size_t available() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    size_t freeSpace() const
+    {
+        size_t head = _head.load(std::memory_order_acquire);
+        return _size - (head - protected_from(head));
+    }
+
+    /**
+     * @brief Total bytes written so far, the stream position of the next byte
+     */
+    size_t writePosition() const
+    {
+        return _head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Total bytes consumed so far, the stream position of the next byte read
+     */
+    size_t readPosition() const
+    {
+        return _tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Bytes that `rewind()` can currently go back
+     */
+    size_t history() const
+    {
+        return _tail.load(std::memory_order_acquire) - _floor.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return _size;
+    }
+
+    int bufferPercent() const
+    {
+        // Relative to the part that isn't reserved for history
+        size_t usable = _size - _history_limit;
+        if (usable == 0) {
+            return 0;
+        }
+        size_t level = available();
+        return (level >= usable) ? 100 : (level * 100) / usable;
+    }
+
+private:
+    enum CursorMode_t : uint8_t {
+        CURSOR_FREE,
+        CURSOR_OPENING,
+        CURSOR_LAGGING,
+        CURSOR_HOLDING,
+    };
+
+    struct Cursor {
+        std::atomic<uint8_t> mode{CURSOR_FREE};
+        std::atomic<size_t> pos{0};  // Owned by the cursor's task
+        std::atomic<size_t> wanted{0};
+        StreamSignal signal;
+    };
+
+    static constexpr size_t CACHE_LINE = 128;  // Of the P4's L2 as sdkconfig.defaults sets it, PSRAM is read through it
+
+    // Two segments at most, from storage wherever it is
+    HOT_PATH void copy_out(uint8_t* data, size_t pos, size_t len) const
+    {
+        size_t offset = pos & _mask;
+        size_t first  = (len < _size - offset) ? len : _size - offset;
+        memcpy(data, _buffer + offset, first);
+        memcpy(data + first, _buffer, len - first);
+    }
+
+    /**
+     * @brief Have the window start at `tail` and hold at least `needed` bytes, `head` is as far as there's data
+     *
+     * What it still has from `tail` on moves to the front, the rest comes from storage in one burst. The burst
+     * stops short of a cache line boundary so the next one starts on it.
+     */
+    HOT_PATH void fill_window(size_t tail, size_t head, size_t needed) const
+    {
+        size_t keep = 0;
+        if ((ptrdiff_t)(tail - _window_pos) >= 0 && tail - _window_pos < _window_len) {
+            keep = _window_len - (tail - _window_pos);
+            memmove(_window, _window + (tail - _window_pos), keep);
+        }
+        size_t from = tail + keep;
+        size_t n    = head - from;
+        if (n > _window_size - keep) {
+            n           = _window_size - keep;
+            size_t trim = (from + n) & (CACHE_LINE - 1);
+            if (trim < n && n - trim >= needed - keep) {
+                n -= trim;
+            }
+        }
+        copy_out(_window + keep, from, n);
+        _window_pos = tail;
+        _window_len = keep + n;
+    }
+
+    /**
+     * @brief Oldest byte the producer must not overwrite: the consumer's history and every holding cursor
+     */
+    HOT_PATH size_t protected_from(size_t head) const
+    {
+        size_t oldest = _floor.load(std::memory_order_acquire);
+        for (const auto& cursor : _cursors) {
+            if (cursor.mode.load(std::memory_order_acquire) == CURSOR_HOLDING) {
+                size_t pos = cursor.pos.load(std::memory_order_acquire);
+                if (head - pos > head - oldest) {
+                    oldest = pos;
+                }
+            }
+        }
+        return oldest;
+    }
+
+    HOT_PATH void signal_space()
+    {
+        size_t wanted = _space_wanted.load(std::memory_order_seq_cst);
+        if (wanted && freeSpace() >= wanted) {
+            _space_wanted.store(0, std::memory_order_relaxed);
+            _space_signal.give();
+        }
+    }
+
+    template <typename LevelFn>
+    bool wait_for(StreamSignal& signal, std::atomic<size_t>& wanted, size_t minBytes, uint32_t timeoutMs,
+                  LevelFn level)
+    {
+        if (level() >= minBytes) {
+            return true;
+        }
+        // Drop a stale signal left over from an earlier wait that timed out
+        signal.take(0);
+        wanted.store(minBytes, std::memory_order_seq_cst);
+        // Re-check after publishing the threshold so a concurrent commit can't be missed
+        if (level() < minBytes) {
+            signal.take(timeoutMs);
+        }
+        wanted.store(0, std::memory_order_relaxed);
+        return level() >= minBytes;
+    }
+
+    uint8_t* _buffer                 = nullptr;
+    hal::HalBase::MemoryPool_t _pool = hal::HalBase::MEMORY_STREAM;  // Where `_buffer` came from
+    size_t _size                     = 0;
+    size_t _mask                     = 0;
+    std::atomic<size_t> _head{0};   // Total bytes written, owned by the producer
+    std::atomic<size_t> _tail{0};   // Total bytes read, owned by the consumer
+    std::atomic<size_t> _floor{0};  // Oldest byte still kept, `tail - floor` is the history. Owned by the consumer
+    size_t _history_limit = 0;
+    std::atomic<size_t> _data_wanted{0};
+    std::atomic<size_t> _space_wanted{0};
+    StreamSignal _data_signal;
+    StreamSignal _space_signal;
+    Cursor _cursors[MAX_CURSORS];
+
+    // The consumer's read window, see setReadWindow()
+    uint8_t* _window                        = nullptr;
+    hal::HalBase::MemoryPool_t _window_pool = hal::HalBase::MEMORY_INTERNAL;
+    size_t _window_size                     = 0;
+    mutable size_t _window_pos              = 0;  // Stream position of `_window[0]`
+    mutable size_t _window_len              = 0;
+};
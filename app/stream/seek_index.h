@@ -0,0 +1,157 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+
+/**
+ * @brief Maps play time to byte offsets in an on-demand MP3 or AAC file, the offset a seek asks the server for
+ *
+ * It starts out from what the first frame says: the Xing table of contents (where each percent of the duration
+ * begins, in 256ths of the audio) or a straight line for CBR and files without one. Frames decoded from the start on
+ * are added as they come, one every MIN_SPACING_S or so. Those are exact, a seek back into what has been played lands
+ * where it was heard, whatever the bitrate did.
+ *
+ *     SeekIndex index;
+ *     index.reset(audioStart, fileSize, seconds, vbr.hasToc ? vbr.toc : nullptr);  // From the first frame
+ *     index.learn(playedSeconds, frameOffset);                                     // Frame by frame from the start
+ *     uint32_t offset = index.offsetOf(90.0f);                                     // Range: bytes=offset-
+ *     float at        = index.timeOf(offset);
+ */
+class SeekIndex {
+public:
+    static constexpr int MAX_POINTS      = 256;  // 2 KB, a point every 42 s of a 3 hour show
+    static constexpr float MIN_SPACING_S = 10;
+
+    /**
+     * @param audioStart file offset of the first audio frame, after the tags and the Xing frame
+     * @param audioEnd the end of the audio, the file size without a trailing tag
+     * @param seconds the duration, from the VBR tag's frame count or the bitrate
+     * @param toc the Xing table of contents, 100 bytes
+     */
+    void reset(uint32_t audioStart, uint32_t audioEnd, float seconds, const uint8_t* toc = nullptr)
+    {
+        _start    = audioStart;
+        _end      = std::max(audioEnd, audioStart);
+        _duration = std::max(seconds, 0.0f);
+        _spacing  = std::max(MIN_SPACING_S, _duration / MAX_POINTS);
+        _has_toc  = toc != nullptr;
+        if (_has_toc) {
+            memcpy(_toc, toc, sizeof(_toc));
+        }
+        _count = 0;
+    }
+
+    float duration() const
+    {
+        return _duration;
+    }
+
+    uint32_t audioStart() const
+    {
+        return _start;
+    }
+
+    /**
+     * @brief A frame heard `seconds` into the audio, counted from its start, begins at `offset`
+     */
+    void learn(float seconds, uint32_t offset)
+    {
+        if (_count == MAX_POINTS || (_count > 0 && seconds < _points[_count - 1].seconds + _spacing)) {
+            return;
+        }
+        _points[_count++] = {seconds, offset};
+    }
+
+    uint32_t offsetOf(float seconds) const
+    {
+        seconds = std::min(std::max(seconds, 0.0f), _duration);
+        if (_count > 0 && seconds <= _points[_count - 1].seconds) {
+            // Between two frames decoded
+            const Point_t* next = std::upper_bound(_points, _points + _count, seconds,
+                                                   [](float s, const Point_t& p) { return s < p.seconds; });
+            Point_t prev = (next == _points) ? Point_t{0, _start} : next[-1];
+            if (next == _points + _count || next->seconds <= prev.seconds) {
+                return prev.offset;
+            }
+            double t = (seconds - prev.seconds) / (next->seconds - prev.seconds);
+            return prev.offset + (uint32_t)(t * (next->offset - prev.offset));
+        }
+        // Past them the estimate can't go back before what's known
+        uint32_t estimate = estimate_offset(seconds);
+        return (_count > 0) ? std::max(estimate, _points[_count - 1].offset) : estimate;
+    }
+
+    float timeOf(uint32_t offset) const
+    {
+        offset = std::min(std::max(offset, _start), _end);
+        if (_count > 0 && offset <= _points[_count - 1].offset) {
+            const Point_t* next = std::upper_bound(_points, _points + _count, offset,
+                                                   [](uint32_t o, const Point_t& p) { return o < p.offset; });
+            Point_t prev = (next == _points) ? Point_t{0, _start} : next[-1];
+            if (next == _points + _count || next->offset <= prev.offset) {
+                return prev.seconds;
+            }
+            double t = (double)(offset - prev.offset) / (next->offset - prev.offset);
+            return prev.seconds + (float)(t * (next->seconds - prev.seconds));
+        }
+        float estimate = estimate_time(offset);
+        return (_count > 0) ? std::max(estimate, _points[_count - 1].seconds) : estimate;
+    }
+
+private:
+    struct Point_t {
+        float seconds;
+        uint32_t offset;
+    };
+
+    uint32_t estimate_offset(float seconds) const
+    {
+        if (_duration <= 0) {
+            return _start;
+        }
+        double fraction = seconds / _duration;
+        if (_has_toc) {
+            double percent = fraction * 100;
+            int i          = std::min(99, (int)percent);
+            double a       = _toc[i];
+            double b       = (i < 99) ? _toc[i + 1] : 256;
+            fraction       = (a + (b - a) * (percent - i)) / 256;
+        }
+        return _start + (uint32_t)(fraction * (_end - _start));
+    }
+
+    float estimate_time(uint32_t offset) const
+    {
+        if (_end <= _start) {
+            return 0;
+        }
+        double fraction = (double)(offset - _start) / (_end - _start);
+        if (_has_toc) {
+            // The table only ever grows, the last entry at or below the offset is the percent it's in
+            double x = fraction * 256;
+            int i    = 0;
+            while (i < 99 && _toc[i + 1] <= x) {
+                i++;
+            }
+            double a = _toc[i];
+            double b = (i < 99) ? _toc[i + 1] : 256;
+            fraction = (i + (b > a ? (x - a) / (b - a) : 0)) / 100;
+        }
+        return (float)(std::min(fraction, 1.0) * _duration);
+    }
+
+    uint32_t _start   = 0;
+    uint32_t _end     = 0;
+    float _duration   = 0;
+    float _spacing    = MIN_SPACING_S;
+    bool _has_toc     = false;
+    uint8_t _toc[100] = {};
+    Point_t _points[MAX_POINTS];
+    int _count = 0;
+};
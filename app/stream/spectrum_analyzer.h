@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <esp_err.h>
+#include <dsps_fft2r.h>
+
+/**
+ * @brief Log-spaced band levels from a windowed fixed-point FFT of mono PCM
+ *
+ * Uses the esp-dsp 16 bit complex FFT (the optimized variant for the target is picked by esp-dsp). Each band is the
+ * peak power of its bins in dBFS, mapped onto 0..255 over LEVEL_RANGE_DB. Bars rise at once, hold for a moment and
+ * then fall at a fixed rate, which reads much better than the raw per-frame values.
+ *
+ *     SpectrumAnalyzer analyzer;
+ *     analyzer.init();
+ *     analyzer.process(last1024Samples, 44100, levels, 32);   // once per display frame
+ */
+class SpectrumAnalyzer {
+public:
+    static constexpr int FFT_SIZE  = 1024;
+    static constexpr int MAX_BANDS = 128;
+
+    static constexpr float MIN_FREQ_HZ    = 40.0f;
+    static constexpr float MAX_FREQ_HZ    = 16000.0f;
+    static constexpr float LEVEL_RANGE_DB = 72.0f;  // dBFS mapped to level 0
+    static constexpr int PEAK_HOLD_FRAMES = 8;      // At display rate, ~250 ms
+    static constexpr float DECAY_DB       = 1.5f;   // Per frame once the hold is over
+
+    bool init()
+    {
+        // The twiddle table is shared by every user of the sc16 FFT, it's only created once
+        static bool tableReady = false;
+        if (!tableReady) {
+            if (dsps_fft2r_init_sc16(nullptr, FFT_SIZE) != ESP_OK) {
+                return false;
+            }
+            tableReady = true;
+        }
+
+        // Hann window in Q15
+        for (int i = 0; i < FFT_SIZE; i++) {
+            float w    = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (FFT_SIZE - 1));
+            _window[i] = (int16_t)(w * 32767.0f);
+        }
+        reset();
+        return true;
+    }
+
+    void reset()
+    {
+        std::fill(_level_db, _level_db + MAX_BANDS, -LEVEL_RANGE_DB);
+        std::fill(_hold, _hold + MAX_BANDS, 0);
+    }
+
+    /**
+     * @param samples FFT_SIZE mono samples, oldest first
+     * @param levels `bands` results, 0..255
+     */
+    void process(const int16_t* samples, int sampleRate, uint8_t* levels, int bands)
+    {
+        bands = std::min(bands, MAX_BANDS);
+        for (int i = 0; i < FFT_SIZE; i++) {
+            _data[i * 2]     = (int16_t)(((int32_t)samples[i] * _window[i]) >> 15);
+            _data[i * 2 + 1] = 0;
+        }
+        dsps_fft2r_sc16(_data, FFT_SIZE);
+        dsps_bit_rev_sc16_ansi(_data, FFT_SIZE);
+
+        // The sc16 FFT halves every stage, a full scale sine peaks at 32768 / 4 with the window's gain of 1/2
+        const float refDb = 20.0f * log10f(32768.0f / 4.0f);
+        float maxFreq     = std::min(MAX_FREQ_HZ, sampleRate * 0.5f);
+        float ratio       = maxFreq / MIN_FREQ_HZ;
+        float binHz       = (float)sampleRate / FFT_SIZE;
+        int lo            = std::max(1, (int)(MIN_FREQ_HZ / binHz));
+        for (int band = 0; band < bands; band++) {
+            float edge = MIN_FREQ_HZ * powf(ratio, (float)(band + 1) / bands);
+            int hi     = std::min(FFT_SIZE / 2, std::max(lo + 1, (int)(edge / binHz)));
+
+            // Low bands are narrower than a bin, they share the nearest one
+            int32_t peak = 0;
+            for (int bin = std::min(lo, hi - 1); bin < hi; bin++) {
+                int32_t re = _data[bin * 2];
+                int32_t im = _data[bin * 2 + 1];
+                peak       = std::max(peak, re * re + im * im);
+            }
+            lo = hi;
+
+            float db       = (peak > 0) ? 10.0f * log10f((float)peak) - refDb : -LEVEL_RANGE_DB;
+            db             = std::max(db, -LEVEL_RANGE_DB);
+            _band_db[band] = db;
+            if (db >= _level_db[band]) {
+                _level_db[band] = db;
+                _hold[band]     = PEAK_HOLD_FRAMES;
+            } else if (_hold[band] > 0) {
+                _hold[band]--;
+            } else {
+                _level_db[band] = std::max(db, _level_db[band] - DECAY_DB);
+            }
+
+            float level  = (_level_db[band] + LEVEL_RANGE_DB) * (255.0f / LEVEL_RANGE_DB);
+            levels[band] = (uint8_t)std::min(255.0f, std::max(0.0f, level));
+        }
+    }
+
+    /**
+     * @brief The last frame's bands in dBFS as measured, before the hold and the fall, down to -LEVEL_RANGE_DB
+     */
+    const float* bandDb() const
+    {
+        return _band_db;
+    }
+
+private:
+    int16_t _window[FFT_SIZE];
+    alignas(16) int16_t _data[FFT_SIZE * 2];  // Interleaved re/im
+    float _level_db[MAX_BANDS];
+    float _band_db[MAX_BANDS]{};
+    uint8_t _hold[MAX_BANDS];
+};
@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <strings.h>
+
+/**
+ * @brief Station playlists (.pls / .m3u) as handed out by station directories
+ *
+ * These only list the stream URLs of a station, usually one per mirror. HLS media playlists (.m3u8) are a
+ * different thing, see hls_playlist.
+ */
+namespace station_playlist {
+
+/**
+ * @return true if `url` points at a station playlist rather than the stream itself
+ */
+inline bool is_playlist_url(const std::string& url)
+{
+    std::string path = url.substr(0, url.find('?'));
+    if (path.size() < 4) {
+        return false;
+    }
+    const char* ext = path.c_str() + path.size() - 4;
+    return strcasecmp(ext, ".pls") == 0 || strcasecmp(ext, ".m3u") == 0;
+}
+
+/**
+ * @brief Stream URLs in playlist order, for both `FileN=url` (PLS) and one-URL-per-line (M3U) playlists
+ */
+inline std::vector<std::string> parse(const std::string& text)
+{
+    std::vector<std::string> urls;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(pos, end - pos);
+        pos              = end + 1;
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+
+        // PLS entries are FileN=url, M3U the bare URL. Comments, titles and lengths are skipped
+        if (strncasecmp(line.c_str(), "File", 4) == 0) {
+            size_t eq = line.find('=');
+            line      = (eq == std::string::npos) ? "" : line.substr(eq + 1);
+        }
+        if (line.find("://") != std::string::npos && line[0] != '#') {
+            urls.push_back(line);
+        }
+    }
+    return urls;
+}
+
+}  // namespace station_playlist
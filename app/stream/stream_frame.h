@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "mp3_frame.h"
+#include "adts_frame.h"
+#include "packet_frame.h"
+
+enum StreamCodec_t {
+    CODEC_MP3,
+    CODEC_AAC,   // ADTS framed AAC-LC / HE-AAC (AAC+)
+    CODEC_OPUS,  // Packets out of Ogg, framed by packet_frame
+    CODEC_FLAC,  // Frames out of Ogg or a native FLAC stream, framed by packet_frame
+};
+
+struct FrameHeader_t {
+    StreamCodec_t codec = CODEC_MP3;
+    size_t frameSize    = 0;
+    int sampleRate      = 0;      // 0 for packets, only the decoder knows
+    bool config         = false;  // A packet with the decoder config, not audio
+};
+
+/**
+ * @brief The frame scanners of all codecs behind one call, for a reader that only knows the stream's codec
+ *
+ *     FrameHeader_t header;
+ *     int offset = stream_frame::find_frame(codec, window, len, &header);
+ *     if (offset >= 0 && len - offset >= header.frameSize) { decode(window + offset, header.frameSize); }
+ */
+namespace stream_frame {
+
+inline bool is_packet(StreamCodec_t codec)
+{
+    return codec == CODEC_OPUS || codec == CODEC_FLAC;
+}
+
+inline const char* codec_name(StreamCodec_t codec)
+{
+    switch (codec) {
+        case CODEC_AAC:
+            return "AAC";
+        case CODEC_OPUS:
+            return "Opus";
+        case CODEC_FLAC:
+            return "FLAC";
+        default:
+            return "MP3";
+    }
+}
+
+inline size_t header_size(StreamCodec_t codec)
+{
+    if (is_packet(codec)) {
+        return packet_frame::HEADER_SIZE;
+    }
+    return (codec == CODEC_AAC) ? adts_frame::HEADER_SIZE : mp3_frame::HEADER_SIZE;
+}
+
+inline bool parse_header(StreamCodec_t codec, const uint8_t* data, FrameHeader_t* header)
+{
+    header->codec  = codec;
+    header->config = false;
+    if (is_packet(codec)) {
+        packet_frame::FrameInfo_t info;
+        if (!packet_frame::parse_header(data, &info)) {
+            return false;
+        }
+        header->frameSize  = info.frameSize;
+        header->sampleRate = 0;
+        header->config     = info.config;
+        return true;
+    }
+    if (codec == CODEC_AAC) {
+        adts_frame::FrameInfo_t info;
+        if (!adts_frame::parse_header(data, &info)) {
+            return false;
+        }
+        header->frameSize  = info.frameSize;
+        header->sampleRate = info.sampleRate;
+        return true;
+    }
+    mp3_frame::FrameInfo_t info;
+    if (!mp3_frame::parse_header(data, &info)) {
+        return false;
+    }
+    header->frameSize  = info.frameSize;
+    header->sampleRate = info.sampleRate;
+    return true;
+}
+
+/**
+ * @return offset of the first frame in `data`, confirmed by the header after it where that's in `data` too, -1 if
+ * there is none
+ */
+inline int find_frame(StreamCodec_t codec, const uint8_t* data, size_t len, FrameHeader_t* header)
+{
+    int offset     = -1;
+    header->config = false;
+    if (is_packet(codec)) {
+        packet_frame::FrameInfo_t info;
+        offset             = packet_frame::find_frame(data, len, &info);
+        header->frameSize  = info.frameSize;
+        header->sampleRate = 0;
+        header->config     = info.config;
+    } else if (codec == CODEC_AAC) {
+        adts_frame::FrameInfo_t info;
+        offset             = adts_frame::find_frame(data, len, &info);
+        header->frameSize  = info.frameSize;
+        header->sampleRate = info.sampleRate;
+    } else {
+        mp3_frame::FrameInfo_t info;
+        offset             = mp3_frame::find_frame(data, len, &info);
+        header->frameSize  = info.frameSize;
+        header->sampleRate = info.sampleRate;
+    }
+    header->codec = codec;
+    return offset;
+}
+
+}  // namespace stream_frame
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/**
+ * @brief Binary semaphore, the one thing the stream pipeline needs from the OS
+ *
+ * A statically allocated FreeRTOS semaphore on the Tab5, a mutex and condition variable elsewhere. Gives don't add
+ * up: given twice before a take, it's taken once.
+ *
+ *     StreamSignal ready;
+ *     ready.give();                  // Producer
+ *     if (ready.take(100)) { ... }   // Consumer, false on the timeout
+ */
+class StreamSignal {
+public:
+    static constexpr uint32_t WAIT_FOREVER = UINT32_MAX;
+
+    StreamSignal(const StreamSignal&)            = delete;
+    StreamSignal& operator=(const StreamSignal&) = delete;
+
+#ifdef ESP_PLATFORM
+    StreamSignal() : _sem(xSemaphoreCreateBinaryStatic(&_storage))
+    {
+    }
+
+    void give()
+    {
+        xSemaphoreGive(_sem);
+    }
+
+    bool take(uint32_t timeoutMs)
+    {
+        return xSemaphoreTake(_sem, timeoutMs == WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+    }
+
+private:
+    StaticSemaphore_t _storage;
+    SemaphoreHandle_t _sem;
+#else
+    StreamSignal() = default;
+
+    void give()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _given = true;
+        }
+        _cond.notify_one();
+    }
+
+    bool take(uint32_t timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (timeoutMs == WAIT_FOREVER) {
+            _cond.wait(lock, [this]() { return _given; });
+        } else if (!_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return _given; })) {
+            return false;
+        }
+        _given = false;
+        return true;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _given = false;
+#endif
+};
@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#else
+#include <chrono>
+#endif
+
+// Numbered for the dump, stream_trace.py names them: only ever append
+enum StreamTraceEvent_t : uint16_t {
+    TRACE_SOCKET_READ = 0,  // arg: bytes
+    TRACE_RING_WRITE,       // arg: bytes
+    TRACE_RING_READ,        // arg: bytes
+    TRACE_FRAME_DECODE,     // arg: frame bytes
+    TRACE_I2S_WRITE,        // arg: bytes
+    TRACE_UNDERRUN,         // The output ran dry
+    TRACE_REBUFFER,         // arg: bytes the decoder waits for
+    TRACE_BUFFER_LEVEL,     // arg: bytes in the stream ring
+    TRACE_STRESS_LOAD,      // arg: the stress phase's loads, HalBase::StressLoad_t bits
+};
+
+enum StreamTracePhase_t : uint16_t {
+    TRACE_BEGIN = 0,
+    TRACE_END,
+    TRACE_INSTANT,
+    TRACE_COUNTER,
+};
+
+/**
+ * @brief Binary event trace of the stream pipeline, for where latency and jitter come from
+ *
+ * A fixed ring of 12 byte records, overwritten oldest first, that any task may append to without a lock or a
+ * format string. It records nothing until `start()` hands it storage, so a build without tracing pays one load and
+ * branch per event. The dump is read by stream_trace.py, which writes Chrome/Perfetto trace JSON.
+ *
+ *     stream_trace().start(records, 16384);
+ *     StreamTrace::Span span(TRACE_FRAME_DECODE, frameSize);   // begin now, end when it goes out of scope
+ *     stream_trace().record(TRACE_UNDERRUN, TRACE_INSTANT);
+ *
+ * Dump file: `FileHeader_t` followed by `count` records, oldest first.
+ */
+class StreamTrace {
+public:
+    struct Record_t {
+        uint32_t timeUs;  // Wraps after 71 minutes, records are in order so the reader unwraps it
+        uint32_t arg;
+        uint16_t event;
+        uint16_t phase;
+    };
+    struct FileHeader_t {
+        char magic[4]       = {'S', 'T', 'R', 'C'};
+        uint16_t version    = 1;
+        uint16_t recordSize = sizeof(Record_t);
+        uint32_t count      = 0;
+        uint32_t dropped    = 0;  // Overwritten before the dump
+    };
+
+    /**
+     * @param capacity records in `storage`, a power of two
+     */
+    void start(Record_t* storage, size_t capacity)
+    {
+        _mask = capacity - 1;
+        _next.store(0, std::memory_order_relaxed);
+        _records.store(storage, std::memory_order_release);
+    }
+
+    bool active() const
+    {
+        return _records.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    void record(StreamTraceEvent_t event, StreamTracePhase_t phase, uint32_t arg = 0)
+    {
+        Record_t* records = _records.load(std::memory_order_acquire);
+        if (!records) {
+            return;
+        }
+        Record_t& record = records[_next.fetch_add(1, std::memory_order_relaxed) & _mask];
+        record.timeUs    = now_us();
+        record.arg       = arg;
+        record.event     = event;
+        record.phase     = phase;
+    }
+
+    /**
+     * @brief Copy the records out oldest first, recording pauses meanwhile
+     *
+     * A record being written as the copy passes it may come out torn, the cost of not locking on the hot path.
+     *
+     * @return records copied
+     */
+    size_t copy(Record_t* out, size_t capacity, FileHeader_t* header)
+    {
+        Record_t* records = _records.exchange(nullptr, std::memory_order_acq_rel);
+        if (!records) {
+            return 0;
+        }
+        uint32_t next  = _next.load(std::memory_order_relaxed);
+        size_t size    = _mask + 1;
+        size_t count   = next < size ? next : size;
+        count          = count < capacity ? count : capacity;
+        uint32_t first = next - count;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = records[(first + i) & _mask];
+        }
+        header->count   = count;
+        header->dropped = first;
+        _records.store(records, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Begin now, end when it goes out of scope
+     */
+    class Span {
+    public:
+        explicit Span(StreamTraceEvent_t event, uint32_t arg = 0);
+        ~Span();
+
+    private:
+        StreamTraceEvent_t _event;
+        uint32_t _arg;
+    };
+
+private:
+    static uint32_t now_us()
+    {
+#ifdef ESP_PLATFORM
+        return (uint32_t)esp_timer_get_time();
+#else
+        auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+        return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+#endif
+    }
+
+    std::atomic<Record_t*> _records{nullptr};
+    std::atomic<uint32_t> _next{0};
+    size_t _mask = 0;
+};
+
+inline StreamTrace& stream_trace()
+{
+    static StreamTrace trace;
+    return trace;
+}
+
+inline StreamTrace::Span::Span(StreamTraceEvent_t event, uint32_t arg) : _event(event), _arg(arg)
+{
+    stream_trace().record(_event, TRACE_BEGIN, _arg);
+}
+
+inline StreamTrace::Span::~Span()
+{
+    stream_trace().record(_event, TRACE_END, _arg);
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025
+#
+# SPDX-License-Identifier: MIT
+"""Convert a stream trace dump (stream_trace.h) to Chrome trace JSON, which Perfetto and chrome://tracing open.
+
+The dump is either the binary file the Tab5 writes to the SD card, or a console log holding the base64 lines it
+prints when there's no card:
+
+    python3 app/stream/stream_trace.py /sd/radio_trace.bin trace.json
+    python3 app/stream/stream_trace.py monitor.log trace.json
+"""
+import base64
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHII")
+RECORD = struct.Struct("<IIHH")
+LOG_MARKER = "STREAM_TRACE "
+
+# StreamTraceEvent_t, in order, with the task each one happens on
+EVENTS = [
+    ("socket read", "HTTP"),
+    ("ring write", "HTTP"),
+    ("ring read", "Decoder"),
+    ("frame decode", "Decoder"),
+    ("I2S write", "Output"),
+    ("underrun", "Output"),
+    ("rebuffer", "Decoder"),
+    ("buffer level", "Decoder"),
+    ("stress load", "Stress"),
+]
+PHASES = ["B", "E", "i", "C"]  # StreamTracePhase_t
+TASKS = ["HTTP", "Decoder", "Output", "Stress"]
+
+
+def read_dump(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] == b"STRC":
+        return data
+    # A console log: the base64 lines after the marker, each one decoded on its own. The last dump in it wins
+    chunks = []
+    for line in data.decode("utf-8", "replace").splitlines():
+        at = line.find(LOG_MARKER)
+        if at >= 0:
+            word = line[at + len(LOG_MARKER):].strip()
+            if word == "BEGIN":
+                chunks = []
+            elif word != "END":
+                chunks.append(word)
+    return b"".join(base64.b64decode(chunk) for chunk in chunks)
+
+
+def convert(data):
+    magic, version, record_size, count, dropped = HEADER.unpack_from(data, 0)
+    if magic != b"STRC" or version != 1 or record_size != RECORD.size:
+        raise ValueError("not a version 1 stream trace")
+    if dropped:
+        print(f"{dropped} older records were overwritten", file=sys.stderr)
+
+    events = [{"ph": "M", "pid": 1, "tid": tid, "name": "thread_name", "args": {"name": name}}
+              for tid, name in enumerate(TASKS)]
+    base = None
+    last = 0
+    wraps = 0
+    for i in range(count):
+        time_us, arg, event, phase = RECORD.unpack_from(data, HEADER.size + i * RECORD.size)
+        if event >= len(EVENTS) or phase >= len(PHASES):
+            continue  # Torn while the dump copied it
+        if time_us < last:
+            wraps += 1
+        last = time_us
+        ts = time_us + (wraps << 32)
+        base = ts if base is None else base
+        name, task = EVENTS[event]
+        entry = {"ph": PHASES[phase], "pid": 1, "tid": TASKS.index(task), "name": name, "ts": ts - base}
+        if PHASES[phase] == "C":
+            entry["args"] = {"bytes": arg}
+        elif PHASES[phase] == "i":
+            entry["s"] = "t"
+            entry["args"] = {"arg": arg}
+        elif PHASES[phase] == "B":
+            entry["args"] = {"bytes": arg}
+        events.append(entry)
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(f"usage: {sys.argv[0]} <dump or log> <trace.json>", file=sys.stderr)
+        return 1
+    trace = convert(read_dump(sys.argv[1]))
+    with open(sys.argv[2], "w") as f:
+        json.dump(trace, f)
+    print(f"{len(trace['traceEvents'])} events written to {sys.argv[2]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Single-producer / single-consumer triple buffer
+ *
+ * The producer fills `back()` and `publish()`es it, the consumer `update()`s and reads `front()`. Neither side
+ * ever waits or copies under a lock, and the consumer always sees a whole value: the newest published one. Values
+ * published while the consumer wasn't looking are dropped, which is what a display wants.
+ *
+ *     // Producer                         // Consumer
+ *     buffer.back() = next;               if (buffer.update()) {
+ *     buffer.publish();                       draw(buffer.front());
+ *                                         }
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    T& back()
+    {
+        return _slots[_back];
+    }
+
+    void publish()
+    {
+        uint8_t previous = _middle.exchange(_back | FRESH, std::memory_order_acq_rel);
+        _back            = previous & INDEX;
+    }
+
+    /**
+     * @return true if a newer value was published since the last call, `front()` now holds it
+     */
+    bool update()
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        uint8_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front           = previous & INDEX;
+        return true;
+    }
+
+    const T& front() const
+    {
+        return _slots[_front];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04;  // Set on the middle slot when it holds an unread value
+
+    T _slots[3]{};
+    uint8_t _back = 0;
+    std::atomic<uint8_t> _middle{1};
+    uint8_t _front = 2;
+};
@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string.h>
+
+/**
+ * @brief Minimal MPEG-TS demuxer that extracts the first audio elementary stream
+ *
+ * Follows PAT -> PMT -> the first AAC (ADTS) or MP3 stream and hands out the PES payloads, which are plain ADTS /
+ * MP3 frames. Packets can be split across calls at any byte; only a partial packet (< 188 bytes) is carried over.
+ */
+class TsDemuxer {
+public:
+    static constexpr size_t PACKET_SIZE = 188;
+
+    enum StreamType_t {
+        STREAM_UNKNOWN,
+        STREAM_AAC,
+        STREAM_MP3,
+    };
+
+    void reset()
+    {
+        _carry_len   = 0;
+        _pmt_pid     = -1;
+        _audio_pid   = -1;
+        _stream_type = STREAM_UNKNOWN;
+    }
+
+    StreamType_t streamType() const
+    {
+        return _stream_type;
+    }
+
+    /**
+     * @param onAudio called as `onAudio(const uint8_t* data, size_t len)` for each piece of audio payload
+     */
+    template <typename AudioFn>
+    void feed(const uint8_t* data, size_t len, AudioFn onAudio)
+    {
+        // Complete a packet left over from the previous call
+        if (_carry_len > 0) {
+            size_t n = PACKET_SIZE - _carry_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(_carry + _carry_len, data, n);
+            _carry_len += n;
+            data += n;
+            len -= n;
+            if (_carry_len < PACKET_SIZE) {
+                return;
+            }
+            handle_packet(_carry, onAudio);
+            _carry_len = 0;
+        }
+
+        while (len >= PACKET_SIZE) {
+            if (data[0] != SYNC_BYTE) {
+                // Lost sync, step to the next candidate
+                data++;
+                len--;
+                continue;
+            }
+            handle_packet(data, onAudio);
+            data += PACKET_SIZE;
+            len -= PACKET_SIZE;
+        }
+
+        if (len > 0) {
+            memcpy(_carry, data, len);
+            _carry_len = len;
+        }
+    }
+
+private:
+    static constexpr uint8_t SYNC_BYTE = 0x47;
+
+    template <typename AudioFn>
+    void handle_packet(const uint8_t* packet, AudioFn& onAudio)
+    {
+        bool unitStart = (packet[1] & 0x40) != 0;
+        int pid        = ((packet[1] & 0x1F) << 8) | packet[2];
+        int adaptation = (packet[3] >> 4) & 0x03;
+
+        size_t pos = 4;
+        if (adaptation & 0x02) {
+            pos += 1 + packet[4];
+        }
+        if (!(adaptation & 0x01) || pos >= PACKET_SIZE) {
+            return;
+        }
+        const uint8_t* payload = packet + pos;
+        size_t payloadLen      = PACKET_SIZE - pos;
+
+        if (pid == _audio_pid) {
+            if (unitStart) {
+                // PES header: 00 00 01 id, length (2), flags (2), header data length, header data
+                if (payloadLen < 9 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1) {
+                    return;
+                }
+                size_t headerLen = 9 + payload[8];
+                if (headerLen >= payloadLen) {
+                    return;
+                }
+                payload += headerLen;
+                payloadLen -= headerLen;
+            }
+            onAudio(payload, payloadLen);
+        } else if (pid == 0 && unitStart) {
+            parse_pat(payload, payloadLen);
+        } else if (pid == _pmt_pid && unitStart) {
+            parse_pmt(payload, payloadLen);
+        }
+    }
+
+    // Both tables are assumed to fit in one packet, which is the case for a single-program audio stream
+    static const uint8_t* section(const uint8_t* payload, size_t len, size_t* sectionLen)
+    {
+        size_t pointer = payload[0];
+        if (1 + pointer + 3 > len) {
+            return nullptr;
+        }
+        const uint8_t* table = payload + 1 + pointer;
+        size_t length        = 3 + (((table[1] & 0x0F) << 8) | table[2]);
+        if (length > len - 1 - pointer) {
+            return nullptr;
+        }
+        *sectionLen = length;
+        return table;
+    }
+
+    void parse_pat(const uint8_t* payload, size_t len)
+    {
+        size_t length;
+        const uint8_t* table = section(payload, len, &length);
+        if (!table || table[0] != 0x00 || length < 12) {
+            return;
+        }
+        // Program entries run from byte 8 up to the CRC
+        for (size_t i = 8; i + 4 <= length - 4; i += 4) {
+            int program = (table[i] << 8) | table[i + 1];
+            if (program != 0) {
+                _pmt_pid = ((table[i + 2] & 0x1F) << 8) | table[i + 3];
+                return;
+            }
+        }
+    }
+
+    void parse_pmt(const uint8_t* payload, size_t len)
+    {
+        size_t length;
+        const uint8_t* table = section(payload, len, &length);
+        if (!table || table[0] != 0x02 || length < 16) {
+            return;
+        }
+        size_t i = 12 + (((table[10] & 0x0F) << 8) | table[11]);
+        while (i + 5 <= length - 4) {
+            uint8_t type  = table[i];
+            int pid       = ((table[i + 1] & 0x1F) << 8) | table[i + 2];
+            size_t esInfo = ((table[i + 3] & 0x0F) << 8) | table[i + 4];
+            if (type == 0x0F) {
+                _audio_pid   = pid;
+                _stream_type = STREAM_AAC;
+                return;
+            }
+            if (type == 0x03 || type == 0x04) {
+                _audio_pid   = pid;
+                _stream_type = STREAM_MP3;
+                return;
+            }
+            i += 5 + esInfo;
+        }
+    }
+
+    uint8_t _carry[PACKET_SIZE];
+    size_t _carry_len         = 0;
+    int _pmt_pid              = -1;
+    int _audio_pid            = -1;
+    StreamType_t _stream_type = STREAM_UNKNOWN;
+};
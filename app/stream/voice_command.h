@@ -0,0 +1,508 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+/**
+ * @brief Spoken commands told apart from examples of them the user recorded, no model or wake word needed
+ *
+ * 16 kHz mono goes through VoiceFeatures into MFCC frames, 10 ms apart, and VoiceUtterance cuts those into the
+ * stretches someone spoke, against a noise floor that follows whatever is left of the music. VoiceMatcher then
+ * finds the example nearest to an utterance by dynamic time warping, so the same word said faster or slower still
+ * lines up. It only ever picks among the commands it has examples of, anything else said is left unmatched as long
+ * as it isn't close to one of them.
+ *
+ *     VoiceFeatures features;
+ *     VoiceUtterance utterance;
+ *     VoiceMatcher matcher;
+ *     features.push(samples, n, [&](const voice::Frame_t& frame, float energyDb) {
+ *         if (utterance.push(frame, energyDb)) {
+ *             int command = matcher.match(utterance.frames());  // Or matcher.addExample(command, ...)
+ *         }
+ *     });
+ */
+namespace voice {
+
+static constexpr int SAMPLE_RATE = 16000;
+static constexpr int WINDOW      = 400;  // 25 ms analysis window
+static constexpr int HOP         = 160;  // 10 ms between frames
+static constexpr int FFT_SIZE    = 512;
+static constexpr int MEL_BANDS   = 24;
+static constexpr int COEFFS      = 12;  // Cepstral coefficients 1..12, the level (0) is left to the VAD
+
+struct Frame_t {
+    float c[COEFFS];
+};
+
+}  // namespace voice
+
+class VoiceFeatures {
+public:
+    static constexpr float PREEMPHASIS = 0.97f;
+    static constexpr float MIN_FREQ_HZ = 100.0f;
+    static constexpr float MAX_FREQ_HZ = 7600.0f;
+
+    VoiceFeatures()
+    {
+        using namespace voice;
+        for (int i = 0; i < WINDOW; i++) {
+            _window[i] = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * i / (WINDOW - 1));
+        }
+        for (int i = 0; i < FFT_SIZE / 2; i++) {
+            _cos[i] = cosf(2.0f * (float)M_PI * i / FFT_SIZE);
+            _sin[i] = -sinf(2.0f * (float)M_PI * i / FFT_SIZE);
+        }
+        for (int i = 0; i < FFT_SIZE; i++) {
+            int r = 0;
+            for (int b = 1, v = i; b < FFT_SIZE; b <<= 1, v >>= 1) {
+                r = (r << 1) | (v & 1);
+            }
+            _bitrev[i] = (uint16_t)r;
+        }
+
+        // Triangles evenly spaced on the mel scale, each band's weights kept from its first bin on
+        auto mel = [](float hz) { return 2595.0f * log10f(1.0f + hz / 700.0f); };
+        float lo = mel(MIN_FREQ_HZ);
+        float hi = mel(MAX_FREQ_HZ);
+        float edges[MEL_BANDS + 2];
+        for (int m = 0; m < MEL_BANDS + 2; m++) {
+            float hz = 700.0f * (powf(10.0f, (lo + (hi - lo) * m / (MEL_BANDS + 1)) / 2595.0f) - 1.0f);
+            edges[m] = hz * FFT_SIZE / SAMPLE_RATE;
+        }
+        for (int m = 0; m < MEL_BANDS; m++) {
+            int first = (int)ceilf(edges[m]);
+            int last  = std::min((int)floorf(edges[m + 2]), FFT_SIZE / 2);
+            _band_first[m] = (uint16_t)first;
+            _band_start[m] = (uint16_t)_weights.size();
+            for (int k = first; k <= last; k++) {
+                float w = (k <= edges[m + 1]) ? (k - edges[m]) / (edges[m + 1] - edges[m])
+                                              : (edges[m + 2] - k) / (edges[m + 2] - edges[m + 1]);
+                _weights.push_back(std::max(w, 0.0f));
+            }
+            _band_count[m] = (uint16_t)(_weights.size() - _band_start[m]);
+        }
+        // Orthonormal DCT-II, so the coefficients stay in log units whatever MEL_BANDS is
+        for (int k = 0; k < COEFFS; k++) {
+            for (int m = 0; m < MEL_BANDS; m++) {
+                _dct[k][m] = sqrtf(2.0f / MEL_BANDS) * cosf((float)M_PI * (k + 1) * (m + 0.5f) / MEL_BANDS);
+            }
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        memset(_history, 0, sizeof(_history));
+        _fill = 0;  // The first frame waits for a whole window, a part of one reads as a quiet moment
+        _last = 0;
+    }
+
+    /**
+     * @brief Take `n` samples (-1..1), `onFrame(const voice::Frame_t&, float energyDb)` for every HOP of them
+     */
+    template <typename OnFrame>
+    void push(const float* samples, size_t n, OnFrame onFrame)
+    {
+        for (size_t i = 0; i < n; i++) {
+            float x           = samples[i];
+            _history[_fill++] = x - PREEMPHASIS * _last;
+            _last             = x;
+            if (_fill == voice::WINDOW) {
+                float energyDb;
+                voice::Frame_t frame;
+                analyze(&frame, &energyDb);
+                onFrame(frame, energyDb);
+                memmove(_history, _history + voice::HOP, (voice::WINDOW - voice::HOP) * sizeof(float));
+                _fill = voice::WINDOW - voice::HOP;
+            }
+        }
+    }
+
+private:
+    float _window[voice::WINDOW];
+    float _cos[voice::FFT_SIZE / 2];
+    float _sin[voice::FFT_SIZE / 2];
+    uint16_t _bitrev[voice::FFT_SIZE];
+    uint16_t _band_first[voice::MEL_BANDS];
+    uint16_t _band_start[voice::MEL_BANDS];
+    uint16_t _band_count[voice::MEL_BANDS];
+    std::vector<float> _weights;
+    float _dct[voice::COEFFS][voice::MEL_BANDS];
+
+    float _history[voice::WINDOW];
+    int _fill   = 0;
+    float _last = 0;
+    float _re[voice::FFT_SIZE];
+    float _im[voice::FFT_SIZE];
+
+    void fft()
+    {
+        using voice::FFT_SIZE;
+        for (int i = 0; i < FFT_SIZE; i++) {
+            int j = _bitrev[i];
+            if (j > i) {
+                std::swap(_re[i], _re[j]);
+                std::swap(_im[i], _im[j]);
+            }
+        }
+        for (int len = 2; len <= FFT_SIZE; len <<= 1) {
+            int half   = len / 2;
+            int stride = FFT_SIZE / len;
+            for (int start = 0; start < FFT_SIZE; start += len) {
+                for (int k = 0; k < half; k++) {
+                    float wr = _cos[k * stride];
+                    float wi = _sin[k * stride];
+                    int a    = start + k;
+                    int b    = a + half;
+                    float tr = _re[b] * wr - _im[b] * wi;
+                    float ti = _re[b] * wi + _im[b] * wr;
+                    _re[b]   = _re[a] - tr;
+                    _im[b]   = _im[a] - ti;
+                    _re[a] += tr;
+                    _im[a] += ti;
+                }
+            }
+        }
+    }
+
+    void analyze(voice::Frame_t* frame, float* energyDb)
+    {
+        using namespace voice;
+        float energy = 0;
+        for (int i = 0; i < WINDOW; i++) {
+            float x = _history[i] * _window[i];
+            _re[i]  = x;
+            _im[i]  = 0;
+            energy += x * x;
+        }
+        std::fill(_re + WINDOW, _re + FFT_SIZE, 0.0f);
+        std::fill(_im + WINDOW, _im + FFT_SIZE, 0.0f);
+        *energyDb = 10.0f * log10f(energy / WINDOW + 1e-12f);
+
+        fft();
+        float logMel[MEL_BANDS];
+        for (int m = 0; m < MEL_BANDS; m++) {
+            const float* w = &_weights[_band_start[m]];
+            float sum      = 0;
+            for (int k = 0; k < _band_count[m]; k++) {
+                int bin = _band_first[m] + k;
+                sum += w[k] * (_re[bin] * _re[bin] + _im[bin] * _im[bin]);
+            }
+            logMel[m] = logf(sum + 1e-10f);
+        }
+        for (int k = 0; k < COEFFS; k++) {
+            float c = 0;
+            for (int m = 0; m < MEL_BANDS; m++) {
+                c += _dct[k][m] * logMel[m];
+            }
+            frame->c[k] = c;
+        }
+    }
+};
+
+/**
+ * @brief Cuts the frames into utterances: a rise well over the noise floor, until it's been back down a while
+ */
+class VoiceUtterance {
+public:
+    static constexpr float ONSET_DB   = 10.0f;  // Over the floor for ONSET_FRAMES in a row starts an utterance
+    static constexpr float RELEASE_DB = 6.0f;   // Under this over the floor for HANGOVER_FRAMES ends it
+    static constexpr float MIN_DBFS   = -70.0f;  // Quieter is never speech, whatever the floor
+    static constexpr int ONSET_FRAMES    = 3;
+    static constexpr int HANGOVER_FRAMES = 25;   // 250 ms, the pause between two words doesn't end it
+    static constexpr int PREROLL_FRAMES  = 8;    // Kept from before the onset, a soft first consonant is in them
+    static constexpr int MIN_FRAMES      = 25;   // Shorter is a knock or a click
+    static constexpr int MAX_FRAMES      = 200;  // Longer is talk or the music, not a command
+
+    void reset()
+    {
+        _frames.clear();
+        _preroll.clear();
+        _speaking = false;
+        _above    = 0;
+        _below    = 0;
+    }
+
+    /**
+     * @return true when an utterance just ended, frames() has it until the next push()
+     */
+    bool push(const voice::Frame_t& frame, float energyDb)
+    {
+        if (!_floor_set) {
+            _floor     = energyDb;
+            _floor_set = true;
+        }
+
+        if (!_speaking) {
+            // Falls quickly to a quieter moment, rises slowly to louder music
+            _floor += (energyDb - _floor) * (energyDb < _floor ? 0.2f : 0.01f);
+            _preroll.push_back(frame);
+            if (_preroll.size() > PREROLL_FRAMES) {
+                _preroll.erase(_preroll.begin());
+            }
+            _above = (energyDb > _floor + ONSET_DB && energyDb > MIN_DBFS) ? _above + 1 : 0;
+            if (_above >= ONSET_FRAMES) {
+                _speaking = true;
+                _below    = 0;
+                _frames   = _preroll;
+                _preroll.clear();
+            }
+            return false;
+        }
+
+        _frames.push_back(frame);
+        _below = (energyDb < _floor + RELEASE_DB) ? _below + 1 : 0;
+        if ((int)_frames.size() > MAX_FRAMES + HANGOVER_FRAMES) {
+            reset();
+            return false;
+        }
+        if (_below < HANGOVER_FRAMES) {
+            return false;
+        }
+
+        // The hangover's silence is most of what's at the end, a few frames of fade are left
+        _frames.resize(_frames.size() - std::min<size_t>(_frames.size(), HANGOVER_FRAMES - 3));
+        bool complete = (int)_frames.size() >= MIN_FRAMES && (int)_frames.size() <= MAX_FRAMES;
+        _speaking     = false;
+        _above        = 0;
+        if (complete) {
+            normalize();
+        }
+        return complete;
+    }
+
+    const std::vector<voice::Frame_t>& frames() const
+    {
+        return _frames;
+    }
+
+    float floorDb() const
+    {
+        return _floor;
+    }
+
+    bool speaking() const
+    {
+        return _speaking;
+    }
+
+private:
+    std::vector<voice::Frame_t> _frames;
+    std::vector<voice::Frame_t> _preroll;
+    float _floor    = 0;
+    bool _floor_set = false;
+    bool _speaking  = false;
+    int _above      = 0;
+    int _below      = 0;
+
+    // Cepstral mean taken out: the mic, the room and the distance mostly add a constant to each coefficient
+    void normalize()
+    {
+        float mean[voice::COEFFS] = {};
+        for (const voice::Frame_t& f : _frames) {
+            for (int k = 0; k < voice::COEFFS; k++) {
+                mean[k] += f.c[k];
+            }
+        }
+        for (int k = 0; k < voice::COEFFS; k++) {
+            mean[k] /= _frames.size();
+        }
+        for (voice::Frame_t& f : _frames) {
+            for (int k = 0; k < voice::COEFFS; k++) {
+                f.c[k] -= mean[k];
+            }
+        }
+    }
+};
+
+/**
+ * @brief The user's examples of each command, and which of them an utterance is nearest to
+ */
+class VoiceMatcher {
+public:
+    static constexpr int MAX_COMMANDS       = 8;
+    static constexpr int EXAMPLES           = 3;      // Per command, another one replaces the oldest
+    static constexpr float ACCEPT_DISTANCE = 3.5f;   // Per warped frame, the same word comes in around 2
+    static constexpr float MARGIN          = 0.85f;  // Of the nearest other command's distance, at most
+    static constexpr float QUANT_SCALE     = 8.0f;   // Coefficients are kept in int8 steps of 1/8
+
+    void addExample(int command, const std::vector<voice::Frame_t>& frames)
+    {
+        if (command < 0 || command >= MAX_COMMANDS || frames.empty()) {
+            return;
+        }
+        if (examples(command) >= EXAMPLES) {
+            for (auto it = _templates.begin(); it != _templates.end(); ++it) {
+                if (it->command == command) {
+                    _templates.erase(it);
+                    break;
+                }
+            }
+        }
+        // Stored as they'd come back from a load, so matching doesn't change across a reboot
+        Template_t t;
+        t.command = (uint8_t)command;
+        t.frames  = frames;
+        for (voice::Frame_t& f : t.frames) {
+            for (float& c : f.c) {
+                c = dequantize(quantize(c));
+            }
+        }
+        _templates.push_back(std::move(t));
+    }
+
+    int examples(int command) const
+    {
+        return (int)std::count_if(_templates.begin(), _templates.end(),
+                                  [command](const Template_t& t) { return t.command == command; });
+    }
+
+    void clear()
+    {
+        _templates.clear();
+    }
+
+    /**
+     * @param distance where to put the nearest example's distance, optional
+     * @return the command, -1 if the utterance isn't close enough to any or as close to two
+     */
+    int match(const std::vector<voice::Frame_t>& frames, float* distance = nullptr) const
+    {
+        float best[MAX_COMMANDS];
+        std::fill(best, best + MAX_COMMANDS, INFINITY);
+        for (const Template_t& t : _templates) {
+            best[t.command] = std::min(best[t.command], dtw(frames, t.frames));
+        }
+        int nearest  = -1;
+        float second = INFINITY;
+        for (int c = 0; c < MAX_COMMANDS; c++) {
+            if (nearest < 0 || best[c] < best[nearest]) {
+                if (nearest >= 0) {
+                    second = best[nearest];
+                }
+                nearest = c;
+            } else {
+                second = std::min(second, best[c]);
+            }
+        }
+        if (distance) {
+            *distance = best[nearest];
+        }
+        if (!std::isfinite(best[nearest]) || best[nearest] > ACCEPT_DISTANCE || best[nearest] > MARGIN * second) {
+            return -1;
+        }
+        return nearest;
+    }
+
+    /**
+     * @brief Every example as one blob to keep in a file
+     */
+    std::vector<uint8_t> serialize() const
+    {
+        std::vector<uint8_t> blob = {'V', 'C', 'M', 'D', FORMAT_VERSION, (uint8_t)_templates.size()};
+        for (const Template_t& t : _templates) {
+            uint16_t count = (uint16_t)t.frames.size();
+            blob.push_back(t.command);
+            blob.push_back(count & 0xff);
+            blob.push_back(count >> 8);
+            for (const voice::Frame_t& f : t.frames) {
+                for (float c : f.c) {
+                    blob.push_back((uint8_t)quantize(c));
+                }
+            }
+        }
+        return blob;
+    }
+
+    /**
+     * @return false if `blob` isn't one from serialize(), the examples are left as they were then
+     */
+    bool load(const std::vector<uint8_t>& blob)
+    {
+        if (blob.size() < HEADER_SIZE || memcmp(blob.data(), "VCMD", 4) != 0 || blob[4] != FORMAT_VERSION) {
+            return false;
+        }
+        std::vector<Template_t> templates(blob[5]);
+        size_t pos = HEADER_SIZE;
+        for (Template_t& t : templates) {
+            if (pos + 3 > blob.size()) {
+                return false;
+            }
+            t.command    = blob[pos];
+            size_t count = blob[pos + 1] | (blob[pos + 2] << 8);
+            pos += 3;
+            if (t.command >= MAX_COMMANDS || pos + count * voice::COEFFS > blob.size()) {
+                return false;
+            }
+            t.frames.resize(count);
+            for (voice::Frame_t& f : t.frames) {
+                for (float& c : f.c) {
+                    c = dequantize((int8_t)blob[pos++]);
+                }
+            }
+        }
+        _templates = std::move(templates);
+        return true;
+    }
+
+    /**
+     * @brief Mean frame distance along the best alignment of `a` and `b`, within a band around the diagonal
+     */
+    static float dtw(const std::vector<voice::Frame_t>& a, const std::vector<voice::Frame_t>& b)
+    {
+        int n = (int)a.size();
+        int m = (int)b.size();
+        if (n == 0 || m == 0 || std::max(n, m) > 2 * std::min(n, m)) {
+            return INFINITY;  // Twice as long isn't the same word said slower
+        }
+        int band = std::max(std::abs(n - m), std::max(n, m) / 4) + 1;
+        std::vector<float> prev(m + 1, INFINITY);
+        std::vector<float> cur(m + 1, INFINITY);
+        prev[0] = 0;
+        for (int i = 1; i <= n; i++) {
+            std::fill(cur.begin(), cur.end(), INFINITY);
+            int center = (int)((int64_t)i * m / n);
+            int from   = std::max(1, center - band);
+            int to     = std::min(m, center + band);
+            for (int j = from; j <= to; j++) {
+                float d = 0;
+                for (int k = 0; k < voice::COEFFS; k++) {
+                    float diff = a[i - 1].c[k] - b[j - 1].c[k];
+                    d += diff * diff;
+                }
+                cur[j] = sqrtf(d) + std::min(prev[j - 1], std::min(prev[j], cur[j - 1]));
+            }
+            std::swap(prev, cur);
+        }
+        return prev[m] / (n + m);
+    }
+
+private:
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr size_t HEADER_SIZE     = 6;
+
+    struct Template_t {
+        uint8_t command = 0;
+        std::vector<voice::Frame_t> frames;
+    };
+
+    std::vector<Template_t> _templates;  // Oldest first
+
+    static int8_t quantize(float c)
+    {
+        return (int8_t)std::min(127.0f, std::max(-127.0f, roundf(c * QUANT_SCALE)));
+    }
+
+    static float dequantize(int8_t q)
+    {
+        return q / QUANT_SCALE;
+    }
+};
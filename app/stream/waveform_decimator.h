@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @brief The last SPAN_MS of mono PCM as a min/max pair per pixel column, for an oscilloscope view
+ *
+ * Reads straight from the spectrum analyzer's mono history ring, at display rate, so the decoder pays nothing for it.
+ * The span starts on a rising zero crossing where there's one close enough, a steady tone then stands still instead
+ * of crawling across the view. 40 ms at 48 kHz into 900 columns is ~2 samples a column: a compare and a shift each,
+ * a few µs a frame.
+ *
+ *     WaveformDecimator::decimate(window, WINDOW - 1, written, 44100, 900, mins, maxs);
+ */
+class WaveformDecimator {
+public:
+    static constexpr int SPAN_MS      = 40;
+    static constexpr int SEARCH_MS    = 20;   // Back from the newest span, for the trigger
+    static constexpr int WRITE_MARGIN = 512;  // Samples of the ring left to the decoder writing ahead meanwhile
+
+    /**
+     * @param ring        Mono history, `mask + 1` samples, a power of two
+     * @param end         Samples written to it in total, the newest is at `(end - 1) & mask`
+     * @param min, max    `columns` each, full scale is -128..127
+     */
+    static void decimate(const int16_t* ring, uint32_t mask, uint32_t end, int sampleRate, int columns, int8_t* min,
+                         int8_t* max)
+    {
+        uint32_t room   = mask + 1 - WRITE_MARGIN;
+        uint32_t span   = std::min<uint32_t>(std::max(sampleRate, 8000) * SPAN_MS / 1000, room);
+        uint32_t search = std::min<uint32_t>(std::max(sampleRate, 8000) * SEARCH_MS / 1000, room - span);
+        search          = std::min(search, end > span ? end - span : 0);
+
+        // The newest rising crossing that still leaves a whole span after it
+        uint32_t begin = end - span;
+        for (uint32_t i = 0; i < search; i++) {
+            uint32_t at = end - span - i;
+            if (ring[(at - 1) & mask] < 0 && ring[at & mask] >= 0) {
+                begin = at;
+                break;
+            }
+        }
+
+        for (int c = 0; c < columns; c++) {
+            uint32_t from = begin + (uint64_t)c * span / columns;
+            uint32_t to   = std::max(from + 1, begin + (uint32_t)((uint64_t)(c + 1) * span / columns));
+            int16_t lo    = ring[from & mask];
+            int16_t hi    = lo;
+            for (uint32_t i = from + 1; i < to; i++) {
+                int16_t s = ring[i & mask];
+                lo        = std::min(lo, s);
+                hi        = std::max(hi, s);
+            }
+            min[c] = (int8_t)(lo >> 8);
+            max[c] = (int8_t)(hi >> 8);
+        }
+    }
+};
@@ -0,0 +1,431 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <hal/hal.h>
+#include <stream/icy_demuxer.h>
+#include <stream/mp3_frame.h>
+#include <stream/pcm_dsp.h>
+#include <stream/resampler.h>
+#include <stream/ring_buffer.h>
+#include <stream/spectrum_analyzer.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Host microbenchmarks of the stream pipeline's hot paths, the same app/stream code the Tab5 runs. Absolute numbers
+// are the host's, the point is comparing one commit with another:
+//
+//     ./radio_bench --json before.json
+//     ./radio_bench --filter ring/ --min-time-ms 1000
+//
+// The JSON has Google Benchmark's layout, so its tools/compare.py can diff two runs
+
+#ifndef RADIO_BENCH_REVISION
+#define RADIO_BENCH_REVISION "unknown"
+#endif
+
+#define DEFAULT_MIN_TIME_MS 200
+#define BENCH_RING_SIZE     (256 * 1024)
+#define SPSC_TRANSFER       (4 * 1024 * 1024)  // Per iteration of the two thread ring benchmarks
+#define ICY_STREAM_SIZE     (1024 * 1024)
+#define ICY_META_INT        16000  // SomaFM's
+#define ICY_CHUNK           1436   // One TCP segment
+#define MP3_STREAM_SIZE     (1024 * 1024)
+#define MP3_GARBAGE_SIZE    (64 * 1024)
+#define PCM_FRAMES          1152  // One MPEG-1 Layer III frame
+#define PCM_RATE            44100
+
+static const size_t s_chunk_sizes[] = {64, 512, 1436, 4096, 16384};
+
+// Results are folded in here so the compiler can't drop the work that produced them
+static volatile uint64_t s_sink = 0;
+
+// Fixed seed, every run sees the same bytes
+static uint32_t s_rand_state = 0x12345678;
+
+static uint32_t next_random()
+{
+    s_rand_state ^= s_rand_state << 13;
+    s_rand_state ^= s_rand_state >> 17;
+    s_rand_state ^= s_rand_state << 5;
+    return s_rand_state;
+}
+
+static void fill_random(uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)next_random();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Harness                                  */
+/* -------------------------------------------------------------------------- */
+struct BenchResult_t {
+    std::string name;
+    uint64_t iterations   = 0;
+    double realNs         = 0;  // Per iteration
+    double cpuNs          = 0;  // Of every thread in the process
+    double bytesPerSecond = 0;  // 0 where the benchmark doesn't move bytes
+};
+
+struct BenchOptions_t {
+    std::string filter;  // Substring of the names to run, empty: all
+    std::string jsonPath;
+    uint32_t minTimeMs = DEFAULT_MIN_TIME_MS;
+};
+
+static BenchOptions_t s_options;
+static std::vector<BenchResult_t> s_results;
+
+/**
+ * @brief Time `fn`, doubling the batch until one batch takes at least the minimum time
+ *
+ * @param bytes processed by one call of `fn`, for the throughput
+ */
+static void run_bench(const std::string& name, size_t bytes, const std::function<void()>& fn)
+{
+    if (!s_options.filter.empty() && name.find(s_options.filter) == std::string::npos) {
+        return;
+    }
+    fn();  // Warm the caches and the branch predictors
+
+    uint64_t batch = 1;
+    double realNs  = 0;
+    double cpuNs   = 0;
+    while (true) {
+        auto start      = std::chrono::steady_clock::now();
+        std::clock_t c0 = std::clock();
+        for (uint64_t i = 0; i < batch; i++) {
+            fn();
+        }
+        cpuNs  = (double)(std::clock() - c0) * 1e9 / CLOCKS_PER_SEC;
+        realNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (realNs >= s_options.minTimeMs * 1e6 || batch >= (1ull << 40)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    BenchResult_t result;
+    result.name           = name;
+    result.iterations     = batch;
+    result.realNs         = realNs / batch;
+    result.cpuNs          = cpuNs / batch;
+    result.bytesPerSecond = bytes ? bytes * 1e9 / result.realNs : 0;
+    s_results.push_back(result);
+
+    if (bytes) {
+        printf("%-32s %14.1f ns %12llu it %10.1f MB/s\n", name.c_str(), result.realNs,
+               (unsigned long long)result.iterations, result.bytesPerSecond / (1024 * 1024));
+    } else {
+        printf("%-32s %14.1f ns %12llu it\n", name.c_str(), result.realNs, (unsigned long long)result.iterations);
+    }
+}
+
+static bool write_json(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "radio_bench: can't write %s\n", path.c_str());
+        return false;
+    }
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date);
+    fprintf(file, "    \"executable\": \"radio_bench\",\n");
+    fprintf(file, "    \"revision\": \"%s\",\n", RADIO_BENCH_REVISION);
+    fprintf(file, "    \"num_cpus\": %u\n", std::thread::hardware_concurrency());
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < s_results.size(); i++) {
+        const BenchResult_t& r = s_results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", r.name.c_str());
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"iterations\": %llu,\n", (unsigned long long)r.iterations);
+        fprintf(file, "      \"real_time\": %.3f,\n", r.realNs);
+        fprintf(file, "      \"cpu_time\": %.3f,\n", r.cpuNs);
+        fprintf(file, "      \"time_unit\": \"ns\"");
+        if (r.bytesPerSecond > 0) {
+            fprintf(file, ",\n      \"bytes_per_second\": %.1f", r.bytesPerSecond);
+        }
+        fprintf(file, "\n    }%s\n", i + 1 < s_results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Ring Buffer                                */
+/* -------------------------------------------------------------------------- */
+static void bench_ring()
+{
+    RingBuffer ring;
+    if (!ring.init(BENCH_RING_SIZE)) {
+        fprintf(stderr, "radio_bench: ring allocation failed\n");
+        return;
+    }
+    std::vector<uint8_t> in(s_chunk_sizes[sizeof(s_chunk_sizes) / sizeof(s_chunk_sizes[0]) - 1]);
+    std::vector<uint8_t> out(in.size());
+    fill_random(in.data(), in.size());
+
+    // One thread, the copy cost alone: what the HTTP task's write and the decoder's read cost per chunk
+    for (size_t chunk : s_chunk_sizes) {
+        run_bench("ring/write_read/" + std::to_string(chunk), chunk, [&]() {
+            ring.write(in.data(), chunk);
+            s_sink += ring.read(out.data(), chunk);
+        });
+    }
+
+    // Producer and consumer on their own threads with the waits in between, as the HTTP task and decoder run
+    for (size_t chunk : s_chunk_sizes) {
+        run_bench("ring/spsc/" + std::to_string(chunk), SPSC_TRANSFER, [&]() {
+            ring.reset();
+            std::thread producer([&]() {
+                for (size_t sent = 0; sent < SPSC_TRANSFER; sent += chunk) {
+                    while (!ring.waitForSpace(chunk, 100)) {
+                    }
+                    ring.write(in.data(), chunk);
+                }
+            });
+            std::vector<uint8_t> dst(chunk);
+            for (size_t received = 0; received < SPSC_TRANSFER;) {
+                ring.waitForData(1, 100);
+                received += ring.read(dst.data(), chunk);
+            }
+            producer.join();
+            s_sink += dst[0];
+        });
+    }
+    ring.deinit();
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                ICY Demuxer                                 */
+/* -------------------------------------------------------------------------- */
+// ICY_STREAM_SIZE bytes of audio and metadata blocks interleaved as a SomaFM server sends them
+static std::vector<uint8_t> make_icy_stream()
+{
+    std::vector<uint8_t> stream;
+    stream.reserve(ICY_STREAM_SIZE + ICY_STREAM_SIZE / ICY_META_INT * 256);
+    for (int block = 0; stream.size() < ICY_STREAM_SIZE; block++) {
+        size_t audio = stream.size();
+        stream.resize(audio + ICY_META_INT);
+        fill_random(stream.data() + audio, ICY_META_INT);
+
+        // Most blocks are empty, servers only repeat the title every few
+        if (block % 4 != 0) {
+            stream.push_back(0);
+            continue;
+        }
+        char meta[256];
+        int len        = snprintf(meta, sizeof(meta), "StreamTitle='Artist %d - Track %d';StreamUrl='';", block, block);
+        int blocks     = (len + 15) / 16;
+        size_t padding = blocks * 16 - len;
+        stream.push_back((uint8_t)blocks);
+        stream.insert(stream.end(), meta, meta + len);
+        stream.insert(stream.end(), padding, 0);
+    }
+    return stream;
+}
+
+static void bench_icy()
+{
+    std::vector<uint8_t> stream = make_icy_stream();
+    IcyDemuxer icy;
+    run_bench("icy/demux/1MB", stream.size(), [&]() {
+        icy.reset(ICY_META_INT);
+        for (size_t pos = 0; pos < stream.size(); pos += ICY_CHUNK) {
+            size_t len = std::min((size_t)ICY_CHUNK, stream.size() - pos);
+            icy.feed(stream.data() + pos, len, [](const uint8_t* audio, size_t n) { s_sink += n; },
+                     [](const char* meta, size_t n) {
+                         const char* title = nullptr;
+                         size_t titleLen   = 0;
+                         if (IcyDemuxer::streamTitle(meta, &title, &titleLen)) {
+                             s_sink += titleLen;
+                         }
+                     });
+        }
+    });
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 MP3 Sync                                   */
+/* -------------------------------------------------------------------------- */
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz, joint stereo: SomaFM's usual stream
+static const uint8_t s_mp3_header[mp3_frame::HEADER_SIZE] = {0xFF, 0xFB, 0x90, 0x64};
+
+static std::vector<uint8_t> make_mp3_stream()
+{
+    mp3_frame::FrameInfo_t info;
+    if (!mp3_frame::parse_header(s_mp3_header, &info)) {
+        return {};
+    }
+    std::vector<uint8_t> stream(MP3_STREAM_SIZE);
+    fill_random(stream.data(), stream.size());
+    for (size_t pos = 0; pos + info.frameSize <= stream.size(); pos += info.frameSize) {
+        memcpy(stream.data() + pos, s_mp3_header, sizeof(s_mp3_header));
+    }
+    return stream;
+}
+
+static void bench_mp3_sync()
+{
+    std::vector<uint8_t> stream = make_mp3_stream();
+    if (stream.empty()) {
+        fprintf(stderr, "radio_bench: bad MP3 header\n");
+        return;
+    }
+
+    // Frame by frame through a clean stream, as the decoder walks it
+    run_bench("mp3_sync/frames/1MB", stream.size(), [&]() {
+        mp3_frame::FrameInfo_t info;
+        for (size_t pos = 0; pos < stream.size();) {
+            int offset = mp3_frame::find_frame(stream.data() + pos, stream.size() - pos, &info);
+            if (offset < 0) {
+                break;
+            }
+            pos += offset + info.frameSize;
+            s_sink += info.frameSize;
+        }
+    });
+
+    // Random bytes, the worst case: every false sync has to be ruled out, like joining mid-frame after a dropout
+    std::vector<uint8_t> garbage(MP3_GARBAGE_SIZE);
+    fill_random(garbage.data(), garbage.size());
+    run_bench("mp3_sync/garbage/64KB", garbage.size(), [&]() {
+        mp3_frame::FrameInfo_t info;
+        for (size_t pos = 0; pos < garbage.size();) {
+            int offset = mp3_frame::find_frame(garbage.data() + pos, garbage.size() - pos, &info);
+            if (offset < 0) {
+                break;
+            }
+            pos += offset + 1;
+            s_sink += offset;
+        }
+    });
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Spectrum and DSP                              */
+/* -------------------------------------------------------------------------- */
+static void fill_tone(int16_t* pcm, int frames, int channels)
+{
+    for (int i = 0; i < frames; i++) {
+        float t     = (float)i / PCM_RATE;
+        float value = 0.4f * sinf(2.0f * (float)M_PI * 440.0f * t) + 0.2f * sinf(2.0f * (float)M_PI * 3000.0f * t);
+        for (int ch = 0; ch < channels; ch++) {
+            pcm[i * channels + ch] = (int16_t)(value * 32767.0f) + (int16_t)(next_random() % 64) - 32;
+        }
+    }
+}
+
+static void bench_spectrum()
+{
+    SpectrumAnalyzer analyzer;
+    if (!analyzer.init()) {
+        fprintf(stderr, "radio_bench: FFT init failed\n");
+        return;
+    }
+    std::vector<int16_t> samples(SpectrumAnalyzer::FFT_SIZE);
+    fill_tone(samples.data(), SpectrumAnalyzer::FFT_SIZE, 1);
+    uint8_t levels[SpectrumAnalyzer::MAX_BANDS];
+    for (int bands : {32, 128}) {
+        run_bench("spectrum/fft1024/" + std::to_string(bands) + "bands", 0, [&]() {
+            analyzer.process(samples.data(), PCM_RATE, levels, bands);
+            s_sink += levels[0];
+        });
+    }
+}
+
+static void bench_pcm_dsp()
+{
+    std::vector<int16_t> source(PCM_FRAMES * 2);
+    std::vector<int16_t> pcm(PCM_FRAMES * 2);
+    fill_tone(source.data(), PCM_FRAMES, 2);
+    size_t bytes = pcm.size() * sizeof(int16_t);
+
+    // PcmDsp holds its loudness history, too big for the stack
+    std::unique_ptr<PcmDsp> dsp(new PcmDsp());
+    dsp->configure(PCM_RATE, 2);
+    dsp->setVolume(0.7f);
+    run_bench("pcm_dsp/volume/1152", bytes, [&]() {
+        memcpy(pcm.data(), source.data(), bytes);
+        dsp->process(pcm.data(), pcm.size());
+        s_sink += pcm[0];
+    });
+
+    const float eq[PcmDsp::EQ_BANDS] = {6.0f, -3.0f, 4.0f};
+    dsp->setEq(eq);
+    dsp->setNormalize(true);
+    run_bench("pcm_dsp/eq_normalize/1152", bytes, [&]() {
+        memcpy(pcm.data(), source.data(), bytes);
+        dsp->process(pcm.data(), pcm.size());
+        s_sink += pcm[0];
+    });
+
+    std::unique_ptr<Resampler> resampler(new Resampler());
+    if (!resampler->configure(PCM_RATE, AudioMixer::SAMPLE_RATE, 2)) {
+        fprintf(stderr, "radio_bench: resampler configure failed\n");
+        return;
+    }
+    std::vector<int16_t> out(resampler->maxOutput(PCM_FRAMES) * 2);
+    run_bench("resampler/44k1_48k/1152", bytes, [&]() {
+        s_sink += resampler->process(source.data(), PCM_FRAMES, out.data(), out.size() / 2);
+    });
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Main                                    */
+/* -------------------------------------------------------------------------- */
+static bool parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue   = i + 1 < argc;
+        if (arg == "--json" && hasValue) {
+            s_options.jsonPath = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            s_options.filter = argv[++i];
+        } else if (arg == "--min-time-ms" && hasValue) {
+            s_options.minTimeMs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--json <file>] [--filter <substring>] [--min-time-ms <ms>]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (!parse_args(argc, argv)) {
+        return 1;
+    }
+    // The base HAL's buffers come from the system heap, as on the desktop
+    hal::Inject(std::make_unique<hal::HalBase>());
+
+    printf("radio_bench %s\n", RADIO_BENCH_REVISION);
+    bench_ring();
+    bench_icy();
+    bench_mp3_sync();
+    bench_spectrum();
+    bench_pcm_dsp();
+
+    if (!s_options.jsonPath.empty() && !write_json(s_options.jsonPath)) {
+        return 1;
+    }
+    return 0;
+}
@@ -8,15 +8,27 @@
 #include <cmath>
 #include <mooncake_log.h>
 #include <SDL2/SDL.h>
+#include <chrono>
+#include <mutex>
 #include <thread>
 #include <iostream>
 
 static const std::string _tag = "audio";
 
+#define VOLUME_RANGE_DB 49.5f  // Volume 1 to 100, the curve the Tab5's codec driver uses
+
+float speaker_gain(int volume)
+{
+    if (volume <= 0) {
+        return 0.0f;
+    }
+    return powf(10.0f, -VOLUME_RANGE_DB * (100 - std::min(volume, 100)) / 100.0f / 20.0f);
+}
+
 void HalDesktop::setSpeakerVolume(uint8_t volume)
 {
     _current_speaker_volume = std::clamp((int)volume, 0, 100);
-    mclog::tagInfo(_tag, "set speaker volume: {}%", _current_speaker_volume);
+    mclog::tagInfo(_tag, "set speaker volume: {}%", (int)_current_speaker_volume);
 }
 
 uint8_t HalDesktop::getSpeakerVolume()
@@ -24,63 +36,70 @@ uint8_t HalDesktop::getSpeakerVolume()
     return _current_speaker_volume;
 }
 
-void HalDesktop::audioPlay(std::vector<int16_t>& data, bool async)
+// UI sounds are voices of the HAL mixer, SDL pulls the mix from its audio thread. The radio's PCM arrives at volume,
+// PcmDsp ramps it in the decoder like on the Tab5, so only the sounds are scaled here, on the same curve
+static constexpr int MIXER_VOICE_FRAMES = 24000;  // 0.5 s per sound
+
+static void sdl_audio_callback(void* userdata, Uint8* stream, int len)
 {
-    static std::once_flag initFlag;
-    static SDL_AudioDeviceID deviceId = 0;
-    static std::mutex audioMutex;
+    auto hal   = static_cast<HalDesktop*>(userdata);
+    int frames = len / (2 * sizeof(int16_t));
+    SDL_memset(stream, 0, len);
+    radio_mix((int16_t*)stream, frames);
+    hal->audioMixer.mix((int16_t*)stream, frames, speaker_gain(hal->getSpeakerVolume()));
+}
 
-    // 音频初始化 & 打开设备（只执行一次）
-    std::call_once(initFlag, []() {
-        if (!(SDL_WasInit(SDL_INIT_AUDIO) & SDL_INIT_AUDIO)) {
-            if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
-                std::cerr << "Failed to init SDL audio: " << SDL_GetError() << std::endl;
-                return;
-            }
-        }
+static SDL_AudioDeviceID _audio_device = 0;
+
+uint32_t audio_device()
+{
+    return _audio_device;
+}
+
+void HalDesktop::audio_init()
+{
+    static std::vector<int16_t> pool(AudioMixer::MAX_VOICES * MIXER_VOICE_FRAMES * 2);
+    audioMixer.init(pool.data(), MIXER_VOICE_FRAMES);
 
-        SDL_AudioSpec want, have;
-        SDL_memset(&want, 0, sizeof(want));
-        want.freq     = 48000;
-        want.format   = AUDIO_S16SYS;
-        want.channels = 2;
-        want.samples  = 4096;
-        want.callback = nullptr;
-
-        deviceId = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
-        if (deviceId == 0) {
-            std::cerr << "SDL_OpenAudioDevice failed: " << SDL_GetError() << std::endl;
-        } else {
-            SDL_PauseAudioDevice(deviceId, 0);  // 开启播放
+    if (!(SDL_WasInit(SDL_INIT_AUDIO) & SDL_INIT_AUDIO)) {
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+            std::cerr << "Failed to init SDL audio: " << SDL_GetError() << std::endl;
+            return;
         }
-    });
+    }
+
+    SDL_AudioSpec want, have;
+    SDL_memset(&want, 0, sizeof(want));
+    want.freq     = AudioMixer::SAMPLE_RATE;
+    want.format   = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples  = 1024;
+    want.callback = sdl_audio_callback;
+    want.userdata = this;
+
+    _audio_device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (_audio_device == 0) {
+        std::cerr << "SDL_OpenAudioDevice failed: " << SDL_GetError() << std::endl;
+    } else {
+        SDL_PauseAudioDevice(_audio_device, 0);  // 开启播放
+    }
+}
 
+void HalDesktop::audioPlay(std::vector<int16_t>& data, bool async)
+{
     // 若设备打开失败，直接返回
-    if (deviceId == 0) return;
-
-    // 异步线程提交音频数据
-    auto volume = getSpeakerVolume();
-    std::thread([data, volume]() {
-        std::vector<int16_t> adjustedData = data;
-
-        // 音量缩放
-        float scale = volume / 100.0f;
-        for (size_t i = 0; i < adjustedData.size(); ++i) {
-            int sample = static_cast<int>(adjustedData[i] * scale);
-            if (sample > INT16_MAX) sample = INT16_MAX;
-            if (sample < INT16_MIN) sample = INT16_MIN;
-            adjustedData[i] = static_cast<int16_t>(sample);
-        }
+    if (_audio_device == 0) return;
 
-        // 加锁提交数据（线程安全）
-        {
-            std::lock_guard<std::mutex> lock(audioMutex);
-            int byteSize = adjustedData.size() * sizeof(int16_t);
-            if (SDL_QueueAudio(deviceId, adjustedData.data(), byteSize) < 0) {
-                std::cerr << "SDL_QueueAudio failed: " << SDL_GetError() << std::endl;
-            }
+    int voice = audioMixer.play(data.data(), data.size() / 2);
+    if (voice < 0) {
+        mclog::tagWarn(_tag, "no free voice");
+        return;
+    }
+    if (!async) {
+        while (audioMixer.playing(voice)) {
+            SDL_Delay(10);
         }
-    }).detach();
+    }
 }
 
 void HalDesktop::audioRecord(std::vector<int16_t>& data, uint16_t durationMs, float gain)
@@ -103,6 +122,90 @@ void HalDesktop::audioRecord(std::vector<int16_t>& data, uint16_t durationMs, fl
     }
 }
 
+// The same 500 Hz tone on every channel, paced by the clock like the Tab5's capture
+#define MIC_READERS     4
+#define MIC_KEEP_FRAMES 85  // What a reader can fall behind by, about 340 ms
+#define MIC_TONE_HZ     500.0
+
+static struct {
+    std::mutex mutex;
+    bool open[MIC_READERS]     = {};
+    uint64_t next[MIC_READERS] = {};  // Frame the reader gets next
+} s_mic;
+
+static uint64_t mic_ms_now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t mic_frames_now()
+{
+    return mic_ms_now() * hal::HalBase::MIC_SAMPLE_RATE / 1000 / hal::HalBase::MIC_FRAME_SAMPLES;
+}
+
+int HalDesktop::openMicCapture()
+{
+    std::lock_guard<std::mutex> lock(s_mic.mutex);
+    for (int i = 0; i < MIC_READERS; i++) {
+        if (!s_mic.open[i]) {
+            s_mic.open[i] = true;
+            s_mic.next[i] = mic_frames_now();
+            return i;
+        }
+    }
+    return -1;
+}
+
+void HalDesktop::closeMicCapture(int reader)
+{
+    std::lock_guard<std::mutex> lock(s_mic.mutex);
+    if (reader >= 0 && reader < MIC_READERS) {
+        s_mic.open[reader] = false;
+    }
+}
+
+int HalDesktop::readMicCapture(int reader, int16_t* data, int maxFrames, uint32_t timeoutMs, int* dropped)
+{
+    if (reader < 0 || reader >= MIC_READERS || maxFrames <= 0) {
+        return 0;
+    }
+    uint64_t next;
+    {
+        std::lock_guard<std::mutex> lock(s_mic.mutex);
+        next = s_mic.next[reader];
+    }
+    uint64_t deadline = mic_ms_now() + timeoutMs;
+    while (mic_frames_now() <= next && mic_ms_now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint64_t now = mic_frames_now();
+    if (now - next > MIC_KEEP_FRAMES) {
+        if (dropped) {
+            *dropped += now - next - MIC_KEEP_FRAMES;
+        }
+        next = now - MIC_KEEP_FRAMES;
+    }
+    int frames = (int)std::min<uint64_t>(now - next, maxFrames);
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < MIC_FRAME_SAMPLES; i++) {
+            uint64_t n     = (next + f) * MIC_FRAME_SAMPLES + i;
+            double t       = (double)(n % MIC_SAMPLE_RATE) / MIC_SAMPLE_RATE;
+            int16_t sample = (int16_t)(std::sin(2.0 * M_PI * MIC_TONE_HZ * t) * 32767);
+            for (int ch = 0; ch < MIC_CHANNELS; ch++) {
+                *data++ = sample;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(s_mic.mutex);
+    s_mic.next[reader] = next + frames;
+    return frames;
+}
+
+void HalDesktop::setMicGain(float gain)
+{
+}
+
 struct DualMicRecordTestData_t {
     std::mutex mutex;
     hal::HalBase::MicTestState_t state = hal::HalBase::MIC_TEST_IDLE;
@@ -8,24 +8,257 @@
 #include "hal/hal.h"
 #include <mooncake_log.h>
 #include <lvgl.h>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
 #include <assets/assets.h>
 // https://github.com/lvgl/lv_port_pc_vscode/blob/master/main/src/main.c
 
 static const std::string _tag = "lvgl";
 static std::mutex _lvgl_mutex;
 
+/* -------------------------------------------------------------------------- */
+/*                                  Headless                                  */
+/* -------------------------------------------------------------------------- */
+// No window and no SDL events: LVGL renders into a frame in memory, time only moves in headless_advance() and a
+// scripted pointer stands in for the mouse, so a run renders the same frames every time
+static struct {
+    bool enabled = false;
+    std::atomic<uint32_t> nowMs{1};  // 0 reads as "never" in places
+    std::vector<uint8_t> frame;
+    lv_display_t* display = nullptr;
+    int32_t x             = 0;
+    int32_t y             = 0;
+    bool pressed          = false;
+    uint32_t key          = 0;
+    bool keyPressed       = false;
+
+    input_recording::Replayer* replayer = nullptr;
+    uint32_t replayStartMs              = 0;
+} s_headless;
+
+void headless_enable()
+{
+    s_headless.enabled = true;
+}
+
+bool headless_enabled()
+{
+    return s_headless.enabled;
+}
+
+uint32_t headless_millis()
+{
+    return s_headless.nowMs.load();
+}
+
+void headless_advance(uint32_t ms)
+{
+    s_headless.nowMs += ms;
+}
+
+void headless_pointer(int x, int y, bool pressed)
+{
+    s_headless.x       = x;
+    s_headless.y       = y;
+    s_headless.pressed = pressed;
+}
+
+void headless_replay(input_recording::Replayer* replayer)
+{
+    s_headless.replayer      = replayer;
+    s_headless.replayStartMs = s_headless.nowMs.load();
+}
+
+bool headless_screenshot(const std::string& path)
+{
+    if (!s_headless.display) {
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    int32_t width        = lv_display_get_horizontal_resolution(s_headless.display);
+    int32_t height       = lv_display_get_vertical_resolution(s_headless.display);
+    lv_color_format_t cf = lv_display_get_color_format(s_headless.display);
+    uint32_t stride      = lv_draw_buf_width_to_stride(width, cf);
+    fprintf(file, "P6\n%d %d\n255\n", (int)width, (int)height);
+    std::vector<uint8_t> row(width * 3);
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t* src = s_headless.frame.data() + y * stride;
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t* rgb = &row[x * 3];
+            if (cf == LV_COLOR_FORMAT_RGB565) {
+                uint16_t px = src[x * 2] | (src[x * 2 + 1] << 8);
+                rgb[0]      = (px >> 11) * 255 / 31;
+                rgb[1]      = ((px >> 5) & 0x3F) * 255 / 63;
+                rgb[2]      = (px & 0x1F) * 255 / 31;
+            } else {
+                // XRGB8888 and the like, stored B G R X
+                const uint8_t* bgr = src + x * lv_color_format_get_size(cf);
+                rgb[0]             = bgr[2];
+                rgb[1]             = bgr[1];
+                rgb[2]             = bgr[0];
+            }
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    fclose(file);
+    return true;
+}
+
+static void headless_flush(lv_display_t* disp, const lv_area_t* area, uint8_t* pixels)
+{
+    // Direct mode renders straight into the frame, there's nothing to copy
+    lv_display_flush_ready(disp);
+}
+
+static void headless_read(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    // Recorded on the mouse or the touch, both are this pointer
+    if (s_headless.replayer) {
+        uint32_t elapsed = s_headless.nowMs.load() - s_headless.replayStartMs;
+        input_recording::Record_t record;
+        if (s_headless.replayer->next(input_recording::POINTERS, elapsed, &record)) {
+            s_headless.x       = record.x;
+            s_headless.y       = record.y;
+            s_headless.pressed = record.pressed;
+        }
+        data->continue_reading = s_headless.replayer->pending(input_recording::POINTERS, elapsed);
+    }
+    data->point.x = s_headless.x;
+    data->point.y = s_headless.y;
+    data->state   = s_headless.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static void headless_keypad_read(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    if (s_headless.replayer) {
+        uint32_t elapsed = s_headless.nowMs.load() - s_headless.replayStartMs;
+        input_recording::Record_t record;
+        if (s_headless.replayer->next(input_recording::KEYS, elapsed, &record)) {
+            s_headless.key        = record.key;
+            s_headless.keyPressed = record.pressed;
+        }
+        data->continue_reading = s_headless.replayer->pending(input_recording::KEYS, elapsed);
+    }
+    data->key   = s_headless.key;
+    data->state = s_headless.keyPressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static lv_display_t* headless_display_create(lv_indev_t** pointer)
+{
+    lv_tick_set_cb(headless_millis);
+
+    lv_display_t* display = lv_display_create(HAL_SCREEN_WIDTH, HAL_SCREEN_HEIGHT);
+    uint32_t stride       = lv_draw_buf_width_to_stride(HAL_SCREEN_WIDTH, lv_display_get_color_format(display));
+    s_headless.frame.assign(stride * HAL_SCREEN_HEIGHT, 0);
+    // Like lv_sdl_window_create() with LV_SDL_RENDER_MODE, so both render the same areas
+    lv_display_set_buffers(display, s_headless.frame.data(), nullptr, s_headless.frame.size(),
+                           LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(display, headless_flush);
+    s_headless.display = display;
+
+    *pointer = lv_indev_create();
+    lv_indev_set_type(*pointer, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(*pointer, headless_read);
+    lv_indev_set_display(*pointer, display);
+
+    lv_indev_t* keypad = lv_indev_create();
+    lv_indev_set_type(keypad, LV_INDEV_TYPE_KEYPAD);
+    lv_indev_set_read_cb(keypad, headless_keypad_read);
+    lv_indev_set_display(keypad, display);
+    lv_indev_set_group(keypad, lv_group_get_default());
+    return display;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Input recording                              */
+/* -------------------------------------------------------------------------- */
+// The SDL drivers' own read callbacks, wrapped. Recorded under the LVGL lock like every other read
+static struct {
+    std::string path;
+    input_recording::Recorder recorder;
+    lv_indev_read_cb_t mouseRead    = nullptr;
+    lv_indev_read_cb_t keyboardRead = nullptr;
+} s_record;
+
+void input_record(const std::string& path)
+{
+    s_record.path = path;
+}
+
+static void record_mouse_read(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    s_record.mouseRead(indev, data);
+    s_record.recorder.read(input_recording::MOUSE, lv_tick_get(), data->state == LV_INDEV_STATE_PRESSED,
+                           data->point.x, data->point.y, 0);
+}
+
+static void record_keyboard_read(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    s_record.keyboardRead(indev, data);
+    s_record.recorder.read(input_recording::KEYPAD, lv_tick_get(), data->state == LV_INDEV_STATE_PRESSED, 0, 0,
+                           data->key);
+}
+
+static void record_save()
+{
+    // Closing the window exits from the LVGL thread, which holds the lock, the app loop's exit waits for it
+    std::unique_lock<std::mutex> lock(_lvgl_mutex, std::defer_lock);
+    for (int i = 0; i < 50 && !lock.try_lock(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    s_record.recorder.stop();
+    if (s_record.recorder.save(s_record.path.c_str())) {
+        mclog::tagInfo(_tag, "{} input records saved to {}", s_record.recorder.size(), s_record.path);
+    } else {
+        mclog::tagError(_tag, "can't write {}", s_record.path);
+    }
+}
+
+static void record_start(lv_indev_t* mouse, lv_indev_t* keyboard)
+{
+    if (s_record.path.empty()) {
+        return;
+    }
+    s_record.mouseRead    = lv_indev_get_read_cb(mouse);
+    s_record.keyboardRead = lv_indev_get_read_cb(keyboard);
+    lv_indev_set_read_cb(mouse, record_mouse_read);
+    lv_indev_set_read_cb(keyboard, record_keyboard_read);
+    s_record.recorder.start(lv_tick_get());
+    atexit(record_save);
+    mclog::tagInfo(_tag, "recording input to {}", s_record.path);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Init                                    */
+/* -------------------------------------------------------------------------- */
 void HalDesktop::lvgl_init()
 {
-    mclog::tagInfo(_tag, "lvgl init");
+    mclog::tagInfo(_tag, "lvgl init{}", s_headless.enabled ? " (headless)" : "");
 
     lv_init();
 
     lv_group_set_default(lv_group_create());
 
+    // Headless runs drive lv_timer_handler() themselves, in step with their clock
+    if (s_headless.enabled) {
+        auto display = headless_display_create(&lvTouchpad);
+        lv_display_set_default(display);
+        lv_indev_set_group(lvTouchpad, lv_group_get_default());
+        perf_attach_display(display);
+        return;
+    }
+
     auto display = lv_sdl_window_create(HAL_SCREEN_WIDTH, HAL_SCREEN_HEIGHT);
     lv_display_set_default(display);
+    perf_attach_display(display);
 
     lvTouchpad = lv_sdl_mouse_create();
     lv_indev_set_group(lvTouchpad, lv_group_get_default());
@@ -44,6 +277,7 @@ void HalDesktop::lvgl_init()
     auto keyboard = lv_sdl_keyboard_create();
     lv_indev_set_display(keyboard, display);
     lv_indev_set_group(keyboard, lv_group_get_default());
+    record_start(lvTouchpad, keyboard);
 
 #if not defined(__APPLE__) && not defined(__MACH__)
     std::thread([]() {
@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "../hal_desktop.h"
+#include <chrono>
+
+// Sampled at most once a second like on the Tab5, the HUD can ask every frame
+#define PERF_SAMPLE_MS 1000
+
+static int64_t now_us()
+{
+    auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+// Written in display events, under the LVGL lock like everything else LVGL does
+static struct {
+    void (*onFrame)(const PerfFrame_t&) = nullptr;
+    int64_t refrStartUs                 = 0;
+    int64_t flushStartUs                = 0;
+    PerfFrame_t frame;  // In progress
+    bool rendered       = false;
+    uint32_t frames     = 0;  // Since the last sample
+    int64_t renderUsSum = 0;
+    int64_t flushUsSum  = 0;
+    uint64_t areasSum   = 0;
+    uint64_t pixelsSum  = 0;
+    uint32_t screen     = 1;  // Pixels
+} s_lvgl;
+
+static void on_display_event(lv_event_t* e)
+{
+    int64_t now = now_us();
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_INVALIDATE_AREA:
+            // Clipped to the screen, an area inside one already invalidated still counts
+            s_lvgl.frame.areas++;
+            s_lvgl.frame.pixels += lv_area_get_size((const lv_area_t*)lv_event_get_param(e));
+            break;
+        case LV_EVENT_REFR_START:
+            s_lvgl.refrStartUs   = now;
+            s_lvgl.frame.flushUs = 0;
+            s_lvgl.rendered      = false;
+            break;
+        case LV_EVENT_RENDER_START:
+            s_lvgl.rendered = true;
+            break;
+        case LV_EVENT_FLUSH_START:
+            s_lvgl.flushStartUs = now;
+            break;
+        case LV_EVENT_FLUSH_FINISH:
+            s_lvgl.frame.flushUs += now - s_lvgl.flushStartUs;
+            break;
+        case LV_EVENT_REFR_READY:
+            // A refresh with nothing invalidated isn't a frame
+            if (s_lvgl.rendered) {
+                s_lvgl.frame.renderUs = now - s_lvgl.refrStartUs - s_lvgl.frame.flushUs;
+                s_lvgl.frames++;
+                s_lvgl.renderUsSum += s_lvgl.frame.renderUs;
+                s_lvgl.flushUsSum += s_lvgl.frame.flushUs;
+                s_lvgl.areasSum += s_lvgl.frame.areas;
+                s_lvgl.pixelsSum += s_lvgl.frame.pixels;
+                if (s_lvgl.onFrame) {
+                    s_lvgl.onFrame(s_lvgl.frame);
+                }
+            }
+            s_lvgl.frame = PerfFrame_t();
+            break;
+        default:
+            break;
+    }
+}
+
+void perf_attach_display(lv_display_t* disp)
+{
+    s_lvgl.screen = lv_display_get_horizontal_resolution(disp) * lv_display_get_vertical_resolution(disp);
+    lv_display_add_event_cb(disp, on_display_event, LV_EVENT_ALL, nullptr);
+}
+
+void perf_on_frame(void (*onFrame)(const PerfFrame_t&))
+{
+    s_lvgl.onFrame = onFrame;
+}
+
+bool HalDesktop::getPerfStats(PerfStats_t* stats)
+{
+    static PerfStats_t s_stats;
+    uint32_t now = millis();
+    if (s_stats.sampledAtMs == 0 || now - s_stats.sampledAtMs >= PERF_SAMPLE_MS) {
+        float seconds = s_stats.sampledAtMs == 0 ? 0 : (now - s_stats.sampledAtMs) / 1000.0f;
+
+        lvglLock();
+        uint32_t frames    = s_lvgl.frames;
+        int64_t renderUs   = s_lvgl.renderUsSum;
+        int64_t flushUs    = s_lvgl.flushUsSum;
+        uint64_t areas     = s_lvgl.areasSum;
+        uint64_t pixels    = s_lvgl.pixelsSum;
+        s_lvgl.frames      = 0;
+        s_lvgl.renderUsSum = 0;
+        s_lvgl.flushUsSum  = 0;
+        s_lvgl.areasSum    = 0;
+        s_lvgl.pixelsSum   = 0;
+        lvglUnlock();
+
+        s_stats.fps           = seconds > 0 ? frames / seconds : 0;
+        s_stats.renderMs      = frames ? renderUs / 1000.0f / frames : 0;
+        s_stats.flushMs       = frames ? flushUs / 1000.0f / frames : 0;
+        s_stats.redrawAreas   = frames ? (float)areas / frames : 0;
+        s_stats.redrawPercent = frames ? 100.0f * pixels / frames / s_lvgl.screen : 0;
+        s_stats.bufferPercent = getRadioState() == RADIO_STOPPED ? -1 : getRadioMetadata().bufferPercent;
+        s_stats.underruns     = getRadioOutputStats().underruns;
+        s_stats.sampledAtMs   = now ? now : 1;
+    }
+
+    *stats = s_stats;
+    return true;
+}
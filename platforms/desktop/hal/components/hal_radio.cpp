@@ -0,0 +1,968 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "../hal_desktop.h"
+#include <hal/byte_ring.h>
+#include <hal/hot_log.h>
+#include <hal/snapshot.h>
+#include <stream/icy_demuxer.h>
+#include <stream/mp3_frame.h>
+#include <stream/pcm_dsp.h>
+#include <stream/resampler.h>
+#include <stream/spectrum_analyzer.h>
+#include <stream/onset_detector.h>
+#include <stream/triple_buffer.h>
+#include <stream/waveform_decimator.h>
+#define MINIMP3_IMPLEMENTATION
+#include <minimp3.h>
+#include <mooncake_log.h>
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// The Tab5's pipeline with the device taken out: a POSIX socket instead of esp_http_client, minimp3 instead of
+// libhelix and SDL instead of I2S. The ICY demuxer, frame scanner, DSP, resampler and spectrum analyzer are
+// app/stream's, shared with the Tab5, so what a profiler finds here is what the device runs
+static const std::string _tag = "radio";
+
+/* -------------------------------------------------------------------------- */
+/*                           Radio Stream State                               */
+/* -------------------------------------------------------------------------- */
+#define RING_BUFFER_SIZE   (512 * 1024)  // ~30 s at 128 kbps, a power of two for ByteRing
+#define MIN_BUFFER_LEVEL   (32 * 1024)   // Before (re)starting playback, ~2 s at 128 kbps
+#define MAX_STALL_SECONDS  30            // Give up on a live stream after 30s without data
+#define HTTP_READ_CHUNK    4096
+#define HTTP_HEADER_MAX    (8 * 1024)
+#define HTTP_TIMEOUT_MS    1000  // Per socket read, so a stop is noticed
+#define CONNECT_TIMEOUT_MS 5000  // What a stop can wait for a connect under way
+#define MAX_REDIRECTS      5
+#define RECONNECT_MIN_MS   250
+#define RECONNECT_MAX_MS   8000
+
+using RadioState_t = hal::HalBase::RadioState_t;
+
+struct RadioStreamState {
+    std::mutex control;  // Serializes start and stop, the stream's threads never take it
+    std::atomic<RadioState_t> state{hal::HalBase::RADIO_STOPPED};
+    std::atomic<bool> stopRequested{false};
+    std::atomic<int> socket{-1};  // Shut down by a stop to break a blocking read
+    std::string url;
+    std::thread httpThread;
+    std::thread decodeThread;
+    std::thread spectrumThread;
+    hal::HalBase::RadioMetadata_t meta;  // Written by the HTTP thread only, published through `metadata`
+    Snapshot<hal::HalBase::RadioMetadata_t> metadata;
+    IcyDemuxer icy;
+    ByteRing<RING_BUFFER_SIZE> ringBuffer;  // HTTP thread to decoder
+};
+
+static RadioStreamState s_radio;
+static Snapshot<hal::HalBase::RadioStreamFormat_t> s_stream_format;
+
+// Subscribers hear of a change, not of every write
+static void set_radio_state(RadioState_t state)
+{
+    if (s_radio.state.exchange(state) != state) {
+        hal_post_event(hal::HalBase::EVENT_RADIO_STATE, state);
+    }
+}
+
+static bool sleep_unless_stopped(uint32_t ms)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!s_radio.stopRequested && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return !s_radio.stopRequested;
+}
+
+static int buffer_percent()
+{
+    return (int)(s_radio.ringBuffer.size() * 100 / RING_BUFFER_SIZE);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           ICY Metadata Parsing                             */
+/* -------------------------------------------------------------------------- */
+static void copy_text(char* dst, size_t dstSize, const char* src, size_t len)
+{
+    if (len >= dstSize) {
+        len = dstSize - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static void parse_icy_metadata(const char* metadata, size_t len)
+{
+    // Format: StreamTitle='Artist - Track';StreamUrl='...';
+    const char* titleStart = nullptr;
+    size_t titleLen        = 0;
+    if (!IcyDemuxer::streamTitle(metadata, &titleStart, &titleLen)) {
+        return;
+    }
+    bool changed = strncmp(s_radio.meta.title, titleStart, titleLen) != 0 || s_radio.meta.title[titleLen] != '\0';
+    copy_text(s_radio.meta.title, sizeof(s_radio.meta.title), titleStart, titleLen);
+    s_radio.metadata.store(s_radio.meta);
+    // Stored first, so a subscriber reading the metadata on the event finds the new title
+    if (changed) {
+        hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);
+        mclog::tagInfo(_tag, "Now playing: {}", s_radio.meta.title);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              HTTP Transfer                                 */
+/* -------------------------------------------------------------------------- */
+enum HttpResult_t {
+    HTTP_STOPPED,   // Stop requested
+    HTTP_RETRY,     // Connection lost, try again
+    HTTP_REDIRECT,  // `url` was replaced by the Location header
+    HTTP_FAILED,    // Nothing this stream can be played from
+};
+
+static bool split_url(const std::string& url, std::string* host, std::string* port, std::string* path)
+{
+    // No TLS on this side, every SomaFM stream is plain http as well
+    if (url.compare(0, 7, "http://") != 0) {
+        return false;
+    }
+    size_t hostStart = 7;
+    size_t pathStart = url.find('/', hostStart);
+    std::string authority =
+        url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+    *path        = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+    size_t colon = authority.find(':');
+    *host        = authority.substr(0, colon);
+    *port        = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+    return !host->empty();
+}
+
+static int open_socket(const std::string& host, const std::string& port)
+{
+    addrinfo hints    = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result  = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+        mclog::tagError(_tag, "Can't resolve {}", host);
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        // Linux applies the send timeout to connect() as well
+        timeval timeout = {CONNECT_TIMEOUT_MS / 1000, (CONNECT_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+/**
+ * @return false for a header that rules the stream out
+ */
+static bool handle_header(const char* key, const char* value, std::string* location)
+{
+    if (strcasecmp(key, "icy-metaint") == 0) {
+        s_radio.icy.reset(atoi(value));
+        mclog::tagInfo(_tag, "ICY metadata interval: {}", s_radio.icy.metaInt());
+    } else if (strcasecmp(key, "icy-name") == 0) {
+        copy_text(s_radio.meta.station, sizeof(s_radio.meta.station), value, strlen(value));
+        s_radio.metadata.store(s_radio.meta);
+        mclog::tagInfo(_tag, "Station: {}", value);
+    } else if (strcasecmp(key, "icy-br") == 0) {
+        s_radio.meta.bitrate = atoi(value);
+        s_radio.metadata.store(s_radio.meta);
+    } else if (strcasecmp(key, "Location") == 0) {
+        *location = value;
+    } else if (strcasecmp(key, "Content-Type") == 0) {
+        mclog::tagInfo(_tag, "Content-Type: {}", value);
+        // Only the MP3 decoder is built for the desktop, an AAC station has to be played from its MP3 stream
+        if (strcasestr(value, "aac") || strcasestr(value, "mpegurl")) {
+            mclog::tagError(_tag, "No decoder for {} in the desktop build", value);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read the status line and headers, the body bytes read along with them are left in `body`
+ *
+ * @param playable cleared by a header that rules the stream out
+ * @return the status code, -1 if the response was cut off
+ */
+static int read_headers(int fd, std::string* body, std::string* location, bool* playable)
+{
+    std::string head;
+    char chunk[HTTP_READ_CHUNK];
+    size_t end;
+    while ((end = head.find("\r\n\r\n")) == std::string::npos) {
+        if (s_radio.stopRequested || head.size() > HTTP_HEADER_MAX) {
+            return -1;
+        }
+        ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+        if (len <= 0) {
+            return -1;
+        }
+        head.append(chunk, len);
+    }
+    *body = head.substr(end + 4);
+    head.resize(end + 2);
+
+    // "HTTP/1.0 200 OK", or "ICY 200 OK" from older Shoutcast servers
+    size_t lineEnd = head.find("\r\n");
+    size_t space   = head.find(' ');
+    if (space == std::string::npos || space > lineEnd) {
+        return -1;
+    }
+    int status = atoi(head.c_str() + space + 1);
+
+    for (size_t pos = lineEnd + 2; pos < head.size(); pos = lineEnd + 2) {
+        lineEnd      = head.find("\r\n", pos);
+        size_t colon = head.find(':', pos);
+        if (colon == std::string::npos || colon > lineEnd) {
+            continue;
+        }
+        std::string key   = head.substr(pos, colon - pos);
+        size_t valueStart = head.find_first_not_of(' ', colon + 1);
+        std::string value = valueStart < lineEnd ? head.substr(valueStart, lineEnd - valueStart) : "";
+        *playable = handle_header(key.c_str(), value.c_str(), location) && *playable;
+    }
+    return status;
+}
+
+/**
+ * @brief Back-pressure: hand the ICY demuxed audio to the ring, waiting while the decoder makes room
+ */
+static void write_audio_data(const uint8_t* data, size_t len)
+{
+    while (len > 0 && !s_radio.stopRequested) {
+        size_t written = s_radio.ringBuffer.write(data, len);
+        data += written;
+        len -= written;
+        if (len > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+static void feed_body(const uint8_t* data, size_t len)
+{
+    s_radio.icy.feed(
+        data, len, [](const uint8_t* audio, size_t n) { write_audio_data(audio, n); },
+        [](const char* meta, size_t n) { parse_icy_metadata(meta, n); });
+}
+
+static HttpResult_t run_stream(std::string* url)
+{
+    std::string host = "replay", port, path = "/";
+    int fd           = -1;
+    if (url->compare(0, 9, "replay://") == 0) {
+        fd = radio_replay_connect(*url);
+        if (fd < 0) {
+            return HTTP_FAILED;
+        }
+    } else {
+        if (!split_url(*url, &host, &port, &path)) {
+            mclog::tagError(_tag, "Not an http:// URL: {}", *url);
+            return HTTP_FAILED;
+        }
+        fd = open_socket(host, port);
+        if (fd < 0) {
+            return HTTP_RETRY;
+        }
+    }
+    timeval timeout = {HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    s_radio.socket = fd;
+    // A stop that came in while connecting found no socket to shut down
+    if (s_radio.stopRequested) {
+        s_radio.socket = -1;
+        close(fd);
+        return HTTP_STOPPED;
+    }
+
+    std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + host +
+                          "\r\nUser-Agent: Tab5-WebRadio\r\nIcy-MetaData: 1\r\nAccept: */*\r\n\r\n";
+    HttpResult_t result = HTTP_RETRY;
+    std::string body, location;
+    s_radio.icy.reset(0);
+    int status    = -1;
+    bool playable = true;
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size()) {
+        status = read_headers(fd, &body, &location, &playable);
+    }
+
+    if (s_radio.stopRequested) {
+        result = HTTP_STOPPED;
+    } else if (!playable) {
+        result = HTTP_FAILED;
+    } else if (status >= 300 && status < 400 && !location.empty()) {
+        mclog::tagInfo(_tag, "Redirected to {}", location);
+        *url   = location;
+        result = HTTP_REDIRECT;
+    } else if (status != 200) {
+        mclog::tagError(_tag, "HTTP status {}", status);
+        result = status < 0 ? HTTP_RETRY : HTTP_FAILED;
+    } else {
+        feed_body((const uint8_t*)body.data(), body.size());
+
+        uint8_t chunk[HTTP_READ_CHUNK];
+        int timeouts = 0;
+        while (!s_radio.stopRequested) {
+            // Back-pressure: leave the bytes in the socket until the decoder has made room
+            if (RING_BUFFER_SIZE - s_radio.ringBuffer.size() < HTTP_READ_CHUNK) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                if (++timeouts * HTTP_TIMEOUT_MS >= MAX_STALL_SECONDS * 1000) {
+                    mclog::tagWarn(_tag, "No data for {} s", MAX_STALL_SECONDS);
+                    break;
+                }
+                continue;
+            }
+            if (len <= 0) {
+                mclog::tagWarn(_tag, "Stream connection closed");
+                break;
+            }
+            timeouts = 0;
+            feed_body(chunk, (size_t)len);
+        }
+        result = s_radio.stopRequested ? HTTP_STOPPED : HTTP_RETRY;
+    }
+
+    s_radio.socket = -1;
+    close(fd);
+    return result;
+}
+
+static void http_stream_thread(std::string url)
+{
+    int redirects       = 0;
+    uint32_t backoffMs  = RECONNECT_MIN_MS;
+    std::string current = url;
+    while (!s_radio.stopRequested) {
+        HttpResult_t result = run_stream(&current);
+        if (result == HTTP_STOPPED) {
+            break;
+        }
+        if (result == HTTP_REDIRECT) {
+            if (++redirects <= MAX_REDIRECTS) {
+                continue;
+            }
+            mclog::tagError(_tag, "Too many redirects");
+            result = HTTP_FAILED;
+        }
+        if (result == HTTP_FAILED) {
+            set_radio_state(hal::HalBase::RADIO_ERROR);
+            break;
+        }
+
+        // Live streams drop now and then, reconnect to the URL we were given. The decoder resyncs on the next frame
+        mclog::tagInfo(_tag, "Reconnecting in {} ms", backoffMs);
+        if (!sleep_unless_stopped(backoffMs)) {
+            break;
+        }
+        backoffMs = std::min<uint32_t>(backoffMs * 2, RECONNECT_MAX_MS);
+        current   = url;
+        redirects = 0;
+    }
+    mclog::tagInfo(_tag, "HTTP stream thread ended");
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           Spectrum Analyzer                                */
+/* -------------------------------------------------------------------------- */
+// Same as the Tab5: the decoder copies a mono downmix into a window, the FFT runs on a thread of its own
+#define SPECTRUM_INTERVAL_MS 33
+#define SPECTRUM_WINDOW      (SpectrumAnalyzer::FFT_SIZE * 4)
+#define SPECTRUM_BANDS       32
+#define SPECTRUM_MIN_BANDS   8
+#define SPECTRUM_FLOOR_DB    -96.0f
+
+using RadioSpectrum_t = hal::HalBase::RadioSpectrum_t;
+
+static int16_t s_pcm_window[SPECTRUM_WINDOW];
+static std::atomic<uint32_t> s_pcm_written{0};  // Total mono samples, the decoder is the only writer
+static std::atomic<int> s_pcm_rate{44100};
+
+static TripleBuffer<RadioSpectrum_t> s_spectrum_frames;
+static uint32_t s_spectrum_version = 0;  // Carries over restarts, so a reader never sees it go back
+static std::atomic<int> s_spectrum_bands{SPECTRUM_BANDS};
+
+// The waveform off the same history, at the same rate, only while the UI asks for columns
+using RadioWaveform_t = hal::HalBase::RadioWaveform_t;
+static TripleBuffer<RadioWaveform_t> s_waveform_frames;
+static uint32_t s_waveform_version = 0;
+static std::atomic<int> s_waveform_columns{0};
+static int s_waveform_flat = 0;  // Columns of the last frame if it went out flat, another wouldn't change a pixel
+
+static void spectrum_tap(const int16_t* pcm, int samples, int channels, int sampleRate)
+{
+    uint32_t pos = s_pcm_written.load(std::memory_order_relaxed);
+    int frames   = samples / channels;
+    for (int i = 0; i < frames; i++) {
+        int32_t sum = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            sum += pcm[i * channels + ch];
+        }
+        s_pcm_window[(pos + i) & (SPECTRUM_WINDOW - 1)] = (int16_t)(sum / channels);
+    }
+    s_pcm_rate.store(sampleRate, std::memory_order_relaxed);
+    s_pcm_written.store(pos + frames, std::memory_order_release);
+}
+
+static float level_db(float amplitude)
+{
+    return (amplitude > 0) ? std::max(SPECTRUM_FLOOR_DB, 20.0f * log10f(amplitude / 32768.0f)) : SPECTRUM_FLOOR_DB;
+}
+
+static void publish_spectrum(const int16_t* samples, int bands, const uint8_t* levels)
+{
+    int64_t sumSquares = 0;
+    int peak           = 0;
+    for (int i = 0; i < SpectrumAnalyzer::FFT_SIZE; i++) {
+        sumSquares += (int32_t)samples[i] * samples[i];
+        peak = std::max(peak, abs((int)samples[i]));
+    }
+
+    RadioSpectrum_t& frame = s_spectrum_frames.back();
+    frame.version          = ++s_spectrum_version;
+    frame.timestampMs      = SDL_GetTicks();
+    frame.bands            = bands;
+    frame.rmsDb            = level_db(sqrtf((float)sumSquares / SpectrumAnalyzer::FFT_SIZE));
+    frame.peakDb           = level_db((float)peak);
+    memcpy(frame.levels, levels, bands);
+    s_spectrum_frames.publish();
+}
+
+static void publish_waveform(uint32_t end, bool silent)
+{
+    int columns = s_waveform_columns.load(std::memory_order_relaxed);
+    if (columns == 0 || (silent && s_waveform_flat == columns)) {
+        return;
+    }
+    RadioWaveform_t& frame = s_waveform_frames.back();
+    frame.version          = ++s_waveform_version;
+    frame.timestampMs      = SDL_GetTicks();
+    frame.columns          = columns;
+    if (silent) {
+        memset(frame.min, 0, columns);
+        memset(frame.max, 0, columns);
+    } else {
+        WaveformDecimator::decimate(s_pcm_window, SPECTRUM_WINDOW - 1, end, s_pcm_rate.load(std::memory_order_relaxed),
+                                    columns, frame.min, frame.max);
+    }
+    s_waveform_frames.publish();
+    s_waveform_flat = silent ? columns : 0;
+}
+
+static void spectrum_thread()
+{
+    auto analyzer = std::make_unique<SpectrumAnalyzer>();
+    auto onsets   = std::make_unique<OnsetDetector>();
+    int16_t samples[SpectrumAnalyzer::FFT_SIZE];
+    uint8_t levels[RadioSpectrum_t::MAX_BANDS];
+    int bands = s_spectrum_bands.load();
+    if (!analyzer->init()) {
+        mclog::tagError(_tag, "Spectrum analyzer init failed");
+        return;
+    }
+
+    uint32_t lastEnd = s_pcm_written.load();
+    auto wake        = std::chrono::steady_clock::now();
+    while (!s_radio.stopRequested) {
+        wake += std::chrono::milliseconds(SPECTRUM_INTERVAL_MS);
+        std::this_thread::sleep_until(wake);
+
+        // The newest FFT_SIZE samples. Rebuffering there's nothing new, silence lets the bars fall
+        uint32_t end = s_pcm_written.load(std::memory_order_acquire);
+        bool silent  = end == lastEnd;
+        if (silent) {
+            memset(samples, 0, sizeof(samples));
+        } else {
+            uint32_t begin = end - SpectrumAnalyzer::FFT_SIZE;
+            for (int i = 0; i < SpectrumAnalyzer::FFT_SIZE; i++) {
+                samples[i] = s_pcm_window[(begin + i) & (SPECTRUM_WINDOW - 1)];
+            }
+        }
+        lastEnd = end;
+
+        int wanted = s_spectrum_bands.load(std::memory_order_relaxed);
+        if (wanted != bands) {
+            bands = wanted;
+            analyzer->reset();
+        }
+
+        analyzer->process(samples, s_pcm_rate.load(std::memory_order_relaxed), levels, bands);
+        publish_spectrum(samples, bands, levels);
+        if (onsets->process(analyzer->bandDb(), bands, SDL_GetTicks())) {
+            hal_post_event(hal::HalBase::EVENT_RADIO_BEAT, onsets->bpm());
+        }
+        publish_waveform(end, silent);
+    }
+
+    // Leave a silent frame behind so the display doesn't freeze on the last one
+    memset(samples, 0, sizeof(samples));
+    memset(levels, 0, sizeof(levels));
+    publish_spectrum(samples, bands, levels);
+    publish_waveform(0, true);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                PCM Output                                  */
+/* -------------------------------------------------------------------------- */
+// Resampled to the mixer's rate and pulled by the SDL audio callback, which the UI sounds are then added onto
+#define OUTPUT_RATE             AudioMixer::SAMPLE_RATE
+#define OUTPUT_RING_SIZE        (32 * 1024)  // ~170 ms of 48 kHz stereo ahead of SDL
+#define OUTPUT_MAX_FRAMES       4096         // Resampled from one frame, 576 at 8 kHz is the most
+#define OUTPUT_WRITE_TIMEOUT_MS 500          // SDL stopped pulling, drop the rest of the frame
+
+static ByteRing<OUTPUT_RING_SIZE> s_output_ring;  // Decoder to the SDL callback
+static std::atomic<bool> s_output_playing{false};
+static std::atomic<uint32_t> s_underruns{0};
+static bool s_output_dry = false;  // The SDL callback's, an underrun is counted once until audio is back
+static Snapshot<hal::HalBase::RadioEq_t> s_output_eq;
+static std::atomic<uint32_t> s_output_eq_version{0};
+
+void radio_mix(int16_t* stream, int frames)
+{
+    size_t wanted = frames * 2 * sizeof(int16_t);
+    bool dry      = s_output_ring.read((uint8_t*)stream, wanted) < wanted;
+    if (dry && !s_output_dry && s_output_playing) {
+        s_underruns++;
+    }
+    s_output_dry = dry;
+}
+
+static void apply_output_settings(PcmDsp* dsp, uint32_t* eqVersion)
+{
+    dsp->setVolume(speaker_gain(GetHAL()->getSpeakerVolume()));
+
+    uint32_t version = s_output_eq_version.load(std::memory_order_acquire);
+    if (version == *eqVersion) {
+        return;
+    }
+    *eqVersion                    = version;
+    hal::HalBase::RadioEq_t eq    = s_output_eq.load();
+    float gains[PcmDsp::EQ_BANDS] = {(float)eq.bassDb, (float)eq.midDb, (float)eq.trebleDb};
+    dsp->setEq(gains);
+    dsp->setNormalize(eq.normalize);
+}
+
+static void output_write(const int16_t* pcm, int frames)
+{
+    const uint8_t* data = (const uint8_t*)pcm;
+    size_t len          = frames * 2 * sizeof(int16_t);
+    auto deadline       = std::chrono::steady_clock::now() + std::chrono::milliseconds(OUTPUT_WRITE_TIMEOUT_MS);
+    while (len > 0 && !s_radio.stopRequested && std::chrono::steady_clock::now() < deadline) {
+        size_t written = s_output_ring.write(data, len);
+        data += written;
+        len -= written;
+        if (len > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+// The SDL callback is the ring's reader, it's held off while what's left of the last stream is thrown away
+static void output_flush()
+{
+    SDL_AudioDeviceID device = audio_device();
+    if (device) {
+        SDL_LockAudioDevice(device);
+    }
+    s_output_ring.commitRead(s_output_ring.size());
+    if (device) {
+        SDL_UnlockAudioDevice(device);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Session Stats                                */
+/* -------------------------------------------------------------------------- */
+// What buffering is judged by, logged when a stream stops: time to first audio, and how often and how long the
+// decoder ran dry after that. RADIO_TRACE=<file> adds the buffer levels over time as CSV, for replays above all
+#define TRACE_INTERVAL_MS 100
+#define TRACE_ENV         "RADIO_TRACE"
+
+struct SessionStats {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point rebufferStart;
+    bool rebuffering = false;  // The decoder's, like `rebufferStart`
+    std::atomic<int64_t> firstAudioMs{-1};
+    std::atomic<uint32_t> rebuffers{0};
+    std::atomic<int64_t> rebufferMs{0};
+    uint32_t underrunsAtStart = 0;
+    FILE* trace               = nullptr;
+    std::thread traceThread;
+};
+
+static SessionStats s_session;
+
+static int64_t session_ms()
+{
+    auto elapsed = std::chrono::steady_clock::now() - s_session.start;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+static void trace_thread()
+{
+    fprintf(s_session.trace, "ms,buffered_bytes,output_bytes,state,rebuffers,underruns\n");
+    while (sleep_unless_stopped(TRACE_INTERVAL_MS)) {
+        fprintf(s_session.trace, "%lld,%zu,%zu,%d,%u,%u\n", (long long)session_ms(), s_radio.ringBuffer.size(),
+                s_output_ring.size(), (int)s_radio.state.load(), s_session.rebuffers.load(),
+                s_underruns.load() - s_session.underrunsAtStart);
+    }
+}
+
+static void session_start()
+{
+    s_session.start            = std::chrono::steady_clock::now();
+    s_session.rebuffering      = false;
+    s_session.firstAudioMs     = -1;
+    s_session.rebuffers        = 0;
+    s_session.rebufferMs       = 0;
+    s_session.underrunsAtStart = s_underruns.load();
+
+    const char* path = getenv(TRACE_ENV);
+    if (path && (s_session.trace = fopen(path, "w")) != nullptr) {
+        s_session.traceThread = std::thread(trace_thread);
+    } else if (path) {
+        mclog::tagError(_tag, "Can't write trace {}", path);
+    }
+}
+
+static void session_audio_out()
+{
+    if (s_session.firstAudioMs < 0) {
+        s_session.firstAudioMs = session_ms();
+    }
+    if (s_session.rebuffering) {
+        auto stalled = std::chrono::steady_clock::now() - s_session.rebufferStart;
+        s_session.rebufferMs += std::chrono::duration_cast<std::chrono::milliseconds>(stalled).count();
+        s_session.rebuffering = false;
+    }
+}
+
+static void session_rebuffer()
+{
+    s_session.rebuffers++;
+    s_session.rebuffering   = true;
+    s_session.rebufferStart = std::chrono::steady_clock::now();
+}
+
+// Once every thread of the stream has ended
+static void session_report()
+{
+    if (s_session.traceThread.joinable()) {
+        s_session.traceThread.join();
+    }
+    int64_t firstAudio = s_session.firstAudioMs;
+    uint32_t underruns = s_underruns.load() - s_session.underrunsAtStart;
+    mclog::tagInfo(_tag, "Session: {} ms, first audio after {} ms, {} rebuffers for {} ms, {} output underruns",
+                   session_ms(), firstAudio, s_session.rebuffers.load(), s_session.rebufferMs.load(), underruns);
+    if (s_session.trace) {
+        fprintf(s_session.trace, "# duration_ms=%lld first_audio_ms=%lld rebuffers=%u rebuffer_ms=%lld underruns=%u\n",
+                (long long)session_ms(), (long long)firstAudio, s_session.rebuffers.load(),
+                (long long)s_session.rebufferMs.load(), underruns);
+        fclose(s_session.trace);
+        s_session.trace = nullptr;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Frame Decoder                                 */
+/* -------------------------------------------------------------------------- */
+#define FRAME_WINDOW (16 * 1024)  // Several frames, minimp3 confirms a first sync by the header after it
+
+struct DecodeBuffers {
+    mp3dec_t mp3;
+    uint8_t window[FRAME_WINDOW];
+    int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    int16_t out[OUTPUT_MAX_FRAMES * 2];
+    PcmDsp dsp;
+    Resampler resampler;
+};
+
+/**
+ * @brief Block until `bytes` are buffered, a ring that ran dry is refilled to MIN_BUFFER_LEVEL first
+ *
+ * @return false if stopped
+ */
+static bool wait_for_stream_data(size_t bytes, bool* playing)
+{
+    if (*playing && s_radio.ringBuffer.size() >= bytes) {
+        return true;
+    }
+    if (*playing) {
+        HOT_LOG_WARN(_tag, "Buffer underrun, rebuffering");
+        *playing         = false;
+        s_output_playing = false;
+        session_rebuffer();
+    }
+    if (s_radio.state != hal::HalBase::RADIO_ERROR) {
+        set_radio_state(hal::HalBase::RADIO_BUFFERING);
+    }
+    while (!s_radio.stopRequested && s_radio.ringBuffer.size() < std::max<size_t>(bytes, MIN_BUFFER_LEVEL)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    if (s_radio.stopRequested) {
+        return false;
+    }
+    *playing         = true;
+    s_output_playing = true;
+    set_radio_state(hal::HalBase::RADIO_PLAYING);
+    return true;
+}
+
+static void publish_format(const mp3_frame::FrameInfo_t& info)
+{
+    hal::HalBase::RadioStreamFormat_t format = s_stream_format.load();
+    if (format.sampleRate == info.sampleRate && format.channels == info.channels &&
+        format.bitrate == info.bitrateKbps) {
+        return;
+    }
+    format.codec      = hal::HalBase::RADIO_CODEC_MP3;
+    format.sampleRate = info.sampleRate;
+    format.channels   = info.channels;
+    format.vbr        = format.vbr || (format.bitrate != 0 && format.bitrate != info.bitrateKbps);
+    format.bitrate    = info.bitrateKbps;
+    s_stream_format.store(format);
+}
+
+static void decode_thread()
+{
+    auto buffers       = std::make_unique<DecodeBuffers>();
+    DecodeBuffers& b   = *buffers;
+    size_t filled      = 0;
+    size_t skipped     = 0;
+    bool playing       = false;
+    uint32_t eqVersion = s_output_eq_version.load() - 1;  // Applied with the first frame
+    mp3dec_init(&b.mp3);
+
+    while (!s_radio.stopRequested) {
+        // Top the window up, the ring's span at the wrap may take two reads
+        filled += s_radio.ringBuffer.read(b.window + filled, FRAME_WINDOW - filled);
+
+        mp3_frame::FrameInfo_t info;
+        int offset = mp3_frame::find_frame(b.window, filled, &info);
+        if (offset < 0) {
+            // Keep the last bytes, a header may start there
+            size_t keep = std::min(filled, mp3_frame::HEADER_SIZE - 1);
+            skipped += filled - keep;
+            memmove(b.window, b.window + filled - keep, keep);
+            filled = keep;
+            if (!wait_for_stream_data(mp3_frame::HEADER_SIZE, &playing)) {
+                break;
+            }
+            continue;
+        }
+        if (offset > 0) {
+            memmove(b.window, b.window + offset, filled - offset);
+            filled -= offset;
+            skipped += offset;
+        }
+        if (filled < info.frameSize) {
+            if (!wait_for_stream_data(info.frameSize - filled, &playing)) {
+                break;
+            }
+            continue;
+        }
+        if (!playing && !wait_for_stream_data(MIN_BUFFER_LEVEL, &playing)) {
+            break;
+        }
+        if (skipped > 0) {
+            HOT_LOG_INFO(_tag, "MP3 sync: skipped {} bytes to frame ({} Hz)", skipped, info.sampleRate);
+            skipped = 0;
+        }
+
+        mp3dec_frame_info_t decoded;
+        int samples    = mp3dec_decode_frame(&b.mp3, b.window, (int)filled, b.pcm, &decoded);
+        size_t consume = decoded.frame_bytes > 0 ? (size_t)decoded.frame_bytes : info.frameSize;
+        consume        = std::min(consume, filled);
+        memmove(b.window, b.window + consume, filled - consume);
+        filled -= consume;
+        if (samples <= 0 || decoded.channels <= 0) {
+            continue;
+        }
+
+        publish_format(info);
+        int channels = decoded.channels;
+        b.dsp.configure(decoded.hz, channels);
+        apply_output_settings(&b.dsp, &eqVersion);
+        b.dsp.process(b.pcm, samples * channels);
+        spectrum_tap(b.pcm, samples * channels, channels, decoded.hz);
+
+        if (!b.resampler.configure(decoded.hz, OUTPUT_RATE, channels)) {
+            mclog::tagError(_tag, "Can't resample {} Hz", decoded.hz);
+            set_radio_state(hal::HalBase::RADIO_ERROR);
+            break;
+        }
+        int frames = b.resampler.process(b.pcm, samples, b.out, OUTPUT_MAX_FRAMES);
+        output_write(b.out, frames);
+        session_audio_out();
+    }
+    s_output_playing = false;
+    mclog::tagInfo(_tag, "Decode thread ended");
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           HAL Implementation                               */
+/* -------------------------------------------------------------------------- */
+hal::HalBase::RadioState_t HalDesktop::getRadioState()
+{
+    return s_radio.state;
+}
+
+bool HalDesktop::startRadioStream(const std::string& stationUrl)
+{
+    stopRadioStream();
+
+    // RADIO_REPLAY=<capture> stands in for every station, see hal_radio_replay.cpp
+    const char* replay = getenv("RADIO_REPLAY");
+    std::string url    = replay ? std::string("replay://") + replay : stationUrl;
+    if (headless_enabled() && !replay) {
+        // A UI benchmark shows the same screens on every run, whatever the network does
+        mclog::tagInfo(_tag, "Headless: not streaming {}", stationUrl);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_radio.control);
+    mclog::tagInfo(_tag, "Starting stream: {}", url);
+    s_radio.url           = url;
+    s_radio.stopRequested = false;
+    s_radio.meta          = {};
+    s_radio.metadata.store(s_radio.meta);
+    s_stream_format.store({});
+    session_start();
+    set_radio_state(RADIO_BUFFERING);
+
+    s_radio.httpThread     = std::thread(http_stream_thread, url);
+    s_radio.decodeThread   = std::thread(decode_thread);
+    s_radio.spectrumThread = std::thread(spectrum_thread);
+    return true;
+}
+
+void HalDesktop::stopRadioStream()
+{
+    std::lock_guard<std::mutex> lock(s_radio.control);
+    if (!s_radio.httpThread.joinable()) {
+        return;
+    }
+    mclog::tagInfo(_tag, "Stopping stream");
+    s_radio.stopRequested = true;
+    int fd                = s_radio.socket.load();
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+    s_radio.httpThread.join();
+    s_radio.decodeThread.join();
+    s_radio.spectrumThread.join();
+    radio_replay_stop();
+    session_report();
+
+    // Both ends are gone, what's left of the old station goes with them
+    s_radio.ringBuffer.commitRead(s_radio.ringBuffer.size());
+    output_flush();
+
+    bool hadTitle = s_radio.meta.title[0] != '\0';
+    s_radio.meta  = {};
+    s_radio.metadata.store(s_radio.meta);
+    set_radio_state(RADIO_STOPPED);
+    if (hadTitle) {
+        hal_post_event(EVENT_RADIO_TITLE);
+    }
+}
+
+hal::HalBase::RadioMetadata_t HalDesktop::getRadioMetadata()
+{
+    RadioMetadata_t metadata = s_radio.metadata.load();
+    metadata.bufferPercent   = buffer_percent();
+    return metadata;
+}
+
+hal::HalBase::RadioStreamFormat_t HalDesktop::getRadioStreamFormat()
+{
+    return s_stream_format.load();
+}
+
+void HalDesktop::setRadioEq(const RadioEq_t& eq)
+{
+    s_output_eq.store(eq);
+    s_output_eq_version++;
+}
+
+hal::HalBase::RadioEq_t HalDesktop::getRadioEq()
+{
+    return s_output_eq.load();
+}
+
+hal::HalBase::RadioOutputStats_t HalDesktop::getRadioOutputStats()
+{
+    RadioOutputStats_t stats;
+    stats.underruns = s_underruns.load();
+    return stats;
+}
+
+bool HalDesktop::getRadioWaveform(RadioWaveform_t* frame)
+{
+    // Like the spectrum, the UI thread is the only consumer
+    s_waveform_frames.update();
+    const RadioWaveform_t& latest = s_waveform_frames.front();
+    if (latest.version == frame->version) {
+        return false;
+    }
+    *frame = latest;
+    return true;
+}
+
+void HalDesktop::setRadioWaveformColumns(int columns)
+{
+    s_waveform_columns = std::clamp(columns, 0, RadioWaveform_t::MAX_COLUMNS);
+}
+
+bool HalDesktop::getRadioSpectrum(RadioSpectrum_t* frame)
+{
+    // The triple buffer's only consumer, which is fine as long as only the UI thread polls
+    s_spectrum_frames.update();
+    const RadioSpectrum_t& latest = s_spectrum_frames.front();
+    if (latest.version == frame->version) {
+        return false;
+    }
+    *frame = latest;
+    return true;
+}
+
+void HalDesktop::setRadioSpectrumBands(int bands)
+{
+    s_spectrum_bands = std::clamp(bands, SPECTRUM_MIN_BANDS, (int)RadioSpectrum_t::MAX_BANDS);
+}
@@ -0,0 +1,379 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "../hal_desktop.h"
+#include <mooncake_log.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A captured Icecast session served over a local socket pair, so the HTTP thread reads it exactly as it reads a
+// server. A capture is what the server sent, status line and headers included:
+//
+//     curl -s -i -H "Icy-MetaData: 1" http://ice1.somafm.com/groovesalad-128-mp3 --max-time 120 > groove.icy
+//
+// A bare MP3 file is served as a plain audio/mpeg stream. The network is scripted by RADIO_REPLAY_SCRIPT, one event
+// per line, `at <seconds>` into the session (the first connect) or from the start if left out:
+//
+//     rate 128              # kbit/s cap, 0: as fast as the client reads
+//     latency 400           # ms from each connect to the first byte
+//     jitter 30             # up to this many ms more after every chunk, from a fixed seed
+//     at 20 stall 6000      # no bytes for 6 s
+//     at 45 disconnect      # the server drops the connection
+//     at 60 rate 48         # the link gets worse
+//
+// A reconnect picks the capture up where the last connection stopped, at the next ICY block so the metadata stays in
+// step. Once the capture is played out every connect gets a 404.
+static const std::string _tag = "replay";
+
+#define REPLAY_CHUNK         1436         // One TCP segment
+#define REPLAY_SOCKET_BUFFER (64 * 1024)  // What a TCP window lets the server get ahead
+#define REPLAY_POLL_MS       50           // Sleeps are cut into slices, a stop or a closed client ends them
+#define REPLAY_SCRIPT_ENV    "RADIO_REPLAY_SCRIPT"
+
+enum ReplayAction_t {
+    REPLAY_RATE,
+    REPLAY_LATENCY,
+    REPLAY_JITTER,
+    REPLAY_STALL,
+    REPLAY_DISCONNECT,
+};
+
+struct ReplayEvent_t {
+    uint32_t atMs         = 0;
+    ReplayAction_t action = REPLAY_RATE;
+    uint32_t value        = 0;
+};
+
+// Connections come one after the other from the HTTP thread, each joins the last one's feeder before it starts its
+// own. So only one thread ever touches the session, apart from `stopping`
+struct ReplaySession {
+    std::string capture;  // Path the session was loaded from, empty: not loaded
+    std::string head;     // Status line and headers, blank line included
+    std::vector<uint8_t> body;
+    std::vector<size_t> resumePoints;  // ICY block starts, empty if any byte will do
+    std::vector<ReplayEvent_t> events;
+    size_t nextEvent  = 0;
+    size_t position   = 0;  // Next body byte to send, carried over reconnects
+    uint32_t rateKbps = 0;
+    uint32_t latency  = 0;
+    uint32_t jitter   = 0;
+    uint32_t random   = 0x2545f491;
+    std::chrono::steady_clock::time_point start;
+    std::thread feeder;
+    std::atomic<bool> stopping{false};
+};
+
+static ReplaySession s_replay;
+
+static uint32_t session_ms()
+{
+    auto elapsed = std::chrono::steady_clock::now() - s_replay.start;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+static uint32_t next_random()
+{
+    s_replay.random ^= s_replay.random << 13;
+    s_replay.random ^= s_replay.random >> 17;
+    s_replay.random ^= s_replay.random << 5;
+    return s_replay.random;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Loading                                  */
+/* -------------------------------------------------------------------------- */
+static bool load_capture(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        mclog::tagError(_tag, "Can't read capture {}", path);
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t end = data.find("\r\n\r\n");
+    if ((data.compare(0, 5, "HTTP/") == 0 || data.compare(0, 4, "ICY ") == 0) && end != std::string::npos) {
+        s_replay.head = data.substr(0, end + 4);
+        s_replay.body.assign(data.begin() + end + 4, data.end());
+    } else {
+        s_replay.head = "HTTP/1.0 200 OK\r\nContent-Type: audio/mpeg\r\n\r\n";
+        s_replay.body.assign(data.begin(), data.end());
+    }
+
+    // The block starts a reconnect may resume at, so the client's ICY count matches the capture's
+    int metaInt = 0;
+    for (size_t pos = 0; pos < s_replay.head.size();) {
+        size_t lineEnd  = s_replay.head.find("\r\n", pos);
+        std::string key = "icy-metaint:";
+        if (strncasecmp(s_replay.head.c_str() + pos, key.c_str(), key.size()) == 0) {
+            metaInt = atoi(s_replay.head.c_str() + pos + key.size());
+        }
+        pos = lineEnd == std::string::npos ? s_replay.head.size() : lineEnd + 2;
+    }
+    s_replay.resumePoints.clear();
+    for (size_t pos = 0; metaInt > 0 && pos < s_replay.body.size();) {
+        s_replay.resumePoints.push_back(pos);
+        pos += metaInt;
+        if (pos < s_replay.body.size()) {
+            pos += 1 + s_replay.body[pos] * 16;
+        }
+    }
+    mclog::tagInfo(_tag, "Capture {}: {} KB, ICY metadata interval {}", path, s_replay.body.size() / 1024, metaInt);
+    return true;
+}
+
+static bool parse_action(const std::string& name, ReplayAction_t* action)
+{
+    static const struct {
+        const char* name;
+        ReplayAction_t action;
+    } actions[] = {
+        {"rate", REPLAY_RATE},   {"latency", REPLAY_LATENCY},       {"jitter", REPLAY_JITTER},
+        {"stall", REPLAY_STALL}, {"disconnect", REPLAY_DISCONNECT},
+    };
+    for (const auto& entry : actions) {
+        if (name == entry.name) {
+            *action = entry.action;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void load_script(const char* path)
+{
+    s_replay.events.clear();
+    if (!path) {
+        return;
+    }
+    std::ifstream file(path);
+    if (!file) {
+        mclog::tagError(_tag, "Can't read script {}", path);
+        return;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string word;
+        if (!(words >> word)) {
+            continue;
+        }
+
+        ReplayEvent_t event;
+        double atSeconds = 0;
+        if (word == "at" && !(words >> atSeconds >> word)) {
+            mclog::tagWarn(_tag, "Script line {}: expected `at <seconds> <event>`", number);
+            continue;
+        }
+        event.atMs = (uint32_t)(atSeconds * 1000);
+        if (!parse_action(word, &event.action)) {
+            mclog::tagWarn(_tag, "Script line {}: unknown event {}", number, word);
+            continue;
+        }
+        if (event.action != REPLAY_DISCONNECT && !(words >> event.value)) {
+            mclog::tagWarn(_tag, "Script line {}: {} needs a value", number, word);
+            continue;
+        }
+        s_replay.events.push_back(event);
+    }
+    std::stable_sort(s_replay.events.begin(), s_replay.events.end(),
+                     [](const ReplayEvent_t& a, const ReplayEvent_t& b) { return a.atMs < b.atMs; });
+    mclog::tagInfo(_tag, "Script {}: {} events", path, s_replay.events.size());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Feeder                                  */
+/* -------------------------------------------------------------------------- */
+/**
+ * @return false if the replay is stopping or the client closed its end
+ */
+static bool sleep_for_client(int fd, uint32_t ms)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!s_replay.stopping) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return true;
+        }
+        pollfd client = {fd, POLLRDHUP, 0};
+        if (poll(&client, 1, std::min<int>((int)left.count(), REPLAY_POLL_MS)) > 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool send_all(int fd, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+// The settings that are due, stalls and disconnects are left for the body loop
+static void apply_settings()
+{
+    while (s_replay.nextEvent < s_replay.events.size()) {
+        const ReplayEvent_t& event = s_replay.events[s_replay.nextEvent];
+        if (event.atMs > session_ms() || event.action == REPLAY_STALL || event.action == REPLAY_DISCONNECT) {
+            return;
+        }
+        if (event.action == REPLAY_RATE) {
+            s_replay.rateKbps = event.value;
+        } else if (event.action == REPLAY_LATENCY) {
+            s_replay.latency = event.value;
+        } else {
+            s_replay.jitter = event.value;
+        }
+        s_replay.nextEvent++;
+    }
+}
+
+static void feed_connection(int fd)
+{
+    apply_settings();
+    if (!sleep_for_client(fd, s_replay.latency)) {
+        close(fd);
+        return;
+    }
+    if (s_replay.position >= s_replay.body.size()) {
+        static const char notFound[] = "HTTP/1.0 404 Not Found\r\n\r\n";
+        send_all(fd, (const uint8_t*)notFound, sizeof(notFound) - 1);
+        close(fd);
+        return;
+    }
+    if (!send_all(fd, (const uint8_t*)s_replay.head.data(), s_replay.head.size())) {
+        close(fd);
+        return;
+    }
+
+    auto rateStart   = std::chrono::steady_clock::now();
+    size_t rateBytes = 0;
+    uint32_t rate    = s_replay.rateKbps;
+    while (s_replay.position < s_replay.body.size()) {
+        // Events that are due, in script order
+        apply_settings();
+        bool dropped = false;
+        while (!dropped && s_replay.nextEvent < s_replay.events.size() &&
+               s_replay.events[s_replay.nextEvent].atMs <= session_ms()) {
+            const ReplayEvent_t& event = s_replay.events[s_replay.nextEvent++];
+            if (event.action == REPLAY_STALL) {
+                mclog::tagInfo(_tag, "{} ms: stall for {} ms", session_ms(), event.value);
+                dropped   = !sleep_for_client(fd, event.value);
+                rateStart = std::chrono::steady_clock::now();
+                rateBytes = 0;
+            } else {
+                mclog::tagInfo(_tag, "{} ms: disconnect", session_ms());
+                dropped = true;
+            }
+            apply_settings();
+        }
+        if (dropped) {
+            break;
+        }
+        if (s_replay.rateKbps != rate) {
+            mclog::tagInfo(_tag, "{} ms: rate {} kbit/s", session_ms(), s_replay.rateKbps);
+            rate      = s_replay.rateKbps;
+            rateStart = std::chrono::steady_clock::now();
+            rateBytes = 0;
+        }
+
+        size_t len = std::min((size_t)REPLAY_CHUNK, s_replay.body.size() - s_replay.position);
+        if (!send_all(fd, s_replay.body.data() + s_replay.position, len)) {
+            break;
+        }
+        s_replay.position += len;
+        rateBytes += len;
+
+        // Paced to the rate, not chunk by chunk, so the jitter doesn't slow it down on average
+        uint32_t waitMs = s_replay.jitter ? next_random() % (s_replay.jitter + 1) : 0;
+        if (rate > 0) {
+            auto due    = rateStart + std::chrono::microseconds(rateBytes * 8 * 1000 / rate);
+            auto behind = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now());
+            waitMs += std::max<int64_t>(behind.count(), 0);
+        }
+        if (waitMs > 0 && !sleep_for_client(fd, waitMs)) {
+            break;
+        }
+    }
+    if (s_replay.position >= s_replay.body.size()) {
+        mclog::tagInfo(_tag, "{} ms: capture played out", session_ms());
+    }
+    close(fd);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Connections                                */
+/* -------------------------------------------------------------------------- */
+int radio_replay_connect(const std::string& url)
+{
+    std::string capture = url.substr(strlen("replay://"));
+    if (s_replay.feeder.joinable()) {
+        s_replay.feeder.join();
+    }
+    if (s_replay.capture != capture) {
+        if (!load_capture(capture)) {
+            return -1;
+        }
+        load_script(getenv(REPLAY_SCRIPT_ENV));
+        s_replay.capture   = capture;
+        s_replay.nextEvent = 0;
+        s_replay.position  = 0;
+        s_replay.rateKbps  = 0;
+        s_replay.latency   = 0;
+        s_replay.jitter    = 0;
+        s_replay.random    = 0x2545f491;
+        s_replay.start     = std::chrono::steady_clock::now();
+    }
+
+    // A reconnect resumes at the next ICY block, the bytes in between were missed like on a live stream
+    auto resume = std::lower_bound(s_replay.resumePoints.begin(), s_replay.resumePoints.end(), s_replay.position);
+    if (resume != s_replay.resumePoints.end()) {
+        s_replay.position = *resume;
+    } else if (!s_replay.resumePoints.empty()) {
+        s_replay.position = s_replay.body.size();
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        mclog::tagError(_tag, "socketpair failed: {}", strerror(errno));
+        return -1;
+    }
+    int buffer = REPLAY_SOCKET_BUFFER;
+    setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+    s_replay.stopping = false;
+    s_replay.feeder   = std::thread(feed_connection, fds[1]);
+    mclog::tagInfo(_tag, "{} ms: connected at byte {}", session_ms(), s_replay.position);
+    return fds[0];
+}
+
+void radio_replay_stop()
+{
+    s_replay.stopping = true;
+    if (s_replay.feeder.joinable()) {
+        s_replay.feeder.join();
+    }
+    s_replay.capture.clear();
+}
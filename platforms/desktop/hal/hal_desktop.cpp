@@ -4,10 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal_desktop.h"
+#include <hal/event_bus.h>
 #include <SDL2/SDL.h>
 #include <mooncake_log.h>
 #include <random>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <thread>
 
 static const std::string _tag = "hal";
@@ -16,6 +19,7 @@ void HalDesktop::init()
 {
     mclog::tagInfo(_tag, "init");
     lvgl_init();
+    audio_init();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -28,7 +32,7 @@ void HalDesktop::delay(uint32_t ms)
 
 uint32_t HalDesktop::millis()
 {
-    return SDL_GetTicks();
+    return headless_enabled() ? headless_millis() : SDL_GetTicks();
 }
 
 int HalDesktop::getCpuTemp()
@@ -139,6 +143,31 @@ bool HalDesktop::getExtAntennaEnable()
     return _ext_antenna_enable;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                                    WiFi                                    */
+/* -------------------------------------------------------------------------- */
+// The host is online already, WiFi is always up so the radio can be played straight away
+hal::HalBase::WifiState_t HalDesktop::getWifiState()
+{
+    return WIFI_CONNECTED;
+}
+
+bool HalDesktop::connectWifiSta(const std::string& ssid, const std::string& password)
+{
+    mclog::tagInfo(_tag, "connect wifi sta: {}", ssid);
+    return true;
+}
+
+hal::HalBase::WifiIp_t HalDesktop::getWifiIp()
+{
+    return "127.0.0.1";
+}
+
+hal::HalBase::WifiSsid_t HalDesktop::getWifiSsid()
+{
+    return "Desktop";
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                   SD card                                  */
 /* -------------------------------------------------------------------------- */
@@ -147,14 +176,83 @@ bool HalDesktop::isSdCardMounted()
     return true;
 }
 
-std::vector<hal::HalBase::FileEntry_t> HalDesktop::scanSdCard(const std::string& dirPath)
+// The host's file system stands in for the card, `dirPath` as it is
+static std::mutex s_sd_mutex;
+static std::map<int, std::filesystem::directory_iterator> s_sd_dirs;
+static int s_sd_next_dir = 0;
+
+int HalDesktop::openSdCardDir(const std::string& dirPath)
 {
-    std::filesystem::path path(dirPath);
-    std::vector<hal::HalBase::FileEntry_t> file_entries;
-    for (const auto& entry : std::filesystem::directory_iterator(path)) {
-        file_entries.push_back({entry.path().filename().string(), entry.is_directory()});
+    std::error_code error;
+    std::filesystem::directory_iterator dir(dirPath, error);
+    if (error) {
+        return -1;
     }
-    return file_entries;
+    std::lock_guard<std::mutex> lock(s_sd_mutex);
+    int cursor        = s_sd_next_dir++;
+    s_sd_dirs[cursor] = std::move(dir);
+    return cursor;
+}
+
+std::vector<hal::HalBase::FileEntry_t> HalDesktop::readSdCardDir(int cursor, int maxEntries)
+{
+    std::vector<FileEntry_t> page;
+    std::lock_guard<std::mutex> lock(s_sd_mutex);
+    auto it = s_sd_dirs.find(cursor);
+    if (it == s_sd_dirs.end()) {
+        return page;
+    }
+    std::error_code error;
+    auto& dir = it->second;
+    while (dir != std::filesystem::directory_iterator() && (int)page.size() < maxEntries) {
+        page.push_back({dir->path().filename().string(), dir->is_directory(error)});
+        dir.increment(error);
+        if (error) {
+            dir = std::filesystem::directory_iterator();  // Ends the listing
+        }
+    }
+    return page;
+}
+
+void HalDesktop::closeSdCardDir(int cursor)
+{
+    std::lock_guard<std::mutex> lock(s_sd_mutex);
+    s_sd_dirs.erase(cursor);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Storage                                  */
+/* -------------------------------------------------------------------------- */
+std::string HalDesktop::getAssetDir()
+{
+    // Read straight from the source tree, LV_FS_STDIO_PATH is app/assets/packed
+    return "S:";
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Change Events                               */
+/* -------------------------------------------------------------------------- */
+// Only the radio changes by itself here, everything else leaves a subscriber with its resync
+static EventBus<hal::HalBase::Event_t, 32, 4> s_events(hal::HalBase::Event_t{hal::HalBase::EVENT_RESYNC, 0});
+
+void hal_post_event(hal::HalBase::EventType_t type, int value)
+{
+    s_events.post({type, value});
+}
+
+int HalDesktop::subscribeEvents()
+{
+    return s_events.subscribe();
+}
+
+void HalDesktop::unsubscribeEvents(int id)
+{
+    s_events.unsubscribe(id);
+}
+
+bool HalDesktop::pollEvent(int id, Event_t* event)
+{
+    return s_events.poll(id, event);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -188,6 +286,27 @@ std::vector<uint8_t> HalDesktop::i2cScan(bool isInternal)
     return addrs;
 }
 
+bool HalDesktop::startI2cScan(bool isInternal)
+{
+    std::thread([this, isInternal]() {
+        std::vector<uint8_t> addrs = i2cScan(isInternal);
+        {
+            std::lock_guard<std::mutex> lock(_i2c_mutex);
+            _i2c_devices[isInternal] = std::move(addrs);
+            _i2c_scanned[isInternal] = true;
+        }
+        hal_post_event(EVENT_I2C_SCAN, isInternal);
+    }).detach();
+    return true;
+}
+
+bool HalDesktop::getI2cDevices(bool isInternal, std::vector<uint8_t>* addrs)
+{
+    std::lock_guard<std::mutex> lock(_i2c_mutex);
+    *addrs = _i2c_devices[isInternal];
+    return _i2c_scanned[isInternal];
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                UART monitor                                */
 /* -------------------------------------------------------------------------- */
@@ -202,12 +321,9 @@ void HalDesktop::uartMonitorSend(std::string msg, bool newLine)
     std::thread([&]() {
         for (int i = 0; i < 6; i++) {
             std::this_thread::sleep_for(std::chrono::seconds(1));
-            std::lock_guard<std::mutex> lock(GetHAL()->uartMonitorData.mutex);
             std::string send_msg = "[2025-04-24 14:32:38.111] [info] [panel-com] recv msg: 32\n";
             mclog::tagInfo(_tag, "send msg: {}", send_msg);
-            for (auto c : send_msg) {
-                GetHAL()->uartMonitorData.rxQueue.push(c);
-            }
+            GetHAL()->uartMonitorData.rx.write((const uint8_t*)send_msg.data(), send_msg.size());
         }
         is_test_thread_running = false;
     }).detach();
@@ -5,6 +5,47 @@
  */
 #pragma once
 #include <hal/hal.h>
+#include <hal/input_recording.h>
+#include <atomic>
+#include <mutex>
+
+// hal_desktop.cpp
+void hal_post_event(hal::HalBase::EventType_t type, int value = 0);
+// hal_audio.cpp, 0 if SDL audio couldn't be opened
+uint32_t audio_device();
+// hal_audio.cpp, linear gain for a speaker volume of 0 to 100 on the Tab5's curve
+float speaker_gain(int volume);
+// hal_radio.cpp, called by the SDL audio callback to fill `stream` with the radio's 48 kHz stereo output
+void radio_mix(int16_t* stream, int frames);
+// hal_radio_replay.cpp, a captured session for a replay://<capture> URL: the client end of a local socket, -1 if the
+// capture can't be read. Reconnects carry on through the capture until radio_replay_stop()
+int radio_replay_connect(const std::string& url);
+void radio_replay_stop();
+
+// hal_perf.cpp, one frame LVGL rendered
+struct PerfFrame_t {
+    int64_t renderUs = 0;  // Without the flushes
+    int64_t flushUs  = 0;
+    uint32_t areas   = 0;  // Invalidated for it, overlaps count twice
+    uint32_t pixels  = 0;
+};
+// Times LVGL's refreshes of `disp` for getPerfStats(), and hands each rendered frame to `onFrame` if set
+void perf_attach_display(lv_display_t* disp);
+void perf_on_frame(void (*onFrame)(const PerfFrame_t&));
+// hal_lvgl.cpp, headless: no window, LVGL renders into memory on a clock that only headless_advance() moves and
+// headless_pointer() is the touch. Enabled before the HAL is injected, the caller then runs lv_timer_handler()
+void headless_enable();
+bool headless_enabled();
+uint32_t headless_millis();
+void headless_advance(uint32_t ms);
+void headless_pointer(int x, int y, bool pressed);
+// From now on the headless pointer and keypad read `replayer`'s records instead, from when this is called
+void headless_replay(input_recording::Replayer* replayer);
+// hal_lvgl.cpp, windowed: what SDL's mouse and keyboard hand LVGL from its init on, saved to `path` at exit. Call
+// before the HAL is injected
+void input_record(const std::string& path);
+// The last rendered frame as a binary PPM
+bool headless_screenshot(const std::string& path);
 
 class HalDesktop : public hal::HalBase {
 public:
@@ -18,6 +59,7 @@ public:
     void delay(uint32_t ms) override;
     uint32_t millis() override;
     int getCpuTemp() override;
+    bool getPerfStats(PerfStats_t* stats) override;
 
     void setDisplayBrightness(uint8_t brightness) override;
     uint8_t getDisplayBrightness() override;
@@ -29,6 +71,11 @@ public:
     uint8_t getSpeakerVolume() override;
     void audioPlay(std::vector<int16_t>& data, bool async = true) override;
     void audioRecord(std::vector<int16_t>& data, uint16_t durationMs, float gain = 80.0f) override;
+    int openMicCapture() override;
+    void closeMicCapture(int reader) override;
+    int readMicCapture(int reader, int16_t* data, int maxFrames, uint32_t timeoutMs = 0,
+                       int* dropped = nullptr) override;
+    void setMicGain(float gain) override;
     void startDualMicRecordTest() override;
     MicTestState_t getDualMicRecordTestState() override;
     void startHeadphoneMicRecordTest() override;
@@ -52,24 +99,56 @@ public:
     void setExtAntennaEnable(bool enable) override;
     bool getExtAntennaEnable() override;
 
+    WifiState_t getWifiState() override;
+    bool connectWifiSta(const std::string& ssid, const std::string& password) override;
+    WifiIp_t getWifiIp() override;
+    WifiSsid_t getWifiSsid() override;
+
+    RadioState_t getRadioState() override;
+    bool startRadioStream(const std::string& url) override;
+    void stopRadioStream() override;
+    RadioMetadata_t getRadioMetadata() override;
+    RadioStreamFormat_t getRadioStreamFormat() override;
+    void setRadioEq(const RadioEq_t& eq) override;
+    RadioEq_t getRadioEq() override;
+    RadioOutputStats_t getRadioOutputStats() override;
+    bool getRadioSpectrum(RadioSpectrum_t* frame) override;
+    void setRadioSpectrumBands(int bands) override;
+    bool getRadioWaveform(RadioWaveform_t* frame) override;
+    void setRadioWaveformColumns(int columns) override;
+
     bool isSdCardMounted() override;
-    std::vector<FileEntry_t> scanSdCard(const std::string& dirPath) override;
+    int openSdCardDir(const std::string& dirPath) override;
+    std::vector<FileEntry_t> readSdCardDir(int cursor, int maxEntries) override;
+    void closeSdCardDir(int cursor) override;
+
+    std::string getAssetDir() override;
+
+    int subscribeEvents() override;
+    void unsubscribeEvents(int id) override;
+    bool pollEvent(int id, Event_t* event) override;
 
     bool usbCDetect() override;
     bool usbADetect() override;
     bool headPhoneDetect() override;
     std::vector<uint8_t> i2cScan(bool isInternal) override;
+    bool startI2cScan(bool isInternal) override;
+    bool getI2cDevices(bool isInternal, std::vector<uint8_t>* addrs) override;
 
     void uartMonitorSend(std::string msg, bool newLine = true) override;
 
 private:
     uint8_t _current_lcd_brightness = 100;
-    uint8_t _current_speaker_volume = 20;
+    std::atomic<uint8_t> _current_speaker_volume{20};  // Read by the SDL callback and the decoder
     bool _charge_qc_enable          = false;
     bool _charge_enable             = true;
     bool _ext_5v_enable             = true;
     bool _usba_5v_enable            = true;
     bool _ext_antenna_enable        = false;
+    std::mutex _i2c_mutex;
+    std::vector<uint8_t> _i2c_devices[2];  // [Port A, internal]
+    bool _i2c_scanned[2] = {};
 
     void lvgl_init();
+    void audio_init();
 };
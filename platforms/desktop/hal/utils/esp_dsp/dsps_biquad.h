@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "esp_err.h"
+
+/**
+ * @brief esp-dsp's biquad on the desktop, the plain C version of what the Tab5 runs with SIMD
+ *
+ * Direct form II, `coef` is b0 b1 b2 a1 a2 and `w` the two state values, so filters designed for the Tab5 carry over
+ * unchanged. Works in place.
+ */
+inline esp_err_t dsps_biquad_f32(const float* input, float* output, int len, float* coef, float* w)
+{
+    for (int i = 0; i < len; i++) {
+        float d0  = input[i] - coef[3] * w[0] - coef[4] * w[1];
+        output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+        w[1]      = w[0];
+        w[0]      = d0;
+    }
+    return ESP_OK;
+}
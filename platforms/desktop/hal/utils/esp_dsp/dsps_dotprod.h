@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "esp_err.h"
+
+/**
+ * @brief esp-dsp's dot product on the desktop, left to the compiler to vectorize
+ */
+inline esp_err_t dsps_dotprod_f32(const float* src1, const float* src2, float* dest, int len)
+{
+    float sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += src1[i] * src2[i];
+    }
+    *dest = sum;
+    return ESP_OK;
+}
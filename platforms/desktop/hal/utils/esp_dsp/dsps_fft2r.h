@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "esp_err.h"
+#include <cstdint>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief esp-dsp's 16 bit complex radix-2 FFT on the desktop
+ *
+ * Same contract as on the Tab5: interleaved re/im in place, natural order in and bit reversed order out until
+ * `dsps_bit_rev_sc16_ansi()`, and every stage halves the values so nothing overflows. The rounding isn't bit exact
+ * with esp-dsp's, levels derived from it are.
+ */
+namespace dsps_fft2r_detail {
+
+inline std::vector<int16_t>& table()
+{
+    static std::vector<int16_t> twiddles;  // cos/sin pairs in Q15 for the largest size, W^k = e^(-2 pi i k / N)
+    return twiddles;
+}
+
+}  // namespace dsps_fft2r_detail
+
+inline esp_err_t dsps_fft2r_init_sc16(int16_t* /*fft_table_buff*/, int table_size)
+{
+    if (table_size <= 0 || (table_size & (table_size - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto& table = dsps_fft2r_detail::table();
+    table.resize(table_size);
+    for (int k = 0; k < table_size / 2; k++) {
+        double angle     = 2.0 * M_PI * k / table_size;
+        table[k * 2]     = (int16_t)lround(cos(angle) * 32767.0);
+        table[k * 2 + 1] = (int16_t)lround(-sin(angle) * 32767.0);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t dsps_fft2r_sc16(int16_t* data, int N)
+{
+    const auto& table = dsps_fft2r_detail::table();
+    if (N <= 0 || (N & (N - 1)) != 0 || N > (int)table.size()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int stride = (int)table.size() / N;
+
+    // Decimation in frequency, so the input needs no reordering and the output comes out bit reversed
+    for (int half = N / 2, step = stride; half > 0; half >>= 1, step <<= 1) {
+        for (int start = 0; start < N; start += half * 2) {
+            for (int k = 0; k < half; k++) {
+                int16_t* a = data + (start + k) * 2;
+                int16_t* b = data + (start + k + half) * 2;
+                int32_t re = a[0] - b[0];
+                int32_t im = a[1] - b[1];
+                a[0]       = (int16_t)((a[0] + b[0]) >> 1);
+                a[1]       = (int16_t)((a[1] + b[1]) >> 1);
+
+                int32_t wr = table[k * step * 2];
+                int32_t wi = table[k * step * 2 + 1];
+                b[0]       = (int16_t)((re * wr - im * wi) >> 16);
+                b[1]       = (int16_t)((re * wi + im * wr) >> 16);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t dsps_bit_rev_sc16_ansi(int16_t* data, int N)
+{
+    for (int i = 1, j = 0; i < N; i++) {
+        int bit = N >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i * 2], data[j * 2]);
+            std::swap(data[i * 2 + 1], data[j * 2 + 1]);
+        }
+    }
+    return ESP_OK;
+}
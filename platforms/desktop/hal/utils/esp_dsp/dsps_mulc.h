@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+/**
+ * @brief esp-dsp's Q15 multiply by a constant on the desktop, `output = data * C >> 15`
+ */
+inline esp_err_t dsps_mulc_s16(const int16_t* data, int16_t* output, int len, int16_t C, int step_in, int step_out)
+{
+    for (int i = 0; i < len; i++) {
+        output[i * step_out] = (int16_t)(((int32_t)data[i * step_in] * C) >> 15);
+    }
+    return ESP_OK;
+}
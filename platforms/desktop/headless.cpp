@@ -0,0 +1,258 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "headless.h"
+#include "hal/hal_desktop.h"
+#include "hal/hal_config.h"
+#include <app.h>
+#include <hal/hal.h>
+#include <mooncake_log.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const std::string _tag = "headless";
+
+// One step of the virtual clock per LVGL refresh period (LV_DEF_REFR_PERIOD)
+static constexpr uint32_t FRAME_MS         = 16;
+static constexpr uint32_t TAP_MS           = 100;   // Press to release
+static constexpr uint32_t SETTLED_MS       = 6000;  // Boot anim done, the radio view built and its dialogs prebuilt
+static constexpr uint32_t REPLAY_SETTLE_MS = 2000;  // Measured after a recording's last record
+
+// Centres of the controls as radio_view.cpp lays them out on the landscape screen
+static constexpr int CONTROLS_TOP = HAL_SCREEN_HEIGHT - 90;
+static constexpr int NEXT_X       = 80 + 400 - 30;
+static constexpr int NEXT_Y       = CONTROLS_TOP + 30;
+static constexpr int WIFI_X       = HAL_SCREEN_WIDTH - 150 + 65;
+static constexpr int WIFI_Y       = HAL_SCREEN_HEIGHT - 70 + 20;
+
+struct Tap_t {
+    uint32_t atMs;
+    int x;
+    int y;
+};
+
+struct Scenario_t {
+    const char* name;
+    const char* description;
+    uint32_t fromMs;  // Frames rendered in [fromMs, toMs) are measured
+    uint32_t toMs;
+    std::vector<Tap_t> taps;
+};
+
+static const std::vector<Scenario_t>& scenarios()
+{
+    static const std::vector<Scenario_t> s_scenarios = {
+        {"radio", "Radio view at steady state", SETTLED_MS, SETTLED_MS + 5000, {}},
+        {"wifi", "WiFi dialog opening and open", SETTLED_MS, SETTLED_MS + 5000, {{SETTLED_MS, WIFI_X, WIFI_Y}}},
+        {"switch",
+         "Three station switches with Next",
+         SETTLED_MS,
+         SETTLED_MS + 6000,
+         {{SETTLED_MS, NEXT_X, NEXT_Y}, {SETTLED_MS + 2000, NEXT_X, NEXT_Y}, {SETTLED_MS + 4000, NEXT_X, NEXT_Y}}},
+    };
+    return s_scenarios;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Report                                   */
+/* -------------------------------------------------------------------------- */
+static std::vector<PerfFrame_t> s_frames;
+static bool s_measuring = false;
+
+static void on_frame(const PerfFrame_t& frame)
+{
+    if (s_measuring) {
+        s_frames.push_back(frame);
+    }
+}
+
+struct Summary_t {
+    double mean = 0;
+    double p50  = 0;
+    double p95  = 0;
+    double max  = 0;
+};
+
+template <typename Fn>
+static Summary_t summarize(Fn value)
+{
+    Summary_t summary;
+    if (s_frames.empty()) {
+        return summary;
+    }
+    std::vector<double> values;
+    for (const auto& frame : s_frames) {
+        values.push_back(value(frame));
+        summary.mean += values.back();
+    }
+    std::sort(values.begin(), values.end());
+    summary.mean /= values.size();
+    summary.p50 = values[values.size() / 2];
+    summary.p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+    summary.max = values.back();
+    return summary;
+}
+
+static void write_json(FILE* file, const Scenario_t& scenario, const Summary_t& render, const Summary_t& flush,
+                       const Summary_t& redraw, const Summary_t& areas)
+{
+    auto summary = [file](const char* name, const Summary_t& s, const char* end) {
+        fprintf(file, "  \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f}%s\n", name, s.mean,
+                s.p50, s.p95, s.max, end);
+    };
+    fprintf(file, "{\n  \"scenario\": \"%s\",\n  \"frame_ms\": %u,\n  \"frames\": %zu,\n", scenario.name,
+            (unsigned)FRAME_MS, s_frames.size());
+    summary("render_ms", render, ",");
+    summary("flush_ms", flush, ",");
+    summary("redraw_percent", redraw, ",");
+    summary("areas", areas, ",");
+    fprintf(file, "  \"per_frame\": [\n");
+    for (size_t i = 0; i < s_frames.size(); i++) {
+        const PerfFrame_t& frame = s_frames[i];
+        fprintf(file, "    {\"render_us\": %lld, \"flush_us\": %lld, \"areas\": %u, \"pixels\": %u}%s\n",
+                (long long)frame.renderUs, (long long)frame.flushUs, (unsigned)frame.areas, (unsigned)frame.pixels,
+                i + 1 < s_frames.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Run                                     */
+/* -------------------------------------------------------------------------- */
+static void usage()
+{
+    fprintf(stderr, "usage: app_desktop_build --headless <scenario> [--json <file>] [--screenshot <file.ppm>]\n");
+    fprintf(stderr, "       app_desktop_build --headless replay --input <recording> [--json <file>] ...\n");
+    for (const auto& scenario : scenarios()) {
+        fprintf(stderr, "  %-8s %s\n", scenario.name, scenario.description);
+    }
+    fprintf(stderr, "  %-8s %s\n", "replay", "A recording made with --record, from its first press or key to its end");
+}
+
+bool headless_requested(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int headless_main(int argc, char** argv, const app::InitCallback_t& callback)
+{
+    const char* name       = nullptr;
+    const char* jsonPath   = nullptr;
+    const char* screenshot = nullptr;
+    const char* input      = nullptr;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0 && hasValue) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--screenshot") == 0 && hasValue) {
+            screenshot = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0 && hasValue) {
+            input = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    const Scenario_t* scenario = nullptr;
+    for (const auto& candidate : scenarios()) {
+        if (name && strcmp(candidate.name, name) == 0) {
+            scenario = &candidate;
+        }
+    }
+    // A recording replays on the clock it was recorded on, from the LVGL init
+    input_recording::Replayer replayer;
+    Scenario_t replay{};
+    if (name && strcmp(name, "replay") == 0 && input) {
+        if (!replayer.load(input) || replayer.size() == 0) {
+            mclog::tagError(_tag, "no recording in {}", input);
+            return 2;
+        }
+        uint32_t fromMs = std::max<uint32_t>(replayer.firstPressMs(), 1);
+        replay          = {"replay", input, fromMs, replayer.lastMs() + REPLAY_SETTLE_MS, {}};
+        scenario        = &replay;
+    }
+    if (!scenario) {
+        usage();
+        return 2;
+    }
+
+    // Sound effects still play, into nothing on machines without an audio device
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    headless_enable();
+    if (scenario == &replay) {
+        headless_replay(&replayer);
+    }
+    app::Init(callback);
+    perf_on_frame(on_frame);
+
+    // The app and LVGL take turns on this thread, one refresh period of virtual time apart
+    // Released where it was pressed, anywhere else LVGL takes it for a drag
+    int x = 0;
+    int y = 0;
+    for (uint32_t now = headless_millis(); now < scenario->toMs; now = headless_millis()) {
+        s_measuring = now >= scenario->fromMs;
+        if (scenario != &replay) {
+            bool pressed = false;
+            for (const auto& tap : scenario->taps) {
+                if (now >= tap.atMs && now < tap.atMs + TAP_MS) {
+                    x       = tap.x;
+                    y       = tap.y;
+                    pressed = true;
+                }
+            }
+            headless_pointer(x, y, pressed);
+        }
+
+        app::Update();
+        GetHAL()->lvglLock();
+        lv_timer_handler();
+        GetHAL()->lvglUnlock();
+        headless_advance(FRAME_MS);
+    }
+    s_measuring = false;
+
+    Summary_t render = summarize([](const PerfFrame_t& f) { return f.renderUs / 1000.0; });
+    Summary_t flush  = summarize([](const PerfFrame_t& f) { return f.flushUs / 1000.0; });
+    Summary_t redraw = summarize(
+        [](const PerfFrame_t& f) { return 100.0 * f.pixels / (HAL_SCREEN_WIDTH * HAL_SCREEN_HEIGHT); });
+    Summary_t areas  = summarize([](const PerfFrame_t& f) { return (double)f.areas; });
+    printf("%s: %zu frames over %u ms\n", scenario->name, s_frames.size(),
+           (unsigned)(scenario->toMs - scenario->fromMs));
+    printf("  render  mean %.2f ms  p50 %.2f  p95 %.2f  max %.2f\n", render.mean, render.p50, render.p95, render.max);
+    printf("  flush   mean %.2f ms  p50 %.2f  p95 %.2f  max %.2f\n", flush.mean, flush.p50, flush.p95, flush.max);
+    printf("  redraw  mean %.1f%%  p95 %.1f%%  max %.1f%%, %.1f areas a frame\n", redraw.mean, redraw.p95,
+           redraw.max, areas.mean);
+
+    int status = 0;
+    if (jsonPath) {
+        FILE* file = fopen(jsonPath, "w");
+        if (file) {
+            write_json(file, *scenario, render, flush, redraw, areas);
+            fclose(file);
+        } else {
+            mclog::tagError(_tag, "can't write {}", jsonPath);
+            status = 1;
+        }
+    }
+    if (screenshot && !headless_screenshot(screenshot)) {
+        mclog::tagError(_tag, "can't write {}", screenshot);
+        status = 1;
+    }
+
+    GetHAL()->stopRadioStream();
+    app::Destroy();
+    return status;
+}
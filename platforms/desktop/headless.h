@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <app.h>
+
+/**
+ * @brief UI benchmarks without a window: `app_desktop_build --headless <scenario> [--json <file>]`
+ *
+ * The app runs as usual, but LVGL renders into memory and time is virtual, one refresh period per step, with scripted
+ * taps for input. Every run renders the same frames, only how long they take varies. The stream is not opened
+ * unless RADIO_REPLAY names a capture. Prints a summary of the measured frames and optionally writes each of them
+ * as JSON, and the last frame as a PPM with `--screenshot`.
+ */
+bool headless_requested(int argc, char** argv);
+// @return the process exit code
+int headless_main(int argc, char** argv, const app::InitCallback_t& callback);
@@ -4,11 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_desktop.h"
+#include "headless.h"
 #include <app.h>
 #include <memory>
+#include <string.h>
 #include <hal/hal.h>
 
-int main()
+int main(int argc, char** argv)
 {
     // 应用层初始化回调
     app::InitCallback_t callback;
@@ -18,6 +20,16 @@ int main()
         hal::Inject(std::make_unique<HalDesktop>());
     };
 
+    if (headless_requested(argc, argv)) {
+        return headless_main(argc, argv, callback);
+    }
+    // --record <file>: the mouse and keyboard, for `--headless replay --input <file>`
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0) {
+            input_record(argv[i + 1]);
+        }
+    }
+
     // 启动应用层
     app::Init(callback);
     while (!app::IsDone()) {
@@ -183,17 +183,28 @@ static esp_err_t gc2145_write(esp_sccb_io_handle_t sccb_handle, uint8_t reg, uin
 }
 
 /* write a array of registers  */
+/* write a array of registers, each run of consecutive ones in a single burst */
 static esp_err_t gc2145_write_array(esp_sccb_io_handle_t sccb_handle, gc2145_reginfo_t *regarray, size_t regs_size)
 {
     int i         = 0;
     esp_err_t ret = ESP_OK;
     while ((ret == ESP_OK) && (i < regs_size)) {
-        if (regarray[i].reg != GC2145_REG_DELAY) {
-            ret = gc2145_write(sccb_handle, regarray[i].reg, regarray[i].val);
-        } else {
+        if (regarray[i].reg == GC2145_REG_DELAY) {
             delay_ms(regarray[i].val);
+            i++;
+            continue;
         }
-        i++;
+        // 0xfe switches the page, the registers after it are another page's. Written in order that's what they
+        // are meant to be
+        uint8_t vals[ESP_SCCB_BURST_MAX];
+        int n = 0;
+        do {
+            vals[n] = regarray[i + n].val;
+            n++;
+        } while (n < ESP_SCCB_BURST_MAX && i + n < regs_size && regarray[i + n].reg == regarray[i].reg + n &&
+                 regarray[i + n].reg < GC2145_REG_DELAY);
+        ret = esp_sccb_transmit_regs_a8v8(sccb_handle, regarray[i].reg, vals, n);
+        i += n;
     }
     ESP_LOGD(TAG, "Set array done[i=%d]", i);
     return ret;
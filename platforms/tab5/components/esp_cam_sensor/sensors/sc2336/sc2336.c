@@ -1344,18 +1344,26 @@ static esp_err_t sc2336_write(esp_sccb_io_handle_t sccb_handle, uint16_t reg, ui
     return esp_sccb_transmit_reg_a16v8(sccb_handle, reg, data);
 }
 
-/* write a array of registers  */
+/* write a array of registers, each run of consecutive ones in a single burst */
 static esp_err_t sc2336_write_array(esp_sccb_io_handle_t sccb_handle, sc2336_reginfo_t *regarray)
 {
     int i         = 0;
     esp_err_t ret = ESP_OK;
     while ((ret == ESP_OK) && regarray[i].reg != SC2336_REG_END) {
-        if (regarray[i].reg != SC2336_REG_DELAY) {
-            ret = sc2336_write(sccb_handle, regarray[i].reg, regarray[i].val);
-        } else {
+        if (regarray[i].reg == SC2336_REG_DELAY) {
             delay_ms(regarray[i].val);
+            i++;
+            continue;
         }
-        i++;
+        uint8_t vals[ESP_SCCB_BURST_MAX];
+        int n = 0;
+        do {
+            vals[n] = regarray[i + n].val;
+            n++;
+        } while (n < ESP_SCCB_BURST_MAX && regarray[i + n].reg == regarray[i].reg + n &&
+                 regarray[i + n].reg < SC2336_REG_DELAY);
+        ret = esp_sccb_transmit_regs_a16v8(sccb_handle, regarray[i].reg, vals, n);
+        i += n;
     }
     return ret;
 }
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 #include "esp_sccb_types.h"
 
@@ -63,6 +64,44 @@ esp_err_t esp_sccb_transmit_reg_a8v16(esp_sccb_io_handle_t io_handle, uint8_t re
  */
 esp_err_t esp_sccb_transmit_reg_a16v16(esp_sccb_io_handle_t io_handle, uint16_t reg_addr, uint16_t reg_val);
 
+/**
+ * @brief Values sent per burst transaction, a longer burst is split.
+ */
+#define ESP_SCCB_BURST_MAX 64
+
+/**
+ * @brief Perform one write transaction for a run of 8-bit registers from 8-bit reg_addr on.
+ *
+ * The sensor has to auto-increment the register address within a write, `reg_vals[i]` goes to `reg_addr + i`.
+ * One transaction replaces `count` single writes, the bus carries one byte per register instead of four.
+ *
+ * @param[in] handle SCCB IO handle
+ * @param[in] reg_addr first register address to send on the sccb bus.
+ * @param[in] reg_vals `count` values, the first for reg_addr.
+ * @param[in] count    Number of registers.
+ * @return
+ *      - ESP_OK: sccb transmit success
+ *      - ESP_ERR_INVALID_ARG: sccb transmit parameter invalid.
+ */
+esp_err_t esp_sccb_transmit_regs_a8v8(esp_sccb_io_handle_t io_handle, uint8_t reg_addr, const uint8_t *reg_vals,
+                                      size_t count);
+
+/**
+ * @brief Perform one write transaction for a run of 8-bit registers from 16-bit reg_addr on.
+ *
+ * As esp_sccb_transmit_regs_a8v8(), with a 16-bit register address.
+ *
+ * @param[in] handle SCCB IO handle
+ * @param[in] reg_addr first register address to send on the sccb bus.
+ * @param[in] reg_vals `count` values, the first for reg_addr.
+ * @param[in] count    Number of registers.
+ * @return
+ *      - ESP_OK: sccb transmit success
+ *      - ESP_ERR_INVALID_ARG: sccb transmit parameter invalid.
+ */
+esp_err_t esp_sccb_transmit_regs_a16v8(esp_sccb_io_handle_t io_handle, uint16_t reg_addr, const uint8_t *reg_vals,
+                                       size_t count);
+
 /**
  * @brief Perform a write-read transaction for 8-bit reg_addr and 8-bit reg_val.
  *
@@ -82,6 +82,52 @@ esp_err_t esp_sccb_transmit_reg_a16v16(esp_sccb_io_handle_t io_handle, uint16_t
     return ret;
 }
 
+esp_err_t esp_sccb_transmit_regs_a8v8(esp_sccb_io_handle_t io_handle, uint8_t reg_addr, const uint8_t *reg_vals,
+                                      size_t count)
+{
+    ESP_RETURN_ON_FALSE(io_handle, ESP_ERR_INVALID_ARG, TAG, "invalid argument: null pointer");
+    ESP_RETURN_ON_FALSE(io_handle->transmit_reg_a8v8, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "controller driver function not supported");
+    ESP_RETURN_ON_FALSE(reg_vals || !count, ESP_ERR_INVALID_ARG, TAG, "invalid argument: reg_vals null pointer");
+
+    // The controller sends whatever follows the address, the sensor stores it at consecutive registers
+    uint8_t data[1 + ESP_SCCB_BURST_MAX];
+    while (count > 0) {
+        size_t n = count < ESP_SCCB_BURST_MAX ? count : ESP_SCCB_BURST_MAX;
+        data[0]  = reg_addr & 0xff;
+        memcpy(&data[1], reg_vals, n);
+        ESP_RETURN_ON_ERROR(io_handle->transmit_reg_a8v8(io_handle, data, 1 + n, ESP_SCCB_TRANS_DEALY), TAG,
+                            "failed to transmit_regs_a8v8");
+        reg_addr += n;
+        reg_vals += n;
+        count -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_sccb_transmit_regs_a16v8(esp_sccb_io_handle_t io_handle, uint16_t reg_addr, const uint8_t *reg_vals,
+                                       size_t count)
+{
+    ESP_RETURN_ON_FALSE(io_handle, ESP_ERR_INVALID_ARG, TAG, "invalid argument: null pointer");
+    ESP_RETURN_ON_FALSE(io_handle->transmit_reg_a16v8, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "controller driver function not supported");
+    ESP_RETURN_ON_FALSE(reg_vals || !count, ESP_ERR_INVALID_ARG, TAG, "invalid argument: reg_vals null pointer");
+
+    uint8_t data[2 + ESP_SCCB_BURST_MAX];
+    while (count > 0) {
+        size_t n = count < ESP_SCCB_BURST_MAX ? count : ESP_SCCB_BURST_MAX;
+        data[0]  = (reg_addr & 0xff00) >> 8;
+        data[1]  = reg_addr & 0xff;
+        memcpy(&data[2], reg_vals, n);
+        ESP_RETURN_ON_ERROR(io_handle->transmit_reg_a16v8(io_handle, data, 2 + n, ESP_SCCB_TRANS_DEALY), TAG,
+                            "failed to transmit_regs_a16v8");
+        reg_addr += n;
+        reg_vals += n;
+        count -= n;
+    }
+    return ESP_OK;
+}
+
 esp_err_t esp_sccb_transmit_receive_reg_a8v8(esp_sccb_io_handle_t io_handle, uint8_t reg_addr, uint8_t *reg_val)
 {
     ESP_RETURN_ON_FALSE(io_handle, ESP_ERR_INVALID_ARG, TAG, "invalid argument: null pointer");
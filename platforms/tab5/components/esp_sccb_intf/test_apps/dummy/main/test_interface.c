@@ -8,6 +8,9 @@
 
 void test_op(esp_sccb_io_handle_t handle)
 {
+    const uint8_t vals[2] = {0, 0};
     esp_sccb_transmit_reg_a8v8(handle, 0, 0);
+    esp_sccb_transmit_regs_a8v8(handle, 0, vals, 2);
+    esp_sccb_transmit_regs_a16v8(handle, 0, vals, 2);
     esp_sccb_del_i2c_io(handle);
 }
@@ -24,6 +24,15 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Called from the ISR when the panel has scanned out a frame
+ *
+ * @param disp LVGL display
+ * @param user_ctx User context passed to lvgl_port_disp_register_refresh_cb
+ * @return Whether a higher priority task has been woken
+ */
+typedef bool (*lvgl_port_refresh_cb_t)(lv_display_t *disp, void *user_ctx);
+
 /**
  * @brief Rotation configuration
  */
@@ -137,6 +146,21 @@ lv_display_t *lvgl_port_add_disp_rgb(const lvgl_port_display_cfg_t *disp_cfg,
  */
 esp_err_t lvgl_port_remove_disp(lv_display_t *disp);
 
+/**
+ * @brief Call back once per panel refresh, to pace work to the display
+ *
+ * @note Only MIPI-DSI displays report their refresh, the callback runs in ISR context.
+ *
+ * @param disp LVGL display
+ * @param cb Callback, NULL to remove it
+ * @param user_ctx Passed to the callback
+ * @return
+ *      - ESP_OK                    on success
+ *      - ESP_ERR_INVALID_ARG       if the display is not a port display
+ *      - ESP_ERR_NOT_SUPPORTED     if the display doesn't report its refresh
+ */
+esp_err_t lvgl_port_disp_register_refresh_cb(lv_display_t *disp, lvgl_port_refresh_cb_t cb, void *user_ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,9 @@ extern "C" {
  *      DEFINES
  *********************/
 
+// The esp32p4 kernels are opt-in (CONFIG_LVGL_PORT_PIE_KERNELS), LVGL's C loops render until they're enabled
+#if !CONFIG_IDF_TARGET_ESP32P4 || CONFIG_LVGL_PORT_PIE_KERNELS
+
 #ifndef LV_DRAW_SW_COLOR_BLEND_TO_ARGB8888
 #define LV_DRAW_SW_COLOR_BLEND_TO_ARGB8888(dsc) _lv_color_blend_to_argb8888_esp(dsc)
 #endif
@@ -30,18 +33,45 @@ extern "C" {
 #define LV_DRAW_SW_COLOR_BLEND_TO_RGB565(dsc) _lv_color_blend_to_rgb565_esp(dsc)
 #endif
 
+#if !CONFIG_IDF_TARGET_ESP32P4  // No RGB888 kernel for esp32p4 yet, LVGL's C loop fills those
 #ifndef LV_DRAW_SW_COLOR_BLEND_TO_RGB888
 #define LV_DRAW_SW_COLOR_BLEND_TO_RGB888(dsc, dest_px_size) _lv_color_blend_to_rgb888_esp(dsc, dest_px_size)
 #endif
+#endif
 
 #ifndef LV_DRAW_SW_RGB565_BLEND_NORMAL_TO_RGB565
 #define LV_DRAW_SW_RGB565_BLEND_NORMAL_TO_RGB565(dsc) _lv_rgb565_blend_normal_to_rgb565_esp(dsc)
 #endif
 
+#if CONFIG_LVGL_PORT_PIE_MIX_KERNEL  // Translucent fills, glyphs and anti-aliased edges: one kernel for all three
+#ifndef LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_OPA
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_OPA(dsc) _lv_color_blend_to_rgb565_mix_esp(dsc)
+#endif
+
+#ifndef LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_MASK
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_MASK(dsc) _lv_color_blend_to_rgb565_mix_esp(dsc)
+#endif
+
+#ifndef LV_DRAW_SW_COLOR_BLEND_TO_RGB565_MIX_MASK_OPA
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565_MIX_MASK_OPA(dsc) _lv_color_blend_to_rgb565_mix_esp(dsc)
+#endif
+#endif
+
+#endif  // !CONFIG_IDF_TARGET_ESP32P4 || CONFIG_LVGL_PORT_PIE_KERNELS
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+// LVGL 9.2 dropped the leading underscore of the blend descriptors, the build defines this for 9.2 and newer
+#if ESP_LVGL_PORT_BLEND_LVGL_9_2
+typedef lv_draw_sw_blend_fill_dsc_t esp_blend_fill_dsc_t;
+typedef lv_draw_sw_blend_image_dsc_t esp_blend_image_dsc_t;
+#else
+typedef _lv_draw_sw_blend_fill_dsc_t esp_blend_fill_dsc_t;
+typedef _lv_draw_sw_blend_image_dsc_t esp_blend_image_dsc_t;
+#endif
+
 typedef struct {
     uint32_t opa;
     void *dst_buf;
@@ -60,7 +90,7 @@ typedef struct {
 
 extern int lv_color_blend_to_argb8888_esp(asm_dsc_t *asm_dsc);
 
-static inline lv_result_t _lv_color_blend_to_argb8888_esp(_lv_draw_sw_blend_fill_dsc_t *dsc)
+static inline lv_result_t _lv_color_blend_to_argb8888_esp(esp_blend_fill_dsc_t *dsc)
 {
     asm_dsc_t asm_dsc = {
         .dst_buf    = dsc->dest_buf,
@@ -75,7 +105,7 @@ static inline lv_result_t _lv_color_blend_to_argb8888_esp(_lv_draw_sw_blend_fill
 
 extern int lv_color_blend_to_rgb565_esp(asm_dsc_t *asm_dsc);
 
-static inline lv_result_t _lv_color_blend_to_rgb565_esp(_lv_draw_sw_blend_fill_dsc_t *dsc)
+static inline lv_result_t _lv_color_blend_to_rgb565_esp(esp_blend_fill_dsc_t *dsc)
 {
     asm_dsc_t asm_dsc = {
         .dst_buf    = dsc->dest_buf,
@@ -88,9 +118,27 @@ static inline lv_result_t _lv_color_blend_to_rgb565_esp(_lv_draw_sw_blend_fill_d
     return lv_color_blend_to_rgb565_esp(&asm_dsc);
 }
 
+extern int lv_color_blend_to_rgb565_mix_esp(asm_dsc_t *asm_dsc);
+
+static inline lv_result_t _lv_color_blend_to_rgb565_mix_esp(esp_blend_fill_dsc_t *dsc)
+{
+    asm_dsc_t asm_dsc = {
+        .opa         = dsc->opa,
+        .dst_buf     = dsc->dest_buf,
+        .dst_w       = dsc->dest_w,
+        .dst_h       = dsc->dest_h,
+        .dst_stride  = dsc->dest_stride,
+        .src_buf     = &dsc->color,
+        .mask_buf    = dsc->mask_buf,
+        .mask_stride = dsc->mask_stride,
+    };
+
+    return lv_color_blend_to_rgb565_mix_esp(&asm_dsc);
+}
+
 extern int lv_color_blend_to_rgb888_esp(asm_dsc_t *asm_dsc);
 
-static inline lv_result_t _lv_color_blend_to_rgb888_esp(_lv_draw_sw_blend_fill_dsc_t *dsc, uint32_t dest_px_size)
+static inline lv_result_t _lv_color_blend_to_rgb888_esp(esp_blend_fill_dsc_t *dsc, uint32_t dest_px_size)
 {
     if (dest_px_size != 3) {
         return LV_RESULT_INVALID;
@@ -108,7 +156,7 @@ static inline lv_result_t _lv_color_blend_to_rgb888_esp(_lv_draw_sw_blend_fill_d
 
 extern int lv_rgb565_blend_normal_to_rgb565_esp(asm_dsc_t *asm_dsc);
 
-static inline lv_result_t _lv_rgb565_blend_normal_to_rgb565_esp(_lv_draw_sw_blend_image_dsc_t *dsc)
+static inline lv_result_t _lv_rgb565_blend_normal_to_rgb565_esp(esp_blend_image_dsc_t *dsc)
 {
     asm_dsc_t asm_dsc = {.dst_buf    = dsc->dest_buf,
                          .dst_w      = dsc->dest_w,
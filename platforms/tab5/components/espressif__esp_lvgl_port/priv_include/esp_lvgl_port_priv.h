@@ -11,6 +11,9 @@
 
 #pragma once
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,6 +32,7 @@ typedef enum {
  */
 typedef struct {
     unsigned int avoid_tearing : 1; /*!< Use internal RGB buffers as a LVGL draw buffers to avoid tearing effect */
+    unsigned int rotate_async : 1;  /*!< Rotate with PPA in the background, through a pool of rotated tiles */
 } lvgl_port_disp_priv_cfg_t;
 
 /**
@@ -42,6 +46,11 @@ typedef struct {
  */
 bool lvgl_port_task_notify(uint32_t value);
 
+/**
+ * @brief LVGL task handle, tasks working for the display run at its priority and on its core
+ */
+TaskHandle_t lvgl_port_get_task(void);
+
 #ifdef __cplusplus
 }
 #endif
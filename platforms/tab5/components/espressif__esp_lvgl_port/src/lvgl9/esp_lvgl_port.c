@@ -216,6 +216,11 @@ IRAM_ATTR bool lvgl_port_task_notify(uint32_t value)
     return (need_yield == pdTRUE);
 }
 
+TaskHandle_t lvgl_port_get_task(void)
+{
+    return lvgl_port_ctx.lvgl_task;
+}
+
 /*******************************************************************************
  * Private functions
  *******************************************************************************/
@@ -46,12 +46,26 @@ static size_t data_cache_line_size        = 0;
 #define CONFIG_LV_DRAW_BUF_ALIGN 1
 #endif
 
+#if (CONFIG_IDF_TARGET_ESP32P4 && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+#define LVGL_PORT_ROTATE_ASYNC 1
+#else
+#define LVGL_PORT_ROTATE_ASYNC 0
+#endif
+#define LVGL_PORT_ROTATE_TILES      (2) /* Rotated tiles: the DSI copies one out while PPA fills the next */
+#define LVGL_PORT_ROTATE_TASK_STACK (3072)
+
 static const char* TAG = "LVGL";
 
 /*******************************************************************************
  * Types definitions
  *******************************************************************************/
 
+typedef struct {
+    lv_display_t* disp; /* Display the tile belongs to */
+    uint8_t* buf;       /* Rotated pixels, cache line aligned for PPA */
+    lv_area_t area;     /* Where the tile goes on the panel */
+} lvgl_port_rotate_tile_t;
+
 typedef struct {
     lvgl_port_disp_type_t disp_type;       /* Display type */
     esp_lcd_panel_io_handle_t io_handle;   /* LCD panel IO handle */
@@ -63,6 +77,17 @@ typedef struct {
     lv_display_t* disp_drv; /* LVGL display driver */
     lv_display_rotation_t current_rotation;
     SemaphoreHandle_t trans_sem; /* Idle transfer mutex */
+    struct {
+        lvgl_port_refresh_cb_t cb; /* Called from the ISR once per panel refresh */
+        void* user_ctx;
+    } refresh;
+    struct {
+        lvgl_port_rotate_tile_t tiles[LVGL_PORT_ROTATE_TILES];
+        QueueHandle_t free_tiles;   /* Tile indices PPA may rotate into */
+        QueueHandle_t done_tiles;   /* Tile indices rotated, waiting for the DSI */
+        SemaphoreHandle_t draw_sem; /* Given when the DSI has copied a tile out */
+        TaskHandle_t task;          /* Hands rotated tiles to the DSI, NULL if rotating in the flush callback */
+    } rotate;
     struct {
         unsigned int monochrome : 1;   /* True, if display is monochrome and using 1bit for 1px */
         unsigned int swap_bytes : 1;   /* Swap bytes in RGB656 (16-bit) before send to LCD driver */
@@ -95,6 +120,13 @@ static void lvgl_port_flush_callback(lv_display_t* drv, const lv_area_t* area, u
 static void lvgl_port_disp_size_update_callback(lv_event_t* e);
 static void lvgl_port_disp_rotation_update(lvgl_port_display_ctx_t* disp_ctx);
 static void lvgl_port_display_invalidate_callback(lv_event_t* e);
+#if LVGL_PORT_ROTATE_ASYNC
+static esp_err_t lvgl_port_rotate_init(lvgl_port_display_ctx_t* disp_ctx, size_t tile_size);
+static void lvgl_port_rotate_deinit(lvgl_port_display_ctx_t* disp_ctx);
+static bool lvgl_port_rotate_done_callback(ppa_client_handle_t ppa_client, ppa_event_data_t* event_data,
+                                           void* user_data);
+static void lvgl_port_rotate_task(void* arg);
+#endif
 
 /*******************************************************************************
  * Public API functions
@@ -137,10 +169,17 @@ lv_display_t* lvgl_port_add_disp_dsi(const lvgl_port_display_cfg_t* disp_cfg,
     };
     ESP_ERROR_CHECK(ppa_register_client(&ppa_srm_config, &ppa_srm_handle));
     ESP_ERROR_CHECK(esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &data_cache_line_size));
+#if LVGL_PORT_ROTATE_ASYNC
+    ppa_event_callbacks_t ppa_cbs = {
+        .on_trans_done = lvgl_port_rotate_done_callback,
+    };
+    ESP_ERROR_CHECK(ppa_client_register_event_callbacks(ppa_srm_handle, &ppa_cbs));
+#endif
 
     assert(dsi_cfg != NULL);
     const lvgl_port_disp_priv_cfg_t priv_cfg = {
         .avoid_tearing = dsi_cfg->flags.avoid_tearing,
+        .rotate_async  = LVGL_PORT_ROTATE_ASYNC,
     };
     lvgl_port_lock(0);
     lv_disp_t* disp = lvgl_port_add_disp_priv(disp_cfg, &priv_cfg);
@@ -151,10 +190,10 @@ lv_display_t* lvgl_port_add_disp_dsi(const lvgl_port_display_cfg_t* disp_cfg,
         disp_ctx->disp_type = LVGL_PORT_DISP_TYPE_DSI;
 
 #if (CONFIG_IDF_TARGET_ESP32P4 && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+        /* Refresh done is also what lvgl_port_disp_register_refresh_cb hooks into */
         esp_lcd_dpi_panel_event_callbacks_t cbs = {0};
-        if (dsi_cfg->flags.avoid_tearing) {
-            cbs.on_refresh_done = lvgl_port_flush_dpi_vsync_ready_callback;
-        } else {
+        cbs.on_refresh_done                     = lvgl_port_flush_dpi_vsync_ready_callback;
+        if (!dsi_cfg->flags.avoid_tearing) {
             cbs.on_color_trans_done = lvgl_port_flush_dpi_panel_ready_callback;
         }
         /* Register done callback */
@@ -217,6 +256,26 @@ lv_display_t* lvgl_port_add_disp_rgb(const lvgl_port_display_cfg_t* disp_cfg,
     return disp;
 }
 
+esp_err_t lvgl_port_disp_register_refresh_cb(lv_display_t* disp, lvgl_port_refresh_cb_t cb, void* user_ctx)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    lvgl_port_display_ctx_t* disp_ctx = (lvgl_port_display_ctx_t*)lv_display_get_driver_data(disp);
+    ESP_RETURN_ON_FALSE(disp_ctx, ESP_ERR_INVALID_ARG, TAG, "not a port display");
+#if (CONFIG_IDF_TARGET_ESP32P4 && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+    ESP_RETURN_ON_FALSE(disp_ctx->disp_type == LVGL_PORT_DISP_TYPE_DSI, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "only MIPI-DSI displays report their refresh");
+
+    /* Registered once at start, before the hook has anything to pace */
+    disp_ctx->refresh.user_ctx = user_ctx;
+    disp_ctx->refresh.cb       = cb;
+    return ESP_OK;
+#else
+    (void)cb;
+    (void)user_ctx;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 esp_err_t lvgl_port_remove_disp(lv_display_t* disp)
 {
     assert(disp);
@@ -226,6 +285,10 @@ esp_err_t lvgl_port_remove_disp(lv_display_t* disp)
     lv_disp_remove(disp);
     lvgl_port_unlock();
 
+#if LVGL_PORT_ROTATE_ASYNC
+    lvgl_port_rotate_deinit(disp_ctx);
+#endif
+
     if (disp_ctx->draw_buffs[0]) {
         free(disp_ctx->draw_buffs[0]);
     }
@@ -420,13 +483,28 @@ static lv_display_t* lvgl_port_add_disp_priv(const lvgl_port_display_cfg_t* disp
 
     /* Use SW rotation */
     if (disp_cfg->flags.sw_rotate) {
-        disp_ctx->draw_buffs[2] = heap_caps_malloc(buffer_size * color_bytes, buff_caps);
-        ESP_GOTO_ON_FALSE(disp_ctx->draw_buffs[2], ESP_ERR_NO_MEM, err, TAG,
-                          "Not enough memory for LVGL buffer (rotation buffer) allocation!");
+#if LVGL_PORT_ROTATE_ASYNC
+        /* Partial refresh only: tiles go out one by one, not as the whole frame buffer */
+        if (priv_cfg && priv_cfg->rotate_async && !disp_ctx->flags.monochrome && !disp_ctx->flags.direct_mode &&
+            !disp_ctx->flags.full_refresh) {
+            ESP_GOTO_ON_ERROR(lvgl_port_rotate_init(disp_ctx, buffer_size * color_bytes), err, TAG,
+                              "Not enough memory for LVGL buffer (rotated tiles) allocation!");
+        } else
+#endif
+        {
+            disp_ctx->draw_buffs[2] = heap_caps_malloc(buffer_size * color_bytes, buff_caps);
+            ESP_GOTO_ON_FALSE(disp_ctx->draw_buffs[2], ESP_ERR_NO_MEM, err, TAG,
+                              "Not enough memory for LVGL buffer (rotation buffer) allocation!");
+        }
     }
 
 err:
     if (ret != ESP_OK) {
+#if LVGL_PORT_ROTATE_ASYNC
+        if (disp_ctx) {
+            lvgl_port_rotate_deinit(disp_ctx);
+        }
+#endif
         if (disp_ctx->draw_buffs[0]) {
             free(disp_ctx->draw_buffs[0]);
         }
@@ -466,6 +544,15 @@ static bool lvgl_port_flush_dpi_panel_ready_callback(esp_lcd_panel_handle_t pane
 {
     lv_display_t* disp_drv = (lv_display_t*)user_ctx;
     assert(disp_drv != NULL);
+    lvgl_port_display_ctx_t* disp_ctx = (lvgl_port_display_ctx_t*)lv_display_get_driver_data(disp_drv);
+
+    /* A rotated tile was copied out, LVGL got its buffer back when PPA finished */
+    if (disp_ctx && disp_ctx->rotate.task) {
+        BaseType_t need_yield = pdFALSE;
+        xSemaphoreGiveFromISR(disp_ctx->rotate.draw_sem, &need_yield);
+        return (need_yield == pdTRUE);
+    }
+
     lv_disp_flush_ready(disp_drv);
     return false;
 }
@@ -484,6 +571,11 @@ static bool lvgl_port_flush_dpi_vsync_ready_callback(esp_lcd_panel_handle_t pane
         xSemaphoreGiveFromISR(disp_ctx->trans_sem, &need_yield);
     }
 
+    lvgl_port_refresh_cb_t refresh_cb = disp_ctx->refresh.cb;
+    if (refresh_cb && refresh_cb(disp_drv, disp_ctx->refresh.user_ctx)) {
+        need_yield = pdTRUE;
+    }
+
     return (need_yield == pdTRUE);
 }
 #endif
@@ -607,8 +699,9 @@ void lvgl_port_rotate_area(lv_display_t* disp, lv_area_t* area)
     }
 }
 
-IRAM_ATTR static void rotate_copy_pixel(const uint16_t* from, uint16_t* to, uint16_t x_start, uint16_t y_start,
-                                        uint16_t x_end, uint16_t y_end, uint16_t w, uint16_t h, uint16_t rotation)
+IRAM_ATTR static esp_err_t rotate_copy_pixel(const uint16_t* from, uint16_t* to, uint16_t x_start, uint16_t y_start,
+                                             uint16_t x_end, uint16_t y_end, uint16_t w, uint16_t h, uint16_t rotation,
+                                             ppa_trans_mode_t mode, void* user_data, bool byte_swap)
 {
     ppa_srm_rotation_angle_t ppa_rotation;
     int x_offset = 0, y_offset = 0;
@@ -647,7 +740,7 @@ IRAM_ATTR static void rotate_copy_pixel(const uint16_t* from, uint16_t* to, uint
         .in.srm_cm         = (LV_COLOR_DEPTH == 24) ? PPA_SRM_COLOR_MODE_RGB888 : PPA_SRM_COLOR_MODE_RGB565,
 
         .out.buffer      = to,
-        .out.buffer_size = ALIGN_UP_BY(sizeof(lv_color_t) * w * h, data_cache_line_size),
+        .out.buffer_size = ALIGN_UP_BY((LV_COLOR_DEPTH / 8) * w * h, data_cache_line_size),
         .out.pic_w = (ppa_rotation == PPA_SRM_ROTATION_ANGLE_90 || ppa_rotation == PPA_SRM_ROTATION_ANGLE_270) ? h : w,
         .out.pic_h = (ppa_rotation == PPA_SRM_ROTATION_ANGLE_90 || ppa_rotation == PPA_SRM_ROTATION_ANGLE_270) ? w : h,
         .out.block_offset_x = x_offset,
@@ -658,11 +751,12 @@ IRAM_ATTR static void rotate_copy_pixel(const uint16_t* from, uint16_t* to, uint
         .scale_x        = 1.0,
         .scale_y        = 1.0,
         .rgb_swap       = 0,
-        .byte_swap      = 0,
-        .mode           = PPA_TRANS_MODE_BLOCKING,
+        .byte_swap      = byte_swap,
+        .mode           = mode,
+        .user_data      = user_data,
     };
 
-    ESP_ERROR_CHECK(ppa_do_scale_rotate_mirror(ppa_srm_handle, &oper_config));
+    return ppa_do_scale_rotate_mirror(ppa_srm_handle, &oper_config);
 }
 
 static void lvgl_port_flush_callback(lv_display_t* drv, const lv_area_t* area, uint8_t* color_map)
@@ -680,6 +774,26 @@ static void lvgl_port_flush_callback(lv_display_t* drv, const lv_area_t* area, u
 
     // printf("%d %d %d %d\n", offsetx1, offsetx2, offsety1, offsety2);
 
+#if LVGL_PORT_ROTATE_ASYNC
+    /* PPA rotates into a free tile in the background, its done callback hands the render buffer back to LVGL and
+     * the tile on to the DSI, so LVGL renders the next area meanwhile. Every flush takes this path, also at
+     * rotation 0, the panel's done callback only ever stands for a tile here. */
+    if (disp_ctx->rotate.task) {
+        uint8_t index = 0;
+        xQueueReceive(disp_ctx->rotate.free_tiles, &index, portMAX_DELAY);
+        lvgl_port_rotate_tile_t* tile = &disp_ctx->rotate.tiles[index];
+        tile->area                    = *area;
+        lvgl_port_rotate_area(drv, &tile->area);
+
+        /* rotate_copy_pixel() takes PPA's counterclockwise angles */
+        uint16_t rotation = (360 - disp_ctx->current_rotation * 90) % 360;
+        ESP_ERROR_CHECK(rotate_copy_pixel((uint16_t*)color_map, (uint16_t*)tile->buf, 0, 0, offsetx2 - offsetx1,
+                                          offsety2 - offsety1, offsetx2 - offsetx1 + 1, offsety2 - offsety1 + 1,
+                                          rotation, PPA_TRANS_MODE_NON_BLOCKING, tile, disp_ctx->flags.swap_bytes));
+        return;
+    }
+#endif
+
     /* SW rotation enabled */
     if (disp_ctx->flags.sw_rotate && (disp_ctx->current_rotation > LV_DISPLAY_ROTATION_0)) {
         /* SW rotation */
@@ -698,8 +812,9 @@ static void lvgl_port_flush_callback(lv_display_t* drv, const lv_area_t* area, u
                 //                   LV_DISPLAY_ROTATION_90, cf);
                 // rotate_copy_pixel((uint16_t*)color_map, (uint16_t*)disp_ctx->draw_buffs[2], offsetx1, offsety1,
                 //                   offsetx2, offsety2, LV_HOR_RES, LV_VER_RES, 270);
-                rotate_copy_pixel((uint16_t*)color_map, (uint16_t*)disp_ctx->draw_buffs[2], 0, 0, offsetx2 - offsetx1,
-                                  offsety2 - offsety1, offsetx2 - offsetx1 + 1, offsety2 - offsety1 + 1, 270);
+                ESP_ERROR_CHECK(rotate_copy_pixel((uint16_t*)color_map, (uint16_t*)disp_ctx->draw_buffs[2], 0, 0,
+                                                  offsetx2 - offsetx1, offsety2 - offsety1, offsetx2 - offsetx1 + 1,
+                                                  offsety2 - offsety1 + 1, 270, PPA_TRANS_MODE_BLOCKING, NULL, false));
             } else if (disp_ctx->current_rotation == LV_DISPLAY_ROTATION_270) {
                 lv_draw_sw_rotate(color_map, disp_ctx->draw_buffs[2], ww, hh, w_stride, h_stride,
                                   LV_DISPLAY_ROTATION_270, cf);
@@ -729,9 +844,13 @@ static void lvgl_port_flush_callback(lv_display_t* drv, const lv_area_t* area, u
             /* If the interface is I80 or SPI, this step cannot be used for drawing. */
             esp_lcd_panel_draw_bitmap(disp_ctx->panel_handle, 0, 0, lv_disp_get_hor_res(drv), lv_disp_get_ver_res(drv),
                                       color_map);
-            /* Waiting for the last frame buffer to complete transmission */
-            // xSemaphoreTake(disp_ctx->trans_sem, 0);
-            // xSemaphoreTake(disp_ctx->trans_sem, portMAX_DELAY);
+            /* color_map is one of the panel's frame buffers: nothing was copied, the panel scans it out from the
+             * next frame on. The one LVGL renders into next is scanned out until then, wait for that frame to
+             * end (a refresh done may be pending from before the swap, hence the first take) */
+            if (disp_ctx->trans_sem) {
+                xSemaphoreTake(disp_ctx->trans_sem, 0);
+                xSemaphoreTake(disp_ctx->trans_sem, portMAX_DELAY);
+            }
         }
     } else {
         esp_lcd_panel_draw_bitmap(disp_ctx->panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, color_map);
@@ -874,3 +993,105 @@ static void lvgl_port_display_invalidate_callback(lv_event_t* e)
     /* Wake LVGL task, if needed */
     lvgl_port_task_wake(LVGL_PORT_EVENT_DISPLAY, NULL);
 }
+
+#if LVGL_PORT_ROTATE_ASYNC
+static esp_err_t lvgl_port_rotate_init(lvgl_port_display_ctx_t* disp_ctx, size_t tile_size)
+{
+    esp_err_t ret = ESP_OK;
+    tile_size     = ALIGN_UP_BY(tile_size, data_cache_line_size);
+
+    disp_ctx->rotate.free_tiles = xQueueCreate(LVGL_PORT_ROTATE_TILES, sizeof(uint8_t));
+    disp_ctx->rotate.done_tiles = xQueueCreate(LVGL_PORT_ROTATE_TILES, sizeof(uint8_t));
+    disp_ctx->rotate.draw_sem   = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(disp_ctx->rotate.free_tiles && disp_ctx->rotate.done_tiles && disp_ctx->rotate.draw_sem,
+                      ESP_ERR_NO_MEM, err, TAG, "Failed to create rotation queues");
+
+    for (uint8_t i = 0; i < LVGL_PORT_ROTATE_TILES; i++) {
+        lvgl_port_rotate_tile_t* tile = &disp_ctx->rotate.tiles[i];
+        tile->disp                    = disp_ctx->disp_drv;
+        tile->buf = heap_caps_aligned_calloc(data_cache_line_size, 1, tile_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(tile->buf, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for rotated tile %d", i);
+        xQueueSend(disp_ctx->rotate.free_tiles, &i, 0);
+    }
+
+    /* Next to the LVGL task, it only waits on the DSI and never holds the core for long */
+    TaskHandle_t lvgl_task = lvgl_port_get_task();
+    BaseType_t res =
+        xTaskCreatePinnedToCore(lvgl_port_rotate_task, "taskLVGLRotate", LVGL_PORT_ROTATE_TASK_STACK, disp_ctx,
+                                uxTaskPriorityGet(lvgl_task), &disp_ctx->rotate.task, xTaskGetCoreID(lvgl_task));
+    ESP_GOTO_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Failed to create rotation task");
+    return ESP_OK;
+
+err:
+    lvgl_port_rotate_deinit(disp_ctx);
+    return ret;
+}
+
+static void lvgl_port_rotate_deinit(lvgl_port_display_ctx_t* disp_ctx)
+{
+    if (disp_ctx->rotate.task) {
+        /* Wait for the tiles in flight to come back */
+        uint8_t index = 0;
+        for (int i = 0; i < LVGL_PORT_ROTATE_TILES; i++) {
+            xQueueReceive(disp_ctx->rotate.free_tiles, &index, pdMS_TO_TICKS(100));
+        }
+        vTaskDelete(disp_ctx->rotate.task);
+        disp_ctx->rotate.task = NULL;
+    }
+    for (int i = 0; i < LVGL_PORT_ROTATE_TILES; i++) {
+        if (disp_ctx->rotate.tiles[i].buf) {
+            free(disp_ctx->rotate.tiles[i].buf);
+            disp_ctx->rotate.tiles[i].buf = NULL;
+        }
+    }
+    if (disp_ctx->rotate.free_tiles) {
+        vQueueDelete(disp_ctx->rotate.free_tiles);
+        disp_ctx->rotate.free_tiles = NULL;
+    }
+    if (disp_ctx->rotate.done_tiles) {
+        vQueueDelete(disp_ctx->rotate.done_tiles);
+        disp_ctx->rotate.done_tiles = NULL;
+    }
+    if (disp_ctx->rotate.draw_sem) {
+        vSemaphoreDelete(disp_ctx->rotate.draw_sem);
+        disp_ctx->rotate.draw_sem = NULL;
+    }
+}
+
+static bool lvgl_port_rotate_done_callback(ppa_client_handle_t ppa_client, ppa_event_data_t* event_data,
+                                           void* user_data)
+{
+    /* Blocking rotations carry no tile */
+    lvgl_port_rotate_tile_t* tile = (lvgl_port_rotate_tile_t*)user_data;
+    if (tile == NULL) {
+        return false;
+    }
+
+    BaseType_t need_yield             = pdFALSE;
+    lvgl_port_display_ctx_t* disp_ctx = (lvgl_port_display_ctx_t*)lv_display_get_driver_data(tile->disp);
+    uint8_t index                     = tile - disp_ctx->rotate.tiles;
+    xQueueSendFromISR(disp_ctx->rotate.done_tiles, &index, &need_yield);
+
+    /* PPA has read the render buffer, LVGL may draw the next area into it */
+    lv_disp_flush_ready(tile->disp);
+
+    return (need_yield == pdTRUE);
+}
+
+static void lvgl_port_rotate_task(void* arg)
+{
+    lvgl_port_display_ctx_t* disp_ctx = (lvgl_port_display_ctx_t*)arg;
+    uint8_t index                     = 0;
+
+    while (1) {
+        xQueueReceive(disp_ctx->rotate.done_tiles, &index, portMAX_DELAY);
+        lvgl_port_rotate_tile_t* tile = &disp_ctx->rotate.tiles[index];
+        esp_lcd_panel_draw_bitmap(disp_ctx->panel_handle, tile->area.x1, tile->area.y1, tile->area.x2 + 1,
+                                  tile->area.y2 + 1, tile->buf);
+
+        /* One copy at a time, the panel's done callback doesn't say which tile it finished */
+        xSemaphoreTake(disp_ctx->rotate.draw_sem, portMAX_DELAY);
+        xQueueSend(disp_ctx->rotate.free_tiles, &index, portMAX_DELAY);
+    }
+}
+#endif
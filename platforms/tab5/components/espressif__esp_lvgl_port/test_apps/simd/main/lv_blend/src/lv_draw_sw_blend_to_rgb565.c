@@ -248,7 +248,7 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_color_to_rgb565(_lv_draw_sw_blend_fi
     }
     /*Opacity only*/
     else if (mask == NULL && opa < LV_OPA_MAX) {
-        if (LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_OPA(dsc)) {
+        if (!dsc->use_asm || LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_OPA(dsc)) {
             uint32_t last_dest32_color = dest_buf_u16[0] + 1; /*Set to value which is not equal to the first pixel*/
             uint32_t last_res32_color  = 0;
 
@@ -289,7 +289,7 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_color_to_rgb565(_lv_draw_sw_blend_fi
 
     /*Masked with full opacity*/
     else if (mask && opa >= LV_OPA_MAX) {
-        if (LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_MASK(dsc)) {
+        if (!dsc->use_asm || LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_MASK(dsc)) {
             for (y = 0; y < h; y++) {
                 x = 0;
                 if ((lv_uintptr_t)(mask)&0x1) {
@@ -319,7 +319,7 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_color_to_rgb565(_lv_draw_sw_blend_fi
     }
     /*Masked with opacity*/
     else if (mask && opa < LV_OPA_MAX) {
-        if (LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_MIX_MASK_OPA(dsc)) {
+        if (!dsc->use_asm || LV_RESULT_INVALID == LV_DRAW_SW_COLOR_BLEND_TO_RGB565_MIX_MASK_OPA(dsc)) {
             for (y = 0; y < h; y++) {
                 for (x = 0; x < w; x++) {
                     dest_buf_u16[x] = lv_color_16_16_mix(color16, dest_buf_u16[x], LV_OPA_MIX2(mask[x], opa));
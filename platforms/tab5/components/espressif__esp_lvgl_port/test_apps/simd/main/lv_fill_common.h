@@ -53,6 +53,8 @@ typedef struct {
     unsigned int dest_h;        // Destination buffer height
     unsigned int dest_stride;   // Destination buffer stride
     unsigned int unalign_byte;  // Destination buffer memory unalignment
+    lv_opa_t opa;               // Fill opacity, 0 for LV_OPA_MAX
+    bool masked;                // Fill through a mask of transparent, opaque and partly covered runs
 } func_test_case_params_t;
 
 /**
@@ -67,6 +69,8 @@ typedef struct {
     unsigned int benchmark_cycles;  // Count of benchmark cycles
     void *array_align16;            // test array with 16 byte alignment - testing most ideal case
     void *array_align1;             // test array with 1 byte alignment - testing worst case
+    lv_opa_t opa;                   // Fill opacity, 0 for LV_OPA_MAX
+    const lv_opa_t *mask_buf;       // Mask of the test array, its stride the array's width, NULL for none
     void (*blend_api_func)(_lv_draw_sw_blend_fill_dsc_t *);  // pointer to LVGL API function
     void (*blend_api_px_func)(_lv_draw_sw_blend_fill_dsc_t *,
                               uint32_t);  // pointer to LVGL API function with dest_px_size argument
@@ -121,6 +121,70 @@ TEST_CASE("LV Fill benchmark RGB565", "[fill][benchmark][RGB565]")
     free(dest_array_align16);
 }
 
+#if CONFIG_IDF_TARGET_ESP32P4  // Only esp32p4 has kernels for the fills with opacity or a mask
+TEST_CASE("LV Fill benchmark RGB565 with opa", "[fill][benchmark][RGB565][opa]")
+{
+    uint16_t *dest_array_align16 = (uint16_t *)memalign(16, STRIDE * HEIGHT * sizeof(uint16_t) + UNALIGN_BYTES * 2);
+    TEST_ASSERT_NOT_EQUAL(NULL, dest_array_align16);
+
+    // Apply a pixel of unalignment for the worst-case test scenario, an odd address is left to the C loop
+    uint16_t *dest_array_align1 = dest_array_align16 + UNALIGN_BYTES;
+
+    bench_test_case_params_t test_params = {
+        .height           = HEIGHT,
+        .width            = WIDTH,
+        .stride           = STRIDE * sizeof(uint16_t),
+        .cc_height        = HEIGHT - 1,
+        .cc_width         = WIDTH - 1,
+        .benchmark_cycles = BENCHMARK_CYCLES,
+        .array_align16    = (void *)dest_array_align16,
+        .array_align1     = (void *)dest_array_align1,
+        .blend_api_func   = &lv_draw_sw_blend_color_to_rgb565,
+        .opa              = LV_OPA_60,
+    };
+
+    ESP_LOGI(TAG_LV_FILL_BENCH, "running test for RGB565 color format with opa");
+    lv_fill_benchmark_init(&test_params);
+    free(dest_array_align16);
+}
+
+TEST_CASE("LV Fill benchmark RGB565 with mask", "[fill][benchmark][RGB565][mask]")
+{
+    uint16_t *dest_array_align16 = (uint16_t *)memalign(16, STRIDE * HEIGHT * sizeof(uint16_t) + UNALIGN_BYTES * 2);
+    TEST_ASSERT_NOT_EQUAL(NULL, dest_array_align16);
+    lv_opa_t *mask = (lv_opa_t *)malloc(STRIDE * HEIGHT);
+    TEST_ASSERT_NOT_EQUAL(NULL, mask);
+
+    // Like a line of text: runs of transparent, opaque and partly covered pixels
+    for (int i = 0; i < STRIDE * HEIGHT; i++) {
+        const int run = (i / 8) % 3;
+        mask[i]       = (run == 0) ? LV_OPA_TRANSP : ((run == 1) ? LV_OPA_COVER : (lv_opa_t)(i * 37 + 11));
+    }
+
+    // Apply a pixel of unalignment for the worst-case test scenario, an odd address is left to the C loop
+    uint16_t *dest_array_align1 = dest_array_align16 + UNALIGN_BYTES;
+
+    bench_test_case_params_t test_params = {
+        .height           = HEIGHT,
+        .width            = WIDTH,
+        .stride           = STRIDE * sizeof(uint16_t),
+        .cc_height        = HEIGHT - 1,
+        .cc_width         = WIDTH - 1,
+        .benchmark_cycles = BENCHMARK_CYCLES,
+        .array_align16    = (void *)dest_array_align16,
+        .array_align1     = (void *)dest_array_align1,
+        .blend_api_func   = &lv_draw_sw_blend_color_to_rgb565,
+        .mask_buf         = mask,
+    };
+
+    ESP_LOGI(TAG_LV_FILL_BENCH, "running test for RGB565 color format with mask");
+    lv_fill_benchmark_init(&test_params);
+    free(mask);
+    free(dest_array_align16);
+}
+#endif
+
+#if !CONFIG_IDF_TARGET_ESP32P4  // No RGB888 kernel for esp32p4 yet
 TEST_CASE("LV Fill benchmark RGB888", "[fill][benchmark][RGB888]")
 {
     uint8_t *dest_array_align16 = (uint8_t *)memalign(16, STRIDE * HEIGHT * sizeof(uint8_t) * 3 + UNALIGN_BYTES);
@@ -145,6 +209,7 @@ TEST_CASE("LV Fill benchmark RGB888", "[fill][benchmark][RGB888]")
     lv_fill_benchmark_init(&test_params);
     free(dest_array_align16);
 }
+#endif
 // ------------------------------------------------ Static test functions ----------------------------------------------
 
 static void lv_fill_benchmark_init(bench_test_case_params_t *test_params)
@@ -155,9 +220,10 @@ static void lv_fill_benchmark_init(bench_test_case_params_t *test_params)
         .dest_w      = test_params->width,
         .dest_h      = test_params->height,
         .dest_stride = test_params->stride,  // stride * sizeof()
-        .mask_buf    = NULL,
+        .mask_buf    = test_params->mask_buf,
+        .mask_stride = test_params->width,
         .color       = test_color,
-        .opa         = LV_OPA_MAX,
+        .opa         = test_params->opa ? test_params->opa : LV_OPA_MAX,
         .use_asm     = true,
     };
 
@@ -157,6 +157,85 @@ TEST_CASE("Test fill functionality RGB565", "[fill][functionality][RGB565]")
     functionality_test_matrix(&test_matrix, &test_case);
 }
 
+#if CONFIG_IDF_TARGET_ESP32P4  // Only esp32p4 has kernels for the fills with opacity or a mask
+TEST_CASE("Test fill functionality RGB565 with opa", "[fill][functionality][RGB565][opa]")
+{
+    test_matrix_params_t test_matrix = {
+        .min_w                   = 1,
+        .min_h                   = 1,
+        .max_w                   = 32,
+        .max_h                   = 4,
+        .min_unalign_byte        = 0,
+        .max_unalign_byte        = 16,
+        .unalign_step            = 1,
+        .dest_stride_step        = 1,
+        .test_combinations_count = 0,
+    };
+
+    func_test_case_params_t test_case = {
+        .blend_api_func = &lv_draw_sw_blend_color_to_rgb565,
+        .color_format   = LV_COLOR_FORMAT_RGB565,
+        .data_type_size = sizeof(uint16_t),
+        .opa            = LV_OPA_60,
+    };
+
+    ESP_LOGI(TAG_LV_FILL_FUNC, "running test for RGB565 color format with opa");
+    functionality_test_matrix(&test_matrix, &test_case);
+}
+
+TEST_CASE("Test fill functionality RGB565 with mask", "[fill][functionality][RGB565][mask]")
+{
+    test_matrix_params_t test_matrix = {
+        .min_w                   = 1,
+        .min_h                   = 1,
+        .max_w                   = 32,
+        .max_h                   = 4,
+        .min_unalign_byte        = 0,
+        .max_unalign_byte        = 16,
+        .unalign_step            = 1,
+        .dest_stride_step        = 1,
+        .test_combinations_count = 0,
+    };
+
+    func_test_case_params_t test_case = {
+        .blend_api_func = &lv_draw_sw_blend_color_to_rgb565,
+        .color_format   = LV_COLOR_FORMAT_RGB565,
+        .data_type_size = sizeof(uint16_t),
+        .masked         = true,
+    };
+
+    ESP_LOGI(TAG_LV_FILL_FUNC, "running test for RGB565 color format with mask");
+    functionality_test_matrix(&test_matrix, &test_case);
+}
+
+TEST_CASE("Test fill functionality RGB565 with mask and opa", "[fill][functionality][RGB565][mask]")
+{
+    test_matrix_params_t test_matrix = {
+        .min_w                   = 1,
+        .min_h                   = 1,
+        .max_w                   = 32,
+        .max_h                   = 4,
+        .min_unalign_byte        = 0,
+        .max_unalign_byte        = 16,
+        .unalign_step            = 1,
+        .dest_stride_step        = 1,
+        .test_combinations_count = 0,
+    };
+
+    func_test_case_params_t test_case = {
+        .blend_api_func = &lv_draw_sw_blend_color_to_rgb565,
+        .color_format   = LV_COLOR_FORMAT_RGB565,
+        .data_type_size = sizeof(uint16_t),
+        .opa            = LV_OPA_30,
+        .masked         = true,
+    };
+
+    ESP_LOGI(TAG_LV_FILL_FUNC, "running test for RGB565 color format with mask and opa");
+    functionality_test_matrix(&test_matrix, &test_case);
+}
+#endif
+
+#if !CONFIG_IDF_TARGET_ESP32P4  // No RGB888 kernel for esp32p4 yet
 TEST_CASE("Test fill functionality RGB888", "[fill][functionality][RGB888]")
 {
     test_matrix_params_t test_matrix = {
@@ -180,6 +259,7 @@ TEST_CASE("Test fill functionality RGB888", "[fill][functionality][RGB888]")
     ESP_LOGI(TAG_LV_FILL_FUNC, "running test for RGB888 color format");
     functionality_test_matrix(&test_matrix, &test_case);
 }
+#endif
 // ------------------------------------------------ Static test functions ----------------------------------------------
 
 static void functionality_test_matrix(test_matrix_params_t *test_matrix, func_test_case_params_t *test_case)
@@ -208,15 +288,29 @@ static void lv_fill_functionality(func_test_case_params_t *test_case)
 {
     fill_test_bufs(test_case);
 
+    // A mask the size of the dest, its stride in bytes the dest's in pixels. Runs of eight transparent, opaque and
+    // partly covered pixels take each path of a mask kernel
+    lv_opa_t *mask = NULL;
+    if (test_case->masked) {
+        const size_t mask_len = test_case->dest_h * test_case->dest_stride;
+        mask                  = (lv_opa_t *)malloc(mask_len);
+        TEST_ASSERT_NOT_NULL_MESSAGE(mask, "Lack of memory");
+        for (int i = 0; i < mask_len; i++) {
+            const int run = (i / 8) % 3;
+            mask[i]       = (run == 0) ? LV_OPA_TRANSP : ((run == 1) ? LV_OPA_COVER : (lv_opa_t)(i * 37 + 11));
+        }
+    }
+
     // Init structure for LVGL blend API, to call the Assembly API
     _lv_draw_sw_blend_fill_dsc_t dsc_asm = {
         .dest_buf    = test_case->buf.p_asm,
         .dest_w      = test_case->dest_w,
         .dest_h      = test_case->dest_h,
         .dest_stride = test_case->dest_stride * test_case->data_type_size,  // stride * sizeof()
-        .mask_buf    = NULL,
+        .mask_buf    = mask,
+        .mask_stride = test_case->dest_stride,
         .color       = test_color,
-        .opa         = LV_OPA_MAX,
+        .opa         = test_case->opa ? test_case->opa : LV_OPA_MAX,
         .use_asm     = true,
     };
 
@@ -263,6 +357,7 @@ static void lv_fill_functionality(func_test_case_params_t *test_case)
 
     free(test_case->buf.p_asm_alloc);
     free(test_case->buf.p_ansi_alloc);
+    free(mask);
 }
 
 static void fill_test_bufs(func_test_case_params_t *test_case)
@@ -298,6 +393,14 @@ static void fill_test_bufs(func_test_case_params_t *test_case)
         dest_buf_ansi[i * data_type_size] = (uint8_t)(i % 255);
     }
 
+    // A fill that mixes with the dest gets every byte of it different, so every channel is mixed from something
+    if (test_case->opa || test_case->masked) {
+        for (int i = CANARY_BYTES * data_type_size; i < (active_buf_len + CANARY_BYTES) * data_type_size; i++) {
+            dest_buf_asm[i]  = (uint8_t)(i * 167 + 13);
+            dest_buf_ansi[i] = (uint8_t)(i * 167 + 13);
+        }
+    }
+
     // Shift array pointers by Canary Bytes amount
     dest_buf_asm += CANARY_BYTES * data_type_size;
     dest_buf_ansi += CANARY_BYTES * data_type_size;
@@ -19,6 +19,7 @@ bool keypad_scanner_tca8418_matrix(uint8_t rows, uint8_t columns);
 uint8_t keypad_scanner_tca8418_flush();
 uint8_t keypad_scanner_tca8418_available();
 uint8_t keypad_scanner_tca8418_get_event();
+uint8_t keypad_scanner_tca8418_read_events(uint8_t *events, uint8_t max_events);
 esp_err_t keypad_scanner_tca8418_irq_init(int int_pin);
 
 // configuration
@@ -248,6 +248,42 @@ uint8_t keypad_scanner_tca8418_get_event()
     return event;
 }
 
+/**
+ * @brief drains the event FIFO in one burst and clears the interrupt.
+ *
+ * @param [out] events     key events, as keypad_scanner_tca8418_get_event() returns them
+ * @param [in]  max_events room in events, the FIFO holds 10
+ * @return number of events read, what didn't fit stays in the FIFO and keeps INT low
+ *
+ * @details with auto-increment off (CFG_AI, off from reset and never set here) every byte of a read from
+ *          KEY_EVENT_A pops the next event, the count decides the read's length.
+ */
+uint8_t keypad_scanner_tca8418_read_events(uint8_t* events, uint8_t max_events)
+{
+    uint8_t int_stat = read_reg(TCA8418_REG_INT_STAT);
+    if (int_stat & TCA8418_REG_STAT_GPI_INT) {
+        // GPI changes are in the FIFO too (GPI_EM), these only have to be read to clear
+        read_reg(TCA8418_REG_GPIO_INT_STAT_1);
+        read_reg(TCA8418_REG_GPIO_INT_STAT_2);
+        read_reg(TCA8418_REG_GPIO_INT_STAT_3);
+    }
+
+    uint8_t count = keypad_scanner_tca8418_available();
+    if (count > max_events) {
+        count = max_events;
+    }
+    if (count > 0) {
+        uint8_t reg = TCA8418_REG_KEY_EVENT_A;
+        if (i2c_master_transmit_receive(i2c_dev_handle_tca8418, &reg, 1, events, count, I2C_MASTER_TIMEOUT_MS) !=
+            ESP_OK) {
+            count = 0;
+        }
+    }
+
+    write_reg(TCA8418_REG_INT_STAT, int_stat & (TCA8418_REG_STAT_GPI_INT | TCA8418_REG_STAT_K_INT));
+    return count;
+}
+
 /**
  * @brief enables key event + GPIO interrupts.
  */
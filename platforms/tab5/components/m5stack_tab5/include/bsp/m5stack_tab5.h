@@ -167,6 +167,13 @@ i2c_master_bus_handle_t bsp_grove_i2c_get_handle(void);
  */
 esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config);
 
+/**
+ * @brief Number of speaker DMA buffers that went out as silence because nothing was written in time
+ *
+ * Counts since boot. Grows steadily while nothing plays, so only its rate during playback means anything.
+ */
+uint32_t bsp_audio_get_tx_silent_buffers(void);
+
 /**
  * @brief Initialize speaker codec device
  *
@@ -278,6 +285,15 @@ esp_err_t bsp_sdcard_init(char *mount_point, size_t max_files);
  */
 esp_err_t bsp_sdcard_deinit(char *mount_point);
 
+/**
+ * @brief Check that the mounted card still answers, the slot has no card detect line
+ *
+ * @return
+ *    - true:  a card is mounted and responds to a status request
+ *    - false: not mounted, or the card was pulled
+ */
+bool bsp_sdcard_present(void);
+
 /**************************************************************************************************
  *
  * LCD interface
@@ -385,6 +401,24 @@ void bsp_generate_poweroff_signal();
 
 bool bsp_headphone_detect();
 
+/**
+ * @brief Let the headphone jack pull the IO expander's INT low when it changes
+ */
+void bsp_headphone_detect_irq_enable(bool en);
+
+/**
+ * @brief Clear the IO expander's INT and read the jack
+ *
+ * @param[out] plugged whether headphones are in now
+ * @return true if the jack was what raised INT
+ */
+bool bsp_headphone_detect_irq(bool *plugged);
+
+/**
+ * @brief The speaker amplifier (SPK_EN), the headphone output doesn't go through it
+ */
+void bsp_set_speaker_enable(bool en);
+
 void bsp_set_ext_antenna_enable(bool en);
 
 void bsp_set_wifi_power_enable(bool en);
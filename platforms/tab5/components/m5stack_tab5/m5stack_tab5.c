@@ -55,6 +55,7 @@ static i2c_master_bus_handle_t grove_i2c_bus_handle = NULL;
 static i2s_chan_handle_t i2s_tx_chan            = NULL;
 static i2s_chan_handle_t i2s_rx_chan            = NULL;
 static const audio_codec_data_if_t* i2s_data_if = NULL; /* Codec data interface */
+static volatile uint32_t i2s_tx_silent_buffers  = 0;    /* DMA buffers sent without new data */
 
 //==================================================================================
 // camera 设置输出时钟
@@ -441,6 +442,64 @@ bool bsp_headphone_detect()
     return ret;
 }
 
+void bsp_headphone_detect_irq_enable(bool en)
+{
+    uint8_t write_buf[2] = {0};
+    uint8_t read_buf[1]  = {0};
+
+    // The INT line only goes low for a difference from the default state, which follows the jack
+    write_buf[0] = PI4IO_REG_IN_DEF_STA;
+    write_buf[1] = bsp_headphone_detect() ? 0b10000000 : 0;
+    i2c_master_transmit(i2c_dev_handle_pi4ioe1, write_buf, 2, I2C_MASTER_TIMEOUT_MS);
+
+    write_buf[0] = PI4IO_REG_INT_MASK;
+    i2c_master_transmit_receive(i2c_dev_handle_pi4ioe1, write_buf, 1, read_buf, 1, I2C_MASTER_TIMEOUT_MS);
+    write_buf[1] = read_buf[0];
+    if (en) {
+        clrbit(write_buf[1], 7);  // 0 enable, 1 disable
+    } else {
+        setbit(write_buf[1], 7);
+    }
+    i2c_master_transmit(i2c_dev_handle_pi4ioe1, write_buf, 2, I2C_MASTER_TIMEOUT_MS);
+}
+
+bool bsp_headphone_detect_irq(bool *plugged)
+{
+    uint8_t write_buf[2] = {0};
+    uint8_t read_buf[1]  = {0};
+
+    // Reading the status clears it and lets INT go high again
+    write_buf[0] = PI4IO_REG_IRQ_STA;
+    i2c_master_transmit_receive(i2c_dev_handle_pi4ioe1, write_buf, 1, read_buf, 1, I2C_MASTER_TIMEOUT_MS);
+    bool changed = read_buf[0] & 0b10000000;
+
+    *plugged     = bsp_headphone_detect();
+    write_buf[0] = PI4IO_REG_IN_DEF_STA;
+    write_buf[1] = *plugged ? 0b10000000 : 0;
+    i2c_master_transmit(i2c_dev_handle_pi4ioe1, write_buf, 2, I2C_MASTER_TIMEOUT_MS);
+
+    return changed;
+}
+
+void bsp_set_speaker_enable(bool en)
+{
+    uint8_t write_buf[2] = {0};
+    uint8_t read_buf[1]  = {0};
+
+    write_buf[0] = PI4IO_REG_OUT_SET;
+    i2c_master_transmit_receive(i2c_dev_handle_pi4ioe1, write_buf, 1, read_buf, 1, I2C_MASTER_TIMEOUT_MS);
+
+    write_buf[0] = PI4IO_REG_OUT_SET;
+    write_buf[1] = read_buf[0];
+    if (en) {
+        setbit(write_buf[1], 1);
+    } else {
+        clrbit(write_buf[1], 1);
+    }
+
+    i2c_master_transmit(i2c_dev_handle_pi4ioe1, write_buf, 2, I2C_MASTER_TIMEOUT_MS);
+}
+
 bool bsp_usb_c_detect()
 {
     uint8_t write_buf[2] = {0};
@@ -650,6 +709,11 @@ esp_err_t bsp_sdcard_deinit(char* mount_point)
     return ret_val;
 }
 
+bool bsp_sdcard_present(void)
+{
+    return card != NULL && sdmmc_get_status(card) == ESP_OK;
+}
+
 //==================================================================================
 // spiffs
 //==================================================================================
@@ -713,6 +777,18 @@ static int volume;
         .gpio_cfg = BSP_I2S_GPIO_CFG,                                                                 \
     }
 
+static bool IRAM_ATTR bsp_i2s_tx_underrun(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx)
+{
+    // Nothing was written in time, auto_clear makes the DMA send silence instead of the stale buffer
+    i2s_tx_silent_buffers++;
+    return false;
+}
+
+uint32_t bsp_audio_get_tx_silent_buffers(void)
+{
+    return i2s_tx_silent_buffers;
+}
+
 esp_err_t bsp_audio_init(const i2s_std_config_t* i2s_config)
 {
     if (i2s_tx_chan && i2s_rx_chan) {
@@ -723,6 +799,8 @@ esp_err_t bsp_audio_init(const i2s_std_config_t* i2s_config)
     /* Setup I2S peripheral */
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(CONFIG_BSP_I2S_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear        = true;  // Auto clear the legacy data in the DMA buffer
+    chan_cfg.dma_desc_num      = 8;     // 8 x 511 frames, ~90 ms at 44.1 kHz of slack for the writer
+    chan_cfg.dma_frame_num     = 511;
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &i2s_tx_chan, &i2s_rx_chan));
 
     /* Setup I2S channels */
@@ -735,6 +813,10 @@ esp_err_t bsp_audio_init(const i2s_std_config_t* i2s_config)
 
     if (i2s_tx_chan != NULL) {
         ESP_ERROR_CHECK(i2s_channel_init_std_mode(i2s_tx_chan, p_i2s_cfg));
+        i2s_event_callbacks_t tx_cbs = {
+            .on_send_q_ovf = bsp_i2s_tx_underrun,
+        };
+        ESP_ERROR_CHECK(i2s_channel_register_event_callback(i2s_tx_chan, &tx_cbs, NULL));
         ESP_ERROR_CHECK(i2s_channel_enable(i2s_tx_chan));
     }
 
@@ -1170,7 +1252,7 @@ esp_err_t bsp_display_new_with_handles(const bsp_display_config_t* config, bsp_l
         .dpi_clk_src        = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
         .dpi_clock_freq_mhz = 60,  // 720*1280 RGB24 60Hz RGB24 // 80,
         .pixel_format       = LCD_COLOR_PIXEL_FORMAT_RGB565,
-        .num_fbs            = 1,
+        .num_fbs            = CONFIG_BSP_LCD_DPI_BUFFER_NUMS,
         .video_timing =
             {
                 .h_size            = BSP_LCD_H_RES,
@@ -1216,7 +1298,7 @@ esp_err_t bsp_display_new_with_handles(const bsp_display_config_t* config, bsp_l
         .dpi_clk_src = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
         .dpi_clock_freq_mhz = 60,                       // LCD_MIPI_DSI_DPI_CLK_MHZ_ST7703,
         .pixel_format = LCD_COLOR_PIXEL_FORMAT_RGB565,  // LCD_COLOR_PIXEL_FORMAT_RGB888,
-        .num_fbs = 1,
+        .num_fbs = CONFIG_BSP_LCD_DPI_BUFFER_NUMS,
         .video_timing =
             {
                 .h_size = BSP_LCD_H_RES,  // lcd_param.width,
@@ -1392,7 +1474,7 @@ esp_err_t bsp_display_new_with_handles_to_st7123(const bsp_display_config_t* con
         .dpi_clk_src        = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
         .dpi_clock_freq_mhz = 70,  // ST7123 DPI clock frequency
         .pixel_format       = LCD_COLOR_PIXEL_FORMAT_RGB565,
-        .num_fbs            = 1,
+        .num_fbs            = CONFIG_BSP_LCD_DPI_BUFFER_NUMS,
         .video_timing =
             {
                 .h_size            = 720,
@@ -16,6 +16,9 @@ void accel_gyro_bmi270_get_data(struct bmi2_sens_data *data);
 bool accel_gyro_bmi270_check_irq(void);
 void accel_gyro_bmi270_clear_irq_int(void);
 bool accel_gyro_bmi270_motion_irq(void);
+bool accel_gyro_bmi270_fifo_enable(void);
+uint16_t accel_gyro_bmi270_fifo_read(struct bmi2_sens_axes_data *acc, struct bmi2_sens_axes_data *gyr,
+                                     uint16_t max_frames);
 
 #ifdef __cplusplus
 }
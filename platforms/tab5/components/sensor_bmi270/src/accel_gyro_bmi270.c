@@ -21,6 +21,10 @@ static const char *TAG = "bmi270";
 #define I2C_MASTER_TIMEOUT_MS 100
 #define I2C_DEV_ADDR_BMI270   0x68
 
+// Bytes per transfer. The I2C master driver refills its FIFO from the ISR, so a transfer has no size limit of its
+// own: the 8 KB feature config goes up in 8 writes instead of 274 of 30 bytes, and a whole FIFO backlog is one read
+#define BMI270_BURST_LEN 1024
+
 void bmi2_error_codes_print_result(int8_t rslt);
 static int8_t bmi270_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len, void *intf_ptr);
 static int8_t bmi270_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len, void *intf_ptr);
@@ -53,7 +57,7 @@ esp_err_t accel_gyro_bmi270_init(i2c_master_bus_handle_t bus_handle)
     bmi270.read            = bmi270_i2c_read;
     bmi270.write           = bmi270_i2c_write;
     bmi270.delay_us        = bmi270_delay_us;
-    bmi270.read_write_len  = 30;
+    bmi270.read_write_len  = BMI270_BURST_LEN;
     bmi270.config_file_ptr = NULL;
 
     // rslt = bmi2_interface_init(&bmi270, BMI2_I2C_INTF);
@@ -253,6 +257,59 @@ void accel_gyro_bmi270_get_data(struct bmi2_sens_data *data)
     bmi2_get_sensor_data(data, &bmi270);
 }
 
+// Accel and gyro frames without headers, 12 bytes each: one burst of reads takes everything since the last one
+#define FIFO_READ_FRAMES 64
+static uint8_t fifo_buffer[FIFO_READ_FRAMES * BMI2_FIFO_ACC_GYR_LENGTH + 1];  // And the dummy byte SPI would need
+
+bool accel_gyro_bmi270_fifo_enable(void)
+{
+    if (i2c_dev_handle_bmi270 == NULL) {
+        ESP_LOGE(TAG, "i2c_dev_handle_bmi270 is NULL");
+        return false;
+    }
+    int8_t rslt = bmi2_set_fifo_config(BMI2_FIFO_ALL_EN, BMI2_DISABLE, &bmi270);
+    if (rslt == BMI2_OK) {
+        rslt = bmi2_set_fifo_config(BMI2_FIFO_ACC_EN | BMI2_FIFO_GYR_EN, BMI2_ENABLE, &bmi270);
+    }
+    if (rslt == BMI2_OK) {
+        rslt = bmi2_set_fifo_config(BMI2_FIFO_HEADER_EN, BMI2_DISABLE, &bmi270);
+    }
+    bmi2_error_codes_print_result(rslt);
+    return rslt == BMI2_OK;
+}
+
+uint16_t accel_gyro_bmi270_fifo_read(struct bmi2_sens_axes_data *acc, struct bmi2_sens_axes_data *gyr,
+                                     uint16_t max_frames)
+{
+    uint16_t length = 0;
+    if (i2c_dev_handle_bmi270 == NULL || bmi2_get_fifo_length(&length, &bmi270) != BMI2_OK) {
+        return 0;
+    }
+    // Whole frames only, what's left is read with the next ones
+    if (max_frames > FIFO_READ_FRAMES) {
+        max_frames = FIFO_READ_FRAMES;
+    }
+    if (length > max_frames * BMI2_FIFO_ACC_GYR_LENGTH) {
+        length = max_frames * BMI2_FIFO_ACC_GYR_LENGTH;
+    }
+    length -= length % BMI2_FIFO_ACC_GYR_LENGTH;
+    if (length == 0) {
+        return 0;
+    }
+
+    struct bmi2_fifo_frame fifo = {0};
+    fifo.data                   = fifo_buffer;
+    fifo.length                 = length + bmi270.dummy_byte;
+    if (bmi2_read_fifo_data(&fifo, &bmi270) != BMI2_OK) {
+        return 0;
+    }
+    uint16_t acc_frames = max_frames;
+    uint16_t gyr_frames = max_frames;
+    bmi2_extract_accel(acc, &acc_frames, &fifo, &bmi270);
+    bmi2_extract_gyro(gyr, &gyr_frames, &fifo, &bmi270);
+    return acc_frames < gyr_frames ? acc_frames : gyr_frames;
+}
+
 bool accel_gyro_bmi270_check_irq(void)
 {
     if (i2c_dev_handle_bmi270 == NULL) {
@@ -299,7 +356,7 @@ void accel_gyro_bmi270_clear_irq_int(void)
 
 static int8_t bmi270_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len, void *intf_ptr)
 {
-    if ((reg_data == NULL) || (len == 0) || (len > 32)) {
+    if ((reg_data == NULL) || (len == 0)) {
         return -1;
     }
 
@@ -316,34 +373,23 @@ static int8_t bmi270_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len,
 
 static int8_t bmi270_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len, void *intf_ptr)
 {
-    if ((reg_data == NULL) || (len == 0) || (len > 32)) {
+    // Not reentrant: the HAL holds its I2C arbiter around every BMI270 call, so one write at a time uses the buffer
+    static uint8_t write_buffer[BMI270_BURST_LEN + 1];
+    if ((reg_data == NULL) || (len == 0) || (len > BMI270_BURST_LEN)) {
         return -1;
     }
 
-    esp_err_t ret;
-
     // Prepare write buffer: first byte is the register address, followed by the data bytes
-    uint8_t *write_buffer = malloc(len + 1);
-    if (write_buffer == NULL) {
-        ESP_LOGE("BMI270", "Memory allocation failed for write buffer");
-        return -1;
-    }
-
-    // First byte is register address
     write_buffer[0] = reg_addr;
-    // Copy the data to be written into the buffer
     memcpy(&write_buffer[1], reg_data, len);
 
     // Perform I2C write operation
-    ret = i2c_master_transmit(i2c_dev_handle_bmi270, write_buffer, len + 1, I2C_MASTER_TIMEOUT_MS);
+    esp_err_t ret = i2c_master_transmit(i2c_dev_handle_bmi270, write_buffer, len + 1, I2C_MASTER_TIMEOUT_MS);
     if (ret != ESP_OK) {
         ESP_LOGE("BMI270", "I2C write failed: %s", esp_err_to_name(ret));
-        free(write_buffer);
         return -1;
     }
 
-    free(write_buffer);  // Clean up allocated memory
-
     return 0;
 }
 
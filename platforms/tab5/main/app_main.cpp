@@ -9,6 +9,7 @@
 #include <memory>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <sdkconfig.h>
 
 extern "C" void app_main(void)
 {
@@ -22,9 +23,35 @@ extern "C" void app_main(void)
 
     // 应用层启动
     app::Init(callback);
+
+#if CONFIG_RADIO_DECODE_BENCHMARK
+    hal::HalBase::RadioBenchmark_t benchmark;
+    GetHAL()->runRadioBenchmark(&benchmark);
+#endif
+#if CONFIG_TAB5_NET_BENCHMARK
+    GetHAL()->runInBackground([]() {
+        // Once the saved network is up, give up after a minute
+        for (int i = 0; i < 600 && GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED; i++) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        hal::HalBase::NetBenchmark_t result;
+        GetHAL()->runNetworkBenchmark(CONFIG_TAB5_NET_BENCHMARK_URL, 10, &result);
+    });
+#endif
+#if CONFIG_TAB5_BENCH_CONSOLE
+    benchmark_console_start();
+#endif
+
+    // One app update per panel refresh while anything on screen moves, the timeout keeps the loop going should the
+    // panel stop reporting. Otherwise asleep until the next app is due or an event or touch wakes it
     while (!app::IsDone()) {
         app::Update();
-        vTaskDelay(1);
+        uint32_t idleMs = app::IdleTime();
+        if (idleMs == 0) {
+            GetHAL()->waitDisplayFrame(50);
+        } else if (GetHAL()->waitWake(idleMs)) {
+            app::Wake();
+        }
     }
     app::Destroy();
 }
@@ -4,13 +4,21 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/joinable_task/joinable_task.h"
+#include <stream/ring_buffer.h>
 #include <mooncake_log.h>
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string.h>
 #include <bsp/m5stack_tab5.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_heap_caps.h>
+#include <driver/gpio.h>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <audio_player.h>
@@ -24,7 +32,12 @@ void HalEsp32::setSpeakerVolume(uint8_t volume)
     _current_speaker_volume = std::clamp((int)volume, 0, 100);
     mclog::tagInfo(TAG, "set speaker volume: {}%", _current_speaker_volume);
 
-    // Apply volume immediately to codec (for radio streaming)
+    // While the radio plays it ramps the volume in software, the codec stays at full scale
+    if (radio_set_volume(_current_speaker_volume)) {
+        warm_restart_volume(_current_speaker_volume);
+        return;
+    }
+
     bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
     if (codec_handle) {
         codec_handle->set_volume(_current_speaker_volume);
@@ -38,88 +51,239 @@ uint8_t HalEsp32::getSpeakerVolume()
 
 void HalEsp32::audioRecord(std::vector<int16_t>& data, uint16_t durationMs, float gain)
 {
-    data.resize(48000 * 4 * durationMs / 1000);
+    const int frameSamples = MIC_FRAME_SAMPLES * MIC_CHANNELS;
+    int frames             = std::max(1, MIC_SAMPLE_RATE * durationMs / 1000 / MIC_FRAME_SAMPLES);
+    data.assign(frames * frameSamples, 0);
 
-    // ESP_LOGI(TAG, "start record");
+    int reader = openMicCapture();
+    if (reader < 0) {
+        return;
+    }
+    setMicGain(gain);
+    for (int got = 0, n = 1; got < frames && n > 0; got += n) {
+        n = readMicCapture(reader, data.data() + got * frameSamples, frames - got, 100);
+    }
+    closeMicCapture(reader);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Mic Capture                                */
+/* -------------------------------------------------------------------------- */
+// One task reads the ES7210 a frame at a time into a ring in PSRAM and lets it go again at once, the ring's history
+// is what readers follow: each one is a lagging cursor, so a slow UI reader skips frames instead of stalling I2S
+#define MIC_RING_SIZE (128 * 1024)  // About 340 ms a reader can fall behind by
+
+static constexpr size_t MIC_FRAME_BYTES =
+    hal::HalBase::MIC_FRAME_SAMPLES * hal::HalBase::MIC_CHANNELS * sizeof(int16_t);
+
+static struct {
+    std::mutex mutex;  // Readers and the task's lifetime
+    RingBuffer ring;
+    JoinableTask task;
+    int readers = 0;
+    std::atomic<bool> running{false};
+    std::atomic<float> gain{80.0f};
+} s_mic;
+
+static void mic_capture_task(void* param)
+{
     bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
-    codec_handle->set_in_gain(gain);
-    size_t bytes_read = 0;
-    codec_handle->i2s_read((char*)data.data(), (48000 * 4 * durationMs / 1000) * sizeof(uint16_t), &bytes_read,
-                           portMAX_DELAY);
-    // ESP_LOGI(TAG, "record done, %d bytes", bytes_read);
+    uint8_t* frame = (uint8_t*)heap_caps_malloc(MIC_FRAME_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    float gain     = -1;
+    while (frame && s_mic.running.load()) {
+        if (s_mic.gain.load() != gain) {
+            gain = s_mic.gain.load();
+            codec_handle->set_in_gain(gain);
+        }
+        size_t bytesRead = 0;
+        if (codec_handle->i2s_read(frame, MIC_FRAME_BYTES, &bytesRead, portMAX_DELAY) != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(4));
+            continue;
+        }
+        // Producer and consumer both: written, then consumed straight into history
+        s_mic.ring.write(frame, MIC_FRAME_BYTES);
+        s_mic.ring.discard(s_mic.ring.available());
+    }
+    heap_caps_free(frame);
+    mclog::tagInfo(TAG, "Mic capture ended, {} B stack left", task_topology::stack_headroom());
 }
 
-struct AudioTaskData_t {
-    std::mutex mutex;
-    bool is_task_running  = false;
-    bool is_audio_ready   = false;
-    bool is_audio_playing = false;
-    std::vector<int16_t> audio_data;
-};
-static AudioTaskData_t _audio_task_data;
+int HalEsp32::openMicCapture()
+{
+    std::lock_guard<std::mutex> lock(s_mic.mutex);
+    if (s_mic.readers == 0) {
+        if (!s_mic.ring.isInitialized()) {
+            if (!s_mic.ring.init(MIC_RING_SIZE)) {
+                mclog::tagError(TAG, "Mic capture ring alloc failed");
+                return -1;
+            }
+            // Whole frames, so a reader that is moved on lands on a frame boundary
+            s_mic.ring.setHistory((s_mic.ring.capacity() / MIC_FRAME_BYTES - 1) * MIC_FRAME_BYTES);
+        }
+        s_mic.ring.reset();
+        s_mic.running = true;
+        if (!s_mic.task.start(task_topology::MIC_CAPTURE, mic_capture_task, nullptr)) {
+            s_mic.running = false;
+            return -1;
+        }
+    }
+    int reader = s_mic.ring.openCursor(false);
+    if (reader >= 0) {
+        s_mic.readers++;
+    } else if (s_mic.readers == 0) {
+        s_mic.running = false;
+        s_mic.task.join(100);
+    }
+    return reader;
+}
 
-void _audio_play_task(void* param)
+void HalEsp32::closeMicCapture(int reader)
 {
-    size_t bytes_written = 0;
+    if (reader < 0 || reader >= RingBuffer::MAX_CURSORS) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s_mic.mutex);
+    s_mic.ring.closeCursor(reader);
+    if (--s_mic.readers == 0) {
+        s_mic.running = false;
+        s_mic.task.join(100);  // A frame, the read returns once it's in
+    }
+}
 
-    while (true) {
-        _audio_task_data.mutex.lock();
+int HalEsp32::readMicCapture(int reader, int16_t* data, int maxFrames, uint32_t timeoutMs, int* dropped)
+{
+    if (reader < 0 || reader >= RingBuffer::MAX_CURSORS || maxFrames <= 0) {
+        return 0;
+    }
+    RingBuffer& ring = s_mic.ring;
+    if (timeoutMs > 0 && ring.cursorAvailable(reader) < MIC_FRAME_BYTES) {
+        ring.waitForCursorData(reader, MIC_FRAME_BYTES, timeoutMs);
+    }
+    // Once more if the reader was moved on, it then starts at the oldest frame still there
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t frames = std::min(ring.cursorAvailable(reader) / MIC_FRAME_BYTES, (size_t)maxFrames);
+        if (frames == 0) {
+            return 0;
+        }
+        size_t skipped = 0;
+        size_t len     = ring.readCursor(reader, (uint8_t*)data, frames * MIC_FRAME_BYTES, &skipped);
+        if (dropped) {
+            *dropped += skipped / MIC_FRAME_BYTES;
+        }
+        if (len > 0) {
+            return len / MIC_FRAME_BYTES;
+        }
+    }
+    return 0;
+}
 
-        if (_audio_task_data.is_audio_ready) {
-            _audio_task_data.is_audio_playing = true;
-            _audio_task_data.mutex.unlock();
+void HalEsp32::setMicGain(float gain)
+{
+    s_mic.gain = gain;
+}
 
-            bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
-            codec_handle->set_volume(_current_speaker_volume);
-            codec_handle->i2s_reconfig_clk_fn(48000, 16, I2S_SLOT_MODE_STEREO);
-            codec_handle->i2s_write(_audio_task_data.audio_data.data(),
-                                    _audio_task_data.audio_data.size() * sizeof(uint16_t), &bytes_written,
-                                    portMAX_DELAY);
+/* -------------------------------------------------------------------------- */
+/*                                    Mixer                                   */
+/* -------------------------------------------------------------------------- */
+// UI sounds are voices of the HAL mixer. Whoever holds the output (the radio, the music player, the mic test)
+// mixes them into what it writes, while nobody does the mixer task plays them on its own.
+#define MIXER_VOICE_FRAMES 24000  // 0.5 s per sound
+#define MIXER_BLOCK_FRAMES 480    // 10 ms, how long a claim waits for the mixer task at most
 
-            _audio_task_data.mutex.lock();
-            _audio_task_data.is_audio_playing = false;
-            _audio_task_data.is_audio_ready   = false;
-            _audio_task_data.mutex.unlock();
+static SemaphoreHandle_t s_output_lock = nullptr;
+static std::atomic<int> s_output_claims{0};
+static TaskHandle_t s_mixer_task = nullptr;
 
+static void mixer_task(void* param)
+{
+    static int16_t block[MIXER_BLOCK_FRAMES * 2];
+    bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
+    size_t bytes_written             = 0;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (s_output_claims > 0) {
             continue;
         }
 
-        _audio_task_data.mutex.unlock();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        xSemaphoreTake(s_output_lock, portMAX_DELAY);
+        codec_handle->set_volume(_current_speaker_volume);
+        codec_handle->i2s_reconfig_clk_fn(AudioMixer::SAMPLE_RATE, 16, I2S_SLOT_MODE_STEREO);
+        while (GetHAL()->audioMixer.active() && s_output_claims == 0) {
+            memset(block, 0, sizeof(block));
+            GetHAL()->audioMixer.mix(block, MIXER_BLOCK_FRAMES);
+            codec_handle->i2s_write(block, sizeof(block), &bytes_written, portMAX_DELAY);
+        }
+        xSemaphoreGive(s_output_lock);
     }
 }
 
-void HalEsp32::audioPlay(std::vector<int16_t>& data, bool async)
+void HalEsp32::audio_mixer_init()
 {
-    if (async) {
-        std::lock_guard<std::mutex> lock(_audio_task_data.mutex);
-
-        if (_audio_task_data.is_audio_playing) {
-            mclog::tagWarn(TAG, "audio is playing");
+    static std::once_flag once;
+    std::call_once(once, [this]() {
+        s_output_lock = xSemaphoreCreateMutex();
+        auto pool     = (int16_t*)heap_caps_malloc(AudioMixer::MAX_VOICES * MIXER_VOICE_FRAMES * 2 * sizeof(int16_t),
+                                                   MALLOC_CAP_SPIRAM);
+        if (!pool) {
+            mclog::tagError(TAG, "mixer pool alloc failed");
             return;
         }
+        audioMixer.init(pool, MIXER_VOICE_FRAMES);
+        task_topology::create(task_topology::MIXER, mixer_task, nullptr, &s_mixer_task);
+    });
+}
 
-        if (!_audio_task_data.is_task_running) {
-            _audio_task_data.is_task_running = true;
-            xTaskCreate(_audio_play_task, "audio", 4096, nullptr, 5, nullptr);
+void audio_claim_output()
+{
+    s_output_claims++;
+    xSemaphoreTake(s_output_lock, portMAX_DELAY);
+}
+
+void audio_release_output()
+{
+    xSemaphoreGive(s_output_lock);
+
+    // Sounds the holder didn't get to finish
+    if (--s_output_claims == 0 && s_mixer_task && GetHAL()->audioMixer.active()) {
+        xTaskNotifyGive(s_mixer_task);
+    }
+}
+
+void HalEsp32::audioPlay(std::vector<int16_t>& data, bool async)
+{
+    int voice = audioMixer.play(data.data(), data.size() / 2);
+    if (voice < 0) {
+        mclog::tagWarn(TAG, "no free voice");
+        return;
+    }
+    if (s_mixer_task) {
+        xTaskNotifyGive(s_mixer_task);
+    }
+
+    if (!async) {
+        while (audioMixer.playing(voice)) {
+            vTaskDelay(pdMS_TO_TICKS(10));
         }
+    }
+}
 
-        _audio_task_data.audio_data     = data;
-        _audio_task_data.is_audio_ready = true;
-    } else {
-        bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
-        codec_handle->set_volume(_current_speaker_volume);
-        size_t bytes_written = 0;
-        codec_handle->i2s_reconfig_clk_fn(48000, 16, I2S_SLOT_MODE_STEREO);
-        codec_handle->i2s_write(data.data(), data.size() * sizeof(uint16_t), &bytes_written, portMAX_DELAY);
+void HalEsp32::audioPlayVoice(int voice, int frames)
+{
+    audioMixer.commit(voice, frames);
+    if (s_mixer_task) {
+        xTaskNotifyGive(s_mixer_task);
     }
 }
 
 /* -------------------------------------------------------------------------- */
 /*                            Record and play test                            */
 /* -------------------------------------------------------------------------- */
+#define REC_TEST_JOIN_MS 200  // A run that set IDLE only has its return left
+
 struct RecTestData_t {
     std::mutex mutex;
+    JoinableTask task;
     bool isDualMic                     = true;
     hal::HalBase::MicTestState_t state = hal::HalBase::MIC_TEST_IDLE;
     int16_t* audio_buffer              = nullptr;
@@ -142,36 +306,24 @@ static void _rec_test_task(void* param)
         _rec_test_data.read_buffer = new int16_t[read_buffer_size](0);
     }
 
-    const size_t sample_rate   = 48000;
-    const size_t total_samples = sample_rate * 4 * 3;  // 4通道，3秒
-    const size_t chunk_samples = 4096 * 4;             // 4通道一帧
-    const size_t chunk_bytes   = chunk_samples * sizeof(int16_t);
-
-    size_t total_read_samples = 0;
-    size_t total_read_bytes   = 0;
+    const int frame_samples = hal::HalBase::MIC_FRAME_SAMPLES * hal::HalBase::MIC_CHANNELS;
+    const int total_frames  = read_buffer_size / frame_samples;  // 3 s
+    const int read_frames   = 16;
 
     bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
-    codec_handle->set_in_gain(240);
 
     int16_t* read_buf = _rec_test_data.read_buffer;
-    memset(read_buf, 0, total_samples * sizeof(int16_t));  // 清零
+    memset(read_buf, 0, read_buffer_size * sizeof(int16_t));  // 清零
 
     mclog::tagInfo(TAG, "start record");
 
-    while (total_read_samples < total_samples) {
-        size_t bytes_to_read = chunk_bytes;
-        if (total_read_samples + chunk_samples > total_samples) {
-            bytes_to_read = (total_samples - total_read_samples) * sizeof(int16_t);
-        }
-
-        size_t bytes_read = 0;
-        codec_handle->i2s_read((char*)(read_buf + total_read_samples), bytes_to_read, &bytes_read, portMAX_DELAY);
-
-        total_read_samples += bytes_read / sizeof(int16_t);
-        total_read_bytes += bytes_read;
-
-        vTaskDelay(pdMS_TO_TICKS(5));
+    int reader = GetHAL()->openMicCapture();
+    GetHAL()->setMicGain(240);
+    for (int got = 0, n = 1; reader >= 0 && got < total_frames && n > 0; got += n) {
+        n = GetHAL()->readMicCapture(reader, read_buf + got * frame_samples,
+                                     std::min(read_frames, total_frames - got), 100);
     }
+    GetHAL()->closeMicCapture(reader);
 
     mclog::tagInfo(TAG, "record done");
 
@@ -195,40 +347,41 @@ static void _rec_test_task(void* param)
     _rec_test_data.mutex.unlock();
 
     size_t bytes_written = 0;
+    audio_claim_output();
     codec_handle->set_volume(_current_speaker_volume);
     codec_handle->i2s_reconfig_clk_fn(48000, 16, I2S_SLOT_MODE_STEREO);
 
+    // In chunks, so UI sounds during the playback are heard when they happen
     mclog::tagInfo(TAG, "start playback");
-    codec_handle->i2s_write(_rec_test_data.audio_buffer, (48000 * 2 * 3) * sizeof(uint16_t), &bytes_written,
-                            portMAX_DELAY);
+    const int chunk_frames = 4800;
+    for (int frame = 0; frame < num_frames; frame += chunk_frames) {
+        int16_t* chunk = _rec_test_data.audio_buffer + frame * 2;
+        int frames     = std::min(chunk_frames, num_frames - frame);
+        GetHAL()->audioMixer.mix(chunk, frames);
+        codec_handle->i2s_write(chunk, frames * 2 * sizeof(int16_t), &bytes_written, portMAX_DELAY);
+    }
     mclog::tagInfo(TAG, "playback done");
+    audio_release_output();
 
     _rec_test_data.mutex.lock();
     _rec_test_data.state = hal::HalBase::MIC_TEST_IDLE;
     _rec_test_data.mutex.unlock();
-
-    vTaskDelete(NULL);
 }
 
 static void try_create_rec_test_task(bool isDualMic)
 {
-    _rec_test_data.mutex.lock();
-
-    if (_rec_test_data.state == hal::HalBase::MIC_TEST_IDLE) {
-        _rec_test_data.mutex.unlock();
-        vTaskDelay(pdMS_TO_TICKS(20));
-        _rec_test_data.mutex.lock();
-        if (_rec_test_data.state == hal::HalBase::MIC_TEST_IDLE) {
-            _rec_test_data.isDualMic = isDualMic;
-            _rec_test_data.state     = hal::HalBase::MIC_TEST_RECORDING;
-            xTaskCreate(_rec_test_task, "rec", 4096, nullptr, 5, nullptr);
-            _rec_test_data.mutex.unlock();
-            return;
-        }
+    std::lock_guard<std::mutex> lock(_rec_test_data.mutex);
+    // IDLE is the last thing a run sets, joining it doesn't wait on this lock
+    if (_rec_test_data.state != hal::HalBase::MIC_TEST_IDLE || !_rec_test_data.task.join(REC_TEST_JOIN_MS)) {
+        mclog::tagWarn(TAG, "rec test is running");
+        return;
+    }
+    _rec_test_data.isDualMic = isDualMic;
+    _rec_test_data.state     = hal::HalBase::MIC_TEST_RECORDING;
+    if (!_rec_test_data.task.start(task_topology::MIC_TEST, _rec_test_task, nullptr)) {
+        mclog::tagError(TAG, "no rec test task");
+        _rec_test_data.state = hal::HalBase::MIC_TEST_IDLE;
     }
-
-    _rec_test_data.mutex.unlock();
-    mclog::tagWarn(TAG, "rec test is running");
 }
 
 void HalEsp32::startDualMicRecordTest()
@@ -269,9 +422,11 @@ enum Mp3PlayTarget_t {
     MP3_PLAY_TARGET_SHUTDOWN_SFX,
 };
 
+#define MUSIC_TEST_JOIN_MS 200  // A run that set IDLE only has its return left
+
 struct MusicTestData_t {
     std::mutex mutex;
-    bool killSignal                      = false;
+    JoinableTask task;  // cancel() stops the tune
     hal::HalBase::MusicPlayState_t state = hal::HalBase::MUSIC_PLAY_IDLE;
     Mp3PlayTarget_t target               = MP3_PLAY_TARGET_CANON_IN_D;
 };
@@ -296,18 +451,36 @@ static void audio_player_callback(audio_player_cb_ctx_t* ctx)
     }
 }
 
-static void _music_play_task(void* param)
+// The player's output carries the UI sounds while it plays, as long as it runs at the mixer's format
+static bool s_player_mixable = true;
+
+static esp_err_t player_clk_set(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    s_player_mixable = (rate == AudioMixer::SAMPLE_RATE && bits_cfg == 16 && ch == I2S_SLOT_MODE_STEREO);
+    return bsp_get_codec_handle()->i2s_reconfig_clk_fn(rate, bits_cfg, ch);
+}
+
+static esp_err_t player_write(void* audio_buffer, size_t len, size_t* bytes_written, uint32_t timeout_ms)
+{
+    if (s_player_mixable) {
+        GetHAL()->audioMixer.mix((int16_t*)audio_buffer, len / (2 * sizeof(int16_t)));
+    }
+    return bsp_get_codec_handle()->i2s_write(audio_buffer, len, bytes_written, timeout_ms);
+}
+
+static void _music_play_task(void* param, const CancelToken& token)
 {
+    audio_claim_output();
     bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
     codec_handle->set_volume(_current_speaker_volume);
-    codec_handle->i2s_reconfig_clk_fn(48000, 16, I2S_SLOT_MODE_STEREO);
+    player_clk_set(48000, 16, I2S_SLOT_MODE_STEREO);
 
     audio_player_config_t config = {
         .mute_fn    = audio_mute_function,
-        .clk_set_fn = codec_handle->i2s_reconfig_clk_fn,
-        .write_fn   = codec_handle->i2s_write,
-        .priority   = 8,
-        .coreID     = 1,
+        .clk_set_fn = player_clk_set,
+        .write_fn   = player_write,
+        .priority   = task_topology::AUDIO_PLAYER.priority,
+        .coreID     = task_topology::AUDIO_PLAYER.core,
     };
     ESP_ERROR_CHECK(audio_player_new(config));
     audio_player_callback_register(audio_player_callback, NULL);
@@ -332,41 +505,40 @@ static void _music_play_task(void* param)
     esp_err_t ret = audio_player_play(fp);
     if (ret != ESP_OK) {
         mclog::tagError(TAG, "audio play failed");
-        vTaskDelete(NULL);
+        audio_release_output();
+        std::lock_guard<std::mutex> lock(_music_test_data.mutex);
+        _music_test_data.state = hal::HalBase::MUSIC_PLAY_IDLE;
         return;
     }
 
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-
-        std::lock_guard<std::mutex> lock(_music_test_data.mutex);
-        if (_music_test_data.killSignal) {
-            break;
-        }
+    // The player's callback cancels it at the end, stopPlayMusicTest() before
+    while (!token.sleep(1000)) {
     }
 
     ret = audio_player_delete();
     if (ret != ESP_OK) {
         mclog::tagError(TAG, "audio player delete failed");
     }
+    audio_release_output();
 
     _music_test_data.mutex.lock();
-    _music_test_data.state      = hal::HalBase::MUSIC_PLAY_IDLE;
-    _music_test_data.killSignal = false;
+    _music_test_data.state = hal::HalBase::MUSIC_PLAY_IDLE;
     _music_test_data.mutex.unlock();
-
-    vTaskDelete(NULL);
 }
 
+// Called with _music_test_data.mutex held
 void try_create_music_play_task(Mp3PlayTarget_t target)
 {
-    if (_music_test_data.state == hal::HalBase::MUSIC_PLAY_IDLE) {
-        _music_test_data.state      = hal::HalBase::MUSIC_PLAY_PLAYING;
-        _music_test_data.target     = target;
-        _music_test_data.killSignal = false;
-        xTaskCreate(_music_play_task, "music", 3000, nullptr, 5, nullptr);
-    } else {
+    // IDLE is the last thing a run sets, joining it doesn't wait on this lock
+    if (_music_test_data.state != hal::HalBase::MUSIC_PLAY_IDLE || !_music_test_data.task.join(MUSIC_TEST_JOIN_MS)) {
         mclog::tagWarn(TAG, "music play is running");
+        return;
+    }
+    _music_test_data.state  = hal::HalBase::MUSIC_PLAY_PLAYING;
+    _music_test_data.target = target;
+    if (!_music_test_data.task.start(task_topology::MUSIC_TEST, _music_play_task, nullptr)) {
+        mclog::tagError(TAG, "no music play task");
+        _music_test_data.state = hal::HalBase::MUSIC_PLAY_IDLE;
     }
 }
 
@@ -384,8 +556,9 @@ hal::HalBase::MusicPlayState_t HalEsp32::getMusicPlayTestState()
 
 void HalEsp32::stopPlayMusicTest()
 {
+    // Not joined, the player's own task calls this at the end of the tune and the run deletes the player
     std::lock_guard<std::mutex> lock(_music_test_data.mutex);
-    _music_test_data.killSignal = true;
+    _music_test_data.task.cancel();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -402,3 +575,112 @@ void HalEsp32::playShutdownSfx()
     std::lock_guard<std::mutex> lock(_music_test_data.mutex);
     try_create_music_play_task(MP3_PLAY_TARGET_SHUTDOWN_SFX);
 }
+
+/* -------------------------------------------------------------------------- */
+/*                               Headphone jack                               */
+/* -------------------------------------------------------------------------- */
+// A task on the network core follows the jack: it sleeps until the IO expander pulls INT low (or reads it every
+// HP_POLL_MS where the line isn't on a GPIO), gives the contacts HP_DEBOUNCE_MS to settle and takes the new state
+// if it held. Headphones in turn the speaker amp off, out turn it back on. While the radio plays its output task
+// does that between a block faded out and the next faded in, I2S and the decoder run on; otherwise it's done here
+#define HP_INT_PIN     CONFIG_TAB5_HP_DETECT_INT_GPIO
+#define HP_DEBOUNCE_MS 80
+#define HP_POLL_MS     250
+
+static std::atomic<bool> s_headphones{false};  // Debounced
+static std::atomic<bool> s_speaker_on{true};   // SPK_EN as last set, the IO expander's init turns it on
+static TaskHandle_t s_headphone_task = nullptr;
+
+static void IRAM_ATTR on_headphone_interrupt(void* arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_headphone_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static bool read_jack()
+{
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+    bool plugged = false;
+    bsp_headphone_detect_irq(&plugged);
+    return plugged;
+}
+
+bool audio_route_pending()
+{
+    return s_speaker_on.load() == s_headphones.load();
+}
+
+void audio_route_apply()
+{
+    bool speaker = !s_headphones.load();
+    if (s_speaker_on.exchange(speaker) != speaker) {
+        bsp_set_speaker_enable(speaker);
+        mclog::tagInfo(TAG, "Output to the {}", speaker ? "speaker" : "headphones");
+    }
+}
+
+static void headphone_task(void* param)
+{
+    while (true) {
+        // INT stays low until the expander's status is read, a change during the last read isn't lost
+        if (HP_INT_PIN < 0) {
+            vTaskDelay(pdMS_TO_TICKS(HP_POLL_MS));
+        } else if (gpio_get_level((gpio_num_t)HP_INT_PIN) != 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        bool plugged = read_jack();
+        if (plugged == s_headphones.load()) {
+            continue;
+        }
+        vTaskDelay(pdMS_TO_TICKS(HP_DEBOUNCE_MS));
+        ulTaskNotifyTake(pdTRUE, 0);  // The bounces meanwhile, the read below has the last word
+        if (read_jack() != plugged) {
+            continue;
+        }
+
+        s_headphones = plugged;
+        mclog::tagInfo(TAG, "Headphones {}", plugged ? "plugged in" : "pulled out");
+        if (!radio_output_routes()) {
+            audio_route_apply();
+        }
+        hal_post_event(hal::HalBase::EVENT_HEADPHONE, plugged);
+    }
+}
+
+void HalEsp32::headphone_init()
+{
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        s_headphones = bsp_headphone_detect();
+        if (HP_INT_PIN >= 0) {
+            bsp_headphone_detect_irq_enable(true);
+        }
+    }
+    audio_route_apply();
+    if (task_topology::create(task_topology::HEADPHONE, headphone_task, nullptr, &s_headphone_task) != pdPASS) {
+        mclog::tagError(TAG, "no headphone task, the jack isn't followed");
+        return;
+    }
+    if (HP_INT_PIN >= 0) {
+        gpio_config_t io_conf = {};
+        io_conf.pin_bit_mask  = 1ULL << HP_INT_PIN;
+        io_conf.mode          = GPIO_MODE_INPUT;
+        io_conf.pull_up_en    = GPIO_PULLUP_ENABLE;
+        io_conf.intr_type     = GPIO_INTR_NEGEDGE;
+        gpio_config(&io_conf);
+        // The touch controller's driver may have installed the service already
+        esp_err_t ret = gpio_install_isr_service(0);
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+            mclog::tagError(TAG, "no gpio isr service: {}", esp_err_to_name(ret));
+        }
+        gpio_isr_handler_add((gpio_num_t)HP_INT_PIN, on_headphone_interrupt, nullptr);
+    }
+    mclog::tagInfo(TAG, "Headphones {}, jack {}", s_headphones.load() ? "in" : "out",
+                   HP_INT_PIN >= 0 ? "on INT" : "polled");
+}
+
+bool HalEsp32::headPhoneDetect()
+{
+    return s_headphones.load();
+}
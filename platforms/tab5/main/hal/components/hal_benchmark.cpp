@@ -0,0 +1,988 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <stream/ring_buffer.h>
+#include <stream/spectrum_analyzer.h>
+#include <stream/pcm_dsp.h>
+#include <stream/resampler.h>
+#include <stream/stream_trace.h>
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/sd_writer/sd_writer.h"
+#include <mooncake_log.h>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <bsp/m5stack_tab5.h>
+#include <driver/i2c_master.h>
+#include <driver/ppa.h>
+#include <esp_app_desc.h>
+#include <esp_chip_info.h>
+#include <esp_console.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include <esp_psram.h>
+#include <esp_timer.h>
+#include <lv_demos.h>
+#include <sdkconfig.h>
+
+static const char* TAG = "bench";
+
+/* -------------------------------------------------------------------------- */
+/*                               Self Benchmark                               */
+/* -------------------------------------------------------------------------- */
+// The same suite on every board and build, so a slow hardware batch or a firmware regression shows as a number that
+// moved. Runs in a task of its own on the audio core, the stages one after the other with nothing else of the radio
+// running. The LVGL demo goes last: it takes the screen over and stays there until a restart
+#define BENCH_PSRAM_COPY_BYTES     (1024 * 1024)  // Well past the 256 KB L2 cache
+#define BENCH_PSRAM_COPY_ROUNDS    16
+#define BENCH_INTERNAL_COPY_BYTES  (16 * 1024)
+#define BENCH_INTERNAL_COPY_ROUNDS 1024
+#define BENCH_PPA_ROUNDS           20
+#define BENCH_DSP_ROUNDS           200
+#define BENCH_DSP_FRAMES           1152  // One MP3 frame
+#define BENCH_RING_SIZE            (256 * 1024)
+#define BENCH_RING_BYTES           (32 * 1024 * 1024)
+#define BENCH_RING_CHUNK           1436  // One TCP segment
+#define BENCH_NET_SECONDS          10
+#define BENCH_LVGL_MS              20000
+#define BENCH_SD_BYTES             (32 * 1024 * 1024)  // Several preallocation steps, past the card's write cache
+#define BENCH_SD_PATH              SDCARD_MOUNT_POINT "/.bench_write"
+#define BENCH_LOG_PATH             SDCARD_MOUNT_POINT "/benchmarks.jsonl"
+#define BENCH_SAMPLE_DIR           "bench"  // On the card, decoder samples: an .aac, .opus or .flac each
+
+struct SelfBenchRun_t {
+    hal::HalBase::SelfBenchmark_t* result = nullptr;
+    TaskHandle_t caller                   = nullptr;
+};
+
+static std::atomic<bool> s_running{false};
+
+static float copy_mbps(uint32_t caps, size_t bytes, int rounds)
+{
+    uint8_t* src = (uint8_t*)heap_caps_malloc(bytes, caps);
+    uint8_t* dst = (uint8_t*)heap_caps_malloc(bytes, caps);
+    float mbps   = 0;
+    if (src && dst) {
+        memset(src, 0x5a, bytes);
+        memcpy(dst, src, bytes);
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < rounds; i++) {
+            memcpy(dst, src, bytes);
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        mbps            = elapsed > 0 ? (float)bytes * rounds / elapsed : 0;  // Bytes per us are MB/s
+    }
+    heap_caps_free(src);
+    heap_caps_free(dst);
+    return mbps;
+}
+
+// A portrait panel frame turned to landscape, what the display flush does with every area
+static float ppa_rotate_mpxps()
+{
+    constexpr uint32_t width  = BSP_LCD_H_RES;
+    constexpr uint32_t height = BSP_LCD_V_RES;
+    constexpr size_t bytes    = width * height * 2;
+
+    ppa_client_handle_t client = nullptr;
+    ppa_client_config_t config = {};
+    config.oper_type           = PPA_OPERATION_SRM;
+    if (ppa_register_client(&config, &client) != ESP_OK) {
+        return 0;
+    }
+    uint8_t* in  = (uint8_t*)heap_caps_aligned_calloc(64, 1, bytes, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+    uint8_t* out = (uint8_t*)heap_caps_aligned_calloc(64, 1, bytes, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+    float mpxps  = 0;
+    if (in && out) {
+        ppa_srm_oper_config_t srm = {};
+        srm.in.buffer             = in;
+        srm.in.pic_w              = width;
+        srm.in.pic_h              = height;
+        srm.in.block_w            = width;
+        srm.in.block_h            = height;
+        srm.in.srm_cm             = PPA_SRM_COLOR_MODE_RGB565;
+        srm.out.buffer            = out;
+        srm.out.buffer_size       = bytes;
+        srm.out.pic_w             = height;
+        srm.out.pic_h             = width;
+        srm.out.srm_cm            = PPA_SRM_COLOR_MODE_RGB565;
+        srm.rotation_angle        = PPA_SRM_ROTATION_ANGLE_90;
+        srm.scale_x               = 1.0f;
+        srm.scale_y               = 1.0f;
+        srm.mode                  = PPA_TRANS_MODE_BLOCKING;
+
+        int rounds    = 0;
+        int64_t start = esp_timer_get_time();
+        while (rounds < BENCH_PPA_ROUNDS && ppa_do_scale_rotate_mirror(client, &srm) == ESP_OK) {
+            rounds++;
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        mpxps           = rounds == BENCH_PPA_ROUNDS && elapsed > 0 ? (float)width * height * rounds / elapsed : 0;
+    }
+    heap_caps_free(in);
+    heap_caps_free(out);
+    ppa_unregister_client(client);
+    return mpxps;
+}
+
+// Cycles per call of the radio's own DSP stages, on a noise-like stereo frame
+static void dsp_cycles(hal::HalBase::SelfBenchmark_t* result)
+{
+    size_t samples     = BENCH_DSP_FRAMES * 2;
+    int16_t* source    = (int16_t*)heap_caps_malloc(samples * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int16_t* pcm       = (int16_t*)heap_caps_malloc(samples * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int16_t* out       = (int16_t*)heap_caps_malloc(Resampler::MAX_INPUT * 2 * sizeof(int16_t), MALLOC_CAP_8BIT);
+    PcmDsp* dsp        = (PcmDsp*)heap_caps_malloc(sizeof(PcmDsp), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    Resampler* src     = new (std::nothrow) Resampler();
+    auto* analyzer     = new (std::nothrow) SpectrumAnalyzer();
+    uint8_t levels[32] = {};
+    if (source && pcm && out && dsp && src && analyzer && analyzer->init()) {
+        uint32_t seed = 1;
+        for (size_t i = 0; i < samples; i++) {
+            seed      = seed * 1664525 + 1013904223;
+            source[i] = (int16_t)(seed >> 16) / 4;
+        }
+
+        new (dsp) PcmDsp();
+        dsp->configure(44100, 2);
+        float gains[PcmDsp::EQ_BANDS] = {3, -2, 4};
+        dsp->setEq(gains);
+        dsp->setNormalize(true);
+        src->configure(44100, AudioMixer::SAMPLE_RATE, 2);
+
+        uint64_t fft      = 0;
+        uint64_t process  = 0;
+        uint64_t resample = 0;
+        for (int i = 0; i < BENCH_DSP_ROUNDS; i++) {
+            memcpy(pcm, source, samples * sizeof(int16_t));
+            esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+            analyzer->process(pcm, 44100, levels, sizeof(levels));
+            esp_cpu_cycle_count_t analyzed = esp_cpu_get_cycle_count();
+            dsp->process(pcm, samples);
+            esp_cpu_cycle_count_t processed = esp_cpu_get_cycle_count();
+            src->process(pcm, BENCH_DSP_FRAMES, out, Resampler::MAX_INPUT);
+            esp_cpu_cycle_count_t resampled = esp_cpu_get_cycle_count();
+            fft += analyzed - start;
+            process += processed - analyzed;
+            resample += resampled - processed;
+        }
+        result->fftCycles      = fft / BENCH_DSP_ROUNDS;
+        result->dspCycles      = process / BENCH_DSP_ROUNDS;
+        result->resampleCycles = resample / BENCH_DSP_ROUNDS;
+        dsp->~PcmDsp();
+    }
+    heap_caps_free(source);
+    heap_caps_free(pcm);
+    heap_caps_free(out);
+    heap_caps_free(dsp);
+    delete src;
+    delete analyzer;
+}
+
+struct RingRun_t {
+    RingBuffer ring;
+    TaskHandle_t consumer = nullptr;
+};
+
+// Network side of the stream ring: socket-sized writes as fast as the consumer makes room
+static void ring_producer_task(void* param)
+{
+    RingRun_t* run = (RingRun_t*)param;
+    uint8_t chunk[BENCH_RING_CHUNK];
+    memset(chunk, 0xa5, sizeof(chunk));
+    size_t sent = 0;
+    while (sent < BENCH_RING_BYTES) {
+        size_t n = std::min(sizeof(chunk), (size_t)BENCH_RING_BYTES - sent);
+        if (run->ring.freeSpace() < n) {
+            run->ring.waitForSpace(n, 100);
+            continue;
+        }
+        sent += run->ring.write(chunk, n);
+    }
+    xTaskNotifyGive(run->consumer);
+    vTaskDelete(nullptr);
+}
+
+// The decoder's side on the calling task, read out in frame-sized copies
+static float ring_mbps()
+{
+    RingRun_t* run = new (std::nothrow) RingRun_t();
+    uint8_t* frame = (uint8_t*)heap_caps_malloc(BENCH_RING_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    float mbps     = 0;
+    if (run && frame && run->ring.init(BENCH_RING_SIZE)) {
+        run->consumer = xTaskGetCurrentTaskHandle();
+        int64_t start = esp_timer_get_time();
+        if (task_topology::create(task_topology::HTTP_STREAM, ring_producer_task, run, nullptr, "bench_ring") ==
+            pdPASS) {
+            size_t received = 0;
+            while (received < BENCH_RING_BYTES) {
+                size_t n = std::min((size_t)BENCH_RING_CHUNK, (size_t)BENCH_RING_BYTES - received);
+                if (run->ring.available() < n) {
+                    run->ring.waitForData(n, 100);
+                    continue;
+                }
+                received += run->ring.read(frame, n);
+            }
+            int64_t elapsed = esp_timer_get_time() - start;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            mbps = elapsed > 0 ? (float)BENCH_RING_BYTES / elapsed : 0;
+        }
+        run->ring.deinit();
+    }
+    delete run;
+    heap_caps_free(frame);
+    return mbps;
+}
+
+// Frame rate and render time over the first seconds of LVGL's own benchmark scenes
+// Sustained rate and the worst block, what decides whether a recording keeps up with the stream
+static void sd_write(hal::HalBase::SelfBenchmark_t* result)
+{
+    if (!sdcard_acquire()) {
+        return;
+    }
+    SdWriter* writer = new (std::nothrow) SdWriter();
+    if (writer && writer->open(BENCH_SD_PATH)) {
+        int64_t start = esp_timer_get_time();
+        uint32_t seed = 1;
+        bool ok       = true;
+        for (size_t written = 0; written < BENCH_SD_BYTES && ok; written += SdWriter::BLOCK_SIZE) {
+            // Not all zeros, in case the card compresses or skips those
+            uint32_t* words = (uint32_t*)writer->space();
+            for (size_t i = 0; i < SdWriter::BLOCK_SIZE / sizeof(uint32_t); i++) {
+                seed     = seed * 1664525u + 1013904223u;
+                words[i] = seed;
+            }
+            ok = writer->commit(SdWriter::BLOCK_SIZE);
+        }
+        ok = writer->close() && ok;
+        int64_t elapsed = esp_timer_get_time() - start;
+        if (ok && elapsed > 0) {
+            result->sdWriteMBps    = (float)BENCH_SD_BYTES / elapsed;
+            result->sdWorstWriteMs = writer->stats().worstUs / 1000.0f;
+        }
+        unlink(BENCH_SD_PATH);
+    }
+    delete writer;
+    sdcard_release();
+}
+
+static void lvgl_demo(hal::HalBase::SelfBenchmark_t* result)
+{
+#if CONFIG_LV_USE_DEMO_BENCHMARK
+    GetHAL()->lvglLock();
+    lv_screen_load(lv_obj_create(nullptr));
+    lv_demo_benchmark();
+    GetHAL()->lvglUnlock();
+
+    // A sample covers the second before it, the first whole one is a second in
+    uint32_t started = GetHAL()->millis();
+    uint32_t shownAt = 0;
+    int samples      = 0;
+    hal::HalBase::PerfStats_t stats;
+    while (GetHAL()->millis() - started < BENCH_LVGL_MS) {
+        vTaskDelay(pdMS_TO_TICKS(250));
+        if (GetHAL()->getPerfStats(&stats) && stats.sampledAtMs != shownAt &&
+            (int32_t)(stats.sampledAtMs - started) >= 1000) {
+            shownAt = stats.sampledAtMs;
+            result->lvglFps += stats.fps;
+            result->lvglRenderMs += stats.renderMs;
+            samples++;
+        }
+    }
+    if (samples > 0) {
+        result->lvglFps /= samples;
+        result->lvglRenderMs /= samples;
+    }
+#endif
+}
+
+static void describe_build(hal::HalBase::SelfBenchmark_t* result)
+{
+    const esp_app_desc_t* app = esp_app_get_description();
+    char text[96];
+    snprintf(text, sizeof(text), "%s (%s %s, IDF %s)", app->version, app->date, app->time, app->idf_ver);
+    result->firmware = text;
+
+    esp_chip_info_t chip;
+    esp_chip_info(&chip);
+    snprintf(text, sizeof(text), "%s rev v%d.%d, %u MB PSRAM", CONFIG_IDF_TARGET, chip.revision / 100,
+             chip.revision % 100, (unsigned)(esp_psram_get_size() / (1024 * 1024)));
+    result->hardware = text;
+}
+
+// The embedded MP3 first, then the samples on the card for the codecs there's nothing embedded of
+static void decode_loads(hal::HalBase::SelfBenchmark_t* result)
+{
+    hal::HalBase::RadioBenchmark_t radio;
+    if (GetHAL()->runRadioBenchmark(&radio)) {
+        result->decodeCycles = radio.cyclesPerFrame;
+        result->mp3Load      = radio.coreLoad;
+    }
+
+    for (const auto& entry : GetHAL()->scanSdCard(BENCH_SAMPLE_DIR)) {
+        std::string path = SDCARD_MOUNT_POINT "/" BENCH_SAMPLE_DIR "/" + entry.name;
+        if (entry.isDir || entry.name[0] == '.' || !GetHAL()->runRadioBenchmark(&radio, path.c_str())) {
+            continue;
+        }
+        if (radio.codec == hal::HalBase::RADIO_CODEC_AAC) {
+            result->aacLoad = radio.coreLoad;
+        } else if (radio.codec == hal::HalBase::RADIO_CODEC_OPUS) {
+            result->opusLoad = radio.coreLoad;
+        } else if (radio.codec == hal::HalBase::RADIO_CODEC_FLAC) {
+            result->flacLoad = radio.coreLoad;
+        }
+    }
+}
+
+// One JSON object per line, appended, so the card collects a history across boards and firmware
+static void store_result(const hal::HalBase::SelfBenchmark_t& r)
+{
+    if (!sdcard_acquire()) {
+        mclog::tagWarn(TAG, "No SD card, results not stored");
+        return;
+    }
+    FILE* file = fopen(BENCH_LOG_PATH, "a");
+    if (file) {
+        fprintf(file,
+                "{\"firmware\": \"%s\", \"hardware\": \"%s\", \"psram_copy_mbps\": %.1f, "
+                "\"internal_copy_mbps\": %.1f, \"ppa_rotate_mpxps\": %.1f, \"fft_cycles\": %u, \"dsp_cycles\": %u, "
+                "\"resample_cycles\": %u, \"ring_mbps\": %.1f, \"decode_cycles\": %u, \"mp3_load\": %.4f, "
+                "\"aac_load\": %.4f, \"opus_load\": %.4f, \"flac_load\": %.4f, \"net_mbps\": %.1f, "
+                "\"sd_write_mbps\": %.1f, \"sd_worst_write_ms\": %.1f, \"lvgl_fps\": %.1f, \"lvgl_render_ms\": %.2f}\n",
+                r.firmware.c_str(), r.hardware.c_str(), r.psramCopyMBps, r.internalCopyMBps, r.ppaRotateMpxps,
+                (unsigned)r.fftCycles, (unsigned)r.dspCycles, (unsigned)r.resampleCycles, r.ringMBps,
+                (unsigned)r.decodeCycles, r.mp3Load, r.aacLoad, r.opusLoad, r.flacLoad, r.netMbps, r.sdWriteMBps,
+                r.sdWorstWriteMs, r.lvglFps, r.lvglRenderMs);
+        fclose(file);
+        mclog::tagInfo(TAG, "Results appended to {}", BENCH_LOG_PATH);
+    } else {
+        mclog::tagWarn(TAG, "Can't write {}", BENCH_LOG_PATH);
+    }
+    sdcard_release();
+}
+
+static void self_bench_task(void* param)
+{
+    SelfBenchRun_t* run                    = (SelfBenchRun_t*)param;
+    hal::HalBase::SelfBenchmark_t& result = *run->result;
+
+    describe_build(&result);
+    mclog::tagInfo(TAG, "Self benchmark: {}, {}", result.firmware, result.hardware);
+
+    result.psramCopyMBps = copy_mbps(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, BENCH_PSRAM_COPY_BYTES,
+                                     BENCH_PSRAM_COPY_ROUNDS);
+    result.internalCopyMBps = copy_mbps(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, BENCH_INTERNAL_COPY_BYTES,
+                                        BENCH_INTERNAL_COPY_ROUNDS);
+    mclog::tagInfo(TAG, "memcpy: PSRAM {:.0f} MB/s, internal {:.0f} MB/s", result.psramCopyMBps,
+                   result.internalCopyMBps);
+
+    result.ppaRotateMpxps = ppa_rotate_mpxps();
+    mclog::tagInfo(TAG, "PPA rotate: {:.1f} Mpx/s", result.ppaRotateMpxps);
+
+    dsp_cycles(&result);
+    mclog::tagInfo(TAG, "DSP: FFT {} cycles, PcmDsp {} cycles, resampler {} cycles per frame", result.fftCycles,
+                   result.dspCycles, result.resampleCycles);
+
+    result.ringMBps = ring_mbps();
+    mclog::tagInfo(TAG, "Stream ring: {:.0f} MB/s", result.ringMBps);
+
+    decode_loads(&result);
+    mclog::tagInfo(TAG, "Decode core load: MP3 {:.1f}%, AAC {:.1f}%, Opus {:.1f}%, FLAC {:.1f}%",
+                   result.mp3Load * 100, result.aacLoad * 100, result.opusLoad * 100, result.flacLoad * 100);
+
+    hal::HalBase::NetBenchmark_t net;
+    if (GetHAL()->getWifiState() == hal::HalBase::WIFI_CONNECTED &&
+        GetHAL()->runNetworkBenchmark(CONFIG_TAB5_NET_BENCHMARK_URL, BENCH_NET_SECONDS, &net)) {
+        result.netMbps = net.mbps;
+    }
+
+    sd_write(&result);
+    mclog::tagInfo(TAG, "SD write: {:.1f} MB/s, slowest block {:.1f} ms", result.sdWriteMBps, result.sdWorstWriteMs);
+
+    lvgl_demo(&result);
+    mclog::tagInfo(TAG, "LVGL demo: {:.1f} fps, render {:.2f} ms", result.lvglFps, result.lvglRenderMs);
+
+    store_result(result);
+    mclog::tagInfo(TAG, "Self benchmark task ended, {} B stack left", task_topology::stack_headroom());
+    xTaskNotifyGive(run->caller);
+    vTaskDelete(nullptr);
+}
+
+bool HalEsp32::runSelfBenchmark(SelfBenchmark_t* result)
+{
+    // Stream buffers, the audio core and the network would be shared with a running stream
+    if (getRadioState() != RADIO_STOPPED) {
+        mclog::tagWarn(TAG, "Self benchmark: radio is playing");
+        return false;
+    }
+    if (s_running.exchange(true)) {
+        mclog::tagWarn(TAG, "Self benchmark: already running");
+        return false;
+    }
+
+    *result = {};
+    SelfBenchRun_t run;
+    run.result = result;
+    run.caller = xTaskGetCurrentTaskHandle();
+    // The numbers are for the full clock, not whatever floor the idle radio left it at
+    cpu_boost(true);
+    bool ok = task_topology::create(task_topology::RADIO_DECODE, self_bench_task, &run, nullptr, "self_bench") ==
+              pdPASS;
+    if (ok) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    cpu_boost(false);
+    s_running = false;
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Stress                                   */
+/* -------------------------------------------------------------------------- */
+// The loads audio glitches were seen with, each on the task and core the real thing runs on, under the playing
+// stream. A sampler on the calling task reads the output's stats and LVGL's frame times as the phase goes and
+// probes what's left of the PSRAM bandwidth with a short copy. The decode times come from the stream trace's
+// frame spans within the phase, so they're only there in a build with TAB5_STREAM_TRACE
+#define STRESS_MAX_SECONDS    300
+#define STRESS_SAMPLE_MS      100
+#define STRESS_PROBE_BYTES    (256 * 1024)  // A light reader, past the L2 cache but not a load of its own
+#define STRESS_PROBE_SAMPLES  5             // A probe every 500 ms
+#define STRESS_PSRAM_BYTES    (1024 * 1024)
+#define STRESS_I2C_ADDRESS    0x41  // The INA226, always there
+#define STRESS_I2C_TIMEOUT_MS 10
+#define STRESS_I2C_GAP_MS     2
+#define STRESS_REDRAW_MS      16
+#define STRESS_SD_PATH        SDCARD_MOUNT_POINT "/.stress_write"
+#define STRESS_SD_MAX_BYTES   (64 * 1024 * 1024)  // Starts over, the card doesn't fill up on a long phase
+#define STRESS_LOG_PATH       SDCARD_MOUNT_POINT "/stress.jsonl"
+#define STACKS_LOG_PATH       SDCARD_MOUNT_POINT "/stacks.jsonl"
+#define STRESS_LOAD_COUNT     5
+
+struct StressRun_t {
+    std::atomic<bool> stop{false};
+    SemaphoreHandle_t done = nullptr;  // Given by each load task as it ends
+};
+
+static void stress_ppa(StressRun_t* run)
+{
+    constexpr uint32_t width  = BSP_LCD_H_RES;
+    constexpr uint32_t height = BSP_LCD_V_RES;
+    constexpr size_t bytes    = width * height * 2;
+
+    ppa_client_handle_t client = nullptr;
+    ppa_client_config_t config = {};
+    config.oper_type           = PPA_OPERATION_SRM;
+    if (ppa_register_client(&config, &client) != ESP_OK) {
+        return;
+    }
+    uint8_t* in  = (uint8_t*)heap_caps_aligned_calloc(64, 1, bytes, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+    uint8_t* out = (uint8_t*)heap_caps_aligned_calloc(64, 1, bytes, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
+    if (in && out) {
+        ppa_srm_oper_config_t srm = {};
+        srm.in.buffer             = in;
+        srm.in.pic_w              = width;
+        srm.in.pic_h              = height;
+        srm.in.block_w            = width;
+        srm.in.block_h            = height;
+        srm.in.srm_cm             = PPA_SRM_COLOR_MODE_RGB565;
+        srm.out.buffer            = out;
+        srm.out.buffer_size       = bytes;
+        srm.out.pic_w             = height;
+        srm.out.pic_h             = width;
+        srm.out.srm_cm            = PPA_SRM_COLOR_MODE_RGB565;
+        srm.rotation_angle        = PPA_SRM_ROTATION_ANGLE_90;
+        srm.scale_x               = 1.0f;
+        srm.scale_y               = 1.0f;
+        srm.mode                  = PPA_TRANS_MODE_BLOCKING;
+        while (!run->stop && ppa_do_scale_rotate_mirror(client, &srm) == ESP_OK) {
+            vTaskDelay(1);  // The camera task waits on a frame in between too
+        }
+    }
+    heap_caps_free(in);
+    heap_caps_free(out);
+    ppa_unregister_client(client);
+}
+
+static void stress_redraw(StressRun_t* run)
+{
+    while (!run->stop) {
+        GetHAL()->lvglLock();
+        lv_obj_invalidate(lv_screen_active());
+        GetHAL()->lvglUnlock();
+        vTaskDelay(pdMS_TO_TICKS(STRESS_REDRAW_MS));
+    }
+}
+
+static void stress_sd(StressRun_t* run)
+{
+    if (!sdcard_acquire()) {
+        return;
+    }
+    SdWriter* writer = new (std::nothrow) SdWriter();
+    uint32_t seed    = 1;
+    while (writer && !run->stop && writer->open(STRESS_SD_PATH)) {
+        bool ok = true;
+        for (size_t written = 0; written < STRESS_SD_MAX_BYTES && ok && !run->stop; written += SdWriter::BLOCK_SIZE) {
+            uint32_t* words = (uint32_t*)writer->space();
+            for (size_t i = 0; i < SdWriter::BLOCK_SIZE / sizeof(uint32_t); i++) {
+                seed     = seed * 1664525u + 1013904223u;
+                words[i] = seed;
+            }
+            ok = writer->commit(SdWriter::BLOCK_SIZE);
+        }
+        if (!writer->close() || !ok) {
+            break;
+        }
+    }
+    unlink(STRESS_SD_PATH);
+    delete writer;
+    sdcard_release();
+}
+
+static void stress_i2c(StressRun_t* run)
+{
+    i2c_master_bus_handle_t bus = bsp_i2c_get_handle();
+    while (!run->stop) {
+        {
+            I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+            i2c_master_probe(bus, STRESS_I2C_ADDRESS, STRESS_I2C_TIMEOUT_MS);
+        }
+        vTaskDelay(pdMS_TO_TICKS(STRESS_I2C_GAP_MS));
+    }
+}
+
+static void stress_psram(StressRun_t* run)
+{
+    uint8_t* src = (uint8_t*)heap_caps_malloc(STRESS_PSRAM_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t* dst = (uint8_t*)heap_caps_malloc(STRESS_PSRAM_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (src && dst) {
+        memset(src, 0x5a, STRESS_PSRAM_BYTES);
+        while (!run->stop) {
+            memcpy(dst, src, STRESS_PSRAM_BYTES);
+            vTaskDelay(1);  // Other core 0 tasks of its priority get their turn
+        }
+    }
+    heap_caps_free(src);
+    heap_caps_free(dst);
+}
+
+struct StressLoadTask_t {
+    hal::HalBase::StressLoad_t load;
+    const char* name;
+    const task_topology::TaskConfig_t& config;  // Of the task the real load runs on
+    void (*fn)(StressRun_t* run);
+};
+static const StressLoadTask_t STRESS_LOADS[STRESS_LOAD_COUNT] = {
+    {hal::HalBase::STRESS_PPA, "stress_ppa", task_topology::CAMERA, stress_ppa},
+    {hal::HalBase::STRESS_REDRAW, "stress_redraw", task_topology::BACKGROUND, stress_redraw},
+    {hal::HalBase::STRESS_SD, "stress_sd", task_topology::RADIO_RECORD, stress_sd},
+    {hal::HalBase::STRESS_I2C, "stress_i2c", task_topology::POWER, stress_i2c},
+    {hal::HalBase::STRESS_PSRAM, "stress_psram", task_topology::BACKGROUND, stress_psram},
+};
+
+struct StressLoadRun_t {
+    StressRun_t* run;
+    const StressLoadTask_t* load;
+};
+
+static void stress_load_task(void* param)
+{
+    StressLoadRun_t* loadRun = (StressLoadRun_t*)param;
+    loadRun->load->fn(loadRun->run);
+    mclog::tagInfo(TAG, "{} ended, {} B stack left", loadRun->load->name, task_topology::stack_headroom());
+    xSemaphoreGive(loadRun->run->done);
+    task_topology::exit();  // The I2C load has a PSRAM stack
+}
+
+static float stress_probe_mbps(uint8_t* src, uint8_t* dst)
+{
+    int64_t start = esp_timer_get_time();
+    memcpy(dst, src, STRESS_PROBE_BYTES);
+    int64_t elapsed = esp_timer_get_time() - start;
+    return elapsed > 0 ? (float)STRESS_PROBE_BYTES / elapsed : 0;
+}
+
+// Percentiles of the frame decodes the trace holds from `sinceUs` on
+static void stress_decode_times(uint32_t sinceUs, hal::HalBase::StressPhase_t* phase)
+{
+#if CONFIG_TAB5_STREAM_TRACE
+    constexpr size_t capacity = 1u << CONFIG_TAB5_STREAM_TRACE_ORDER;
+    auto* records             = (StreamTrace::Record_t*)heap_caps_malloc(capacity * sizeof(StreamTrace::Record_t),
+                                                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!records) {
+        return;
+    }
+    StreamTrace::FileHeader_t header;
+    size_t count = stream_trace().copy(records, capacity, &header);
+    std::vector<uint32_t> times;
+    uint32_t begunAt = 0;
+    bool begun       = false;
+    for (size_t i = 0; i < count; i++) {
+        const auto& r = records[i];
+        if (r.event != TRACE_FRAME_DECODE || (int32_t)(r.timeUs - sinceUs) < 0) {
+            continue;
+        }
+        if (r.phase == TRACE_BEGIN) {
+            begunAt = r.timeUs;
+            begun   = true;
+        } else if (r.phase == TRACE_END && begun) {
+            times.push_back(r.timeUs - begunAt);
+            begun = false;
+        }
+    }
+    heap_caps_free(records);
+    if (times.empty()) {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    phase->decodeFrames = times.size();
+    phase->decodeP50Ms  = times[times.size() / 2] / 1000.0f;
+    phase->decodeP99Ms  = times[std::min(times.size() - 1, times.size() * 99 / 100)] / 1000.0f;
+    phase->decodeMaxMs  = times.back() / 1000.0f;
+#endif
+}
+
+static bool stress_phase(uint32_t loads, uint32_t seconds, uint8_t* probeSrc, uint8_t* probeDst,
+                         hal::HalBase::StressPhase_t* phase)
+{
+    StressRun_t run;
+    run.done = xSemaphoreCreateCounting(STRESS_LOAD_COUNT, 0);
+    if (!run.done) {
+        return false;
+    }
+    *phase       = {};
+    phase->loads = loads;
+
+    uint32_t sinceUs = (uint32_t)esp_timer_get_time();
+    stream_trace().record(TRACE_STRESS_LOAD, TRACE_BEGIN, loads);
+    StressLoadRun_t loadRuns[STRESS_LOAD_COUNT];
+    int started = 0;
+    for (const auto& load : STRESS_LOADS) {
+        if (!(loads & load.load)) {
+            continue;
+        }
+        loadRuns[started] = {&run, &load};
+        if (task_topology::create(load.config, stress_load_task, &loadRuns[started], nullptr, load.name) == pdPASS) {
+            started++;
+        } else {
+            mclog::tagWarn(TAG, "Stress: no {} task", load.name);
+        }
+    }
+
+    auto output          = GetHAL()->getRadioOutputStats();
+    uint32_t underruns   = output.underruns;
+    uint32_t startedAt   = GetHAL()->millis();
+    uint32_t perfShownAt = 0;
+    int perfSamples      = 0;
+    float probeMin       = 0;
+    hal::HalBase::PerfStats_t perf;
+    for (int sample = 0; GetHAL()->millis() - startedAt < seconds * 1000; sample++) {
+        vTaskDelay(pdMS_TO_TICKS(STRESS_SAMPLE_MS));
+        output                    = GetHAL()->getRadioOutputStats();
+        phase->outputLatencyMaxMs = std::max(phase->outputLatencyMaxMs, output.latencyMs);
+        if (sample % STRESS_PROBE_SAMPLES == 0) {
+            float mbps = stress_probe_mbps(probeSrc, probeDst);
+            probeMin   = probeMin == 0 ? mbps : std::min(probeMin, mbps);
+            task_topology::stack_sample();
+        }
+        // A sample covers the second before it, the first whole one is a second in
+        if (GetHAL()->getPerfStats(&perf) && perf.sampledAtMs != perfShownAt &&
+            (int32_t)(perf.sampledAtMs - startedAt) >= 1000) {
+            perfShownAt = perf.sampledAtMs;
+            phase->fps += perf.fps;
+            phase->frameMsMax = std::max(phase->frameMsMax, perf.renderMs + perf.flushMs);
+            perfSamples++;
+        }
+    }
+    phase->seconds   = (GetHAL()->millis() - startedAt) / 1000.0f;
+    phase->underruns = output.underruns - underruns;
+    phase->psramMBps = probeMin;
+    if (perfSamples > 0) {
+        phase->fps /= perfSamples;
+    }
+
+    run.stop = true;
+    for (int i = 0; i < started; i++) {
+        xSemaphoreTake(run.done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(run.done);
+    stream_trace().record(TRACE_STRESS_LOAD, TRACE_END, loads);
+    stress_decode_times(sinceUs, phase);
+    return true;
+}
+
+static std::string stress_load_names(uint32_t loads)
+{
+    if (loads == 0) {
+        return "none";
+    }
+    std::string names;
+    for (const auto& load : STRESS_LOADS) {
+        if (loads & load.load) {
+            names += (names.empty() ? "" : "+") + std::string(load.name + strlen("stress_"));
+        }
+    }
+    return names;
+}
+
+static void stress_store(const hal::HalBase::StressBenchmark_t& result)
+{
+    if (!sdcard_acquire()) {
+        mclog::tagWarn(TAG, "No SD card, results not stored");
+        return;
+    }
+    FILE* file = fopen(STRESS_LOG_PATH, "a");
+    if (file) {
+        const esp_app_desc_t* app = esp_app_get_description();
+        for (const auto& p : result.phases) {
+            fprintf(file,
+                    "{\"firmware\": \"%s (%s %s)\", \"loads\": \"%s\", \"seconds\": %.1f, \"underruns\": %u, "
+                    "\"output_latency_max_ms\": %u, \"decode_frames\": %u, \"decode_p50_ms\": %.2f, "
+                    "\"decode_p99_ms\": %.2f, \"decode_max_ms\": %.2f, \"fps\": %.1f, \"frame_max_ms\": %.2f, "
+                    "\"psram_mbps\": %.1f}\n",
+                    app->version, app->date, app->time, stress_load_names(p.loads).c_str(), p.seconds,
+                    (unsigned)p.underruns, (unsigned)p.outputLatencyMaxMs, (unsigned)p.decodeFrames, p.decodeP50Ms,
+                    p.decodeP99Ms, p.decodeMaxMs, p.fps, p.frameMsMax, p.psramMBps);
+        }
+        fclose(file);
+        mclog::tagInfo(TAG, "Results appended to {}", STRESS_LOG_PATH);
+    } else {
+        mclog::tagWarn(TAG, "Can't write {}", STRESS_LOG_PATH);
+    }
+    sdcard_release();
+}
+
+// What the tasks used of their stacks, over the stress run and everything before it since boot
+static void stacks_report(bool store)
+{
+    auto report = task_topology::stack_report();
+    for (const auto& use : report) {
+        if (use.stackSize == 0) {
+            mclog::tagInfo(TAG, "Stack {}: {} B free at least", use.name, use.leastFree);
+        } else {
+            mclog::tagInfo(TAG, "Stack {}: {} B{}, {} B free at least, {} B recommended{}", use.name, use.stackSize,
+                           use.psram ? " in PSRAM" : "", use.leastFree, use.recommended,
+                           use.running ? "" : " (not running)");
+        }
+    }
+    if (!store) {
+        return;
+    }
+    if (!sdcard_acquire()) {
+        return;
+    }
+    FILE* file = fopen(STACKS_LOG_PATH, "a");
+    if (file) {
+        const esp_app_desc_t* app = esp_app_get_description();
+        for (const auto& use : report) {
+            fprintf(file,
+                    "{\"firmware\": \"%s (%s %s)\", \"task\": \"%s\", \"stack\": %u, \"least_free\": %u, "
+                    "\"recommended\": %u, \"psram\": %s}\n",
+                    app->version, app->date, app->time, use.name, (unsigned)use.stackSize, (unsigned)use.leastFree,
+                    (unsigned)use.recommended, use.psram ? "true" : "false");
+        }
+        fclose(file);
+        mclog::tagInfo(TAG, "Stacks appended to {}", STACKS_LOG_PATH);
+    } else {
+        mclog::tagWarn(TAG, "Can't write {}", STACKS_LOG_PATH);
+    }
+    sdcard_release();
+}
+
+bool HalEsp32::runStressBenchmark(uint32_t phaseSeconds, uint32_t loads, StressBenchmark_t* result)
+{
+    // It's the stream's glitches it measures
+    if (getRadioState() != RADIO_PLAYING) {
+        mclog::tagWarn(TAG, "Stress: the radio isn't playing");
+        return false;
+    }
+    if (s_running.exchange(true)) {
+        mclog::tagWarn(TAG, "Stress: a benchmark is already running");
+        return false;
+    }
+
+    *result      = {};
+    loads        = loads & STRESS_ALL;
+    phaseSeconds = std::clamp<uint32_t>(phaseSeconds, 1, STRESS_MAX_SECONDS);
+    uint8_t* src = (uint8_t*)heap_caps_malloc(STRESS_PROBE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t* dst = (uint8_t*)heap_caps_malloc(STRESS_PROBE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    bool ok      = src && dst;
+    if (ok) {
+        memset(src, 0x5a, STRESS_PROBE_BYTES);
+        std::vector<uint32_t> combinations = {0};
+        for (const auto& load : STRESS_LOADS) {
+            if (loads & load.load) {
+                combinations.push_back(load.load);
+            }
+        }
+        if (combinations.size() > 2) {
+            combinations.push_back(loads);
+        }
+#if !CONFIG_TAB5_STREAM_TRACE
+        mclog::tagWarn(TAG, "Stress: no stream trace in this build, no decode times");
+#endif
+        for (uint32_t combination : combinations) {
+            StressPhase_t phase;
+            if (!stress_phase(combination, phaseSeconds, src, dst, &phase)) {
+                ok = false;
+                break;
+            }
+            result->phases.push_back(phase);
+            mclog::tagInfo(TAG,
+                           "Stress {}: {} underruns, output latency max {} ms, decode p50 {:.2f} p99 {:.2f} max "
+                           "{:.2f} ms ({} frames), {:.1f} fps, frame max {:.2f} ms, PSRAM {:.0f} MB/s",
+                           stress_load_names(combination), phase.underruns, phase.outputLatencyMaxMs,
+                           phase.decodeP50Ms, phase.decodeP99Ms, phase.decodeMaxMs, phase.decodeFrames, phase.fps,
+                           phase.frameMsMax, phase.psramMBps);
+        }
+    }
+    heap_caps_free(src);
+    heap_caps_free(dst);
+    if (ok) {
+        stress_store(*result);
+        stacks_report(true);
+    }
+    s_running = false;
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Console                                  */
+/* -------------------------------------------------------------------------- */
+#define BENCH_OUTPUT_SECONDS 30
+#define STRESS_PHASE_SECONDS 20
+
+static int bench_command(int argc, char** argv)
+{
+    hal::HalBase::SelfBenchmark_t result;
+    return GetHAL()->runSelfBenchmark(&result) ? 0 : 1;
+}
+
+static int bench_output_command(int argc, char** argv)
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : BENCH_OUTPUT_SECONDS;
+    hal::HalBase::OutputBenchmark_t result;
+    return GetHAL()->runOutputBenchmark(seconds, &result) ? 0 : 1;
+}
+
+// stress [seconds per phase] [ppa|redraw|sd|i2c|psram ...], all of them unless some are named
+static int stress_command(int argc, char** argv)
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : STRESS_PHASE_SECONDS;
+    uint32_t loads   = 0;
+    for (int i = 2; i < argc; i++) {
+        bool known = false;
+        for (const auto& load : STRESS_LOADS) {
+            if (strcmp(argv[i], load.name + strlen("stress_")) == 0) {
+                loads |= load.load;
+                known = true;
+            }
+        }
+        if (!known) {
+            printf("stress [seconds] [ppa|redraw|sd|i2c|psram ...]\n");
+            return 1;
+        }
+    }
+    hal::HalBase::StressBenchmark_t result;
+    return GetHAL()->runStressBenchmark(seconds, loads ? loads : hal::HalBase::STRESS_ALL, &result) ? 0 : 1;
+}
+
+// The stack report as it is now, `stress` stores it after its run
+static int stacks_command(int argc, char** argv)
+{
+    stacks_report(false);
+    return 0;
+}
+
+// input record | input stop <name> | input replay <name>, recordings are files on the SD card
+static int input_command(int argc, char** argv)
+{
+    if (argc == 2 && strcmp(argv[1], "record") == 0) {
+        return GetHAL()->startInputRecording() ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "stop") == 0) {
+        return GetHAL()->stopInputRecording(argv[2]) ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "replay") == 0) {
+        hal::HalBase::InputReplay_t result;
+        return GetHAL()->runInputReplay(argv[2], &result) ? 0 : 1;
+    }
+    printf("input record | input stop <name> | input replay <name>\n");
+    return 1;
+}
+
+// Runs in the background, the log shows how it goes
+static int update_command(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("update <url> [restart]\n");
+        return 1;
+    }
+    bool restart = argc > 2 && strcmp(argv[2], "restart") == 0;
+    return GetHAL()->startFirmwareUpdate(argv[1], restart) ? 0 : 1;
+}
+
+void benchmark_console_start()
+{
+    esp_console_repl_t* repl              = nullptr;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt                    = "tab5>";
+
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+#if CONFIG_ESP_CONSOLE_UART_DEFAULT || CONFIG_ESP_CONSOLE_UART_CUSTOM
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+#elif CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t jtag_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    err = esp_console_new_repl_usb_serial_jtag(&jtag_config, &repl_config, &repl);
+#endif
+    if (err != ESP_OK) {
+        mclog::tagWarn(TAG, "No console: {}", esp_err_to_name(err));
+        return;
+    }
+
+    esp_console_cmd_t command = {};
+    command.command           = "bench";
+    command.help              = "Run the self benchmark, the radio has to be stopped";
+    command.func              = bench_command;
+    esp_console_cmd_register(&command);
+
+    command.command = "bench_output";
+    command.help    = "Play silence through the radio's output, USB DAC or speaker: bench_output [seconds]";
+    command.func    = bench_output_command;
+    esp_console_cmd_register(&command);
+
+    command.command = "stress";
+    command.help    = "Loads under the playing stream, each alone then all: stress [seconds] [ppa|redraw|sd|i2c|psram]";
+    command.func    = stress_command;
+    esp_console_cmd_register(&command);
+
+    command.command = "stacks";
+    command.help    = "Least free stack per task since boot, and a size from it, biggest stacks first";
+    command.func    = stacks_command;
+    esp_console_cmd_register(&command);
+
+    command.command = "input";
+    command.help    = "Record the touch, mouse and keys, or replay them and time the frames: input record|stop|replay";
+    command.func    = input_command;
+    esp_console_cmd_register(&command);
+
+    command.command = "update";
+    command.help    = "Download a firmware update (pack_ota.py) into the other slot: update <url> [restart]";
+    command.func    = update_command;
+    esp_console_cmd_register(&command);
+    esp_console_start_repl(repl);
+}
@@ -4,11 +4,16 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
-#include "../utils/task_controller/task_controller.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/dma_buffer/dma_buffer.h"
+#include "../utils/joinable_task/joinable_task.h"
 #include <mooncake_log.h>
 #include <vector>
 #include <driver/gpio.h>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 #include "bsp/esp-bsp.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -27,8 +32,11 @@
 #include "esp_video_device.h"
 #include "driver/i2c_master.h"
 #include "driver/ppa.h"
-#include "imlib.h"
 #include "freertos/queue.h"
+#include <esp_http_server.h>
+#include <esp_heap_caps.h>
+#include <math.h>
+#include "human_face_detect.hpp"
 
 #define CAMERA_WIDTH  1280
 #define CAMERA_HEIGHT 720
@@ -36,17 +44,18 @@
 static lv_obj_t* camera_canvas;
 // extern uint8_t* frame_buf;
 static QueueHandle_t queue_camera_ctrl = NULL;
+static JoinableTask s_camera_task;  // Stopped with its token, the queue only carries requests
 // 定义任务控制标志
-#define TASK_CONTROL_PAUSE  0
-#define TASK_CONTROL_RESUME 1
-#define TASK_CONTROL_EXIT   2
+#define TASK_CONTROL_RESIZE 3     // To s_camera_request's preview size
+#define TASK_CONTROL_STILL  4     // One full resolution frame into s_camera_request.still
+#define CAMERA_JOIN_MS      1000  // A frame, a display refresh and the teardown
 
 static bool is_camera_capturing = false;
 static std::mutex camera_mutex;
 
 static const char* TAG = "camera";
 
-#define EXAMPLE_VIDEO_BUFFER_COUNT 2
+#define EXAMPLE_VIDEO_BUFFER_COUNT 3  // One on the canvas, one waiting for the display to let go, one filling
 #define MEMORY_TYPE                V4L2_MEMORY_MMAP
 #define CAM_DEV_PATH               ESP_VIDEO_MIPI_CSI_DEVICE_NAME
 #ifndef ARRAY_SIZE
@@ -59,6 +68,7 @@ typedef struct cam {
     uint32_t height;
     uint32_t pixel_format;
     uint8_t* buffer[EXAMPLE_VIDEO_BUFFER_COUNT];
+    uint32_t length[EXAMPLE_VIDEO_BUFFER_COUNT];
 } cam_t;
 
 /*
@@ -135,30 +145,13 @@ exit_0:
     return -1;
 }
 
-static esp_err_t new_cam(int cam_fd, cam_t** ret_wc)
+/**
+ * @brief Request, map and queue the buffers for the format set, then start streaming
+ */
+static esp_err_t cam_start(cam_t* wc)
 {
-    int ret;
-    struct v4l2_format format;
     int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     struct v4l2_requestbuffers req;
-    cam_t* wc;
-
-    memset(&format, 0, sizeof(struct v4l2_format));
-    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(cam_fd, VIDIOC_G_FMT, &format) != 0) {
-        ESP_LOGE(TAG, "Failed get fmt");
-        return ESP_FAIL;
-    }
-
-    wc = (cam_t*)malloc(sizeof(cam_t));
-    if (!wc) {
-        return ESP_ERR_NO_MEM;
-    }
-
-    wc->fd           = cam_fd;
-    wc->width        = format.fmt.pix.width;
-    wc->height       = format.fmt.pix.height;
-    wc->pixel_format = format.fmt.pix.pixelformat;
 
     memset(&req, 0, sizeof(req));
     req.count  = ARRAY_SIZE(wc->buffer);
@@ -166,8 +159,7 @@ static esp_err_t new_cam(int cam_fd, cam_t** ret_wc)
     req.memory = MEMORY_TYPE;
     if (ioctl(wc->fd, VIDIOC_REQBUFS, &req) != 0) {
         ESP_LOGE(TAG, "failed to req buffers");
-        ret = ESP_FAIL;
-        goto errout;
+        return ESP_FAIL;
     }
 
     for (int i = 0; i < ARRAY_SIZE(wc->buffer); i++) {
@@ -179,44 +171,541 @@ static esp_err_t new_cam(int cam_fd, cam_t** ret_wc)
         buf.index  = i;
         if (ioctl(wc->fd, VIDIOC_QUERYBUF, &buf) != 0) {
             ESP_LOGE(TAG, "failed to query buffer");
-            ret = ESP_FAIL;
-            goto errout;
+            return ESP_FAIL;
         }
 
         wc->buffer[i] = (uint8_t*)mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, wc->fd, buf.m.offset);
+        wc->length[i] = buf.length;
         if (!wc->buffer[i]) {
             ESP_LOGE(TAG, "failed to map buffer");
-            ret = ESP_FAIL;
-            goto errout;
+            return ESP_FAIL;
         }
 
         if (ioctl(wc->fd, VIDIOC_QBUF, &buf) != 0) {
             ESP_LOGE(TAG, "failed to queue frame buffer");
-            ret = ESP_FAIL;
-            goto errout;
+            return ESP_FAIL;
         }
     }
 
     if (ioctl(wc->fd, VIDIOC_STREAMON, &type)) {
         ESP_LOGE(TAG, "failed to start stream");
-        ret = ESP_FAIL;
-        goto errout;
+        return ESP_FAIL;
     }
+    return ESP_OK;
+}
 
+static esp_err_t new_cam(int cam_fd, cam_t** ret_wc)
+{
+    struct v4l2_format format;
+    cam_t* wc;
+
+    memset(&format, 0, sizeof(struct v4l2_format));
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(cam_fd, VIDIOC_G_FMT, &format) != 0) {
+        ESP_LOGE(TAG, "Failed get fmt");
+        return ESP_FAIL;
+    }
+
+    wc = (cam_t*)malloc(sizeof(cam_t));
+    if (!wc) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    wc->fd           = cam_fd;
+    wc->width        = format.fmt.pix.width;
+    wc->height       = format.fmt.pix.height;
+    wc->pixel_format = format.fmt.pix.pixelformat;
+
+    esp_err_t ret = cam_start(wc);
+    if (ret != ESP_OK) {
+        free(wc);
+        return ret;
+    }
     *ret_wc = wc;
     return ESP_OK;
+}
+
+/**
+ * @brief Stream `width` x `height` from now on, or the nearest the sensor and ISP have a mode for
+ *
+ * The format can only change with the stream off and no buffers out, every buffer must be back with the driver.
+ * The mappings are the driver's buffers themselves, gone with the zero count request: nothing may point into them.
+ */
+static esp_err_t cam_set_size(cam_t* wc, uint32_t width, uint32_t height)
+{
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(wc->fd, VIDIOC_STREAMOFF, &type) != 0) {
+        ESP_LOGE(TAG, "failed to stop stream");
+        return ESP_FAIL;
+    }
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count  = 0;
+    req.type   = type;
+    req.memory = MEMORY_TYPE;
+    ioctl(wc->fd, VIDIOC_REQBUFS, &req);
 
-errout:
-    free(wc);
-    return ret;
+    struct v4l2_format format;
+    memset(&format, 0, sizeof(format));
+    format.type                = type;
+    format.fmt.pix.width       = width;
+    format.fmt.pix.height      = height;
+    format.fmt.pix.pixelformat = wc->pixel_format;
+    if (ioctl(wc->fd, VIDIOC_S_FMT, &format) != 0) {
+        mclog::tagWarn(TAG, "No {}x{} mode, staying at {}x{}", width, height, wc->width, wc->height);
+    }
+    // What the driver settled on, which S_FMT may have adjusted
+    memset(&format, 0, sizeof(format));
+    format.type = type;
+    if (ioctl(wc->fd, VIDIOC_G_FMT, &format) == 0) {
+        wc->width  = format.fmt.pix.width;
+        wc->height = format.fmt.pix.height;
+    }
+    mclog::tagInfo(TAG, "Capturing {}x{}", wc->width, wc->height);
+    return cam_start(wc);
 }
 
-// static HumanFaceDetect* human_face_detector;
 static bool cam_is_initial = false;
 static cam_t* camera       = NULL;
 
-void app_camera_display(void* arg)
+// Asked of the capture task through its control queue, under camera_mutex
+static struct {
+    int width  = CAMERA_WIDTH;  // Preview size
+    int height = CAMERA_HEIGHT;
+    std::vector<uint16_t> still;  // Last still taken, RGB565
+    int stillWidth  = 0;
+    int stillHeight = 0;
+} s_camera_request;
+
+/* -------------------------------------------------------------------------- */
+/*                              Zero-copy display                             */
+/* -------------------------------------------------------------------------- */
+// The canvas shows the driver's own buffers: each frame becomes the canvas's draw buffer as it's dequeued, and the
+// one it replaced goes back to the driver once LVGL has finished a refresh since, when nothing reads it any more.
+// The sensor does the mirroring, only if it can't is the PPA used, into two staging buffers taking turns instead
+#define CAMERA_RELEASE_WAIT_MS 100  // For a refresh after a swap, a display that isn't refreshing drops frames
+#define CAMERA_STAGING_COUNT   2
+
+static constexpr size_t CAMERA_FRAME_SIZE = CAMERA_WIDTH * CAMERA_HEIGHT * 2;
+static constexpr int CAMERA_SLOTS         = EXAMPLE_VIDEO_BUFFER_COUNT + CAMERA_STAGING_COUNT;
+
+static std::atomic<uint32_t> s_camera_refreshes{0};  // LVGL refreshes finished
+
+static void on_display_refreshed(lv_event_t* e)
+{
+    s_camera_refreshes.fetch_add(1);
+}
+
+static bool wait_display_refresh(uint32_t since, uint32_t timeoutMs)
+{
+    for (uint32_t waited = 0; s_camera_refreshes.load() == since; waited++) {
+        if (waited >= timeoutMs) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+static bool sensor_mirror(int fd)
 {
+    struct v4l2_ext_control control;
+    struct v4l2_ext_controls controls;
+    memset(&control, 0, sizeof(control));
+    memset(&controls, 0, sizeof(controls));
+    control.id          = V4L2_CID_HFLIP;
+    control.value       = 1;
+    controls.ctrl_class = V4L2_CTRL_CLASS_USER;
+    controls.count      = 1;
+    controls.controls   = &control;
+    return ioctl(fd, VIDIOC_S_EXT_CTRLS, &controls) == 0;
+}
+
+static void queue_buffer(int index)
+{
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = MEMORY_TYPE;
+    buf.index  = index;
+    if (ioctl(camera->fd, VIDIOC_QBUF, &buf) != 0) {
+        ESP_LOGE(TAG, "failed to free video frame");
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Network stream                               */
+/* -------------------------------------------------------------------------- */
+// While the camera captures, viewers at /camera on the relay server get it as MJPEG. The JPEG codec reads the
+// driver's buffer itself, a USERPTR on the encoder's input, so no CPU ever copies a raw frame: only the compressed
+// one is copied out, for each viewer to send at its own pace. Viewers time their sends and the quality follows the
+// slowest of them, a frame that wouldn't fit its link at CAMERA_STREAM_FPS comes out smaller the next time
+#define CAMERA_STREAM_FPS         10
+#define CAMERA_STREAM_QUALITY     60    // JPEG quality to start at, 1 to 100
+#define CAMERA_STREAM_QUALITY_MIN 20
+#define CAMERA_STREAM_QUALITY_MAX 85
+#define CAMERA_STREAM_HEADROOM    0.7f  // Of a viewer's measured throughput one frame's worth may take
+#define CAMERA_STREAM_IDLE_MS     3000  // Without a new frame, the capture stopped and viewers are let go
+#define CAMERA_STREAM_BOUNDARY    "tab5frame"
+
+struct CameraViewer_t {
+    httpd_req_t* req;
+    int slot;  // In s_camera_stream.throughput
+};
+
+static struct {
+    std::mutex mutex;  // Up to the encoder's fields
+    std::vector<uint8_t> jpeg;
+    uint32_t sequence                           = 0;  // Of the frame in jpeg
+    bool used[CAMERA_STREAM_MAX_VIEWERS]        = {};
+    float throughput[CAMERA_STREAM_MAX_VIEWERS] = {};  // Bytes/s, 0 until the first send
+    std::atomic<int> viewers{0};
+    httpd_handle_t server = nullptr;
+
+    // Only the capture task touches the encoder
+    int fd                = -1;
+    uint8_t* output       = nullptr;  // The encoder's capture buffer, where the JPEG comes out
+    uint32_t outputLength = 0;
+    uint32_t width        = 0;
+    uint32_t height       = 0;
+    int quality           = CAMERA_STREAM_QUALITY;
+    int64_t lastUs        = 0;
+} s_camera_stream;
+
+static bool encoder_set_quality(int quality)
+{
+    struct v4l2_ext_control control;
+    struct v4l2_ext_controls controls;
+    memset(&control, 0, sizeof(control));
+    memset(&controls, 0, sizeof(controls));
+    control.id          = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+    control.value       = quality;
+    controls.ctrl_class = V4L2_CTRL_CLASS_JPEG;
+    controls.count      = 1;
+    controls.controls   = &control;
+    return ioctl(s_camera_stream.fd, VIDIOC_S_EXT_CTRLS, &controls) == 0;
+}
+
+static void encoder_close()
+{
+    if (s_camera_stream.fd < 0) {
+        return;
+    }
+    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    ioctl(s_camera_stream.fd, VIDIOC_STREAMOFF, &type);
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ioctl(s_camera_stream.fd, VIDIOC_STREAMOFF, &type);
+    if (s_camera_stream.output) {
+        munmap(s_camera_stream.output, s_camera_stream.outputLength);
+    }
+    close(s_camera_stream.fd);
+    s_camera_stream.fd     = -1;
+    s_camera_stream.output = nullptr;
+    s_camera_stream.width  = 0;
+    s_camera_stream.height = 0;
+}
+
+/**
+ * @brief The esp_video JPEG device as a mem2mem encoder: RGB565 frames of the camera's size in, JPEG out
+ */
+static bool encoder_open(uint32_t width, uint32_t height)
+{
+    encoder_close();
+    int fd = open(ESP_VIDEO_JPEG_DEVICE_NAME, O_RDONLY);
+    if (fd < 0) {
+        mclog::tagError(TAG, "No JPEG encoder, the stream is off");
+        return false;
+    }
+    s_camera_stream.fd = fd;
+    encoder_set_quality(s_camera_stream.quality);
+
+    struct v4l2_format format;
+    memset(&format, 0, sizeof(format));
+    format.type                = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    format.fmt.pix.width       = width;
+    format.fmt.pix.height      = height;
+    format.fmt.pix.pixelformat = V4L2_PIX_FMT_RGB565;
+    bool ok                    = ioctl(fd, VIDIOC_S_FMT, &format) == 0;
+    format.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    format.fmt.pix.pixelformat = V4L2_PIX_FMT_JPEG;
+    ok                         = ok && ioctl(fd, VIDIOC_S_FMT, &format) == 0;
+
+    // The input is whichever capture buffer just came in, lent for the one encode
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count  = 1;
+    req.type   = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_USERPTR;
+    ok         = ok && ioctl(fd, VIDIOC_REQBUFS, &req) == 0;
+
+    memset(&req, 0, sizeof(req));
+    req.count  = 1;
+    req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    ok         = ok && ioctl(fd, VIDIOC_REQBUFS, &req) == 0;
+
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index  = 0;
+    if (ok && ioctl(fd, VIDIOC_QUERYBUF, &buf) == 0) {
+        s_camera_stream.output       = (uint8_t*)mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                                                      buf.m.offset);
+        s_camera_stream.outputLength = buf.length;
+    }
+    ok = ok && s_camera_stream.output && ioctl(fd, VIDIOC_QBUF, &buf) == 0;
+
+    int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    ok       = ok && ioctl(fd, VIDIOC_STREAMON, &type) == 0;
+    type     = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ok       = ok && ioctl(fd, VIDIOC_STREAMON, &type) == 0;
+    if (!ok) {
+        mclog::tagError(TAG, "JPEG encoder won't take {}x{}, the stream is off", width, height);
+        encoder_close();
+        return false;
+    }
+    s_camera_stream.width  = width;
+    s_camera_stream.height = height;
+    mclog::tagInfo(TAG, "Streaming {}x{} JPEG, quality {}", width, height, s_camera_stream.quality);
+    return true;
+}
+
+/**
+ * @brief Encode the capture buffer `index` for the viewers, if there are any and one is due
+ *
+ * The buffer stays the capture task's: the encode is over by the time this returns.
+ */
+static void camera_stream_frame(int index)
+{
+    if (s_camera_stream.viewers.load() == 0) {
+        encoder_close();
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (now - s_camera_stream.lastUs < 1000000 / CAMERA_STREAM_FPS) {
+        return;
+    }
+    s_camera_stream.lastUs = now;
+    if ((s_camera_stream.width != camera->width || s_camera_stream.height != camera->height) &&
+        !encoder_open(camera->width, camera->height)) {
+        return;
+    }
+
+    int fd = s_camera_stream.fd;
+    struct v4l2_buffer input;
+    memset(&input, 0, sizeof(input));
+    input.type      = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    input.memory    = V4L2_MEMORY_USERPTR;
+    input.index     = 0;
+    input.m.userptr = (unsigned long)camera->buffer[index];
+    input.length    = camera->length[index];
+    input.bytesused = camera->width * camera->height * 2;
+    if (ioctl(fd, VIDIOC_QBUF, &input) != 0) {
+        encoder_close();
+        return;
+    }
+    struct v4l2_buffer output;
+    memset(&output, 0, sizeof(output));
+    output.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    output.memory = V4L2_MEMORY_MMAP;
+    bool encoded  = ioctl(fd, VIDIOC_DQBUF, &output) == 0;
+    size_t size   = encoded ? output.bytesused : 0;
+
+    float slowest = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+        if (size > 0) {
+            s_camera_stream.jpeg.assign(s_camera_stream.output, s_camera_stream.output + size);
+            s_camera_stream.sequence++;
+        }
+        for (int i = 0; i < CAMERA_STREAM_MAX_VIEWERS; i++) {
+            float bps = s_camera_stream.throughput[i];
+            if (s_camera_stream.used[i] && bps > 0 && (slowest == 0 || bps < slowest)) {
+                slowest = bps;
+            }
+        }
+    }
+    if (encoded) {
+        ioctl(fd, VIDIOC_QBUF, &output);
+    }
+    ioctl(fd, VIDIOC_DQBUF, &input);  // The capture buffer is the driver's again
+    if (!encoded) {
+        encoder_close();
+        return;
+    }
+
+    // Down fast when a frame doesn't fit, back up slowly when several would
+    if (slowest > 0) {
+        float budget = slowest * CAMERA_STREAM_HEADROOM / CAMERA_STREAM_FPS;
+        int quality  = s_camera_stream.quality;
+        if (size > budget) {
+            quality = std::max(CAMERA_STREAM_QUALITY_MIN, quality - 10);
+        } else if (size < budget / 2) {
+            quality = std::min(CAMERA_STREAM_QUALITY_MAX, quality + 5);
+        }
+        if (quality != s_camera_stream.quality && encoder_set_quality(quality)) {
+            mclog::tagInfo(TAG, "Stream quality {}, {} KB frames on a {} KB/s link", quality, size / 1024,
+                           (int)(slowest / 1024));
+            s_camera_stream.quality = quality;
+        }
+    }
+}
+
+/**
+ * @return false if the viewer is gone or stopped reading for a whole send timeout
+ */
+static bool camera_stream_send(httpd_req_t* req, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        int sent = httpd_send(req, (const char*)data, len);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+static void camera_viewer_task(void* param)
+{
+    CameraViewer_t* viewer = (CameraViewer_t*)param;
+    httpd_req_t* req       = viewer->req;
+    const char* header     = "HTTP/1.0 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary="
+                             CAMERA_STREAM_BOUNDARY "\r\nCache-Control: no-cache\r\n\r\n";
+    bool ok                = camera_stream_send(req, (const uint8_t*)header, strlen(header));
+    mclog::tagInfo(TAG, "Stream: new viewer");
+
+    std::vector<uint8_t> frame;
+    uint32_t seen      = 0;
+    uint32_t idleSince = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    size_t frames      = 0;
+    while (ok) {
+        {
+            std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+            if (s_camera_stream.sequence != seen) {
+                frame = s_camera_stream.jpeg;
+                seen  = s_camera_stream.sequence;
+            } else {
+                frame.clear();
+            }
+        }
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        if (frame.empty()) {
+            if (now - idleSince > CAMERA_STREAM_IDLE_MS) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        idleSince = now;
+
+        char part[128];
+        int len = snprintf(part, sizeof(part),
+                           "\r\n--" CAMERA_STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                           (unsigned)frame.size());
+        int64_t start = esp_timer_get_time();
+        ok            = camera_stream_send(req, (const uint8_t*)part, len) &&
+             camera_stream_send(req, frame.data(), frame.size());
+        int64_t took  = std::max<int64_t>(esp_timer_get_time() - start, 1);
+        float bps     = (len + frame.size()) * 1000000.0f / took;
+        frames++;
+        std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+        float& measured = s_camera_stream.throughput[viewer->slot];
+        measured        = (measured == 0) ? bps : measured * 0.7f + bps * 0.3f;
+    }
+    mclog::tagInfo(TAG, "Stream: viewer left after {} frames, {} B stack left", frames,
+                   task_topology::stack_headroom());
+
+    int sockfd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(s_camera_stream.server, sockfd);
+    {
+        std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+        s_camera_stream.used[viewer->slot]       = false;
+        s_camera_stream.throughput[viewer->slot] = 0;
+    }
+    s_camera_stream.viewers.fetch_sub(1);
+    delete viewer;
+    vTaskDelete(NULL);
+}
+
+// In the server task, which hands the viewer its own task like the relay's listeners
+static esp_err_t camera_stream_handler(httpd_req_t* req)
+{
+    {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+        if (!is_camera_capturing) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_sendstr(req, "Camera is off");
+            return ESP_OK;
+        }
+    }
+    int slot = -1;
+    {
+        std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+        for (int i = 0; i < CAMERA_STREAM_MAX_VIEWERS && slot < 0; i++) {
+            if (!s_camera_stream.used[i]) {
+                slot                          = i;
+                s_camera_stream.used[i]       = true;
+                s_camera_stream.throughput[i] = 0;
+            }
+        }
+    }
+    if (slot < 0) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Too many viewers");
+        return ESP_OK;
+    }
+
+    auto unclaim = [slot]() {
+        std::lock_guard<std::mutex> lock(s_camera_stream.mutex);
+        s_camera_stream.used[slot] = false;
+    };
+    httpd_req_t* asyncReq = nullptr;
+    if (httpd_req_async_handler_begin(req, &asyncReq) != ESP_OK) {
+        unclaim();
+        return ESP_FAIL;
+    }
+    CameraViewer_t* viewer = new CameraViewer_t{asyncReq, slot};
+    s_camera_stream.viewers.fetch_add(1);
+    if (task_topology::create(task_topology::CAMERA_VIEW, camera_viewer_task, viewer, nullptr) != pdPASS) {
+        s_camera_stream.viewers.fetch_sub(1);
+        httpd_req_async_handler_complete(asyncReq);
+        delete viewer;
+        unclaim();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void camera_stream_attach(httpd_handle_t server)
+{
+    s_camera_stream.server = server;
+    static const httpd_uri_t camera_uri = {
+        .uri = "/camera", .method = HTTP_GET, .handler = camera_stream_handler, .user_ctx = nullptr};
+    if (httpd_register_uri_handler(server, &camera_uri) != ESP_OK) {
+        mclog::tagError(TAG, "Can't serve /camera");
+    }
+}
+
+int HalEsp32::getCameraStreamViewers()
+{
+    return s_camera_stream.viewers.load();
+}
+
+/**
+ * @brief The sensor streaming into `camera`, set up once and kept from then on. Capture task or presence task only
+ */
+static bool camera_open()
+{
+    static bool s_camera_open = false;  // An init that failed isn't tried again
+
+    // Boot leaves the sensor's clock off, nothing else needs it
+    static std::once_flag osc_once;
+    std::call_once(osc_once, [] { bsp_cam_osc_init(); });
+
     /* camera config */
     static esp_video_init_csi_config_t csi_config = {
         .sccb_config =
@@ -245,44 +734,134 @@ void app_camera_display(void* arg)
         int video_cam_fd = app_video_open(CAM_DEV_PATH, EXAMPLE_VIDEO_FMT_RGB565);
         if (video_cam_fd < 0) {
             ESP_LOGE(TAG, "video cam open failed");
-            return;
+            return false;
         }
         ESP_ERROR_CHECK(new_cam(video_cam_fd, &camera));
+        s_camera_open = true;
     }
+    return s_camera_open;
+}
 
-    struct v4l2_buffer buf;
+static void presence_resume();
 
-    /* */
-    uint16_t screen_width  = 1280;  // 640;//lcd_height();
-    uint16_t screen_height = 720;   // 480;//lcd_width();
-    uint8_t* img_show_data = NULL;
-    uint32_t img_show_size = screen_width * screen_height * 2;
-    // uint32_t img_offset = 280 * 720 * 2;
-    uint32_t img_offset = 0;
-    static image_t* img_show;  // 初始化静态变量时不能使用非常量表达式
-    if (img_show == NULL) {
-        img_show    = (image_t*)malloc(sizeof(image_t));
-        img_show->w = 720,            // screen_width;
-                                      // img_show->h = 720, // screen_height;
-            img_show->h      = 1280,  // screen_height;
-            img_show->pixfmt = PIXFORMAT_RGB565;
-        img_show->size       = img_show->w * img_show->h * img_show->bpp;
-        img_show_data        = (uint8_t*)heap_caps_calloc(img_show_size, 1, MALLOC_CAP_DMA | MALLOC_CAP_SPIRAM);
-        img_show->data       = img_show_data + img_offset;
-        if (img_show->data == NULL) {
-            ESP_LOGE(TAG, "malloc for img_show->data failed");
-        }
+static void app_camera_display(void* arg, const CancelToken& token)
+{
+    if (!camera_open()) {
+        camera_mutex.lock();
+        is_camera_capturing = false;
+        camera_mutex.unlock();
+        presence_resume();
+        return;
     }
+    // Frames come at the sensor's rate, whatever the radio needs the clock for
+    cpu_boost(true);
 
+    DmaBuffer staging[CAMERA_STAGING_COUNT];  // Whole cache lines, the PPA won't write anything else
     ppa_client_handle_t ppa_srm_handle = NULL;
-    ppa_client_config_t ppa_srm_config = {
-        .oper_type             = PPA_OPERATION_SRM,
-        .max_pending_trans_num = 1,
+    bool mirrored                      = false;
+
+    // Slots up to EXAMPLE_VIDEO_BUFFER_COUNT are the driver's buffers, the staging ones follow
+    static lv_draw_buf_t draw_bufs[CAMERA_SLOTS];
+    auto release = [](int slot) {
+        if (slot >= 0 && slot < EXAMPLE_VIDEO_BUFFER_COUNT) {
+            queue_buffer(slot);
+        }
+    };
+    // After every format change: the size, the buffers and the sensor's flip may all be new
+    auto bind = [&]() {
+        size_t frame_size = camera->width * camera->height * 2;
+        mirrored          = sensor_mirror(camera->fd);
+        if (!mirrored && !ppa_srm_handle) {
+            mclog::tagWarn(TAG, "Sensor can't mirror, the PPA copies each frame");
+            ppa_client_config_t ppa_srm_config = {
+                .oper_type             = PPA_OPERATION_SRM,
+                .max_pending_trans_num = 1,
+            };
+            ESP_ERROR_CHECK(ppa_register_client(&ppa_srm_config, &ppa_srm_handle));
+            for (auto& buffer : staging) {
+                buffer.alloc(CAMERA_FRAME_SIZE, MALLOC_CAP_SPIRAM);
+            }
+        }
+        for (int slot = 0; slot < CAMERA_SLOTS; slot++) {
+            bool driver   = slot < EXAMPLE_VIDEO_BUFFER_COUNT;
+            uint8_t* data = driver ? camera->buffer[slot] : staging[slot - EXAMPLE_VIDEO_BUFFER_COUNT].data();
+            size_t size   = driver ? camera->length[slot] : CAMERA_FRAME_SIZE;
+            if (data && size >= frame_size) {
+                lv_draw_buf_init(&draw_bufs[slot], camera->width, camera->height, LV_COLOR_FORMAT_RGB565, 0, data,
+                                 size);
+            }
+        }
+    };
+
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+        width  = s_camera_request.width;
+        height = s_camera_request.height;
+    }
+    bool resize = (int)camera->width != width || (int)camera->height != height;
+    if (resize && cam_set_size(camera, width, height) != ESP_OK) {
+        ESP_LOGE(TAG, "video cam restart failed");
+    }
+    bind();
+
+    lvgl_lock(hal::HalBase::LVGL_LOCK_CAMERA);
+    lv_display_add_event_cb(lv_display_get_default(), on_display_refreshed, LV_EVENT_REFR_READY, NULL);
+    lvgl_unlock();
+
+    int shown             = -1;  // Slot on the canvas
+    int pending           = -1;  // Slot swapped out, until a refresh after pending_mark
+    uint32_t pending_mark = 0;
+    bool hidden           = false;
+    int task_control      = 0;
+
+    // A format change frees the driver's buffers, the canvas lets go of them and everything held goes back first
+    auto give_back = [&]() {
+        lvgl_lock(hal::HalBase::LVGL_LOCK_CAMERA);
+        lv_obj_add_flag(camera_canvas, LV_OBJ_FLAG_HIDDEN);
+        lvgl_unlock();
+        hidden = true;
+        release(pending);
+        release(shown);
+        pending = -1;
+        shown   = -1;
+    };
+
+    auto take_still = [&]() {
+        uint32_t preview_width  = camera->width;
+        uint32_t preview_height = camera->height;
+        bool ok                 = false;
+        give_back();
+        if (cam_set_size(camera, CAMERA_WIDTH, CAMERA_HEIGHT) == ESP_OK) {
+            // The first frame after a mode change may still carry the old exposure, the second is kept
+            for (int frame = 0; frame < 2; frame++) {
+                struct v4l2_buffer still;
+                memset(&still, 0, sizeof(still));
+                still.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                still.memory = MEMORY_TYPE;
+                if (ioctl(camera->fd, VIDIOC_DQBUF, &still) != 0) {
+                    break;
+                }
+                if (frame == 1) {
+                    std::lock_guard<std::mutex> lock(camera_mutex);
+                    const uint16_t* pixels = (const uint16_t*)camera->buffer[still.index];
+                    s_camera_request.still.assign(pixels, pixels + camera->width * camera->height);
+                    s_camera_request.stillWidth  = camera->width;
+                    s_camera_request.stillHeight = camera->height;
+                    ok                           = true;
+                }
+                queue_buffer(still.index);
+            }
+        }
+        hal_post_event(hal::HalBase::EVENT_CAMERA_STILL, ok);
+        if (cam_set_size(camera, preview_width, preview_height) != ESP_OK) {
+            ESP_LOGE(TAG, "video cam restart failed");
+        }
+        bind();
     };
-    ESP_ERROR_CHECK(ppa_register_client(&ppa_srm_config, &ppa_srm_handle));
 
-    int task_control = 0;
-    while (1) {
+    struct v4l2_buffer buf;
+    while (!token.cancelled()) {
         memset(&buf, 0, sizeof(buf));
         buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         buf.memory = MEMORY_TYPE;
@@ -290,102 +869,382 @@ void app_camera_display(void* arg)
             ESP_LOGE(TAG, "failed to receive video frame");
             break;
         }
+        int slot = buf.index;
+        camera_stream_frame(slot);
+
+        if (pending >= 0 && s_camera_refreshes.load() != pending_mark) {
+            release(pending);
+            pending = -1;
+        }
+        if (pending >= 0) {
+            release(slot);  // The display is behind, this frame is dropped
+        } else {
+            size_t frame_size = camera->width * camera->height * 2;
+            if (!mirrored && staging[0] && staging[1] && frame_size <= CAMERA_FRAME_SIZE) {
+                int target = (shown == EXAMPLE_VIDEO_BUFFER_COUNT) ? EXAMPLE_VIDEO_BUFFER_COUNT + 1
+                                                                   : EXAMPLE_VIDEO_BUFFER_COUNT;
+                DmaBuffer& out = staging[target - EXAMPLE_VIDEO_BUFFER_COUNT];
+                ppa_srm_oper_config_t srm_config = {
+                    .in             = {.buffer         = camera->buffer[slot],
+                                       .pic_w          = camera->width,
+                                       .pic_h          = camera->height,
+                                       .block_w        = camera->width,
+                                       .block_h        = camera->height,
+                                       .block_offset_x = 0,
+                                       .block_offset_y = 0,
+                                       .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
+                    .out            = {.buffer         = out.data(),
+                                       .buffer_size    = (uint32_t)out.size(),
+                                       .pic_w          = camera->width,
+                                       .pic_h          = camera->height,
+                                       .block_offset_x = 0,
+                                       .block_offset_y = 0,
+                                       .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
+                    .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
+                    .scale_x        = 1,
+                    .scale_y        = 1,
+                    .mirror_x       = true,
+                    .mirror_y       = false,
+                    .rgb_swap       = false,
+                    .byte_swap      = false,
+                    .mode           = PPA_TRANS_MODE_BLOCKING};
+                ppa_do_scale_rotate_mirror(ppa_srm_handle, &srm_config);
+                release(slot);
+                slot = target;
+            }
+
+            // Under the lock no refresh is in progress, the first one to finish after it draws the new frame
+            lvgl_lock(hal::HalBase::LVGL_LOCK_CAMERA);
+            lv_canvas_set_draw_buf(camera_canvas, &draw_bufs[slot]);
+            lv_obj_invalidate(camera_canvas);
+            if (hidden) {
+                lv_obj_remove_flag(camera_canvas, LV_OBJ_FLAG_HIDDEN);
+                hidden = false;
+            }
+            pending_mark = s_camera_refreshes.load();
+            lvgl_unlock();
+            pending = shown;
+            shown   = slot;
 
-        ppa_srm_oper_config_t srm_config = {.in             = {.buffer         = camera->buffer[buf.index],
-                                                               .pic_w          = 1280,
-                                                               .pic_h          = 720,
-                                                               .block_w        = 1280,
-                                                               .block_h        = 720,
-                                                               .block_offset_x = 0,
-                                                               .block_offset_y = 0,
-                                                               .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
-                                            .out            = {.buffer         = img_show_data,
-                                                               .buffer_size    = img_show_size,
-                                                               .pic_w          = 1280,
-                                                               .pic_h          = 720,
-                                                               .block_offset_x = 0,
-                                                               .block_offset_y = 0,
-                                                               .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
-                                            .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
-                                            .scale_x        = 1,
-                                            .scale_y        = 1,
-                                            .mirror_x       = true,
-                                            .mirror_y       = false,
-                                            .rgb_swap       = false,
-                                            .byte_swap      = false,
-                                            .mode           = PPA_TRANS_MODE_BLOCKING};
-        ppa_do_scale_rotate_mirror(ppa_srm_handle, &srm_config);
-
-        // auto detect_results = human_face_detector->run(dl_img); // format: hwc
-
-        bsp_display_lock(0);
-        lv_canvas_set_buffer(camera_canvas, img_show->data, CAMERA_WIDTH, CAMERA_HEIGHT, LV_COLOR_FORMAT_RGB565);
-        bsp_display_unlock();
-
-        if (ioctl(camera->fd, VIDIOC_QBUF, &buf) != 0) {
-            ESP_LOGE(TAG, "failed to free video frame");
+            // Back with the driver before it needs it for the frame after next
+            if (pending >= 0 && wait_display_refresh(pending_mark, CAMERA_RELEASE_WAIT_MS)) {
+                release(pending);
+                pending = -1;
+            }
         }
 
         if (xQueueReceive(queue_camera_ctrl, &task_control, 0) == pdPASS) {
-            if (task_control == TASK_CONTROL_PAUSE) {
-                ESP_LOGI(TAG, "task pause");
-                if (xQueueReceive(queue_camera_ctrl, &task_control, portMAX_DELAY) == pdPASS) {
-                    if (task_control == TASK_CONTROL_EXIT) {
-                        break;
-                    } else {
-                        ESP_LOGI(TAG, "task resume");
+            if (task_control == TASK_CONTROL_RESIZE) {
+                {
+                    std::lock_guard<std::mutex> lock(camera_mutex);
+                    width  = s_camera_request.width;
+                    height = s_camera_request.height;
+                }
+                if ((int)camera->width != width || (int)camera->height != height) {
+                    give_back();
+                    if (cam_set_size(camera, width, height) != ESP_OK) {
+                        ESP_LOGE(TAG, "video cam restart failed");
                     }
+                    bind();
                 }
+            } else if (task_control == TASK_CONTROL_STILL) {
+                take_still();
             }
         }
-
-        vTaskDelay(pdMS_TO_TICKS(10));
     }
 
     ESP_LOGI(TAG, "task exit");
-    ppa_unregister_client(ppa_srm_handle);
-    // delete human_face_detector;
-    if (img_show_data) {
-        heap_caps_free(img_show_data);
-        img_show_data = NULL;
+    lvgl_lock(hal::HalBase::LVGL_LOCK_CAMERA);
+    lv_display_remove_event_cb_with_user_data(lv_display_get_default(), on_display_refreshed, NULL);
+    lvgl_unlock();
+    // The canvas is hidden before a stop, everything held goes back for the next start
+    release(pending);
+    release(shown);
+    if (ppa_srm_handle) {
+        ppa_unregister_client(ppa_srm_handle);
     }
-    if (img_show) {
-        heap_caps_free(img_show);
-        img_show = NULL;
+    for (auto& buffer : staging) {
+        buffer.free();
     }
+    encoder_close();
     // close(camera->fd);
 
+    cpu_boost(false);
     camera_mutex.lock();
     is_camera_capturing = false;
     camera_mutex.unlock();
+    presence_resume();
+}
 
-    vTaskDelete(NULL);
+/* -------------------------------------------------------------------------- */
+/*                                  Presence                                  */
+/* -------------------------------------------------------------------------- */
+// A face detector looking a couple of times a second, on the network core so the decoder's never sees it. The sensor
+// streams at the mode nearest PRESENCE_WIDTH x PRESENCE_HEIGHT, each frame looked at is scaled down by the PPA to at
+// most PRESENCE_WIDTH wide and the model (espressif/human_face_detect, read from the human_face_det partition) runs
+// on that. Its tensors and the scaled frame are in PSRAM: a run needs PRESENCE_PSRAM_BUDGET free to start, and warns
+// once they have taken more than that
+#define PRESENCE_WIDTH        320
+#define PRESENCE_HEIGHT       240    // Asked of the sensor, the scaled frame keeps whatever aspect it settles on
+#define PRESENCE_INTERVAL_MS  500    // Between detections, 2 fps
+#define PRESENCE_LOST_MS      30000  // Without a face before nobody is there
+#define PRESENCE_PSRAM_BUDGET (1024 * 1024)
+#define PRESENCE_REPORT_MS    60000  // Between load reports in the log
+
+static struct {
+    std::mutex mutex;  // Everything below but running, and the task's starts and stops
+    JoinableTask task;
+    std::atomic<bool> running{false};
+    bool wanted = false;  // Detection is on, whether the camera lets it run right now or not
+} s_presence;
+
+static void presence_task(void* param)
+{
+    if (!camera_open() || cam_set_size(camera, PRESENCE_WIDTH, PRESENCE_HEIGHT) != ESP_OK) {
+        mclog::tagError(TAG, "Presence: no camera");
+        s_presence.running = false;
+        return;
+    }
+    // The driver's buffers are the sensor's business, the budget is what's set aside from here on
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    if (psram_free < PRESENCE_PSRAM_BUDGET) {
+        mclog::tagError(TAG, "Presence: {} KB of PSRAM free, {} KB needed", psram_free / 1024,
+                        PRESENCE_PSRAM_BUDGET / 1024);
+        s_presence.running = false;
+        return;
+    }
+
+    // The PPA scales in sixteenths
+    float scale = std::max(1.0f / 16, floorf(16.0f * std::min<uint32_t>(PRESENCE_WIDTH, camera->width) /
+                                            camera->width) / 16);
+    uint16_t width  = camera->width * scale;
+    uint16_t height = camera->height * scale;
+
+    DmaBuffer frame;
+    ppa_client_handle_t ppa_srm_handle = NULL;
+    ppa_client_config_t ppa_srm_config = {
+        .oper_type             = PPA_OPERATION_SRM,
+        .max_pending_trans_num = 1,
+    };
+    if (!frame.alloc(width * height * 2, MALLOC_CAP_SPIRAM) ||
+        ppa_register_client(&ppa_srm_config, &ppa_srm_handle) != ESP_OK) {
+        mclog::tagError(TAG, "Presence: no room for a {}x{} frame", width, height);
+        frame.free();
+        s_presence.running = false;
+        return;
+    }
+    auto detector = std::make_unique<HumanFaceDetect>();
+    mclog::tagInfo(TAG, "Presence: looking at {}x{}, scaled from {}x{}", width, height, camera->width,
+                   camera->height);
+
+    bool present        = true;
+    int64_t seenAt      = esp_timer_get_time();
+    int64_t reportStart = seenAt;
+    int64_t busyUs      = 0;
+    bool overBudget     = false;
+    struct v4l2_buffer buf;
+    while (s_presence.running.load()) {
+        int64_t start = esp_timer_get_time();
+
+        // What the driver holds was filled while nobody looked, it goes back and the next frame is a fresh one
+        bool ok = true;
+        for (int i = 0; i <= EXAMPLE_VIDEO_BUFFER_COUNT && ok; i++) {
+            memset(&buf, 0, sizeof(buf));
+            buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = MEMORY_TYPE;
+            ok         = ioctl(camera->fd, VIDIOC_DQBUF, &buf) == 0;
+            if (ok && i < EXAMPLE_VIDEO_BUFFER_COUNT) {
+                queue_buffer(buf.index);
+            }
+        }
+        if (!ok) {
+            ESP_LOGE(TAG, "failed to receive video frame");
+            break;
+        }
+
+        ppa_srm_oper_config_t srm_config = {
+            .in             = {.buffer         = camera->buffer[buf.index],
+                               .pic_w          = camera->width,
+                               .pic_h          = camera->height,
+                               .block_w        = camera->width,
+                               .block_h        = camera->height,
+                               .block_offset_x = 0,
+                               .block_offset_y = 0,
+                               .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
+            .out            = {.buffer         = frame.data(),
+                               .buffer_size    = (uint32_t)frame.size(),
+                               .pic_w          = width,
+                               .pic_h          = height,
+                               .block_offset_x = 0,
+                               .block_offset_y = 0,
+                               .srm_cm         = PPA_SRM_COLOR_MODE_RGB565},
+            .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
+            .scale_x        = scale,
+            .scale_y        = scale,
+            .mirror_x       = false,
+            .mirror_y       = false,
+            .rgb_swap       = false,
+            .byte_swap      = false,
+            .mode           = PPA_TRANS_MODE_BLOCKING};
+        esp_err_t scaled = ppa_do_scale_rotate_mirror(ppa_srm_handle, &srm_config);
+        queue_buffer(buf.index);
+
+        if (scaled == ESP_OK) {
+            dl::image::img_t img = {
+                .data     = frame.data(),
+                .width    = width,
+                .height   = height,
+                .pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB565,
+            };
+            bool seen   = !detector->run(img).empty();
+            int64_t now = esp_timer_get_time();
+            if (seen) {
+                seenAt = now;
+            }
+            if (seen != present && (seen || now - seenAt >= PRESENCE_LOST_MS * 1000LL)) {
+                present = seen;
+                mclog::tagInfo(TAG, "Presence: {}", present ? "someone's there" : "nobody for a while");
+                hal_post_event(hal::HalBase::EVENT_PRESENCE, present);
+            }
+            // The model's tensors are only all there after its first run
+            size_t used = psram_free - std::min(psram_free, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+            if (used > PRESENCE_PSRAM_BUDGET && !overBudget) {
+                mclog::tagWarn(TAG, "Presence: {} KB of PSRAM, over the {} KB budget", used / 1024,
+                               PRESENCE_PSRAM_BUDGET / 1024);
+            }
+            overBudget = used > PRESENCE_PSRAM_BUDGET;
+        }
+
+        int64_t now = esp_timer_get_time();
+        busyUs += now - start;
+        if (now - reportStart >= PRESENCE_REPORT_MS * 1000LL) {
+            mclog::tagInfo(TAG, "Presence: {:.1f}% of a core", 100.0f * busyUs / (now - reportStart));
+            reportStart = now;
+            busyUs      = 0;
+        }
+        int64_t leftMs = PRESENCE_INTERVAL_MS - (now - start) / 1000;
+        if (leftMs > 0 && s_presence.running.load()) {
+            vTaskDelay(pdMS_TO_TICKS(leftMs));
+        }
+    }
+
+    detector.reset();
+    ppa_unregister_client(ppa_srm_handle);
+    frame.free();
+    mclog::tagInfo(TAG, "Presence task ended, {} B stack left", task_topology::stack_headroom());
+}
+
+// s_presence.mutex held
+static bool presence_start_locked()
+{
+    if (s_presence.running.load()) {
+        return true;
+    }
+    // A run that gave up by itself may still be on its way out
+    s_presence.task.join(200);
+    s_presence.running = true;
+    if (!s_presence.task.start(task_topology::PRESENCE, presence_task, nullptr)) {
+        s_presence.running = false;
+        return false;
+    }
+    return true;
+}
+
+// The preview takes the sensor over, the detector lets go of it first
+static void presence_pause()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_presence.mutex);
+        s_presence.running = false;
+    }
+    s_presence.task.join(PRESENCE_INTERVAL_MS + 1000);  // The wait between detections and a detection
+}
+
+// The preview is done with the sensor
+static void presence_resume()
+{
+    std::lock_guard<std::mutex> lock(s_presence.mutex);
+    if (s_presence.wanted) {
+        presence_start_locked();
+    }
+}
+
+bool HalEsp32::startPresenceDetection()
+{
+    std::lock_guard<std::mutex> lock(s_presence.mutex);
+    s_presence.wanted = true;
+    {
+        std::lock_guard<std::mutex> camera_lock(camera_mutex);
+        if (is_camera_capturing) {
+            return true;  // Once the preview is done
+        }
+    }
+    s_presence.wanted = presence_start_locked();
+    return s_presence.wanted;
 }
 
-void HalEsp32::startCameraCapture(lv_obj_t* imgCanvas)
+void HalEsp32::stopPresenceDetection()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_presence.mutex);
+        s_presence.wanted = false;
+    }
+    presence_pause();
+}
+
+bool HalEsp32::isPresenceDetectionRunning()
+{
+    std::lock_guard<std::mutex> lock(s_presence.mutex);
+    return s_presence.wanted;
+}
+
+void HalEsp32::startCameraCapture(lv_obj_t* imgCanvas, int width, int height)
 {
     mclog::tagInfo(TAG, "start camera capture");
+    // The last capture is past its last LVGL lock once it's no longer capturing, the join is its way out
+    bool joined = s_camera_task.join(CAMERA_JOIN_MS);
+    {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+        if (!joined || is_camera_capturing) {
+            mclog::tagWarn(TAG, "camera still capturing");
+            return;
+        }
+    }
+    presence_pause();
 
     camera_canvas = imgCanvas;
 
-    queue_camera_ctrl = xQueueCreate(10, sizeof(int));
+    if (queue_camera_ctrl == NULL) {
+        queue_camera_ctrl = xQueueCreate(10, sizeof(int));
+    }
     if (queue_camera_ctrl == NULL) {
         ESP_LOGD(TAG, "Failed to create semaphore\n");
+        presence_resume();
+        return;
     }
+    xQueueReset(queue_camera_ctrl);  // Requests the last capture didn't get to
 
-    is_camera_capturing = true;
-    xTaskCreatePinnedToCore(app_camera_display, "cam", 8 * 1024, NULL, 5, NULL, 1);
+    {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+        s_camera_request.width  = std::min(width, CAMERA_WIDTH);
+        s_camera_request.height = std::min(height, CAMERA_HEIGHT);
+        is_camera_capturing     = true;
+    }
+    if (!s_camera_task.start(task_topology::CAMERA, app_camera_display, NULL)) {
+        mclog::tagError(TAG, "no camera task");
+        camera_mutex.lock();
+        is_camera_capturing = false;
+        camera_mutex.unlock();
+        presence_resume();
+    }
 }
 
 void HalEsp32::stopCameraCapture()
 {
     mclog::tagInfo(TAG, "stop camera capture");
-
-    int control_state = 0;  // pause
-    xQueueSend(queue_camera_ctrl, &control_state, portMAX_DELAY);
-
-    control_state = 2;  // exit
-    xQueueSend(queue_camera_ctrl, &control_state, portMAX_DELAY);
+    // Not joined here: the UI calls this under the LVGL lock, which the task needs to give the canvas back. It
+    // polls isCameraCapturing() instead, and the next start joins
+    s_camera_task.cancel();
 }
 
 bool HalEsp32::isCameraCapturing()
@@ -393,3 +1252,34 @@ bool HalEsp32::isCameraCapturing()
     std::lock_guard<std::mutex> lock(camera_mutex);
     return is_camera_capturing;
 }
+
+void HalEsp32::setCameraPreviewSize(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(camera_mutex);
+    s_camera_request.width  = std::min(width, CAMERA_WIDTH);
+    s_camera_request.height = std::min(height, CAMERA_HEIGHT);
+    if (is_camera_capturing) {
+        int control_state = TASK_CONTROL_RESIZE;
+        xQueueSend(queue_camera_ctrl, &control_state, 0);
+    }
+}
+
+bool HalEsp32::requestCameraStill()
+{
+    std::lock_guard<std::mutex> lock(camera_mutex);
+    int control_state = TASK_CONTROL_STILL;
+    return is_camera_capturing && xQueueSend(queue_camera_ctrl, &control_state, 0) == pdPASS;
+}
+
+bool HalEsp32::takeCameraStill(std::vector<uint16_t>& pixels, int* width, int* height)
+{
+    std::lock_guard<std::mutex> lock(camera_mutex);
+    if (s_camera_request.still.empty()) {
+        return false;
+    }
+    pixels  = std::move(s_camera_request.still);
+    *width  = s_camera_request.stillWidth;
+    *height = s_camera_request.stillHeight;
+    s_camera_request.still.clear();
+    return true;
+}
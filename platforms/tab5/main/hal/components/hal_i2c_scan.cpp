@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <bsp/m5stack_tab5.h>
+#include <driver/i2c_master.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char* TAG = "i2c-scan";
+
+/* -------------------------------------------------------------------------- */
+/*                                  I2C Scan                                  */
+/* -------------------------------------------------------------------------- */
+// A low priority task probes a bus when asked and keeps the map it found, the UI only ever reads the maps. The
+// internal bus is shared, it's probed a row of 16 addresses per turn on it (utils/i2c_arbiter) and touch can cut in
+// between probes. A probe nobody ACKs is over in a few bit times, the short timeout is for a bus something holds low
+#define I2C_SCAN_FIRST        0x10
+#define I2C_SCAN_LAST         0x7F
+#define I2C_SCAN_ROW          16
+#define I2C_SCAN_TIMEOUT_MS   10
+#define I2C_SCAN_SETTLE_MS    100  // After EXT 5V comes on, before what's on Port A answers
+#define I2C_SCAN_INTERNAL     (1 << 0)
+#define I2C_SCAN_PORT_A       (1 << 1)
+#define I2C_SCAN_PORT_A_POWER (1 << 2)
+
+static struct {
+    std::mutex mutex;  // Everything below but the bus
+    std::mutex portA;  // Port A's bus, held while it's probed and while it's set up or taken down
+    int portAUsers    = 0;
+    TaskHandle_t task = nullptr;
+    bool scanned[2]   = {};  // [Port A, internal]
+    std::vector<uint8_t> devices[2];
+} s_i2c_scan;
+
+static std::vector<uint8_t> probe_bus(i2c_master_bus_handle_t bus, bool isInternal)
+{
+    std::vector<uint8_t> found;
+    for (int row = I2C_SCAN_FIRST; row <= I2C_SCAN_LAST; row += I2C_SCAN_ROW) {
+        std::optional<I2cArbiter::Hold> hold;
+        if (isInternal) {
+            hold.emplace(i2c_arbiter(), I2cArbiter::SCAN);
+        }
+        for (int address = row; address < row + I2C_SCAN_ROW && address <= I2C_SCAN_LAST; address++) {
+            if (i2c_master_probe(bus, address, I2C_SCAN_TIMEOUT_MS) == ESP_OK) {
+                found.push_back(address);
+            }
+            if (hold) {
+                hold->yield();
+            }
+        }
+    }
+    return found;
+}
+
+static std::vector<uint8_t> probe_port_a()
+{
+    std::lock_guard<std::mutex> lock(s_i2c_scan.portA);
+    // Without EXT 5V nothing out there pulls the lines up, every probe would time out
+    if (s_i2c_scan.portAUsers == 0 || !GetHAL()->getExt5vEnable()) {
+        return {};
+    }
+    return probe_bus(bsp_ext_i2c_get_handle(), false);
+}
+
+static void publish(bool isInternal, std::vector<uint8_t> found)
+{
+    mclog::tagInfo(TAG, "{}: {} devices", isInternal ? "internal" : "port a", found.size());
+    {
+        std::lock_guard<std::mutex> lock(s_i2c_scan.mutex);
+        s_i2c_scan.devices[isInternal] = std::move(found);
+        s_i2c_scan.scanned[isInternal] = true;
+    }
+    hal_post_event(hal::HalBase::EVENT_I2C_SCAN, isInternal);
+}
+
+static void i2c_scan_task(void* param)
+{
+    while (true) {
+        // Requests while a scan runs pile up in the bits, each bus is then scanned once more
+        uint32_t buses = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &buses, portMAX_DELAY);
+        if (buses & I2C_SCAN_INTERNAL) {
+            publish(true, probe_bus(bsp_i2c_get_handle(), true));
+        }
+        if (buses & I2C_SCAN_PORT_A_POWER) {
+            vTaskDelay(pdMS_TO_TICKS(I2C_SCAN_SETTLE_MS));
+        }
+        if (buses & (I2C_SCAN_PORT_A | I2C_SCAN_PORT_A_POWER)) {
+            publish(false, probe_port_a());
+        }
+    }
+}
+
+static bool request_scan(uint32_t buses)
+{
+    std::lock_guard<std::mutex> lock(s_i2c_scan.mutex);
+    if (!s_i2c_scan.task &&
+        task_topology::create(task_topology::I2C_SCAN, i2c_scan_task, nullptr, &s_i2c_scan.task) != pdPASS) {
+        s_i2c_scan.task = nullptr;
+        mclog::tagError(TAG, "Can't start the scan task");
+        return false;
+    }
+    xTaskNotify(s_i2c_scan.task, buses, eSetBits);
+    return true;
+}
+
+bool HalEsp32::startI2cScan(bool isInternal)
+{
+    return request_scan(isInternal ? I2C_SCAN_INTERNAL : I2C_SCAN_PORT_A);
+}
+
+bool HalEsp32::getI2cDevices(bool isInternal, std::vector<uint8_t>* addrs)
+{
+    std::lock_guard<std::mutex> lock(s_i2c_scan.mutex);
+    *addrs = s_i2c_scan.devices[isInternal];
+    return s_i2c_scan.scanned[isInternal];
+}
+
+std::vector<uint8_t> HalEsp32::i2cScan(bool isInternal)
+{
+    return isInternal ? probe_bus(bsp_i2c_get_handle(), true) : probe_port_a();
+}
+
+void i2c_scan_port_a_power_changed()
+{
+    bool up;
+    {
+        std::lock_guard<std::mutex> lock(s_i2c_scan.portA);
+        up = s_i2c_scan.portAUsers > 0;
+    }
+    if (up) {
+        request_scan(I2C_SCAN_PORT_A_POWER);
+    }
+}
+
+bool port_a_acquire()
+{
+    std::lock_guard<std::mutex> lock(s_i2c_scan.portA);
+    if (s_i2c_scan.portAUsers == 0 && bsp_ext_i2c_init() != ESP_OK) {
+        return false;
+    }
+    s_i2c_scan.portAUsers++;
+    return true;
+}
+
+void port_a_release()
+{
+    std::lock_guard<std::mutex> lock(s_i2c_scan.portA);
+    if (s_i2c_scan.portAUsers == 0 || --s_i2c_scan.portAUsers > 0) {
+        return;
+    }
+    bsp_ext_i2c_deinit();
+    // What was on the port is unknown until it's up and scanned again
+    std::lock_guard<std::mutex> maps(s_i2c_scan.mutex);
+    s_i2c_scan.scanned[false] = false;
+    s_i2c_scan.devices[false].clear();
+}
+
+void HalEsp32::initPortAI2c()
+{
+    mclog::tagInfo(TAG, "init port a i2c");
+    port_a_acquire();
+}
+
+void HalEsp32::deinitPortAI2c()
+{
+    mclog::tagInfo(TAG, "deinit port a i2c");
+    port_a_release();
+}
@@ -0,0 +1,704 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/dma_buffer/dma_buffer.h"
+#include <mooncake_log.h>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <strings.h>
+#include <lvgl.h>
+#include <src/draw/lv_draw_private.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
+#include <driver/jpeg_decode.h>
+#include <driver/ppa.h>
+
+static const char* TAG = "image";
+
+/* -------------------------------------------------------------------------- */
+/*                               JPEG Thumbnails                              */
+/* -------------------------------------------------------------------------- */
+// The hardware JPEG decoder writes whole MCUs, the PPA scales in 1/16 steps. Both want DMA-capable, cache line
+// aligned buffers (128 B for PSRAM), which are allocated per image: thumbnails are decoded once and cached by the
+// caller
+#define JPEG_MAX_SIDE      1024  // Larger pictures are refused rather than given megabytes of PSRAM
+#define JPEG_MCU_ALIGN     16
+#define JPEG_TIMEOUT_MS    200
+
+static std::mutex s_image_mutex;  // One decoder engine and PPA client, shared by every caller
+static jpeg_decoder_handle_t s_jpeg_decoder = nullptr;
+static ppa_client_handle_t s_ppa_srm        = nullptr;
+
+static bool image_engines_init()
+{
+    if (!s_jpeg_decoder) {
+        jpeg_decode_engine_cfg_t config = {};
+        config.intr_priority            = 0;
+        config.timeout_ms               = JPEG_TIMEOUT_MS;
+        if (jpeg_new_decoder_engine(&config, &s_jpeg_decoder) != ESP_OK) {
+            mclog::tagError(TAG, "Failed to create JPEG decoder");
+            s_jpeg_decoder = nullptr;
+            return false;
+        }
+    }
+    if (!s_ppa_srm) {
+        ppa_client_config_t config   = {};
+        config.oper_type             = PPA_OPERATION_SRM;
+        config.max_pending_trans_num = 1;
+        if (ppa_register_client(&config, &s_ppa_srm) != ESP_OK) {
+            mclog::tagError(TAG, "Failed to register PPA client");
+            s_ppa_srm = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t align_up(size_t value, size_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+// Whole MCUs into `out`, the picture's width and height rounded up to JPEG_MCU_ALIGN
+static bool jpeg_decode_rgb565(const uint8_t* in, size_t len, uint8_t* out, size_t out_size)
+{
+    // BGR element order is what LVGL's RGB565 reads as RGB
+    jpeg_decode_cfg_t decode = {};
+    decode.output_format     = JPEG_DECODE_OUT_FORMAT_RGB565;
+    decode.rgb_order         = JPEG_DEC_RGB_ELEMENT_ORDER_BGR;
+    decode.conv_std          = JPEG_YUV_RGB_CONV_STD_BT601;
+
+    uint32_t written = 0;
+    return jpeg_decoder_process(s_jpeg_decoder, &decode, in, len, out, out_size, &written) == ESP_OK;
+}
+
+bool HalEsp32::decodeJpegThumbnail(const uint8_t* data, size_t len, int size, uint16_t* pixels)
+{
+    std::lock_guard<std::mutex> lock(s_image_mutex);
+    if (!image_engines_init()) {
+        return false;
+    }
+
+    jpeg_decode_picture_info_t info = {};
+    if (jpeg_decoder_get_info(data, len, &info) != ESP_OK || info.width == 0 || info.height == 0 ||
+        info.width > JPEG_MAX_SIDE || info.height > JPEG_MAX_SIDE) {
+        mclog::tagWarn(TAG, "Not a JPEG the decoder takes ({}x{})", info.width, info.height);
+        return false;
+    }
+
+    // The decoder's buffers come from its own allocator, which knows its alignment rules
+    uint32_t stride    = align_up(info.width, JPEG_MCU_ALIGN);
+    uint32_t rows      = align_up(info.height, JPEG_MCU_ALIGN);
+    size_t in_size     = 0;
+    size_t decode_size = 0;
+
+    jpeg_decode_memory_alloc_cfg_t in_cfg  = {.buffer_direction = JPEG_DEC_ALLOC_INPUT_BUFFER};
+    jpeg_decode_memory_alloc_cfg_t out_cfg = {.buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER};
+
+    uint8_t* in      = (uint8_t*)jpeg_alloc_decoder_mem(len, &in_cfg, &in_size);
+    uint8_t* decoded = (uint8_t*)jpeg_alloc_decoder_mem((size_t)stride * rows * 2, &out_cfg, &decode_size);
+    DmaBuffer scaled;
+    scaled.alloc((size_t)size * size * 2, MALLOC_CAP_SPIRAM);
+
+    bool ok = in && decoded && scaled;
+    if (ok) {
+        memcpy(in, data, len);
+        ok = jpeg_decode_rgb565(in, len, decoded, decode_size);
+    }
+
+    if (ok) {
+        // Centre square of the picture, scaled by the largest 1/16 step that fits, centred in the thumbnail
+        uint32_t side  = std::min(info.width, info.height);
+        float scale    = std::max(1.0f, floorf(size * 16.0f / side)) / 16.0f;
+        uint32_t fit   = std::min((uint32_t)(side * scale), (uint32_t)size);
+        uint32_t inset = (size - fit) / 2;
+
+        ppa_srm_oper_config_t srm = {};
+        srm.in.buffer             = decoded;
+        srm.in.pic_w              = stride;
+        srm.in.pic_h              = rows;
+        srm.in.block_w            = side;
+        srm.in.block_h            = side;
+        srm.in.block_offset_x     = (info.width - side) / 2;
+        srm.in.block_offset_y     = (info.height - side) / 2;
+        srm.in.srm_cm             = PPA_SRM_COLOR_MODE_RGB565;
+        srm.out.buffer            = scaled.data();
+        srm.out.buffer_size       = scaled.size();
+        srm.out.pic_w             = size;
+        srm.out.pic_h             = size;
+        srm.out.block_offset_x    = inset;
+        srm.out.block_offset_y    = inset;
+        srm.out.srm_cm            = PPA_SRM_COLOR_MODE_RGB565;
+        srm.rotation_angle        = PPA_SRM_ROTATION_ANGLE_0;
+        srm.scale_x               = scale;
+        srm.scale_y               = scale;
+        srm.mode                  = PPA_TRANS_MODE_BLOCKING;
+
+        ok = ppa_do_scale_rotate_mirror(s_ppa_srm, &srm) == ESP_OK;
+    }
+
+    if (ok) {
+        memcpy(pixels, scaled.data(), (size_t)size * size * 2);  // The PPA driver invalidates its output
+    } else {
+        mclog::tagWarn(TAG, "JPEG thumbnail failed");
+    }
+
+    free(in);
+    free(decoded);
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                             LVGL image decoder                             */
+/* -------------------------------------------------------------------------- */
+// JPEGs as image sources for any lv_image: a file path ending in .jpg or .jpeg, or an lv_image_dsc_t of
+// LV_COLOR_FORMAT_RAW holding the file. The engine decodes them whole into RGB565, the rows are copied out of its
+// MCU padded buffer into a draw buffer from LVGL's heap, and that goes into LVGL's image cache: an image shown again
+// isn't decoded again while it's cached. Only baseline JPEGs, what the engine takes; LVGL tries its other decoders
+// for the rest.
+#define JPEG_IMAGE_MAX_SIDE 2048
+
+static bool is_jpeg_path(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    return ext && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0);
+}
+
+static const lv_image_dsc_t* jpeg_variable(const lv_image_decoder_dsc_t* dsc)
+{
+    auto image = static_cast<const lv_image_dsc_t*>(dsc->src);
+    if (image->header.cf != LV_COLOR_FORMAT_RAW || image->data_size < 4 || image->data[0] != 0xFF ||
+        image->data[1] != 0xD8) {
+        return nullptr;
+    }
+    return image;
+}
+
+// Walks the markers up to the frame header, only that much of the file is read
+static bool jpeg_file_size(lv_fs_file_t* file, uint32_t* width, uint32_t* height)
+{
+    uint8_t b[5];
+    uint32_t n = 0;
+    if (lv_fs_read(file, b, 2, &n) != LV_FS_RES_OK || n != 2 || b[0] != 0xFF || b[1] != 0xD8) {
+        return false;
+    }
+    for (int segment = 0; segment < 64; segment++) {
+        if (lv_fs_read(file, b, 4, &n) != LV_FS_RES_OK || n != 4 || b[0] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = b[1];
+        uint32_t len   = b[2] << 8 | b[3];
+        if (marker == 0xC0) {
+            // Baseline frame: precision, then height and width
+            if (lv_fs_read(file, b, 5, &n) != LV_FS_RES_OK || n != 5) {
+                return false;
+            }
+            *height = b[1] << 8 | b[2];
+            *width  = b[3] << 8 | b[4];
+            return *width > 0 && *height > 0;
+        }
+        // Any other frame type, or the scan before a frame
+        bool frame = marker >= 0xC1 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (frame || marker == 0xDA || marker == 0xD9 || len < 2 ||
+            lv_fs_seek(file, len - 2, LV_FS_SEEK_CUR) != LV_FS_RES_OK) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static lv_result_t jpeg_decoder_info(lv_image_decoder_t* decoder, lv_image_decoder_dsc_t* dsc,
+                                     lv_image_header_t* header)
+{
+    uint32_t width  = 0;
+    uint32_t height = 0;
+    if (dsc->src_type == LV_IMAGE_SRC_VARIABLE) {
+        auto image = jpeg_variable(dsc);
+        if (!image) {
+            return LV_RESULT_INVALID;
+        }
+        jpeg_decode_picture_info_t info = {};
+        if (jpeg_decoder_get_info(image->data, image->data_size, &info) != ESP_OK) {
+            return LV_RESULT_INVALID;
+        }
+        width  = info.width;
+        height = info.height;
+    } else if (dsc->src_type == LV_IMAGE_SRC_FILE) {
+        if (!is_jpeg_path(static_cast<const char*>(dsc->src)) || !jpeg_file_size(&dsc->file, &width, &height)) {
+            return LV_RESULT_INVALID;
+        }
+    } else {
+        return LV_RESULT_INVALID;
+    }
+    if (width == 0 || height == 0 || width > JPEG_IMAGE_MAX_SIDE || height > JPEG_IMAGE_MAX_SIDE) {
+        return LV_RESULT_INVALID;
+    }
+
+    header->cf     = LV_COLOR_FORMAT_RGB565;
+    header->w      = width;
+    header->h      = height;
+    header->stride = lv_draw_buf_width_to_stride(width, LV_COLOR_FORMAT_RGB565);
+    return LV_RESULT_OK;
+}
+
+// The compressed picture in a buffer the engine can read from, the file read straight into it
+static uint8_t* jpeg_load(lv_image_decoder_dsc_t* dsc, size_t* len)
+{
+    jpeg_decode_memory_alloc_cfg_t in_cfg = {.buffer_direction = JPEG_DEC_ALLOC_INPUT_BUFFER};
+    size_t in_size                        = 0;
+    if (dsc->src_type == LV_IMAGE_SRC_VARIABLE) {
+        auto image = jpeg_variable(dsc);
+        *len       = image->data_size;
+        auto in    = (uint8_t*)jpeg_alloc_decoder_mem(*len, &in_cfg, &in_size);
+        if (in) {
+            memcpy(in, image->data, *len);
+        }
+        return in;
+    }
+
+    uint32_t end = 0;
+    if (lv_fs_seek(&dsc->file, 0, LV_FS_SEEK_END) != LV_FS_RES_OK || lv_fs_tell(&dsc->file, &end) != LV_FS_RES_OK ||
+        lv_fs_seek(&dsc->file, 0, LV_FS_SEEK_SET) != LV_FS_RES_OK || end == 0) {
+        return nullptr;
+    }
+    *len    = end;
+    auto in = (uint8_t*)jpeg_alloc_decoder_mem(*len, &in_cfg, &in_size);
+    if (!in) {
+        return nullptr;
+    }
+    uint32_t n = 0;
+    if (lv_fs_read(&dsc->file, in, *len, &n) != LV_FS_RES_OK || n != *len) {
+        free(in);
+        return nullptr;
+    }
+    return in;
+}
+
+static lv_result_t jpeg_decoder_open(lv_image_decoder_t* decoder, lv_image_decoder_dsc_t* dsc)
+{
+    uint32_t width  = dsc->header.w;
+    uint32_t height = dsc->header.h;
+    uint32_t stride = align_up(width, JPEG_MCU_ALIGN);
+    uint32_t rows   = align_up(height, JPEG_MCU_ALIGN);
+
+    lv_draw_buf_t* decoded = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_image_mutex);
+        if (!image_engines_init()) {
+            return LV_RESULT_INVALID;
+        }
+
+        size_t len                             = 0;
+        size_t out_size                        = 0;
+        jpeg_decode_memory_alloc_cfg_t out_cfg = {.buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER};
+        uint8_t* in                            = jpeg_load(dsc, &len);
+        uint8_t* out = (uint8_t*)jpeg_alloc_decoder_mem((size_t)stride * rows * 2, &out_cfg, &out_size);
+        if (in && out && jpeg_decode_rgb565(in, len, out, out_size)) {
+            decoded = lv_draw_buf_create(width, height, LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+        }
+        if (decoded) {
+            // The engine's output is cache line aligned and padded to whole MCUs, LVGL's buffer is neither
+            for (uint32_t y = 0; y < height; y++) {
+                memcpy(lv_draw_buf_goto_xy(decoded, 0, y), out + (size_t)y * stride * 2, width * 2);
+            }
+        } else {
+            mclog::tagWarn(TAG, "JPEG image {}x{} not decoded", width, height);
+        }
+        free(in);
+        free(out);
+    }
+    if (!decoded) {
+        return LV_RESULT_INVALID;
+    }
+
+    lv_draw_buf_t* adjusted = lv_image_decoder_post_process(dsc, decoded);
+    if (!adjusted) {
+        lv_draw_buf_destroy(decoded);
+        return LV_RESULT_INVALID;
+    }
+    if (adjusted != decoded) {
+        lv_draw_buf_destroy(decoded);
+        decoded = adjusted;
+    }
+    dsc->decoded = decoded;
+
+    if (dsc->args.no_cache || !lv_image_cache_is_enabled()) {
+        return LV_RESULT_OK;
+    }
+    lv_image_cache_data_t search_key;
+    search_key.src_type     = dsc->src_type;
+    search_key.src          = dsc->src;
+    search_key.slot.size    = decoded->data_size;
+    lv_cache_entry_t* entry = lv_image_decoder_add_to_cache(decoder, &search_key, decoded, nullptr);
+    if (!entry) {
+        lv_draw_buf_destroy(decoded);
+        return LV_RESULT_INVALID;
+    }
+    dsc->cache_entry = entry;
+    return LV_RESULT_OK;
+}
+
+static void jpeg_decoder_close(lv_image_decoder_t* decoder, lv_image_decoder_dsc_t* dsc)
+{
+    // A cached one is the cache's to free
+    if (dsc->args.no_cache || !lv_image_cache_is_enabled()) {
+        lv_draw_buf_destroy((lv_draw_buf_t*)dsc->decoded);
+    }
+}
+
+void jpeg_image_decoder_init()
+{
+    lv_image_decoder_t* decoder = lv_image_decoder_create();
+    lv_image_decoder_set_info_cb(decoder, jpeg_decoder_info);
+    lv_image_decoder_set_open_cb(decoder, jpeg_decoder_open);
+    lv_image_decoder_set_close_cb(decoder, jpeg_decoder_close);
+    decoder->name = "JPEG_HW";
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              LVGL PPA draw unit                            */
+/* -------------------------------------------------------------------------- */
+// The PPA fills, blends and scales rectangles by DMA, which LVGL's software renderer does pixel by pixel on the
+// CPU. This draw unit takes LVGL's large plain draw tasks off it: opaque fills (the straight middle of a rounded
+// one, its corners are still drawn in software), images copied or scaled by whole 1/16 steps without blending, and
+// images blended onto the layer unscaled with their alpha and opacity. Anything else, and anything smaller than
+// PPA_DRAW_MIN_PIXELS, stays with the software units.
+//
+// The PPA writes back and invalidates the layer's cache lines around its window, and a row of the window shares
+// lines with pixels a software unit may be drawing beside it. So a task only starts on a layer with nothing else
+// in progress, and runs in LVGL's dispatch: no other task starts on the layer meanwhile, and the CPU waits on the
+// PPA's interrupt instead of drawing.
+#define PPA_DRAW_UNIT_ID    16
+#define PPA_DRAW_SCORE      70         // LVGL's software units score 100, lower is preferred
+#define PPA_DRAW_MIN_PIXELS (64 * 64)  // Quicker done in software than a transaction is set up
+#define PPA_BUFFER_ALIGN    128        // The PPA writes whole cache lines, of PSRAM's size
+
+#if CONFIG_TAB5_LVGL_PPA_DRAW
+static ppa_client_handle_t s_draw_fill  = nullptr;
+static ppa_client_handle_t s_draw_blend = nullptr;
+static ppa_client_handle_t s_draw_srm   = nullptr;
+
+static bool opaque_format(lv_color_format_t cf)
+{
+    return cf == LV_COLOR_FORMAT_RGB565 || cf == LV_COLOR_FORMAT_RGB888 || cf == LV_COLOR_FORMAT_XRGB8888;
+}
+
+// The PPA's color modes share their values across fill, blend and SRM
+static bool ppa_color_mode(lv_color_format_t cf, ppa_srm_color_mode_t* mode)
+{
+    switch (cf) {
+        case LV_COLOR_FORMAT_RGB565:
+            *mode = PPA_SRM_COLOR_MODE_RGB565;
+            return true;
+        case LV_COLOR_FORMAT_RGB888:
+            *mode = PPA_SRM_COLOR_MODE_RGB888;
+            return true;
+        case LV_COLOR_FORMAT_ARGB8888:
+        case LV_COLOR_FORMAT_XRGB8888:
+            *mode = PPA_SRM_COLOR_MODE_ARGB8888;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Where an unrotated image with `dsc`'s scale lands, its pixels scaled around the pivot
+static lv_area_t scaled_area(const lv_draw_image_dsc_t* dsc, const lv_area_t* coords)
+{
+    int32_t w  = lv_area_get_width(coords);
+    int32_t h  = lv_area_get_height(coords);
+    int32_t x1 = coords->x1 + dsc->pivot.x - dsc->pivot.x * dsc->scale_x / LV_SCALE_NONE;
+    int32_t y1 = coords->y1 + dsc->pivot.y - dsc->pivot.y * dsc->scale_y / LV_SCALE_NONE;
+    return {x1, y1, x1 + w * dsc->scale_x / LV_SCALE_NONE - 1, y1 + h * dsc->scale_y / LV_SCALE_NONE - 1};
+}
+
+// Internal SRAM or PSRAM, not an image in flash
+static bool dma_readable(const void* data)
+{
+    return esp_ptr_dma_capable(data) || esp_ptr_dma_ext_capable(data);
+}
+
+static bool scaled(const lv_draw_image_dsc_t* dsc)
+{
+    return dsc->scale_x != LV_SCALE_NONE || dsc->scale_y != LV_SCALE_NONE;
+}
+
+// The straight band of a rounded rectangle, between its corners
+static lv_area_t fill_middle(const lv_draw_fill_dsc_t* dsc, const lv_area_t* coords)
+{
+    int32_t side   = std::min(lv_area_get_width(coords), lv_area_get_height(coords));
+    int32_t r      = std::min<int32_t>(dsc->radius, side / 2);
+    lv_area_t band = *coords;
+    band.y1 += r;
+    band.y2 -= r;
+    return band;
+}
+
+static bool ppa_fill_takes(const lv_draw_task_t* t)
+{
+    auto dsc = static_cast<const lv_draw_fill_dsc_t*>(t->draw_dsc);
+    if (dsc->opa < LV_OPA_MAX || dsc->grad.dir != LV_GRAD_DIR_NONE) {
+        return false;
+    }
+    lv_area_t band    = fill_middle(dsc, &t->area);
+    lv_area_t visible = {};
+    return lv_area_intersect(&visible, &band, &t->clip_area) && lv_area_get_size(&visible) >= PPA_DRAW_MIN_PIXELS;
+}
+
+static bool ppa_image_takes(const lv_draw_task_t* t)
+{
+    auto dsc = static_cast<const lv_draw_image_dsc_t*>(t->draw_dsc);
+    if (dsc->rotation != 0 || dsc->skew_x != 0 || dsc->skew_y != 0 || dsc->tile || dsc->clip_radius != 0 ||
+        dsc->bitmap_mask_src || dsc->recolor_opa > LV_OPA_MIN || dsc->blend_mode != LV_BLEND_MODE_NORMAL ||
+        (dsc->header.flags & LV_IMAGE_FLAGS_COMPRESSED)) {
+        return false;
+    }
+    ppa_srm_color_mode_t mode;
+    if (!ppa_color_mode((lv_color_format_t)dsc->header.cf, &mode)) {
+        return false;
+    }
+    lv_area_t visible = {};
+    if (!scaled(dsc)) {
+        return lv_area_intersect(&visible, &t->area, &t->clip_area) &&
+               lv_area_get_size(&visible) >= PPA_DRAW_MIN_PIXELS;
+    }
+
+    // The engine scales by 1/16 steps, from 1/16 to 16, and copies: opaque images in full view only
+    bool steps = dsc->scale_x % 16 == 0 && dsc->scale_y % 16 == 0 && dsc->scale_x >= 16 && dsc->scale_y >= 16 &&
+                 dsc->scale_x <= 16 * LV_SCALE_NONE && dsc->scale_y <= 16 * LV_SCALE_NONE;
+    if (!steps || !opaque_format((lv_color_format_t)dsc->header.cf) || dsc->opa < LV_OPA_MAX) {
+        return false;
+    }
+    lv_area_t target = scaled_area(dsc, &t->area);
+    return lv_area_is_in(&target, &t->clip_area, 0) && lv_area_get_size(&target) >= PPA_DRAW_MIN_PIXELS;
+}
+
+static int32_t ppa_draw_evaluate(lv_draw_unit_t* unit, lv_draw_task_t* t)
+{
+    bool takes = false;
+    if (t->type == LV_DRAW_TASK_TYPE_FILL) {
+        takes = ppa_fill_takes(t);
+    } else if (t->type == LV_DRAW_TASK_TYPE_IMAGE) {
+        takes = ppa_image_takes(t);
+    }
+    if (takes && t->preference_score > PPA_DRAW_SCORE) {
+        t->preference_score       = PPA_DRAW_SCORE;
+        t->preferred_draw_unit_id = PPA_DRAW_UNIT_ID;
+    }
+    return 0;
+}
+
+// The layer's buffer as the PPA's output picture, if the engine can write it
+static bool ppa_layer_out(lv_layer_t* layer, ppa_out_pic_blk_config_t* out)
+{
+    lv_draw_buf_t* buf = layer->draw_buf;
+    ppa_srm_color_mode_t mode;
+    uint32_t bpp = lv_color_format_get_size(layer->color_format);
+    if (!buf || !ppa_color_mode(layer->color_format, &mode) || buf->header.stride % bpp != 0 ||
+        ((uintptr_t)buf->data & (PPA_BUFFER_ALIGN - 1)) != 0 || !dma_readable(buf->data)) {
+        return false;
+    }
+    out->buffer      = buf->data;
+    out->buffer_size = buf->data_size & ~(PPA_BUFFER_ALIGN - 1);
+    out->pic_w       = buf->header.stride / bpp;
+    out->pic_h       = buf->header.h;
+    out->srm_cm      = mode;
+    return (size_t)buf->header.stride * buf->header.h <= out->buffer_size;
+}
+
+static bool ppa_draw_fill(lv_layer_t* layer, const lv_draw_fill_dsc_t* dsc, const lv_area_t* area)
+{
+    ppa_fill_oper_config_t fill = {};
+    if (!ppa_layer_out(layer, &fill.out)) {
+        return false;
+    }
+    fill.out.block_offset_x = area->x1 - layer->buf_area.x1;
+    fill.out.block_offset_y = area->y1 - layer->buf_area.y1;
+    fill.fill_block_w       = lv_area_get_width(area);
+    fill.fill_block_h       = lv_area_get_height(area);
+    fill.fill_argb_color.a  = 0xFF;
+    fill.fill_argb_color.r  = dsc->color.red;
+    fill.fill_argb_color.g  = dsc->color.green;
+    fill.fill_argb_color.b  = dsc->color.blue;
+    fill.mode               = PPA_TRANS_MODE_BLOCKING;
+    return ppa_do_fill(s_draw_fill, &fill) == ESP_OK;
+}
+
+static bool ppa_draw_image(lv_layer_t* layer, const lv_draw_image_dsc_t* dsc, const lv_area_t* coords,
+                           const lv_area_t* clip)
+{
+    lv_image_decoder_dsc_t decoder;
+    if (lv_image_decoder_open(&decoder, dsc->src, nullptr) != LV_RESULT_OK) {
+        return false;
+    }
+    const lv_draw_buf_t* image = decoder.decoded;
+    ppa_srm_color_mode_t in_mode;
+    uint32_t bpp = image ? lv_color_format_get_size((lv_color_format_t)image->header.cf) : 0;
+    bool ok      = image && ppa_color_mode((lv_color_format_t)image->header.cf, &in_mode) &&
+              image->header.stride % bpp == 0 && dma_readable(image->data);
+
+    ppa_out_pic_blk_config_t out = {};
+    ok                           = ok && ppa_layer_out(layer, &out);
+    // What it decoded to may not be opaque after all
+    bool blend = ok && (!opaque_format((lv_color_format_t)image->header.cf) || dsc->opa < LV_OPA_MAX);
+    ok         = ok && !(blend && (scaled(dsc) || !opaque_format(layer->color_format)));
+
+    if (ok && !blend) {
+        lv_area_t target = scaled(dsc) ? scaled_area(dsc, coords) : *coords;
+        lv_area_t visible;
+        lv_area_intersect(&visible, &target, clip);
+
+        ppa_srm_oper_config_t srm = {};
+        srm.in.buffer             = image->data;
+        srm.in.pic_w              = image->header.stride / bpp;
+        srm.in.pic_h              = image->header.h;
+        srm.in.block_w            = scaled(dsc) ? image->header.w : lv_area_get_width(&visible);
+        srm.in.block_h            = scaled(dsc) ? image->header.h : lv_area_get_height(&visible);
+        srm.in.block_offset_x     = visible.x1 - target.x1;  // 0 when scaled, those are in full view
+        srm.in.block_offset_y     = visible.y1 - target.y1;
+        srm.in.srm_cm             = in_mode;
+        srm.out                   = out;
+        srm.out.block_offset_x    = visible.x1 - layer->buf_area.x1;
+        srm.out.block_offset_y    = visible.y1 - layer->buf_area.y1;
+        srm.rotation_angle        = PPA_SRM_ROTATION_ANGLE_0;
+        srm.scale_x               = (float)dsc->scale_x / LV_SCALE_NONE;
+        srm.scale_y               = (float)dsc->scale_y / LV_SCALE_NONE;
+        srm.mode                  = PPA_TRANS_MODE_BLOCKING;
+        ok                        = ppa_do_scale_rotate_mirror(s_draw_srm, &srm) == ESP_OK;
+    } else if (ok) {
+        lv_area_t visible;
+        lv_area_intersect(&visible, coords, clip);
+
+        ppa_blend_oper_config_t blend_op = {};
+        blend_op.in_bg.buffer            = out.buffer;
+        blend_op.in_bg.pic_w             = out.pic_w;
+        blend_op.in_bg.pic_h             = out.pic_h;
+        blend_op.in_bg.block_w           = lv_area_get_width(&visible);
+        blend_op.in_bg.block_h           = lv_area_get_height(&visible);
+        blend_op.in_bg.block_offset_x    = visible.x1 - layer->buf_area.x1;
+        blend_op.in_bg.block_offset_y    = visible.y1 - layer->buf_area.y1;
+        blend_op.in_bg.blend_cm          = (ppa_blend_color_mode_t)out.srm_cm;
+        blend_op.in_fg.buffer            = image->data;
+        blend_op.in_fg.pic_w             = image->header.stride / bpp;
+        blend_op.in_fg.pic_h             = image->header.h;
+        blend_op.in_fg.block_w           = blend_op.in_bg.block_w;
+        blend_op.in_fg.block_h           = blend_op.in_bg.block_h;
+        blend_op.in_fg.block_offset_x    = visible.x1 - coords->x1;
+        blend_op.in_fg.block_offset_y    = visible.y1 - coords->y1;
+        blend_op.in_fg.blend_cm          = (ppa_blend_color_mode_t)in_mode;
+        blend_op.out                     = out;
+        blend_op.out.block_offset_x      = blend_op.in_bg.block_offset_x;
+        blend_op.out.block_offset_y      = blend_op.in_bg.block_offset_y;
+        blend_op.bg_alpha_update_mode    = PPA_ALPHA_NO_CHANGE;
+        // The image's own alpha scaled by the opacity, or the opacity for a format without alpha
+        if (image->header.cf == LV_COLOR_FORMAT_ARGB8888) {
+            blend_op.fg_alpha_update_mode = PPA_ALPHA_SCALE;
+            blend_op.fg_alpha_scale_ratio = dsc->opa / 255.0f;
+        } else {
+            blend_op.fg_alpha_update_mode = PPA_ALPHA_FIX_VALUE;
+            blend_op.fg_alpha_fix_val     = dsc->opa;
+        }
+        blend_op.mode = PPA_TRANS_MODE_BLOCKING;
+        ok            = ppa_do_blend(s_draw_blend, &blend_op) == ESP_OK;
+    }
+    lv_image_decoder_close(&decoder);
+    return ok;
+}
+
+static bool layer_busy(lv_layer_t* layer)
+{
+    for (lv_draw_task_t* t = layer->draw_task_head; t; t = t->next) {
+        if (t->state == LV_DRAW_TASK_STATE_IN_PROGRESS) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ppa_draw_task(lv_draw_unit_t* unit, lv_layer_t* layer, lv_draw_task_t* t)
+{
+    // The software renderer draws with the unit's layer and clip, what the PPA didn't
+    unit->target_layer = layer;
+    unit->clip_area    = &t->clip_area;
+
+    if (t->type == LV_DRAW_TASK_TYPE_FILL) {
+        auto dsc          = static_cast<const lv_draw_fill_dsc_t*>(t->draw_dsc);
+        lv_area_t band    = fill_middle(dsc, &t->area);
+        lv_area_t visible = {};
+        if (!lv_area_intersect(&visible, &band, &t->clip_area) || !ppa_draw_fill(layer, dsc, &visible)) {
+            lv_draw_sw_fill(unit, dsc, &t->area);
+            return;
+        }
+        // The corners, above and below the band
+        lv_area_t above = {t->clip_area.x1, t->clip_area.y1, t->clip_area.x2, visible.y1 - 1};
+        lv_area_t below = {t->clip_area.x1, visible.y2 + 1, t->clip_area.x2, t->clip_area.y2};
+        for (const lv_area_t* rest : {&above, &below}) {
+            if (rest->y1 <= rest->y2) {
+                unit->clip_area = rest;
+                lv_draw_sw_fill(unit, dsc, &t->area);
+            }
+        }
+        return;
+    }
+
+    auto dsc = static_cast<const lv_draw_image_dsc_t*>(t->draw_dsc);
+    if (!ppa_draw_image(layer, dsc, &t->area, &t->clip_area)) {
+        lv_draw_sw_image(unit, dsc, &t->area);
+    }
+}
+
+static int32_t ppa_draw_dispatch(lv_draw_unit_t* unit, lv_layer_t* layer)
+{
+    lv_draw_task_t* t = lv_draw_get_next_available_task(layer, nullptr, PPA_DRAW_UNIT_ID);
+    if (!t || t->preferred_draw_unit_id != PPA_DRAW_UNIT_ID) {
+        return LV_DRAW_UNIT_IDLE;
+    }
+    if (layer_busy(layer)) {
+        return 0;  // Asked again when the software units are done
+    }
+    if (!lv_draw_layer_alloc_buf(layer)) {
+        return LV_DRAW_UNIT_IDLE;
+    }
+
+    t->state     = LV_DRAW_TASK_STATE_IN_PROGRESS;
+    t->draw_unit = unit;
+    ppa_draw_task(unit, layer, t);
+    t->state        = LV_DRAW_TASK_STATE_READY;
+    unit->clip_area = nullptr;
+    lv_draw_dispatch_request();
+    return 1;
+}
+
+static ppa_client_handle_t ppa_draw_client(ppa_operation_t oper)
+{
+    ppa_client_config_t config   = {};
+    config.oper_type             = oper;
+    config.max_pending_trans_num = 1;
+    ppa_client_handle_t client   = nullptr;
+    if (ppa_register_client(&config, &client) != ESP_OK) {
+        return nullptr;
+    }
+    return client;
+}
+
+void ppa_draw_unit_init()
+{
+    s_draw_fill  = ppa_draw_client(PPA_OPERATION_FILL);
+    s_draw_blend = ppa_draw_client(PPA_OPERATION_BLEND);
+    s_draw_srm   = ppa_draw_client(PPA_OPERATION_SRM);
+    if (!s_draw_fill || !s_draw_blend || !s_draw_srm) {
+        mclog::tagError(TAG, "Failed to register PPA clients, LVGL draws in software only");
+        return;
+    }
+    auto unit         = static_cast<lv_draw_unit_t*>(lv_draw_create_unit(sizeof(lv_draw_unit_t)));
+    unit->evaluate_cb = ppa_draw_evaluate;
+    unit->dispatch_cb = ppa_draw_dispatch;
+}
+#else
+void ppa_draw_unit_init() {}
+#endif
@@ -4,10 +4,15 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/joinable_task/joinable_task.h"
 #include <mooncake_log.h>
 #include <vector>
 #include <driver/gpio.h>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <stdio.h>
 #include <math.h>
 #include <stdint.h>
@@ -20,9 +25,126 @@
 
 static const std::string _tag = "imu";
 
+/* -------------------------------------------------------------------------- */
+/*                                  Sampling                                  */
+/* -------------------------------------------------------------------------- */
+// The BMI270 queues its samples in its FIFO and a task on the network core takes them IMU_DRAIN_MS apart, in bursts,
+// into a ring: readers copy out of the ring and never wait on the internal I2C bus the touch, codec and RTC share.
+// INT1 only reaches the power latch for the shake wakeup, so the drain goes by the clock instead of a watermark
+// interrupt. It runs while someone reads and stops IMU_IDLE_MS after the last read
+#define IMU_RING_SAMPLES 256   // 1.28 s
+#define IMU_DRAIN_MS     100   // 20 frames a burst, the FIFO holds 170
+#define IMU_IDLE_MS      2000
+#define IMU_READ_FRAMES  64    // Per burst, a backlog takes several
+
+// Counts at the ranges accel_gyro_bmi270_enable_sensor() sets, +-4 g and +-1000 dps, to imuData's units
+static constexpr float IMU_ACCEL_SCALE = 1.0f / 8359.2f;
+static constexpr float IMU_GYRO_SCALE  = 1.0f / 327.68f;
+
+struct ImuSample_t {
+    int16_t accel[3];  // Sensor axes, counts
+    int16_t gyro[3];
+};
+
+static struct {
+    std::mutex mutex;  // ring, written
+    ImuSample_t ring[IMU_RING_SAMPLES];
+    uint32_t written = 0;  // Samples so far, the newest is at (written - 1) % IMU_RING_SAMPLES
+    std::mutex control;    // Starting and stopping the task
+    JoinableTask task;
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> lastReadMs{0};
+    bool fifo = false;               // Set up since the last bmi270_init(), which resets it
+    std::atomic<bool> ready{false};  // imu_init() done, it runs after boot has shown the UI
+} s_imu;
+
+static uint32_t imu_millis()
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+// The sensor's axes to the board's
+static hal::HalBase::IMUData_t imu_convert(const ImuSample_t& sample)
+{
+    hal::HalBase::IMUData_t data;
+    data.accelX = sample.accel[1] * IMU_ACCEL_SCALE;  // m/s^2
+    data.accelY = -sample.accel[0] * IMU_ACCEL_SCALE;
+    data.accelZ = -sample.accel[2] * IMU_ACCEL_SCALE;
+    data.gyroX  = sample.gyro[1] * IMU_GYRO_SCALE;  // °/s
+    data.gyroY  = sample.gyro[0] * IMU_GYRO_SCALE;
+    data.gyroZ  = -sample.gyro[2] * IMU_GYRO_SCALE;
+    return data;
+}
+
+static void imu_task(void* param)
+{
+    static struct bmi2_sens_axes_data accel[IMU_READ_FRAMES];
+    static struct bmi2_sens_axes_data gyro[IMU_READ_FRAMES];
+    size_t bursts  = 0;
+    size_t samples = 0;
+    while (s_imu.running.load() && imu_millis() - s_imu.lastReadMs.load() < IMU_IDLE_MS) {
+        uint16_t n;
+        do {
+            {
+                I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+                n = accel_gyro_bmi270_fifo_read(accel, gyro, IMU_READ_FRAMES);
+            }
+            std::lock_guard<std::mutex> lock(s_imu.mutex);
+            for (int i = 0; i < n; i++) {
+                s_imu.ring[s_imu.written % IMU_RING_SAMPLES] = {{accel[i].x, accel[i].y, accel[i].z},
+                                                                {gyro[i].x, gyro[i].y, gyro[i].z}};
+                s_imu.written++;
+            }
+            samples += n;
+            bursts++;
+        } while (n == IMU_READ_FRAMES);
+        vTaskDelay(pdMS_TO_TICKS(IMU_DRAIN_MS));
+    }
+    s_imu.running = false;
+    mclog::tagInfo(_tag, "Sampling stopped, {} samples in {} bursts, {} B stack left", samples, bursts,
+                   task_topology::stack_headroom());
+}
+
+// From the readers: the first read starts the drain, later ones keep it going
+static void imu_keep_sampling()
+{
+    s_imu.lastReadMs = imu_millis();
+    if (s_imu.running.load() || !s_imu.ready.load()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s_imu.control);
+    if (s_imu.running.load()) {
+        return;
+    }
+    // A run that stopped itself may still be on its way out
+    s_imu.task.join(IMU_DRAIN_MS * 2);
+    if (!s_imu.fifo) {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        s_imu.fifo = accel_gyro_bmi270_fifo_enable();
+        if (!s_imu.fifo) {
+            return;
+        }
+    }
+    s_imu.running = true;
+    if (!s_imu.task.start(task_topology::IMU, imu_task, nullptr)) {
+        s_imu.running = false;
+    }
+}
+
+// Before anything else talks to the BMI270
+static void imu_stop_sampling()
+{
+    std::lock_guard<std::mutex> lock(s_imu.control);
+    s_imu.running = false;
+    s_imu.task.join(IMU_DRAIN_MS * 2);
+}
+
 void HalEsp32::clearImuIrq()
 {
     mclog::tagInfo(_tag, "clear imu irq");
+    imu_stop_sampling();
+    s_imu.fifo = false;
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
     accel_gyro_bmi270_init(bsp_i2c_get_handle());
     if (accel_gyro_bmi270_check_irq()) {
         accel_gyro_bmi270_clear_irq_int();
@@ -34,26 +156,36 @@ void HalEsp32::imu_init()
 {
     mclog::tagInfo(_tag, "imu init");
 
+    // The config upload is 8 KB on the bus, nothing else on it may cut in
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
     accel_gyro_bmi270_init(bsp_i2c_get_handle());
     if (accel_gyro_bmi270_check_irq()) {
         accel_gyro_bmi270_clear_irq_int();
         mclog::tagInfo(_tag, "imu irq detected! clear it!");
     }
     accel_gyro_bmi270_enable_sensor();
+    s_imu.ready = true;
 }
 
 void HalEsp32::updateImuData()
 {
-    static struct bmi2_sens_data bmi_sensor_data;
-    accel_gyro_bmi270_get_data(&bmi_sensor_data);
-
-    /* 根据设置量程转换 */
-    imuData.accelX = bmi_sensor_data.acc.y / 835.92 / 10.0f;  // m/s^2
-    imuData.accelY = -bmi_sensor_data.acc.x / 835.92 / 10.0f;
-    imuData.accelZ = -bmi_sensor_data.acc.z / 835.92 / 10.0f;
-    imuData.gyroX  = bmi_sensor_data.gyr.y / 32.768 / 10.0f;  // °/s   gyro_raw*2*1000/2^16 --> 0.0305
-    imuData.gyroY  = bmi_sensor_data.gyr.x / 32.768 / 10.0f;
-    imuData.gyroZ  = -bmi_sensor_data.gyr.z / 32.768 / 10.0f;
+    imu_keep_sampling();
+    std::lock_guard<std::mutex> lock(s_imu.mutex);
+    if (s_imu.written > 0) {
+        imuData = imu_convert(s_imu.ring[(s_imu.written - 1) % IMU_RING_SAMPLES]);
+    }
+}
+
+int HalEsp32::getImuWindow(IMUData_t* samples, int count)
+{
+    imu_keep_sampling();
+    std::lock_guard<std::mutex> lock(s_imu.mutex);
+    int n          = (int)std::min<uint32_t>(std::max(count, 0), std::min<uint32_t>(s_imu.written, IMU_RING_SAMPLES));
+    uint32_t first = s_imu.written - n;
+    for (int i = 0; i < n; i++) {
+        samples[i] = imu_convert(s_imu.ring[(first + i) % IMU_RING_SAMPLES]);
+    }
+    return n;
 }
 
 void HalEsp32::sleepAndShakeWakeup()
@@ -66,7 +198,10 @@ void HalEsp32::sleepAndShakeWakeup()
     delay(200);
 
     mclog::tagInfo(_tag, "set motion irq");
-    accel_gyro_bmi270_motion_irq();
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        accel_gyro_bmi270_motion_irq();
+    }
 
     // delay(800);
     powerOff();
@@ -0,0 +1,248 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_app_desc.h>
+
+#define TAG "input"
+
+#define INPUT_DIR        SDCARD_MOUNT_POINT "/"
+#define REPLAY_LOG_PATH  SDCARD_MOUNT_POINT "/replay.jsonl"
+#define REPLAY_SETTLE_MS 2000  // Measured after the last record, for the animations it set off
+
+using input_recording::Device_t;
+using input_recording::Record_t;
+
+// Under the LVGL lock: the read callbacks run in the LVGL task with it held
+static struct {
+    input_recording::Recorder recorder;
+    input_recording::Replayer replayer;
+    bool replaying   = false;
+    uint32_t startMs = 0;  // lv_tick_get() the replay started at
+    Record_t last[input_recording::DEVICE_COUNT]{};  // What each device reads until its next record is due
+    // Key sources are indevs of their own, the first one to press a key is recorded, and replays all the keys
+    lv_indev_t* keypad = nullptr;
+    std::vector<PerfFrame_t> frames;
+} s_input;
+
+/* -------------------------------------------------------------------------- */
+/*                                 Read hook                                  */
+/* -------------------------------------------------------------------------- */
+void input_read(Device_t device, lv_indev_t* indev, lv_indev_data_t* data)
+{
+    uint32_t now = lv_tick_get();
+    bool pressed = data->state == LV_INDEV_STATE_PRESSED;
+    if (device == input_recording::KEYPAD && !s_input.keypad && (pressed || s_input.replaying)) {
+        s_input.keypad = indev;
+    }
+    bool otherKeys = device == input_recording::KEYPAD && indev != s_input.keypad;
+
+    if (!s_input.replaying) {
+        if (!otherKeys) {
+            s_input.recorder.read(device, now, pressed, data->point.x, data->point.y,
+                                  device == input_recording::KEYPAD ? data->key : 0);
+        }
+        return;
+    }
+
+    // Only the replay's input gets to LVGL while it runs
+    if (otherKeys) {
+        data->state            = LV_INDEV_STATE_RELEASED;
+        data->continue_reading = false;
+        return;
+    }
+    uint32_t mask    = 1u << device;
+    uint32_t elapsed = now - s_input.startMs;
+    Record_t record;
+    if (s_input.replayer.next(mask, elapsed, &record)) {
+        s_input.last[device] = record;
+    }
+    const Record_t& state  = s_input.last[device];
+    data->state            = state.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->point.x          = state.x;
+    data->point.y          = state.y;
+    data->key              = state.key;
+    data->continue_reading = s_input.replayer.pending(mask, elapsed);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Recording                                 */
+/* -------------------------------------------------------------------------- */
+bool HalEsp32::startInputRecording()
+{
+    lvgl_lock(LVGL_LOCK_HAL);
+    bool busy = s_input.replaying || s_input.recorder.recording();
+    if (!busy) {
+        s_input.keypad = nullptr;
+        s_input.recorder.start(lv_tick_get());
+    }
+    lvgl_unlock();
+    if (busy) {
+        mclog::tagWarn(TAG, "Already recording or replaying");
+        return false;
+    }
+    mclog::tagInfo(TAG, "Recording input");
+    return true;
+}
+
+bool HalEsp32::stopInputRecording(const std::string& name)
+{
+    lvgl_lock(LVGL_LOCK_HAL);
+    bool recording = s_input.recorder.recording();
+    s_input.recorder.stop();
+    lvgl_unlock();
+    if (!recording) {
+        mclog::tagWarn(TAG, "Not recording");
+        return false;
+    }
+
+    // Stopped, the read callbacks leave it alone from here on
+    if (!sdcard_acquire()) {
+        mclog::tagWarn(TAG, "No SD card, recording dropped");
+        return false;
+    }
+    std::string path = INPUT_DIR + name;
+    bool saved       = s_input.recorder.save(path.c_str());
+    sdcard_release();
+    if (!saved) {
+        mclog::tagWarn(TAG, "Can't write {}", path);
+        return false;
+    }
+    mclog::tagInfo(TAG, "{} records saved to {}", s_input.recorder.size(), path);
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Replay                                   */
+/* -------------------------------------------------------------------------- */
+static void on_replay_frame(const PerfFrame_t& frame)
+{
+    s_input.frames.push_back(frame);
+}
+
+template <typename Fn>
+static void summarize(const std::vector<PerfFrame_t>& frames, Fn value, float* mean, float* p95, float* max)
+{
+    std::vector<float> values;
+    values.reserve(frames.size());
+    double sum = 0;
+    for (const auto& frame : frames) {
+        values.push_back(value(frame));
+        sum += values.back();
+    }
+    if (values.empty()) {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    *mean = sum / values.size();
+    if (p95) {
+        *p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+    }
+    if (max) {
+        *max = values.back();
+    }
+}
+
+static void replay_store(const std::string& name, const hal::HalBase::InputReplay_t& r)
+{
+    if (!sdcard_acquire()) {
+        return;
+    }
+    FILE* file = fopen(REPLAY_LOG_PATH, "a");
+    if (file) {
+        const esp_app_desc_t* app = esp_app_get_description();
+        fprintf(file,
+                "{\"firmware\": \"%s (%s %s)\", \"recording\": \"%s\", \"records\": %u, \"seconds\": %.1f, "
+                "\"frames\": %u, \"fps\": %.1f, \"render_ms_mean\": %.2f, \"render_ms_p95\": %.2f, "
+                "\"render_ms_max\": %.2f, \"flush_ms_mean\": %.2f, \"flush_ms_max\": %.2f, "
+                "\"redraw_percent_mean\": %.1f, \"redraw_percent_p95\": %.1f, \"areas_mean\": %.1f}\n",
+                app->version, app->date, app->time, name.c_str(), (unsigned)r.records, r.seconds, (unsigned)r.frames,
+                r.fps, r.renderMsMean, r.renderMsP95, r.renderMsMax, r.flushMsMean, r.flushMsMax,
+                r.redrawPercentMean, r.redrawPercentP95, r.areasMean);
+        fclose(file);
+        mclog::tagInfo(TAG, "Results appended to {}", REPLAY_LOG_PATH);
+    } else {
+        mclog::tagWarn(TAG, "Can't write {}", REPLAY_LOG_PATH);
+    }
+    sdcard_release();
+}
+
+bool HalEsp32::runInputReplay(const std::string& name, InputReplay_t* result)
+{
+    std::string path = INPUT_DIR + name;
+    input_recording::Replayer replayer;
+    if (!sdcard_acquire()) {
+        mclog::tagWarn(TAG, "No SD card");
+        return false;
+    }
+    bool loaded = replayer.load(path.c_str());
+    sdcard_release();
+    if (!loaded || replayer.size() == 0) {
+        mclog::tagWarn(TAG, "No recording in {}", path);
+        return false;
+    }
+
+    // Taps on a dark screen only wake it, the recording didn't start from one
+    resumeDisplay();
+
+    *result             = {};
+    result->records     = replayer.size();
+    uint32_t durationMs = replayer.lastMs() + REPLAY_SETTLE_MS;
+    lvgl_lock(LVGL_LOCK_HAL);
+    bool busy = s_input.replaying || s_input.recorder.recording();
+    if (!busy) {
+        s_input.replayer  = std::move(replayer);
+        s_input.replaying = true;
+        s_input.startMs   = lv_tick_get();
+        s_input.keypad    = nullptr;
+        std::fill(s_input.last, s_input.last + input_recording::DEVICE_COUNT, Record_t{});
+        s_input.frames.clear();
+        perf_on_frame(on_replay_frame);
+    }
+    lvgl_unlock();
+    if (busy) {
+        mclog::tagWarn(TAG, "Already recording or replaying");
+        return false;
+    }
+    mclog::tagInfo(TAG, "Replaying {} records from {}, {:.1f} s", result->records, path, durationMs / 1000.0f);
+
+    vTaskDelay(pdMS_TO_TICKS(durationMs));
+
+    lvgl_lock(LVGL_LOCK_HAL);
+    uint32_t elapsedMs = lv_tick_get() - s_input.startMs;
+    s_input.replaying  = false;
+    perf_on_frame(nullptr);
+    std::vector<PerfFrame_t> frames = std::move(s_input.frames);
+    s_input.frames.clear();
+    lvgl_unlock();
+
+    float screen    = lv_display_get_horizontal_resolution(lvDisp) * lv_display_get_vertical_resolution(lvDisp);
+    auto renderMs   = [](const PerfFrame_t& f) { return f.renderUs / 1000.0f; };
+    auto flushMs    = [](const PerfFrame_t& f) { return f.flushUs / 1000.0f; };
+    auto redraw     = [screen](const PerfFrame_t& f) { return 100.0f * f.pixels / screen; };
+    auto areas      = [](const PerfFrame_t& f) { return (float)f.areas; };
+    result->seconds = elapsedMs / 1000.0f;
+    result->frames  = frames.size();
+    result->fps     = result->seconds > 0 ? frames.size() / result->seconds : 0;
+    summarize(frames, renderMs, &result->renderMsMean, &result->renderMsP95, &result->renderMsMax);
+    summarize(frames, flushMs, &result->flushMsMean, nullptr, &result->flushMsMax);
+    summarize(frames, redraw, &result->redrawPercentMean, &result->redrawPercentP95, nullptr);
+    summarize(frames, areas, &result->areasMean, nullptr, nullptr);
+    mclog::tagInfo(TAG,
+                   "Replay {}: {} frames in {:.1f} s ({:.1f} fps), render mean {:.2f} p95 {:.2f} max {:.2f} ms, flush "
+                   "mean {:.2f} max {:.2f} ms, redraw mean {:.1f}% p95 {:.1f}% in {:.1f} areas",
+                   name, result->frames, result->seconds, result->fps, result->renderMsMean, result->renderMsP95,
+                   result->renderMsMax, result->flushMsMean, result->flushMsMax, result->redrawPercentMean,
+                   result->redrawPercentP95, result->areasMean);
+    replay_store(name, *result);
+    return true;
+}
@@ -0,0 +1,281 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <atomic>
+#include <ctype.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <driver/gpio.h>
+#include <driver/i2c_master.h>
+#include <bsp/m5stack_tab5.h>
+#include <esp_lvgl_port.h>
+#include <keypad_scanner_tca8418.h>
+
+#define TAG "keypad"
+
+/* -------------------------------------------------------------------------- */
+/*                                 Key sources                                */
+/* -------------------------------------------------------------------------- */
+// Each keyboard has its own keypad indev and queue. Keys go to LVGL while a text field has the focus, EVENT_KEY takes
+// the rest. The group is shared: text fields and buttons made once there's a source join it, a click focuses them
+#define KEY_QUEUE_SIZE 32  // Power of two
+
+struct KeyEvent_t {
+    uint32_t key;  // LV_KEY_* or the character
+    bool pressed;
+};
+
+struct KeySource_t {
+    // Single producer (the keyboard's task), single consumer (the indev read in the LVGL task)
+    KeyEvent_t queue[KEY_QUEUE_SIZE];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+
+    uint32_t lvglKey   = 0;  // Handed to LVGL last
+    bool lvglPressed   = false;
+    KeyEvent_t pending = {};  // A press that has to wait for the release of the key before it
+    bool hasPending    = false;
+};
+
+static lv_group_t* s_group = nullptr;
+
+static bool queue_pop(KeySource_t* source, KeyEvent_t* event)
+{
+    uint32_t tail = source->tail.load(std::memory_order_relaxed);
+    if (tail == source->head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *event = source->queue[tail % KEY_QUEUE_SIZE];
+    source->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool key_source_push(KeySource_t* source, uint32_t key, bool pressed)
+{
+    uint32_t head = source->head.load(std::memory_order_relaxed);
+    if (head - source->tail.load(std::memory_order_acquire) >= KEY_QUEUE_SIZE) {
+        return false;  // LVGL is stuck in a long redraw, the key is lost like a missed press
+    }
+    source->queue[head % KEY_QUEUE_SIZE] = {key, pressed};
+    source->head.store(head + 1, std::memory_order_release);
+    if (pressed && GetHAL()->isDisplaySuspended()) {
+        GetHAL()->resumeDisplay();  // The key still counts, unlike the touch that wakes it
+    }
+    lvgl_port_task_wake(LVGL_PORT_EVENT_USER, nullptr);
+    app_wake();
+    return true;
+}
+
+static bool text_field_focused()
+{
+    lv_obj_t* focused = lv_group_get_focused(s_group);
+    return focused && lv_obj_check_type(focused, &lv_textarea_class) && lv_obj_is_visible(focused);
+}
+
+static void key_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    KeySource_t* source = static_cast<KeySource_t*>(lv_indev_get_user_data(indev));
+    KeyEvent_t event;
+    while (source->hasPending || queue_pop(source, &event)) {
+        if (source->hasPending) {
+            event              = source->pending;
+            source->hasPending = false;
+        }
+        bool toLvgl = event.pressed ? text_field_focused() : (source->lvglPressed && event.key == source->lvglKey);
+        if (!toLvgl) {
+            if (event.pressed) {
+                hal_post_event(hal::HalBase::EVENT_KEY, event.key);
+            }
+            continue;
+        }
+        if (event.pressed && source->lvglPressed) {
+            // LVGL sees one key at a time: the held one goes up first
+            source->pending     = event;
+            source->hasPending  = true;
+            source->lvglPressed = false;
+        } else {
+            source->lvglKey     = event.key;
+            source->lvglPressed = event.pressed;
+        }
+        data->continue_reading = source->hasPending || source->tail.load() != source->head.load();
+        break;
+    }
+
+    data->key   = source->lvglKey;
+    data->state = source->lvglPressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    input_read(input_recording::KEYPAD, indev, data);
+}
+
+KeySource_t* key_source_create(lv_indev_t** indev)
+{
+    if (!s_group) {
+        s_group = lv_group_create();
+        lv_group_set_default(s_group);
+    }
+    KeySource_t* source = new KeySource_t;
+    *indev              = lv_indev_create();
+    lv_indev_set_type(*indev, LV_INDEV_TYPE_KEYPAD);
+    lv_indev_set_user_data(*indev, source);
+    lv_indev_set_read_cb(*indev, key_read_cb);
+    lv_indev_set_group(*indev, s_group);
+    return source;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Keypad                                   */
+/* -------------------------------------------------------------------------- */
+// The TCA8418 scans and debounces the matrix itself, and holds INT low while its event FIFO isn't empty. The keypad
+// task sleeps until INT falls and drains the whole FIFO in one burst read, between presses nothing goes over the bus
+#define KEYPAD_I2C_ADDR     0x34
+#define KEYPAD_INT_PIN      GPIO_NUM_50
+#define KEYPAD_ROWS         8
+#define KEYPAD_COLUMNS      9   // The 10th column's line is a GPI, the FN key
+#define KEYPAD_FIFO_EVENTS  10  // The TCA8418's FIFO depth
+#define KEYPAD_RETRY_MS     50  // INT stayed low but the read failed
+#define KEYPAD_KEY_CODES    128
+
+// Key numbers (row * 10 + column + 1) of the keys that don't type a character, see key_value_map_str
+enum : uint8_t {
+    KEYPAD_SHIFT = 7,
+    KEYPAD_ESC   = 28,
+    KEYPAD_CAPS  = 37,
+    KEYPAD_TAB   = 38,
+    KEYPAD_STOP  = 48,
+    KEYPAD_LEFT  = 49,
+    KEYPAD_BS    = 58,
+    KEYPAD_UP    = 59,
+    KEYPAD_SEL   = 68,
+    KEYPAD_DOWN  = 69,
+    KEYPAD_RET   = 78,
+    KEYPAD_RIGHT = 79,
+};
+
+static TaskHandle_t s_keypad_task = nullptr;
+static KeySource_t* s_keypad      = nullptr;
+
+static void IRAM_ATTR on_keypad_interrupt(void* arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_keypad_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// 0 for the keys that do nothing by themselves
+static uint32_t translate(uint8_t code, bool upper)
+{
+    switch (code) {
+        case KEYPAD_ESC:
+        case KEYPAD_STOP:
+            return LV_KEY_ESC;
+        case KEYPAD_TAB:
+            return LV_KEY_NEXT;
+        case KEYPAD_LEFT:
+            return LV_KEY_LEFT;
+        case KEYPAD_RIGHT:
+            return LV_KEY_RIGHT;
+        case KEYPAD_UP:
+            return LV_KEY_UP;
+        case KEYPAD_DOWN:
+            return LV_KEY_DOWN;
+        case KEYPAD_BS:
+            return LV_KEY_BACKSPACE;
+        case KEYPAD_RET:
+        case KEYPAD_SEL:
+            return LV_KEY_ENTER;
+        default:
+            break;
+    }
+    if (code < 1 || code > KEYPAD_ROWS * 10) {
+        return 0;  // The GPI and anything unknown
+    }
+    unsigned char c = key_value_map[code - 1];
+    if (c <= ' ' || c > '~') {
+        return 0;  // Blank in the table, a modifier, or not ASCII
+    }
+    return upper ? toupper(c) : c;
+}
+
+static void keypad_task(void* param)
+{
+    uint8_t events[KEYPAD_FIFO_EVENTS];
+    uint32_t down[KEYPAD_KEY_CODES] = {};  // What each held key was pressed as, its release goes out the same
+    bool shift                      = false;
+    bool caps                       = false;
+
+    while (true) {
+        // INT stays low while events are left, a burst that didn't take them all goes round again
+        if (gpio_get_level(KEYPAD_INT_PIN) != 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        uint8_t n = keypad_scanner_tca8418_read_events(events, KEYPAD_FIFO_EVENTS);
+        if (n == 0) {
+            vTaskDelay(pdMS_TO_TICKS(KEYPAD_RETRY_MS));
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            uint8_t code = events[i] & 0x7F;
+            bool pressed = events[i] & 0x80;
+            if (code == KEYPAD_SHIFT) {
+                shift = pressed;
+                continue;
+            }
+            if (code == KEYPAD_CAPS) {
+                if (pressed) {
+                    caps = !caps;
+                }
+                continue;
+            }
+            uint32_t key = pressed ? translate(code, shift != caps) : down[code];
+            down[code]   = pressed ? key : 0;
+            if (key) {
+                key_source_push(s_keypad, key, pressed);
+            }
+        }
+    }
+}
+
+lv_indev_t* keypad_start()
+{
+    if (!port_a_acquire()) {
+        return nullptr;
+    }
+    i2c_master_bus_handle_t bus = bsp_ext_i2c_get_handle();
+    if (i2c_master_probe(bus, KEYPAD_I2C_ADDR, 20) != ESP_OK) {
+        mclog::tagInfo(TAG, "no keyboard on port a");
+        port_a_release();
+        return nullptr;
+    }
+    keypad_scanner_tca8418_init(bus);
+    keypad_scanner_tca8418_matrix(KEYPAD_ROWS, KEYPAD_COLUMNS);
+    keypad_scanner_tca8418_flush();
+
+    lv_indev_t* indev = nullptr;
+    s_keypad          = key_source_create(&indev);
+    if (task_topology::create(task_topology::KEYPAD, keypad_task, nullptr, &s_keypad_task) != pdPASS) {
+        mclog::tagError(TAG, "no keypad task");
+        port_a_release();
+        return indev;  // Stays quiet
+    }
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask  = 1ULL << KEYPAD_INT_PIN;
+    io_conf.mode          = GPIO_MODE_INPUT;
+    io_conf.pull_up_en    = GPIO_PULLUP_ENABLE;
+    io_conf.intr_type     = GPIO_INTR_NEGEDGE;
+    gpio_config(&io_conf);
+    // The touch controller's driver may have installed the service already
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        mclog::tagError(TAG, "no gpio isr service: {}", esp_err_to_name(ret));
+    }
+    gpio_isr_handler_add(KEYPAD_INT_PIN, on_keypad_interrupt, nullptr);
+    keypad_scanner_tca8418_enable_int();
+
+    mclog::tagInfo(TAG, "keyboard on port a, {}x{} keys", KEYPAD_ROWS, KEYPAD_COLUMNS);
+    return indev;
+}
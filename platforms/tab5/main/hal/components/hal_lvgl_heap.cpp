@@ -0,0 +1,318 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <hal/metrics.h>
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <lvgl.h>
+#include <esp_heap_caps.h>
+#include <multi_heap.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define TAG "lvgl_heap"
+
+#if CONFIG_LV_USE_CUSTOM_MALLOC
+/* -------------------------------------------------------------------------- */
+/*                                  LVGL heap                                 */
+/* -------------------------------------------------------------------------- */
+// LVGL's lv_malloc() and friends, CONFIG_LV_USE_CUSTOM_MALLOC. Going through the C library put every widget, style
+// and label text below the SPIRAM malloc threshold into the internal heap WiFi and the drivers need, and everything
+// else, decoded images and the catalog's strings, into PSRAM next to the stream buffers. Here LVGL has heaps of its
+// own, each IDF's TLSF multi_heap over a block taken once:
+//   - A small internal pool, CONFIG_TAB5_LVGL_FAST_HEAP_KB, for allocations of up to LVGL_SMALL_MAX bytes: objects,
+//     style lists and short strings, what the renderer walks every frame, stay out of the PSRAM cache's way. When
+//     it's full they go to PSRAM like the rest
+//   - PSRAM regions, the first of CONFIG_TAB5_LVGL_HEAP_KB at lv_init(), another of CONFIG_TAB5_LVGL_HEAP_EXPAND_KB
+//     (or what the allocation needs) whenever none has room, up to LVGL_HEAP_REGIONS. A big catalog or a full
+//     artwork cache grows the heap instead of failing at a fixed size
+// Each heap has its own lock, taken by multi_heap for the allocation only. Regions are only ever added, under a
+// mutex; a region is published by the count, after it's set up, so finding a pointer's heap takes no lock.
+#define LVGL_SMALL_MAX    256
+#define LVGL_HEAP_REGIONS 8
+
+struct LvglRegion_t {
+    uint8_t* start           = nullptr;
+    size_t size              = 0;
+    multi_heap_handle_t heap = nullptr;
+    portMUX_TYPE lock        = portMUX_INITIALIZER_UNLOCKED;
+};
+
+static struct {
+    LvglRegion_t fast;
+    LvglRegion_t regions[LVGL_HEAP_REGIONS];
+    std::atomic<int> count{0};
+    SemaphoreHandle_t growLock = nullptr;
+    StaticSemaphore_t growLockBuffer;
+    std::atomic<uint32_t> failures{0};
+} s_lvgl_heap;
+
+static metrics::Gauge s_metric_size_fast("lvgl_heap_size_bytes", "Bytes the LVGL heap holds", "pool=\"internal\"");
+static metrics::Gauge s_metric_size_psram("lvgl_heap_size_bytes", "Bytes the LVGL heap holds", "pool=\"psram\"");
+static metrics::Gauge s_metric_used_fast("lvgl_heap_used_bytes", "Bytes LVGL has allocated, block headers included",
+                                         "pool=\"internal\"");
+static metrics::Gauge s_metric_used_psram("lvgl_heap_used_bytes", "Bytes LVGL has allocated, block headers included",
+                                          "pool=\"psram\"");
+static metrics::Gauge s_metric_peak_fast("lvgl_heap_peak_bytes", "Most bytes allocated at once, per region summed",
+                                         "pool=\"internal\"");
+static metrics::Gauge s_metric_peak_psram("lvgl_heap_peak_bytes", "Most bytes allocated at once, per region summed",
+                                          "pool=\"psram\"");
+static metrics::Gauge s_metric_block_fast("lvgl_heap_largest_free_block_bytes", "Largest allocation that fits",
+                                          "pool=\"internal\"");
+static metrics::Gauge s_metric_block_psram("lvgl_heap_largest_free_block_bytes", "Largest allocation that fits",
+                                           "pool=\"psram\"");
+static metrics::Gauge s_metric_frag_fast("lvgl_heap_fragmentation_percent",
+                                         "Free bytes outside the largest free block", "pool=\"internal\"");
+static metrics::Gauge s_metric_frag_psram("lvgl_heap_fragmentation_percent",
+                                          "Free bytes outside the largest free block", "pool=\"psram\"");
+static metrics::Gauge s_metric_regions("lvgl_heap_regions", "PSRAM regions the LVGL heap has grown to");
+static metrics::Gauge s_metric_failures("lvgl_heap_failed_allocs", "LVGL allocations no heap had room for");
+
+static bool region_init(LvglRegion_t* region, size_t size, uint32_t caps)
+{
+    region->start = (uint8_t*)heap_caps_malloc(size, caps);
+    if (!region->start) {
+        return false;
+    }
+    region->heap = multi_heap_register(region->start, size);
+    if (!region->heap) {
+        heap_caps_free(region->start);
+        region->start = nullptr;
+        return false;
+    }
+    multi_heap_set_lock(region->heap, &region->lock);
+    region->size = size;
+    return true;
+}
+
+static bool region_contains(const LvglRegion_t& region, const void* p)
+{
+    return region.heap && p >= region.start && (const uint8_t*)p < region.start + region.size;
+}
+
+static LvglRegion_t* region_of(const void* p)
+{
+    if (region_contains(s_lvgl_heap.fast, p)) {
+        return &s_lvgl_heap.fast;
+    }
+    int count = s_lvgl_heap.count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (region_contains(s_lvgl_heap.regions[i], p)) {
+            return &s_lvgl_heap.regions[i];
+        }
+    }
+    return nullptr;
+}
+
+// Another PSRAM region with room for `size`, unless another task added one meanwhile: it's tried first
+static void* grow_and_alloc(size_t size, int seen)
+{
+    xSemaphoreTake(s_lvgl_heap.growLock, portMAX_DELAY);
+    void* p   = nullptr;
+    int count = s_lvgl_heap.count.load(std::memory_order_relaxed);
+    for (int i = seen; !p && i < count; i++) {
+        p = multi_heap_malloc(s_lvgl_heap.regions[i].heap, size);
+    }
+    if (!p && count < LVGL_HEAP_REGIONS) {
+        // Room for the allocator's headers and a few neighbours of a large one
+        size_t bytes = std::max<size_t>(CONFIG_TAB5_LVGL_HEAP_EXPAND_KB * 1024, size + size / 8 + 1024);
+        auto& region = s_lvgl_heap.regions[count];
+        if (region_init(&region, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)) {
+            s_lvgl_heap.count.store(count + 1, std::memory_order_release);
+            mclog::tagInfo(TAG, "grown by {} KB, {} regions", bytes / 1024, count + 1);
+            p = multi_heap_malloc(region.heap, size);
+        }
+    }
+    xSemaphoreGive(s_lvgl_heap.growLock);
+    return p;
+}
+
+static void* lvgl_alloc(size_t size, bool small)
+{
+    void* p = small && s_lvgl_heap.fast.heap ? multi_heap_malloc(s_lvgl_heap.fast.heap, size) : nullptr;
+    int count = s_lvgl_heap.count.load(std::memory_order_acquire);
+    for (int i = 0; !p && i < count; i++) {
+        p = multi_heap_malloc(s_lvgl_heap.regions[i].heap, size);
+    }
+    if (!p) {
+        p = grow_and_alloc(size, count);
+    }
+    if (!p) {
+        s_lvgl_heap.failures.fetch_add(1, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+struct LvglHeapInfo_t {
+    size_t size    = 0;
+    size_t free    = 0;
+    size_t minFree = 0;
+    size_t largest = 0;
+    size_t used    = 0;  // Blocks
+    size_t holes   = 0;  // Free blocks
+};
+
+static void region_info(const LvglRegion_t& region, LvglHeapInfo_t* info)
+{
+    if (!region.heap) {
+        return;
+    }
+    multi_heap_info_t heap;
+    multi_heap_get_info(region.heap, &heap);
+    info->size += region.size;
+    info->free += heap.total_free_bytes;
+    info->minFree += heap.minimum_free_bytes;
+    info->largest = std::max(info->largest, heap.largest_free_block);
+    info->used += heap.allocated_blocks;
+    info->holes += heap.free_blocks;
+}
+
+static void psram_info(LvglHeapInfo_t* info)
+{
+    int count = s_lvgl_heap.count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        region_info(s_lvgl_heap.regions[i], info);
+    }
+}
+
+static int fragmentation(const LvglHeapInfo_t& info)
+{
+    return info.free ? 100 - (int)(info.largest * 100 / info.free) : 0;
+}
+
+extern "C" {
+
+void lv_mem_init(void)
+{
+    s_lvgl_heap.growLock = xSemaphoreCreateMutexStatic(&s_lvgl_heap.growLockBuffer);
+    if (CONFIG_TAB5_LVGL_FAST_HEAP_KB > 0 &&
+        !region_init(&s_lvgl_heap.fast, CONFIG_TAB5_LVGL_FAST_HEAP_KB * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) {
+        mclog::tagWarn(TAG, "no room for the {} KB internal pool", CONFIG_TAB5_LVGL_FAST_HEAP_KB);
+    }
+    if (region_init(&s_lvgl_heap.regions[0], CONFIG_TAB5_LVGL_HEAP_KB * 1024, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)) {
+        s_lvgl_heap.count.store(1, std::memory_order_release);
+    }
+    mclog::tagInfo(TAG, "{} KB internal, {} KB PSRAM, growing by {} KB", s_lvgl_heap.fast.size / 1024,
+                   s_lvgl_heap.regions[0].size / 1024, CONFIG_TAB5_LVGL_HEAP_EXPAND_KB);
+}
+
+void lv_mem_deinit(void)
+{
+    // LVGL's objects are all gone by now, so are the blocks
+    int count = s_lvgl_heap.count.exchange(0);
+    for (int i = 0; i < count; i++) {
+        heap_caps_free(s_lvgl_heap.regions[i].start);
+        s_lvgl_heap.regions[i] = {};
+    }
+    if (s_lvgl_heap.fast.start) {
+        heap_caps_free(s_lvgl_heap.fast.start);
+        s_lvgl_heap.fast = {};
+    }
+}
+
+// The heap grows by itself, a pool handed in is not taken
+lv_mem_pool_t lv_mem_add_pool(void* mem, size_t bytes)
+{
+    return nullptr;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t pool)
+{
+}
+
+void* lv_malloc_core(size_t size)
+{
+    return lvgl_alloc(size, size <= LVGL_SMALL_MAX);
+}
+
+void* lv_realloc_core(void* p, size_t new_size)
+{
+    if (!p) {
+        return lv_malloc_core(new_size);
+    }
+    LvglRegion_t* region = region_of(p);
+    if (!region) {
+        return nullptr;
+    }
+    // In place if its heap has room, a small block outgrowing the internal pool moves to PSRAM
+    bool leaves = region == &s_lvgl_heap.fast && new_size > LVGL_SMALL_MAX;
+    void* moved = leaves ? nullptr : multi_heap_realloc(region->heap, p, new_size);
+    if (moved) {
+        return moved;
+    }
+    moved = lvgl_alloc(new_size, new_size <= LVGL_SMALL_MAX && !leaves);
+    if (moved) {
+        memcpy(moved, p, std::min(new_size, multi_heap_get_allocated_size(region->heap, p)));
+        multi_heap_free(region->heap, p);
+    }
+    return moved;
+}
+
+void lv_free_core(void* p)
+{
+    LvglRegion_t* region = region_of(p);
+    if (region) {
+        multi_heap_free(region->heap, p);
+    }
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t* mon_p)
+{
+    LvglHeapInfo_t info;
+    region_info(s_lvgl_heap.fast, &info);
+    psram_info(&info);
+    mon_p->total_size        = info.size;
+    mon_p->free_size         = info.free;
+    mon_p->free_biggest_size = info.largest;
+    mon_p->free_cnt          = info.holes;
+    mon_p->used_cnt          = info.used;
+    mon_p->max_used          = info.size - info.minFree;
+    mon_p->used_pct          = info.size ? 100 - (int)(info.free * 100 / info.size) : 0;
+    mon_p->frag_pct          = fragmentation(info);
+}
+
+lv_result_t lv_mem_test_core(void)
+{
+    if (s_lvgl_heap.fast.heap && !multi_heap_check(s_lvgl_heap.fast.heap, true)) {
+        return LV_RESULT_INVALID;
+    }
+    int count = s_lvgl_heap.count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (!multi_heap_check(s_lvgl_heap.regions[i].heap, true)) {
+            return LV_RESULT_INVALID;
+        }
+    }
+    return LV_RESULT_OK;
+}
+
+}  // extern "C"
+
+void lvgl_heap_sample()
+{
+    LvglHeapInfo_t fast;
+    LvglHeapInfo_t psram;
+    region_info(s_lvgl_heap.fast, &fast);
+    psram_info(&psram);
+    s_metric_size_fast.set(fast.size);
+    s_metric_size_psram.set(psram.size);
+    s_metric_used_fast.set(fast.size - fast.free);
+    s_metric_used_psram.set(psram.size - psram.free);
+    s_metric_peak_fast.set(fast.size - fast.minFree);
+    s_metric_peak_psram.set(psram.size - psram.minFree);
+    s_metric_block_fast.set(fast.largest);
+    s_metric_block_psram.set(psram.largest);
+    s_metric_frag_fast.set(fragmentation(fast));
+    s_metric_frag_psram.set(fragmentation(psram));
+    s_metric_regions.set(s_lvgl_heap.count.load(std::memory_order_relaxed));
+    s_metric_failures.set(s_lvgl_heap.failures.load(std::memory_order_relaxed));
+}
+#else
+void lvgl_heap_sample()
+{
+}
+#endif
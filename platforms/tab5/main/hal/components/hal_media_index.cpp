@@ -0,0 +1,325 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <stream/media_index.h>
+#include <stream/media_tags.h>
+#include <mooncake_log.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char* TAG = "media";
+
+/* -------------------------------------------------------------------------- */
+/*                                 Media Index                                */
+/* -------------------------------------------------------------------------- */
+// The card is walked by a low priority task and its tags go into a sorted index (stream/media_index.h) kept on the
+// card, so browsing never opens a file. A rescan lists every directory again, FatFs never updates a directory's
+// timestamp when files come or go, but only opens files whose size or time differ from what the index has
+#define MEDIA_INDEX_PATH   SDCARD_MOUNT_POINT "/.media_index"
+#define MEDIA_INDEX_TEMP   SDCARD_MOUNT_POINT "/.media_index.tmp"
+#define MEDIA_INDEX_MAX    (8 * 1024 * 1024)  // Bytes, a bigger file isn't one of ours
+#define MEDIA_MAX_FILES    20000
+#define MEDIA_MAX_DEPTH    8
+#define MEDIA_YIELD_EVERY  16  // Files read between breaks for anything else on the card
+
+static struct {
+    std::mutex mutex;  // Everything below
+    std::shared_ptr<const MediaIndex> index;  // Searched outside the lock, a scan swaps in a new one
+    uint32_t generation = 0;                  // Bumped when the card goes, a scan of the one before doesn't publish
+    bool running        = false;
+    bool rescan         = false;  // Asked for again while a scan ran
+} s_media;
+
+static bool is_media_file(const char* name)
+{
+    const char* dot = strrchr(name, '.');
+    if (!dot) {
+        return false;
+    }
+    for (const char* ext : {".mp3", ".aac", ".flac", ".ogg", ".opus"}) {
+        if (strcasecmp(dot, ext) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool load_index_file(MediaIndex* index)
+{
+    // The temporary one is left if a power cut came between writing it and the rename
+    for (const char* path : {MEDIA_INDEX_PATH, MEDIA_INDEX_TEMP}) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            continue;
+        }
+        long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+        std::vector<uint8_t> blob;
+        if (size > 0 && size <= MEDIA_INDEX_MAX && fseek(file, 0, SEEK_SET) == 0) {
+            blob.resize(size);
+            if (fread(blob.data(), 1, size, file) != (size_t)size) {
+                blob.clear();
+            }
+        }
+        fclose(file);
+        if (index->load(std::move(blob))) {
+            return true;
+        }
+        mclog::tagWarn(TAG, "{} isn't a usable index", path);
+    }
+    return false;
+}
+
+static bool save_index_file(const std::vector<uint8_t>& blob)
+{
+    FILE* file = fopen(MEDIA_INDEX_TEMP, "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    written      = (fclose(file) == 0) && written;
+    if (!written) {
+        unlink(MEDIA_INDEX_TEMP);
+        return false;
+    }
+    // FatFs won't rename onto an existing file
+    unlink(MEDIA_INDEX_PATH);
+    return rename(MEDIA_INDEX_TEMP, MEDIA_INDEX_PATH) == 0;
+}
+
+static void publish(std::shared_ptr<const MediaIndex> index, uint32_t generation)
+{
+    std::lock_guard<std::mutex> lock(s_media.mutex);
+    if (generation == s_media.generation) {
+        s_media.index = std::move(index);
+    }
+}
+
+static std::string file_stem(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    return name.substr(0, name.rfind('.'));
+}
+
+/**
+ * @brief Tags from the first HEAD_BYTES of the file, and ID3v1 from its end where those leave a gap
+ */
+static void read_tags(const std::string& path, off_t size, std::vector<uint8_t>* buffer, media_tags::Tags_t* tags)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return;
+    }
+    setvbuf(file, nullptr, _IONBF, 0);
+    size_t len = fread(buffer->data(), 1, media_tags::HEAD_BYTES, file);
+    media_tags::parse(buffer->data(), len, tags);
+    if (!tags->complete() && size >= (off_t)(media_tags::ID3V1_SIZE + len) &&
+        fseek(file, -(long)media_tags::ID3V1_SIZE, SEEK_END) == 0 &&
+        fread(buffer->data(), 1, media_tags::ID3V1_SIZE, file) == media_tags::ID3V1_SIZE) {
+        media_tags::parse_id3v1(buffer->data(), tags);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Walk the card into a new index, with the records of `old` for the files that haven't changed
+ *
+ * @return false if the card went away meanwhile, the walk may have missed files then
+ */
+static bool scan_card(const MediaIndex* old, uint32_t generation, MediaIndexBuilder* builder)
+{
+    std::vector<uint32_t> oldByPath = old ? old->pathOrder() : std::vector<uint32_t>();
+    std::vector<uint8_t> buffer(media_tags::HEAD_BYTES);
+    std::vector<std::pair<std::string, int>> pending = {{"", 0}};  // Directories from the root, with their depth
+    uint32_t read   = 0;
+    uint32_t reused = 0;
+    uint32_t start  = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    while (!pending.empty() && builder->size() < MEDIA_MAX_FILES) {
+        auto [dir, depth] = pending.back();
+        pending.pop_back();
+        DIR* handle = opendir((SDCARD_MOUNT_POINT + dir).c_str());
+        if (!handle) {
+            continue;
+        }
+        // The directory is read to its end before anything in it is opened, one handle at a time
+        std::vector<std::string> files;
+        struct dirent* entry;
+        while ((entry = readdir(handle)) != nullptr) {
+            if (entry->d_name[0] == '.' || strcmp(entry->d_name, "System Volume Information") == 0) {
+                continue;
+            }
+            std::string path = dir + "/" + entry->d_name;
+            if (entry->d_type == DT_DIR) {
+                if (depth + 1 < MEDIA_MAX_DEPTH) {
+                    pending.push_back({path, depth + 1});
+                }
+            } else if (is_media_file(entry->d_name)) {
+                files.push_back(path);
+            }
+        }
+        closedir(handle);
+
+        for (const std::string& path : files) {
+            if (builder->size() >= MEDIA_MAX_FILES) {
+                mclog::tagWarn(TAG, "More than {} files, the rest aren't indexed", MEDIA_MAX_FILES);
+                break;
+            }
+            std::string full = SDCARD_MOUNT_POINT + path;
+            struct stat st;
+            if (stat(full.c_str(), &st) != 0) {
+                continue;
+            }
+            const MediaIndex::Record_t* known = old ? old->findPath(oldByPath, path.c_str()) : nullptr;
+            if (known && known->size == (uint32_t)st.st_size && known->mtime == (uint32_t)st.st_mtime) {
+                builder->add(old->string(known->artist), old->string(known->album), old->string(known->title),
+                             path.c_str(), known->size, known->mtime);
+                reused++;
+                continue;
+            }
+
+            media_tags::Tags_t tags;
+            read_tags(full, st.st_size, &buffer, &tags);
+            if (tags.title.empty()) {
+                tags.title = file_stem(path);
+            }
+            builder->add(tags.artist.c_str(), tags.album.c_str(), tags.title.c_str(), path.c_str(),
+                         (uint32_t)st.st_size, (uint32_t)st.st_mtime);
+            if (++read % MEDIA_YIELD_EVERY == 0) {
+                vTaskDelay(1);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(s_media.mutex);
+        if (generation != s_media.generation) {
+            return false;
+        }
+    }
+    mclog::tagInfo(TAG, "Scanned {} files in {} ms, {} read, {} unchanged", builder->size(),
+                   xTaskGetTickCount() * portTICK_PERIOD_MS - start, read, reused);
+    return true;
+}
+
+static void media_index_task(void* param)
+{
+    while (true) {
+        uint32_t generation;
+        std::shared_ptr<const MediaIndex> old;
+        {
+            std::lock_guard<std::mutex> lock(s_media.mutex);
+            generation = s_media.generation;
+            old        = s_media.index;
+        }
+
+        if (sdcard_acquire()) {
+            // What the last scan left on the card can be searched until this one is done
+            if (!old) {
+                auto loaded = std::make_shared<MediaIndex>();
+                if (load_index_file(loaded.get())) {
+                    mclog::tagInfo(TAG, "Loaded the index, {} files", loaded->size());
+                    old = loaded;
+                    publish(loaded, generation);
+                }
+            }
+
+            MediaIndexBuilder builder;
+            if (scan_card(old.get(), generation, &builder)) {
+                auto index = std::make_shared<MediaIndex>();
+                std::vector<uint8_t> blob = builder.finish();
+                if (!save_index_file(blob)) {
+                    mclog::tagWarn(TAG, "Can't write {}, the index lasts until the card goes", MEDIA_INDEX_PATH);
+                }
+                index->load(std::move(blob));
+                uint32_t count = index->size();
+                publish(std::move(index), generation);
+                hal_post_event(hal::HalBase::EVENT_MEDIA_INDEX, count);
+            }
+            sdcard_release();
+        }
+
+        std::lock_guard<std::mutex> lock(s_media.mutex);
+        if (!s_media.rescan) {
+            s_media.running = false;
+            break;
+        }
+        s_media.rescan = false;
+    }
+    mclog::tagInfo(TAG, "Index task ended, {} B stack left", task_topology::stack_headroom());
+    vTaskDelete(NULL);
+}
+
+void media_index_mounted()
+{
+    GetHAL()->startMediaScan();
+}
+
+void media_index_removed()
+{
+    std::lock_guard<std::mutex> lock(s_media.mutex);
+    s_media.generation++;
+    s_media.index.reset();
+}
+
+bool HalEsp32::startMediaScan()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_media.mutex);
+        if (s_media.running) {
+            s_media.rescan = true;
+            return true;
+        }
+        s_media.running = true;
+    }
+    if (task_topology::create(task_topology::MEDIA_INDEX, media_index_task, nullptr, nullptr) != pdPASS) {
+        std::lock_guard<std::mutex> lock(s_media.mutex);
+        s_media.running = false;
+        return false;
+    }
+    return true;
+}
+
+bool HalEsp32::isMediaScanRunning()
+{
+    std::lock_guard<std::mutex> lock(s_media.mutex);
+    return s_media.running;
+}
+
+std::vector<hal::HalBase::MediaEntry_t> HalEsp32::searchMedia(MediaField_t field, const std::string& prefix,
+                                                               int maxResults)
+{
+    std::vector<MediaEntry_t> results;
+    std::shared_ptr<const MediaIndex> index;
+    {
+        std::lock_guard<std::mutex> lock(s_media.mutex);
+        index = s_media.index;
+    }
+    if (!index || maxResults <= 0) {
+        return results;
+    }
+    auto collect = [&](const MediaIndex::Record_t& r) {
+        results.push_back({index->string(r.artist), index->string(r.album), index->string(r.title),
+                           index->string(r.path)});
+        return (int)results.size() < maxResults;
+    };
+    if (field == MEDIA_ARTIST) {
+        index->findByArtist(prefix.c_str(), collect);
+    } else {
+        index->findByTitle(prefix.c_str(), collect);
+    }
+    return results;
+}
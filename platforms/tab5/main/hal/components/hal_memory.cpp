@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <mooncake_log.h>
+
+#define TAG "memory"
+
+static MemoryArena s_pools[hal::HalBase::MEMORY_POOL_COUNT];
+
+void memory_init()
+{
+    // First thing in init(), before the drivers and the WiFi stack have taken their share and left holes
+    auto reserve = [](hal::HalBase::MemoryPool_t pool, const char* name, size_t kb, uint32_t caps) {
+        if (!s_pools[pool].reserve(name, kb * 1024, caps) && kb > 0) {
+            mclog::tagWarn(TAG, "no room for the {} KB {} pool, its buffers come from the system heap", kb, name);
+            return;
+        }
+        mclog::tagInfo(TAG, "{} pool: {} KB", name, kb);
+    };
+    reserve(hal::HalBase::MEMORY_STREAM, "stream", CONFIG_TAB5_STREAM_ARENA_KB, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    reserve(hal::HalBase::MEMORY_INTERNAL, "internal", CONFIG_TAB5_INTERNAL_POOL_KB,
+            MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+}
+
+MemoryArena& memory_pool(hal::HalBase::MemoryPool_t pool)
+{
+    return s_pools[pool];
+}
+
+void* HalEsp32::allocBuffer(MemoryPool_t pool, size_t size)
+{
+    return s_pools[pool].alloc(size);
+}
+
+void HalEsp32::freeBuffer(MemoryPool_t pool, void* buffer)
+{
+    s_pools[pool].free(buffer);
+}
+
+bool HalEsp32::getMemoryPoolStats(MemoryPool_t pool, MemoryPoolStats_t* stats)
+{
+    const MemoryArena& arena = s_pools[pool];
+    stats->name              = arena.name();
+    stats->size              = arena.size();
+    stats->used              = arena.used();
+    stats->highWater         = arena.highWater();
+    stats->fallbacks         = arena.fallbacks();
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <hal/metrics.h>
+#include <mooncake_log.h>
+#include <string>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#define TAG "metrics"
+
+// What the registry holds is kept up to date where it happens, these are only read when a scrape asks
+static metrics::Gauge s_uptime("uptime_seconds", "Time since boot");
+static metrics::Gauge s_internal_free("heap_internal_free_bytes", "Free internal RAM");
+static metrics::Gauge s_internal_min("heap_internal_min_free_bytes", "Least free internal RAM since boot");
+static metrics::Gauge s_internal_block("heap_internal_largest_block_bytes", "Largest free block of internal RAM");
+static metrics::Gauge s_psram_free("heap_psram_free_bytes", "Free PSRAM");
+static metrics::Gauge s_psram_min("heap_psram_min_free_bytes", "Least free PSRAM since boot");
+static metrics::Gauge s_bus_voltage("power_bus_volts", "Supply voltage at the INA226");
+static metrics::Gauge s_current("power_current_amps", "Supply current at the INA226, negative while charging");
+static metrics::Gauge s_power("power_bus_watts", "Supply power at the INA226");
+
+static void sample()
+{
+    s_uptime.set(esp_timer_get_time() / 1000000.0f);
+    s_internal_free.set(heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    s_internal_min.set(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    s_internal_block.set(heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    s_psram_free.set(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    s_psram_min.set(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    // The power monitor's task has the newest sample, the scrape doesn't wait on the I2C bus for one
+    hal::HalBase::PMData_t power;
+    if (power_monitor_latest(&power)) {
+        s_bus_voltage.set(power.busVoltage);
+        s_current.set(power.shuntCurrent);
+        s_power.set(power.busPower);
+    }
+    lvgl_heap_sample();
+}
+
+// In the server's task on the network core: rendering only loads the atomics the audio tasks add to
+static esp_err_t metrics_handler(httpd_req_t* req)
+{
+    sample();
+    std::string text;
+    text.reserve(4096);
+    metrics::render(&text);
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    return httpd_resp_send(req, text.data(), text.size());
+}
+
+void metrics_attach(httpd_handle_t server)
+{
+    static const httpd_uri_t metrics_uri = {
+        .uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler, .user_ctx = nullptr};
+    if (httpd_register_uri_handler(server, &metrics_uri) != ESP_OK) {
+        mclog::tagError(TAG, "failed to register /metrics");
+        return;
+    }
+    mclog::tagInfo(TAG, "serving /metrics");
+}
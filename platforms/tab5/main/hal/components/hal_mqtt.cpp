@@ -0,0 +1,232 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_crt_bundle.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <mqtt_client.h>
+
+#define TAG "mqtt"
+
+#if CONFIG_TAB5_MQTT
+/* -------------------------------------------------------------------------- */
+/*                                    MQTT                                    */
+/* -------------------------------------------------------------------------- */
+// For a building system: the unit publishes what it plays under CONFIG_TAB5_MQTT_TOPIC and takes commands under
+// <topic>/set. The topics, all retained:
+//   <topic>/status   "online", or "offline" as the broker's last will
+//   <topic>/state    stopped, buffering, playing, error or paused
+//   <topic>/station  the station's name, <topic>/title the track's
+//   <topic>/volume   0..100
+//   <topic>/health   JSON: uptime, free internal heap, buffer %, bitrate, output underruns, every MQTT_HEALTH_S
+// and the commands, posted as EVENT_REMOTE from a background worker, never from the MQTT client's task:
+//   <topic>/set/station <index>, <topic>/set/volume <0..100>, <topic>/set/play, stop, next, previous
+//
+// A task of its own publishes at most CONFIG_TAB5_MQTT_MAX_HZ times a second, only the topics whose value changed
+// since the last publish: a title change and the buffering around it are one batch. The QoS and backpressure policy:
+//   - State goes out QoS 0 retained, the newest value is all that matters. Publishes are queued for the client's
+//     task with esp_mqtt_client_enqueue() and never wait on the network
+//   - The outbox is capped at MQTT_OUTBOX_LIMIT bytes. A publish that doesn't fit is dropped, its topic goes out
+//     again with the next batch
+//   - Nothing is queued while the broker is away. Once it's back every topic is republished, so a broker outage
+//     costs the stream nothing but a reconnect attempt now and then in the client's task
+//   - Commands are subscribed QoS 1, a command isn't lost to a dropped packet
+#define MQTT_OUTBOX_LIMIT (8 * 1024)
+#define MQTT_HEALTH_S     30
+#define MQTT_KEEPALIVE_S  60
+#define MQTT_PAYLOAD_MAX  256
+
+enum Topic_t {
+    TOPIC_STATE,
+    TOPIC_STATION,
+    TOPIC_TITLE,
+    TOPIC_VOLUME,
+    TOPIC_HEALTH,
+    TOPIC_COUNT,
+};
+
+static const char* TOPIC_NAMES[TOPIC_COUNT] = {"state", "station", "title", "volume", "health"};
+static const char* STATE_NAMES[]            = {"stopped", "buffering", "playing", "error", "paused"};
+
+static struct {
+    esp_mqtt_client_handle_t client = nullptr;
+    TaskHandle_t task               = nullptr;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> republish{false};  // Connected again, every topic goes out
+    std::string published[TOPIC_COUNT];  // What the broker has, the publish task's alone
+    uint32_t drops = 0;
+} s_mqtt;
+
+static std::string topic(const char* name)
+{
+    return std::string(CONFIG_TAB5_MQTT_TOPIC) + "/" + name;
+}
+
+static void current(std::string values[TOPIC_COUNT], bool health)
+{
+    auto hal      = GetHAL();
+    auto metadata = hal->getRadioMetadata();
+    int state     = std::clamp((int)hal->getRadioState(), 0, (int)(sizeof(STATE_NAMES) / sizeof(*STATE_NAMES)) - 1);
+    values[TOPIC_STATE]   = STATE_NAMES[state];
+    values[TOPIC_STATION] = metadata.station;
+    values[TOPIC_TITLE]   = metadata.title;
+    values[TOPIC_VOLUME]  = std::to_string(hal->getSpeakerVolume());
+    if (health) {
+        char json[MQTT_PAYLOAD_MAX];
+        snprintf(json, sizeof(json),
+                 "{\"uptime\":%lld,\"heap_internal_free\":%u,\"buffer\":%d,\"bitrate\":%d,\"underruns\":%lu,"
+                 "\"dropped_publishes\":%lu}",
+                 esp_timer_get_time() / 1000000, (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                 std::clamp(metadata.bufferPercent, 0, 100), std::max(metadata.bitrate, 0),
+                 (unsigned long)hal->getRadioOutputStats().underruns, (unsigned long)s_mqtt.drops);
+        values[TOPIC_HEALTH] = json;
+    }
+}
+
+// The topics that changed, or all of them after a reconnect. A topic the outbox had no room for keeps its old value
+// here, so it's different again next time
+static void publish(bool health)
+{
+    std::string values[TOPIC_COUNT];
+    current(values, health);
+    bool all = s_mqtt.republish.exchange(false);
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        if ((i == TOPIC_HEALTH && !health) || (!all && values[i] == s_mqtt.published[i])) {
+            continue;
+        }
+        if (esp_mqtt_client_enqueue(s_mqtt.client, topic(TOPIC_NAMES[i]).c_str(), values[i].data(), values[i].size(),
+                                    0, 1, true) < 0) {
+            s_mqtt.drops++;
+            continue;
+        }
+        s_mqtt.published[i] = values[i];
+    }
+}
+
+// One batch per interval: whatever changed in it, the volume included, which is set without an event
+static void publish_task(void* param)
+{
+    int64_t lastHealth = 0;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000 / CONFIG_TAB5_MQTT_MAX_HZ));
+        if (!s_mqtt.connected) {
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        bool health = s_mqtt.republish || now - lastHealth >= MQTT_HEALTH_S * 1000000LL;
+        publish(health);
+        if (health) {
+            lastHealth = now;
+        }
+    }
+}
+
+static void run_command(const std::string& name, int argument)
+{
+    int command;
+    if (name == "play") {
+        command = hal::HalBase::REMOTE_PLAY;
+    } else if (name == "stop") {
+        command = hal::HalBase::REMOTE_STOP;
+    } else if (name == "next") {
+        command = hal::HalBase::REMOTE_NEXT_STATION;
+    } else if (name == "previous") {
+        command = hal::HalBase::REMOTE_PREVIOUS_STATION;
+    } else if (name == "station" && argument >= 0) {
+        command = hal::HalBase::REMOTE_STATION;
+    } else if (name == "volume") {
+        command  = hal::HalBase::REMOTE_VOLUME;
+        argument = std::clamp(argument, 0, 100);
+    } else {
+        mclog::tagWarn(TAG, "unknown command: {}", name);
+        return;
+    }
+    hal_post_event(hal::HalBase::EVENT_REMOTE, command | argument << 8);
+}
+
+// In the client's task: the command is copied out and handed to a background worker
+static void on_command(esp_mqtt_event_handle_t event)
+{
+    std::string prefix = topic("set/");
+    std::string name(event->topic, event->topic_len);
+    if (name.compare(0, prefix.size(), prefix) != 0 || event->data_len > 16) {
+        return;
+    }
+    name = name.substr(prefix.size());
+    std::string data(event->data, event->data_len);
+    GetHAL()->runInBackground([name, data]() { run_command(name, atoi(data.c_str())); });
+}
+
+static void on_mqtt_event(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    auto event = (esp_mqtt_event_handle_t)data;
+    switch (id) {
+        case MQTT_EVENT_CONNECTED:
+            mclog::tagInfo(TAG, "connected to {}", CONFIG_TAB5_MQTT_BROKER_URL);
+            esp_mqtt_client_enqueue(s_mqtt.client, topic("status").c_str(), "online", 0, 1, 1, true);
+            esp_mqtt_client_subscribe(s_mqtt.client, topic("set/#").c_str(), 1);
+            s_mqtt.republish = true;
+            s_mqtt.connected = true;
+            xTaskNotifyGive(s_mqtt.task);
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            if (s_mqtt.connected.exchange(false)) {
+                mclog::tagWarn(TAG, "broker gone, retrying in the background");
+            }
+            break;
+        case MQTT_EVENT_DATA:
+            // A message split over several events is longer than any command
+            if (event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+                on_command(event);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void mqtt_start()
+{
+    if (s_mqtt.client) {
+        return;  // Reconnects on its own
+    }
+    static std::string willTopic    = topic("status");
+    esp_mqtt_client_config_t config = {};
+    config.broker.address.uri       = CONFIG_TAB5_MQTT_BROKER_URL;
+    config.session.keepalive        = MQTT_KEEPALIVE_S;
+    config.session.last_will.topic  = willTopic.c_str();
+    config.session.last_will.msg    = "offline";
+    config.session.last_will.qos    = 1;
+    config.session.last_will.retain = 1;
+    config.outbox.limit             = MQTT_OUTBOX_LIMIT;
+    config.task.priority            = task_topology::MQTT.priority;  // The core is CONFIG_MQTT_USE_CORE_0
+    config.task.stack_size          = task_topology::MQTT.stackSize;
+    // For mqtts://
+    config.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    s_mqtt.client                                = esp_mqtt_client_init(&config);
+    if (!s_mqtt.client) {
+        mclog::tagError(TAG, "failed to init the client");
+        return;
+    }
+    esp_mqtt_client_register_event(s_mqtt.client, MQTT_EVENT_ANY, on_mqtt_event, nullptr);
+    if (task_topology::create(task_topology::MQTT_PUBLISH, publish_task, nullptr, &s_mqtt.task) != pdPASS ||
+        esp_mqtt_client_start(s_mqtt.client) != ESP_OK) {
+        mclog::tagError(TAG, "failed to start");
+        return;
+    }
+    mclog::tagInfo(TAG, "publishing to {} under {}", CONFIG_TAB5_MQTT_BROKER_URL, CONFIG_TAB5_MQTT_TOPIC);
+}
+#endif
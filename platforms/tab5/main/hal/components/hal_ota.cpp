@@ -0,0 +1,258 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/ota_image/ota_image.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_crt_bundle.h>
+#include <esp_http_client.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <mbedtls/sha256.h>
+
+static const char* TAG = "ota";
+
+/* -------------------------------------------------------------------------- */
+/*                               Firmware Update                              */
+/* -------------------------------------------------------------------------- */
+// A task below everything the radio runs downloads the update and unpacks it (utils/ota_image) into the other slot,
+// 64 KB at a time: sequential writes erase as they go, so flash is never busy for long. While the radio plays each
+// piece is followed by a pause for the stream to catch up. The swap is otadata pointing at the new slot, the
+// bootloader goes back to the old one if the new firmware restarts before firmware_update_confirm()
+#define OTA_HTTP_CHUNK       4096
+#define OTA_HTTP_TIMEOUT_MS  15000
+#define OTA_PLAYING_YIELD_MS 40
+#define OTA_RESTART_DELAY_MS 1000
+#define OTA_BASE_CHUNK       4096
+
+static struct {
+    std::mutex mutex;
+    hal::HalBase::FirmwareUpdate_t status;
+    bool running = false;
+} s_ota;
+
+struct OtaJob_t {
+    std::string url;
+    bool restart;
+};
+
+static void set_state(hal::HalBase::FirmwareUpdateState_t state, const char* error = nullptr)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_ota.mutex);
+        s_ota.status.state = state;
+        if (error) {
+            s_ota.status.error = error;
+        }
+    }
+    if (error) {
+        mclog::tagError(TAG, "Update failed: {}", error);
+    }
+    hal_post_event(hal::HalBase::EVENT_FW_UPDATE, state);
+}
+
+// The first `size` bytes of the running firmware hash to what the delta update was made against
+static bool base_matches(const esp_partition_t* running, uint32_t size, const uint8_t* sha256)
+{
+    if (size > running->size) {
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> chunk(new (std::nothrow) uint8_t[OTA_BASE_CHUNK]);
+    if (!chunk) {
+        return false;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    bool ok = true;
+    for (uint32_t offset = 0; ok && offset < size; offset += OTA_BASE_CHUNK) {
+        uint32_t n = std::min<uint32_t>(OTA_BASE_CHUNK, size - offset);
+        ok         = esp_partition_read(running, offset, chunk.get(), n) == ESP_OK;
+        mbedtls_sha256_update(&sha, chunk.get(), n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    return ok && memcmp(digest, sha256, sizeof(digest)) == 0;
+}
+
+static const char* run_update(const std::string& url)
+{
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    const esp_partition_t* target  = esp_ota_get_next_update_partition(nullptr);
+    if (!running || !target) {
+        return "no OTA slot, the partition table predates them";
+    }
+
+    esp_http_client_config_t config = {};
+    config.url                      = url.c_str();
+    config.timeout_ms               = OTA_HTTP_TIMEOUT_MS;
+    config.buffer_size              = OTA_HTTP_CHUNK;
+    config.crt_bundle_attach        = esp_crt_bundle_attach;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    std::unique_ptr<uint8_t[]> chunk(new (std::nothrow) uint8_t[OTA_HTTP_CHUNK]);
+    if (!client || !chunk) {
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        return "no memory for the download";
+    }
+    esp_http_client_set_header(client, "User-Agent", "Tab5-WebRadio/1.0");
+
+    // Checked on the first dictionary a delta update asks for, a full update never reads the running firmware
+    const char* error = nullptr;
+    bool baseChecked  = false;
+    OtaImage image;
+    auto readBase = [&](uint32_t offset, uint8_t* dst, size_t len) {
+        if (!baseChecked) {
+            baseChecked = true;
+            if (!base_matches(running, image.header().baseSize, image.header().baseSha256)) {
+                error = "the delta update is for another firmware";
+            }
+        }
+        return !error && esp_partition_read(running, offset, dst, len) == ESP_OK;
+    };
+
+    esp_ota_handle_t ota = 0;
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    auto write = [&](const uint8_t* piece, size_t len) {
+        if (!ota && esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &ota) != ESP_OK) {
+            ota   = 0;
+            error = "can't start writing the slot";
+            return false;
+        }
+        mbedtls_sha256_update(&sha, piece, len);
+        if (esp_ota_write(ota, piece, len) != ESP_OK) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(s_ota.mutex);
+            s_ota.status.written = image.produced();
+        }
+        if (GetHAL()->getRadioState() == hal::HalBase::RADIO_PLAYING) {
+            vTaskDelay(pdMS_TO_TICKS(OTA_PLAYING_YIELD_MS));
+        }
+        return true;
+    };
+
+    if (!image.begin(readBase)) {
+        error = image.error();
+    } else if (esp_http_client_open(client, 0) != ESP_OK || esp_http_client_fetch_headers(client) < 0) {
+        error = "can't connect";
+    } else if (esp_http_client_get_status_code(client) != 200) {
+        mclog::tagWarn(TAG, "HTTP {} for {}", esp_http_client_get_status_code(client), url);
+        error = "the server refused the download";
+    } else {
+        mclog::tagInfo(TAG, "Downloading {} into {} at 0x{:x}", url, target->label, target->address);
+        uint32_t downloaded = 0;
+        int len;
+        while (!error && (len = esp_http_client_read(client, (char*)chunk.get(), OTA_HTTP_CHUNK)) > 0) {
+            downloaded += len;
+            if (!image.feed(chunk.get(), len, write)) {
+                error = error ? error : image.error();
+            }
+            std::lock_guard<std::mutex> lock(s_ota.mutex);
+            s_ota.status.downloaded = downloaded;
+            s_ota.status.imageSize  = image.header().imageSize;
+            s_ota.status.delta      = image.isDelta();
+        }
+        if (!error && !image.done()) {
+            error = "the download ended early";
+        }
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (error) {
+        if (ota) {
+            esp_ota_abort(ota);
+        }
+        return error;
+    }
+
+    set_state(hal::HalBase::FIRMWARE_UPDATE_VERIFYING);
+    if (memcmp(digest, image.header().imageSha256, sizeof(digest)) != 0) {
+        esp_ota_abort(ota);
+        return "the image doesn't match its hash";
+    }
+    // Checks the image's own header and digest before the slot counts as written
+    if (esp_ota_end(ota) != ESP_OK) {
+        return "the image doesn't verify";
+    }
+    if (esp_ota_set_boot_partition(target) != ESP_OK) {
+        return "can't switch slots";
+    }
+    mclog::tagInfo(TAG, "{} bytes in {}, boots next restart", image.produced(), target->label);
+    return nullptr;
+}
+
+static void ota_task(void* param)
+{
+    std::unique_ptr<OtaJob_t> job((OtaJob_t*)param);
+    const char* error = run_update(job->url);
+    set_state(error ? hal::HalBase::FIRMWARE_UPDATE_FAILED : hal::HalBase::FIRMWARE_UPDATE_READY, error);
+    mclog::tagInfo(TAG, "{} B stack left", task_topology::stack_headroom());
+    {
+        std::lock_guard<std::mutex> lock(s_ota.mutex);
+        s_ota.running = false;
+    }
+    if (!error && job->restart) {
+        vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY_MS));
+        esp_restart();
+    }
+    vTaskDelete(nullptr);
+}
+
+bool HalEsp32::startFirmwareUpdate(const std::string& url, bool restart)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_ota.mutex);
+        if (s_ota.running) {
+            return false;
+        }
+        s_ota.running = true;
+        s_ota.status  = {};
+    }
+    set_state(FIRMWARE_UPDATE_DOWNLOADING);
+    auto job = new OtaJob_t{url, restart};
+    if (task_topology::create(task_topology::FW_UPDATE, ota_task, job, nullptr) != pdPASS) {
+        delete job;
+        set_state(FIRMWARE_UPDATE_FAILED, "no task for the update");
+        std::lock_guard<std::mutex> lock(s_ota.mutex);
+        s_ota.running = false;
+        return false;
+    }
+    return true;
+}
+
+hal::HalBase::FirmwareUpdate_t HalEsp32::getFirmwareUpdate()
+{
+    std::lock_guard<std::mutex> lock(s_ota.mutex);
+    return s_ota.status;
+}
+
+void firmware_update_confirm()
+{
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        mclog::tagInfo(TAG, "New firmware in {} came up, keeping it", running->label);
+    }
+}
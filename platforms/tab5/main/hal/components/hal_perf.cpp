@@ -0,0 +1,336 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include <hal/metrics.h>
+#include <algorithm>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_lvgl_port.h>
+
+// Everything is sampled at most once a second, the HUD that shows it can ask every frame
+#define PERF_SAMPLE_MS 1000
+#define PERF_MAX_TASKS 40
+#define PERF_TOP_TASKS 6
+
+/* -------------------------------------------------------------------------- */
+/*                                LVGL timings                                */
+/* -------------------------------------------------------------------------- */
+// Written by the LVGL task in display events, read under the LVGL lock
+static struct {
+    int64_t refrStartUs  = 0;
+    int64_t flushStartUs = 0;
+    int64_t flushUs      = 0;  // Of the refresh in progress
+    bool rendered        = false;
+    uint32_t frames      = 0;  // Since the last sample
+    int64_t renderUsSum  = 0;
+    int64_t flushUsSum   = 0;
+    uint32_t areas       = 0;  // Invalidated since the last frame
+    uint32_t pixels      = 0;
+    uint64_t areasSum    = 0;  // Of the frames since the last sample
+    uint64_t pixelsSum   = 0;
+    int64_t touchAtUs    = 0;  // Oldest touch sample not on screen yet, 0 if none
+    uint32_t touches     = 0;  // Since the last sample
+    int64_t touchUsSum   = 0;
+    int64_t touchUsMax   = 0;
+
+    void (*onFrame)(const PerfFrame_t&) = nullptr;
+} s_lvgl;
+
+// The same frames for /metrics, where the scraper works out the rate
+static metrics::Counter s_metric_frames("ui_frames_total", "Frames LVGL rendered");
+static metrics::Histogram s_metric_render("ui_frame_ms", "Render and flush time per frame", {5, 10, 16, 33, 50, 100});
+
+static void on_display_event(lv_event_t* e)
+{
+    int64_t now = esp_timer_get_time();
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_INVALIDATE_AREA:
+            // Clipped to the screen, an area inside one already invalidated still counts
+            s_lvgl.areas++;
+            s_lvgl.pixels += lv_area_get_size((const lv_area_t*)lv_event_get_param(e));
+            break;
+        case LV_EVENT_REFR_START:
+            s_lvgl.refrStartUs = now;
+            s_lvgl.flushUs     = 0;
+            s_lvgl.rendered    = false;
+            break;
+        case LV_EVENT_RENDER_START:
+            s_lvgl.rendered = true;
+            break;
+        case LV_EVENT_FLUSH_START:
+            s_lvgl.flushStartUs = now;
+            break;
+        case LV_EVENT_FLUSH_FINISH:
+            s_lvgl.flushUs += now - s_lvgl.flushStartUs;
+            break;
+        case LV_EVENT_REFR_READY:
+            // A refresh with nothing invalidated isn't a frame
+            if (s_lvgl.rendered) {
+                s_lvgl.frames++;
+                s_lvgl.renderUsSum += now - s_lvgl.refrStartUs - s_lvgl.flushUs;
+                s_lvgl.flushUsSum += s_lvgl.flushUs;
+                s_lvgl.areasSum += s_lvgl.areas;
+                s_lvgl.pixelsSum += s_lvgl.pixels;
+                s_metric_frames.inc();
+                s_metric_render.observe((now - s_lvgl.refrStartUs) / 1000);
+                if (s_lvgl.onFrame) {
+                    PerfFrame_t frame;
+                    frame.renderUs = now - s_lvgl.refrStartUs - s_lvgl.flushUs;
+                    frame.flushUs  = s_lvgl.flushUs;
+                    frame.areas    = s_lvgl.areas;
+                    frame.pixels   = s_lvgl.pixels;
+                    s_lvgl.onFrame(frame);
+                }
+                // Flushed, so on the panel with its next scan out
+                if (s_lvgl.touchAtUs) {
+                    int64_t latency = now - s_lvgl.touchAtUs;
+                    s_lvgl.touches++;
+                    s_lvgl.touchUsSum += latency;
+                    s_lvgl.touchUsMax = std::max(s_lvgl.touchUsMax, latency);
+                    s_lvgl.touchAtUs  = 0;
+                }
+            }
+            s_lvgl.areas  = 0;
+            s_lvgl.pixels = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void perf_attach_display(lv_display_t* disp)
+{
+    lv_display_add_event_cb(disp, on_display_event, LV_EVENT_ALL, nullptr);
+}
+
+void perf_on_frame(void (*onFrame)(const PerfFrame_t&))
+{
+    // Set under the LVGL lock, the events are sent under it
+    s_lvgl.onFrame = onFrame;
+}
+
+void perf_touch_sampled(int64_t atUs)
+{
+    // Called from the indev read, in the LVGL task like the display events
+    if (!s_lvgl.touchAtUs) {
+        s_lvgl.touchAtUs = atUs;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  LVGL lock                                 */
+/* -------------------------------------------------------------------------- */
+// lvgl_port's lock is a recursive mutex, only the outermost take is timed. All of it is written and read under the
+// lock. The LVGL task's own takes aren't in here, its renders and flushes are above, and what they cost the others
+// shows in their waits
+#define LOCK_SITES hal::HalBase::LVGL_LOCK_SITE_COUNT
+static struct {
+    int depth                      = 0;
+    int site                       = 0;
+    int64_t takenUs                = 0;
+    uint32_t holds[LOCK_SITES]     = {};  // Since the last sample
+    int64_t heldUs[LOCK_SITES]     = {};
+    uint32_t maxWaitUs[LOCK_SITES] = {};
+    uint32_t maxHoldUs[LOCK_SITES] = {};
+} s_lock;
+
+static const char* s_lock_sites[LOCK_SITES] = {"other", "app update", "app open", "camera", "hal"};
+
+#define LOCK_US_BOUNDS {100, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000}
+static metrics::Histogram s_metric_lock_wait[LOCK_SITES] = {
+    {"ui_lock_wait_us", "Time waited for the LVGL lock", LOCK_US_BOUNDS, "site=\"other\""},
+    {"ui_lock_wait_us", "Time waited for the LVGL lock", LOCK_US_BOUNDS, "site=\"app_update\""},
+    {"ui_lock_wait_us", "Time waited for the LVGL lock", LOCK_US_BOUNDS, "site=\"app_open\""},
+    {"ui_lock_wait_us", "Time waited for the LVGL lock", LOCK_US_BOUNDS, "site=\"camera\""},
+    {"ui_lock_wait_us", "Time waited for the LVGL lock", LOCK_US_BOUNDS, "site=\"hal\""},
+};
+static metrics::Histogram s_metric_lock_hold[LOCK_SITES] = {
+    {"ui_lock_hold_us", "Time the LVGL lock was held", LOCK_US_BOUNDS, "site=\"other\""},
+    {"ui_lock_hold_us", "Time the LVGL lock was held", LOCK_US_BOUNDS, "site=\"app_update\""},
+    {"ui_lock_hold_us", "Time the LVGL lock was held", LOCK_US_BOUNDS, "site=\"app_open\""},
+    {"ui_lock_hold_us", "Time the LVGL lock was held", LOCK_US_BOUNDS, "site=\"camera\""},
+    {"ui_lock_hold_us", "Time the LVGL lock was held", LOCK_US_BOUNDS, "site=\"hal\""},
+};
+
+void lvgl_lock(hal::HalBase::LvglLockSite_t site)
+{
+    int64_t start = esp_timer_get_time();
+    lvgl_port_lock(0);
+    if (s_lock.depth++ > 0) {
+        return;  // Taken again by the task holding it, the outer take counts it all
+    }
+    int64_t now    = esp_timer_get_time();
+    uint32_t wait  = now - start;
+    s_lock.site    = site < hal::HalBase::LVGL_LOCK_SITE_COUNT ? site : hal::HalBase::LVGL_LOCK_OTHER;
+    s_lock.takenUs = now;
+
+    s_lock.maxWaitUs[s_lock.site] = std::max(s_lock.maxWaitUs[s_lock.site], wait);
+    s_metric_lock_wait[s_lock.site].observe(wait);
+}
+
+void lvgl_unlock()
+{
+    if (--s_lock.depth == 0) {
+        uint32_t held = esp_timer_get_time() - s_lock.takenUs;
+        s_lock.holds[s_lock.site]++;
+        s_lock.heldUs[s_lock.site] += held;
+        s_lock.maxHoldUs[s_lock.site] = std::max(s_lock.maxHoldUs[s_lock.site], held);
+        s_metric_lock_hold[s_lock.site].observe(held);
+    }
+    lvgl_port_unlock();
+}
+
+// Called under the lock
+static void sample_lock(float seconds, std::vector<hal::HalBase::PerfLock_t>& locks)
+{
+    locks.clear();
+    for (int i = 0; i < LOCK_SITES; i++) {
+        // The sample's own take is still held, it shows from the next sample on
+        if (s_lock.holds[i] > 0 && seconds > 0) {
+            hal::HalBase::PerfLock_t lock;
+            lock.site           = s_lock_sites[i];
+            lock.holdsPerSecond = s_lock.holds[i] / seconds;
+            lock.heldPercent    = s_lock.heldUs[i] / 10000.0f / seconds;
+            lock.waitMaxMs      = s_lock.maxWaitUs[i] / 1000.0f;
+            lock.holdMaxMs      = s_lock.maxHoldUs[i] / 1000.0f;
+            locks.push_back(lock);
+        }
+        s_lock.holds[i]     = 0;
+        s_lock.heldUs[i]    = 0;
+        s_lock.maxWaitUs[i] = 0;
+        s_lock.maxHoldUs[i] = 0;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  Task load                                 */
+/* -------------------------------------------------------------------------- */
+struct TaskRunTime_t {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runTime;
+};
+
+static std::vector<TaskRunTime_t> s_last_run_times;
+static configRUN_TIME_COUNTER_TYPE s_last_total_run_time = 0;
+
+static void sample_tasks(std::vector<hal::HalBase::PerfTask_t>& tasks)
+{
+    static TaskStatus_t status[PERF_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count                 = uxTaskGetSystemState(status, PERF_MAX_TASKS, &total);
+    configRUN_TIME_COUNTER_TYPE span  = total - s_last_total_run_time;
+
+    // CPU use is the run time a task got since the last sample, a task that's new counts from its start
+    std::vector<TaskRunTime_t> runTimes;
+    runTimes.reserve(count);
+    tasks.clear();
+    for (UBaseType_t i = 0; i < count; i++) {
+        configRUN_TIME_COUNTER_TYPE last = 0;
+        for (auto& prev : s_last_run_times) {
+            if (prev.handle == status[i].xHandle) {
+                last = prev.runTime;
+                break;
+            }
+        }
+        runTimes.push_back({status[i].xHandle, status[i].ulRunTimeCounter});
+
+        if (s_last_total_run_time == 0 || span == 0) {
+            continue;
+        }
+        hal::HalBase::PerfTask_t task;
+        task.name       = status[i].pcTaskName;
+        task.core       = status[i].xCoreID == tskNO_AFFINITY ? -1 : (int)status[i].xCoreID;
+        task.cpuPercent = 100.0f * (float)(status[i].ulRunTimeCounter - last) / (float)span;
+        tasks.push_back(task);
+    }
+    s_last_run_times      = std::move(runTimes);
+    s_last_total_run_time = total;
+
+    std::sort(tasks.begin(), tasks.end(), [](const auto& a, const auto& b) { return a.cpuPercent > b.cpuPercent; });
+    if (tasks.size() > PERF_TOP_TASKS) {
+        tasks.resize(PERF_TOP_TASKS);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                   Sample                                   */
+/* -------------------------------------------------------------------------- */
+static hal::HalBase::PerfStats_t s_stats;
+
+// Supply current per WiFi power profile, what a profile costs shows as the two averages drift apart
+static struct {
+    double sumMa   = 0;
+    uint32_t count = 0;
+} s_current[2];
+
+static uint32_t s_i2c_busy_us = 0;  // At the last sample
+
+bool HalEsp32::getPerfStats(PerfStats_t* stats)
+{
+    uint32_t now = millis();
+    if (s_stats.sampledAtMs == 0 || now - s_stats.sampledAtMs >= PERF_SAMPLE_MS) {
+        float seconds = s_stats.sampledAtMs == 0 ? 0 : (now - s_stats.sampledAtMs) / 1000.0f;
+
+        lvgl_lock(LVGL_LOCK_HAL);
+        uint32_t frames    = s_lvgl.frames;
+        int64_t renderUs   = s_lvgl.renderUsSum;
+        int64_t flushUs    = s_lvgl.flushUsSum;
+        uint64_t areas     = s_lvgl.areasSum;
+        uint64_t pixels    = s_lvgl.pixelsSum;
+        uint32_t touches   = s_lvgl.touches;
+        int64_t touchUs    = s_lvgl.touchUsSum;
+        int64_t touchMaxUs = s_lvgl.touchUsMax;
+        s_lvgl.frames      = 0;
+        s_lvgl.renderUsSum = 0;
+        s_lvgl.flushUsSum  = 0;
+        s_lvgl.areasSum    = 0;
+        s_lvgl.pixelsSum   = 0;
+        s_lvgl.touches     = 0;
+        s_lvgl.touchUsSum  = 0;
+        s_lvgl.touchUsMax  = 0;
+        sample_lock(seconds, s_stats.lvglLocks);
+        lvgl_unlock();
+
+        s_stats.fps      = seconds > 0 ? frames / seconds : 0;
+        s_stats.renderMs = frames ? renderUs / 1000.0f / frames : 0;
+        s_stats.flushMs  = frames ? flushUs / 1000.0f / frames : 0;
+
+        float screen = lv_display_get_horizontal_resolution(lvDisp) * lv_display_get_vertical_resolution(lvDisp);
+        s_stats.redrawAreas   = frames ? (float)areas / frames : 0;
+        s_stats.redrawPercent = frames ? 100.0f * pixels / frames / screen : 0;
+
+        s_stats.touchLatencyMs    = touches ? touchUs / 1000.0f / touches : 0;
+        s_stats.touchLatencyMaxMs = touchMaxUs / 1000.0f;
+
+        I2cArbiter::Stats_t i2c   = i2c_arbiter().stats(true);
+        s_stats.i2cBusyPercent    = seconds > 0 ? (i2c.busyUs - s_i2c_busy_us) / 10000.0f / seconds : 0;
+        s_stats.i2cTouchWaitMaxMs = i2c.maxWaitUs[I2cArbiter::TOUCH] / 1000.0f;
+        s_i2c_busy_us             = i2c.busyUs;
+
+        s_stats.bufferPercent = radio_buffer_level();
+        s_stats.underruns     = getRadioOutputStats().underruns;
+        s_stats.internalFree  = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        s_stats.internalMin   = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+        s_stats.psramFree     = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+        auto& current         = s_current[wifi_power_save() ? 1 : 0];
+        s_stats.wifiPowerSave = wifi_power_save();
+        PMData_t power;
+        s_stats.currentMa = power_monitor_latest(&power) ? power.shuntCurrent * 1000.0f : 0;
+        current.sumMa += s_stats.currentMa;
+        current.count++;
+        s_stats.currentAwakeMa  = s_current[0].count ? s_current[0].sumMa / s_current[0].count : 0;
+        s_stats.currentSavingMa = s_current[1].count ? s_current[1].sumMa / s_current[1].count : 0;
+        sample_tasks(s_stats.tasks);
+        s_stats.sampledAtMs = now ? now : 1;
+    }
+
+    *stats = s_stats;
+    return true;
+}
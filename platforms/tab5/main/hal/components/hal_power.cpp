@@ -4,7 +4,14 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <hal/metrics.h>
 #include <mooncake_log.h>
+#include <algorithm>
+#include <mutex>
+#include <cstddef>
+#include <string.h>
+#include <esp_timer.h>
 #include <driver/gpio.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -12,16 +19,164 @@
 #include <esp_sleep.h>
 #include <esp_check.h>
 #include <esp_pm.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_rom_crc.h>
 
 static const std::string _tag = "power";
 
+/* -------------------------------------------------------------------------- */
+/*                                Power monitor                               */
+/* -------------------------------------------------------------------------- */
+// The INA226 averages continuously over 64 conversions of each channel, 141 ms a result. A task picks every result up
+// as its conversion ready flag comes on into a ring, with the energy since the last one booked against what the board
+// was doing. The alert pin isn't brought out to the P4, so the flag is polled, at the pace the results come. The
+// power also goes into a history of seconds, minutes and hours, for charts longer than the ring
+#define POWER_CONVERSION_MS 141  // INA226_AVERAGES_64 x (1.1 ms bus + 1.1 ms shunt)
+#define POWER_POLL_MS       10   // Once a result is due, until its flag comes on
+#define POWER_RING_SAMPLES  64   // 9 s
+#define POWER_MAX_GAP_MS    1000 // A longer gap isn't integrated over, the board did something unknown meanwhile
+
+static struct {
+    std::mutex mutex;  // All below but the sensor
+    INA226* ina226 = nullptr;
+    hal::HalBase::PMData_t ring[POWER_RING_SAMPLES];
+    uint32_t written = 0;  // The newest is at (written - 1) % POWER_RING_SAMPLES
+    hal::HalBase::PowerEnergy_t energy[hal::HalBase::POWER_STATE_COUNT];
+    DecimationRing history;
+} s_power;
+
+static metrics::Gauge s_energy_streaming("power_energy_joules", "Energy drawn since boot", "state=\"streaming\"");
+static metrics::Gauge s_energy_idle("power_energy_joules", "Energy drawn since boot", "state=\"idle\"");
+static metrics::Gauge s_energy_screen_off("power_energy_joules", "Energy drawn since boot", "state=\"screen_off\"");
+static metrics::Gauge s_time_streaming("power_state_seconds", "Time spent since boot", "state=\"streaming\"");
+static metrics::Gauge s_time_idle("power_state_seconds", "Time spent since boot", "state=\"idle\"");
+static metrics::Gauge s_time_screen_off("power_state_seconds", "Time spent since boot", "state=\"screen_off\"");
+
+static metrics::Gauge* const s_energy_gauges[hal::HalBase::POWER_STATE_COUNT] = {
+    &s_energy_streaming, &s_energy_idle, &s_energy_screen_off};
+static metrics::Gauge* const s_time_gauges[hal::HalBase::POWER_STATE_COUNT] = {&s_time_streaming, &s_time_idle,
+                                                                               &s_time_screen_off};
+
+static hal::HalBase::PowerState_t power_state()
+{
+    if (GetHAL()->getDisplayBrightness() == 0 || GetHAL()->isDisplaySuspended()) {
+        return hal::HalBase::POWER_STATE_SCREEN_OFF;
+    }
+    if (GetHAL()->getRadioState() == hal::HalBase::RADIO_PLAYING) {
+        return hal::HalBase::POWER_STATE_STREAMING;
+    }
+    return hal::HalBase::POWER_STATE_IDLE;
+}
+
+// Every poll is its own turn on the bus, touch gets in between them
+static bool conversion_ready(INA226* ina226)
+{
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+    return ina226->getMaskEnable() & INA226_BIT_CVRF;
+}
+
+static void power_task(void* param)
+{
+    INA226* ina226   = s_power.ina226;
+    int64_t lastUs   = 0;
+    float lastWatts  = 0;
+    uint32_t samples = 0;
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(POWER_CONVERSION_MS - POWER_POLL_MS));
+        // Reading the mask/enable register clears the flag, a result is then read at most once
+        int polls = 0;
+        while (!conversion_ready(ina226) && ++polls < POWER_CONVERSION_MS / POWER_POLL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(POWER_POLL_MS));
+        }
+
+        // The three registers are separate transfers, but one turn on the bus
+        hal::HalBase::PMData_t sample;
+        {
+            I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+            sample.busVoltage = ina226->readBusVoltage();
+            hold.yield();
+            sample.shuntCurrent = ina226->readShuntCurrent();
+            hold.yield();
+            sample.shuntVoltage = ina226->readShuntVoltage();
+        }
+        sample.busPower = sample.busVoltage * sample.shuntCurrent;  // Signed, unlike the power register
+        int64_t now     = esp_timer_get_time();
+        auto state      = power_state();
+
+        std::lock_guard<std::mutex> lock(s_power.mutex);
+        s_power.ring[s_power.written % POWER_RING_SAMPLES] = sample;
+        s_power.written++;
+        s_power.history.add(sample.busPower, now / 1000);
+        // Trapezoids between results, booked against the state at the end of each
+        float seconds = (now - lastUs) / 1e6f;
+        if (lastUs > 0 && seconds < POWER_MAX_GAP_MS / 1000.0f) {
+            auto& energy = s_power.energy[state];
+            energy.joules += (lastWatts + sample.busPower) / 2 * seconds;
+            energy.seconds += seconds;
+            s_energy_gauges[state]->set(energy.joules);
+            s_time_gauges[state]->set(energy.seconds);
+        }
+        lastUs    = now;
+        lastWatts = sample.busPower;
+        if (++samples == 1) {
+            mclog::tagInfo(_tag, "Power monitor: first sample {:.2f} V {:.3f} A, {} B stack left", sample.busVoltage,
+                           sample.shuntCurrent, task_topology::stack_headroom());
+        }
+    }
+}
+
+void power_monitor_start(INA226* ina226)
+{
+    s_power.ina226 = ina226;
+    if (task_topology::create(task_topology::POWER, power_task, nullptr, nullptr) != pdPASS) {
+        mclog::tagError(_tag, "Power monitor: no task, the readings stay at zero");
+    }
+}
+
+bool power_monitor_latest(hal::HalBase::PMData_t* sample)
+{
+    std::lock_guard<std::mutex> lock(s_power.mutex);
+    if (s_power.written == 0) {
+        return false;
+    }
+    *sample = s_power.ring[(s_power.written - 1) % POWER_RING_SAMPLES];
+    return true;
+}
+
 void HalEsp32::updatePowerMonitorData()
 {
-    // mclog::tagInfo(_tag, "update power monitor");
-    powerMonitorData.busVoltage   = ina226.readBusVoltage();
-    powerMonitorData.shuntVoltage = ina226.readShuntVoltage();
-    powerMonitorData.busPower     = ina226.readBusPower();
-    powerMonitorData.shuntCurrent = ina226.readShuntCurrent();
+    power_monitor_latest(&powerMonitorData);
+}
+
+int HalEsp32::getPowerMonitorWindow(PMData_t* samples, int count)
+{
+    std::lock_guard<std::mutex> lock(s_power.mutex);
+    int n = (int)std::min<uint32_t>(std::max(count, 0), std::min<uint32_t>(s_power.written, POWER_RING_SAMPLES));
+    uint32_t first = s_power.written - n;
+    for (int i = 0; i < n; i++) {
+        samples[i] = s_power.ring[(first + i) % POWER_RING_SAMPLES];
+    }
+    return n;
+}
+
+int HalEsp32::getPowerHistory(DecimationRing::Tier_t tier, DecimationRing::Point_t* points, int count)
+{
+    if (tier < 0 || tier >= DecimationRing::TIER_COUNT) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(s_power.mutex);
+    return s_power.history.read(tier, points, count);
+}
+
+bool HalEsp32::getPowerEnergy(PowerState_t state, PowerEnergy_t* energy)
+{
+    if (state < 0 || state >= POWER_STATE_COUNT) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s_power.mutex);
+    *energy = s_power.energy[state];
+    return true;
 }
 
 void HalEsp32::setChargeQcEnable(bool enable)
@@ -65,6 +220,7 @@ void HalEsp32::setExt5vEnable(bool enable)
     _ext_5v_enable = enable;
     mclog::tagInfo(_tag, "set ext 5v enable: {}", _ext_5v_enable);
     bsp_set_ext_5v_en(_ext_5v_enable);
+    i2c_scan_port_a_power_changed();
 }
 
 bool HalEsp32::getExt5vEnable()
@@ -96,7 +252,7 @@ void HalEsp32::sleepAndTouchWakeup()
 {
     mclog::tagInfo(_tag, "sleep and touch wakeup");
 
-    lvglLock();
+    lvglLockAt(LVGL_LOCK_HAL);
     auto brightness = getDisplayBrightness();
     setDisplayBrightness(0);
 
@@ -161,3 +317,142 @@ void HalEsp32::sleepAndRtcWakeup()
         delay(100);
     }
 }
+
+void HalEsp32::sleepAndAlarmWakeup(int hour, int minute)
+{
+    mclog::tagInfo(_tag, "sleep until the rtc alarm at {:02d}:{:02d}", hour, minute);
+
+    clearRtcIrq();
+    clearImuIrq();
+
+    struct tm time = {};
+    time.tm_hour   = hour;
+    time.tm_min    = minute;
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        rx8130.setAlarmIrq(&time);
+    }
+
+    powerOff();
+    while (1) {
+        delay(100);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Warm restart                                */
+/* -------------------------------------------------------------------------- */
+// RTC memory isn't cleared by a software reset, only by a power cycle or a deep sleep. What the radio was playing is
+// kept there with a checksum, a boot after a crash, a watchdog or esp_restart() that finds it intact resumes it. The
+// restarts are counted until a boot has been up for WARM_STABLE_MS, a board that keeps falling over boots cold
+#define WARM_MAGIC        0x57524D31  // "WRM1"
+#define WARM_MAX_RESTARTS 3
+#define WARM_STABLE_MS    60000
+
+// Plain fields without initializers, nothing clears it at startup
+struct WarmRecord_t {
+    uint32_t magic;
+    uint32_t restarts;  // Warm boots in a row that didn't last WARM_STABLE_MS
+    bool playing;
+    char url[sizeof(hal::HalBase::WarmRestart_t::url)];
+    uint8_t volume;
+    uint32_t crc;  // Over all of the above
+};
+static RTC_NOINIT_ATTR WarmRecord_t s_warm_record;
+static std::mutex s_warm_mutex;
+static hal::HalBase::WarmRestart_t s_warm_boot;  // What the last boot left, for getWarmRestart()
+static bool s_warm                     = false;
+static esp_timer_handle_t s_warm_timer = nullptr;
+
+static uint32_t warm_crc()
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)&s_warm_record, offsetof(WarmRecord_t, crc));
+}
+
+static void warm_store_locked()
+{
+    s_warm_record.magic = WARM_MAGIC;
+    s_warm_record.crc   = warm_crc();
+}
+
+static bool warm_reset_reason()
+{
+    switch (esp_reset_reason()) {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void HalEsp32::warm_restart_init()
+{
+    std::lock_guard<std::mutex> lock(s_warm_mutex);
+    bool intact = s_warm_record.magic == WARM_MAGIC && s_warm_record.crc == warm_crc();
+    if (!intact || !warm_reset_reason()) {
+        memset(&s_warm_record, 0, sizeof(s_warm_record));
+    } else if (s_warm_record.restarts >= WARM_MAX_RESTARTS) {
+        mclog::tagWarn(_tag, "{} warm restarts in a row, booting cold", s_warm_record.restarts);
+        memset(&s_warm_record, 0, sizeof(s_warm_record));
+    } else {
+        s_warm              = true;
+        s_warm_boot.playing = s_warm_record.playing;
+        s_warm_boot.volume  = s_warm_record.volume;
+        memcpy(s_warm_boot.url, s_warm_record.url, sizeof(s_warm_boot.url));
+        s_warm_boot.url[sizeof(s_warm_boot.url) - 1] = '\0';
+        s_warm_record.restarts++;
+        mclog::tagInfo(_tag, "warm restart ({}), {}", (int)esp_reset_reason(),
+                       s_warm_boot.playing ? s_warm_boot.url : "nothing was playing");
+    }
+    s_warm_record.playing = false;  // Until the radio starts again
+    warm_store_locked();
+
+    if (s_warm) {
+        // Up long enough, the next reset isn't part of a loop
+        esp_timer_create_args_t args = {};
+        args.callback                = [](void*) {
+            std::lock_guard<std::mutex> lock(s_warm_mutex);
+            s_warm_record.restarts = 0;
+            warm_store_locked();
+        };
+        args.name = "warm_stable";
+        if (esp_timer_create(&args, &s_warm_timer) == ESP_OK) {
+            esp_timer_start_once(s_warm_timer, WARM_STABLE_MS * 1000);
+        }
+    }
+}
+
+bool HalEsp32::getWarmRestart(WarmRestart_t* state)
+{
+    if (s_warm && state) {
+        *state = s_warm_boot;
+    }
+    return s_warm;
+}
+
+void warm_restart_playing(const char* url, uint8_t volume)
+{
+    std::lock_guard<std::mutex> lock(s_warm_mutex);
+    s_warm_record.playing = true;
+    s_warm_record.volume  = volume;
+    snprintf(s_warm_record.url, sizeof(s_warm_record.url), "%s", url);
+    warm_store_locked();
+}
+
+void warm_restart_volume(uint8_t volume)
+{
+    std::lock_guard<std::mutex> lock(s_warm_mutex);
+    s_warm_record.volume = volume;
+    warm_store_locked();
+}
+
+void warm_restart_stopped()
+{
+    std::lock_guard<std::mutex> lock(s_warm_mutex);
+    s_warm_record.playing = false;
+    warm_store_locked();
+}
@@ -4,768 +4,6353 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include <hal/hot_log.h>
+#include <hal/hot_path.h>
+#include <hal/metrics.h>
+#include <hal/snapshot.h>
+#include <stream/ring_buffer.h>
+#include <stream/icy_demuxer.h>
+#include <stream/stream_frame.h>
+#include <stream/hls_playlist.h>
+#include <stream/ts_demuxer.h>
+#include <stream/packet_demuxer.h>
+#include <stream/station_playlist.h>
+#include <stream/spectrum_analyzer.h>
+#include <stream/onset_detector.h>
+#include <stream/triple_buffer.h>
+#include <stream/waveform_decimator.h>
+#include <stream/pcm_dsp.h>
+#include <stream/resampler.h>
+#include <stream/clock_drift.h>
+#include <stream/seek_index.h>
+#include <stream/media_tags.h>
+#include <stream/stream_trace.h>
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/joinable_task/joinable_task.h"
+#include "../utils/title_history/title_history.h"
+#include "../utils/sd_writer/sd_writer.h"
 #include <mooncake_log.h>
 #include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <deque>
+#include <vector>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <esp_crt_bundle.h>
 #include <esp_http_client.h>
+#include <esp_http_server.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <nvs.h>
+#include <time.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <bsp/m5stack_tab5.h>
-#include <audio_player.h>
+#include <mp3dec.h>
+#include <esp_aac_dec.h>
+#include <esp_opus_dec.h>
+#include <esp_flac_dec.h>
 #include <cmath>
+#include <new>
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <mbedtls/base64.h>
 
 static const char* TAG = "radio";
 
 /* -------------------------------------------------------------------------- */
 /*                              Ring Buffer                                   */
 /* -------------------------------------------------------------------------- */
-// 128kbps MP3 = 16KB/sec, so:
-// - 256KB buffer = ~16 seconds of audio
-// - 64KB prebuffer = ~4 seconds before playback starts
+// 128kbps MP3 = 16KB/sec (the real bitrate is probed from the first frames), so:
+// - 4MB buffer = ~4 minutes of audio, 1MB of it kept as time-shift history behind the play position
+// - the prebuffer is sized from the measured throughput, from a few KB on a good LAN up to ~12 seconds
 // Larger buffers help with network jitter and WiFi instability
-#define RING_BUFFER_SIZE     (256 * 1024)  // 256KB ring buffer (in PSRAM)
-#define PREBUFFER_SIZE       (64 * 1024)   // 64KB prebuffer before playback
-#define MIN_BUFFER_LEVEL     (8 * 1024)    // 8KB minimum before rebuffering
-#define SPECTRUM_BANDS       32
-
-struct RingBuffer {
-    uint8_t* buffer      = nullptr;
-    size_t size          = 0;
-    size_t writePos      = 0;
-    size_t readPos       = 0;
-    size_t dataAvailable = 0;
-    SemaphoreHandle_t mutex;
-
-    bool init(size_t bufferSize)
-    {
-        buffer = (uint8_t*)heap_caps_malloc(bufferSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (!buffer) {
-            buffer = (uint8_t*)malloc(bufferSize);
-        }
-        if (!buffer) {
-            return false;
-        }
-        size  = bufferSize;
-        mutex = xSemaphoreCreateMutex();
-        return mutex != nullptr;
-    }
+// The ring is lock-free SPSC: the HTTP task is the only producer, the decoder the only consumer
+// The HTTP task stops reading the socket when the ring is full, so the size sets the latency budget, not a burst limit.
+// While paused it keeps receiving until the non-history part is full, ~3 minutes at 128kbps
+#define RING_BUFFER_SIZE     (4 * 1024 * 1024)  // 4MB ring buffer (in PSRAM)
+#define TIMESHIFT_HISTORY    (1024 * 1024)      // Already-played audio kept for skipping back, ~60s at 128kbps
+#define RING_READ_WINDOW     (32 * 1024)        // Internal SRAM copy the decoder reads from, a FLAC frame fits
+#define PREBUFFER_MAX_SIZE   (192 * 1024)  // Most we'll prebuffer, used until throughput has been measured
+#define MIN_BUFFER_LEVEL     (8 * 1024)    // 8KB minimum before (re)starting playback
+#define MAX_BUFFER_LEVEL     (96 * 1024)   // Cap for the watermark raised by underruns
+#define MAX_STALL_SECONDS    30            // Give up on a live stream after 30s without data
+// With WiFi power save on, a full ring is left to drain this far before the socket is read again, so the data comes
+// in bursts with the modem asleep in between. ~16s at 128kbps, well inside what Icecast queues for a slow client
+#define BURST_REFILL_BYTES   (256 * 1024)
 
-    void deinit()
-    {
-        if (buffer) {
-            free(buffer);
-            buffer = nullptr;
-        }
-        if (mutex) {
-            vSemaphoreDelete(mutex);
-            mutex = nullptr;
-        }
-    }
+// A warm (zap) connection only keeps the newest ~2 seconds, so switching to it plays live audio straight away
+#define ZAP_BUFFER_SIZE      (32 * 1024)
 
-    void reset()
-    {
-        if (xSemaphoreTake(mutex, portMAX_DELAY)) {
-            writePos      = 0;
-            readPos       = 0;
-            dataAvailable = 0;
-            xSemaphoreGive(mutex);
-        }
-    }
+// Adaptive prebuffer: playback starts once the buffer covers the next PREBUFFER_HORIZON_S seconds even if the
+// inbound rate drops UNDERRUN_DEVIATIONS mean deviations below its average (~2% chance for 2)
+#define THROUGHPUT_WINDOW_MS   200
+#define PREBUFFER_MIN_SAMPLES  2    // Windows measured before trusting the estimate
+#define PREBUFFER_HORIZON_S    10
+#define UNDERRUN_DEVIATIONS    2
+#define DEFAULT_BITRATE_KBPS   128  // Until the stream's frames or icy-br tell us better
 
-    size_t write(const uint8_t* data, size_t len)
-    {
-        if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(100))) {
-            return 0;
-        }
+// Most a stop waits for each task once asked to end, both wake from their ring waits right away. One that takes
+// longer is left to finish by itself: deleting a task inside lwip or the decoder would leak or crash
+#define DECODE_JOIN_MS 2000
+#define HTTP_JOIN_MS   5000  // A connect or read already under way has to time out first
+
+// Buffers that are freed and taken again with every stream come from the pools reserved at boot (hal_memory.cpp)
+static MemoryArena& stream_pool()
+{
+    return memory_pool(hal::HalBase::MEMORY_STREAM);
+}
 
-        size_t freeSpace = size - dataAvailable;
-        size_t toWrite   = (len < freeSpace) ? len : freeSpace;
+static MemoryArena& internal_pool()
+{
+    return memory_pool(hal::HalBase::MEMORY_INTERNAL);
+}
 
-        for (size_t i = 0; i < toWrite; i++) {
-            buffer[writePos] = data[i];
-            writePos         = (writePos + 1) % size;
-        }
-        dataAvailable += toWrite;
+/* -------------------------------------------------------------------------- */
+/*                           Throughput Estimate                              */
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Inbound rate estimate, fed by the HTTP task and read by the decoder
+ *
+ * Bytes are counted over THROUGHPUT_WINDOW_MS windows, each window's rate is smoothed like TCP's RTT estimator: an
+ * EWMA of the rate (1/8 gain) and of its mean deviation (1/4 gain).
+ */
+struct ThroughputEstimator {
+    uint32_t windowStart = 0;
+    uint32_t windowBytes = 0;
+    std::atomic<uint32_t> rate{0};       // Bytes/s
+    std::atomic<uint32_t> deviation{0};  // Bytes/s
+    std::atomic<uint32_t> samples{0};
+    std::atomic<uint32_t> lastSample{0};  // ms
+    std::atomic<uint32_t> firstByte{0};   // ms
+    // Highest the smoothed rate got, the server's burst on connect shows what the link can do. A live stream
+    // arrives at its bitrate once that's in, whatever the link could carry
+    std::atomic<uint32_t> peak{0};
 
-        xSemaphoreGive(mutex);
-        return toWrite;
+    void reset()
+    {
+        windowStart = 0;
+        windowBytes = 0;
+        rate.store(0);
+        deviation.store(0);
+        samples.store(0);
+        lastSample.store(0);
+        firstByte.store(0);
+        peak.store(0);
     }
 
-    size_t read(uint8_t* data, size_t len)
+    void addBytes(uint32_t now, size_t bytes)
     {
-        if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(100))) {
-            return 0;
+        if (windowStart == 0) {
+            windowStart = now;
+            firstByte.store(now);
         }
-
-        size_t toRead = (len < dataAvailable) ? len : dataAvailable;
-
-        for (size_t i = 0; i < toRead; i++) {
-            data[i]  = buffer[readPos];
-            readPos  = (readPos + 1) % size;
+        windowBytes += bytes;
+        uint32_t elapsed = now - windowStart;
+        if (elapsed < THROUGHPUT_WINDOW_MS) {
+            return;
         }
-        dataAvailable -= toRead;
 
-        xSemaphoreGive(mutex);
-        return toRead;
-    }
+        int32_t sample = (int32_t)((uint64_t)windowBytes * 1000 / elapsed);
+        windowStart    = now;
+        windowBytes    = 0;
 
-    size_t available()
-    {
-        if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(100))) {
-            return 0;
+        if (samples.load() == 0) {
+            rate.store(sample);
+            deviation.store(sample / 2);
+        } else {
+            int32_t mean = rate.load();
+            int32_t dev  = deviation.load();
+            int32_t err  = sample - mean;
+            rate.store(mean + err / 8);
+            deviation.store(dev + ((err < 0 ? -err : err) - dev) / 4);
         }
-        size_t avail = dataAvailable;
-        xSemaphoreGive(mutex);
-        return avail;
-    }
-
-    int bufferPercent()
-    {
-        return (available() * 100) / size;
+        if (rate.load() > peak.load()) {
+            peak.store(rate.load());
+        }
+        lastSample.store(now);
+        samples.fetch_add(1);
     }
 };
 
 /* -------------------------------------------------------------------------- */
 /*                           Radio Stream State                               */
 /* -------------------------------------------------------------------------- */
+/**
+ * @brief A track's loudness from its tags, from the ring position it starts at. `version` goes up with each track
+ */
+struct TrackGain_t {
+    uint32_t version = 0;
+    size_t at        = 0;
+    bool known       = false;
+    float gainDb     = 0;
+};
+
+/**
+ * @brief The last titles a stream changed to, with the ring position each started at, to name what a save from the
+ * history writes
+ */
+#define TITLE_MARKS 8  // A minute of history rarely holds more than two
+struct TitleMarks_t {
+    struct Mark_t {
+        size_t at       = 0;
+        char title[128] = {0};
+    };
+    uint32_t count = 0;  // Since the ring was reset, the newest is marks[(count - 1) % TITLE_MARKS]
+    Mark_t marks[TITLE_MARKS];
+};
+
+/**
+ * @brief One HTTP stream feeding one ring buffer
+ *
+ * There are two of these: the active connection the decoder reads from, and a spare that can be opened "warm" on
+ * the next station so a station change only has to swap which ring the decoder reads.
+ */
+struct StreamConnection {
+    std::string url;
+    volatile StreamCodec_t codec = CODEC_MP3;  // From Content-Type, set before any audio is written
+    volatile bool playlist       = false;      // Content-Type says the URL is an HLS playlist
+    volatile bool packetized     = false;      // Content-Type says Ogg or FLAC, the demuxer sets the codec
+    hal::HalBase::RadioMetadata_t meta;  // Written by the HTTP task only (the decoder for SD card files), published
+                                         // through `metadata`
+    Snapshot<hal::HalBase::RadioMetadata_t> metadata;
+    volatile bool warm = false;          // Trim to ZAP_BUFFER_SIZE, nobody is consuming yet
+    bool draining      = false;          // Ring was full in power save, waiting for BURST_REFILL_BYTES of room
+    bool resync        = false;          // Reconnected mid-stream, drop audio up to the next frame header
+    std::atomic<bool> reconnect{false};  // The supervisor found the socket stalled, drop it and connect again
+    JoinableTask task;                   // cancel() stops it
+    uint32_t id              = 0;  // Incremented each open, used to ignore stale HTTP tasks
+    IcyDemuxer icy;  // Splits the body into audio for the ring and metadata blocks
+    TsDemuxer ts;    // HLS segments in MPEG-TS
+    PacketDemuxer packets;  // Ogg pages and native FLAC into framed packets
+    RingBuffer ringBuffer;
+    ThroughputEstimator throughput;
+    std::atomic<int> relayReaders{0};  // LAN relay listeners with a cursor on the ring
+    bool local = false;                // Fed from SD card files instead of HTTP
+    std::atomic<bool> ended{false};    // The files are all read, running dry is the end rather than an underrun
+    uint32_t urlHash       = 0;        // sync_url_hash(url), what a sync master beacons and its relay checks
+    volatile bool following = false;   // Streaming from a sync master's relay (hal_sync.cpp)
+    // The latest track's, written by the HTTP task (the decoder for SD card files). One that starts before the
+    // decoder got to the last is folded into it, that only happens with tracks shorter than the ring
+    Snapshot<TrackGain_t> trackGain;
+    Snapshot<TitleMarks_t> titleMarks;  // Written with `meta`
+
+    // On demand: a file with a length and byte ranges, see On-Demand Transport. The current range's first byte
+    // went into the ring at `rangeStart`, its file offset is `rangeOffset`
+    volatile bool onDemand     = false;
+    volatile bool acceptRanges = false;  // From the response headers, with `fileSize` from Content-Range
+    uint32_t fileSize          = 0;
+    std::atomic<size_t> rangeStart{0};
+    std::atomic<uint32_t> rangeOffset{0};
+    std::atomic<int64_t> seekTo{-1};  // File offset the decoder wants the body from, cleared once the range is in
+};
+
 struct RadioStreamState {
     SemaphoreHandle_t mutex = nullptr;
     hal::HalBase::RadioState_t state = hal::HalBase::RADIO_STOPPED;
-    std::string currentUrl;
-    std::string streamTitle;
-    int icyMetaInt           = 0;
-    int bytesUntilMeta       = 0;
-    bool stopRequested       = false;
-    TaskHandle_t httpTask    = nullptr;
-    TaskHandle_t audioTask   = nullptr;
-    RingBuffer ringBuffer;
-    uint8_t spectrum[SPECTRUM_BANDS] = {0};
-    HalEsp32* hal                    = nullptr;
-    uint32_t streamId        = 0;  // Incremented each stream, used to ignore old HTTP tasks
+    bool stopRequested       = false;  // Stops the decoder
+    volatile bool paused     = false;  // Time-shift: the decoder holds its read position
+    std::atomic<int> skipSeconds{0};   // Requested jump, applied by the decoder since it owns the read position
+    std::atomic<int> seekSeconds{-1};  // Requested position in an on-demand stream, the same way
+    JoinableTask audioTask;
+    StreamConnection connections[2];
+    StreamConnection* active = &connections[0];
+    StreamConnection* spare  = &connections[1];
 };
 
 static RadioStreamState s_radio;
 
-/* -------------------------------------------------------------------------- */
-/*                           ICY Metadata Parsing                             */
-/* -------------------------------------------------------------------------- */
-static void parse_icy_metadata(const char* metadata, size_t len)
+// Connection the decoder should move to, picked up by the decoder itself so a ring's single consumer never changes
+// underneath a read
+static std::atomic<StreamConnection*> s_pending_conn{nullptr};
+static std::atomic<bool> s_pending_fresh{false};  // Just opened rather than warm, it has to prebuffer first
+
+// The same station at another bitrate, taken by the decoder once the connection it reads from is played out (see
+// Adaptive Bitrate). The first `s_splice_skip` bytes of its ring are older than where the other one ended
+static std::atomic<StreamConnection*> s_splice_conn{nullptr};
+static std::atomic<size_t> s_splice_skip{0};
+
+// With s_radio.mutex held. Subscribers hear of a change, not of every write
+static void set_radio_state(hal::HalBase::RadioState_t state)
 {
-    // Format: StreamTitle='Artist - Track';StreamUrl='...';
-    const char* titleStart = strstr(metadata, "StreamTitle='");
-    if (titleStart) {
-        titleStart += 13;  // Skip "StreamTitle='"
-        const char* titleEnd = strchr(titleStart, '\'');
-        if (titleEnd && titleEnd > titleStart) {
-            size_t titleLen = titleEnd - titleStart;
-            if (titleLen > 0 && titleLen < 256) {
-                if (xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(100))) {
-                    s_radio.streamTitle = std::string(titleStart, titleLen);
-                    if (s_radio.hal) {
-                        s_radio.hal->radioMetadata.title = s_radio.streamTitle;
-                    }
-                    xSemaphoreGive(s_radio.mutex);
-                    mclog::tagInfo(TAG, "Now playing: {}", s_radio.streamTitle);
-                }
-            }
-        }
+    if (state != s_radio.state) {
+        s_radio.state = state;
+        hal_post_event(hal::HalBase::EVENT_RADIO_STATE, state);
     }
 }
 
 /* -------------------------------------------------------------------------- */
-/*                           HTTP Event Handler                               */
+/*                              Stream Recorder                               */
 /* -------------------------------------------------------------------------- */
-// Stream ID for current HTTP task - used to ignore data from stale tasks
-static uint32_t s_http_task_stream_id = 0;
+// A low priority task follows the active ring with a lagging cursor and reads the demuxed audio straight into an
+// SdWriter, which puts it on the SD card in whole blocks. The cursor never holds the HTTP task back, so it rides out
+// SD write latency spikes (card housekeeping can stall a write for hundreds of ms) on the decoder's backlog and
+// time-shift history. Falling behind even that loses audio in the recording, never in the playback.
+#define RECORD_DIR         SDCARD_MOUNT_POINT "/radio"
+#define RECORD_NAME_MAX    64           // Title characters kept in a file name
+#define RECORD_DRAIN_MS    3000         // Most a station change waits for queued audio to reach the card
+#define RECORD_JOIN_MS     2000         // Then for the block already being written, once it's given up on
 
-static esp_err_t http_event_handler(esp_http_client_event_t* evt)
-{
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_HEADER:
-            // Check for ICY metadata interval
-            if (strcasecmp(evt->header_key, "icy-metaint") == 0) {
-                s_radio.icyMetaInt     = atoi(evt->header_value);
-                s_radio.bytesUntilMeta = s_radio.icyMetaInt;
-                mclog::tagInfo(TAG, "ICY metadata interval: {}", s_radio.icyMetaInt);
-            } else if (strcasecmp(evt->header_key, "icy-name") == 0) {
-                if (xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(100))) {
-                    if (s_radio.hal) {
-                        s_radio.hal->radioMetadata.station = evt->header_value;
-                    }
-                    xSemaphoreGive(s_radio.mutex);
-                    mclog::tagInfo(TAG, "Station: {}", evt->header_value);
-                }
-            } else if (strcasecmp(evt->header_key, "icy-br") == 0) {
-                if (xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(100))) {
-                    if (s_radio.hal) {
-                        s_radio.hal->radioMetadata.bitrate = atoi(evt->header_value);
-                    }
-                    xSemaphoreGive(s_radio.mutex);
-                }
-            }
-            break;
+/**
+ * @brief Where the stream changes track, as a ring write position
+ */
+struct RecordSplit_t {
+    uint32_t seq    = 0;
+    uint64_t offset = 0;
+    char title[RECORD_NAME_MAX + 1] = {0};
+};
 
-        case HTTP_EVENT_ON_DATA:
-            if (s_radio.stopRequested) {
-                return ESP_FAIL;  // Stop the HTTP request
-            }
-
-            // Check if this HTTP task is still the current one
-            // If a new stream started, ignore data from old tasks
-            if (s_http_task_stream_id != s_radio.streamId) {
-                return ESP_FAIL;  // Stale task, stop it
-            }
-
-            // Handle ICY metadata if present
-            if (s_radio.icyMetaInt > 0) {
-                uint8_t* data     = (uint8_t*)evt->data;
-                int dataLen       = evt->data_len;
-                int dataPos       = 0;
-
-                while (dataPos < dataLen && s_http_task_stream_id == s_radio.streamId) {
-                    if (s_radio.bytesUntilMeta > 0) {
-                        // Write audio data
-                        int audioBytes = (dataLen - dataPos < s_radio.bytesUntilMeta)
-                                             ? (dataLen - dataPos)
-                                             : s_radio.bytesUntilMeta;
-                        size_t written = s_radio.ringBuffer.write(data + dataPos, audioBytes);
-                        if (written < (size_t)audioBytes) {
-                            // Buffer full - this shouldn't happen with our large buffer
-                            static uint32_t lastFullLog = 0;
-                            uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                            if ((now - lastFullLog) > 1000) {
-                                mclog::tagWarn(TAG, "Ring buffer full! Dropping {} bytes", audioBytes - written);
-                                lastFullLog = now;
-                            }
-                        }
-                        dataPos += audioBytes;
-                        s_radio.bytesUntilMeta -= audioBytes;
-                    } else {
-                        // Read metadata length byte
-                        int metaLen = data[dataPos++] * 16;
-                        if (metaLen > 0) {
-                            if (dataPos + metaLen <= dataLen) {
-                                // Full metadata in this chunk
-                                parse_icy_metadata((char*)(data + dataPos), metaLen);
-                                dataPos += metaLen;
-                            } else {
-                                // Metadata spans chunks - skip it (rare edge case)
-                                // Just skip the bytes we have and reset counter
-                                int skipBytes = dataLen - dataPos;
-                                dataPos = dataLen;
-                                mclog::tagWarn(TAG, "ICY metadata spans chunks, skipping ({} bytes)", metaLen);
-                            }
-                        }
-                        s_radio.bytesUntilMeta = s_radio.icyMetaInt;
-                    }
-                }
-            } else {
-                // No ICY metadata, write directly
-                size_t written = s_radio.ringBuffer.write((uint8_t*)evt->data, evt->data_len);
-                if (written < (size_t)evt->data_len) {
-                    static uint32_t lastFullLog = 0;
-                    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                    if ((now - lastFullLog) > 1000) {
-                        mclog::tagWarn(TAG, "Ring buffer full! Dropping {} bytes", evt->data_len - written);
-                        lastFullLog = now;
-                    }
-                }
-            }
+struct StreamRecorder {
+    std::atomic<StreamConnection*> conn{nullptr};  // Connection being recorded, nullptr once stopping
+    JoinableTask task;
+    int cursor    = -1;  // On conn's ring
+    size_t stopAt = 0;   // Write position the recording ends at once conn is cleared
+    Snapshot<RecordSplit_t> split;
+    const char* extension = ".mp3";
+};
 
-            // Update buffer percentage
-            if (xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(10))) {
-                if (s_radio.hal) {
-                    s_radio.hal->radioMetadata.bufferPercent = s_radio.ringBuffer.bufferPercent();
-                }
-                xSemaphoreGive(s_radio.mutex);
-            }
-            break;
+static StreamRecorder s_recorder;
 
-        default:
-            break;
+/**
+ * @brief Start a new file at the current write position, called when the ICY title changes
+ */
+static void record_split(StreamConnection* conn, const char* title)
+{
+    if (s_recorder.conn.load(std::memory_order_acquire) != conn) {
+        return;
     }
-    return ESP_OK;
+    RecordSplit_t split = s_recorder.split.load();
+    split.seq++;
+    split.offset = conn->ringBuffer.writePosition();
+    snprintf(split.title, sizeof(split.title), "%s", title);
+    s_recorder.split.store(split);
 }
 
-/* -------------------------------------------------------------------------- */
-/*                           HTTP Streaming Task                              */
-/* -------------------------------------------------------------------------- */
-static void http_stream_task(void* param)
+/**
+ * @brief Open the next numbered file in RECORD_DIR, named after `title` where the card allows it
+ */
+static bool open_record_file(SdWriter* writer, const char* title, const char* extension)
 {
-    // Capture the stream ID for this task - used to ignore data from stale tasks
-    uint32_t myStreamId = s_radio.streamId;
-    s_http_task_stream_id = myStreamId;
-    mclog::tagInfo(TAG, "HTTP stream task started for: {} (stream #{})", s_radio.currentUrl, myStreamId);
+    std::string name;
+    for (const char* c = title; *c; c++) {
+        // FAT rejects \/:*?"<>| and control characters
+        bool valid = (unsigned char)*c >= 0x20 && !strchr("\\/:*?\"<>|", *c);
+        name += valid ? *c : '_';
+    }
+    while (!name.empty() && (name.back() == ' ' || name.back() == '.')) {
+        name.pop_back();
+    }
 
-    // Check if URL is HTTPS or HTTP
-    bool is_https = s_radio.currentUrl.find("https://") == 0;
+    static int index = 0;
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        index = (index % 999) + 1;
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "/%03d", index);
+        std::string path = std::string(RECORD_DIR) + prefix + (name.empty() ? "" : " " + name) + extension;
 
-    esp_http_client_config_t config = {};
-    config.url                      = s_radio.currentUrl.c_str();
-    config.event_handler            = http_event_handler;
-    config.buffer_size              = 4096;
-    config.timeout_ms               = 30000;
-    config.keep_alive_enable        = true;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            continue;
+        }
+        bool opened = writer->open(path.c_str());
+        if (!opened && !name.empty()) {
+            // Title made an invalid name, fall back to the number alone
+            path   = std::string(RECORD_DIR) + prefix + extension;
+            opened = writer->open(path.c_str());
+        }
+        if (opened) {
+            mclog::tagInfo(TAG, "Recording to {}", path);
+        }
+        return opened;
+    }
+    return false;
+}
 
-    if (is_https) {
-        // For HTTPS: skip certificate verification for radio streams
-        // (RTC may not have correct time, and streams are public anyway)
-        config.skip_cert_common_name_check = true;
-        config.use_global_ca_store         = false;
-        config.crt_bundle_attach           = NULL;
-        // Set cert_pem to empty to skip server cert verification
-        config.cert_pem                    = NULL;
+static void record_task(void* param, const CancelToken& token)
+{
+    StreamConnection* conn = (StreamConnection*)param;
+    RingBuffer& ring       = conn->ringBuffer;
+    int cursor             = s_recorder.cursor;  // A run that outlived its stop keeps its own
+
+    SdWriter* writer = new (std::nothrow) SdWriter();
+
+    mkdir(RECORD_DIR, 0777);
+    RecordSplit_t split = s_recorder.split.load();
+    uint32_t splitSeq   = split.seq;
+    size_t dropped      = 0;
+    bool open           = writer && open_record_file(writer, split.title, s_recorder.extension);
+    if (!open) {
+        mclog::tagError(TAG, "Recording: failed to create a file in {}", RECORD_DIR);
     }
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        mclog::tagError(TAG, "Failed to init HTTP client");
-        if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
-            s_radio.state = hal::HalBase::RADIO_ERROR;
-            xSemaphoreGive(s_radio.mutex);
+    while (open && !token.cancelled()) {
+        size_t pos    = ring.cursorPosition(cursor);
+        bool stopping = s_recorder.conn.load(std::memory_order_acquire) == nullptr;
+        size_t want   = writer->spaceLeft();
+        if (stopping) {
+            want = (ptrdiff_t)(s_recorder.stopAt - pos) > 0 ? std::min(want, s_recorder.stopAt - pos) : 0;
         }
-        vTaskDelete(nullptr);
-        return;
-    }
 
-    // Set ICY metadata request header
-    esp_http_client_set_header(client, "Icy-MetaData", "1");
-    esp_http_client_set_header(client, "User-Agent", "Tab5-WebRadio/1.0");
+        // A title change ends the file at its write position, anything after goes into the next one
+        split         = s_recorder.split.load();
+        bool splitDue = split.seq != splitSeq;
+        if (splitDue) {
+            ptrdiff_t toSplit = (ptrdiff_t)(split.offset - pos);
+            want              = std::min(want, (size_t)std::max<ptrdiff_t>(toSplit, 0));
+        }
+        if (splitDue && want == 0) {
+            writer->close();
+            splitSeq = split.seq;
+            open     = open_record_file(writer, split.title, s_recorder.extension);
+            continue;
+        }
 
-    // Perform HTTP request - this blocks while streaming
-    mclog::tagInfo(TAG, "HTTP client performing request...");
-    esp_err_t err = esp_http_client_perform(client);
+        if (want == 0) {
+            break;  // Stopped and written out
+        }
 
-    // Log why the HTTP request ended
-    if (err != ESP_OK) {
-        if (s_radio.stopRequested) {
-            mclog::tagInfo(TAG, "HTTP stream stopped by user request");
-        } else {
-            mclog::tagError(TAG, "HTTP stream error: {} ({})", esp_err_to_name(err), (int)err);
-            if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
-                s_radio.state = hal::HalBase::RADIO_ERROR;
-                xSemaphoreGive(s_radio.mutex);
+        // The rest of the writer's block at once, it's only cut short at a split or when stopping
+        if (ring.cursorAvailable(cursor) < want) {
+            ring.waitForCursorData(cursor, want, 200);
+            if (ring.cursorAvailable(cursor) < want) {
+                continue;
             }
         }
-    } else {
-        mclog::tagInfo(TAG, "HTTP stream completed normally (unexpected for live stream!)");
+
+        size_t skipped;
+        size_t len = ring.readCursor(cursor, writer->space(), want, &skipped);
+        dropped += skipped;
+        if (len == 0) {
+            continue;
+        }
+        uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        if (!writer->commit(len)) {
+            mclog::tagError(TAG, "Recording: write failed, card full or removed?");
+            break;
+        }
+        uint32_t elapsed = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
+        if (elapsed > 500) {
+            mclog::tagWarn(TAG, "Recording: SD write took {} ms, {} KB queued", elapsed,
+                           ring.cursorAvailable(cursor) / 1024);
+        }
     }
 
-    esp_http_client_cleanup(client);
-    mclog::tagInfo(TAG, "HTTP stream task ended (stream #{})", myStreamId);
+    if (writer) {
+        writer->close();
+        const SdWriter::Stats_t& stats = writer->stats();
+        mclog::tagInfo(TAG, "Recording: {} KB written at {:.1f} MB/s, slowest block {} ms", stats.bytes / 1024,
+                       stats.mbps(), stats.worstUs / 1000);
+        delete writer;
+    }
+    if (dropped > 0) {
+        mclog::tagWarn(TAG, "Recording: {} KB dropped, the card couldn't keep up", dropped / 1024);
+    }
+    mclog::tagInfo(TAG, "Recording task ended, {} B stack left", task_topology::stack_headroom());
+    sdcard_release();
 
-    s_radio.httpTask = nullptr;
-    vTaskDelete(nullptr);
+    // Ends a recording that failed on its own as well. Stopped, the next recording may have started already
+    if (!token.cancelled()) {
+        s_recorder.conn.store(nullptr, std::memory_order_release);
+        s_recorder.cursor = -1;
+    }
+    ring.closeCursor(cursor);
 }
 
-/* -------------------------------------------------------------------------- */
-/*                           Audio Decode Task                                */
-/* -------------------------------------------------------------------------- */
-
-static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting)
+static bool start_recording(StreamConnection* conn)
 {
-    bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
-    codec_handle->set_mute(setting == AUDIO_PLAYER_MUTE ? true : false);
-    return ESP_OK;
-}
-
-// Custom FILE-like read from ring buffer
-static RingBuffer* s_audio_ring_buffer = nullptr;
-
-// Track position for fake seek support
-static size_t s_stream_position = 0;
+    if (s_recorder.task || !conn->task) {
+        return false;
+    }
+    if (conn->packetized || stream_frame::is_packet(conn->codec)) {
+        // The ring holds packets in their own framing, a file would have to be muxed into Ogg again
+        mclog::tagError(TAG, "Recording: Opus and FLAC streams can't be recorded");
+        return false;
+    }
+    if (!sdcard_acquire()) {
+        mclog::tagError(TAG, "Recording: no sd card");
+        return false;
+    }
+    // Lagging, a slow card must never hold back the stream
+    s_recorder.cursor = conn->ringBuffer.openCursor(false);
+    if (s_recorder.cursor < 0) {
+        sdcard_release();
+        return false;
+    }
+    s_recorder.extension = conn->codec == CODEC_AAC ? ".aac" : ".mp3";
 
-// Save first bytes for rewind support (needed for is_mp3() detection)
-// ID3v2 header is 10 bytes, but we need more to handle the ID3 tag size
-// which can be up to several KB. We'll save enough for typical ID3 detection.
-#define HEADER_BUFFER_SIZE 4096
-static uint8_t* s_header_buffer = nullptr;  // Dynamically allocated in PSRAM
-static size_t s_header_bytes_saved = 0;
-static size_t s_header_read_pos = 0;
-static bool s_header_replay_mode = false;
+    // The first file is named after what's playing now
+    RecordSplit_t split = s_recorder.split.load();
+    split.offset        = 0;
+    snprintf(split.title, sizeof(split.title), "%s", conn->metadata.load().title);
+    s_recorder.split.store(split);
 
-// Flag to log first header read - reset when starting new stream
-static bool s_first_header_read_logged = false;
+    // Lowest application priority, the writes must never take time from the HTTP or decode task
+    s_recorder.conn.store(conn, std::memory_order_release);
+    if (!s_recorder.task.start(task_topology::RADIO_RECORD, record_task, conn)) {
+        s_recorder.conn.store(nullptr, std::memory_order_release);
+        conn->ringBuffer.closeCursor(s_recorder.cursor);
+        s_recorder.cursor = -1;
+        sdcard_release();
+        return false;
+    }
+    return true;
+}
 
-static ssize_t ringbuffer_read(void* cookie, char* buf, size_t size)
+/**
+ * @brief End the recording at the current write position, the task still writes out what's queued up to there
+ *
+ * @param drain wait for the task to finish, needed before the ring may be reset for another station
+ */
+static void stop_recording(bool drain)
 {
-    if (!s_audio_ring_buffer || s_radio.stopRequested) {
-        return -1;
+    StreamConnection* conn = s_recorder.conn.load();
+    if (conn) {
+        s_recorder.stopAt = conn->ringBuffer.writePosition();
+        s_recorder.conn.store(nullptr, std::memory_order_seq_cst);
+        mclog::tagInfo(TAG, "Recording stopped");
+    }
+    if (!drain) {
+        return;
+    }
+    if (!s_recorder.task.wait(RECORD_DRAIN_MS)) {
+        s_recorder.task.cancel();  // Still stuck on the card, give up on the rest
     }
+    if (!s_recorder.task.join(RECORD_JOIN_MS)) {
+        // It reads its own cursor, which stays open on the ring until it ends
+        mclog::tagWarn(TAG, "Recording task still on the card after {} ms, left to end by itself",
+                       RECORD_DRAIN_MS + RECORD_JOIN_MS);
+        s_recorder.conn.store(nullptr, std::memory_order_release);
+        s_recorder.cursor = -1;
+    }
+}
 
-    int totalRead = 0;
+/**
+ * @brief Note the title the stream changed to at the current write position, for naming a save from the history
+ */
+static void mark_title(StreamConnection* conn, const char* title)
+{
+    TitleMarks_t titles        = conn->titleMarks.load();
+    TitleMarks_t::Mark_t& mark = titles.marks[titles.count++ % TITLE_MARKS];
+    mark.at                    = conn->ringBuffer.writePosition();
+    snprintf(mark.title, sizeof(mark.title), "%s", title);
+    conn->titleMarks.store(titles);
+}
 
-    // If in header replay mode, serve from saved header first
-    if (s_header_buffer && s_header_replay_mode && s_header_read_pos < s_header_bytes_saved) {
-        size_t headerAvail = s_header_bytes_saved - s_header_read_pos;
-        size_t toRead = (size < headerAvail) ? size : headerAvail;
-        memcpy(buf, s_header_buffer + s_header_read_pos, toRead);
-        s_header_read_pos += toRead;
-        totalRead = toRead;
-        s_stream_position += toRead;
+/* -------------------------------------------------------------------------- */
+/*                                History Save                                */
+/* -------------------------------------------------------------------------- */
+// "Save the last minutes": a lagging cursor opened back in the time-shift history copies what was played into the
+// recorder's writer a large chunk at a time, from a task at the recorder's priority. The history is behind the
+// decoder, where the HTTP task doesn't write, so the producer never waits for the save and nothing live is copied.
+// Files start and end on whole frames and split where the metadata left a title mark on the ring
+#define SAVE_CHUNK   (64 * 1024)  // Read per step, a writer block
+#define SAVE_JOIN_MS 2000         // Most an abort waits for the chunk being written
 
-        // Log first read from header buffer (once per stream)
-        if (!s_first_header_read_logged) {
-            mclog::tagInfo(TAG, "First header read: {} bytes, first 4: {:02X} {:02X} {:02X} {:02X}",
-                          toRead, (uint8_t)buf[0], (uint8_t)buf[1], (uint8_t)buf[2], (uint8_t)buf[3]);
-            s_first_header_read_logged = true;
-        }
+struct HistorySave {
+    std::atomic<StreamConnection*> conn{nullptr};  // Being saved from, nullptr once done
+    JoinableTask task;
+    int cursor          = -1;  // On conn's ring
+    size_t stopAt       = 0;   // The play position when the save was asked for
+    StreamCodec_t codec = CODEC_MP3;
+};
 
-        // If we've replayed all header bytes, exit replay mode
-        if (s_header_read_pos >= s_header_bytes_saved) {
-            mclog::tagInfo(TAG, "Header replay complete, switching to ring buffer");
-            s_header_replay_mode = false;
-        }
+static HistorySave s_save;
 
-        // If we've satisfied the request, return
-        if ((size_t)totalRead >= size) {
-            return totalRead;
+/**
+ * @brief Title of the newest mark at or before `pos`, empty if it's older than the marks kept
+ *
+ * @param next set to the position of the first mark past `pos`, `pos` if there's none
+ */
+static const char* title_at(const TitleMarks_t& titles, size_t pos, size_t* next)
+{
+    const char* title = "";
+    *next             = pos;
+    uint32_t kept     = std::min<uint32_t>(titles.count, TITLE_MARKS);
+    for (uint32_t i = titles.count - kept; i != titles.count; i++) {
+        const TitleMarks_t::Mark_t& mark = titles.marks[i % TITLE_MARKS];
+        if ((ptrdiff_t)(mark.at - pos) <= 0) {
+            title = mark.title;
+        } else {
+            *next = mark.at;
+            break;
         }
-        // Otherwise continue reading from ring buffer
-        buf += totalRead;
-        size -= totalRead;
     }
+    return title;
+}
 
-    // Block until we have at least some data - this is critical because
-    // returning 0 from read() signals EOF to the audio player!
-    // For live streams, we need to be very patient - network can have long stalls
-    int retries    = 0;
-    int maxRetries = 3000;  // 30 seconds timeout - very patient for live streams
-    static uint32_t lastBufferLog = 0;
-    static uint32_t lastHealthyLog = 0;
+static void save_task(void* param, const CancelToken& token)
+{
+    StreamConnection* conn = (StreamConnection*)param;
+    RingBuffer& ring       = conn->ringBuffer;
+    int cursor             = s_save.cursor;  // A run that outlived its abort keeps its own
+    size_t stopAt          = s_save.stopAt;
+    StreamCodec_t codec    = s_save.codec;
+    size_t headerSize      = stream_frame::header_size(codec);
+    TitleMarks_t* titles   = new (std::nothrow) TitleMarks_t(conn->titleMarks.load());  // Off the small stack
 
-    // Wait for at least 1 byte of data before returning
-    while (retries < maxRetries && !s_radio.stopRequested) {
-        size_t available = s_audio_ring_buffer->available();
+    SdWriter* writer = new (std::nothrow) SdWriter();
+    uint8_t* chunk   = (uint8_t*)heap_caps_malloc(SAVE_CHUNK, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    mkdir(RECORD_DIR, 0777);
 
-        if (available > 0) {
-            uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    // `chunk` holds `fill` bytes from the ring position `start`, from a frame header on once synced
+    size_t start      = ring.cursorPosition(cursor);
+    size_t fill       = 0;
+    bool synced       = false;
+    bool open         = false;
+    bool ok           = titles && writer && chunk;
+    int files         = 0;
+    size_t dropped    = 0;
+    size_t split      = start;  // Next title mark, `start` or behind it if there's none
+    const char* title = "";
+    if (!ok) {
+        mclog::tagError(TAG, "History save: out of memory");
+    }
 
-            // Log buffer level periodically when low
-            if (available < MIN_BUFFER_LEVEL && (now - lastBufferLog) > 1000) {
-                mclog::tagWarn(TAG, "Buffer low: {} bytes ({} KB)", available, available / 1024);
-                lastBufferLog = now;
+    while (ok && !token.cancelled()) {
+        size_t pos  = start + fill;
+        size_t left = (ptrdiff_t)(stopAt - pos) > 0 ? stopAt - pos : 0;
+        size_t want = std::min(SAVE_CHUNK - fill, left);
+        if (want > 0) {
+            size_t skipped;
+            size_t len = ring.readCursor(cursor, chunk + fill, want, &skipped);
+            if (skipped > 0) {
+                // The history moved on past the cursor, what was read from before it may be torn
+                dropped += skipped;
+                start  = ring.cursorPosition(cursor);
+                fill   = 0;
+                synced = false;
+                continue;
             }
+            fill += len;
+        }
 
-            // Log healthy buffer periodically (every 10 seconds)
-            if (available >= MIN_BUFFER_LEVEL && (now - lastHealthyLog) > 10000) {
-                mclog::tagInfo(TAG, "Buffer healthy: {} KB", available / 1024);
-                lastHealthyLog = now;
+        if (!synced) {
+            FrameHeader_t header;
+            int offset = stream_frame::find_frame(codec, chunk, fill, &header);
+            size_t skip = offset >= 0 ? offset : fill - std::min(fill, headerSize - 1);
+            memmove(chunk, chunk + skip, fill - skip);
+            start += skip;
+            fill -= skip;
+            synced = offset >= 0;
+            if (!synced) {
+                if (want == 0) {
+                    break;
+                }
+                continue;
             }
+            title = title_at(*titles, start, &split);
+        }
 
-            // Read as much as available, up to requested size
-            size_t toRead = (size < available) ? size : available;
-            size_t bytesRead = s_audio_ring_buffer->read((uint8_t*)buf, toRead);
+        // Whole frames, up to the first that starts at the next title
+        size_t frames = 0;
+        bool lost     = false;
+        bool splitDue = false;
+        while (frames + headerSize <= fill) {
+            splitDue = (ptrdiff_t)(split - start) > 0 && (ptrdiff_t)(start + frames - split) >= 0;
+            if (splitDue) {
+                break;
+            }
+            FrameHeader_t header;
+            if (!stream_frame::parse_header(codec, chunk + frames, &header) || header.frameSize == 0) {
+                lost = true;
+                break;
+            }
+            if (frames + header.frameSize > fill) {
+                break;
+            }
+            frames += header.frameSize;
+        }
 
-            totalRead += bytesRead;
-            s_stream_position += bytesRead;
-            break;  // Got data, exit wait loop
-        } else {
-            // Buffer empty! Log this (but not too often)
-            if (retries == 0) {
-                mclog::tagWarn(TAG, "Buffer empty! Waiting for data...");
-            } else if (retries % 100 == 0) {
-                // Log every second while waiting
-                mclog::tagWarn(TAG, "Still waiting for data... ({} seconds)", retries / 100);
+        if (frames > 0 && !open) {
+            open = open_record_file(writer, title, codec == CODEC_AAC ? ".aac" : ".mp3");
+            ok   = open;
+            if (open) {
+                files++;
+            } else {
+                mclog::tagError(TAG, "History save: failed to create a file in {}", RECORD_DIR);
             }
-            vTaskDelay(pdMS_TO_TICKS(10));
-            retries++;
         }
-    }
+        if (frames > 0 && ok && !writer->write(chunk, frames)) {
+            mclog::tagError(TAG, "History save: write failed, card full or removed?");
+            ok = false;
+        }
+        memmove(chunk, chunk + frames, fill - frames);
+        start += frames;
+        fill -= frames;
 
-    // If we couldn't get any data and stop was requested, signal EOF
-    if (totalRead == 0) {
-        if (s_radio.stopRequested) {
-            mclog::tagInfo(TAG, "ringbuffer_read: stop requested, returning -1");
-            return -1;  // Signal EOF
+        if (splitDue) {
+            writer->close();
+            open  = false;
+            title = title_at(*titles, start, &split);
+        } else if (lost) {
+            // Garbage between frames, look for the next one past it
+            memmove(chunk, chunk + 1, fill - 1);
+            start++;
+            fill--;
+            synced = false;
+        } else if (want == 0 && frames == 0) {
+            break;  // At the play position, what's left is part of the frame playing
         }
-        // Timeout waiting for data - after 30 seconds, give up
-        mclog::tagError(TAG, "ringbuffer_read: timeout after 30s waiting for data");
-        return -1;
     }
 
-    // Update spectrum data from audio
-    if (totalRead > 0) {
-        // Simple amplitude-based spectrum visualization
-        int16_t* samples   = (int16_t*)buf;
-        int numSamples     = totalRead / 2;
-        int samplesPerBand = numSamples / SPECTRUM_BANDS;
-        if (samplesPerBand < 1) samplesPerBand = 1;
-
-        for (int band = 0; band < SPECTRUM_BANDS && band * samplesPerBand < numSamples; band++) {
-            int sum = 0;
-            for (int i = 0; i < samplesPerBand && (band * samplesPerBand + i) < numSamples; i++) {
-                sum += abs(samples[band * samplesPerBand + i]);
-            }
-            int avg             = sum / samplesPerBand;
-            s_radio.spectrum[band] = (uint8_t)((avg * 255) / 32768);
-        }
+    if (ok && files == 0) {
+        mclog::tagWarn(TAG, "History save: no frames in what's buffered");
     }
+    if (writer) {
+        writer->close();
+        const SdWriter::Stats_t& stats = writer->stats();
+        mclog::tagInfo(TAG, "History save: {} KB in {} files at {:.1f} MB/s", stats.bytes / 1024, files,
+                       stats.mbps());
+        delete writer;
+    }
+    if (dropped > 0) {
+        mclog::tagWarn(TAG, "History save: {} KB played out of the history before they were saved", dropped / 1024);
+    }
+    heap_caps_free(chunk);
+    delete titles;
+    sdcard_release();
 
-    return totalRead;
+    // Aborted, abort_save() has ended the save already
+    if (!token.cancelled()) {
+        s_save.conn.store(nullptr, std::memory_order_release);
+        s_save.cursor = -1;
+    }
+    ring.closeCursor(cursor);
 }
 
-// Fake seek - for streams we can only support SEEK_SET to 0 (reset)
-// The MP3 decoder calls fseek(fp, 0, SEEK_SET) to reset position
-// We support seeking back to 0 by replaying saved header bytes
-static int ringbuffer_seek(void* cookie, off_t* offset, int whence)
+/**
+ * @brief Save the `bytes` played last on `conn`, at most what its history holds
+ */
+static bool start_save(StreamConnection* conn, size_t bytes)
 {
-    if (whence == SEEK_SET && *offset == 0) {
-        // Seek to start - enable header replay mode if we have saved bytes
-        if (s_header_buffer && s_header_bytes_saved > 0) {
-            s_header_replay_mode = true;
-            s_header_read_pos = 0;
-            s_stream_position = 0;
-            mclog::tagInfo(TAG, "Seek to 0: enabling header replay mode ({} bytes saved)", s_header_bytes_saved);
-            return 0;
-        }
-        // No header buffer, just reset position counter
-        s_stream_position = 0;
-        return 0;
-    } else if (whence == SEEK_CUR && *offset == 0) {
-        // Just return current position
-        *offset = (off_t)s_stream_position;
-        return 0;
-    } else if (whence == SEEK_END) {
-        // Can't seek to end of a live stream
-        return -1;
+    if (s_save.task || !conn->task) {
+        return false;
     }
-
-    // For any other seek, return error
-    return -1;
+    if (conn->local) {
+        return false;  // It's on the card already
+    }
+    if (conn->packetized || stream_frame::is_packet(conn->codec)) {
+        mclog::tagError(TAG, "History save: Opus and FLAC streams can't be recorded");
+        return false;
+    }
+    RingBuffer& ring = conn->ringBuffer;
+    bytes            = std::min(bytes, ring.history());
+    if (bytes == 0) {
+        return false;
+    }
+    if (!sdcard_acquire()) {
+        mclog::tagError(TAG, "History save: no sd card");
+        return false;
+    }
+    // Lagging: if the card is slower than the history moves on, the save loses its oldest audio, never the stream
+    size_t stopAt = ring.readPosition();
+    s_save.cursor = ring.openCursor(false, ring.writePosition() - stopAt + bytes);
+    if (s_save.cursor < 0) {
+        sdcard_release();
+        return false;
+    }
+    s_save.stopAt = stopAt;
+    s_save.codec  = conn->codec;
+    s_save.conn.store(conn, std::memory_order_release);
+    if (!s_save.task.start(task_topology::RADIO_RECORD, save_task, conn)) {
+        s_save.conn.store(nullptr, std::memory_order_release);
+        ring.closeCursor(s_save.cursor);
+        s_save.cursor = -1;
+        sdcard_release();
+        return false;
+    }
+    mclog::tagInfo(TAG, "History save: the last {} KB played", bytes / 1024);
+    return true;
 }
 
-static int ringbuffer_close(void* cookie)
+/**
+ * @brief End a save from `conn` and wait for its task, before the ring is reset for another stream
+ */
+static void abort_save(StreamConnection* conn)
 {
-    s_stream_position = 0;
-    s_header_bytes_saved = 0;
-    s_header_read_pos = 0;
-    s_header_replay_mode = false;
-    return 0;
+    if (s_save.conn.load(std::memory_order_acquire) != conn) {
+        return;
+    }
+    if (!s_save.task.stop(SAVE_JOIN_MS)) {
+        // It reads its own cursor, which stays open on the ring until it ends
+        mclog::tagWarn(TAG, "History save still on the card after {} ms, left to end by itself", SAVE_JOIN_MS);
+        s_save.conn.store(nullptr, std::memory_order_release);
+        s_save.cursor = -1;
+    }
 }
 
-static void audio_decode_task(void* param)
-{
-    mclog::tagInfo(TAG, "Audio decode task started");
+/* -------------------------------------------------------------------------- */
+/*                                Stream Trace                                */
+/* -------------------------------------------------------------------------- */
+// The pipeline's steps as binary records (stream/stream_trace.h), written to the card when the stream stops or to
+// the console if there's no card. app/stream/stream_trace.py turns either into a Perfetto trace
+#define TRACE_DUMP_PATH  SDCARD_MOUNT_POINT "/radio_trace.bin"
+#define TRACE_LINE_BYTES 48  // Per base64 console line
 
-    // Wait for prebuffer
-    mclog::tagInfo(TAG, "Prebuffering...");
-    while (s_radio.ringBuffer.available() < PREBUFFER_SIZE && !s_radio.stopRequested) {
-        vTaskDelay(pdMS_TO_TICKS(50));
+static void trace_ring_write(StreamConnection* conn, size_t len)
+{
+    if (!conn->warm) {
+        stream_trace().record(TRACE_RING_WRITE, TRACE_INSTANT, len);
     }
+}
 
-    if (s_radio.stopRequested) {
-        mclog::tagInfo(TAG, "Audio decode task stopped during prebuffer");
-        s_radio.audioTask = nullptr;
-        vTaskDelete(nullptr);
+#if CONFIG_TAB5_STREAM_TRACE
+#define TRACE_RECORDS (1u << CONFIG_TAB5_STREAM_TRACE_ORDER)
+
+static void trace_start()
+{
+    static StreamTrace::Record_t* s_records = nullptr;
+    if (s_records) {
         return;
     }
-
-    // Update state to playing
-    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
-        s_radio.state = hal::HalBase::RADIO_PLAYING;
-        xSemaphoreGive(s_radio.mutex);
+    s_records = (StreamTrace::Record_t*)heap_caps_malloc(TRACE_RECORDS * sizeof(StreamTrace::Record_t),
+                                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s_records) {
+        mclog::tagError(TAG, "Trace: no room for {} records", TRACE_RECORDS);
+        return;
     }
-    mclog::tagInfo(TAG, "Prebuffer complete, starting playback");
+    stream_trace().start(s_records, TRACE_RECORDS);
+}
 
-    // Allocate header buffer for seek support FIRST (before audio player starts reading)
-    if (!s_header_buffer) {
-        s_header_buffer = (uint8_t*)heap_caps_malloc(HEADER_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (!s_header_buffer) {
-            s_header_buffer = (uint8_t*)malloc(HEADER_BUFFER_SIZE);
-        }
+static void trace_print(const uint8_t* data, size_t len)
+{
+    unsigned char line[TRACE_LINE_BYTES * 4 / 3 + 4];
+    for (size_t pos = 0; pos < len; pos += TRACE_LINE_BYTES) {
+        size_t olen = 0;
+        mbedtls_base64_encode(line, sizeof(line), &olen, data + pos, std::min((size_t)TRACE_LINE_BYTES, len - pos));
+        printf("STREAM_TRACE %.*s\n", (int)olen, line);
     }
-    if (!s_header_buffer) {
-        mclog::tagError(TAG, "Failed to allocate header buffer");
-        s_radio.audioTask = nullptr;
-        vTaskDelete(nullptr);
+}
+
+// On a HAL worker: a stop must not wait for the card or the console
+static void trace_dump()
+{
+    auto* records = (StreamTrace::Record_t*)heap_caps_malloc(TRACE_RECORDS * sizeof(StreamTrace::Record_t),
+                                                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!records) {
         return;
     }
+    StreamTrace::FileHeader_t header;
+    size_t count = stream_trace().copy(records, TRACE_RECORDS, &header);
+    size_t bytes = count * sizeof(StreamTrace::Record_t);
 
-    // Scan the prebuffer to find the first valid MP3 frame header
-    // When joining a live stream, we may be in the middle of a frame
-    // MP3 frame header: 0xFF followed by specific bit patterns
-    // See: http://www.mp3-tech.org/programmer/frame_header.html
-    {
-        // Read data from ring buffer to scan for sync
-        size_t available = s_radio.ringBuffer.available();
-        size_t scanSize = (available < HEADER_BUFFER_SIZE) ? available : HEADER_BUFFER_SIZE;
-        size_t bytesRead = s_radio.ringBuffer.read(s_header_buffer, scanSize);
-
-        // Find valid MP3 frame header (need at least 4 bytes for full header)
-        int syncOffset = -1;
-        for (size_t i = 0; i < bytesRead - 3; i++) {
-            uint8_t b0 = s_header_buffer[i];
-            uint8_t b1 = s_header_buffer[i + 1];
-            uint8_t b2 = s_header_buffer[i + 2];
-
-            // Check for sync word: 11 bits set (0xFF followed by 0xE0 or higher)
-            if (b0 != 0xFF || (b1 & 0xE0) != 0xE0) {
-                continue;
+    FILE* file = nullptr;
+    if (count > 0 && sdcard_acquire()) {
+        file = fopen(TRACE_DUMP_PATH, "wb");
+        if (file) {
+            fwrite(&header, sizeof(header), 1, file);
+            fwrite(records, 1, bytes, file);
+            fclose(file);
+            mclog::tagInfo(TAG, "Trace: {} records written to {}", count, TRACE_DUMP_PATH);
+        }
+        sdcard_release();
+    }
+    if (count > 0 && !file) {
+        printf("STREAM_TRACE BEGIN\n");
+        trace_print((const uint8_t*)&header, sizeof(header));
+        trace_print((const uint8_t*)records, bytes);
+        printf("STREAM_TRACE END\n");
+    }
+    heap_caps_free(records);
+}
+#else
+static void trace_start()
+{
+}
+
+static void trace_dump()
+{
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                                  Metrics                                   */
+/* -------------------------------------------------------------------------- */
+// Served at /metrics by the relay server (hal_metrics.cpp). Only the station being heard counts, like the trace
+#define METRIC_STACK_EVERY 256  // Loop iterations between stack reports
+
+static metrics::Counter s_metric_bytes("radio_bytes_received_total", "Stream body bytes read, metadata included");
+static metrics::Counter s_metric_reconnects("radio_reconnects_total", "Stream reconnect attempts");
+static metrics::Counter s_metric_underruns("radio_underruns_total", "Times the output ran dry while playing");
+static metrics::Counter s_metric_resyncs("radio_decoder_resyncs_total", "Times the decoder skipped bytes to a frame");
+static metrics::Counter s_metric_decode_errors("radio_decode_errors_total", "Frames the decoder rejected");
+static metrics::Counter s_metric_icy_errors("radio_icy_parse_failures_total",
+                                            "ICY metadata blocks without a readable StreamTitle");
+static metrics::Gauge s_metric_buffer("radio_buffer_bytes", "Bytes in the stream ring");
+static metrics::Gauge s_metric_boot_to_audio("radio_boot_to_audio_ms",
+                                             "Boot to the first audio heard, the wake-to-audio time after an alarm");
+static metrics::Gauge s_metric_drift("radio_clock_drift_ppm", "Output rate trim following the stream's encoder clock");
+static metrics::Histogram s_metric_rebuffer("radio_rebuffer_ms", "Time from running dry to resuming playback",
+                                            {250, 500, 1000, 2000, 5000, 10000, 30000});
+
+// A task's stack can only be measured safely by the task itself, so the long-lived ones report now and then
+static metrics::Gauge s_metric_stack_http("task_stack_free_bytes", "Least free stack a task has had",
+                                          "task=\"http_stream\"");
+static metrics::Gauge s_metric_stack_decode("task_stack_free_bytes", "Least free stack a task has had",
+                                            "task=\"audio_decode\"");
+static metrics::Gauge s_metric_stack_output("task_stack_free_bytes", "Least free stack a task has had",
+                                            "task=\"radio_out\"");
+
+static void metric_report_stack(metrics::Gauge* gauge, uint32_t iteration)
+{
+    if (iteration % METRIC_STACK_EVERY == 0) {
+        gauge->set(task_topology::stack_headroom());
+    }
+}
+
+// From the HTTP task, per socket read
+static void metric_received(StreamConnection* conn, size_t len)
+{
+    static uint32_t s_reads = 0;
+    if (!conn->warm) {
+        s_metric_bytes.inc(len);
+        metric_report_stack(&s_metric_stack_http, s_reads++);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Pipeline Heartbeats                             */
+/* -------------------------------------------------------------------------- */
+// Each stage beats a progress counter per unit of work: a socket read, audio demuxed into the ring, a decoded frame,
+// a processed slice, a block written out. It's busy from the start of a unit until its beat and idle while it waits
+// on a neighbour, the back-pressure of a full ring or queue or an empty one upstream. Only a stage that's been busy
+// for longer than its budget is stalled, the supervisor (Pipeline Supervisor) recovers it
+enum Stage_t {
+    STAGE_TRANSPORT = 0,  // HTTP reader, upstream first: a stall is blamed on the first stage stuck
+    STAGE_DEMUX,
+    STAGE_DECODE,
+    STAGE_DSP,
+    STAGE_OUTPUT,
+    STAGE_COUNT,
+};
+
+struct Heartbeat_t {
+    metrics::Counter beats;
+    metrics::Counter stalls;
+    std::atomic<uint32_t> busySince{0};  // ms the unit in hand started at, 0 while idle
+};
+
+static Heartbeat_t s_heartbeats[STAGE_COUNT] = {
+    {{"radio_stage_progress_total", "Units of work a pipeline stage finished", "stage=\"transport\""},
+     {"radio_stage_stalls_total", "Times a pipeline stage overran its stall budget", "stage=\"transport\""}},
+    {{"radio_stage_progress_total", "Units of work a pipeline stage finished", "stage=\"demux\""},
+     {"radio_stage_stalls_total", "Times a pipeline stage overran its stall budget", "stage=\"demux\""}},
+    {{"radio_stage_progress_total", "Units of work a pipeline stage finished", "stage=\"decode\""},
+     {"radio_stage_stalls_total", "Times a pipeline stage overran its stall budget", "stage=\"decode\""}},
+    {{"radio_stage_progress_total", "Units of work a pipeline stage finished", "stage=\"dsp\""},
+     {"radio_stage_stalls_total", "Times a pipeline stage overran its stall budget", "stage=\"dsp\""}},
+    {{"radio_stage_progress_total", "Units of work a pipeline stage finished", "stage=\"output\""},
+     {"radio_stage_stalls_total", "Times a pipeline stage overran its stall budget", "stage=\"output\""}},
+};
+
+// Set by the supervisor, taken by the decoder before its next frame
+static std::atomic<bool> s_decoder_resync{false};
+
+static uint32_t heartbeat_ms()
+{
+    return (uint32_t)(esp_timer_get_time() / 1000) | 1;  // 0 is idle
+}
+
+// The HTTP task's stages only beat for the connection being heard, not the warm one or one closing down
+static bool stage_heard(StreamConnection* conn)
+{
+    return !conn || (!conn->warm && !conn->task.cancelled());
+}
+
+// A unit of work starts, unless one is already under way: a read that timed out is still the same wait for data
+static void stage_work(Stage_t stage, StreamConnection* conn = nullptr)
+{
+    if (stage_heard(conn) && s_heartbeats[stage].busySince.load(std::memory_order_relaxed) == 0) {
+        s_heartbeats[stage].busySince.store(heartbeat_ms(), std::memory_order_relaxed);
+    }
+}
+
+static void stage_beat(Stage_t stage, StreamConnection* conn = nullptr)
+{
+    if (stage_heard(conn)) {
+        s_heartbeats[stage].beats.inc();
+        s_heartbeats[stage].busySince.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Any connection's task may idle the stages, a closing one mustn't leave them busy for the next
+static void stage_idle(Stage_t stage)
+{
+    s_heartbeats[stage].busySince.store(0, std::memory_order_relaxed);
+}
+
+// The HTTP task's stages go idle once it leaves a body, however it leaves: a reconnect's backoff or the wait for
+// the next HLS segment are no stall
+struct StageBody {
+    ~StageBody()
+    {
+        stage_idle(STAGE_TRANSPORT);
+        stage_idle(STAGE_DEMUX);
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+/*                            Now-Playing History                             */
+/* -------------------------------------------------------------------------- */
+// Every title heard is kept in a fixed PSRAM ring and appended to a log in the data directory in batches, so the
+// flash sees one write per few songs. The log is replayed on first use and rewritten from the ring once it has
+// grown well past what the ring holds. Appends and rewrites copy a slice of the ring at a time, never holding the
+// lock the HTTP task takes over a file write
+#define HISTORY_LOG_NAME    "/history.log"
+#define HISTORY_LOG_MAX     (256 * 1024)  // Bytes, compacted past this
+#define HISTORY_FLUSH_COUNT 8             // Titles per append, what a power cut can lose
+#define HISTORY_SLICE       64            // Entries serialized per lock
+
+struct RadioHistory {
+    std::mutex mutex;
+    TitleHistory ring;
+    std::string path;  // Empty if there's nowhere to keep the log
+    bool loaded         = false;
+    bool flushing       = false;
+    uint32_t flushedSeq = 0;  // Entries before this are in the log
+    long logSize        = 0;
+};
+
+static RadioHistory s_history;
+
+static bool time_is_valid(time_t now)
+{
+    return now > 1700000000;  // The RTC hasn't been set when it's still in 2023 or earlier
+}
+
+// Record: time (u32), station and title lengths (u8 each), then both strings, no terminators
+static void history_append_record(std::string* out, uint32_t time, const char* station, const char* title)
+{
+    uint8_t lens[2] = {(uint8_t)strlen(station), (uint8_t)strlen(title)};
+    out->append((const char*)&time, sizeof(time));
+    out->append((const char*)lens, sizeof(lens));
+    out->append(station, lens[0]);
+    out->append(title, lens[1]);
+}
+
+/**
+ * @brief Allocate the ring and replay the log, once. Called with the lock held
+ */
+static void history_load_locked()
+{
+    if (s_history.loaded) {
+        return;
+    }
+    s_history.loaded = true;
+    if (!s_history.ring.init()) {
+        mclog::tagError(TAG, "Failed to allocate title history");
+        return;
+    }
+
+    std::string dir = GetHAL()->getDataDir();
+    if (dir.empty()) {
+        return;
+    }
+    s_history.path = dir + HISTORY_LOG_NAME;
+
+    FILE* file = fopen(s_history.path.c_str(), "rb");
+    if (!file) {
+        return;
+    }
+    char station[TitleHistory::STRING_SIZE];
+    char title[TitleHistory::STRING_SIZE];
+    uint32_t time;
+    uint8_t lens[2];
+    long good = 0;
+    while (fread(&time, sizeof(time), 1, file) == 1 && fread(lens, sizeof(lens), 1, file) == 1 &&
+           lens[0] < sizeof(station) && lens[1] < sizeof(title) && fread(station, 1, lens[0], file) == lens[0] &&
+           fread(title, 1, lens[1], file) == lens[1]) {
+        station[lens[0]] = '\0';
+        title[lens[1]]   = '\0';
+        s_history.ring.add(time, station, title);
+        good = ftell(file);
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+
+    s_history.flushedSeq = s_history.ring.nextSeq();
+    s_history.logSize    = size;
+    if (good != size) {
+        // Cut off by a power loss mid-append, appending after it would hide everything that follows
+        mclog::tagWarn(TAG, "Title history log damaged at {}, rewriting", good);
+        s_history.logSize = HISTORY_LOG_MAX + 1;
+    }
+    mclog::tagInfo(TAG, "Title history: {} titles", s_history.ring.size());
+}
+
+static void history_flush()
+{
+    uint32_t from, to;
+    bool compact;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(s_history.mutex);
+        to      = s_history.ring.nextSeq();
+        compact = s_history.logSize > HISTORY_LOG_MAX;
+        from    = compact ? to - s_history.ring.size() : s_history.flushedSeq;
+        path    = s_history.path;
+    }
+
+    std::string target = compact ? path + ".tmp" : path;
+    FILE* file         = fopen(target.c_str(), compact ? "wb" : "ab");
+    bool ok            = file != nullptr;
+    long written       = 0;
+
+    std::string batch;
+    for (uint32_t seq = from; ok && seq != to;) {
+        uint32_t end = to - seq > HISTORY_SLICE ? seq + HISTORY_SLICE : to;
+        batch.clear();
+        {
+            // Entries dropped from the ring since are skipped, the log keeps no more than the ring would
+            std::lock_guard<std::mutex> lock(s_history.mutex);
+            s_history.ring.entriesSince(seq, [&](const TitleHistory::Entry_t& entry, const char* station,
+                                                 const char* title) {
+                if ((int32_t)(entry.seq - end) < 0) {
+                    history_append_record(&batch, entry.time, station, title);
+                }
+            });
+        }
+        ok = fwrite(batch.data(), 1, batch.size(), file) == batch.size();
+        written += batch.size();
+        seq = end;
+    }
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (ok && compact) {
+        remove(path.c_str());
+        ok = rename(target.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        mclog::tagWarn(TAG, "Failed to write title history log");
+    }
+
+    std::lock_guard<std::mutex> lock(s_history.mutex);
+    s_history.flushedSeq = to;
+    // A partial append can't be undone, a rewrite from the ring next time replaces it
+    s_history.logSize  = !ok ? HISTORY_LOG_MAX + 1 : compact ? written : s_history.logSize + written;
+    s_history.flushing = false;
+}
+
+/**
+ * @param minPending titles that have to be waiting before an append is worth it
+ */
+static void history_flush_async(uint32_t minPending)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_history.mutex);
+        uint32_t pending = s_history.ring.nextSeq() - s_history.flushedSeq;
+        if (s_history.path.empty() || s_history.flushing || pending == 0 || pending < minPending) {
+            return;
+        }
+        s_history.flushing = true;
+    }
+    GetHAL()->runInBackground(history_flush);
+}
+
+static void history_add(const std::string& station, const char* title)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_history.mutex);
+        history_load_locked();
+        time_t now = time(nullptr);
+        s_history.ring.add(time_is_valid(now) ? (uint32_t)now : 0, station.c_str(), title);
+    }
+    history_flush_async(HISTORY_FLUSH_COUNT);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           ICY Metadata Parsing                             */
+/* -------------------------------------------------------------------------- */
+// Metadata is published lock-free so neither the HTTP task nor the UI ever waits on the other
+static void copy_text(char* dst, size_t dstSize, const char* src, size_t len)
+{
+    if (len >= dstSize) {
+        len = dstSize - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+// From the ICY metadata, or the Vorbis comments of an Ogg or FLAC stream
+static void set_stream_title(StreamConnection* conn, const char* titleStart, size_t titleLen)
+{
+    bool changed = strncmp(conn->meta.title, titleStart, titleLen) != 0 || conn->meta.title[titleLen] != '\0';
+    if (changed) {
+        std::string title(titleStart, titleLen);
+        record_split(conn, title.c_str());
+        mark_title(conn, title.c_str());
+        // A warm station isn't heard yet, its title is added if it takes over
+        if (!conn->warm) {
+            history_add(conn->url, title.c_str());
+        }
+    }
+    copy_text(conn->meta.title, sizeof(conn->meta.title), titleStart, titleLen);
+    conn->metadata.store(conn->meta);
+    // Stored first, so a subscriber reading the metadata on the event finds the new title
+    if (changed && !conn->warm) {
+        hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);
+    }
+    mclog::tagInfo(TAG, "Now playing: {}", conn->meta.title);
+}
+
+static void parse_icy_metadata(StreamConnection* conn, const char* metadata, size_t len)
+{
+    // Format: StreamTitle='Artist - Track';StreamUrl='...';
+    const char* titleStart = nullptr;
+    size_t titleLen        = 0;
+    if (!IcyDemuxer::streamTitle(metadata, &titleStart, &titleLen) || titleLen >= 256) {
+        // An empty title is what some stations send between tracks
+        if (!conn->warm && !strstr(metadata, "StreamTitle='';")) {
+            s_metric_icy_errors.inc();
+        }
+        return;
+    }
+    set_stream_title(conn, titleStart, titleLen);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           HTTP Event Handler                               */
+/* -------------------------------------------------------------------------- */
+// Only headers are handled here, the body is pulled by http_stream_task so it can apply back-pressure
+static esp_err_t http_event_handler(esp_http_client_event_t* evt)
+{
+    StreamConnection* conn = (StreamConnection*)evt->user_data;
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_HEADER:
+            // Check for ICY metadata interval
+            if (strcasecmp(evt->header_key, "icy-metaint") == 0) {
+                conn->icy.reset(atoi(evt->header_value));
+                HOT_LOG_INFO(TAG, "ICY metadata interval: {}", conn->icy.metaInt());
+            } else if (strcasecmp(evt->header_key, "icy-name") == 0) {
+                copy_text(conn->meta.station, sizeof(conn->meta.station), evt->header_value,
+                          strlen(evt->header_value));
+                conn->metadata.store(conn->meta);
+                HOT_LOG_INFO(TAG, "Station: {}", evt->header_value);
+            } else if (strcasecmp(evt->header_key, "Content-Type") == 0) {
+                // audio/aac, audio/aacp, audio/x-aac or audio/mpeg. Anything else (HLS playlists, MPEG-TS segments)
+                // leaves the codec alone, TS segments set it from their PMT. Ogg and FLAC streams (audio/ogg,
+                // application/ogg, audio/opus, audio/flac) say what they carry in their first packet
+                if (strcasestr(evt->header_value, "mpegurl")) {
+                    conn->playlist = true;
+                } else if (strcasestr(evt->header_value, "ogg") || strcasestr(evt->header_value, "opus") ||
+                           strcasestr(evt->header_value, "flac")) {
+                    conn->packetized = true;
+                } else if (strcasestr(evt->header_value, "aac")) {
+                    conn->codec = CODEC_AAC;
+                } else if (strcasestr(evt->header_value, "audio/mpeg")) {
+                    conn->codec = CODEC_MP3;
+                }
+                HOT_LOG_INFO(TAG, "Content-Type: {} ({})", evt->header_value,
+                             conn->playlist     ? "HLS"
+                             : conn->packetized ? "Ogg/FLAC"
+                                                : stream_frame::codec_name(conn->codec));
+            } else if (strcasecmp(evt->header_key, "icy-br") == 0) {
+                conn->meta.bitrate = atoi(evt->header_value);
+                conn->metadata.store(conn->meta);
+            } else if (strcasecmp(evt->header_key, "Accept-Ranges") == 0) {
+                conn->acceptRanges = strcasestr(evt->header_value, "bytes") != nullptr;
+            } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+                // bytes 1000-4999/5000, the total is what the index needs
+                const char* total = strchr(evt->header_value, '/');
+                if (total && total[1] != '*') {
+                    conn->fileSize = (uint32_t)strtoul(total + 1, nullptr, 10);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           Stream Data Handling                             */
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Bytes at the front of `data` to drop before it may go into the ring, all of them while resyncing
+ *
+ * After a reconnect the new body starts anywhere in a frame. Only whole frames are spliced in behind what's still
+ * buffered, the decoder's own resync then skips the old connection's truncated last frame.
+ */
+static size_t resync_skip(StreamConnection* conn, const uint8_t* data, size_t len)
+{
+    if (!conn->resync) {
+        return 0;
+    }
+    FrameHeader_t header;
+    int offset = stream_frame::find_frame(conn->codec, data, len, &header);
+    if (conn->onDemand) {
+        // Nothing of the range is in the ring yet, it begins at the frame
+        conn->rangeOffset += (offset < 0) ? len : (size_t)offset;
+    }
+    if (offset < 0) {
+        return len;
+    }
+    mclog::tagInfo(TAG, "Reconnected: resynced after {} bytes", offset);
+    conn->resync = false;
+    return (size_t)offset;
+}
+
+static void write_audio_data(StreamConnection* conn, const uint8_t* data, size_t len)
+{
+    size_t skip = resync_skip(conn, data, len);
+    data += skip;
+    len -= skip;
+
+    size_t written = conn->ringBuffer.write(data, len);
+    trace_ring_write(conn, written);
+    if (written > 0) {
+        stage_beat(STAGE_DEMUX, conn);
+    }
+    if (written < len) {
+        // Can't happen while http_stream_task waits for a full chunk of space before reading
+        HOT_LOG_WARN_EVERY(1000, TAG, "Ring buffer full! Dropping {} bytes", len - written);
+    }
+}
+
+static void trim_warm_ring(StreamConnection* conn)
+{
+    // Nobody reads a warm ring yet, so this task may drop the oldest bytes itself. Done under the mutex so
+    // promotion (which clears warm) can't race a discard once the decoder starts reading. The active stream never
+    // takes the mutex here, its buffer level is read straight from the ring by getRadioMetadata()
+    if (conn->warm && xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(10))) {
+        size_t level = conn->ringBuffer.available();
+        if (conn->warm && level > ZAP_BUFFER_SIZE) {
+            conn->ringBuffer.discard(level - ZAP_BUFFER_SIZE);
+        }
+        xSemaphoreGive(s_radio.mutex);
+    }
+}
+
+/**
+ * @brief Cut the ICY metadata out of freshly received bytes where they are, e.g. in the ring's write span
+ *
+ * @return length of the audio now at the front of `data`
+ */
+static size_t demux_in_place(StreamConnection* conn, uint8_t* data, size_t len)
+{
+    // Audio is only ever moved towards the front, behind the bytes the demuxer has already consumed. Metadata blocks
+    // may straddle any number of reads, the demuxer keeps its own copy
+    uint8_t* out = data;
+    conn->icy.feed(
+        data, len,
+        [&out](const uint8_t* audio, size_t n) {
+            if (out != audio) {
+                memmove(out, audio, n);
+            }
+            out += n;
+        },
+        [conn](const char* metadata, size_t n) { parse_icy_metadata(conn, metadata, n); });
+
+    size_t audioLen = out - data;
+    size_t skip     = resync_skip(conn, data, audioLen);
+    if (skip > 0 && skip < audioLen) {
+        memmove(data, data + skip, audioLen - skip);
+    }
+    return audioLen - skip;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              HTTP Transfer                                 */
+/* -------------------------------------------------------------------------- */
+// Bytes pulled from the socket per read. The task waits until the ring can take a whole chunk before reading, so
+// when the decoder falls behind the TCP receive window fills up and the server throttles instead of us dropping audio
+// A body read on a quiet socket comes back every HTTP_BODY_TIMEOUT_MS to see if the supervisor asked for a reconnect
+#define HTTP_READ_CHUNK      4096
+#define HTTP_TIMEOUT_MS      30000  // Connect and headers
+#define HTTP_BODY_TIMEOUT_MS 1000
+#define HTTP_CLOSED_READS    3  // Reads of nothing in a row, the read timeout comes back as EAGAIN instead
+
+static void set_radio_error(StreamConnection* conn)
+{
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        // A failing warm connection just isn't available for zapping
+        if (conn == s_radio.active && !conn->warm) {
+            set_radio_state(hal::HalBase::RADIO_ERROR);
+        }
+        xSemaphoreGive(s_radio.mutex);
+    }
+}
+
+static bool is_stopped(StreamConnection* conn, uint32_t myId)
+{
+    return conn->task.cancelled() || conn->id != myId;
+}
+
+/**
+ * @return false if the connection was stopped while sleeping
+ */
+static bool sleep_unless_stopped(StreamConnection* conn, uint32_t myId, uint32_t ms)
+{
+    uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    while (!is_stopped(conn, myId) && xTaskGetTickCount() * portTICK_PERIOD_MS - start < ms) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return !is_stopped(conn, myId);
+}
+
+/**
+ * @brief While WiFi reconnects there's no point in trying the stream, wait for the link or until `deadlineMs`
+ *
+ * @return false if the connection was stopped meanwhile
+ */
+static bool wait_for_wifi(StreamConnection* conn, uint32_t myId, uint32_t deadlineMs)
+{
+    while (!is_stopped(conn, myId) && GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED &&
+           (int32_t)(deadlineMs - xTaskGetTickCount() * portTICK_PERIOD_MS) > 0) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return !is_stopped(conn, myId);
+}
+
+/**
+ * @brief Back-pressure: wait until the decoder has made room for a read, or for a burst's worth in power save
+ *
+ * @return false on the timeout, call again
+ */
+static bool wait_for_room(StreamConnection* conn, uint32_t timeoutMs)
+{
+    RingBuffer& ring = conn->ringBuffer;
+    if (!conn->warm && wifi_power_save() && ring.freeSpace() < HTTP_READ_CHUNK) {
+        conn->draining = true;
+    }
+    size_t wanted = conn->draining ? std::min<size_t>(BURST_REFILL_BYTES, ring.capacity() / 2) : HTTP_READ_CHUNK;
+    if (stage_heard(conn) && ring.freeSpace() < wanted) {
+        // The decoder is behind, nothing upstream is stuck meanwhile
+        stage_idle(STAGE_TRANSPORT);
+        stage_idle(STAGE_DEMUX);
+    }
+    if (!ring.waitForSpace(wanted, timeoutMs)) {
+        // Power save may have ended meanwhile
+        conn->draining = conn->draining && wifi_power_save();
+        return false;
+    }
+    conn->draining = false;
+    return true;
+}
+
+/**
+ * @brief Pull the body of the open request into `onData(const uint8_t* data, size_t len)` until it returns false
+ *
+ * @param completed set when the server ended the body, as opposed to a stop request
+ */
+// Only the station being heard is traced, the warm one's reads would interleave with its spans
+static int traced_read(StreamConnection* conn, esp_http_client_handle_t client, uint8_t* buffer, size_t len)
+{
+    if (conn->warm) {
+        return esp_http_client_read(client, (char*)buffer, len);
+    }
+    stream_trace().record(TRACE_SOCKET_READ, TRACE_BEGIN, len);
+    int read = esp_http_client_read(client, (char*)buffer, len);
+    stream_trace().record(TRACE_SOCKET_READ, TRACE_END, read > 0 ? read : 0);
+    return read;
+}
+
+/**
+ * @brief A read of nothing: the end of a body whose length was known, or the server closing the connection. An
+ * Icecast stream has no Content-Length, every read after its close comes back empty and the body is never complete:
+ * that goes to the reconnect, rather than reading on at full speed
+ *
+ * @return ESP_OK to read on, ESP_FAIL for the close, ESP_OK with `completed` set for the end
+ */
+static esp_err_t read_nothing(esp_http_client_handle_t client, int* emptyReads, bool* completed)
+{
+    if (esp_http_client_is_complete_data_received(client)) {
+        *completed = true;
+        return ESP_OK;
+    }
+    if (++*emptyReads >= HTTP_CLOSED_READS || esp_http_client_get_errno(client) == ENOTCONN) {
+        mclog::tagWarn(TAG, "Server closed the stream");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+template <typename DataFn>
+static esp_err_t read_body(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client, uint8_t* chunk,
+                           bool* completed, DataFn onData)
+{
+    StageBody body;
+    *completed     = false;
+    int emptyReads = 0;
+    while (!is_stopped(conn, myId)) {
+        if (conn->reconnect.exchange(false)) {
+            return ESP_FAIL;
+        }
+        // Back-pressure: leave the bytes in the socket until the decoder has made room
+        if (!wait_for_room(conn, 1000)) {
+            continue;
+        }
+
+        stage_work(STAGE_TRANSPORT, conn);
+        int len = traced_read(conn, client, chunk, HTTP_READ_CHUNK);
+        if (len < 0) {
+            if (len == -ESP_ERR_HTTP_EAGAIN) {
+                continue;
+            }
+            return ESP_FAIL;
+        }
+        if (len == 0) {
+            esp_err_t err = read_nothing(client, &emptyReads, completed);
+            if (err != ESP_OK || *completed) {
+                return err;
+            }
+            continue;
+        }
+        emptyReads = 0;
+
+        conn->throughput.addBytes(xTaskGetTickCount() * portTICK_PERIOD_MS, len);
+        metric_received(conn, len);
+        stage_beat(STAGE_TRANSPORT, conn);
+        stage_work(STAGE_DEMUX, conn);
+        if (!onData(chunk, (size_t)len)) {
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief read_body() for Icecast streams without the staging buffer
+ *
+ * The socket is read straight into the ring's free span and the ICY metadata cut out in place, only the audio is
+ * committed. That saves a full copy of the stream into PSRAM.
+ */
+static esp_err_t receive_into_ring(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client,
+                                   bool* completed)
+{
+    RingBuffer& ring = conn->ringBuffer;
+    StageBody body;
+    *completed     = false;
+    int emptyReads = 0;
+    while (!is_stopped(conn, myId)) {
+        if (conn->seekTo.load() >= 0) {
+            return ESP_OK;  // run_stream() asks for the body from the target on
+        }
+        if (conn->reconnect.exchange(false)) {
+            return ESP_FAIL;
+        }
+        if (!wait_for_room(conn, 1000)) {
+            continue;
+        }
+
+        // The span ends at the wrap, the next read continues at the start of the storage
+        uint8_t* span;
+        size_t spanLen = ring.peekWrite(&span);
+        if (spanLen > HTTP_READ_CHUNK) {
+            spanLen = HTTP_READ_CHUNK;
+        }
+
+        stage_work(STAGE_TRANSPORT, conn);
+        int len = traced_read(conn, client, span, spanLen);
+        if (len < 0) {
+            if (len == -ESP_ERR_HTTP_EAGAIN) {
+                continue;
+            }
+            return ESP_FAIL;
+        }
+        if (len == 0) {
+            esp_err_t err = read_nothing(client, &emptyReads, completed);
+            if (err != ESP_OK || *completed) {
+                return err;
+            }
+            continue;
+        }
+        emptyReads = 0;
+
+        conn->throughput.addBytes(xTaskGetTickCount() * portTICK_PERIOD_MS, len);
+        metric_received(conn, len);
+        stage_beat(STAGE_TRANSPORT, conn);
+        stage_work(STAGE_DEMUX, conn);
+        size_t audio = demux_in_place(conn, span, (size_t)len);
+        ring.commitWrite(audio);
+        trace_ring_write(conn, audio);
+        if (audio > 0) {
+            stage_beat(STAGE_DEMUX, conn);
+        }
+        trim_warm_ring(conn);
+    }
+    return ESP_OK;
+}
+
+// A packet goes in whole. A chunk may demux into more than the room read_body() waited for, the rest is waited for
+// here, a stop drops it
+static void write_packet(StreamConnection* conn, uint32_t myId, const uint8_t* frame, size_t len)
+{
+    while (!conn->ringBuffer.waitForSpace(len, 200)) {
+        if (is_stopped(conn, myId)) {
+            return;
+        }
+    }
+    size_t written = conn->ringBuffer.write(frame, len);
+    trace_ring_write(conn, written);
+    stage_beat(STAGE_DEMUX, conn);
+}
+
+/**
+ * @brief read_body() for Ogg and FLAC streams: the packets go into the ring behind packet_frame headers
+ *
+ * Only whole packets are written, so a reconnect needs no resync. Icecast sends the stream headers again on every
+ * connect, the decoder just finds the same config.
+ */
+static esp_err_t receive_packets(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client,
+                                 uint8_t* chunk, bool* completed)
+{
+    if (!conn->packets.reset()) {
+        mclog::tagError(TAG, "No memory for the packet demuxer");
+        return ESP_ERR_NO_MEM;
+    }
+    conn->resync      = false;
+    uint32_t comments = 0;
+
+    esp_err_t err = read_body(conn, myId, client, chunk, completed, [&](const uint8_t* data, size_t len) {
+        conn->icy.feed(
+            data, len,
+            [&](const uint8_t* audio, size_t n) {
+                conn->packets.feed(
+                    audio, n,
+                    [&](const uint8_t* frame, size_t frameLen) {
+                        // Before the first config goes in, the decoder opens the codec it says
+                        StreamCodec_t codec = conn->packets.codec() == PacketDemuxer::CODEC_OPUS ? CODEC_OPUS
+                                                                                                 : CODEC_FLAC;
+                        if (conn->codec != codec) {
+                            conn->codec = codec;
+                        }
+                        if (conn->packets.comments() != comments) {
+                            // A new track's comments, its gain starts with the packets after them
+                            comments         = conn->packets.comments();
+                            TrackGain_t gain = conn->trackGain.load();
+                            gain.version++;
+                            gain.at    = conn->ringBuffer.writePosition();
+                            gain.known = conn->packets.trackGain(&gain.gainDb);
+                            conn->trackGain.store(gain);
+                        }
+                        write_packet(conn, myId, frame, frameLen);
+                    },
+                    [conn](const char* title) { set_stream_title(conn, title, strlen(title)); });
+            },
+            [conn](const char* metadata, size_t n) { parse_icy_metadata(conn, metadata, n); });
+        trim_warm_ring(conn);
+        return conn->packets.codec() != PacketDemuxer::CODEC_UNSUPPORTED;  // Vorbis, or no STREAMINFO
+    });
+    if (err == ESP_OK && conn->packets.codec() == PacketDemuxer::CODEC_UNSUPPORTED) {
+        err = ESP_ERR_NOT_SUPPORTED;
+    }
+    return err;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              HLS Transport                                 */
+/* -------------------------------------------------------------------------- */
+// Live HLS: the playlist is reloaded every target duration and new segments are fetched one after the other into
+// the same ring the decoder reads. The ring is the prefetch queue, back-pressure keeps up to ~16 seconds of segments
+// ahead of playback, and a segment that fails is retried or skipped without the decoder noticing.
+#define HLS_MAX_PLAYLIST_SIZE  (64 * 1024)
+#define HLS_LIVE_EDGE_SEGMENTS 3     // Start this far from the end of a live playlist, like most players
+#define HLS_SEGMENT_RETRIES    3     // Attempts per segment before skipping it
+#define HLS_PLAYLIST_RETRIES   5     // Failed reloads in a row before giving up on the stream
+#define HLS_TIMEOUT_MS         5000  // Per read, a stalled segment is retried rather than waited out
+
+static bool ends_with(const std::string& url, const char* suffix)
+{
+    std::string path = url.substr(0, url.find('?'));
+    size_t len       = strlen(suffix);
+    return path.size() >= len && strcasecmp(path.c_str() + path.size() - len, suffix) == 0;
+}
+
+static esp_err_t http_get(esp_http_client_handle_t client, const std::string& url)
+{
+    esp_http_client_set_url(client, url.c_str());
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (esp_http_client_fetch_headers(client) < 0) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        mclog::tagWarn(TAG, "HLS: HTTP {} for {}", status, url);
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Playlists are small, this doesn't need the ring's back-pressure
+static void read_text(esp_http_client_handle_t client, uint8_t* chunk, std::string* text)
+{
+    int len;
+    while ((len = esp_http_client_read(client, (char*)chunk, HTTP_READ_CHUNK)) > 0 &&
+           text->size() < HLS_MAX_PLAYLIST_SIZE) {
+        text->append((const char*)chunk, len);
+    }
+}
+
+/**
+ * @brief Fetch a media playlist, following a master playlist to its lowest bandwidth variant
+ *
+ * @param url the playlist URL, updated to the media playlist's so segment URIs resolve against it
+ */
+static esp_err_t fetch_playlist(esp_http_client_handle_t client, uint8_t* chunk, std::string* url,
+                                hls_playlist::Playlist_t* playlist)
+{
+    for (int depth = 0; depth < 2; depth++) {
+        esp_err_t err = http_get(client, *url);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        std::string text;
+        read_text(client, chunk, &text);
+        esp_http_client_close(client);
+
+        if (!hls_playlist::parse(text, playlist)) {
+            mclog::tagError(TAG, "HLS: not a playlist: {}", *url);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (!playlist->isMaster) {
+            return ESP_OK;
+        }
+
+        // Radio doesn't need adaptive bitrate, the cheapest variant leaves the most WiFi headroom
+        const hls_playlist::Variant_t* variant = nullptr;
+        for (const auto& v : playlist->variants) {
+            if (!variant || v.bandwidth < variant->bandwidth) {
+                variant = &v;
+            }
+        }
+        if (!variant) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        mclog::tagInfo(TAG, "HLS: variant {} bps ({})", variant->bandwidth, variant->codecs);
+        *url = hls_playlist::resolve_url(*url, variant->uri);
+    }
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+// ID3v2 tag (timestamps) at the start of packed audio segments
+static size_t id3_size(const uint8_t* data, size_t len)
+{
+    if (len < 10 || memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    size_t size = ((size_t)(data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) | ((data[8] & 0x7F) << 7) |
+                  (data[9] & 0x7F);
+    return 10 + size + ((data[5] & 0x10) ? 10 : 0);
+}
+
+static esp_err_t fetch_segment(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client, uint8_t* chunk,
+                               const std::string& url)
+{
+    // Packed audio says what it is by extension, Content-Type can still override it
+    if (ends_with(url, ".aac")) {
+        conn->codec = CODEC_AAC;
+    } else if (ends_with(url, ".mp3")) {
+        conn->codec = CODEC_MP3;
+    }
+
+    esp_err_t err = http_get(client, url);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    bool first     = true;
+    bool transport = false;
+    size_t skip    = 0;
+    conn->ts.reset();
+
+    bool completed = false;
+    err = read_body(conn, myId, client, chunk, &completed, [&](const uint8_t* data, size_t len) {
+        if (first) {
+            first     = false;
+            transport = data[0] == 0x47 && (len <= TsDemuxer::PACKET_SIZE || data[TsDemuxer::PACKET_SIZE] == 0x47);
+            skip      = transport ? 0 : id3_size(data, len);
+        }
+        if (skip > 0) {
+            size_t n = skip < len ? skip : len;
+            data += n;
+            len -= n;
+            skip -= n;
+        }
+
+        if (transport) {
+            conn->ts.feed(data, len, [conn](const uint8_t* audio, size_t n) {
+                StreamCodec_t codec = conn->ts.streamType() == TsDemuxer::STREAM_AAC ? CODEC_AAC : CODEC_MP3;
+                if (conn->codec != codec) {
+                    conn->codec = codec;
+                }
+                write_audio_data(conn, audio, n);
+            });
+        } else if (len > 0) {
+            write_audio_data(conn, data, len);
+        }
+        trim_warm_ring(conn);
+        return true;
+    });
+    esp_http_client_close(client);
+
+    if (err == ESP_OK && !completed && !is_stopped(conn, myId)) {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+/**
+ * @brief Stream an HLS playlist until it ends or the connection is stopped
+ *
+ * Each request opens and closes the connection, keep-alive reuse isn't relied upon.
+ *
+ * @param finished set when the playlist ended, there is nothing to reconnect to
+ */
+static esp_err_t stream_hls(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client, uint8_t* chunk,
+                            const std::string& url, bool* finished)
+{
+    esp_http_client_set_timeout_ms(client, HLS_TIMEOUT_MS);
+
+    std::string playlistUrl = url;
+    hls_playlist::Playlist_t playlist;
+    esp_err_t err = fetch_playlist(client, chunk, &playlistUrl, &playlist);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int64_t next = playlist.mediaSequence;
+    if (!playlist.endList && playlist.segments.size() > HLS_LIVE_EDGE_SEGMENTS) {
+        next += playlist.segments.size() - HLS_LIVE_EDGE_SEGMENTS;
+    }
+    mclog::tagInfo(TAG, "HLS: {} segments, target {}s, starting at #{}", playlist.segments.size(),
+                   playlist.targetDuration, next);
+
+    int playlistFailures = 0;
+    while (!is_stopped(conn, myId)) {
+        uint32_t loaded = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        bool fetched    = false;
+
+        for (const auto& segment : playlist.segments) {
+            if (is_stopped(conn, myId)) {
+                break;
+            }
+            if (segment.sequence < next) {
+                continue;
+            }
+
+            std::string url = hls_playlist::resolve_url(playlistUrl, segment.uri);
+            for (int attempt = 1;; attempt++) {
+                err = fetch_segment(conn, myId, client, chunk, url);
+                if (err == ESP_OK || is_stopped(conn, myId)) {
+                    break;
+                }
+                if (attempt >= HLS_SEGMENT_RETRIES) {
+                    mclog::tagWarn(TAG, "HLS: skipping segment #{} after {} attempts", segment.sequence, attempt);
+                    break;
+                }
+                mclog::tagWarn(TAG, "HLS: segment #{} failed ({}), retrying", segment.sequence, esp_err_to_name(err));
+                sleep_unless_stopped(conn, myId, 500 * attempt);
+            }
+            next    = segment.sequence + 1;
+            fetched = true;
+        }
+        if (is_stopped(conn, myId)) {
+            break;
+        }
+        if (playlist.endList) {
+            mclog::tagInfo(TAG, "HLS: end of playlist");
+            *finished = true;
+            return ESP_OK;
+        }
+
+        // RFC 8216 6.3.4: reload after a target duration, half that when the last reload had nothing new
+        uint32_t interval = (playlist.targetDuration > 0 ? playlist.targetDuration : 1) * 1000;
+        if (!fetched) {
+            interval /= 2;
+        }
+        uint32_t elapsed = xTaskGetTickCount() * portTICK_PERIOD_MS - loaded;
+        if (elapsed < interval && !sleep_unless_stopped(conn, myId, interval - elapsed)) {
+            break;
+        }
+
+        hls_playlist::Playlist_t reloaded;
+        err = fetch_playlist(client, chunk, &playlistUrl, &reloaded);
+        if (err != ESP_OK) {
+            // Keep the old playlist, the ring covers a few missed reloads
+            if (++playlistFailures >= HLS_PLAYLIST_RETRIES) {
+                return err;
+            }
+            mclog::tagWarn(TAG, "HLS: playlist reload failed ({}), retrying", esp_err_to_name(err));
+            continue;
+        }
+        playlistFailures = 0;
+        playlist         = reloaded;
+        if (next < playlist.mediaSequence) {
+            mclog::tagWarn(TAG, "HLS: fell behind the live window, jumping {} segments", playlist.mediaSequence - next);
+            next = playlist.mediaSequence;
+        }
+    }
+    return ESP_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              URL Resolver                                  */
+/* -------------------------------------------------------------------------- */
+// Station URLs may be .pls/.m3u playlists or redirect to a load-balanced mirror. The mirror that actually streamed
+// is cached per station in NVS, so the next start connects to it directly instead of paying those hops again
+#define URL_CACHE_NAMESPACE "radio_urls"
+#define URL_CACHE_TTL_S     (24 * 3600)
+#define URL_CACHE_MAX_LEN   256
+#define MAX_REDIRECTS       5
+#define MAX_CANDIDATES      16  // Bounds playlists pointing at playlists
+
+// NVS keys are limited to 15 characters, so stations are keyed by a hash of their URL
+static std::string url_cache_key(const std::string& url)
+{
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (char c : url) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    char key[16];
+    snprintf(key, sizeof(key), "u%08lx", (unsigned long)hash);
+    return key;
+}
+
+/**
+ * @param expires set to when the entry expires, can be null
+ * @return false if there is no entry, or it expired
+ */
+static bool url_cache_load(const std::string& url, std::string* resolved, time_t* expires = nullptr)
+{
+    nvs_handle_t handle;
+    if (nvs_open(URL_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    // Stored as "<expiry> <url>"
+    char value[URL_CACHE_MAX_LEN + 24] = {0};
+    size_t len                         = sizeof(value);
+    esp_err_t ret                      = nvs_get_str(handle, url_cache_key(url).c_str(), value, &len);
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        return false;
+    }
+
+    char* space = strchr(value, ' ');
+    time_t now  = time(nullptr);
+    if (!space || !time_is_valid(now) || (time_t)atoll(value) < now) {
+        return false;
+    }
+    if (expires) {
+        *expires = (time_t)atoll(value);
+    }
+    *resolved = space + 1;
+    return true;
+}
+
+static void url_cache_store(const std::string& url, const std::string& resolved)
+{
+    time_t now = time(nullptr);
+    if (!time_is_valid(now) || resolved.size() > URL_CACHE_MAX_LEN) {
+        return;
+    }
+
+    // Save flash wear: only rewrite an entry that changed or has used up half its TTL
+    std::string cached;
+    time_t expires;
+    if (url_cache_load(url, &cached, &expires) && cached == resolved && expires - now > URL_CACHE_TTL_S / 2) {
+        return;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(URL_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    std::string value = std::to_string((long long)(now + URL_CACHE_TTL_S)) + " " + resolved;
+    nvs_set_str(handle, url_cache_key(url).c_str(), value.c_str());
+    nvs_commit(handle);
+    nvs_close(handle);
+    mclog::tagInfo(TAG, "Cached stream URL: {} -> {}", url, resolved);
+}
+
+static void url_cache_erase(const std::string& url)
+{
+    nvs_handle_t handle;
+    if (nvs_open(URL_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_erase_key(handle, url_cache_key(url).c_str());
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief Replace the station playlist at `candidates[index]` with the mirrors it lists
+ */
+static esp_err_t expand_station_playlist(esp_http_client_handle_t client, uint8_t* chunk,
+                                         std::vector<std::string>* candidates, size_t index)
+{
+    std::string url = (*candidates)[index];
+    esp_err_t err   = http_get(client, url);
+    if (err != ESP_OK) {
+        return err;
+    }
+    std::string text;
+    read_text(client, chunk, &text);
+    esp_http_client_close(client);
+
+    std::vector<std::string> mirrors = station_playlist::parse(text);
+    if (mirrors.empty()) {
+        mclog::tagError(TAG, "No streams in playlist: {}", url);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (candidates->size() - 1 + mirrors.size() > MAX_CANDIDATES) {
+        mirrors.resize(MAX_CANDIDATES - (candidates->size() - 1));
+    }
+    mclog::tagInfo(TAG, "Playlist {}: {} stream(s), first {}", url, mirrors.size(), mirrors[0]);
+
+    candidates->erase(candidates->begin() + index);
+    candidates->insert(candidates->begin() + index, mirrors.begin(), mirrors.end());
+    return ESP_OK;
+}
+
+static bool is_redirect(int status)
+{
+    return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Mirror Ranking                                */
+/* -------------------------------------------------------------------------- */
+// SomaFM serves every stream from each of its ice* hosts. While nothing streams, a low priority task probes each
+// mirror with a short GET (time to first byte, then the speed of the first few KB) and keeps a rolling average per
+// mirror. A station start tries the fastest healthy mirror first. Probes run one at a time, PROBE_GAP_MS apart,
+// and stop for as long as the radio plays, so they never compete with a stream for airtime
+#define PROBE_INTERVAL_MS  (10 * 60 * 1000)  // Between rounds over all mirrors
+#define PROBE_GAP_MS       2000              // Between two probes
+#define PROBE_BYTES        (16 * 1024)       // Read per probe, the server's burst-on-connect
+#define PROBE_TIMEOUT_MS   3000
+#define PROBE_SCORE_BYTES  (32 * 1024)       // Ranked by the time to get about a prebuffer's worth
+#define PROBE_EWMA_WEIGHT  0.3f              // Of the newest sample
+#define PROBE_MAX_FAILURES 2                 // In a row, then the mirror isn't picked until a probe succeeds
+
+// Hosts that serve the same paths, a station URL on one of them works on any other
+static const char* const MIRROR_HOSTS[] = {
+    "ice1.somafm.com", "ice2.somafm.com", "ice4.somafm.com", "ice5.somafm.com", "ice6.somafm.com",
+};
+
+struct MirrorStats_t {
+    std::string host;
+    float ttfbMs       = 0;  // Rolling averages, 0 until a probe succeeded
+    float bytesPerS    = 0;
+    int failures       = 0;  // In a row, from probes and from real streams
+    uint32_t lastProbe = 0;
+};
+
+static std::vector<MirrorStats_t> s_mirrors;  // Guarded by s_mirror_mutex
+static std::string s_probe_path;              // A stream every mirror has, from the station list
+static SemaphoreHandle_t s_mirror_mutex = nullptr;
+static TaskHandle_t s_probe_task        = nullptr;
+
+static std::string url_host(const std::string& url)
+{
+    size_t start = url.find("://");
+    start        = (start == std::string::npos) ? 0 : start + 3;
+    size_t end   = url.find_first_of(":/?", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+static bool is_mirror_host(const std::string& host)
+{
+    for (const char* mirror : MIRROR_HOSTS) {
+        if (host == mirror) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string with_host(const std::string& url, const std::string& host)
+{
+    std::string old = url_host(url);
+    size_t at       = url.find(old);
+    return url.substr(0, at) + host + url.substr(at + old.size());
+}
+
+static float mirror_score(const MirrorStats_t& mirror)
+{
+    return mirror.ttfbMs + 1000.0f * PROBE_SCORE_BYTES / mirror.bytesPerS;
+}
+
+/**
+ * @brief `url` on the fastest healthy mirror, `url` itself if it isn't on a mirror or nothing was probed yet
+ */
+static std::string mirror_pick(const std::string& url)
+{
+    if (!s_mirror_mutex || !is_mirror_host(url_host(url))) {
+        return url;
+    }
+    const MirrorStats_t* best = nullptr;
+    std::string host;
+    if (xSemaphoreTake(s_mirror_mutex, portMAX_DELAY)) {
+        for (const auto& mirror : s_mirrors) {
+            if (mirror.failures < PROBE_MAX_FAILURES && mirror.bytesPerS > 0 &&
+                (!best || mirror_score(mirror) < mirror_score(*best))) {
+                best = &mirror;
+            }
+        }
+        if (best) {
+            host = best->host;
+            mclog::tagInfo(TAG, "Fastest mirror: {} ({:.0f} ms to first byte, {:.0f} KB/s)", host, best->ttfbMs,
+                           best->bytesPerS / 1024);
+        }
+        xSemaphoreGive(s_mirror_mutex);
+    }
+    return host.empty() ? url : with_host(url, host);
+}
+
+/**
+ * @brief A probe's or a stream's outcome on the mirror serving `url`, the averages only take probe samples
+ */
+static void mirror_report(const std::string& url, bool ok, float ttfbMs = 0, float bytesPerS = 0)
+{
+    if (!s_mirror_mutex || !xSemaphoreTake(s_mirror_mutex, portMAX_DELAY)) {
+        return;
+    }
+    std::string host = url_host(url);
+    for (auto& mirror : s_mirrors) {
+        if (mirror.host != host) {
+            continue;
+        }
+        mirror.failures = ok ? 0 : mirror.failures + 1;
+        if (ok && bytesPerS > 0) {
+            // The first sample is taken as is, an average from 0 would take several rounds to mean anything
+            bool first   = mirror.bytesPerS == 0;
+            auto average = [first](float avg, float sample) {
+                return first ? sample : avg + PROBE_EWMA_WEIGHT * (sample - avg);
+            };
+            mirror.ttfbMs    = average(mirror.ttfbMs, ttfbMs);
+            mirror.bytesPerS = average(mirror.bytesPerS, bytesPerS);
+        }
+    }
+    xSemaphoreGive(s_mirror_mutex);
+}
+
+static void probe_mirror(const std::string& url, uint8_t* chunk)
+{
+    esp_http_client_config_t config = {};
+    config.url                      = url.c_str();
+    config.timeout_ms               = PROBE_TIMEOUT_MS;
+    config.buffer_size              = 2048;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return;
+    }
+    esp_http_client_set_header(client, "User-Agent", "Tab5-WebRadio/1.0");
+
+    uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t ttfb  = 0;
+    size_t total   = 0;
+
+    bool ok = esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0 &&
+              esp_http_client_get_status_code(client) == 200;
+    if (ok) {
+        ttfb = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
+        while (total < PROBE_BYTES) {
+            int len = esp_http_client_read(client, (char*)chunk, HTTP_READ_CHUNK);
+            if (len <= 0) {
+                break;
+            }
+            total += len;
+        }
+        ok = total >= PROBE_BYTES;
+    }
+    uint32_t elapsed = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    float bytesPerS = ok && elapsed > ttfb ? total * 1000.0f / (elapsed - ttfb) : 0;
+    mirror_report(url, ok, ttfb, bytesPerS);
+    mclog::tagInfo(TAG, "Probe {}: {}, {} ms to first byte, {:.0f} KB/s", url_host(url), ok ? "ok" : "failed", ttfb,
+                   bytesPerS / 1024);
+}
+
+static bool radio_streaming()
+{
+    return s_radio.audioTask.running();
+}
+
+static void probe_task(void* param)
+{
+    uint8_t* chunk = (uint8_t*)malloc(HTTP_READ_CHUNK);
+    while (chunk) {
+        // The mirror probed longest ago first, so a round cut short by a stream carries on where it stopped
+        std::string url;
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        if (!radio_streaming() && GetHAL()->getWifiState() == hal::HalBase::WIFI_CONNECTED &&
+            xSemaphoreTake(s_mirror_mutex, portMAX_DELAY)) {
+            MirrorStats_t* next = nullptr;
+            for (auto& mirror : s_mirrors) {
+                bool due = mirror.lastProbe == 0 || now - mirror.lastProbe >= PROBE_INTERVAL_MS;
+                if (due && (!next || now - mirror.lastProbe > now - next->lastProbe)) {
+                    next = &mirror;
+                }
+            }
+            if (next && !s_probe_path.empty()) {
+                next->lastProbe = now ? now : 1;
+                url             = "http://" + next->host + s_probe_path;
+            }
+            xSemaphoreGive(s_mirror_mutex);
+        }
+        if (!url.empty()) {
+            probe_mirror(url, chunk);
+        }
+        vTaskDelay(pdMS_TO_TICKS(PROBE_GAP_MS));
+    }
+    s_probe_task = nullptr;
+    task_topology::exit();
+}
+
+/**
+ * @brief Mirrors to keep ranked, from the station URLs. Starts the probe task the first time there are some
+ */
+static void mirror_set_stations(const std::vector<std::string>& urls)
+{
+    if (!s_mirror_mutex) {
+        s_mirror_mutex = xSemaphoreCreateMutex();
+        if (!s_mirror_mutex) {
+            return;
+        }
+    }
+
+    std::string path;
+    for (const auto& url : urls) {
+        std::string host = url_host(url);
+        if (is_mirror_host(host)) {
+            path = url.substr(url.find(host) + host.size());
+            break;
+        }
+    }
+    if (path.empty()) {
+        return;
+    }
+
+    if (xSemaphoreTake(s_mirror_mutex, portMAX_DELAY)) {
+        s_probe_path = path;
+        if (s_mirrors.empty()) {
+            for (const char* host : MIRROR_HOSTS) {
+                s_mirrors.push_back({host});
+            }
+        }
+        xSemaphoreGive(s_mirror_mutex);
+    }
+    if (!s_probe_task &&
+        task_topology::create(task_topology::RADIO_PROBE, probe_task, nullptr, &s_probe_task) != pdPASS) {
+        s_probe_task = nullptr;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Address Race                                 */
+/* -------------------------------------------------------------------------- */
+// A mirror name resolves to several addresses, and the HTTP client only tries the first one, for up to its 30 s
+// timeout. Before a plain HTTP stream connects, a TCP connect races the first RACE_ADDRESSES addresses. They start
+// RACE_STAGGER_MS apart, alternating IPv6 and IPv4 (RFC 8305), and one that fails starts the next at once. The HTTP
+// client then connects to the first address that answered, with the name in the Host header. An address that went
+// on to deliver audio is kept per host in the URL resolver cache and gets the head start next time, so on a healthy
+// mirror the race is over with its first handshake. HTTPS connects by name, an address in its URL would fail the
+// certificate check
+#define RACE_ADDRESSES  3
+#define RACE_STAGGER_MS 250
+#define RACE_TIMEOUT_MS 3000  // For all of them, then the HTTP client connects by name as before
+
+struct RaceAddress_t {
+    sockaddr_storage addr;
+    socklen_t len;
+    std::string text;  // As it goes in a URL, IPv6 in brackets
+};
+
+// The resolver cache entry, by host and port
+static std::string race_key(const std::string& host, const std::string& port)
+{
+    return "tcp://" + host + ":" + port;
+}
+
+static std::string url_port(const std::string& url, const std::string& host)
+{
+    size_t at = url.find(host) + host.size();
+    if (at < url.size() && url[at] == ':') {
+        return url.substr(at + 1, url.find_first_of("/?", at) - at - 1);
+    }
+    return "80";
+}
+
+/**
+ * @brief Up to RACE_ADDRESSES of `host`'s addresses in the order they're tried: `preferred` first if it's one of
+ * them, then the families taking turns
+ */
+static std::vector<RaceAddress_t> race_resolve(const std::string& host, const std::string& port,
+                                               const std::string& preferred)
+{
+    struct addrinfo hints = {};
+    hints.ai_family       = AF_UNSPEC;
+    hints.ai_socktype     = SOCK_STREAM;
+    struct addrinfo* res  = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        return {};
+    }
+    std::vector<RaceAddress_t> v4, v6;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        RaceAddress_t address = {};
+        char text[INET6_ADDRSTRLEN];
+        if (ai->ai_family == AF_INET) {
+            inet_ntop(AF_INET, &((sockaddr_in*)ai->ai_addr)->sin_addr, text, sizeof(text));
+            address.text = text;
+        } else if (ai->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((sockaddr_in6*)ai->ai_addr)->sin6_addr, text, sizeof(text));
+            address.text = std::string("[") + text + "]";
+        } else {
+            continue;
+        }
+        memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+        address.len = ai->ai_addrlen;
+        (ai->ai_family == AF_INET ? v4 : v6).push_back(address);
+    }
+    freeaddrinfo(res);
+
+    std::vector<RaceAddress_t> order;
+    for (size_t i = 0; i < std::max(v4.size(), v6.size()); i++) {
+        if (i < v6.size()) {
+            order.push_back(v6[i]);
+        }
+        if (i < v4.size()) {
+            order.push_back(v4[i]);
+        }
+    }
+    auto cached = std::find_if(order.begin(), order.end(), [&](const auto& a) { return a.text == preferred; });
+    if (cached != order.end()) {
+        std::rotate(order.begin(), cached, cached + 1);
+    }
+    if (order.size() > RACE_ADDRESSES) {
+        order.resize(RACE_ADDRESSES);
+    }
+    return order;
+}
+
+/**
+ * @brief `url` with its host replaced by the address that took a TCP connect first
+ *
+ * @param winner set to that address, for race_remember() once it delivered
+ * @return `url` itself if it isn't plain HTTP, its host has a single address or none answered in time
+ */
+static std::string race_addresses(StreamConnection* conn, uint32_t myId, const std::string& url, std::string* winner)
+{
+    winner->clear();
+    std::string host = url_host(url);
+    if (url.compare(0, 7, "http://") != 0 || host.empty()) {
+        return url;
+    }
+    std::string port = url_port(url, host);
+    std::string preferred;
+    url_cache_load(race_key(host, port), &preferred);
+    std::vector<RaceAddress_t> addresses = race_resolve(host, port, preferred);
+    if (addresses.size() < 2) {
+        return url;  // Nothing to race, an address literal among them
+    }
+
+    int fds[RACE_ADDRESSES];
+    std::fill(std::begin(fds), std::end(fds), -1);
+    int started    = 0;
+    int won        = -1;
+    uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t next  = 0;  // Into the race, when the next address starts
+    while (won < 0 && !is_stopped(conn, myId)) {
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
+        if (now >= RACE_TIMEOUT_MS) {
+            break;
+        }
+        if (started < (int)addresses.size() && now >= next) {
+            const RaceAddress_t& address = addresses[started];
+            int fd                       = socket(address.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                if (connect(fd, (const sockaddr*)&address.addr, address.len) == 0) {
+                    won = started;
+                } else if (errno != EINPROGRESS) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            fds[started++] = fd;
+            next           = fd >= 0 ? now + RACE_STAGGER_MS : now;
+            continue;
+        }
+
+        fd_set writable;
+        FD_ZERO(&writable);
+        int maxFd = -1;
+        for (int i = 0; i < started; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &writable);
+                maxFd = std::max(maxFd, fds[i]);
+            }
+        }
+        bool more = started < (int)addresses.size();
+        if (maxFd < 0 && !more) {
+            break;  // All refused
+        }
+        // Wakes for the next start, and at least every stagger to notice a stop
+        uint32_t wait = std::min<uint32_t>(more ? next - now : RACE_TIMEOUT_MS - now, RACE_STAGGER_MS);
+        if (maxFd < 0) {
+            vTaskDelay(pdMS_TO_TICKS(wait));
+            continue;
+        }
+        struct timeval timeout = {(time_t)(wait / 1000), (suseconds_t)(wait % 1000) * 1000};
+        if (select(maxFd + 1, nullptr, &writable, nullptr, &timeout) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < started && won < 0; i++) {
+            if (fds[i] < 0 || !FD_ISSET(fds[i], &writable)) {
+                continue;
+            }
+            int error       = 0;
+            socklen_t size  = sizeof(error);
+            getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &error, &size);
+            if (error == 0) {
+                won = i;
+            } else {
+                close(fds[i]);
+                fds[i] = -1;
+                next   = 0;  // Refused, the next one goes now
+            }
+        }
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (won < 0) {
+        mclog::tagWarn(TAG, "No address of {} answered within {} ms, connecting by name", host, RACE_TIMEOUT_MS);
+        return url;
+    }
+
+    *winner = addresses[won].text;
+    mclog::tagInfo(TAG, "{} answered first of {} addresses of {} after {} ms", *winner, started, host,
+                   xTaskGetTickCount() * portTICK_PERIOD_MS - start);
+    size_t at = url.find(host);
+    return url.substr(0, at) + *winner + url.substr(at + host.size());
+}
+
+// `address` streamed audio for `url`'s host, it goes first next time, after a restart too
+static void race_remember(const std::string& url, const std::string& address)
+{
+    std::string host = url_host(url);
+    url_cache_store(race_key(host, url_port(url, host)), address);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           On-Demand Transport                              */
+/* -------------------------------------------------------------------------- */
+// A podcast or archive URL is a file: the server says how long it is and serves byte ranges of it. It's played like a
+// stream, fetched only as far ahead as the ring reaches. A seek to a part that isn't buffered reconnects with a Range
+// request from the target's offset, a dropped connection resumes at the byte after the last one received, without a
+// resync. The decoder keeps the seek index, see On-Demand Position
+#define ONDEMAND_END_POLL_MS 50
+
+// File offset of the byte at ring position `pos`
+static int64_t ondemand_offset(StreamConnection* conn, size_t pos)
+{
+    return (int64_t)conn->rangeOffset.load() + (ptrdiff_t)(pos - conn->rangeStart.load());
+}
+
+/**
+ * @brief Ask for the body from the decoder's seek target, or from where the last response left off
+ *
+ * @return the offset asked for, -1 for the whole file
+ */
+static int64_t ondemand_request(StreamConnection* conn, esp_http_client_handle_t client)
+{
+    if (!conn->onDemand) {
+        esp_http_client_delete_header(client, "Range");
+        return -1;
+    }
+    int64_t seek = conn->seekTo.load();
+    int64_t from = (seek >= 0) ? seek : ondemand_offset(conn, conn->ringBuffer.writePosition());
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%lld-", (long long)from);
+    esp_http_client_set_header(client, "Range", range);
+    return from;
+}
+
+// Once the response's headers are in, before any of its body
+static void ondemand_response(StreamConnection* conn, esp_http_client_handle_t client, int status, int64_t from)
+{
+    int64_t length = esp_http_client_get_content_length(client);
+    bool file      = !conn->playlist && !conn->packetized && conn->icy.metaInt() == 0 && !conn->following;
+    if (from >= 0 && status == 206) {
+        conn->rangeOffset = (uint32_t)from;
+        conn->resync      = conn->seekTo.load() >= 0;  // A seek lands anywhere in a frame, a resume right after one
+    } else if (from < 0 && status == 200 && file && conn->acceptRanges && length > 0 && length <= UINT32_MAX) {
+        mclog::tagInfo(TAG, "On demand: {} KB, seekable", length / 1024);
+        conn->onDemand    = true;
+        conn->fileSize    = (uint32_t)length;
+        conn->rangeOffset = 0;
+    } else {
+        if (from >= 0) {
+            mclog::tagWarn(TAG, "On demand: Range answered with {}, playing on like a live stream", status);
+        }
+        conn->onDemand = false;
+    }
+    conn->rangeStart = conn->ringBuffer.writePosition();
+    conn->seekTo     = -1;  // Last, the decoder drops what's in the ring before rangeStart
+}
+
+/**
+ * @brief Read to the end of the file: let the decoder play out the ring, but stay for a seek back into it
+ *
+ * @return true if a seek came, false if stopped meanwhile or the decoder is done
+ */
+static bool ondemand_wait_for_seek(StreamConnection* conn, uint32_t myId)
+{
+    mclog::tagInfo(TAG, "On demand: received to the end");
+    conn->ended = true;
+    conn->ringBuffer.wakeAll();
+    while (!is_stopped(conn, myId) && s_radio.audioTask.running()) {
+        if (conn->seekTo.load() >= 0) {
+            conn->ended = false;
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(ONDEMAND_END_POLL_MS));
+    }
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           HTTP Streaming Task                              */
+/* -------------------------------------------------------------------------- */
+#define RECONNECT_MIN_MS 250
+#define RECONNECT_MAX_MS 8000
+
+/**
+ * @brief One connection to the stream at `url`, until it drops or is stopped
+ *
+ * @param finished set when the stream ended for good (an HLS playlist with an end), as opposed to dropping
+ */
+static esp_err_t run_stream(StreamConnection* conn, uint32_t myId, esp_http_client_handle_t client, uint8_t* chunk,
+                            const std::string& url, bool* finished)
+{
+    *finished = false;
+    conn->icy.reset(0);  // Until this response's icy-metaint says otherwise
+    conn->playlist     = false;
+    conn->packetized   = false;
+    conn->acceptRanges = false;
+
+    if (ends_with(url, ".m3u8")) {
+        return stream_hls(conn, myId, client, chunk, url, finished);
+    }
+
+    // Open the connection and parse headers (icy-* headers arrive through http_event_handler)
+    mclog::tagInfo(TAG, "HTTP client opening connection to {}", url);
+    std::string winner;
+    std::string target = race_addresses(conn, myId, url, &winner);
+    esp_http_client_set_url(client, target.c_str());
+    if (!winner.empty()) {
+        // The URL sets it to the address, a redirect's sets it again
+        std::string host = url_host(url);
+        std::string port = url_port(url, host);
+        esp_http_client_set_header(client, "Host", (port == "80" ? host : host + ":" + port).c_str());
+    }
+    int64_t from  = ondemand_request(conn, client);
+    esp_err_t err = ESP_OK;
+    int status    = 0;
+    for (int redirects = 0;; redirects++) {
+        err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (esp_http_client_fetch_headers(client) < 0) {
+            esp_http_client_close(client);
+            return ESP_FAIL;
+        }
+        status = esp_http_client_get_status_code(client);
+        if (!is_redirect(status)) {
+            break;
+        }
+        if (redirects >= MAX_REDIRECTS) {
+            mclog::tagError(TAG, "Too many redirects");
+            esp_http_client_close(client);
+            return ESP_FAIL;
+        }
+        // Unlike esp_http_client_perform(), open/fetch_headers leave following the Location header to us
+        esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+    }
+    mclog::tagInfo(TAG, "HTTP status: {}", status);
+    if (status >= 400) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+
+    // This one answered, remember where the hops ended up
+    std::string resolved            = url;
+    char buf[URL_CACHE_MAX_LEN + 1] = {0};
+    if (esp_http_client_get_url(client, buf, sizeof(buf)) == ESP_OK && buf[0] != '\0') {
+        resolved = buf;
+    }
+    if (resolved == target) {
+        resolved = url;  // Not the address it raced to
+    }
+    if (resolved != conn->url && !conn->following) {
+        url_cache_store(conn->url, resolved);
+    }
+
+    if (conn->playlist) {
+        // Served as an HLS playlist without the .m3u8 extension
+        esp_http_client_close(client);
+        return stream_hls(conn, myId, client, chunk, resolved, finished);
+    }
+    ondemand_response(conn, client, status, from);
+
+    // Pull the body - this blocks while streaming
+    bool completed  = false;
+    size_t received = conn->ringBuffer.writePosition();
+    esp_http_client_set_timeout_ms(client, HTTP_BODY_TIMEOUT_MS);
+    if (conn->packetized) {
+        err = receive_packets(conn, myId, client, chunk, &completed);
+    } else {
+        err = receive_into_ring(conn, myId, client, &completed);
+    }
+    esp_http_client_close(client);
+    esp_http_client_set_timeout_ms(client, HTTP_TIMEOUT_MS);
+    if (!winner.empty() && conn->ringBuffer.writePosition() != received) {
+        race_remember(url, winner);
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        // Another mirror won't have it in another codec
+        mclog::tagError(TAG, "Ogg stream with a codec other than Opus or FLAC, not supported");
+        set_radio_error(conn);
+        *finished = true;
+        return err;
+    }
+    if (err == ESP_OK && completed && !is_stopped(conn, myId)) {
+        if (conn->onDemand) {
+            *finished = !ondemand_wait_for_seek(conn, myId);
+        } else {
+            mclog::tagWarn(TAG, "HTTP stream ended by the server (unexpected for live stream!)");
+        }
+    }
+    return err;
+}
+
+#if CONFIG_TAB5_MULTIROOM_SYNC
+// Slots are reused, the task's stream number tells their followings apart
+static uint64_t sync_owner(StreamConnection* conn, uint32_t myId)
+{
+    return ((uint64_t)(uintptr_t)conn << 32) | myId;
+}
+#endif
+
+// A client keeps the TLS session of its last handshake and resumes it on its next connect, an abbreviated handshake
+// without the certificate chain or the key exchange. A stream task's client is parked here when the task ends, by the
+// host it last streamed from, and the next task for that host picks it up: switching between stations on the same
+// mirror then resumes too. Only verified clients are parked, the clock doesn't go back to invalid
+#define TLS_PARKED_CLIENTS 2
+
+struct ParkedClient_t {
+    std::string host;
+    esp_http_client_handle_t client;
+};
+
+static std::mutex s_parked_mutex;
+static std::deque<ParkedClient_t> s_parked;  // Oldest first
+
+static esp_http_client_handle_t tls_client_take(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(s_parked_mutex);
+    for (auto it = s_parked.begin(); it != s_parked.end(); ++it) {
+        if (it->host == host) {
+            esp_http_client_handle_t client = it->client;
+            s_parked.erase(it);
+            return client;
+        }
+    }
+    return nullptr;
+}
+
+static void tls_client_park(const std::string& host, esp_http_client_handle_t client)
+{
+    esp_http_client_handle_t evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_parked_mutex);
+        if (s_parked.size() >= TLS_PARKED_CLIENTS) {
+            evicted = s_parked.front().client;
+            s_parked.pop_front();
+        }
+        s_parked.push_back({host, client});
+    }
+    if (evicted) {
+        esp_http_client_cleanup(evicted);
+    }
+}
+
+static void http_stream_task(void* param)
+{
+    StreamConnection* conn = (StreamConnection*)param;
+
+    // Capture the connection ID for this task - used to ignore data from stale tasks
+    uint32_t myId = conn->id;
+    mclog::tagInfo(TAG, "HTTP stream task started for: {} (stream #{}{})", conn->url, myId, conn->warm ? ", warm" : "");
+
+    // Check if URL is HTTPS or HTTP
+    bool is_https = conn->url.find("https://") == 0;
+
+    esp_http_client_config_t config = {};
+    config.url                      = conn->url.c_str();
+    config.event_handler            = http_event_handler;
+    config.user_data                = conn;
+    config.buffer_size              = 4096;
+    config.timeout_ms               = HTTP_TIMEOUT_MS;
+    config.keep_alive_enable        = true;
+
+    // Certificates are checked against the bundle once the clock can tell an expired one, before SNTP got through on
+    // an RTC that lost its battery they can't be: the streams are public, playing beats refusing
+    bool verified = is_https && system_time_valid();
+    if (verified) {
+        config.crt_bundle_attach = esp_crt_bundle_attach;
+    } else if (is_https) {
+        mclog::tagWarn(TAG, "Clock not set yet, not checking the stream's certificate");
+        config.skip_cert_common_name_check = true;
+        config.use_global_ca_store         = false;
+        config.crt_bundle_attach           = NULL;
+        config.cert_pem                    = NULL;
+    }
+    // Reconnects resume the TLS session instead of a full handshake
+    config.save_client_session = is_https;
+
+    // Where the first attempt goes, then wherever the last one went
+    std::string host                = url_host(mirror_pick(conn->url));
+    esp_http_client_handle_t client = verified ? tls_client_take(host) : nullptr;
+    if (client) {
+        mclog::tagInfo(TAG, "Picking up the TLS session with {}", host);
+        esp_http_client_set_user_data(client, conn);
+    } else {
+        client = esp_http_client_init(&config);
+    }
+    uint8_t* chunk = (uint8_t*)internal_pool().alloc(HTTP_READ_CHUNK);
+    if (!client || !chunk) {
+        mclog::tagError(TAG, "Failed to init HTTP client");
+        set_radio_error(conn);
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        internal_pool().free(chunk);
+        return;
+    }
+
+    // Set ICY metadata request header
+    esp_http_client_set_header(client, "Icy-MetaData", "1");
+    esp_http_client_set_header(client, "User-Agent", "Tab5-WebRadio/1.0");
+
+    // A dropped connection is retried with exponential backoff while the decoder keeps playing what's buffered,
+    // only MAX_STALL_SECONDS without any new data make it an error
+    // Candidates: the cached mirror first, then the station URL. Playlists are expanded into their mirrors when
+    // it's their turn, a connection that doesn't get going moves on to the next candidate
+    // The fastest probed mirror goes ahead of both, the others are still there if it fails
+    std::vector<std::string> candidates;
+    std::string cached;
+    std::string fastest = mirror_pick(conn->url);
+    if (fastest != conn->url) {
+        candidates.push_back(fastest);
+    }
+    if (url_cache_load(conn->url, &cached) && cached != fastest) {
+        mclog::tagInfo(TAG, "Using cached stream URL: {}", cached);
+        candidates.push_back(cached);
+    }
+    candidates.push_back(conn->url);
+    size_t candidate = 0;
+
+    esp_err_t err     = ESP_OK;
+    bool finished     = false;
+    uint32_t backoff  = RECONNECT_MIN_MS;
+    uint32_t lastData = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    for (int attempt = 0; !is_stopped(conn, myId); attempt++) {
+        if (attempt > 0) {
+            mclog::tagWarn(TAG, "Reconnecting in {} ms (attempt {})", backoff, attempt);
+            s_metric_reconnects.inc();
+            if (!sleep_unless_stopped(conn, myId, backoff)) {
+                break;
+            }
+            conn->resync = true;
+        }
+
+        // A sync master playing the station goes ahead of every mirror, on each attempt
+        std::string relay;
+#if CONFIG_TAB5_MULTIROOM_SYNC
+        conn->following = !conn->warm && sync_follow(conn->url, sync_owner(conn, myId), &relay);
+#endif
+        uint32_t samples = conn->throughput.samples.load();
+        err              = ESP_OK;
+        if (!conn->following && station_playlist::is_playlist_url(candidates[candidate])) {
+            err = expand_station_playlist(client, chunk, &candidates, candidate);
+        }
+        if (err == ESP_OK) {
+            if (!conn->following) {
+                host = url_host(candidates[candidate]);
+            }
+            err = run_stream(conn, myId, client, chunk, conn->following ? relay : candidates[candidate], &finished);
+        }
+        if (is_stopped(conn, myId) || finished) {
+            break;
+        }
+        if (err == ESP_OK && conn->seekTo.load() >= 0) {
+            // A seek past what's buffered, straight on to the range it wants
+            attempt  = -1;
+            lastData = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            continue;
+        }
+        if (err != ESP_OK) {
+            mclog::tagWarn(TAG, "HTTP stream error: {} ({})", esp_err_to_name(err), (int)err);
+        }
+
+        uint32_t now  = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        bool streamed = conn->throughput.samples.load() != samples || conn->ringBuffer.freeSpace() < HTTP_READ_CHUNK;
+        if (GetHAL()->getWifiState() != hal::HalBase::WIFI_CONNECTED) {
+            // The link dropped and the HAL is reconnecting, the ring plays on. No mirror is to blame, the same one
+            // is tried again as soon as the link is back
+            mclog::tagWarn(TAG, "WiFi down, waiting for it to come back");
+            if (streamed) {
+                lastData = now;
+            }
+            if (!wait_for_wifi(conn, myId, lastData + MAX_STALL_SECONDS * 1000)) {
+                break;
+            }
+            backoff = RECONNECT_MIN_MS;
+            now     = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        } else if (streamed) {
+            // Streaming, or paused with a full ring, which is no reason to give up either
+            // It was streaming, so start over from a quick retry on the same URL
+            if (!conn->following) {
+                mirror_report(candidates[candidate], true);
+            }
+            lastData = now;
+            backoff  = RECONNECT_MIN_MS;
+        } else if (conn->following) {
+#if CONFIG_TAB5_MULTIROOM_SYNC
+            // The master is full or moved on, the station's own mirrors are next
+            sync_unfollow(sync_owner(conn, myId), true);
+#endif
+            conn->following = false;
+        } else {
+            mirror_report(candidates[candidate], false);
+            // A cached mirror that fails is dropped, the station URL resolves a fresh one
+            if (!cached.empty() && candidates[candidate] == cached) {
+                url_cache_erase(conn->url);
+                cached.clear();
+            }
+            candidate = (candidate + 1) % candidates.size();
+            if (candidate == 0 && backoff < RECONNECT_MAX_MS) {
+                backoff *= 2;
+            }
+        }
+        if (now - lastData > MAX_STALL_SECONDS * 1000) {
+            mclog::tagError(TAG, "No data for {}s, giving up", MAX_STALL_SECONDS);
+            set_radio_error(conn);
+            break;
+        }
+    }
+
+    // Log why the HTTP stream ended
+    if (is_stopped(conn, myId)) {
+        mclog::tagInfo(TAG, "HTTP stream stopped by user request");
+    } else if (finished) {
+        mclog::tagInfo(TAG, "HTTP stream finished");
+    }
+
+#if CONFIG_TAB5_MULTIROOM_SYNC
+    sync_unfollow(sync_owner(conn, myId), false);
+#endif
+    if (verified) {
+        esp_http_client_close(client);
+        tls_client_park(host, client);
+    } else {
+        esp_http_client_cleanup(client);
+    }
+    internal_pool().free(chunk);
+    mclog::tagInfo(TAG, "HTTP stream task ended (stream #{}), {} B stack left", myId, task_topology::stack_headroom());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              SD Card Source                                */
+/* -------------------------------------------------------------------------- */
+// Files from the card take the place of the HTTP task: a task of their own reads them in whole blocks into the same
+// ring, one after the other, so the decoder goes from one file to the next without draining the output or restarting
+// and the ring's depth rides out the card's latency spikes. Where each file begins is queued as a ring write
+// position, the decoder takes over its codec and title when its read position gets there
+#define FILE_READ_BLOCK (32 * 1024)  // Per read, a multiple of the FAT cluster size and aligned to it
+#define FILE_ID3V1_SIZE 128          // Trailing tag of older MP3s
+
+/**
+ * @brief Where a file begins in the ring
+ */
+struct FileTrack_t {
+    size_t offset       = 0;  // Ring write position of its first byte
+    StreamCodec_t codec = CODEC_MP3;
+    bool hasGain        = false;  // From its tags, see TrackGain_t
+    float gainDb        = 0;
+    char title[sizeof(hal::HalBase::RadioMetadata_t::title)] = {0};
+};
+
+struct FileSource {
+    std::mutex mutex;                // Everything below
+    std::deque<std::string> queue;   // Not read yet, paths on the card
+    std::deque<FileTrack_t> tracks;  // Read into the ring, not reached by the decoder yet
+};
+
+static FileSource s_files;
+
+static bool file_codec(const std::string& path, StreamCodec_t* codec)
+{
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    if (ext == "mp3") {
+        *codec = CODEC_MP3;
+        return true;
+    }
+    if (ext == "aac" || ext == "adts") {
+        *codec = CODEC_AAC;
+        return true;
+    }
+    return false;
+}
+
+// The file name without its directory and extension
+static void file_title(const std::string& path, char* title, size_t size)
+{
+    size_t slash = path.rfind('/');
+    size_t start = (slash == std::string::npos) ? 0 : slash + 1;
+    size_t dot   = path.rfind('.');
+    size_t end   = (dot == std::string::npos || dot < start) ? path.size() : dot;
+    copy_text(title, size, path.c_str() + start, end - start);
+}
+
+/**
+ * @brief Take over the codec and title of the file the decoder's read position has reached
+ *
+ * @return bytes until the next file begins, SIZE_MAX if there's none in the ring
+ */
+static size_t file_track_advance(StreamConnection* conn)
+{
+    if (!conn->local) {
+        return SIZE_MAX;
+    }
+    std::lock_guard<std::mutex> lock(s_files.mutex);
+    size_t pos   = conn->ringBuffer.readPosition();
+    bool reached = false;
+    while (!s_files.tracks.empty() && (ptrdiff_t)(pos - s_files.tracks.front().offset) >= 0) {
+        const FileTrack_t& track = s_files.tracks.front();
+        conn->codec              = track.codec;
+        copy_text(conn->meta.title, sizeof(conn->meta.title), track.title, strlen(track.title));
+        TrackGain_t gain = conn->trackGain.load();
+        gain.version++;
+        gain.at     = track.offset;
+        gain.known  = track.hasGain;
+        gain.gainDb = track.gainDb;
+        conn->trackGain.store(gain);
+        s_files.tracks.pop_front();
+        reached = true;
+    }
+    if (reached) {
+        mclog::tagInfo(TAG, "Playing file: {}", conn->meta.title);
+        conn->metadata.store(conn->meta);
+        hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);
+    }
+    return s_files.tracks.empty() ? SIZE_MAX : s_files.tracks.front().offset - pos;
+}
+
+/**
+ * @return false if stopped before all of `data` went into the ring
+ */
+static bool file_write(StreamConnection* conn, uint32_t myId, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        if (is_stopped(conn, myId)) {
+            return false;
+        }
+        if (!conn->ringBuffer.waitForSpace(std::min<size_t>(len, FILE_READ_BLOCK), 200)) {
+            continue;
+        }
+        size_t written = conn->ringBuffer.write(data, len);
+        trace_ring_write(conn, written);
+        s_metric_bytes.inc(written);
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+/**
+ * @brief Read one file into the ring, without its ID3 tags and the Xing/Info frame that isn't audio
+ *
+ * @return false if stopped meanwhile
+ */
+static bool file_read(StreamConnection* conn, uint32_t myId, FILE* file, StreamCodec_t codec, const char* title,
+                      uint8_t* block)
+{
+    // ID3v1 is at a known place at the end, ID3v2 only says how long it is once read
+    size_t end = 0;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        end       = size > 0 ? (size_t)size : 0;
+    }
+    if (end >= FILE_ID3V1_SIZE && fseek(file, end - FILE_ID3V1_SIZE, SEEK_SET) == 0 &&
+        fread(block, 1, 3, file) == 3 && memcmp(block, "TAG", 3) == 0) {
+        end -= FILE_ID3V1_SIZE;
+    }
+    rewind(file);
+    size_t pos  = 0;  // File offset of block[0]
+    size_t len  = fread(block, 1, FILE_READ_BLOCK, file);
+    size_t skip = id3_size(block, len);
+    media_tags::Tags_t tags;
+    media_tags::parse_id3v2(block, len, &tags);  // For the ReplayGain, the title is the file name
+    if (skip >= len && skip < end) {
+        // Cover art and all, carry on from the block the audio starts in so the reads stay aligned
+        pos = skip / FILE_READ_BLOCK * FILE_READ_BLOCK;
+        len = (fseek(file, pos, SEEK_SET) == 0) ? fread(block, 1, FILE_READ_BLOCK, file) : 0;
+        skip -= pos;
+    }
+    mp3_frame::FrameInfo_t info;
+    mp3_frame::VbrInfo_t tag;
+    if (codec == CODEC_MP3 && skip + mp3_frame::HEADER_SIZE <= len && mp3_frame::parse_header(block + skip, &info) &&
+        skip + info.frameSize <= len && mp3_frame::parse_vbr_tag(block + skip, info.frameSize, info, &tag)) {
+        skip += info.frameSize;
+    }
+    if (skip >= len) {
+        return true;  // Nothing but tags
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_files.mutex);
+        FileTrack_t track;
+        track.offset  = conn->ringBuffer.writePosition();
+        track.codec   = codec;
+        track.hasGain = tags.hasGain;
+        track.gainDb  = tags.gainDb;
+        snprintf(track.title, sizeof(track.title), "%s", title);
+        s_files.tracks.push_back(track);
+    }
+
+    while (len > 0 && pos < end) {
+        size_t audio = std::min(len, end - pos);
+        if (audio > skip && !file_write(conn, myId, block + skip, audio - skip)) {
+            return false;
+        }
+        pos += len;
+        skip = 0;
+
+        uint32_t start   = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        len              = fread(block, 1, FILE_READ_BLOCK, file);
+        uint32_t elapsed = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
+        if (elapsed > 200) {
+            mclog::tagWarn(TAG, "SD read took {} ms, {} KB buffered", elapsed, conn->ringBuffer.available() / 1024);
+        }
+    }
+    return true;
+}
+
+static void file_stream_task(void* param)
+{
+    StreamConnection* conn = (StreamConnection*)param;
+    uint32_t myId          = conn->id;
+    mclog::tagInfo(TAG, "SD card file task started (stream #{})", myId);
+
+    uint8_t* block = (uint8_t*)internal_pool().alloc(FILE_READ_BLOCK);
+    bool held      = block && sdcard_acquire();
+    if (!held) {
+        mclog::tagError(TAG, "No {} for the files", block ? "SD card" : "read buffer");
+        set_radio_error(conn);
+    }
+
+    int played = 0;
+    while (held && !is_stopped(conn, myId)) {
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(s_files.mutex);
+            if (s_files.queue.empty()) {
+                conn->ended = true;  // Under the mutex, so queueRadioFile() either got in before or starts afresh
+                break;
+            }
+            path = s_files.queue.front();
+            s_files.queue.pop_front();
+        }
+
+        StreamCodec_t codec;
+        FILE* file = file_codec(path, &codec) ? fopen((SDCARD_MOUNT_POINT + path).c_str(), "rb") : nullptr;
+        if (!file) {
+            mclog::tagWarn(TAG, "Skipping {}: can't open it or not MP3 / AAC", path);
+            continue;
+        }
+        // Whole blocks straight from the card, stdio buffering would only add a copy
+        setvbuf(file, nullptr, _IONBF, 0);
+        if (played++ == 0) {
+            conn->codec = codec;  // Before any audio, like the HTTP task's Content-Type. Later ones are in tracks
+        }
+        char title[sizeof(FileTrack_t::title)];
+        file_title(path, title, sizeof(title));
+        bool read = file_read(conn, myId, file, codec, title, block);
+        if (ferror(file)) {
+            mclog::tagWarn(TAG, "Read error in {}, card removed?", path);
+        }
+        fclose(file);
+        if (!read) {
+            break;
+        }
+    }
+    conn->ended = true;
+    conn->ringBuffer.wakeAll();  // A decoder waiting on more data finds the end
+
+    if (held) {
+        sdcard_release();
+    }
+    internal_pool().free(block);
+    mclog::tagInfo(TAG, "SD card file task ended (stream #{}), {} B stack left", myId,
+                   task_topology::stack_headroom());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           Connection Control                               */
+/* -------------------------------------------------------------------------- */
+/**
+ * @param local `url` is the first of the SD card files queued in s_files, read by a task of its own
+ */
+static bool open_connection(StreamConnection* conn, const std::string& url, bool warm, bool local = false)
+{
+    if (!conn->ringBuffer.isInitialized()) {
+        if (!conn->ringBuffer.init(RING_BUFFER_SIZE, hal::HalBase::MEMORY_STREAM)) {
+            mclog::tagError(TAG, "Failed to init ring buffer");
+            return false;
+        }
+        conn->ringBuffer.setHistory(TIMESHIFT_HISTORY);
+        if (!conn->ringBuffer.setReadWindow(RING_READ_WINDOW, hal::HalBase::MEMORY_INTERNAL)) {
+            mclog::tagWarn(TAG, "No internal SRAM for the read window, decoding straight from PSRAM");
+        }
+    }
+    // Relay listeners let go of a ring within a read or send timeout once it's no longer the active one
+    for (int waited = 0; conn->relayReaders.load() > 0 && waited < 3000; waited += 20) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    if (conn->relayReaders.load() > 0) {
+        mclog::tagWarn(TAG, "Relay listener still on the ring, it may get garbage");
+    }
+    abort_save(conn);
+    conn->ringBuffer.reset();
+    conn->throughput.reset();
+
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        conn->id++;  // New stream, old HTTP tasks on this slot will be ignored
+        conn->url       = url;
+        conn->urlHash   = sync_url_hash(url);
+        conn->following = false;
+        conn->codec     = CODEC_MP3;
+        conn->meta      = {};
+        conn->metadata.store(conn->meta);
+        conn->icy.reset(0);
+        conn->ts.reset();
+        conn->playlist    = false;
+        conn->resync      = false;
+        conn->reconnect   = false;
+        conn->warm        = warm;
+        conn->local       = local;
+        conn->ended       = false;
+        conn->onDemand    = false;
+        conn->fileSize    = 0;
+        conn->rangeStart  = 0;
+        conn->rangeOffset = 0;
+        conn->seekTo      = -1;
+        conn->trackGain.store({});
+        conn->titleMarks.store({});
+        xSemaphoreGive(s_radio.mutex);
+    }
+
+    bool started = local ? conn->task.start(task_topology::RADIO_FILES, file_stream_task, conn)
+                         : conn->task.start(task_topology::HTTP_STREAM, http_stream_task, conn,
+                                            warm ? "http_warm" : nullptr);
+    if (!started) {
+        mclog::tagError(TAG, "Failed to create {} task", local ? "SD card file" : "HTTP stream");
+        return false;
+    }
+    return true;
+}
+
+static void close_connection(StreamConnection* conn)
+{
+    conn->task.cancel();
+    conn->ringBuffer.wakeAll();
+}
+
+static void wait_connection(StreamConnection* conn)
+{
+    // Don't force delete HTTP task - it crashes the lwip stack!
+    // If it's still running, just log a warning and continue - the ID check keeps it away from the ring
+    if (!conn->task.join(HTTP_JOIN_MS)) {
+        mclog::tagWarn(TAG, "HTTP task still running, not force deleting (would crash lwip)");
+        conn->id++;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           Audio Decode Task                                */
+/* -------------------------------------------------------------------------- */
+// The decoder pulls whole MP3 / ADTS frames and Opus / FLAC packets straight out of the ring: no FILE layer, no
+// format probe. Frames longer than PCM_SLICE_FRAMES go through the DSP and the resampler in slices
+#define PCM_MAX_SAMPLES    (5760 * 2)  // 120 ms of stereo Opus, the longest packet. Also a 4608 sample FLAC block
+#define PCM_SLICE_FRAMES   2048        // One HE-AAC frame (SBR doubles the 1024 samples)
+#define FRAME_BUFFER_SIZE  (std::max<size_t>(adts_frame::MAX_FRAME_SIZE + 1, packet_frame::MAX_FRAME_SIZE))
+#define FRAME_SCAN_WINDOW  2048        // Bytes peeked per sync scan
+static_assert(RING_READ_WINDOW >= FRAME_BUFFER_SIZE, "The largest frame is read out of the window in one go");
+
+// Connection the decoder is reading, only changed by the decoder itself
+static StreamConnection* s_audio_conn = nullptr;
+static bool s_audio_fresh             = false;  // It was switched to cold, there's nothing to crossfade from
+static bool s_audio_spliced           = false;  // Another bitrate of the same station, nothing to crossfade either
+
+static void pcm_output_drain();  // PCM Output
+
+// Floor for both the prebuffer and rebuffering, doubled on every underrun. It's a property of this network
+// rather than the station, so it carries over station changes
+static size_t s_buffer_watermark = MIN_BUFFER_LEVEL;
+static bool s_rebuffering        = false;
+static uint32_t s_rebuffer_at    = 0;  // When it ran dry
+
+// Format of the stream being played: probed from its first frames, corrected by what the decoder outputs
+static Snapshot<hal::HalBase::RadioStreamFormat_t> s_stream_format;
+
+// The buffer level subscribers last heard of. Checked at most every BUFFER_EVENT_MS, so a level hovering on a step
+// boundary costs a few events a second rather than one per frame
+#define BUFFER_EVENT_MS 250
+
+static int s_buffer_event_level     = -1;
+static uint32_t s_buffer_checked_at = 0;
+static std::atomic<uint32_t> s_decode_busy_kcycles{0};  // See radio_decode_busy_kcycles()
+
+static void post_buffer_level(StreamConnection* conn)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now - s_buffer_checked_at < BUFFER_EVENT_MS) {
+        return;
+    }
+    s_buffer_checked_at = now;
+    stream_trace().record(TRACE_BUFFER_LEVEL, TRACE_COUNTER, conn->ringBuffer.available());
+    s_metric_buffer.set(conn->ringBuffer.available());
+
+    int step  = hal::HalBase::BUFFER_EVENT_STEP;
+    int level = conn->ringBuffer.bufferPercent() / step * step;
+    if (level != s_buffer_event_level) {
+        s_buffer_event_level = level;
+        hal_post_event(hal::HalBase::EVENT_RADIO_BUFFER, level);
+        wifi_power_buffer_level(level);
+    }
+}
+
+int radio_buffer_level()
+{
+    return radio_streaming() ? s_buffer_event_level : -1;
+}
+
+uint32_t radio_decode_busy_kcycles()
+{
+    return s_decode_busy_kcycles.load(std::memory_order_relaxed);
+}
+
+static void set_playing(bool playing)
+{
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        // A pause that came in while rebuffering sticks
+        if (s_radio.paused) {
+            set_radio_state(hal::HalBase::RADIO_PAUSED);
+        } else {
+            set_radio_state(playing ? hal::HalBase::RADIO_PLAYING : hal::HalBase::RADIO_BUFFERING);
+        }
+        xSemaphoreGive(s_radio.mutex);
+    }
+}
+
+/**
+ * @brief Consumption rate of the stream, from the probed format, the ICY header or the default
+ */
+static int stream_bytes_per_second(StreamConnection* conn)
+{
+    int bitrate = s_stream_format.load().bitrate;
+    if (bitrate <= 0) {
+        bitrate = conn->metadata.load().bitrate;
+    }
+    return (bitrate > 0 ? bitrate : DEFAULT_BITRATE_KBPS) * 1000 / 8;
+}
+
+/**
+ * @brief Bytes to buffer before playback so an underrun over the next PREBUFFER_HORIZON_S is unlikely
+ */
+static size_t prebuffer_target(StreamConnection* conn)
+{
+    const ThroughputEstimator& est = conn->throughput;
+    uint32_t now                   = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    int64_t target                 = PREBUFFER_MAX_SIZE;
+
+    // No data for a couple of windows counts as no estimate
+    if (est.samples.load() >= PREBUFFER_MIN_SAMPLES && (now - est.lastSample.load()) <= 2 * THROUGHPUT_WINDOW_MS) {
+        int64_t consume = stream_bytes_per_second(conn);
+        int64_t worst   = (int64_t)est.rate.load() - UNDERRUN_DEVIATIONS * (int64_t)est.deviation.load();
+        int64_t deficit = consume - worst;
+        target          = (deficit > 0) ? deficit * PREBUFFER_HORIZON_S : 0;
+    }
+
+    if (target < (int64_t)s_buffer_watermark) {
+        target = s_buffer_watermark;
+    }
+    if (target > PREBUFFER_MAX_SIZE) {
+        target = PREBUFFER_MAX_SIZE;
+    }
+    return (size_t)target;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Clock drift                                */
+/* -------------------------------------------------------------------------- */
+// The encoder's clock and our output's drift apart by tens of ppm, over days enough to run the ring dry or full.
+// The output resampler is trimmed to hold the buffered seconds where they settled after each start, skip, pause or
+// rebuffer. SD card files and on-demand streams have no remote clock, they're read as fast as there's room, so they
+// play untrimmed
+#define DRIFT_UPDATE_MS 1000
+
+static struct {
+    ClockDrift control;
+    uint32_t updatedAt = 0;
+    bool rebase        = false;  // Set by wait_for_stream_data() after a rebuffer, taken by the decoder
+    bool synced        = false;  // Trimmed by the multi-room sync instead
+} s_drift;
+
+static void clock_drift_restart(bool sameStation)
+{
+    if (sameStation) {
+        s_drift.control.rebase();
+    } else {
+        s_drift.control.reset();
+    }
+    s_drift.updatedAt = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    s_drift.rebase    = false;
+}
+
+static void clock_drift_update(StreamConnection* conn, Resampler* src)
+{
+    if (s_drift.rebase) {
+        clock_drift_restart(true);
+    }
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now - s_drift.updatedAt < DRIFT_UPDATE_MS) {
+        return;
+    }
+    float elapsed     = (now - s_drift.updatedAt) / 1000.0f;
+    s_drift.updatedAt = now;
+    int ppm           = 0;
+    if (sync_following(&ppm)) {
+        // The sync master's output is the clock to follow, the buffer level goes along with it
+        s_drift.synced = true;
+    } else if (s_drift.synced) {
+        s_drift.synced = false;
+        clock_drift_restart(true);
+        ppm = s_drift.control.ppm();
+    } else if (!conn->local && !conn->onDemand) {
+        ppm = s_drift.control.update((float)conn->ringBuffer.available() / stream_bytes_per_second(conn), elapsed);
+    }
+    src->setTrim(ppm);
+    s_metric_drift.set(ppm);
+}
+
+/**
+ * @brief Block until `bytes` are buffered
+ *
+ * Picks up station switches, and treats running short as an underrun: the watermark is raised and playback only
+ * resumes once the ring has refilled to it.
+ *
+ * @return false if stopped or the stream stalled for MAX_STALL_SECONDS
+ */
+static bool wait_for_stream_data(size_t bytes)
+{
+    // For live streams, we need to be very patient - network can have long stalls
+    // The ring buffer wakes us as soon as the HTTP task commits new data
+    int waitedSeconds = 0;
+    size_t lastLevel  = 0;
+    bool prebuffering = false;
+
+    while (!s_radio.stopRequested) {
+        // Station change: continue from the promoted warm connection, the frame scan resyncs on its next frame
+        StreamConnection* next = s_pending_conn.exchange(nullptr);
+        if (next) {
+            if (s_rebuffering) {
+                stream_trace().record(TRACE_REBUFFER, TRACE_END, next->ringBuffer.available());
+                s_metric_rebuffer.observe(xTaskGetTickCount() * portTICK_PERIOD_MS - s_rebuffer_at);
+            }
+            s_audio_conn  = next;
+            s_rebuffering = false;  // The warm ring already holds live audio
+            s_splice_conn.store(nullptr);
+            if (s_pending_fresh.exchange(false)) {
+                // Switched to cold: what's queued plays out and fades, then the new station prebuffers like a start
+                s_audio_fresh = true;
+                prebuffering  = true;
+                pcm_output_drain();
+                set_playing(false);
+            }
+        }
+
+        // Bitrate step: the stream stepped from is played out to its last whole frame, the next one goes on from
+        // the same moment, the frame scan finds its first frame
+        StreamConnection* splice = s_splice_conn.load();
+        if (splice && s_audio_conn->ringBuffer.available() < bytes) {
+            s_splice_conn.store(nullptr);
+            size_t skip = splice->ringBuffer.discard(s_splice_skip.load());
+            mclog::tagInfo(TAG, "Spliced in stream #{}, {} KB of it already played", splice->id, skip / 1024);
+            s_audio_conn    = splice;
+            s_audio_spliced = true;
+        }
+
+        RingBuffer& ring = s_audio_conn->ringBuffer;
+        bool ended       = s_audio_conn->ended;  // Before the level, the last bytes are in once it's set
+        size_t available = ring.available();
+        size_t needed    = s_rebuffering ? s_buffer_watermark : bytes;
+        if (prebuffering) {
+            needed = prebuffer_target(s_audio_conn);
+        }
+        if (needed < bytes) {
+            needed = bytes;
+        }
+
+        if (available >= needed) {
+            if (prebuffering) {
+                mclog::tagInfo(TAG, "Prebuffered {} KB after the switch, playing", available / 1024);
+                set_playing(true);
+            }
+            if (s_rebuffering) {
+                mclog::tagInfo(TAG, "Rebuffered {} KB, resuming", available / 1024);
+                stream_trace().record(TRACE_REBUFFER, TRACE_END, available);
+                s_metric_rebuffer.observe(xTaskGetTickCount() * portTICK_PERIOD_MS - s_rebuffer_at);
+                s_rebuffering  = false;
+                s_drift.rebase = true;
+                set_playing(true);
+            }
+
+            // The buffer level now and then, at most once a second while it's low
+            if (available < MIN_BUFFER_LEVEL) {
+                HOT_LOG_WARN_EVERY(1000, TAG, "Buffer low: {} bytes ({} KB)", available, available / 1024);
+            } else {
+                HOT_LOG_INFO_EVERY(10000, TAG, "Buffer healthy: {} KB", available / 1024);
+            }
+            stage_work(STAGE_DECODE);
+            return true;
+        }
+
+        if (ended) {
+            mclog::tagInfo(TAG, "Played to the end of the {}", s_audio_conn->local ? "files" : "file");
+            return false;
+        }
+        if (waitedSeconds >= MAX_STALL_SECONDS) {
+            mclog::tagError(TAG, "Timeout after {}s waiting for data", MAX_STALL_SECONDS);
+            return false;
+        }
+
+        // Buffer ran dry! That's an underrun: ask for more headroom from now on and refill up to it before resuming
+        if (prebuffering) {
+            // Not an underrun, and a station that never comes is reported by its HTTP task
+            waitedSeconds = 0;
+        } else if (!s_rebuffering) {
+            s_buffer_watermark *= 2;
+            if (s_buffer_watermark > MAX_BUFFER_LEVEL) {
+                s_buffer_watermark = MAX_BUFFER_LEVEL;
+            }
+            s_rebuffering = true;
+            s_rebuffer_at = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            set_playing(false);
+            stream_trace().record(TRACE_REBUFFER, TRACE_BEGIN, s_buffer_watermark);
+            mclog::tagWarn(TAG, "Buffer empty! Rebuffering to {} KB...", s_buffer_watermark / 1024);
+        } else if (waitedSeconds > 0) {
+            HOT_LOG_WARN(TAG, "Still waiting for data... ({} seconds)", waitedSeconds);
+        }
+
+        // Only a second without any new data counts towards the stall limit
+        stage_idle(STAGE_DECODE);  // Starved, a stall upstream if any
+        lastLevel = available;
+        if (!ring.waitForData(needed > s_buffer_watermark ? needed : s_buffer_watermark, 1000) &&
+            ring.available() == lastLevel) {
+            waitedSeconds++;
+        }
+        post_buffer_level(s_audio_conn);
+    }
+    return false;
+}
+
+/**
+ * @brief Jump `seconds` back into the history or forward through what's buffered, the frame scan resyncs after
+ */
+static void skip_stream(int seconds)
+{
+    RingBuffer& ring = s_audio_conn->ringBuffer;
+    size_t bytes     = (size_t)(seconds < 0 ? -seconds : seconds) * stream_bytes_per_second(s_audio_conn);
+    size_t moved     = 0;
+    if (seconds < 0) {
+        moved = ring.rewind(bytes);
+    } else {
+        // Stop short of live, keep enough to play on without rebuffering
+        size_t available = ring.available();
+        size_t keep      = s_buffer_watermark;
+        moved            = ring.discard(available > keep ? std::min(bytes, available - keep) : 0);
+    }
+    mclog::tagInfo(TAG, "Skipped {} KB {}", moved / 1024, seconds < 0 ? "back" : "forward");
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           On-Demand Position                               */
+/* -------------------------------------------------------------------------- */
+// The decoder keeps the seek index of the on-demand stream it reads. It's set up from the first frame and learns
+// the offset of the frames decoded while the position is still counted from the start. A seek into what the ring
+// holds, its history included, only moves the read position. Anything else has the HTTP task fetch the range from the
+// target on, and playback resumes once SEEK_REFILL_BYTES of it are in
+#define SEEK_REFILL_BYTES   MIN_BUFFER_LEVEL  // ~0.5 s at 128 kbps
+#define POSITION_PUBLISH_MS 250
+
+static struct {
+    StreamConnection* conn = nullptr;  // With its stream number, the one the index is for
+    uint32_t id            = 0;
+    SeekIndex index;
+    bool counted         = false;  // The position is counted from the start of the audio, the index learns from it
+    double position      = 0;      // Seconds, at the frame being decoded
+    uint32_t publishedAt = 0;
+} s_ondemand;
+
+static Snapshot<hal::HalBase::RadioPosition_t> s_position;
+
+static bool ondemand_playing()
+{
+    return s_audio_conn->onDemand && s_ondemand.conn == s_audio_conn && s_ondemand.id == s_audio_conn->id;
+}
+
+static void ondemand_publish(bool now)
+{
+    uint32_t ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (!now && ms - s_ondemand.publishedAt < POSITION_PUBLISH_MS) {
+        return;
+    }
+    s_ondemand.publishedAt = ms;
+    hal::HalBase::RadioPosition_t position;
+    if (s_audio_conn && ondemand_playing()) {
+        position.seekable  = true;
+        position.positionS = (int)s_ondemand.position;
+        position.durationS = (int)lroundf(s_ondemand.index.duration());
+    }
+    s_position.store(position);
+}
+
+/**
+ * @brief Place the frame just read in the file, the first one of an on-demand stream sets the index up
+ *
+ * @return true if it's the Xing/Info frame, silent and not to be decoded
+ */
+static bool ondemand_frame(const uint8_t* frame, const FrameHeader_t& header)
+{
+    StreamConnection* conn = s_audio_conn;
+    if (!conn->onDemand || stream_frame::is_packet(header.codec)) {
+        if (s_ondemand.conn) {
+            s_ondemand.conn = nullptr;
+            ondemand_publish(true);
+        }
+        return false;
+    }
+    int64_t offset = ondemand_offset(conn, conn->ringBuffer.readPosition() - header.frameSize);
+    if (offset < 0 || offset > UINT32_MAX) {
+        return false;
+    }
+
+    if (s_ondemand.conn != conn || s_ondemand.id != conn->id) {
+        // The whole file was asked for first, this is the start of its audio: a VBR tag says how long it is,
+        // otherwise the bitrate does
+        mp3_frame::FrameInfo_t info;
+        mp3_frame::VbrInfo_t vbr;
+        bool mp3 = header.codec == CODEC_MP3 && mp3_frame::parse_header(frame, &info);
+        bool tag = mp3 && mp3_frame::parse_vbr_tag(frame, header.frameSize, info, &vbr);
+        uint32_t start = (uint32_t)offset + (tag ? header.frameSize : 0);
+        uint32_t end   = conn->fileSize;
+        if (tag && vbr.bytes > 0) {
+            end = std::min<uint32_t>(end, (uint32_t)offset + vbr.bytes);
+        }
+        float seconds = 0;
+        if (tag && vbr.frames > 0) {
+            seconds = (float)vbr.frames * mp3_frame::samples_per_frame(info) / info.sampleRate;
+        } else if (end > start) {
+            int bytesPerSecond = (mp3 && !tag) ? info.bitrateKbps * 1000 / 8 : stream_bytes_per_second(conn);
+            seconds            = (float)(end - start) / bytesPerSecond;
+        }
+        s_ondemand.index.reset(start, end, seconds, (tag && vbr.hasToc) ? vbr.toc : nullptr);
+        s_ondemand.conn     = conn;
+        s_ondemand.id       = conn->id;
+        s_ondemand.counted  = true;
+        s_ondemand.position = 0;
+        mclog::tagInfo(TAG, "On demand: {:.0f} s of {}, {}", seconds, stream_frame::codec_name(header.codec),
+                       (tag && vbr.hasToc) ? "Xing TOC" : tag ? "VBR tag" : "by bitrate");
+        ondemand_publish(true);
+        if (tag) {
+            return true;
+        }
+    }
+
+    if (s_ondemand.counted) {
+        s_ondemand.index.learn((float)s_ondemand.position, (uint32_t)offset);
+    } else {
+        s_ondemand.position = s_ondemand.index.timeOf((uint32_t)offset);
+    }
+    ondemand_publish(false);
+    return false;
+}
+
+// The frame decoded into `samples` (interleaved) at `sampleRate`
+static void ondemand_played(int samples, int channels, int sampleRate)
+{
+    if (s_ondemand.conn == s_audio_conn && s_ondemand.counted && channels > 0 && sampleRate > 0) {
+        s_ondemand.position += (double)samples / channels / sampleRate;
+    }
+}
+
+static void ondemand_seek(double seconds)
+{
+    StreamConnection* conn = s_audio_conn;
+    RingBuffer& ring       = conn->ringBuffer;
+    SeekIndex& index       = s_ondemand.index;
+    seconds                = std::min(std::max(seconds, 0.0), std::max(index.duration() - 1.0, 0.0));
+    uint32_t target        = index.offsetOf((float)seconds);
+
+    // What the ring holds of the current range, back into the history
+    size_t read   = ring.readPosition();
+    size_t back   = std::min(ring.history(), (size_t)std::max<ptrdiff_t>(0, (ptrdiff_t)(read - conn->rangeStart)));
+    int64_t first = ondemand_offset(conn, read - back);
+    int64_t last  = ondemand_offset(conn, ring.writePosition());
+    if (target >= first && target + SEEK_REFILL_BYTES <= last) {
+        ptrdiff_t move = (ptrdiff_t)(target - first) - (ptrdiff_t)back;
+        if (move < 0) {
+            ring.rewind(-move);
+        } else {
+            ring.discard(move);
+        }
+        mclog::tagInfo(TAG, "On demand: seek to {:.0f} s, buffered", seconds);
+    } else {
+        mclog::tagInfo(TAG, "On demand: seek to {:.0f} s, from byte {}", seconds, target);
+        uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        pcm_output_drain();
+        set_playing(false);
+        conn->seekTo = target;
+        ring.discard(ring.available());  // Frees the HTTP task if it waits for room
+        while (conn->seekTo.load() >= 0 && !s_radio.stopRequested && conn->task.running()) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        // What came in before the new range is from the old position
+        ptrdiff_t stale = (ptrdiff_t)(conn->rangeStart.load() - ring.readPosition());
+        if (stale > 0) {
+            ring.discard(stale);
+        }
+        while (!s_radio.stopRequested && conn->task.running() && !conn->ended &&
+               ring.available() < SEEK_REFILL_BYTES) {
+            ring.waitForData(SEEK_REFILL_BYTES, 100);
+        }
+        set_playing(true);
+        mclog::tagInfo(TAG, "On demand: playing again after {} ms",
+                       xTaskGetTickCount() * portTICK_PERIOD_MS - start);
+    }
+    s_ondemand.counted  = target <= index.audioStart();
+    s_ondemand.position = s_ondemand.counted ? 0 : seconds;
+    ondemand_publish(true);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Frame Reader                                  */
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Read the next complete frame into `frame`, skipping anything that isn't one
+ *
+ * Joining a live stream or switching stations lands mid-frame, so the ring is scanned for a header (confirmed by
+ * the following header where possible) before a frame is consumed. The codec is the one of the connection being
+ * read, which can change when a warm station of another format is promoted or the next SD card file begins. The
+ * scan never reaches into the next file, it may use the other codec.
+ */
+static bool read_frame(uint8_t* frame, FrameHeader_t* header)
+{
+    size_t skipped = 0;
+    while (true) {
+        size_t toNext       = file_track_advance(s_audio_conn);
+        StreamCodec_t codec = s_audio_conn->codec;
+        size_t headerSize   = stream_frame::header_size(codec);
+        if (!wait_for_stream_data(headerSize)) {
+            return false;
+        }
+        if (s_audio_conn->codec != codec) {
+            continue;
+        }
+
+        RingBuffer& ring = s_audio_conn->ringBuffer;
+        size_t window    = ring.peek(frame, std::min<size_t>(FRAME_SCAN_WINDOW, toNext));
+        int offset       = stream_frame::find_frame(codec, frame, window, header);
+        if (offset < 0) {
+            // Keep the last bytes, a header may start there. Not at the end of a file, the next one starts after
+            size_t drop = (window == toNext) ? window : window - (headerSize - 1);
+            ring.discard(drop);
+            skipped += drop;
+            continue;
+        }
+        if (toNext != SIZE_MAX && offset + header->frameSize > toNext) {
+            // The file's truncated last frame, the next file starts inside it
+            ring.discard(toNext);
+            skipped += toNext;
+            continue;
+        }
+        if (offset > 0) {
+            ring.discard(offset);
+            skipped += offset;
+        }
+
+        if (!wait_for_stream_data(header->frameSize)) {
+            return false;
+        }
+
+        // The wait may have moved to another connection, check the header is still in front
+        FrameHeader_t check;
+        RingBuffer& current = s_audio_conn->ringBuffer;
+        current.peek(frame, headerSize);
+        if (s_audio_conn->codec != codec || !stream_frame::parse_header(codec, frame, &check) ||
+            check.frameSize != header->frameSize) {
+            continue;
+        }
+
+        current.read(frame, header->frameSize);
+        stream_trace().record(TRACE_RING_READ, TRACE_INSTANT, header->frameSize);
+        if (skipped > 0) {
+            s_metric_resyncs.inc();
+            HOT_LOG_INFO(TAG, "{} sync: skipped {} bytes to frame ({} Hz)", stream_frame::codec_name(codec), skipped,
+                         header->sampleRate);
+        }
+        return true;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Format Probe                                  */
+/* -------------------------------------------------------------------------- */
+#define PROBE_WINDOW     (8 * 1024)  // ~20 MP3 frames at 128kbps, ~30 HE-AAC frames at 64kbps
+#define PROBE_MIN_FRAMES 4           // Consecutive frames needed to trust the result
+
+static bool probe_mp3(const uint8_t* data, size_t len, hal::HalBase::RadioStreamFormat_t* format)
+{
+    mp3_frame::FrameInfo_t first;
+    int offset = mp3_frame::find_frame(data, len, &first);
+    if (offset < 0) {
+        return false;
+    }
+
+    // Walk the frames that follow, a bitrate that changes means VBR even without a tag
+    mp3_frame::VbrInfo_t tag;
+    bool hasTag     = false;
+    int frames      = 0;
+    int64_t kbpsSum = 0;
+    int minKbps     = first.bitrateKbps;
+    int maxKbps     = first.bitrateKbps;
+    size_t pos      = offset;
+    mp3_frame::FrameInfo_t info;
+    while (pos + mp3_frame::HEADER_SIZE <= len && mp3_frame::parse_header(data + pos, &info) &&
+           info.sampleRate == first.sampleRate && pos + info.frameSize <= len) {
+        if (pos == (size_t)offset && mp3_frame::parse_vbr_tag(data + pos, info.frameSize, info, &tag)) {
+            hasTag = true;  // The tag frame isn't audio, its bitrate says nothing
+        } else {
+            kbpsSum += info.bitrateKbps;
+            minKbps = std::min(minKbps, info.bitrateKbps);
+            maxKbps = std::max(maxKbps, info.bitrateKbps);
+            frames++;
+        }
+        pos += info.frameSize;
+    }
+    if (frames < PROBE_MIN_FRAMES) {
+        return false;
+    }
+
+    format->codec      = hal::HalBase::RADIO_CODEC_MP3;
+    format->sampleRate = first.sampleRate;
+    format->channels   = first.channels;
+    format->vbr        = hasTag ? tag.vbr : (minKbps != maxKbps);
+    format->bitrate    = (int)(kbpsSum / frames);
+    if (hasTag && tag.frames > 0 && tag.bytes > 0) {
+        // The tag covers the whole file, better than a few frames
+        uint64_t bits   = (uint64_t)tag.bytes * 8 * first.sampleRate;
+        format->bitrate  = (int)(bits / ((uint64_t)tag.frames * mp3_frame::samples_per_frame(first) * 1000));
+    }
+    return true;
+}
+
+static bool probe_adts(const uint8_t* data, size_t len, hal::HalBase::RadioStreamFormat_t* format)
+{
+    adts_frame::FrameInfo_t first;
+    int offset = adts_frame::find_frame(data, len, &first);
+    if (offset < 0) {
+        return false;
+    }
+
+    int frames     = 0;
+    uint64_t bytes = 0;
+    size_t pos     = offset;
+    adts_frame::FrameInfo_t info;
+    while (pos + adts_frame::HEADER_SIZE <= len && adts_frame::parse_header(data + pos, &info) &&
+           info.sampleRate == first.sampleRate && pos + info.frameSize <= len) {
+        bytes += info.frameSize;
+        frames++;
+        pos += info.frameSize;
+    }
+    if (frames < PROBE_MIN_FRAMES) {
+        return false;
+    }
+
+    format->codec    = hal::HalBase::RADIO_CODEC_AAC;
+    format->channels = first.channels;
+    format->vbr      = first.vbr;
+    format->bitrate  = (int)(bytes * 8 * first.sampleRate / ((uint64_t)frames * adts_frame::SAMPLES_PER_FRAME * 1000));
+    // HE-AAC signals SBR implicitly, but a core rate of 24 kHz or less almost always means SBR doubles it. The
+    // decoder corrects the guess if not
+    format->sampleRate = (first.sampleRate <= 24000) ? first.sampleRate * 2 : first.sampleRate;
+    return true;
+}
+
+static hal::HalBase::RadioCodec_t radio_codec(StreamCodec_t codec)
+{
+    switch (codec) {
+        case CODEC_AAC:
+            return hal::HalBase::RADIO_CODEC_AAC;
+        case CODEC_OPUS:
+            return hal::HalBase::RADIO_CODEC_OPUS;
+        case CODEC_FLAC:
+            return hal::HalBase::RADIO_CODEC_FLAC;
+        default:
+            return hal::HalBase::RADIO_CODEC_MP3;
+    }
+}
+
+// Samples at 48 kHz in an Opus packet, from its TOC byte (RFC 6716 3.1), 0 if it's malformed
+static int opus_packet_samples(const uint8_t* packet, size_t len)
+{
+    if (len < 1) {
+        return 0;
+    }
+    static const int16_t frameSamples[32] = {480, 960, 1920, 2880, 480, 960, 1920, 2880, 480, 960, 1920, 2880,
+                                             480, 960, 480,  960,  120, 240, 480,  960,  120, 240, 480,  960,
+                                             120, 240, 480,  960,  120, 240, 480,  960};
+    int count = packet[0] & 0x03;
+    if (count == 3) {
+        count = len >= 2 ? (packet[1] & 0x3F) : 0;
+    } else {
+        count = (count == 0) ? 1 : 2;
+    }
+    return frameSamples[packet[0] >> 3] * count;
+}
+
+/**
+ * @brief The format from a config packet and the audio packets after it
+ *
+ * Packets are framed by the demuxer, so one audio packet behind the config is proof enough. Joined between two
+ * configs there's nothing to go by, the decoder's first output sets the format then.
+ */
+static bool probe_packets(StreamCodec_t codec, const uint8_t* data, size_t len,
+                          hal::HalBase::RadioStreamFormat_t* format)
+{
+    FrameHeader_t header;
+    int offset = stream_frame::find_frame(codec, data, len, &header);
+    if (offset < 0) {
+        return false;
+    }
+
+    size_t pos       = offset;
+    bool config      = false;
+    int frames       = 0;
+    uint64_t bytes   = 0;
+    uint64_t samples = 0;
+    int blockSize    = 0;  // FLAC's, when it's fixed
+    while (pos + packet_frame::HEADER_SIZE <= len && stream_frame::parse_header(codec, data + pos, &header) &&
+           pos + header.frameSize <= len) {
+        const uint8_t* payload = data + pos + packet_frame::HEADER_SIZE;
+        size_t payloadLen      = header.frameSize - packet_frame::HEADER_SIZE;
+        if (header.config && !config && codec == CODEC_OPUS && payloadLen >= 19) {
+            config             = true;
+            format->sampleRate = 48000;  // The decoder's output, whatever the encoder's input was
+            format->channels   = payload[9];
+        } else if (header.config && !config && codec == CODEC_FLAC && payloadLen >= 42) {
+            // "fLaC", the STREAMINFO block header, then block sizes, frame sizes and the 20 bit rate
+            const uint8_t* info = payload + 8;
+            config              = true;
+            format->sampleRate  = ((int)info[10] << 12) | ((int)info[11] << 4) | (info[12] >> 4);
+            format->channels    = ((info[12] >> 1) & 0x07) + 1;
+            int minBlock        = ((int)info[0] << 8) | info[1];
+            int maxBlock        = ((int)info[2] << 8) | info[3];
+            blockSize           = (minBlock == maxBlock) ? minBlock : 0;
+        } else if (config && !header.config) {
+            int packetSamples = (codec == CODEC_OPUS) ? opus_packet_samples(payload, payloadLen) : blockSize;
+            if (packetSamples > 0) {
+                bytes += payloadLen;
+                samples += packetSamples;
+                frames++;
+            }
+        }
+        pos += header.frameSize;
+    }
+    if (!config || frames == 0 || format->sampleRate <= 0) {
+        return false;
+    }
+
+    format->codec   = radio_codec(codec);
+    format->vbr     = true;  // Opus streams nearly always are, FLAC always
+    format->bitrate = (int)(bytes * 8 * format->sampleRate / (samples * 1000));
+    return true;
+}
+
+/**
+ * @brief Work out the format from the frames at the front of `conn`'s ring, without consuming them
+ *
+ * @return false until PROBE_MIN_FRAMES consecutive frames are buffered
+ */
+static bool probe_stream_format(StreamConnection* conn, hal::HalBase::RadioStreamFormat_t* format)
+{
+    uint8_t* window = (uint8_t*)stream_pool().alloc(PROBE_WINDOW);
+    if (!window) {
+        return false;
+    }
+    size_t len          = conn->ringBuffer.peek(window, PROBE_WINDOW);
+    StreamCodec_t codec = conn->codec;
+    bool found          = false;
+    if (stream_frame::is_packet(codec)) {
+        found = probe_packets(codec, window, len, format);
+    } else {
+        found = (codec == CODEC_AAC) ? probe_adts(window, len, format) : probe_mp3(window, len, format);
+    }
+    stream_pool().free(window);
+
+    if (found) {
+        mclog::tagInfo(TAG, "Stream format: {} {} Hz, {} ch, {} kbps {}", stream_frame::codec_name(codec),
+                       format->sampleRate, format->channels, format->bitrate, format->vbr ? "VBR" : "CBR");
+    }
+    return found;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                           Spectrum Analyzer                                */
+/* -------------------------------------------------------------------------- */
+// The decoder only copies a mono downmix of its output into a window, the FFT runs on a low priority task of its own
+// at display rate. Neither the decode loop nor the I2S writes pay for it
+#define SPECTRUM_INTERVAL_MS 33                                // ~30 fps, what the UI redraws at
+#define SPECTRUM_WINDOW      (SpectrumAnalyzer::FFT_SIZE * 4)  // Mono history, room for a whole HE-AAC frame
+#define SPECTRUM_BANDS       32                                // Until the UI asks for something else
+#define SPECTRUM_MIN_BANDS   8
+#define SPECTRUM_FLOOR_DB    -96.0f
+#define SPECTRUM_JOIN_MS     200  // An interval and an analysis, below the decoder on its core
+
+using RadioSpectrum_t = hal::HalBase::RadioSpectrum_t;
+static_assert(RadioSpectrum_t::MAX_BANDS <= SpectrumAnalyzer::MAX_BANDS, "Frame has more bands than the analyzer");
+
+static int16_t s_pcm_window[SPECTRUM_WINDOW];
+static std::atomic<uint32_t> s_pcm_written{0};  // Total mono samples, the decoder is the only writer
+static std::atomic<int> s_pcm_rate{44100};
+static JoinableTask s_spectrum_task;
+
+// Written by the spectrum task only, read by getRadioSpectrum() (the UI) without a lock
+static TripleBuffer<RadioSpectrum_t> s_spectrum_frames;
+static uint32_t s_spectrum_version = 0;  // Carries over restarts, so a reader never sees it go back
+static std::atomic<int> s_spectrum_bands{SPECTRUM_BANDS};
+
+// The waveform off the same history, at the same rate, only while the UI asks for columns
+using RadioWaveform_t = hal::HalBase::RadioWaveform_t;
+static TripleBuffer<RadioWaveform_t> s_waveform_frames;
+static uint32_t s_waveform_version = 0;
+static std::atomic<int> s_waveform_columns{0};
+static int s_waveform_flat = 0;  // Columns of the last frame if it went out flat, another wouldn't change a pixel
+
+/**
+ * @brief Hand decoded PCM to the analyzer, called by the decoder with what it writes to I2S
+ */
+static void spectrum_tap(const int16_t* pcm, int samples, int channels, int sampleRate)
+{
+    uint32_t pos = s_pcm_written.load(std::memory_order_relaxed);
+    int frames   = samples / channels;
+    for (int i = 0; i < frames; i++) {
+        int32_t sum = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            sum += pcm[i * channels + ch];
+        }
+        s_pcm_window[(pos + i) & (SPECTRUM_WINDOW - 1)] = (int16_t)(sum / channels);
+    }
+    s_pcm_rate.store(sampleRate, std::memory_order_relaxed);
+    s_pcm_written.store(pos + frames, std::memory_order_release);
+}
+
+static float level_db(float amplitude)
+{
+    return (amplitude > 0) ? std::max(SPECTRUM_FLOOR_DB, 20.0f * log10f(amplitude / 32768.0f)) : SPECTRUM_FLOOR_DB;
+}
+
+static void publish_spectrum(const int16_t* samples, int bands, const uint8_t* levels)
+{
+    int64_t sumSquares = 0;
+    int peak           = 0;
+    for (int i = 0; i < SpectrumAnalyzer::FFT_SIZE; i++) {
+        sumSquares += (int32_t)samples[i] * samples[i];
+        peak = std::max(peak, abs((int)samples[i]));
+    }
+
+    RadioSpectrum_t& frame = s_spectrum_frames.back();
+    frame.version          = ++s_spectrum_version;
+    frame.timestampMs      = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    frame.bands            = bands;
+    frame.rmsDb            = level_db(sqrtf((float)sumSquares / SpectrumAnalyzer::FFT_SIZE));
+    frame.peakDb           = level_db((float)peak);
+    memcpy(frame.levels, levels, bands);
+    s_spectrum_frames.publish();
+}
+
+static void publish_waveform(uint32_t end, bool silent)
+{
+    int columns = s_waveform_columns.load(std::memory_order_relaxed);
+    if (columns == 0 || (silent && s_waveform_flat == columns)) {
+        return;
+    }
+    RadioWaveform_t& frame = s_waveform_frames.back();
+    frame.version          = ++s_waveform_version;
+    frame.timestampMs      = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    frame.columns          = columns;
+    if (silent) {
+        memset(frame.min, 0, columns);
+        memset(frame.max, 0, columns);
+    } else {
+        WaveformDecimator::decimate(s_pcm_window, SPECTRUM_WINDOW - 1, end, s_pcm_rate.load(std::memory_order_relaxed),
+                                    columns, frame.min, frame.max);
+    }
+    s_waveform_frames.publish();
+    s_waveform_flat = silent ? columns : 0;
+}
+
+static void spectrum_task(void* param, const CancelToken& token)
+{
+    SpectrumAnalyzer* analyzer = new SpectrumAnalyzer();
+    OnsetDetector* onsets      = new OnsetDetector();
+    int16_t* samples           = (int16_t*)malloc(SpectrumAnalyzer::FFT_SIZE * sizeof(int16_t));
+    uint8_t levels[RadioSpectrum_t::MAX_BANDS];
+    int bands = s_spectrum_bands.load();
+    if (!samples || !analyzer->init()) {
+        mclog::tagError(TAG, "Spectrum analyzer init failed");
+    } else {
+        uint32_t lastEnd = s_pcm_written.load();
+        TickType_t wake  = xTaskGetTickCount();
+        while (!token.cancelled()) {
+            vTaskDelayUntil(&wake, pdMS_TO_TICKS(SPECTRUM_INTERVAL_MS));
+
+            // The newest FFT_SIZE samples. Paused or rebuffering there's nothing new, silence lets the bars fall
+            uint32_t end = s_pcm_written.load(std::memory_order_acquire);
+            bool silent  = end == lastEnd;
+            if (silent) {
+                memset(samples, 0, SpectrumAnalyzer::FFT_SIZE * sizeof(int16_t));
+            } else {
+                uint32_t begin = end - SpectrumAnalyzer::FFT_SIZE;
+                for (int i = 0; i < SpectrumAnalyzer::FFT_SIZE; i++) {
+                    samples[i] = s_pcm_window[(begin + i) & (SPECTRUM_WINDOW - 1)];
+                }
+            }
+            lastEnd = end;
+
+            // A band's held level means nothing once the bands are laid out differently
+            int wanted = s_spectrum_bands.load(std::memory_order_relaxed);
+            if (wanted != bands) {
+                bands = wanted;
+                analyzer->reset();
+            }
+
+            analyzer->process(samples, s_pcm_rate.load(std::memory_order_relaxed), levels, bands);
+            publish_spectrum(samples, bands, levels);
+            if (onsets->process(analyzer->bandDb(), bands, xTaskGetTickCount() * portTICK_PERIOD_MS)) {
+                hal_post_event(hal::HalBase::EVENT_RADIO_BEAT, onsets->bpm());
+            }
+            publish_waveform(end, silent);
+        }
+    }
+
+    // Leave a silent frame behind so the display doesn't freeze on the last one
+    if (samples) {
+        memset(samples, 0, SpectrumAnalyzer::FFT_SIZE * sizeof(int16_t));
+        memset(levels, 0, sizeof(levels));
+        publish_spectrum(samples, bands, levels);
+        publish_waveform(0, true);
+    }
+    free(samples);
+    delete onsets;
+    delete analyzer;
+    mclog::tagInfo(TAG, "Spectrum task ended, {} B stack left", task_topology::stack_headroom());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Output Processing                               */
+/* -------------------------------------------------------------------------- */
+// While the decoder runs it owns the output level: the codec sits at full scale and PcmDsp ramps the volume, so a
+// slider drag doesn't zipper. The EQ and normalizer settings are handed over the same way, picked up per frame
+#define OUTPUT_CODEC_VOLUME 100
+#define VOLUME_RANGE_DB     49.5f  // Volume 1 to 100, the same curve the codec driver uses
+static_assert(PCM_SLICE_FRAMES <= PcmDsp::MAX_FRAMES && PCM_SLICE_FRAMES <= Resampler::MAX_INPUT,
+              "PcmDsp and the resampler can't take a whole slice");
+
+static std::atomic<int> s_output_volume{60};
+static std::atomic<bool> s_output_owned{false};
+static Snapshot<hal::HalBase::RadioEq_t> s_output_eq;
+static std::atomic<uint32_t> s_output_eq_version{0};
+
+static float volume_gain(int volume)
+{
+    if (volume <= 0) {
+        return 0.0f;
+    }
+    return powf(10.0f, -VOLUME_RANGE_DB * (100 - std::min(volume, 100)) / 100.0f / 20.0f);
+}
+
+/**
+ * @brief Pass the latest volume and, if it changed, EQ to the decoder's DSP
+ */
+static void apply_output_settings(PcmDsp* dsp, uint32_t* eqVersion)
+{
+    dsp->setVolume(volume_gain(s_output_volume.load(std::memory_order_relaxed)));
+
+    uint32_t version = s_output_eq_version.load(std::memory_order_acquire);
+    if (version == *eqVersion) {
+        return;
+    }
+    *eqVersion                    = version;
+    hal::HalBase::RadioEq_t eq    = s_output_eq.load();
+    float gains[PcmDsp::EQ_BANDS] = {(float)eq.bassDb, (float)eq.midDb, (float)eq.trebleDb};
+    dsp->setEq(gains);
+    dsp->setNormalize(eq.normalize);
+}
+
+/**
+ * @brief Hand the track gain over once the decoder reaches the track it's for
+ *
+ * @param version last one applied, UINT32_MAX after a station change so even the same number is taken
+ */
+static void apply_track_gain(PcmDsp* dsp, const FrameHeader_t& header, uint32_t* version)
+{
+    TrackGain_t gain = s_audio_conn->trackGain.load();
+    size_t start     = s_audio_conn->ringBuffer.readPosition() - header.frameSize;
+    if ((gain.version == *version && *version != UINT32_MAX) || (ptrdiff_t)(start - gain.at) < 0) {
+        return;
+    }
+    *version = gain.version;
+    dsp->setTrackGain(gain.known, gain.gainDb);
+    if (gain.known) {
+        mclog::tagInfo(TAG, "Track gain {:.1f} dB from its tags", gain.gainDb);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                PCM Output                                  */
+/* -------------------------------------------------------------------------- */
+// I2S runs at 48 kHz stereo all the time, a stream at any other rate is converted on its way in, so the codec is
+// never re-clocked mid-stream and UI sounds (48 kHz too) can be mixed on top of the radio.
+// The decoder hands finished frames to a writer task instead of blocking on I2S itself, so a frame that takes long
+// to arrive (read stall, network) eats into OUTPUT_BLOCKS of slack plus the DMA ring first. The writer holds back
+// the last few ms of every block: if the next one is late, that tail goes out faded to zero and is counted as an
+// underrun, instead of the DMA cutting off mid-waveform with a click. The next block fades back in.
+// A USB DAC (hal_usb_audio.cpp) takes the blocks instead of I2S while one is plugged in, paced by its own ring.
+// Headphones going in or out switch the speaker amp between blocks (audio_route_pending()): the block fades out,
+// the DMA ring is filled with silence and once that's all it holds the amp is switched, the next block fades in
+#define OUTPUT_RATE           48000
+#define OUTPUT_BLOCKS         3     // Blocks queued ahead of I2S
+#define OUTPUT_BLOCK_FRAMES   2048  // ~43 ms, stereo
+#define OUTPUT_WAIT_MS        40    // Well inside the ~85 ms DMA ring, a block later than this is concealed
+#define OUTPUT_TAIL_FRAMES    128   // ~3 ms
+#define OUTPUT_I2S_RING_MS    85    // 8 DMA buffers of 511 frames (m5stack_tab5.c)
+#define OUTPUT_WRITE_MS       1000
+#define OUTPUT_JOIN_MS        (2 * OUTPUT_WRITE_MS + OUTPUT_WAIT_MS)  // A block and its tail at their timeouts
+#define OUTPUT_SILENCE_FRAMES 512  // A write of the silence ahead of a route switch, the ring takes a few
+
+struct OutputBlock_t {
+    int16_t* pcm     = nullptr;  // Stereo at OUTPUT_RATE
+    int samples      = 0;
+    int64_t queuedUs = 0;  // When the decoder handed it over
+    uint32_t tag     = 0;  // Of the frame it starts with, 0 for the rest (multi-room sync)
+};
+
+struct PcmOutput {
+    QueueHandle_t filled   = nullptr;  // OutputBlock_t*, in play order
+    QueueHandle_t empty    = nullptr;
+    OutputBlock_t blocks[OUTPUT_BLOCKS];
+    int16_t tail[OUTPUT_TAIL_FRAMES * 2];
+    int tailSamples        = 0;        // Held back from the last block, 0 once written out
+    bool faded             = true;     // Nothing playing, the next block fades in
+    std::atomic<int> pending{0};       // Blocks handed over and not completely written yet
+    volatile bool draining = false;    // Running dry on purpose (pause, stop), not an underrun
+    JoinableTask task;
+    std::atomic<bool> ended{true};       // The task is done with the blocks, even one that outlived its join
+    std::atomic<uint32_t> underruns{0};  // Since boot
+    std::atomic<bool> usb{false};        // Where the last block went, the USB DAC or I2S
+    std::atomic<uint32_t> latencyUs{0};  // The last block's, handed over until its end is heard
+    uint32_t maxLatencyUs = 0;           // Since the start, the output task's only
+    uint64_t sumLatencyUs = 0;
+    uint32_t blocksOut    = 0;
+
+    // Decoder side
+    Resampler* src = nullptr;
+    int inRate     = 0;
+    int inChannels = 0;
+};
+
+static PcmOutput s_output;
+
+static void crossfade_mix(int16_t* pcm, int frames);  // Station Crossfade
+
+static HOT_PATH void ramp(int16_t* pcm, int samples, bool in)
+{
+    int frames = samples / 2;
+    for (int i = 0; i < frames; i++) {
+        int32_t gain   = in ? i : frames - 1 - i;
+        pcm[i * 2]     = (int16_t)((int32_t)pcm[i * 2] * gain / frames);
+        pcm[i * 2 + 1] = (int16_t)((int32_t)pcm[i * 2 + 1] * gain / frames);
+    }
+}
+
+static HOT_PATH void output_write(bsp_codec_config_t* codec, const int16_t* pcm, int samples)
+{
+    size_t written = 0;
+    StreamTrace::Span span(TRACE_I2S_WRITE, samples * sizeof(int16_t));
+#if CONFIG_TAB5_USB_AUDIO
+    // A DAC unplugged mid-write, the rest goes to the speaker
+    if (usb_audio_active() && usb_audio_write(pcm, samples, OUTPUT_WRITE_MS)) {
+        s_output.usb = true;
+        return;
+    }
+#endif
+    s_output.usb = false;
+    codec->i2s_write((void*)pcm, samples * sizeof(int16_t), &written, OUTPUT_WRITE_MS);
+}
+
+// What's queued in the sink's own ring is heard after the block's end went in
+static int output_ring_ms()
+{
+#if CONFIG_TAB5_USB_AUDIO
+    if (s_output.usb) {
+        return usb_audio_buffer_ms();
+    }
+#endif
+    return OUTPUT_I2S_RING_MS;
+}
+
+static void output_account_latency(const OutputBlock_t* block)
+{
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - block->queuedUs) + output_ring_ms() * 1000;
+    s_output.latencyUs.store(latency, std::memory_order_relaxed);
+    s_output.maxLatencyUs = std::max(s_output.maxLatencyUs, latency);
+    s_output.sumLatencyUs += latency;
+    s_output.blocksOut++;
+}
+
+/**
+ * @brief Fade `block` out and switch the speaker amp once it's been heard, the next block fades back in
+ */
+static void output_switch_route(bsp_codec_config_t* codec, OutputBlock_t* block)
+{
+    static const int16_t silence[OUTPUT_SILENCE_FRAMES * 2] = {};
+    ramp(block->pcm, block->samples, false);
+    output_write(codec, block->pcm, block->samples);
+    output_account_latency(block);
+    if (block->tag) {
+        int64_t written = (int64_t)block->samples / 2 * 1000000 / OUTPUT_RATE;
+        sync_frame_heard(block->tag, esp_timer_get_time() + output_ring_ms() * 1000 - written);
+    }
+    if (!s_output.usb) {
+        // Each write returns once there's room for it, after the last one the ring holds nothing but silence
+        for (int frames = 0; frames < OUTPUT_RATE * OUTPUT_I2S_RING_MS / 1000; frames += OUTPUT_SILENCE_FRAMES) {
+            output_write(codec, silence, OUTPUT_SILENCE_FRAMES * 2);
+        }
+    }
+    audio_route_apply();
+    s_output.faded = true;
+}
+
+static HOT_PATH void output_task(void* param, const CancelToken& token)
+{
+    bsp_codec_config_t* codec = bsp_get_codec_handle();
+    AudioMixer& mixer         = GetHAL()->audioMixer;
+    uint32_t blocks           = 0;
+    while (!token.cancelled()) {
+        OutputBlock_t* block = nullptr;
+        if (xQueueReceive(s_output.filled, &block, pdMS_TO_TICKS(OUTPUT_WAIT_MS)) != pdTRUE) {
+            if (s_output.tailSamples > 0) {
+                if (!s_output.draining) {
+                    s_output.underruns++;
+                    s_metric_underruns.inc();
+                    stream_trace().record(TRACE_UNDERRUN, TRACE_INSTANT);
+                }
+                ramp(s_output.tail, s_output.tailSamples, false);
+                output_write(codec, s_output.tail, s_output.tailSamples);
+                s_output.tailSamples = 0;
+                s_output.faded       = true;
+                s_output.pending--;
+            } else if (audio_route_pending()) {
+                audio_route_apply();  // Nothing's been written for a wait, the ring has played out
+            }
+            continue;
+        }
+
+        stage_work(STAGE_OUTPUT);
+        if (s_output.faded) {
+            ramp(block->pcm, std::min(block->samples, OUTPUT_TAIL_FRAMES * 2), true);
+            s_output.faded = false;
+        }
+        mixer.mix(block->pcm, block->samples / 2, volume_gain(s_output_volume.load(std::memory_order_relaxed)));
+        if (s_output.tailSamples > 0) {
+            output_write(codec, s_output.tail, s_output.tailSamples);
+            s_output.pending--;
+        }
+        if (audio_route_pending()) {
+            output_switch_route(codec, block);
+            s_output.tailSamples = 0;
+            s_output.pending--;
+            xQueueSend(s_output.empty, &block, 0);
+            stage_beat(STAGE_OUTPUT);
+            continue;
+        }
+
+        // Everything but the new tail, which waits for the next block or the fade-out
+        int tail = std::min(OUTPUT_TAIL_FRAMES, block->samples / 4) * 2;
+        output_write(codec, block->pcm, block->samples - tail);
+        output_account_latency(block);
+        if (block->tag) {
+            int64_t written = (int64_t)(block->samples - tail) / 2 * 1000000 / OUTPUT_RATE;
+            sync_frame_heard(block->tag, esp_timer_get_time() + output_ring_ms() * 1000 - written);
+        }
+        memcpy(s_output.tail, block->pcm + block->samples - tail, tail * sizeof(int16_t));
+        s_output.tailSamples = tail;
+        if (tail == 0) {
+            s_output.pending--;
+        }
+        xQueueSend(s_output.empty, &block, 0);
+        stage_beat(STAGE_OUTPUT);
+        metric_report_stack(&s_metric_stack_output, blocks++);
+    }
+    mclog::tagInfo(TAG, "Output task ended, {} B stack left", task_topology::stack_headroom());
+    s_output.ended.store(true);
+}
+
+static void pcm_output_free()
+{
+    for (int i = 0; i < OUTPUT_BLOCKS; i++) {
+        internal_pool().free(s_output.blocks[i].pcm);
+        s_output.blocks[i].pcm = nullptr;
+    }
+    if (s_output.filled) {
+        vQueueDelete(s_output.filled);
+        s_output.filled = nullptr;
+    }
+    if (s_output.empty) {
+        vQueueDelete(s_output.empty);
+        s_output.empty = nullptr;
+    }
+    delete s_output.src;
+    s_output.src = nullptr;
+}
+
+static bool pcm_output_start()
+{
+    if (!s_output.ended.load()) {
+        mclog::tagError(TAG, "Output: the last output task hasn't ended yet, its blocks are still out");
+        return false;
+    }
+    pcm_output_free();  // What a task that outlived its stop left behind
+    s_output.filled       = xQueueCreate(OUTPUT_BLOCKS, sizeof(OutputBlock_t*));
+    s_output.empty        = xQueueCreate(OUTPUT_BLOCKS, sizeof(OutputBlock_t*));
+    s_output.src          = new (std::nothrow) Resampler();
+    s_output.inRate       = 0;
+    s_output.inChannels   = 0;
+    s_output.tailSamples  = 0;
+    s_output.faded        = true;
+    s_output.pending      = 0;
+    s_output.draining     = false;
+    s_output.maxLatencyUs = 0;
+    s_output.sumLatencyUs = 0;
+    s_output.blocksOut    = 0;
+    bool ok               = s_output.filled && s_output.empty && s_output.src;
+    for (int i = 0; ok && i < OUTPUT_BLOCKS; i++) {
+        OutputBlock_t* block = &s_output.blocks[i];
+        block->pcm = (int16_t*)internal_pool().alloc(OUTPUT_BLOCK_FRAMES * 2 * sizeof(int16_t));
+        ok = block->pcm && xQueueSend(s_output.empty, &block, 0) == pdTRUE;
+    }
+    s_output.ended = !ok;
+    if (ok && !s_output.task.start(task_topology::RADIO_OUTPUT, output_task, nullptr)) {
+        s_output.ended = true;
+        ok             = false;
+    }
+    return ok;
+}
+
+/**
+ * @brief Format of what the decoder writes from now on, converted to the output rate
+ */
+static void pcm_output_configure(int sampleRate, int channels)
+{
+    if (!s_output.src->configure(sampleRate, OUTPUT_RATE, channels)) {
+        mclog::tagError(TAG, "Output: no conversion from {} Hz", sampleRate);
+        return;
+    }
+    s_output.inRate     = sampleRate;
+    s_output.inChannels = channels;
+}
+
+/**
+ * @brief Convert and queue a decoded frame for I2S, blocks while all blocks are taken, which paces the decoder
+ *
+ * @param tag identifies the frame to sync_frame_heard() once its first block is heard, 0 for none
+ */
+static void pcm_output_write(const int16_t* pcm, int samples, uint32_t tag = 0)
+{
+    if (s_output.inRate <= 0) {
+        return;
+    }
+    int frames = samples / s_output.inChannels;
+
+    // Input per block, so the converted audio always fits whatever the trim
+    int chunk = std::min(s_output.src->maxInput(OUTPUT_BLOCK_FRAMES), Resampler::MAX_INPUT);
+    while (frames > 0) {
+        OutputBlock_t* block = nullptr;
+        while (xQueueReceive(s_output.empty, &block, pdMS_TO_TICKS(100)) != pdTRUE) {
+            if (s_radio.stopRequested || !s_output.task) {
+                return;
+            }
+        }
+        int n          = std::min(frames, chunk);
+        int produced   = s_output.src->process(pcm, n, block->pcm, OUTPUT_BLOCK_FRAMES);
+        block->samples  = produced * 2;
+        block->queuedUs = esp_timer_get_time();
+        block->tag      = tag;
+        tag             = 0;
+        crossfade_mix(block->pcm, produced);
+        pcm += n * s_output.inChannels;
+        frames -= n;
+
+        s_output.pending++;
+        xQueueSend(s_output.filled, &block, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief Let everything queued play out and fade, before the output is muted or stopped
+ */
+static void pcm_output_drain()
+{
+    s_output.draining = true;
+    for (int waited = 0; s_output.pending > 0 && s_output.task && waited < 500; waited += 5) {
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    s_output.draining = false;
+}
+
+static void pcm_output_stop()
+{
+    if (s_output.task) {
+        pcm_output_drain();
+    }
+    if (!s_output.task.stop(OUTPUT_JOIN_MS)) {
+        // Not freed under it, the next start does once it has ended
+        mclog::tagError(TAG, "Output task still running after {} ms, keeping its blocks", OUTPUT_JOIN_MS);
+        return;
+    }
+    pcm_output_free();
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Decode Supervisor                               */
+/* -------------------------------------------------------------------------- */
+// Bad frames are skipped one by one, but a run of them (a false sync chain, decoder state wrecked by a corrupt frame)
+// or a run of frames without output means the decoder itself is stuck. It's then reopened in place and the read
+// goes on from the next frame header, while I2S keeps running: the last output fades to zero, the gap is filled with
+// silence and the first good frame fades back in. That's a few ms of audio instead of a stopped stream.
+#define DESYNC_ERROR_LIMIT 4    // Consecutive decode errors before the decoder is restarted
+#define STALL_FRAME_LIMIT  24   // Consecutive frames without output (MP3 bit reservoir refill takes a few)
+#define FADE_FRAMES        128  // Per channel, ~3 ms at 44.1 kHz
+
+struct DecodeSupervisor {
+    int badFrames        = 0;       // Consecutive errors
+    int silentFrames     = 0;       // Consecutive frames that gave no output
+    bool faded           = false;   // Output faded out, the next good frame fades in
+    int16_t last[2]      = {0, 0};  // Last output sample per channel, the fade-out starts from it
+    int lastSamples      = 0;       // Size of the last output, the silence written per missing frame
+    uint32_t restarts    = 0;
+    uint32_t glitchStart = 0;
+};
+
+/**
+ * @brief Ramp from the last output sample to zero, so the gap that follows doesn't click
+ */
+static void write_fade_out(DecodeSupervisor* sv, int16_t* pcm, int channels)
+{
+    for (int i = 0; i < FADE_FRAMES; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            pcm[i * channels + ch] = (int16_t)((int32_t)sv->last[ch & 1] * (FADE_FRAMES - 1 - i) / FADE_FRAMES);
+        }
+    }
+    pcm_output_write(pcm, FADE_FRAMES * channels);
+}
+
+static void write_silence(int16_t* pcm, int samples, int channels)
+{
+    memset(pcm, 0, samples * sizeof(int16_t));
+    pcm_output_write(pcm, samples);
+}
+
+static void fade_in(int16_t* pcm, int samples, int channels)
+{
+    int frames = std::min(samples / channels, FADE_FRAMES);
+    for (int i = 0; i < frames; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            pcm[i * channels + ch] = (int16_t)((int32_t)pcm[i * channels + ch] * i / frames);
+        }
+    }
+}
+
+/**
+ * @brief Account for a frame that gave no output and keep I2S fed
+ *
+ * @return true if the decoder has to be restarted
+ */
+static bool handle_bad_frame(DecodeSupervisor* sv, bool error, int16_t* pcm, int channels, bool playing)
+{
+    if (error) {
+        sv->badFrames++;
+    } else {
+        sv->silentFrames++;
+    }
+    bool restart = sv->badFrames >= DESYNC_ERROR_LIMIT || sv->silentFrames >= STALL_FRAME_LIMIT;
+    if (restart) {
+        mclog::tagWarn(TAG, "Decoder {}: restarting in place",
+                       sv->badFrames >= DESYNC_ERROR_LIMIT ? "desync" : "stall");
+        sv->badFrames    = 0;
+        sv->silentFrames = 0;
+        sv->restarts++;
+    }
+    if (!playing || channels <= 0) {
+        return restart;  // Still starting up, nothing is being heard yet
+    }
+
+    if (!sv->faded) {
+        write_fade_out(sv, pcm, channels);
+        sv->faded       = true;
+        sv->glitchStart = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    }
+    // The missing frame's duration as silence, so the DMA never runs dry and repeats stale audio
+    if (sv->lastSamples > 0) {
+        write_silence(pcm, sv->lastSamples, channels);
+    }
+    return restart;
+}
+
+/**
+ * @brief A frame decoded fine: end any glitch with a fade-in and remember where the output ends
+ */
+static void handle_good_frame(DecodeSupervisor* sv, int16_t* pcm, int samples, int channels)
+{
+    sv->badFrames    = 0;
+    sv->silentFrames = 0;
+    if (sv->faded) {
+        fade_in(pcm, samples, channels);
+        sv->faded = false;
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        mclog::tagInfo(TAG, "Decoder recovered after {} ms", now - sv->glitchStart);
+    }
+    for (int ch = 0; ch < channels && ch < 2; ch++) {
+        sv->last[ch] = pcm[samples - channels + ch];
+    }
+    if (channels == 1) {
+        sv->last[1] = sv->last[0];
+    }
+    sv->lastSamples = samples;
+}
+
+/**
+ * @brief Jump to the sync master's output (hal_sync.cpp): silence while it's behind, frames dropped while ahead
+ *
+ * The output fades out first, the first good frame after the silence or the drop fades back in.
+ */
+static void sync_step(DecodeSupervisor* sv, int16_t* pcm, int channels, int sampleRate, int64_t* dropUs)
+{
+    int64_t step = sync_take_step();
+    if (step == 0 || channels <= 0 || sampleRate <= 0) {
+        return;
+    }
+    if (!sv->faded) {
+        write_fade_out(sv, pcm, channels);
+        sv->faded       = true;
+        sv->glitchStart = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    }
+    if (step > 0) {
+        *dropUs += step;
+        return;
+    }
+    for (int64_t frames = -step * sampleRate / 1000000; frames > 0;) {
+        int n = (int)std::min<int64_t>(frames, PCM_MAX_SAMPLES / channels);
+        write_silence(pcm, n * channels, channels);
+        frames -= n;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Frame Decoder                                 */
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief One frame in, PCM out, for any codec
+ *
+ * Opus and FLAC are opened by the config packet in the stream. The last one is kept across open() and close(), a
+ * restart in place or a zap back to the same stream doesn't have to wait for the next. Audio packets before any
+ * config give no output.
+ */
+class StreamDecoder {
+public:
+    ~StreamDecoder()
+    {
+        close();
+    }
+
+    bool open(StreamCodec_t codec)
+    {
+        close();
+        if (codec != _codec) {
+            _config_len = 0;  // Another codec's
+        }
+        _codec = codec;
+        if (codec == CODEC_AAC) {
+            esp_aac_dec_cfg_t cfg = {};
+            cfg.aac_plus_enable   = true;  // HE-AAC v1/v2 (SBR, PS)
+            if (esp_aac_dec_open(&cfg, sizeof(cfg), &_aac) != ESP_AUDIO_ERR_OK) {
+                _aac = nullptr;
+                return false;
+            }
+        } else if (stream_frame::is_packet(codec)) {
+            if (_config_len > 0 && !open_packets()) {
+                return false;
+            }
+        } else {
+            _mp3 = MP3InitDecoder();
+            if (!_mp3) {
+                return false;
+            }
+        }
+        _is_open = true;
+        return true;
+    }
+
+    void close()
+    {
+        if (_mp3) {
+            MP3FreeDecoder(_mp3);
+            _mp3 = nullptr;
+        }
+        if (_aac) {
+            esp_aac_dec_close(_aac);
+            _aac = nullptr;
+        }
+        close_packets();
+        _is_open = false;
+    }
+
+    bool isOpen() const
+    {
+        return _is_open;
+    }
+
+    StreamCodec_t codec() const
+    {
+        return _codec;
+    }
+
+    /**
+     * @brief Decode one frame, or take a config packet
+     *
+     * @return samples written to `pcm` (all channels), 0 if the frame gave no output yet, -1 on a decode error or a
+     * config the decoder can't play
+     */
+    int decode(uint8_t* frame, size_t len, int16_t* pcm, size_t maxSamples, int* sampleRate, int* channels)
+    {
+        if (stream_frame::is_packet(_codec)) {
+            return decode_packet(frame, len, pcm, maxSamples, sampleRate, channels);
+        }
+        if (_codec == CODEC_AAC) {
+            esp_audio_dec_in_raw_t raw    = {};
+            raw.buffer                    = frame;
+            raw.len                       = len;
+            esp_audio_dec_out_frame_t out = {};
+            out.buffer                    = (uint8_t*)pcm;
+            out.len                       = maxSamples * sizeof(int16_t);
+            esp_audio_dec_info_t info     = {};
+            if (esp_aac_dec_decode(_aac, &raw, &out, &info) != ESP_AUDIO_ERR_OK) {
+                return -1;
+            }
+            *sampleRate = info.sample_rate;
+            *channels   = info.channel;
+            return out.decoded_size / sizeof(int16_t);
+        }
+
+        uint8_t* inPtr = frame;
+        int bytesLeft  = (int)len;
+        int err        = MP3Decode(_mp3, &inPtr, &bytesLeft, pcm, 0);
+        if (err != ERR_MP3_NONE) {
+            // Main data underflow is expected for the first frames after a sync, the bit reservoir is still empty
+            return (err == ERR_MP3_MAINDATA_UNDERFLOW) ? 0 : -1;
+        }
+        MP3FrameInfo frameInfo;
+        MP3GetLastFrameInfo(_mp3, &frameInfo);
+        *sampleRate = frameInfo.samprate;
+        *channels   = frameInfo.nChans;
+        return frameInfo.outputSamps;
+    }
+
+private:
+    bool open_packets()
+    {
+        close_packets();
+        if (_codec == CODEC_OPUS) {
+            // OpusHead: the channel count, then the pre-skip
+            int channels = _config[9];
+            if (_config_len < 19 || channels < 1 || channels > 2) {
+                return false;
+            }
+            esp_opus_dec_cfg_t cfg = ESP_OPUS_DEC_CONFIG_DEFAULT();
+            cfg.sample_rate        = 48000;
+            cfg.channel            = channels;
+            cfg.frame_duration     = ESP_OPUS_DEC_FRAME_DURATION_INVALID;  // Whatever each packet's TOC says
+            cfg.self_delimited     = false;
+            if (esp_opus_dec_open(&cfg, sizeof(cfg), &_packets) != ESP_AUDIO_ERR_OK) {
+                _packets = nullptr;
+                return false;
+            }
+            _skip = ((int)_config[11] << 8 | _config[10]) * channels;
+            return true;
+        }
+
+        // "fLaC" and STREAMINFO: the output is plain 16 bit PCM, mono or stereo
+        const uint8_t* info = _config + 8;
+        int bits            = (((info[12] & 0x01) << 4) | (info[13] >> 4)) + 1;
+        int channels        = ((info[12] >> 1) & 0x07) + 1;
+        if (_config_len < 42 || bits != 16 || channels > 2) {
+            return false;
+        }
+        if (esp_flac_dec_open(nullptr, 0, &_packets) != ESP_AUDIO_ERR_OK) {
+            _packets = nullptr;
+            return false;
+        }
+        // The decoder takes the stream header like the start of a file
+        esp_audio_dec_in_raw_t raw    = {};
+        raw.buffer                    = _config;
+        raw.len                       = _config_len;
+        esp_audio_dec_out_frame_t out = {};
+        esp_audio_dec_info_t decInfo  = {};
+        esp_audio_err_t err           = esp_flac_dec_decode(_packets, &raw, &out, &decInfo);
+        if (err != ESP_AUDIO_ERR_OK && err != ESP_AUDIO_ERR_DATA_LACK) {
+            close_packets();
+            return false;
+        }
+        _skip = 0;
+        return true;
+    }
+
+    void close_packets()
+    {
+        if (!_packets) {
+            return;
+        }
+        if (_codec == CODEC_OPUS) {
+            esp_opus_dec_close(_packets);
+        } else {
+            esp_flac_dec_close(_packets);
+        }
+        _packets = nullptr;
+    }
+
+    int decode_packet(uint8_t* frame, size_t len, int16_t* pcm, size_t maxSamples, int* sampleRate, int* channels)
+    {
+        packet_frame::FrameInfo_t header;
+        if (len <= packet_frame::HEADER_SIZE || !packet_frame::parse_header(frame, &header)) {
+            return -1;
+        }
+        uint8_t* payload  = frame + packet_frame::HEADER_SIZE;
+        size_t payloadLen = len - packet_frame::HEADER_SIZE;
+        if (header.config) {
+            // Repeated every few packets, only a different one (a chained stream) reopens
+            if (_packets && payloadLen == _config_len && memcmp(payload, _config, payloadLen) == 0) {
+                return 0;
+            }
+            if (payloadLen > sizeof(_config)) {
+                return -1;
+            }
+            memcpy(_config, payload, payloadLen);
+            _config_len = payloadLen;
+            return open_packets() ? 0 : -1;
+        }
+        if (!_packets) {
+            return 0;  // Joined between two configs
+        }
+
+        esp_audio_dec_in_raw_t raw    = {};
+        raw.buffer                    = payload;
+        raw.len                       = payloadLen;
+        esp_audio_dec_out_frame_t out = {};
+        out.buffer                    = (uint8_t*)pcm;
+        out.len                       = maxSamples * sizeof(int16_t);
+        esp_audio_dec_info_t info     = {};
+        esp_audio_err_t err           = (_codec == CODEC_OPUS) ? esp_opus_dec_decode(_packets, &raw, &out, &info)
+                                                               : esp_flac_dec_decode(_packets, &raw, &out, &info);
+        if (err != ESP_AUDIO_ERR_OK || info.bits_per_sample != 16) {
+            return -1;
+        }
+        *sampleRate = info.sample_rate;
+        *channels   = info.channel;
+        int samples = out.decoded_size / sizeof(int16_t);
+
+        // Opus streams start with the encoder's lookahead, RFC 7845 has it dropped
+        if (_skip > 0) {
+            int skip = std::min(_skip, samples);
+            memmove(pcm, pcm + skip, (samples - skip) * sizeof(int16_t));
+            samples -= skip;
+            _skip -= skip;
+        }
+        return samples;
+    }
+
+    StreamCodec_t _codec = CODEC_MP3;
+    HMP3Decoder _mp3     = nullptr;
+    void* _aac           = nullptr;
+    void* _packets       = nullptr;  // Opus or FLAC
+    bool _is_open        = false;
+    uint8_t _config[PacketDemuxer::MAX_CONFIG_SIZE];
+    size_t _config_len = 0;
+    int _skip          = 0;  // Samples (all channels) still to drop
+};
+
+/* -------------------------------------------------------------------------- */
+/*                              Station Crossfade                             */
+/* -------------------------------------------------------------------------- */
+// A zap to a warm station plays the outgoing one on from what its ring still holds (its HTTP task is already
+// closed) and crossfades the two at the output rate, equal power over s_crossfade_ms. Only the fade decodes twice:
+// the outgoing stream gets a second decoder and resampler but skips the EQ, loudness meter and spectrum, it keeps
+// the gain it had. Its buffers come out of PSRAM on the first zap and stay until the decoder ends.
+#define CROSSFADE_MIN_MS      500
+#define CROSSFADE_MAX_MS      3000
+#define CROSSFADE_FIFO_FRAMES (OUTPUT_BLOCK_FRAMES * 4)  // Stereo at the output rate, kept ahead of the new stream
+
+static std::atomic<int> s_crossfade_ms{1500};                  // 0 cuts straight over
+static std::atomic<StreamConnection*> s_fading_conn{nullptr};  // Its ring must not be reopened until the fade ends
+
+struct Crossfade {
+    StreamConnection* conn = nullptr;  // Outgoing station, nullptr when no fade runs
+    StreamDecoder decoder;
+    Resampler* src = nullptr;
+    uint8_t* frame = nullptr;
+    int16_t* pcm   = nullptr;
+    int16_t* fifo  = nullptr;
+    int fifoFrames = 0;
+    int sampleRate = 0;
+    int channels   = 0;
+    int pos        = 0;      // Output frames into the fade
+    int length     = 0;
+    float gain     = 1;      // Volume and loudness gain the outgoing stream had
+    bool dry       = false;  // Its ring ran out, what's in the FIFO is the last of it
+};
+
+static Crossfade s_crossfade;
+
+static bool crossfade_alloc(Crossfade* cf)
+{
+    if (!cf->fifo) {
+        cf->frame = (uint8_t*)stream_pool().alloc(FRAME_BUFFER_SIZE);
+        cf->pcm   = (int16_t*)stream_pool().alloc(PCM_MAX_SAMPLES * sizeof(int16_t));
+        cf->fifo  = (int16_t*)stream_pool().alloc(CROSSFADE_FIFO_FRAMES * 2 * sizeof(int16_t));
+        void* src = stream_pool().alloc(sizeof(Resampler));
+        cf->src   = src ? new (src) Resampler() : nullptr;
+    }
+    return cf->frame && cf->pcm && cf->fifo && cf->src;
+}
+
+static void crossfade_end(Crossfade* cf)
+{
+    if (cf->conn) {
+        mclog::tagInfo(TAG, "Crossfade done");
+    }
+    cf->decoder.close();
+    cf->conn = nullptr;
+    s_fading_conn.store(nullptr);
+}
+
+static void crossfade_free(Crossfade* cf)
+{
+    crossfade_end(cf);
+    stream_pool().free(cf->frame);
+    stream_pool().free(cf->pcm);
+    stream_pool().free(cf->fifo);
+    if (cf->src) {
+        cf->src->~Resampler();
+        stream_pool().free(cf->src);
+    }
+    cf->frame = nullptr;
+    cf->pcm   = nullptr;
+    cf->fifo  = nullptr;
+    cf->src   = nullptr;
+}
+
+/**
+ * @brief Keep playing `old` under the station that replaces it, for the configured time
+ */
+static void crossfade_start(Crossfade* cf, StreamConnection* old, float gain)
+{
+    crossfade_end(cf);
+    int ms = s_crossfade_ms.load();
+    if (ms <= 0 || old->ringBuffer.available() == 0 || !crossfade_alloc(cf)) {
+        return;
+    }
+    cf->conn       = old;
+    cf->fifoFrames = 0;
+    cf->sampleRate = 0;
+    cf->channels   = 0;
+    cf->pos        = 0;
+    cf->length     = OUTPUT_RATE / 1000 * ms;
+    cf->gain       = gain;
+    cf->dry        = false;
+    s_fading_conn.store(old);
+    mclog::tagInfo(TAG, "Crossfade over {} ms", ms);
+}
+
+static bool crossfade_read_frame(Crossfade* cf, FrameHeader_t* header)
+{
+    RingBuffer& ring    = cf->conn->ringBuffer;
+    StreamCodec_t codec = cf->conn->codec;
+    while (true) {
+        size_t window = ring.peek(cf->frame, FRAME_SCAN_WINDOW);
+        if (window < stream_frame::header_size(codec)) {
+            return false;
+        }
+        int offset = stream_frame::find_frame(codec, cf->frame, window, header);
+        if (offset < 0) {
+            ring.discard(window - (stream_frame::header_size(codec) - 1));
+            if (window < FRAME_SCAN_WINDOW) {
+                return false;
+            }
+            continue;
+        }
+        ring.discard(offset);
+        if (ring.available() < header->frameSize) {
+            return false;
+        }
+        ring.read(cf->frame, header->frameSize);
+        return true;
+    }
+}
+
+/**
+ * @brief Decode the outgoing station until the FIFO holds at least `frames` output frames
+ */
+static void crossfade_fill(Crossfade* cf, int frames)
+{
+    frames = std::min(frames, CROSSFADE_FIFO_FRAMES - OUTPUT_BLOCK_FRAMES);
+    while (cf->conn && !cf->dry && cf->fifoFrames < frames) {
+        FrameHeader_t header;
+        if (!crossfade_read_frame(cf, &header)) {
+            // Out of buffered audio before the fade is over, the last of it fades quickly instead of cutting off
+            ramp(cf->fifo, cf->fifoFrames * 2, false);
+            cf->dry = true;
+            break;
+        }
+        if ((!cf->decoder.isOpen() || cf->decoder.codec() != header.codec) && !cf->decoder.open(header.codec)) {
+            cf->dry = true;
+            break;
+        }
+
+        int rate     = 0;
+        int channels = 0;
+        int samples  = cf->decoder.decode(cf->frame, header.frameSize, cf->pcm, PCM_MAX_SAMPLES, &rate, &channels);
+        if (samples <= 0) {
+            continue;
+        }
+        if (rate != cf->sampleRate || channels != cf->channels) {
+            if (!cf->src->configure(rate, OUTPUT_RATE, channels)) {
+                cf->dry = true;
+                break;
+            }
+            cf->sampleRate = rate;
+            cf->channels   = channels;
+        }
+        for (int done = 0; done < samples / channels;) {
+            int n        = std::min(samples / channels - done, PCM_SLICE_FRAMES);
+            int16_t* out = cf->fifo + cf->fifoFrames * 2;
+            cf->fifoFrames +=
+                cf->src->process(cf->pcm + done * channels, n, out, CROSSFADE_FIFO_FRAMES - cf->fifoFrames);
+            done += n;
+        }
+    }
+}
+
+static void crossfade_mix(int16_t* pcm, int frames)
+{
+    Crossfade* cf = &s_crossfade;
+    if (!cf->conn) {
+        return;
+    }
+
+    int n = std::min(frames, cf->fifoFrames);
+    for (int i = 0; i < frames; i++) {
+        float t       = std::min(1.0f, (float)(cf->pos + i) / cf->length) * (float)M_PI_2;
+        float fadeIn  = sinf(t);
+        float fadeOut = cosf(t) * cf->gain;
+        for (int ch = 0; ch < 2; ch++) {
+            float old       = (i < n) ? cf->fifo[i * 2 + ch] : 0.0f;
+            float mixed     = pcm[i * 2 + ch] * fadeIn + old * fadeOut;
+            pcm[i * 2 + ch] = (int16_t)std::min(32767.0f, std::max(-32768.0f, mixed));
+        }
+    }
+    cf->fifoFrames -= n;
+    memmove(cf->fifo, cf->fifo + n * 2, cf->fifoFrames * 2 * sizeof(int16_t));
+    cf->pos += frames;
+    if (cf->pos >= cf->length) {
+        crossfade_end(cf);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Adaptive Bitrate                              */
+/* -------------------------------------------------------------------------- */
+// A station that comes at several bitrates (setRadioVariants()) steps between them as the link allows, instead of
+// running dry on poor WiFi. The decoder checks once a second:
+// - down when the inbound rate, UNDERRUN_DEVIATIONS below its average, is short of the bitrate and the buffer
+//   level's trend would run it dry within ABR_DOWN_HORIZON_S, or right after an underrun
+// - up when the buffer has held at least ABR_UP_LEVEL_S for ABR_UP_STABLE_MS and the link has shown ABR_UP_HEADROOM
+//   percent of the next bitrate. A live stream only arrives at its bitrate, so that's its burst on connect
+// A step opens the next variant on the spare connection from a background worker and closes the current one once
+// its first windows are in. The decoder plays the closed ring out to its last whole frame and goes on in the new
+// one from the same moment: the server's burst holds older audio, what it received beyond the bitrate since its
+// first byte is skipped. That holds while the closed stream was at the live edge, so not with a ring that filled
+// up. A variant that doesn't connect within ABR_CONNECT_MS isn't tried again for the station
+#define ABR_CHECK_MS       1000
+#define ABR_HOLD_MS        15000  // After a step, before the next one
+#define ABR_UP_STABLE_MS   60000
+#define ABR_UP_LEVEL_S     8
+#define ABR_UP_HEADROOM    150  // Percent
+#define ABR_DOWN_HORIZON_S 20
+#define ABR_CONNECT_MS     5000
+#define ABR_MAX_VARIANTS   8
+
+struct AdaptiveBitrate {
+    // Held for every change of connections: starts, stops, prewarming and a step
+    std::recursive_mutex control;
+    std::vector<hal::HalBase::RadioVariant_t> variants;  // By bitrate, with `control` held
+    int current     = -1;                                 // Index playing, -1 if it isn't one of them
+    uint32_t failed = 0;                                  // Variants that didn't connect, a bit per index
+    std::atomic<int> upKbps{0};                           // The next ones up and down, 0 if there's none
+    std::atomic<int> downKbps{0};
+    std::atomic<bool> stepping{false};
+
+    // The decoder's, for the connection it last checked
+    uint32_t connId      = 0;
+    uint32_t checkedAt   = 0;
+    uint32_t since       = 0;  // When it was first checked
+    uint32_t stableSince = 0;
+    uint32_t rebufferAt  = 0;
+    int32_t levelMs      = -1;
+    int32_t trend        = 0;  // Buffered ms gained per second, smoothed
+};
+
+static AdaptiveBitrate s_abr;
+
+static metrics::Gauge s_metric_abr_kbps("radio_abr_kbps", "Bitrate of the variant playing, 0 without variants");
+static metrics::Counter s_metric_abr_up("radio_abr_steps_total", "Steps to another bitrate of the station",
+                                        "direction=\"up\"");
+static metrics::Counter s_metric_abr_down("radio_abr_steps_total", "Steps to another bitrate of the station",
+                                          "direction=\"down\"");
+
+// With `control` held
+static int abr_neighbour(int direction)
+{
+    if (s_abr.current < 0) {
+        return -1;
+    }
+    for (int i = s_abr.current + direction; i >= 0 && i < (int)s_abr.variants.size(); i += direction) {
+        bool allowed = direction < 0 || s_abr.variants[i].kbps <= CONFIG_TAB5_RADIO_ABR_MAX_KBPS;
+        if (allowed && !(s_abr.failed & (1u << i))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// With `control` held, after `current` or `failed` changed
+static void abr_publish()
+{
+    int up   = abr_neighbour(1);
+    int down = abr_neighbour(-1);
+    s_abr.upKbps.store(up >= 0 ? s_abr.variants[up].kbps : 0);
+    s_abr.downKbps.store(down >= 0 ? s_abr.variants[down].kbps : 0);
+    s_metric_abr_kbps.set(s_abr.current >= 0 ? s_abr.variants[s_abr.current].kbps : 0);
+}
+
+// With `control` held, a start of `url` makes it the current variant, or takes the ladder out of play
+static void abr_select(const std::string& url)
+{
+    s_abr.current = -1;
+    for (int i = 0; i < (int)s_abr.variants.size(); i++) {
+        if (s_abr.variants[i].url == url) {
+            s_abr.current = i;
+        }
+    }
+    abr_publish();
+}
+
+/**
+ * @brief Open the next variant up (1) or down (-1) on the spare connection and splice it in, from a background
+ * worker. Whatever started, stopped or prewarmed meanwhile wins, the step is dropped
+ *
+ * @param target index in `variants` to step to instead, in `direction`, for switchRadioVariant()
+ */
+static void abr_step(int direction, int target = -1)
+{
+    std::unique_lock<std::recursive_mutex> lock(s_abr.control);
+    StreamConnection* active = s_radio.active;
+    StreamConnection* spare  = s_radio.spare;
+    if (target < 0) {
+        target = abr_neighbour(direction);
+    }
+    if (target < 0 || target >= (int)s_abr.variants.size() || s_abr.current < 0 || !s_radio.audioTask ||
+        s_radio.stopRequested || s_audio_conn != active || active->url != s_abr.variants[s_abr.current].url ||
+        s_pending_conn.load() != nullptr ||
+        s_splice_conn.load() != nullptr || s_fading_conn.load() == spare) {
+        s_abr.stepping = false;
+        return;
+    }
+    if (spare->task) {
+        close_connection(spare);  // The next station warm, it's warmed again once this is done
+        wait_connection(spare);
+    }
+    hal::HalBase::RadioVariant_t variant = s_abr.variants[target];
+    mclog::tagInfo(TAG, "Stepping {} to {} kbps: {}", direction > 0 ? "up" : "down", variant.kbps, variant.url);
+    if (!open_connection(spare, variant.url, false)) {
+        s_abr.stepping = false;
+        return;
+    }
+    uint32_t id = spare->id;
+
+    // Its first windows, the burst on connect with them. Not holding `control`, a station change goes ahead
+    lock.unlock();
+    uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool ready     = false;
+    while (!ready && spare->id == id && !spare->task.cancelled() &&
+           xTaskGetTickCount() * portTICK_PERIOD_MS - start < ABR_CONNECT_MS) {
+        ready = spare->throughput.samples.load() >= PREBUFFER_MIN_SAMPLES;
+        if (!ready) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+    }
+    lock.lock();
+
+    bool intact = spare->id == id && s_radio.spare == spare && s_audio_conn == active && !s_radio.stopRequested &&
+                  s_pending_conn.load() == nullptr;
+    if (!ready || !intact) {
+        if (spare->id == id) {
+            close_connection(spare);
+        }
+        if (!ready && intact) {
+            mclog::tagWarn(TAG, "No data from the {} kbps stream, not trying it again", variant.kbps);
+            s_abr.failed |= 1u << target;
+            abr_publish();
+        }
+        s_abr.stepping = false;
+        return;
+    }
+
+    // What it received beyond its bitrate since the first byte came before the moment the current one ends
+    uint32_t now    = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint64_t live   = (uint64_t)variant.kbps * 1000 / 8 * (now - spare->throughput.firstByte.load()) / 1000;
+    size_t received = spare->ringBuffer.writePosition();
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        s_radio.active = spare;
+        s_radio.spare  = active;
+        xSemaphoreGive(s_radio.mutex);
+    }
+    s_splice_skip.store(received > live ? received - (size_t)live : 0);
+    s_splice_conn.store(spare);
+    close_connection(active);
+    hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);  // The bitrate changed
+
+    s_abr.current = target;
+    abr_publish();
+    (direction > 0 ? s_metric_abr_up : s_metric_abr_down).inc();
+    mclog::tagInfo(TAG, "Stream #{} at {} kbps splices in once #{} is played out", spare->id, variant.kbps,
+                   active->id);
+    s_abr.stepping = false;
+}
+
+/**
+ * @brief The decoder's once a second check of the connection it reads, asks for a step when one is due
+ */
+static void abr_update(StreamConnection* conn)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now - s_abr.checkedAt < ABR_CHECK_MS || s_abr.stepping.load() || s_splice_conn.load() != nullptr) {
+        return;
+    }
+    uint32_t elapsed = s_abr.checkedAt ? now - s_abr.checkedAt : ABR_CHECK_MS;
+    s_abr.checkedAt  = now;
+
+    int up   = s_abr.upKbps.load();
+    int down = s_abr.downKbps.load();
+    if (conn->id != s_abr.connId || conn != s_radio.active) {
+        // Started, zapped or stepped: held for a while, measured from scratch
+        s_abr.connId      = conn->id;
+        s_abr.since       = now;
+        s_abr.stableSince = now;
+        s_abr.rebufferAt  = s_rebuffer_at;
+        s_abr.levelMs     = -1;
+        s_abr.trend       = 0;
+        return;
+    }
+    // Bursts in power save, a full ring, a recording, relay listeners and followers all need the stream as it is
+    if ((up == 0 && down == 0) || conn->draining || conn->following || conn->relayReaders.load() > 0 ||
+        s_recorder.conn.load() != nullptr || conn->ringBuffer.freeSpace() < BURST_REFILL_BYTES) {
+        s_abr.levelMs = -1;
+        return;
+    }
+
+    const ThroughputEstimator& est = conn->throughput;
+    int64_t consume                = stream_bytes_per_second(conn);
+    int32_t level                  = (int32_t)((int64_t)conn->ringBuffer.available() * 1000 / consume);
+    if (s_abr.levelMs >= 0) {
+        int32_t sample = (int32_t)((int64_t)(level - s_abr.levelMs) * 1000 / elapsed);
+        s_abr.trend += (sample - s_abr.trend) / 4;
+    }
+    s_abr.levelMs = level;
+
+    // No data for a couple of windows counts as none coming in
+    bool fresh = est.samples.load() >= PREBUFFER_MIN_SAMPLES && now - est.lastSample.load() <= 2 * THROUGHPUT_WINDOW_MS;
+    int64_t worst  = fresh ? (int64_t)est.rate.load() - UNDERRUN_DEVIATIONS * (int64_t)est.deviation.load() : 0;
+    bool underrun  = s_rebuffer_at != s_abr.rebufferAt;
+    bool shortfall = worst < consume && s_abr.trend < 0 && level < -s_abr.trend * ABR_DOWN_HORIZON_S;
+    s_abr.rebufferAt = s_rebuffer_at;
+    if (level < ABR_UP_LEVEL_S * 1000 || s_abr.trend < 0 || underrun) {
+        s_abr.stableSince = now;
+    }
+
+    int direction = 0;
+    if (down > 0 && (underrun || (shortfall && now - s_abr.since >= ABR_HOLD_MS))) {
+        direction = -1;
+    } else if (up > 0 && now - s_abr.since >= ABR_HOLD_MS && now - s_abr.stableSince >= ABR_UP_STABLE_MS &&
+               (int64_t)est.peak.load() >= (int64_t)up * 1000 / 8 * ABR_UP_HEADROOM / 100) {
+        direction = 1;
+    }
+    if (direction != 0) {
+        s_abr.stepping = true;
+        GetHAL()->runInBackground([direction]() { abr_step(direction); });
+    }
+}
+
+static void audio_decode_task(void* param)
+{
+    mclog::tagInfo(TAG, "Audio decode task started");
+
+    // Wait for prebuffer - the target is re-evaluated as throughput samples come in
+    mclog::tagInfo(TAG, "Prebuffering...");
+    StreamConnection* conn  = s_radio.active;
+    uint32_t prebufferStart = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    size_t target           = PREBUFFER_MAX_SIZE;
+    s_rebuffering           = false;
+    s_buffer_event_level    = -1;
+
+    // The format is probed as soon as a few frames are in, so the prebuffer is sized from the real bitrate
+    hal::HalBase::RadioStreamFormat_t format;
+    bool probed = false;
+    s_stream_format.store(format);
+    while (!s_radio.stopRequested) {
+        if (!probed && conn->ringBuffer.available() >= PROBE_WINDOW) {
+            probed = probe_stream_format(conn, &format);
+            if (probed) {
+                s_stream_format.store(format);
+            }
+        }
+        target = prebuffer_target(conn);
+        if (conn->ringBuffer.waitForData(target, 100)) {
+            break;
+        }
+        post_buffer_level(conn);
+    }
+    if (!probed && !s_radio.stopRequested) {
+        probed = probe_stream_format(conn, &format);
+        if (probed) {
+            s_stream_format.store(format);
+        }
+    }
+
+    if (s_radio.stopRequested) {
+        mclog::tagInfo(TAG, "Audio decode task stopped during prebuffer");
+        return;
+    }
+
+    // Update state to playing
+    set_playing(true);
+    mclog::tagInfo(TAG, "Prebuffer complete after {} ms ({} KB, target {} KB, {} B/s +/- {}), starting playback",
+                   xTaskGetTickCount() * portTICK_PERIOD_MS - prebufferStart, conn->ringBuffer.available() / 1024,
+                   target / 1024, conn->throughput.rate.load(), conn->throughput.deviation.load());
+
+    uint8_t* frame = (uint8_t*)internal_pool().alloc(FRAME_BUFFER_SIZE);
+    int16_t* pcm   = (int16_t*)internal_pool().alloc(PCM_MAX_SAMPLES * sizeof(int16_t));
+    PcmDsp* dsp    = (PcmDsp*)internal_pool().alloc(sizeof(PcmDsp));
+    if (!frame || !pcm || !dsp || !pcm_output_start()) {
+        mclog::tagError(TAG, "Failed to allocate decode buffers");
+        internal_pool().free(frame);
+        internal_pool().free(pcm);
+        internal_pool().free(dsp);
+        pcm_output_stop();
+        return;
+    }
+
+    // The volume is applied in software from here on, the clock stays at the output rate, streams are converted
+    audio_claim_output();
+    bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
+    new (dsp) PcmDsp();
+    uint32_t eqVersion   = s_output_eq_version.load() - 1;  // Apply the current settings on the first frame
+    uint32_t gainVersion = UINT32_MAX;
+    codec_handle->set_volume(OUTPUT_CODEC_VOLUME);  // Also unmutes
+    codec_handle->set_mute(true);
+    s_output_owned = true;
+    s_pending_conn.store(nullptr);
+    s_pending_fresh.store(false);
+    s_splice_conn.store(nullptr);
+    s_audio_fresh   = false;
+    s_audio_spliced = false;
+    s_audio_conn    = conn;
+    clock_drift_restart(false);
+
+    // Set the conversion up once from the probe, the decoder only changes it if the stream turns out different
+    codec_handle->i2s_reconfig_clk_fn(OUTPUT_RATE, 16, I2S_SLOT_MODE_STEREO);
+    int sampleRate = 0;
+    int channels   = 0;
+    if (probed) {
+        sampleRate = format.sampleRate;
+        channels   = format.channels;
+        dsp->configure(sampleRate, channels);
+        pcm_output_configure(sampleRate, channels);
+    }
+
+    StreamDecoder decoder;
+    StreamConnection* formatConn = conn;
+    bool unmuted                 = false;
+    uint32_t frames        = 0;
+    uint32_t decodeErrors  = 0;
+    int64_t syncDropUs     = 0;  // Still to skip to catch up with the sync master
+    DecodeSupervisor supervisor;
+    FrameHeader_t header;
+
+    while (!s_radio.stopRequested) {
+        // Time-shift: the read position stays put while paused, the HTTP task keeps filling the ring
+        if (s_radio.paused) {
+            crossfade_end(&s_crossfade);
+            pcm_output_drain();
+            codec_handle->set_mute(true);
+            unmuted = false;
+
+            // UI sounds play on their own meanwhile, at the codec's volume
+            audio_release_output();
+            stage_idle(STAGE_DECODE);
+            while (s_radio.paused && !s_radio.stopRequested) {
+                vTaskDelay(pdMS_TO_TICKS(20));
+            }
+            audio_claim_output();
+            codec_handle->i2s_reconfig_clk_fn(OUTPUT_RATE, 16, I2S_SLOT_MODE_STEREO);
+            codec_handle->set_volume(OUTPUT_CODEC_VOLUME);
+            codec_handle->set_mute(true);
+            clock_drift_restart(true);  // The ring filled up meanwhile
+            continue;
+        }
+        int skip = s_radio.skipSeconds.exchange(0);
+        int seek = s_radio.seekSeconds.exchange(-1);
+        if (ondemand_playing() && (seek >= 0 || skip != 0)) {
+            // An on-demand stream skips by seeking, the history may not reach
+            crossfade_end(&s_crossfade);
+            ondemand_seek(seek >= 0 ? seek : s_ondemand.position + skip);
+            clock_drift_restart(true);
+        } else if (skip != 0) {
+            crossfade_end(&s_crossfade);
+            skip_stream(skip);
+            clock_drift_restart(true);
+        }
+        sync_step(&supervisor, pcm, channels, sampleRate, &syncDropUs);
+
+        if (s_decoder_resync.exchange(false) && decoder.isOpen()) {
+            // The pipeline supervisor's cheapest recovery: a fresh decoder, the frame scan goes on at the next header
+            mclog::tagWarn(TAG, "Supervisor: resyncing the {} decoder", stream_frame::codec_name(decoder.codec()));
+            supervisor.restarts++;
+            if (!decoder.open(decoder.codec())) {
+                mclog::tagError(TAG, "Failed to restart {} decoder", stream_frame::codec_name(decoder.codec()));
+                break;
+            }
+        }
+        if (!read_frame(frame, &header)) {
+            break;
+        }
+
+        // A promoted station has its own format, its warm ring is already deep enough to probe
+        if (s_audio_conn != formatConn) {
+            bool spliced    = s_audio_spliced;
+            s_audio_spliced = false;
+            if (spliced) {
+                // Plays on from where the other bitrate ended, the same station at the same level
+            } else if (s_audio_fresh) {
+                crossfade_end(&s_crossfade);  // The output is drained, the outgoing station is long gone
+                s_audio_fresh = false;
+            } else {
+                float level = dsp->levelGainDb();
+                crossfade_start(&s_crossfade, formatConn,
+                                volume_gain(s_output_volume.load()) * powf(10.0f, level / 20.0f));
+            }
+            formatConn = s_audio_conn;
+            format     = {};
+            if (probe_stream_format(formatConn, &format)) {
+                s_stream_format.store(format);
+            }
+            if (!spliced) {
+                dsp->resetLoudness();  // A different station, its level has to be measured again
+                gainVersion = UINT32_MAX;
+            }
+            clock_drift_restart(spliced);
+        }
+        apply_track_gain(dsp, header, &gainVersion);
+        if (ondemand_frame(frame, header)) {
+            stage_beat(STAGE_DECODE);
+            continue;  // The VBR tag's frame, silence
+        }
+
+        // (Re)open on the first frame and whenever a promoted station uses another codec
+        if (!decoder.isOpen() || decoder.codec() != header.codec) {
+            if (!decoder.open(header.codec)) {
+                mclog::tagError(TAG, "Failed to create {} decoder", stream_frame::codec_name(header.codec));
+                break;
+            }
+            sampleRate = 0;
+        }
+
+        int frameRate     = 0;
+        int frameChannels = 0;
+        uint32_t cyclesAt = esp_cpu_get_cycle_count();
+        stream_trace().record(TRACE_FRAME_DECODE, TRACE_BEGIN, header.frameSize);
+        int samples = decoder.decode(frame, header.frameSize, pcm, PCM_MAX_SAMPLES, &frameRate, &frameChannels);
+        stream_trace().record(TRACE_FRAME_DECODE, TRACE_END, header.frameSize);
+        if (header.config) {
+            // Opens the decoder, nothing to hear
+            if (samples < 0) {
+                mclog::tagError(TAG, "{} stream in a format the decoder can't play",
+                                stream_frame::codec_name(header.codec));
+                break;
+            }
+            stage_beat(STAGE_DECODE);
+            continue;
+        }
+        if (samples <= 0) {
+            if (samples < 0) {
+                decodeErrors++;
+                s_metric_decode_errors.inc();
             }
+            // A storm restarts the decoder, the frame scan already resumes at the next header
+            if (handle_bad_frame(&supervisor, samples < 0, pcm, channels, unmuted) &&
+                !decoder.open(header.codec)) {
+                mclog::tagError(TAG, "Failed to restart {} decoder", stream_frame::codec_name(header.codec));
+                break;
+            }
+            continue;  // No progress, a run of these for the stall budget is a stall
+        }
+        stage_beat(STAGE_DECODE);
 
-            // Extract and validate header fields
-            // Bits in b1: AAAB BCCD
-            // A = sync (111), B = version (00=2.5, 01=reserved, 10=2, 11=1)
-            // C = layer (00=reserved, 01=III, 10=II, 11=I), D = protection
-            int version = (b1 >> 3) & 0x03;
-            int layer = (b1 >> 1) & 0x03;
+        if (frameRate != sampleRate || frameChannels != channels) {
+            // Only when the probe failed or guessed wrong (AAC without SBR, parametric stereo), or after a zap
+            mclog::tagInfo(TAG, "Output format: {} {} Hz, {} ch", stream_frame::codec_name(header.codec), frameRate,
+                           frameChannels);
+            sampleRate = frameRate;
+            channels   = frameChannels;
+            dsp->configure(sampleRate, channels);
+            pcm_output_configure(sampleRate, channels);
 
-            // Skip reserved version (01) and reserved layer (00)
-            if (version == 1 || layer == 0) {
+            format.codec      = radio_codec(header.codec);
+            format.sampleRate = sampleRate;
+            format.channels   = channels;
+            s_stream_format.store(format);
+        }
+        ondemand_played(samples, channels, sampleRate);
+        // The spectrum shows the stream as received, the supervisor has to see what's actually played. A long FLAC
+        // block or Opus packet goes through in slices, the frame's tag goes with the first
+        uint32_t tag = esp_rom_crc32_le(0, frame, header.frameSize) | 1;
+        for (int done = 0; done < samples; done += PCM_SLICE_FRAMES * channels) {
+            int16_t* slice = pcm + done;
+            int n          = std::min(samples - done, PCM_SLICE_FRAMES * channels);
+            if (done > 0) {
+                cyclesAt = esp_cpu_get_cycle_count();  // The output's wait isn't decode time
+            }
+            spectrum_tap(slice, n, channels, sampleRate);
+            stage_work(STAGE_DSP);
+            apply_output_settings(dsp, &eqVersion);
+            dsp->process(slice, n);
+            stage_beat(STAGE_DSP);
+            s_decode_busy_kcycles.fetch_add((esp_cpu_get_cycle_count() - cyclesAt) >> 10, std::memory_order_relaxed);
+            if (syncDropUs > 0) {
+                // Behind the sync master, the frame is skipped with the output faded out
+                syncDropUs -= (int64_t)(n / channels) * 1000000 / sampleRate;
                 continue;
             }
+            handle_good_frame(&supervisor, slice, n, channels);
+            if (!unmuted) {
+                codec_handle->set_mute(false);
+                unmuted = true;
+                static bool s_heard = false;
+                if (!s_heard) {
+                    s_heard = true;
+                    s_metric_boot_to_audio.set(esp_timer_get_time() / 1000);
+                    mclog::tagInfo(TAG, "First audio {} ms after boot", esp_timer_get_time() / 1000);
+                }
+            }
+
+            // Blocks while the output is full, the I2S DMA behind it is what paces the whole pipeline
+            crossfade_fill(&s_crossfade, s_output.src->maxOutput(n / channels));
+            pcm_output_write(slice, n, tag);
+            tag = 0;
+        }
+        frames++;
+        post_buffer_level(s_audio_conn);
+        abr_update(s_audio_conn);
+        clock_drift_update(s_audio_conn, s_output.src);
+        metric_report_stack(&s_metric_stack_decode, frames);
+
+        // Status every 5 seconds
+        HOT_LOG_INFO_EVERY(5000, TAG,
+                           "Status: buffer={}KB ({}%), HTTP task={}, frames={}, decode errors={}, restarts={}, "
+                           "underruns={}, loudness={:.1f} LUFS ({:+.1f} dB), drift={:+d} ppm ({:+.2f} s)",
+                           s_audio_conn->ringBuffer.available() / 1024, s_audio_conn->ringBuffer.bufferPercent(),
+                           s_audio_conn->task.running() ? "running" : "stopped", frames, decodeErrors,
+                           supervisor.restarts, s_output.underruns.load(), dsp->loudness(), dsp->levelGainDb(),
+                           s_drift.control.ppm(), s_drift.control.error());
+    }
+
+    // Cleanup, the codec gets the volume back for everything else that plays
+    crossfade_free(&s_crossfade);
+    pcm_output_stop();
+    s_output_owned = false;
+    codec_handle->set_volume(s_output_volume.load());
+    codec_handle->set_mute(true);
+    audio_release_output();
+    decoder.close();
+    internal_pool().free(frame);
+    internal_pool().free(pcm);
+    dsp->~PcmDsp();
+    internal_pool().free(dsp);
+    s_audio_conn    = nullptr;
+    s_ondemand.conn = nullptr;
+    s_position.store({});
+
+    // Update state
+    if (s_radio.mutex && xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(100))) {
+        set_radio_state(hal::HalBase::RADIO_STOPPED);
+        xSemaphoreGive(s_radio.mutex);
+    }
+
+    mclog::tagInfo(TAG, "Audio decode task ended, {} B stack left", task_topology::stack_headroom());
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Pipeline Supervisor                             */
+/* -------------------------------------------------------------------------- */
+// While a stream runs an esp_timer checks the heartbeats SUPERVISOR_CHECKS times a budget. The first stage found
+// stalled gets the cheapest recovery that can help it, and the next one up for every budget it stays stuck: the
+// decoder resynced, the connection reconnected, the stream restarted. The stage beating again ends it. The timer only
+// reads and flags, the log, the metrics and a restart are a background job's
+#define STALL_BUDGET_MS           CONFIG_TAB5_RADIO_STALL_MS
+#define TRANSPORT_STALL_BUDGET_MS CONFIG_TAB5_RADIO_TRANSPORT_STALL_MS
+#define SUPERVISOR_CHECKS         4
+
+enum Recovery_t {
+    RECOVER_RESYNC = 0,
+    RECOVER_RECONNECT,
+    RECOVER_RESTART,
+    RECOVER_COUNT,
+};
+
+static const char* const STAGE_NAMES[STAGE_COUNT]      = {"transport", "demux", "decode", "DSP", "output"};
+static const char* const RECOVERY_NAMES[RECOVER_COUNT] = {"resyncing the decoder", "reconnecting",
+                                                          "restarting the stream"};
+// A resync gets no bytes off a stuck socket, and nothing short of a restart frees a stuck I2S write
+static constexpr Recovery_t FIRST_RECOVERY[STAGE_COUNT] = {RECOVER_RECONNECT, RECOVER_RECONNECT, RECOVER_RESYNC,
+                                                           RECOVER_RESYNC, RECOVER_RESTART};
+
+static metrics::Counter s_metric_recoveries[RECOVER_COUNT] = {
+    {"radio_stall_recoveries_total", "Recoveries the pipeline supervisor ran", "action=\"resync\""},
+    {"radio_stall_recoveries_total", "Recoveries the pipeline supervisor ran", "action=\"reconnect\""},
+    {"radio_stall_recoveries_total", "Recoveries the pipeline supervisor ran", "action=\"restart\""},
+};
+static metrics::Histogram s_metric_stall("radio_stall_ms", "Time from a stage stalling to its next progress",
+                                         {500, 1000, 2000, 5000, 10000, 30000});
+
+static struct {
+    esp_timer_handle_t timer = nullptr;
+    std::atomic<uint32_t> generation{0};  // Bumped by every start, the timer drops the stall it was on
+    // The timer's own
+    uint32_t seen    = 0;   // Generation the stall below is of
+    int stage        = -1;  // Stalled, -1 for none
+    uint32_t beats   = 0;   // Its progress counter when it stalled
+    uint32_t stallAt = 0;   // heartbeat_ms() it's been busy since
+    uint32_t actedAt = 0;
+    int next         = 0;  // Recovery_t to run next
+} s_supervisor;
+
+static uint32_t stage_budget(int stage)
+{
+    return stage <= STAGE_DEMUX ? TRANSPORT_STALL_BUDGET_MS : STALL_BUDGET_MS;
+}
+
+// Stopped, restarted or tuned elsewhere meanwhile, or SD card files, which have nothing to start over from
+static void pipeline_restart(uint32_t generation)
+{
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
+    StreamConnection* conn = s_radio.active;
+    if (generation != s_supervisor.generation.load() || !s_radio.audioTask || s_radio.stopRequested || conn->local) {
+        return;
+    }
+    std::string url = conn->url;
+    GetHAL()->stopRadioStream();
+    GetHAL()->startRadioStream(url);
+}
+
+static void pipeline_recover(Stage_t stage, Recovery_t action, uint32_t stalledMs, uint32_t generation)
+{
+    mclog::tagWarn(TAG, "Supervisor: {} stalled for {} ms, {}", STAGE_NAMES[stage], stalledMs, RECOVERY_NAMES[action]);
+    s_metric_recoveries[action].inc();
+    if (action == RECOVER_RESTART) {
+        pipeline_restart(generation);
+    }
+}
+
+static void pipeline_recovered(Stage_t stage, uint32_t stalledMs)
+{
+    mclog::tagInfo(TAG, "Supervisor: {} moving again after {} ms", STAGE_NAMES[stage], stalledMs);
+    s_metric_stall.observe(stalledMs);
+}
+
+// In the timer: the flags are set here, straight away, the rest goes to the background job
+static void supervisor_step(StreamConnection* conn, uint32_t now)
+{
+    Recovery_t action = (Recovery_t)s_supervisor.next++;
+    if (action == RECOVER_RECONNECT && conn->local) {
+        action = (Recovery_t)s_supervisor.next++;  // The SD card has no connection
+    }
+    if (action == RECOVER_RESYNC) {
+        s_decoder_resync = true;
+    } else if (action == RECOVER_RECONNECT) {
+        conn->reconnect = true;
+    }
+    s_supervisor.actedAt = now;
+
+    Stage_t stage       = (Stage_t)s_supervisor.stage;
+    uint32_t stalledMs  = now - s_supervisor.stallAt;
+    uint32_t generation = s_supervisor.seen;
+    GetHAL()->runInBackground(
+        [stage, action, stalledMs, generation]() { pipeline_recover(stage, action, stalledMs, generation); });
+}
+
+static void supervise(void*)
+{
+    StreamConnection* conn = s_radio.active;  // What the HTTP task feeds, the decoder moves over to it
+    uint32_t generation    = s_supervisor.generation.load();
+    if (generation != s_supervisor.seen || !s_audio_conn || s_radio.stopRequested || !s_radio.audioTask) {
+        s_supervisor.seen  = generation;
+        s_supervisor.stage = -1;
+        return;
+    }
+
+    uint32_t now = heartbeat_ms();
+    if (s_supervisor.stage >= 0) {
+        Stage_t stage     = (Stage_t)s_supervisor.stage;
+        Heartbeat_t& beat = s_heartbeats[stage];
+        if (beat.beats.value() != s_supervisor.beats) {
+            uint32_t stalledMs = now - s_supervisor.stallAt;
+            s_supervisor.stage = -1;
+            GetHAL()->runInBackground([stage, stalledMs]() { pipeline_recovered(stage, stalledMs); });
+            return;
+        }
+        // Idle, on a neighbour the last step may have woken, isn't stuck, only not moving yet
+        uint32_t since = beat.busySince.load(std::memory_order_relaxed);
+        if (since != 0 && s_supervisor.next < RECOVER_COUNT &&
+            (int32_t)(now - std::max(since, s_supervisor.actedAt)) >= (int32_t)stage_budget(stage)) {
+            supervisor_step(conn, now);
+        }
+        return;
+    }
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        uint32_t since = s_heartbeats[stage].busySince.load(std::memory_order_relaxed);
+        // Signed, a stage may have started after `now` was read
+        if (since != 0 && (int32_t)(now - since) >= (int32_t)stage_budget(stage)) {
+            s_heartbeats[stage].stalls.inc();
+            s_supervisor.stage   = stage;
+            s_supervisor.beats   = s_heartbeats[stage].beats.value();
+            s_supervisor.stallAt = since;
+            s_supervisor.next    = FIRST_RECOVERY[stage];
+            supervisor_step(conn, now);
+            return;
+        }
+    }
+}
+
+// A stream starting, switching or zapping: the stall being recovered, if any, was of the one before
+static void supervisor_start()
+{
+    s_supervisor.generation++;
+    s_decoder_resync = false;
+    for (auto& beat : s_heartbeats) {
+        beat.busySince.store(0);
+    }
+    if (STALL_BUDGET_MS == 0) {
+        return;
+    }
+    if (!s_supervisor.timer) {
+        esp_timer_create_args_t args = {};
+        args.callback                = supervise;
+        args.name                    = "radio_supervisor";
+        if (esp_timer_create(&args, &s_supervisor.timer) != ESP_OK) {
+            s_supervisor.timer = nullptr;
+            mclog::tagWarn(TAG, "No timer for the pipeline supervisor, stalls aren't recovered");
+            return;
+        }
+    }
+    if (!esp_timer_is_active(s_supervisor.timer)) {
+        esp_timer_start_periodic(s_supervisor.timer, STALL_BUDGET_MS * 1000 / SUPERVISOR_CHECKS);
+    }
+}
+
+static void supervisor_stop()
+{
+    if (s_supervisor.timer && esp_timer_is_active(s_supervisor.timer)) {
+        esp_timer_stop(s_supervisor.timer);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Decode Benchmark                              */
+/* -------------------------------------------------------------------------- */
+// Replays the embedded canon_in_d.mp3, or a sample file of any codec, through the same demuxer, ring, frame scan,
+// decoder, DSP and rate conversion the radio uses, on the audio core with the decoder's priority. I2S is left out,
+// the converted PCM is dropped, so what's measured is the CPU side of a frame. The file goes in one socket-sized
+// chunk at a time, as fast as the ring takes it.
+#define BENCH_CHUNK_SIZE    1436  // One TCP segment
+#define BENCH_RING_SIZE     (64 * 1024)
+#define BENCH_FILE_MAX_SIZE (8 * 1024 * 1024)  // Read into PSRAM whole, card latency isn't what's measured
+
+extern const uint8_t canon_in_d_mp3_start[] asm("_binary_canon_in_d_mp3_start");
+extern const uint8_t canon_in_d_mp3_end[] asm("_binary_canon_in_d_mp3_end");
+
+struct BenchRun_t {
+    hal::HalBase::RadioBenchmark_t* result = nullptr;
+    const uint8_t* file                    = nullptr;
+    size_t fileSize                        = 0;
+    bool packetized                        = false;  // Ogg or FLAC, the demuxer finds the codec
+    StreamCodec_t codec                    = CODEC_MP3;
+    bool ok                                = false;
+    TaskHandle_t caller                    = nullptr;
+};
+
+static void bench_run(BenchRun_t* run)
+{
+    hal::HalBase::RadioBenchmark_t& result = *run->result;
+    size_t internalBefore                  = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psramBefore                     = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    StreamConnection* conn = new (std::nothrow) StreamConnection();
+    uint8_t* chunk         = (uint8_t*)heap_caps_malloc(BENCH_CHUNK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t* frame         = (uint8_t*)heap_caps_malloc(FRAME_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int16_t* pcm =
+        (int16_t*)heap_caps_malloc(PCM_MAX_SAMPLES * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    int16_t* out   = (int16_t*)heap_caps_malloc(OUTPUT_BLOCK_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_8BIT);
+    PcmDsp* dsp    = (PcmDsp*)heap_caps_malloc(sizeof(PcmDsp), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    Resampler* src = new (std::nothrow) Resampler();
+    StreamDecoder decoder;
+    if (!conn || !chunk || !frame || !pcm || !out || !dsp || !src || !conn->ringBuffer.init(BENCH_RING_SIZE) ||
+        !conn->ringBuffer.setReadWindow(RING_READ_WINDOW) || (run->packetized && !conn->packets.reset())) {
+        mclog::tagError(TAG, "Benchmark: allocation failed");
+    } else {
+        new (dsp) PcmDsp();
+        conn->icy.reset(0);
+        conn->codec = run->codec;
+
+        const uint8_t* file   = run->file;
+        size_t fileSize       = run->fileSize;
+        size_t room           = BENCH_CHUNK_SIZE + (run->packetized ? 2 * packet_frame::MAX_FRAME_SIZE : 0);
+        size_t fed            = 0;
+        int sampleRate        = 0;
+        int channels          = 0;
+        uint64_t cycles       = 0;
+        uint64_t busyUs       = 0;
+        uint64_t samples      = 0;
+        size_t lowestInternal = internalBefore;
+        size_t lowestPsram    = psramBefore;
+        RingBuffer& ring      = conn->ringBuffer;
+        while (true) {
+            // Network side
+            while (fed < fileSize && ring.freeSpace() >= room) {
+                size_t n = std::min((size_t)BENCH_CHUNK_SIZE, fileSize - fed);
+                memcpy(chunk, file + fed, n);
+                fed += n;
+                if (!run->packetized) {
+                    ring.write(chunk, demux_in_place(conn, chunk, n));
+                    continue;
+                }
+                conn->packets.feed(
+                    chunk, n,
+                    [&](const uint8_t* packet, size_t len) {
+                        conn->codec = conn->packets.codec() == PacketDemuxer::CODEC_OPUS ? CODEC_OPUS : CODEC_FLAC;
+                        ring.write(packet, len);
+                    },
+                    [](const char* title) {});
+            }
 
-            // Bits in b2: EEEE FFGH
-            // E = bitrate index (0000 and 1111 are invalid)
-            // F = sample rate index (11 is reserved)
-            int bitrateIdx = (b2 >> 4) & 0x0F;
-            int sampleRateIdx = (b2 >> 2) & 0x03;
+            int64_t start                = esp_timer_get_time();
+            esp_cpu_cycle_count_t cycle0 = esp_cpu_get_cycle_count();
+            StreamCodec_t codec          = conn->codec;
+            FrameHeader_t header;
+            size_t window = ring.peek(frame, FRAME_SCAN_WINDOW);
+            int offset    = stream_frame::find_frame(codec, frame, window, &header);
+            if (offset < 0) {
+                if (fed >= fileSize) {
+                    break;
+                }
+                ring.discard(window - std::min(window, stream_frame::header_size(codec) - 1));
+                continue;
+            }
+            ring.discard(offset);
+            if (ring.available() < header.frameSize) {
+                if (fed >= fileSize) {
+                    break;
+                }
+                continue;
+            }
+            ring.read(frame, header.frameSize);
+            if ((!decoder.isOpen() || decoder.codec() != codec) && !decoder.open(codec)) {
+                mclog::tagError(TAG, "Benchmark: no {} decoder", stream_frame::codec_name(codec));
+                break;
+            }
 
-            // Skip invalid bitrate (0 = free, 15 = bad) and reserved sample rate
-            if (bitrateIdx == 0 || bitrateIdx == 15 || sampleRateIdx == 3) {
+            int frameRate     = 0;
+            int frameChannels = 0;
+            int n = decoder.decode(frame, header.frameSize, pcm, PCM_MAX_SAMPLES, &frameRate, &frameChannels);
+            if (n < 0) {
+                result.decodeErrors++;
+            }
+            if (n <= 0) {
                 continue;
             }
+            if (frameRate != sampleRate || frameChannels != channels) {
+                sampleRate = frameRate;
+                channels   = frameChannels;
+                dsp->configure(sampleRate, channels);
+                src->configure(sampleRate, OUTPUT_RATE, channels);
+            }
+            for (int done = 0; done < n; done += PCM_SLICE_FRAMES * channels) {
+                int slice = std::min(n - done, PCM_SLICE_FRAMES * channels);
+                dsp->process(pcm + done, slice);
+                src->process(pcm + done, slice / channels, out, OUTPUT_BLOCK_FRAMES);
+            }
 
-            // This looks like a valid MP3 frame header!
-            syncOffset = i;
-            mclog::tagInfo(TAG, "Found valid MP3 header at offset {}: {:02X} {:02X} {:02X} {:02X} "
-                          "(v={} l={} br={} sr={})",
-                          i, b0, b1, b2, s_header_buffer[i + 3],
-                          version, layer, bitrateIdx, sampleRateIdx);
-            break;
+            uint32_t frameCycles = esp_cpu_get_cycle_count() - cycle0;
+            uint32_t frameUs     = (uint32_t)(esp_timer_get_time() - start);
+            cycles += frameCycles;
+            busyUs += frameUs;
+            samples += n / channels;
+            result.frames++;
+            result.maxFrameCycles = std::max(result.maxFrameCycles, frameCycles);
+            result.maxFrameUs     = std::max(result.maxFrameUs, frameUs);
+            lowestInternal        = std::min(lowestInternal, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+            lowestPsram           = std::min(lowestPsram, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
         }
 
-        if (syncOffset > 0) {
-            // Move data so sync word is at the beginning
-            mclog::tagInfo(TAG, "Shifting buffer to start at MP3 frame");
-            s_header_bytes_saved = bytesRead - syncOffset;
-            memmove(s_header_buffer, s_header_buffer + syncOffset, s_header_bytes_saved);
-        } else if (syncOffset == 0) {
-            // Sync word already at start
-            mclog::tagInfo(TAG, "MP3 frame already at start of buffer");
-            s_header_bytes_saved = bytesRead;
-        } else {
-            // No valid frame found - log first bytes for debugging
-            mclog::tagWarn(TAG, "No valid MP3 frame in first {} bytes, first 8 bytes: "
-                          "{:02X} {:02X} {:02X} {:02X} {:02X} {:02X} {:02X} {:02X}",
-                          bytesRead,
-                          s_header_buffer[0], s_header_buffer[1], s_header_buffer[2], s_header_buffer[3],
-                          s_header_buffer[4], s_header_buffer[5], s_header_buffer[6], s_header_buffer[7]);
-            s_header_bytes_saved = bytesRead;
+        if (result.frames > 0 && sampleRate > 0) {
+            result.codec          = radio_codec(conn->codec);
+            result.audioSeconds   = (float)samples / sampleRate;
+            result.bitrateKbps    = (uint32_t)(fileSize * 8 / 1000 / result.audioSeconds);
+            result.cyclesPerFrame = (uint32_t)(cycles / result.frames);
+            result.coreLoad       = busyUs / 1e6f / result.audioSeconds;
+            result.internalBytes  = internalBefore - lowestInternal;
+            result.psramBytes     = psramBefore - lowestPsram;
+            run->ok               = true;
         }
+        dsp->~PcmDsp();
     }
 
-    // Initialize the fopencookie state BEFORE creating audio player
-    // Start in replay mode so is_mp3() reads from header buffer
-    s_audio_ring_buffer = &s_radio.ringBuffer;
-    s_stream_position = 0;
-    s_header_read_pos = 0;
-    s_header_replay_mode = true;  // Start in replay mode!
-    s_first_header_read_logged = false;  // Reset logging flag for new stream
+    decoder.close();
+    if (conn) {
+        conn->ringBuffer.deinit();
+    }
+    delete conn;
+    delete src;
+    free(chunk);
+    free(frame);
+    free(pcm);
+    free(out);
+    free(dsp);
+}
 
-    // Initialize audio player - volume is controlled by HAL setSpeakerVolume()
-    bsp_codec_config_t* codec_handle = bsp_get_codec_handle();
+static void bench_task(void* param)
+{
+    BenchRun_t* run = (BenchRun_t*)param;
+    bench_run(run);
+    mclog::tagInfo(TAG, "Benchmark task ended, {} B stack left", task_topology::stack_headroom());
+    xTaskNotifyGive(run->caller);
+    vTaskDelete(nullptr);
+}
 
-    // Pre-configure I2S to 44100Hz (standard for MP3 radio streams) to avoid
-    // "Mode conflict" error when audio_player tries to reconfigure while running
-    // This sets up the codec before playback starts
-    mclog::tagInfo(TAG, "Pre-configuring I2S for 44100Hz stereo");
-    codec_handle->i2s_reconfig_clk_fn(44100, 16, I2S_SLOT_MODE_STEREO);
-    // The MP3 decoder will call clk_set_fn with the correct sample rate from the stream
-
-    audio_player_config_t config = {
-        .mute_fn    = audio_mute_function,
-        .clk_set_fn = codec_handle->i2s_reconfig_clk_fn,
-        .write_fn   = codec_handle->i2s_write,
-        .priority   = 8,
-        .coreID     = 1,
-    };
-    esp_err_t ret = audio_player_new(config);
-    if (ret != ESP_OK) {
-        mclog::tagError(TAG, "Failed to create audio player: {}", esp_err_to_name(ret));
-        s_radio.audioTask = nullptr;
-        vTaskDelete(nullptr);
+/* -------------------------------------------------------------------------- */
+/*                              Output Benchmark                              */
+/* -------------------------------------------------------------------------- */
+// Silence through the output task at the output rate, to the USB DAC if one is plugged in and the speaker codec
+// (muted) if not: the latency and underruns of the sink as the radio sees them, and the core time the task takes
+// to feed it. Written from the decoder's task at its priority, one MP3 frame's worth at a time
+#define OUTPUT_BENCH_FRAMES      1152
+#define OUTPUT_BENCH_MAX_SECONDS 600
+
+struct OutputBenchRun_t {
+    hal::HalBase::OutputBenchmark_t* result = nullptr;
+    uint32_t seconds                        = 0;
+    bool ok                                 = false;
+    TaskHandle_t caller                     = nullptr;
+};
+
+static void output_bench_run(OutputBenchRun_t* run)
+{
+    hal::HalBase::OutputBenchmark_t& result = *run->result;
+    int16_t* pcm = (int16_t*)heap_caps_calloc(OUTPUT_BENCH_FRAMES * 2, sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (!pcm || !pcm_output_start()) {
+        mclog::tagError(TAG, "Output benchmark: allocation failed");
+        pcm_output_stop();
+        free(pcm);
         return;
     }
 
-    // Create custom FILE from ring buffer using fopencookie
-    // We provide a seek function so is_mp3() detection works
-    cookie_io_functions_t io_funcs = {
-        .read  = ringbuffer_read,
-        .write = nullptr,
-        .seek  = ringbuffer_seek,
-        .close = ringbuffer_close,
-    };
-    FILE* stream_fp = fopencookie(nullptr, "rb", io_funcs);
-    if (!stream_fp) {
-        mclog::tagError(TAG, "Failed to create stream FILE");
-        audio_player_delete();
-        s_radio.audioTask = nullptr;
-        vTaskDelete(nullptr);
-        return;
+    audio_claim_output();
+    bsp_codec_config_t* codec = bsp_get_codec_handle();
+    codec->i2s_reconfig_clk_fn(OUTPUT_RATE, 16, I2S_SLOT_MODE_STEREO);
+    codec->set_mute(true);
+    pcm_output_configure(OUTPUT_RATE, 2);
+
+    uint32_t underruns                = s_output.underruns.load();
+    configRUN_TIME_COUNTER_TYPE busy0 = ulTaskGetRunTimeCounter(s_output.task.handle());
+    configRUN_TIME_COUNTER_TYPE span0 = portGET_RUN_TIME_COUNTER_VALUE();
+    int64_t start                     = esp_timer_get_time();
+    uint64_t frames                   = 0;
+    while (frames < (uint64_t)run->seconds * OUTPUT_RATE) {
+        pcm_output_write(pcm, OUTPUT_BENCH_FRAMES * 2);
+        frames += OUTPUT_BENCH_FRAMES;
     }
+    pcm_output_drain();
+    configRUN_TIME_COUNTER_TYPE busy = ulTaskGetRunTimeCounter(s_output.task.handle()) - busy0;
+    configRUN_TIME_COUNTER_TYPE span = portGET_RUN_TIME_COUNTER_VALUE() - span0;
 
-    // Start playback
-    mclog::tagInfo(TAG, "Calling audio_player_play with {} bytes in header buffer", s_header_bytes_saved);
-    ret = audio_player_play(stream_fp);
-    if (ret != ESP_OK) {
-        mclog::tagError(TAG, "Failed to start playback: {}", esp_err_to_name(ret));
-        fclose(stream_fp);
-        audio_player_delete();
-        s_radio.audioTask = nullptr;
-        vTaskDelete(nullptr);
+    result.usbAudio  = s_output.usb.load();
+    result.seconds   = (esp_timer_get_time() - start) / 1e6f;
+    result.blocks    = s_output.blocksOut;
+    result.underruns = s_output.underruns.load() - underruns;
+    if (s_output.blocksOut > 0) {
+        result.latencyMs    = (uint32_t)(s_output.sumLatencyUs / s_output.blocksOut / 1000);
+        result.maxLatencyMs = s_output.maxLatencyUs / 1000;
+    }
+    result.coreLoad = span > 0 ? (float)busy / span : 0;
+    run->ok         = result.blocks > 0;
+
+    pcm_output_stop();
+    codec->set_volume(s_output_volume.load());
+    codec->set_mute(true);
+    audio_release_output();
+    free(pcm);
+}
+
+static void output_bench_task(void* param)
+{
+    OutputBenchRun_t* run = (OutputBenchRun_t*)param;
+    output_bench_run(run);
+    mclog::tagInfo(TAG, "Output benchmark task ended, {} B stack left", task_topology::stack_headroom());
+    xTaskNotifyGive(run->caller);
+    vTaskDelete(nullptr);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                              Host Prewarm                                  */
+/* -------------------------------------------------------------------------- */
+// A lookup here leaves the answer in lwIP's DNS cache, so the HTTP client's own lookup when a station starts returns
+// straight away. Idle TCP connections per station aren't kept, the warm spare connection covers the next zap
+static std::vector<std::string> s_prewarm_hosts;  // Guarded by s_prewarm_mutex
+static SemaphoreHandle_t s_prewarm_mutex = nullptr;
+static TaskHandle_t s_prewarm_task       = nullptr;
+
+static void resolve_hosts_task(void* param)
+{
+    std::vector<std::string> hosts;
+    if (xSemaphoreTake(s_prewarm_mutex, portMAX_DELAY)) {
+        hosts = s_prewarm_hosts;
+        xSemaphoreGive(s_prewarm_mutex);
+    }
+
+    for (const auto& host : hosts) {
+        uint32_t start = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+        struct addrinfo hints = {};
+        hints.ai_family       = AF_INET;
+        hints.ai_socktype     = SOCK_STREAM;
+        struct addrinfo* res  = nullptr;
+        int ret               = getaddrinfo(host.c_str(), nullptr, &hints, &res);
+        if (ret != 0 || !res) {
+            mclog::tagWarn(TAG, "Prewarm: can't resolve {} ({})", host, ret);
+            continue;
+        }
+        char addr[16];
+        inet_ntoa_r(((struct sockaddr_in*)res->ai_addr)->sin_addr, addr, sizeof(addr));
+        freeaddrinfo(res);
+        mclog::tagInfo(TAG, "Prewarm: {} -> {} ({} ms)", host, addr, xTaskGetTickCount() * portTICK_PERIOD_MS - start);
+    }
+
+    s_prewarm_task = nullptr;
+    task_topology::exit();
+}
+
+void HalEsp32::radio_resolve_hosts()
+{
+    if (!s_prewarm_mutex || s_prewarm_task) {
         return;
     }
+    if (task_topology::create(task_topology::DNS_PREWARM, resolve_hosts_task, nullptr, &s_prewarm_task) != pdPASS) {
+        s_prewarm_task = nullptr;
+    }
+}
+
+void HalEsp32::prewarmRadioHosts(const std::vector<std::string>& urls)
+{
+    if (!s_prewarm_mutex) {
+        s_prewarm_mutex = xSemaphoreCreateMutex();
+        if (!s_prewarm_mutex) {
+            return;
+        }
+    }
 
-    // Give the audio player's internal task time to start and begin decoding
-    vTaskDelay(pdMS_TO_TICKS(500));
+    // SomaFM serves every station from the same host, so this is usually a single lookup
+    std::vector<std::string> hosts;
+    for (const auto& url : urls) {
+        std::string host = url_host(url);
+        if (!host.empty() && std::find(hosts.begin(), hosts.end(), host) == hosts.end()) {
+            hosts.push_back(host);
+        }
+    }
+    if (xSemaphoreTake(s_prewarm_mutex, portMAX_DELAY)) {
+        s_prewarm_hosts = hosts;
+        xSemaphoreGive(s_prewarm_mutex);
+    }
+    mirror_set_stations(urls);
 
-    // Check if playback actually started
-    audio_player_state_t initial_state = audio_player_get_state();
-    mclog::tagInfo(TAG, "After 500ms delay, player state: {}", (int)initial_state);
+    if (_wifi_state == WIFI_CONNECTED) {
+        radio_resolve_hosts();
+    }
+}
 
-    // Wait for stop signal or idle state
-    // Also monitor buffer health and HTTP task status
-    uint32_t lastStatusLog = 0;
-    while (!s_radio.stopRequested) {
-        audio_player_state_t state = audio_player_get_state();
-        if (state == AUDIO_PLAYER_STATE_IDLE) {
-            mclog::tagInfo(TAG, "Audio player became idle");
+/* -------------------------------------------------------------------------- */
+/*                                LAN Relay                                   */
+/* -------------------------------------------------------------------------- */
+// Re-serves the playing stream to other players on the LAN at http://<ip>:8000/stream, so several rooms share the
+// one upstream connection. Every listener has its own task and a lagging cursor on the active ring: a slow listener
+// only ever falls behind or skips, the decoder and the HTTP task never wait for it.
+#define RELAY_PORT         8000
+#define RELAY_MAX_CLIENTS  3            // One ring cursor each, the recorder has the fourth
+#define RELAY_CHUNK        4096
+#define RELAY_CLIENT_QUEUE (64 * 1024)  // Per listener, further behind than this skips ahead
+#define RELAY_METAINT      16000        // ICY metadata interval sent to listeners that ask for it
+#define RELAY_REATTACH_MS  5000         // Grace period across a station change before the listener is dropped
+
+struct RelayClient_t {
+    httpd_req_t* req;
+    bool icy;              // Listener sent Icy-MetaData: 1
+    bool sync;             // A multi-room sync follower, ?sync=<url hash>: that station only
+    uint32_t urlHash = 0;
+};
+
+static httpd_handle_t s_relay_server = nullptr;
+static std::atomic<int> s_relay_clients{0};
+
+/**
+ * @brief Open a cursor on the active ring, nullptr if nothing is playing
+ */
+static StreamConnection* relay_attach(int* cursor)
+{
+    StreamConnection* conn = s_radio.active;
+    if (!s_radio.audioTask || s_radio.stopRequested) {
+        return nullptr;
+    }
+    // Check again once counted, open_connection() won't reset a ring that has readers
+    conn->relayReaders.fetch_add(1);
+    if (conn != s_radio.active || s_radio.stopRequested || !conn->task) {
+        conn->relayReaders.fetch_sub(1);
+        return nullptr;
+    }
+    *cursor = conn->ringBuffer.openCursor(false);
+    if (*cursor < 0) {
+        conn->relayReaders.fetch_sub(1);
+        return nullptr;
+    }
+    return conn;
+}
+
+static void relay_detach(StreamConnection* conn, int cursor)
+{
+    conn->ringBuffer.closeCursor(cursor);
+    conn->relayReaders.fetch_sub(1);
+}
+
+/**
+ * @return false if the listener is gone or stopped reading for a whole send timeout
+ */
+static bool relay_send(httpd_req_t* req, const uint8_t* data, size_t len)
+{
+    while (len > 0) {
+        int sent = httpd_send(req, (const char*)data, len);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+/**
+ * @brief Send an ICY metadata block, the title only when it changed since the last one
+ */
+static bool relay_send_metadata(httpd_req_t* req, StreamConnection* conn, std::string* lastTitle)
+{
+    auto meta = conn->metadata.load();
+    if (*lastTitle == meta.title) {
+        uint8_t empty = 0;
+        return relay_send(req, &empty, 1);
+    }
+    *lastTitle = meta.title;
+
+    // Length byte in 16 byte units, then the text NUL padded
+    std::string text = "StreamTitle='" + *lastTitle + "';";
+    size_t blocks    = std::min<size_t>((text.size() + 15) / 16, 255);
+    std::string block(1 + blocks * 16, '\0');
+    block[0] = (char)blocks;
+    memcpy(&block[1], text.data(), std::min(text.size(), blocks * 16));
+    return relay_send(req, (const uint8_t*)block.data(), block.size());
+}
+
+static bool relay_send_header(httpd_req_t* req, StreamConnection* conn, bool icy)
+{
+    auto meta = conn->metadata.load();
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+                       "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nCache-Control: no-cache\r\nicy-name: %s\r\n",
+                       conn->codec == CODEC_AAC ? "audio/aac" : "audio/mpeg", meta.station);
+    if (meta.bitrate > 0) {
+        len += snprintf(header + len, sizeof(header) - len, "icy-br: %d\r\n", meta.bitrate);
+    }
+    if (icy) {
+        len += snprintf(header + len, sizeof(header) - len, "icy-metaint: %d\r\n", RELAY_METAINT);
+    }
+    len += snprintf(header + len, sizeof(header) - len, "\r\n");
+    return relay_send(req, (const uint8_t*)header, std::min<size_t>(len, sizeof(header) - 1));
+}
+
+static void relay_client_task(void* param)
+{
+    RelayClient_t* client = (RelayClient_t*)param;
+    httpd_req_t* req      = client->req;
+    uint8_t* chunk        = (uint8_t*)malloc(RELAY_CHUNK);
+
+    StreamConnection* conn = nullptr;
+    int cursor             = -1;
+    uint32_t connId        = 0;
+    StreamCodec_t codec    = CODEC_MP3;
+    bool started           = false;
+    uint32_t detachedAt    = 0;
+    size_t untilMeta       = RELAY_METAINT;
+    size_t dropped         = 0;
+    bool unsupported       = false;
+    std::string lastTitle;
+
+    while (chunk) {
+        // Follow the active connection across station changes, as long as the format stays the same
+        if (!conn) {
+            uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            conn         = relay_attach(&cursor);
+            if (!conn) {
+                if (!started || now - detachedAt > RELAY_REATTACH_MS) {
+                    break;
+                }
+                vTaskDelay(pdMS_TO_TICKS(100));
+                continue;
+            }
+            if (started && (conn->codec != codec || client->sync)) {
+                break;
+            }
+            if (stream_frame::is_packet(conn->codec)) {
+                unsupported = true;  // The ring holds our own packet framing, no player could take it
+                break;
+            }
+            if (client->sync && conn->urlHash != client->urlHash) {
+                break;  // The follower goes to the station's own mirrors
+            }
+            if (!started && !relay_send_header(req, conn, client->icy)) {
+                break;
+            }
+            started = true;
+            connId  = conn->id;
+            codec   = conn->codec;
+        }
+        if (conn != s_radio.active || conn->id != connId || s_radio.stopRequested) {
+            relay_detach(conn, cursor);
+            conn       = nullptr;
+            detachedAt = xTaskGetTickCount() * portTICK_PERIOD_MS;
+            continue;
+        }
+
+        // Bounded queue: a listener that can't keep up loses audio rather than holding anything up
+        RingBuffer& ring = conn->ringBuffer;
+        size_t backlog   = ring.cursorAvailable(cursor);
+        if (backlog > RELAY_CLIENT_QUEUE) {
+            dropped += ring.skipCursor(cursor, backlog - RELAY_CLIENT_QUEUE / 2);
+        }
+        if (!ring.waitForCursorData(cursor, 1024, 200)) {
+            continue;
+        }
+
+        size_t want = client->icy ? std::min<size_t>(RELAY_CHUNK, untilMeta) : RELAY_CHUNK;
+        size_t skipped;
+        size_t len = ring.readCursor(cursor, chunk, want, &skipped);
+        dropped += skipped;
+        if (len == 0) {
+            continue;
+        }
+        if (!relay_send(req, chunk, len)) {
             break;
         }
+        if (client->icy) {
+            untilMeta -= len;
+            if (untilMeta == 0) {
+                if (!relay_send_metadata(req, conn, &lastTitle)) {
+                    break;
+                }
+                untilMeta = RELAY_METAINT;
+            }
+        }
+    }
+
+    if (conn) {
+        relay_detach(conn, cursor);
+    }
+    if (dropped > 0) {
+        mclog::tagWarn(TAG, "Relay: listener left, {} KB skipped while it lagged", dropped / 1024);
+    } else {
+        mclog::tagInfo(TAG, "Relay: listener left, {} B stack left", task_topology::stack_headroom());
+    }
+    if (!started) {
+        const char* busy = unsupported ? "HTTP/1.0 415 Unsupported Media Type\r\nContent-Type: text/plain\r\n\r\n"
+                                         "Opus and FLAC streams aren't relayed\r\n"
+                                       : "HTTP/1.0 503 Service Unavailable\r\nContent-Type: text/plain\r\n\r\n"
+                                         "Nothing playing\r\n";
+        relay_send(req, (const uint8_t*)busy, strlen(busy));
+    }
+    free(chunk);
+
+    int sockfd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(s_relay_server, sockfd);
+    delete client;
+    s_relay_clients.fetch_sub(1);
+    vTaskDelete(NULL);
+}
+
+// Runs in the server task, which only hands the request over so it stays free for the next listener
+static esp_err_t relay_stream_handler(httpd_req_t* req)
+{
+    if (s_relay_clients.fetch_add(1) >= RELAY_MAX_CLIENTS) {
+        s_relay_clients.fetch_sub(1);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Too many listeners");
+        return ESP_OK;
+    }
 
-        // Log status every 5 seconds
-        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        if ((now - lastStatusLog) > 5000) {
-            size_t bufferBytes = s_radio.ringBuffer.available();
-            int bufferPct = s_radio.ringBuffer.bufferPercent();
-            bool httpRunning = (s_radio.httpTask != nullptr);
-            mclog::tagInfo(TAG, "Status: buffer={}KB ({}%), HTTP task={}, player state={}",
-                          bufferBytes / 1024, bufferPct, httpRunning ? "running" : "stopped", (int)state);
-            lastStatusLog = now;
-        }
+    char value[8] = {0};
+    bool icy      = httpd_req_get_hdr_value_str(req, "Icy-MetaData", value, sizeof(value)) == ESP_OK && atoi(value);
+    char query[32] = {0};
+    char hash[12]  = {0};
+    bool sync      = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                httpd_query_key_value(query, "sync", hash, sizeof(hash)) == ESP_OK;
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+    httpd_req_t* asyncReq = nullptr;
+    if (httpd_req_async_handler_begin(req, &asyncReq) != ESP_OK) {
+        s_relay_clients.fetch_sub(1);
+        return ESP_FAIL;
     }
+    RelayClient_t* client = new RelayClient_t{asyncReq, icy, sync, (uint32_t)strtoul(hash, nullptr, 16)};
+    mclog::tagInfo(TAG, "Relay: new listener{}", sync ? " (sync follower)" : icy ? " (ICY metadata)" : "");
 
-    // Cleanup - delete audio player first
-    audio_player_delete();
+    // Below the HTTP and decode tasks
+    if (task_topology::create(task_topology::RADIO_RELAY, relay_client_task, client, nullptr) != pdPASS) {
+        httpd_req_async_handler_complete(asyncReq);
+        delete client;
+        s_relay_clients.fetch_sub(1);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
 
-    // Note: Don't call fclose on fopencookie FILE - it can cause issues
-    // The ringbuffer_close callback handles cleanup
-    // fclose(stream_fp);  // Removed - causes mutex assertion failure
-    s_audio_ring_buffer = nullptr;
+void HalEsp32::radio_start_relay()
+{
+    if (s_relay_server) {
+        return;
+    }
 
-    // Update state
-    if (s_radio.mutex && xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(100))) {
-        s_radio.state = hal::HalBase::RADIO_STOPPED;
-        xSemaphoreGive(s_radio.mutex);
+    httpd_config_t config    = HTTPD_DEFAULT_CONFIG();
+    config.server_port       = RELAY_PORT;
+    config.ctrl_port         = config.ctrl_port + 1;  // Clear of the AP mode page server
+    config.max_open_sockets  = RELAY_MAX_CLIENTS + CAMERA_STREAM_MAX_VIEWERS + REMOTE_MAX_CLIENTS + 2;
+    config.lru_purge_enable  = true;
+    config.send_wait_timeout = 2;  // Seconds, a listener that stalls longer is dropped
+    config.core_id           = task_topology::CORE_NETWORK;  // Scrapes and new listeners stay off the audio core
+    if (httpd_start(&s_relay_server, &config) != ESP_OK) {
+        mclog::tagError(TAG, "Relay: failed to start server");
+        s_relay_server = nullptr;
+        return;
     }
 
-    mclog::tagInfo(TAG, "Audio decode task ended");
-    s_radio.audioTask = nullptr;
-    vTaskDelete(nullptr);
+    static const httpd_uri_t stream_uri = {
+        .uri = "/stream", .method = HTTP_GET, .handler = relay_stream_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(s_relay_server, &stream_uri);
+    metrics_attach(s_relay_server);
+#if CONFIG_TAB5_CAMERA_STREAM
+    camera_stream_attach(s_relay_server);
+#endif
+#if CONFIG_TAB5_WEB_REMOTE
+    remote_attach(s_relay_server);
+#endif
+    mclog::tagInfo(TAG, "Relay: listening on port {}, /stream", RELAY_PORT);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -785,13 +6370,135 @@ hal::HalBase::RadioState_t HalEsp32::getRadioState()
     return _radio_state;
 }
 
+// For the sync beacon (hal_sync.cpp): playing a station from upstream, not from the SD card or another master
+bool radio_sync_source(uint32_t* urlHash)
+{
+    bool source = false;
+    if (s_radio.mutex && xSemaphoreTake(s_radio.mutex, pdMS_TO_TICKS(10))) {
+        StreamConnection* conn = s_radio.active;
+        source   = s_radio.state == hal::HalBase::RADIO_PLAYING && conn && !conn->local && !conn->following &&
+                 !conn->onDemand &&                      // Its seeks would leave the followers behind
+                 !stream_frame::is_packet(conn->codec);  // Followers take the relay, which doesn't serve those
+        *urlHash = source ? conn->urlHash : 0;
+        xSemaphoreGive(s_radio.mutex);
+    }
+    return source;
+}
+
+// Switch the running decoder over to the warm connection if it is already streaming `url`
+static bool promote_warm_connection(const std::string& url)
+{
+    StreamConnection* warm = s_radio.spare;
+    if (!warm->warm || warm->url != url || !warm->task) {
+        return false;
+    }
+    // Needs a running decoder to hand over to, and something already received on the warm side
+    if (!s_radio.audioTask || !s_audio_conn || s_radio.stopRequested || warm->ringBuffer.available() == 0) {
+        return false;
+    }
+
+    StreamConnection* old = s_radio.active;
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        // From here the HTTP task stops trimming, the decoder becomes the consumer
+        warm->warm     = false;
+        s_radio.active = warm;
+        s_radio.spare  = old;
+        set_radio_state(hal::HalBase::RADIO_PLAYING);
+        xSemaphoreGive(s_radio.mutex);
+    }
+    hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);
+
+    // Publish the new ring before closing the old one, closing wakes a decoder blocked on the old ring
+    s_pending_conn.store(warm);
+    close_connection(old);
+
+    hal::HalBase::RadioMetadata_t meta = warm->metadata.load();
+    if (meta.title[0]) {
+        history_add(warm->url, meta.title);
+    }
+
+    mclog::tagInfo(TAG, "Zapped to warm stream #{}", warm->id);
+    return true;
+}
+
+// Switch the running decoder over to `url` on the spare connection, cold. The decoder, the output task and the I2S
+// clock stay up: no codec reconfiguration, no pop, only the new station's prebuffer
+static bool switch_connection(const std::string& url)
+{
+    StreamConnection* old   = s_radio.active;
+    StreamConnection* spare = s_radio.spare;
+    if (!s_radio.audioTask || !s_audio_conn || s_radio.stopRequested || old->local) {
+        return false;
+    }
+    // A crossfade still reading the spare's ring, or a zap the decoder hasn't taken yet, needs the full restart
+    if (s_audio_conn == spare || s_pending_conn.load() != nullptr || s_fading_conn.load() == spare) {
+        return false;
+    }
+    if (spare->task) {
+        close_connection(spare);  // Warm on another station, or the one before last still closing
+        wait_connection(spare);
+    }
+    if (!open_connection(spare, url, false)) {
+        return false;
+    }
+
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        s_radio.active = spare;
+        s_radio.spare  = old;
+        set_radio_state(hal::HalBase::RADIO_BUFFERING);
+        xSemaphoreGive(s_radio.mutex);
+    }
+    hal_post_event(hal::HalBase::EVENT_RADIO_TITLE);
+
+    // Publish the new ring before closing the old one, closing wakes a decoder blocked on the old ring
+    s_pending_fresh.store(true);
+    s_pending_conn.store(spare);
+    close_connection(old);
+
+    mclog::tagInfo(TAG, "Switched to stream #{}", spare->id);
+    return true;
+}
+
 bool HalEsp32::startRadioStream(const std::string& url)
 {
     mclog::tagInfo(TAG, "Starting radio stream: {}", url);
+    if (!radio_start(url, false)) {
+        return false;
+    }
+    warm_restart_playing(url.c_str(), getSpeakerVolume());
+    return true;
+}
+
+bool HalEsp32::startRadioFiles(const std::vector<std::string>& paths)
+{
+    if (paths.empty() || !isSdCardMounted()) {
+        return false;
+    }
+    mclog::tagInfo(TAG, "Playing {} files from the SD card", paths.size());
+    stopRadioStream();  // Its file task may still be at the queue
+    {
+        std::lock_guard<std::mutex> lock(s_files.mutex);
+        s_files.queue.assign(paths.begin(), paths.end());
+        s_files.tracks.clear();
+    }
+    return radio_start(SDCARD_MOUNT_POINT + paths[0], true);
+}
 
-    // Stop any existing stream
-    stopRadioStream();
+bool HalEsp32::queueRadioFile(const std::string& path)
+{
+    StreamConnection* conn = s_radio.active;
+    {
+        std::lock_guard<std::mutex> lock(s_files.mutex);
+        if (s_radio.audioTask && !s_radio.stopRequested && conn->local && !conn->ended) {
+            s_files.queue.push_back(path);
+            return true;
+        }
+    }
+    return startRadioFiles({path});
+}
 
+bool HalEsp32::radio_start(const std::string& url, bool local)
+{
     // Initialize mutex if needed
     if (!s_radio.mutex) {
         s_radio.mutex = xSemaphoreCreateMutex();
@@ -801,110 +6508,483 @@ bool HalEsp32::startRadioStream(const std::string& url)
         }
     }
 
-    // Initialize ring buffer
-    if (!s_radio.ringBuffer.buffer) {
-        if (!s_radio.ringBuffer.init(RING_BUFFER_SIZE)) {
-            mclog::tagError(TAG, "Failed to init ring buffer");
-            return false;
-        }
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
+    abr_select(local ? std::string() : url);
+
+    // A new station always starts live, and a recording belongs to the station it was started on
+    stop_recording(true);
+    s_radio.paused = false;
+    s_radio.skipSeconds.store(0);
+    s_radio.seekSeconds.store(-1);
+
+    // Fast path: the station is already buffered on the warm connection, no reconnect or prebuffer needed
+    if (!local && promote_warm_connection(url)) {
+        _radio_state = RADIO_PLAYING;
+        supervisor_start();
+        return true;
+    }
+    // Otherwise a running decoder takes the new station as it is
+    if (!local && switch_connection(url)) {
+        _radio_state = RADIO_BUFFERING;
+        supervisor_start();
+        return true;
     }
-    s_radio.ringBuffer.reset();
 
-    // Set state - increment stream ID to invalidate old HTTP tasks
+    // Stop any existing stream, the files to play are already queued
+    if (!local) {
+        stopRadioStream();
+    }
+    trace_start();
+    s_output_volume = getSpeakerVolume();
+
+    // Set state
     if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
-        s_radio.streamId++;  // New stream, old HTTP tasks will be ignored
-        s_radio.currentUrl     = url;
-        s_radio.state          = RADIO_BUFFERING;
-        s_radio.stopRequested  = false;
-        s_radio.streamTitle    = "";
-        s_radio.icyMetaInt     = 0;
-        s_radio.bytesUntilMeta = 0;
-        s_radio.hal            = this;
-        radioMetadata.title    = "";
-        radioMetadata.station  = "";
-        radioMetadata.bufferPercent = 0;
-        memset(s_radio.spectrum, 0, sizeof(s_radio.spectrum));
-        mclog::tagInfo(TAG, "Starting stream #{}", s_radio.streamId);
+        s_radio.stopRequested = false;
+        set_radio_state(RADIO_BUFFERING);
         xSemaphoreGive(s_radio.mutex);
     }
 
     _radio_state = RADIO_BUFFERING;
 
     // Start HTTP streaming task
-    BaseType_t ret =
-        xTaskCreate(http_stream_task, "http_stream", 8192, nullptr, 5, &s_radio.httpTask);
-    if (ret != pdPASS) {
-        mclog::tagError(TAG, "Failed to create HTTP stream task");
+    // Reported as an error, not left buffering a stream that never comes
+    if (!open_connection(s_radio.active, url, false, local)) {
+        set_radio_error(s_radio.active);
         _radio_state = RADIO_ERROR;
         return false;
     }
+    mclog::tagInfo(TAG, "Starting stream #{}", s_radio.active->id);
 
     // Start audio decode task
-    ret = xTaskCreate(audio_decode_task, "audio_decode", 8192, nullptr, 6, &s_radio.audioTask);
-    if (ret != pdPASS) {
+    if (!s_radio.audioTask.start(task_topology::RADIO_DECODE, audio_decode_task, nullptr)) {
         mclog::tagError(TAG, "Failed to create audio decode task");
         s_radio.stopRequested = true;
-        _radio_state          = RADIO_ERROR;
+        close_connection(s_radio.active);
+        set_radio_error(s_radio.active);
+        _radio_state = RADIO_ERROR;
         return false;
     }
 
+    if (!s_spectrum_task && !s_spectrum_task.start(task_topology::RADIO_SPECTRUM, spectrum_task, nullptr)) {
+        mclog::tagWarn(TAG, "No spectrum task, the display gets no bars");
+    }
+    supervisor_start();
+
     return true;
 }
 
-void HalEsp32::stopRadioStream()
+bool HalEsp32::prewarmRadioStream(const std::string& url)
 {
-    mclog::tagInfo(TAG, "Stopping radio stream");
+    // Only worth a second connection while something is playing
+    if (!s_radio.mutex || !s_radio.audioTask || s_radio.stopRequested) {
+        return false;
+    }
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
 
-    // Signal tasks to stop
-    s_radio.stopRequested = true;
+    StreamConnection* spare = s_radio.spare;
+    if (spare->warm && spare->url == url && spare->task) {
+        return true;
+    }
 
-    // Wait for audio task to end first (it's the consumer)
-    int timeout = 50;  // 5 seconds for audio task
-    while (s_radio.audioTask && timeout > 0) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        timeout--;
+    // The spare must be fully released first: its HTTP task gone and the decoder moved off its ring
+    if (spare->task) {
+        if (spare->warm) {
+            close_connection(spare);  // Warm on a different station
+        }
+        return false;
+    }
+    if (s_audio_conn == spare || s_pending_conn.load() != nullptr || s_fading_conn.load() == spare) {
+        return false;
     }
 
-    // Wait for HTTP task to end (it should stop after audio task is gone)
-    timeout = 50;  // 5 seconds for HTTP task
-    while (s_radio.httpTask && timeout > 0) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        timeout--;
+    mclog::tagInfo(TAG, "Pre-warming: {}", url);
+    return open_connection(spare, url, true);
+}
+
+void HalEsp32::setRadioVariants(const std::vector<RadioVariant_t>& variants)
+{
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
+    s_abr.variants.clear();
+    s_abr.failed  = 0;
+    s_abr.current = -1;
+    if (CONFIG_TAB5_RADIO_ABR_MAX_KBPS > 0) {
+        for (const auto& variant : variants) {
+            if (variant.kbps > 0 && !variant.url.empty() && s_abr.variants.size() < ABR_MAX_VARIANTS) {
+                s_abr.variants.push_back(variant);
+            }
+        }
+        std::stable_sort(s_abr.variants.begin(), s_abr.variants.end(),
+                         [](const RadioVariant_t& a, const RadioVariant_t& b) { return a.kbps < b.kbps; });
     }
+    abr_select(s_radio.active->url);
+}
 
-    // Don't force delete HTTP task - it crashes the lwip stack!
-    // If tasks are still running, just log a warning and continue
-    // The tasks will clean themselves up eventually
-    if (s_radio.httpTask) {
-        mclog::tagWarn(TAG, "HTTP task still running, not force deleting (would crash lwip)");
-        // Just clear the handle - task will delete itself
-        s_radio.httpTask = nullptr;
+bool HalEsp32::switchRadioVariant(const std::string& url)
+{
+    if (!s_radio.mutex || !s_radio.audioTask || s_radio.stopRequested) {
+        return false;
     }
-    if (s_radio.audioTask) {
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
+    int target = -1;
+    for (int i = 0; i < (int)s_abr.variants.size(); i++) {
+        if (s_abr.variants[i].url == url) {
+            target = i;
+        }
+    }
+    if (target < 0 || s_abr.current < 0 || (s_abr.failed & (1u << target))) {
+        return false;
+    }
+    if (target == s_abr.current) {
+        return true;
+    }
+    // The decoder's own steps wait for this one
+    if (s_abr.stepping.exchange(true)) {
+        return false;
+    }
+    int direction = target > s_abr.current ? 1 : -1;
+    mclog::tagInfo(TAG, "Switching to the {} kbps variant", s_abr.variants[target].kbps);
+    runInBackground([direction, target]() { abr_step(direction, target); });
+    return true;
+}
+
+void HalEsp32::stopRadioStream()
+{
+    mclog::tagInfo(TAG, "Stopping radio stream");
+    std::lock_guard<std::recursive_mutex> lock(s_abr.control);
+    warm_restart_stopped();
+
+    // Signal tasks to stop and release anything blocked on the ring buffers
+    supervisor_stop();
+    stop_recording(true);
+    s_radio.stopRequested = true;
+    s_spectrum_task.cancel();
+    close_connection(s_radio.active);
+    close_connection(s_radio.spare);
+    history_flush_async(1);  // Stopping is often the last thing before a power off
+
+    // Join the audio task first (it's the consumer), then the HTTP tasks it was reading from
+    if (!s_radio.audioTask.join(DECODE_JOIN_MS)) {
         mclog::tagWarn(TAG, "Audio task still running, not force deleting");
-        s_radio.audioTask = nullptr;
+    }
+    wait_connection(s_radio.active);
+    wait_connection(s_radio.spare);
+    if (!s_spectrum_task.join(SPECTRUM_JOIN_MS)) {
+        mclog::tagWarn(TAG, "Spectrum task still running, left to end by itself");
     }
 
-    // Reset audio state
-    s_audio_ring_buffer = nullptr;
-    s_stream_position = 0;
+    // Reset audio state, the decoder clears its own ring pointer on exit
+    s_pending_conn.store(nullptr);
+    s_pending_fresh.store(false);
+    s_splice_conn.store(nullptr);
 
     // Update state
     if (s_radio.mutex && xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
-        s_radio.state = RADIO_STOPPED;
+        set_radio_state(RADIO_STOPPED);
         xSemaphoreGive(s_radio.mutex);
     }
     _radio_state = RADIO_STOPPED;
 
-    radioMetadata.title         = "";
-    radioMetadata.bufferPercent = 0;
+    // Nothing writes the connections' metadata any more
+    s_radio.active->metadata.store({});
+    s_stream_format.store({});
+    hal_post_event(EVENT_RADIO_TITLE);
+    if (stream_trace().active()) {
+        runInBackground(trace_dump);
+    }
+}
+
+bool HalEsp32::pauseRadioStream()
+{
+    if (!s_radio.mutex || !s_radio.audioTask || s_radio.stopRequested) {
+        return false;
+    }
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        s_radio.paused = true;
+        set_radio_state(RADIO_PAUSED);
+        xSemaphoreGive(s_radio.mutex);
+    }
+    _radio_state = RADIO_PAUSED;
+    return true;
+}
+
+void HalEsp32::resumeRadioStream()
+{
+    if (!s_radio.mutex || !s_radio.paused) {
+        return;
+    }
+    if (xSemaphoreTake(s_radio.mutex, portMAX_DELAY)) {
+        s_radio.paused = false;
+        set_radio_state(RADIO_PLAYING);
+        xSemaphoreGive(s_radio.mutex);
+    }
+    _radio_state = RADIO_PLAYING;
+}
+
+bool HalEsp32::skipRadioStream(int seconds)
+{
+    if (!s_radio.audioTask || s_radio.stopRequested) {
+        return false;
+    }
+    s_radio.skipSeconds.fetch_add(seconds);
+    return true;
+}
+
+bool HalEsp32::seekRadioStream(int seconds)
+{
+    if (!s_radio.audioTask || s_radio.stopRequested || !s_position.load().seekable) {
+        return false;
+    }
+    s_radio.seekSeconds.store(std::max(seconds, 0));
+    return true;
+}
+
+hal::HalBase::RadioPosition_t HalEsp32::getRadioPosition()
+{
+    return s_position.load();
+}
+
+hal::HalBase::RadioTimeShift_t HalEsp32::getRadioTimeShift()
+{
+    RadioTimeShift_t timeShift;
+    StreamConnection* conn = s_radio.active;
+    if (!s_radio.audioTask || !conn->ringBuffer.isInitialized()) {
+        return timeShift;
+    }
+    int rate              = stream_bytes_per_second(conn);
+    timeShift.paused      = s_radio.paused;
+    timeShift.behindLiveS = conn->ringBuffer.available() / rate;
+    timeShift.historyS    = conn->ringBuffer.history() / rate;
+    return timeShift;
+}
+
+bool HalEsp32::startRadioRecording()
+{
+    if (!s_radio.audioTask || s_radio.stopRequested) {
+        return false;
+    }
+    return start_recording(s_radio.active);
+}
+
+void HalEsp32::stopRadioRecording()
+{
+    stop_recording(false);
+}
+
+bool HalEsp32::isRadioRecording()
+{
+    return s_recorder.conn.load() != nullptr;
+}
+
+bool HalEsp32::saveRadioHistory(int minutes)
+{
+    if (!s_radio.audioTask || s_radio.stopRequested || minutes <= 0) {
+        return false;
+    }
+    StreamConnection* conn = s_radio.active;
+    return start_save(conn, (size_t)minutes * 60 * stream_bytes_per_second(conn));
+}
+
+bool HalEsp32::isRadioHistorySaving()
+{
+    return s_save.conn.load() != nullptr;
+}
+
+std::vector<hal::HalBase::RadioHistoryEntry_t> HalEsp32::searchRadioHistory(const std::string& prefix,
+                                                                            int maxResults)
+{
+    std::vector<RadioHistoryEntry_t> results;
+    std::lock_guard<std::mutex> lock(s_history.mutex);
+    history_load_locked();
+    s_history.ring.search(prefix.c_str(), [&](const TitleHistory::Entry_t& entry, const char* station,
+                                              const char* title) {
+        results.push_back({entry.time, station, title});
+        return (int)results.size() < maxResults;
+    });
+    return results;
+}
+
+hal::HalBase::RadioStreamFormat_t HalEsp32::getRadioStreamFormat()
+{
+    return s_stream_format.load();
+}
+
+hal::HalBase::RadioMetadata_t HalEsp32::getRadioMetadata()
+{
+    StreamConnection* active = s_radio.active;
+    RadioMetadata_t metadata = active->metadata.load();
+    metadata.bufferPercent   = active->ringBuffer.bufferPercent();
+    return metadata;
+}
+
+bool radio_output_routes()
+{
+    return !s_output.task.cancelled();
+}
+
+bool HalEsp32::radio_set_volume(uint8_t volume)
+{
+    s_output_volume = volume;
+    return s_output_owned;
+}
+
+void HalEsp32::setRadioEq(const RadioEq_t& eq)
+{
+    s_output_eq.store(eq);
+    s_output_eq_version++;
+}
+
+hal::HalBase::RadioEq_t HalEsp32::getRadioEq()
+{
+    return s_output_eq.load();
+}
+
+void HalEsp32::setRadioCrossfade(int ms)
+{
+    s_crossfade_ms = (ms <= 0) ? 0 : std::clamp(ms, CROSSFADE_MIN_MS, CROSSFADE_MAX_MS);
+}
+
+int HalEsp32::getRadioCrossfade()
+{
+    return s_crossfade_ms.load();
+}
+
+hal::HalBase::RadioOutputStats_t HalEsp32::getRadioOutputStats()
+{
+    RadioOutputStats_t stats;
+    stats.underruns        = s_output.underruns.load();
+    stats.silentDmaBuffers = bsp_audio_get_tx_silent_buffers();
+    stats.usbAudio         = s_output.usb.load();
+    stats.latencyMs        = s_output.latencyUs.load() / 1000;
+    return stats;
+}
+
+bool HalEsp32::getRadioWaveform(RadioWaveform_t* frame)
+{
+    // Like the spectrum, the UI task is the only consumer
+    s_waveform_frames.update();
+    const RadioWaveform_t& latest = s_waveform_frames.front();
+    if (latest.version == frame->version) {
+        return false;
+    }
+    *frame = latest;
+    return true;
+}
+
+void HalEsp32::setRadioWaveformColumns(int columns)
+{
+    s_waveform_columns = std::clamp(columns, 0, RadioWaveform_t::MAX_COLUMNS);
+}
+
+bool HalEsp32::getRadioSpectrum(RadioSpectrum_t* frame)
+{
+    // The triple buffer's only consumer, which is fine as long as only the UI task polls
+    s_spectrum_frames.update();
+    const RadioSpectrum_t& latest = s_spectrum_frames.front();
+    if (latest.version == frame->version) {
+        return false;
+    }
+    *frame = latest;
+    return true;
+}
+
+void HalEsp32::setRadioSpectrumBands(int bands)
+{
+    s_spectrum_bands = std::clamp(bands, SPECTRUM_MIN_BANDS, (int)RadioSpectrum_t::MAX_BANDS);
+}
+
+// The whole file in PSRAM, nullptr if it isn't there or too big
+static uint8_t* bench_load(const char* path, size_t* size)
+{
+    if (!sdcard_acquire()) {
+        return nullptr;
+    }
+    uint8_t* data = nullptr;
+    FILE* file    = fopen(path, "rb");
+    struct stat st;
+    if (file && fstat(fileno(file), &st) == 0 && st.st_size > 0 && st.st_size <= BENCH_FILE_MAX_SIZE) {
+        data = (uint8_t*)heap_caps_malloc(st.st_size, MALLOC_CAP_SPIRAM);
+        if (data && fread(data, 1, st.st_size, file) != (size_t)st.st_size) {
+            free(data);
+            data = nullptr;
+        }
+        *size = st.st_size;
+    }
+    if (file) {
+        fclose(file);
+    }
+    sdcard_release();
+    return data;
+}
+
+bool HalEsp32::runRadioBenchmark(RadioBenchmark_t* result, const char* path)
+{
+    // The decoder's buffers and the audio core would be shared with a running stream
+    if (s_radio.audioTask) {
+        mclog::tagWarn(TAG, "Benchmark: radio is playing");
+        return false;
+    }
+
+    *result = {};
+    BenchRun_t run;
+    run.result   = result;
+    run.caller   = xTaskGetCurrentTaskHandle();
+    run.file     = canon_in_d_mp3_start;
+    run.fileSize = canon_in_d_mp3_end - canon_in_d_mp3_start - 1;  // EMBED_TXTFILES adds a NUL
+    uint8_t* loaded = nullptr;
+    if (path) {
+        loaded = bench_load(path, &run.fileSize);
+        if (!loaded) {
+            mclog::tagWarn(TAG, "Benchmark: can't read {}", path);
+            return false;
+        }
+        run.file       = loaded;
+        run.packetized = ends_with(path, ".ogg") || ends_with(path, ".opus") || ends_with(path, ".flac");
+        run.codec      = ends_with(path, ".aac") ? CODEC_AAC : CODEC_MP3;
+    }
+    bool created =
+        task_topology::create(task_topology::RADIO_DECODE, bench_task, &run, nullptr, "radio_bench") == pdPASS;
+    if (created) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    free(loaded);
+    if (!created || !run.ok) {
+        return false;
+    }
 
-    // Give time for tasks to fully clean up and network stack to settle
-    vTaskDelay(pdMS_TO_TICKS(500));
+    mclog::tagInfo(TAG,
+                   "Benchmark ({}): {} frames, {:.1f} s at {} kbps, {} cycles/frame (max {}), max frame {} us, "
+                   "core load {:.1f}%, {} B internal, {} B PSRAM, {} decode errors",
+                   path ? path : "embedded MP3", result->frames, result->audioSeconds, result->bitrateKbps,
+                   result->cyclesPerFrame, result->maxFrameCycles, result->maxFrameUs, result->coreLoad * 100,
+                   result->internalBytes, result->psramBytes, result->decodeErrors);
+    return true;
 }
 
-void HalEsp32::getRadioSpectrum(uint8_t* spectrum, size_t len)
+bool HalEsp32::runOutputBenchmark(uint32_t seconds, OutputBenchmark_t* result)
 {
-    size_t copyLen = (len < SPECTRUM_BANDS) ? len : SPECTRUM_BANDS;
-    memcpy(spectrum, s_radio.spectrum, copyLen);
+    // The output's blocks and queues are the radio's
+    if (s_radio.audioTask) {
+        mclog::tagWarn(TAG, "Output benchmark: radio is playing");
+        return false;
+    }
+
+    *result = {};
+    OutputBenchRun_t run;
+    run.result  = result;
+    run.seconds = std::clamp<uint32_t>(seconds, 1, OUTPUT_BENCH_MAX_SECONDS);
+    run.caller  = xTaskGetCurrentTaskHandle();
+    if (task_topology::create(task_topology::RADIO_DECODE, output_bench_task, &run, nullptr, "out_bench") != pdPASS) {
+        return false;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!run.ok) {
+        return false;
+    }
+
+    mclog::tagInfo(TAG,
+                   "Output benchmark: {}, {:.1f} s, {} blocks, {} underruns, latency {} ms (max {}), "
+                   "core load {:.2f}%",
+                   result->usbAudio ? "USB DAC" : "speaker codec", result->seconds, result->blocks, result->underruns,
+                   result->latencyMs, result->maxLatencyMs, result->coreLoad * 100);
+    return true;
 }
@@ -0,0 +1,367 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_http_server.h>
+
+#define TAG "remote"
+
+/* -------------------------------------------------------------------------- */
+/*                                 Web Remote                                 */
+/* -------------------------------------------------------------------------- */
+// A page on the relay server (http://<ip>:8000/) that lists the stations, sets the volume and shows what plays. The
+// page is app/assets/web/remote.html, gzipped into the assets partition and sent as it is stored. Its WebSocket at
+// /ws gets the state pushed: a task of its own subscribes to the HAL's events, and each batch of changes becomes one
+// JSON message for every client. Sends are queued on the server's task with httpd_ws_send_data_async(), at most
+// REMOTE_CLIENT_QUEUE per client: a client that falls behind skips messages and gets the newest state once it has
+// room again, the state is always whole. What a client sends is a word and maybe a number ("station 12", "volume
+// 40", "play", "stop", "next", "previous"), posted as EVENT_REMOTE for the UI. Nothing here takes the LVGL lock or
+// waits on a stream task
+#define REMOTE_PAGE         "/assets/remote.html.gz"
+#define REMOTE_CLIENT_QUEUE 4
+#define REMOTE_POLL_MS      100
+#define REMOTE_PAGE_CHUNK   2048
+#define REMOTE_COMMAND_MAX  32
+
+struct RemoteClient_t {
+    int fd = -1;
+    std::atomic<int> queued{0};
+    bool stale    = false;  // Skipped a state message, the next one goes out even if nothing changed
+    bool stations = false;  // Has the station list
+};
+
+// One payload for every client it goes to, freed with the last send
+struct RemoteSend_t {
+    std::shared_ptr<std::string> text;
+    RemoteClient_t* client;
+};
+
+static struct {
+    httpd_handle_t server = nullptr;
+    TaskHandle_t task     = nullptr;
+    std::mutex mutex;  // Clients and the station list, the server's task and the push task
+    RemoteClient_t clients[REMOTE_MAX_CLIENTS];
+    std::vector<std::string> stations;
+    uint32_t stationsVersion = 1;  // The clients start at 0, with nothing
+} s_remote;
+
+static void json_string(std::string* out, const char* text)
+{
+    out->push_back('"');
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out->push_back('\\');
+            out->push_back(*c);
+        } else if ((uint8_t)*c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+            out->append(escaped);
+        } else {
+            out->push_back(*c);
+        }
+    }
+    out->push_back('"');
+}
+
+static std::shared_ptr<std::string> state_message()
+{
+    auto hal      = GetHAL();
+    auto metadata = hal->getRadioMetadata();
+    auto text     = std::make_shared<std::string>();
+    text->reserve(256);
+    char numbers[96];
+    snprintf(numbers, sizeof(numbers), "{\"type\":\"state\",\"state\":%d,\"volume\":%d,\"buffer\":%d,\"bitrate\":%d,",
+             (int)hal->getRadioState(), (int)hal->getSpeakerVolume(), std::clamp(metadata.bufferPercent, 0, 100),
+             std::max(metadata.bitrate, 0));
+    text->append(numbers);
+    text->append("\"station\":");
+    json_string(text.get(), metadata.station);
+    text->append(",\"title\":");
+    json_string(text.get(), metadata.title);
+    text->push_back('}');
+    return text;
+}
+
+static std::shared_ptr<std::string> stations_message()
+{
+    auto text = std::make_shared<std::string>("{\"type\":\"stations\",\"names\":[");
+    std::lock_guard<std::mutex> lock(s_remote.mutex);
+    for (size_t i = 0; i < s_remote.stations.size(); i++) {
+        if (i > 0) {
+            text->push_back(',');
+        }
+        json_string(text.get(), s_remote.stations[i].c_str());
+    }
+    text->append("]}");
+    return text;
+}
+
+static RemoteClient_t* client_for(int fd)
+{
+    for (auto& client : s_remote.clients) {
+        if (client.fd == fd) {
+            return &client;
+        }
+    }
+    return nullptr;
+}
+
+static void drop_client(int fd)
+{
+    std::lock_guard<std::mutex> lock(s_remote.mutex);
+    if (RemoteClient_t* client = client_for(fd)) {
+        client->fd = -1;
+        mclog::tagInfo(TAG, "client {} left", fd);
+    }
+}
+
+// On the server's task, once the frame went out or couldn't
+static void on_sent(esp_err_t err, int fd, void* arg)
+{
+    std::unique_ptr<RemoteSend_t> send((RemoteSend_t*)arg);
+    send->client->queued.fetch_sub(1);
+    if (err != ESP_OK) {
+        drop_client(fd);
+    }
+}
+
+// False if the client's queue is full
+static bool queue_send(RemoteClient_t* client, const std::shared_ptr<std::string>& text)
+{
+    if (client->queued.fetch_add(1) >= REMOTE_CLIENT_QUEUE) {
+        client->queued.fetch_sub(1);
+        return false;
+    }
+    auto send              = new RemoteSend_t{text, client};
+    httpd_ws_frame_t frame = {};
+    frame.type             = HTTPD_WS_TYPE_TEXT;
+    frame.final            = true;
+    frame.payload          = (uint8_t*)text->data();
+    frame.len              = text->size();
+    if (httpd_ws_send_data_async(s_remote.server, client->fd, &frame, on_sent, send) != ESP_OK) {
+        client->queued.fetch_sub(1);
+        delete send;
+        return false;
+    }
+    return true;
+}
+
+// Each client gets the station list once and again when it changes, the state when it changed or was skipped
+static void push(bool changed, uint32_t* stationsSent)
+{
+    bool needStations = false;
+    {
+        std::lock_guard<std::mutex> lock(s_remote.mutex);
+        for (auto& client : s_remote.clients) {
+            if (client.fd >= 0 && httpd_ws_get_fd_info(s_remote.server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+                client.fd = -1;  // Gone without a word
+            }
+            client.stations = client.stations && s_remote.stationsVersion == *stationsSent;
+            needStations    = needStations || (client.fd >= 0 && !client.stations);
+            changed         = changed || client.stale;
+        }
+        *stationsSent = s_remote.stationsVersion;
+    }
+    // Built outside the lock, the state getters take their own
+    auto stations = needStations ? stations_message() : nullptr;
+    auto state    = changed ? state_message() : nullptr;
+
+    std::lock_guard<std::mutex> lock(s_remote.mutex);
+    for (auto& client : s_remote.clients) {
+        if (client.fd < 0) {
+            continue;
+        }
+        if (stations && !client.stations) {
+            client.stations = queue_send(&client, stations);
+        }
+        if (state) {
+            client.stale = !queue_send(&client, state);
+        }
+    }
+}
+
+static bool has_clients()
+{
+    std::lock_guard<std::mutex> lock(s_remote.mutex);
+    return std::any_of(std::begin(s_remote.clients), std::end(s_remote.clients),
+                       [](const RemoteClient_t& client) { return client.fd >= 0; });
+}
+
+static void remote_task(void* param)
+{
+    int subscriber        = -1;
+    uint32_t stationsSent = 0;
+    int volume            = -1;  // The UI sets it without an event
+    while (true) {
+        if (!has_clients()) {
+            // Nobody to tell, the events aren't even queued until the next client comes
+            GetHAL()->unsubscribeEvents(subscriber);
+            subscriber = -1;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (subscriber < 0) {
+            subscriber = GetHAL()->subscribeEvents();
+        }
+        bool changed = false;
+        hal::HalBase::Event_t event;
+        while (GetHAL()->pollEvent(subscriber, &event)) {
+            switch (event.type) {
+                case hal::HalBase::EVENT_RESYNC:
+                case hal::HalBase::EVENT_RADIO_STATE:
+                case hal::HalBase::EVENT_RADIO_TITLE:
+                case hal::HalBase::EVENT_RADIO_BUFFER:
+                    changed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (GetHAL()->getSpeakerVolume() != volume) {
+            volume  = GetHAL()->getSpeakerVolume();
+            changed = true;
+        }
+        push(changed, &stationsSent);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(REMOTE_POLL_MS));
+    }
+}
+
+static void handle_command(const char* text)
+{
+    char word[16] = {};
+    int argument  = 0;
+    if (sscanf(text, "%15s %d", word, &argument) < 1) {
+        return;
+    }
+    int command;
+    if (strcmp(word, "play") == 0) {
+        command = hal::HalBase::REMOTE_PLAY;
+    } else if (strcmp(word, "stop") == 0) {
+        command = hal::HalBase::REMOTE_STOP;
+    } else if (strcmp(word, "next") == 0) {
+        command = hal::HalBase::REMOTE_NEXT_STATION;
+    } else if (strcmp(word, "previous") == 0) {
+        command = hal::HalBase::REMOTE_PREVIOUS_STATION;
+    } else if (strcmp(word, "station") == 0 && argument >= 0) {
+        command = hal::HalBase::REMOTE_STATION;
+    } else if (strcmp(word, "volume") == 0) {
+        command  = hal::HalBase::REMOTE_VOLUME;
+        argument = std::clamp(argument, 0, 100);
+    } else {
+        mclog::tagWarn(TAG, "unknown command: {}", text);
+        return;
+    }
+    hal_post_event(hal::HalBase::EVENT_REMOTE, command | argument << 8);
+}
+
+static esp_err_t ws_handler(httpd_req_t* req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET) {
+        // The handshake
+        std::lock_guard<std::mutex> lock(s_remote.mutex);
+        RemoteClient_t* client = client_for(fd) ? client_for(fd) : client_for(-1);
+        if (!client) {
+            mclog::tagWarn(TAG, "{} clients already, turning one away", REMOTE_MAX_CLIENTS);
+            return ESP_FAIL;
+        }
+        client->fd       = fd;
+        client->stale    = true;
+        client->stations = false;
+        mclog::tagInfo(TAG, "client {} joined", fd);
+        xTaskNotifyGive(s_remote.task);
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = {};
+    if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    // Every payload is read, binary ones too, or the server takes its bytes for the next frame's header. It can only
+    // be read in one go, so a client sending more than a command is closed
+    if (frame.len > REMOTE_COMMAND_MAX) {
+        mclog::tagWarn(TAG, "client {} sent a {} byte frame, closing it", fd, frame.len);
+        drop_client(fd);
+        return ESP_FAIL;
+    }
+    char text[REMOTE_COMMAND_MAX + 1] = {};
+    frame.payload                     = (uint8_t*)text;
+    if (frame.len > 0 && httpd_ws_recv_frame(req, &frame, REMOTE_COMMAND_MAX) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (frame.type == HTTPD_WS_TYPE_TEXT) {
+        handle_command(text);
+    }
+    return ESP_OK;
+}
+
+// The page as stored, the browser unzips it
+static esp_err_t page_handler(httpd_req_t* req)
+{
+    FILE* file = fopen(REMOTE_PAGE, "rb");
+    if (!file) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "The assets partition has no remote page");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Cache-Control", "max-age=3600");
+    std::unique_ptr<char[]> chunk(new (std::nothrow) char[REMOTE_PAGE_CHUNK]);
+    esp_err_t err = chunk ? ESP_OK : ESP_ERR_NO_MEM;
+    size_t n;
+    while (err == ESP_OK && (n = fread(chunk.get(), 1, REMOTE_PAGE_CHUNK, file)) > 0) {
+        err = httpd_resp_send_chunk(req, chunk.get(), n);
+    }
+    fclose(file);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, nullptr, 0);
+    }
+    return err;
+}
+
+void remote_attach(httpd_handle_t server)
+{
+    s_remote.server = server;
+    if (task_topology::create(task_topology::WEB_REMOTE, remote_task, nullptr, &s_remote.task) != pdPASS) {
+        mclog::tagError(TAG, "no task for the web remote");
+        s_remote.task = nullptr;
+        return;
+    }
+    static const httpd_uri_t page_uri = {
+        .uri = "/", .method = HTTP_GET, .handler = page_handler, .user_ctx = nullptr};
+    httpd_uri_t ws_uri  = {};
+    ws_uri.uri          = "/ws";
+    ws_uri.method       = HTTP_GET;
+    ws_uri.handler      = ws_handler;
+    ws_uri.is_websocket = true;
+    if (httpd_register_uri_handler(server, &page_uri) != ESP_OK ||
+        httpd_register_uri_handler(server, &ws_uri) != ESP_OK) {
+        mclog::tagError(TAG, "failed to register / and /ws");
+        return;
+    }
+    mclog::tagInfo(TAG, "serving the web remote at / and /ws");
+}
+
+void HalEsp32::setRemoteStations(const std::vector<std::string>& names)
+{
+    std::lock_guard<std::mutex> lock(s_remote.mutex);
+    if (names != s_remote.stations) {
+        s_remote.stations = names;
+        s_remote.stationsVersion++;
+    }
+}
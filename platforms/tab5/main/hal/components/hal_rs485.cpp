@@ -4,72 +4,252 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/frame_link/frame_link.h"
+#include <hal/metrics.h>
 #include <mooncake_log.h>
-#include <vector>
+#include <algorithm>
+#include <string>
+#include <string.h>
 #include <driver/gpio.h>
-#include <memory>
 #include "driver/uart.h"
 #include "esp_log.h"
 
 #define TAG "hal_rs485"
 
 // RS485
-#define TAB5_RS485_BUF_SIZE (127)
+#define TAB5_RS485_BUF_SIZE   (4096)  // Driver RX and TX buffers each, ~20 ms at 2 Mbaud
+#define TAB5_RS485_QUEUE_SIZE 16
+#define TAB5_RS485_TX_POLL_MS 20
+#define TAB5_RS485_RX_FULL    100  // FIFO bytes per RX interrupt, the task wakes once per this many at most
 // Timeout threshold for UART = number of symbols (~10 tics) with unchanged state on receive pin
 #define TAB5_RS485_READ_TOUT        (3)  // 3.5T * 8 = 28 ticks, TOUT=3 -> ~24..33 ticks
-#define TAB5_RS485_PACKET_READ_TICS (100 / portTICK_PERIOD_MS)
 static uart_port_t tab5_rs485_uart_num = UART_NUM_1;
 
 #define TAB5_SYS_RS485_TX_PIN 20
 #define TAB5_SYS_RS485_RX_PIN 21
 #define TAB5_SYS_RS485_DE_PIN 34
 
-static void tab5_rs485_echo_send(const int port, uint8_t* str, uint8_t length)
+/* -------------------------------------------------------------------------- */
+/*                                  RS485 Link                                */
+/* -------------------------------------------------------------------------- */
+// A master on the bus (building automation, a PLC) drives the radio with framed packets (utils/frame_link: COBS,
+// CRC-16, 0x00 between frames). A packet is [address][command][sequence][body...], a reply has the unit's address,
+// the command | 0x80 and the same sequence. Address 0 is a broadcast nobody answers.
+//   0x01 ping           -> empty
+//   0x02 status         -> state, volume, buffer %, bitrate (u16), station (u8 length + text), title (the same)
+//   0x03 play, 0x04 stop, 0x05 next, 0x06 previous station, 0x07 station (u16 index), 0x08 volume (u8 0..100)
+//                       -> empty once the UI has it queued (EVENT_REMOTE)
+//   0x09 metrics (u16 offset) -> total length (u16) and the Prometheus text from there, as much as fits. Offset 0
+//                       takes a fresh copy, the later chunks come from it
+//   anything else       -> command 0xFF, body the command
+// The driver's interrupt moves the bytes between FIFO and ring buffers, the task wakes per FIFO's worth or at a
+// pause on the line and decodes straight out of a chunk of the driver's buffer. Raw bytes still go to the COM
+// monitor panel too, and what it sends goes out between frames
+#define RS485_ADDRESS   CONFIG_TAB5_RS485_ADDRESS
+#define RS485_BROADCAST 0
+#define RS485_RX_CHUNK  512
+#define RS485_REPLY     0x80
+#define RS485_HEADER    3  // Address, command, sequence
+
+enum : uint8_t {
+    RS485_PING = 0x01,
+    RS485_STATUS,
+    RS485_PLAY,
+    RS485_STOP,
+    RS485_NEXT,
+    RS485_PREVIOUS,
+    RS485_STATION,
+    RS485_VOLUME,
+    RS485_METRICS,
+    RS485_UNKNOWN = 0x7F,
+};
+
+static QueueHandle_t s_uart_queue = nullptr;
+
+static metrics::Counter s_metric_frames("rs485_frames_total", "Frames for this unit received intact");
+static metrics::Counter s_metric_errors("rs485_frame_errors_total", "Frames cut short, too long or failing the CRC");
+static metrics::Counter s_metric_overruns("rs485_overruns_total", "Times the UART's FIFO or buffer overflowed");
+
+struct Reply_t {
+    uint8_t packet[frame_link::MAX_PACKET - 2];
+    size_t len = 0;
+
+    size_t room() const
+    {
+        return sizeof(packet) - len;
+    }
+    void put(const void* data, size_t n)
+    {
+        n = std::min(n, room());
+        memcpy(packet + len, data, n);
+        len += n;
+    }
+    void put8(uint8_t value)
+    {
+        put(&value, 1);
+    }
+    void put16(uint16_t value)
+    {
+        uint8_t le[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+        put(le, 2);
+    }
+    void putText(const char* text, size_t maxLen)
+    {
+        uint8_t n = (uint8_t)std::min({strlen(text), maxLen, room() > 0 ? room() - 1 : 0, (size_t)255});
+        put8(n);
+        put(text, n);
+    }
+};
+
+static void put_status(Reply_t* reply)
+{
+    auto metadata = GetHAL()->getRadioMetadata();
+    reply->put8(GetHAL()->getRadioState());
+    reply->put8(GetHAL()->getSpeakerVolume());
+    reply->put8(std::clamp(metadata.bufferPercent, 0, 100));
+    reply->put16(std::max(metadata.bitrate, 0));
+    reply->putText(metadata.station, 64);
+    reply->putText(metadata.title, reply->room());
+}
+
+static void put_metrics(Reply_t* reply, uint16_t offset)
 {
-    if (uart_write_bytes((uart_port_t)port, str, length) != length) {
-        ESP_LOGE(TAG, "Send data critical failure.");
-        // add your code to handle sending failure here
-        abort();
+    static std::string text;  // The link task's only
+    if (offset == 0) {
+        text.clear();
+        metrics::render(&text);
+    }
+    uint16_t total = std::min(text.size(), (size_t)UINT16_MAX);
+    reply->put16(total);
+    if (offset < total) {
+        reply->put(text.data() + offset, total - offset);
     }
 }
 
-static void _rs485_test_task(void* param)
+// Whether the remote command was queued for the UI
+static bool post_remote(uint8_t command, const uint8_t* body, size_t len)
 {
-    // Allocate buffers for UART
-    uint8_t* data  = (uint8_t*)malloc(TAB5_RS485_BUF_SIZE);
-    uint8_t* wdata = (uint8_t*)malloc(TAB5_RS485_BUF_SIZE);
+    switch (command) {
+        case RS485_PLAY:
+            hal_post_event(hal::HalBase::EVENT_REMOTE, hal::HalBase::REMOTE_PLAY);
+            return true;
+        case RS485_STOP:
+            hal_post_event(hal::HalBase::EVENT_REMOTE, hal::HalBase::REMOTE_STOP);
+            return true;
+        case RS485_NEXT:
+            hal_post_event(hal::HalBase::EVENT_REMOTE, hal::HalBase::REMOTE_NEXT_STATION);
+            return true;
+        case RS485_PREVIOUS:
+            hal_post_event(hal::HalBase::EVENT_REMOTE, hal::HalBase::REMOTE_PREVIOUS_STATION);
+            return true;
+        case RS485_STATION:
+            if (len < 2) {
+                return false;
+            }
+            hal_post_event(hal::HalBase::EVENT_REMOTE,
+                           hal::HalBase::REMOTE_STATION | (body[0] | body[1] << 8) << 8);
+            return true;
+        case RS485_VOLUME:
+            if (len < 1 || body[0] > 100) {
+                return false;
+            }
+            hal_post_event(hal::HalBase::EVENT_REMOTE, hal::HalBase::REMOTE_VOLUME | body[0] << 8);
+            return true;
+        default:
+            return false;
+    }
+}
 
-    int count               = 0;
-    uint64_t last_send_time = 0;
-    while (1) {
-        // Read data from UART
-        memset(data, 0, TAB5_RS485_BUF_SIZE);
-        int len = uart_read_bytes(tab5_rs485_uart_num, data, TAB5_RS485_BUF_SIZE, TAB5_RS485_PACKET_READ_TICS);
+static void handle_packet(const uint8_t* packet, size_t len)
+{
+    if (len < RS485_HEADER || (packet[0] != RS485_ADDRESS && packet[0] != RS485_BROADCAST)) {
+        return;  // Someone else's
+    }
+    s_metric_frames.inc();
+    uint8_t command     = packet[1];
+    const uint8_t* body = packet + RS485_HEADER;
+    size_t bodyLen      = len - RS485_HEADER;
 
-        // Write data back to UART
-        if (len > 0) {
-            // printf("Received [%u] : %s\n", len, data);
-            // tab5_rs485_echo_send(tab5_rs485_uart_num, data, len);
+    Reply_t reply;
+    reply.put8(RS485_ADDRESS);
+    reply.put8(command | RS485_REPLY);
+    reply.put8(packet[2]);
+    bool known = true;
+    switch (command) {
+        case RS485_PING:
+            break;
+        case RS485_STATUS:
+            put_status(&reply);
+            break;
+        case RS485_METRICS:
+            put_metrics(&reply, bodyLen >= 2 ? body[0] | body[1] << 8 : 0);
+            break;
+        default:
+            known = post_remote(command, body, bodyLen);
+            break;
+    }
+    if (!known) {
+        reply.packet[1] = RS485_UNKNOWN | RS485_REPLY;
+        reply.len       = RS485_HEADER;
+        reply.put8(command);
+    }
+    if (packet[0] == RS485_BROADCAST) {
+        return;
+    }
 
-            std::lock_guard<std::mutex> lock(GetHAL()->uartMonitorData.mutex);
-            for (int i = 0; i < len; i++) {
-                GetHAL()->uartMonitorData.rxQueue.push(data[i]);
+    uint8_t wire[frame_link::MAX_WIRE];
+    size_t n = frame_link::encode(reply.packet, reply.len, wire);
+    uart_write_bytes(tab5_rs485_uart_num, wire, n);
+}
+
+static void rs485_task(void* param)
+{
+    static frame_link::Decoder decoder;
+    static uint8_t chunk[RS485_RX_CHUNK];
+    while (1) {
+        // Woken by the driver per FIFO's worth or a pause on the line, and every TX poll for the monitor
+        uart_event_t event = {};
+        xQueueReceive(s_uart_queue, &event, pdMS_TO_TICKS(TAB5_RS485_TX_POLL_MS));
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+            s_metric_overruns.inc();
+            uart_flush_input(tab5_rs485_uart_num);
+            xQueueReset(s_uart_queue);
+            decoder.push(0);  // What was half in is lost, the frame goes as an error
+            continue;
+        }
+
+        // Received: a chunk at a time through the decoder, and on to the monitor, which drops once 4 KB behind
+        auto& monitor   = GetHAL()->uartMonitorData;
+        size_t buffered = 0;
+        uart_get_buffered_data_len(tab5_rs485_uart_num, &buffered);
+        while (buffered > 0) {
+            int len = uart_read_bytes(tab5_rs485_uart_num, chunk, std::min(sizeof(chunk), buffered), 0);
+            if (len <= 0) {
+                break;
             }
-            while (GetHAL()->uartMonitorData.rxQueue.size() > 4096) {
-                GetHAL()->uartMonitorData.rxQueue.pop();
+            for (int i = 0; i < len; i++) {
+                frame_link::Decoder::Result_t result = decoder.push(chunk[i]);
+                if (result == frame_link::Decoder::FRAME) {
+                    handle_packet(decoder.payload(), decoder.payloadSize());
+                } else if (result == frame_link::Decoder::ERROR) {
+                    s_metric_errors.inc();
+                }
             }
+            monitor.rx.write(chunk, len);
+            buffered -= len;
         }
 
-        {
-            std::lock_guard<std::mutex> lock(GetHAL()->uartMonitorData.mutex);
-            while (!GetHAL()->uartMonitorData.txQueue.empty()) {
-                uint8_t txData = GetHAL()->uartMonitorData.txQueue.front();
-                GetHAL()->uartMonitorData.txQueue.pop();
-                uart_write_bytes(tab5_rs485_uart_num, &txData, 1);
+        // To send: copied into the driver's TX buffer, its interrupt feeds the FIFO from there
+        const uint8_t* span;
+        size_t pending;
+        while ((pending = monitor.tx.peekRead(&span)) > 0) {
+            int len = uart_write_bytes(tab5_rs485_uart_num, span, pending);
+            if (len <= 0) {
+                break;
             }
+            monitor.tx.commitRead(len);
         }
-
-        vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 }
 
@@ -78,7 +258,7 @@ void HalEsp32::rs485_init()
     mclog::tagInfo(TAG, "rs485 init");
 
     uart_config_t uart_config;
-    uart_config.baud_rate           = 115200;
+    uart_config.baud_rate           = CONFIG_TAB5_RS485_BAUD;
     uart_config.data_bits           = UART_DATA_8_BITS;
     uart_config.parity              = UART_PARITY_DISABLE;
     uart_config.stop_bits           = UART_STOP_BITS_1;
@@ -86,9 +266,9 @@ void HalEsp32::rs485_init()
     uart_config.rx_flow_ctrl_thresh = 122;
     uart_config.source_clk          = UART_SCLK_DEFAULT;
 
-    // Install UART driver (we don't need an event queue here)
-    // In this example we don't even use a buffer for sending data.
-    ESP_ERROR_CHECK(uart_driver_install(tab5_rs485_uart_num, TAB5_RS485_BUF_SIZE * 2, 0, 0, NULL, 0));
+    // Buffered both ways, the interrupt moves the bytes between FIFO and buffers while the task only handles blocks
+    ESP_ERROR_CHECK(uart_driver_install(tab5_rs485_uart_num, TAB5_RS485_BUF_SIZE, TAB5_RS485_BUF_SIZE,
+                                        TAB5_RS485_QUEUE_SIZE, &s_uart_queue, 0));
 
     // Configure UART parameters
     ESP_ERROR_CHECK(uart_param_config(tab5_rs485_uart_num, &uart_config));
@@ -102,8 +282,13 @@ void HalEsp32::rs485_init()
     // Set RS485 half duplex mode
     ESP_ERROR_CHECK(uart_set_mode(tab5_rs485_uart_num, UART_MODE_RS485_HALF_DUPLEX));
 
-    // Set read timeout of UART TOUT feature
+    // Set read timeout of UART TOUT feature, and how full the FIFO gets before it interrupts anyway
     ESP_ERROR_CHECK(uart_set_rx_timeout(tab5_rs485_uart_num, TAB5_RS485_READ_TOUT));
+    ESP_ERROR_CHECK(uart_set_rx_full_threshold(tab5_rs485_uart_num, TAB5_RS485_RX_FULL));
 
-    xTaskCreate(_rs485_test_task, "rs485", 2000, NULL, 5, NULL);
+    if (task_topology::create(task_topology::RS485, rs485_task, nullptr, nullptr) != pdPASS) {
+        mclog::tagError(TAG, "No RS485 task, the link stays deaf");
+        return;
+    }
+    mclog::tagInfo(TAG, "RS485 link at {} baud, address {}", CONFIG_TAB5_RS485_BAUD, RS485_ADDRESS);
 }
@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string.h>
+#include <dirent.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <bsp/m5stack_tab5.h>
+#include <esp_log.h>
+#include <sdkconfig.h>
+
+static const char* TAG = "sdcard";
+
+/* -------------------------------------------------------------------------- */
+/*                                   SD Card                                  */
+/* -------------------------------------------------------------------------- */
+// Mounted once by a watcher task and left mounted. The slot has no card detect line: a mounted card is asked for its
+// status every second, an empty slot is tried again with a backoff. Whoever has files open holds the card, and a
+// card pulled meanwhile is only unmounted once the last of them lets go
+#define SDCARD_MAX_FILES    25
+#define SDCARD_POLL_MS      1000
+#define SDCARD_RETRY_MIN_MS 2000
+#define SDCARD_RETRY_MAX_MS 30000
+
+// What an empty slot logs on every try, quiet after the first
+static const char* const SDCARD_PROBE_TAGS[] = {"sdmmc_common", "sdmmc_init", "sdmmc_req", "vfs_fat_sdmmc",
+                                               "M5STACK_TAB5"};
+
+static struct {
+    std::mutex mutex;  // Everything below
+    bool mounted = false;
+    bool gone    = false;  // Pulled while held, unmounted with the last release
+    int users    = 0;
+    std::map<int, DIR*> dirs;  // Open listings, each holds the card
+    int nextDir = 0;
+} s_sd;
+
+static void sdcard_unmount_locked()
+{
+    bsp_sdcard_deinit((char*)SDCARD_MOUNT_POINT);
+    s_sd.mounted = false;
+    s_sd.gone    = false;
+    mclog::tagInfo(TAG, "Card removed");
+    media_index_removed();
+    hal_post_event(hal::HalBase::EVENT_SD_CARD, 0);
+}
+
+bool sdcard_acquire()
+{
+    std::lock_guard<std::mutex> lock(s_sd.mutex);
+    if (!s_sd.mounted || s_sd.gone) {
+        return false;
+    }
+    s_sd.users++;
+    return true;
+}
+
+void sdcard_release()
+{
+    std::lock_guard<std::mutex> lock(s_sd.mutex);
+    if (s_sd.users > 0 && --s_sd.users == 0 && s_sd.gone) {
+        sdcard_unmount_locked();
+    }
+}
+
+static void probe_logs(esp_log_level_t level)
+{
+    for (const char* tag : SDCARD_PROBE_TAGS) {
+        esp_log_level_set(tag, level);
+    }
+}
+
+// Only this task mounts, and only it looks at the card while nobody has given it up for gone
+static void sd_watch_task(void* param)
+{
+    uint32_t retryMs = SDCARD_RETRY_MIN_MS;
+    bool probed      = false;
+    while (true) {
+        bool mounted;
+        bool gone;
+        {
+            std::lock_guard<std::mutex> lock(s_sd.mutex);
+            mounted = s_sd.mounted;
+            gone    = s_sd.gone;
+        }
+
+        if (mounted) {
+            if (!gone && !bsp_sdcard_present()) {
+                std::lock_guard<std::mutex> lock(s_sd.mutex);
+                if (s_sd.users == 0) {
+                    sdcard_unmount_locked();
+                } else {
+                    s_sd.gone = true;
+                    mclog::tagWarn(TAG, "Card removed with {} users, unmounted once they let go", s_sd.users);
+                }
+            }
+            vTaskDelay(pdMS_TO_TICKS(SDCARD_POLL_MS));
+            continue;
+        }
+
+        if (probed) {
+            probe_logs(ESP_LOG_NONE);
+        }
+        esp_err_t err = bsp_sdcard_init((char*)SDCARD_MOUNT_POINT, SDCARD_MAX_FILES);
+        if (probed) {
+            probe_logs((esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL);
+        }
+        probed = true;
+        if (err == ESP_OK) {
+            {
+                std::lock_guard<std::mutex> lock(s_sd.mutex);
+                s_sd.mounted = true;
+            }
+            mclog::tagInfo(TAG, "Card mounted at {}", SDCARD_MOUNT_POINT);
+            hal_post_event(hal::HalBase::EVENT_SD_CARD, 1);
+            media_index_mounted();
+            retryMs = SDCARD_RETRY_MIN_MS;
+            probed  = false;
+            continue;
+        }
+        vTaskDelay(pdMS_TO_TICKS(retryMs));
+        retryMs = std::min(retryMs * 2, (uint32_t)SDCARD_RETRY_MAX_MS);
+    }
+}
+
+void sdcard_start()
+{
+    task_topology::create(task_topology::SD_WATCH, sd_watch_task, nullptr, nullptr);
+}
+
+bool HalEsp32::isSdCardMounted()
+{
+    std::lock_guard<std::mutex> lock(s_sd.mutex);
+    return s_sd.mounted && !s_sd.gone;
+}
+
+int HalEsp32::openSdCardDir(const std::string& dirPath)
+{
+    if (!sdcard_acquire()) {
+        return -1;
+    }
+    size_t start     = dirPath.find_first_not_of('/');
+    std::string path = std::string(SDCARD_MOUNT_POINT) + "/";
+    if (start != std::string::npos) {
+        path += dirPath.substr(start);
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        mclog::tagWarn(TAG, "Can't open {}", path);
+        sdcard_release();
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(s_sd.mutex);
+    int cursor = s_sd.nextDir++;
+    s_sd.dirs[cursor] = dir;
+    return cursor;
+}
+
+std::vector<hal::HalBase::FileEntry_t> HalEsp32::readSdCardDir(int cursor, int maxEntries)
+{
+    std::vector<FileEntry_t> page;
+    DIR* dir = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_sd.mutex);
+        auto it = s_sd.dirs.find(cursor);
+        if (it != s_sd.dirs.end()) {
+            dir = it->second;
+        }
+    }
+    if (!dir) {
+        return page;
+    }
+
+    // The card is only read here, one cursor belongs to one task at a time
+    page.reserve(maxEntries);
+    struct dirent* entry;
+    while ((int)page.size() < maxEntries && (entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        page.push_back({entry->d_name, entry->d_type == DT_DIR});
+    }
+    return page;
+}
+
+void HalEsp32::closeSdCardDir(int cursor)
+{
+    DIR* dir = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_sd.mutex);
+        auto it = s_sd.dirs.find(cursor);
+        if (it == s_sd.dirs.end()) {
+            return;
+        }
+        dir = it->second;
+        s_sd.dirs.erase(it);
+    }
+    closedir(dir);
+    sdcard_release();
+}
@@ -0,0 +1,566 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <hal/metrics.h>
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+static const char* TAG = "sync";
+
+/* -------------------------------------------------------------------------- */
+/*                              Multi-room Sync                               */
+/* -------------------------------------------------------------------------- */
+// A unit playing a station from upstream is its master: it beacons the station's URL hash on the LAN once a second
+// and answers time requests. A unit starting the same station while a master beacons it streams it from the
+// master's relay instead (hal_radio_stream.cpp), the same bytes, so both decode the same frames. Frames are known by
+// their CRC on both ends, and each side notes when it hears the first sample of one on its own esp_timer clock.
+// The follower's requests (PTP-lite: t1 sent, t2 received and t3 sent by the master, t4 back) give the clocks'
+// offset from the fastest round trip of the last few, and the replies carry the master's newest heard frames. The
+// skew between two hearings of a frame is low-passed, and a PI loop slews the follower's output resampler by up to
+// 0.1% to take it to zero. Only a skew past SYNC_STEP_US, like the seconds at the start, is jumped: the output
+// writes silence when early, and drops frames when late.
+#define SYNC_PORT           8001        // UDP, next to the relay's 8000
+#define SYNC_RELAY_PORT     8000
+#define SYNC_MAGIC          0x59533554  // "T5SY"
+#define SYNC_VERSION        1
+#define SYNC_BEACON_MS      1000
+#define SYNC_REQUEST_MS     500
+#define SYNC_POLL_MS        100         // Socket timeout, the beacon and request timers are checked this often
+#define SYNC_MASTER_LOST_MS 3000        // Beacons missed before a master is forgotten
+#define SYNC_FAILED_MS      30000       // A master whose relay didn't stream is passed over this long
+#define SYNC_MAX_MASTERS    4
+#define SYNC_OFFSETS        8           // Exchanges the offset is picked from
+#define SYNC_MAX_RTT_US     50000       // Slower exchanges are no use for the offset
+#define SYNC_ANCHORS        4           // Master's heard frames per reply
+#define SYNC_HISTORY        512         // Frames heard here, ~13 s of MP3
+#define SYNC_PENDING        64          // Master's frames not heard here yet
+#define SYNC_PENDING_US     20000000
+#define SYNC_STEP_US        30000       // Skew past this is jumped rather than slewed
+#define SYNC_SETTLE_US      1500000     // After a jump, what was queued still plays at the old time
+#define SYNC_MIN_SAMPLES    3           // Skews measured before the filter is trusted
+#define SYNC_FILTER         0.1f        // Low-pass weight of a new skew
+#define SYNC_GAIN_PPM       40.0f       // Per ms of skew
+#define SYNC_INTEGRAL_S     60.0f
+#define SYNC_MAX_PPM        1000.0f     // Resampler::MAX_TRIM_PPM
+
+enum : uint8_t {
+    SYNC_BEACON       = 1,  // Master, broadcast
+    SYNC_TIME_REQUEST = 2,  // Follower to master
+    SYNC_TIME_REPLY   = 3,
+};
+
+struct __attribute__((packed)) SyncHeader_t {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t node;  // The sender's, random at boot
+};
+
+struct __attribute__((packed)) SyncBeacon_t {
+    SyncHeader_t header;
+    uint32_t urlHash;
+};
+
+struct __attribute__((packed)) SyncTimeRequest_t {
+    SyncHeader_t header;
+    int64_t t1;
+};
+
+struct __attribute__((packed)) SyncAnchor_t {
+    uint32_t index;  // In the master's history, newer ones are higher
+    uint32_t tag;
+    int64_t heardUs;
+};
+
+struct __attribute__((packed)) SyncTimeReply_t {
+    SyncHeader_t header;
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+    uint8_t anchors;
+    SyncAnchor_t anchor[SYNC_ANCHORS];
+};
+
+struct SyncMaster_t {
+    uint32_t addr    = 0;  // Network order, 0 for a free slot
+    uint32_t urlHash = 0;
+    int64_t beaconAt = 0;
+    int64_t failedAt = 0;
+};
+
+struct SyncFrame_t {
+    uint32_t tag;
+    int64_t us;  // When its first sample is heard, on the clock of whoever heard it
+};
+
+struct SyncPending_t {
+    uint32_t tag;
+    int64_t masterUs;
+    int64_t receivedAt;  // Ours, to let it go once it's too old to be heard here
+};
+
+struct SyncOffset_t {
+    int64_t offset;  // Master's clock minus ours
+    int64_t rtt;
+};
+
+static metrics::Gauge s_metric_skew("radio_sync_skew_ms", "Filtered playback skew to the sync master, late positive");
+static metrics::Counter s_metric_steps("radio_sync_steps_total", "Times the output jumped to the sync master");
+
+static struct {
+    std::mutex mutex;  // All but the atomics, the output task hands frames in under it
+    int sock      = -1;
+    uint32_t node = 0;
+    SyncMaster_t masters[SYNC_MAX_MASTERS];
+
+    // Frames heard here, a master's anchors come from it
+    SyncFrame_t* history = nullptr;
+    uint32_t heard       = 0;  // Frames ever heard, the newest is at heard - 1
+    uint32_t lastTag     = 0;
+
+    // Following
+    uint64_t owner  = 0;  // The connection following, 0 if none
+    uint32_t master = 0;
+    uint16_t seq    = 0;
+    int64_t sentAt  = 0;  // t1 of the request in flight
+    SyncOffset_t offsets[SYNC_OFFSETS];
+    int offsetCount      = 0;
+    uint32_t anchorIndex = 0;  // Newest of the master's anchors taken
+    bool anchorSeen      = false;
+    SyncPending_t pending[SYNC_PENDING];
+    int pendingCount   = 0;
+    float skewUs       = 0;
+    int samples        = 0;
+    float integral     = 0;  // ppm
+    int64_t measuredAt = 0;
+    int64_t steppedAt  = 0;
+
+    std::atomic<bool> following{false};
+    std::atomic<int> ppm{0};
+    std::atomic<int64_t> stepUs{0};
+} s_sync;
+
+uint32_t sync_url_hash(const std::string& url)
+{
+    return esp_rom_crc32_le(0, (const uint8_t*)url.data(), url.size());
+}
+
+static void fill_header(SyncHeader_t* header, uint8_t type, uint16_t seq)
+{
+    header->magic   = SYNC_MAGIC;
+    header->version = SYNC_VERSION;
+    header->type    = type;
+    header->seq     = seq;
+    header->node    = s_sync.node;
+}
+
+// With the mutex held
+static void stop_following()
+{
+    if (s_sync.owner != 0) {
+        mclog::tagInfo(TAG, "No longer following");
+    }
+    s_sync.owner  = 0;
+    s_sync.master = 0;
+    s_sync.following.store(false);
+    s_sync.ppm.store(0);
+    s_sync.stepUs.store(0);
+    s_metric_skew.set(0);
+}
+
+// With the mutex held. A new master, or the same one for a new stream: nothing measured so far holds
+static void reset_follower()
+{
+    s_sync.offsetCount  = 0;
+    s_sync.anchorSeen   = false;
+    s_sync.pendingCount = 0;
+    s_sync.skewUs       = 0;
+    s_sync.samples      = 0;
+    s_sync.integral     = 0;
+    s_sync.measuredAt   = 0;
+    s_sync.steppedAt    = 0;
+    s_sync.ppm.store(0);
+    s_sync.stepUs.store(0);
+}
+
+// With the mutex held, false until an exchange has come back fast enough
+static bool clock_offset(int64_t* offset)
+{
+    if (s_sync.offsetCount == 0) {
+        return false;
+    }
+    int count                = std::min(s_sync.offsetCount, SYNC_OFFSETS);
+    const SyncOffset_t* best = &s_sync.offsets[0];
+    for (int i = 1; i < count; i++) {
+        if (s_sync.offsets[i].rtt < best->rtt) {
+            best = &s_sync.offsets[i];
+        }
+    }
+    *offset = best->offset;
+    return true;
+}
+
+/**
+ * @brief The same frame was heard at `localUs` here and `masterUs` there, with the mutex held
+ */
+static void measure(int64_t localUs, int64_t masterUs)
+{
+    int64_t offset = 0;
+    int64_t now    = esp_timer_get_time();
+    if (!clock_offset(&offset) || now - s_sync.steppedAt < SYNC_SETTLE_US) {
+        return;
+    }
+    float skew     = (float)(localUs - (masterUs - offset));
+    s_sync.skewUs  = s_sync.samples == 0 ? skew : s_sync.skewUs + (skew - s_sync.skewUs) * SYNC_FILTER;
+    s_sync.samples = s_sync.samples + 1;
+    s_metric_skew.set(s_sync.skewUs / 1000);
+    if (s_sync.samples < SYNC_MIN_SAMPLES) {
+        return;
+    }
+
+    if (fabsf(s_sync.skewUs) > SYNC_STEP_US) {
+        mclog::tagInfo(TAG, "{:.1f} ms {}, jumping", fabsf(s_sync.skewUs) / 1000,
+                       s_sync.skewUs > 0 ? "late" : "early");
+        s_sync.stepUs.store((int64_t)s_sync.skewUs);
+        s_sync.steppedAt  = now;
+        s_sync.samples    = 0;
+        s_sync.measuredAt = 0;
+        s_metric_steps.inc();
+        return;
+    }
+
+    // Late means playing faster. The integral is the clocks' rate difference, it doesn't move while clamped
+    float elapsed     = s_sync.measuredAt ? (now - s_sync.measuredAt) / 1e6f : 0;
+    s_sync.measuredAt = now;
+    float error       = s_sync.skewUs / 1000;
+    float integral    = s_sync.integral + SYNC_GAIN_PPM * error * elapsed / SYNC_INTEGRAL_S;
+    float output      = SYNC_GAIN_PPM * error + integral;
+    if (fabsf(output) < SYNC_MAX_PPM) {
+        s_sync.integral = integral;
+    }
+    s_sync.ppm.store((int)lroundf(std::min(std::max(output, -SYNC_MAX_PPM), SYNC_MAX_PPM)));
+}
+
+/**
+ * @brief Where `tag` is in the history: the index of its one hearing, -1 if none or more than one
+ */
+static int history_find(uint32_t tag)
+{
+    int found  = -1;
+    int frames = (int)std::min<uint32_t>(s_sync.heard, SYNC_HISTORY);
+    for (int i = 0; i < frames; i++) {
+        if (s_sync.history[i].tag == tag) {
+            if (found >= 0) {
+                return -1;  // Repeated content, silence, no telling which
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+void sync_frame_heard(uint32_t tag, int64_t heardUs)
+{
+    std::lock_guard<std::mutex> lock(s_sync.mutex);
+    if (!s_sync.history) {
+        return;
+    }
+    bool repeated  = tag == s_sync.lastTag;
+    s_sync.lastTag = tag;
+    s_sync.history[s_sync.heard % SYNC_HISTORY] = {tag, heardUs};
+    s_sync.heard++;
+    if (!s_sync.following.load() || repeated) {
+        return;
+    }
+    for (int i = 0; i < s_sync.pendingCount; i++) {
+        if (s_sync.pending[i].tag == tag) {
+            measure(heardUs, s_sync.pending[i].masterUs);
+            s_sync.pending[i] = s_sync.pending[--s_sync.pendingCount];
+            return;
+        }
+    }
+}
+
+static void handle_reply(const SyncTimeReply_t* reply, int64_t t4)
+{
+    if (reply->header.seq != s_sync.seq || reply->t1 != s_sync.sentAt) {
+        return;  // Late, or not ours
+    }
+    int64_t rtt = (t4 - reply->t1) - (reply->t3 - reply->t2);
+    if (rtt >= 0 && rtt <= SYNC_MAX_RTT_US) {
+        s_sync.offsets[s_sync.offsetCount % SYNC_OFFSETS] = {((reply->t2 - reply->t1) + (reply->t3 - t4)) / 2, rtt};
+        s_sync.offsetCount++;
+    }
+
+    for (int i = 0; i < s_sync.pendingCount;) {
+        if (t4 - s_sync.pending[i].receivedAt > SYNC_PENDING_US) {
+            s_sync.pending[i] = s_sync.pending[--s_sync.pendingCount];
+        } else {
+            i++;
+        }
+    }
+
+    // Oldest first, each only once: heard here already, or kept until it is
+    int anchors = std::min<int>(reply->anchors, SYNC_ANCHORS);
+    for (int i = anchors - 1; i >= 0; i--) {
+        const SyncAnchor_t& anchor = reply->anchor[i];
+        if (s_sync.anchorSeen && (int32_t)(anchor.index - s_sync.anchorIndex) <= 0) {
+            continue;
+        }
+        s_sync.anchorIndex = anchor.index;
+        s_sync.anchorSeen  = true;
+        int found          = history_find(anchor.tag);
+        if (found >= 0) {
+            measure(s_sync.history[found].us, anchor.heardUs);
+        } else if (s_sync.pendingCount < SYNC_PENDING) {
+            s_sync.pending[s_sync.pendingCount++] = {anchor.tag, anchor.heardUs, t4};
+        }
+    }
+}
+
+// Answered straight from the receive, t2 and t3 as close to the wire as this task gets
+static void handle_request(const SyncTimeRequest_t* request, const sockaddr_in& from, int64_t t2)
+{
+    uint32_t urlHash = 0;
+    if (!radio_sync_source(&urlHash)) {
+        return;
+    }
+    SyncTimeReply_t reply = {};
+    fill_header(&reply.header, SYNC_TIME_REPLY, request->header.seq);
+    reply.t1 = request->t1;
+    reply.t2 = t2;
+    {
+        std::lock_guard<std::mutex> lock(s_sync.mutex);
+        int anchors = (int)std::min<uint32_t>(s_sync.heard, SYNC_ANCHORS);
+        for (int i = 0; i < anchors; i++) {
+            uint32_t index           = s_sync.heard - 1 - i;
+            const SyncFrame_t& frame = s_sync.history[index % SYNC_HISTORY];
+            reply.anchor[i]          = {index, frame.tag, frame.us};
+        }
+        reply.anchors = anchors;
+    }
+    reply.t3 = esp_timer_get_time();
+    sendto(s_sync.sock, &reply, sizeof(reply), 0, (const sockaddr*)&from, sizeof(from));
+}
+
+static void handle_beacon(const SyncBeacon_t* beacon, const sockaddr_in& from, int64_t now)
+{
+    SyncMaster_t* slot = nullptr;
+    for (SyncMaster_t& master : s_sync.masters) {
+        if (master.addr == from.sin_addr.s_addr) {
+            slot = &master;
+            break;
+        }
+        if (!slot && (master.addr == 0 || now - master.beaconAt > SYNC_MASTER_LOST_MS * 1000LL)) {
+            slot = &master;  // Free or forgotten, unless this one turns up further on
+        }
+    }
+    if (!slot) {
+        return;
+    }
+    if (slot->addr != from.sin_addr.s_addr) {
+        *slot = {};
+    }
+    slot->addr     = from.sin_addr.s_addr;
+    slot->urlHash  = beacon->urlHash;
+    slot->beaconAt = now;
+}
+
+static void handle_packet(const uint8_t* packet, int len, const sockaddr_in& from, int64_t now)
+{
+    const SyncHeader_t* header = (const SyncHeader_t*)packet;
+    if (header->magic != SYNC_MAGIC || header->version != SYNC_VERSION || header->node == s_sync.node) {
+        return;
+    }
+    if (header->type == SYNC_TIME_REQUEST && len >= (int)sizeof(SyncTimeRequest_t)) {
+        handle_request((const SyncTimeRequest_t*)packet, from, now);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(s_sync.mutex);
+    if (header->type == SYNC_BEACON && len >= (int)sizeof(SyncBeacon_t)) {
+        handle_beacon((const SyncBeacon_t*)packet, from, now);
+    } else if (header->type == SYNC_TIME_REPLY && len >= (int)sizeof(SyncTimeReply_t) &&
+               s_sync.following.load() && from.sin_addr.s_addr == s_sync.master) {
+        handle_reply((const SyncTimeReply_t*)packet, now);
+    }
+}
+
+static void send_beacon(uint32_t urlHash)
+{
+    SyncBeacon_t beacon = {};
+    fill_header(&beacon.header, SYNC_BEACON, 0);
+    beacon.urlHash     = urlHash;
+    sockaddr_in to     = {};
+    to.sin_family      = AF_INET;
+    to.sin_port        = htons(SYNC_PORT);
+    to.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    sendto(s_sync.sock, &beacon, sizeof(beacon), 0, (const sockaddr*)&to, sizeof(to));
+}
+
+static void send_request()
+{
+    SyncTimeRequest_t request = {};
+    sockaddr_in to            = {};
+    {
+        std::lock_guard<std::mutex> lock(s_sync.mutex);
+        if (!s_sync.following.load()) {
+            return;
+        }
+        fill_header(&request.header, SYNC_TIME_REQUEST, ++s_sync.seq);
+        to.sin_addr.s_addr = s_sync.master;
+        request.t1         = esp_timer_get_time();
+        s_sync.sentAt      = request.t1;
+    }
+    to.sin_family = AF_INET;
+    to.sin_port   = htons(SYNC_PORT);
+    sendto(s_sync.sock, &request, sizeof(request), 0, (const sockaddr*)&to, sizeof(to));
+}
+
+static void sync_task(void* param)
+{
+    uint8_t packet[sizeof(SyncTimeReply_t)];
+    int64_t beaconAt  = 0;
+    int64_t requestAt = 0;
+    while (true) {
+        sockaddr_in from  = {};
+        socklen_t fromLen = sizeof(from);
+        int len           = recvfrom(s_sync.sock, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLen);
+        int64_t now       = esp_timer_get_time();
+        if (len >= (int)sizeof(SyncHeader_t)) {
+            handle_packet(packet, len, from, now);
+        }
+
+        now              = esp_timer_get_time();
+        uint32_t urlHash = 0;
+        if (now - beaconAt >= SYNC_BEACON_MS * 1000LL) {
+            beaconAt = now;
+            if (radio_sync_source(&urlHash)) {
+                send_beacon(urlHash);
+            }
+        }
+        if (now - requestAt >= SYNC_REQUEST_MS * 1000LL) {
+            requestAt = now;
+            send_request();
+        }
+    }
+}
+
+void sync_start()
+{
+    if (s_sync.sock >= 0) {
+        return;
+    }
+    s_sync.history = (SyncFrame_t*)heap_caps_calloc(SYNC_HISTORY, sizeof(SyncFrame_t), MALLOC_CAP_SPIRAM);
+    s_sync.node    = esp_random();
+    int sock       = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (!s_sync.history || sock < 0) {
+        mclog::tagError(TAG, "No sync socket, playing on our own");
+        if (sock >= 0) {
+            close(sock);
+        }
+        return;
+    }
+    int on               = 1;
+    timeval timeout      = {0, SYNC_POLL_MS * 1000};
+    sockaddr_in addr     = {};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(SYNC_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (bind(sock, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        mclog::tagError(TAG, "Can't bind UDP port {}", SYNC_PORT);
+        close(sock);
+        return;
+    }
+    s_sync.sock = sock;
+    if (task_topology::create(task_topology::SYNC, sync_task, nullptr, nullptr) != pdPASS) {
+        mclog::tagError(TAG, "No sync task");
+        return;
+    }
+    mclog::tagInfo(TAG, "Multi-room sync on UDP port {}", SYNC_PORT);
+}
+
+bool sync_follow(const std::string& url, uint64_t owner, std::string* relayUrl)
+{
+    std::lock_guard<std::mutex> lock(s_sync.mutex);
+    uint32_t urlHash           = sync_url_hash(url);
+    int64_t now                = esp_timer_get_time();
+    const SyncMaster_t* master = nullptr;
+    for (const SyncMaster_t& candidate : s_sync.masters) {
+        bool live   = candidate.addr != 0 && now - candidate.beaconAt <= SYNC_MASTER_LOST_MS * 1000LL;
+        bool failed = candidate.failedAt != 0 && now - candidate.failedAt <= SYNC_FAILED_MS * 1000LL;
+        if (live && !failed && candidate.urlHash == urlHash && (!master || candidate.beaconAt > master->beaconAt)) {
+            master = &candidate;
+        }
+    }
+    if (!master) {
+        if (s_sync.owner == owner) {
+            stop_following();
+        }
+        return false;
+    }
+
+    if (s_sync.owner != owner || s_sync.master != master->addr) {
+        reset_follower();
+    }
+    s_sync.owner  = owner;
+    s_sync.master = master->addr;
+    s_sync.following.store(true);
+
+    in_addr addr = {};
+    addr.s_addr  = master->addr;
+    char ip[16];
+    inet_ntoa_r(addr, ip, sizeof(ip));
+    char buf[64];
+    snprintf(buf, sizeof(buf), "http://%s:%d/stream?sync=%08lx", ip, SYNC_RELAY_PORT, (unsigned long)urlHash);
+    *relayUrl = buf;
+    mclog::tagInfo(TAG, "Following {} for this station", ip);
+    return true;
+}
+
+void sync_unfollow(uint64_t owner, bool failed)
+{
+    std::lock_guard<std::mutex> lock(s_sync.mutex);
+    if (owner != s_sync.owner) {
+        return;
+    }
+    if (failed) {
+        for (SyncMaster_t& master : s_sync.masters) {
+            if (master.addr == s_sync.master) {
+                master.failedAt = esp_timer_get_time();
+            }
+        }
+    }
+    stop_following();
+}
+
+bool sync_following(int* ppm)
+{
+    if (!s_sync.following.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    *ppm = s_sync.ppm.load(std::memory_order_relaxed);
+    return true;
+}
+
+int64_t sync_take_step()
+{
+    return s_sync.stepUs.exchange(0);
+}
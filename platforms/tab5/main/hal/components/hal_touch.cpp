@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_lcd_touch.h>
+#include <esp_lvgl_port.h>
+
+extern esp_lcd_touch_handle_t _lcd_touch_handle;
+
+#define TAG "touch"
+
+// Both controllers pulse INT at their report rate while touched. The timeouts only cover a missed edge: a poll while
+// pressed so a release isn't lost, and a slow one otherwise should INT not fire at all
+#define TOUCH_PRESSED_POLL_MS 20
+#define TOUCH_IDLE_POLL_MS    100
+#define TOUCH_QUEUE_SIZE      16  // Power of two
+
+struct TouchSample_t {
+    int16_t x;
+    int16_t y;
+    bool pressed;
+    int64_t atUs;  // When INT fired, or the poll that read it
+};
+
+// Single producer (the touch task), single consumer (the indev read in the LVGL task)
+static TouchSample_t s_queue[TOUCH_QUEUE_SIZE];
+static std::atomic<uint32_t> s_queue_head{0};
+static std::atomic<uint32_t> s_queue_tail{0};
+
+static TaskHandle_t s_touch_task       = nullptr;
+static volatile int64_t s_interrupt_at = 0;
+static uint32_t s_idle_poll_ms         = TOUCH_IDLE_POLL_MS;  // The pressed rate without INT
+
+static bool queue_push(const TouchSample_t& sample)
+{
+    uint32_t head = s_queue_head.load(std::memory_order_relaxed);
+    if (head - s_queue_tail.load(std::memory_order_acquire) >= TOUCH_QUEUE_SIZE) {
+        return false;
+    }
+    s_queue[head % TOUCH_QUEUE_SIZE] = sample;
+    s_queue_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+static bool queue_pop(TouchSample_t* sample)
+{
+    uint32_t tail = s_queue_tail.load(std::memory_order_relaxed);
+    if (tail == s_queue_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *sample = s_queue[tail % TOUCH_QUEUE_SIZE];
+    s_queue_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+static void IRAM_ATTR on_touch_interrupt(esp_lcd_touch_handle_t tp)
+{
+    s_interrupt_at   = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_touch_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void touch_task(void* param)
+{
+    esp_lcd_touch_handle_t tp = static_cast<esp_lcd_touch_handle_t>(param);
+    bool pressed              = false;
+    bool waking               = false;  // The press that resumed the display, LVGL doesn't see it
+
+    while (true) {
+        uint32_t waitMs  = pressed ? TOUCH_PRESSED_POLL_MS : s_idle_poll_ms;
+        bool interrupted = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs)) > 0;
+
+        uint16_t x[1], y[1];
+        uint8_t count = 0;
+        {
+            I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TOUCH);
+            esp_lcd_touch_read_data(tp);
+        }
+        TouchSample_t sample;
+        sample.pressed = esp_lcd_touch_get_coordinates(tp, x, y, nullptr, &count, 1) && count > 0;
+        sample.x       = sample.pressed ? x[0] : 0;
+        sample.y       = sample.pressed ? y[0] : 0;
+        sample.atUs    = interrupted ? s_interrupt_at : esp_timer_get_time();
+        if (!sample.pressed && !pressed) {
+            continue;  // Still nothing
+        }
+        if (waking || GetHAL()->isDisplaySuspended()) {
+            if (sample.pressed && !waking) {
+                GetHAL()->resumeDisplay();
+            }
+            waking  = sample.pressed;
+            pressed = sample.pressed;
+            continue;
+        }
+
+        // A full queue means LVGL is stuck in a long redraw, the sample is read again on the next poll
+        if (!queue_push(sample)) {
+            continue;
+        }
+        pressed = sample.pressed;
+        lvgl_port_task_wake(LVGL_PORT_EVENT_TOUCH, nullptr);
+        app_wake();  // Paced by the display again while the finger is down
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                    Indev                                   */
+/* -------------------------------------------------------------------------- */
+// Last two samples handed to LVGL, for the prediction
+static TouchSample_t s_last   = {};
+static TouchSample_t s_before = {};
+static int16_t s_max_x        = 0;
+static int16_t s_max_y        = 0;
+
+static void predict(lv_indev_data_t* data)
+{
+#if CONFIG_TAB5_TOUCH_PREDICT_MS > 0
+    // Extrapolate a moving finger by its speed over the last two samples, scrolling keeps up with the finger rather
+    // than trailing it by a frame. Only while the samples are fresh, a resting finger stays where it is
+    int64_t span = s_last.atUs - s_before.atUs;
+    if (!s_before.pressed || span <= 0 || span > 50000 || esp_timer_get_time() - s_last.atUs > 50000) {
+        return;
+    }
+    int32_t ahead = CONFIG_TAB5_TOUCH_PREDICT_MS * 1000;
+    data->point.x = std::clamp<int32_t>(s_last.x + (s_last.x - s_before.x) * ahead / span, 0, s_max_x);
+    data->point.y = std::clamp<int32_t>(s_last.y + (s_last.y - s_before.y) * ahead / span, 0, s_max_y);
+#endif
+}
+
+static void touch_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    TouchSample_t sample;
+    if (queue_pop(&sample)) {
+        s_before = s_last;
+        s_last   = sample;
+        perf_touch_sampled(sample.atUs);
+        // A press and its release can both be queued, LVGL gets each of them
+        data->continue_reading = s_queue_tail.load() != s_queue_head.load();
+    }
+
+    data->state   = s_last.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->point.x = s_last.x;
+    data->point.y = s_last.y;
+    if (s_last.pressed) {
+        predict(data);
+    }
+    input_read(input_recording::TOUCH, indev, data);
+}
+
+void touch_start(lv_indev_t* indev)
+{
+    esp_lcd_touch_handle_t tp = _lcd_touch_handle;
+    if (!indev || !tp) {
+        return;
+    }
+    s_max_x = tp->config.x_max - 1;
+    s_max_y = tp->config.y_max - 1;
+
+    bool interrupt = tp->config.int_gpio_num != GPIO_NUM_NC;
+    if (!interrupt) {
+        s_idle_poll_ms = TOUCH_PRESSED_POLL_MS;
+    }
+    task_topology::create(task_topology::TOUCH, touch_task, tp, &s_touch_task);
+
+    // The BSP had LVGL read the controller itself, over I2C on the LVGL task. It reads the queue instead, woken by
+    // each new sample and still on its timer for long presses and scroll throws
+    lv_indev_set_read_cb(indev, touch_read_cb);
+    lv_indev_set_mode(indev, LV_INDEV_MODE_TIMER);
+
+    if (interrupt && esp_lcd_touch_register_interrupt_callback(tp, on_touch_interrupt) != ESP_OK) {
+        interrupt      = false;
+        s_idle_poll_ms = TOUCH_PRESSED_POLL_MS;
+    }
+    if (!interrupt) {
+        mclog::tagWarn(TAG, "no touch interrupt, polling every {} ms", TOUCH_PRESSED_POLL_MS);
+    }
+}
@@ -7,8 +7,9 @@
 #include <mooncake_log.h>
 #include <vector>
 #include <driver/gpio.h>
+#include <algorithm>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <lvgl.h>
 #include <usb/usb_host.h>
 #include <usb/hid_host.h>
@@ -19,8 +20,8 @@
 
 #define TAG "usba"
 
-static std::mutex _usba_detect_mutex;
-static bool _is_usba_connected = false;
+static std::atomic<int> _usba_devices{0};
+static std::atomic<int> _usba_mice{0};
 static lv_obj_t* _cursor_img;
 
 QueueHandle_t app_event_queue = NULL;
@@ -37,64 +38,132 @@ typedef struct {
 
 static const char* hid_proto_name_str[] = {"NONE", "KEYBOARD", "MOUSE"};
 
-typedef struct {
-    enum key_state { KEY_STATE_PRESSED = 0x00, KEY_STATE_RELEASED = 0x01 } state;
-    uint8_t modifier;
-    uint8_t key_code;
-} key_event_t;
+/* -------------------------------------------------------------------------- */
+/*                                   Reports                                  */
+/* -------------------------------------------------------------------------- */
+// The HID host's task only queues what the reports say, the indevs take it from there on the LVGL task. Mouse moves
+// queue as they come and add up per read, up to a button change: a click shorter than a frame still gets through.
+// The keyboard's reports become key presses and releases for a keypad indev of its own
+#define HID_MOUSE_QUEUE_SIZE 64    // Power of two, a 1 kHz mouse fills it in 64 ms
+#define HID_USAGE_ROLLOVER   0x01  // ErrorRollOver, in every slot while too many keys are down
+
+struct MouseReport_t {
+    int8_t dx;
+    int8_t dy;
+    bool left;
+    bool right;
+};
+
+// Single producer (the HID host's task), single consumer (the cursor's indev read)
+static MouseReport_t s_mouse_queue[HID_MOUSE_QUEUE_SIZE];
+static std::atomic<uint32_t> s_mouse_head{0};
+static std::atomic<uint32_t> s_mouse_tail{0};
+static std::atomic<uint32_t> s_mouse_dropped{0};
+
+static KeySource_t* s_usb_keys = nullptr;
 
-#define KEYBOARD_ENTER_MAIN_CHAR '\r'
-#define KEYBOARD_ENTER_LF_EXTEND 1
+static void hid_host_mouse_report_callback(const uint8_t* const data, const int length)
+{
+    if (length < sizeof(hid_mouse_input_report_boot_t)) {
+        return;
+    }
+    auto report         = reinterpret_cast<const hid_mouse_input_report_boot_t*>(data);
+    MouseReport_t mouse = {report->x_displacement, report->y_displacement, (bool)report->buttons.button1,
+                           (bool)report->buttons.button2};
+    uint32_t head       = s_mouse_head.load(std::memory_order_relaxed);
+    if (head - s_mouse_tail.load(std::memory_order_acquire) >= HID_MOUSE_QUEUE_SIZE) {
+        s_mouse_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    s_mouse_queue[head % HID_MOUSE_QUEUE_SIZE] = mouse;
+    s_mouse_head.store(head + 1, std::memory_order_release);
+}
 
-static void hid_print_new_device_report_header(hid_protocol_t proto)
+// HID usage to character, unshifted and shifted, from HID_KEY_A (0x04) to HID_KEY_SLASH (0x38)
+static const char s_usage_chars[][2] = {
+    {'a', 'A'}, {'b', 'B'}, {'c', 'C'}, {'d', 'D'},  {'e', 'E'}, {'f', 'F'}, {'g', 'G'},  {'h', 'H'}, {'i', 'I'},
+    {'j', 'J'}, {'k', 'K'}, {'l', 'L'}, {'m', 'M'},  {'n', 'N'}, {'o', 'O'}, {'p', 'P'},  {'q', 'Q'}, {'r', 'R'},
+    {'s', 'S'}, {'t', 'T'}, {'u', 'U'}, {'v', 'V'},  {'w', 'W'}, {'x', 'X'}, {'y', 'Y'},  {'z', 'Z'}, {'1', '!'},
+    {'2', '@'}, {'3', '#'}, {'4', '$'}, {'5', '%'},  {'6', '^'}, {'7', '&'}, {'8', '*'},  {'9', '('}, {'0', ')'},
+    {0, 0},     {0, 0},     {0, 0},     {0, 0},      {' ', ' '}, {'-', '_'}, {'=', '+'},  {'[', '{'}, {']', '}'},
+    {'\\', '|'}, {0, 0},  {';', ':'}, {'\'', '"'}, {'`', '~'}, {',', '<'}, {'.', '>'},  {'/', '?'},
+};
+
+// 0 for the keys that do nothing by themselves
+static uint32_t usage_to_key(uint8_t usage, bool shifted)
 {
-    static hid_protocol_t prev_proto_output;
-
-    if (prev_proto_output != proto) {
-        prev_proto_output = proto;
-        printf("\r\n");
-        if (proto == HID_PROTOCOL_MOUSE) {
-            printf("Mouse\r\n");
-        } else if (proto == HID_PROTOCOL_KEYBOARD) {
-            printf("Keyboard\r\n");
-        } else {
-            printf("Generic\r\n");
-        }
-        fflush(stdout);
+    switch (usage) {
+        case HID_KEY_ENTER:
+            return LV_KEY_ENTER;
+        case HID_KEY_ESC:
+            return LV_KEY_ESC;
+        case HID_KEY_DEL:
+            return LV_KEY_BACKSPACE;
+        case HID_KEY_TAB:
+            return shifted ? LV_KEY_PREV : LV_KEY_NEXT;
+        case HID_KEY_DELETE:
+            return LV_KEY_DEL;
+        case HID_KEY_HOME:
+            return LV_KEY_HOME;
+        case HID_KEY_END:
+            return LV_KEY_END;
+        case HID_KEY_RIGHT:
+            return LV_KEY_RIGHT;
+        case HID_KEY_LEFT:
+            return LV_KEY_LEFT;
+        case HID_KEY_DOWN:
+            return LV_KEY_DOWN;
+        case HID_KEY_UP:
+            return LV_KEY_UP;
+        default:
+            break;
+    }
+    if (usage < HID_KEY_A || usage > HID_KEY_SLASH) {
+        return 0;
     }
+    return (uint8_t)s_usage_chars[usage - HID_KEY_A][shifted ? 1 : 0];
 }
 
-static void hid_host_mouse_report_callback(const uint8_t* const data, const int length)
+static bool report_holds(const uint8_t* keys, uint8_t usage)
 {
-    hid_mouse_input_report_boot_t* mouse_report = (hid_mouse_input_report_boot_t*)data;
+    return std::find(keys, keys + HID_KEYBOARD_KEY_MAX, usage) != keys + HID_KEYBOARD_KEY_MAX;
+}
 
-    if (length < sizeof(hid_mouse_input_report_boot_t)) {
+static void hid_host_keyboard_report_callback(const uint8_t* const data, const int length)
+{
+    if (length < sizeof(hid_keyboard_input_report_boot_t) || !s_usb_keys) {
         return;
     }
+    auto report     = reinterpret_cast<const hid_keyboard_input_report_boot_t*>(data);
+    const auto keys = report->key;
+    bool shifted    = report->modifier.val & (HID_LEFT_SHIFT | HID_RIGHT_SHIFT);
+    if (report_holds(keys, HID_USAGE_ROLLOVER)) {
+        return;  // Too many keys at once, the report doesn't say which: the held ones stay held
+    }
 
-    static int x_pos = 720 / 2;
-    static int y_pos = 1280 / 2;
-
-    // Calculate absolute position from displacement
-    x_pos += mouse_report->y_displacement;
-    y_pos -= mouse_report->x_displacement;
-
-    x_pos = std::clamp(x_pos, 0, 720);
-    y_pos = std::clamp(y_pos, 0, 1280);
-
-    hid_print_new_device_report_header(HID_PROTOCOL_MOUSE);
-
-    // printf("X: %06d\tY: %06d\t|%c|%c|\r", x_pos, y_pos, (mouse_report->buttons.button1 ? 'o' : ' '),
-    //        (mouse_report->buttons.button2 ? 'o' : ' '));
-
-    GetHAL()->hidMouseData.mutex.lock();
-    GetHAL()->hidMouseData.x        = x_pos;
-    GetHAL()->hidMouseData.y        = y_pos;
-    GetHAL()->hidMouseData.btnLeft  = mouse_report->buttons.button1;
-    GetHAL()->hidMouseData.btnRight = mouse_report->buttons.button2;
-    GetHAL()->hidMouseData.mutex.unlock();
-
-    fflush(stdout);
+    // A report lists the keys held: the new ones went down, the missing ones came up. A key comes up as what it went
+    // down as, whatever shift did meanwhile
+    static uint8_t s_held[HID_KEYBOARD_KEY_MAX]     = {};
+    static uint32_t s_held_as[HID_KEYBOARD_KEY_MAX] = {};
+    for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
+        if (s_held_as[i] && !report_holds(keys, s_held[i])) {
+            key_source_push(s_usb_keys, s_held_as[i], false);
+        }
+    }
+    uint32_t as[HID_KEYBOARD_KEY_MAX] = {};
+    for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
+        if (keys[i] <= HID_KEY_ERROR_UNDEFINED) {
+            continue;
+        }
+        const uint8_t* before = std::find(s_held, s_held + HID_KEYBOARD_KEY_MAX, keys[i]);
+        if (before != s_held + HID_KEYBOARD_KEY_MAX) {
+            as[i] = s_held_as[before - s_held];
+        } else if ((as[i] = usage_to_key(keys[i], shifted)) != 0) {
+            key_source_push(s_usb_keys, as[i], true);
+        }
+    }
+    std::copy(keys, keys + HID_KEYBOARD_KEY_MAX, s_held);
+    std::copy(as, as + HID_KEYBOARD_KEY_MAX, s_held_as);
 }
 
 void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle, const hid_host_interface_event_t event,
@@ -111,7 +180,7 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle, con
 
             if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
                 if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
-                    // hid_host_keyboard_report_callback(data, data_length);
+                    hid_host_keyboard_report_callback(data, data_length);
                 } else if (HID_PROTOCOL_MOUSE == dev_params.proto) {
                     hid_host_mouse_report_callback(data, data_length);
                 }
@@ -124,9 +193,14 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle, con
             ESP_LOGI(TAG, "HID Device, protocol '%s' DISCONNECTED", hid_proto_name_str[dev_params.proto]);
             ESP_ERROR_CHECK(hid_host_device_close(hid_device_handle));
 
-            _usba_detect_mutex.lock();
-            _is_usba_connected = false;
-            _usba_detect_mutex.unlock();
+            _usba_devices--;
+            if (HID_PROTOCOL_MOUSE == dev_params.proto) {
+                _usba_mice--;
+            } else if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
+                // Nothing held any more, what was comes up
+                hid_keyboard_input_report_boot_t none = {};
+                hid_host_keyboard_report_callback((const uint8_t*)&none, sizeof(none));
+            }
 
             break;
         case HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR:
@@ -158,9 +232,10 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle, const hid
             }
             ESP_ERROR_CHECK(hid_host_device_start(hid_device_handle));
 
-            _usba_detect_mutex.lock();
-            _is_usba_connected = true;
-            _usba_detect_mutex.unlock();
+            _usba_devices++;
+            if (HID_PROTOCOL_MOUSE == dev_params.proto) {
+                _usba_mice++;
+            }
 
             break;
         }
@@ -228,26 +303,49 @@ static void tab5_usb_host_task(void* pvParameters)
     }
 }
 
-static void lvgl_mouse_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
+static void mouse_read(lv_indev_t* indev, lv_indev_data_t* data)
 {
-    _usba_detect_mutex.lock();
-    if (!_is_usba_connected) {
-        _usba_detect_mutex.unlock();
+    if (_usba_mice.load() <= 0) {
         data->state = LV_INDEV_STATE_REL;
         if (lv_obj_get_style_opa(_cursor_img, LV_PART_MAIN) == LV_OPA_COVER) {
             lv_obj_set_style_opa(_cursor_img, LV_OPA_TRANSP, LV_PART_MAIN);
         }
         return;
     }
-    _usba_detect_mutex.unlock();
     if (lv_obj_get_style_opa(_cursor_img, LV_PART_MAIN) == LV_OPA_TRANSP) {
         lv_obj_set_style_opa(_cursor_img, LV_OPA_COVER, LV_PART_MAIN);
     }
 
-    std::lock_guard<std::mutex> lock(GetHAL()->hidMouseData.mutex);
-    data->point.x = GetHAL()->hidMouseData.x;
-    data->point.y = GetHAL()->hidMouseData.y;
-    data->state   = GetHAL()->hidMouseData.btnLeft ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    // The panel is portrait, the mouse's x runs down it in landscape
+    hal::HalBase::HidMouseData_t mouse = GetHAL()->hidMouseData.load();
+    uint32_t tail                      = s_mouse_tail.load(std::memory_order_relaxed);
+    uint32_t head                      = s_mouse_head.load(std::memory_order_acquire);
+    while (tail != head) {
+        const MouseReport_t& report = s_mouse_queue[tail % HID_MOUSE_QUEUE_SIZE];
+        bool clicked                = report.left != mouse.btnLeft || report.right != mouse.btnRight;
+        mouse.x                     = std::clamp(mouse.x + report.dy, 0, 720);
+        mouse.y                     = std::clamp(mouse.y - report.dx, 0, 1280);
+        mouse.btnLeft               = report.left;
+        mouse.btnRight              = report.right;
+        tail++;
+        if (clicked) {
+            // LVGL gets the button as it was at this move, the moves after it on the next read
+            data->continue_reading = tail != head;
+            break;
+        }
+    }
+    s_mouse_tail.store(tail, std::memory_order_release);
+    GetHAL()->hidMouseData.store(mouse);
+
+    data->point.x = mouse.x;
+    data->point.y = mouse.y;
+    data->state   = mouse.btnLeft ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static void lvgl_mouse_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    mouse_read(indev, data);
+    input_read(input_recording::MOUSE, indev, data);
 }
 
 void HalEsp32::hid_init()
@@ -263,10 +361,18 @@ void HalEsp32::hid_init()
     _cursor_img = lv_image_create(lv_screen_active()); /*Create an image object for the cursor */
     lv_image_set_src(_cursor_img, &mouse_cursor);      /*Set the image source*/
     lv_indev_set_cursor(lvMouse, _cursor_img);         /*Connect the image  object to the driver*/
+
+    hal::HalBase::HidMouseData_t centre;
+    centre.x = 720 / 2;
+    centre.y = 1280 / 2;
+    GetHAL()->hidMouseData.store(centre);
+
+    // A USB keyboard types into text fields like the one on Port A does, through its own keypad indev
+    lv_indev_t* lvUsbKeyboard = nullptr;
+    s_usb_keys                = key_source_create(&lvUsbKeyboard);
 }
 
 bool HalEsp32::usbADetect()
 {
-    std::lock_guard<std::mutex> lock(_usba_detect_mutex);
-    return _is_usba_connected;
+    return _usba_devices.load() > 0;
 }
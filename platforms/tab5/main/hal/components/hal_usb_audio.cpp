@@ -0,0 +1,226 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <usb/uac_host.h>
+
+static const char* TAG = "usb-audio";
+
+/* -------------------------------------------------------------------------- */
+/*                                 USB Audio                                  */
+/* -------------------------------------------------------------------------- */
+// A USB Audio Class DAC on USB-A takes over from the speaker codec while it's plugged in, at the output's own
+// 48 kHz 16-bit stereo, so nothing is converted twice. The UAC driver's ring is sent one packet per 1 ms frame,
+// its size derived from the frame clock: an adaptive or synchronous DAC locks on to that, and the radio's output
+// task is paced by writes blocking on the ring, the same way I2S paces it. The ring is about as deep as the I2S
+// DMA ring, so a late block is concealed by the output task before either runs dry. Asynchronous DACs with a
+// feedback endpoint aren't rate matched by the driver and slip a sample now and then
+#define USB_AUDIO_RATE        48000
+#define USB_AUDIO_CHANNELS    2
+#define USB_AUDIO_BITS        16
+#define USB_AUDIO_BUFFER_MS   90
+#define USB_AUDIO_FRAME_BYTES (USB_AUDIO_CHANNELS * USB_AUDIO_BITS / 8)
+#define USB_AUDIO_BUFFER      (USB_AUDIO_RATE / 1000 * USB_AUDIO_FRAME_BYTES * USB_AUDIO_BUFFER_MS)
+#define USB_AUDIO_WRITE_BYTES (USB_AUDIO_BUFFER / 4)  // Per driver write, a block goes in as room comes free
+#define USB_AUDIO_VOLUME      100                     // The DAC's own, the output's volume is applied in software
+#define USB_AUDIO_EVENTS      4
+
+struct UsbAudioEvent_t {
+    bool connected;
+    uint8_t addr;
+    uint8_t iface;
+    uac_host_device_handle_t handle;
+};
+
+static struct {
+    std::mutex mutex;  // The device, held over a write so it isn't closed under one
+    uac_host_device_handle_t device = nullptr;
+    std::atomic<bool> active{false};  // Cheap check for the output task, set once the stream runs
+    std::atomic<uint32_t> writeErrors{0};
+    QueueHandle_t events = nullptr;
+} s_usb_audio;
+
+static bool supports_output_format(uac_host_device_handle_t handle)
+{
+    uac_host_dev_info_t info;
+    if (uac_host_get_device_info(handle, &info) != ESP_OK) {
+        return false;
+    }
+    for (int alt = 1; alt <= info.iface_alt_num; alt++) {
+        uac_host_dev_alt_param_t param;
+        if (uac_host_get_device_alt_param(handle, alt, &param) != ESP_OK || param.channels != USB_AUDIO_CHANNELS ||
+            param.bit_resolution != USB_AUDIO_BITS) {
+            continue;
+        }
+        if (param.sample_freq_type == 0) {
+            if (param.sample_freq_lower <= USB_AUDIO_RATE && USB_AUDIO_RATE <= param.sample_freq_upper) {
+                return true;
+            }
+            continue;
+        }
+        for (int i = 0; i < param.sample_freq_type && i < UAC_FREQ_NUM_MAX; i++) {
+            if (param.sample_freq[i] == USB_AUDIO_RATE) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// On the UAC driver's task: opening and closing happen on ours
+static void device_callback(uac_host_device_handle_t handle, const uac_host_device_event_t event, void* arg)
+{
+    if (event == UAC_HOST_DRIVER_EVENT_DISCONNECTED) {
+        UsbAudioEvent_t disconnected = {false, 0, 0, handle};
+        xQueueSend(s_usb_audio.events, &disconnected, 0);
+    } else if (event == UAC_HOST_DEVICE_EVENT_TRANSFER_ERROR) {
+        s_usb_audio.writeErrors++;
+    }
+}
+
+static void driver_callback(uint8_t addr, uint8_t iface, const uac_host_driver_event_t event, void* arg)
+{
+    // Microphones (RX) stay unclaimed, the ES7210 is the input
+    if (event == UAC_HOST_DRIVER_EVENT_TX_CONNECTED) {
+        UsbAudioEvent_t connected = {true, addr, iface, nullptr};
+        xQueueSend(s_usb_audio.events, &connected, 0);
+    }
+}
+
+static void open_device(const UsbAudioEvent_t& event)
+{
+    if (s_usb_audio.device) {
+        mclog::tagWarn(TAG, "Second DAC at address {} ignored, one plays at a time", event.addr);
+        return;
+    }
+    uac_host_device_config_t config = {};
+    config.addr                     = event.addr;
+    config.iface_num                = event.iface;
+    config.buffer_size              = USB_AUDIO_BUFFER;
+    config.buffer_threshold         = 0;  // The writes block, TX_DONE isn't waited for
+    config.callback                 = device_callback;
+    uac_host_device_handle_t handle = nullptr;
+    if (uac_host_device_open(&config, &handle) != ESP_OK) {
+        mclog::tagError(TAG, "Can't open the DAC at address {}", event.addr);
+        return;
+    }
+    if (!supports_output_format(handle)) {
+        mclog::tagWarn(TAG, "DAC at address {} has no {} Hz {}-bit stereo, the speaker stays on", event.addr,
+                       USB_AUDIO_RATE, USB_AUDIO_BITS);
+        uac_host_device_close(handle);
+        return;
+    }
+
+    uac_host_stream_config_t stream = {};
+    stream.channels                 = USB_AUDIO_CHANNELS;
+    stream.bit_resolution           = USB_AUDIO_BITS;
+    stream.sample_freq              = USB_AUDIO_RATE;
+    if (uac_host_device_start(handle, &stream) != ESP_OK) {
+        mclog::tagError(TAG, "Can't start the DAC's stream");
+        uac_host_device_close(handle);
+        return;
+    }
+    // Not every DAC has these controls
+    uac_host_device_set_mute(handle, false);
+    uac_host_device_set_volume(handle, USB_AUDIO_VOLUME);
+
+    std::lock_guard<std::mutex> lock(s_usb_audio.mutex);
+    s_usb_audio.device = handle;
+    s_usb_audio.active = true;
+    mclog::tagInfo(TAG, "DAC at address {} plays, {} ms buffer", event.addr, USB_AUDIO_BUFFER_MS);
+}
+
+static void close_device(uac_host_device_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_usb_audio.mutex);
+    if (handle != s_usb_audio.device) {
+        return;  // Closed already, it never got to play
+    }
+    s_usb_audio.active = false;
+    uac_host_device_stop(handle);
+    uac_host_device_close(handle);
+    s_usb_audio.device = nullptr;
+    mclog::tagInfo(TAG, "DAC gone, back to the speaker");
+}
+
+static void usb_audio_task(void* param)
+{
+    UsbAudioEvent_t event;
+    while (true) {
+        if (xQueueReceive(s_usb_audio.events, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (event.connected) {
+            open_device(event);
+        } else {
+            close_device(event.handle);
+        }
+    }
+}
+
+void usb_audio_start()
+{
+    s_usb_audio.events = xQueueCreate(USB_AUDIO_EVENTS, sizeof(UsbAudioEvent_t));
+    if (!s_usb_audio.events ||
+        task_topology::create(task_topology::USB_AUDIO, usb_audio_task, nullptr, nullptr) != pdPASS) {
+        mclog::tagError(TAG, "No USB audio task, the speaker is the only output");
+        return;
+    }
+
+    const uac_host_driver_config_t config = {
+        .create_background_task = true,
+        .task_priority          = task_topology::USB_AUDIO.priority,
+        .stack_size             = task_topology::USB_AUDIO.stackSize,
+        .core_id                = task_topology::USB_AUDIO.core,
+        .callback               = driver_callback,
+        .callback_arg           = nullptr,
+    };
+    esp_err_t ret = uac_host_install(&config);
+    if (ret != ESP_OK) {
+        mclog::tagError(TAG, "UAC host install failed: {}", esp_err_to_name(ret));
+    }
+}
+
+bool usb_audio_active()
+{
+    return s_usb_audio.active.load(std::memory_order_relaxed);
+}
+
+int usb_audio_buffer_ms()
+{
+    return USB_AUDIO_BUFFER_MS;
+}
+
+bool usb_audio_write(const int16_t* pcm, int samples, uint32_t timeoutMs)
+{
+    std::lock_guard<std::mutex> lock(s_usb_audio.mutex);
+    if (!s_usb_audio.device) {
+        return false;
+    }
+    uint8_t* data = (uint8_t*)pcm;
+    size_t left   = samples * sizeof(int16_t);
+    while (left > 0) {
+        size_t n = std::min(left, (size_t)USB_AUDIO_WRITE_BYTES);
+        if (uac_host_device_write(s_usb_audio.device, data, n, pdMS_TO_TICKS(timeoutMs)) != ESP_OK) {
+            s_usb_audio.writeErrors++;
+            return false;
+        }
+        data += n;
+        left -= n;
+    }
+    return true;
+}
+
+uint32_t usb_audio_write_errors()
+{
+    return s_usb_audio.writeErrors.load(std::memory_order_relaxed);
+}
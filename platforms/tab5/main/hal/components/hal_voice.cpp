@@ -0,0 +1,271 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "hal/hal_esp32.h"
+#include "../utils/task_topology/task_topology.h"
+#include "../utils/joinable_task/joinable_task.h"
+#include <stream/echo_canceller.h>
+#include <stream/pcm_channels.h>
+#include <stream/resampler.h>
+#include <stream/voice_command.h>
+#include <mooncake_log.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char* TAG = "voice";
+
+/* -------------------------------------------------------------------------- */
+/*                                Voice Control                               */
+/* -------------------------------------------------------------------------- */
+// A mic capture reader on the network core, so the decoder's core never sees it. MIC-L and MIC-R are averaged and
+// taken down to 16 kHz with the AEC reference beside them, the echo canceller takes the speaker out, and what's left
+// is cut into utterances and matched against the user's examples (stream/voice_command.h)
+#define VOICE_TEMPLATES_FILE "/voice_commands.bin"
+#define VOICE_TEMPLATES_MAX  (64 * 1024)
+#define VOICE_READ_FRAMES    8      // Mic frames per read, 32 ms
+#define VOICE_REPORT_MS      30000  // Between load reports in the log
+#define VOICE_BUDGET_PERCENT 15     // Of core 0, a report over it is a warning
+
+static constexpr int VOICE_READ_SAMPLES = VOICE_READ_FRAMES * hal::HalBase::MIC_FRAME_SAMPLES;
+
+static struct {
+    std::mutex mutex;  // Everything below but the task
+    JoinableTask task;
+    std::atomic<bool> running{false};
+    bool listening = false;  // Voice control is on, rather than just a training
+    int training   = -1;     // Command the next utterance is an example of
+    bool loaded    = false;
+    VoiceMatcher matcher;
+} s_voice;
+
+struct VoicePipeline_t {
+    Resampler decimator;
+    EchoCanceller aec;
+    VoiceFeatures features;
+    VoiceUtterance utterance;
+    int16_t capture[VOICE_READ_SAMPLES * hal::HalBase::MIC_CHANNELS];
+    int16_t left[VOICE_READ_SAMPLES];
+    int16_t reference[VOICE_READ_SAMPLES];
+    int16_t right[VOICE_READ_SAMPLES];
+    int16_t pair[VOICE_READ_SAMPLES * 2];  // [mics, reference]
+    int16_t decimated[VOICE_READ_SAMPLES * 2];
+    float mic[VOICE_READ_SAMPLES];
+    float ref[VOICE_READ_SAMPLES];
+};
+
+static std::string templates_path()
+{
+    std::string dir = GetHAL()->getDataDir();
+    return dir.empty() ? dir : dir + VOICE_TEMPLATES_FILE;
+}
+
+// s_voice.mutex held
+static void load_templates()
+{
+    std::string path = templates_path();
+    FILE* file       = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!file) {
+        return;
+    }
+    long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    std::vector<uint8_t> blob;
+    if (size > 0 && size <= VOICE_TEMPLATES_MAX && fseek(file, 0, SEEK_SET) == 0) {
+        blob.resize(size);
+        if (fread(blob.data(), 1, size, file) != (size_t)size) {
+            blob.clear();
+        }
+    }
+    fclose(file);
+    if (!s_voice.matcher.load(blob)) {
+        mclog::tagWarn(TAG, "{} isn't usable, commands need training again", path);
+    }
+}
+
+// s_voice.mutex held
+static void save_templates()
+{
+    std::string path = templates_path();
+    if (path.empty()) {
+        mclog::tagWarn(TAG, "No data dir, the examples last until reboot");
+        return;
+    }
+    std::vector<uint8_t> blob = s_voice.matcher.serialize();
+    FILE* file                = fopen(path.c_str(), "wb");
+    bool written              = file && fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    if (file) {
+        written = (fclose(file) == 0) && written;
+    }
+    if (!written) {
+        mclog::tagWarn(TAG, "Can't write {}", path);
+        unlink(path.c_str());
+    }
+}
+
+static void on_utterance(const std::vector<voice::Frame_t>& frames)
+{
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    if (s_voice.training >= 0) {
+        int command      = s_voice.training;
+        s_voice.training = -1;
+        s_voice.matcher.addExample(command, frames);
+        save_templates();
+        mclog::tagInfo(TAG, "Example {} of command {} kept, {} frames", s_voice.matcher.examples(command), command,
+                       frames.size());
+        hal_post_event(hal::HalBase::EVENT_VOICE_TRAINED, command);
+        if (!s_voice.listening) {
+            s_voice.running = false;
+        }
+        return;
+    }
+
+    float distance = 0;
+    int command    = s_voice.matcher.match(frames, &distance);
+    mclog::tagInfo(TAG, "Heard {} frames: command {}, distance {:.2f}", frames.size(), command, distance);
+    if (command >= 0) {
+        hal_post_event(hal::HalBase::EVENT_VOICE_COMMAND, command);
+    }
+}
+
+static void voice_task(void* param)
+{
+    auto p     = std::make_unique<VoicePipeline_t>();
+    int reader = GetHAL()->openMicCapture();
+    if (reader < 0) {
+        mclog::tagError(TAG, "No mic capture reader left");
+        s_voice.running = false;
+        return;
+    }
+    p->decimator.configure(hal::HalBase::MIC_SAMPLE_RATE, voice::SAMPLE_RATE, 2);
+    p->aec.init();
+
+    int16_t* channels[hal::HalBase::MIC_CHANNELS] = {p->left, p->reference, p->right, nullptr};
+    int64_t reportStart                           = esp_timer_get_time();
+    int64_t busyUs                                = 0;
+    int dropped                                   = 0;
+    while (s_voice.running.load()) {
+        int frames = GetHAL()->readMicCapture(reader, p->capture, VOICE_READ_FRAMES, 100, &dropped);
+        if (frames <= 0) {
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        int samples   = frames * hal::HalBase::MIC_FRAME_SAMPLES;
+        pcm_channels::deinterleave(p->capture, samples, hal::HalBase::MIC_CHANNELS, channels);
+        for (int i = 0; i < samples; i++) {
+            p->pair[i * 2]     = (int16_t)((p->left[i] + p->right[i]) / 2);
+            p->pair[i * 2 + 1] = p->reference[i];
+        }
+        int n = p->decimator.process(p->pair, samples, p->decimated, VOICE_READ_SAMPLES);
+        for (int i = 0; i < n; i++) {
+            p->mic[i] = p->decimated[i * 2] / 32768.0f;
+            p->ref[i] = p->decimated[i * 2 + 1] / 32768.0f;
+        }
+        p->aec.process(p->mic, p->ref, p->mic, n);
+        p->features.push(p->mic, n, [&](const voice::Frame_t& frame, float energyDb) {
+            if (p->utterance.push(frame, energyDb)) {
+                on_utterance(p->utterance.frames());
+            }
+        });
+        busyUs += esp_timer_get_time() - start;
+
+        int64_t now = esp_timer_get_time();
+        if (now - reportStart >= VOICE_REPORT_MS * 1000) {
+            float load = 100.0f * busyUs / (now - reportStart);
+            if (load > VOICE_BUDGET_PERCENT) {
+                mclog::tagWarn(TAG, "Using {:.1f}% of a core, over the {}% budget", load, VOICE_BUDGET_PERCENT);
+            }
+            mclog::tagInfo(TAG, "{:.1f}% of a core, echo -{:.0f} dB, floor {:.0f} dBFS, {} frames dropped", load,
+                           p->aec.erleDb(), p->utterance.floorDb(), dropped);
+            reportStart = now;
+            busyUs      = 0;
+            dropped     = 0;
+        }
+    }
+    GetHAL()->closeMicCapture(reader);
+    mclog::tagInfo(TAG, "Voice task ended, {} B stack left", task_topology::stack_headroom());
+}
+
+// s_voice.mutex held
+static bool start_locked()
+{
+    if (!s_voice.loaded) {
+        load_templates();
+        s_voice.loaded = true;
+    }
+    if (s_voice.running.load()) {
+        return true;
+    }
+    // A run that stopped itself after a training may still be on its way out
+    s_voice.task.join(200);
+    s_voice.running = true;
+    if (!s_voice.task.start(task_topology::VOICE, voice_task, nullptr)) {
+        s_voice.running = false;
+        return false;
+    }
+    return true;
+}
+
+bool HalEsp32::startVoiceControl()
+{
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    s_voice.listening = start_locked();
+    return s_voice.listening;
+}
+
+void HalEsp32::stopVoiceControl()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_voice.mutex);
+        s_voice.listening = false;
+        s_voice.training  = -1;
+        s_voice.running   = false;
+    }
+    s_voice.task.join(500);  // Up to a read timeout and the rest of one utterance
+}
+
+bool HalEsp32::isVoiceControlRunning()
+{
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    return s_voice.listening;
+}
+
+bool HalEsp32::trainVoiceCommand(VoiceCommand_t command)
+{
+    if (command < 0 || command >= VOICE_COMMAND_COUNT) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    s_voice.training = command;
+    if (!start_locked()) {
+        s_voice.training = -1;
+        return false;
+    }
+    return true;
+}
+
+int HalEsp32::getVoiceCommandExamples(VoiceCommand_t command)
+{
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    if (!s_voice.loaded) {
+        load_templates();
+        s_voice.loaded = true;
+    }
+    return s_voice.matcher.examples(command);
+}
+
+void HalEsp32::clearVoiceCommands()
+{
+    std::lock_guard<std::mutex> lock(s_voice.mutex);
+    s_voice.matcher.clear();
+    s_voice.loaded = true;
+    save_templates();
+}
@@ -4,12 +4,20 @@
  * SPDX-License-Identifier: MIT
  */
 #include "hal/hal_esp32.h"
+#include <hal/metrics.h>
+#include <hal/snapshot.h>
 #include <mooncake_log.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <vector>
 #include <memory>
+#include <new>
 #include <string.h>
 #include <bsp/m5stack_tab5.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <esp_wifi.h>
 #include <nvs_flash.h>
@@ -17,7 +25,10 @@
 #include <esp_event.h>
 #include <esp_log.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
 #include <esp_http_server.h>
+#include <esp_http_client.h>
+#include <esp_crt_bundle.h>
 
 static const char* TAG = "wifi";
 
@@ -27,9 +38,15 @@ static const char* TAG = "wifi";
 #define MAX_STA_CONN    4
 
 // WiFi STA event bits
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
-#define WIFI_MAX_RETRY     5
+#define WIFI_CONNECTED_BIT      BIT0
+#define WIFI_FAIL_BIT           BIT1
+#define WIFI_MAX_RETRY          5
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define WIFI_BACKOFF_MIN_MS     1000   // Reconnects once the quick retries are used up, doubling up to the max
+#define WIFI_BACKOFF_MAX_MS     30000
+#define WIFI_ROAM_RSSI          -70    // dBm, below it a stronger AP of the same network is looked for
+#define WIFI_ROAM_MARGIN        8      // dB an AP has to be stronger to be worth the switch
+#define WIFI_ROAM_HOLDOFF_MS    30000  // Between two looks
 
 // NVS namespace for WiFi config
 #define NVS_WIFI_NAMESPACE "wifi_cfg"
@@ -40,6 +57,37 @@ static int s_retry_num                       = 0;
 static HalEsp32* s_hal_instance              = nullptr;
 static esp_netif_t* s_sta_netif              = nullptr;
 static bool s_wifi_started                   = false;
+static esp_timer_handle_t s_connect_timer    = nullptr;  // Gives up a connect that takes too long
+static esp_timer_handle_t s_reconnect_timer  = nullptr;  // Next try in the background after that
+static esp_timer_handle_t s_roam_timer       = nullptr;  // Looks for a stronger AP again
+static uint32_t s_backoff_ms                 = WIFI_BACKOFF_MIN_MS;
+static bool s_auto_reconnect                 = false;  // Until disconnectWifi()
+static bool s_roaming                        = false;  // The next disconnect is the switch to another AP
+
+// The network and address the UI shows, read lock-free from any task. Both the event task and connectWifiSta() set
+// them, the mutex keeps them to one writer at a time
+struct WifiLink_t {
+    hal::HalBase::WifiSsid_t ssid;
+    hal::HalBase::WifiIp_t ip;
+};
+static Snapshot<WifiLink_t> s_link;
+static std::mutex s_link_mutex;
+
+static void link_set_ssid(const std::string& ssid)
+{
+    std::lock_guard<std::mutex> lock(s_link_mutex);
+    WifiLink_t link = s_link.load();
+    link.ssid       = ssid;
+    s_link.store(link);
+}
+
+static void link_set_ip(const char* ip)
+{
+    std::lock_guard<std::mutex> lock(s_link_mutex);
+    WifiLink_t link = s_link.load();
+    link.ip         = ip;
+    s_link.store(link);
+}
 
 // HTTP 处理函数
 esp_err_t hello_get_handler(httpd_req_t* req)
@@ -171,6 +219,526 @@ void HalEsp32::startWifiAp()
     wifi_init();
 }
 
+/* -------------------------------------------------------------------------- */
+/*                               Fast Reconnect                               */
+/* -------------------------------------------------------------------------- */
+// Where the last connect to a network ended up. The next one to the same SSID goes straight to that AP on its
+// channel instead of scanning them all, and can take its lease over instead of asking DHCP again
+struct FastConnect_t {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip;
+    esp_ip4_addr_t dns;
+};
+
+static FastConnect_t s_fast_connect = {};     // Loaded or last saved, ssid empty if none
+static bool s_directed              = false;  // This attempt goes to the cached AP
+
+static bool fast_connect_load(const std::string& ssid)
+{
+    nvs_handle_t handle;
+    size_t size = sizeof(s_fast_connect);
+    bool ok     = nvs_open(NVS_WIFI_NAMESPACE, NVS_READONLY, &handle) == ESP_OK;
+    if (ok) {
+        ok = nvs_get_blob(handle, "fast", &s_fast_connect, &size) == ESP_OK && size == sizeof(s_fast_connect);
+        nvs_close(handle);
+    }
+    s_fast_connect.ssid[sizeof(s_fast_connect.ssid) - 1] = '\0';
+    if (!ok || ssid != s_fast_connect.ssid) {
+        s_fast_connect = {};
+        return false;
+    }
+    return true;
+}
+
+static void fast_connect_save(const FastConnect_t& fast)
+{
+    // Reconnects to the same AP land here with the same values, flash is only written when they changed
+    if (memcmp(&fast, &s_fast_connect, sizeof(fast)) == 0) {
+        return;
+    }
+    nvs_handle_t handle;
+    if (nvs_open(NVS_WIFI_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, "fast", &fast, sizeof(fast)) == ESP_OK && nvs_commit(handle) == ESP_OK) {
+        s_fast_connect = fast;
+    }
+    nvs_close(handle);
+}
+
+static void fast_connect_forget()
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_WIFI_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, "fast");
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    s_fast_connect = {};
+}
+
+static void set_dns(esp_ip4_addr_t addr)
+{
+    esp_netif_dns_info_t dns = {};
+    dns.ip.type              = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4        = addr;
+    esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+
+// Static address, the last lease of `fast` or DHCP, as configured
+static void apply_ip_config(const FastConnect_t* fast)
+{
+#if CONFIG_TAB5_WIFI_IP_STATIC
+    esp_netif_ip_info_t ip = {};
+    ip.ip.addr             = esp_ip4addr_aton(CONFIG_TAB5_WIFI_STATIC_IP);
+    ip.netmask.addr        = esp_ip4addr_aton(CONFIG_TAB5_WIFI_STATIC_NETMASK);
+    ip.gw.addr             = esp_ip4addr_aton(CONFIG_TAB5_WIFI_STATIC_GATEWAY);
+    esp_netif_dhcpc_stop(s_sta_netif);
+    esp_netif_set_ip_info(s_sta_netif, &ip);
+    esp_ip4_addr_t dns = {esp_ip4addr_aton(CONFIG_TAB5_WIFI_STATIC_DNS)};
+    set_dns(dns);
+    return;
+#elif CONFIG_TAB5_WIFI_IP_LAST_LEASE
+    if (fast && fast->ip.ip.addr != 0) {
+        esp_netif_dhcpc_stop(s_sta_netif);
+        esp_netif_set_ip_info(s_sta_netif, &fast->ip);
+        set_dns(fast->dns);
+        return;
+    }
+#endif
+    esp_netif_dhcpc_start(s_sta_netif);  // Already running is fine
+}
+
+// The cached AP didn't take us: forget it and scan as on a first connect
+static void fast_connect_fall_back()
+{
+    mclog::tagWarn(TAG, "Cached AP {:02x}:{:02x}:{:02x}:{:02x}:{:02x}:{:02x} didn't answer, scanning",
+                   s_fast_connect.bssid[0], s_fast_connect.bssid[1], s_fast_connect.bssid[2], s_fast_connect.bssid[3],
+                   s_fast_connect.bssid[4], s_fast_connect.bssid[5]);
+    s_directed = false;
+    fast_connect_forget();
+
+    wifi_config_t config;
+    esp_wifi_get_config(WIFI_IF_STA, &config);
+    config.sta.bssid_set = false;
+    config.sta.channel   = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+    apply_ip_config(nullptr);
+    esp_wifi_connect();
+}
+
+static void fast_connect_remember(const esp_netif_ip_info_t& ip)
+{
+    wifi_ap_record_t ap;
+    esp_netif_dns_info_t dns;
+    if (!s_hal_instance || esp_wifi_sta_get_ap_info(&ap) != ESP_OK ||
+        esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK) {
+        return;
+    }
+    FastConnect_t fast = {};
+    strncpy(fast.ssid, s_hal_instance->getWifiSsid().c_str(), sizeof(fast.ssid) - 1);
+    memcpy(fast.bssid, ap.bssid, sizeof(fast.bssid));
+    fast.channel = ap.primary;
+    fast.ip      = ip;
+    fast.dns     = dns.ip.u_addr.ip4;
+    fast_connect_save(fast);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               Saved Networks                               */
+/* -------------------------------------------------------------------------- */
+// A few networks, so one moving between home and the office finds whichever is around. Kept as one NVS blob
+#define WIFI_SAVED_MAX 5
+
+struct SavedNetwork_t {
+    char ssid[33];
+    char password[65];
+    uint32_t lastSuccess;  // Joins counted over all of them at its last one, higher is more recent, 0 if never
+};
+
+static std::mutex s_saved_mutex;
+static std::vector<SavedNetwork_t> s_saved;  // Saved or joined last first
+static bool s_saved_loaded = false;
+
+// A connect on behalf of the list: a network that fails hands over to the next one of the round
+static bool s_from_saved   = false;
+static bool s_saved_scan   = false;  // The scan that ranks them is running, or due once the station started
+static bool s_saved_ranked = false;  // This round's candidates are in
+static std::string s_saved_skip;     // Just failed, left out of the round
+static std::vector<SavedNetwork_t> s_saved_candidates;
+
+static void saved_store()
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_WIFI_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_set_blob(handle, "networks", s_saved.data(), s_saved.size() * sizeof(SavedNetwork_t));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+// Under s_saved_mutex
+static void saved_load()
+{
+    if (s_saved_loaded) {
+        return;
+    }
+    s_saved_loaded = true;
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_WIFI_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    size_t size = 0;
+    if (nvs_get_blob(handle, "networks", nullptr, &size) == ESP_OK && size % sizeof(SavedNetwork_t) == 0) {
+        s_saved.resize(std::min(size / sizeof(SavedNetwork_t), (size_t)WIFI_SAVED_MAX));
+        size = s_saved.size() * sizeof(SavedNetwork_t);
+        if (nvs_get_blob(handle, "networks", s_saved.data(), &size) != ESP_OK) {
+            s_saved.clear();
+        }
+        for (auto& saved : s_saved) {
+            saved.ssid[sizeof(saved.ssid) - 1]         = '\0';
+            saved.password[sizeof(saved.password) - 1] = '\0';
+        }
+        nvs_close(handle);
+        return;
+    }
+
+    // Saved before there was a list: the one network becomes its first entry
+    SavedNetwork_t saved = {};
+    size_t ssidLen       = sizeof(saved.ssid);
+    size_t passwordLen   = sizeof(saved.password);
+    if (nvs_get_str(handle, "ssid", saved.ssid, &ssidLen) == ESP_OK && saved.ssid[0] != '\0') {
+        if (nvs_get_str(handle, "password", saved.password, &passwordLen) != ESP_OK) {
+            saved.password[0] = '\0';  // Open network
+        }
+        saved.lastSuccess = 1;
+        s_saved.push_back(saved);
+        nvs_set_blob(handle, "networks", s_saved.data(), sizeof(SavedNetwork_t));
+        nvs_erase_key(handle, "ssid");
+        nvs_erase_key(handle, "password");
+        nvs_commit(handle);
+        mclog::tagInfo(TAG, "Moved saved network {} into the list", saved.ssid);
+    }
+    nvs_close(handle);
+}
+
+// Joined: most recent success, and first for loadWifiConfig()
+static void saved_succeeded(const std::string& ssid)
+{
+    std::lock_guard<std::mutex> lock(s_saved_mutex);
+    saved_load();
+    auto it = std::find_if(s_saved.begin(), s_saved.end(), [&](const auto& s) { return ssid == s.ssid; });
+    if (it == s_saved.end()) {
+        return;
+    }
+    uint32_t latest = 0;
+    for (const auto& saved : s_saved) {
+        latest = std::max(latest, saved.lastSuccess);
+    }
+    if (it == s_saved.begin() && it->lastSuccess == latest && latest != 0) {
+        return;  // A reconnect to the same one, nothing to write
+    }
+    SavedNetwork_t saved = *it;
+    saved.lastSuccess    = latest + 1;
+    s_saved.erase(it);
+    s_saved.insert(s_saved.begin(), saved);
+    saved_store();
+}
+
+// The round's order: those the scan saw before the rest, more recently joined first among either
+static void saved_rank()
+{
+    std::vector<SavedNetwork_t> candidates;
+    {
+        std::lock_guard<std::mutex> lock(s_saved_mutex);
+        saved_load();
+        for (const auto& saved : s_saved) {
+            if (s_saved_skip != saved.ssid) {
+                candidates.push_back(saved);
+            }
+        }
+    }
+
+    static wifi_ap_record_t records[24];  // Strongest first, off the event task's small stack
+    uint16_t count = sizeof(records) / sizeof(records[0]);
+    if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+    esp_wifi_clear_ap_list();
+    std::vector<bool> seen(candidates.size(), false);
+    for (uint16_t r = 0; r < count; r++) {
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (strcmp((const char*)records[r].ssid, candidates[i].ssid) == 0) {
+                seen[i] = true;
+            }
+        }
+    }
+
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (seen[a] != seen[b]) {
+            return (bool)seen[a];
+        }
+        return candidates[a].lastSuccess > candidates[b].lastSuccess;
+    });
+    s_saved_candidates.clear();
+    int inRange = 0;
+    for (size_t i : order) {
+        s_saved_candidates.push_back(candidates[i]);
+        inRange += seen[i] ? 1 : 0;
+    }
+    s_saved_ranked = true;
+    mclog::tagInfo(TAG, "{} of {} saved networks in range", inRange, candidates.size());
+}
+
+static bool saved_scan_start()
+{
+    // All channels at once, only which SSIDs are around matters here
+    s_saved_scan = esp_wifi_scan_start(nullptr, false) == ESP_OK;
+    return s_saved_scan;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Network Scan                                */
+/* -------------------------------------------------------------------------- */
+// One channel at a time, so the list grows as the channels come in instead of after the whole band
+#define WIFI_SCAN_CHANNELS    13
+#define WIFI_SCAN_CHANNEL_MS  100    // Active scan time per channel
+#define WIFI_SCAN_CACHE_MS    10000  // A finished scan younger than this is reused
+#define WIFI_SCAN_MAX_RECORDS 20     // Per channel
+
+static std::mutex s_scan_mutex;
+static std::vector<hal::HalBase::WifiNetwork_t> s_networks;  // One per SSID, strongest first
+static int s_scan_channel   = 0;                              // Being scanned, 0 if none
+static int64_t s_scanned_at = 0;                              // When the last full scan ended
+
+static bool scan_channel(int channel)
+{
+    wifi_scan_config_t scan   = {};
+    scan.channel              = channel;
+    scan.scan_type            = WIFI_SCAN_TYPE_ACTIVE;
+    scan.scan_time.active.max = WIFI_SCAN_CHANNEL_MS;
+    return esp_wifi_scan_start(&scan, false) == ESP_OK;
+}
+
+// WIFI_EVENT_SCAN_DONE of a channel: add what it found, go on with the next
+static void scan_merge()
+{
+    static wifi_ap_record_t records[WIFI_SCAN_MAX_RECORDS];  // Off the event task's small stack
+    uint16_t count = WIFI_SCAN_MAX_RECORDS;
+    if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+    esp_wifi_clear_ap_list();
+
+    {
+        std::lock_guard<std::mutex> lock(s_scan_mutex);
+        for (uint16_t i = 0; i < count; i++) {
+            const char* ssid = (const char*)records[i].ssid;
+            if (ssid[0] == '\0') {
+                continue;  // Hidden
+            }
+            auto it = std::find_if(s_networks.begin(), s_networks.end(), [&](const auto& n) { return n.ssid == ssid; });
+            if (it == s_networks.end()) {
+                s_networks.push_back({ssid, records[i].rssi, records[i].authmode != WIFI_AUTH_OPEN});
+            } else if (records[i].rssi > it->rssi) {
+                it->rssi = records[i].rssi;  // Strongest AP of the network
+            }
+        }
+        std::stable_sort(s_networks.begin(), s_networks.end(),
+                         [](const auto& a, const auto& b) { return a.rssi > b.rssi; });
+    }
+
+    if (s_scan_channel < WIFI_SCAN_CHANNELS && scan_channel(s_scan_channel + 1)) {
+        s_scan_channel++;
+        hal_post_event(hal::HalBase::EVENT_WIFI_SCAN, 1);
+        return;
+    }
+    s_scan_channel = 0;
+    s_scanned_at   = esp_timer_get_time();
+    hal_post_event(hal::HalBase::EVENT_WIFI_SCAN, 0);
+}
+
+bool HalEsp32::startWifiScan()
+{
+    if (s_scan_channel) {
+        return true;  // Already on it
+    }
+    if (s_scanned_at && esp_timer_get_time() - s_scanned_at < WIFI_SCAN_CACHE_MS * 1000) {
+        hal_post_event(EVENT_WIFI_SCAN, 0);
+        return true;
+    }
+    if (!wifi_sta_init()) {
+        return false;
+    }
+    if (!s_wifi_started) {
+        // Nothing to connect to yet, the station only has to be up to scan
+        if (esp_wifi_start() != ESP_OK) {
+            return false;
+        }
+        s_wifi_started = true;
+    }
+
+    std::lock_guard<std::mutex> lock(s_scan_mutex);
+    s_networks.clear();
+    s_scan_channel = 1;
+    if (!scan_channel(1)) {
+        // Busy connecting, or a roaming scan
+        s_scan_channel = 0;
+        return false;
+    }
+    return true;
+}
+
+std::vector<hal::HalBase::WifiNetwork_t> HalEsp32::getWifiNetworks()
+{
+    std::lock_guard<std::mutex> lock(s_scan_mutex);
+    return s_networks;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                            Reconnect and Roaming                           */
+/* -------------------------------------------------------------------------- */
+// After the quick retries the network is tried again in the background, for as long as it takes
+static void schedule_reconnect()
+{
+    if (!s_auto_reconnect || esp_timer_is_active(s_reconnect_timer)) {
+        return;
+    }
+    mclog::tagInfo(TAG, "Trying again in {} ms", s_backoff_ms);
+    esp_timer_start_once(s_reconnect_timer, s_backoff_ms * 1000);
+    s_backoff_ms = std::min(s_backoff_ms * 2, (uint32_t)WIFI_BACKOFF_MAX_MS);
+}
+
+static void on_reconnect_timer(void* arg)
+{
+    // One try each time, its failure schedules the next. The state stays failed meanwhile
+    if (s_auto_reconnect && s_hal_instance && s_hal_instance->getWifiState() != hal::HalBase::WIFI_CONNECTED) {
+        s_retry_num    = WIFI_MAX_RETRY;
+        s_saved_ranked = false;  // Should it fail, a new round of the saved networks follows
+        esp_wifi_connect();
+    }
+}
+
+// The signal got weak (WIFI_EVENT_STA_BSS_RSSI_LOW): look for the other APs of the network
+static void roam_scan()
+{
+    static char ssid[33];
+    if (!s_hal_instance || s_hal_instance->getWifiState() != hal::HalBase::WIFI_CONNECTED || s_scan_channel) {
+        return;
+    }
+    strncpy(ssid, s_hal_instance->getWifiSsid().c_str(), sizeof(ssid) - 1);
+    wifi_scan_config_t scan = {};
+    scan.ssid               = (uint8_t*)ssid;
+    if (esp_wifi_scan_start(&scan, false) != ESP_OK) {
+        esp_timer_start_once(s_roam_timer, WIFI_ROAM_HOLDOFF_MS * 1000);
+    }
+}
+
+// The scan is done: move to the strongest AP if it's clearly better than this one
+static void roam_pick()
+{
+    static wifi_ap_record_t records[8];  // Off the event task's small stack
+    uint16_t count = sizeof(records) / sizeof(records[0]);
+    wifi_ap_record_t current;
+    bool ok = esp_wifi_scan_get_ap_records(&count, records) == ESP_OK;
+    esp_wifi_clear_ap_list();
+    if (!ok || esp_wifi_sta_get_ap_info(&current) != ESP_OK) {
+        esp_timer_start_once(s_roam_timer, WIFI_ROAM_HOLDOFF_MS * 1000);
+        return;
+    }
+
+    const wifi_ap_record_t* best = nullptr;
+    for (uint16_t i = 0; i < count; i++) {
+        if (memcmp(records[i].bssid, current.bssid, sizeof(current.bssid)) != 0 &&
+            (!best || records[i].rssi > best->rssi)) {
+            best = &records[i];
+        }
+    }
+    if (!best || best->rssi < current.rssi + WIFI_ROAM_MARGIN) {
+        esp_timer_start_once(s_roam_timer, WIFI_ROAM_HOLDOFF_MS * 1000);
+        return;
+    }
+
+    mclog::tagInfo(TAG, "Roaming to {:02x}:{:02x}:{:02x}:{:02x}:{:02x}:{:02x} on channel {}, {} dBm over {} dBm",
+                   best->bssid[0], best->bssid[1], best->bssid[2], best->bssid[3], best->bssid[4], best->bssid[5],
+                   best->primary, best->rssi, current.rssi);
+    wifi_config_t config;
+    esp_wifi_get_config(WIFI_IF_STA, &config);
+    memcpy(config.sta.bssid, best->bssid, sizeof(config.sta.bssid));
+    config.sta.bssid_set = true;
+    config.sta.channel   = best->primary;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+    s_roaming = true;
+    esp_wifi_disconnect();
+}
+
+static void on_roam_timer(void* arg)
+{
+    // The threshold only fires once, a signal that's still weak fires it again right away
+    if (s_hal_instance && s_hal_instance->getWifiState() == hal::HalBase::WIFI_CONNECTED) {
+        esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI);
+    }
+}
+
+static bool create_timer(esp_timer_cb_t callback, const char* name, esp_timer_handle_t* handle)
+{
+    esp_timer_create_args_t args = {};
+    args.callback                = callback;
+    args.name                    = name;
+    return esp_timer_create(&args, handle) == ESP_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                Power Profile                               */
+/* -------------------------------------------------------------------------- */
+// Auto: the modem sleeps (woken at each DTIM) once the stream has this much buffered, the stream then reads in
+// bursts. It stays awake below the lower level, for a fast prebuffer and refill
+#define WIFI_POWER_SAVE_FROM  90  // % of the stream ring
+#define WIFI_POWER_FULL_UNDER 60
+
+#if CONFIG_TAB5_WIFI_POWER_LOW
+static std::atomic<bool> s_power_save{true};
+#else
+static std::atomic<bool> s_power_save{false};
+#endif
+
+static void apply_power_save()
+{
+    if (s_wifi_started) {
+        esp_wifi_set_ps(s_power_save ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+    }
+}
+
+void wifi_power_buffer_level(int percent)
+{
+#if CONFIG_TAB5_WIFI_POWER_AUTO
+    bool save = s_power_save;
+    if (percent >= WIFI_POWER_SAVE_FROM) {
+        save = true;
+    } else if (percent < WIFI_POWER_FULL_UNDER) {
+        save = false;
+    }
+    if (save != s_power_save) {
+        mclog::tagInfo(TAG, "Buffer at {}%, power save {}", percent, save ? "on" : "off");
+        s_power_save = save;
+        apply_power_save();
+    }
+#endif
+}
+
+bool wifi_power_save()
+{
+    return s_power_save;
+}
+
 /* -------------------------------------------------------------------------- */
 /*                              WiFi STA Mode                                 */
 /* -------------------------------------------------------------------------- */
@@ -178,21 +746,87 @@ void HalEsp32::startWifiAp()
 void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        mclog::tagInfo(TAG, "WiFi STA started, connecting...");
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAX_RETRY) {
+        // A saved round ranks the networks first. Started for the picker's scan only, there's nothing to join
+        if (s_saved_scan) {
+            s_saved_scan = false;
+            if (!s_hal_instance->wifi_next_saved(nullptr)) {
+                s_hal_instance->wifi_fail();
+            }
+        } else if (s_auto_reconnect) {
+            mclog::tagInfo(TAG, "WiFi STA started, connecting...");
             esp_wifi_connect();
-            s_retry_num++;
-            mclog::tagInfo(TAG, "Retry connecting to AP, attempt {}", s_retry_num);
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        if (s_hal_instance) {
+            s_hal_instance->wifi_set_step(hal::HalBase::WIFI_STEP_DHCP);
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_BSS_RSSI_LOW) {
+        roam_scan();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        if (s_scan_channel) {
+            scan_merge();
+        } else if (s_saved_scan) {
+            s_saved_scan = false;
+            saved_rank();
+            if (s_hal_instance && !s_hal_instance->wifi_next_saved(nullptr)) {
+                s_hal_instance->wifi_fail();
+            }
         } else {
-            if (s_wifi_event_group) {
-                xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            roam_pick();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        auto event = (wifi_event_sta_disconnected_t*)event_data;
+        if (!s_auto_reconnect) {
+            return;  // disconnectWifi(), or a connect stopping the last one
+        }
+        if (s_roaming) {
+            // Same network and most likely the same address, the state stays connected for the moment it takes
+            s_roaming = false;
+            esp_wifi_connect();
+            return;
+        }
+        if (s_hal_instance && s_hal_instance->_wifi_state == hal::HalBase::WIFI_CONNECTED) {
+            // Lost it: any AP of the network will do, the stream plays from its buffer in the meantime
+            mclog::tagWarn(TAG, "Connection lost (reason {}), reconnecting", event->reason);
+            wifi_config_t config;
+            esp_wifi_get_config(WIFI_IF_STA, &config);
+            config.sta.bssid_set = false;
+            config.sta.channel   = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &config);
+            s_retry_num              = 0;
+            link_set_ip("");
+            s_hal_instance->wifi_set_state(hal::HalBase::WIFI_CONNECTING);
+            s_hal_instance->wifi_set_step(hal::HalBase::WIFI_STEP_SCANNING);
+            esp_timer_stop(s_roam_timer);
+            esp_timer_start_once(s_connect_timer, WIFI_CONNECT_TIMEOUT_MS * 1000);
+        }
+        if (s_directed && s_from_saved && !s_saved_ranked) {
+            // The others may be around as well, one scan ranks them all
+            s_directed = false;
+            fast_connect_forget();
+            if (!s_hal_instance->wifi_next_saved(nullptr)) {
+                s_hal_instance->wifi_fail();
             }
+        } else if (s_directed) {
+            fast_connect_fall_back();  // Not counted as a retry
             if (s_hal_instance) {
-                s_hal_instance->_wifi_state = hal::HalBase::WIFI_FAILED;
+                s_hal_instance->wifi_set_step(hal::HalBase::WIFI_STEP_SCANNING);
+            }
+        } else if (s_retry_num < WIFI_MAX_RETRY) {
+            esp_wifi_connect();
+            s_retry_num++;
+            mclog::tagInfo(TAG, "Retry connecting to AP, attempt {} (reason {})", s_retry_num, event->reason);
+            // Anything but not finding it means the network is there and turned us away
+            if (s_hal_instance && s_hal_instance->_wifi_state == hal::HalBase::WIFI_CONNECTING) {
+                s_hal_instance->wifi_set_step(event->reason == WIFI_REASON_NO_AP_FOUND
+                                                  ? hal::HalBase::WIFI_STEP_SCANNING
+                                                  : hal::HalBase::WIFI_STEP_AUTHENTICATING);
+            }
+        } else if (s_hal_instance) {
+            mclog::tagWarn(TAG, "No connection to AP (reason {})", event->reason);
+            if (!s_hal_instance->wifi_next_saved(s_link.load().ssid.c_str())) {
+                s_hal_instance->wifi_fail();
             }
-            mclog::tagWarn(TAG, "Failed to connect to AP after {} attempts", WIFI_MAX_RETRY);
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
@@ -200,17 +834,66 @@ void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id
         snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&event->ip_info.ip));
 
         mclog::tagInfo(TAG, "Got IP: {}", ip_str);
+        esp_timer_stop(s_connect_timer);
+        esp_timer_stop(s_reconnect_timer);
+        s_backoff_ms = WIFI_BACKOFF_MIN_MS;
+        s_directed   = false;  // A later drop retries the same AP like any other
+        fast_connect_remember(event->ip_info);
+        if (s_hal_instance) {
+            saved_succeeded(s_link.load().ssid.c_str());
+        }
+        s_saved_ranked = false;  // A drop later on starts a new round
+        s_saved_candidates.clear();
+        esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI);
 
         if (s_hal_instance) {
-            s_hal_instance->_wifi_ip    = ip_str;
-            s_hal_instance->_wifi_state = hal::HalBase::WIFI_CONNECTED;
+            link_set_ip(ip_str);
+            s_hal_instance->wifi_set_state(hal::HalBase::WIFI_CONNECTED);
         }
 
         s_retry_num = 0;
         if (s_wifi_event_group) {
             xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         }
+
+        time_sync_start();
+
+        // A new network may hand out a new DNS server, and whatever was cached is stale anyway
+        if (s_hal_instance) {
+            s_hal_instance->radio_resolve_hosts();
+            s_hal_instance->radio_start_relay();
+#if CONFIG_TAB5_MULTIROOM_SYNC
+            sync_start();
+#endif
+#if CONFIG_TAB5_MQTT
+            mqtt_start();
+#endif
+        }
+    }
+}
+
+void wifi_connect_timeout(void* arg)
+{
+    if (!s_hal_instance || s_hal_instance->_wifi_state != hal::HalBase::WIFI_CONNECTING) {
+        return;
+    }
+    mclog::tagError(TAG, "Connection timeout for {}", s_link.load().ssid.c_str());
+    // No more retries, the disconnect this causes lands in the failure path as well
+    s_retry_num = WIFI_MAX_RETRY;
+    esp_wifi_disconnect();
+    if (!s_hal_instance->wifi_next_saved(s_link.load().ssid.c_str())) {
+        s_hal_instance->wifi_fail();
+    }
+}
+
+void HalEsp32::wifi_fail()
+{
+    esp_timer_stop(s_connect_timer);
+    if (s_wifi_event_group) {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
     }
+    wifi_set_state(WIFI_FAILED);
+    schedule_reconnect();
 }
 
 bool HalEsp32::wifi_sta_init()
@@ -269,6 +952,13 @@ bool HalEsp32::wifi_sta_init()
         return false;
     }
 
+    if (!create_timer(wifi_connect_timeout, "wifi_timeout", &s_connect_timer) ||
+        !create_timer(on_reconnect_timer, "wifi_reconnect", &s_reconnect_timer) ||
+        !create_timer(on_roam_timer, "wifi_roam", &s_roam_timer)) {
+        mclog::tagError(TAG, "Failed to create WiFi timers");
+        return false;
+    }
+
     // Register event handlers
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
@@ -300,23 +990,115 @@ bool HalEsp32::wifi_sta_init()
     return true;
 }
 
+void HalEsp32::wifi_set_state(WifiState_t state)
+{
+    if (state != WIFI_CONNECTING) {
+        wifi_set_step(WIFI_STEP_IDLE);
+    }
+    if (state != _wifi_state) {
+        _wifi_state = state;
+        hal_post_event(EVENT_WIFI_STATE, state);
+    }
+}
+
+void HalEsp32::wifi_set_step(WifiStep_t step)
+{
+    if (step != _wifi_step) {
+        _wifi_step = step;
+        hal_post_event(EVENT_WIFI_STEP, step);
+    }
+}
+
 hal::HalBase::WifiState_t HalEsp32::getWifiState()
 {
     return _wifi_state;
 }
 
+hal::HalBase::WifiStep_t HalEsp32::getWifiStep()
+{
+    return _wifi_step;
+}
+
 bool HalEsp32::connectWifiSta(const std::string& ssid, const std::string& password)
+{
+    if (!startWifiSta(ssid, password)) {
+        return false;
+    }
+
+    // The connect timer gives up first, this only guards against it never firing
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS + 1000));
+
+    if (bits & WIFI_CONNECTED_BIT) {
+        mclog::tagInfo(TAG, "Connected to {} with IP: {}", ssid, s_link.load().ip.c_str());
+        return true;
+    } else if (bits & WIFI_FAIL_BIT) {
+        mclog::tagError(TAG, "Failed to connect to {}", ssid);
+        return false;
+    } else {
+        mclog::tagError(TAG, "Connection timeout for {}", ssid);
+        wifi_set_state(WIFI_FAILED);
+        return false;
+    }
+}
+
+// The station's config for a network, and its address setup with it
+static void sta_config(const std::string& ssid, const std::string& password, wifi_config_t* config)
+{
+    *config = {};
+    strncpy((char*)config->sta.ssid, ssid.c_str(), sizeof(config->sta.ssid) - 1);
+    strncpy((char*)config->sta.password, password.c_str(), sizeof(config->sta.password) - 1);
+    config->sta.threshold.authmode = password.empty() ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+    config->sta.pmf_cfg.capable    = true;
+    config->sta.pmf_cfg.required   = false;
+
+    // Straight to the AP of the last connect when it was this network, the event handler scans if it's gone
+    s_directed = fast_connect_load(ssid);
+    if (s_directed) {
+        memcpy(config->sta.bssid, s_fast_connect.bssid, sizeof(config->sta.bssid));
+        config->sta.bssid_set = true;
+        config->sta.channel   = s_fast_connect.channel;
+        mclog::tagInfo(TAG, "Trying the last AP first, channel {}", s_fast_connect.channel);
+    }
+    apply_ip_config(s_directed ? &s_fast_connect : nullptr);
+}
+
+bool HalEsp32::startWifiSta(const std::string& ssid, const std::string& password)
+{
+    return wifi_start(ssid, password, false);
+}
+
+// An empty `ssid` scans for the saved networks instead, once the station is up
+bool HalEsp32::wifi_start(const std::string& ssid, const std::string& password, bool fromSaved)
 {
     if (!wifi_sta_init()) {
         return false;
     }
 
-    mclog::tagInfo(TAG, "Connecting to SSID: {}", ssid);
+    if (ssid.empty()) {
+        mclog::tagInfo(TAG, "Looking for the saved networks");
+    } else {
+        mclog::tagInfo(TAG, "Connecting to SSID: {}", ssid);
+    }
 
-    _wifi_state = WIFI_CONNECTING;
-    _wifi_ssid  = ssid;
-    _wifi_ip    = "";
+    // Whatever an earlier connect left behind
+    esp_timer_stop(s_connect_timer);
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_stop(s_roam_timer);
+    s_auto_reconnect = false;
+    s_roaming        = false;
+    s_backoff_ms     = WIFI_BACKOFF_MIN_MS;
+    s_from_saved     = fromSaved;
+    s_saved_scan     = ssid.empty();
+    s_saved_ranked   = false;
+    s_saved_candidates.clear();
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+
+    link_set_ssid(ssid);
+    link_set_ip("");
     s_retry_num = 0;
+    wifi_set_state(WIFI_CONNECTING);
+    wifi_set_step(WIFI_STEP_SCANNING);
 
     // Stop WiFi if already running
     if (s_wifi_started) {
@@ -325,115 +1107,437 @@ bool HalEsp32::connectWifiSta(const std::string& ssid, const std::string& passwo
     }
 
     // Configure WiFi
-    wifi_config_t wifi_config = {};
-    strncpy((char*)wifi_config.sta.ssid, ssid.c_str(), sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char*)wifi_config.sta.password, password.c_str(), sizeof(wifi_config.sta.password) - 1);
-    wifi_config.sta.threshold.authmode = password.empty() ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
-    wifi_config.sta.pmf_cfg.capable    = true;
-    wifi_config.sta.pmf_cfg.required   = false;
-
-    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_err_t ret = ESP_OK;
+    if (!ssid.empty()) {
+        wifi_config_t wifi_config;
+        sta_config(ssid, password, &wifi_config);
+        ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
     if (ret != ESP_OK) {
         mclog::tagError(TAG, "Failed to set WiFi config: {}", esp_err_to_name(ret));
-        _wifi_state = WIFI_FAILED;
+        wifi_set_state(WIFI_FAILED);
         return false;
     }
 
-    // Start WiFi
-    ret = esp_wifi_start();
+    // Start WiFi, it connects (or scans) once started
+    s_auto_reconnect = true;
+    ret              = esp_wifi_start();
     if (ret != ESP_OK) {
+        s_auto_reconnect = false;
+        s_saved_scan     = false;
         mclog::tagError(TAG, "Failed to start WiFi: {}", esp_err_to_name(ret));
-        _wifi_state = WIFI_FAILED;
+        wifi_set_state(WIFI_FAILED);
         return false;
     }
     s_wifi_started = true;
+    apply_power_save();
 
-    // Wait for connection with timeout (10 seconds)
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
-                                           pdMS_TO_TICKS(10000));
+    // Association and DHCP carry on in the WiFi event handler. The scan arms the timer with the network it picks
+    if (!ssid.empty()) {
+        esp_timer_start_once(s_connect_timer, WIFI_CONNECT_TIMEOUT_MS * 1000);
+    }
+    return true;
+}
 
-    if (bits & WIFI_CONNECTED_BIT) {
-        mclog::tagInfo(TAG, "Connected to {} with IP: {}", ssid, _wifi_ip);
-        return true;
-    } else if (bits & WIFI_FAIL_BIT) {
-        mclog::tagError(TAG, "Failed to connect to {}", ssid);
-        _wifi_state = WIFI_FAILED;
+// Next network of a saved round, on the running station
+void HalEsp32::wifi_join(const std::string& ssid, const std::string& password)
+{
+    mclog::tagInfo(TAG, "Trying saved network {}", ssid);
+    link_set_ssid(ssid);
+    s_retry_num = 0;
+    wifi_config_t config;
+    sta_config(ssid, password, &config);
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+    esp_wifi_connect();
+
+    // In the background the retries run out by themselves, the state stays failed meanwhile
+    if (_wifi_state == WIFI_CONNECTING) {
+        wifi_set_step(WIFI_STEP_SCANNING);
+        esp_timer_stop(s_connect_timer);
+        esp_timer_start_once(s_connect_timer, WIFI_CONNECT_TIMEOUT_MS * 1000);
+    }
+}
+
+// A network of the round didn't take us (`failed`, null if it was only its cached AP): scan to rank the rest if
+// this round hasn't yet, or join the next. False once there's nothing left to try
+bool HalEsp32::wifi_next_saved(const char* failed)
+{
+    if (!s_from_saved) {
         return false;
-    } else {
-        mclog::tagError(TAG, "Connection timeout for {}", ssid);
-        _wifi_state = WIFI_FAILED;
+    }
+    if (s_saved_scan) {
+        return true;  // Already ranking them
+    }
+    if (!s_saved_ranked) {
+        s_saved_skip = failed ? failed : "";
+        esp_timer_stop(s_connect_timer);
+        if (_wifi_state == WIFI_CONNECTING) {
+            wifi_set_step(WIFI_STEP_SCANNING);
+        }
+        if (saved_scan_start()) {
+            return true;
+        }
+        saved_rank();  // By their last success alone
+    }
+    if (s_saved_candidates.empty()) {
+        s_saved_ranked = false;  // The next round in the background starts over
         return false;
     }
+    SavedNetwork_t next = s_saved_candidates.front();
+    s_saved_candidates.erase(s_saved_candidates.begin());
+    wifi_join(next.ssid, next.password);
+    return true;
+}
+
+bool HalEsp32::startSavedWifi()
+{
+    SavedNetwork_t latest = {};
+    {
+        std::lock_guard<std::mutex> lock(s_saved_mutex);
+        saved_load();
+        if (s_saved.empty()) {
+            return false;
+        }
+        for (const auto& saved : s_saved) {
+            if (saved.lastSuccess > latest.lastSuccess) {
+                latest = saved;
+            }
+        }
+    }
+
+    // Probing the AP of the last join is quicker than any scan, the scan only runs should it be gone
+    if (latest.lastSuccess && fast_connect_load(latest.ssid)) {
+        return wifi_start(latest.ssid, latest.password, true);
+    }
+    return wifi_start("", "", true);
+}
+
+bool HalEsp32::connectSavedWifi()
+{
+    if (!startSavedWifi()) {
+        return false;
+    }
+
+    // Each network has its connect timeout, this only guards against none of them firing
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS * (WIFI_SAVED_MAX + 1)));
+    if (bits & WIFI_CONNECTED_BIT) {
+        WifiLink_t link = s_link.load();
+        mclog::tagInfo(TAG, "Connected to {} with IP: {}", link.ssid.c_str(), link.ip.c_str());
+        return true;
+    }
+    mclog::tagError(TAG, "None of the saved networks took us");
+    if (!(bits & WIFI_FAIL_BIT)) {
+        wifi_set_state(WIFI_FAILED);
+    }
+    return false;
 }
 
 void HalEsp32::disconnectWifi()
 {
     if (s_wifi_started) {
         mclog::tagInfo(TAG, "Disconnecting WiFi");
+        s_auto_reconnect = false;
+        s_from_saved     = false;
+        s_saved_scan     = false;
+        esp_timer_stop(s_connect_timer);
+        esp_timer_stop(s_reconnect_timer);
+        esp_timer_stop(s_roam_timer);
         esp_wifi_disconnect();
-        _wifi_state = WIFI_DISCONNECTED;
-        _wifi_ip    = "";
+        link_set_ip("");
+        wifi_set_state(WIFI_DISCONNECTED);
     }
 }
 
-std::string HalEsp32::getWifiIp()
+hal::HalBase::WifiIp_t HalEsp32::getWifiIp()
 {
-    return _wifi_ip;
+    return s_link.load().ip;
 }
 
-std::string HalEsp32::getWifiSsid()
+hal::HalBase::WifiSsid_t HalEsp32::getWifiSsid()
 {
-    return _wifi_ssid;
+    return s_link.load().ssid;
 }
 
 void HalEsp32::saveWifiConfig(const std::string& ssid, const std::string& password)
 {
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_WIFI_NAMESPACE, NVS_READWRITE, &handle);
-    if (ret != ESP_OK) {
-        mclog::tagError(TAG, "Failed to open NVS: {}", esp_err_to_name(ret));
-        return;
+    std::lock_guard<std::mutex> lock(s_saved_mutex);
+    saved_load();
+
+    SavedNetwork_t saved = {};
+    auto it = std::find_if(s_saved.begin(), s_saved.end(), [&](const auto& s) { return ssid == s.ssid; });
+    if (it != s_saved.end()) {
+        saved = *it;  // Keeps its last success
+        s_saved.erase(it);
+    } else if (s_saved.size() >= WIFI_SAVED_MAX) {
+        // Full: the one joined longest ago makes room
+        auto oldest = std::min_element(s_saved.begin(), s_saved.end(),
+                                       [](const auto& a, const auto& b) { return a.lastSuccess < b.lastSuccess; });
+        mclog::tagInfo(TAG, "Forgetting saved network {}", oldest->ssid);
+        s_saved.erase(oldest);
     }
+    strncpy(saved.ssid, ssid.c_str(), sizeof(saved.ssid) - 1);
+    memset(saved.password, 0, sizeof(saved.password));
+    strncpy(saved.password, password.c_str(), sizeof(saved.password) - 1);
+    s_saved.insert(s_saved.begin(), saved);
+    saved_store();
 
-    nvs_set_str(handle, "ssid", ssid.c_str());
-    nvs_set_str(handle, "password", password.c_str());
-    nvs_commit(handle);
-    nvs_close(handle);
-
-    mclog::tagInfo(TAG, "WiFi config saved for SSID: {}", ssid);
+    mclog::tagInfo(TAG, "WiFi config saved for SSID: {}, {} saved", ssid, s_saved.size());
 }
 
 bool HalEsp32::loadWifiConfig(std::string& ssid, std::string& password)
 {
-    nvs_handle_t handle;
-    esp_err_t ret = nvs_open(NVS_WIFI_NAMESPACE, NVS_READONLY, &handle);
-    if (ret != ESP_OK) {
+    std::lock_guard<std::mutex> lock(s_saved_mutex);
+    saved_load();
+    if (s_saved.empty()) {
         mclog::tagInfo(TAG, "No saved WiFi config found");
         return false;
     }
 
-    char ssid_buf[64]     = {0};
-    char password_buf[64] = {0};
-    size_t ssid_len       = sizeof(ssid_buf);
-    size_t password_len   = sizeof(password_buf);
+    ssid     = s_saved.front().ssid;
+    password = s_saved.front().password;
+    mclog::tagInfo(TAG, "Loaded WiFi config for SSID: {}", ssid);
+    return true;
+}
 
-    ret = nvs_get_str(handle, "ssid", ssid_buf, &ssid_len);
-    if (ret != ESP_OK) {
-        nvs_close(handle);
+/* -------------------------------------------------------------------------- */
+/*                                 HTTP Client                                */
+/* -------------------------------------------------------------------------- */
+// The station list, artwork and track lookups share a few keep-alive clients by origin: the next GET to a host goes
+// out on the connection the last one left open, without DNS, TCP or a TLS handshake, and the client's buffers are
+// allocated once. A connection the server closed meanwhile costs one retry on a fresh client. At most
+// HTTP_MAX_REQUESTS run at once, the rest wait their turn, so background fetches only ever take that much airtime
+// and internal RAM from the stream. The HTTP client has one request in flight per connection, requests to a host
+// follow each other on it rather than being pipelined
+#define HTTP_GET_CHUNK      2048
+#define HTTP_GET_TIMEOUT_MS 10000
+#define HTTP_POOL_SIZE      3      // Idle connections kept
+#define HTTP_POOL_IDLE_MS   15000  // About when servers close an idle keep-alive connection themselves
+#define HTTP_MAX_REQUESTS   2
+
+struct PooledClient_t {
+    std::string origin;  // scheme://host:port
+    esp_http_client_handle_t client = nullptr;
+    std::unique_ptr<char[]> chunk;
+    uint32_t idleSince = 0;
+    bool reused        = false;  // Taken from the pool rather than new
+};
+
+static std::mutex s_http_mutex;
+static std::condition_variable s_http_turn;
+static std::vector<PooledClient_t> s_http_pool;  // Idle, oldest first
+static int s_http_requests = 0;
+
+static metrics::Counter s_metric_http_reused("http_requests_total", "GETs outside the stream",
+                                             "connection=\"reused\"");
+static metrics::Counter s_metric_http_new("http_requests_total", "GETs outside the stream", "connection=\"new\"");
+
+static std::string http_origin(const std::string& url)
+{
+    size_t host = url.find("://");
+    host        = (host == std::string::npos) ? 0 : host + 3;
+    return url.substr(0, url.find_first_of("/?#", host));
+}
+
+static uint32_t http_now()
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief An idle connection to `url`'s origin, or a new client for it. Waits while HTTP_MAX_REQUESTS run
+ */
+static PooledClient_t http_take(const std::string& url, bool fresh)
+{
+    std::string origin = http_origin(url);
+    PooledClient_t pooled;
+    std::vector<esp_http_client_handle_t> expired;
+    {
+        std::unique_lock<std::mutex> lock(s_http_mutex);
+        s_http_turn.wait(lock, []() { return s_http_requests < HTTP_MAX_REQUESTS; });
+        s_http_requests++;
+
+        uint32_t now = http_now();
+        for (auto it = s_http_pool.begin(); it != s_http_pool.end();) {
+            if (now - it->idleSince >= HTTP_POOL_IDLE_MS) {
+                expired.push_back(it->client);
+                it = s_http_pool.erase(it);
+            } else if (!fresh && !pooled.client && it->origin == origin) {
+                pooled = std::move(*it);
+                it     = s_http_pool.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto client : expired) {
+        esp_http_client_cleanup(client);
+    }
+    if (pooled.client) {
+        esp_http_client_set_url(pooled.client, url.c_str());
+        pooled.reused = true;
+        s_metric_http_reused.inc();
+        return pooled;
+    }
+
+    esp_http_client_config_t config = {};
+    config.url                      = url.c_str();
+    config.timeout_ms               = HTTP_GET_TIMEOUT_MS;
+    config.crt_bundle_attach        = esp_crt_bundle_attach;
+    config.keep_alive_enable        = true;
+    config.save_client_session      = url.find("https://") == 0;  // A new connection resumes the TLS session
+    pooled.origin                   = origin;
+    pooled.client                   = esp_http_client_init(&config);
+    pooled.chunk.reset(new (std::nothrow) char[HTTP_GET_CHUNK]);
+    if (pooled.client) {
+        esp_http_client_set_header(pooled.client, "User-Agent", "Tab5-WebRadio/1.0");
+    }
+    s_metric_http_new.inc();
+    return pooled;
+}
+
+/**
+ * @brief Done with it: kept open for the next request to the same origin if `reusable`, the oldest idle one is
+ * closed to make room
+ */
+static void http_give(PooledClient_t pooled, bool reusable)
+{
+    esp_http_client_handle_t evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_http_mutex);
+        s_http_requests--;
+        if (reusable && pooled.client && pooled.chunk) {
+            if (s_http_pool.size() >= HTTP_POOL_SIZE) {
+                evicted = s_http_pool.front().client;
+                s_http_pool.erase(s_http_pool.begin());
+            }
+            pooled.idleSince = http_now();
+            s_http_pool.push_back(std::move(pooled));
+            pooled.client = nullptr;
+        }
+    }
+    s_http_turn.notify_one();
+    if (evicted) {
+        esp_http_client_cleanup(evicted);
+    }
+    if (pooled.client) {
+        esp_http_client_close(pooled.client);
+        esp_http_client_cleanup(pooled.client);
+    }
+}
+
+bool HalEsp32::httpGet(const std::string& url, std::function<bool(const char* data, size_t len)> onData)
+{
+    if (_wifi_state != WIFI_CONNECTED) {
         return false;
     }
 
-    ret = nvs_get_str(handle, "password", password_buf, &password_len);
-    if (ret != ESP_OK) {
-        // Password might be empty for open networks
-        password_buf[0] = '\0';
+    for (int attempt = 0; attempt < 2; attempt++) {
+        PooledClient_t pooled = http_take(url, attempt > 0);
+        if (!pooled.client || !pooled.chunk) {
+            mclog::tagError(TAG, "Failed to init HTTP client");
+            http_give(std::move(pooled), false);
+            return false;
+        }
+
+        bool ok       = false;
+        bool complete = false;
+        esp_err_t err = esp_http_client_open(pooled.client, 0);
+        if (err == ESP_OK && esp_http_client_fetch_headers(pooled.client) >= 0) {
+            int status = esp_http_client_get_status_code(pooled.client);
+            if (status == 200) {
+                int len;
+                ok = true;
+                while (ok && (len = esp_http_client_read(pooled.client, pooled.chunk.get(), HTTP_GET_CHUNK)) > 0) {
+                    ok = onData(pooled.chunk.get(), len);
+                }
+                complete = esp_http_client_is_complete_data_received(pooled.client);
+                ok       = ok && complete;
+            } else {
+                mclog::tagWarn(TAG, "HTTP {} for {}", status, url);
+            }
+        } else if (pooled.reused) {
+            // The server closed it while it sat in the pool, nothing was handed out yet
+            http_give(std::move(pooled), false);
+            continue;
+        } else {
+            mclog::tagWarn(TAG, "GET {} failed: {}", url, esp_err_to_name(err));
+        }
+
+        // Only a body read to its end leaves the connection ready for the next request
+        http_give(std::move(pooled), complete);
+        return ok;
     }
+    return false;
+}
 
-    nvs_close(handle);
+/* -------------------------------------------------------------------------- */
+/*                             Network Benchmark                              */
+/* -------------------------------------------------------------------------- */
+#define NET_BENCH_CHUNK (16 * 1024)
+
+// Run time all idle tasks got, and the time that passed on each core meanwhile
+static void idle_run_time(configRUN_TIME_COUNTER_TYPE* idle, configRUN_TIME_COUNTER_TYPE* total)
+{
+    *idle = 0;
+    for (int core = 0; core < configNUMBER_OF_CORES; core++) {
+        *idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+    *total = portGET_RUN_TIME_COUNTER_VALUE() * configNUMBER_OF_CORES;
+}
 
-    ssid     = ssid_buf;
-    password = password_buf;
+bool HalEsp32::runNetworkBenchmark(const std::string& url, uint32_t seconds, NetBenchmark_t* result)
+{
+    *result = {};
+    if (_wifi_state != WIFI_CONNECTED) {
+        mclog::tagWarn(TAG, "Network benchmark: no WiFi");
+        return false;
+    }
 
-    mclog::tagInfo(TAG, "Loaded WiFi config for SSID: {}", ssid);
-    return !ssid.empty();
+    esp_http_client_config_t config = {};
+    config.url                      = url.c_str();
+    config.timeout_ms               = HTTP_GET_TIMEOUT_MS;
+    config.buffer_size              = NET_BENCH_CHUNK;
+    config.crt_bundle_attach        = esp_crt_bundle_attach;
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    std::unique_ptr<char[]> chunk(new (std::nothrow) char[NET_BENCH_CHUNK]);
+    if (!client || !chunk) {
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        return false;
+    }
+
+    bool ok       = false;
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK && esp_http_client_fetch_headers(client) >= 0 && esp_http_client_get_status_code(client) == 200) {
+        configRUN_TIME_COUNTER_TYPE idleStart, totalStart, idleEnd, totalEnd;
+        idle_run_time(&idleStart, &totalStart);
+        int64_t start = esp_timer_get_time();
+        int64_t end   = start + (int64_t)seconds * 1000000;
+
+        int len;
+        while (esp_timer_get_time() < end && (len = esp_http_client_read(client, chunk.get(), NET_BENCH_CHUNK)) > 0) {
+            result->bytes += len;
+        }
+
+        idle_run_time(&idleEnd, &totalEnd);
+        result->seconds = (esp_timer_get_time() - start) / 1e6f;
+        result->mbps    = result->seconds > 0 ? result->bytes * 8 / 1e6f / result->seconds : 0;
+        if (totalEnd > totalStart) {
+            result->cpuPercent = 100.0f - 100.0f * (float)(idleEnd - idleStart) / (float)(totalEnd - totalStart);
+        }
+        ok = result->bytes > 0;
+    } else {
+        mclog::tagWarn(TAG, "Network benchmark: GET {} failed: {}", url, esp_err_to_name(err));
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    if (ok) {
+        mclog::tagInfo(TAG, "Network benchmark: {} KB in {:.1f} s, {:.1f} Mbit/s, CPU {:.1f}%", result->bytes / 1024,
+                       result->seconds, result->mbps, result->cpuPercent);
+    }
+    return ok;
 }
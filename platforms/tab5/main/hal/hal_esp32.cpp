@@ -7,17 +7,45 @@
 extern "C" {
 #include "utils/rx8130/rx8130.h"
 }
+#include "utils/task_topology/task_topology.h"
+#include <hal/event_bus.h>
+#include <hal/metrics.h>
 #include <mooncake_log.h>
+#include <atomic>
+#include <mutex>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
 #include <bsp/m5stack_tab5.h>
+#include <nvs.h>
+#include <esp_partition.h>
+#include <esp_spiffs.h>
 #include <lv_demos.h>
+#include <esp_pm.h>
+#include <esp_netif_sntp.h>
+#include <esp_sntp.h>
 
 extern esp_lcd_touch_handle_t _lcd_touch_handle;
 
 static const std::string _tag = "hal";
 
+// The app loop renders and then sleeps until the panel's next refresh. LVGL's own refresh timer only backs that
+// up, for when the app loop is busy
+static constexpr uint32_t LVGL_REFR_FALLBACK_MS = 100;
+static TaskHandle_t s_frame_task                = nullptr;  // Waiting in waitDisplayFrame()
+static TaskHandle_t s_wake_task                 = nullptr;  // Sleeping in waitWake()
+
+static bool IRAM_ATTR on_display_refresh(lv_display_t* disp, void* userCtx)
+{
+    BaseType_t woken  = pdFALSE;
+    TaskHandle_t task = s_frame_task;
+    if (task) {
+        vTaskNotifyGiveFromISR(task, &woken);
+    }
+    return woken == pdTRUE;
+}
+
 static void lvgl_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
 {
     if (_lcd_touch_handle == NULL) {
@@ -44,17 +72,58 @@ static void lvgl_read_cb(lv_indev_t* indev, lv_indev_data_t* data)
     }
 }
 
+/* -------------------------------------------------------------------------- */
+/*                                    Boot                                    */
+/* -------------------------------------------------------------------------- */
+// The critical path is what the first frame and the radio need: power, the codec, the file systems, the RTC and the
+// display. The rest (telemetry, USB, RS485) comes up on a task of its own next to it, and the camera oscillator only
+// once the camera starts. Each phase is logged with its time, each path's total ends in a gauge
+static metrics::Gauge s_boot_critical("boot_seconds", "Time HalEsp32::init took, per path", "path=\"critical\"");
+static metrics::Gauge s_boot_deferred("boot_seconds", "Time HalEsp32::init took, per path", "path=\"deferred\"");
+static TaskHandle_t s_boot_deferred_task = nullptr;
+
+class BootClock {
+public:
+    explicit BootClock(const char* path) : _path(path), _start(esp_timer_get_time()), _last(_start)
+    {
+    }
+
+    void phase(const char* name)
+    {
+        int64_t now = esp_timer_get_time();
+        mclog::tagInfo(_tag, "boot {}: {} in {} ms", _path, name, (now - _last) / 1000);
+        _last = now;
+    }
+
+    void done(metrics::Gauge& gauge)
+    {
+        int64_t now = esp_timer_get_time();
+        gauge.set((now - _start) / 1e6f);
+        mclog::tagInfo(_tag, "boot {}: done in {} ms, {} ms since reset", _path, (now - _start) / 1000, now / 1000);
+    }
+
+private:
+    const char* _path;
+    int64_t _start;
+    int64_t _last;
+};
+
+static void boot_deferred_task(void* param)
+{
+    ((HalEsp32*)param)->deferred_init();
+    s_boot_deferred_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
 void HalEsp32::init()
 {
     mclog::tagInfo(_tag, "init");
+    BootClock clock("critical");
+    warm_restart_init();
+    memory_init();
+    clock.phase("memory");
 
-    mclog::tagInfo(_tag, "camera init");
-    bsp_cam_osc_init();
-
-    mclog::tagInfo(_tag, "i2c init");
     bsp_i2c_init();
-
-    mclog::tagInfo(_tag, "io expander init");
     i2c_master_bus_handle_t i2c_bus_handle = bsp_i2c_get_handle();
     bsp_io_expander_pi4ioe_init(i2c_bus_handle);
 
@@ -62,34 +131,60 @@ void HalEsp32::init()
     delay(50);
     setChargeEnable(true);
     // setChargeEnable(false);
+    clock.phase("i2c and io expander");
 
-    mclog::tagInfo(_tag, "i2c scan");
-    bsp_i2c_scan();
+    // From here on the deferred half runs alongside, on the audio core nothing plays on yet
+    if (task_topology::create(task_topology::BOOT_DEFERRED, boot_deferred_task, this, &s_boot_deferred_task) !=
+        pdPASS) {
+        mclog::tagError(_tag, "no deferred init task, it runs after the display");
+        s_boot_deferred_task = nullptr;
+    }
 
-    mclog::tagInfo(_tag, "codec init");
     delay(200);
     bsp_codec_init();
+    audio_mixer_init();
+    clock.phase("codec");
 
-    mclog::tagInfo(_tag, "imu init");
-    imu_init();
+    _data_mounted = bsp_spiffs_mount() == ESP_OK;
+    sdcard_start();
 
-    mclog::tagInfo(_tag, "ina226 init");
-    ina226.begin(i2c_bus_handle, 0x41);
-    ina226.configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US,
-                     INA226_MODE_SHUNT_BUS_CONT);
-    ina226.calibrate(0.005, 8.192);
-    mclog::tagInfo(_tag, "bus voltage: {}", ina226.readBusVoltage());
+    // The packed images, flashed with the build and never written
+    esp_vfs_spiffs_conf_t assets_conf = {};
+    assets_conf.base_path             = "/assets";
+    assets_conf.partition_label       = "assets";
+    assets_conf.max_files             = 3;  // LVGL's images, and the web remote's page
+    _assets_mounted                   = esp_vfs_spiffs_register(&assets_conf) == ESP_OK;
+    clock.phase("spiffs");
 
-    mclog::tagInfo(_tag, "rx8130 init");
-    rx8130.begin(i2c_bus_handle, 0x32);
-    rx8130.initBat();
+    // Early, the app decides on the alarm screen from it
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        rx8130.begin(i2c_bus_handle, 0x32);
+        rx8130.initBat();
+        _woke_by_alarm = rx8130.alarmFired();
+    }
+    if (_woke_by_alarm) {
+        mclog::tagInfo(_tag, "woken by the rtc alarm");
+    }
     clearRtcIrq();
     update_system_time();
+    clock.phase("rtc");
 
-    mclog::tagInfo(_tag, "display init");
     bsp_reset_tp();
+    // Full frames in PSRAM, or stripes of whole rows (the longer side, so either orientation) in internal SRAM. With
+    // BSP_DISPLAY_LVGL_AVOID_TEAR LVGL draws into the panel's own frame buffers instead, and these go unused
+#if CONFIG_BSP_DISPLAY_LVGL_AVOID_TEAR && !CONFIG_TAB5_DISPLAY_NATIVE_PORTRAIT
+#error "Rendering into the panel's frame buffers leaves no pass to rotate in, it takes TAB5_DISPLAY_NATIVE_PORTRAIT"
+#endif
+#if CONFIG_TAB5_DISPLAY_BUFFER_LINES > 0
+    constexpr uint32_t draw_buffer_size = BSP_LCD_V_RES * CONFIG_TAB5_DISPLAY_BUFFER_LINES;
+    constexpr bool draw_buffer_spiram   = false;
+#else
+    constexpr uint32_t draw_buffer_size = BSP_LCD_H_RES * BSP_LCD_V_RES;
+    constexpr bool draw_buffer_spiram   = true;
+#endif
     bsp_display_cfg_t cfg = {.lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
-                             .buffer_size   = BSP_LCD_H_RES * BSP_LCD_V_RES,
+                             .buffer_size   = draw_buffer_size,
                              .double_buffer = true,
                              .flags         = {
 #if CONFIG_BSP_LCD_COLOR_FORMAT_RGB888
@@ -97,33 +192,106 @@ void HalEsp32::init()
 #else
                                  .buff_dma = true,
 #endif
-                                 .buff_spiram = true,
-                                 .sw_rotate   = true,
+                                 .buff_spiram = draw_buffer_spiram,
+#if CONFIG_TAB5_DISPLAY_NATIVE_PORTRAIT
+                                 .sw_rotate = false,
+#else
+                                 .sw_rotate = true,
+#endif
                              }};
-    lvDisp = bsp_display_start_with_config(&cfg);
+    cfg.lvgl_port_cfg.task_priority = task_topology::LVGL.priority;
+    cfg.lvgl_port_cfg.task_stack    = task_topology::LVGL.stackSize;
+    cfg.lvgl_port_cfg.task_affinity = task_topology::LVGL.core;
+    lvDisp                          = bsp_display_start_with_config(&cfg);
+#if !CONFIG_TAB5_DISPLAY_NATIVE_PORTRAIT
+    // The DSI panel scans out 720x1280 and can't swap axes, landscape is rotated by PPA per flushed area
     lv_display_set_rotation(lvDisp, LV_DISPLAY_ROTATION_90);
+#endif
     bsp_display_backlight_on();
+    perf_attach_display(lvDisp);
+    jpeg_image_decoder_init();
+    ppa_draw_unit_init();
+    display_power_init(lvDisp);
+    touch_start(bsp_display_get_input_dev());
+    if (lvgl_port_disp_register_refresh_cb(lvDisp, on_display_refresh, nullptr) == ESP_OK) {
+        lv_timer_set_period(lv_display_get_refr_timer(lvDisp), LVGL_REFR_FALLBACK_MS);
+    }
+#if CONFIG_TAB5_LVGL_IMAGE_CACHE_FRAMES > 0
+    // In screens of this display, a cache this size lands in the LVGL heap's PSRAM regions
+    uint32_t screen_bytes = lv_display_get_horizontal_resolution(lvDisp) * lv_display_get_vertical_resolution(lvDisp) *
+                            lv_color_format_get_size(lv_display_get_color_format(lvDisp));
+    lv_image_cache_resize(CONFIG_TAB5_LVGL_IMAGE_CACHE_FRAMES * screen_bytes, false);
+#endif
 
-    // // Touchpad lvgl indev
-    // mclog::tagInfo(_tag, "create lvgl touchpad indev");
-    // lvTouchpad = lv_indev_create();
-    // lv_indev_set_type(lvTouchpad, LV_INDEV_TYPE_POINTER);
-    // lv_indev_set_read_cb(lvTouchpad, lvgl_read_cb);
-    // lv_indev_set_display(lvTouchpad, lvDisp);
+    clock.phase("display");
 
-    mclog::tagInfo(_tag, "usb host init");
-    bsp_usb_host_start(BSP_USB_HOST_POWER_MODE_USB_DEV, true);
+#if CONFIG_TAB5_KEYPAD
+    lvKeyboard = keypad_start();
+    clock.phase("keypad");
+#endif
 
-    mclog::tagInfo(_tag, "hid init");
-    hid_init();
+    set_gpio_output_capability();
+    bsp_display_unlock();
+
+    clock.done(s_boot_critical);
+
+    // The deferred half has its own LVGL bits left, for the mouse
+    if (s_boot_deferred_task) {
+        xTaskNotifyGive(s_boot_deferred_task);
+    } else {
+        deferred_init();
+    }
+}
+
+void HalEsp32::deferred_init()
+{
+    BootClock clock("deferred");
+    i2c_master_bus_handle_t i2c_bus_handle = bsp_i2c_get_handle();
+
+    imu_init();  // Holds the bus itself
+    clock.phase("imu");
+
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+        ina226.begin(i2c_bus_handle, 0x41);
+        ina226.configure(INA226_AVERAGES_64, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US,
+                         INA226_MODE_SHUNT_BUS_CONT);
+        ina226.calibrate(0.005, 8.192);
+        mclog::tagInfo(_tag, "bus voltage: {}", ina226.readBusVoltage());
+    }
+    power_monitor_start(&ina226);
+    clock.phase("ina226");
+
+    headphone_init();
+    clock.phase("headphone jack");
 
-    mclog::tagInfo(_tag, "rs485 init");
     rs485_init();
+    clock.phase("rs485");
 
-    mclog::tagInfo(_tag, "set gpio output capability");
-    set_gpio_output_capability();
+    bsp_usb_host_start(BSP_USB_HOST_POWER_MODE_USB_DEV, true);
+#if CONFIG_TAB5_USB_AUDIO
+    usb_audio_start();
+#endif
+    clock.phase("usb host");
 
-    bsp_display_unlock();
+    // The mouse cursor goes on the screen, once there is one
+    if (s_boot_deferred_task) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    lvgl_lock(LVGL_LOCK_HAL);
+    hid_init();
+    lvgl_unlock();
+    clock.phase("hid");
+
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::SCAN);
+        bsp_i2c_scan();
+    }
+    clock.phase("i2c scan");
+    clock.done(s_boot_deferred);
+
+    // Everything came up, a new firmware stays
+    firmware_update_confirm();
 }
 
 static const gpio_num_t _driver_gpios[] = {
@@ -206,6 +374,80 @@ int HalEsp32::getCpuTemp()
     return temp;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                                 Background                                 */
+/* -------------------------------------------------------------------------- */
+// A few jobs are long (a download, a fast resume waiting for WiFi), the rest are short and shouldn't queue behind them
+#define BACKGROUND_WORKERS 3
+#define BACKGROUND_QUEUE   16
+
+struct BackgroundJob_t {
+    std::function<void()> job;
+    std::function<void()> done;  // On the LVGL thread
+};
+
+static QueueHandle_t s_background_queue = nullptr;
+
+static void background_done(void* param)
+{
+    // LVGL's async calls run from its timer handler, with the lock held
+    auto job = (BackgroundJob_t*)param;
+    job->done();
+    delete job;
+}
+
+static void background_run(BackgroundJob_t* job)
+{
+    job->job();
+    if (!job->done) {
+        delete job;
+        return;
+    }
+    lvgl_lock(hal::HalBase::LVGL_LOCK_HAL);
+    if (lv_async_call(background_done, job) != LV_RESULT_OK) {
+        job->done();
+        delete job;
+    }
+    lvgl_unlock();
+}
+
+static void background_worker(void* param)
+{
+    BackgroundJob_t* job = nullptr;
+    while (true) {
+        if (xQueueReceive(s_background_queue, &job, portMAX_DELAY) == pdTRUE) {
+            background_run(job);
+        }
+    }
+}
+
+static void background_task(void* param)
+{
+    background_run((BackgroundJob_t*)param);
+    vTaskDelete(nullptr);
+}
+
+void HalEsp32::runInBackground(std::function<void()> job, std::function<void()> done)
+{
+    if (!s_background_queue) {
+        s_background_queue = xQueueCreate(BACKGROUND_QUEUE, sizeof(BackgroundJob_t*));
+        for (int i = 0; s_background_queue && i < BACKGROUND_WORKERS; i++) {
+            task_topology::create(task_topology::BACKGROUND, background_worker, nullptr, nullptr);
+        }
+    }
+
+    // With the queue full the job gets a task of its own rather than blocking the caller
+    auto pending = new BackgroundJob_t{std::move(job), std::move(done)};
+    if (s_background_queue && xQueueSend(s_background_queue, &pending, 0) == pdTRUE) {
+        return;
+    }
+    mclog::tagWarn(_tag, "background workers busy, starting a task for the job");
+    if (task_topology::create(task_topology::BACKGROUND, background_task, pending, nullptr) != pdPASS) {
+        mclog::tagError(_tag, "failed to start background job");
+        delete pending;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /*                                   Display                                  */
 /* -------------------------------------------------------------------------- */
@@ -221,14 +463,290 @@ uint8_t HalEsp32::getDisplayBrightness()
     return _current_lcd_brightness;
 }
 
+static void render_now(lv_display_t* disp)
+{
+    // Render now instead of on LVGL's timer, a refresh with no invalidated area returns straight away
+    lvgl_lock(hal::HalBase::LVGL_LOCK_HAL);
+    lv_timer_ready(lv_display_get_refr_timer(disp));
+    lvgl_unlock();
+    lvgl_port_task_wake(LVGL_PORT_EVENT_DISPLAY, nullptr);
+}
+
+bool HalEsp32::waitDisplayFrame(uint32_t timeoutMs)
+{
+    render_now(lvDisp);
+    s_frame_task   = xTaskGetCurrentTaskHandle();
+    bool refreshed = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+    s_frame_task   = nullptr;  // A sleep in waitWake() isn't woken by each refresh
+    return refreshed;
+}
+
+bool HalEsp32::waitWake(uint32_t timeoutMs)
+{
+    render_now(lvDisp);
+    s_wake_task = xTaskGetCurrentTaskHandle();
+    bool woken  = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+    s_wake_task = nullptr;
+    return woken;
+}
+
+void app_wake()
+{
+    TaskHandle_t task = s_wake_task;
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  CPU clock                                 */
+/* -------------------------------------------------------------------------- */
+// With TAB5_SCREEN_OFF_DFS the CPU runs at a floor sized for the radio and goes to full speed only for what can't
+// wait on it: LVGL's renders, from start until the frame is flushed (the whole time the display is on without
+// TAB5_RENDER_DFS), and cpu_boost() holders such as the camera. The floor is the slowest clock at which the decoder's
+// cycles over the last DFS_CHECK_MS take at most DFS_MAX_LOAD_PERCENT of a core, never below TAB5_SCREEN_OFF_CPU_MHZ.
+// An underrun at a lowered floor raises it a step, and keeps it at least there for DFS_UNDERRUN_HOLD_MS.
+// cpu_floor_mhz and the energy per power state on /metrics show what it saves
+#define DFS_CHECK_MS         2000
+#define DFS_MAX_LOAD_PERCENT 60  // Of a core, the rest is headroom for bursts and the network
+#define DFS_UNDERRUN_HOLD_MS 60000
+
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+static const int DFS_STEPS_MHZ[] = {40, 60, 90, 120, 180, 360};  // 360 divided by a whole number, and the crystal
+
+static metrics::Gauge s_cpu_floor("cpu_floor_mhz", "The CPU clock between renders, sized for the radio's decoder");
+
+static struct {
+    esp_pm_lock_handle_t displayLock = nullptr;  // The display is on, without TAB5_RENDER_DFS
+    esp_pm_lock_handle_t renderLock  = nullptr;  // A render until its frame is flushed
+    esp_pm_lock_handle_t boostLock   = nullptr;  // cpu_boost(), counted
+    bool rendering                   = false;    // LVGL's task only
+    esp_timer_handle_t timer         = nullptr;
+    // On the esp_timer task only
+    int floorMhz       = 0;
+    int heldMhz        = 0;  // Raised after an underrun, until heldUntil
+    int64_t heldUntil  = 0;
+    uint32_t kcycles   = 0;  // radio_decode_busy_kcycles() at the last check
+    uint32_t underruns = 0;
+    int64_t checkedAt  = 0;
+} s_clock;
+
+static int dfs_step_above(float mhz)
+{
+    for (int step : DFS_STEPS_MHZ) {
+        if (step >= mhz && step >= CONFIG_TAB5_SCREEN_OFF_CPU_MHZ && step <= CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ) {
+            return step;
+        }
+    }
+    return CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+}
+
+static void set_floor(int mhz, float neededMhz)
+{
+    esp_pm_config_t config    = {};
+    config.max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    config.min_freq_mhz       = mhz;
+    config.light_sleep_enable = false;
+    esp_err_t ret             = esp_pm_configure(&config);
+    if (ret != ESP_OK) {
+        mclog::tagWarn(_tag, "cpu floor {} MHz refused: {}", mhz, esp_err_to_name(ret));
+        return;
+    }
+    s_clock.floorMhz = mhz;
+    s_cpu_floor.set(mhz);
+    mclog::tagInfo(_tag, "cpu floor {} MHz, the decoder needs {:.0f}, {} underruns so far", mhz, neededMhz,
+                   s_clock.underruns);
+}
+
+// On the esp_timer task
+static void dfs_check(void* arg)
+{
+    uint32_t kcycles   = radio_decode_busy_kcycles();
+    uint32_t underruns = GetHAL()->getRadioOutputStats().underruns;
+    int64_t now        = esp_timer_get_time();
+    if (s_clock.checkedAt > 0 && now > s_clock.checkedAt) {
+        // Cycles per microsecond are the MHz it takes, at whichever clocks it ran
+        float needed = (uint32_t)(kcycles - s_clock.kcycles) * 1024.0f / (now - s_clock.checkedAt);
+        int floor    = dfs_step_above(needed * 100 / DFS_MAX_LOAD_PERCENT);
+        if (underruns != s_clock.underruns && s_clock.floorMhz < CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ) {
+            s_clock.heldMhz   = dfs_step_above(s_clock.floorMhz + 1);
+            s_clock.heldUntil = now + DFS_UNDERRUN_HOLD_MS * 1000LL;
+        }
+        s_clock.underruns = underruns;
+        if (now < s_clock.heldUntil) {
+            floor = std::max(floor, s_clock.heldMhz);
+        }
+        if (floor != s_clock.floorMhz) {
+            set_floor(floor, needed);
+        }
+    }
+    s_clock.kcycles   = kcycles;
+    s_clock.underruns = underruns;
+    s_clock.checkedAt = now;
+}
+
+static void on_render_start(lv_event_t* e)
+{
+    if (!s_clock.rendering && s_clock.renderLock) {
+        s_clock.rendering = true;
+        esp_pm_lock_acquire(s_clock.renderLock);
+    }
+}
+
+static void render_done()
+{
+    if (s_clock.rendering) {
+        s_clock.rendering = false;
+        esp_pm_lock_release(s_clock.renderLock);
+    }
+}
+
+static void set_display_lock(bool on)
+{
+#if !CONFIG_TAB5_RENDER_DFS
+    if (s_clock.displayLock) {
+        on ? esp_pm_lock_acquire(s_clock.displayLock) : esp_pm_lock_release(s_clock.displayLock);
+    }
+#endif
+}
+
+static void cpu_clock_init(lv_display_t* disp)
+{
+    // The locks are there before DFS is, the clock only drops once the first check has seen the decoder
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "display", &s_clock.displayLock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "render", &s_clock.renderLock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &s_clock.boostLock) != ESP_OK) {
+        mclog::tagWarn(_tag, "no cpu clock locks, it stays at full speed");
+        return;
+    }
+    set_display_lock(true);
+    lv_display_add_event_cb(disp, on_render_start, LV_EVENT_RENDER_START, nullptr);
+    set_floor(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, 0);
+
+    esp_timer_create_args_t timer = {};
+    timer.callback                = dfs_check;
+    timer.name                    = "dfs_check";
+    if (esp_timer_create(&timer, &s_clock.timer) != ESP_OK ||
+        esp_timer_start_periodic(s_clock.timer, DFS_CHECK_MS * 1000) != ESP_OK) {
+        mclog::tagWarn(_tag, "no cpu floor checks, it stays at full speed");
+    }
+}
+#endif
+
+void cpu_boost(bool on)
+{
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+    if (s_clock.boostLock) {
+        on ? esp_pm_lock_acquire(s_clock.boostLock) : esp_pm_lock_release(s_clock.boostLock);
+    }
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 Display off                                */
+/* -------------------------------------------------------------------------- */
+// Suspended, LVGL's timers and tick are stopped and its task sleeps through them: no indev reads, renders or flushes,
+// the panel scans out its last frame behind the dark backlight. Resuming invalidates the whole screen and turns the
+// backlight back on once that has been drawn
+static struct {
+    std::atomic<bool> suspended{false};
+    std::atomic<bool> backlightPending{false};  // Resumed, the backlight waits for the redraw
+    int64_t offAt = 0;
+} s_display;
+
+static void on_display_redrawn(lv_event_t* e)
+{
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+    render_done();
+#endif
+    if (s_display.backlightPending.exchange(false)) {
+        bsp_display_brightness_set(GetHAL()->getDisplayBrightness());
+    }
+}
+
+static void display_power_init(lv_display_t* disp)
+{
+    lv_display_add_event_cb(disp, on_display_redrawn, LV_EVENT_REFR_READY, nullptr);
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+    cpu_clock_init(disp);
+#endif
+}
+
+bool HalEsp32::suspendDisplay()
+{
+    lvgl_lock(LVGL_LOCK_HAL);
+    if (!s_display.suspended) {
+        bsp_display_backlight_off();
+        s_display.backlightPending = false;
+        lvgl_port_stop();
+        s_display.suspended = true;
+        s_display.offAt     = esp_timer_get_time();
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+        render_done();  // A render cut short by the stop never gets to flush
+        set_display_lock(false);
+#endif
+        mclog::tagInfo(_tag, "display off, ui suspended");
+    }
+    lvgl_unlock();
+    return true;
+}
+
+void HalEsp32::resumeDisplay()
+{
+    lvgl_lock(LVGL_LOCK_HAL);
+    if (!s_display.suspended) {
+        lvgl_unlock();
+        return;
+    }
+#if CONFIG_TAB5_SCREEN_OFF_DFS
+    set_display_lock(true);
+#endif
+    // Everything is drawn anew, what changed meanwhile included, before the backlight shows it
+    lv_obj_invalidate(lv_screen_active());
+    lv_obj_invalidate(lv_layer_top());
+    lv_display_trigger_activity(lvDisp);  // The touch that woke it never reached LVGL
+    s_display.backlightPending = true;
+    s_display.suspended        = false;
+    lvgl_port_resume();
+    lvgl_unlock();
+    render_now(lvDisp);
+    lvgl_port_task_wake(LVGL_PORT_EVENT_USER, nullptr);
+
+    float offSeconds = (esp_timer_get_time() - s_display.offAt) / 1e6f;
+    PowerEnergy_t off, on;
+    if (getPowerEnergy(POWER_STATE_SCREEN_OFF, &off) && getPowerEnergy(POWER_STATE_STREAMING, &on) &&
+        off.seconds > 0 && on.seconds > 0) {
+        mclog::tagInfo(_tag, "display on after {:.0f} s, {:.2f} W with it off against {:.2f} W streaming with it on",
+                       offSeconds, off.joules / off.seconds, on.joules / on.seconds);
+    } else {
+        mclog::tagInfo(_tag, "display on after {:.0f} s", offSeconds);
+    }
+}
+
+bool HalEsp32::isDisplaySuspended()
+{
+    return s_display.suspended.load(std::memory_order_relaxed);
+}
+
 void HalEsp32::lvglLock()
 {
-    lvgl_port_lock(0);
+    lvgl_lock(LVGL_LOCK_OTHER);
 }
 
 void HalEsp32::lvglUnlock()
 {
-    lvgl_port_unlock();
+    lvgl_unlock();
+}
+
+void HalEsp32::lvglLockAt(LvglLockSite_t site)
+{
+    lvgl_lock(site);
+}
+
+I2cArbiter& i2c_arbiter()
+{
+    static I2cArbiter arbiter;
+    return arbiter;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -237,134 +755,346 @@ void HalEsp32::lvglUnlock()
 void HalEsp32::clearRtcIrq()
 {
     mclog::tagInfo(_tag, "clear rtc irq");
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
     rx8130.clearIrqFlags();
     rx8130.disableIrq();
 }
 
+// The system clock, counted by the esp_timer, is the wall clock: time() and getRtcTime() read it without touching the
+// bus. The RTC sets it at boot. SNTP corrects it once WiFi is up, slewed with adjtime() so it never jumps back, and each
+// sync goes back into the RTC on a whole second. Offline the RTC is the reference: every RTC_CHECK_S its next seconds
+// tick is timed against the system clock, and a difference past RTC_SLEW_MIN_MS is slewed out the same way. The RTC
+// is only on the bus for those. A clock before TIME_VALID_AFTER is an RTC that lost its battery: certificates can't be
+// checked against it
+#define TIME_VALID_AFTER 1735689600  // 2025-01-01
+#define TIME_SNTP_SERVER "pool.ntp.org"
+#define RTC_CHECK_S      3600
+#define RTC_POLL_MS      10   // Between reads of the seconds while waiting for the tick, the most a check is off by
+#define RTC_SLEW_MIN_MS  200  // Less is left alone, the RTC only counts whole seconds
+#define SNTP_FRESH_US    (2LL * CONFIG_LWIP_SNTP_UPDATE_DELAY * 1000)  // Missed one sync, it's offline
+
+static metrics::Gauge s_clock_sntp("clock_correction_ms", "Last difference found in the system clock, per reference",
+                                   "source=\"sntp\"");
+static metrics::Gauge s_clock_rtc("clock_correction_ms", "Last difference found in the system clock, per reference",
+                                  "source=\"rtc\"");
+
+static struct {
+    std::atomic<int64_t> sntpUs{0};    // Wall clock the last SNTP sync set, in us
+    std::atomic<int64_t> sntpAtUs{0};  // esp_timer_get_time() then, 0 before the first
+    esp_timer_handle_t timer = nullptr;
+} s_wall;
+
+bool system_time_valid()
+{
+    return time(nullptr) >= TIME_VALID_AFTER;
+}
+
+static int64_t wall_us()
+{
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+// Slewed when it's small enough for adjtime(), stepped otherwise
+static void wall_correct(int64_t offsetUs)
+{
+    struct timeval delta = {(time_t)(offsetUs / 1000000), (suseconds_t)(offsetUs % 1000000)};
+    if (adjtime(&delta, nullptr) != 0) {
+        int64_t target     = wall_us() + offsetUs;
+        struct timeval now = {(time_t)(target / 1000000), (suseconds_t)(target % 1000000)};
+        settimeofday(&now, nullptr);
+    }
+}
+
+/**
+ * @brief Time the RTC's next seconds tick against the system clock, polls it for up to a second
+ *
+ * @param offsetUs set to how far the RTC is ahead
+ * @return false if it didn't tick or lost its time
+ */
+static bool rtc_offset(int64_t* offsetUs)
+{
+    RX8130_Class& rtc = static_cast<HalEsp32*>(GetHAL())->rx8130;
+    struct tm first;
+    struct tm time;
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        rtc.getTime(&first);
+    }
+    for (int waited = 0; waited <= 1000 + RTC_POLL_MS; waited += RTC_POLL_MS) {
+        vTaskDelay(pdMS_TO_TICKS(RTC_POLL_MS));
+        int64_t now = wall_us();
+        {
+            I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+            rtc.getTime(&time);
+        }
+        if (time.tm_sec != first.tm_sec) {
+            time_t seconds = mktime(&time);
+            *offsetUs      = (int64_t)seconds * 1000000 - now;
+            return seconds >= TIME_VALID_AFTER;
+        }
+    }
+    return false;
+}
+
+// On a HAL worker, once an hour
+static void wall_check()
+{
+    int64_t sntpAt = s_wall.sntpAtUs.load();
+    if (sntpAt != 0 && esp_timer_get_time() - sntpAt < SNTP_FRESH_US) {
+        return;  // SNTP keeps it, and the RTC with it
+    }
+    int64_t offset;
+    if (!rtc_offset(&offset)) {
+        mclog::tagWarn(_tag, "rtc isn't ticking or lost its time, the system clock runs on");
+        return;
+    }
+    s_clock_rtc.set(offset / 1000.0f);
+    if (llabs(offset) >= RTC_SLEW_MIN_MS * 1000) {
+        mclog::tagInfo(_tag, "system clock {} ms off the rtc, slewing", offset / 1000);
+        wall_correct(offset);
+    }
+}
+
+// On a HAL worker after each SNTP sync
+static void rtc_write_back()
+{
+    // The RTC takes whole seconds, so it's written as one starts. From the SNTP time, the system clock may still be
+    // slewing towards it
+    int64_t sntpNow = s_wall.sntpUs.load() + (esp_timer_get_time() - s_wall.sntpAtUs.load());
+    int64_t waitUs  = 1000000 - sntpNow % 1000000;
+    vTaskDelay(pdMS_TO_TICKS((waitUs + 999) / 1000));
+    sntpNow    = s_wall.sntpUs.load() + (esp_timer_get_time() - s_wall.sntpAtUs.load());
+    time_t now = (time_t)(sntpNow / 1000000);
+    struct tm time;
+    localtime_r(&now, &time);
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+    static_cast<HalEsp32*>(GetHAL())->rx8130.setTime(&time);
+}
+
+void HalEsp32::getRtcTime(tm* time)
+{
+    time_t now = ::time(nullptr);
+    localtime_r(&now, time);
+}
+
 void HalEsp32::setRtcTime(tm time)
 {
     mclog::tagInfo(_tag, "set rtc time to {}/{}/{} {:02d}:{:02d}:{:02d}", time.tm_year + 1900, time.tm_mon + 1,
                    time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec);
+    struct timeval now = {mktime(&time), 0};
+    settimeofday(&now, NULL);
+    I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
     rx8130.setTime(&time);
-    delay(50);
-
-    update_system_time();
 }
 
 void HalEsp32::update_system_time()
 {
     mclog::tagInfo(_tag, "update system time");
     struct tm time;
-    rx8130.getTime(&time);
+    {
+        I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::CONTROL);
+        rx8130.getTime(&time);
+    }
     mclog::tagInfo(_tag, "sync to rtc time: {}-{:02d}-{:02d} {:02d}:{:02d}:{:02d}", time.tm_year + 1900,
                    time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec);
     struct timeval now;
     now.tv_sec  = mktime(&time);
     now.tv_usec = 0;
     settimeofday(&now, NULL);
+
+    esp_timer_create_args_t args = {};
+    args.callback                = [](void*) { GetHAL()->runInBackground(wall_check); };
+    args.name                    = "wall_check";
+    if (esp_timer_create(&args, &s_wall.timer) != ESP_OK ||
+        esp_timer_start_periodic(s_wall.timer, RTC_CHECK_S * 1000000LL) != ESP_OK) {
+        mclog::tagWarn(_tag, "no rtc checks, the system clock runs on its own offline");
+    }
+}
+
+static std::atomic<bool> s_sntp_started{false};
+
+// In the lwip task, the bus is left to a worker
+static void on_sntp_sync(struct timeval* tv)
+{
+    int64_t sntpUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    s_clock_sntp.set((sntpUs - wall_us()) / 1000.0f);
+    s_wall.sntpUs   = sntpUs;
+    s_wall.sntpAtUs = esp_timer_get_time();
+
+    struct tm time;
+    time_t now = tv->tv_sec;
+    localtime_r(&now, &time);
+    mclog::tagInfo(_tag, "sntp time: {}-{:02d}-{:02d} {:02d}:{:02d}:{:02d}, into the rtc", time.tm_year + 1900,
+                   time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec);
+    GetHAL()->runInBackground(rtc_write_back);
+}
+
+void time_sync_start()
+{
+    if (s_sntp_started.exchange(true)) {
+        // A new network, ask again rather than at the next interval
+        esp_sntp_restart();
+        return;
+    }
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(TIME_SNTP_SERVER);
+    config.sync_cb           = on_sntp_sync;
+    config.smooth_sync       = true;  // adjtime(), stepped only when it's too far off for that
+    if (esp_netif_sntp_init(&config) != ESP_OK) {
+        mclog::tagWarn(_tag, "sntp didn't start, the rtc's time stays");
+        s_sntp_started = false;
+    }
 }
 
 /* -------------------------------------------------------------------------- */
-/*                                   SD Card                                  */
+/*                                   Storage                                  */
 /* -------------------------------------------------------------------------- */
-#include <dirent.h>
-#include <sys/types.h>
+std::string HalEsp32::getDataDir()
+{
+    // The "storage" SPIFFS partition, formatted on first boot
+    return _data_mounted ? CONFIG_BSP_SPIFFS_MOUNT_POINT : "";
+}
 
-bool HalEsp32::isSdCardMounted()
+// The "assets" SPIFFS partition at /assets, LVGL's POSIX driver reads it as drive 'A' (CONFIG_LV_FS_POSIX_PATH)
+std::string HalEsp32::getAssetDir()
 {
-    return true;
+    return _assets_mounted ? "A:" : "";
 }
 
-std::vector<hal::HalBase::FileEntry_t> HalEsp32::scanSdCard(const std::string& dirPath)
+// The "catalog" partition, split in two. Each slot is mapped once and stays mapped, callers keep pointers into it
+#define CATALOG_PARTITION "catalog"
+
+static const void* s_catalog_slots[hal::HalBase::CATALOG_SLOTS] = {};
+
+static const esp_partition_t* catalog_partition()
 {
-    std::vector<hal::HalBase::FileEntry_t> file_entries;
+    static const esp_partition_t* s_partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CATALOG_PARTITION);
+    return s_partition;
+}
+
+const uint8_t* HalEsp32::mapCatalogSlot(int slot, size_t* size)
+{
+    const esp_partition_t* partition = catalog_partition();
+    if (!partition || slot < 0 || slot >= CATALOG_SLOTS) {
+        return nullptr;
+    }
+    *size = partition->size / CATALOG_SLOTS;
 
-    mclog::tagInfo(_tag, "init sd card");
-    if (bsp_sdcard_init("/sd", 25) != ESP_OK) {
-        mclog::error("failed to mount sd card");
-        return file_entries;
+    if (!s_catalog_slots[slot]) {
+        esp_partition_mmap_handle_t handle;
+        esp_err_t ret = esp_partition_mmap(partition, slot * *size, *size, ESP_PARTITION_MMAP_DATA,
+                                           &s_catalog_slots[slot], &handle);
+        if (ret != ESP_OK) {
+            mclog::tagError(_tag, "Failed to map catalog slot {}: {}", slot, esp_err_to_name(ret));
+            s_catalog_slots[slot] = nullptr;
+            return nullptr;
+        }
+    }
+    return (const uint8_t*)s_catalog_slots[slot];
+}
+
+bool HalEsp32::writeCatalogSlot(int slot, const void* data, size_t len)
+{
+    const esp_partition_t* partition = catalog_partition();
+    size_t slot_size                 = partition ? partition->size / CATALOG_SLOTS : 0;
+    if (!partition || slot < 0 || slot >= CATALOG_SLOTS || len > slot_size) {
+        return false;
     }
 
-    std::string target_path = "/sd/" + dirPath;
+    // Only the sectors the image takes are erased. A write cut short leaves a slot whose checksum fails, and the
+    // reader falls back to the other one. The flash driver drops the cache over the written range, so a mapping
+    // of the slot reads the new bytes
+    size_t offset = slot * slot_size;
+    size_t erase  = (len + partition->erase_size - 1) / partition->erase_size * partition->erase_size;
 
-    DIR* dir = opendir(target_path.c_str());
-    if (dir == nullptr) {
-        mclog::error("failed to open directory: {}", target_path);
-        return file_entries;
+    esp_err_t ret = esp_partition_erase_range(partition, offset, erase);
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(partition, offset, data, len);
     }
+    if (ret != ESP_OK) {
+        mclog::tagError(_tag, "Failed to write catalog slot {}: {}", slot, esp_err_to_name(ret));
+        return false;
+    }
+    mclog::tagInfo(_tag, "Catalog slot {}: {} bytes written", slot, len);
+    return true;
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (std::string(entry->d_name) == "." || std::string(entry->d_name) == "..") {
-            continue;
-        }
+#define NVS_SETTINGS_NAMESPACE "settings"
+#define NVS_SETTINGS_KEY       "app"
 
-        hal::HalBase::FileEntry_t file_entry;
-        file_entry.name  = entry->d_name;
-        file_entry.isDir = (entry->d_type == DT_DIR);
-        file_entries.push_back(file_entry);
+bool HalEsp32::loadSettings(std::vector<uint8_t>& data)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_SETTINGS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
     }
 
-    closedir(dir);
+    size_t size   = 0;
+    esp_err_t ret = nvs_get_blob(handle, NVS_SETTINGS_KEY, nullptr, &size);
+    if (ret == ESP_OK) {
+        data.resize(size);
+        ret = nvs_get_blob(handle, NVS_SETTINGS_KEY, data.data(), &size);
+    }
+    nvs_close(handle);
+    return ret == ESP_OK;
+}
 
-    mclog::tagInfo(_tag, "deinit sd card");
-    bsp_sdcard_deinit("/sd");
+void HalEsp32::saveSettings(const std::vector<uint8_t>& data)
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        mclog::tagError(_tag, "Failed to open NVS: {}", esp_err_to_name(ret));
+        return;
+    }
 
-    return file_entries;
+    // NVS leaves an unchanged blob alone, so an identical save costs no flash write
+    ret = nvs_set_blob(handle, NVS_SETTINGS_KEY, data.data(), data.size());
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        mclog::tagError(_tag, "Failed to save settings: {}", esp_err_to_name(ret));
+    }
 }
 
 /* -------------------------------------------------------------------------- */
-/*                                  Interface                                 */
+/*                                Change Events                               */
 /* -------------------------------------------------------------------------- */
-bool HalEsp32::usbCDetect()
+// Room for a burst of changes between two UI ticks, and for a few apps and the UI at once
+static EventBus<hal::HalBase::Event_t, 32, 4> s_events(hal::HalBase::Event_t{hal::HalBase::EVENT_RESYNC, 0});
+
+void hal_post_event(hal::HalBase::EventType_t type, int value)
 {
-    return bsp_usb_c_detect();
-    // return false;
+    s_events.post({type, value});
+    app_wake();
 }
 
-bool HalEsp32::headPhoneDetect()
+int HalEsp32::subscribeEvents()
 {
-    return bsp_headphone_detect();
+    return s_events.subscribe();
 }
 
-std::vector<uint8_t> HalEsp32::i2cScan(bool isInternal)
+void HalEsp32::unsubscribeEvents(int id)
 {
-    i2c_master_bus_handle_t i2c_bus_handle;
-    std::vector<uint8_t> addrs;
-
-    if (isInternal) {
-        i2c_bus_handle = bsp_i2c_get_handle();
-    } else {
-        i2c_bus_handle = bsp_ext_i2c_get_handle();
-    }
-
-    esp_err_t ret;
-    uint8_t address;
-
-    for (int i = 16; i < 128; i += 16) {
-        for (int j = 0; j < 16; j++) {
-            fflush(stdout);
-            address = i + j;
-            ret     = i2c_master_probe(i2c_bus_handle, address, 50);
-            if (ret == ESP_OK) {
-                addrs.push_back(address);
-            }
-        }
-    }
-
-    return addrs;
+    s_events.unsubscribe(id);
 }
 
-void HalEsp32::initPortAI2c()
+bool HalEsp32::pollEvent(int id, Event_t* event)
 {
-    mclog::tagInfo(_tag, "init port a i2c");
-    bsp_ext_i2c_init();
+    return s_events.poll(id, event);
 }
 
-void HalEsp32::deinitPortAI2c()
+/* -------------------------------------------------------------------------- */
+/*                                  Interface                                 */
+/* -------------------------------------------------------------------------- */
+bool HalEsp32::usbCDetect()
 {
-    mclog::tagInfo(_tag, "deinit port a i2c");
-    bsp_ext_i2c_deinit();
+    return bsp_usb_c_detect();
+    // return false;
 }
 
 void HalEsp32::gpioInitOutput(uint8_t pin)
@@ -5,16 +5,180 @@
  */
 #pragma once
 #include <hal/hal.h>
+#include <hal/input_recording.h>
 #include <ina226.hpp>
 #include <lvgl.h>
 #include <esp_event_base.h>
+#include <esp_http_server.h>
 #include "utils/rx8130/rx8130.h"
+#include "utils/memory_arena/memory_arena.h"
+#include "utils/i2c_arbiter/i2c_arbiter.h"
 
-// Forward declaration for friend function
+// Forward declaration for friend functions
 void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
+void wifi_connect_timeout(void* arg);
+
+// Exclusive use of the speaker output (hal_audio.cpp), the holder mixes `audioMixer` into what it writes
+void audio_claim_output();
+void audio_release_output();
+// Speaker or headphones (hal_audio.cpp): the jack has moved on from where the output goes, and the switch to follow
+// it. Whoever writes the output switches in a faded gap, see radio_output_routes()
+bool audio_route_pending();
+void audio_route_apply();
+
+// The radio's state as a software reset would find it, for getWarmRestart() on the next boot (hal_power.cpp)
+void warm_restart_playing(const char* url, uint8_t volume);
+void warm_restart_volume(uint8_t volume);
+void warm_restart_stopped();
+
+// Hands a change to the event subscribers, from any task (hal_esp32.cpp)
+void hal_post_event(hal::HalBase::EventType_t type, int value = 0);
+// Cuts a waitWake() of the app loop short, from any task (hal_esp32.cpp)
+void app_wake();
+
+// Wall clock from SNTP once WiFi is up, written back to the RTC, which keeps it until then and offline (hal_esp32.cpp).
+// Valid once it's past what the RTC reads with a dead battery, certificates are checked against it from then on
+void time_sync_start();
+bool system_time_valid();
+
+// Stream ring fill as last posted with EVENT_RADIO_BUFFER, -1 while not streaming (hal_radio_stream.cpp)
+int radio_buffer_level();
+// CPU cycles the decode task spent decoding and in the DSP since boot, 1024 to the unit, wraps: the work, whatever the
+// clock was. What the CPU clock's floor is sized for (hal_radio_stream.cpp)
+uint32_t radio_decode_busy_kcycles();
+
+// One frame LVGL rendered
+struct PerfFrame_t {
+    int64_t renderUs = 0;  // Without the flushes
+    int64_t flushUs  = 0;
+    uint32_t areas   = 0;  // Invalidated for it, overlaps count twice
+    uint32_t pixels  = 0;
+};
+// Times LVGL's renders and flushes on `disp` for getPerfStats(), and hands each rendered frame to `onFrame` if set, in
+// the LVGL task (hal_perf.cpp)
+void perf_attach_display(lv_display_t* disp);
+void perf_on_frame(void (*onFrame)(const PerfFrame_t&));
+// A touch sample taken at `atUs` reached LVGL, the next rendered frame ends its touch-to-photon time (hal_perf.cpp)
+void perf_touch_sampled(int64_t atUs);
+// What `device`'s read callback on `indev` hands LVGL, last thing in it: recorded, or replaced by a replay's while one
+// runs (hal_input_replay.cpp)
+void input_read(input_recording::Device_t device, lv_indev_t* indev, lv_indev_data_t* data);
+// The LVGL lock, its waits and holds timed against `site` for getPerfStats() and /metrics. What the HAL's own code
+// takes instead of lvgl_port_lock() (hal_perf.cpp)
+void lvgl_lock(hal::HalBase::LvglLockSite_t site);
+void lvgl_unlock();
+
+// WiFi power-save profile (hal_wifi.cpp). The stream hands in its buffer level as it posts it, and reads in bursts
+// while power save is on
+void wifi_power_buffer_level(int percent);
+bool wifi_power_save();
+
+// Turns on the internal I2C bus for the drivers that poll it, touch first (hal_esp32.cpp)
+I2cArbiter& i2c_arbiter();
+
+// EXT 5V was switched, Port A is scanned again if it's up (hal_i2c_scan.cpp)
+void i2c_scan_port_a_power_changed();
+// Port A's bus is up from the first acquire to the last release, the scan panel and the keypad share it
+bool port_a_acquire();
+void port_a_release();
+
+// Looks for the TCA8418 keyboard on Port A and, if it's there, gives it an LVGL keypad indev (hal_keypad.cpp)
+lv_indev_t* keypad_start();
+// A keyboard's keypad indev, fed by one task. Keys no text field has the focus for go out as EVENT_KEY
+struct KeySource_t;
+KeySource_t* key_source_create(lv_indev_t** indev);
+bool key_source_push(KeySource_t* source, uint32_t key, bool pressed);  // key: LV_KEY_* or the character
+
+// A USB Audio Class DAC on USB-A, the radio's output while one is plugged in (hal_usb_audio.cpp). Writes block until
+// the DAC's ring has room for them, false if it went away
+void usb_audio_start();
+bool usb_audio_active();
+int usb_audio_buffer_ms();
+bool usb_audio_write(const int16_t* pcm, int samples, uint32_t timeoutMs);
+uint32_t usb_audio_write_errors();
+
+// Multi-room sync (hal_sync.cpp). A unit playing a station from upstream beacons it on the LAN, one that starts the
+// same station follows it: streams from its relay and has its output locked to the master's. sync_follow() picks a
+// master for `url` and gives its relay's URL, the connection `owner` then follows until sync_unfollow()
+void sync_start();
+uint32_t sync_url_hash(const std::string& url);
+bool sync_follow(const std::string& url, uint64_t owner, std::string* relayUrl);
+void sync_unfollow(uint64_t owner, bool failed);
+// The output heard the first sample of the frame with CRC `tag` at `heardUs`, or will
+void sync_frame_heard(uint32_t tag, int64_t heardUs);
+// While following: the output trim towards the master, and a jump to make first (late positive, us)
+bool sync_following(int* ppm);
+int64_t sync_take_step();
+// The active station's URL hash while it plays from upstream, what a master beacons (hal_radio_stream.cpp)
+bool radio_sync_source(uint32_t* urlHash);
+// The radio's output is running and takes a pending route switch into its next block (hal_radio_stream.cpp)
+bool radio_output_routes();
+
+// Publishes the radio's state to CONFIG_TAB5_MQTT_BROKER_URL and takes commands from it, started on the first WiFi
+// connect and reconnecting on its own from then on (hal_mqtt.cpp)
+void mqtt_start();
+
+// Serves the metrics registry at /metrics on `server` (hal_metrics.cpp)
+void metrics_attach(httpd_handle_t server);
+
+// Sets the LVGL heap's gauges, the internal pool's and the PSRAM regions' sizes, use and fragmentation, from the
+// scrape (hal_lvgl_heap.cpp)
+void lvgl_heap_sample();
+
+// Samples `ina226` on every conversion it finishes from a task of its own, so readers never touch the I2C bus. The
+// newest sample, false before the first (hal_power.cpp)
+void power_monitor_start(INA226* ina226);
+bool power_monitor_latest(hal::HalBase::PMData_t* sample);
+
+// Serves the camera as MJPEG at /camera on `server` while it captures, to up to CAMERA_STREAM_MAX_VIEWERS at once
+// (hal_camera.cpp)
+#define CAMERA_STREAM_MAX_VIEWERS 2
+void camera_stream_attach(httpd_handle_t server);
+
+// Serves the web remote's page at / and its WebSocket at /ws on `server`, to up to REMOTE_MAX_CLIENTS at once
+// (hal_remote.cpp)
+#define REMOTE_MAX_CLIENTS 4
+void remote_attach(httpd_handle_t server);
+
+// Full CPU clock until the matching cpu_boost(false), for work the floor the radio sets isn't sized for (camera
+// frames, benchmarks). Counted, nothing without TAB5_SCREEN_OFF_DFS (hal_esp32.cpp)
+void cpu_boost(bool on);
+
+// Lets LVGL show JPEG files and JPEG data in lv_image_dsc_t, decoded by the hardware engine, from the display's
+// start (hal_image.cpp)
+void jpeg_image_decoder_init();
+
+// Hands LVGL's large fills and image blits to the PPA, with TAB5_LVGL_PPA_DRAW (hal_image.cpp)
+void ppa_draw_unit_init();
+
+// Reserves the buffer pools at boot, before anything can fragment the heaps (hal_memory.cpp)
+void memory_init();
+MemoryArena& memory_pool(hal::HalBase::MemoryPool_t pool);
+
+// The uSD card, mounted at SDCARD_MOUNT_POINT by a watcher task whenever one is in (hal_sdcard.cpp). Hold it with
+// sdcard_acquire() while files are open, false if there's no card: a pulled card stays mounted until the release
+#define SDCARD_MOUNT_POINT "/sd"
+void sdcard_start();
+bool sdcard_acquire();
+void sdcard_release();
+
+// The card's media index, loaded and rescanned as a card is mounted, dropped when it goes (hal_media_index.cpp)
+void media_index_mounted();
+void media_index_removed();
+
+// The firmware that's running came up: keep it, rather than going back to the previous slot at the next restart
+// (hal_ota.cpp)
+void firmware_update_confirm();
+
+// A serial console with a `bench` command that runs the self benchmark and an `update` one (hal_benchmark.cpp)
+void benchmark_console_start();
+
+// Samples the touch controller on its interrupt in a task of its own and feeds `indev` from there (hal_touch.cpp)
+void touch_start(lv_indev_t* indev);
 
 class HalEsp32 : public hal::HalBase {
     friend void wifi_event_handler(void*, esp_event_base_t, int32_t, void*);
+    friend void wifi_connect_timeout(void*);
 
 public:
     std::string type() override
@@ -27,6 +191,11 @@ public:
     void delay(uint32_t ms) override;
     uint32_t millis() override;
     int getCpuTemp() override;
+    void runInBackground(std::function<void()> job, std::function<void()> done = nullptr) override;
+    bool getPerfStats(PerfStats_t* stats) override;
+    void* allocBuffer(MemoryPool_t pool, size_t size) override;
+    void freeBuffer(MemoryPool_t pool, void* buffer) override;
+    bool getMemoryPoolStats(MemoryPool_t pool, MemoryPoolStats_t* stats) override;
 
     INA226 ina226;
     RX8130_Class rx8130;
@@ -35,15 +204,26 @@ public:
 
     void setDisplayBrightness(uint8_t brightness) override;
     uint8_t getDisplayBrightness() override;
+    bool suspendDisplay() override;
+    void resumeDisplay() override;
+    bool isDisplaySuspended() override;
+    bool waitDisplayFrame(uint32_t timeoutMs) override;
+    bool waitWake(uint32_t timeoutMs) override;
 
     void lvglLock() override;
     void lvglUnlock() override;
+    void lvglLockAt(LvglLockSite_t site) override;
 
     void updatePowerMonitorData() override;
+    int getPowerMonitorWindow(PMData_t* samples, int count) override;
+    int getPowerHistory(DecimationRing::Tier_t tier, DecimationRing::Point_t* points, int count) override;
+    bool getPowerEnergy(PowerState_t state, PowerEnergy_t* energy) override;
     void updateImuData() override;
+    int getImuWindow(IMUData_t* samples, int count) override;
     void clearImuIrq() override;
 
     void clearRtcIrq() override;
+    void getRtcTime(tm* time) override;
     void setRtcTime(tm time) override;
 
     void setChargeQcEnable(bool enable) override;
@@ -58,15 +238,36 @@ public:
     void sleepAndTouchWakeup() override;
     void sleepAndShakeWakeup() override;
     void sleepAndRtcWakeup() override;
+    void sleepAndAlarmWakeup(int hour, int minute) override;
+    bool wokeByRtcAlarm() override
+    {
+        return _woke_by_alarm;
+    }
+    bool getWarmRestart(WarmRestart_t* state) override;
 
-    void startCameraCapture(lv_obj_t* imgCanvas) override;
+    void startCameraCapture(lv_obj_t* imgCanvas, int width = 1280, int height = 720) override;
     void stopCameraCapture() override;
     bool isCameraCapturing() override;
+    void setCameraPreviewSize(int width, int height) override;
+    bool requestCameraStill() override;
+    bool takeCameraStill(std::vector<uint16_t>& pixels, int* width, int* height) override;
+    int getCameraStreamViewers() override;
+    bool startPresenceDetection() override;
+    void stopPresenceDetection() override;
+    bool isPresenceDetectionRunning() override;
+
+    bool decodeJpegThumbnail(const uint8_t* data, size_t len, int size, uint16_t* pixels) override;
 
     void setSpeakerVolume(uint8_t volume) override;
     uint8_t getSpeakerVolume() override;
     void audioRecord(std::vector<int16_t>& data, uint16_t durationMs, float gain = 80.0f) override;
+    int openMicCapture() override;
+    void closeMicCapture(int reader) override;
+    int readMicCapture(int reader, int16_t* data, int maxFrames, uint32_t timeoutMs = 0,
+                       int* dropped = nullptr) override;
+    void setMicGain(float gain) override;
     void audioPlay(std::vector<int16_t>& data, bool async = true) override;
+    void audioPlayVoice(int voice, int frames) override;
     void startDualMicRecordTest() override;
     MicTestState_t getDualMicRecordTestState() override;
     void startHeadphoneMicRecordTest() override;
@@ -77,46 +278,134 @@ public:
     void playStartupSfx() override;
     void playShutdownSfx() override;
 
+    // Voice control
+    bool startVoiceControl() override;
+    void stopVoiceControl() override;
+    bool isVoiceControlRunning() override;
+    bool trainVoiceCommand(VoiceCommand_t command) override;
+    int getVoiceCommandExamples(VoiceCommand_t command) override;
+    void clearVoiceCommands() override;
+
     void setExtAntennaEnable(bool enable) override;
     bool getExtAntennaEnable() override;
     void startWifiAp() override;
 
     // WiFi STA mode
     WifiState_t getWifiState() override;
+    WifiStep_t getWifiStep() override;
     bool connectWifiSta(const std::string& ssid, const std::string& password) override;
+    bool startWifiSta(const std::string& ssid, const std::string& password) override;
+    bool startWifiScan() override;
+    std::vector<WifiNetwork_t> getWifiNetworks() override;
     void disconnectWifi() override;
-    std::string getWifiIp() override;
-    std::string getWifiSsid() override;
+    WifiIp_t getWifiIp() override;
+    WifiSsid_t getWifiSsid() override;
     void saveWifiConfig(const std::string& ssid, const std::string& password) override;
     bool loadWifiConfig(std::string& ssid, std::string& password) override;
+    bool startSavedWifi() override;
+    bool connectSavedWifi() override;
+    bool httpGet(const std::string& url, std::function<bool(const char* data, size_t len)> onData) override;
+    bool runNetworkBenchmark(const std::string& url, uint32_t seconds, NetBenchmark_t* result) override;
 
     // Radio streaming
     RadioState_t getRadioState() override;
     bool startRadioStream(const std::string& url) override;
+    bool startRadioFiles(const std::vector<std::string>& paths) override;
+    bool queueRadioFile(const std::string& path) override;
     void stopRadioStream() override;
-    void getRadioSpectrum(uint8_t* spectrum, size_t len) override;
+    bool prewarmRadioStream(const std::string& url) override;
+    void setRadioVariants(const std::vector<RadioVariant_t>& variants) override;
+    bool switchRadioVariant(const std::string& url) override;
+    void prewarmRadioHosts(const std::vector<std::string>& urls) override;
+    void setRemoteStations(const std::vector<std::string>& names) override;
+    RadioMetadata_t getRadioMetadata() override;
+    RadioStreamFormat_t getRadioStreamFormat() override;
+    bool pauseRadioStream() override;
+    void resumeRadioStream() override;
+    bool skipRadioStream(int seconds) override;
+    RadioTimeShift_t getRadioTimeShift() override;
+    bool seekRadioStream(int seconds) override;
+    RadioPosition_t getRadioPosition() override;
+    bool startRadioRecording() override;
+    void stopRadioRecording() override;
+    bool isRadioRecording() override;
+    bool saveRadioHistory(int minutes) override;
+    bool isRadioHistorySaving() override;
+    std::vector<RadioHistoryEntry_t> searchRadioHistory(const std::string& prefix, int maxResults) override;
+    void setRadioEq(const RadioEq_t& eq) override;
+    RadioEq_t getRadioEq() override;
+    void setRadioCrossfade(int ms) override;
+    int getRadioCrossfade() override;
+    RadioOutputStats_t getRadioOutputStats() override;
+    bool getRadioSpectrum(RadioSpectrum_t* frame) override;
+    void setRadioSpectrumBands(int bands) override;
+    bool getRadioWaveform(RadioWaveform_t* frame) override;
+    void setRadioWaveformColumns(int columns) override;
+    bool runRadioBenchmark(RadioBenchmark_t* result, const char* path = nullptr) override;
+    bool runOutputBenchmark(uint32_t seconds, OutputBenchmark_t* result) override;
+    bool runSelfBenchmark(SelfBenchmark_t* result) override;
+    bool runStressBenchmark(uint32_t phaseSeconds, uint32_t loads, StressBenchmark_t* result) override;
+    bool startInputRecording() override;
+    bool stopInputRecording(const std::string& name) override;
+    bool runInputReplay(const std::string& name, InputReplay_t* result) override;
+    bool startFirmwareUpdate(const std::string& url, bool restart = false) override;
+    FirmwareUpdate_t getFirmwareUpdate() override;
 
     bool isSdCardMounted() override;
-    std::vector<FileEntry_t> scanSdCard(const std::string& dirPath) override;
+    int openSdCardDir(const std::string& dirPath) override;
+    std::vector<FileEntry_t> readSdCardDir(int cursor, int maxEntries) override;
+    void closeSdCardDir(int cursor) override;
+    bool startMediaScan() override;
+    bool isMediaScanRunning() override;
+    std::vector<MediaEntry_t> searchMedia(MediaField_t field, const std::string& prefix, int maxResults) override;
+
+    std::string getDataDir() override;
+    std::string getAssetDir() override;
+    const uint8_t* mapCatalogSlot(int slot, size_t* size) override;
+    bool writeCatalogSlot(int slot, const void* data, size_t len) override;
+    bool loadSettings(std::vector<uint8_t>& data) override;
+    void saveSettings(const std::vector<uint8_t>& data) override;
+
+    int subscribeEvents() override;
+    void unsubscribeEvents(int id) override;
+    bool pollEvent(int id, Event_t* event) override;
 
     bool usbCDetect() override;
     bool usbADetect() override;
     bool headPhoneDetect() override;
     std::vector<uint8_t> i2cScan(bool isInternal) override;
+    bool startI2cScan(bool isInternal) override;
+    bool getI2cDevices(bool isInternal, std::vector<uint8_t>* addrs) override;
     void initPortAI2c() override;
     void deinitPortAI2c() override;
     void gpioInitOutput(uint8_t pin) override;
     void gpioSetLevel(uint8_t pin, bool level) override;
     void gpioReset(uint8_t pin) override;
 
+    // The half of init() the first frame doesn't wait for, on a task of its own
+    void deferred_init();
+
 private:
     void set_gpio_output_capability();
     void hid_init();
     void rs485_init();
     bool wifi_init();
     bool wifi_sta_init();
+    void wifi_set_state(WifiState_t state);
+    void wifi_set_step(WifiStep_t step);
+    bool wifi_start(const std::string& ssid, const std::string& password, bool fromSaved);
+    void wifi_join(const std::string& ssid, const std::string& password);
+    bool wifi_next_saved(const char* failed);
+    void wifi_fail();
     void imu_init();
+    void headphone_init();
+    void warm_restart_init();
+    void audio_mixer_init();
     void update_system_time();
+    bool radio_start(const std::string& url, bool local);
+    void radio_resolve_hosts();
+    bool radio_set_volume(uint8_t volume);
+    void radio_start_relay();
 
     uint8_t _current_lcd_brightness = 100;
     bool _charge_qc_enable          = false;
@@ -125,11 +414,13 @@ private:
     bool _usba_5v_enable            = true;
     bool _ext_antenna_enable        = false;
     bool _sd_card_mounted           = false;
+    bool _data_mounted              = false;
+    bool _woke_by_alarm             = false;
+    bool _assets_mounted            = false;
 
     // WiFi STA state
     WifiState_t _wifi_state  = WIFI_DISCONNECTED;
-    std::string _wifi_ssid   = "";
-    std::string _wifi_ip     = "";
+    WifiStep_t _wifi_step    = WIFI_STEP_IDLE;
     bool _wifi_initialized   = false;
 
     // Radio stream state
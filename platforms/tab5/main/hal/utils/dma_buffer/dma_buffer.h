@@ -0,0 +1,134 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <esp_cache.h>
+#include <esp_dma_utils.h>
+#include <esp_heap_caps.h>
+
+/**
+ * @brief A buffer a DMA engine (PPA, JPEG, camera, SDMMC) and the CPU hand back and forth, in whole cache lines
+ *
+ * Start and size are rounded to the cache line of the memory it's in, 128 bytes for PSRAM with the L2 line
+ * sdkconfig.defaults sets, so no other buffer shares a line with it. A writeback or invalidate of any part of it
+ * then never loses a neighbour's data, and covers just that part instead of the whole cache.
+ *
+ *     DmaBuffer out;
+ *     out.alloc(w * h * 2, MALLOC_CAP_SPIRAM);
+ *     fill(out.data());
+ *     out.writeback();   // The CPU wrote it, before an engine reads it
+ *     ...                // An engine writes it
+ *     out.invalidate();  // Before the CPU reads what the engine wrote
+ *
+ * The IDF drivers sync the buffers they're given themselves, and refuse an output that isn't whole lines.
+ * `writeback()` and `invalidate()` are for the handoffs no driver sees, such as a frame passed on to LVGL.
+ */
+class DmaBuffer {
+public:
+    DmaBuffer() = default;
+    DmaBuffer(const DmaBuffer&)            = delete;
+    DmaBuffer& operator=(const DmaBuffer&) = delete;
+
+    ~DmaBuffer()
+    {
+        free();
+    }
+
+    /**
+     * @brief Cache line of the memory `caps` picks, 0 where it isn't cached
+     */
+    static size_t line_size(uint32_t caps)
+    {
+        size_t line = 0;
+        if (esp_cache_get_alignment(caps, &line) != ESP_OK) {
+            return 0;
+        }
+        return line;
+    }
+
+    /**
+     * @brief Allocate `size` bytes, zeroed, padded up to whole cache lines
+     *
+     * @param caps MALLOC_CAP_SPIRAM or MALLOC_CAP_INTERNAL, it's DMA capable either way
+     * @return false if there's no room
+     */
+    bool alloc(size_t size, uint32_t caps)
+    {
+        free();
+        esp_dma_mem_info_t info  = {};
+        info.extra_heap_caps     = caps;
+        info.dma_alignment_bytes = 4;
+        void* data               = nullptr;
+        size_t actual            = 0;
+        if (esp_dma_capable_calloc(1, size, &info, &data, &actual) != ESP_OK) {
+            return false;
+        }
+        _data = (uint8_t*)data;
+        _size = actual;
+        _line = line_size(caps);
+        return true;
+    }
+
+    void free()
+    {
+        heap_caps_free(_data);
+        _data = nullptr;
+        _size = 0;
+    }
+
+    uint8_t* data() const
+    {
+        return _data;
+    }
+
+    /**
+     * @brief Usable bytes, at least what was asked for: the padding is the buffer's own
+     */
+    size_t size() const
+    {
+        return _size;
+    }
+
+    explicit operator bool() const
+    {
+        return _data != nullptr;
+    }
+
+    /**
+     * @brief Write what the CPU wrote from its cache to memory, for an engine to read
+     */
+    void writeback(size_t offset = 0, size_t len = SIZE_MAX)
+    {
+        sync(offset, len, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+    }
+
+    /**
+     * @brief Drop the cached copy, for the CPU to read what an engine wrote
+     */
+    void invalidate(size_t offset = 0, size_t len = SIZE_MAX)
+    {
+        sync(offset, len, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    }
+
+private:
+    // The range grows to whole lines, they're all the buffer's own
+    void sync(size_t offset, size_t len, int direction)
+    {
+        if (!_data || _line == 0 || offset >= _size) {
+            return;
+        }
+        size_t end   = std::min(_size, offset + std::min(len, _size - offset));
+        size_t start = offset / _line * _line;
+        end          = std::min(_size, (end + _line - 1) / _line * _line);
+        esp_cache_msync(_data + start, end - start, direction | ESP_CACHE_MSYNC_FLAG_TYPE_DATA);
+    }
+
+    uint8_t* _data = nullptr;
+    size_t _size   = 0;
+    size_t _line   = 0;
+};
@@ -0,0 +1,150 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief COBS framing with a CRC-16 for a byte stream that can drop, repeat or corrupt bytes, like an RS485 line
+ *
+ * A packet goes out COBS encoded and ends in a 0x00, the only zero on the wire, so a receiver that joins mid-frame
+ * or loses bytes is back in step at the next delimiter. The last two bytes of a packet are the CRC-16/CCITT-FALSE
+ * of the rest, little endian. The decoder takes bytes as they come in and rebuilds the packet in its own buffer,
+ * the only copy between the driver and whoever handles it:
+ *
+ *     frame_link::Decoder decoder;
+ *     for (size_t i = 0; i < n; i++) {
+ *         if (decoder.push(rx[i]) == frame_link::Decoder::FRAME) {
+ *             handle(decoder.payload(), decoder.payloadSize());
+ *         }
+ *     }
+ *     size_t len = frame_link::encode(packet, packetSize, wire);  // CRC and delimiter added
+ */
+namespace frame_link {
+
+static constexpr size_t MAX_PACKET = 256;  // Payload and CRC, decoded
+static constexpr size_t MAX_WIRE   = MAX_PACKET + MAX_PACKET / 254 + 2;
+
+inline uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief COBS encode `payload` with its CRC appended, and the delimiter
+ *
+ * @param wire room for MAX_WIRE bytes
+ * @return bytes to send, 0 if the payload is over MAX_PACKET - 2
+ */
+inline size_t encode(const uint8_t* payload, size_t len, uint8_t* wire)
+{
+    if (len > MAX_PACKET - 2) {
+        return 0;
+    }
+    uint16_t crc    = crc16(payload, len);
+    uint8_t tail[2] = {(uint8_t)crc, (uint8_t)(crc >> 8)};
+    size_t codeAt   = 0;  // Where the current block's code byte goes
+    size_t out      = 1;
+    uint8_t code    = 1;
+    for (size_t i = 0; i < len + 2; i++) {
+        uint8_t byte = i < len ? payload[i] : tail[i - len];
+        if (byte != 0) {
+            wire[out++] = byte;
+            code++;
+        }
+        if (byte == 0 || code == 0xFF) {
+            wire[codeAt] = code;
+            codeAt       = out++;
+            code         = 1;
+        }
+    }
+    wire[codeAt] = code;
+    wire[out++]  = 0;
+    return out;
+}
+
+class Decoder {
+public:
+    enum Result_t {
+        MORE,   // Inside a frame, or between them
+        FRAME,  // payload() holds a packet whose CRC checked out
+        ERROR,  // A frame ended that was cut short, too long or had a bad CRC
+    };
+
+    Result_t push(uint8_t byte)
+    {
+        if (byte == 0) {
+            Result_t result = MORE;
+            if (_started) {
+                bool whole = _left == 0 && !_overflow && _len >= 2;
+                result     = whole && crc16(_packet, _len - 2) == (_packet[_len - 2] | _packet[_len - 1] << 8)
+                                 ? FRAME
+                                 : ERROR;
+            }
+            _frame_len = result == FRAME ? _len - 2 : 0;
+            reset();
+            return result;
+        }
+        if (_left == 0) {
+            // A code byte: the block before it ended in a zero unless it was a full one
+            if (_started && _code != 0xFF) {
+                append(0);
+            }
+            _started = true;
+            _code    = byte;
+            _left    = byte - 1;
+        } else {
+            append(byte);
+            _left--;
+        }
+        return MORE;
+    }
+
+    // The last FRAME's payload, without the CRC. Valid until the next push()
+    const uint8_t* payload() const
+    {
+        return _packet;
+    }
+    size_t payloadSize() const
+    {
+        return _frame_len;
+    }
+
+private:
+    void append(uint8_t byte)
+    {
+        if (_len < MAX_PACKET) {
+            _packet[_len++] = byte;
+        } else {
+            _overflow = true;
+        }
+    }
+
+    void reset()
+    {
+        _len      = 0;
+        _left     = 0;
+        _code     = 0xFF;
+        _started  = false;
+        _overflow = false;
+    }
+
+    uint8_t _packet[MAX_PACKET];
+    size_t _len       = 0;
+    size_t _frame_len = 0;
+    uint8_t _left     = 0;  // Data bytes still due in the current block
+    uint8_t _code     = 0xFF;
+    bool _started     = false;
+    bool _overflow    = false;
+};
+
+}  // namespace frame_link
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * @brief Takes turns on the internal I2C bus for the drivers that keep coming back to it, touch first
+ *
+ * A user holds the bus for a whole batch of transfers rather than queueing behind every other driver for each one.
+ * The hold is a FreeRTOS mutex: waiters get it highest task priority first, which puts the touch task ahead of the
+ * telemetry tasks, and a telemetry task holding it runs at the priority of whoever waits. A long batch calls yield()
+ * between transfers and hands the bus over early to anyone more urgent that's waiting. Not recursive.
+ *
+ *     {
+ *         I2cArbiter::Hold hold(i2c_arbiter(), I2cArbiter::TELEMETRY);
+ *         float volts = ina226.readBusVoltage();
+ *         hold.yield();
+ *         float amps = ina226.readShuntCurrent();
+ *     }
+ *     I2cArbiter::Stats_t stats = i2c_arbiter().stats(true);  // Once a second, for the bus load
+ *
+ * The IDF driver's own bus lock still sits below, for the drivers that don't come through here (the codecs, the IO
+ * expander): each of their transfers is a short wait for whoever holds the bus, and isn't counted.
+ */
+class I2cArbiter {
+public:
+    enum Priority_t {
+        TOUCH = 0,
+        CONTROL,    // One-off reads and writes for the UI, the RTC
+        TELEMETRY,  // Periodic sampling, the IMU and power monitor
+        SCAN,
+        PRIORITY_COUNT
+    };
+
+    struct Stats_t {
+        uint32_t busyUs                    = 0;  // Held, since boot. Wraps, differences are what count
+        uint32_t holds[PRIORITY_COUNT]     = {};
+        uint32_t maxWaitUs[PRIORITY_COUNT] = {};  // Since the last reset
+    };
+
+    class Hold {
+    public:
+        Hold(I2cArbiter& arbiter, Priority_t priority) : _arbiter(arbiter), _priority(priority)
+        {
+            _arbiter.acquire(_priority);
+        }
+        ~Hold()
+        {
+            _arbiter.release();
+        }
+        Hold(const Hold&)            = delete;
+        Hold& operator=(const Hold&) = delete;
+
+        /**
+         * @brief Between the transfers of a batch, lets anyone more urgent go first
+         */
+        void yield()
+        {
+            if (_arbiter.urgentWaiting(_priority)) {
+                _arbiter.release();
+                _arbiter.acquire(_priority);
+            }
+        }
+
+    private:
+        I2cArbiter& _arbiter;
+        Priority_t _priority;
+    };
+
+    I2cArbiter() : _mutex(xSemaphoreCreateMutexStatic(&_storage))
+    {
+    }
+    I2cArbiter(const I2cArbiter&)            = delete;
+    I2cArbiter& operator=(const I2cArbiter&) = delete;
+
+    /**
+     * @param resetMaxWait start the waits over, for a maximum per sampling period
+     */
+    Stats_t stats(bool resetMaxWait = false)
+    {
+        Stats_t stats;
+        stats.busyUs = _busy_us.load(std::memory_order_relaxed);
+        for (int i = 0; i < PRIORITY_COUNT; i++) {
+            stats.holds[i]     = _holds[i].load(std::memory_order_relaxed);
+            stats.maxWaitUs[i] = resetMaxWait ? _max_wait_us[i].exchange(0, std::memory_order_relaxed)
+                                              : _max_wait_us[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    void acquire(Priority_t priority)
+    {
+        int64_t start = esp_timer_get_time();
+        _waiting[priority].fetch_add(1);
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        _waiting[priority].fetch_sub(1);
+        _held_since = esp_timer_get_time();
+
+        uint32_t waited = (uint32_t)(_held_since - start);
+        uint32_t max    = _max_wait_us[priority].load(std::memory_order_relaxed);
+        while (waited > max && !_max_wait_us[priority].compare_exchange_weak(max, waited, std::memory_order_relaxed)) {
+        }
+        _holds[priority].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+        _busy_us.fetch_add((uint32_t)(esp_timer_get_time() - _held_since), std::memory_order_relaxed);
+        xSemaphoreGive(_mutex);
+    }
+
+    bool urgentWaiting(Priority_t priority) const
+    {
+        for (int i = 0; i < priority; i++) {
+            if (_waiting[i].load() > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    StaticSemaphore_t _storage;
+    SemaphoreHandle_t _mutex;
+    int64_t _held_since = 0;  // Only ever touched by the holder
+    std::atomic<uint32_t> _busy_us{0};
+    std::atomic<int> _waiting[PRIORITY_COUNT]          = {};
+    std::atomic<uint32_t> _holds[PRIORITY_COUNT]       = {};
+    std::atomic<uint32_t> _max_wait_us[PRIORITY_COUNT] = {};
+};
@@ -0,0 +1,301 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "../task_topology/task_topology.h"
+
+/**
+ * @brief A stop request for one run of a JoinableTask, which the run checks between pieces of work
+ *
+ * `sleep()` is a delay that a stop cuts short, for runs that wait between rounds.
+ */
+class CancelToken {
+public:
+    CancelToken() : _wake(xSemaphoreCreateBinaryStatic(&_wake_buffer))
+    {
+    }
+
+    ~CancelToken()
+    {
+        vSemaphoreDelete(_wake);
+    }
+
+    CancelToken(const CancelToken&)            = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    void cancel()
+    {
+        _cancelled.store(true);
+        xSemaphoreGive(_wake);
+    }
+
+    bool cancelled() const
+    {
+        return _cancelled.load();
+    }
+
+    /**
+     * @return cancelled(), after `ms` or as soon as the run is cancelled
+     */
+    bool sleep(uint32_t ms) const
+    {
+        if (!cancelled()) {
+            xSemaphoreTake(_wake, pdMS_TO_TICKS(ms));
+        }
+        return cancelled();
+    }
+
+private:
+    std::atomic<bool> _cancelled{false};
+    StaticSemaphore_t _wake_buffer;
+    SemaphoreHandle_t _wake;
+};
+
+/**
+ * @brief A task that is started and stopped over and over, each run on the same stack, and can be joined
+ *
+ * The stack and TCB are set aside on the first start and kept, so restarting a stream doesn't carve 8 KB out of
+ * the internal heap each time, a PSRAM_STACK config's stack is kept in PSRAM. The function simply returns when it's
+ * done. One that takes a CancelToken gets its run's own, `cancel()` sets it and `stop()` joins after that; a plain
+ * TaskFunction_t is stopped by whatever the caller has it check (a flag, a ring it wakes). `cancelled()` is the
+ * same request seen from outside the run.
+ *
+ *     static JoinableTask s_task;
+ *     s_task.start(task_topology::RADIO_OUTPUT, output_task, nullptr);
+ *     ...
+ *     static void output_task(void* arg, const CancelToken& token)
+ *     {
+ *         while (!token.cancelled()) { ... }
+ *     }
+ *     ...
+ *     s_task.stop(2000);
+ *
+ * start(), cancel(), stop(), wait() and join() are for one task at a time, the one that owns the JoinableTask.
+ *
+ * Bounded: a run that doesn't end within the join timeout is left to finish on its own. Its stack can't be handed
+ * to the next run while it's still on it, so from then on runs come from the heap like any other task. Each run has
+ * a Run_t of its own, the orphan takes it along and frees it, so it never signals for a later run.
+ */
+class JoinableTask {
+public:
+    typedef void (*CancellableFunction_t)(void* arg, const CancelToken& token);
+
+    /**
+     * @param name overrides the config's, as with task_topology::create()
+     * @return false if the task couldn't be created, or the last run hasn't been joined and is still going
+     */
+    bool start(const task_topology::TaskConfig_t& config, TaskFunction_t fn, void* arg, const char* name = nullptr)
+    {
+        return start_run(config, fn, nullptr, arg, name);
+    }
+
+    bool start(const task_topology::TaskConfig_t& config, CancellableFunction_t fn, void* arg,
+               const char* name = nullptr)
+    {
+        return start_run(config, nullptr, fn, arg, name);
+    }
+
+    /**
+     * @brief Ask the run to stop, it ends when it next checks its token
+     */
+    void cancel()
+    {
+        _cancelled.store(true);
+        if (_run) {
+            _run->token.cancel();
+        }
+    }
+
+    /**
+     * @return cancel() and join()
+     */
+    bool stop(uint32_t timeoutMs)
+    {
+        cancel();
+        return join(timeoutMs);
+    }
+
+    /**
+     * @return true once the run was asked to stop, or with none going. Safe from any task, an orphan's too
+     */
+    bool cancelled() const
+    {
+        return _cancelled.load() || !_running.load();
+    }
+
+    /**
+     * @brief Wait for the run to end by itself, it isn't given up on: join() it after this
+     *
+     * @return true once it ended (or there was none), false if it's still going after `timeoutMs`
+     */
+    bool wait(uint32_t timeoutMs)
+    {
+        if (!_handle) {
+            return true;
+        }
+        if (xSemaphoreTake(_done, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+            return false;
+        }
+        xSemaphoreGive(_done);  // For join()
+        return true;
+    }
+
+    /**
+     * @return true once the run is gone (or there was none), false if it's still going after `timeoutMs`
+     */
+    bool join(uint32_t timeoutMs)
+    {
+        if (!_handle) {
+            return true;
+        }
+        if (xSemaphoreTake(_done, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+            if (timeoutMs == 0) {
+                return false;
+            }
+            if (_run->state.exchange(RUN_ORPHANED) != RUN_DONE) {
+                // Left to end by itself, it frees its Run_t and deletes itself then. Its stack stays with it
+                _run       = nullptr;
+                _heap_only = _heap_only || _on_stack;
+                _handle    = nullptr;
+                _running.store(false);
+                return false;
+            }
+            // It ended just now and is about to signal
+            xSemaphoreTake(_done, portMAX_DELAY);
+        }
+        delete _run;
+        _run = nullptr;
+        if (_on_stack) {
+            // It suspends itself right after signalling, deleting it from here frees the TCB for the next run
+            while (eTaskGetState(_handle) != eSuspended) {
+                vTaskDelay(1);
+            }
+            vTaskDelete(_handle);
+        }
+        _handle = nullptr;
+        return true;
+    }
+
+    bool running() const
+    {
+        return _running.load();
+    }
+
+    explicit operator bool() const
+    {
+        return running();
+    }
+
+    /**
+     * @return the current run's task, nullptr with none
+     */
+    TaskHandle_t handle() const
+    {
+        return _handle;
+    }
+
+private:
+    enum RunState_t : uint8_t { RUN_GOING, RUN_DONE, RUN_ORPHANED };
+
+    struct Run_t {
+        JoinableTask* owner;
+        TaskFunction_t fn;
+        CancellableFunction_t cancellableFn;
+        void* arg;
+        bool onStack;
+        std::atomic<uint8_t> state{RUN_GOING};  // Whichever of the run and join() swaps it second sees the other's
+        CancelToken token;
+    };
+
+    bool start_run(const task_topology::TaskConfig_t& config, TaskFunction_t fn, CancellableFunction_t cancellableFn,
+                   void* arg, const char* name)
+    {
+        if (_running.load() || (_handle && !join(0))) {
+            return false;
+        }
+        if (!_done) {
+            _done = xSemaphoreCreateBinaryStatic(&_done_buffer);
+        }
+        if (!_stack && !_heap_only) {
+            uint32_t caps = (config.psramStack ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL) | MALLOC_CAP_8BIT;
+            _stack        = (StackType_t*)heap_caps_malloc(config.stackSize, caps);
+            _stack_size   = config.stackSize;
+            _stack_psram  = config.psramStack;
+        }
+
+        Run_t* run = new (std::nothrow) Run_t{this, fn, cancellableFn, arg,
+                                              !_heap_only && _stack && config.stackSize <= _stack_size};
+        if (!run) {
+            return false;
+        }
+        _cancelled.store(false);
+        _running.store(true);
+        xSemaphoreTake(_done, 0);
+        if (run->onStack) {
+            _handle = xTaskCreateStaticPinnedToCore(entry, name ? name : config.name, config.stackSize, run,
+                                                    config.priority, _stack, &_tcb, config.core);
+            task_topology::stack_created(name ? name : config.name, config.stackSize, _stack_psram);
+        } else if (task_topology::create(config, entry, run, &_handle, name) != pdPASS) {
+            _handle = nullptr;
+        }
+        if (!_handle) {
+            _running.store(false);
+            delete run;
+            return false;
+        }
+        _run      = run;
+        _on_stack = run->onStack;
+        return true;
+    }
+
+    static void entry(void* param)
+    {
+        Run_t* run = static_cast<Run_t*>(param);
+        if (run->cancellableFn) {
+            run->cancellableFn(run->arg, run->token);
+        } else {
+            run->fn(run->arg);
+        }
+        task_topology::stack_mark();
+
+        JoinableTask* owner = run->owner;
+        bool onStack        = run->onStack;
+        if (run->state.exchange(RUN_DONE) == RUN_ORPHANED) {
+            // Nobody joins it any more, and the owner may be on another run already
+            delete run;
+            if (onStack) {
+                vTaskDelete(nullptr);
+            }
+            task_topology::exit();
+        }
+        // join() frees the run from here on
+        owner->_running.store(false);
+        xSemaphoreGive(owner->_done);
+        if (onStack) {
+            vTaskSuspend(nullptr);  // Until join() deletes it
+        }
+        task_topology::exit();  // A run create() made
+    }
+
+    TaskHandle_t _handle = nullptr;
+    std::atomic<bool> _running{false};
+    SemaphoreHandle_t _done = nullptr;
+    StaticSemaphore_t _done_buffer;
+    StaticTask_t _tcb;
+    StackType_t* _stack  = nullptr;  // Kept from the first start on
+    uint32_t _stack_size = 0;
+    bool _stack_psram    = false;
+    bool _on_stack       = false;  // The current run is on `_stack`
+    bool _heap_only      = false;  // A run was orphaned on `_stack`
+    Run_t* _run          = nullptr;  // Until the run is joined or left to end by itself
+    std::atomic<bool> _cancelled{false};
+};
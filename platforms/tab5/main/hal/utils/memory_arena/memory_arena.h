@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <esp_heap_caps.h>
+#include <multi_heap.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief A heap of its own for buffers that come and go with a stream, reserved as one block at boot
+ *
+ * Station after station the same few buffers are freed and allocated again, in between everything else that uses the
+ * system heap. Here they never mix with those: the region is taken once, before anything could fragment it, and
+ * managed with IDF's own multi_heap allocator. What is still in use and the most that ever was show how big the
+ * region really has to be.
+ *
+ *     static MemoryArena s_arena;
+ *     s_arena.reserve("stream", 8 * 1024 * 1024, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+ *     uint8_t* buffer = (uint8_t*)s_arena.alloc(4096);
+ *     s_arena.free(buffer);
+ *
+ * A buffer the region can't hold comes from the system heap with the same caps and is counted as a fallback, `free()`
+ * tells the two apart by address. Not reserved, or with the reserve failed, every buffer is a fallback.
+ */
+class MemoryArena {
+public:
+    bool reserve(const char* name, size_t size, uint32_t caps)
+    {
+        _name = name;
+        _caps = caps;
+        if (_heap || size == 0) {
+            return _heap != nullptr;
+        }
+        _region = (uint8_t*)heap_caps_malloc(size, caps);
+        if (!_region) {
+            return false;
+        }
+        _heap = multi_heap_register(_region, size);
+        if (!_heap) {
+            heap_caps_free(_region);
+            _region = nullptr;
+            return false;
+        }
+        multi_heap_set_lock(_heap, &_lock);
+        _size = size;
+        return true;
+    }
+
+    void* alloc(size_t size)
+    {
+        void* p = _heap ? multi_heap_malloc(_heap, size) : nullptr;
+        if (!p) {
+            p = heap_caps_malloc(size, _caps);
+            if (p) {
+                _fallbacks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        return p;
+    }
+
+    void free(void* p)
+    {
+        if (contains(p)) {
+            multi_heap_free(_heap, p);
+        } else {
+            heap_caps_free(p);
+        }
+    }
+
+    bool contains(const void* p) const
+    {
+        return _region && p >= _region && (const uint8_t*)p < _region + _size;
+    }
+
+    const char* name() const
+    {
+        return _name;
+    }
+
+    // Bytes reserved, 0 if the region couldn't be
+    size_t size() const
+    {
+        return _size;
+    }
+
+    // Bytes allocated in the region, the allocator's block headers included
+    size_t used() const
+    {
+        return _heap ? _size - multi_heap_free_size(_heap) : 0;
+    }
+
+    // Most bytes ever used at once
+    size_t highWater() const
+    {
+        return _heap ? _size - multi_heap_minimum_free_size(_heap) : 0;
+    }
+
+    // Buffers that came from the system heap since boot
+    uint32_t fallbacks() const
+    {
+        return _fallbacks.load(std::memory_order_relaxed);
+    }
+
+private:
+    const char* _name         = "";
+    uint32_t _caps            = MALLOC_CAP_8BIT;
+    uint8_t* _region          = nullptr;
+    size_t _size              = 0;
+    multi_heap_handle_t _heap = nullptr;
+    portMUX_TYPE _lock        = portMUX_INITIALIZER_UNLOCKED;
+    std::atomic<uint32_t> _fallbacks{0};
+};
@@ -0,0 +1,342 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string.h>
+#include <esp_heap_caps.h>
+
+/**
+ * @brief Unpacks a firmware update (pack_ota.py) as it downloads, into whole WRITE_SIZE pieces for the OTA slot
+ *
+ * The update is the app image cut into BLOCK_SIZE blocks, each LZ4 compressed on its own or stored. In a delta
+ * update a block may name a window of the running firmware as its LZ4 dictionary: unchanged code then costs a few
+ * bytes per match. The windows are where pack_ota.py found the block's old bytes, so code that moved still matches.
+ * Everything is held in three PSRAM buffers, a compressed block, a dictionary and the piece being written, whatever
+ * the size of the image.
+ *
+ *     OtaImage image;
+ *     image.begin([](uint32_t offset, uint8_t* dst, size_t len) { return base_read(offset, dst, len); });
+ *     while ((n = http_read(chunk, sizeof(chunk))) > 0) {
+ *         if (!image.feed(chunk, n, [](const uint8_t* piece, size_t len) { return ota_write(piece, len); })) {
+ *             break;  // image.error() says why
+ *         }
+ *     }
+ *     bool complete = image.done();
+ *
+ * Layout, little endian: a Header_t, then per block a uint32 with the length of its data and the BLOCK_* flags, the
+ * dictionary's uint32 offset and length in the running firmware for BLOCK_DICT, and the data.
+ */
+class OtaImage {
+public:
+    static constexpr uint32_t MAGIC      = 0x50553554;  // "T5UP"
+    static constexpr uint16_t VERSION    = 1;
+    static constexpr uint16_t FLAG_DELTA = 1 << 0;  // Blocks refer to the firmware the base hash names
+
+    static constexpr size_t BLOCK_SIZE   = 32 * 1024;  // Dictionary and block both in reach of a 16 bit LZ4 offset
+    static constexpr size_t DICT_MAX     = 64 * 1024;
+    static constexpr size_t WRITE_SIZE   = 64 * 1024;  // Whole flash blocks, two compressed blocks each
+    static constexpr size_t BLOCK_IN_MAX = BLOCK_SIZE + BLOCK_SIZE / 255 + 16;  // LZ4's worst case, past stored
+
+    static constexpr uint32_t BLOCK_STORED = 1u << 31;
+    static constexpr uint32_t BLOCK_DICT   = 1u << 30;
+    static constexpr uint32_t BLOCK_LENGTH = BLOCK_DICT - 1;
+
+    struct __attribute__((packed)) Header_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        uint32_t imageSize;  // The app image as esp_ota_write() gets it
+        uint32_t baseSize;   // Bytes of the running firmware baseSha256 covers, 0 for a full update
+        uint8_t imageSha256[32];
+        uint8_t baseSha256[32];
+    };
+
+    // Reads `len` bytes of the running firmware at `offset`, for the dictionaries of a delta update
+    using BaseReader = std::function<bool(uint32_t offset, uint8_t* dst, size_t len)>;
+    // Takes the next piece of the new image, WRITE_SIZE but for the last one
+    using Sink = std::function<bool(const uint8_t* piece, size_t len)>;
+
+    ~OtaImage()
+    {
+        end();
+    }
+
+    bool begin(BaseReader base = nullptr)
+    {
+        end();
+        _in    = (uint8_t*)heap_caps_malloc(BLOCK_IN_MAX, MALLOC_CAP_SPIRAM);
+        _dict  = (uint8_t*)heap_caps_malloc(DICT_MAX, MALLOC_CAP_SPIRAM);
+        _piece = (uint8_t*)heap_caps_malloc(WRITE_SIZE, MALLOC_CAP_SPIRAM);
+        _base  = std::move(base);
+        if (!_in || !_dict || !_piece) {
+            end();
+            return fail("no PSRAM for the buffers");
+        }
+        return true;
+    }
+
+    void end()
+    {
+        heap_caps_free(_in);
+        heap_caps_free(_dict);
+        heap_caps_free(_piece);
+        _in        = nullptr;
+        _dict      = nullptr;
+        _piece     = nullptr;
+        _state     = HEADER;
+        _have      = 0;
+        _need      = 0;
+        _pieceFill = 0;
+        _produced  = 0;
+        _error     = nullptr;
+    }
+
+    /**
+     * @brief Take the next bytes of the download, however they were cut, handing `sink` each piece that fills up
+     *
+     * @return false on a malformed update or a failed write, see error()
+     */
+    bool feed(const uint8_t* data, size_t len, const Sink& sink)
+    {
+        while (len > 0 && !_error) {
+            if (_state == DONE) {
+                return fail("data past the end of the image");
+            }
+            size_t n;
+            if (_state == HEADER) {
+                n = take((uint8_t*)&_header, sizeof(_header), data, len);
+                if (_have == sizeof(_header) && !header_ok()) {
+                    return false;
+                }
+            } else if (_state == BLOCK_INFO) {
+                n = take(_info, 4, data, len);
+                if (_have == 4 && _need == 4 && (word(0) & BLOCK_DICT)) {
+                    _need = sizeof(_info);
+                }
+            } else {
+                n = take(_in, _need, data, len);
+            }
+            data += n;
+            len -= n;
+            if (_have == _need && !next(sink)) {
+                return false;
+            }
+        }
+        return !_error;
+    }
+
+    // The whole image has arrived and gone to the sink
+    bool done() const
+    {
+        return _state == DONE && !_error;
+    }
+
+    const Header_t& header() const
+    {
+        return _header;
+    }
+
+    bool isDelta() const
+    {
+        return _header.flags & FLAG_DELTA;
+    }
+
+    // Bytes of the new image decoded so far
+    uint32_t produced() const
+    {
+        return _produced;
+    }
+
+    const char* error() const
+    {
+        return _error;
+    }
+
+    /**
+     * @brief LZ4 block decoder, `dict` is what came right before `dst`
+     *
+     * @return bytes written to `dst`, -1 for a block that doesn't decode to within `dstLen`
+     */
+    static int lz4_decode(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstLen, const uint8_t* dict,
+                          size_t dictLen)
+    {
+        const uint8_t* end = src + srcLen;
+        size_t out         = 0;
+        while (src < end) {
+            uint8_t token   = *src++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !extend(&src, end, &literals)) {
+                return -1;
+            }
+            if (literals > (size_t)(end - src) || literals > dstLen - out) {
+                return -1;
+            }
+            memcpy(dst + out, src, literals);
+            src += literals;
+            out += literals;
+            if (src == end) {
+                break;  // The last sequence has no match
+            }
+            if (end - src < 2) {
+                return -1;
+            }
+            size_t offset = src[0] | (src[1] << 8);
+            src += 2;
+            size_t match = (token & 15) + 4;
+            if ((token & 15) == 15 && !extend(&src, end, &match)) {
+                return -1;
+            }
+            if (offset == 0 || offset > out + dictLen || match > dstLen - out) {
+                return -1;
+            }
+            // Out of the dictionary first, where the match starts before this block
+            if (offset > out) {
+                size_t from = dictLen - (offset - out);
+                size_t n    = std::min(match, offset - out);
+                memcpy(dst + out, dict + from, n);
+                out += n;
+                match -= n;
+            }
+            // Byte by byte, a match may overlap what it copies
+            for (size_t i = 0; i < match; i++) {
+                dst[out + i] = dst[out + i - offset];
+            }
+            out += match;
+        }
+        return (int)out;
+    }
+
+private:
+    enum State_t { HEADER, BLOCK_INFO, BLOCK_DATA, DONE };
+
+    static bool extend(const uint8_t** src, const uint8_t* end, size_t* length)
+    {
+        uint8_t b;
+        do {
+            if (*src == end) {
+                return false;
+            }
+            b = *(*src)++;
+            *length += b;
+        } while (b == 255);
+        return true;
+    }
+
+    bool fail(const char* why)
+    {
+        _error = why;
+        return false;
+    }
+
+    uint32_t word(int i) const
+    {
+        return _info[i * 4] | (_info[i * 4 + 1] << 8) | (_info[i * 4 + 2] << 16) | ((uint32_t)_info[i * 4 + 3] << 24);
+    }
+
+    size_t take(uint8_t* dst, size_t need, const uint8_t* data, size_t len)
+    {
+        if (_need == 0) {
+            _need = need;
+        }
+        size_t n = std::min(len, _need - _have);
+        memcpy(dst + _have, data, n);
+        _have += n;
+        return n;
+    }
+
+    bool header_ok()
+    {
+        if (_header.magic != MAGIC || _header.version != VERSION) {
+            return fail("not a firmware update");
+        }
+        if (_header.imageSize == 0) {
+            return fail("empty image");
+        }
+        if (isDelta() && !_base) {
+            return fail("a delta update with nothing to apply it to");
+        }
+        return true;
+    }
+
+    // A field filled up: move on to the next one, or decode the block that's complete
+    bool next(const Sink& sink)
+    {
+        State_t state = _state;
+        _have = _need = 0;
+        if (state == HEADER) {
+            _state = BLOCK_INFO;
+            return true;
+        }
+        if (state == BLOCK_INFO) {
+            if ((word(0) & BLOCK_LENGTH) > BLOCK_IN_MAX || (word(0) & BLOCK_LENGTH) == 0) {
+                return fail("block length out of range");
+            }
+            _need  = word(0) & BLOCK_LENGTH;
+            _state = BLOCK_DATA;
+            return true;
+        }
+        _state = BLOCK_INFO;
+        return decode_block(sink);
+    }
+
+    bool decode_block(const Sink& sink)
+    {
+        uint32_t info  = word(0);
+        size_t srcLen  = info & BLOCK_LENGTH;
+        size_t expect  = std::min<size_t>(BLOCK_SIZE, _header.imageSize - _produced);
+        size_t dictLen = 0;
+        if (info & BLOCK_DICT) {
+            dictLen = word(2);
+            if (!isDelta() || dictLen > DICT_MAX || word(1) + (uint64_t)dictLen > _header.baseSize) {
+                return fail("dictionary out of range");
+            }
+            if (!_base(word(1), _dict, dictLen)) {
+                return fail("can't read the running firmware");
+            }
+        }
+
+        // Decodes straight into the piece being written, WRITE_SIZE is whole blocks
+        uint8_t* dst = _piece + _pieceFill;
+        if (info & BLOCK_STORED) {
+            if (srcLen != expect) {
+                return fail("stored block of the wrong size");
+            }
+            memcpy(dst, _in, srcLen);
+        } else if (lz4_decode(_in, srcLen, dst, expect, _dict, dictLen) != (int)expect) {
+            return fail("block doesn't decode");
+        }
+        _pieceFill += expect;
+        _produced += expect;
+
+        bool last = _produced == _header.imageSize;
+        if (_pieceFill == WRITE_SIZE || last) {
+            if (!sink(_piece, _pieceFill)) {
+                return fail("write failed");
+            }
+            _pieceFill = 0;
+        }
+        if (last) {
+            _state = DONE;
+        }
+        return true;
+    }
+
+    Header_t _header   = {};
+    BaseReader _base   = nullptr;
+    State_t _state     = HEADER;
+    uint8_t _info[12]  = {};
+    uint8_t* _in       = nullptr;
+    uint8_t* _dict     = nullptr;
+    uint8_t* _piece    = nullptr;
+    size_t _have       = 0;
+    size_t _need       = 0;
+    size_t _pieceFill  = 0;
+    uint32_t _produced = 0;
+    const char* _error = nullptr;
+};
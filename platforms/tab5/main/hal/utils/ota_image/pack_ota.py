@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2025
+#
+# SPDX-License-Identifier: MIT
+"""
+Pack an app image into a firmware update for HalBase::startFirmwareUpdate(), the format ota_image.h unpacks.
+
+Blocks are LZ4 compressed one by one. With --base, the firmware the Tab5s run now, it's a delta update: each block
+may use the stretch of the old image where its bytes were found as a dictionary, and the update only applies on top
+of exactly that image.
+
+    python3 pack_ota.py build/m5stack_tab5.bin update.t5u
+    python3 pack_ota.py build/m5stack_tab5.bin update.t5u --base old/m5stack_tab5.bin
+"""
+import argparse
+import collections
+import hashlib
+import struct
+
+MAGIC = 0x50553554
+VERSION = 1
+FLAG_DELTA = 1 << 0
+BLOCK_SIZE = 32 * 1024
+DICT_MAX = 64 * 1024
+DICT_LEAD = 16 * 1024  # How far before the block's old bytes the dictionary starts, moves either way stay in reach
+BLOCK_STORED = 1 << 31
+BLOCK_DICT = 1 << 30
+
+MIN_MATCH = 4
+LAST_LITERALS = 5     # The block format wants the last bytes as literals
+MATCH_LIMIT = 12      # and no match starting this close to the end
+MAX_OFFSET = 0xFFFF
+
+GRAM = 16             # Bytes looked up in the old image to find where a block came from
+GRAM_STRIDE = 8
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def lz4_compress(src, dictionary=b""):
+    """Greedy LZ4 block compressor, hashing 4-byte sequences, matches may reach back into `dictionary`"""
+    data = dictionary + src
+    out = bytearray()
+    table = {}
+    for j in range(len(dictionary) - MIN_MATCH + 1):
+        table[data[j:j + MIN_MATCH]] = j
+    anchor = i = len(dictionary)
+    end = len(data)
+    limit = end - MATCH_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = i
+        if ref is None or i - ref > MAX_OFFSET:
+            i += 1
+            continue
+        n = MIN_MATCH
+        while i + n < end - LAST_LITERALS and data[ref + n] == data[i + n]:
+            n += 1
+        literals = i - anchor
+        ml = n - MIN_MATCH
+        out.append((min(literals, 15) << 4) | min(ml, 15))
+        if literals >= 15:
+            _length(out, literals - 15)
+        out += data[anchor:i]
+        out += struct.pack("<H", i - ref)
+        if ml >= 15:
+            _length(out, ml - 15)
+        i += n
+        anchor = i
+    literals = end - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        _length(out, literals - 15)
+    out += data[anchor:]
+    return bytes(out)
+
+
+def index_base(base):
+    grams = {}
+    for j in range(0, len(base) - GRAM + 1, GRAM_STRIDE):
+        grams.setdefault(base[j:j + GRAM], j)
+    return grams
+
+
+def find_dictionary(block, base, grams):
+    """Where the block's bytes sit in the old image: the shift most of its sampled sequences agree on"""
+    shifts = collections.Counter()
+    for p in range(0, len(block) - GRAM + 1):
+        j = grams.get(block[p:p + GRAM])
+        if j is not None:
+            shifts[j - p] += 1
+    if not shifts:
+        return None
+    start = shifts.most_common(1)[0][0] - DICT_LEAD
+    start = max(0, min(start, len(base) - DICT_MAX))
+    return start, min(DICT_MAX, len(base) - start)
+
+
+def pack_block(block, base, grams):
+    best = (BLOCK_STORED | len(block), b"", block)
+    packed = lz4_compress(block)
+    if len(packed) < len(best[2]):
+        best = (len(packed), b"", packed)
+    if base:
+        window = find_dictionary(block, base, grams)
+        if window:
+            start, length = window
+            packed = lz4_compress(block, base[start:start + length])
+            if len(packed) + 8 < len(best[2]) + len(best[1]):
+                best = (BLOCK_DICT | len(packed), struct.pack("<II", start, length), packed)
+    info, extra, data = best
+    return struct.pack("<I", info) + extra + data, bool(info & BLOCK_DICT)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="the app image, build/<project>.bin")
+    parser.add_argument("output")
+    parser.add_argument("--base", help="the app image the update applies to, for a delta update")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    base = b""
+    if args.base:
+        with open(args.base, "rb") as f:
+            base = f.read()
+    grams = index_base(base) if base else {}
+
+    blocks = []
+    matched = 0
+    for offset in range(0, len(image), BLOCK_SIZE):
+        packed, delta = pack_block(image[offset:offset + BLOCK_SIZE], base, grams)
+        blocks.append(packed)
+        matched += delta
+
+    with open(args.output, "wb") as f:
+        f.write(struct.pack("<IHHII", MAGIC, VERSION, FLAG_DELTA if base else 0, len(image), len(base)))
+        f.write(hashlib.sha256(image).digest())
+        f.write(hashlib.sha256(base).digest() if base else bytes(32))
+        for packed in blocks:
+            f.write(packed)
+    size = 84 + sum(len(b) for b in blocks)
+    print("%s: %d -> %d bytes, %d blocks%s" % (args.output, len(image), size, len(blocks),
+                                               ", %d from the base" % matched if base else ""))
+
+
+if __name__ == "__main__":
+    main()
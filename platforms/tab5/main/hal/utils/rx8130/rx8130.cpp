@@ -150,32 +150,20 @@ void RX8130_Class::setAlarmIrq(struct tm* time)
     clrbit(buf, 5);
     writeRegister8(RX8130_REG_CTRL0, buf);
 
-    buf = readRegister8(RX8130_REG_CTRL0);
-    // debug_print_reg(0x1E, buf);
-
-    // Hour AE, week AE day AE
-    buf = 0x80;
-    writeRegister8(RX8130_REG_ALWDAY, buf);
-    buf = readRegister8(RX8130_REG_ALWDAY);
-    // debug_print_reg(0x19, buf);
-
-    buf = 0x80;
-    writeRegister8(RX8130_REG_ALHOUR, buf);
-    buf = readRegister8(RX8130_REG_ALHOUR);
-    // debug_print_reg(0x18, buf);
-
-    buf = 0x80;
-    writeRegister8(RX8130_REG_ALMIN, buf);
-    buf = readRegister8(RX8130_REG_ALMIN);
-    // debug_print_reg(0x17, buf);
+    // Any day (AE set), at the hour and minute given (AE clear)
+    writeRegister8(RX8130_REG_ALWDAY, 0x80);
+    writeRegister8(RX8130_REG_ALHOUR, dec2bcd(time->tm_hour % 24));
+    writeRegister8(RX8130_REG_ALMIN, dec2bcd(time->tm_min % 60));
 
     // Write 1 to AIE
     buf = readRegister8(RX8130_REG_CTRL0);
     setbit(buf, 3);
     writeRegister8(RX8130_REG_CTRL0, buf);
+}
 
-    buf = readRegister8(RX8130_REG_CTRL0);
-    // debug_print_reg(0x1E, buf);
+bool RX8130_Class::alarmFired()
+{
+    return readRegister8(RX8130_REG_FLAG) & RX8130_BIT_FLAG_AF;
 }
 
 // RX8130 寄存器地址
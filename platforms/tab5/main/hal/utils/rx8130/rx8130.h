@@ -22,7 +22,8 @@ public:
     void getTime(struct tm* time);
     void clearIrqFlags();
     void disableIrq();
-    void setAlarmIrq(struct tm* time);
+    void setAlarmIrq(struct tm* time);  // Daily, at tm_hour:tm_min
+    bool alarmFired();                  // AF, set until clearIrqFlags()
     void setTimerIrq(uint16_t seconds);
 
 protected:
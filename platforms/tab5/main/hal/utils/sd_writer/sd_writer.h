@@ -0,0 +1,208 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <esp_dma_utils.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+/**
+ * @brief A file on the SD card written in whole, cluster aligned blocks from a DMA capable buffer in PSRAM
+ *
+ * FatFs hands a block this size to the card as one multi-sector transfer straight out of the buffer, where small or
+ * unaligned writes go sector by sector through a bounce buffer. The file grows PREALLOCATE_STEP at a time, so the
+ * FAT is updated once per step rather than once per cluster, and the size on the card is brought up to date first:
+ * a power cut loses at most the last step. Writes block on the card, call it from a low priority task.
+ *
+ *     SdWriter writer;
+ *     writer.open(SDCARD_MOUNT_POINT "/radio/001.mp3");
+ *     size_t n = ring.readCursor(cursor, writer.space(), writer.spaceLeft(), &skipped);
+ *     writer.commit(n);  // Goes out once the block is full
+ *     writer.close();
+ */
+class SdWriter {
+public:
+    static constexpr size_t BLOCK_SIZE       = 64 * 1024;  // A multiple of the cluster size cards come formatted with
+    static constexpr size_t PREALLOCATE_STEP = 4 * 1024 * 1024;
+
+    struct Stats_t {
+        uint64_t bytes   = 0;
+        uint32_t blocks  = 0;  // Writes to the card, a short one at the end of each file
+        uint64_t busyUs  = 0;  // In those writes and the preallocation
+        uint32_t worstUs = 0;  // Longest of them, card housekeeping shows here
+
+        float mbps() const
+        {
+            return busyUs > 0 ? (float)bytes / busyUs : 0;
+        }
+    };
+
+    ~SdWriter()
+    {
+        close();
+        heap_caps_free(_block);
+    }
+
+    /**
+     * @brief Create `path`, or empty it if it's there. Stats add up across files
+     */
+    bool open(const char* path)
+    {
+        close();
+        if (!_block && !alloc_block()) {
+            return false;
+        }
+        _file = fopen(path, "wb");
+        if (!_file) {
+            return false;
+        }
+        // Blocks are handed over whole, stdio buffering would only add a copy
+        setvbuf(_file, nullptr, _IONBF, 0);
+        _fill        = 0;
+        _written     = 0;
+        _allocated   = 0;
+        _preallocate = true;
+        _ok          = true;
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return _file != nullptr;
+    }
+
+    /**
+     * @brief Where the next bytes go, spaceLeft() of them, for a producer that can read straight into it
+     */
+    uint8_t* space()
+    {
+        return _block + _fill;
+    }
+
+    size_t spaceLeft() const
+    {
+        return BLOCK_SIZE - _fill;
+    }
+
+    /**
+     * @brief Take `len` bytes put at space(), the block goes to the card once full
+     *
+     * @return false once a write failed, the file is no good past that
+     */
+    bool commit(size_t len)
+    {
+        _fill += std::min(len, spaceLeft());
+        if (_fill == BLOCK_SIZE && _ok) {
+            write_out(BLOCK_SIZE);
+        }
+        return _ok;
+    }
+
+    bool write(const void* data, size_t len)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        while (len > 0 && _ok) {
+            size_t n = std::min(len, spaceLeft());
+            memcpy(space(), p, n);
+            commit(n);
+            p += n;
+            len -= n;
+        }
+        return _ok;
+    }
+
+    /**
+     * @brief Write what's left, give the preallocation past it back and close
+     *
+     * @return false if any write to the file failed
+     */
+    bool close()
+    {
+        if (!_file) {
+            return false;
+        }
+        if (_fill > 0 && _ok) {
+            write_out(_fill);
+        }
+        if (_allocated > _written && ftruncate(fileno(_file), _written) != 0) {
+            _ok = false;
+        }
+        _ok   = (fclose(_file) == 0) && _ok;
+        _file = nullptr;
+        return _ok;
+    }
+
+    const Stats_t& stats() const
+    {
+        return _stats;
+    }
+
+private:
+    FILE* _file         = nullptr;
+    uint8_t* _block     = nullptr;
+    size_t _fill        = 0;
+    uint64_t _written   = 0;  // Bytes on the card, the file position
+    uint64_t _allocated = 0;
+    bool _preallocate   = true;
+    bool _ok            = true;
+    Stats_t _stats;
+
+    bool alloc_block()
+    {
+        // Cache line aligned, which is what the SDMMC DMA needs to read PSRAM without a bounce buffer
+        esp_dma_mem_info_t info  = {};
+        info.extra_heap_caps     = MALLOC_CAP_SPIRAM;
+        info.dma_alignment_bytes = 4;
+        size_t actual            = 0;
+        if (esp_dma_capable_malloc(BLOCK_SIZE, &info, (void**)&_block, &actual) != ESP_OK) {
+            info.extra_heap_caps = 0;
+            if (esp_dma_capable_malloc(BLOCK_SIZE, &info, (void**)&_block, &actual) != ESP_OK) {
+                _block = nullptr;
+            }
+        }
+        return _block != nullptr;
+    }
+
+    void preallocate()
+    {
+        // What's written so far gets its size on the card before the next step is claimed
+        fsync(fileno(_file));
+        uint64_t target = _written + PREALLOCATE_STEP;
+        if (fseek(_file, (long)target, SEEK_SET) != 0) {
+            _preallocate = false;  // Grows a cluster at a time then, as without
+        } else {
+            _allocated = target;
+        }
+        if (fseek(_file, (long)_written, SEEK_SET) != 0) {
+            _ok = false;
+        }
+    }
+
+    void write_out(size_t len)
+    {
+        int64_t start = esp_timer_get_time();
+        if (_preallocate && _written + len > _allocated) {
+            preallocate();
+        }
+        if (_ok && fwrite(_block, 1, len, _file) != len) {
+            _ok = false;
+        }
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+        if (_ok) {
+            _written += len;
+            _stats.bytes += len;
+        }
+        _stats.blocks++;
+        _stats.busyUs += elapsed;
+        _stats.worstUs = std::max(_stats.worstUs, elapsed);
+        _fill          = 0;
+    }
+};
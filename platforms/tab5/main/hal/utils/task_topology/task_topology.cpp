@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "task_topology.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace task_topology;
+
+#define STACK_MAX_TASKS 64  // Names kept, more than ever run at once: a task that's gone keeps its entry
+
+// By name, what's known of a task stays over its runs and with it gone
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static StackUse_t s_stacks[STACK_MAX_TASKS];
+static int s_count = 0;
+
+// Under the lock
+static StackUse_t* find_stack(const char* name)
+{
+    for (int i = 0; i < s_count; i++) {
+        if (strncmp(s_stacks[i].name, name, sizeof(s_stacks[i].name)) == 0) {
+            return &s_stacks[i];
+        }
+    }
+    if (s_count == STACK_MAX_TASKS) {
+        return nullptr;
+    }
+    StackUse_t* use = &s_stacks[s_count++];
+    *use            = {};
+    strncpy(use->name, name, sizeof(use->name) - 1);
+    use->leastFree = UINT32_MAX;
+    return use;
+}
+
+static void note_free(const char* name, uint32_t freeBytes)
+{
+    portENTER_CRITICAL(&s_lock);
+    StackUse_t* use = find_stack(name);
+    if (use) {
+        use->leastFree = std::min(use->leastFree, freeBytes);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void task_topology::stack_created(const char* name, uint32_t stackSize, bool psram)
+{
+    portENTER_CRITICAL(&s_lock);
+    StackUse_t* use = find_stack(name);
+    if (use) {
+        // A role that's run with another size takes the bigger one, its marks may be from that
+        use->stackSize = std::max(use->stackSize, stackSize);
+        use->psram     = psram;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void task_topology::stack_mark()
+{
+    note_free(pcTaskGetName(nullptr), uxTaskGetStackHighWaterMark(nullptr));
+}
+
+// The running tasks, their marks noted
+static std::vector<TaskStatus_t> sample_running()
+{
+    std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);  // Room for a few started meanwhile
+    status.resize(uxTaskGetSystemState(status.data(), status.size(), nullptr));
+    for (const auto& task : status) {
+        note_free(task.pcTaskName, task.usStackHighWaterMark);
+    }
+    return status;
+}
+
+void task_topology::stack_sample()
+{
+    sample_running();
+}
+
+std::vector<StackUse_t> task_topology::stack_report()
+{
+    std::vector<TaskStatus_t> status = sample_running();
+
+    std::vector<StackUse_t> report;
+    report.reserve(STACK_MAX_TASKS);  // Nothing is allocated under the lock
+    portENTER_CRITICAL(&s_lock);
+    report.assign(s_stacks, s_stacks + s_count);
+    portEXIT_CRITICAL(&s_lock);
+
+    for (auto& use : report) {
+        use.running = std::any_of(status.begin(), status.end(), [&](const TaskStatus_t& task) {
+            return strncmp(task.pcTaskName, use.name, sizeof(use.name)) == 0;
+        });
+        if (use.leastFree == UINT32_MAX) {
+            use.leastFree = 0;  // Made, but gone before anything was seen of it
+            continue;
+        }
+        if (use.stackSize == 0) {
+            continue;
+        }
+        uint32_t used   = use.stackSize - std::min(use.leastFree, use.stackSize);
+        uint32_t margin = std::max(used * STACK_MARGIN_PERCENT / 100, STACK_MARGIN_MIN);
+        use.recommended = (used + margin + STACK_ROUND - 1) / STACK_ROUND * STACK_ROUND;
+    }
+    std::sort(report.begin(), report.end(),
+              [](const StackUse_t& a, const StackUse_t& b) { return a.stackSize > b.stackSize; });
+    return report;
+}
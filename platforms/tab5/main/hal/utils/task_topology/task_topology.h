@@ -0,0 +1,170 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/idf_additions.h>
+
+/**
+ * @brief Where every long-lived task runs, in one place
+ *
+ * Core 1 belongs to audio: the decoder (with the output DSP) has to reach I2S once per frame, nothing else that
+ * can hold a core for long may run there. Core 0 takes the network, the SD card, the camera and the UI. The UI
+ * sits below the network so a heavy redraw never starves the socket reads that keep the ring buffer full.
+ *
+ * Stack sizes have room over the high-water marks the tasks log when they exit (`stack_headroom()`), re-check
+ * them there after changing what a task does. `stack_report()` has them for every task, the least any of them had
+ * free since boot and a size from that, the stress benchmark and the `stacks` console command print it.
+ *
+ * Stacks come from internal SRAM, which I2S, DMA and the network's buffers need too. A task marked PSRAM_STACK takes
+ * its stack from PSRAM instead: one that's neither timing critical nor hands a buffer on its stack to DMA. With the
+ * code running from PSRAM (CONFIG_SPIRAM_XIP_FROM_PSRAM) the cache stays on through flash writes, so those are no
+ * reason to keep a stack internal. Such a task ends with `exit()`, which frees the stack it was made with.
+ */
+namespace task_topology {
+
+static constexpr BaseType_t CORE_NETWORK = 0;
+static constexpr BaseType_t CORE_AUDIO   = 1;
+
+static constexpr bool PSRAM_STACK = true;
+
+struct TaskConfig_t {
+    const char* name;
+    uint32_t stackSize;  // Bytes
+    UBaseType_t priority;
+    BaseType_t core;
+    bool psramStack = false;  // PSRAM_STACK, see above
+};
+
+// Audio
+static constexpr TaskConfig_t AUDIO_PLAYER   = {"audio_player", 4096, 8, CORE_AUDIO};  // Local files (music app)
+static constexpr TaskConfig_t RADIO_OUTPUT   = {"radio_out", 4096, 7, CORE_AUDIO};     // Feeds I2S from decoded frames
+static constexpr TaskConfig_t RADIO_DECODE   = {"audio_decode", 8192, 6, CORE_AUDIO};
+static constexpr TaskConfig_t RADIO_SPECTRUM = {"radio_fft", 4096, 2, CORE_AUDIO};     // Only feeds the display
+static constexpr TaskConfig_t MIXER          = {"mixer", 4096, 5, CORE_AUDIO};         // UI sounds, nothing else playing
+static constexpr TaskConfig_t MIC_CAPTURE    = {"mic_capture", 3072, 7, CORE_AUDIO};   // Waits on I2S nearly always
+static constexpr TaskConfig_t MIC_TEST       = {"rec", 4096, 5, CORE_AUDIO};           // Factory record-and-play test
+static constexpr TaskConfig_t MUSIC_TEST     = {"music", 3072, 5, CORE_AUDIO};         // Holds the player for a tune
+static constexpr TaskConfig_t BOOT_DEFERRED  = {"boot_late", 6144, 1, CORE_AUDIO};     // HalEsp32::deferred_init
+
+// Network and storage
+static constexpr TaskConfig_t HTTP_STREAM  = {"http_stream", 8192, 5, CORE_NETWORK};
+static constexpr TaskConfig_t RADIO_FILES  = {"radio_files", 4096, 5, CORE_NETWORK};  // SD card files into the ring
+static constexpr TaskConfig_t RADIO_RELAY  = {"radio_relay", 4096, 4, CORE_NETWORK};
+static constexpr TaskConfig_t WEB_REMOTE   = {"web_remote", 4096, 2, CORE_NETWORK, PSRAM_STACK};  // State pushes, 10 Hz
+static constexpr TaskConfig_t MQTT         = {"mqtt_task", 6144, 3, CORE_NETWORK};   // esp-mqtt's, from its config
+static constexpr TaskConfig_t MQTT_PUBLISH = {"mqtt_pub", 4096, 2, CORE_NETWORK, PSRAM_STACK};  // Batched publishes
+static constexpr TaskConfig_t SYNC         = {"sync", 4096, 5, CORE_NETWORK};  // Multi-room clock, answers in time
+static constexpr TaskConfig_t DNS_PREWARM  = {"dns_warm", 4096, 3, CORE_NETWORK, PSRAM_STACK};
+static constexpr TaskConfig_t RADIO_RECORD = {"radio_rec", 4096, 2, CORE_NETWORK};
+static constexpr TaskConfig_t RADIO_PROBE  = {"radio_probe", 6144, 1, CORE_NETWORK, PSRAM_STACK};  // Mirror ranking
+static constexpr TaskConfig_t FW_UPDATE    = {"fw_update", 6144, 1, CORE_NETWORK};    // Downloads under the radio
+static constexpr TaskConfig_t BACKGROUND   = {"bg_job", 8192, 2, CORE_NETWORK};       // HalBase::runInBackground() workers
+static constexpr TaskConfig_t SD_WATCH     = {"sd_watch", 4096, 1, CORE_NETWORK};     // Mounts the card, notices removal
+static constexpr TaskConfig_t MEDIA_INDEX  = {"media_index", 6144, 1, CORE_NETWORK};  // Card scans, idle time only
+static constexpr TaskConfig_t VOICE        = {"voice", 6144, 3, CORE_NETWORK};        // Spoken commands, mic AEC
+static constexpr TaskConfig_t CAMERA_VIEW  = {"cam_view", 4096, 2, CORE_NETWORK};     // One per camera stream viewer
+static constexpr TaskConfig_t PRESENCE     = {"presence", 8192, 1, CORE_NETWORK, PSRAM_STACK};  // Face detection, 2 fps
+static constexpr TaskConfig_t IMU          = {"imu", 4096, 2, CORE_NETWORK, PSRAM_STACK};  // BMI270 FIFO drain, 10 Hz
+static constexpr TaskConfig_t POWER        = {"power", 4096, 1, CORE_NETWORK, PSRAM_STACK};  // INA226 samples, 7 Hz
+static constexpr TaskConfig_t HEADPHONE    = {"hp_jack", 3072, 3, CORE_NETWORK};      // Jack INT, debounce, routing
+static constexpr TaskConfig_t I2C_SCAN     = {"i2c_scan", 3072, 1, CORE_NETWORK, PSRAM_STACK};  // Bus scans on request
+static constexpr TaskConfig_t RS485        = {"rs485", 4096, 4, CORE_NETWORK};        // Framed link, wakes per FIFO
+static constexpr TaskConfig_t USB_AUDIO    = {"usb_audio", 4096, 5, CORE_NETWORK};    // USB DAC plugs, UAC driver
+
+// UI. LVGL creates its two SW draw units (CONFIG_LV_DRAW_SW_DRAW_UNIT_CNT) itself, unpinned at LV_THREAD_PRIO_HIGH (3):
+// below every audio task but the display-only spectrum, so on core 1 a redraw only takes what audio leaves idle
+static constexpr TaskConfig_t LVGL   = {"taskLVGL", 8192, 3, CORE_NETWORK};
+static constexpr TaskConfig_t CAMERA = {"cam", 8192, 3, CORE_NETWORK};
+static constexpr TaskConfig_t TOUCH  = {"touch", 3072, 4, CORE_NETWORK};  // One short I2C read per INT, ahead of LVGL
+static constexpr TaskConfig_t KEYPAD = {"keypad", 3072, 4, CORE_NETWORK};  // One FIFO burst per INT (hal_keypad.cpp)
+
+/**
+ * @brief Note a task's stack size for `stack_report()`, create() does for the tasks it makes
+ */
+void stack_created(const char* name, uint32_t stackSize, bool psram);
+
+/**
+ * @brief Note how little of its stack the calling task has had free so far, for `stack_report()`
+ */
+void stack_mark();
+
+/**
+ * @param name overrides the config's, for tasks that exist in several roles
+ */
+inline BaseType_t create(const TaskConfig_t& config, TaskFunction_t fn, void* arg, TaskHandle_t* handle,
+                         const char* name = nullptr)
+{
+    name = name ? name : config.name;
+    if (config.psramStack) {
+        BaseType_t created = xTaskCreatePinnedToCoreWithCaps(fn, name, config.stackSize, arg, config.priority, handle,
+                                                             config.core, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (created == pdPASS) {
+            stack_created(name, config.stackSize, true);
+            return created;
+        }
+        // Short of PSRAM it still runs, on an internal stack
+    }
+    stack_created(name, config.stackSize, false);
+    return xTaskCreatePinnedToCore(fn, name, config.stackSize, arg, config.priority, handle, config.core);
+}
+
+/**
+ * @brief End the calling task, one create() made: its high-water mark is noted and a PSRAM stack freed
+ */
+inline void exit()
+{
+    stack_mark();
+    // create() makes only the PSRAM stacks static, vTaskDeleteWithCaps() frees them
+    StackType_t* stack = nullptr;
+    StaticTask_t* tcb  = nullptr;
+    if (xTaskGetStaticBuffers(nullptr, &stack, &tcb) == pdTRUE) {
+        vTaskDeleteWithCaps(nullptr);
+    } else {
+        vTaskDelete(nullptr);
+    }
+}
+
+/**
+ * @return the least free stack the calling task has had so far, in bytes, noted for `stack_report()` too
+ */
+inline uint32_t stack_headroom()
+{
+    stack_mark();
+    return uxTaskGetStackHighWaterMark(nullptr);
+}
+
+struct StackUse_t {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stackSize;    // Bytes, 0 for a task create() didn't make
+    uint32_t leastFree;    // Since boot, over the runs of a task that was there several times
+    uint32_t recommended;  // What to give it, 0 without a size
+    bool psram;
+    bool running;
+};
+
+/**
+ * @brief Every task's stack use seen so far, the running ones sampled now, biggest stacks first
+ *
+ * A size is recommended for the tasks create() made: the most they used with STACK_MARGIN_PERCENT on top, at least
+ * STACK_MARGIN_MIN bytes, rounded up to STACK_ROUND. That's only as good as the load they were seen under, read it
+ * after a stress run that took every path the task has.
+ */
+std::vector<StackUse_t> stack_report();
+
+/**
+ * @brief Sample the running tasks' high-water marks into the report, cheap enough for every few hundred ms
+ */
+void stack_sample();
+
+static constexpr uint32_t STACK_MARGIN_PERCENT = 25;
+static constexpr uint32_t STACK_MARGIN_MIN     = 1024;  // A log line with formatting in a path not seen
+static constexpr uint32_t STACK_ROUND          = 512;
+
+}  // namespace task_topology
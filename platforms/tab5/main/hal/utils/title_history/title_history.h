@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2025
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <ctype.h>
+#include <string.h>
+#include <esp_heap_caps.h>
+
+/**
+ * @brief Bounded history of (time, station, title), every string interned once
+ *
+ * Entries sit in a ring of MAX_ENTRIES, strings in MAX_STRINGS fixed slots that are reference counted by the
+ * entries using them, so a song in rotation or a station name costs one slot however often it comes up. All of
+ * it is allocated by `init()` and never grows: a new entry that finds the ring or the slots full drops the oldest
+ * entries until there's room. Not thread-safe, the owner locks around it.
+ *
+ *     history.add(time(nullptr), url, title);
+ *     history.search("beat", [](const TitleHistory::Entry_t& e, const char* station, const char* title) {
+ *         return true;  // Newest first, false stops
+ *     });
+ */
+class TitleHistory {
+public:
+    static constexpr int MAX_ENTRIES = 2048;
+    static constexpr int MAX_STRINGS = 1024;
+    static constexpr int STRING_SIZE = 128;  // Longer titles are cut, bytes including the terminator
+
+    struct Entry_t {
+        uint32_t time;  // Unix seconds
+        uint32_t seq;   // Position in everything ever added, see `entriesSince()`
+        uint16_t station;
+        uint16_t title;
+    };
+
+    ~TitleHistory()
+    {
+        heap_caps_free(_entries);
+        heap_caps_free(_strings);
+    }
+
+    /**
+     * @brief Allocate everything up front, PSRAM preferred
+     */
+    bool init()
+    {
+        if (_entries) {
+            return true;
+        }
+        _entries = (Entry_t*)alloc(sizeof(Entry_t) * MAX_ENTRIES);
+        _strings = (String_t*)alloc(sizeof(String_t) * MAX_STRINGS);
+        if (!_entries || !_strings) {
+            return false;
+        }
+        _free_count = 0;
+        for (int i = MAX_STRINGS - 1; i >= 0; i--) {
+            _strings[i].refs     = 0;
+            _free[_free_count++] = i;
+        }
+        return true;
+    }
+
+    void add(uint32_t time, const char* station, const char* title)
+    {
+        if (!_entries) {
+            return;
+        }
+        // Both strings may need a slot, the lookup of the second must not free the first
+        while (_count == MAX_ENTRIES || _free_count < 2) {
+            drop_oldest();
+        }
+        Entry_t& entry = _entries[(_first + _count) % MAX_ENTRIES];
+        entry.time     = time;
+        entry.seq      = _next_seq++;
+        entry.station  = intern(station);
+        entry.title    = intern(title);
+        _count++;
+    }
+
+    int size() const
+    {
+        return _count;
+    }
+
+    /**
+     * @return the `seq` the next entry will get
+     */
+    uint32_t nextSeq() const
+    {
+        return _next_seq;
+    }
+
+    /**
+     * @brief Oldest first, the entries added at or after `seq` that are still held
+     * @param fn `void(const Entry_t&, const char* station, const char* title)`
+     */
+    template <typename Fn>
+    void entriesSince(uint32_t seq, Fn fn) const
+    {
+        for (int i = 0; i < _count; i++) {
+            const Entry_t& entry = _entries[(_first + i) % MAX_ENTRIES];
+            if ((int32_t)(entry.seq - seq) >= 0) {
+                fn(entry, _strings[entry.station].text, _strings[entry.title].text);
+            }
+        }
+    }
+
+    /**
+     * @brief Newest first, entries with a word of the title starting with `prefix` (ASCII case-insensitive)
+     *
+     * Each distinct title is matched once per search, not once per entry
+     *
+     * @param fn `bool(const Entry_t&, const char* station, const char* title)`, false stops the search
+     */
+    template <typename Fn>
+    void search(const char* prefix, Fn fn)
+    {
+        // 0 not checked yet, 1 matches, 2 doesn't
+        for (int i = 0; i < MAX_STRINGS; i++) {
+            _strings[i].match = 0;
+        }
+        for (int i = _count - 1; i >= 0; i--) {
+            const Entry_t& entry = _entries[(_first + i) % MAX_ENTRIES];
+            String_t& title      = _strings[entry.title];
+            if (title.match == 0) {
+                title.match = has_word_prefix(title.text, prefix) ? 1 : 2;
+            }
+            if (title.match == 1 && !fn(entry, _strings[entry.station].text, title.text)) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Does a word of `text` start with `prefix`? An empty prefix matches everything
+     */
+    static bool has_word_prefix(const char* text, const char* prefix)
+    {
+        size_t len = strlen(prefix);
+        for (const char* p = text; *p; p++) {
+            bool word_start = p == text || !isalnum((unsigned char)p[-1]);
+            if (word_start && strncasecmp(p, prefix, len) == 0) {
+                return true;
+            }
+        }
+        return len == 0;
+    }
+
+private:
+    struct String_t {
+        uint32_t hash;
+        uint16_t refs;  // Entries pointing here as station or title, 0 is a free slot
+        uint8_t match;  // Scratch for `search()`
+        char text[STRING_SIZE];
+    };
+
+    static void* alloc(size_t size)
+    {
+        void* p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        return p ? p : malloc(size);
+    }
+
+    static uint32_t hash_of(const char* text)
+    {
+        uint32_t hash = 2166136261u;
+        for (int i = 0; text[i] && i < STRING_SIZE - 1; i++) {
+            hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    uint16_t intern(const char* text)
+    {
+        // A title changes every few minutes, a scan of the slots costs nothing next to that
+        uint32_t hash = hash_of(text);
+        for (int i = 0; i < MAX_STRINGS; i++) {
+            String_t& s = _strings[i];
+            if (s.refs > 0 && s.hash == hash && strncmp(s.text, text, STRING_SIZE - 1) == 0) {
+                s.refs++;
+                return i;
+            }
+        }
+
+        uint16_t slot = _free[--_free_count];
+        String_t& s   = _strings[slot];
+        s.hash        = hash;
+        s.refs        = 1;
+        strncpy(s.text, text, STRING_SIZE - 1);
+        s.text[STRING_SIZE - 1] = '\0';
+        return slot;
+    }
+
+    void release(uint16_t slot)
+    {
+        if (--_strings[slot].refs == 0) {
+            _free[_free_count++] = slot;
+        }
+    }
+
+    void drop_oldest()
+    {
+        const Entry_t& entry = _entries[_first];
+        release(entry.station);
+        release(entry.title);
+        _first = (_first + 1) % MAX_ENTRIES;
+        _count--;
+    }
+
+    Entry_t* _entries  = nullptr;
+    String_t* _strings = nullptr;
+    int _free_count    = 0;
+    int _first         = 0;
+    int _count         = 0;
+    uint32_t _next_seq = 0;
+    uint16_t _free[MAX_STRINGS];  // Free slot stack, `_free_count` deep
+};